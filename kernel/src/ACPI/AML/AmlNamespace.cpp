@@ -11,7 +11,8 @@
 namespace Hal {
     namespace AML {
 
-        Namespace::Namespace() : m_chunkCount(0), m_nodeCount(0) {
+        Namespace::Namespace()
+            : m_chunkCount(0), m_nodeCount(0), m_hash(nullptr), m_hashSlots(0), m_hashCount(0) {
             for (int i = 0; i < MaxChunks; i++)
                 m_chunks[i] = nullptr;
             // Root node is created lazily by the first CreateNode/AllocNode call,
@@ -83,6 +84,17 @@ namespace Hal {
             return true;
         }
 
+        uint32_t Namespace::PackSegment(const char* seg) {
+            uint32_t packed = 0;
+            bool ended = false;
+            for (int i = 0; i < MaxNameSegLen; i++) {
+                if (!seg[i]) ended = true;
+                char c = ended ? '_' : seg[i];
+                packed |= (uint32_t)(uint8_t)c << (i * 8);
+            }
+            return packed;
+        }
+
         void Namespace::PadSegment(const char* src, char* dst) {
             int i = 0;
             while (i < MaxNameSegLen && src[i] != '\0') {
@@ -130,20 +142,65 @@ namespace Hal {
             return count;
         }
 
-        int32_t Namespace::FindChildByName(int32_t parentIndex, const char* seg) const {
-            auto* parent = GetNode(parentIndex);
-            if (!parent) return -1;
-
-            for (int32_t i = 0; i < parent->ChildCount; i++) {
-                int32_t ci = parent->ChildIndices[i];
-                auto* child = GetNode(ci);
-                if (!child) continue;
-                if (SegmentEqual(child->Name, seg))
-                    return ci;
+        // Name hash: (parent, NameSeg) -> node index. Entries are never removed.
+        uint32_t Namespace::HashKey(int32_t parentIndex, uint32_t seg) {
+            uint32_t h = seg * 0x9E3779B1u ^ ((uint32_t)parentIndex * 0x85EBCA77u);
+            h ^= h >> 15;
+            h *= 0x2C1B3C6Du;
+            h ^= h >> 13;
+            return h;
+        }
+
+        bool Namespace::HashGrow() {
+            int32_t slots = m_hashSlots ? m_hashSlots * 2 : InitialHashSlots;
+            auto* table = (int32_t*)Memory::g_heap->Request(sizeof(int32_t) * slots);
+            if (!table) return false;
+            for (int32_t i = 0; i < slots; i++)
+                table[i] = -1;
+
+            int32_t* old = m_hash;
+            int32_t oldSlots = m_hashSlots;
+            m_hash = table;
+            m_hashSlots = slots;
+            m_hashCount = 0;
+
+            for (int32_t i = 0; i < oldSlots; i++) {
+                if (old[i] >= 0) HashInsert(old[i]);
+            }
+            if (old) Memory::g_heap->Free(old);
+            return true;
+        }
+
+        bool Namespace::HashInsert(int32_t nodeIndex) {
+            if ((m_hashCount + 1) * 2 > m_hashSlots && !HashGrow()) return false;
+
+            auto* node = GetNode(nodeIndex);
+            uint32_t mask = (uint32_t)m_hashSlots - 1;
+            uint32_t slot = HashKey(node->ParentIndex, node->NameSeg) & mask;
+            while (m_hash[slot] >= 0)
+                slot = (slot + 1) & mask;
+            m_hash[slot] = nodeIndex;
+            m_hashCount++;
+            return true;
+        }
+
+        int32_t Namespace::FindChild(int32_t parentIndex, uint32_t seg) const {
+            if (!m_hash) return -1;
+
+            uint32_t mask = (uint32_t)m_hashSlots - 1;
+            for (uint32_t slot = HashKey(parentIndex, seg) & mask; m_hash[slot] >= 0;
+                 slot = (slot + 1) & mask) {
+                auto* node = GetNode(m_hash[slot]);
+                if (node && node->ParentIndex == parentIndex && node->NameSeg == seg)
+                    return m_hash[slot];
             }
             return -1;
         }
 
+        int32_t Namespace::FindChildByName(int32_t parentIndex, const char* seg) const {
+            return FindChild(parentIndex, PackSegment(seg));
+        }
+
         int32_t Namespace::CreateNode(const char* absolutePath) {
             EnsureRoot();
             char segments[MaxPathDepth][MaxNameSegLen + 1];
@@ -160,16 +217,20 @@ namespace Hal {
                     auto* childNode = GetNode(child);
                     if (!childNode) return -1;
                     memcpy(childNode->Name, segments[i], MaxNameSegLen + 1);
+                    childNode->NameSeg = PackSegment(segments[i]);
                     childNode->ParentIndex = current;
+                    if (!HashInsert(child)) return -1;
 
-                    // Add to parent's children
+                    // Append to the parent's children
                     auto* parent = GetNode(current);
                     if (!parent) return -1;
-                    if (parent->ChildCount < MaxChildren) {
-                        parent->ChildIndices[parent->ChildCount++] = child;
+                    if (parent->LastChild >= 0) {
+                        GetNode(parent->LastChild)->NextSibling = child;
                     } else {
-                        return -1; // too many children
+                        parent->FirstChild = child;
                     }
+                    parent->LastChild = child;
+                    parent->ChildCount++;
                 }
                 current = child;
             }
@@ -194,12 +255,11 @@ namespace Hal {
                 return FindNode(name);
 
             // Try to find relative to the current scope, walking up
-            char padded[MaxNameSegLen + 1];
-            PadSegment(name, padded);
+            uint32_t seg = PackSegment(name);
 
             int32_t scope = scopeNodeIndex;
             while (scope >= 0) {
-                int32_t found = FindChildByName(scope, padded);
+                int32_t found = FindChild(scope, seg);
                 if (found >= 0) return found;
                 auto* node = GetNode(scope);
                 scope = node ? node->ParentIndex : -1;
@@ -55,7 +55,6 @@ namespace Hal {
         // ============================================================================
         static constexpr int MaxNameSegLen     = 4;
         static constexpr int MaxPathDepth      = 16;
-        static constexpr int MaxChildren       = 64;
         static constexpr int MaxStringLen      = 64;
         static constexpr int MaxBufferLen      = 256;
         static constexpr int MaxPackageElements = 16;
@@ -67,6 +66,10 @@ namespace Hal {
         static constexpr int NodesPerChunk     = 256;
         static constexpr int MaxChunks         = 128;  // up to 32768 nodes
 
+        // Name lookup table: open addressing over (parent, NameSeg), grown
+        // by doubling to stay at most half full
+        static constexpr int InitialHashSlots  = 1024;
+
         // ============================================================================
 
         // AML Object
@@ -125,20 +128,26 @@ namespace Hal {
 
         // ============================================================================
         // Each node has a 4-char name segment and an associated object.
+        // Children form a list in creation order through NextSibling.
         struct NamespaceNode {
             char         Name[MaxNameSegLen + 1]; // null-terminated 4-char segment
+            uint32_t     NameSeg;                 // Name packed, for hashing
             Object       Obj;
             int32_t      ParentIndex;             // -1 for root
-            int32_t      ChildIndices[MaxChildren];
+            int32_t      FirstChild;
+            int32_t      LastChild;
+            int32_t      NextSibling;
             int32_t      ChildCount;
 
             void Clear() {
                 Name[0] = 0;
+                NameSeg = 0;
                 Obj = Object{};
                 ParentIndex = -1;
+                FirstChild = -1;
+                LastChild = -1;
+                NextSibling = -1;
                 ChildCount = 0;
-                for (int i = 0; i < MaxChildren; i++)
-                    ChildIndices[i] = -1;
             }
         };
 
@@ -189,12 +198,14 @@ namespace Hal {
             int32_t ForEachChild(int32_t parentIndex, ObjectType type, Fn callback) const {
                 auto* parent = GetNode(parentIndex);
                 if (!parent) return -1;
-                for (int32_t i = 0; i < parent->ChildCount; i++) {
-                    int32_t ci = parent->ChildIndices[i];
+                for (int32_t ci = parent->FirstChild; ci >= 0; ) {
                     auto* child = GetNode(ci);
-                    if (!child) continue;
-                    if (type != ObjectType::None && child->Obj.Type != type) continue;
-                    if (!callback(ci, child)) return ci;
+                    if (!child) break;
+                    int32_t next = child->NextSibling;
+                    if (type == ObjectType::None || child->Obj.Type == type) {
+                        if (!callback(ci, child)) return ci;
+                    }
+                    ci = next;
                 }
                 return -1;
             }
@@ -204,13 +215,13 @@ namespace Hal {
             void WalkDescendants(int32_t nodeIndex, ObjectType type, Fn callback) const {
                 auto* node = GetNode(nodeIndex);
                 if (!node) return;
-                for (int32_t i = 0; i < node->ChildCount; i++) {
-                    int32_t ci = node->ChildIndices[i];
+                for (int32_t ci = node->FirstChild; ci >= 0; ) {
                     auto* child = GetNode(ci);
-                    if (!child) continue;
+                    if (!child) break;
                     if (type == ObjectType::None || child->Obj.Type == type)
                         callback(ci, child);
                     WalkDescendants(ci, type, callback);
+                    ci = child->NextSibling;
                 }
             }
 
@@ -219,15 +230,24 @@ namespace Hal {
             bool    AllocChunk();
             void    EnsureRoot();
             int32_t FindChildByName(int32_t parentIndex, const char* seg) const;
+            int32_t FindChild(int32_t parentIndex, uint32_t seg) const;
+            bool    HashInsert(int32_t nodeIndex);
+            bool    HashGrow();
 
             // Parse an absolute path into segments. Returns number of segments.
             static int ParsePath(const char* path, char segments[][MaxNameSegLen + 1], int maxSegments);
             static bool SegmentEqual(const char* a, const char* b);
             static void PadSegment(const char* src, char* dst); // pad to 4 chars with '_'
+            static uint32_t PackSegment(const char* seg);       // same padding, as an integer
+            static uint32_t HashKey(int32_t parentIndex, uint32_t seg);
 
             NamespaceNode* m_chunks[MaxChunks];  // array of pointers to heap-allocated chunks
             int32_t        m_chunkCount;
             int32_t        m_nodeCount;
+
+            int32_t*       m_hash;                // node indices, -1 = empty
+            int32_t        m_hashSlots;           // power of two
+            int32_t        m_hashCount;
         };
 
     };
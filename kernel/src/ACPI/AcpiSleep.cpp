@@ -19,13 +19,16 @@
 #include <Hal/Apic/IoApic.hpp>
 #include <Hal/Apic/Pic.hpp>
 #include <Timekeeping/ApicTimer.hpp>
-#include <Drivers/Graphics/IntelGPU.hpp>
 #include <Drivers/PS2/PS2Controller.hpp>
 #include <Graphics/Cursor.hpp>
 #include <Libraries/Memory.hpp>
 #include <Hal/MSR.hpp>
 #include <Hal/SmpBoot.hpp>
+#include <Hal/Fpu.hpp>
+#include <Sched/Scheduler.hpp>
+#include <CppLib/Spinlock.hpp>
 #include <Api/Syscall.hpp>
+#include <atomic>
 
 using namespace Kt;
 
@@ -86,6 +89,16 @@ namespace Hal {
         // Set by AcpiResumeEntry to signal Suspend() that resume completed.
         static volatile int g_resumeComplete = 0;
 
+        // Registered device hooks, in probe order
+        static DeviceHooks g_deviceHooks[MaxDeviceHooks];
+        static int g_deviceHookCount = 0;
+        static kcp::Spinlock g_deviceHookLock;
+
+        // Deferred resume threads of the last wake that have not finished.
+        // A new suspend waits for them rather than pulling a device out
+        // from under its own resume.
+        static std::atomic<int> g_deferredRunning{0};
+
         // ============================================================================
 
         // Initialize
@@ -127,9 +140,12 @@ namespace Hal {
                     const char* stepNames[] = {
                         "?", "GDT", "TSS", "Syscalls", "PAT", "PIC",
                         "LocalAPIC", "IoAPIC", "APICTimer", "PM1Clear",
-                        "WAK", "PS2", "IntelGPU", "sti"
+                        "WAK", "PS2", "Devices", "sti"
                     };
-                    const char* stepName = reinitStep <= 0x0D ? stepNames[reinitStep] : "?";
+                    // Step 0x20 + i is the i-th early resume hook in probe
+                    // order; the names are gone with the previous boot
+                    const char* stepName = reinitStep <= 0x0D ? stepNames[reinitStep] :
+                                           reinitStep >= 0x20 ? "device hook" : "?";
                     KernelLogStream(WARNING, "S3") << "Reinit stopped after step 0x"
                         << base::hex << (uint64_t)reinitStep << " (" << stepName
                         << ") - next step crashed/hung";
@@ -201,6 +217,52 @@ namespace Hal {
 
         // ============================================================================
 
+        // Device power hooks
+
+        // ============================================================================
+        void RegisterDevice(const DeviceHooks& hooks) {
+            g_deviceHookLock.Acquire();
+            bool full = g_deviceHookCount >= MaxDeviceHooks;
+            if (!full) g_deviceHooks[g_deviceHookCount++] = hooks;
+            g_deviceHookLock.Release();
+
+            if (full) {
+                KernelLogStream(WARNING, "S3") << "No room for power hooks of "
+                    << hooks.Name << "; it will not survive S3";
+            }
+        }
+
+        // Quiesce devices newest first, so a device goes down before the
+        // ones it was brought up on top of
+        static void RunSuspendHooks() {
+            for (int i = g_deviceHookCount - 1; i >= 0; i--) {
+                if (g_deviceHooks[i].Suspend) g_deviceHooks[i].Suspend();
+            }
+        }
+
+        static void DeferredResumeThread(uint64_t index) {
+            const DeviceHooks& hooks = g_deviceHooks[index];
+            uint64_t start = Timekeeping::GetMilliseconds();
+            hooks.Resume();
+            KernelLogStream(OK, "S3") << hooks.Name << " resumed in " << base::dec
+                << (Timekeeping::GetMilliseconds() - start) << " ms";
+            g_deferredRunning.fetch_sub(1);
+        }
+
+        // Hand each deferred resume to a system thread of its own. If none
+        // can be had, the hook runs on the caller instead.
+        static void StartDeferredResumes() {
+            for (int i = 0; i < g_deviceHookCount; i++) {
+                if (g_deviceHooks[i].Stage != ResumeStage::Deferred) continue;
+                g_deferredRunning.fetch_add(1);
+                if (Sched::CreateSystemThread(DeferredResumeThread, (uint64_t)i) < 0) {
+                    DeferredResumeThread((uint64_t)i);
+                }
+            }
+        }
+
+        // ============================================================================
+
         // Evaluate _PTS (Prepare To Sleep)
 
         // ============================================================================
@@ -435,6 +497,7 @@ namespace Hal {
             }
             reinitProgress(0x04);  // PAT
             Hal::InitializePAT();
+            Hal::Fpu::InitializeAP();  // XCR0 is reset by S3
             reinitProgress(0x05);  // PIC
             Hal::DisableLegacyPic();
             reinitProgress(0x06);  // Local APIC
@@ -451,9 +514,11 @@ namespace Hal {
             Drivers::PS2::Reinitialize();
             // Re-enable ACPI events (power button) after S3
             AcpiEvents::Reinitialize();
-            reinitProgress(0x0C);  // Intel GPU
-            if (Drivers::Graphics::IntelGPU::IsInitialized()) {
-                Drivers::Graphics::IntelGPU::Reinitialize();
+            reinitProgress(0x0C);  // Early device hooks
+            for (int i = 0; i < g_deviceHookCount; i++) {
+                if (g_deviceHooks[i].Stage != ResumeStage::Early) continue;
+                reinitProgress((uint8_t)(0x20 + i));
+                g_deviceHooks[i].Resume();
             }
             reinitProgress(0x0D);  // sti
             asm volatile("sti");
@@ -484,17 +549,28 @@ namespace Hal {
 
             KernelLogStream(INFO, "S3") << "Preparing for S3 suspend...";
 
-            // 1. Evaluate _PTS(3) — Prepare To Sleep
+            // 1. Let the last wake's deferred resumes finish, then quiesce
+            //    the devices. Probing is over by now, so the hook table no
+            //    longer changes.
+            while (g_deferredRunning.load() > 0) {
+                Sched::BlockForSleep(10);
+            }
+            RunSuspendHooks();
+
+            // 2. Evaluate _PTS(3) — Prepare To Sleep
             EvaluatePts(3);
 
-            // 2. Save CPU state. On resume, AcpiResumeLongMode jumps to
+            // 3. Save CPU state. On resume, AcpiResumeLongMode jumps to
             //    AcpiResumeEntry (not back here), which does all reinit and
             //    sets g_resumeComplete=1, then returns here via the stack.
             g_resumeComplete = 0;
+            Sched::SaveFpuState();
             AcpiSaveAndSuspend(&g_cpuState);
 
-            // If we get here after resume, AcpiResumeEntry already ran.
+            // If we get here after resume, AcpiResumeEntry already ran and
+            // the early devices are back. The rest come up in the background.
             if (g_resumeComplete) {
+                StartDeferredResumes();
                 return 0;
             }
 
@@ -509,27 +585,27 @@ namespace Hal {
             Io::Out8(0xF3, 0x70);  // CMOS register 0x73
             Io::Out8(0x00, 0x71);
 
-            // 3. Disable interrupts
+            // 4. Disable interrupts
             asm volatile("cli");
 
-            // 4. Identity-map the trampoline page so the CPU can execute it
+            // 5. Identity-map the trampoline page so the CPU can execute it
             //    after paging is re-enabled with our CR3 during wake.
             //    Physical 0x8000 → virtual 0x8000 (flat identity mapping).
             Memory::VMM::g_paging->Map(TRAMPOLINE_PHYS, TRAMPOLINE_PHYS);
 
-            // 5. Flush all caches
+            // 6. Flush all caches
             asm volatile("wbinvd");
 
-            // 6. Set the waking vector in FACS
+            // 7. Set the waking vector in FACS
             SetWakingVector();
 
-            // 7. Clear any pending PM1 status bits
+            // 8. Clear any pending PM1 status bits
             ClearPM1Status();
 
-            // 8. Enable wake events (power button, RTC)
+            // 9. Enable wake events (power button, RTC)
             EnableWakeEvents();
 
-            // 9. Write SLP_TYP to PM1 control registers (without SLP_EN)
+            // 10. Write SLP_TYP to PM1 control registers (without SLP_EN)
             uint16_t pm1a = Io::In16((uint16_t)g_pm1aControlBlock);
             pm1a = (pm1a & ~PM1_SLP_TYP_MASK) | (g_s3SlpTypA << 10);
             Io::Out16(pm1a, (uint16_t)g_pm1aControlBlock);
@@ -540,10 +616,10 @@ namespace Hal {
                 Io::Out16(pm1b, (uint16_t)g_pm1bControlBlock);
             }
 
-            // 10. Flush caches again
+            // 11. Flush caches again
             asm volatile("wbinvd");
 
-            // 11. Assert SLP_EN — this triggers S3 entry
+            // 12. Assert SLP_EN — this triggers S3 entry
             Io::Out16(pm1a | PM1_SLP_EN, (uint16_t)g_pm1aControlBlock);
 
             if (g_pm1bControlBlock != 0) {
@@ -570,6 +646,12 @@ namespace Hal {
             asm volatile("sti");
 
             KernelLogStream(WARNING, "S3") << "S3 entry may have failed (fell through)";
+
+            // The devices were quiesced all the same
+            for (int i = 0; i < g_deviceHookCount; i++) {
+                if (g_deviceHooks[i].Stage == ResumeStage::Early) g_deviceHooks[i].Resume();
+            }
+            StartDeferredResumes();
             return 0;
         }
 
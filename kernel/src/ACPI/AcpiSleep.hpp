@@ -104,10 +104,39 @@ namespace Hal {
         bool IsS3Available();
 
         // Perform an S3 suspend-to-RAM.
-        // Saves CPU state, evaluates _PTS(3), programs PM registers,
-        // sets waking vector, and enters S3.
+        // Runs the device suspend hooks, saves CPU state, evaluates _PTS(3),
+        // programs PM registers, sets waking vector, and enters S3.
         // Returns 0 on successful resume, or -1 if S3 is unavailable.
         int Suspend();
 
+        // ============================================================================
+
+        // Device power hooks
+
+        // ============================================================================
+        // Drivers register a pair of hooks for each device they bring up, so
+        // a wake restores the state they saved instead of probing again.
+        // Suspend hooks run newest first, before _PTS. Early resume hooks run
+        // on the BSP inside the resume path, before interrupts are back on,
+        // for what the desktop cannot draw without. Deferred ones (network
+        // link, USB) each get a system thread once the resume path is done,
+        // so they neither hold up the desktop nor each other.
+        enum class ResumeStage : uint8_t {
+            Early,
+            Deferred,
+        };
+
+        struct DeviceHooks {
+            const char* Name;
+            void (*Suspend)();      // Quiesce and save state; may be null
+            void (*Resume)();       // Restore the saved state
+            ResumeStage Stage;
+        };
+
+        static constexpr int MaxDeviceHooks = 16;
+
+        // Called by a driver once its device is up. Safe from parallel probes.
+        void RegisterDevice(const DeviceHooks& hooks);
+
     };
 };
@@ -0,0 +1,412 @@
+/*
+    * Channel.cpp
+    * Message channels: bidirectional message queues between processes
+    * Copyright (c) 2026 Daniel Hammer
+*/
+
+#include "Channel.hpp"
+#include <Memory/Heap.hpp>
+#include <Memory/MemObject.hpp>
+#include <Libraries/Memory.hpp>
+#include <Libraries/String.hpp>
+#include <CppLib/Spinlock.hpp>
+#include <Sched/Scheduler.hpp>
+
+namespace Channel {
+
+    // Handles: the slot's generation above bit 8, bit 7 set for a
+    // listener, the slot index in bits 1-6 and, for a channel, the end
+    // in bit 0 (0 = client, 1 = server)
+    static constexpr int ListenerBit = 0x80;
+    static constexpr int EndClient = 0;
+    static constexpr int EndServer = 1;
+
+    struct EndState {
+        int ownerPid;               // -1 until a server end is accepted
+        bool open;
+        uint32_t head, tail;        // Messages ever queued for / taken by this end
+        Message queue[QueueDepth];
+    };
+
+    // Allocated from the kernel heap while either end is open
+    struct ChannelState {
+        EndState ends[2];
+    };
+
+    struct Listener {
+        bool used;
+        uint16_t gen;
+        int ownerPid;
+        char name[Montauk::CHAN_NAME_MAX];
+        int pending[Backlog];       // Channel slots, oldest first
+        int pendingCount;
+        volatile uint32_t seq;      // Moves as connections arrive
+    };
+
+    static kcp::LockStat g_lockStat{"channel"};
+    static kcp::Spinlock g_lock{&g_lockStat};
+    static ChannelState* g_channels[MaxChannels];
+    static uint16_t g_channelGens[MaxChannels];
+    static Listener g_listeners[MaxListeners];
+
+    // Wait queue word of each end, moved when a message arrives for it,
+    // one leaves the peer's queue or the peer closes. Outside the
+    // channel, so a sleeper never touches freed memory.
+    static volatile uint32_t g_seqs[MaxChannels][2];
+
+    static bool StrEqual(const char* a, const char* b) {
+        while (*a && *a == *b) { a++; b++; }
+        return *a == *b;
+    }
+
+    static int MakeEndHandle(int index, int end) {
+        return ((int)g_channelGens[index] << 8) | (index << 1) | end;
+    }
+
+    static int MakeListenerHandle(int index) {
+        return ((int)g_listeners[index].gen << 8) | ListenerBit | (index << 1);
+    }
+
+    static bool IsListenerHandle(int handle) {
+        return (handle & ListenerBit) != 0;
+    }
+
+    static EndState* LookupEndLocked(int handle, int pid, int& index, int& end) {
+        if (handle <= 0 || IsListenerHandle(handle)) return nullptr;
+        index = (handle >> 1) & (MaxChannels - 1);
+        end = handle & 1;
+        ChannelState* channel = g_channels[index];
+        if (channel == nullptr || MakeEndHandle(index, end) != handle) return nullptr;
+        EndState& self = channel->ends[end];
+        if (!self.open || self.ownerPid != pid) return nullptr;
+        return &self;
+    }
+
+    static Listener* LookupListenerLocked(int handle, int pid) {
+        if (handle <= 0 || !IsListenerHandle(handle)) return nullptr;
+        int index = (handle >> 1) & (MaxListeners - 1);
+        Listener& listener = g_listeners[index];
+        if (!listener.used || listener.ownerPid != pid || MakeListenerHandle(index) != handle) return nullptr;
+        return &listener;
+    }
+
+    static uint32_t BumpLocked(int index, int end) {
+        return __atomic_add_fetch(&g_seqs[index][end], 1, __ATOMIC_SEQ_CST);
+    }
+
+    static void Wake(int index, int end) {
+        Sched::WakeAddress(&g_seqs[index][end], Sched::MaxProcesses);
+        Sched::NotifyReady(&g_seqs[index][end]);
+    }
+
+    static bool KillPending() {
+        auto* thread = Sched::GetCurrentThreadPtr();
+        return thread == nullptr || thread->sched->killPending;
+    }
+
+    // What closing an end leaves to do once g_lock is released
+    struct Closed {
+        Memory::MemObject* drop[QueueDepth];
+        int dropCount;
+        ChannelState* free;         // Both ends are closed
+    };
+
+    static void CloseEndLocked(int index, int end, Closed& closed) {
+        ChannelState* channel = g_channels[index];
+        EndState& self = channel->ends[end];
+        closed.dropCount = 0;
+        closed.free = nullptr;
+
+        for (; self.tail != self.head; self.tail++) {
+            Message& m = self.queue[self.tail % QueueDepth];
+            if (m.object) closed.drop[closed.dropCount++] = m.object;
+        }
+        self.open = false;
+        self.ownerPid = -1;
+        BumpLocked(index, end ^ 1);
+
+        if (!channel->ends[end ^ 1].open) {
+            g_channels[index] = nullptr;
+            closed.free = channel;
+        }
+    }
+
+    static void FinishClose(int index, int end, Closed& closed) {
+        for (int i = 0; i < closed.dropCount; i++) closed.drop[i]->Release();
+        if (closed.free) Memory::g_heap->Free(closed.free);
+        Wake(index, end ^ 1);
+    }
+
+    int Listen(const char* name, int pid) {
+        int len = (int)Lib::strlen(name);
+        if (len == 0 || len >= Montauk::CHAN_NAME_MAX) return -1;
+
+        g_lock.Acquire();
+        int index = -1;
+        for (int i = 0; i < MaxListeners; i++) {
+            if (!g_listeners[i].used) {
+                if (index < 0) index = i;
+            } else if (StrEqual(g_listeners[i].name, name)) {
+                g_lock.Release();
+                return -1;
+            }
+        }
+        if (index < 0) {
+            g_lock.Release();
+            return -1;
+        }
+
+        Listener& listener = g_listeners[index];
+        listener.used = true;
+        listener.gen = (uint16_t)(listener.gen + 1);
+        if (listener.gen == 0) listener.gen = 1;
+        listener.ownerPid = pid;
+        memcpy(listener.name, name, len + 1);
+        listener.pendingCount = 0;
+        int handle = MakeListenerHandle(index);
+        g_lock.Release();
+        return handle;
+    }
+
+    int Connect(const char* name, int pid) {
+        auto* channel = (ChannelState*)Memory::g_heap->Request(sizeof(ChannelState));
+        if (channel == nullptr) return -1;
+        memset(channel, 0, sizeof(ChannelState));
+        channel->ends[EndClient].ownerPid = pid;
+        channel->ends[EndClient].open = true;
+        channel->ends[EndServer].ownerPid = -1;
+        channel->ends[EndServer].open = true;
+
+        g_lock.Acquire();
+        Listener* listener = nullptr;
+        for (int i = 0; i < MaxListeners; i++) {
+            if (g_listeners[i].used && StrEqual(g_listeners[i].name, name)) {
+                listener = &g_listeners[i];
+                break;
+            }
+        }
+        int index = -1;
+        for (int i = 0; i < MaxChannels && listener != nullptr; i++) {
+            if (g_channels[i] == nullptr) { index = i; break; }
+        }
+        if (index < 0 || listener->pendingCount == Backlog) {
+            g_lock.Release();
+            Memory::g_heap->Free(channel);
+            return -1;
+        }
+
+        g_channels[index] = channel;
+        g_channelGens[index] = (uint16_t)(g_channelGens[index] + 1);
+        if (g_channelGens[index] == 0) g_channelGens[index] = 1;
+        listener->pending[listener->pendingCount++] = index;
+        __atomic_add_fetch(&listener->seq, 1, __ATOMIC_SEQ_CST);
+        int handle = MakeEndHandle(index, EndClient);
+        volatile uint32_t* word = &listener->seq;
+        g_lock.Release();
+
+        Sched::WakeAddress(word, Sched::MaxProcesses);
+        Sched::NotifyReady(word);
+        return handle;
+    }
+
+    int Accept(int handle, int pid, uint32_t flags) {
+        while (true) {
+            g_lock.Acquire();
+            Listener* listener = LookupListenerLocked(handle, pid);
+            if (listener == nullptr) {
+                g_lock.Release();
+                return -1;
+            }
+            if (listener->pendingCount > 0) {
+                int index = listener->pending[0];
+                listener->pendingCount--;
+                for (int i = 0; i < listener->pendingCount; i++) listener->pending[i] = listener->pending[i + 1];
+                g_channels[index]->ends[EndServer].ownerPid = pid;
+                int end = MakeEndHandle(index, EndServer);
+                g_lock.Release();
+                return end;
+            }
+            uint32_t seq = listener->seq;
+            g_lock.Release();
+
+            if (flags & Montauk::CHAN_NOWAIT) return 0;
+            if (KillPending()) return -1;
+            // Listener slots are static, so the word outlives a close;
+            // closing moves it too
+            Sched::WaitOnAddress(&listener->seq, seq);
+        }
+    }
+
+    int Send(int handle, int pid, Message& message, uint32_t flags) {
+        while (true) {
+            g_lock.Acquire();
+            int index, end;
+            EndState* self = LookupEndLocked(handle, pid, index, end);
+            if (self == nullptr || !g_channels[index]->ends[end ^ 1].open) {
+                g_lock.Release();
+                return -1;
+            }
+            EndState& peer = g_channels[index]->ends[end ^ 1];
+            uint32_t seq = g_seqs[index][end];
+            if (peer.head - peer.tail < (uint32_t)QueueDepth) {
+                message.msg.senderPid = pid;
+                peer.queue[peer.head % QueueDepth] = message;
+                peer.head++;
+                BumpLocked(index, end ^ 1);
+                g_lock.Release();
+                Wake(index, end ^ 1);
+                return 1;
+            }
+            g_lock.Release();
+
+            if (flags & Montauk::CHAN_NOWAIT) return 0;
+            if (KillPending()) return -1;
+            // The peer taking a message or closing moves our word
+            Sched::WaitOnAddress(&g_seqs[index][end], seq);
+        }
+    }
+
+    int Recv(int handle, int pid, Message& out, uint32_t flags) {
+        while (true) {
+            g_lock.Acquire();
+            int index, end;
+            EndState* self = LookupEndLocked(handle, pid, index, end);
+            if (self == nullptr) {
+                g_lock.Release();
+                return -1;
+            }
+            uint32_t seq = g_seqs[index][end];
+            if (self->tail != self->head) {
+                out = self->queue[self->tail % QueueDepth];
+                self->tail++;
+                BumpLocked(index, end ^ 1);
+                g_lock.Release();
+                Wake(index, end ^ 1);
+                return 1;
+            }
+            bool peerOpen = g_channels[index]->ends[end ^ 1].open;
+            g_lock.Release();
+
+            if (!peerOpen) return -1;
+            if (flags & Montauk::CHAN_NOWAIT) return 0;
+            if (KillPending()) return -1;
+            Sched::WaitOnAddress(&g_seqs[index][end], seq);
+        }
+    }
+
+    int Close(int handle, int pid) {
+        g_lock.Acquire();
+
+        if (IsListenerHandle(handle)) {
+            Listener* listener = LookupListenerLocked(handle, pid);
+            if (listener == nullptr) {
+                g_lock.Release();
+                return -1;
+            }
+            listener->used = false;
+            int pending[Backlog];
+            int count = listener->pendingCount;
+            for (int i = 0; i < count; i++) pending[i] = listener->pending[i];
+            listener->pendingCount = 0;
+            __atomic_add_fetch(&listener->seq, 1, __ATOMIC_SEQ_CST);
+            g_lock.Release();
+            Sched::WakeAddress(&listener->seq, Sched::MaxProcesses);
+
+            // Connections never accepted are closed from the server side
+            for (int i = 0; i < count; i++) {
+                Closed closed;
+                g_lock.Acquire();
+                CloseEndLocked(pending[i], EndServer, closed);
+                g_lock.Release();
+                FinishClose(pending[i], EndServer, closed);
+            }
+            Sched::NotifyReady(&listener->seq);
+            return 0;
+        }
+
+        int index, end;
+        if (LookupEndLocked(handle, pid, index, end) == nullptr) {
+            g_lock.Release();
+            return -1;
+        }
+        Closed closed;
+        CloseEndLocked(index, end, closed);
+        g_lock.Release();
+        FinishClose(index, end, closed);
+        return 0;
+    }
+
+    uint32_t Poll(int handle, int pid, uint32_t& seq, uint64_t& key) {
+        seq = 0;
+        key = 0;
+        g_lock.Acquire();
+
+        if (IsListenerHandle(handle)) {
+            Listener* listener = LookupListenerLocked(handle, pid);
+            uint32_t bits = Montauk::POLL_ERR;
+            if (listener) {
+                seq = listener->seq;
+                key = (uint64_t)&listener->seq;
+                bits = listener->pendingCount > 0 ? Montauk::POLL_IN : 0;
+            }
+            g_lock.Release();
+            return bits;
+        }
+
+        int index, end;
+        EndState* self = LookupEndLocked(handle, pid, index, end);
+        if (self == nullptr) {
+            g_lock.Release();
+            return Montauk::POLL_ERR;
+        }
+        EndState& peer = g_channels[index]->ends[end ^ 1];
+        seq = g_seqs[index][end];
+        key = (uint64_t)&g_seqs[index][end];
+        uint32_t bits = self->head != self->tail ? Montauk::POLL_IN : 0;
+        if (!peer.open) bits |= Montauk::POLL_IN | Montauk::POLL_HUP;
+        else if (peer.head - peer.tail < (uint32_t)QueueDepth) bits |= Montauk::POLL_OUT;
+        g_lock.Release();
+        return bits;
+    }
+
+    // A handle `pid` owns, or 0
+    static int FindOwnedLocked(int pid) {
+        for (int i = 0; i < MaxListeners; i++) {
+            if (g_listeners[i].used && g_listeners[i].ownerPid == pid) return MakeListenerHandle(i);
+        }
+        for (int i = 0; i < MaxChannels; i++) {
+            ChannelState* channel = g_channels[i];
+            if (channel == nullptr) continue;
+            for (int end = 0; end < 2; end++) {
+                if (channel->ends[end].open && channel->ends[end].ownerPid == pid) return MakeEndHandle(i, end);
+            }
+        }
+        return 0;
+    }
+
+    void CleanupProcess(int pid) {
+        while (true) {
+            g_lock.Acquire();
+            int handle = FindOwnedLocked(pid);
+            g_lock.Release();
+            if (handle == 0 || Close(handle, pid) < 0) return;
+        }
+    }
+
+    int CountHeld(int pid) {
+        int count = 0;
+        g_lock.Acquire();
+        for (int i = 0; i < MaxListeners; i++) {
+            if (g_listeners[i].used && g_listeners[i].ownerPid == pid) count++;
+        }
+        for (int i = 0; i < MaxChannels; i++) {
+            ChannelState* channel = g_channels[i];
+            if (channel == nullptr) continue;
+            for (int end = 0; end < 2; end++) {
+                if (channel->ends[end].open && channel->ends[end].ownerPid == pid) count++;
+            }
+        }
+        g_lock.Release();
+        return count;
+    }
+}
@@ -0,0 +1,73 @@
+/*
+    * Channel.hpp
+    * Message channels: bidirectional message queues between processes
+    * Copyright (c) 2026 Daniel Hammer
+*/
+
+#pragma once
+#include <cstdint>
+#include "Syscall.hpp"
+
+namespace Memory { class MemObject; }
+
+namespace Channel {
+
+    static constexpr int MaxChannels = 64;
+    static constexpr int MaxListeners = 16;
+    static constexpr int QueueDepth = Montauk::CHAN_QUEUE_DEPTH;
+    // Connections a listener holds until they are accepted
+    static constexpr int Backlog = 8;
+
+    // A message as queued: the ChanMsg, and the shared memory it hands
+    // over, if any, as a reference to its object and the pages of it
+    struct Message {
+        Montauk::ChanMsg msg;
+        Memory::MemObject* object;
+        uint64_t objectPage;
+        uint64_t pages;
+    };
+
+    // Each end of a channel, and each listener, belongs to the process
+    // that created, connected or accepted it, and is closed when that
+    // process exits. The calls below return -1 if `pid` does not own
+    // `handle`.
+
+    // Listen on `name` (at most CHAN_NAME_MAX - 1 bytes, not in use).
+    // Returns the listener handle, or -1.
+    int Listen(const char* name, int pid);
+
+    // Make a channel to the listener `name`. Returns the client end, or
+    // -1 if nobody listens there or its backlog is full.
+    int Connect(const char* name, int pid);
+
+    // The server end of the oldest pending connection; 0 with
+    // CHAN_NOWAIT if there is none
+    int Accept(int listener, int pid, uint32_t flags);
+
+    // Queue `message` for the other end. Takes over its object reference
+    // when it returns 1; on 0 (CHAN_NOWAIT, queue full) or -1 (peer
+    // closed) the caller keeps it.
+    int Send(int handle, int pid, Message& message, uint32_t flags);
+
+    // Take the oldest message queued for `handle`, with the object
+    // reference it carries. Returns 1, 0 with CHAN_NOWAIT if none is
+    // queued, or -1 once none is and the peer has closed.
+    int Recv(int handle, int pid, Message& out, uint32_t flags);
+
+    // Close a channel end (dropping the messages queued for it) or a
+    // listener (closing the connections it has not handed out)
+    int Close(int handle, int pid);
+
+    // Montauk::POLL_* bits (SYS_EPOLL_WAIT): for an end POLL_IN when a
+    // message is queued, POLL_OUT when the peer's queue has room,
+    // POLL_HUP once the peer has closed; for a listener POLL_IN when a
+    // connection is pending. `seq` moves with each change; `key` is what
+    // the channel then passes to Sched::NotifyReady.
+    uint32_t Poll(int handle, int pid, uint32_t& seq, uint64_t& key);
+
+    // Close every end and listener `pid` owns
+    void CleanupProcess(int pid);
+
+    // Ends and listeners `pid` owns
+    int CountHeld(int pid);
+}
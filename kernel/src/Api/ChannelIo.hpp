@@ -0,0 +1,109 @@
+/*
+    * ChannelIo.hpp
+    * SYS_CHAN_LISTEN, SYS_CHAN_CONNECT, SYS_CHAN_ACCEPT, SYS_CHAN_SEND,
+    * SYS_CHAN_RECV, SYS_CHAN_CLOSE syscalls
+    * Copyright (c) 2026 Daniel Hammer
+*/
+
+#pragma once
+#include <Sched/Scheduler.hpp>
+#include <Memory/MemObject.hpp>
+#include <Libraries/Memory.hpp>
+
+#include "Syscall.hpp"
+#include "Channel.hpp"
+
+namespace Montauk {
+
+    // Copy a channel name out of user memory; false if it is too long
+    static bool CopyChannelName(const char* name, char* out) {
+        for (int i = 0; i < CHAN_NAME_MAX; i++) {
+            out[i] = name[i];
+            if (out[i] == '\0') return true;
+        }
+        return false;
+    }
+
+    static int Sys_ChanListen(const char* name) {
+        auto* proc = Sched::GetCurrentProcessPtr();
+        char copy[CHAN_NAME_MAX];
+        if (proc == nullptr || !CopyChannelName(name, copy)) return -1;
+        return Channel::Listen(copy, proc->pid);
+    }
+
+    static int Sys_ChanConnect(const char* name) {
+        auto* proc = Sched::GetCurrentProcessPtr();
+        char copy[CHAN_NAME_MAX];
+        if (proc == nullptr || !CopyChannelName(name, copy)) return -1;
+        return Channel::Connect(copy, proc->pid);
+    }
+
+    static int Sys_ChanAccept(int listener, uint32_t flags) {
+        auto* proc = Sched::GetCurrentProcessPtr();
+        if (proc == nullptr) return -1;
+        return Channel::Accept(listener, proc->pid, flags);
+    }
+
+    // A message handing over shared memory takes a reference to the
+    // object behind the sender's mapping at msg.shmAddr; the sender's own
+    // mapping stays as it is
+    static int Sys_ChanSend(int handle, const ChanMsg* msg, uint32_t flags) {
+        auto* proc = Sched::GetCurrentProcessPtr();
+        if (proc == nullptr) return -1;
+
+        Channel::Message message;
+        memcpy(&message.msg, msg, sizeof(ChanMsg));
+        message.object = nullptr;
+        message.objectPage = 0;
+        message.pages = 0;
+        if (message.msg.length > (uint32_t)CHAN_MSG_DATA) return -1;
+
+        if (message.msg.shmAddr != 0) {
+            proc->vmLock.Acquire();
+            const Memory::VmaTree::Node* region = proc->heapVmas.Find(message.msg.shmAddr);
+            if (region == nullptr || region->object == nullptr || region->start != message.msg.shmAddr) {
+                proc->vmLock.Release();
+                return -1;
+            }
+            message.object = region->object;
+            message.objectPage = region->objectPage;
+            message.pages = region->pages;
+            message.object->Retain();
+            proc->vmLock.Release();
+
+            uint64_t want = (message.msg.shmSize + 0xFFF) / 0x1000;
+            if (want != 0 && want < message.pages) message.pages = want;
+        }
+
+        int result = Channel::Send(handle, proc->pid, message, flags);
+        if (result != 1 && message.object) message.object->Release();
+        return result;
+    }
+
+    // The memory a message hands over is mapped before it is returned,
+    // as a region of the receiver's heap that SYS_FREE unmaps (MapObject:
+    // Mmap.hpp must be included first)
+    static int Sys_ChanRecv(int handle, ChanMsg* out, uint32_t flags) {
+        auto* proc = Sched::GetCurrentProcessPtr();
+        if (proc == nullptr) return -1;
+
+        Channel::Message message;
+        int result = Channel::Recv(handle, proc->pid, message, flags);
+        if (result != 1) return result;
+
+        message.msg.shmAddr = 0;
+        message.msg.shmSize = 0;
+        if (message.object) {
+            message.msg.shmAddr = MapObject(message.object, message.objectPage, message.pages);
+            if (message.msg.shmAddr != 0) message.msg.shmSize = message.pages * 0x1000;
+        }
+        memcpy(out, &message.msg, sizeof(ChanMsg));
+        return 1;
+    }
+
+    static int Sys_ChanClose(int handle) {
+        auto* proc = Sched::GetCurrentProcessPtr();
+        if (proc == nullptr) return -1;
+        return Channel::Close(handle, proc->pid);
+    }
+};
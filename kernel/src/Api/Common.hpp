@@ -1,5 +1,6 @@
 #pragma once
 #include <Sched/Scheduler.hpp>
+#include <Libraries/Memory.hpp>
 
 namespace Montauk {
     // Find the process that owns the I/O ring buffers for a redirected process.
@@ -22,16 +23,20 @@ namespace Montauk {
         head = (h + 1) % size;
     }
 
+    // Copies out at most two contiguous spans (before and after the wrap)
     static int RingRead(uint8_t* buf, volatile uint32_t& head, volatile uint32_t& tail, uint32_t size, uint8_t* out, int maxLen) {
-        int count = 0;
         uint32_t t = tail;
         uint32_t h = head;
-        while (t != h && count < maxLen) {
-            out[count++] = buf[t];
-            t = (t + 1) % size;
-        }
         asm volatile("" ::: "memory");  // compiler barrier
-        tail = t;
-        return count;
+        uint32_t avail = (h + size - t) % size;
+        uint32_t count = maxLen <= 0 ? 0 : (avail < (uint32_t)maxLen ? avail : (uint32_t)maxLen);
+
+        uint32_t first = size - t < count ? size - t : count;
+        memcpy(out, buf + t, first);
+        memcpy(out + first, buf, count - first);
+
+        asm volatile("" ::: "memory");  // compiler barrier
+        tail = (t + count) % size;
+        return (int)count;
     }
 }
\ No newline at end of file
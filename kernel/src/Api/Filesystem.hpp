@@ -1,7 +1,7 @@
 /*
     * Filesystem.hpp
     * SYS_OPEN, SYS_READ, SYS_GETSIZE, SYS_CLOSE, SYS_READDIR,
-    * SYS_FWRITE, SYS_FCREATE syscalls
+    * SYS_READDIRSTAT, SYS_FWRITE, SYS_FCREATE, SYS_FCOPY, SYS_FSYNC syscalls
     * Copyright (c) 2026 Daniel Hammer
 */
 
@@ -12,13 +12,15 @@
 #include <Memory/HHDM.hpp>
 #include <Memory/Paging.hpp>
 #include <Libraries/Memory.hpp>
+#include "Handles.hpp"
 #include "Path.hpp"
+#include "Syscall.hpp"
 
 namespace Montauk {
     static int Sys_Open(const char* path) {
         char resolved[256];
         if (!ResolveProcessPath(path, resolved, sizeof(resolved))) return -1;
-        return Fs::Vfs::VfsOpen(resolved);
+        return NoteHandleOpened(Fs::Vfs::VfsOpen(resolved));
     }
 
     static int Sys_Read(int handle, uint8_t* buffer, uint64_t offset, uint64_t size) {
@@ -30,6 +32,7 @@ namespace Montauk {
     }
 
     static void Sys_Close(int handle) {
+        NoteHandleClosed(handle);
         Fs::Vfs::VfsClose(handle);
     }
 
@@ -52,6 +55,7 @@ namespace Montauk {
         // bumping heapNext on every call. This keeps repeated directory scans
         // from leaking user heap space while still allowing nested callers to
         // hold multiple readdir results at once.
+        proc->vmLock.Acquire();
         uint32_t slot = proc->readdirCursor % Sched::UserReadDirSlots;
         proc->readdirCursor = (slot + 1) % Sched::UserReadDirSlots;
 
@@ -61,10 +65,14 @@ namespace Montauk {
 
         if (physAddr == 0) {
             void* page = Memory::g_pfa->AllocateZeroed();
-            if (page == nullptr) return -1;
+            if (page == nullptr) {
+                proc->vmLock.Release();
+                return -1;
+            }
             physAddr = Memory::SubHHDM((uint64_t)page);
             if (!Memory::VMM::Paging::MapUserIn(proc->pml4Phys, physAddr, userVa)) {
                 Memory::g_pfa->Free(page);
+                proc->vmLock.Release();
                 return -1;
             }
             pageBuf = (uint8_t*)page;
@@ -72,6 +80,7 @@ namespace Montauk {
             pageBuf = (uint8_t*)Memory::HHDM(physAddr);
             memset(pageBuf, 0, 0x1000);
         }
+        proc->vmLock.Release();
 
         // Copy strings into the user page and write pointers to outNames
         uint64_t offset = 0;
@@ -88,14 +97,32 @@ namespace Montauk {
         return copied;
     }
 
+    static_assert(sizeof(DirEntryInfo) == sizeof(Fs::Vfs::DirStat), "DirEntryInfo must match Vfs::DirStat");
+
+    // Records go straight into the caller's buffer
+    static int Sys_ReadDirStat(const char* path, uint64_t* cursor, DirEntryInfo* out, int maxEntries) {
+        char resolved[256];
+        if (!ResolveProcessPath(path, resolved, sizeof(resolved))) return -1;
+        return Fs::Vfs::VfsReadDirStat(resolved, cursor, (Fs::Vfs::DirStat*)out, maxEntries);
+    }
+
     static int Sys_FWrite(int handle, const uint8_t* data, uint64_t offset, uint64_t size) {
         return Fs::Vfs::VfsWrite(handle, data, offset, size);
     }
 
+    static int64_t Sys_FCopy(int srcHandle, int dstHandle, uint64_t srcOffset,
+                             uint64_t dstOffset, uint64_t size) {
+        return Fs::Vfs::VfsCopy(srcHandle, srcOffset, dstHandle, dstOffset, size);
+    }
+
+    static int Sys_FSync(int handle) {
+        return Fs::Vfs::VfsFsync(handle);
+    }
+
     static int Sys_FCreate(const char* path) {
         char resolved[256];
         if (!ResolveProcessPath(path, resolved, sizeof(resolved))) return -1;
-        return Fs::Vfs::VfsCreate(resolved);
+        return NoteHandleOpened(Fs::Vfs::VfsCreate(resolved));
     }
 
     static int Sys_FDelete(const char* path) {
@@ -0,0 +1,58 @@
+/*
+    * Futex.hpp
+    * SYS_FUTEX_WAIT, SYS_FUTEX_WAKE syscalls
+    * Copyright (c) 2026 Daniel Hammer
+*/
+
+#pragma once
+#include <cstdint>
+#include <Sched/Scheduler.hpp>
+#include <Memory/Paging.hpp>
+#include <Memory/HHDM.hpp>
+
+namespace Montauk {
+
+    static constexpr uint64_t FUTEX_USER_END = 0x0000800000000000ULL;
+
+    // Kernel alias for a 32-bit user word, or nullptr if it isn't mapped.
+    // The scheduler reads the word with interrupts off under its futex
+    // lock, where taking a page fault on a user address is not an option.
+    static volatile uint32_t* FutexWord(Sched::Process* proc, uint64_t addr) {
+        if (addr == 0 || (addr & 3) != 0 || addr >= FUTEX_USER_END) return nullptr;
+        uint64_t phys = Memory::VMM::Paging::GetUserPhysAddr(proc->pml4Phys, addr);
+        if (phys == 0 && HandleHeapFault(addr)) {
+            // An untouched heap page: fault it in like the access would
+            phys = Memory::VMM::Paging::GetUserPhysAddr(proc->pml4Phys, addr);
+        }
+        if (phys == 0) return nullptr;
+
+        // An untouched copy-on-write data page: take the private copy now,
+        // so the alias is the frame the process's own writes will reach
+        if (Memory::VMM::Paging::BreakCopyOnWrite(proc->pml4Phys, addr)) {
+            phys = Memory::VMM::Paging::GetUserPhysAddr(proc->pml4Phys, addr);
+        }
+        return (volatile uint32_t*)Memory::HHDM(phys);
+    }
+
+    static int Sys_FutexWait(uint64_t addr, uint32_t expected, uint64_t timeoutMs) {
+        auto* proc = Sched::GetCurrentProcessPtr();
+        if (proc == nullptr) return -1;
+
+        volatile uint32_t* word = FutexWord(proc, addr);
+        if (word == nullptr) return -1;
+
+        return Sched::FutexWait(addr, word, expected, timeoutMs);
+    }
+
+    static int Sys_FutexWake(uint64_t addr, int count) {
+        if (count <= 0) return -1;
+        auto* proc = Sched::GetCurrentProcessPtr();
+        if (proc == nullptr) return -1;
+
+        // Resolved like a wait, so the key is always a user address and
+        // never one of the kernel's own WaitOnAddress words
+        if (FutexWord(proc, addr) == nullptr) return -1;
+
+        return Sched::FutexWake(addr, count);
+    }
+};
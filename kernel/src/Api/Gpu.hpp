@@ -0,0 +1,176 @@
+/*
+    * Gpu.hpp
+    * SYS_GPUALLOC, SYS_GPUBLIT syscalls
+    * Copyright (c) 2026 Daniel Hammer
+*/
+
+#pragma once
+#include <cstdint>
+#include <Sched/Scheduler.hpp>
+#include <Memory/Heap.hpp>
+#include <Memory/MemObject.hpp>
+#include <Drivers/Graphics/IntelGPU.hpp>
+#include <CppLib/Spinlock.hpp>
+
+#include "Syscall.hpp"
+#include "WinServer.hpp"
+#include "Graphics.hpp"
+#include "Mmap.hpp"
+
+namespace Montauk {
+
+    // Memory handed out by SYS_GPUALLOC is an anonymous object mapped into
+    // the caller's heap and, for the blitter, into the GTT. The table holds
+    // a reference, so the pages outlive a blit that raced SYS_FREE; an
+    // entry whose object nobody else refers to any more is dropped on the
+    // next allocation.
+    struct GpuSurface {
+        Memory::MemObject* object;
+        uint64_t* physPages;
+        uint64_t pages;
+        uint64_t gpuAddress;
+    };
+
+    static constexpr int MaxGpuSurfaces = 32;
+
+    // Held across a whole SYS_GPUBLIT, so no graphics address it resolved
+    // can be unmapped and handed to another surface before the blits ran
+    static kcp::Mutex g_gpuLock;
+    static GpuSurface g_gpuSurfaces[MaxGpuSurfaces];
+    static int g_gpuSurfaceCount = 0;
+
+    static void ReclaimGpuSurfacesLocked() {
+        for (int i = 0; i < g_gpuSurfaceCount;) {
+            GpuSurface& surface = g_gpuSurfaces[i];
+            if (surface.object->References() > 1) {
+                i++;
+                continue;
+            }
+            Drivers::Graphics::IntelGPU::UnmapSurface(surface.gpuAddress);
+            Memory::g_heap->Free(surface.physPages);
+            surface.object->Release();
+            g_gpuSurfaces[i] = g_gpuSurfaces[--g_gpuSurfaceCount];
+        }
+    }
+
+    // `size` bytes of zeroed memory the blitter can read and write, freed
+    // with SYS_FREE. Returns its address, or 0 without a blitter.
+    static uint64_t Sys_GpuAlloc(uint64_t size) {
+        if (!Drivers::Graphics::IntelGPU::HasBlitter()) return 0;
+        if (size == 0 || size > (uint64_t)WinServer::MaxPixelPages * 0x1000 * 2) return 0;
+
+        g_gpuLock.Acquire();
+        ReclaimGpuSurfacesLocked();
+        if (g_gpuSurfaceCount == MaxGpuSurfaces) {
+            g_gpuLock.Release();
+            return 0;
+        }
+
+        Memory::MemObject* object = Memory::MemObject::CreateAnonymous(size);
+        if (object == nullptr) {
+            g_gpuLock.Release();
+            return 0;
+        }
+
+        // The blitter cannot take faults, so every page is backed now
+        uint64_t pages = object->Pages();
+        auto* physPages = (uint64_t*)Memory::g_heap->Request(pages * sizeof(uint64_t));
+        bool backed = physPages != nullptr;
+        for (uint64_t i = 0; backed && i < pages; i++) {
+            physPages[i] = object->PageAt(i);
+            backed = physPages[i] != 0;
+        }
+        uint64_t gpuAddress = backed ? Drivers::Graphics::IntelGPU::MapSurface(physPages, pages) : 0;
+        if (gpuAddress == 0) {
+            if (physPages) Memory::g_heap->Free(physPages);
+            object->Release();
+            g_gpuLock.Release();
+            return 0;
+        }
+
+        g_gpuSurfaces[g_gpuSurfaceCount++] = { object, physPages, pages, gpuAddress };
+        object->Retain();
+        g_gpuLock.Release();
+
+        // A failed mapping drops its reference; the entry goes next time
+        return MapObject(object, 0, pages);
+    }
+
+    // Graphics address of the caller's [va, va + length): a scanout buffer
+    // at its SYS_FBMAPBUFFER address, SYS_GPUALLOC memory, or (only to read
+    // from) a window front buffer it mapped. Under g_gpuLock.
+    static bool GpuAddressOfLocked(Sched::Process* proc, uint64_t va, uint64_t length, bool read,
+                                   uint64_t& out) {
+        if (length == 0 || va + length < va) return false;
+
+        constexpr uint64_t hugeSize = Memory::VMM::Paging::HugePageSize;
+        uint64_t fbSize = FbSize();
+        uint64_t stride = (fbSize + hugeSize - 1) & ~(hugeSize - 1);
+        int scanouts = Drivers::Graphics::IntelGPU::GetScanoutCount();
+        if (va >= FbUserVa && stride != 0 && va < FbUserVa + (uint64_t)scanouts * stride) {
+            uint64_t index = (va - FbUserVa) / stride;
+            uint64_t offset = (va - FbUserVa) % stride;
+            if (offset > fbSize || length > fbSize - offset) return false;
+            out = Drivers::Graphics::IntelGPU::GetScanoutGpuAddress((int)index) + offset;
+            return true;
+        }
+
+        // Window buffers are freed with the window, which need not wait
+        // for the compositor; the blitter never writes them
+        if (read) {
+            uint64_t window = WinServer::GpuAddress(proc->pid, va, length);
+            if (window != 0) {
+                out = window;
+                return true;
+            }
+        }
+
+        proc->vmLock.Acquire();
+        const Memory::VmaTree::Node* region = proc->heapVmas.Find(va);
+        bool found = false;
+        if (region != nullptr && region->object != nullptr
+            && length <= region->start + region->pages * 0x1000 - va) {
+            for (int i = 0; i < g_gpuSurfaceCount && !found; i++) {
+                const GpuSurface& surface = g_gpuSurfaces[i];
+                if (surface.object != region->object) continue;
+                out = surface.gpuAddress + region->objectPage * 0x1000 + (va - region->start);
+                found = true;
+            }
+        }
+        proc->vmLock.Release();
+        return found;
+    }
+
+    // Run `count` fills and copies on the blitter, in order, returning
+    // once they are done. 0, or -1 if any rectangle is not in memory the
+    // blitter reaches (nothing runs then) or there is no blitter.
+    static int Sys_GpuBlit(const GpuBlit* blits, int count) {
+        if (count <= 0 || count > GPU_BLIT_MAX) return -1;
+        auto* proc = Sched::GetCurrentProcessPtr();
+        if (proc == nullptr || !Drivers::Graphics::IntelGPU::HasBlitter()) return -1;
+
+        // Copied in before taking the lock, which a fault must not wait under;
+        // dst and src hold user addresses until resolved
+        Drivers::Graphics::IntelGPU::BlitCommand commands[GPU_BLIT_MAX];
+        for (int i = 0; i < count; i++) {
+            GpuBlit blit = blits[i];
+            if (blit.width == 0 || blit.height == 0 || blit.width > 0x8000 || blit.height > 0x8000) return -1;
+            commands[i] = { blit.fill != 0, blit.dst, blit.src, blit.dstPitch, blit.srcPitch,
+                            blit.width, blit.height, blit.color };
+        }
+
+        g_gpuLock.Acquire();
+        bool ok = true;
+        for (int i = 0; i < count && ok; i++) {
+            auto& command = commands[i];
+            uint64_t dstLength = (uint64_t)(command.height - 1) * command.dstPitch + (uint64_t)command.width * 4;
+            uint64_t srcLength = (uint64_t)(command.height - 1) * command.srcPitch + (uint64_t)command.width * 4;
+            ok = GpuAddressOfLocked(proc, command.dst, dstLength, false, command.dst)
+                && (command.fill || GpuAddressOfLocked(proc, command.src, srcLength, true, command.src));
+        }
+
+        if (ok) ok = Drivers::Graphics::IntelGPU::Blit(commands, count);
+        g_gpuLock.Release();
+        return ok ? 0 : -1;
+    }
+};
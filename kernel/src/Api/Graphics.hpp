@@ -1,6 +1,6 @@
 /*
     * Graphics.hpp
-    * SYS_FBINFO, SYS_FBMAP, SYS_TERMSIZE, SYS_TERMSCALE syscalls
+    * SYS_FBINFO, SYS_FBMAP, SYS_FBMAPBUFFER, SYS_FBFLIP, SYS_CURSORSET, SYS_TERMSIZE, SYS_TERMSCALE syscalls
     * Copyright (c) 2026 Daniel Hammer
 */
 
@@ -11,6 +11,9 @@
 #include <Memory/HHDM.hpp>
 #include <Graphics/Cursor.hpp>
 #include <Terminal/Terminal.hpp>
+#include <Timekeeping/ApicTimer.hpp>
+#include <Drivers/Graphics/IntelGPU.hpp>
+#include <Drivers/PS2/Mouse.hpp>
 
 #include "Syscall.hpp"
 #include "Common.hpp"
@@ -18,6 +21,16 @@
 
 namespace Montauk {
 
+    // Scanout buffers are mapped at a fixed user VA (2 MiB aligned), one
+    // after another, each starting on a 2 MiB boundary
+    static constexpr uint64_t FbUserVa = 0x50000000ULL;
+
+    // A flip that has not reached the screen after this long is given up on
+    static constexpr uint64_t FbFlipTimeoutMs = 50;
+
+    // Vertical blank count when the last flip reached the screen
+    static uint32_t g_fbFlipVblank = 0;
+
     static void Sys_FbInfo(FbInfo* out) {
         if (out == nullptr) return;
         out->width    = Graphics::Cursor::GetFramebufferWidth();
@@ -25,6 +38,39 @@ namespace Montauk {
         out->pitch    = Graphics::Cursor::GetFramebufferPitch();
         out->bpp      = 32;
         out->userAddr = 0;
+        out->buffers  = (uint64_t)Drivers::Graphics::IntelGPU::GetScanoutCount();
+    }
+
+    static uint64_t FbSize() {
+        return Graphics::Cursor::GetFramebufferHeight() * Graphics::Cursor::GetFramebufferPitch();
+    }
+
+    static uint64_t MapFramebufferAt(Sched::Process* proc, uint64_t fbPhys, uint64_t userVa) {
+        uint64_t numPages = (FbSize() + 0xFFF) / 0x1000;
+        constexpr uint64_t hugeSize = Memory::VMM::Paging::HugePageSize;
+        constexpr uint64_t hugePages = hugeSize / 0x1000;
+
+        // Whole 2 MiB stretches of an aligned framebuffer go in as huge
+        // pages (a 4K display needs ~16 instead of ~8000 TLB entries);
+        // the rest, or everything when misaligned, as 4 KiB pages.
+        for (uint64_t i = 0; i < numPages;) {
+            uint64_t phys = fbPhys + i * 0x1000;
+            uint64_t va = userVa + i * 0x1000;
+
+            if ((phys & (hugeSize - 1)) == 0 && numPages - i >= hugePages
+                && (Memory::VMM::Paging::IsUserHugePage(proc->pml4Phys, va)
+                    || Memory::VMM::Paging::MapUserHugeIn(proc->pml4Phys, phys, va, true))) {
+                i += hugePages;
+                continue;
+            }
+
+            if (!Memory::VMM::Paging::MapUserInWC(proc->pml4Phys, phys, va)) {
+                return 0;
+            }
+            i++;
+        }
+
+        return userVa;
     }
 
     static uint64_t Sys_FbMap() {
@@ -35,31 +81,71 @@ namespace Montauk {
         if (fbBase == nullptr) return 0;
 
         uint64_t fbPhys = Memory::SubHHDM((uint64_t)fbBase);
-        uint64_t fbSize = Graphics::Cursor::GetFramebufferHeight()
-                        * Graphics::Cursor::GetFramebufferPitch();
-        uint64_t numPages = (fbSize + 0xFFF) / 0x1000;
+        uint64_t fbSize = FbSize();
 
         Kt::KernelLogStream(Kt::INFO, "FbMap") << "fbPhys=" << kcp::hex << fbPhys
             << " size=" << kcp::dec << fbSize
-            << " pages=" << numPages
+            << " pages=" << (fbSize + 0xFFF) / 0x1000
             << " (" << Graphics::Cursor::GetFramebufferWidth()
             << "x" << Graphics::Cursor::GetFramebufferHeight()
             << " pitch=" << Graphics::Cursor::GetFramebufferPitch() << ")";
 
-        // Map at a fixed user VA
-        constexpr uint64_t userVa = 0x50000000ULL;
+        return MapFramebufferAt(proc, fbPhys, FbUserVa);
+    }
 
-        for (uint64_t i = 0; i < numPages; i++) {
-            if (!Memory::VMM::Paging::MapUserInWC(
-                proc->pml4Phys,
-                fbPhys + i * 0x1000,
-                userVa + i * 0x1000
-            )) {
-                return 0;
-            }
+    // Map scanout buffer `index` (0 = the framebuffer SYS_FBMAP maps).
+    // Returns its user address, or 0.
+    static uint64_t Sys_FbMapBuffer(int index) {
+        if (index == 0) return Sys_FbMap();
+
+        auto* proc = Sched::GetCurrentProcessPtr();
+        uint64_t phys = Drivers::Graphics::IntelGPU::GetScanoutPhysBase(index);
+        if (proc == nullptr || phys == 0) return 0;
+
+        constexpr uint64_t hugeSize = Memory::VMM::Paging::HugePageSize;
+        uint64_t stride = (FbSize() + hugeSize - 1) & ~(hugeSize - 1);
+        return MapFramebufferAt(proc, phys, FbUserVa + (uint64_t)index * stride);
+    }
+
+    // Scan out buffer `index` from the next vertical blank on, and wait
+    // until it is on screen, so the one it replaces can be drawn into.
+    // Returns 0, or -1 if the display cannot flip.
+    static int64_t Sys_FbFlip(int index) {
+        if (!Drivers::Graphics::IntelGPU::Flip(index)) return -1;
+
+        uint64_t deadline = Timekeeping::GetMilliseconds() + FbFlipTimeoutMs;
+        while (!Drivers::Graphics::IntelGPU::FlipDone() && Timekeeping::GetMilliseconds() < deadline) {
+            Sched::BlockForSleep(1);
         }
 
-        return userVa;
+        g_fbFlipVblank = Drivers::Graphics::IntelGPU::GetVblankCount();
+        return 0;
+    }
+
+    // POLL_SRC_VBLANK: ready once a vertical blank has passed since the
+    // last flip reached the screen; `seq` moves with every blank
+    static uint32_t PollVblank(uint32_t& seq) {
+        if (Drivers::Graphics::IntelGPU::GetScanoutCount() < 2) return POLL_ERR;
+        seq = Drivers::Graphics::IntelGPU::GetVblankCount();
+        return seq != g_fbFlipVblank ? POLL_IN : 0;
+    }
+
+    // Load `image` into the hardware cursor plane at the current mouse
+    // position, or hide the cursor if it is null. Returns -1 if there is
+    // no cursor plane (or the image does not fit it).
+    static int64_t Sys_CursorSet(const CursorImage* image) {
+        if (!Drivers::Graphics::IntelGPU::HasCursorPlane()) return -1;
+        if (image == nullptr) {
+            Drivers::Graphics::IntelGPU::SetCursorImage(nullptr, 0, 0, 0, 0);
+            return 0;
+        }
+
+        if (!Drivers::Graphics::IntelGPU::SetCursorImage(image->pixels, image->width, image->height,
+                                                          image->hotX, image->hotY)) {
+            return -1;
+        }
+        Drivers::Graphics::IntelGPU::MoveCursor(Drivers::PS2::Mouse::GetX(), Drivers::PS2::Mouse::GetY());
+        return 0;
     }
 
     static uint64_t Sys_TermSize() {
@@ -0,0 +1,36 @@
+/*
+    * Handles.hpp
+    * Which process opened each VFS handle
+    * Copyright (c) 2026 Daniel Hammer
+*/
+
+#pragma once
+#include <Fs/Vfs.hpp>
+#include <Sched/Scheduler.hpp>
+
+namespace Montauk {
+
+    // VFS handles are global; this only records who opened them through
+    // a syscall, for SYS_PROCLIST. PID + 1 of the opener, 0 if none.
+    inline int g_handleOwner[Fs::Vfs::MaxHandles] = {};
+
+    // Pass through the result of a VfsOpen/VfsCreate made for the caller
+    static int NoteHandleOpened(int handle) {
+        if (handle >= 0 && handle < Fs::Vfs::MaxHandles) {
+            g_handleOwner[handle] = Sched::GetCurrentPid() + 1;
+        }
+        return handle;
+    }
+
+    static void NoteHandleClosed(int handle) {
+        if (handle >= 0 && handle < Fs::Vfs::MaxHandles) g_handleOwner[handle] = 0;
+    }
+
+    static int CountHandles(int pid) {
+        int count = 0;
+        for (int i = 0; i < Fs::Vfs::MaxHandles; i++) {
+            if (g_handleOwner[i] == pid + 1) count++;
+        }
+        return count;
+    }
+};
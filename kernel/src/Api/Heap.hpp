@@ -7,76 +7,244 @@
 #include <cstdint>
 #include <Sched/Scheduler.hpp>
 #include <Memory/Paging.hpp>
+#include <Memory/Tlb.hpp>
 #include <Memory/HHDM.hpp>
 #include <Memory/PageFrameAllocator.hpp>
+#include <Memory/MemObject.hpp>
+#include <Memory/Zram.hpp>
+#include <Memory/Dma.hpp>
+#include <Libraries/Memory.hpp>
 
 namespace Montauk {
 
-    // Per-process heap allocation tracking (separate from Process struct to avoid bloating it)
-    struct HeapAlloc {
-        uint64_t va;
-        uint64_t numPages;
-    };
+    // Heap regions of a process live in its leader's heapVmas tree. Freed
+    // regions become holes that later allocations reuse; heapNext is only
+    // the bump frontier above the highest region.
 
-    static constexpr int MaxHeapAllocs = 512;
-
-    static HeapAlloc g_heapAllocs[Sched::MaxProcesses][MaxHeapAllocs];
-    static int g_heapAllocCount[Sched::MaxProcesses];
-
-    // Get the process table slot index for the current process
+    // Get the process table slot index for the current process (its
+    // thread group leader's slot, so all threads share one heap record)
     static int GetCurrentSlot() {
         auto* proc = Sched::GetCurrentProcessPtr();
         if (proc == nullptr) return -1;
-        // Process slot index = pointer offset from slot 0
-        auto* slot0 = Sched::GetProcessSlot(0);
-        return (int)(proc - slot0);
+        return proc->leaderSlot;
+    }
+
+    static constexpr uint64_t HugePageSize = Memory::VMM::Paging::HugePageSize;
+
+    // Reserve `numPages` of heap address space and record it as a region,
+    // backed by `object` if given (the region takes over that reference).
+    // Returns the start address, or 0 when out of address space or nodes.
+    // vmLock must be held.
+    static uint64_t ReserveRegionLocked(Sched::Process* proc, uint64_t numPages,
+                                        Memory::MemObject* object = nullptr, uint64_t objectPage = 0) {
+        static constexpr uint64_t USER_SPACE_END = 0x0000800000000000ULL;
+        uint64_t size = numPages * 0x1000;
+
+        // Reuse a freed hole if one fits, otherwise extend the frontier
+        uint64_t userVa = proc->heapVmas.TakeHole(numPages);
+        bool fromFrontier = userVa == 0;
+        if (fromFrontier) {
+            userVa = proc->heapNext;
+
+            // Start large regions on a 2 MiB boundary so the fault handler
+            // can back them with huge pages; the gap stays usable as a hole
+            if (size >= HugePageSize) userVa = (userVa + HugePageSize - 1) & ~(HugePageSize - 1);
+
+            // Ensure allocation stays within user address space
+            if (userVa + size < userVa || userVa + size > USER_SPACE_END) return 0;
+        }
+
+        // An untracked region could never be faulted in
+        if (!proc->heapVmas.Insert(userVa, numPages, object, objectPage)) {
+            if (!fromFrontier) {
+                uint64_t start = userVa, pages = numPages;
+                proc->heapVmas.AddHole(start, pages);
+            }
+            return 0;
+        }
+
+        if (fromFrontier) {
+            if (userVa != proc->heapNext) {
+                uint64_t gap = proc->heapNext, gapPages = (userVa - proc->heapNext) / 0x1000;
+                proc->heapVmas.AddHole(gap, gapPages);
+            }
+            proc->heapNext = userVa + size;
+        }
+        return userVa;
     }
 
+    // Heap regions are reserve-only: Sys_Alloc hands out address space, and
+    // each page is allocated and mapped on first touch by HandleHeapFault.
     static uint64_t Sys_Alloc(uint64_t size) {
         auto* proc = Sched::GetCurrentProcessPtr();
         if (proc == nullptr) return 0;
+        int slot = GetCurrentSlot();
+        if (slot < 0) return 0;
 
         // Guard against overflow before rounding
-        static constexpr uint64_t USER_SPACE_END = 0x0000800000000000ULL;
         if (size > 0xFFFFFFFFFFFF0000ULL) return 0;
 
         // Round up to page boundary
         size = (size + 0xFFF) & ~0xFFFULL;
         if (size == 0) size = 0x1000;
+        uint64_t numPages = size / 0x1000;
 
-        uint64_t userVa = proc->heapNext;
+        // Threads of the process share the heap map and the page tables
+        proc->vmLock.Acquire();
 
-        // Ensure allocation stays within user address space
-        if (userVa + size < userVa || userVa + size > USER_SPACE_END) return 0;
+        uint64_t userVa = ReserveRegionLocked(proc, numPages);
+        if (userVa != 0) proc->reservedPages += numPages;
 
-        uint64_t numPages = size / 0x1000;
+        proc->vmLock.Release();
+        return userVa;
+    }
 
-        // Allocate physical pages and map them into the process
-        for (uint64_t i = 0; i < numPages; i++) {
-            void* page = Memory::g_pfa->AllocateZeroed();
-            if (page == nullptr) return 0;
-            uint64_t physAddr = Memory::SubHHDM((uint64_t)page);
-            if (!Memory::VMM::Paging::MapUserIn(proc->pml4Phys, physAddr, userVa + i * 0x1000)) return 0;
-        }
+    // Back the 2 MiB window at `hugeVa` with one zeroed huge page. Fails if
+    // physical memory is too fragmented or the window already has 4 KiB
+    // pages mapped. vmLock must be held.
+    static bool MapHugeHeapPage(Sched::Process* proc, uint64_t hugeVa) {
+        void* block = Memory::g_pfa->AllocateHuge();
+        if (block == nullptr) return false;
 
-        proc->heapNext += size;
+        memset(block, 0, HugePageSize);
+        if (!Memory::VMM::Paging::MapUserHugeIn(proc->pml4Phys, Memory::SubHHDM((uint64_t)block), hugeVa)) {
+            Memory::g_pfa->Free(block, (int)(HugePageSize / 0x1000));
+            return false;
+        }
+        proc->allocatedPages += HugePageSize / 0x1000;
+        return true;
+    }
 
-        // Track the allocation so Sys_Free can release it
+    // Not-present page fault at user address `addr` in the current process.
+    // If it lies in one of its heap regions, back the page with a zeroed
+    // frame and return true so the faulting access is retried. Where the
+    // region covers the whole surrounding 2 MiB window, a huge page is
+    // tried first. Mapped objects (see Mmap.hpp) map the object's page,
+    // and a page swapped out by Zram is decompressed into a fresh frame.
+    static bool HandleHeapFault(uint64_t addr) {
+        auto* proc = Sched::GetCurrentProcessPtr();
         int slot = GetCurrentSlot();
-        if (slot >= 0) Sched::g_allocatedPages[slot] += numPages;
-        if (slot >= 0 && g_heapAllocCount[slot] < MaxHeapAllocs) {
-            g_heapAllocs[slot][g_heapAllocCount[slot]++] = { userVa, numPages };
+        if (proc == nullptr || slot < 0 || addr < Sched::UserHeapBase) return false;
+
+        uint64_t pageVa = addr & ~0xFFFULL;
+        proc->vmLock.Acquire();
+
+        auto* region = proc->heapVmas.Find(pageVa);
+        if (region == nullptr) {
+            proc->vmLock.Release();
+            return false;
         }
 
-        return userVa;
+        // Another thread of the process may have faulted it in first
+        if (Memory::VMM::Paging::GetUserPhysAddr(proc->pml4Phys, pageVa) != 0) {
+            proc->vmLock.Release();
+            return true;
+        }
+
+        // The frame belongs to the object and is not charged to the process
+        if (region->object) {
+            uint64_t index = region->objectPage + (pageVa - region->start) / 0x1000;
+            uint64_t phys = region->object->PageAt(index);
+            bool mapped = phys != 0 && Memory::VMM::Paging::MapUserInShared(proc->pml4Phys, phys, pageVa,
+                                                                            region->object->IsWritable());
+            proc->vmLock.Release();
+            return mapped;
+        }
+
+        uint64_t swapSlot = Memory::VMM::Paging::GetUserSwapSlot(proc->pml4Phys, pageVa);
+        if (swapSlot != 0) {
+            void* page = Memory::g_pfa->Allocate();
+            bool mapped = page != nullptr && Memory::Zram::Load(swapSlot, page)
+                && Memory::VMM::Paging::MapUserIn(proc->pml4Phys, Memory::SubHHDM((uint64_t)page), pageVa);
+            if (mapped) {
+                Memory::Zram::Release(swapSlot);
+                proc->allocatedPages++;
+            } else if (page != nullptr) {
+                Memory::g_pfa->Free(page);
+            }
+            proc->vmLock.Release();
+            return mapped;
+        }
+
+        uint64_t hugeVa = pageVa & ~(HugePageSize - 1);
+        if (hugeVa >= region->start && hugeVa + HugePageSize <= region->start + region->pages * 0x1000
+            && MapHugeHeapPage(proc, hugeVa)) {
+            proc->vmLock.Release();
+            return true;
+        }
+
+        void* page = Memory::g_pfa->AllocateZeroed();
+        if (page == nullptr) {
+            proc->vmLock.Release();
+            return false;
+        }
+        if (!Memory::VMM::Paging::MapUserIn(proc->pml4Phys, Memory::SubHHDM((uint64_t)page), pageVa)) {
+            Memory::g_pfa->Free(page);
+            proc->vmLock.Release();
+            return false;
+        }
+        proc->allocatedPages++;
+
+        proc->vmLock.Release();
+        return true;
     }
 
-    // Reset heap allocation tracking for a process slot.
-    // The actual physical pages are freed by Paging::FreeUserHalf() during process cleanup.
+    // Reset heap accounting for a process slot. The region map is freed
+    // with the process slot, and the physical pages by
+    // Paging::FreeUserHalf() during process cleanup.
     static void CleanupHeapForSlot(int slot, uint64_t /*pml4Phys*/) {
-        if (slot < 0 || slot >= Sched::MaxProcesses) return;
-        g_heapAllocCount[slot] = 0;
-        Sched::g_allocatedPages[slot] = 0;
+        auto* proc = Sched::GetProcessSlot(slot);
+        if (proc == nullptr) return;
+        proc->allocatedPages = 0;
+        proc->reservedPages = 0;
+    }
+
+    // Unmap and free the touched pages of an anonymous region.
+    // vmLock must be held.
+    static void UnmapHeapPagesLocked(Sched::Process* proc, uint64_t addr, uint64_t numPages) {
+        // Unmap the pages that were touched; the batch frees them once no
+        // other thread's CPU can still reach them. Huge pages only ever
+        // cover windows entirely inside the region.
+        uint64_t resident = 0;
+        uint64_t end = addr + numPages * 0x1000;
+        Memory::VMM::Tlb::Batch batch(proc->pml4Phys);
+        for (uint64_t pageVa = addr; pageVa < end; pageVa += 0x1000) {
+            if ((pageVa & (HugePageSize - 1)) == 0 && Memory::VMM::Paging::IsUserHugePage(proc->pml4Phys, pageVa)) {
+                uint64_t physAddr = Memory::VMM::Paging::GetPhysAddr(proc->pml4Phys, pageVa);
+                Memory::VMM::Paging::UnmapUserIn(proc->pml4Phys, pageVa, batch);
+                batch.FreeAfter((void*)Memory::HHDM(physAddr), (int)(HugePageSize / 0x1000));
+                resident += HugePageSize / 0x1000;
+                pageVa += HugePageSize - 0x1000;
+                continue;
+            }
+
+            // Swapped out: only the compressed copy is left to drop
+            uint64_t swapSlot = Memory::VMM::Paging::DropUserSwapEntry(proc->pml4Phys, pageVa);
+            if (swapSlot != 0) {
+                Memory::Zram::Release(swapSlot);
+                continue;
+            }
+
+            uint64_t physAddr = Memory::VMM::Paging::GetPhysAddr(proc->pml4Phys, pageVa);
+            if (physAddr != 0) {
+                Memory::VMM::Paging::UnmapUserIn(proc->pml4Phys, pageVa, batch);
+                batch.FreeAfter((void*)Memory::HHDM(physAddr));
+                resident++;
+            }
+        }
+        batch.Flush();
+
+        proc->allocatedPages -= resident;
+        proc->reservedPages -= numPages;
+    }
+
+    // Wait until no device is using pages of the process (see Dma.hpp).
+    // A thread killed mid-transfer never unpins, so give up once the
+    // whole process is going away. vmLock must be held.
+    static void WaitForDmaLocked(Sched::Process* proc, int slot) {
+        while (Memory::Dma::IsPinned(slot) && !proc->groupExiting) {
+            asm volatile("pause");
+        }
     }
 
     static void Sys_Free(uint64_t addr) {
@@ -86,33 +254,37 @@ namespace Montauk {
         int slot = GetCurrentSlot();
         if (slot < 0) return;
 
-        // Find the allocation record matching this address
-        int idx = -1;
-        for (int i = 0; i < g_heapAllocCount[slot]; i++) {
-            if (g_heapAllocs[slot][i].va == addr) {
-                idx = i;
-                break;
-            }
-        }
-        if (idx < 0) return;  // Unknown address — ignore
+        proc->vmLock.Acquire();
+        WaitForDmaLocked(proc, slot);
 
-        uint64_t va = g_heapAllocs[slot][idx].va;
-        uint64_t numPages = g_heapAllocs[slot][idx].numPages;
+        Memory::MemObject* object = nullptr;
+        uint64_t numPages = proc->heapVmas.Remove(addr, &object);
+        if (numPages == 0) {  // Unknown address — ignore
+            proc->vmLock.Release();
+            return;
+        }
 
-        // Free physical pages in bulk and unmap virtual addresses
-        for (uint64_t i = 0; i < numPages; i++) {
-            uint64_t pageVa = va + i * 0x1000;
-            uint64_t physAddr = Memory::VMM::Paging::GetPhysAddr(proc->pml4Phys, pageVa);
-            if (physAddr != 0) {
-                Memory::g_pfa->Free((void*)Memory::HHDM(physAddr));
+        // A mapping only drops its view; the object owns the frames
+        if (object) {
+            uint64_t end = addr + numPages * 0x1000;
+            Memory::VMM::Tlb::Batch batch(proc->pml4Phys);
+            for (uint64_t pageVa = addr; pageVa < end; pageVa += 0x1000) {
+                Memory::VMM::Paging::UnmapUserIn(proc->pml4Phys, pageVa, batch);
             }
-            Memory::VMM::Paging::UnmapUserIn(proc->pml4Phys, pageVa);
+            batch.Flush();
+            object->Release();
+        } else {
+            UnmapHeapPagesLocked(proc, addr, numPages);
         }
 
-        Sched::g_allocatedPages[slot] -= numPages;
+        // Make the range reusable. A hole reaching the frontier folds back
+        // into it, so the top of the heap can shrink again.
+        uint64_t start = addr, pages = numPages;
+        if (proc->heapVmas.AddHole(start, pages) && start + pages * 0x1000 == proc->heapNext) {
+            proc->heapVmas.RemoveHole(start);
+            proc->heapNext = start;
+        }
 
-        // Remove tracking entry by swapping with the last element
-        g_heapAllocs[slot][idx] = g_heapAllocs[slot][g_heapAllocCount[slot] - 1];
-        g_heapAllocCount[slot]--;
+        proc->vmLock.Release();
     }
 };
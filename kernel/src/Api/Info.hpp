@@ -6,6 +6,7 @@
 
 #pragma once
 #include <Sched/Scheduler.hpp>
+#include <Timekeeping/ApicTimer.hpp>
 
 #include "Syscall.hpp"
 
@@ -24,5 +25,7 @@ namespace Montauk {
 
         outInfo->apiVersion = 2;
         outInfo->maxProcesses = Sched::MaxProcesses;
+        outInfo->tscPerUs = Timekeeping::TscPerMicrosecond();
+        outInfo->cpuCount = (uint32_t)__builtin_popcountll(Sched::OnlineCpuMask());
     }
 };
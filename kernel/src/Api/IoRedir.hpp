@@ -15,7 +15,13 @@
 
 namespace Montauk {
 
-    static int Sys_SpawnRedir(const char* path, const char* args) {
+    // `outBufSize` is the size of the child's output ring, rounded up to
+    // whole pages; 0 picks the default
+    static int Sys_SpawnRedir(const char* path, const char* args, uint32_t outBufSize) {
+        if (outBufSize == 0) outBufSize = Sched::Process::OutBufDefaultSize;
+        if (outBufSize > Sched::Process::OutBufMaxSize) outBufSize = Sched::Process::OutBufMaxSize;
+        outBufSize = (outBufSize + 0xFFF) & ~0xFFFu;
+
         char resolved[256];
         if (!ResolveProcessPath(path, resolved, sizeof(resolved))) return -1;
 
@@ -26,11 +32,12 @@ namespace Montauk {
         if (child == nullptr) return -1;
 
         // Allocate ring buffers
-        void* outPage = Memory::g_pfa->AllocateZeroed();
+        void* outPages = Memory::g_pfa->AllocateContiguous((int)(outBufSize / 0x1000));
         void* inPage = Memory::g_pfa->AllocateZeroed();
-        if (!outPage || !inPage) return -1;
+        if (!outPages || !inPage) return -1;
 
-        child->outBuf = (uint8_t*)outPage;
+        child->outBuf = (uint8_t*)outPages;
+        child->outBufSize = outBufSize;
         child->inBuf = (uint8_t*)inPage;
         child->outHead = 0;
         child->outTail = 0;
@@ -47,7 +54,7 @@ namespace Montauk {
     static int Sys_ChildIoRead(int childPid, char* buf, int maxLen) {
         auto* child = Sched::GetProcessByPid(childPid);
         if (child == nullptr || !child->redirected || !child->outBuf) return -1;
-        return RingRead(child->outBuf, child->outHead, child->outTail, Sched::Process::IoBufSize, (uint8_t*)buf, maxLen);
+        return RingRead(child->outBuf, child->outHead, child->outTail, child->outBufSize, (uint8_t*)buf, maxLen);
     }
 
     static int Sys_ChildIoWrite(int childPid, const char* data, int len) {
@@ -56,6 +63,8 @@ namespace Montauk {
         for (int i = 0; i < len; i++) {
             RingWrite(child->inBuf, child->inHead, child->inTail, Sched::Process::IoBufSize, (uint8_t)data[i]);
         }
+        Sched::BoostInput(childPid);
+        Sched::NotifyReady(&child->inHead);
         return len;
     }
 
@@ -65,6 +74,8 @@ namespace Montauk {
         if (child == nullptr || !child->redirected) return -1;
         child->keyBuf[child->keyHead] = *key;
         child->keyHead = (child->keyHead + 1) % 64;
+        Sched::BoostInput(childPid);
+        Sched::NotifyReady(&child->inHead);
         return 0;
     }
 
@@ -0,0 +1,261 @@
+/*
+    * IoRing.hpp
+    * SYS_IORING_SETUP, SYS_IORING_ENTER syscalls
+    * Copyright (c) 2026 Daniel Hammer
+*/
+
+#pragma once
+#include <cstdint>
+#include <Sched/Scheduler.hpp>
+#include <Memory/MemObject.hpp>
+#include <Memory/HHDM.hpp>
+#include <Fs/Vfs.hpp>
+#include "Handles.hpp"
+#include "Path.hpp"
+
+namespace Montauk {
+
+    // Each ring is a MemObject mapped into the process and served by a
+    // kernel thread of that process, which takes submissions in order and
+    // runs them through the VFS. The application never waits for the disk
+    // unless it asks to in SYS_IORING_ENTER. The worker reaches the ring
+    // through its kernel alias, so unmapping it cannot fault the kernel;
+    // data buffers and paths are user addresses in the shared address space.
+    // Rings last as long as their process.
+
+    static constexpr int MaxIoRings = 32;
+    static constexpr int MaxIoRingsPerProcess = 4;
+    static constexpr uint32_t IoSqeSize = sizeof(IoSqe);
+    static constexpr uint32_t IoCqeSize = sizeof(IoCqe);
+    static constexpr int IoRingMaxPages =
+        1 + (int)((IORING_MAX_ENTRIES * (IoSqeSize + IoCqeSize) + 0xFFF) / 0x1000);
+
+    static_assert(0x1000 % IoSqeSize == 0 && 0x1000 % IoCqeSize == 0,
+                  "ring entries must not straddle pages");
+
+    struct IoRing {
+        bool used;
+        int tgid;                          // Owning process
+        int workerTid;
+        uint64_t userVa;                   // Where the process sees the ring
+        uint32_t entries;
+        Memory::MemObject* object;         // The kernel's own reference
+        uint8_t* pages[IoRingMaxPages];    // Kernel aliases of the ring pages
+        volatile uint32_t doorbell;        // Bumped by SYS_IORING_ENTER
+
+        uint8_t* At(uint64_t offset) { return pages[offset / 0x1000] + offset % 0x1000; }
+        IoRingHeader* Header() { return (IoRingHeader*)pages[0]; }
+    };
+
+    static IoRing g_ioRings[MaxIoRings];
+    static kcp::Mutex g_ioRingLock;
+
+    // Run one submission as the matching synchronous syscall would
+    static int64_t IoRingExecute(const IoSqe& sqe) {
+        static constexpr uint64_t USER_SPACE_END = 0x0000800000000000ULL;
+        switch (sqe.op) {
+            case IORING_OP_NOP:
+                return 0;
+            case IORING_OP_READ:
+            case IORING_OP_WRITE: {
+                if (sqe.addr == 0 || sqe.len > 0x7FFFFFFF || sqe.addr + sqe.len > USER_SPACE_END) return -1;
+                if (sqe.op == IORING_OP_READ) {
+                    return Fs::Vfs::VfsRead(sqe.handle, (uint8_t*)sqe.addr, sqe.offset, sqe.len);
+                }
+                return Fs::Vfs::VfsWrite(sqe.handle, (const uint8_t*)sqe.addr, sqe.offset, sqe.len);
+            }
+            case IORING_OP_OPEN: {
+                if (sqe.addr == 0 || sqe.addr + 256 > USER_SPACE_END) return -1;
+                char resolved[256];
+                if (!ResolveProcessPath((const char*)sqe.addr, resolved, sizeof(resolved))) return -1;
+                return NoteHandleOpened(Fs::Vfs::VfsOpen(resolved));
+            }
+            case IORING_OP_CLOSE:
+                NoteHandleClosed(sqe.handle);
+                Fs::Vfs::VfsClose(sqe.handle);
+                return 0;
+            default:
+                return -1;
+        }
+    }
+
+    // Body of a ring's kernel thread; `arg` is the ring's table index.
+    // Sleeps on the doorbell whenever there is nothing to submit or no
+    // room to complete; the process's exit kills it.
+    static void IoRingWorker(uint64_t arg) {
+        IoRing& ring = g_ioRings[arg];
+        IoRingHeader* hdr = ring.Header();
+        uint32_t mask = ring.entries - 1;
+        uint64_t sqOffset = hdr->sqOffset, cqOffset = hdr->cqOffset;
+        uint64_t cqTailVa = ring.userVa + __builtin_offsetof(IoRingHeader, cqTail);
+
+        for (;;) {
+            uint32_t bell = __atomic_load_n(&ring.doorbell, __ATOMIC_ACQUIRE);
+            bool progress = false;
+
+            for (;;) {
+                uint32_t head = hdr->sqHead;
+                if (head == __atomic_load_n(&hdr->sqTail, __ATOMIC_ACQUIRE)) break;
+
+                uint32_t cqTail = hdr->cqTail;
+                if (cqTail - __atomic_load_n(&hdr->cqHead, __ATOMIC_ACQUIRE) >= ring.entries) break;
+
+                // Copy the entry out and hand the slot back before running it
+                IoSqe sqe;
+                memcpy(&sqe, ring.At(sqOffset + (uint64_t)(head & mask) * IoSqeSize), sizeof(sqe));
+                __atomic_store_n(&hdr->sqHead, head + 1, __ATOMIC_RELEASE);
+
+                auto* cqe = (IoCqe*)ring.At(cqOffset + (uint64_t)(cqTail & mask) * IoCqeSize);
+                cqe->userData = sqe.userData;
+                cqe->result = IoRingExecute(sqe);
+                __atomic_store_n(&hdr->cqTail, cqTail + 1, __ATOMIC_RELEASE);
+                Sched::FutexWake(cqTailVa, 0x7FFFFFFF);
+                progress = true;
+            }
+
+            if (!progress) Sched::WaitOnAddress(&ring.doorbell, bell);
+        }
+    }
+
+    // Free the table slots of processes that have exited. g_ioRingLock held.
+    static void ReapIoRingsLocked() {
+        for (int i = 0; i < MaxIoRings; i++) {
+            IoRing& ring = g_ioRings[i];
+            if (!ring.used || ring.object == nullptr) continue;
+            if (Sched::IsAlive(ring.tgid) || Sched::IsAlive(ring.workerTid)) continue;
+            ring.object->Release();
+            ring.object = nullptr;
+            ring.used = false;
+        }
+    }
+
+    // Create a ring of `entries` (rounded up to a power of two, at most
+    // IORING_MAX_ENTRIES) submission and completion slots with its worker.
+    // Returns the ring's address, or 0.
+    static uint64_t Sys_IoRingSetup(uint32_t entries) {
+        auto* proc = Sched::GetCurrentProcessPtr();
+        if (proc == nullptr || entries == 0 || entries > IORING_MAX_ENTRIES) return 0;
+
+        uint32_t rounded = 1;
+        while (rounded < entries) rounded <<= 1;
+        entries = rounded;
+
+        uint32_t sqOffset = 0x1000;
+        uint32_t cqOffset = sqOffset + entries * IoSqeSize;
+        uint64_t size = cqOffset + (uint64_t)entries * IoCqeSize;
+        uint64_t pages = (size + 0xFFF) / 0x1000;
+
+        // Claim a slot; `object` stays null until the ring is complete
+        g_ioRingLock.Acquire();
+        ReapIoRingsLocked();
+        int slot = -1, owned = 0;
+        for (int i = 0; i < MaxIoRings; i++) {
+            if (!g_ioRings[i].used) {
+                if (slot < 0) slot = i;
+            } else if (g_ioRings[i].tgid == proc->pid) {
+                owned++;
+            }
+        }
+        if (slot < 0 || owned >= MaxIoRingsPerProcess) {
+            g_ioRingLock.Release();
+            return 0;
+        }
+        IoRing& ring = g_ioRings[slot];
+        ring.used = true;
+        ring.tgid = proc->pid;
+        ring.object = nullptr;
+        g_ioRingLock.Release();
+
+        auto releaseSlot = [&]() {
+            g_ioRingLock.Acquire();
+            ring.used = false;
+            g_ioRingLock.Release();
+        };
+
+        Memory::MemObject* object = Memory::MemObject::CreateAnonymous(size);
+        if (object == nullptr) {
+            releaseSlot();
+            return 0;
+        }
+
+        // Back every page now: the worker must never fail to reach the ring
+        for (uint64_t i = 0; i < pages; i++) {
+            uint64_t phys = object->PageAt(i);
+            if (phys == 0) {
+                object->Release();
+                releaseSlot();
+                return 0;
+            }
+            ring.pages[i] = (uint8_t*)Memory::HHDM(phys);
+        }
+
+        IoRingHeader* hdr = ring.Header();
+        hdr->entries = entries;
+        hdr->sqOffset = sqOffset;
+        hdr->cqOffset = cqOffset;
+        ring.entries = entries;
+        ring.doorbell = 0;
+
+        // The mapping takes a reference of its own
+        object->Retain();
+        uint64_t userVa = MapObject(object, 0, pages);
+        if (userVa == 0) {
+            object->Release();
+            releaseSlot();
+            return 0;
+        }
+        ring.userVa = userVa;
+
+        int tid = Sched::CreateKernelThread(IoRingWorker, (uint64_t)slot);
+        if (tid < 0) {
+            Sys_Free(userVa);
+            object->Release();
+            releaseSlot();
+            return 0;
+        }
+
+        g_ioRingLock.Acquire();
+        ring.workerTid = tid;
+        ring.object = object;
+        g_ioRingLock.Release();
+        return userVa;
+    }
+
+    static IoRing* FindIoRing(uint64_t userVa) {
+        auto* proc = Sched::GetCurrentProcessPtr();
+        if (proc == nullptr) return nullptr;
+
+        IoRing* found = nullptr;
+        g_ioRingLock.Acquire();
+        for (int i = 0; i < MaxIoRings && found == nullptr; i++) {
+            IoRing& ring = g_ioRings[i];
+            if (ring.used && ring.object && ring.tgid == proc->pid && ring.userVa == userVa) found = &ring;
+        }
+        g_ioRingLock.Release();
+        return found;
+    }
+
+    // Tell the worker about new submissions (or freed completion slots),
+    // then wait until at least `minComplete` completions are unconsumed,
+    // giving up after `timeoutMs` if non-zero. Returns the number of
+    // completions ready, or -1 for an unknown ring.
+    static int64_t Sys_IoRingEnter(uint64_t userVa, uint32_t minComplete, uint64_t timeoutMs) {
+        IoRing* ring = FindIoRing(userVa);
+        if (ring == nullptr) return -1;
+        if (minComplete > ring->entries) minComplete = ring->entries;
+
+        __atomic_add_fetch(&ring->doorbell, 1, __ATOMIC_RELEASE);
+        Sched::WakeAddress(&ring->doorbell, 1);
+
+        IoRingHeader* hdr = ring->Header();
+        uint64_t cqTailVa = userVa + __builtin_offsetof(IoRingHeader, cqTail);
+        for (;;) {
+            uint32_t tail = __atomic_load_n(&hdr->cqTail, __ATOMIC_ACQUIRE);
+            uint32_t ready = tail - hdr->cqHead;
+            if (ready >= minComplete) return ready;
+            if (Sched::FutexWait(cqTailVa, &hdr->cqTail, tail, timeoutMs) == 1) {
+                return __atomic_load_n(&hdr->cqTail, __ATOMIC_ACQUIRE) - hdr->cqHead;
+            }
+        }
+    }
+};
@@ -9,6 +9,7 @@
 #include <Drivers/PS2/Keyboard.hpp>
 
 #include "Common.hpp"
+#include "Pipe.hpp"
 
 namespace Montauk {
     static bool Sys_IsKeyAvailable() {
@@ -44,8 +45,13 @@ namespace Montauk {
         outEvent->alt      = k.Alt;
     }
 
-    static char Sys_GetChar() {
+    // A byte of stdin; -1 once a stdin pipe has nothing more to give
+    static int Sys_GetChar() {
         auto* proc = Sched::GetCurrentProcessPtr();
+        if (proc && proc->stdinPipe > 0) {
+            uint8_t c;
+            return Pipe::Read(proc->stdinPipe, proc->pid, &c, 1) == 1 ? c : -1;
+        }
         if (proc && proc->redirected) {
             auto* target = GetRedirTarget(proc);
             if (target) {
@@ -53,14 +59,14 @@ namespace Montauk {
                     if (target->inBuf && target->inTail != target->inHead) {
                         uint8_t c = target->inBuf[target->inTail];
                         target->inTail = (target->inTail + 1) % Sched::Process::IoBufSize;
-                        return (char)c;
+                        return c;
                     }
 
                     if (target->keyTail != target->keyHead) {
                         auto ev = target->keyBuf[target->keyTail];
                         target->keyTail = (target->keyTail + 1) % 64;
                         if (ev.pressed && ev.ascii != 0) {
-                            return ev.ascii;
+                            return (uint8_t)ev.ascii;
                         }
                     }
 
@@ -68,6 +74,6 @@ namespace Montauk {
                 }
             }
         }
-        return Drivers::PS2::Keyboard::GetChar();
+        return (uint8_t)Drivers::PS2::Keyboard::GetChar();
     }
 };
@@ -0,0 +1,45 @@
+/*
+    * LockStat.hpp
+    * SYS_LOCKSTAT syscall
+    * Copyright (c) 2026 Daniel Hammer
+*/
+
+#pragma once
+#include <cstdint>
+#include <CppLib/Spinlock.hpp>
+#include <Timekeeping/ApicTimer.hpp>
+
+#include "Syscall.hpp"
+
+namespace Montauk {
+
+    static uint64_t TscToNs(uint64_t tsc, uint64_t tscPerUs) {
+        if (tscPerUs == 0) return 0;
+        return tsc / tscPerUs * 1000 + tsc % tscPerUs * 1000 / tscPerUs;
+    }
+
+    // Copy the counters of up to `max` named locks into `buf`; a nonzero
+    // `reset` zeroes them once copied. Locks nobody has taken yet are
+    // not listed. Returns the number of entries written.
+    static int64_t Sys_LockStat(LockStatInfo* buf, int max, int reset) {
+        if (max <= 0) return 0;
+        uint64_t tscPerUs = Timekeeping::TscPerMicrosecond();
+
+        int count = 0;
+        for (kcp::LockStat* stat = kcp::LockStatList(); stat != nullptr && count < max; stat = stat->next) {
+            LockStatInfo& info = buf[count++];
+            int i = 0;
+            for (; stat->name[i] && i < (int)sizeof(info.name) - 1; i++) info.name[i] = stat->name[i];
+            info.name[i] = '\0';
+
+            info.acquisitions = stat->acquisitions.load(std::memory_order_relaxed);
+            info.contended    = stat->contended.load(std::memory_order_relaxed);
+            info.spinNs       = TscToNs(stat->spinTsc.load(std::memory_order_relaxed), tscPerUs);
+            info.maxSpinNs    = TscToNs(stat->maxSpinTsc.load(std::memory_order_relaxed), tscPerUs);
+            info.maxHoldNs    = TscToNs(stat->maxHoldTsc.load(std::memory_order_relaxed), tscPerUs);
+
+            if (reset) stat->Reset();
+        }
+        return count;
+    }
+};
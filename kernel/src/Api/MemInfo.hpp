@@ -6,6 +6,8 @@
 
 #pragma once
 #include <Memory/PageFrameAllocator.hpp>
+#include <Memory/Zram.hpp>
+#include <Sched/Scheduler.hpp>
 
 #include "Syscall.hpp"
 
@@ -14,5 +16,17 @@ namespace Montauk {
     static void Sys_MemStats(MemStats* out) {
         if (out == nullptr) return;
         Memory::g_pfa->GetStats(out);
+
+        uint64_t resident = 0, reserved = 0;
+        int slots = Sched::SlotCount();
+        for (int i = 0; i < slots; i++) {
+            const Sched::Process* proc = Sched::GetProcessSlot(i);
+            resident += proc->allocatedPages;
+            reserved += proc->reservedPages;
+        }
+        out->heapResidentBytes = resident * 0x1000;
+        out->heapReservedBytes = reserved * 0x1000;
+        out->swappedBytes = Memory::Zram::SwappedBytes();
+        out->compressedBytes = Memory::Zram::CompressedBytes();
     }
 };
@@ -0,0 +1,89 @@
+/*
+    * Mmap.hpp
+    * SYS_MMAP, SYS_SHMOPEN, SYS_SHMUNLINK syscalls
+    * Copyright (c) 2026 Daniel Hammer
+*/
+
+#pragma once
+#include <cstdint>
+#include <Sched/Scheduler.hpp>
+#include <Memory/MemObject.hpp>
+#include "Path.hpp"
+
+namespace Montauk {
+
+    // Mappings are heap regions backed by a MemObject (Heap.hpp must be
+    // included first). Nothing is mapped up front: HandleHeapFault maps the
+    // object's page on first touch, and SYS_FREE on the returned address
+    // unmaps the whole region.
+
+    // Reserve a region for `pages` pages of `object` from page `firstPage`.
+    // Consumes the caller's reference. Returns the address, or 0.
+    static uint64_t MapObject(Memory::MemObject* object, uint64_t firstPage, uint64_t pages) {
+        auto* proc = Sched::GetCurrentProcessPtr();
+        if (proc == nullptr) {
+            object->Release();
+            return 0;
+        }
+
+        proc->vmLock.Acquire();
+        uint64_t userVa = ReserveRegionLocked(proc, pages, object, firstPage);
+        proc->vmLock.Release();
+
+        if (userVa == 0) object->Release();
+        return userVa;
+    }
+
+    // Map `length` bytes of a file read-only, starting at the page aligned
+    // `offset`. Length 0 maps up to the end of the file; longer requests
+    // are clipped to it. Every process mapping the same file shares the
+    // page cache, so e.g. fonts are read from disk once.
+    static uint64_t Sys_MMap(const char* path, uint64_t offset, uint64_t length) {
+        if (offset % 0x1000 != 0) return 0;
+
+        char resolved[256];
+        if (!ResolveProcessPath(path, resolved, sizeof(resolved))) return 0;
+
+        Memory::MemObject* object = Memory::MemObject::OpenFile(resolved);
+        if (object == nullptr) return 0;
+
+        uint64_t firstPage = offset / 0x1000;
+        if (firstPage >= object->Pages()) {
+            object->Release();
+            return 0;
+        }
+
+        uint64_t pages = object->Pages() - firstPage;
+        if (length != 0 && (length + 0xFFF) / 0x1000 < pages) pages = (length + 0xFFF) / 0x1000;
+        return MapObject(object, firstPage, pages);
+    }
+
+    // Map the shared memory object `name` read-write, creating it zeroed
+    // with `size` bytes if needed. Size 0 opens an existing object whole.
+    // With no name, a new object only this mapping refers to, for handing
+    // over in a channel message.
+    static uint64_t Sys_ShmOpen(const char* name, uint64_t size) {
+        if (name == nullptr) {
+            if (size == 0 || size > 0xFFFFFFFFFFFF0000ULL) return 0;
+            Memory::MemObject* object = Memory::MemObject::CreateAnonymous(size);
+            if (object == nullptr) return 0;
+            return MapObject(object, 0, object->Pages());
+        }
+
+        int len = 0;
+        while (name[len] && len < Memory::MemObject::MaxNameLength) len++;
+        if (len == 0 || len >= Memory::MemObject::MaxNameLength) return 0;
+        if (size > 0xFFFFFFFFFFFF0000ULL) return 0;
+
+        Memory::MemObject* object = Memory::MemObject::OpenShared(name, size);
+        if (object == nullptr) return 0;
+
+        uint64_t pages = size == 0 ? object->Pages() : (size + 0xFFF) / 0x1000;
+        return MapObject(object, 0, pages);
+    }
+
+    // Remove the name; existing mappings stay valid until freed
+    static int Sys_ShmUnlink(const char* name) {
+        return Memory::MemObject::Unlink(name) ? 0 : -1;
+    }
+};
@@ -1,11 +1,12 @@
 /*
     * Mouse.hpp
-    * SYS_MOUSESTATE, SYS_SETMOUSEBOUNDS syscalls
+    * SYS_MOUSESTATE, SYS_SETMOUSEBOUNDS, SYS_MOUSEEVENTS syscalls
     * Copyright (c) 2026 Daniel Hammer
 */
 
 #pragma once
 #include <Drivers/PS2/Mouse.hpp>
+#include <Libraries/Memory.hpp>
 
 #include "Syscall.hpp"
 
@@ -20,6 +21,20 @@ namespace Montauk {
         out->buttons = state.Buttons;
     }
 
+    static_assert(sizeof(MouseEvent) == sizeof(Drivers::PS2::Mouse::MouseEvent), "MouseEvent must match Mouse::MouseEvent");
+    static_assert(MOUSE_EVENTS_MAX == Drivers::PS2::Mouse::EventQueueSize);
+
+    // The queue is drained under a spinlock, where touching a user page
+    // that may fault is not allowed, so events are copied out after
+    static int Sys_MouseEvents(MouseEvent* out, int max) {
+        if (out == nullptr || max <= 0) return 0;
+        if (max > MOUSE_EVENTS_MAX) max = MOUSE_EVENTS_MAX;
+        Drivers::PS2::Mouse::MouseEvent events[MOUSE_EVENTS_MAX];
+        int count = Drivers::PS2::Mouse::ReadEvents(events, max);
+        if (count > 0) memcpy(out, events, (uint64_t)count * sizeof(MouseEvent));
+        return count;
+    }
+
     static void Sys_SetMouseBounds(int32_t maxX, int32_t maxY) {
         Drivers::PS2::Mouse::SetBounds(maxX, maxY);
     }
@@ -2,7 +2,9 @@
     * Net.hpp
     * Networking syscalls: SYS_PING, SYS_SOCKET, SYS_CONNECT, SYS_BIND,
     * SYS_LISTEN, SYS_ACCEPT, SYS_SEND, SYS_RECV, SYS_CLOSESOCK,
-    * SYS_SENDTO, SYS_RECVFROM, SYS_GETNETCFG, SYS_SETNETCFG, SYS_RESOLVE
+    * SYS_SENDTO, SYS_RECVFROM, SYS_GETNETCFG, SYS_SETNETCFG, SYS_RESOLVE,
+    * SYS_SETSOCKOPT, SYS_SENDFILE, SYS_RESOLVE_ASYNC, SYS_SENDMMSG,
+    * SYS_RECVMMSG, SYS_GETSOCKOPT
     * Copyright (c) 2026 Daniel Hammer
 */
 
@@ -14,6 +16,8 @@
 #include <Net/Dns.hpp>
 #include <Net/Socket.hpp>
 #include <Net/NetConfig.hpp>
+#include <Net/Loopback.hpp>
+#include <Fs/Vfs.hpp>
 #include <Drivers/Net/E1000.hpp>
 #include <Drivers/Net/E1000E.hpp>
 
@@ -29,6 +33,7 @@ namespace Montauk {
 
         Net::Icmp::ResetReply();
         Net::Icmp::SendEchoRequest(ipAddr, PING_ID, seq);
+        Net::Loopback::Poll();
 
         uint64_t start = Timekeeping::GetMilliseconds();
         while (!Net::Icmp::HasReply(PING_ID, seq)) {
@@ -43,12 +48,19 @@ namespace Montauk {
 
     // ---- Socket syscalls ----
 
+    // Calls that may have sent over loopback deliver it before returning,
+    // holding no connection lock (see Net::Loopback::Poll)
+    static int Delivered(int result) {
+        Net::Loopback::Poll();
+        return result;
+    }
+
     static int Sys_Socket(int type) {
         return Net::Socket::Create(type, Sched::GetCurrentPid());
     }
 
     static int Sys_Connect(int fd, uint32_t ip, uint16_t port) {
-        return Net::Socket::Connect(fd, ip, port, Sched::GetCurrentPid());
+        return Delivered(Net::Socket::Connect(fd, ip, port, Sched::GetCurrentPid()));
     }
 
     static int Sys_Bind(int fd, uint16_t port) {
@@ -60,29 +72,91 @@ namespace Montauk {
     }
 
     static int Sys_Accept(int fd) {
-        return Net::Socket::Accept(fd, Sched::GetCurrentPid());
+        return Delivered(Net::Socket::Accept(fd, Sched::GetCurrentPid()));
     }
 
     static int Sys_Send(int fd, const uint8_t* data, uint32_t len) {
-        return Net::Socket::Send(fd, data, len, Sched::GetCurrentPid());
+        return Delivered(Net::Socket::Send(fd, data, len, Sched::GetCurrentPid()));
+    }
+
+    // ---- sendfile ----
+
+    struct SendFileSource {
+        int      handle;
+        uint64_t offset;
+    };
+
+    // Reads the file straight into the TCP send buffer
+    static int ReadFileInto(void* context, uint8_t* dest, uint32_t offset, uint32_t length) {
+        auto* src = (SendFileSource*)context;
+        return Fs::Vfs::VfsRead(src->handle, dest, src->offset + offset, length);
+    }
+
+    // Send `length` bytes of an open file, starting at `offset`, on a
+    // connected TCP socket. Returns the bytes sent (short at end of file)
+    // or -1.
+    static int Sys_SendFile(int handle, int fd, uint64_t offset, uint32_t length) {
+        if (length == 0) return 0;
+        SendFileSource src = { handle, offset };
+        return Delivered(Net::Socket::SendFrom(fd, length, ReadFileInto, &src, Sched::GetCurrentPid()));
     }
 
     static int Sys_Recv(int fd, uint8_t* buf, uint32_t maxLen) {
-        return Net::Socket::Recv(fd, buf, maxLen, Sched::GetCurrentPid());
+        return Delivered(Net::Socket::Recv(fd, buf, maxLen, Sched::GetCurrentPid()));
+    }
+
+    static int Sys_SetSockOpt(int fd, int option, uint64_t value) {
+        return Net::Socket::SetOption(fd, option, value, Sched::GetCurrentPid());
     }
 
     static void Sys_CloseSock(int fd) {
         Net::Socket::Close(fd, Sched::GetCurrentPid());
+        Net::Loopback::Poll();
     }
 
     static int Sys_SendTo(int fd, const uint8_t* data, uint32_t len,
                           uint32_t destIp, uint16_t destPort) {
-        return Net::Socket::SendTo(fd, data, len, destIp, destPort, Sched::GetCurrentPid());
+        return Delivered(Net::Socket::SendTo(fd, data, len, destIp, destPort, Sched::GetCurrentPid()));
     }
 
     static int Sys_RecvFrom(int fd, uint8_t* buf, uint32_t maxLen,
                             uint32_t* srcIp, uint16_t* srcPort) {
-        return Net::Socket::RecvFrom(fd, buf, maxLen, srcIp, srcPort, Sched::GetCurrentPid());
+        return Delivered(Net::Socket::RecvFrom(fd, buf, maxLen, srcIp, srcPort, Sched::GetCurrentPid()));
+    }
+
+    // ---- Batched UDP ----
+
+    static_assert(sizeof(UdpMsg) == sizeof(Net::Socket::Datagram), "UdpMsg layout");
+
+    // Clamp the batch and check every payload buffer lies in user space.
+    // Returns the count to process, or -1.
+    static int CheckUdpMsgs(const UdpMsg* msgs, int count) {
+        static constexpr uint64_t USER_SPACE_END = 0x0000800000000000ULL;
+        if (count < 0) return -1;
+        if (count > Net::Socket::MAX_BATCH) count = Net::Socket::MAX_BATCH;
+        for (int i = 0; i < count; i++) {
+            if (msgs[i].len == 0) continue;
+            if (msgs[i].addr == 0 || msgs[i].addr + msgs[i].len > USER_SPACE_END) return -1;
+        }
+        return count;
+    }
+
+    static int Sys_SendMmsg(int fd, UdpMsg* msgs, int count) {
+        count = CheckUdpMsgs(msgs, count);
+        if (count < 0) return -1;
+        return Delivered(Net::Socket::SendMany(fd, (Net::Socket::Datagram*)msgs, count,
+                                               Sched::GetCurrentPid()));
+    }
+
+    static int Sys_RecvMmsg(int fd, UdpMsg* msgs, int count) {
+        count = CheckUdpMsgs(msgs, count);
+        if (count < 0) return -1;
+        return Delivered(Net::Socket::RecvMany(fd, (Net::Socket::Datagram*)msgs, count,
+                                               Sched::GetCurrentPid()));
+    }
+
+    static int Sys_GetSockOpt(int fd, int option, uint64_t* value) {
+        return Net::Socket::GetOption(fd, option, value, Sched::GetCurrentPid());
     }
 
     static void Sys_GetNetCfg(NetCfg* out) {
@@ -104,7 +178,8 @@ namespace Montauk {
         }
         out->_pad[0] = 0;
         out->_pad[1] = 0;
-        out->dnsServer = Net::GetDnsServer();
+        out->dnsServer = Net::GetDnsServer(0);
+        out->dnsServer2 = Net::GetDnsServer(1);
     }
 
     static int Sys_SetNetCfg(const NetCfg* in) {
@@ -112,7 +187,8 @@ namespace Montauk {
         Net::SetIpAddress(in->ipAddress);
         Net::SetSubnetMask(in->subnetMask);
         Net::SetGateway(in->gateway);
-        Net::SetDnsServer(in->dnsServer);
+        Net::SetDnsServer(in->dnsServer, 0);
+        Net::SetDnsServer(in->dnsServer2, 1);
         return 0;
     }
 
@@ -122,4 +198,8 @@ namespace Montauk {
         uint32_t ip = Net::Dns::Resolve(hostname);
         return (int64_t)ip;
     }
+
+    static int64_t Sys_ResolveAsync(const char* hostname) {
+        return Net::Dns::ResolveAsync(hostname);
+    }
 };
@@ -0,0 +1,25 @@
+/*
+    * Perf.hpp
+    * SYS_PERFCTL, SYS_PERFREAD syscalls
+    * Copyright (c) 2026 Daniel Hammer
+*/
+
+#pragma once
+#include <cstdint>
+#include <Sched/Scheduler.hpp>
+
+#include "Syscall.hpp"
+
+namespace Montauk {
+
+    // Count the PERF_* `events` for the calling thread from zero (0 stops).
+    // Returns the events actually counted, or -1 without a usable PMU.
+    static int64_t Sys_PerfCtl(uint32_t events, uint32_t flags) {
+        return Sched::PerfStart(events & PERF_ALL, flags);
+    }
+
+    static int64_t Sys_PerfRead(PerfCounts* out) {
+        Sched::PerfRead(*out);
+        return 0;
+    }
+};
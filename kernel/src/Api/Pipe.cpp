@@ -0,0 +1,376 @@
+/*
+    * Pipe.cpp
+    * Anonymous pipes: kernel byte streams between processes
+    * Copyright (c) 2026 Daniel Hammer
+*/
+
+#include "Pipe.hpp"
+#include <Memory/PageFrameAllocator.hpp>
+#include <Libraries/Memory.hpp>
+#include <CppLib/Spinlock.hpp>
+#include <Sched/Scheduler.hpp>
+#include <Sched/SleepLock.hpp>
+
+namespace Pipe {
+
+    static constexpr int EndRead = 0;
+    static constexpr int EndWrite = 1;
+
+    struct PipeState {
+        bool used;
+        uint16_t gen;               // Part of both handles; moves on each Create
+        uint8_t* buffer;
+        uint32_t capacity;          // A power of two
+        volatile uint32_t head;     // Bytes ever written
+        volatile uint32_t tail;     // Bytes ever read
+        int readers, writers;       // Holds on each end
+        int busy;                   // Transfers in progress; the pipe outlives them
+        // Wait queue words: writers sleep on readSeq, which moves as data
+        // leaves or a read end closes; readers sleep on writeSeq
+        volatile uint32_t readSeq;
+        volatile uint32_t writeSeq;
+        // One reader and one writer copy at a time, outside g_lock, since
+        // touching the caller's buffer may fault
+        Sched::SleepLock readLock;
+        Sched::SleepLock writeLock;
+    };
+
+    // One hold of a pipe end by a process
+    struct Ref {
+        int holder;                 // PID + 1, 0 = free
+        int handle;
+    };
+
+    static kcp::LockStat g_lockStat{"pipe"};
+    static kcp::Spinlock g_lock{&g_lockStat};
+    static PipeState g_pipes[MaxPipes];
+    static Ref g_refs[MaxRefs];
+
+    static int MakeHandle(int index, int end) {
+        return ((int)g_pipes[index].gen << 7) | (index << 1) | end;
+    }
+
+    static PipeState* LookupLocked(int handle, int& end) {
+        if (handle <= 0) return nullptr;
+        int index = (handle >> 1) & (MaxPipes - 1);
+        end = handle & 1;
+        PipeState& pipe = g_pipes[index];
+        if (!pipe.used || MakeHandle(index, end) != handle) return nullptr;
+        return &pipe;
+    }
+
+    static int FindRefLocked(int handle, int pid) {
+        for (int i = 0; i < MaxRefs; i++) {
+            if (g_refs[i].holder == pid + 1 && g_refs[i].handle == handle) return i;
+        }
+        return -1;
+    }
+
+    static int FreeRefLocked() {
+        for (int i = 0; i < MaxRefs; i++) {
+            if (g_refs[i].holder == 0) return i;
+        }
+        return -1;
+    }
+
+    static void AddRefLocked(int ref, PipeState& pipe, int handle, int pid) {
+        g_refs[ref].holder = pid + 1;
+        g_refs[ref].handle = handle;
+        if ((handle & 1) == EndRead) pipe.readers++;
+        else pipe.writers++;
+    }
+
+    // The last hold of an end going wakes whoever waits on the other
+    // end: readers to see the end of the stream, writers to fail
+    static void DropRefLocked(int ref, PipeState& pipe) {
+        if ((g_refs[ref].handle & 1) == EndRead) {
+            if (--pipe.readers == 0) __atomic_add_fetch(&pipe.readSeq, 1, __ATOMIC_SEQ_CST);
+        } else {
+            if (--pipe.writers == 0) __atomic_add_fetch(&pipe.writeSeq, 1, __ATOMIC_SEQ_CST);
+        }
+        g_refs[ref].holder = 0;
+    }
+
+    // Retire a pipe nobody holds or uses. Returns the buffer to free once
+    // g_lock is released, or nullptr.
+    static uint8_t* RetireIfUnusedLocked(PipeState& pipe) {
+        if (!pipe.used || pipe.readers > 0 || pipe.writers > 0 || pipe.busy > 0) return nullptr;
+        pipe.used = false;
+        uint8_t* buffer = pipe.buffer;
+        pipe.buffer = nullptr;
+        return buffer;
+    }
+
+    static void FreeBuffer(uint8_t* buffer, uint32_t capacity) {
+        if (buffer) Memory::g_pfa->Free(buffer, (int)(capacity / 0x1000));
+    }
+
+    static void WakeAll(PipeState& pipe) {
+        Sched::WakeAddress(&pipe.readSeq, Sched::MaxProcesses);
+        Sched::WakeAddress(&pipe.writeSeq, Sched::MaxProcesses);
+        Sched::NotifyReady(&pipe.readSeq);
+        Sched::NotifyReady(&pipe.writeSeq);
+    }
+
+    // Look up an end `pid` holds and mark a transfer in progress on it
+    static PipeState* BeginTransfer(int handle, int pid, int wantEnd, uint32_t& seq, bool& peerOpen) {
+        g_lock.Acquire();
+        int end;
+        PipeState* pipe = LookupLocked(handle, end);
+        if (pipe == nullptr || end != wantEnd || FindRefLocked(handle, pid) < 0) {
+            g_lock.Release();
+            return nullptr;
+        }
+        pipe->busy++;
+        if (wantEnd == EndRead) {
+            seq = pipe->writeSeq;
+            peerOpen = pipe->writers > 0;
+        } else {
+            seq = pipe->readSeq;
+            peerOpen = pipe->readers > 0;
+        }
+        g_lock.Release();
+        return pipe;
+    }
+
+    static void EndTransfer(PipeState* pipe) {
+        g_lock.Acquire();
+        pipe->busy--;
+        uint32_t capacity = pipe->capacity;
+        uint8_t* buffer = RetireIfUnusedLocked(*pipe);
+        g_lock.Release();
+        FreeBuffer(buffer, capacity);
+    }
+
+    static bool KillPending() {
+        auto* thread = Sched::GetCurrentThreadPtr();
+        return thread == nullptr || thread->sched->killPending;
+    }
+
+    int Create(int pid, uint32_t capacity, int& readHandle, int& writeHandle) {
+        if (capacity == 0) capacity = DefaultCapacity;
+        if (capacity > MaxCapacity) capacity = MaxCapacity;
+        uint32_t size = 0x1000;
+        while (size < capacity) size <<= 1;
+
+        uint8_t* buffer = (uint8_t*)Memory::g_pfa->AllocateContiguous((int)(size / 0x1000));
+        if (buffer == nullptr) return -1;
+
+        g_lock.Acquire();
+        int index = -1;
+        for (int i = 0; i < MaxPipes; i++) {
+            if (!g_pipes[i].used && g_pipes[i].busy == 0) { index = i; break; }
+        }
+        int readRef = -1, writeRef = -1;
+        for (int i = 0; i < MaxRefs && writeRef < 0; i++) {
+            if (g_refs[i].holder != 0) continue;
+            if (readRef < 0) readRef = i;
+            else writeRef = i;
+        }
+        if (index < 0 || readRef < 0 || writeRef < 0) {
+            g_lock.Release();
+            FreeBuffer(buffer, size);
+            return -1;
+        }
+
+        PipeState& pipe = g_pipes[index];
+        pipe.used = true;
+        pipe.gen = (uint16_t)(pipe.gen + 1);
+        if (pipe.gen == 0) pipe.gen = 1;
+        pipe.buffer = buffer;
+        pipe.capacity = size;
+        pipe.head = 0;
+        pipe.tail = 0;
+        pipe.readers = 0;
+        pipe.writers = 0;
+
+        readHandle = MakeHandle(index, EndRead);
+        writeHandle = MakeHandle(index, EndWrite);
+        AddRefLocked(readRef, pipe, readHandle, pid);
+        AddRefLocked(writeRef, pipe, writeHandle, pid);
+        g_lock.Release();
+        return 0;
+    }
+
+    int Share(int handle, int holder, int pid) {
+        g_lock.Acquire();
+        int end;
+        PipeState* pipe = LookupLocked(handle, end);
+        int ref = FreeRefLocked();
+        if (pipe == nullptr || ref < 0 || FindRefLocked(handle, holder) < 0) {
+            g_lock.Release();
+            return -1;
+        }
+        AddRefLocked(ref, *pipe, handle, pid);
+        g_lock.Release();
+        return 0;
+    }
+
+    int Close(int handle, int pid) {
+        g_lock.Acquire();
+        int end;
+        PipeState* pipe = LookupLocked(handle, end);
+        int ref = pipe ? FindRefLocked(handle, pid) : -1;
+        if (ref < 0) {
+            g_lock.Release();
+            return -1;
+        }
+        DropRefLocked(ref, *pipe);
+        uint32_t capacity = pipe->capacity;
+        uint8_t* buffer = RetireIfUnusedLocked(*pipe);
+        g_lock.Release();
+
+        FreeBuffer(buffer, capacity);
+        WakeAll(*pipe);
+        return 0;
+    }
+
+    int Read(int handle, int pid, void* buf, int len) {
+        if (len < 0) return -1;
+        while (true) {
+            uint32_t seq;
+            bool writersOpen;
+            PipeState* pipe = BeginTransfer(handle, pid, EndRead, seq, writersOpen);
+            if (pipe == nullptr) return -1;
+
+            pipe->readLock.Acquire();
+            uint32_t tail = pipe->tail;
+            uint32_t avail = __atomic_load_n(&pipe->head, __ATOMIC_ACQUIRE) - tail;
+            uint32_t n = avail < (uint32_t)len ? avail : (uint32_t)len;
+            if (n > 0) {
+                uint32_t at = tail & (pipe->capacity - 1);
+                uint32_t first = pipe->capacity - at < n ? pipe->capacity - at : n;
+                memcpy(buf, pipe->buffer + at, first);
+                memcpy((uint8_t*)buf + first, pipe->buffer, n - first);
+                __atomic_store_n(&pipe->tail, tail + n, __ATOMIC_RELEASE);
+            }
+            pipe->readLock.Release();
+
+            if (n > 0) {
+                __atomic_add_fetch(&pipe->readSeq, 1, __ATOMIC_SEQ_CST);
+                Sched::WakeAddress(&pipe->readSeq, Sched::MaxProcesses);
+                Sched::NotifyReady(&pipe->readSeq);
+            }
+            EndTransfer(pipe);
+            if (n > 0 || len == 0) return (int)n;
+            if (!writersOpen) return 0;
+            if (KillPending()) return -1;
+
+            // Data or the last writer's close moves writeSeq past `seq`
+            Sched::WaitOnAddress(&pipe->writeSeq, seq);
+        }
+    }
+
+    int Write(int handle, int pid, const void* buf, int len) {
+        if (len < 0) return -1;
+        int done = 0;
+        while (done < len) {
+            uint32_t seq;
+            bool readersOpen;
+            PipeState* pipe = BeginTransfer(handle, pid, EndWrite, seq, readersOpen);
+            if (pipe == nullptr) return done > 0 ? done : -1;
+            if (!readersOpen) {
+                EndTransfer(pipe);
+                return done > 0 ? done : -1;
+            }
+
+            pipe->writeLock.Acquire();
+            uint32_t head = pipe->head;
+            uint32_t space = pipe->capacity - (head - __atomic_load_n(&pipe->tail, __ATOMIC_ACQUIRE));
+            uint32_t want = (uint32_t)(len - done);
+            uint32_t n = space < want ? space : want;
+            if (n > 0) {
+                uint32_t at = head & (pipe->capacity - 1);
+                uint32_t first = pipe->capacity - at < n ? pipe->capacity - at : n;
+                const uint8_t* src = (const uint8_t*)buf + done;
+                memcpy(pipe->buffer + at, src, first);
+                memcpy(pipe->buffer, src + first, n - first);
+                __atomic_store_n(&pipe->head, head + n, __ATOMIC_RELEASE);
+            }
+            pipe->writeLock.Release();
+
+            if (n > 0) {
+                __atomic_add_fetch(&pipe->writeSeq, 1, __ATOMIC_SEQ_CST);
+                Sched::WakeAddress(&pipe->writeSeq, Sched::MaxProcesses);
+                Sched::NotifyReady(&pipe->writeSeq);
+                done += (int)n;
+                EndTransfer(pipe);
+                continue;
+            }
+            EndTransfer(pipe);
+            if (KillPending()) return done > 0 ? done : -1;
+
+            // A read or the last reader's close moves readSeq past `seq`
+            Sched::WaitOnAddress(&pipe->readSeq, seq);
+        }
+        return done;
+    }
+
+    uint32_t Poll(int handle, int pid, uint32_t& seq, uint64_t& key) {
+        seq = 0;
+        key = 0;
+        g_lock.Acquire();
+        int end;
+        PipeState* pipe = LookupLocked(handle, end);
+        if (pipe == nullptr || FindRefLocked(handle, pid) < 0) {
+            g_lock.Release();
+            return Montauk::POLL_ERR;
+        }
+        uint32_t used = pipe->head - pipe->tail;
+        uint32_t bits;
+        if (end == EndRead) {
+            seq = pipe->head;
+            key = (uint64_t)&pipe->writeSeq;
+            bits = used > 0 ? Montauk::POLL_IN : 0;
+            if (pipe->writers == 0) bits |= Montauk::POLL_IN | Montauk::POLL_HUP;
+        } else {
+            seq = pipe->tail;
+            key = (uint64_t)&pipe->readSeq;
+            bits = used < pipe->capacity ? Montauk::POLL_OUT : 0;
+            if (pipe->readers == 0) bits |= Montauk::POLL_HUP;
+        }
+        g_lock.Release();
+        return bits;
+    }
+
+    void CleanupProcess(int pid) {
+        bool touched[MaxPipes] = {};
+        uint8_t* buffers[MaxPipes] = {};
+        uint32_t capacities[MaxPipes] = {};
+
+        g_lock.Acquire();
+        for (int i = 0; i < MaxRefs; i++) {
+            if (g_refs[i].holder != pid + 1) continue;
+            int end;
+            PipeState* pipe = LookupLocked(g_refs[i].handle, end);
+            if (pipe == nullptr) {
+                g_refs[i].holder = 0;
+                continue;
+            }
+            DropRefLocked(i, *pipe);
+            touched[pipe - g_pipes] = true;
+        }
+        for (int i = 0; i < MaxPipes; i++) {
+            if (!touched[i]) continue;
+            capacities[i] = g_pipes[i].capacity;
+            buffers[i] = RetireIfUnusedLocked(g_pipes[i]);
+        }
+        g_lock.Release();
+
+        for (int i = 0; i < MaxPipes; i++) {
+            if (!touched[i]) continue;
+            FreeBuffer(buffers[i], capacities[i]);
+            WakeAll(g_pipes[i]);
+        }
+    }
+
+    int CountHeld(int pid) {
+        int count = 0;
+        g_lock.Acquire();
+        for (int i = 0; i < MaxRefs; i++) {
+            if (g_refs[i].holder == pid + 1) count++;
+        }
+        g_lock.Release();
+        return count;
+    }
+}
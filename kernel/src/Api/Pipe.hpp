@@ -0,0 +1,57 @@
+/*
+    * Pipe.hpp
+    * Anonymous pipes: kernel byte streams between processes
+    * Copyright (c) 2026 Daniel Hammer
+*/
+
+#pragma once
+#include <cstdint>
+#include "Syscall.hpp"
+
+namespace Pipe {
+
+    static constexpr int MaxPipes = 64;
+    // Ends held across all processes; a pipe set up for a pipeline holds
+    // two, plus the ones its spawner has not closed yet
+    static constexpr int MaxRefs = 256;
+
+    // Buffer sizes Create accepts, rounded up to a power of two
+    static constexpr uint32_t DefaultCapacity = Montauk::PIPE_DEFAULT_CAPACITY;
+    static constexpr uint32_t MaxCapacity = Montauk::PIPE_MAX_CAPACITY;
+
+    // A pipe has a read end and a write end, each named by a handle that
+    // any number of processes may hold. Reads block until data arrives
+    // and return 0 once no process holds the write end; writes block
+    // until everything is in the buffer and fail once no process holds
+    // the read end. A process's ends are closed when it exits.
+
+    // Create a pipe held by `pid`. Returns 0 and the handles, or -1.
+    int Create(int pid, uint32_t capacity, int& readHandle, int& writeHandle);
+
+    // Give `pid` a hold on the end `handle` names, which `holder` must
+    // hold (SYS_SPAWN_PIPED attaching a child's stdin or stdout)
+    int Share(int handle, int holder, int pid);
+
+    // Drop one of `pid`'s holds on `handle`. Returns 0, or -1.
+    int Close(int handle, int pid);
+
+    // Blocking transfers; `buf` is in the caller's address space. Read
+    // returns the bytes read (at most `len`), 0 at end of stream; Write
+    // returns `len`, or the bytes written before the readers went away.
+    // Both return -1 if `pid` does not hold that end or is being killed.
+    int Read(int handle, int pid, void* buf, int len);
+    int Write(int handle, int pid, const void* buf, int len);
+
+    // Montauk::POLL_* bits of the end (SYS_EPOLL_WAIT): POLL_IN when a
+    // read would not block, POLL_OUT when a write would find room,
+    // POLL_HUP once the other end is closed. `seq` moves with each
+    // transfer the end waits for; `key` is what the pipe then passes to
+    // Sched::NotifyReady.
+    uint32_t Poll(int handle, int pid, uint32_t& seq, uint64_t& key);
+
+    // Close every end `pid` holds
+    void CleanupProcess(int pid);
+
+    // Ends `pid` holds
+    int CountHeld(int pid);
+}
@@ -0,0 +1,72 @@
+/*
+    * PipeIo.hpp
+    * SYS_PIPE, SYS_PIPE_READ, SYS_PIPE_WRITE, SYS_PIPE_CLOSE,
+    * SYS_SPAWN_PIPED syscalls
+    * Copyright (c) 2026 Daniel Hammer
+*/
+
+#pragma once
+#include <Sched/Scheduler.hpp>
+
+#include "Syscall.hpp"
+#include "Pipe.hpp"
+#include "Path.hpp"
+
+namespace Montauk {
+
+    // A handle of the caller's, with PIPE_STDIN and PIPE_STDOUT standing
+    // for the pipes it was spawned with (-1 if it has none)
+    static int ResolvePipeHandle(Sched::Process* proc, int handle) {
+        if (handle == PIPE_STDIN) return proc->stdinPipe;
+        if (handle == PIPE_STDOUT) return proc->stdoutPipe;
+        return handle;
+    }
+
+    static int Sys_Pipe(int32_t* handles, uint32_t capacity) {
+        auto* proc = Sched::GetCurrentProcessPtr();
+        if (proc == nullptr) return -1;
+        int readHandle, writeHandle;
+        if (Pipe::Create(proc->pid, capacity, readHandle, writeHandle) < 0) return -1;
+        handles[0] = readHandle;
+        handles[1] = writeHandle;
+        return 0;
+    }
+
+    static int Sys_PipeRead(int handle, void* buf, int len) {
+        auto* proc = Sched::GetCurrentProcessPtr();
+        if (proc == nullptr) return -1;
+        return Pipe::Read(ResolvePipeHandle(proc, handle), proc->pid, buf, len);
+    }
+
+    static int Sys_PipeWrite(int handle, const void* buf, int len) {
+        auto* proc = Sched::GetCurrentProcessPtr();
+        if (proc == nullptr) return -1;
+        return Pipe::Write(ResolvePipeHandle(proc, handle), proc->pid, buf, len);
+    }
+
+    static int Sys_PipeClose(int handle) {
+        auto* proc = Sched::GetCurrentProcessPtr();
+        if (proc == nullptr) return -1;
+        return Pipe::Close(handle, proc->pid);
+    }
+
+    static int Sys_SpawnPiped(const char* path, const char* args, int stdinPipe, int stdoutPipe) {
+        char resolved[256];
+        if (!ResolveProcessPath(path, resolved, sizeof(resolved))) return -1;
+
+        auto* parent = Sched::GetCurrentProcessPtr();
+        int childPid = Sched::Spawn(resolved, args, PRIO_INHERIT, stdinPipe, stdoutPipe);
+        if (childPid < 0) return childPid;
+
+        // Output that does not go to a pipe goes where the parent's does,
+        // as with SYS_SPAWN
+        if (parent && parent->redirected) {
+            auto* child = Sched::GetProcessByPid(childPid);
+            if (child) {
+                child->redirected = true;
+                child->parentPid = parent->outBuf ? parent->pid : parent->parentPid;
+            }
+        }
+        return childPid;
+    }
+};
@@ -0,0 +1,317 @@
+/*
+    * Poll.hpp
+    * SYS_EPOLL_CREATE, SYS_EPOLL_CTL, SYS_EPOLL_WAIT, SYS_EPOLL_CLOSE syscalls
+    * Copyright (c) 2026 Daniel Hammer
+*/
+
+#pragma once
+#include <cstdint>
+#include <Sched/Scheduler.hpp>
+#include <Timekeeping/ApicTimer.hpp>
+#include <Net/Socket.hpp>
+#include <Drivers/PS2/Keyboard.hpp>
+#include <Drivers/PS2/Mouse.hpp>
+#include <Memory/Pressure.hpp>
+
+#include "Syscall.hpp"
+#include "Common.hpp"
+#include "WinServer.hpp"
+#include "Pipe.hpp"
+#include "Channel.hpp"
+#include "Graphics.hpp"
+
+namespace Montauk {
+
+    // A poll set is a table of watches owned by one process. Waiting
+    // checks every watch, and if none is ready sleeps on the set's own
+    // readiness generation, which only the sources it watches bump: the
+    // set is scheduler readiness listener number `epfd`, subscribed to
+    // the key of each watched source. Each source also reports a counter
+    // that changes with every new arrival; an edge-triggered watch
+    // remembers the value it last reported and stays quiet until it
+    // moves. Sets last until closed or until their process is gone.
+
+    static constexpr int MaxPollSets = 64;
+    static_assert(MaxPollSets <= Sched::MaxReadyListeners, "each poll set is a readiness listener");
+    static constexpr int MaxPollSetsPerProcess = 8;
+
+    // TCP timers only run when a thread touches the connection, so a
+    // waiter watching a connection with data in flight wakes this often
+    static constexpr uint64_t PollTimerMs = 10;
+
+    struct PollWatch {
+        bool     used;
+        bool     reported;        // lastSeq is valid (edge-triggered)
+        uint8_t  source;
+        int32_t  id;
+        uint32_t events;
+        uint32_t lastSeq;
+        uint64_t userData;
+    };
+
+    struct PollSet {
+        bool used;
+        int tgid;
+        kcp::Mutex lock;          // Watches and readiness subscriptions; held while checking them
+        PollWatch watches[EPOLL_MAX_WATCHES];
+    };
+
+    static PollSet g_pollSets[MaxPollSets];
+    static kcp::Mutex g_pollSetLock;
+
+    // Free the sets of processes that have exited. g_pollSetLock held.
+    static void ReapPollSetsLocked() {
+        for (int i = 0; i < MaxPollSets; i++) {
+            if (g_pollSets[i].used && !Sched::IsAlive(g_pollSets[i].tgid)) {
+                g_pollSets[i].lock.Acquire();
+                g_pollSets[i].used = false;
+                Sched::SubscribeReady(i, nullptr, 0);
+                g_pollSets[i].lock.Release();
+            }
+        }
+    }
+
+    static PollSet* GetPollSet(int epfd) {
+        auto* proc = Sched::GetCurrentProcessPtr();
+        if (proc == nullptr || epfd < 0 || epfd >= MaxPollSets) return nullptr;
+        PollSet* set = &g_pollSets[epfd];
+        if (!set->used || set->tgid != proc->pid) return nullptr;
+        return set;
+    }
+
+    // Ready POLL_* bits of one source for process `proc`, its arrival
+    // counter in `seq`, and the key it notifies readiness under in `key`
+    // (0 if it never does)
+    static uint32_t PollSource(Sched::Process* proc, uint8_t source, int32_t id,
+                               uint32_t& seq, bool& timers, uint64_t& key) {
+        seq = 0;
+        key = 0;
+        switch (source) {
+            case POLL_SRC_SOCKET:
+                return Net::Socket::Poll(id, proc->pid, seq, timers, key);
+
+            case POLL_SRC_KEYBOARD: {
+                if (proc->redirected) {
+                    auto* target = GetRedirTarget(proc);
+                    if (target == nullptr) return POLL_HUP;
+                    key = (uint64_t)&target->inHead;
+                    seq = target->keyHead + target->inHead;
+                    bool chars = target->inBuf && target->inHead != target->inTail;
+                    return (chars || target->keyHead != target->keyTail) ? POLL_IN : 0;
+                }
+                key = POLL_SRC_KEYBOARD;
+                seq = Drivers::PS2::Keyboard::EventCount();
+                return Drivers::PS2::Keyboard::IsKeyAvailable() ? POLL_IN : 0;
+            }
+
+            case POLL_SRC_WINDOW: {
+                int pending = WinServer::Pending(id, proc->pid, seq, key);
+                if (pending < 0) return POLL_ERR;
+                return pending ? POLL_IN : 0;
+            }
+
+            case POLL_SRC_CHILDIO: {
+                auto* child = Sched::GetProcessByPid(id);
+                if (child == nullptr || !child->redirected || child->parentPid != proc->pid) {
+                    return POLL_HUP;
+                }
+                if (child->outBuf == nullptr) return POLL_HUP;
+                key = (uint64_t)&child->outHead;
+                seq = child->outHead;
+                return POLL_OUT | (child->outHead != child->outTail ? POLL_IN : 0);
+            }
+
+            case POLL_SRC_MOUSE:
+                key = POLL_SRC_MOUSE;
+                seq = Drivers::PS2::Mouse::EventCount();
+                return Drivers::PS2::Mouse::HasNewState() ? POLL_IN : 0;
+
+            case POLL_SRC_WINSERVER:
+                key = POLL_SRC_WINSERVER;
+                return WinServer::Activity(seq) ? POLL_IN : 0;
+
+            case POLL_SRC_PIPE: {
+                int handle = id == PIPE_STDIN ? proc->stdinPipe : id == PIPE_STDOUT ? proc->stdoutPipe : id;
+                return Pipe::Poll(handle, proc->pid, seq, key);
+            }
+
+            case POLL_SRC_CHANNEL:
+                return Channel::Poll(id, proc->pid, seq, key);
+
+            case POLL_SRC_MEMORY:
+                key = POLL_SRC_MEMORY;
+                seq = Memory::Pressure::EventCount();
+                return Memory::Pressure::Level() > MEM_PRESSURE_NONE ? POLL_IN : 0;
+
+            case POLL_SRC_VBLANK:
+                // Nothing signals a blank; recheck at the timer interval
+                timers = true;
+                return PollVblank(seq);
+
+            default:
+                return POLL_ERR;
+        }
+    }
+
+    // Fill `out` with up to `max` ready watches, and `keys` with the
+    // readiness keys of the watches checked (`keyCount` of them). set->lock held.
+    static int CollectReady(Sched::Process* proc, PollSet* set, PollEvent* out, int max, bool& timers,
+                            uint64_t* keys, int& keyCount) {
+        int count = 0;
+        keyCount = 0;
+        for (int i = 0; i < EPOLL_MAX_WATCHES && count < max; i++) {
+            PollWatch& w = set->watches[i];
+            if (!w.used) continue;
+
+            uint32_t seq;
+            uint32_t ready = PollSource(proc, w.source, w.id, seq, timers, keys[keyCount]);
+            keyCount++;
+            ready &= (w.events & (POLL_IN | POLL_OUT)) | POLL_ERR | POLL_HUP;
+            if (ready == 0) continue;
+
+            if (w.events & POLL_ET) {
+                if (w.reported && w.lastSeq == seq) continue;
+                w.reported = true;
+                w.lastSeq = seq;
+            }
+
+            out[count].source = w.source;
+            out[count].id = w.id;
+            out[count].events = ready;
+            out[count].userData = w.userData;
+            count++;
+        }
+        return count;
+    }
+
+    static int Sys_EpollCreate() {
+        auto* proc = Sched::GetCurrentProcessPtr();
+        if (proc == nullptr) return -1;
+
+        g_pollSetLock.Acquire();
+        ReapPollSetsLocked();
+        int slot = -1, owned = 0;
+        for (int i = 0; i < MaxPollSets; i++) {
+            if (!g_pollSets[i].used) {
+                if (slot < 0) slot = i;
+            } else if (g_pollSets[i].tgid == proc->pid) {
+                owned++;
+            }
+        }
+        if (slot < 0 || owned >= MaxPollSetsPerProcess) {
+            g_pollSetLock.Release();
+            return -1;
+        }
+
+        PollSet& set = g_pollSets[slot];
+        set.used = true;
+        set.tgid = proc->pid;
+        for (int i = 0; i < EPOLL_MAX_WATCHES; i++) set.watches[i].used = false;
+        g_pollSetLock.Release();
+        return slot;
+    }
+
+    static int Sys_EpollCtl(int epfd, int op, const PollEvent* ev) {
+        PollSet* set = GetPollSet(epfd);
+        if (set == nullptr || ev == nullptr) return -1;
+        if (ev->source > POLL_SRC_VBLANK) return -1;
+        PollEvent req = *ev;
+
+        set->lock.Acquire();
+        int found = -1, unused = -1;
+        for (int i = 0; i < EPOLL_MAX_WATCHES; i++) {
+            PollWatch& w = set->watches[i];
+            if (!w.used) {
+                if (unused < 0) unused = i;
+            } else if (w.source == req.source && w.id == req.id) {
+                found = i;
+            }
+        }
+
+        int result = 0;
+        switch (op) {
+            case EPOLL_CTL_ADD:
+                if (found >= 0 || unused < 0) { result = -1; break; }
+                found = unused;
+                set->watches[found].used = true;
+                set->watches[found].source = req.source;
+                set->watches[found].id = req.id;
+                [[fallthrough]];
+            case EPOLL_CTL_MOD:
+                if (found < 0) { result = -1; break; }
+                set->watches[found].events = req.events;
+                set->watches[found].userData = req.userData;
+                set->watches[found].reported = false;
+                break;
+            case EPOLL_CTL_DEL:
+                if (found < 0) { result = -1; break; }
+                set->watches[found].used = false;
+                break;
+            default:
+                result = -1;
+                break;
+        }
+        set->lock.Release();
+        return result;
+    }
+
+    // Wait until a watch is ready or `timeoutMs` passes (0 = just check,
+    // negative = no limit). Returns the number of events written to
+    // `out`, 0 on timeout, or -1.
+    static int Sys_EpollWait(int epfd, PollEvent* out, int max, int64_t timeoutMs) {
+        auto* proc = Sched::GetCurrentProcessPtr();
+        PollSet* set = GetPollSet(epfd);
+        if (set == nullptr || max <= 0) return -1;
+
+        uint64_t deadline = 0;
+        if (timeoutMs > 0) deadline = Timekeeping::GetMilliseconds() + (uint64_t)timeoutMs;
+
+        uint64_t keys[EPOLL_MAX_WATCHES];
+        for (;;) {
+            // Read the generation first: a notification after this point
+            // makes WaitReady return at once
+            uint32_t generation = Sched::ReadyGeneration(epfd);
+            bool timers = false;
+            int keyCount;
+
+            set->lock.Acquire();
+            if (!set->used) {
+                // Closed by another thread while we slept
+                set->lock.Release();
+                return -1;
+            }
+            int count = CollectReady(proc, set, out, max, timers, keys, keyCount);
+            // A source not subscribed to before the generation was read
+            // may have been notified unseen: check again
+            bool added = count == 0 && timeoutMs != 0 && Sched::SubscribeReady(epfd, keys, keyCount);
+            set->lock.Release();
+            if (count > 0 || timeoutMs == 0) return count;
+            if (added) continue;
+
+            uint64_t wait = 0;
+            if (timeoutMs > 0) {
+                uint64_t now = Timekeeping::GetMilliseconds();
+                if (now >= deadline) return 0;
+                wait = deadline - now;
+            }
+            if (timers && (wait == 0 || wait > PollTimerMs)) wait = PollTimerMs;
+
+            auto* thread = Sched::GetCurrentThreadPtr();
+            if (thread && thread->sched->killPending) return -1;
+            Sched::WaitReady(epfd, generation, wait);
+        }
+    }
+
+    static int Sys_EpollClose(int epfd) {
+        PollSet* set = GetPollSet(epfd);
+        if (set == nullptr) return -1;
+
+        g_pollSetLock.Acquire();
+        set->lock.Acquire();
+        set->used = false;
+        Sched::SubscribeReady(epfd, nullptr, 0);
+        set->lock.Release();
+        g_pollSetLock.Release();
+        return 0;
+    }
+};
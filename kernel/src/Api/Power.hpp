@@ -10,10 +10,13 @@
 #include <Memory/Paging.hpp>
 #include <ACPI/AcpiShutdown.hpp>
 #include <ACPI/AcpiSleep.hpp>
+#include <Fs/Vfs.hpp>
 
 namespace Montauk {
 
     static void Sys_Reset() {
+        Fs::Vfs::VfsSync();
+
         if (Efi::g_ResetSystem) {
             /* Switch to kernel PML4 which has identity-mapped UEFI runtime regions */
             Memory::VMM::LoadCR3(Memory::VMM::g_paging->PML4);
@@ -27,6 +30,8 @@ namespace Montauk {
     }
 
     static void Sys_Shutdown() {
+        Fs::Vfs::VfsSync();
+
         /* Primary: ACPI S5 shutdown via PM1 control registers */
         if (Hal::AcpiShutdown::IsAvailable()) {
             Hal::AcpiShutdown::Shutdown();
@@ -47,6 +52,7 @@ namespace Montauk {
         if (!Hal::AcpiSleep::IsS3Available()) {
             return -1; // S3 not supported
         }
+        Fs::Vfs::VfsSync();
         return (int64_t)Hal::AcpiSleep::Suspend();
     }
 };
@@ -1,7 +1,9 @@
 /*
     * Process.hpp
     * SYS_EXIT, SYS_YIELD, SYS_SLEEP_MS, SYS_GETPID,
-    * SYS_WAITPID, SYS_SPAWN, SYS_GETARGS, SYS_PROCLIST, SYS_KILL syscalls
+    * SYS_WAITPID, SYS_SPAWN, SYS_GETARGS, SYS_PROCLIST, SYS_KILL,
+    * SYS_THREAD_CREATE, SYS_THREAD_JOIN, SYS_THREAD_EXIT, SYS_GETTID,
+    * SYS_SETPRIORITY, SYS_GETPRIORITY, SYS_SETAFFINITY, SYS_GETAFFINITY syscalls
     * Copyright (c) 2026 Daniel Hammer
 */
 
@@ -12,9 +14,13 @@
 #include <Memory/PageFrameAllocator.hpp>
 #include <Memory/HHDM.hpp>
 #include <Fs/Vfs.hpp>
+#include <Net/Socket.hpp>
 
 #include "Syscall.hpp"
 #include "WinServer.hpp"
+#include "Pipe.hpp"
+#include "Channel.hpp"
+#include "Handles.hpp"
 #include "Path.hpp"
 
 namespace Montauk {
@@ -39,12 +45,31 @@ namespace Montauk {
         Sched::BlockOnPid(pid);
     }
 
-    static int Sys_Spawn(const char* path, const char* args) {
+    static int Sys_GetTid() {
+        return Sched::GetCurrentTid();
+    }
+
+    static int Sys_ThreadCreate(uint64_t entry, uint64_t arg) {
+        return Sched::CreateThread(entry, arg);
+    }
+
+    static int Sys_ThreadJoin(int tid, int* exitCode) {
+        int code = 0;
+        if (Sched::JoinThread(tid, &code) < 0) return -1;
+        if (exitCode) *exitCode = code;
+        return 0;
+    }
+
+    static void Sys_ThreadExit(int exitCode) {
+        Sched::ExitThread(exitCode);
+    }
+
+    static int Sys_Spawn(const char* path, const char* args, int priority) {
         char resolved[256];
         if (!ResolveProcessPath(path, resolved, sizeof(resolved))) return -1;
 
         auto* parent = Sched::GetCurrentProcessPtr();
-        int childPid = Sched::Spawn(resolved, args);
+        int childPid = Sched::Spawn(resolved, args, priority);
         if (childPid < 0) return childPid;
 
             // Inherit I/O redirection: if the parent is redirected, the child
@@ -79,23 +104,44 @@ namespace Montauk {
     static int Sys_ProcList(ProcInfo* buf, int maxCount) {
         if (buf == nullptr || maxCount <= 0) return 0;
         int count = 0;
-        for (int i = 0; i < Sched::MaxProcesses && count < maxCount; i++) {
+        int slots = Sched::SlotCount();
+        for (int i = 0; i < slots && count < maxCount; i++) {
             auto* proc = Sched::GetProcessSlot(i);
-            if (!proc || proc->state == Sched::ProcessState::Free) continue;
+            if (!proc || proc->sched->state == Sched::ProcessState::Free) continue;
+            if (proc->leaderSlot != i) continue; // Threads are listed as their process
 
             buf[count].pid = (int32_t)proc->pid;
             buf[count].parentPid = (int32_t)proc->parentPid;
-            buf[count].state = (uint8_t)proc->state;
+            buf[count].state = (uint8_t)proc->sched->state;
+            buf[count].priority = proc->sched->priority;
             buf[count]._pad[0] = 0;
             buf[count]._pad[1] = 0;
-            buf[count]._pad[2] = 0;
             {
                 int j = 0;
                 for (; j < 63 && proc->name[j]; j++)
                     buf[count].name[j] = proc->name[j];
                 buf[count].name[j] = '\0';
             }
-            buf[count].heapUsed = Sched::g_allocatedPages[i] * 0x1000;
+            buf[count].heapUsed = proc->allocatedPages * 0x1000;
+            buf[count].residentPages = proc->allocatedPages;
+            buf[count].reservedPages = proc->reservedPages;
+            proc->vmLock.Acquire();
+            buf[count].vmaCount = (uint32_t)proc->heapVmas.RegionCount();
+            proc->vmLock.Release();
+            buf[count].windowPages = (uint32_t)WinServer::BufferPages(proc->pid);
+            buf[count].sockets = (uint32_t)Net::Socket::CountOwned(proc->pid);
+            buf[count].openFiles = (uint32_t)(CountHandles(proc->pid) + Pipe::CountHeld(proc->pid) +
+                                              Channel::CountHeld(proc->pid));
+
+            Sched::GroupStats stats = {};
+            stats.cpu = -1;
+            Sched::GetGroupStats(proc->pid, stats);
+            buf[count].userTimeUs = stats.userUs;
+            buf[count].kernelTimeUs = stats.kernelUs;
+            buf[count].voluntarySwitches = stats.voluntarySwitches;
+            buf[count].involuntarySwitches = stats.involuntarySwitches;
+            buf[count].cpu = stats.cpu;
+            buf[count].threads = (uint32_t)stats.threads;
             count++;
         }
         return count;
@@ -105,6 +151,27 @@ namespace Montauk {
         return Sched::KillProcess(pid);
     }
 
+    // pid < 0 means the calling process
+    static int Sys_SetPriority(int pid, int priority) {
+        if (pid < 0) pid = Sched::GetCurrentPid();
+        return Sched::SetPriority(pid, priority);
+    }
+
+    static int Sys_GetPriority(int pid) {
+        if (pid < 0) pid = Sched::GetCurrentPid();
+        return Sched::GetPriority(pid);
+    }
+
+    static int Sys_SetAffinity(int pid, uint64_t mask) {
+        if (pid < 0) pid = Sched::GetCurrentPid();
+        return Sched::SetAffinity(pid, mask);
+    }
+
+    static uint64_t Sys_GetAffinity(int pid) {
+        if (pid < 0) pid = Sched::GetCurrentPid();
+        return Sched::GetAffinity(pid);
+    }
+
     static int Sys_SetUser(int pid, const char* name) {
         if (name == nullptr) return -1;
         auto* target = Sched::GetProcessByPid(pid);
@@ -137,12 +204,10 @@ namespace Montauk {
         return i;
     }
 
-    static int Sys_Chdir(const char* path) {
-        auto* proc = Sched::GetCurrentProcessPtr();
-        if (proc == nullptr || path == nullptr) return -1;
-
-        char resolved[256];
-        if (!ResolveProcessPath(path, resolved, sizeof(resolved))) return -1;
+    // Resolve `path` against the caller's cwd into `resolved` (256 bytes);
+    // false unless it names an existing directory
+    static bool ResolveDirectory(const char* path, char* resolved) {
+        if (!ResolveProcessPath(path, resolved, 256)) return false;
 
         bool isDriveRoot = false;
         {
@@ -155,12 +220,21 @@ namespace Montauk {
 
         if (isDriveRoot) {
             const char* entries[1];
-            if (Fs::Vfs::VfsReadDir(resolved, entries, 1) < 0) return -1;
+            if (Fs::Vfs::VfsReadDir(resolved, entries, 1) < 0) return false;
         } else {
             int handle = Fs::Vfs::VfsOpen(resolved);
-            if (handle < 0) return -1;
+            if (handle < 0) return false;
             Fs::Vfs::VfsClose(handle);
         }
+        return true;
+    }
+
+    static int Sys_Chdir(const char* path) {
+        auto* proc = Sched::GetCurrentProcessPtr();
+        if (proc == nullptr || path == nullptr) return -1;
+
+        char resolved[256];
+        if (!ResolveDirectory(path, resolved)) return -1;
 
         int i = 0;
         for (; i < 255 && resolved[i]; i++) proc->cwd[i] = resolved[i];
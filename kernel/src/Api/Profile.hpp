@@ -0,0 +1,28 @@
+/*
+    * Profile.hpp
+    * SYS_PROFCTL, SYS_PROFREAD syscalls
+    * Copyright (c) 2026 Daniel Hammer
+*/
+
+#pragma once
+#include <cstdint>
+#include <Common/Profiler.hpp>
+
+#include "Syscall.hpp"
+
+namespace Montauk {
+
+    // Nonzero `enable` starts sampling process `pid` (-1: every process)
+    // and returns 0, or -1 if the buffers cannot be allocated. Zero stops
+    // and returns the number of samples that were dropped.
+    static int64_t Sys_ProfCtl(int enable, int pid) {
+        if (!enable) return (int64_t)Prof::Stop();
+        return Prof::Start(pid) ? 0 : -1;
+    }
+
+    // Move up to `max` recorded samples into `buf`. Returns how many.
+    static int64_t Sys_ProfRead(ProfSample* buf, int max) {
+        if (max <= 0) return 0;
+        return Prof::Read(buf, max);
+    }
+};
@@ -0,0 +1,193 @@
+/*
+    * Spawn.hpp
+    * SYS_SPAWN_EX, SYS_GETENV syscalls
+    * Copyright (c) 2026 Daniel Hammer
+*/
+
+#pragma once
+#include <Sched/Scheduler.hpp>
+#include <Memory/Heap.hpp>
+#include <Libraries/Memory.hpp>
+
+#include "Syscall.hpp"
+#include "Pipe.hpp"
+#include "Path.hpp"
+
+namespace Montauk {
+
+    // Resolving pipe handles and directories: PipeIo.hpp and Process.hpp
+    // must be included first
+
+    static constexpr uint64_t SPAWN_USER_END = 0x0000800000000000ULL;
+
+    static bool SpawnUserPtr(const void* p) {
+        return p != nullptr && (uint64_t)p < SPAWN_USER_END;
+    }
+
+    // Join the null-terminated `argv` with spaces into `out`
+    // (SPAWN_ARGS_MAX bytes); false if it does not fit
+    static bool JoinSpawnArgs(const char* const* argv, char* out) {
+        int len = 0;
+        out[0] = '\0';
+        for (int i = 0; ; i++) {
+            if (!SpawnUserPtr(&argv[i])) return false;
+            const char* arg = argv[i];
+            if (arg == nullptr) return true;
+            if (!SpawnUserPtr(arg)) return false;
+            if (i > 0) {
+                if (len + 1 >= SPAWN_ARGS_MAX) return false;
+                out[len++] = ' ';
+            }
+            for (int j = 0; arg[j]; j++) {
+                if (len + 1 >= SPAWN_ARGS_MAX) return false;
+                out[len++] = arg[j];
+            }
+            out[len] = '\0';
+        }
+    }
+
+    // Copy the null-terminated `envp` into `out` (SPAWN_ENV_MAX bytes) as
+    // an environment block; -1 if it does not fit or a string has no '='
+    static int BuildSpawnEnv(const char* const* envp, char* out) {
+        int size = 0;
+        for (int i = 0; ; i++) {
+            if (!SpawnUserPtr(&envp[i])) return -1;
+            const char* entry = envp[i];
+            if (entry == nullptr) return size;
+            if (!SpawnUserPtr(entry)) return -1;
+            bool named = false;
+            for (int j = 0; ; j++) {
+                if (size >= SPAWN_ENV_MAX) return -1;
+                out[size++] = entry[j];
+                if (entry[j] == '\0') break;
+                if (entry[j] == '=' && j > 0) named = true;
+            }
+            if (!named) return -1;
+        }
+    }
+
+    static int Sys_SpawnEx(SpawnAttr* userAttr) {
+        auto* proc = Sched::GetCurrentProcessPtr();
+        if (proc == nullptr) return -1;
+
+        SpawnAttr attr;
+        memcpy(&attr, userAttr, sizeof(SpawnAttr));
+
+        char resolved[256];
+        if (!SpawnUserPtr(attr.path) || !ResolveProcessPath(attr.path, resolved, sizeof(resolved))) return -1;
+
+        char args[SPAWN_ARGS_MAX];
+        args[0] = '\0';
+        if (attr.argv != nullptr && !JoinSpawnArgs(attr.argv, args)) return -1;
+
+        char cwd[256];
+        if (attr.cwd != nullptr && (!SpawnUserPtr(attr.cwd) || !ResolveDirectory(attr.cwd, cwd))) return -1;
+
+        if (attr.priority < PRIO_INHERIT || attr.priority >= PRIO_COUNT) return -1;
+        uint64_t affinity = attr.affinity ? attr.affinity : ~0ULL;
+        if ((affinity & Sched::OnlineCpuMask()) == 0) return -1;
+
+        if (attr.actionCount > (uint32_t)SPAWN_ACTIONS_MAX) return -1;
+        SpawnAction actions[SPAWN_ACTIONS_MAX];
+        if (attr.actionCount > 0) {
+            if (!SpawnUserPtr(attr.actions)) return -1;
+            memcpy(actions, attr.actions, attr.actionCount * sizeof(SpawnAction));
+        }
+
+        char* env = nullptr;
+        int envSize = 0;
+        if (attr.envp != nullptr) {
+            env = (char*)Memory::g_heap->Request(SPAWN_ENV_MAX);
+            if (env == nullptr) return -1;
+            envSize = BuildSpawnEnv(attr.envp, env);
+            if (envSize < 0) {
+                Memory::g_heap->Free(env);
+                return -1;
+            }
+        }
+
+        // The child's streams, and the ends of the pipes made for it: the
+        // child's, which the caller lets go of once the child holds it, and
+        // the caller's
+        int streams[2] = { PIPE_INHERIT, PIPE_INHERIT };
+        int childEnds[SPAWN_ACTIONS_MAX];
+        int callerEnds[SPAWN_ACTIONS_MAX];
+        int pipes = 0;
+        bool ok = true;
+
+        for (uint32_t i = 0; i < attr.actionCount && ok; i++) {
+            SpawnAction& action = actions[i];
+            if (action.stream != SPAWN_STDIN && action.stream != SPAWN_STDOUT) {
+                ok = false;
+            } else if (action.action == SPAWN_ACT_DUP) {
+                int handle = ResolvePipeHandle(proc, action.handle);
+                if (handle <= 0) ok = false;
+                streams[action.stream] = handle;
+            } else if (action.action == SPAWN_ACT_CLOSE) {
+                streams[action.stream] = PIPE_NONE;
+            } else if (action.action == SPAWN_ACT_PIPE) {
+                int readHandle, writeHandle;
+                if (Pipe::Create(proc->pid, action.capacity, readHandle, writeHandle) < 0) {
+                    ok = false;
+                    continue;
+                }
+                bool in = action.stream == SPAWN_STDIN;
+                childEnds[pipes] = in ? readHandle : writeHandle;
+                callerEnds[pipes] = in ? writeHandle : readHandle;
+                streams[action.stream] = childEnds[pipes];
+                action.handle = callerEnds[pipes];
+                pipes++;
+            } else {
+                ok = false;
+            }
+        }
+
+        int childPid = -1;
+        if (ok) {
+            Sched::SpawnOptions options;
+            options.priority = attr.priority;
+            options.stdinPipe = streams[SPAWN_STDIN];
+            options.stdoutPipe = streams[SPAWN_STDOUT];
+            options.affinity = affinity;
+            options.cwd = attr.cwd != nullptr ? cwd : nullptr;
+            if (attr.envp != nullptr) {
+                options.env = env;
+                options.envSize = (uint32_t)envSize;
+            }
+            childPid = Sched::Spawn(resolved, args, options);
+        }
+        if (env != nullptr) Memory::g_heap->Free(env);
+
+        for (int i = 0; i < pipes; i++) {
+            Pipe::Close(childEnds[i], proc->pid);
+            if (childPid < 0) Pipe::Close(callerEnds[i], proc->pid);
+        }
+        if (childPid < 0) return -1;
+
+        if (attr.actionCount > 0) {
+            memcpy(attr.actions, actions, attr.actionCount * sizeof(SpawnAction));
+        }
+
+        // Output that does not go to a pipe goes where the caller's does,
+        // as with SYS_SPAWN
+        if (proc->redirected) {
+            auto* child = Sched::GetProcessByPid(childPid);
+            if (child) {
+                child->redirected = true;
+                child->parentPid = proc->outBuf ? proc->pid : proc->parentPid;
+            }
+        }
+        return childPid;
+    }
+
+    // Copy the caller's environment block into `buf`; returns its size,
+    // which is more than `maxLen` if it did not fit
+    static int Sys_GetEnv(char* buf, uint64_t maxLen) {
+        auto* proc = Sched::GetCurrentProcessPtr();
+        if (proc == nullptr) return -1;
+        if (buf == nullptr) maxLen = 0;
+        uint64_t n = proc->envSize < maxLen ? proc->envSize : maxLen;
+        if (n > 0) memcpy(buf, proc->env, n);
+        return (int)proc->envSize;
+    }
+};
@@ -7,10 +7,13 @@
 #pragma once
 #include <cstdint>
 #include <Drivers/Storage/BlockDevice.hpp>
+#include <Drivers/Storage/BufferCache.hpp>
 #include <Drivers/Storage/Gpt.hpp>
+#include <Drivers/Storage/Bench.hpp>
 #include <Fs/FsProbe.hpp>
 #include <Fs/Fat32.hpp>
 #include <Fs/Ext2.hpp>
+#include <Memory/Heap.hpp>
 
 #include "Syscall.hpp"
 
@@ -34,7 +37,7 @@ namespace Montauk {
             if (!p) break;
 
             buf[i].blockDev = p->BlockDevIndex;
-            buf[i]._pad0 = 0;
+            buf[i].drive = Fs::FsProbe::DriveOf(i);
             buf[i].startLba = p->StartLba;
             buf[i].endLba = p->EndLba;
             buf[i].sectorCount = p->SectorCount;
@@ -62,7 +65,7 @@ namespace Montauk {
 
         if (lba + count > dev->SectorCount) return -1;
 
-        if (!dev->ReadSectors(dev->Ctx, lba, count, buffer)) return -1;
+        if (!Drivers::Storage::BufferCache::Read(dev, lba, count, buffer)) return -1;
 
         return (int64_t)(count * dev->SectorSize);
     }
@@ -77,11 +80,56 @@ namespace Montauk {
 
         if (lba + count > dev->SectorCount) return -1;
 
-        if (!dev->WriteSectors(dev->Ctx, lba, count, buffer)) return -1;
+        if (!Drivers::Storage::BufferCache::Write(dev, lba, count, buffer)) return -1;
+        if (!Drivers::Storage::BufferCache::Flush(dev)) return -1;
 
         return (int64_t)(count * dev->SectorSize);
     }
 
+    // Whether the device carries a GPT, so its unpartitioned space is free
+    static bool DiskHasGpt(const Drivers::Storage::BlockDevice* dev) {
+        if (dev->SectorSize < 512 || dev->SectorSize > 4096) return false;
+        auto* header = (uint8_t*)Memory::g_heap->Request(dev->SectorSize);
+        if (header == nullptr) return false;
+        bool found = Drivers::Storage::BufferCache::Read(dev, 1, 1, header) &&
+                     __builtin_memcmp(header, "EFI PART", 8) == 0;
+        Memory::g_heap->Free(header);
+        return found;
+    }
+
+    // Benchmark a block device below the buffer cache. Writes are refused
+    // unless the device has a GPT and the region lies outside every
+    // partition and clear of both GPT copies, so a benchmark never damages
+    // data. Returns 0 with `result` filled in, or -1.
+    static int64_t Sys_DiskBench(const DiskBenchParams* params, DiskBenchResult* result) {
+        if (params == nullptr || result == nullptr) return -1;
+
+        auto* dev = Drivers::Storage::GetBlockDevice(params->blockDev);
+        if (!dev) return -1;
+
+        uint64_t start = params->startLba, count = params->sectorCount;
+        if (count == 0 || start >= dev->SectorCount || count > dev->SectorCount - start) return -1;
+
+        if (params->flags & DISKBENCH_WRITE) {
+            static constexpr uint64_t GptSectors = 34;
+            if (start < GptSectors || start + count > dev->SectorCount - (GptSectors - 1)) return -1;
+            if (!DiskHasGpt(dev)) return -1;
+
+            int parts = Drivers::Storage::Gpt::GetPartitionCount();
+            for (int i = 0; i < parts; i++) {
+                auto* p = Drivers::Storage::Gpt::GetPartition(i);
+                if (!p || p->BlockDevIndex != params->blockDev) continue;
+                if (start <= p->EndLba && p->StartLba < start + count) return -1;
+            }
+        }
+
+        DiskBenchParams copy = *params;
+        DiskBenchResult out;
+        if (!Drivers::Storage::Bench::Run(dev, copy, out)) return -1;
+        *result = out;
+        return 0;
+    }
+
     // Initialize a new GPT on a block device. Returns 0 on success, -1 on error.
     static int64_t Sys_GptInit(int blockDev) {
         return (int64_t)Drivers::Storage::Gpt::InitializeGpt(blockDev);
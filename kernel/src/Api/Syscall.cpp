@@ -8,30 +8,44 @@
 #include <Terminal/Terminal.hpp>
 #include <Hal/MSR.hpp>
 #include <Hal/GDT.hpp>
+#include <Hal/Cpu.hpp>
 
 /* For common functions used by multiple syscall implementations*/
 #include "Common.hpp"
 
 /* Syscall impl. includes */
-#include "Process.hpp"    // SYS_EXIT, SYS_YIELD, SYS_SLEEP_MS, SYS_GETPID, SYS_WAITPID, SYS_SPAWN, SYS_GETARGS, SYS_PROCLIST, SYS_KILL
+#include "Process.hpp"    // SYS_EXIT, SYS_YIELD, SYS_SLEEP_MS, SYS_GETPID, SYS_WAITPID, SYS_SPAWN, SYS_GETARGS, SYS_PROCLIST, SYS_KILL, SYS_THREAD_*, SYS_GETTID, SYS_*PRIORITY, SYS_*AFFINITY
 #include "Terminal.hpp"   // SYS_PRINT, SYS_PUTCHAR
-#include "Filesystem.hpp" // SYS_OPEN, SYS_READ, SYS_GETSIZE, SYS_CLOSE, SYS_READDIR, SYS_FWRITE, SYS_FCREATE
+#include "Filesystem.hpp" // SYS_OPEN, SYS_READ, SYS_GETSIZE, SYS_CLOSE, SYS_READDIR, SYS_FWRITE, SYS_FCREATE, SYS_FCOPY, SYS_FSYNC
 #include "Heap.hpp"       // SYS_ALLOC, SYS_FREE
-#include "Time.hpp"       // SYS_GETTICKS, SYS_GETMILLISECONDS, SYS_GETTIME
+#include "Mmap.hpp"       // SYS_MMAP, SYS_SHMOPEN, SYS_SHMUNLINK
+#include "IoRing.hpp"     // SYS_IORING_SETUP, SYS_IORING_ENTER
+#include "Time.hpp"       // SYS_GETTICKS, SYS_GETMILLISECONDS, SYS_GETTIME, SYS_BOOTPROFILE, SYS_BOOTMARK
 #include "Keyboard.hpp"   // SYS_ISKEYAVAILABLE, SYS_GETKEY, SYS_GETCHAR
 #include "Info.hpp"       // SYS_GETINFO
-#include "Graphics.hpp"   // SYS_FBINFO, SYS_FBMAP, SYS_TERMSIZE, SYS_TERMSCALE
-#include "Net.hpp"        // SYS_PING, SYS_SOCKET, SYS_CONNECT, SYS_BIND, SYS_LISTEN, SYS_ACCEPT, SYS_SEND, SYS_RECV, SYS_CLOSESOCK, SYS_SENDTO, SYS_RECVFROM, SYS_GETNETCFG, SYS_SETNETCFG, SYS_RESOLVE
+#include "Graphics.hpp"   // SYS_FBINFO, SYS_FBMAP, SYS_FBMAPBUFFER, SYS_FBFLIP, SYS_TERMSIZE, SYS_TERMSCALE
+#include "Net.hpp"        // SYS_PING, SYS_SOCKET, SYS_CONNECT, SYS_BIND, SYS_LISTEN, SYS_ACCEPT, SYS_SEND, SYS_RECV, SYS_CLOSESOCK, SYS_SENDTO, SYS_RECVFROM, SYS_GETNETCFG, SYS_SETNETCFG, SYS_RESOLVE, SYS_SETSOCKOPT, SYS_SENDFILE, SYS_RESOLVE_ASYNC, SYS_SENDMMSG, SYS_RECVMMSG, SYS_GETSOCKOPT
 #include "Power.hpp"      // SYS_RESET, SYS_SHUTDOWN, SYS_SUSPEND
-#include "Mouse.hpp"      // SYS_MOUSESTATE, SYS_SETMOUSEBOUNDS
+#include "Mouse.hpp"      // SYS_MOUSESTATE, SYS_SETMOUSEBOUNDS, SYS_MOUSEEVENTS
 #include "IoRedir.hpp"    // SYS_SPAWN_REDIR, SYS_CHILDIO_READ, SYS_CHILDIO_WRITE, SYS_CHILDIO_WRITEKEY, SYS_CHILDIO_SETTERMSZ
+#include "Poll.hpp"       // SYS_EPOLL_CREATE, SYS_EPOLL_CTL, SYS_EPOLL_WAIT, SYS_EPOLL_CLOSE
+#include "Futex.hpp"      // SYS_FUTEX_WAIT, SYS_FUTEX_WAKE
 #include "Random.hpp"     // SYS_GETRANDOM
 #include "MemInfo.hpp"    // SYS_MEMSTATS
 #include "Device.hpp"     // SYS_DEVLIST, SYS_DISKINFO
-#include "Storage.hpp"    // SYS_PARTLIST, SYS_DISKREAD, SYS_DISKWRITE
-#include "Window.hpp"     // SYS_WINCREATE, SYS_WINDESTROY, SYS_WINPRESENT, SYS_WINPOLL, SYS_WINENUM, SYS_WINMAP, SYS_WINSENDEVENT, SYS_WINRESIZE, SYS_WINSETSCALE, SYS_WINGETSCALE
+#include "Storage.hpp"    // SYS_PARTLIST, SYS_DISKREAD, SYS_DISKWRITE, SYS_DISKBENCH
+#include "Window.hpp"     // SYS_WINCREATE, SYS_WINDESTROY, SYS_WINPRESENT, SYS_WINPRESENTRECTS, SYS_WINPOLL, SYS_WINENUM, SYS_WINMAP, SYS_WINSENDEVENT, SYS_WINRESIZE, SYS_WINSETSCALE, SYS_WINGETSCALE, SYS_WINEVENTRING, SYS_WINCHANGES
+#include "Gpu.hpp"        // SYS_GPUALLOC, SYS_GPUBLIT
 #include "Audio.hpp"      // SYS_AUDIOOPEN, SYS_AUDIOCLOSE, SYS_AUDIOWRITE, SYS_AUDIOCTL
 #include "BluetoothSyscall.hpp" // SYS_BTSCAN, SYS_BTCONNECT, SYS_BTDISCONNECT, SYS_BTLIST, SYS_BTINFO
+#include "Trace.hpp"      // SYS_TRACECTL, SYS_TRACEMAP
+#include "LockStat.hpp"   // SYS_LOCKSTAT
+#include "SyscallStat.hpp" // SYS_SYSCALLSTATCTL, SYS_SYSCALLSTAT
+#include "Profile.hpp"    // SYS_PROFCTL, SYS_PROFREAD
+#include "Perf.hpp"       // SYS_PERFCTL, SYS_PERFREAD
+#include "PipeIo.hpp"     // SYS_PIPE, SYS_PIPE_READ, SYS_PIPE_WRITE, SYS_PIPE_CLOSE, SYS_SPAWN_PIPED
+#include "ChannelIo.hpp"  // SYS_CHAN_LISTEN, SYS_CHAN_CONNECT, SYS_CHAN_ACCEPT, SYS_CHAN_SEND, SYS_CHAN_RECV, SYS_CHAN_CLOSE
+#include "Spawn.hpp"      // SYS_SPAWN_EX, SYS_GETENV
 
 // Assembly entry point
 extern "C" void SyscallEntry();
@@ -57,7 +71,9 @@ namespace Montauk {
 
     // ---- Dispatch ----
 
-    extern "C" int64_t SyscallDispatch(SyscallFrame* frame) {
+    static int64_t Sys_Batch(BatchCall* calls, int count, uint32_t flags);
+
+    static int64_t Dispatch(SyscallFrame* frame) {
         switch (frame->syscall_nr) {
             case SYS_EXIT: {
                 int slot = GetCurrentSlot();
@@ -99,6 +115,14 @@ namespace Montauk {
                 return (int64_t)Sys_ReadDir((const char*)frame->arg1,
                                             (const char**)frame->arg2,
                                             (int)frame->arg3);
+            case SYS_READDIRSTAT: {
+                if (!ValidUserPtr(frame->arg1) || !ValidUserPtr(frame->arg2) || !ValidUserPtr(frame->arg3)) return -1;
+                int max = (int)frame->arg4;
+                if (max < 0) return -1;
+                if (frame->arg3 + (uint64_t)max * sizeof(DirEntryInfo) > USER_SPACE_END) return -1;
+                return (int64_t)Sys_ReadDirStat((const char*)frame->arg1, (uint64_t*)frame->arg2,
+                                                (DirEntryInfo*)frame->arg3, max);
+            }
             case SYS_ALLOC:
                 return (int64_t)Sys_Alloc(frame->arg1);
             case SYS_FREE:
@@ -125,7 +149,8 @@ namespace Montauk {
             case SYS_SPAWN:
                 if (!ValidUserPtr(frame->arg1)) return -1;
                 return (int64_t)Sys_Spawn((const char*)frame->arg1,
-                                          IsUserPtr(frame->arg2) ? (const char*)frame->arg2 : nullptr);
+                                          IsUserPtr(frame->arg2) ? (const char*)frame->arg2 : nullptr,
+                                          (int)frame->arg3);
             case SYS_WAITPID:
                 Sys_WaitPid((int)frame->arg1);
                 return 0;
@@ -135,6 +160,18 @@ namespace Montauk {
                 return 0;
             case SYS_FBMAP:
                 return (int64_t)Sys_FbMap();
+            case SYS_FBMAPBUFFER:
+                return (int64_t)Sys_FbMapBuffer((int)frame->arg1);
+            case SYS_FBFLIP:
+                return Sys_FbFlip((int)frame->arg1);
+            case SYS_GPUALLOC:
+                return (int64_t)Sys_GpuAlloc(frame->arg1);
+            case SYS_GPUBLIT:
+                if (!ValidUserPtr(frame->arg1)) return -1;
+                return Sys_GpuBlit((const GpuBlit*)frame->arg1, (int)frame->arg2);
+            case SYS_CURSORSET:
+                if (!IsUserPtr(frame->arg1)) return -1;
+                return Sys_CursorSet((const CursorImage*)frame->arg1);
             case SYS_TERMSIZE:
                 return (int64_t)Sys_TermSize();
             case SYS_GETARGS:
@@ -191,6 +228,11 @@ namespace Montauk {
                 if (!ValidUserPtr(frame->arg2)) return -1;
                 return (int64_t)Sys_FWrite((int)frame->arg1, (const uint8_t*)frame->arg2,
                                            frame->arg3, frame->arg4);
+            case SYS_FCOPY:
+                return Sys_FCopy((int)frame->arg1, (int)frame->arg2, frame->arg3,
+                                 frame->arg4, frame->arg5);
+            case SYS_FSYNC:
+                return Sys_FSync((int)frame->arg1);
             case SYS_FCREATE:
                 if (!ValidUserPtr(frame->arg1)) return -1;
                 return (int64_t)Sys_FCreate((const char*)frame->arg1);
@@ -212,12 +254,24 @@ namespace Montauk {
             case SYS_RESOLVE:
                 if (!ValidUserPtr(frame->arg1)) return -1;
                 return Sys_Resolve((const char*)frame->arg1);
+            case SYS_RESOLVE_ASYNC:
+                if (!ValidUserPtr(frame->arg1)) return -1;
+                return Sys_ResolveAsync((const char*)frame->arg1);
+            case SYS_SENDMMSG:
+                if (!ValidUserPtr(frame->arg2)) return -1;
+                return (int64_t)Sys_SendMmsg((int)frame->arg1, (UdpMsg*)frame->arg2, (int)frame->arg3);
+            case SYS_RECVMMSG:
+                if (!ValidUserPtr(frame->arg2)) return -1;
+                return (int64_t)Sys_RecvMmsg((int)frame->arg1, (UdpMsg*)frame->arg2, (int)frame->arg3);
             case SYS_GETRANDOM:
                 if (!ValidUserPtr(frame->arg1)) return -1;
                 return Sys_GetRandom((uint8_t*)frame->arg1, frame->arg2);
             case SYS_KLOG:
                 if (!ValidUserPtr(frame->arg1)) return -1;
-                return Kt::ReadKernelLog((char*)frame->arg1, frame->arg2);
+                if (frame->arg3 != 0 && !ValidUserPtr(frame->arg3)) return -1;
+                static_assert(KLOG_MAX_CPUS == Kt::LogCpus);
+                return Kt::ReadKernelLog((char*)frame->arg1, frame->arg2,
+                                         frame->arg3 ? ((KlogCursor*)frame->arg3)->next : nullptr);
             case SYS_MOUSESTATE:
                 if (!ValidUserPtr(frame->arg1)) return -1;
                 Sys_MouseState((MouseState*)frame->arg1);
@@ -225,10 +279,14 @@ namespace Montauk {
             case SYS_SETMOUSEBOUNDS:
                 Sys_SetMouseBounds((int32_t)frame->arg1, (int32_t)frame->arg2);
                 return 0;
+            case SYS_MOUSEEVENTS:
+                if (!ValidUserPtr(frame->arg1)) return -1;
+                return Sys_MouseEvents((MouseEvent*)frame->arg1, (int)frame->arg2);
             case SYS_SPAWN_REDIR:
                 if (!ValidUserPtr(frame->arg1)) return -1;
                 return (int64_t)Sys_SpawnRedir((const char*)frame->arg1,
-                                               IsUserPtr(frame->arg2) ? (const char*)frame->arg2 : nullptr);
+                                               IsUserPtr(frame->arg2) ? (const char*)frame->arg2 : nullptr,
+                                               (uint32_t)frame->arg3);
             case SYS_CHILDIO_READ:
                 if (!ValidUserPtr(frame->arg2)) return -1;
                 return (int64_t)Sys_ChildIoRead((int)frame->arg1, (char*)frame->arg2, (int)frame->arg3);
@@ -248,6 +306,10 @@ namespace Montauk {
                 return (int64_t)Sys_WinDestroy((int)frame->arg1);
             case SYS_WINPRESENT:
                 return (int64_t)Sys_WinPresent((int)frame->arg1);
+            case SYS_WINPRESENTRECTS:
+                if (!ValidUserPtr(frame->arg2)) return -1;
+                return (int64_t)Sys_WinPresentRects((int)frame->arg1, (const WinRect*)frame->arg2,
+                                                    (int)frame->arg3);
             case SYS_WINPOLL:
                 if (!ValidUserPtr(frame->arg2)) return -1;
                 return (int64_t)Sys_WinPoll((int)frame->arg1, (WinEvent*)frame->arg2);
@@ -268,8 +330,8 @@ namespace Montauk {
                 // Free heap allocations for the target process before killing it
                 auto* target = Sched::GetProcessByPid((int)frame->arg1);
                 if (target) {
-                    auto* slot0 = Sched::GetProcessSlot(0);
-                    int targetSlot = (int)(target - slot0);
+                    int targetSlot = target->leaderSlot;
+                    target = Sched::GetProcessSlot(targetSlot);
                     CleanupHeapForSlot(targetSlot, target->pml4Phys);
                 }
                 return (int64_t)Sys_Kill((int)frame->arg1);
@@ -284,6 +346,52 @@ namespace Montauk {
                 return (int64_t)Sys_WinSetScale((int)frame->arg1);
             case SYS_WINGETSCALE:
                 return (int64_t)Sys_WinGetScale();
+            case SYS_WINEVENTRING:
+                return (int64_t)Sys_WinEventRing((int)frame->arg1);
+            case SYS_WINCHANGES:
+                if (!ValidUserPtr(frame->arg1)) return -1;
+                return (int64_t)Sys_WinChanges((WinInfo*)frame->arg1, (int)frame->arg2);
+            case SYS_PIPE:
+                if (!ValidUserPtr(frame->arg1)) return -1;
+                return (int64_t)Sys_Pipe((int32_t*)frame->arg1, (uint32_t)frame->arg2);
+            case SYS_PIPE_READ:
+                if (!ValidUserPtr(frame->arg2)) return -1;
+                return (int64_t)Sys_PipeRead((int)frame->arg1, (void*)frame->arg2, (int)frame->arg3);
+            case SYS_PIPE_WRITE:
+                if (!ValidUserPtr(frame->arg2)) return -1;
+                return (int64_t)Sys_PipeWrite((int)frame->arg1, (const void*)frame->arg2, (int)frame->arg3);
+            case SYS_PIPE_CLOSE:
+                return (int64_t)Sys_PipeClose((int)frame->arg1);
+            case SYS_SPAWN_PIPED:
+                if (!ValidUserPtr(frame->arg1)) return -1;
+                return (int64_t)Sys_SpawnPiped((const char*)frame->arg1,
+                                               IsUserPtr(frame->arg2) ? (const char*)frame->arg2 : nullptr,
+                                               (int)frame->arg3, (int)frame->arg4);
+            case SYS_CHAN_LISTEN:
+                if (!ValidUserPtr(frame->arg1)) return -1;
+                return (int64_t)Sys_ChanListen((const char*)frame->arg1);
+            case SYS_CHAN_CONNECT:
+                if (!ValidUserPtr(frame->arg1)) return -1;
+                return (int64_t)Sys_ChanConnect((const char*)frame->arg1);
+            case SYS_CHAN_ACCEPT:
+                return (int64_t)Sys_ChanAccept((int)frame->arg1, (uint32_t)frame->arg2);
+            case SYS_CHAN_SEND:
+                if (!ValidUserPtr(frame->arg2)) return -1;
+                return (int64_t)Sys_ChanSend((int)frame->arg1, (const ChanMsg*)frame->arg2, (uint32_t)frame->arg3);
+            case SYS_CHAN_RECV:
+                if (!ValidUserPtr(frame->arg2)) return -1;
+                return (int64_t)Sys_ChanRecv((int)frame->arg1, (ChanMsg*)frame->arg2, (uint32_t)frame->arg3);
+            case SYS_CHAN_CLOSE:
+                return (int64_t)Sys_ChanClose((int)frame->arg1);
+            case SYS_BATCH:
+                if (!ValidUserPtr(frame->arg1)) return -1;
+                return Sys_Batch((BatchCall*)frame->arg1, (int)frame->arg2, (uint32_t)frame->arg3);
+            case SYS_SPAWN_EX:
+                if (!ValidUserPtr(frame->arg1)) return -1;
+                return (int64_t)Sys_SpawnEx((SpawnAttr*)frame->arg1);
+            case SYS_GETENV:
+                if (!IsUserPtr(frame->arg1)) return -1;
+                return (int64_t)Sys_GetEnv((char*)frame->arg1, frame->arg2);
             case SYS_WINSETCURSOR:
                 return (int64_t)Sys_WinSetCursor((int)frame->arg1, (int)frame->arg2);
             case SYS_MEMSTATS:
@@ -341,6 +449,47 @@ namespace Montauk {
                 return Sys_SetTZ((int32_t)frame->arg1);
             case SYS_GETTZ:
                 return Sys_GetTZ();
+            case SYS_BOOTPROFILE:
+                if (!ValidUserPtr(frame->arg1)) return -1;
+                return Sys_BootProfile((BootEvent*)frame->arg1, (int)frame->arg2);
+            case SYS_BOOTMARK:
+                if (!ValidUserPtr(frame->arg1)) return -1;
+                return Sys_BootMark((const char*)frame->arg1);
+            case SYS_TRACECTL:
+                return Sys_TraceCtl((uint32_t)frame->arg1);
+            case SYS_TRACEMAP:
+                return (int64_t)Sys_TraceMap();
+            case SYS_LOCKSTAT:
+                if (!ValidUserPtr(frame->arg1)) return -1;
+                return Sys_LockStat((LockStatInfo*)frame->arg1, (int)frame->arg2, (int)frame->arg3);
+            case SYS_SYSCALLSTATCTL:
+                return Sys_SyscallStatCtl((uint32_t)frame->arg1);
+            case SYS_SYSCALLSTAT: {
+                if (!ValidUserPtr(frame->arg2)) return -1;
+                int max = (int)frame->arg3;
+                if (max > SYSSTAT_MAX_SYSCALLS) max = SYSSTAT_MAX_SYSCALLS;
+                if (max > 0 && frame->arg2 + (uint64_t)max * sizeof(SyscallStatInfo) > USER_SPACE_END) return -1;
+                return Sys_SyscallStat((int)frame->arg1, (SyscallStatInfo*)frame->arg2, max);
+            }
+            case SYS_PROFCTL:
+                return Sys_ProfCtl((int)frame->arg1, (int)frame->arg2);
+            case SYS_PROFREAD: {
+                if (!ValidUserPtr(frame->arg1)) return -1;
+                int max = (int)frame->arg2;
+                if (max > 0 && frame->arg1 + (uint64_t)max * sizeof(ProfSample) > USER_SPACE_END) return -1;
+                return Sys_ProfRead((ProfSample*)frame->arg1, max);
+            }
+            case SYS_DISKBENCH:
+                if (!ValidUserPtr(frame->arg1) || !ValidUserPtr(frame->arg2)) return -1;
+                if (frame->arg1 + sizeof(DiskBenchParams) > USER_SPACE_END ||
+                    frame->arg2 + sizeof(DiskBenchResult) > USER_SPACE_END) return -1;
+                return Sys_DiskBench((const DiskBenchParams*)frame->arg1, (DiskBenchResult*)frame->arg2);
+            case SYS_PERFCTL:
+                return Sys_PerfCtl((uint32_t)frame->arg1, (uint32_t)frame->arg2);
+            case SYS_PERFREAD:
+                if (!ValidUserPtr(frame->arg1) ||
+                    frame->arg1 + sizeof(PerfCounts) > USER_SPACE_END) return -1;
+                return Sys_PerfRead((PerfCounts*)frame->arg1);
             case SYS_SETUSER:
                 if (!ValidUserPtr(frame->arg2)) return -1;
                 return Sys_SetUser((int)frame->arg1, (const char*)frame->arg2);
@@ -353,11 +502,128 @@ namespace Montauk {
             case SYS_CHDIR:
                 if (!ValidUserPtr(frame->arg1)) return -1;
                 return Sys_Chdir((const char*)frame->arg1);
+            case SYS_THREAD_CREATE:
+                if (!ValidUserPtr(frame->arg1)) return -1;
+                return (int64_t)Sys_ThreadCreate(frame->arg1, frame->arg2);
+            case SYS_THREAD_JOIN:
+                if (!IsUserPtr(frame->arg2)) return -1;
+                return (int64_t)Sys_ThreadJoin((int)frame->arg1, (int*)frame->arg2);
+            case SYS_THREAD_EXIT:
+                Sys_ThreadExit((int)frame->arg1);
+                return 0;
+            case SYS_GETTID:
+                return (int64_t)Sys_GetTid();
+            case SYS_FUTEX_WAIT:
+                if (!ValidUserPtr(frame->arg1)) return -1;
+                return (int64_t)Sys_FutexWait(frame->arg1, (uint32_t)frame->arg2, frame->arg3);
+            case SYS_FUTEX_WAKE:
+                if (!ValidUserPtr(frame->arg1)) return -1;
+                return (int64_t)Sys_FutexWake(frame->arg1, (int)frame->arg2);
+            case SYS_SETPRIORITY:
+                return (int64_t)Sys_SetPriority((int)frame->arg1, (int)frame->arg2);
+            case SYS_GETPRIORITY:
+                return (int64_t)Sys_GetPriority((int)frame->arg1);
+            case SYS_SETAFFINITY:
+                return (int64_t)Sys_SetAffinity((int)frame->arg1, frame->arg2);
+            case SYS_GETAFFINITY:
+                return (int64_t)Sys_GetAffinity((int)frame->arg1);
+            case SYS_MMAP:
+                if (!ValidUserPtr(frame->arg1)) return 0;
+                return (int64_t)Sys_MMap((const char*)frame->arg1, frame->arg2, frame->arg3);
+            case SYS_SHMOPEN:
+                if (!IsUserPtr(frame->arg1)) return 0;
+                return (int64_t)Sys_ShmOpen((const char*)frame->arg1, frame->arg2);
+            case SYS_SHMUNLINK:
+                if (!ValidUserPtr(frame->arg1)) return -1;
+                return (int64_t)Sys_ShmUnlink((const char*)frame->arg1);
+            case SYS_IORING_SETUP:
+                return (int64_t)Sys_IoRingSetup((uint32_t)frame->arg1);
+            case SYS_IORING_ENTER:
+                return Sys_IoRingEnter(frame->arg1, (uint32_t)frame->arg2, frame->arg3);
+            case SYS_SETSOCKOPT:
+                return (int64_t)Sys_SetSockOpt((int)frame->arg1, (int)frame->arg2, frame->arg3);
+            case SYS_GETSOCKOPT:
+                if (!ValidUserPtr(frame->arg3)) return -1;
+                return (int64_t)Sys_GetSockOpt((int)frame->arg1, (int)frame->arg2, (uint64_t*)frame->arg3);
+            case SYS_EPOLL_CREATE:
+                return (int64_t)Sys_EpollCreate();
+            case SYS_EPOLL_CTL:
+                if (!ValidUserPtr(frame->arg3)) return -1;
+                return (int64_t)Sys_EpollCtl((int)frame->arg1, (int)frame->arg2, (const PollEvent*)frame->arg3);
+            case SYS_EPOLL_WAIT: {
+                if (!ValidUserPtr(frame->arg2)) return -1;
+                int max = (int)frame->arg3;
+                if (max <= 0 || max > EPOLL_MAX_WATCHES) return -1;
+                if (frame->arg2 + (uint64_t)max * sizeof(PollEvent) > USER_SPACE_END) return -1;
+                return (int64_t)Sys_EpollWait((int)frame->arg1, (PollEvent*)frame->arg2, max,
+                                              (int64_t)frame->arg4);
+            }
+            case SYS_EPOLL_CLOSE:
+                return (int64_t)Sys_EpollClose((int)frame->arg1);
+            case SYS_SENDFILE:
+                return (int64_t)Sys_SendFile((int)frame->arg1, (int)frame->arg2,
+                                             frame->arg3, (uint32_t)frame->arg4);
             default:
                 return -1;
         }
     }
 
+    // Each call of a batch goes through Dispatch with a frame of its own,
+    // and is counted and traced like a syscall of its own
+    static int64_t Sys_Batch(BatchCall* calls, int count, uint32_t flags) {
+        if (count < 0 || count > BATCH_MAX) return -1;
+        if ((uint64_t)(calls + count) > USER_SPACE_END) return -1;
+
+        int done = 0;
+        while (done < count) {
+            BatchCall& call = calls[done];
+            SyscallFrame frame = {};
+            frame.syscall_nr = call.nr;
+            frame.arg1 = call.args[0];
+            frame.arg2 = call.args[1];
+            frame.arg3 = call.args[2];
+            frame.arg4 = call.args[3];
+            frame.arg5 = call.args[4];
+            frame.arg6 = call.args[5];
+
+            int64_t ret = -1;
+            if (frame.syscall_nr != SYS_BATCH) {
+                Trace::Emit(TRACE_SYSCALL, TRACE_EV_SYSCALL_ENTER, (uint32_t)frame.syscall_nr, frame.arg1);
+                uint64_t statStart = SyscallStats::On() ? Hal::ReadTsc() : 0;
+                ret = Dispatch(&frame);
+                if (statStart != 0) SyscallStats::Record(frame.syscall_nr, Hal::ReadTsc() - statStart);
+                Trace::Emit(TRACE_SYSCALL, TRACE_EV_SYSCALL_EXIT, (uint32_t)frame.syscall_nr, (uint64_t)ret);
+            }
+            call.result = ret;
+            done++;
+            if (ret < 0 && (flags & BATCH_STOP_ON_ERROR)) break;
+        }
+        return done;
+    }
+
+    // Time between the two hooks is charged as the caller's kernel time
+    extern "C" int64_t SyscallDispatch(SyscallFrame* frame) {
+        Sched::EnterSyscall();
+        Trace::Emit(TRACE_SYSCALL, TRACE_EV_SYSCALL_ENTER, (uint32_t)frame->syscall_nr, frame->arg1);
+        uint64_t statStart = SyscallStats::On() ? Hal::ReadTsc() : 0;
+        int64_t ret = Dispatch(frame);
+        if (statStart != 0) SyscallStats::Record(frame->syscall_nr, Hal::ReadTsc() - statStart);
+        Trace::Emit(TRACE_SYSCALL, TRACE_EV_SYSCALL_EXIT, (uint32_t)frame->syscall_nr, (uint64_t)ret);
+        Sched::LeaveSyscall();
+        return ret;
+    }
+
+    bool HandleUserPageFault(uint64_t addr) {
+        if (!IsUserPtr(addr)) return false;
+        return HandleHeapFault(addr);
+    }
+
+    bool HandleUserWriteFault(uint64_t addr) {
+        auto* proc = Sched::GetCurrentProcessPtr();
+        if (proc == nullptr || addr == 0 || !IsUserPtr(addr)) return false;
+        return Memory::VMM::Paging::BreakCopyOnWrite(proc->pml4Phys, addr);
+    }
+
     // ---- SYSCALL MSR initialization ----
 
     void InitializeSyscalls() {
@@ -163,6 +163,39 @@ namespace Montauk {
     static constexpr int AUDIO_CTL_GET_OUTPUT  = 4;   // 0=HDA, 1=Bluetooth
     static constexpr int AUDIO_CTL_SET_OUTPUT  = 5;   // Switch audio output
     static constexpr int AUDIO_CTL_BT_STATUS   = 6;   // Get Bluetooth connection status
+    static constexpr int AUDIO_CTL_SET_PERIOD_BYTES = 7;  // Bytes per period, empties the ring
+    static constexpr int AUDIO_CTL_SET_PERIODS      = 8;  // Periods in the ring, empties the ring
+    static constexpr int AUDIO_CTL_MAP_RING         = 9;  // Map the AudioRingHeader, returns its address or 0
+    static constexpr int AUDIO_CTL_WAIT_PERIOD      = 10; // value = periodsDone last seen, returns the new count
+
+    // Handle 0 is the output device: volume, output and Bluetooth status
+    // apply to everything. Handles from SYS_AUDIOOPEN are streams that the
+    // kernel mixes together; on them volume and pause are per stream.
+
+    // Ring of a stream (AUDIO_CTL_MAP_RING). The mapping starts with this
+    // header, the ring of periodBytes * periodCount bytes follows at
+    // ringOffset. Both byte counters run freely; byte n lives at ring
+    // position n % ringBytes. The application writes PCM at appBytes and
+    // then advances it, at most ringBytes ahead of hwBytes. The mixer
+    // advances hwBytes as it consumes the ring, never past appBytes, and
+    // bumps periodsDone for each period consumed. Running out of data
+    // after playing some counts an underrun. Changing the period layout
+    // resets the counters.
+    static constexpr uint32_t AUDIO_PERIOD_MIN_BYTES = 256;      // multiple of 128
+    static constexpr uint32_t AUDIO_PERIODS_MIN      = 2;
+    static constexpr uint32_t AUDIO_PERIODS_MAX      = 32;
+    static constexpr uint32_t AUDIO_RING_MAX_BYTES   = 0x10000;
+
+    struct AudioRingHeader {
+        volatile uint64_t hwBytes;
+        volatile uint64_t appBytes;
+        uint32_t periodBytes;
+        uint32_t periodCount;
+        uint32_t ringBytes;
+        uint32_t ringOffset;      // from the start of the mapping
+        volatile uint32_t periodsDone;
+        volatile uint32_t underruns;
+    };
 
     /* Bluetooth.hpp */
     static constexpr uint64_t SYS_BTSCAN       = 84;
@@ -187,9 +220,315 @@ namespace Montauk {
     static constexpr uint64_t SYS_GETCWD        = 95;
     static constexpr uint64_t SYS_CHDIR         = 96;
 
+    /* Process.hpp */
+    static constexpr uint64_t SYS_THREAD_CREATE = 97;
+    static constexpr uint64_t SYS_THREAD_JOIN   = 98;
+    static constexpr uint64_t SYS_THREAD_EXIT   = 99;
+    static constexpr uint64_t SYS_GETTID        = 100;
+
+    /* Futex.hpp */
+    static constexpr uint64_t SYS_FUTEX_WAIT    = 101;
+    static constexpr uint64_t SYS_FUTEX_WAKE    = 102;
+
+    /* Process.hpp */
+    static constexpr uint64_t SYS_SETPRIORITY   = 103;
+    static constexpr uint64_t SYS_GETPRIORITY   = 104;
+    static constexpr uint64_t SYS_SETAFFINITY   = 105;
+    static constexpr uint64_t SYS_GETAFFINITY   = 106;
+
+    /* Mmap.hpp */
+    static constexpr uint64_t SYS_MMAP          = 107;
+    static constexpr uint64_t SYS_SHMOPEN       = 108;
+    static constexpr uint64_t SYS_SHMUNLINK     = 109;
+
+    /* Filesystem.hpp */
+    static constexpr uint64_t SYS_READDIRSTAT   = 110;
+
+    /* IoRing.hpp */
+    static constexpr uint64_t SYS_IORING_SETUP  = 111;
+    static constexpr uint64_t SYS_IORING_ENTER  = 112;
+
+    /* Net.hpp */
+    static constexpr uint64_t SYS_SETSOCKOPT    = 113;
+
+    /* Poll.hpp */
+    static constexpr uint64_t SYS_EPOLL_CREATE  = 114;
+    static constexpr uint64_t SYS_EPOLL_CTL     = 115;
+    static constexpr uint64_t SYS_EPOLL_WAIT    = 116;
+    static constexpr uint64_t SYS_EPOLL_CLOSE   = 117;
+
+    /* Net.hpp */
+    static constexpr uint64_t SYS_SENDFILE      = 118;
+
+    /* Window.hpp */
+    static constexpr uint64_t SYS_WINPRESENTRECTS = 119;
+
+    /* Graphics.hpp */
+    static constexpr uint64_t SYS_FBMAPBUFFER    = 120;
+    static constexpr uint64_t SYS_FBFLIP         = 121;
+    static constexpr uint64_t SYS_CURSORSET      = 122;
+
+    /* Net.hpp */
+    static constexpr uint64_t SYS_RESOLVE_ASYNC  = 123;
+    static constexpr uint64_t SYS_SENDMMSG       = 124;
+    static constexpr uint64_t SYS_RECVMMSG       = 125;
+    static constexpr uint64_t SYS_GETSOCKOPT     = 126;
+
+    /* Time.hpp */
+    static constexpr uint64_t SYS_BOOTPROFILE    = 127;
+    static constexpr uint64_t SYS_BOOTMARK       = 128;
+    static constexpr uint64_t SYS_TRACECTL       = 129;
+    static constexpr uint64_t SYS_TRACEMAP       = 130;
+
+    /* LockStat.hpp */
+    static constexpr uint64_t SYS_LOCKSTAT       = 131;
+
+    /* SyscallStat.hpp */
+    static constexpr uint64_t SYS_SYSCALLSTATCTL = 132;
+    static constexpr uint64_t SYS_SYSCALLSTAT    = 133;
+
+    /* Profile.hpp */
+    static constexpr uint64_t SYS_PROFCTL        = 134;
+    static constexpr uint64_t SYS_PROFREAD       = 135;
+
+    /* Perf.hpp */
+    static constexpr uint64_t SYS_PERFCTL        = 136;
+    static constexpr uint64_t SYS_PERFREAD       = 137;
+
+    /* Storage.hpp */
+    static constexpr uint64_t SYS_DISKBENCH      = 138;
+
+    /* Window.hpp */
+    static constexpr uint64_t SYS_WINEVENTRING   = 139;
+    static constexpr uint64_t SYS_WINCHANGES     = 140;
+
+    /* PipeIo.hpp */
+    static constexpr uint64_t SYS_PIPE           = 141;
+    static constexpr uint64_t SYS_PIPE_READ      = 142;
+    static constexpr uint64_t SYS_PIPE_WRITE     = 143;
+    static constexpr uint64_t SYS_PIPE_CLOSE     = 144;
+    static constexpr uint64_t SYS_SPAWN_PIPED    = 145;
+
+    /* ChannelIo.hpp */
+    static constexpr uint64_t SYS_CHAN_LISTEN    = 146;
+    static constexpr uint64_t SYS_CHAN_CONNECT   = 147;
+    static constexpr uint64_t SYS_CHAN_ACCEPT    = 148;
+    static constexpr uint64_t SYS_CHAN_SEND      = 149;
+    static constexpr uint64_t SYS_CHAN_RECV      = 150;
+    static constexpr uint64_t SYS_CHAN_CLOSE     = 151;
+
+    /* Syscall.cpp */
+    static constexpr uint64_t SYS_BATCH          = 152;
+
+    /* Spawn.hpp */
+    static constexpr uint64_t SYS_SPAWN_EX       = 153;
+    static constexpr uint64_t SYS_GETENV         = 154;
+
+    /* Filesystem.hpp */
+    static constexpr uint64_t SYS_FCOPY          = 155;
+
+    /* Mouse.hpp */
+    static constexpr uint64_t SYS_MOUSEEVENTS    = 156;
+
+    /* Filesystem.hpp */
+    static constexpr uint64_t SYS_FSYNC          = 157;
+
+    /* Gpu.hpp */
+    static constexpr uint64_t SYS_GPUALLOC       = 158;
+    static constexpr uint64_t SYS_GPUBLIT        = 159;
+
+    // Scheduling classes (SYS_SETPRIORITY, SYS_SPAWN arg3). A lower value
+    // always runs first. PRIO_INHERIT keeps a batch parent's class and is
+    // PRIO_NORMAL otherwise.
+    static constexpr int PRIO_REALTIME    = 0;
+    static constexpr int PRIO_INTERACTIVE = 1;
+    static constexpr int PRIO_NORMAL      = 2;
+    static constexpr int PRIO_BATCH       = 3;
+    static constexpr int PRIO_COUNT       = 4;
+    static constexpr int PRIO_INHERIT     = -1;
+
+    // Anonymous pipes (SYS_PIPE). Handles are positive. SYS_PIPE_READ and
+    // SYS_PIPE_WRITE also take PIPE_STDIN and PIPE_STDOUT for the pipes a
+    // process was spawned with, and fail if it has none. SYS_SPAWN_PIPED
+    // takes for each of the child's stdin and stdout a handle the caller
+    // holds, PIPE_INHERIT for the caller's own, or PIPE_NONE. A process
+    // whose stdout is a pipe prints into it; one whose stdin is a pipe
+    // reads it with SYS_GETCHAR, which returns -1 at its end.
+    static constexpr uint32_t PIPE_DEFAULT_CAPACITY = 64 * 1024;  // SYS_PIPE capacity 0
+    static constexpr uint32_t PIPE_MAX_CAPACITY     = 1024 * 1024;
+    static constexpr int PIPE_NONE    = 0;
+    static constexpr int PIPE_INHERIT = -1;
+    static constexpr int PIPE_STDIN   = -2;
+    static constexpr int PIPE_STDOUT  = -3;
+
+    // Message channels (SYS_CHAN_*). A server listens on a name; each
+    // SYS_CHAN_CONNECT to it makes a channel, whose client end the
+    // connecting process gets and whose server end SYS_CHAN_ACCEPT hands
+    // out. Both ends send and receive ChanMsg, queued CHAN_QUEUE_DEPTH
+    // deep on the receiving side. A message may carry a shared memory
+    // mapping of the sender's (from SYS_SHMOPEN or SYS_MMAP): shmAddr
+    // names its start on send, and on receipt the kernel has mapped the
+    // same pages into the receiver at shmAddr, shmSize bytes long. Bulk
+    // data thus goes through the kernel by reference only. Send, receive
+    // and accept block unless given CHAN_NOWAIT, and then return 0 when
+    // they would have; receive returns -1 once the queue is empty and the
+    // peer has closed. Handles are positive.
+    static constexpr int CHAN_NAME_MAX    = 32;   // Including the terminator
+    static constexpr int CHAN_QUEUE_DEPTH = 16;
+    static constexpr int CHAN_MSG_DATA    = 96;
+    static constexpr uint32_t CHAN_NOWAIT = 0x01;
+
+    struct ChanMsg {
+        uint32_t type;            // Free for the protocol
+        uint32_t length;          // Bytes of data in use, at most CHAN_MSG_DATA
+        uint64_t shmAddr;         // Mapping handed over, 0 = none
+        uint64_t shmSize;         // Send: bytes of it to hand over, 0 = all; receive: bytes mapped
+        int32_t  senderPid;       // Set by the kernel
+        uint32_t _pad;
+        uint8_t  data[CHAN_MSG_DATA];
+    };
+
+    // Batched syscalls (SYS_BATCH): the calls are made in order in one
+    // kernel entry, each as if issued on its own, and each result stored
+    // with its call. SYS_BATCH returns how many calls were made; with
+    // BATCH_STOP_ON_ERROR it stops after the first negative result. A
+    // batch cannot contain SYS_BATCH.
+    static constexpr int BATCH_MAX = 64;
+    static constexpr uint32_t BATCH_STOP_ON_ERROR = 0x01;
+
+    struct BatchCall {
+        uint64_t nr;              // SYS_*
+        uint64_t args[6];
+        int64_t  result;          // Set by the kernel
+    };
+
+    // Spawning with the child's setup given up front (SYS_SPAWN_EX): it is
+    // built in one call, with arguments, environment, working directory,
+    // standard streams, priority and affinity in place before it first
+    // runs. argv is joined with spaces into the string SYS_GETARGS returns,
+    // which must fit in SPAWN_ARGS_MAX bytes. The environment is a block
+    // of "NAME=value" strings, each with its terminator, that the child
+    // reads with SYS_GETENV; a null envp passes on the caller's own block.
+    // The child's stdin and stdout are the caller's unless the actions,
+    // applied in order, say otherwise.
+    static constexpr int SPAWN_ARGS_MAX    = 256;   // Including the terminator
+    static constexpr int SPAWN_ENV_MAX     = 4096;  // Bytes of the environment block
+    static constexpr int SPAWN_ACTIONS_MAX = 8;
+
+    static constexpr uint32_t SPAWN_STDIN  = 0;
+    static constexpr uint32_t SPAWN_STDOUT = 1;
+
+    static constexpr uint32_t SPAWN_ACT_DUP   = 0;  // Pipe end `handle`, or PIPE_STDIN / PIPE_STDOUT
+    static constexpr uint32_t SPAWN_ACT_CLOSE = 1;  // Not connected (PIPE_NONE)
+    static constexpr uint32_t SPAWN_ACT_PIPE  = 2;  // A new pipe, `handle` set to the caller's end
+
+    struct SpawnAction {
+        uint32_t action;          // SPAWN_ACT_*
+        uint32_t stream;          // SPAWN_STDIN or SPAWN_STDOUT
+        int32_t  handle;          // DUP: the pipe end; PIPE: set by the kernel
+        uint32_t capacity;        // PIPE: buffer size, 0 = PIPE_DEFAULT_CAPACITY
+    };
+
+    struct SpawnAttr {
+        const char* path;
+        const char* const* argv;  // Arguments after the program name, null-terminated; null = none
+        const char* const* envp;  // "NAME=value" strings, null-terminated; null = the caller's
+        const char* cwd;          // Working directory; null = the caller's
+        SpawnAction* actions;
+        uint32_t actionCount;     // At most SPAWN_ACTIONS_MAX
+        int32_t  priority;        // PRIO_*, or PRIO_INHERIT
+        uint64_t affinity;        // CPU mask as for SYS_SETAFFINITY, 0 = any CPU
+    };
+
+    // User stacks. Each thread's stack lies in a window of its own below
+    // the main one, one of USER_THREAD_SLOTS per process, so a thread can
+    // tell which it is from its stack pointer alone (montauk/heap.h does).
+    static constexpr uint64_t USER_STACK_TOP           = 0x7FFFFFF000ULL;
+    static constexpr uint64_t USER_THREAD_STACK_TOP    = USER_STACK_TOP - 0x100000ULL;
+    static constexpr uint64_t USER_THREAD_STACK_STRIDE = 0x20000ULL;
+    static constexpr int      USER_THREAD_SLOTS        = 1024;
+
+    // Clock page, mapped read-only at USER_TIME_PAGE in every process so
+    // montauk::get_milliseconds() and friends need no syscall. With
+    // TIME_PAGE_TSC set, the clock in microseconds is
+    // usOffset + (rdtsc - tscBase) / tscPerUs; otherwise it is the 1 ms
+    // tick count in `ms`. The kernel makes `seq` odd while it rewrites
+    // the page, so readers retry until they see the same even value
+    // before and after reading.
+    static constexpr uint64_t USER_TIME_PAGE = 0x3FE000ULL;
+    static constexpr uint32_t TIME_PAGE_TSC  = 1 << 0;
+
+    struct TimePage {
+        volatile uint32_t seq;
+        volatile uint32_t flags;      // TIME_PAGE_*
+        volatile uint64_t tscPerUs;
+        volatile uint64_t tscBase;
+        volatile uint64_t usOffset;
+        volatile uint64_t ms;         // Tick count, without TIME_PAGE_TSC
+    };
+
     static constexpr int SOCK_TCP = 1;
     static constexpr int SOCK_UDP = 2;
 
+    // Options for SYS_SETSOCKOPT (TCP sockets). Window scaling,
+    // timestamps and SACK apply to connections set up after the call.
+    static constexpr int SOCKOPT_RCVBUF     = 1;   // Receive buffer limit, bytes (4 KiB - 4 MiB)
+    static constexpr int SOCKOPT_WSCALE     = 2;   // RFC 7323 window scaling, 0 or 1
+    static constexpr int SOCKOPT_TIMESTAMPS = 3;   // RFC 7323 timestamps, 0 or 1
+    static constexpr int SOCKOPT_SACK       = 4;   // RFC 2018 selective ACKs, 0 or 1
+
+    // UDP sockets take SOCKOPT_RCVBUF (receive ring, 4 KiB - 1 MiB, rounded
+    // up to a power of two) and these; SYS_GETSOCKOPT reads any option
+    static constexpr int SOCKOPT_RCVQLEN    = 5;   // Most queued datagrams (1 - 4096, default 256)
+    static constexpr int SOCKOPT_DROPS      = 6;   // Datagrams dropped on a full queue (read only)
+
+    // TCP options that take effect at once, on a connected socket too
+    static constexpr int SOCKOPT_NODELAY    = 7;   // Send small segments without waiting (no Nagle), 0 or 1
+    static constexpr int SOCKOPT_QUICKACK   = 8;   // ACK every segment at once (no delayed ACKs), 0 or 1
+
+    // Most datagrams moved by one SYS_SENDMMSG or SYS_RECVMMSG
+    static constexpr int UDP_MAX_BATCH = 64;
+    static constexpr uint16_t UDPMSG_TRUNC = 0x01;   // payload cut to fit len
+
+    // Readiness multiplexing (SYS_EPOLL_*). A poll set watches up to
+    // EPOLL_MAX_WATCHES sources; SYS_EPOLL_WAIT sleeps until one of them
+    // is ready. Level-triggered watches are reported for as long as the
+    // source is ready; with POLL_ET a watch is reported once per new
+    // arrival (data, connection, key, event, output). POLL_ERR and
+    // POLL_HUP are always reported.
+    static constexpr uint8_t POLL_SRC_SOCKET   = 0;   // id = socket fd
+    static constexpr uint8_t POLL_SRC_KEYBOARD = 1;   // id unused; keys for SYS_GETKEY
+    static constexpr uint8_t POLL_SRC_WINDOW   = 2;   // id = window id; events for SYS_WINPOLL
+    static constexpr uint8_t POLL_SRC_CHILDIO  = 3;   // id = pid from SYS_SPAWN_REDIR
+    static constexpr uint8_t POLL_SRC_MOUSE    = 4;   // id unused; moved since the last SYS_MOUSESTATE or SYS_MOUSEEVENTS
+    static constexpr uint8_t POLL_SRC_WINSERVER = 5;  // id unused; windows changed since SYS_WINCHANGES last took all
+    static constexpr uint8_t POLL_SRC_VBLANK   = 6;   // id unused; a vertical blank since the last SYS_FBFLIP
+    static constexpr uint8_t POLL_SRC_PIPE     = 7;   // id = pipe end handle, PIPE_STDIN or PIPE_STDOUT
+    static constexpr uint8_t POLL_SRC_CHANNEL  = 8;   // id = channel end or listener handle
+    static constexpr uint8_t POLL_SRC_MEMORY   = 9;   // id unused; in while the pressure level is above NONE, a new arrival per level change
+
+    static constexpr uint32_t POLL_IN  = 0x01;        // Something to read or accept
+    static constexpr uint32_t POLL_OUT = 0x04;        // Room to send / write
+    static constexpr uint32_t POLL_ERR = 0x08;        // Source no longer valid
+    static constexpr uint32_t POLL_HUP = 0x10;        // Peer closed / child exited
+    static constexpr uint32_t POLL_ET  = 0x80000000;  // Edge-triggered watch
+
+    static constexpr int EPOLL_CTL_ADD = 1;
+    static constexpr int EPOLL_CTL_DEL = 2;
+    static constexpr int EPOLL_CTL_MOD = 3;
+    static constexpr int EPOLL_MAX_WATCHES = 64;
+
+    // A watch (SYS_EPOLL_CTL), or a ready source (SYS_EPOLL_WAIT, with
+    // `events` holding the POLL_* bits that are ready)
+    struct PollEvent {
+        uint8_t  source;          // POLL_SRC_*
+        uint8_t  _pad[3];
+        int32_t  id;
+        uint32_t events;          // POLL_* bits
+        uint32_t _pad2;
+        uint64_t userData;        // returned as given
+    };
+
     struct DateTime {
         uint16_t Year;
         uint8_t Month;
@@ -199,12 +538,184 @@ namespace Montauk {
         uint8_t Second;
     };
 
+    // Position in the kernel log (SYS_KLOG arg3): how many records of each
+    // CPU's ring the reader has seen. Zeroed, it starts at the oldest kept.
+    static constexpr int KLOG_MAX_CPUS = 64;
+
+    struct KlogCursor {
+        uint64_t next[KLOG_MAX_CPUS];
+    };
+
+    // One boot phase (SYS_BOOTPROFILE). Times count from TSC reset, so the
+    // first kernel event also shows how long firmware and loader took.
+    static constexpr int BOOT_MAX_EVENTS = 96;
+
+    struct BootEvent {
+        char     name[32];
+        uint64_t startUs;
+        uint64_t endUs;       // == startUs for a point marker, 0 while running
+        uint32_t cpu;
+        uint32_t _pad;
+    };
+
+    // Kernel tracing (SYS_TRACECTL, SYS_TRACEMAP). Each category of
+    // tracepoints is one bit of the enable mask.
+    static constexpr uint32_t TRACE_SCHED   = 1u << 0;   // Switch, wakeup, block
+    static constexpr uint32_t TRACE_SYSCALL = 1u << 1;   // Entry, exit
+    static constexpr uint32_t TRACE_FAULT   = 1u << 2;   // Page faults
+    static constexpr uint32_t TRACE_BLOCK   = 1u << 3;   // Block I/O submit, complete
+    static constexpr uint32_t TRACE_IRQ     = 1u << 4;   // Device interrupts
+    static constexpr uint32_t TRACE_NET     = 1u << 5;   // Frames received, sent
+    static constexpr uint32_t TRACE_ALL     = 0x3F;
+
+    // TraceRecord::type, and what arg0 / arg1 / arg2 hold. Pids are -1
+    // for the idle loop.
+    static constexpr uint16_t TRACE_EV_SWITCH         = 1;   // prev pid, next pid, 1 if prev blocked
+    static constexpr uint16_t TRACE_EV_WAKEUP         = 2;   // pid, cpu it is queued on
+    static constexpr uint16_t TRACE_EV_BLOCK          = 3;   // pid
+    static constexpr uint16_t TRACE_EV_SYSCALL_ENTER  = 4;   // number, first argument
+    static constexpr uint16_t TRACE_EV_SYSCALL_EXIT   = 5;   // number, return value
+    static constexpr uint16_t TRACE_EV_PAGE_FAULT     = 6;   // error code, address, 1 if resolved
+    static constexpr uint16_t TRACE_EV_BLOCK_SUBMIT   = 7;   // device, lba, sectors | write << 31
+    static constexpr uint16_t TRACE_EV_BLOCK_COMPLETE = 8;   // device | failed << 31, lba, sectors | write << 31
+    static constexpr uint16_t TRACE_EV_IRQ            = 9;   // irq
+    static constexpr uint16_t TRACE_EV_NET_RX         = 10;  // ethertype, frame bytes
+    static constexpr uint16_t TRACE_EV_NET_TX         = 11;  // ethertype, frame bytes
+
+    struct TraceRecord {
+        uint64_t tsc;
+        uint16_t type;
+        uint16_t cpu;
+        uint32_t arg0;
+        uint64_t arg1;
+        uint64_t arg2;
+    };
+
+    // First page of the buffer SYS_TRACEMAP maps. One ring of
+    // recordsPerCpu records per CPU follows; record n of a CPU is at
+    // n % recordsPerCpu in its ring, so the last recordsPerCpu written
+    // are kept. Read the rings after stopping the trace.
+    static constexpr uint32_t TRACE_MAGIC    = 0x43525454;    // "TTRC"
+    static constexpr int      TRACE_MAX_CPUS = 64;
+
+    struct TraceHeader {
+        uint32_t magic;
+        uint32_t cpus;                    // Rings in the buffer
+        uint32_t recordsPerCpu;           // Power of two
+        uint32_t mask;                    // Categories being recorded
+        uint64_t tscPerUs;                // For turning tsc into time
+        uint64_t ringOffset;              // Byte offset of CPU 0's ring
+        uint64_t ringStride;              // Bytes from one ring to the next
+        uint64_t head[TRACE_MAX_CPUS];    // Records written per CPU since the start
+    };
+
+    // Hardware performance counter events (SYS_PERFCTL). The bit number
+    // is the index into PerfCounts::self and ::children.
+    static constexpr uint32_t PERF_CYCLES        = 1 << 0;   // Core cycles, unhalted
+    static constexpr uint32_t PERF_INSTRUCTIONS  = 1 << 1;   // Instructions retired
+    static constexpr uint32_t PERF_LLC_MISSES    = 1 << 2;   // Last level cache misses
+    static constexpr uint32_t PERF_BRANCH_MISSES = 1 << 3;   // Mispredicted branches retired
+    static constexpr uint32_t PERF_DTLB_MISSES   = 1 << 4;   // Data TLB misses that walked the page tables
+    static constexpr uint32_t PERF_ALL           = 0x1F;
+    static constexpr int      PERF_MAX_EVENTS    = 5;
+
+    // SYS_PERFCTL flags
+    static constexpr uint32_t PERF_INHERIT   = 1 << 0;   // Threads and processes started later count too
+    static constexpr uint32_t PERF_USER_ONLY = 1 << 1;   // Leave out time spent in the kernel
+
+    struct PerfCounts {
+        uint32_t events;                        // PERF_* the calling thread counts
+        uint32_t reserved;
+        uint64_t self[PERF_MAX_EVENTS];         // Calling thread since SYS_PERFCTL
+        uint64_t children[PERF_MAX_EVENTS];     // Exited processes that inherited the counters
+    };
+
+    // Sampling profiler (SYS_PROFCTL, SYS_PROFREAD). While on, each CPU
+    // takes PROF_HZ samples a second of whatever process it is running.
+    static constexpr int      PROF_HZ        = 1000;
+    static constexpr int      PROF_MAX_DEPTH = 16;
+    static constexpr uint16_t PROF_KERNEL    = 1 << 0;    // Interrupted in the kernel; ip[0] is kernel code
+
+    struct ProfSample {
+        int32_t  pid;                     // Process (thread group leader)
+        int32_t  tid;                     // Thread that was running
+        uint16_t cpu;
+        uint16_t flags;                   // PROF_*
+        uint16_t depth;                   // Entries of ip[] in use
+        uint16_t reserved;
+        uint64_t tsc;
+        uint64_t ip[PROF_MAX_DEPTH];      // Interrupted RIP, then return addresses from the frame pointer chain
+    };
+
+    // Syscall statistics (SYS_SYSCALLSTATCTL). Off by default; while on,
+    // every syscall is timed from entry to exit.
+    static constexpr uint32_t SYSSTAT_ON      = 1 << 0;   // Count and time every syscall
+    static constexpr uint32_t SYSSTAT_PROCESS = 1 << 1;   // Also keep totals per process
+    static constexpr uint32_t SYSSTAT_RESET   = 1 << 2;   // Zero all counters first
+
+    static constexpr int SYSSTAT_MAX_SYSCALLS = 160;      // Higher numbers are not counted
+    static constexpr int SYSSTAT_BUCKETS      = 32;
+
+    // One syscall's counters (SYS_SYSCALLSTAT), summed over all CPUs, or
+    // over one process's threads. A process only gets count and totalNs.
+    struct SyscallStatInfo {
+        uint32_t nr;
+        uint32_t reserved;
+        uint64_t count;
+        uint64_t totalNs;
+        uint64_t maxNs;
+        uint64_t buckets[SYSSTAT_BUCKETS];    // [i]: calls taking 2^i to 2^(i+1) ns; the last is open ended
+    };
+
+    // Contention counters of one named kernel lock (SYS_LOCKSTAT). Several
+    // locks can share a name, e.g. one run queue lock per CPU.
+    struct LockStatInfo {
+        char name[32];
+        uint64_t acquisitions;
+        uint64_t contended;       // Acquisitions that found the lock taken
+        uint64_t spinNs;          // Total time spent waiting
+        uint64_t maxSpinNs;
+        uint64_t maxHoldNs;
+    };
+
     struct FbInfo {
         uint64_t width;
         uint64_t height;
         uint64_t pitch;      // bytes per scanline
         uint64_t bpp;        // bits per pixel (32)
         uint64_t userAddr;   // filled by SYS_FBMAP (0 until mapped)
+        uint64_t buffers;    // scanout buffers SYS_FBFLIP switches between (1 = no flipping)
+    };
+
+    // Pointer image for the hardware cursor plane (SYS_CURSORSET).
+    // Pixels are ARGB, `width` per row; (hotX, hotY) is the pixel
+    // that sits on the mouse position.
+    static constexpr int CURSOR_MAX_SIZE = 64;
+
+    struct CursorImage {
+        int32_t  width;
+        int32_t  height;
+        int32_t  hotX;
+        int32_t  hotY;
+        uint32_t pixels[CURSOR_MAX_SIZE * CURSOR_MAX_SIZE];
+    };
+
+    // One blit for SYS_GPUBLIT: a `width` x `height` rectangle of 32-bit
+    // pixels at `dst`, filled with `color` or copied from `src` (which must
+    // not overlap it). Pitches are in bytes, at most 32767. Both must lie
+    // in memory the GPU reaches: SYS_GPUALLOC memory, a mapped scanout
+    // buffer, or a window the caller mapped with SYS_WINMAP.
+    static constexpr int GPU_BLIT_MAX = 32;
+
+    struct GpuBlit {
+        uint64_t dst;
+        uint64_t src;
+        uint32_t dstPitch;
+        uint32_t srcPitch;
+        uint32_t width;
+        uint32_t height;
+        uint32_t color;
+        uint32_t fill;       // 1 = fill with color, 0 = copy from src
     };
 
     struct SysInfo {
@@ -212,6 +723,8 @@ namespace Montauk {
         char osVersion[32];
         uint32_t    apiVersion;
         uint32_t    maxProcesses;
+        uint64_t    tscPerUs;      // rdtsc ticks per microsecond, for timing in userspace
+        uint32_t    cpuCount;      // CPUs online
     };
 
     struct NetCfg {
@@ -221,6 +734,17 @@ namespace Montauk {
         uint8_t  macAddress[6];
         uint8_t  _pad[2];
         uint32_t dnsServer;   // network byte order
+        uint32_t dnsServer2;  // network byte order, 0 = none
+    };
+
+    // One datagram for SYS_SENDMMSG / SYS_RECVMMSG
+    struct UdpMsg {
+        uint64_t addr;        // payload buffer
+        uint32_t len;         // send: payload bytes; receive: buffer size in, bytes received out
+        uint32_t ip;          // destination or source, network byte order
+        uint16_t port;        // destination or source
+        uint16_t flags;       // UDPMSG_* (receive)
+        uint32_t _pad;
     };
 
     struct KeyEvent {
@@ -239,6 +763,21 @@ namespace Montauk {
         uint8_t  buttons;
     };
 
+    // One input event (SYS_MOUSEEVENTS). Motion between reads is folded
+    // into one event; each button change starts a new one.
+    struct MouseEvent {
+        int32_t  x;           // position after the event
+        int32_t  y;
+        int32_t  dx;          // motion folded into the event, unclamped
+        int32_t  dy;
+        int32_t  scroll;
+        uint8_t  buttons;     // button state after the event
+        uint8_t  _pad[3];
+        uint64_t timeUs;      // when its last report arrived
+    };
+
+    static constexpr int MOUSE_EVENTS_MAX = 64;   // events the kernel holds
+
     // Window server shared types
     struct WinEvent {
         uint8_t type;     // 0=key, 1=mouse, 2=resize, 3=close, 4=scale
@@ -251,6 +790,47 @@ namespace Montauk {
         };
     };
 
+    // Event queue of a window, shared with its owner (SYS_WINEVENTRING).
+    // The kernel appends at `head`; the owner takes events at `tail` and
+    // needs no syscall while there are any. Both count up forever; event
+    // n lives in slots[n % WIN_EVENT_RING_SIZE]. A consumer claims the
+    // slot at `tail` by moving its state from WIN_SLOT_READY to
+    // WIN_SLOT_TAKEN (retrying while it is WIN_SLOT_WRITING), copies the
+    // event, and then advances `tail`. The kernel merges a mouse move into
+    // the newest event when that is an unclaimed move too, so a fast mouse
+    // does not fill the queue. SYS_WINPOLL takes events the same way.
+    static constexpr uint32_t WIN_EVENT_RING_SIZE = 512;   // Power of two
+    static constexpr uint32_t WIN_SLOT_READY   = 0;
+    static constexpr uint32_t WIN_SLOT_WRITING = 1;
+    static constexpr uint32_t WIN_SLOT_TAKEN   = 2;
+
+    // 32 bytes, so that no slot straddles a page
+    struct WinEventSlot {
+        volatile uint32_t state;   // WIN_SLOT_*
+        WinEvent event;
+        uint32_t _pad[2];
+    };
+
+    struct WinEventRing {
+        volatile uint32_t head;     // Written by the kernel only
+        volatile uint32_t tail;     // Written by whoever takes events
+        volatile uint32_t dropped;  // Events lost to a full queue
+        uint32_t _pad[13];
+        WinEventSlot slots[WIN_EVENT_RING_SIZE];
+    };
+
+    // A rectangle of a window, in window pixels (SYS_WINPRESENTRECTS)
+    struct WinRect {
+        int32_t  x, y, w, h;
+    };
+
+    // Windows the server holds at once. An ID modulo this is the window's
+    // slot, which a later window may take over under a new ID.
+    static constexpr int WinMaxWindows = 64;
+
+    // Damage rectangles reported per window by SYS_WINCHANGES
+    static constexpr int WinMaxDamage = 4;
+
     struct WinInfo {
         int32_t  id;
         int32_t  ownerPid;
@@ -258,7 +838,10 @@ namespace Montauk {
         int32_t  width, height;
         uint8_t  dirty;
         uint8_t  cursor;    // 0=arrow, 1=resize_h, 2=resize_v
-        uint8_t  _pad[2];
+        uint8_t  damageCount;  // Rects in damage; 0 with dirty set = the whole window
+        uint8_t  closed;    // SYS_WINCHANGES: the window is gone, only id is set
+        WinRect  damage[WinMaxDamage];  // Presented since the last SYS_WINCHANGES
+        uint32_t presents;  // Frames presented since the window was created
     };
 
     struct WinCreateResult {
@@ -272,8 +855,23 @@ namespace Montauk {
         uint64_t freeBytes;
         uint64_t usedBytes;
         uint64_t pageSize;
+        uint64_t heapReservedBytes;  // User heap address space handed out by SYS_ALLOC
+        uint64_t heapResidentBytes;  // Part of it backed by memory (touched at least once)
+        uint32_t pressure;           // MEM_PRESSURE_*
+        uint32_t pressureEvents;     // Changes with every change of `pressure`
+        uint64_t swappedBytes;       // Heap pages compressed out of memory (zram)
+        uint64_t compressedBytes;    // Memory holding them
     };
 
+    // Memory pressure levels, from the share of physical memory free.
+    // Programs with caches they can rebuild (decoded images, rendered
+    // pages, glyphs) should stop growing them at LOW and give back what
+    // they can at MEDIUM; at CRITICAL allocations are about to fail.
+    static constexpr uint32_t MEM_PRESSURE_NONE     = 0;
+    static constexpr uint32_t MEM_PRESSURE_LOW      = 1;
+    static constexpr uint32_t MEM_PRESSURE_MEDIUM   = 2;
+    static constexpr uint32_t MEM_PRESSURE_CRITICAL = 3;
+
     struct DevInfo {
         uint8_t  category;     // 0=CPU, 1=Interrupt, 2=Timer, 3=Input, 4=USB, 5=Network, 6=Display, 7=Storage, 8=PCI
         uint8_t  _pad[3];
@@ -313,7 +911,7 @@ namespace Montauk {
 
     struct PartInfo {
         int32_t  blockDev;        // block device index
-        uint32_t _pad0;
+        int32_t  drive;           // VFS drive it is mounted as, -1 if none
         uint64_t startLba;
         uint64_t endLba;
         uint64_t sectorCount;
@@ -343,13 +941,115 @@ namespace Montauk {
         char     label[32];       // volume label
     };
 
+    // Raw block device benchmark (SYS_DISKBENCH). Requests go through the
+    // device's request queue but not the buffer cache.
+    static constexpr uint32_t DISKBENCH_WRITE     = 1 << 0;  // Only outside every partition
+    static constexpr uint32_t DISKBENCH_RANDOM    = 1 << 1;  // Block-aligned random offsets, else sequential
+    static constexpr uint32_t DISKBENCH_MAX_DEPTH = 32;
+    static constexpr uint32_t DISKBENCH_MAX_MS    = 10000;
+
+    struct DiskBenchParams {
+        int32_t  blockDev;
+        uint32_t flags;           // DISKBENCH_*
+        uint32_t blockBytes;      // Per request; capped at the device's transfer limit
+        uint32_t depth;           // Requests kept in flight
+        uint32_t durationMs;
+        uint32_t _pad;
+        uint64_t startLba;        // Region to exercise
+        uint64_t sectorCount;
+    };
+
+    struct DiskBenchResult {
+        uint32_t blockBytes;      // As actually used
+        uint32_t depth;
+        uint64_t ops;             // Requests completed without error
+        uint64_t bytes;
+        uint64_t elapsedUs;
+        uint64_t errors;
+        uint64_t avgNs;           // Submit to completion, queueing included
+        uint64_t minNs;
+        uint64_t p50Ns;
+        uint64_t p90Ns;
+        uint64_t p99Ns;
+        uint64_t p999Ns;
+        uint64_t maxNs;
+    };
+
+    // Directory entry types (DirEntryInfo::type)
+    static constexpr uint8_t DT_UNKNOWN = 0;
+    static constexpr uint8_t DT_FILE    = 1;
+    static constexpr uint8_t DT_DIR     = 2;
+
+    // One directory entry with its metadata (returned by SYS_READDIRSTAT)
+    struct DirEntryInfo {
+        char     name[256];       // bare name, no trailing '/'
+        uint64_t size;            // bytes, 0 for directories
+        int64_t  mtime;           // Unix seconds, 0 if unknown
+        uint8_t  type;            // DT_*
+        uint8_t  _pad[7];
+    };
+
+    // Asynchronous file I/O ring (SYS_IORING_SETUP). The mapping starts
+    // with an IoRingHeader, followed by `entries` IoSqe slots at sqOffset
+    // and as many IoCqe slots at cqOffset. Userspace fills SQEs and bumps
+    // sqTail, then calls SYS_IORING_ENTER; it consumes CQEs and bumps
+    // cqHead. The kernel advances sqHead and cqTail. Indices run freely
+    // and are masked with entries - 1. cqTail doubles as a futex word that
+    // is woken on every completion.
+    static constexpr uint8_t IORING_OP_NOP   = 0;
+    static constexpr uint8_t IORING_OP_READ  = 1;   // handle, addr, len, offset -> bytes
+    static constexpr uint8_t IORING_OP_WRITE = 2;   // handle, addr, len, offset -> bytes
+    static constexpr uint8_t IORING_OP_OPEN  = 3;   // addr = path -> handle
+    static constexpr uint8_t IORING_OP_CLOSE = 4;   // handle -> 0
+    static constexpr uint32_t IORING_MAX_ENTRIES = 256;
+
+    struct IoRingHeader {
+        volatile uint32_t sqHead;
+        volatile uint32_t sqTail;
+        volatile uint32_t cqHead;
+        volatile uint32_t cqTail;
+        uint32_t entries;         // power of two
+        uint32_t sqOffset;        // byte offsets from the start of the ring
+        uint32_t cqOffset;
+        uint32_t _pad;
+    };
+
+    struct IoSqe {
+        uint8_t  op;              // IORING_OP_*
+        uint8_t  _pad[3];
+        int32_t  handle;
+        uint64_t offset;
+        uint64_t addr;            // buffer, or path for OPEN
+        uint64_t len;
+        uint64_t userData;        // copied to the completion
+        uint64_t _reserved[3];
+    };
+
+    struct IoCqe {
+        uint64_t userData;
+        int64_t  result;          // as the synchronous syscall; -1 on error
+    };
+
     struct ProcInfo {
         int32_t  pid;
         int32_t  parentPid;
         uint8_t  state;        // 0=Free, 1=Ready, 2=Running, 3=Blocked, 4=Terminated
-        uint8_t  _pad[3];
+        uint8_t  priority;     // PRIO_* scheduling class
+        uint8_t  _pad[2];
         char     name[64];
         uint64_t heapUsed;     // heapNext - UserHeapBase (bytes)
+        uint64_t userTimeUs;   // CPU time in user mode, all threads
+        uint64_t kernelTimeUs; // CPU time in syscalls, all threads
+        uint64_t residentPages;      // Heap pages backed by memory (heapUsed / 4096)
+        uint64_t reservedPages;      // Heap pages reserved with SYS_ALLOC
+        uint32_t vmaCount;           // Heap regions (SYS_ALLOC, SYS_MMAP)
+        uint32_t windowPages;        // Window buffers, all swap buffers
+        uint32_t sockets;            // Open sockets
+        uint32_t openFiles;          // VFS handles open, pipe ends and channel handles held
+        uint64_t voluntarySwitches;  // Gave up the CPU by blocking, all threads
+        uint64_t involuntarySwitches; // Preempted or yielded, all threads
+        int32_t  cpu;                // CPU running one of its threads, -1 if none
+        uint32_t threads;            // Live threads, the leader included
     };
 
     // Bluetooth scan result (returned by SYS_BTSCAN)
@@ -397,4 +1097,14 @@ namespace Montauk {
     // Kernel-only: set up SYSCALL MSRs and initialize dispatch
     void InitializeSyscalls();
 
+    // Kernel-only: called by the #PF handler for a not-present fault at
+    // user address `addr` in the current process. Returns true if the page
+    // was demand-allocated and the access can be retried.
+    bool HandleUserPageFault(uint64_t addr);
+
+    // Kernel-only: called by the #PF handler for a write to a present,
+    // read-only user page. Returns true if it was copy-on-write and the
+    // process now has its own writable copy.
+    bool HandleUserWriteFault(uint64_t addr);
+
 }
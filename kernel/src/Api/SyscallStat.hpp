@@ -0,0 +1,27 @@
+/*
+    * SyscallStat.hpp
+    * SYS_SYSCALLSTATCTL, SYS_SYSCALLSTAT syscalls
+    * Copyright (c) 2026 Daniel Hammer
+*/
+
+#pragma once
+#include <cstdint>
+#include <Common/SyscallStats.hpp>
+
+#include "Syscall.hpp"
+
+namespace Montauk {
+
+    // Apply SYSSTAT_* flags; 0 stops counting. Returns 0, or -1 if the
+    // counters cannot be allocated.
+    static int64_t Sys_SyscallStatCtl(uint32_t flags) {
+        return SyscallStats::SetFlags(flags) ? 0 : -1;
+    }
+
+    // Copy up to `max` per-syscall entries, system wide for pid -1 or for
+    // one process. Returns the number written.
+    static int64_t Sys_SyscallStat(int pid, SyscallStatInfo* buf, int max) {
+        if (max <= 0) return 0;
+        return SyscallStats::Read(pid, buf, max);
+    }
+};
@@ -7,19 +7,27 @@
 #pragma once
 #include <Sched/Scheduler.hpp>
 #include <Terminal/Terminal.hpp>
+#include <Libraries/String.hpp>
 
 #include "Common.hpp"
+#include "Pipe.hpp"
 
 namespace Montauk {
 
     static void Sys_Print(const char* text) {
         auto* proc = Sched::GetCurrentProcessPtr();
+        // Output nobody reads any more is dropped
+        if (proc && proc->stdoutPipe > 0) {
+            Pipe::Write(proc->stdoutPipe, proc->pid, text, Lib::strlen(text));
+            return;
+        }
         if (proc && proc->redirected) {
             auto* target = GetRedirTarget(proc);
             if (target && target->outBuf) {
                 for (int i = 0; text[i]; i++) {
-                    RingWrite(target->outBuf, target->outHead, target->outTail, Sched::Process::IoBufSize, (uint8_t)text[i]);
+                    RingWrite(target->outBuf, target->outHead, target->outTail, target->outBufSize, (uint8_t)text[i]);
                 }
+                Sched::NotifyReady(&target->outHead);
                 return;
             }
         }
@@ -30,10 +38,15 @@ namespace Montauk {
 
     static void Sys_Putchar(char c) {
         auto* proc = Sched::GetCurrentProcessPtr();
+        if (proc && proc->stdoutPipe > 0) {
+            Pipe::Write(proc->stdoutPipe, proc->pid, &c, 1);
+            return;
+        }
         if (proc && proc->redirected) {
             auto* target = GetRedirTarget(proc);
             if (target && target->outBuf) {
-                RingWrite(target->outBuf, target->outHead, target->outTail, Sched::Process::IoBufSize, (uint8_t)c);
+                RingWrite(target->outBuf, target->outHead, target->outTail, target->outBufSize, (uint8_t)c);
+                Sched::NotifyReady(&target->outHead);
                 return;
             }
         }
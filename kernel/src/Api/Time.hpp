@@ -7,6 +7,7 @@
 #pragma once
 #include <Timekeeping/ApicTimer.hpp>
 #include <Timekeeping/Time.hpp>
+#include <Timekeeping/BootProfile.hpp>
 
 #include "Syscall.hpp"
 
@@ -38,4 +39,31 @@ namespace Montauk {
     static int64_t Sys_GetTZ() {
         return (int64_t)Timekeeping::GetTZOffset();
     }
+
+    static int64_t Sys_BootProfile(BootEvent* out, int max) {
+        int count = Timekeeping::BootProfile::Count();
+        if (max < count) count = max;
+
+        for (int i = 0; i < count; i++) {
+            Timekeeping::BootProfile::Event ev;
+            if (!Timekeeping::BootProfile::Get(i, ev)) return i;
+
+            for (int c = 0; c < (int)sizeof(out[i].name); c++) out[i].name[c] = ev.Name[c];
+            out[i].startUs = Timekeeping::TscToMicroseconds(ev.StartTsc);
+            out[i].endUs = ev.EndTsc ? Timekeeping::TscToMicroseconds(ev.EndTsc) : 0;
+            out[i].cpu = ev.Cpu;
+            out[i]._pad = 0;
+        }
+        return count;
+    }
+
+    // Userspace milestones, e.g. the desktop's first frame
+    static int64_t Sys_BootMark(const char* name) {
+        char copy[Timekeeping::BootProfile::MaxNameLen + 1];
+        int i = 0;
+        for (; i < Timekeeping::BootProfile::MaxNameLen && name[i]; i++) copy[i] = name[i];
+        copy[i] = '\0';
+        Timekeeping::BootProfile::Mark(copy);
+        return 0;
+    }
 };
\ No newline at end of file
@@ -0,0 +1,32 @@
+/*
+    * Trace.hpp
+    * SYS_TRACECTL, SYS_TRACEMAP syscalls
+    * Copyright (c) 2026 Daniel Hammer
+*/
+
+#pragma once
+#include <cstdint>
+#include <Common/Trace.hpp>
+#include <Memory/MemObject.hpp>
+
+#include "Syscall.hpp"
+
+namespace Montauk {
+
+    // Record the TRACE_* categories in `mask`; 0 stops. Returns 0, or -1
+    // if the trace buffer cannot be allocated.
+    static int64_t Sys_TraceCtl(uint32_t mask) {
+        return Trace::SetMask(mask) ? 0 : -1;
+    }
+
+    // Map the trace buffer (TraceHeader, then the per-CPU rings) into the
+    // caller. Returns its address, or 0. SYS_FREE unmaps it.
+    static uint64_t Sys_TraceMap() {
+        Memory::MemObject* object = Trace::GetBuffer();
+        if (object == nullptr) return 0;
+
+        // The mapping takes a reference of its own
+        object->Retain();
+        return MapObject(object, 0, object->Pages());
+    }
+};
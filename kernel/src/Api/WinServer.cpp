@@ -6,30 +6,41 @@
 
 #include "WinServer.hpp"
 #include <Memory/PageFrameAllocator.hpp>
+#include <Memory/Heap.hpp>
 #include <Memory/Paging.hpp>
+#include <Memory/Tlb.hpp>
 #include <Memory/HHDM.hpp>
 #include <Libraries/Memory.hpp>
 #include <Terminal/Terminal.hpp>
 #include <CppLib/Spinlock.hpp>
 #include <Sched/Scheduler.hpp>
-#include <Timekeeping/ApicTimer.hpp>
+#include <Sched/SleepLock.hpp>
+#include <Drivers/Graphics/IntelGPU.hpp>
 
 namespace WinServer {
 
-    static WindowSlot g_slots[MaxWindows];
+    // Windows by slot index, allocated when created. A window's ID is
+    // its index plus MaxWindows times the slot's generation, which moves
+    // on with every window created in the slot, so a stale ID never
+    // reaches the window that took the slot over.
+    static WindowSlot* g_slots[MaxWindows];
+    static uint32_t g_generations[MaxWindows];
+    static int g_freeIndices[MaxWindows];  // Stack of unused indices
+    static int g_freeCount = 0;
+    static bool g_freeReady = false;
+    static constexpr uint32_t IdGenerations = 0x7FFFFFFF / MaxWindows;
+    static_assert(MaxWindows <= 64, "g_changed has a bit per slot");
     static int g_uiScale = 1;
-    static kcp::Mutex wsLock;
-    static constexpr uint64_t RetireGraceMs = 2000;
-    static constexpr int MaxRetiredBatches = MaxWindows * 4;
-
-    struct RetiredBatch {
-        bool used;
-        int numPages;
-        uint64_t freeAfterMs;
-        uint64_t physPages[MaxPixelPages];
-    };
+    static kcp::LockStat wsLockStat{"winserver"};
+    static Sched::SleepLock wsLock{&wsLockStat};
+    static uint64_t g_deadPagePhys = 0;
 
-    static RetiredBatch g_retired[MaxRetiredBatches];
+    // Changes for the compositor, and their count when it last took all
+    // of them. g_changed has the bit of every slot whose window changed
+    // (or went away) since the compositor last heard of it.
+    static uint32_t g_activity = 0;
+    static uint32_t g_activitySeen = 0;
+    static uint64_t g_changed = 0;
 
     // RAII lock guard for WinServer operations
     struct WsGuard {
@@ -37,6 +48,53 @@ namespace WinServer {
         ~WsGuard() { wsLock.Release(); }
     };
 
+    // Something the compositor shows of `slot` changed; wake it if it waits
+    static void NoteActivityLocked(const WindowSlot& slot) {
+        g_changed |= 1ULL << slot.index;
+        g_activity++;
+        Sched::NotifyReady(Montauk::POLL_SRC_WINSERVER);
+    }
+
+    static int MakeId(int index) {
+        return (int)(g_generations[index] % IdGenerations) * MaxWindows + index;
+    }
+
+    // The window `windowId`, or nullptr if it is gone
+    static WindowSlot* LookupLocked(int windowId) {
+        if (windowId < 0) return nullptr;
+        WindowSlot* slot = g_slots[windowId % MaxWindows];
+        return slot != nullptr && slot->id == windowId ? slot : nullptr;
+    }
+
+    // A new, zeroed window in an unused slot; nullptr if all are taken
+    static WindowSlot* AllocateSlotLocked() {
+        if (!g_freeReady) {
+            for (int i = MaxWindows - 1; i >= 0; i--) g_freeIndices[g_freeCount++] = i;
+            g_freeReady = true;
+        }
+        if (g_freeCount == 0) return nullptr;
+
+        auto* slot = (WindowSlot*)Memory::g_heap->Request(sizeof(WindowSlot));
+        if (slot == nullptr) return nullptr;
+        memset(slot, 0, sizeof(WindowSlot));
+
+        int index = g_freeIndices[--g_freeCount];
+        g_generations[index]++;
+        slot->index = index;
+        slot->id = MakeId(index);
+        g_slots[index] = slot;
+        return slot;
+    }
+
+    // Give back the slot of a window whose memory is already released.
+    // The compositor learns it is gone with its next Changes.
+    static void FreeSlotLocked(WindowSlot* slot) {
+        NoteActivityLocked(*slot);
+        g_slots[slot->index] = nullptr;
+        g_freeIndices[g_freeCount++] = slot->index;
+        Memory::g_heap->Free(slot);
+    }
+
     static void FreePageBatchLocked(uint64_t* physPages, int numPages) {
         for (int i = 0; i < numPages; i++) {
             if (physPages[i] != 0) {
@@ -46,85 +104,252 @@ namespace WinServer {
         }
     }
 
-    static void ProcessRetiredLocked() {
-        uint64_t now = Timekeeping::GetMilliseconds();
-        for (int i = 0; i < MaxRetiredBatches; i++) {
-            if (!g_retired[i].used) continue;
-            if (now < g_retired[i].freeAfterMs) continue;
-            FreePageBatchLocked(g_retired[i].physPages, g_retired[i].numPages);
-            g_retired[i].used = false;
-            g_retired[i].numPages = 0;
-            g_retired[i].freeAfterMs = 0;
+    // A zeroed page that stands in for the snapshot pages of a window the
+    // desktop still has mapped after they are gone. Mapped WC so that
+    // FreeUserHalf() skips it; never freed.
+    static uint64_t DeadPageLocked() {
+        if (g_deadPagePhys == 0) {
+            void* page = Memory::g_pfa->AllocateZeroed();
+            if (page != nullptr) g_deadPagePhys = Memory::SubHHDM((uint64_t)page);
         }
+        return g_deadPagePhys;
     }
 
-    static void RetirePageBatchLocked(uint64_t* physPages, int numPages) {
-        if (numPages <= 0) return;
+    // Remove a window's pages from the owner's address space. Returns
+    // once no CPU can reach them, so they can be freed right away.
+    static void UnmapOwnerLocked(uint64_t ownerPml4, uint64_t ownerVa, int numPages) {
+        Memory::VMM::Tlb::Batch batch(ownerPml4);
+        for (int i = 0; i < numPages; i++) {
+            Memory::VMM::Paging::UnmapUserIn(ownerPml4, ownerVa + (uint64_t)i * 0x1000, batch);
+        }
+    }
 
-        int retireIdx = -1;
-        for (int i = 0; i < MaxRetiredBatches; i++) {
-            if (!g_retired[i].used) {
-                retireIdx = i;
-                break;
+    // Detach the desktop's view of the snapshot pages. The compositor may
+    // still draw the old frame until its next Changes, so the range is
+    // pointed at the dead page rather than unmapped (a fault there would
+    // kill the desktop). Returns once no CPU can reach the old pages.
+    static void DetachDesktopLocked(WindowSlot& slot) {
+        if (slot.desktopVa != 0) {
+            auto* desktop = Sched::GetProcessByPid(slot.desktopPid);
+            if (desktop) {
+                uint64_t deadPage = DeadPageLocked();
+                Memory::VMM::Tlb::Batch batch(desktop->pml4Phys);
+                for (int p = 0; p < slot.pixelNumPages; p++) {
+                    uint64_t va = slot.desktopVa + (uint64_t)p * 0x1000;
+                    if (deadPage != 0 && Memory::VMM::Paging::MapUserInWC(desktop->pml4Phys, deadPage, va)) {
+                        batch.Add(va);
+                    } else {
+                        Memory::VMM::Paging::UnmapUserIn(desktop->pml4Phys, va, batch);
+                    }
+                }
             }
         }
+        slot.desktopVa = 0;
+        slot.desktopPid = 0;
+    }
 
-        if (retireIdx < 0) {
-            ProcessRetiredLocked();
-            for (int i = 0; i < MaxRetiredBatches; i++) {
-                if (!g_retired[i].used) {
-                    retireIdx = i;
-                    break;
-                }
+    // Point the `numPages` pages at `va` in an address space at another
+    // buffer. Returns once no CPU can reach the old pages through it.
+    static void MapBufferLocked(uint64_t pml4Phys, uint64_t va, const uint64_t* physPages, int numPages) {
+        Memory::VMM::Tlb::Batch batch(pml4Phys);
+        for (int i = 0; i < numPages; i++) {
+            uint64_t pageVa = va + (uint64_t)i * 0x1000;
+            if (Memory::VMM::Paging::MapUserIn(pml4Phys, physPages[i], pageVa)) {
+                batch.Add(pageVa);
             }
         }
+    }
+
+    // Free the swapchain's buffers, except the back buffer if the owner's
+    // page tables still map it (FreeUserHalf() frees it then). Unmapping
+    // them from the blitter first waits out a blit reading them.
+    static void FreeBuffersLocked(WindowSlot& slot, bool keepBack) {
+        for (int b = 0; b < SwapBuffers; b++) {
+            Drivers::Graphics::IntelGPU::UnmapSurface(slot.bufferGpu[b]);
+            slot.bufferGpu[b] = 0;
+        }
+        for (int b = 0; b < SwapBuffers; b++) {
+            if (keepBack && b == slot.back) continue;
+            FreePageBatchLocked(slot.bufferPhysPages[b], slot.pixelNumPages);
+        }
+    }
 
-        if (retireIdx < 0) {
-            uint64_t oldest = ~0ULL;
-            for (int i = 0; i < MaxRetiredBatches; i++) {
-                if (g_retired[i].freeAfterMs < oldest) {
-                    oldest = g_retired[i].freeAfterMs;
-                    retireIdx = i;
-                }
+    static_assert(sizeof(Montauk::WinEventSlot) == 32 && offsetof(Montauk::WinEventRing, slots) == 64,
+                  "event slots must not straddle pages");
+
+    // Event queue of a new window. Backed in full up front: events are
+    // sent with the kernel's view of it, which must never fault.
+    static bool AllocateEventsLocked(WindowSlot& slot) {
+        auto* object = Memory::MemObject::CreateAnonymous(sizeof(Montauk::WinEventRing));
+        if (object == nullptr) return false;
+        for (int i = 0; i < EventRingPages; i++) {
+            uint64_t phys = object->PageAt(i);
+            if (phys == 0) {
+                object->Release();
+                return false;
             }
-            if (retireIdx >= 0) {
-                Kt::KernelLogStream(Kt::ERROR, "WinServer")
-                    << "Retire queue full, forcing early free of stale window pages";
-                FreePageBatchLocked(g_retired[retireIdx].physPages, g_retired[retireIdx].numPages);
-                g_retired[retireIdx].used = false;
-                g_retired[retireIdx].numPages = 0;
-                g_retired[retireIdx].freeAfterMs = 0;
+            slot.eventPages[i] = (uint8_t*)Memory::HHDM(phys);
+        }
+        slot.events = object;
+        slot.eventHeader = (Montauk::WinEventRing*)slot.eventPages[0];
+        slot.eventHead = 0;
+        return true;
+    }
+
+    // Drop the window's reference; the owner's mapping keeps its own
+    static void FreeEventsLocked(WindowSlot& slot) {
+        if (slot.events != nullptr) slot.events->Release();
+        slot.events = nullptr;
+        slot.eventHeader = nullptr;
+    }
+
+    // Slot of event `n`. The pages are not contiguous in the HHDM.
+    static Montauk::WinEventSlot& EventSlotLocked(WindowSlot& slot, uint32_t n) {
+        uint64_t offset = offsetof(Montauk::WinEventRing, slots)
+                        + (uint64_t)(n % Montauk::WIN_EVENT_RING_SIZE) * sizeof(Montauk::WinEventSlot);
+        return *(Montauk::WinEventSlot*)(slot.eventPages[offset / 0x1000] + offset % 0x1000);
+    }
+
+    // Events the owner has not taken yet. It owns `tail`, so a value that
+    // makes no sense counts as a full queue.
+    static uint32_t EventsQueuedLocked(const WindowSlot& slot) {
+        uint32_t queued = slot.eventHead - slot.eventHeader->tail;
+        return queued > Montauk::WIN_EVENT_RING_SIZE ? Montauk::WIN_EVENT_RING_SIZE : queued;
+    }
+
+    static bool IsMouseMove(const Montauk::WinEvent& ev) {
+        return ev.type == 1 && ev.mouse.scroll == 0 && ev.mouse.buttons == ev.mouse.prev_buttons;
+    }
+
+    // Replace the newest queued event with the move `ev` if that is a
+    // move with the same buttons nobody has claimed yet. The slot is
+    // WIN_SLOT_WRITING meanwhile, and consumers spin on it, so this must
+    // not be preempted.
+    static bool MergeMoveLocked(WindowSlot& slot, const Montauk::WinEvent& ev) {
+        Montauk::WinEventSlot& last = EventSlotLocked(slot, slot.eventHead - 1);
+        bool merged = false;
+
+        uint64_t flags;
+        asm volatile("pushfq; pop %0; cli" : "=r"(flags) :: "memory");
+        uint32_t expected = Montauk::WIN_SLOT_READY;
+        if (__atomic_compare_exchange_n(&last.state, &expected, Montauk::WIN_SLOT_WRITING,
+                                        false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            if (IsMouseMove(last.event) && last.event.mouse.buttons == ev.mouse.buttons) {
+                last.event = ev;
+                merged = true;
             }
+            __atomic_store_n(&last.state, Montauk::WIN_SLOT_READY, __ATOMIC_RELEASE);
         }
+        asm volatile("push %0; popfq" :: "r"(flags) : "memory");
+        return merged;
+    }
+
+    static bool EmptyRect(const Montauk::WinRect& r) {
+        return r.w <= 0 || r.h <= 0;
+    }
 
-        if (retireIdx < 0) {
-            FreePageBatchLocked(physPages, numPages);
+    // Grow `into` to the bounding box of itself and `r`
+    static void UnionRect(Montauk::WinRect& into, const Montauk::WinRect& r) {
+        if (EmptyRect(r)) return;
+        if (EmptyRect(into)) { into = r; return; }
+        int32_t x1 = into.x + into.w > r.x + r.w ? into.x + into.w : r.x + r.w;
+        int32_t y1 = into.y + into.h > r.y + r.h ? into.y + into.h : r.y + r.h;
+        if (r.x < into.x) into.x = r.x;
+        if (r.y < into.y) into.y = r.y;
+        into.w = x1 - into.x;
+        into.h = y1 - into.y;
+    }
+
+    // Clip `r` to a w x h window. Returns false if nothing is left.
+    static bool ClipRect(Montauk::WinRect& r, int w, int h) {
+        int32_t x1 = r.x + r.w > w ? w : r.x + r.w;
+        int32_t y1 = r.y + r.h > h ? h : r.y + r.h;
+        if (r.x < 0) r.x = 0;
+        if (r.y < 0) r.y = 0;
+        r.w = x1 - r.x;
+        r.h = y1 - r.y;
+        return !EmptyRect(r);
+    }
+
+    // Record damage for the compositor's next Changes. Past
+    // WinMaxDamage rectangles, the last one grows to cover the rest.
+    static void AddDamageLocked(WindowSlot& slot, const Montauk::WinRect& r) {
+        if (slot.damageFull) return;
+        if (slot.damageCount == Montauk::WinMaxDamage) {
+            UnionRect(slot.damage[slot.damageCount - 1], r);
             return;
         }
+        slot.damage[slot.damageCount++] = r;
+    }
+
+    // Copy the rectangle `r` of a w-wide window between two buffers
+    static void CopyRect(const uint64_t* fromPages, const uint64_t* toPages, int width,
+                         const Montauk::WinRect& r) {
+        for (int32_t y = r.y; y < r.y + r.h; y++) {
+            uint64_t offset = ((uint64_t)y * width + r.x) * 4;
+            uint64_t remaining = (uint64_t)r.w * 4;
+            while (remaining > 0) {
+                uint64_t page = offset / 0x1000;
+                uint64_t inPage = offset % 0x1000;
+                uint64_t chunk = 0x1000 - inPage < remaining ? 0x1000 - inPage : remaining;
+                memcpy((uint8_t*)Memory::HHDM(toPages[page]) + inPage,
+                       (const uint8_t*)Memory::HHDM(fromPages[page]) + inPage, chunk);
+                offset += chunk;
+                remaining -= chunk;
+            }
+        }
+    }
+
+    // Allocate the swapchain for slot.pixelNumPages pages and map its back
+    // buffer at `userVa` in the owner. On failure nothing is left behind.
+    static bool AllocateBuffersLocked(WindowSlot& slot, uint64_t ownerPml4, uint64_t userVa) {
+        slot.back = 0;
+        slot.pending = 1;
+        slot.front = 2;
+        slot.framePending = false;
+        for (int b = 0; b < SwapBuffers; b++) slot.stale[b] = {};
+        slot.damageCount = 0;
+        slot.damageFull = false;
+
+        int numPages = slot.pixelNumPages;
+        for (int b = 0; b < SwapBuffers; b++) {
+            for (int i = 0; i < numPages; i++) {
+                void* page = Memory::g_pfa->AllocateZeroed();
+                if (page == nullptr) {
+                    FreeBuffersLocked(slot, false);
+                    return false;
+                }
+                slot.bufferPhysPages[b][i] = Memory::SubHHDM((uint64_t)page);
+            }
+        }
 
-        RetiredBatch& batch = g_retired[retireIdx];
-        batch.used = true;
-        batch.numPages = numPages;
-        batch.freeAfterMs = Timekeeping::GetMilliseconds() + RetireGraceMs;
         for (int i = 0; i < numPages; i++) {
-            batch.physPages[i] = physPages[i];
-            physPages[i] = 0;
+            if (!Memory::VMM::Paging::MapUserIn(ownerPml4, slot.bufferPhysPages[slot.back][i],
+                                                userVa + (uint64_t)i * 0x1000)) {
+                UnmapOwnerLocked(ownerPml4, userVa, i);
+                FreeBuffersLocked(slot, false);
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Make the pending frame the front buffer, remapping the compositor's
+    // view if it has one. `desktopPml4` is the compositor's address space.
+    static void TakePendingLocked(WindowSlot& slot, uint64_t desktopPml4) {
+        if (!slot.framePending) return;
+        uint8_t taken = slot.pending;
+        slot.pending = slot.front;
+        slot.front = taken;
+        slot.framePending = false;
+        if (slot.desktopVa != 0) {
+            MapBufferLocked(desktopPml4, slot.desktopVa, slot.bufferPhysPages[slot.front], slot.pixelNumPages);
         }
     }
 
     int Create(int ownerPid, uint64_t ownerPml4, const char* title, int w, int h,
                uint64_t& heapNext, uint64_t& outVa) {
         WsGuard guard;
-        ProcessRetiredLocked();
-        // Find a free slot
-        int slotIdx = -1;
-        for (int i = 0; i < MaxWindows; i++) {
-            if (!g_slots[i].used) {
-                slotIdx = i;
-                break;
-            }
-        }
-        if (slotIdx < 0) return -1;
 
         // Validate dimensions (cap at 16384 to prevent integer overflow in w*h*4)
         if (w <= 0 || h <= 0 || w > 16384 || h > 16384) return -1;
@@ -132,15 +357,13 @@ namespace WinServer {
         int numPages = (int)((bufSize + 0xFFF) / 0x1000);
         if (numPages > MaxPixelPages) return -1;
 
-        WindowSlot& slot = g_slots[slotIdx];
-        memset(&slot, 0, sizeof(WindowSlot));
-        slot.used = true;
+        WindowSlot* created = AllocateSlotLocked();
+        if (created == nullptr) return -1;
+        WindowSlot& slot = *created;
         slot.ownerPid = ownerPid;
         slot.width = w;
         slot.height = h;
         slot.pixelNumPages = numPages;
-        slot.eventHead = 0;
-        slot.eventTail = 0;
         slot.dirty = false;
         slot.desktopVa = 0;
         slot.desktopPid = 0;
@@ -153,147 +376,228 @@ namespace WinServer {
         }
         slot.title[tlen] = '\0';
 
-        // Allocate live pixel pages (app renders here) and snapshot pages
-        // (compositor reads here). Present copies live -> snapshot.
-        uint64_t userVa = heapNext;
-        for (int i = 0; i < numPages; i++) {
-            void* page = Memory::g_pfa->AllocateZeroed();
-            if (page == nullptr) {
-                slot.used = false;
-                return -1;
-            }
-            uint64_t physAddr = Memory::SubHHDM((uint64_t)page);
-            slot.pixelPhysPages[i] = physAddr;
-            if (!Memory::VMM::Paging::MapUserIn(ownerPml4, physAddr, userVa + (uint64_t)i * 0x1000)) {
-                slot.used = false;
-                return -1;
-            }
+        if (!AllocateEventsLocked(slot)) {
+            FreeSlotLocked(created);
+            return -1;
+        }
 
-            // Allocate corresponding snapshot page
-            void* snapPage = Memory::g_pfa->AllocateZeroed();
-            if (snapPage == nullptr) {
-                slot.used = false;
-                return -1;
-            }
-            slot.snapshotPhysPages[i] = Memory::SubHHDM((uint64_t)snapPage);
+        // Allocate the swapchain; the owner renders into the back buffer
+        uint64_t userVa = heapNext;
+        if (!AllocateBuffersLocked(slot, ownerPml4, userVa)) {
+            FreeEventsLocked(slot);
+            FreeSlotLocked(created);
+            return -1;
         }
 
         slot.ownerVa = userVa;
         heapNext += (uint64_t)numPages * 0x1000;
         outVa = userVa;
+        NoteActivityLocked(slot);
 
-        Kt::KernelLogStream(Kt::OK, "WinServer") << "Created window " << slotIdx
+        Kt::KernelLogStream(Kt::OK, "WinServer") << "Created window " << slot.id
             << " (" << w << "x" << h << ") for PID " << ownerPid;
 
-        return slotIdx;
+        return slot.id;
     }
 
     int Destroy(int windowId, int callerPid) {
         WsGuard guard;
-        ProcessRetiredLocked();
-        if (windowId < 0 || windowId >= MaxWindows) return -1;
-        WindowSlot& slot = g_slots[windowId];
-        if (!slot.used || slot.ownerPid != callerPid) return -1;
-
-        // Unmap LIVE pixel pages from the owner's address space so that
-        // FreeUserHalf() won't double-free them when the process exits.
-        // Physical page reclamation is deferred below to avoid stale-TLB
-        // consumers reading freed memory.
+        WindowSlot* found = LookupLocked(windowId);
+        if (found == nullptr || found->ownerPid != callerPid) return -1;
+        WindowSlot& slot = *found;
+
+        // Unmap the back buffer from the owner and the front buffer from
+        // the desktop, then free all three. The shootdowns guarantee that
+        // no CPU still reaches them through a stale TLB entry.
         {
             auto* ownerProc = Sched::GetProcessByPid(slot.ownerPid);
-            if (ownerProc) {
-                for (int p = 0; p < slot.pixelNumPages; p++) {
-                    Memory::VMM::Paging::UnmapUserIn(
-                        ownerProc->pml4Phys,
-                        slot.ownerVa + (uint64_t)p * 0x1000);
-                }
-            }
+            if (ownerProc) UnmapOwnerLocked(ownerProc->pml4Phys, slot.ownerVa, slot.pixelNumPages);
         }
+        DetachDesktopLocked(slot);
+        FreeBuffersLocked(slot, false);
+        FreeEventsLocked(slot);
+        FreeSlotLocked(&slot);
+        return 0;
+    }
 
-        // Retire both the owner-facing live pages and the compositor-facing
-        // snapshot pages. The desktop can still hold stale mappings to the
-        // snapshot pages for a short time after Enumerate notices the window
-        // is gone, so freeing them immediately turns that stale mapping into
-        // a use-after-free.
-        RetirePageBatchLocked(slot.pixelPhysPages, slot.pixelNumPages);
-        RetirePageBatchLocked(slot.snapshotPhysPages, slot.pixelNumPages);
+    // The frame just drawn becomes the pending one (replacing any the
+    // compositor has not taken yet), and the owner draws on in the buffer
+    // that was pending. Every other buffer now lacks `changed` as well.
+    // Returns the buffer that was presented.
+    static uint8_t SwapLocked(WindowSlot& slot, uint64_t ownerPml4, const Montauk::WinRect& changed) {
+        uint8_t drawn = slot.back;
+        for (int b = 0; b < SwapBuffers; b++) {
+            if (b == drawn) slot.stale[b] = {};
+            else UnionRect(slot.stale[b], changed);
+        }
 
-        slot.used = false;
-        slot.pixelNumPages = 0;
-        slot.ownerVa = 0;
-        slot.desktopVa = 0;
-        slot.desktopPid = 0;
+        slot.back = slot.pending;
+        slot.pending = drawn;
+        slot.framePending = true;
+        MapBufferLocked(ownerPml4, slot.ownerVa, slot.bufferPhysPages[slot.back], slot.pixelNumPages);
+
+        slot.dirty = true;
+        slot.presents++;
+        NoteActivityLocked(slot);
+        return drawn;
+    }
+
+    int Present(int windowId, int callerPid, uint64_t callerPml4) {
+        WsGuard guard;
+        WindowSlot* found = LookupLocked(windowId);
+        if (found == nullptr || found->ownerPid != callerPid) return -1;
+        WindowSlot& slot = *found;
+
+        SwapLocked(slot, callerPml4, {0, 0, slot.width, slot.height});
+        slot.damageFull = true;
+        slot.damageCount = 0;
         return 0;
     }
 
-    int Present(int windowId, int callerPid) {
-        // Validate ownership under the lock (brief)
+    int PresentRects(int windowId, int callerPid, uint64_t callerPml4,
+                     const Montauk::WinRect* rects, int count) {
         wsLock.Acquire();
-        ProcessRetiredLocked();
-        if (windowId < 0 || windowId >= MaxWindows) { wsLock.Release(); return -1; }
-        WindowSlot& slot = g_slots[windowId];
-        if (!slot.used || slot.ownerPid != callerPid) { wsLock.Release(); return -1; }
-        int numPages = slot.pixelNumPages;
-        wsLock.Release();
-
-        // Snapshot memcpy OUTSIDE the lock. This is safe because only the
-        // owning process calls Present/Resize, and a process runs on one
-        // CPU at a time. Holding wsLock during an 8MB copy would block
-        // ALL other WinServer operations (Poll, Enumerate, SendEvent)
-        // across all CPUs, causing convoy stalls and lockups.
-        for (int i = 0; i < numPages; i++) {
-            void* src = (void*)Memory::HHDM(slot.pixelPhysPages[i]);
-            void* dst = (void*)Memory::HHDM(slot.snapshotPhysPages[i]);
-            memcpy(dst, src, 0x1000);
+        WindowSlot* found = LookupLocked(windowId);
+        if (found == nullptr || found->ownerPid != callerPid) { wsLock.Release(); return -1; }
+        WindowSlot& slot = *found;
+
+        Montauk::WinRect changed = {};
+        for (int i = 0; i < count; i++) {
+            Montauk::WinRect r = rects[i];
+            if (!ClipRect(r, slot.width, slot.height)) continue;
+            AddDamageLocked(slot, r);
+            UnionRect(changed, r);
         }
 
-        // Set dirty under lock
-        wsLock.Acquire();
-        slot.dirty = true;
+        uint8_t drawn = SwapLocked(slot, callerPml4, changed);
+
+        // Bring the new back buffer up to date, so the owner only has to
+        // redraw what changes next. It is mapped in the owner alone, and the
+        // presented frame is only ever read from now on.
+        Montauk::WinRect missing = slot.stale[slot.back];
+        slot.stale[slot.back] = {};
+        const uint64_t* fromPages = slot.bufferPhysPages[drawn];
+        const uint64_t* toPages = slot.bufferPhysPages[slot.back];
+        int width = slot.width;
         wsLock.Release();
+
+        // Copy OUTSIDE the lock, as the first copy after full presents can
+        // be the whole window. Only the owning process presents or resizes
+        // its window, so the buffers stay put meanwhile.
+        if (!EmptyRect(missing)) CopyRect(fromPages, toPages, width, missing);
         return 0;
     }
 
     int Poll(int windowId, int callerPid, Montauk::WinEvent* outEvent) {
         WsGuard guard;
-        ProcessRetiredLocked();
-        if (windowId < 0 || windowId >= MaxWindows) return -1;
-        WindowSlot& slot = g_slots[windowId];
-        if (!slot.used || slot.ownerPid != callerPid) return -1;
-
-        if (slot.eventHead == slot.eventTail) return 0; // no events
+        WindowSlot* found = LookupLocked(windowId);
+        if (found == nullptr || found->ownerPid != callerPid) return -1;
+        WindowSlot& slot = *found;
+
+        // Take the event like the owner would. wsLock keeps the kernel
+        // from writing meanwhile, so a slot that is not ready has just
+        // been claimed by one of the owner's threads.
+        if (EventsQueuedLocked(slot) == 0) return 0;
+        uint32_t tail = slot.eventHeader->tail;
+        Montauk::WinEventSlot& taken = EventSlotLocked(slot, tail);
+        uint32_t expected = Montauk::WIN_SLOT_READY;
+        if (!__atomic_compare_exchange_n(&taken.state, &expected, Montauk::WIN_SLOT_TAKEN,
+                                         false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            return 0;
+        }
 
-        *outEvent = slot.events[slot.eventTail];
-        slot.eventTail = (slot.eventTail + 1) % MaxEvents;
+        *outEvent = taken.event;
+        __atomic_store_n(&slot.eventHeader->tail, tail + 1, __ATOMIC_RELEASE);
         return 1;
     }
 
+    Memory::MemObject* AcquireEventRing(int windowId, int callerPid) {
+        WsGuard guard;
+        WindowSlot* found = LookupLocked(windowId);
+        if (found == nullptr || found->ownerPid != callerPid) return nullptr;
+        WindowSlot& slot = *found;
+
+        slot.events->Retain();
+        return slot.events;
+    }
+
+    int Pending(int windowId, int callerPid, uint32_t& posted, uint64_t& key) {
+        WsGuard guard;
+        WindowSlot* found = LookupLocked(windowId);
+        if (found == nullptr || found->ownerPid != callerPid) return -1;
+        WindowSlot& slot = *found;
+
+        posted = slot.eventsPosted;
+        key = (uint64_t)&slot;
+        return EventsQueuedLocked(slot) != 0 ? 1 : 0;
+    }
+
+    static void DescribeLocked(const WindowSlot& slot, Montauk::WinInfo& info) {
+        info.id = slot.id;
+        info.ownerPid = slot.ownerPid;
+        for (int j = 0; j < 64; j++) info.title[j] = slot.title[j];
+        info.width = slot.width;
+        info.height = slot.height;
+        info.dirty = slot.dirty ? 1 : 0;
+        info.cursor = slot.cursor;
+        info.closed = 0;
+        info.presents = slot.presents;
+        info.damageCount = 0;
+        if (slot.dirty && !slot.damageFull) {
+            info.damageCount = (uint8_t)slot.damageCount;
+            for (int d = 0; d < slot.damageCount; d++) info.damage[d] = slot.damage[d];
+        }
+    }
+
     int Enumerate(Montauk::WinInfo* outArray, int maxCount) {
         WsGuard guard;
-        ProcessRetiredLocked();
         int count = 0;
         for (int i = 0; i < MaxWindows && count < maxCount; i++) {
-            if (!g_slots[i].used) continue;
-            Montauk::WinInfo& info = outArray[count];
-            info.id = i;
-            info.ownerPid = g_slots[i].ownerPid;
-            for (int j = 0; j < 64; j++) info.title[j] = g_slots[i].title[j];
-            info.width = g_slots[i].width;
-            info.height = g_slots[i].height;
-            info.dirty = g_slots[i].dirty ? 1 : 0;
-            info.cursor = g_slots[i].cursor;
-            g_slots[i].dirty = false; // clear dirty after read
-            count++;
+            if (g_slots[i] == nullptr) continue;
+            DescribeLocked(*g_slots[i], outArray[count++]);
         }
         return count;
     }
 
+    int Changes(Montauk::WinInfo* outArray, int maxCount, int callerPid, uint64_t callerPml4) {
+        WsGuard guard;
+        int count = 0;
+        while (g_changed != 0 && count < maxCount) {
+            int index = __builtin_ctzll(g_changed);
+            g_changed &= g_changed - 1;
+
+            Montauk::WinInfo& info = outArray[count++];
+            WindowSlot* slot = g_slots[index];
+            if (slot == nullptr) {
+                memset(&info, 0, sizeof(info));
+                info.id = MakeId(index);
+                info.closed = 1;
+                continue;
+            }
+
+            if (slot->desktopPid == callerPid || slot->desktopVa == 0) {
+                TakePendingLocked(*slot, callerPml4);
+            }
+            DescribeLocked(*slot, info);
+            slot->dirty = false;
+            slot->damageCount = 0;
+            slot->damageFull = false;
+        }
+        if (g_changed == 0) g_activitySeen = g_activity;
+        return count;
+    }
+
+    int Activity(uint32_t& seq) {
+        WsGuard guard;
+        seq = g_activity;
+        return g_activity != g_activitySeen ? 1 : 0;
+    }
+
     uint64_t Map(int windowId, int callerPid, uint64_t callerPml4, uint64_t& heapNext) {
         WsGuard guard;
-        ProcessRetiredLocked();
-        if (windowId < 0 || windowId >= MaxWindows) return 0;
-        WindowSlot& slot = g_slots[windowId];
-        if (!slot.used) return 0;
+        WindowSlot* found = LookupLocked(windowId);
+        if (found == nullptr) return 0;
+        WindowSlot& slot = *found;
 
         // If already mapped into this process, return existing VA
         if (slot.desktopPid == callerPid && slot.desktopVa != 0) {
@@ -302,10 +606,11 @@ namespace WinServer {
 
         uint64_t userVa = heapNext;
 
-        // Map the SNAPSHOT pages (not live pages) so the compositor
-        // always reads a complete frame captured at Present time.
+        // Map the front buffer (not the back buffer) so the compositor
+        // always reads a complete presented frame
+        TakePendingLocked(slot, callerPml4);
         for (int i = 0; i < slot.pixelNumPages; i++) {
-            if (!Memory::VMM::Paging::MapUserIn(callerPml4, slot.snapshotPhysPages[i],
+            if (!Memory::VMM::Paging::MapUserIn(callerPml4, slot.bufferPhysPages[slot.front][i],
                                            userVa + (uint64_t)i * 0x1000)) {
                 return 0;
             }
@@ -318,33 +623,63 @@ namespace WinServer {
         return userVa;
     }
 
-    // Internal: send event without acquiring lock (caller must hold wsLock)
-    static int SendEventLocked(int windowId, const Montauk::WinEvent* event) {
-        if (windowId < 0 || windowId >= MaxWindows) return -1;
-        WindowSlot& slot = g_slots[windowId];
-        if (!slot.used) return -1;
+    uint64_t GpuAddress(int callerPid, uint64_t va, uint64_t length) {
+        WsGuard guard;
+        for (int i = 0; i < MaxWindows; i++) {
+            WindowSlot* slot = g_slots[i];
+            if (slot == nullptr || slot->desktopPid != callerPid || slot->desktopVa == 0) continue;
+
+            uint64_t size = (uint64_t)slot->pixelNumPages * 0x1000;
+            if (va < slot->desktopVa || va - slot->desktopVa > size || length > size - (va - slot->desktopVa)) {
+                continue;
+            }
+
+            uint64_t& gpu = slot->bufferGpu[slot->front];
+            if (gpu == 0) {
+                gpu = Drivers::Graphics::IntelGPU::MapSurface(slot->bufferPhysPages[slot->front],
+                                                              slot->pixelNumPages);
+            }
+            return gpu != 0 ? gpu + (va - slot->desktopVa) : 0;
+        }
+        return 0;
+    }
 
-        int nextHead = (slot.eventHead + 1) % MaxEvents;
-        if (nextHead == slot.eventTail) return -1; // queue full, drop event
+    // Internal: send event without acquiring lock (caller must hold wsLock)
+    static int SendEventLocked(WindowSlot& slot, const Montauk::WinEvent* event) {
+        // A move that only updates the pointer position replaces the one
+        // the owner has not seen yet
+        uint32_t queued = EventsQueuedLocked(slot);
+        if (queued == 0 || !IsMouseMove(*event) || !MergeMoveLocked(slot, *event)) {
+            if (queued == Montauk::WIN_EVENT_RING_SIZE) {
+                slot.eventHeader->dropped = slot.eventHeader->dropped + 1;
+                return -1; // queue full, drop event
+            }
 
-        slot.events[slot.eventHead] = *event;
-        slot.eventHead = nextHead;
+            Montauk::WinEventSlot& next = EventSlotLocked(slot, slot.eventHead);
+            next.event = *event;
+            next.state = Montauk::WIN_SLOT_READY;
+            slot.eventHead++;
+            __atomic_store_n(&slot.eventHeader->head, slot.eventHead, __ATOMIC_RELEASE);
+        }
+        slot.eventsPosted++;
+        Sched::BoostInput(slot.ownerPid);
+        Sched::NotifyReady(&slot);
         return 0;
     }
 
     int SendEvent(int windowId, const Montauk::WinEvent* event) {
         WsGuard guard;
-        ProcessRetiredLocked();
-        return SendEventLocked(windowId, event);
+        WindowSlot* slot = LookupLocked(windowId);
+        if (slot == nullptr) return -1;
+        return SendEventLocked(*slot, event);
     }
 
     int Resize(int windowId, int callerPid, uint64_t ownerPml4, int newW, int newH,
                uint64_t& heapNext, uint64_t& outVa) {
         WsGuard guard;
-        ProcessRetiredLocked();
-        if (windowId < 0 || windowId >= MaxWindows) return -1;
-        WindowSlot& slot = g_slots[windowId];
-        if (!slot.used || slot.ownerPid != callerPid) return -1;
+        WindowSlot* found = LookupLocked(windowId);
+        if (found == nullptr || found->ownerPid != callerPid) return -1;
+        WindowSlot& slot = *found;
         if (newW <= 0 || newH <= 0 || newW > 16384 || newH > 16384) return -1;
         if (newW == slot.width && newH == slot.height) {
             outVa = slot.ownerVa;
@@ -355,61 +690,45 @@ namespace WinServer {
         int numPages = (int)((bufSize + 0xFFF) / 0x1000);
         if (numPages > MaxPixelPages) return -1;
 
-        // Unmap old LIVE pixel pages from the owner's address space. Actual
-        // physical page reclamation is deferred below for both live and
-        // snapshot pages so stale desktop mappings cannot turn into
-        // use-after-free reads during remap.
-        int oldNumPages = slot.pixelNumPages;
-        for (int i = 0; i < oldNumPages; i++) {
-            Memory::VMM::Paging::UnmapUserIn(
-                ownerPml4, slot.ownerVa + (uint64_t)i * 0x1000);
-        }
-        RetirePageBatchLocked(slot.pixelPhysPages, oldNumPages);
-        RetirePageBatchLocked(slot.snapshotPhysPages, oldNumPages);
+        // Take the old pages out of both address spaces and free them
+        UnmapOwnerLocked(ownerPml4, slot.ownerVa, slot.pixelNumPages);
+        DetachDesktopLocked(slot);
+        FreeBuffersLocked(slot, false);
 
-        // Allocate new live + snapshot pages and map live into owner's address space
+        // Allocate a new swapchain and map its back buffer into the owner
         uint64_t userVa = heapNext;
-        for (int i = 0; i < numPages; i++) {
-            void* page = Memory::g_pfa->AllocateZeroed();
-            if (page == nullptr) return -1;
-            uint64_t physAddr = Memory::SubHHDM((uint64_t)page);
-            slot.pixelPhysPages[i] = physAddr;
-            if (!Memory::VMM::Paging::MapUserIn(ownerPml4, physAddr, userVa + (uint64_t)i * 0x1000)) {
-                return -1;
-            }
-
-            void* snapPage = Memory::g_pfa->AllocateZeroed();
-            if (snapPage == nullptr) return -1;
-            slot.snapshotPhysPages[i] = Memory::SubHHDM((uint64_t)snapPage);
+        slot.pixelNumPages = numPages;
+        if (!AllocateBuffersLocked(slot, ownerPml4, userVa)) {
+            slot.pixelNumPages = 0;
+            slot.ownerVa = 0;
+            return -1;
         }
 
         slot.width = newW;
         slot.height = newH;
-        slot.pixelNumPages = numPages;
         slot.ownerVa = userVa;
         heapNext += (uint64_t)numPages * 0x1000;
 
-        // Invalidate desktop mapping so it re-maps on next enumerate
-        slot.desktopVa = 0;
-        slot.desktopPid = 0;
-
+        // The desktop re-maps the new front buffer on its next enumerate
         outVa = userVa;
+        NoteActivityLocked(slot);
         return 0;
     }
 
     int SetCursor(int windowId, int callerPid, int cursor) {
         WsGuard guard;
-        ProcessRetiredLocked();
-        if (windowId < 0 || windowId >= MaxWindows) return -1;
-        WindowSlot& slot = g_slots[windowId];
-        if (!slot.used || slot.ownerPid != callerPid) return -1;
-        slot.cursor = (uint8_t)cursor;
+        WindowSlot* found = LookupLocked(windowId);
+        if (found == nullptr || found->ownerPid != callerPid) return -1;
+        WindowSlot& slot = *found;
+        if (slot.cursor != (uint8_t)cursor) {
+            slot.cursor = (uint8_t)cursor;
+            NoteActivityLocked(slot);
+        }
         return 0;
     }
 
     int SetScale(int scale) {
         WsGuard guard;
-        ProcessRetiredLocked();
         if (scale < 0) scale = 0;
         if (scale > 2) scale = 2;
         g_uiScale = scale;
@@ -420,8 +739,8 @@ namespace WinServer {
         ev.type = 4;
         ev.scale.scale = scale;
         for (int i = 0; i < MaxWindows; i++) {
-            if (g_slots[i].used) {
-                SendEventLocked(i, &ev);
+            if (g_slots[i] != nullptr) {
+                SendEventLocked(*g_slots[i], &ev);
             }
         }
         return 0;
@@ -431,43 +750,54 @@ namespace WinServer {
         return g_uiScale;
     }
 
+    uint64_t BufferPages(int pid) {
+        WsGuard guard;
+        uint64_t pages = 0;
+        for (int i = 0; i < MaxWindows; i++) {
+            if (g_slots[i] != nullptr && g_slots[i]->ownerPid == pid) {
+                pages += (uint64_t)SwapBuffers * g_slots[i]->pixelNumPages;
+            }
+        }
+        return pages;
+    }
+
     void CleanupProcess(int pid) {
         WsGuard guard;
-        ProcessRetiredLocked();
         for (int i = 0; i < MaxWindows; i++) {
-            if (g_slots[i].used && g_slots[i].ownerPid == pid) {
+            WindowSlot* slot = g_slots[i];
+            if (slot == nullptr) continue;
+
+            if (slot->ownerPid == pid) {
                 Kt::KernelLogStream(Kt::INFO, "WinServer") << "Cleaning up window "
-                    << i << " for exited PID " << pid;
+                    << slot->id << " for exited PID " << pid;
 
-                // Do NOT free live pixel pages here -- they are still mapped
+                // Do NOT free the back buffer here -- it is still mapped
                 // in the owner's page tables and FreeUserHalf() (called right
-                // after CleanupProcess) will free them.
-
-                // Snapshot pages can still be mapped into the desktop, so
-                // retire them instead of freeing them immediately.
-                RetirePageBatchLocked(g_slots[i].snapshotPhysPages, g_slots[i].pixelNumPages);
-
-                g_slots[i].used = false;
-                g_slots[i].pixelNumPages = 0;
-                g_slots[i].ownerVa = 0;
-                g_slots[i].desktopVa = 0;
-                g_slots[i].desktopPid = 0;
+                // after CleanupProcess) will free it.
+
+                // The front buffer can still be mapped into the desktop
+                DetachDesktopLocked(*slot);
+                FreeBuffersLocked(*slot, true);
+                FreeEventsLocked(*slot);
+                FreeSlotLocked(slot);
+                continue;
             }
 
             // If this process had windows mapped INTO it (was the desktop viewer),
             // unmap those pixel pages so FreeUserHalf() won't free pages owned
             // by other processes.
-            if (g_slots[i].used && g_slots[i].desktopPid == pid) {
+            if (slot->desktopPid == pid) {
                 auto* proc = Sched::GetProcessByPid(pid);
                 if (proc) {
-                    for (int p = 0; p < g_slots[i].pixelNumPages; p++) {
+                    Memory::VMM::Tlb::Batch batch(proc->pml4Phys);
+                    for (int p = 0; p < slot->pixelNumPages; p++) {
                         Memory::VMM::Paging::UnmapUserIn(
                             proc->pml4Phys,
-                            g_slots[i].desktopVa + (uint64_t)p * 0x1000);
+                            slot->desktopVa + (uint64_t)p * 0x1000, batch);
                     }
                 }
-                g_slots[i].desktopVa = 0;
-                g_slots[i].desktopPid = 0;
+                slot->desktopVa = 0;
+                slot->desktopPid = 0;
             }
         }
     }
@@ -7,26 +7,56 @@
 #pragma once
 #include "Syscall.hpp"
 #include <cstdint>
+#include <Memory/MemObject.hpp>
 
 namespace WinServer {
 
-    static constexpr int MaxWindows = 8;
-    static constexpr int MaxEvents = 64;
+    static constexpr int MaxWindows = Montauk::WinMaxWindows;
+    static constexpr int EventRingPages =
+        (int)((sizeof(Montauk::WinEventRing) + 0xFFF) / 0x1000);
     static constexpr int MaxPixelPages = 8192; // up to 3840x2160 @ 32bpp = 32MB
 
+    // A window is a swapchain of three buffers. The owner draws into the
+    // back buffer; Present makes it the pending frame and maps the old
+    // pending buffer in its place. The compositor takes the pending frame
+    // in its next Changes, swapping it with the front buffer it reads
+    // from. Presenting only rewrites page table entries, and neither side
+    // ever sees the other writing. After Present the back buffer holds
+    // an older frame, so clients redraw it in full -- unless they present
+    // with damage rectangles, after which the back buffer is brought up
+    // to date by copying just the regions it is missing.
+    static constexpr int SwapBuffers = 3;
+
+    // Rectangles accepted by one PresentRects call
+    static constexpr int MaxPresentRects = 16;
+
+    // Allocated from the kernel heap for as long as the window exists
     struct WindowSlot {
-        bool used;
+        int id;                // Index in the slot table, plus the generation
+        int index;
         int ownerPid;
         char title[64];
         int width, height;
-        uint64_t pixelPhysPages[MaxPixelPages];     // live buffer (app writes here)
-        uint64_t snapshotPhysPages[MaxPixelPages];   // snapshot (compositor reads here)
+        uint64_t bufferPhysPages[SwapBuffers][MaxPixelPages];
+        uint8_t back;          // Mapped in the owner at ownerVa
+        uint8_t pending;       // Presented, not yet taken by the compositor (if framePending)
+        uint8_t front;         // Mapped in the desktop at desktopVa
+        bool framePending;
+        Montauk::WinRect stale[SwapBuffers];  // Bounding box of what each buffer lacks of the newest frame
+        Montauk::WinRect damage[Montauk::WinMaxDamage];  // Presented since the last Changes
+        int damageCount;
+        bool damageFull;       // The whole window was presented since the last Changes
+        uint32_t presents;     // Frames presented since creation
         int pixelNumPages;
         uint64_t ownerVa;      // VA in owner's address space
         uint64_t desktopVa;    // VA in desktop's address space (0 = not yet mapped)
         int desktopPid;        // PID of the process that mapped it
-        Montauk::WinEvent events[MaxEvents];
-        int eventHead, eventTail;
+        uint64_t bufferGpu[SwapBuffers];  // Blitter address of each buffer (0 = not mapped)
+        Memory::MemObject* events;  // The WinEventRing, shared with the owner
+        Montauk::WinEventRing* eventHeader;  // Its first page (head, tail, dropped)
+        uint8_t* eventPages[EventRingPages];
+        uint32_t eventHead;     // Next event to write; the ring's head is only a copy
+        uint32_t eventsPosted;  // Events ever queued (SYS_EPOLL_WAIT edge detection)
         bool dirty;
         uint8_t cursor;     // cursor style requested by app (0=arrow, 1=resize_h, 2=resize_v)
     };
@@ -34,14 +64,40 @@ namespace WinServer {
     int Create(int ownerPid, uint64_t ownerPml4, const char* title, int w, int h,
                uint64_t& heapNext, uint64_t& outVa);
     int Destroy(int windowId, int callerPid);
-    int Present(int windowId, int callerPid);
+    int Present(int windowId, int callerPid, uint64_t callerPml4);
+    // Present a frame of which only `rects` changed (window coordinates)
+    int PresentRects(int windowId, int callerPid, uint64_t callerPml4,
+                     const Montauk::WinRect* rects, int count);
     int Poll(int windowId, int callerPid, Montauk::WinEvent* outEvent);
+    // A reference to the event queue of the caller's window, for mapping
+    // it; nullptr if the caller has no such window
+    Memory::MemObject* AcquireEventRing(int windowId, int callerPid);
+    // Whether events are queued, without taking one: 1 or 0, the window's
+    // eventsPosted in `posted` and what it passes to Sched::NotifyReady in
+    // `key`; -1 if the caller has no such window
+    int Pending(int windowId, int callerPid, uint32_t& posted, uint64_t& key);
+    // Every window, as it is; takes nothing from the compositor
     int Enumerate(Montauk::WinInfo* outArray, int maxCount);
+    // The windows that changed (created, destroyed, presented, resized,
+    // cursor) since the last call, each once, and the ones gone marked
+    // closed. Also hands the caller, if it is the compositor of a window,
+    // the window's pending frame, and resets the window's damage.
+    int Changes(Montauk::WinInfo* outArray, int maxCount, int callerPid, uint64_t callerPml4);
+    // Whether windows changed since Changes last returned all of them: 1
+    // or 0, and a counter that moves with each change in `seq`
+    // (SYS_EPOLL_WAIT)
+    int Activity(uint32_t& seq);
     uint64_t Map(int windowId, int callerPid, uint64_t callerPml4, uint64_t& heapNext);
     int SendEvent(int windowId, const Montauk::WinEvent* event);
     int Resize(int windowId, int callerPid, uint64_t ownerPml4, int newW, int newH,
                uint64_t& heapNext, uint64_t& outVa);
     void CleanupProcess(int pid);
+    // Pages of every swap buffer of the windows `pid` owns
+    uint64_t BufferPages(int pid);
+    // Blitter address of [va, va + length) in a window front buffer the
+    // caller has mapped, mapping the buffer for the blitter on first use;
+    // 0 if the range is no such buffer or the blitter has no room
+    uint64_t GpuAddress(int callerPid, uint64_t va, uint64_t length);
     int SetCursor(int windowId, int callerPid, int cursor);
     int SetScale(int scale);
     int GetScale();
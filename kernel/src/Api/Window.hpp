@@ -2,7 +2,8 @@
     * Window.hpp
     * SYS_WINCREATE, SYS_WINDESTROY, SYS_WINPRESENT, SYS_WINPOLL,
     * SYS_WINENUM, SYS_WINMAP, SYS_WINSENDEVENT, SYS_WINRESIZE,
-    * SYS_WINSETSCALE, SYS_WINGETSCALE syscalls
+    * SYS_WINSETSCALE, SYS_WINGETSCALE, SYS_WINPRESENTRECTS,
+    * SYS_WINEVENTRING, SYS_WINCHANGES syscalls
     * Copyright (c) 2026 Daniel Hammer
 */
 
@@ -14,14 +15,20 @@
 
 namespace Montauk {
 
+    // SYS_WINEVENTRING maps through MapObject, so Mmap.hpp must be
+    // included first.
+
     static int Sys_WinCreate(const char* title, int w, int h, WinCreateResult* result) {
         if (result == nullptr || title == nullptr) return -1;
         auto* proc = Sched::GetCurrentProcessPtr();
         if (proc == nullptr) return -1;
 
+        // heapNext and the page tables are shared with the process's other threads
         uint64_t outVa = 0;
+        proc->vmLock.Acquire();
         int id = WinServer::Create(proc->pid, proc->pml4Phys, title, w, h,
                                    proc->heapNext, outVa);
+        proc->vmLock.Release();
         result->id = id;
         result->pixelVa = (id >= 0) ? outVa : 0;
         return id >= 0 ? 0 : -1;
@@ -32,7 +39,26 @@ namespace Montauk {
     }
 
     static uint64_t Sys_WinPresent(int windowId) {
-        return WinServer::Present(windowId, Sched::GetCurrentPid());
+        auto* proc = Sched::GetCurrentProcessPtr();
+        if (proc == nullptr) return (uint64_t)-1;
+        // Present remaps the back buffer in the shared page tables
+        proc->vmLock.Acquire();
+        int r = WinServer::Present(windowId, proc->pid, proc->pml4Phys);
+        proc->vmLock.Release();
+        return r;
+    }
+
+    static uint64_t Sys_WinPresentRects(int windowId, const WinRect* rects, int count) {
+        if (count < 0 || count > WinServer::MaxPresentRects) return (uint64_t)-1;
+        WinRect local[WinServer::MaxPresentRects];
+        for (int i = 0; i < count; i++) local[i] = rects[i];
+
+        auto* proc = Sched::GetCurrentProcessPtr();
+        if (proc == nullptr) return (uint64_t)-1;
+        proc->vmLock.Acquire();
+        int r = WinServer::PresentRects(windowId, proc->pid, proc->pml4Phys, local, count);
+        proc->vmLock.Release();
+        return r;
     }
 
     static int Sys_WinPoll(int windowId, WinEvent* outEvent) {
@@ -40,15 +66,35 @@ namespace Montauk {
         return WinServer::Poll(windowId, Sched::GetCurrentPid(), outEvent);
     }
 
+    // Map the event queue of a window; each call maps it again
+    static uint64_t Sys_WinEventRing(int windowId) {
+        Memory::MemObject* ring = WinServer::AcquireEventRing(windowId, Sched::GetCurrentPid());
+        if (ring == nullptr) return 0;
+        return MapObject(ring, 0, ring->Pages());
+    }
+
     static int Sys_WinEnum(WinInfo* outArray, int maxCount) {
         if (outArray == nullptr || maxCount <= 0) return 0;
         return WinServer::Enumerate(outArray, maxCount);
     }
 
+    static int Sys_WinChanges(WinInfo* outArray, int maxCount) {
+        if (outArray == nullptr || maxCount <= 0) return 0;
+        auto* proc = Sched::GetCurrentProcessPtr();
+        if (proc == nullptr) return 0;
+        proc->vmLock.Acquire();
+        int count = WinServer::Changes(outArray, maxCount, proc->pid, proc->pml4Phys);
+        proc->vmLock.Release();
+        return count;
+    }
+
     static uint64_t Sys_WinMap(int windowId) {
         auto* proc = Sched::GetCurrentProcessPtr();
         if (proc == nullptr) return 0;
-        return WinServer::Map(windowId, proc->pid, proc->pml4Phys, proc->heapNext);
+        proc->vmLock.Acquire();
+        uint64_t va = WinServer::Map(windowId, proc->pid, proc->pml4Phys, proc->heapNext);
+        proc->vmLock.Release();
+        return va;
     }
 
     static int Sys_WinSendEvent(int windowId, const WinEvent* event) {
@@ -60,8 +106,10 @@ namespace Montauk {
         auto* proc = Sched::GetCurrentProcessPtr();
         if (proc == nullptr) return 0;
         uint64_t outVa = 0;
+        proc->vmLock.Acquire();
         int r = WinServer::Resize(windowId, proc->pid, proc->pml4Phys, newW, newH,
                                   proc->heapNext, outVa);
+        proc->vmLock.Release();
         return (r == 0) ? outVa : 0;
     }
 
@@ -0,0 +1,168 @@
+/*
+    * Profiler.cpp
+    * Timer-driven sampling profiler
+    * Copyright (c) 2026 Daniel Hammer
+*/
+
+#include "Profiler.hpp"
+#include <Hal/Cpu.hpp>
+#include <Hal/SmpBoot.hpp>
+#include <Hal/Apic/Interrupts.hpp>
+#include <Memory/HHDM.hpp>
+#include <Memory/Heap.hpp>
+#include <Memory/Paging.hpp>
+#include <Sched/Scheduler.hpp>
+#include <Timekeeping/ApicTimer.hpp>
+#include <CppLib/Spinlock.hpp>
+
+namespace Prof {
+
+    using Montauk::ProfSample;
+
+    // About 2 seconds at PROF_HZ, 300 KiB per CPU. prof drains the
+    // buffers several times a second.
+    static constexpr uint64_t SamplesPerCpu = 2048;
+    static constexpr uint64_t IntervalUs = 1000000 / Montauk::PROF_HZ;
+
+    // Single producer (its CPU, in the timer interrupt), single consumer
+    // (Read, under g_readLock)
+    struct Ring {
+        uint64_t head;
+        uint64_t tail;
+        ProfSample* samples;
+    };
+
+    int g_active = 0;
+
+    static kcp::Mutex g_setupLock;
+    static kcp::Mutex g_readLock;
+    static Ring g_rings[Smp::MaxCPUs];
+    static int g_cpus = 0;
+    static int g_pid = -1;
+    static uint64_t g_dropped = 0;
+
+    // One word of the interrupted process's memory, through the HHDM so
+    // a bad frame pointer cannot fault inside the interrupt
+    static bool ReadUserWord(uint64_t pml4Phys, uint64_t addr, uint64_t& value) {
+        if (addr & 7) return false;
+        uint64_t phys = Memory::VMM::Paging::GetUserPhysAddr(pml4Phys, addr);
+        if (phys == 0) return false;
+        value = *(volatile uint64_t*)Memory::HHDM(phys);
+        return true;
+    }
+
+    void Sample(const Hal::IrqFrame* frame) {
+        // Tickless CPUs would otherwise only be interrupted at slice ends
+        Timekeeping::ArmTimer(Timekeeping::GetMicroseconds() + IntervalUs);
+
+        auto* cpuData = Smp::GetCurrentCpuData();
+        int cpu = cpuData->cpuIndex;
+        if (cpu >= g_cpus) return;
+
+        // The idle loop is not sampled
+        Sched::Process* proc = Sched::GetProcessSlot(cpuData->currentSlot);
+        if (proc == nullptr) return;
+        int pid = __atomic_load_n(&g_pid, __ATOMIC_RELAXED);
+        if (pid >= 0 && proc->tgid != pid) return;
+
+        Ring& ring = g_rings[cpu];
+        uint64_t head = ring.head;
+        if (head - __atomic_load_n(&ring.tail, __ATOMIC_ACQUIRE) >= SamplesPerCpu) {
+            __atomic_fetch_add(&g_dropped, 1, __ATOMIC_RELAXED);
+            return;
+        }
+
+        ProfSample& sample = ring.samples[head % SamplesPerCpu];
+        sample.pid = proc->tgid;
+        sample.tid = proc->pid;
+        sample.cpu = (uint16_t)cpu;
+        sample.reserved = 0;
+        sample.tsc = Hal::ReadTsc();
+        sample.ip[0] = frame->rip;
+
+        int depth = 1;
+        bool user = (frame->cs & 3) == 3;
+        if (user) {
+            // Each frame holds the caller's rbp, then the return address.
+            // Frames only go up the stack, so a bad chain ends quickly.
+            uint64_t fp = frame->rbp;
+            while (depth < Montauk::PROF_MAX_DEPTH && fp != 0 && fp < Sched::UserStackTop) {
+                uint64_t next, ret;
+                if (!ReadUserWord(proc->pml4Phys, fp, next)) break;
+                if (!ReadUserWord(proc->pml4Phys, fp + 8, ret)) break;
+                if (ret == 0) break;
+                sample.ip[depth++] = ret;
+                if (next <= fp) break;
+                fp = next;
+            }
+        }
+        sample.flags = user ? 0 : Montauk::PROF_KERNEL;
+        sample.depth = (uint16_t)depth;
+
+        __atomic_store_n(&ring.head, head + 1, __ATOMIC_RELEASE);
+    }
+
+    bool Start(int pid) {
+        g_setupLock.Acquire();
+        __atomic_store_n(&g_active, 0, __ATOMIC_RELEASE);
+
+        if (g_cpus == 0) {
+            int cpus = Smp::GetCpuCount();
+            if (cpus < 1) cpus = 1;
+            for (int cpu = 0; cpu < cpus; cpu++) {
+                g_rings[cpu].samples = (ProfSample*)Memory::g_heap->Request(SamplesPerCpu * sizeof(ProfSample));
+                if (g_rings[cpu].samples == nullptr) {
+                    for (int i = 0; i < cpu; i++) {
+                        Memory::g_heap->Free(g_rings[i].samples);
+                        g_rings[i].samples = nullptr;
+                    }
+                    g_setupLock.Release();
+                    return false;
+                }
+            }
+            g_cpus = cpus;
+        }
+
+        // A sample being written as g_active dropped can still land
+        g_readLock.Acquire();
+        for (int cpu = 0; cpu < g_cpus; cpu++) {
+            __atomic_store_n(&g_rings[cpu].tail, __atomic_load_n(&g_rings[cpu].head, __ATOMIC_ACQUIRE), __ATOMIC_RELEASE);
+        }
+        g_readLock.Release();
+
+        __atomic_store_n(&g_dropped, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&g_pid, pid < 0 ? -1 : pid, __ATOMIC_RELAXED);
+        __atomic_store_n(&g_active, 1, __ATOMIC_RELEASE);
+        g_setupLock.Release();
+        return true;
+    }
+
+    uint64_t Stop() {
+        __atomic_store_n(&g_active, 0, __ATOMIC_RELEASE);
+        return __atomic_load_n(&g_dropped, __ATOMIC_RELAXED);
+    }
+
+    int Read(ProfSample* out, int max) {
+        int count = 0;
+        for (int cpu = 0; cpu < __atomic_load_n(&g_cpus, __ATOMIC_ACQUIRE) && count < max; cpu++) {
+            Ring& ring = g_rings[cpu];
+            while (count < max) {
+                // `out` is user memory that may fault, so each sample is
+                // taken under the lock and stored after it
+                ProfSample sample;
+                g_readLock.Acquire();
+                uint64_t tail = ring.tail;
+                if (tail == __atomic_load_n(&ring.head, __ATOMIC_ACQUIRE)) {
+                    g_readLock.Release();
+                    break;
+                }
+                sample = ring.samples[tail % SamplesPerCpu];
+                __atomic_store_n(&ring.tail, tail + 1, __ATOMIC_RELEASE);
+                g_readLock.Release();
+
+                out[count++] = sample;
+            }
+        }
+        return count;
+    }
+};
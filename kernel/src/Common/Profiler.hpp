@@ -0,0 +1,40 @@
+/*
+    * Profiler.hpp
+    * Timer-driven sampling profiler
+    * Copyright (c) 2026 Daniel Hammer
+*/
+
+#pragma once
+#include <cstdint>
+#include <Api/Syscall.hpp>
+
+namespace Hal { struct IrqFrame; }
+
+namespace Prof {
+
+    // Nonzero while sampling. Off, the timer interrupt pays one load and a
+    // not-taken branch.
+    extern int g_active;
+
+    inline bool On() {
+        return __builtin_expect(__atomic_load_n(&g_active, __ATOMIC_RELAXED) != 0, 0);
+    }
+
+    // Record what the timer interrupt in `frame` interrupted: its RIP and,
+    // in user mode, up to Montauk::PROF_MAX_DEPTH - 1 return addresses
+    // from the frame pointer chain. Runs in the interrupt, before the
+    // timer handler.
+    void Sample(const Hal::IrqFrame* frame);
+
+    // Start sampling process `pid`, or every process with -1. Empties the
+    // sample buffers. Returns false if they cannot be allocated.
+    bool Start(int pid);
+
+    // Stop sampling. What was recorded stays readable. Returns the number
+    // of samples lost to full buffers.
+    uint64_t Stop();
+
+    // Move up to `max` recorded samples to `out`, oldest first per CPU.
+    // Returns the number moved.
+    int Read(Montauk::ProfSample* out, int max);
+};
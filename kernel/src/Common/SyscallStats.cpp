@@ -0,0 +1,198 @@
+/*
+    * SyscallStats.cpp
+    * Per-syscall counts and latency histograms
+    * Copyright (c) 2026 Daniel Hammer
+*/
+
+#include "SyscallStats.hpp"
+#include <Hal/SmpBoot.hpp>
+#include <Memory/Heap.hpp>
+#include <Sched/Scheduler.hpp>
+#include <Timekeeping/ApicTimer.hpp>
+#include <CppLib/Spinlock.hpp>
+#include <Libraries/Memory.hpp>
+
+namespace SyscallStats {
+
+    using Montauk::SyscallStatInfo;
+    using Montauk::SYSSTAT_MAX_SYSCALLS;
+    using Montauk::SYSSTAT_BUCKETS;
+
+    struct CallStats {
+        uint64_t count;
+        uint64_t totalNs;
+        uint64_t maxNs;
+        uint32_t buckets[SYSSTAT_BUCKETS];
+    };
+
+    // About 24 KiB per CPU. Only its own CPU writes it, with interrupts
+    // off, so the counters need no atomics.
+    struct CpuStats {
+        CallStats calls[SYSSTAT_MAX_SYSCALLS];
+    };
+
+    // One per process table slot, owned by whichever process runs in it.
+    // A slot taken over by a new process starts from zero. They are
+    // allocated a table chunk at a time, when a slot of the chunk first
+    // makes a counted call, and never freed.
+    struct ProcStats {
+        int pid;
+        uint64_t count[SYSSTAT_MAX_SYSCALLS];
+        uint64_t totalNs[SYSSTAT_MAX_SYSCALLS];
+    };
+
+    uint32_t g_flags = 0;
+
+    static kcp::Mutex g_setupLock;
+    static CpuStats* g_cpuStats = nullptr;
+    static ProcStats* g_procStats[Sched::MaxProcesses / Sched::SlotChunk];
+    static int g_cpus = 0;
+
+    // Nanoseconds per TSC tick, 32.32 fixed point
+    static uint64_t g_nsPerTsc = 0;
+
+    static int BucketOf(uint64_t ns) {
+        if (ns == 0) return 0;
+        int bucket = 63 - __builtin_clzll(ns);
+        return bucket < SYSSTAT_BUCKETS ? bucket : SYSSTAT_BUCKETS - 1;
+    }
+
+    static void ResetProcStats(ProcStats* chunk) {
+        memset(chunk, 0, Sched::SlotChunk * sizeof(ProcStats));
+        for (int i = 0; i < Sched::SlotChunk; i++) chunk[i].pid = -1;
+    }
+
+    // Counters of table chunk `index`, allocated on first use. Nullptr if
+    // out of memory. Process context, with interrupts enabled.
+    static ProcStats* ProcChunk(int index) {
+        ProcStats* chunk = __atomic_load_n(&g_procStats[index], __ATOMIC_ACQUIRE);
+        if (chunk != nullptr) return chunk;
+
+        g_setupLock.Acquire();
+        chunk = g_procStats[index];
+        if (chunk == nullptr) {
+            chunk = (ProcStats*)Memory::g_heap->Request(Sched::SlotChunk * sizeof(ProcStats));
+            if (chunk != nullptr) {
+                ResetProcStats(chunk);
+                __atomic_store_n(&g_procStats[index], chunk, __ATOMIC_RELEASE);
+            }
+        }
+        g_setupLock.Release();
+        return chunk;
+    }
+
+    void Record(uint64_t nr, uint64_t tsc) {
+        if (nr >= (uint64_t)SYSSTAT_MAX_SYSCALLS) return;
+        uint64_t ns = (uint64_t)(((unsigned __int128)tsc * g_nsPerTsc) >> 32);
+
+        // The calling slot's counters, allocated while interrupts are on
+        int slot = Smp::GetCurrentCpuData()->currentSlot;
+        Sched::Process* proc = Sched::GetProcessSlot(slot);
+        ProcStats* chunk = nullptr;
+        if (proc != nullptr && (__atomic_load_n(&g_flags, __ATOMIC_RELAXED) & Montauk::SYSSTAT_PROCESS)) {
+            chunk = ProcChunk(slot / Sched::SlotChunk);
+        }
+
+        // Interrupts off: the call may have migrated, and this CPU's
+        // counters must not be updated from two contexts at once
+        uint64_t flags;
+        asm volatile("pushfq; pop %0; cli" : "=r"(flags) :: "memory");
+
+        int cpu = Smp::CurrentCpuIndex();
+        if (g_cpuStats != nullptr && cpu < g_cpus) {
+            CallStats& call = g_cpuStats[cpu].calls[nr];
+            call.count++;
+            call.totalNs += ns;
+            if (ns > call.maxNs) call.maxNs = ns;
+            call.buckets[BucketOf(ns)]++;
+        }
+
+        if (chunk != nullptr) {
+            ProcStats& stats = chunk[slot % Sched::SlotChunk];
+            if (stats.pid != proc->tgid) {
+                memset(&stats, 0, sizeof(stats));
+                stats.pid = proc->tgid;
+            }
+            stats.count[nr]++;
+            stats.totalNs[nr] += ns;
+        }
+
+        asm volatile("push %0; popfq" :: "r"(flags) : "memory");
+    }
+
+    // Setup lock held
+    static bool AllocateLocked() {
+        if (g_cpuStats == nullptr) {
+            int cpus = Smp::GetCpuCount();
+            if (cpus < 1) cpus = 1;
+            auto* stats = (CpuStats*)Memory::g_heap->Request(cpus * sizeof(CpuStats));
+            if (stats == nullptr) return false;
+            memset(stats, 0, cpus * sizeof(CpuStats));
+
+            uint64_t tscPerUs = Timekeeping::TscPerMicrosecond();
+            g_nsPerTsc = tscPerUs ? (1000ULL << 32) / tscPerUs : 0;
+            g_cpus = cpus;
+            __atomic_store_n(&g_cpuStats, stats, __ATOMIC_RELEASE);
+        }
+        return true;
+    }
+
+    bool SetFlags(uint32_t flags) {
+        if (flags & Montauk::SYSSTAT_PROCESS) flags |= Montauk::SYSSTAT_ON;
+
+        g_setupLock.Acquire();
+        if ((flags & Montauk::SYSSTAT_ON) && !AllocateLocked()) {
+            g_setupLock.Release();
+            return false;
+        }
+
+        // A syscall that is being counted may still add to what is zeroed
+        if (flags & Montauk::SYSSTAT_RESET) {
+            if (g_cpuStats) memset(g_cpuStats, 0, g_cpus * sizeof(CpuStats));
+            for (ProcStats* chunk : g_procStats) {
+                if (chunk != nullptr) ResetProcStats(chunk);
+            }
+        }
+
+        __atomic_store_n(&g_flags, flags & (Montauk::SYSSTAT_ON | Montauk::SYSSTAT_PROCESS), __ATOMIC_RELEASE);
+        g_setupLock.Release();
+        return true;
+    }
+
+    // Lock-free: the counters are never freed once allocated, and `out`
+    // is user memory that may fault
+    int Read(int pid, SyscallStatInfo* out, int max) {
+        const CpuStats* cpuStats = __atomic_load_n(&g_cpuStats, __ATOMIC_ACQUIRE);
+        int cpus = __atomic_load_n(&g_cpus, __ATOMIC_RELAXED);
+        int written = 0;
+
+        for (int nr = 0; nr < SYSSTAT_MAX_SYSCALLS && written < max; nr++) {
+            SyscallStatInfo info{};
+            info.nr = (uint32_t)nr;
+
+            if (pid < 0) {
+                if (cpuStats == nullptr) break;
+                for (int cpu = 0; cpu < cpus; cpu++) {
+                    const CallStats& call = cpuStats[cpu].calls[nr];
+                    info.count += call.count;
+                    info.totalNs += call.totalNs;
+                    if (call.maxNs > info.maxNs) info.maxNs = call.maxNs;
+                    for (int b = 0; b < SYSSTAT_BUCKETS; b++) info.buckets[b] += call.buckets[b];
+                }
+            } else {
+                for (int c = 0; c < Sched::MaxProcesses / Sched::SlotChunk; c++) {
+                    const ProcStats* chunk = __atomic_load_n(&g_procStats[c], __ATOMIC_ACQUIRE);
+                    if (chunk == nullptr) continue;
+                    for (int i = 0; i < Sched::SlotChunk; i++) {
+                        if (chunk[i].pid != pid) continue;
+                        info.count += chunk[i].count[nr];
+                        info.totalNs += chunk[i].totalNs[nr];
+                    }
+                }
+            }
+
+            if (info.count != 0) out[written++] = info;
+        }
+        return written;
+    }
+};
@@ -0,0 +1,34 @@
+/*
+    * SyscallStats.hpp
+    * Per-syscall counts and latency histograms
+    * Copyright (c) 2026 Daniel Hammer
+*/
+
+#pragma once
+#include <cstdint>
+#include <Api/Syscall.hpp>
+
+namespace SyscallStats {
+
+    // Montauk::SYSSTAT_ON and SYSSTAT_PROCESS as currently set. While off,
+    // the dispatcher pays one load and a not-taken branch per syscall.
+    extern uint32_t g_flags;
+
+    inline bool On() {
+        return __builtin_expect((__atomic_load_n(&g_flags, __ATOMIC_RELAXED) & Montauk::SYSSTAT_ON) != 0, 0);
+    }
+
+    // Charge one call of syscall `nr` that took `tsc` ticks to this CPU,
+    // and to the calling process with SYSSTAT_PROCESS. Call only when On()
+    // said so at entry.
+    void Record(uint64_t nr, uint64_t tsc);
+
+    // Apply Montauk::SYSSTAT_* flags; 0 stops counting, keeping what was
+    // counted. Returns false if the counters cannot be allocated.
+    bool SetFlags(uint32_t flags);
+
+    // Copy the syscalls that were called at least once, in number order:
+    // summed over all CPUs for pid -1, else over the threads of process
+    // `pid`. Returns the number of entries written.
+    int Read(int pid, Montauk::SyscallStatInfo* out, int max);
+};
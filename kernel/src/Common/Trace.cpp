@@ -0,0 +1,144 @@
+/*
+    * Trace.cpp
+    * Static kernel tracepoints
+    * Copyright (c) 2026 Daniel Hammer
+*/
+
+#include "Trace.hpp"
+#include <Hal/Cpu.hpp>
+#include <Hal/SmpBoot.hpp>
+#include <Memory/HHDM.hpp>
+#include <Memory/Heap.hpp>
+#include <Memory/MemObject.hpp>
+#include <Timekeeping/ApicTimer.hpp>
+#include <CppLib/Spinlock.hpp>
+
+namespace Trace {
+
+    using Montauk::TraceHeader;
+    using Montauk::TraceRecord;
+
+    static_assert(Montauk::TRACE_MAX_CPUS == Smp::MaxCPUs, "one ring per possible CPU");
+    static_assert(sizeof(TraceHeader) <= 0x1000, "the header fits its page");
+
+    // 128 KiB per CPU
+    static constexpr uint32_t RecordsPerCpu = 4096;
+    static constexpr uint32_t RecordsPerPage = 0x1000 / sizeof(TraceRecord);
+    static constexpr uint64_t RingPages = RecordsPerCpu / RecordsPerPage;
+
+    uint32_t g_mask = 0;
+
+    static kcp::Mutex g_setupLock;
+    static Memory::MemObject* g_object = nullptr;
+    static TraceHeader* g_header = nullptr;
+    static uint8_t** g_pages = nullptr;     // Kernel address of every buffer page
+    static int g_cpus = 0;
+
+    // Authoritative write positions. The copies in the header are for the
+    // reader; the buffer is mapped writable, so they are never read back.
+    static uint64_t g_heads[Smp::MaxCPUs];
+
+    static TraceRecord* Slot(int cpu, uint64_t n) {
+        uint64_t index = n & (RecordsPerCpu - 1);
+        uint8_t* page = g_pages[1 + cpu * RingPages + index / RecordsPerPage];
+        return (TraceRecord*)page + index % RecordsPerPage;
+    }
+
+    void Write(uint16_t type, uint32_t arg0, uint64_t arg1, uint64_t arg2) {
+        // Interrupts off: a tracepoint in an interrupt handler must not
+        // land in the middle of this CPU's record
+        uint64_t flags;
+        asm volatile("pushfq; pop %0; cli" : "=r"(flags) :: "memory");
+
+        int cpu = Smp::CurrentCpuIndex();
+        if (cpu < g_cpus) {
+            uint64_t n = g_heads[cpu];
+            TraceRecord* rec = Slot(cpu, n);
+            rec->tsc = Hal::ReadTsc();
+            rec->type = type;
+            rec->cpu = (uint16_t)cpu;
+            rec->arg0 = arg0;
+            rec->arg1 = arg1;
+            rec->arg2 = arg2;
+
+            g_heads[cpu] = n + 1;
+            __atomic_store_n(&g_header->head[cpu], n + 1, __ATOMIC_RELEASE);
+        }
+
+        asm volatile("push %0; popfq" :: "r"(flags) : "memory");
+    }
+
+    // Allocate and back the whole buffer: tracepoints run in interrupt
+    // handlers and must never fault a page in. Setup lock held.
+    static bool SetupLocked() {
+        if (g_object) return true;
+
+        int cpus = Smp::GetCpuCount();
+        if (cpus < 1) cpus = 1;
+        uint64_t pages = 1 + (uint64_t)cpus * RingPages;
+
+        auto* object = Memory::MemObject::CreateAnonymous(pages * 0x1000);
+        auto** pageTable = (uint8_t**)Memory::g_heap->Request(pages * sizeof(uint8_t*));
+        if (object == nullptr || pageTable == nullptr) {
+            if (object) object->Release();
+            if (pageTable) Memory::g_heap->Free(pageTable);
+            return false;
+        }
+
+        for (uint64_t i = 0; i < pages; i++) {
+            uint64_t phys = object->PageAt(i);
+            if (phys == 0) {
+                object->Release();
+                Memory::g_heap->Free(pageTable);
+                return false;
+            }
+            pageTable[i] = (uint8_t*)Memory::HHDM(phys);
+        }
+
+        auto* header = (TraceHeader*)pageTable[0];
+        header->magic = Montauk::TRACE_MAGIC;
+        header->cpus = (uint32_t)cpus;
+        header->recordsPerCpu = RecordsPerCpu;
+        header->mask = 0;
+        header->tscPerUs = Timekeeping::TscPerMicrosecond();
+        header->ringOffset = 0x1000;
+        header->ringStride = RingPages * 0x1000;
+
+        g_pages = pageTable;
+        g_header = header;
+        g_cpus = cpus;
+        g_object = object;
+        return true;
+    }
+
+    bool SetMask(uint32_t mask) {
+        mask &= Montauk::TRACE_ALL;
+
+        g_setupLock.Acquire();
+        if (!SetupLocked()) {
+            g_setupLock.Release();
+            return false;
+        }
+
+        // A fresh trace starts with empty rings. A tracepoint that saw the
+        // old mask just before it was cleared may still land one record.
+        if (g_mask == 0 && mask != 0) {
+            for (int cpu = 0; cpu < g_cpus; cpu++) {
+                g_heads[cpu] = 0;
+                g_header->head[cpu] = 0;
+            }
+        }
+
+        g_header->mask = mask;
+        __atomic_store_n(&g_mask, mask, __ATOMIC_RELEASE);
+        g_setupLock.Release();
+        return true;
+    }
+
+    Memory::MemObject* GetBuffer() {
+        g_setupLock.Acquire();
+        bool ok = SetupLocked();
+        g_setupLock.Release();
+        return ok ? g_object : nullptr;
+    }
+};
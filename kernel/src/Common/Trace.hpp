@@ -0,0 +1,38 @@
+/*
+    * Trace.hpp
+    * Static kernel tracepoints
+    * Copyright (c) 2026 Daniel Hammer
+*/
+
+#pragma once
+#include <cstdint>
+#include <Api/Syscall.hpp>
+
+namespace Memory { class MemObject; }
+
+namespace Trace {
+
+    // Categories (Montauk::TRACE_*) currently recorded. A tracepoint whose
+    // category is off costs one load and a not-taken branch.
+    extern uint32_t g_mask;
+
+    inline bool On(uint32_t category) {
+        return __builtin_expect((__atomic_load_n(&g_mask, __ATOMIC_RELAXED) & category) != 0, 0);
+    }
+
+    // Append a record to this CPU's ring. Call only when On() says so.
+    void Write(uint16_t type, uint32_t arg0, uint64_t arg1, uint64_t arg2);
+
+    inline void Emit(uint32_t category, uint16_t type, uint32_t arg0, uint64_t arg1 = 0, uint64_t arg2 = 0) {
+        if (On(category)) Write(type, arg0, arg1, arg2);
+    }
+
+    // Record the categories in `mask` (0 stops tracing). Starting from
+    // stopped empties the rings. Returns false if the buffer could not be
+    // allocated.
+    bool SetMask(uint32_t mask);
+
+    // The trace buffer (a Montauk::TraceHeader page, then the rings),
+    // allocated on first use. Returns nullptr when out of memory.
+    Memory::MemObject* GetBuffer();
+};
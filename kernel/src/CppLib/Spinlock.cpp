@@ -7,18 +7,149 @@
 #include "Spinlock.hpp"
 
 namespace kcp {
+    static std::atomic<LockStat*> g_lockStats{nullptr};
+
+    static inline uint64_t Tsc() {
+        uint32_t lo, hi;
+        asm volatile("rdtsc" : "=a"(lo), "=d"(hi));
+        return ((uint64_t)hi << 32) | lo;
+    }
+
+    static inline void RaiseMax(std::atomic<uint64_t>& max, uint64_t value) {
+        uint64_t seen = max.load(std::memory_order_relaxed);
+        while (value > seen && !max.compare_exchange_weak(seen, value, std::memory_order_relaxed)) {}
+    }
+
+    LockStat* LockStatList() {
+        return g_lockStats.load(std::memory_order_acquire);
+    }
+
+    void LockStat::Acquired(uint64_t start, bool spun) {
+        uint64_t now = Tsc();
+        acquiredAt = now;
+        acquisitions.fetch_add(1, std::memory_order_relaxed);
+        if (spun) {
+            contended.fetch_add(1, std::memory_order_relaxed);
+            spinTsc.fetch_add(now - start, std::memory_order_relaxed);
+            RaiseMax(maxSpinTsc, now - start);
+        }
+
+        if (!listed.load(std::memory_order_relaxed) && !listed.exchange(true, std::memory_order_relaxed)) {
+            LockStat* head = g_lockStats.load(std::memory_order_relaxed);
+            do {
+                next = head;
+            } while (!g_lockStats.compare_exchange_weak(head, this, std::memory_order_release, std::memory_order_relaxed));
+        }
+    }
+
+    void LockStat::Released() {
+        RaiseMax(maxHoldTsc, Tsc() - acquiredAt);
+    }
+
+    void LockStat::Reset() {
+        acquisitions.store(0, std::memory_order_relaxed);
+        contended.store(0, std::memory_order_relaxed);
+        spinTsc.store(0, std::memory_order_relaxed);
+        maxSpinTsc.store(0, std::memory_order_relaxed);
+        maxHoldTsc.store(0, std::memory_order_relaxed);
+    }
+
     void Spinlock::Acquire() {
         uint64_t flags;
         asm volatile("pushfq; pop %0; cli" : "=r"(flags) :: "memory");
-        while (atomic_flag.test_and_set(std::memory_order_acquire)) {
-            asm volatile("pause");
+        if (stat == nullptr) {
+            while (atomic_flag.test_and_set(std::memory_order_acquire)) {
+                asm volatile("pause");
+            }
+        } else {
+            // Only a failed first attempt is timed, so an uncontended
+            // acquisition costs one extra rdtsc
+            uint64_t start = 0;
+            bool spun = false;
+            while (atomic_flag.test_and_set(std::memory_order_acquire)) {
+                if (!spun) {
+                    start = Tsc();
+                    spun = true;
+                }
+                asm volatile("pause");
+            }
+            stat->Acquired(start, spun);
         }
         savedFlags = flags;
     }
 
+    bool Spinlock::TryAcquire() {
+        uint64_t flags;
+        asm volatile("pushfq; pop %0; cli" : "=r"(flags) :: "memory");
+        if (atomic_flag.test_and_set(std::memory_order_acquire)) {
+            asm volatile("push %0; popfq" :: "r"(flags) : "memory");
+            return false;
+        }
+        if (stat != nullptr) stat->Acquired(0, false);
+        savedFlags = flags;
+        return true;
+    }
+
     void Spinlock::Release() {
         uint64_t flags = savedFlags;
+        if (stat != nullptr) stat->Released();
         atomic_flag.clear(std::memory_order_release);
         asm volatile("push %0; popfq" :: "r"(flags) : "memory");
     }
-};
\ No newline at end of file
+
+    void TicketLock::Acquire() {
+        uint64_t flags;
+        asm volatile("pushfq; pop %0; cli" : "=r"(flags) :: "memory");
+        uint32_t ticket = next.fetch_add(1, std::memory_order_relaxed);
+        uint32_t now = serving.load(std::memory_order_acquire);
+        if (now == ticket) {
+            if (stat != nullptr) stat->Acquired(0, false);
+        } else {
+            uint64_t start = (stat != nullptr) ? Tsc() : 0;
+            do {
+                for (uint32_t ahead = ticket - now; ahead > 0; ahead--) {
+                    asm volatile("pause");
+                }
+                now = serving.load(std::memory_order_acquire);
+            } while (now != ticket);
+            if (stat != nullptr) stat->Acquired(start, true);
+        }
+        savedFlags = flags;
+    }
+
+    bool TicketLock::TryAcquire() {
+        uint64_t flags;
+        asm volatile("pushfq; pop %0; cli" : "=r"(flags) :: "memory");
+        // Free exactly when no ticket is outstanding beyond the one served
+        uint32_t ticket = serving.load(std::memory_order_acquire);
+        if (!next.compare_exchange_strong(ticket, ticket + 1, std::memory_order_acquire,
+                                          std::memory_order_relaxed)) {
+            asm volatile("push %0; popfq" :: "r"(flags) : "memory");
+            return false;
+        }
+        if (stat != nullptr) stat->Acquired(0, false);
+        savedFlags = flags;
+        return true;
+    }
+
+    void TicketLock::Release() {
+        uint64_t flags = savedFlags;
+        if (stat != nullptr) stat->Released();
+        // Only the holder writes `serving`
+        serving.store(serving.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        asm volatile("push %0; popfq" :: "r"(flags) : "memory");
+    }
+
+    void Mutex::AcquireTracked() {
+        uint64_t start = 0;
+        bool spun = false;
+        while (flag.test_and_set(std::memory_order_acquire)) {
+            if (!spun) {
+                start = Tsc();
+                spun = true;
+            }
+            asm volatile("pause");
+        }
+        stat->Acquired(start, spun);
+    }
+};
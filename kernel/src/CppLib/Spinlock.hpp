@@ -6,13 +6,68 @@
 
 #pragma once
 #include <atomic>
+#include <cstdint>
 
 namespace kcp {
+    // Contention counters for one named lock. A lock only pays for them
+    // when it is given one; the rest stay on the plain test_and_set path.
+    // Times are in TSC ticks. The record joins the list LockStatList()
+    // returns the first time its lock is taken.
+    struct LockStat {
+        const char* name;
+        std::atomic<uint64_t> acquisitions{0};
+        std::atomic<uint64_t> contended{0};      // Acquisitions that had to spin
+        std::atomic<uint64_t> spinTsc{0};
+        std::atomic<uint64_t> maxSpinTsc{0};
+        std::atomic<uint64_t> maxHoldTsc{0};
+        uint64_t acquiredAt = 0;                 // Written by the holder only
+        LockStat* next = nullptr;
+        std::atomic<bool> listed{false};
+
+        constexpr explicit LockStat(const char* n) : name(n) {}
+
+        void Acquired(uint64_t start, bool spun);
+        void Released();
+        void Reset();
+    };
+
+    // Head of the registered LockStat records, newest first
+    LockStat* LockStatList();
+
     class Spinlock {
         std::atomic_flag atomic_flag{ATOMIC_FLAG_INIT};
         uint64_t savedFlags = 0;
+        LockStat* stat = nullptr;
+    public:
+        constexpr Spinlock() = default;
+        constexpr explicit Spinlock(LockStat* s) : stat(s) {}
+
+        void Track(LockStat* s) { stat = s; }
+
+        void Acquire();
+        bool TryAcquire();
+        void Release();
+    };
+
+    // Spinlock that hands the lock out in arrival order. Each acquirer
+    // draws a ticket and waits for `serving` to reach it, so no CPU can
+    // starve the others, and waiters back off in proportion to their
+    // place in line instead of all hammering the line with atomics. For
+    // hot locks that several CPUs contend for; interrupts are disabled
+    // while held, as with Spinlock.
+    class TicketLock {
+        std::atomic<uint32_t> next{0};
+        std::atomic<uint32_t> serving{0};
+        uint64_t savedFlags = 0;
+        LockStat* stat = nullptr;
     public:
+        constexpr TicketLock() = default;
+        constexpr explicit TicketLock(LockStat* s) : stat(s) {}
+
+        void Track(LockStat* s) { stat = s; }
+
         void Acquire();
+        bool TryAcquire();
         void Release();
     };
 
@@ -21,14 +76,32 @@ namespace kcp {
     // Keeps interrupts enabled while spinning and while held.
     class Mutex {
         std::atomic_flag flag{ATOMIC_FLAG_INIT};
+        LockStat* stat = nullptr;
+
+        void AcquireTracked();
     public:
+        constexpr Mutex() = default;
+        constexpr explicit Mutex(LockStat* s) : stat(s) {}
+
+        void Track(LockStat* s) { stat = s; }
+
         void Acquire() {
+            if (stat != nullptr) {
+                AcquireTracked();
+                return;
+            }
             while (flag.test_and_set(std::memory_order_acquire)) {
                 asm volatile("pause");
             }
         }
+        bool TryAcquire() {
+            if (flag.test_and_set(std::memory_order_acquire)) return false;
+            if (stat != nullptr) stat->Acquired(0, false);
+            return true;
+        }
         void Release() {
+            if (stat != nullptr) stat->Released();
             flag.clear(std::memory_order_release);
         }
     };
-};
\ No newline at end of file
+};
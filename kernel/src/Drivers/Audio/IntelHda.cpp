@@ -8,8 +8,11 @@
 #include <Memory/PageFrameAllocator.hpp>
 #include <Memory/HHDM.hpp>
 #include <Memory/Paging.hpp>
+#include <Memory/MemObject.hpp>
+#include <CppLib/Spinlock.hpp>
 #include <Hal/Apic/Interrupts.hpp>
 #include <Hal/Apic/IoApic.hpp>
+#include <ACPI/AcpiSleep.hpp>
 #include <Terminal/Terminal.hpp>
 #include <CppLib/Stream.hpp>
 #include <Libraries/Memory.hpp>
@@ -26,6 +29,7 @@ namespace Drivers::Audio::IntelHda {
 
     static volatile uint8_t* g_mmioBase = nullptr;
     static uint8_t g_bus, g_dev, g_func;
+    static bool g_msiEnabled = false;
 
     // CORB/RIRB
     static volatile uint32_t* g_corb = nullptr;
@@ -38,6 +42,7 @@ namespace Drivers::Audio::IntelHda {
 
     // Codec info
     static uint8_t g_codecAddr = 0;    // First codec found
+    static uint8_t g_afgNid = 0;       // Its Audio Function Group
     static bool g_codecFound = false;
     static uint32_t g_codecVendorId = 0;  // Vendor (upper 16) | Device (lower 16)
 
@@ -57,8 +62,19 @@ namespace Drivers::Audio::IntelHda {
     // DMA buffers for output
     static volatile BdlEntry* g_bdl = nullptr;
     static uint64_t g_bdlPhys = 0;
-    static uint8_t* g_dmaBuffer = nullptr;       // Virtual (HHDM)
-    static uint64_t g_dmaBufferPhys = 0;
+
+    // Output ring, backed by a MemObject. Page 0 holds the AudioRingHeader
+    // counters, the ring pages follow. They need not be contiguous: the BDL
+    // gets one entry per page piece of every period. g_ringLock serializes
+    // position updates between the interrupt handler and syscalls.
+    static Memory::MemObject* g_ringObject = nullptr;   // The driver's own reference
+    static Montauk::AudioRingHeader* g_ringHeader = nullptr;
+    static uint8_t* g_ringPages[RING_MAX_PAGES];        // Kernel aliases
+    static uint64_t g_ringPhys[RING_MAX_PAGES];
+    static kcp::Spinlock g_ringLock;
+
+    // Produces the PCM that keeps the ring full (the kernel mixer)
+    static SourceFn g_source = nullptr;
 
     // DMA position buffer
     static volatile uint32_t* g_dmaPos = nullptr;
@@ -70,10 +86,18 @@ namespace Drivers::Audio::IntelHda {
     // Volume (0-127 for HDA, exposed as 0-100 to userspace)
     static int g_volume = 80;  // Default 80%
 
+    // S3: g_powerLock keeps Open, Close, Service and Control off the
+    // controller while the power hooks take it down and bring it back.
+    // Between the two, g_asleep is set and only the volume can change.
+    static kcp::Mutex g_powerLock;
+    static bool g_asleep = false;
+    static bool g_savedRunning = false;  // Stream was running at suspend
+    static uint16_t g_savedFormat = 0;   // Its SD_FMT
+
     // Set when an unsolicited response is detected (e.g. jack plug/unplug)
     static volatile bool g_jackEventPending = false;
 
-    // Debounce: after a switch, ignore jack events for this many Write() calls.
+    // Debounce: after a switch, ignore jack events for this many Service() calls.
     // Pin sense is unreliable while the pin widget is settling after reconfiguration.
     static uint32_t g_jackDebounce = 0;
     static constexpr uint32_t JACK_DEBOUNCE_COUNT = 512;
@@ -295,10 +319,13 @@ namespace Drivers::Audio::IntelHda {
         uint8_t corbSizeReg = Read8(REG_CORBSIZE);
         g_corbSize = DecodeSizeCapability(corbSizeReg);
 
-        // Allocate CORB buffer (aligned to 128 bytes, we allocate a full page)
-        void* corbVirt = Memory::g_pfa->AllocateZeroed();
-        g_corbPhys = Memory::SubHHDM(corbVirt);
-        g_corb = (volatile uint32_t*)corbVirt;
+        // Allocate CORB buffer (aligned to 128 bytes, we allocate a full
+        // page). A resume reuses the one from boot.
+        if (g_corb == nullptr) {
+            void* corbVirt = Memory::g_pfa->AllocateZeroed();
+            g_corbPhys = Memory::SubHHDM(corbVirt);
+            g_corb = (volatile uint32_t*)corbVirt;
+        }
 
         // Set CORB base address
         Write32(REG_CORBLBASE, (uint32_t)(g_corbPhys & 0xFFFFFFFF));
@@ -326,9 +353,11 @@ namespace Drivers::Audio::IntelHda {
         g_rirbSize = DecodeSizeCapability(rirbSizeReg);
 
         // Allocate RIRB buffer (8 bytes per entry)
-        void* rirbVirt = Memory::g_pfa->AllocateZeroed();
-        g_rirbPhys = Memory::SubHHDM(rirbVirt);
-        g_rirb = (volatile RirbEntry*)rirbVirt;
+        if (g_rirb == nullptr) {
+            void* rirbVirt = Memory::g_pfa->AllocateZeroed();
+            g_rirbPhys = Memory::SubHHDM(rirbVirt);
+            g_rirb = (volatile RirbEntry*)rirbVirt;
+        }
 
         // Set RIRB base address
         Write32(REG_RIRBLBASE, (uint32_t)(g_rirbPhys & 0xFFFFFFFF));
@@ -406,6 +435,7 @@ namespace Drivers::Audio::IntelHda {
             uint32_t fgType = GetParameter(g_codecAddr, nid, PARAM_FN_GROUP_TYPE);
             if ((fgType & 0xFF) == 0x01) {  // Audio Function Group
                 afg = nid;
+                g_afgNid = nid;
                 KernelLogStream(INFO, "HDA") << "Audio Function Group at NID " << (uint64_t)nid;
                 break;
             }
@@ -726,7 +756,8 @@ namespace Drivers::Audio::IntelHda {
     // Output stream setup
     // =========================================================================
 
-    static bool SetupOutputStream(uint8_t streamIndex, uint16_t streamFormat) {
+    static bool SetupOutputStream(uint8_t streamIndex, uint16_t streamFormat,
+                                  uint32_t periodBytes, uint32_t periodCount) {
         // Reset stream
         WriteSD8(streamIndex, SD_CTL, SD_CTL0_SRST);
         for (int i = 0; i < 1000; i++) {
@@ -746,11 +777,20 @@ namespace Drivers::Audio::IntelHda {
         // Clear status bits
         WriteSD8(streamIndex, SD_STS, SD_STS_BCIS | SD_STS_FIFOE | SD_STS_DESE);
 
-        // Set up BDL (double-buffered)
-        for (int i = 0; i < BUFFER_COUNT; i++) {
-            g_bdl[i].Address = g_dmaBufferPhys + (uint64_t)(i * BUFFER_SIZE);
-            g_bdl[i].Length = BUFFER_SIZE;
-            g_bdl[i].Ioc = 1;  // Interrupt on completion for each buffer
+        // Set up BDL: each period split at page boundaries, interrupt on
+        // completion after the last piece of a period
+        uint32_t ringBytes = periodBytes * periodCount;
+        int entries = 0;
+        for (uint32_t offset = 0; offset < ringBytes; ) {
+            uint32_t periodEnd = (offset / periodBytes + 1) * periodBytes;
+            uint32_t pageEnd = (offset / 0x1000 + 1) * 0x1000;
+            uint32_t end = periodEnd < pageEnd ? periodEnd : pageEnd;
+
+            g_bdl[entries].Address = g_ringPhys[offset / 0x1000] + offset % 0x1000;
+            g_bdl[entries].Length = end - offset;
+            g_bdl[entries].Ioc = end == periodEnd ? 1 : 0;
+            entries++;
+            offset = end;
         }
 
         // Set BDL address
@@ -758,10 +798,10 @@ namespace Drivers::Audio::IntelHda {
         WriteSD32(streamIndex, SD_BDPU, (uint32_t)(g_bdlPhys >> 32));
 
         // Set cyclic buffer length (total bytes across all BDL entries)
-        WriteSD32(streamIndex, SD_CBL, TOTAL_BUFFER_SIZE);
+        WriteSD32(streamIndex, SD_CBL, ringBytes);
 
         // Set last valid index (0-based)
-        WriteSD16(streamIndex, SD_LVI, BUFFER_COUNT - 1);
+        WriteSD16(streamIndex, SD_LVI, (uint16_t)(entries - 1));
 
         // Set stream format
         WriteSD16(streamIndex, SD_FMT, streamFormat);
@@ -799,13 +839,10 @@ namespace Drivers::Audio::IntelHda {
 
     static void HandleInterrupt(uint8_t irq);
 
-    static bool SetupMsi(uint8_t bus, uint8_t dev, uint8_t func) {
-        uint8_t cap = Pci::FindCapability(bus, dev, func, Pci::PCI_CAP_MSI);
-        if (cap == 0) {
-            KernelLogStream(INFO, "HDA") << "MSI capability not found";
-            return false;
-        }
-
+    // Point the MSI capability at our vector and switch off INTx. Also
+    // used on resume, since S3 clears PCI config space. Returns whether
+    // the capability has 64-bit addresses.
+    static bool ProgramMsi(uint8_t bus, uint8_t dev, uint8_t func, uint8_t cap) {
         uint16_t msgCtrl = Pci::LegacyRead16(bus, dev, func, cap + 2);
         bool is64bit = (msgCtrl & (1 << 7)) != 0;
 
@@ -825,8 +862,19 @@ namespace Drivers::Audio::IntelHda {
         uint16_t pciCmd = Pci::LegacyRead16(bus, dev, func, (uint8_t)Pci::PCI_REG_COMMAND);
         pciCmd |= Pci::PCI_CMD_INTX_DISABLE;
         Pci::LegacyWrite16(bus, dev, func, (uint8_t)Pci::PCI_REG_COMMAND, pciCmd);
+        return is64bit;
+    }
+
+    static bool SetupMsi(uint8_t bus, uint8_t dev, uint8_t func) {
+        uint8_t cap = Pci::FindCapability(bus, dev, func, Pci::PCI_CAP_MSI);
+        if (cap == 0) {
+            KernelLogStream(INFO, "HDA") << "MSI capability not found";
+            return false;
+        }
 
+        bool is64bit = ProgramMsi(bus, dev, func, cap);
         Hal::RegisterIrqHandler(MSI_IRQ, HandleInterrupt);
+        g_msiEnabled = true;
 
         KernelLogStream(OK, "HDA") << "MSI enabled: vector " << base::dec << (uint64_t)MSI_VECTOR
             << " (IRQ slot " << (uint64_t)MSI_IRQ << ")" << (is64bit ? " [64-bit]" : " [32-bit]");
@@ -834,6 +882,104 @@ namespace Drivers::Audio::IntelHda {
         return true;
     }
 
+    // =========================================================================
+    // Ring position
+    // =========================================================================
+
+    static uint32_t RingBytes() {
+        return g_stream.PeriodBytes * g_stream.PeriodCount;
+    }
+
+    static uint8_t* RingAt(uint32_t offset) {
+        return g_ringPages[offset / 0x1000] + offset % 0x1000;
+    }
+
+    static void ZeroRing() {
+        for (uint32_t i = 0; i < RING_MAX_PAGES; i++) {
+            memset(g_ringPages[i], 0, 0x1000);
+        }
+    }
+
+    // Advance hwBytes to where the controller is now, from the DMA position
+    // buffer (LPIB if the buffer reads back out of range). Called at every
+    // period interrupt, so the position never laps the ring unseen. If the
+    // controller has caught up with the application, silence the ring once
+    // so stale periods are not replayed. g_ringLock held.
+    static void SyncPositionLocked() {
+        uint32_t ringBytes = RingBytes();
+        uint32_t pos = g_dmaPos[g_stream.StreamIndex * 2];
+        if (pos >= ringBytes) pos = ReadSD32(g_stream.StreamIndex, SD_LPIB);
+        if (pos >= ringBytes) return;
+
+        uint32_t advance = (pos + ringBytes - g_stream.LinkPos) % ringBytes;
+        g_stream.LinkPos = pos;
+        if (advance == 0) return;
+
+        uint64_t hw = g_ringHeader->hwBytes + advance;
+        uint64_t app = __atomic_load_n(&g_ringHeader->appBytes, __ATOMIC_ACQUIRE);
+        if (hw > app) {
+            if (!g_stream.Dry) {
+                ZeroRing();
+                __atomic_fetch_add(&g_ringHeader->underruns, 1, __ATOMIC_RELAXED);
+                g_stream.Dry = true;
+            }
+        } else {
+            g_stream.Dry = false;
+        }
+        __atomic_store_n(&g_ringHeader->hwBytes, hw, __ATOMIC_RELEASE);
+    }
+
+    static void SyncPosition() {
+        g_ringLock.Acquire();
+        SyncPositionLocked();
+        g_ringLock.Release();
+    }
+
+    // Top the ring up from the source: everything between appBytes and a
+    // ring ahead of the controller, less a small guard. Runs after every
+    // period interrupt and once before the stream starts.
+    static void Refill() {
+        if (g_source == nullptr) return;
+
+        g_ringLock.Acquire();
+        uint32_t ringBytes = RingBytes();
+        uint64_t hw = g_ringHeader->hwBytes;
+        uint64_t app = g_ringHeader->appBytes;
+        if (app < hw) app = hw;
+
+        uint32_t space = ringBytes - (uint32_t)(app - hw);
+        space = space > 64 ? (space - 64) & ~3u : 0;
+        for (uint32_t done = 0; done < space; ) {
+            uint32_t offset = (uint32_t)((app + done) % ringBytes);
+            uint32_t chunk = 0x1000 - offset % 0x1000;
+            if (chunk > space - done) chunk = space - done;
+            g_source(RingAt(offset), chunk);
+            done += chunk;
+        }
+
+        if (space > 0) g_stream.Dry = false;
+        __atomic_store_n(&g_ringHeader->appBytes, app + space, __ATOMIC_RELEASE);
+        g_ringLock.Release();
+    }
+
+    // (Re)program the stream for the current period layout and restart the
+    // counters. The stream is left stopped.
+    static bool ConfigureRing(uint16_t fmt) {
+        g_ringLock.Acquire();
+        ZeroRing();
+        g_stream.LinkPos = 0;
+        g_stream.Dry = false;
+        g_ringHeader->hwBytes = 0;
+        g_ringHeader->appBytes = 0;
+        g_ringHeader->periodBytes = g_stream.PeriodBytes;
+        g_ringHeader->periodCount = g_stream.PeriodCount;
+        g_ringHeader->ringBytes = RingBytes();
+        g_ringHeader->ringOffset = RING_OFFSET;
+        g_ringLock.Release();
+
+        return SetupOutputStream(g_stream.StreamIndex, fmt, g_stream.PeriodBytes, g_stream.PeriodCount);
+    }
+
     // =========================================================================
     // Interrupt handler
     // =========================================================================
@@ -847,6 +993,14 @@ namespace Drivers::Audio::IntelHda {
             if (intsts & (1u << si)) {
                 uint8_t sts = ReadSD8(si, SD_STS);
                 WriteSD8(si, SD_STS, sts);
+
+                // A period finished: refill is driven from here, not from
+                // a write syscall
+                if (sts & SD_STS_BCIS) {
+                    SyncPosition();
+                    __atomic_fetch_add(&g_ringHeader->periodsDone, 1, __ATOMIC_RELEASE);
+                    Refill();
+                }
             }
         }
 
@@ -870,28 +1024,148 @@ namespace Drivers::Audio::IntelHda {
         g_bdlPhys = Memory::SubHHDM(bdlVirt);
         g_bdl = (volatile BdlEntry*)bdlVirt;
 
-        // Allocate DMA audio buffers (BUFFER_COUNT * BUFFER_SIZE = 32 KiB = 8 pages)
-        int pages = TOTAL_BUFFER_SIZE / 0x1000;
-        void* bufVirt = Memory::g_pfa->ReallocConsecutive(nullptr, pages);
-        if (!bufVirt) {
-            KernelLogStream(ERROR, "HDA") << "Failed to allocate DMA buffer (" << base::dec << pages << " pages)";
-            return false;
-        }
-        memset(bufVirt, 0, TOTAL_BUFFER_SIZE);
-        g_dmaBufferPhys = Memory::SubHHDM(bufVirt);
-        g_dmaBuffer = (uint8_t*)bufVirt;
-
-        // Allocate DMA position buffer (one page)
+        // Allocate DMA position buffer (one page). The ring itself comes
+        // with each stream (AllocateRing).
         void* posVirt = Memory::g_pfa->AllocateZeroed();
         g_dmaPosPhys = Memory::SubHHDM(posVirt);
         g_dmaPos = (volatile uint32_t*)posVirt;
 
-        KernelLogStream(OK, "HDA") << "DMA buffers allocated: " << base::dec
-            << BUFFER_COUNT << "x" << BUFFER_SIZE << " bytes";
+        KernelLogStream(OK, "HDA") << "DMA buffers allocated";
 
         return true;
     }
 
+    // Create the shared ring for a new stream, backed in full so the
+    // controller never sees a missing page
+    static bool AllocateRing() {
+        auto* object = Memory::MemObject::CreateAnonymous(RING_OFFSET + RING_MAX_BYTES);
+        if (object == nullptr) return false;
+
+        uint64_t headerPhys = object->PageAt(0);
+        for (uint32_t i = 0; i < RING_MAX_PAGES && headerPhys != 0; i++) {
+            g_ringPhys[i] = object->PageAt(1 + i);
+            if (g_ringPhys[i] == 0) headerPhys = 0;
+            else g_ringPages[i] = (uint8_t*)Memory::HHDM(g_ringPhys[i]);
+        }
+        if (headerPhys == 0) {
+            object->Release();
+            KernelLogStream(ERROR, "HDA") << "Failed to allocate output ring";
+            return false;
+        }
+
+        g_ringHeader = (Montauk::AudioRingHeader*)Memory::HHDM(headerPhys);
+        g_ringObject = object;
+        return true;
+    }
+
+    // =========================================================================
+    // Controller setup shared by probe and resume
+    // =========================================================================
+
+    static void EnableDmaPosition() {
+        Write32(REG_DPIBLBASE, (uint32_t)(g_dmaPosPhys & 0xFFFFFFFF) | 1);  // Bit 0 = enable
+        Write32(REG_DPIBUBASE, (uint32_t)(g_dmaPosPhys >> 32));
+    }
+
+    static void EnableInterrupts() {
+        uint32_t intctl = INTCTL_GIE | INTCTL_CIE;
+        // Enable interrupt for all output streams
+        for (uint8_t i = 0; i < g_numOutputStreams; i++) {
+            intctl |= (1u << (g_numInputStreams + i));
+        }
+        Write32(REG_INTCTL, intctl);
+    }
+
+    // =========================================================================
+    // S3 power hooks
+    // =========================================================================
+
+    // Stop the stream, remembering whether it ran and its format, power
+    // the codec down and stop the controller's DMA engines. The codec
+    // path (pins, volume, jack state) is already held in the driver state.
+    static void SuspendController() {
+        g_powerLock.Acquire();
+        g_savedRunning = false;
+        if (g_stream.Active) {
+            uint8_t si = g_stream.StreamIndex;
+            g_savedRunning = (ReadSD8(si, SD_CTL) & SD_CTL0_RUN) != 0;
+            g_savedFormat = ReadSD16(si, SD_FMT);
+            StopStream(si);
+        }
+
+        Write32(REG_INTCTL, 0);
+        if (g_afgNid) CodecCommand(g_codecAddr, g_afgNid, 0x70500 | 0x03);  // D3
+
+        Write8(REG_CORBCTL, 0);
+        Write8(REG_RIRBCTL, 0);
+        Write32(REG_DPIBLBASE, 0);
+        g_asleep = true;
+        g_powerLock.Release();
+    }
+
+    // The ring contents are stale after S3, and the controller restarts
+    // at ring offset 0. Silence the ring and move both counters on to the
+    // next whole ring, so they stay monotonic and line up with the
+    // controller's position again.
+    static void RestartRing() {
+        g_ringLock.Acquire();
+        ZeroRing();
+        uint32_t ringBytes = RingBytes();
+        uint64_t hw = (g_ringHeader->hwBytes + ringBytes - 1) / ringBytes * ringBytes;
+        g_ringHeader->hwBytes = hw;
+        g_ringHeader->appBytes = hw;
+        g_stream.LinkPos = 0;
+        g_stream.Dry = false;
+        g_ringLock.Release();
+    }
+
+    // Runs on its own thread once the desktop is back. The link reset
+    // also resets the codec, so every verb the driver sent is sent again.
+    static void ResumeController() {
+        g_powerLock.Acquire();
+
+        // S3 clears PCI config space
+        Pci::EnableBusMaster(g_bus, g_dev, g_func);
+        if (g_msiEnabled) {
+            uint8_t cap = Pci::FindCapability(g_bus, g_dev, g_func, Pci::PCI_CAP_MSI);
+            if (cap != 0) ProgramMsi(g_bus, g_dev, g_func, cap);
+        }
+
+        if (!ResetController()) {
+            KernelLogStream(ERROR, "HDA") << "Controller lost in S3, audio stays down";
+            g_powerLock.Release();
+            return;
+        }
+        EnableDmaPosition();
+        InitCorbRirb();
+        EnableInterrupts();
+
+        // Wait for the codec to come back on the link
+        for (int i = 0; i < 100 && !(Read16(REG_STATESTS) & (1u << g_codecAddr)); i++) {
+            MicroDelay(1000);
+        }
+        Write16(REG_STATESTS, Read16(REG_STATESTS));
+
+        if (g_afgNid) CodecCommand(g_codecAddr, g_afgNid, 0x70500 | 0x00);  // D0
+        if (g_hpNid && g_hpPresenceDetect) {
+            CodecCommand(g_codecAddr, g_hpNid, 0x70800 | (1 << 7) | 0x01);
+            g_hpPlugged = IsHpPlugged();
+        }
+
+        if (g_stream.Active) {
+            ConfigureOutputPath(g_savedFormat, g_stream.StreamTag);
+            RestartRing();
+            SetupOutputStream(g_stream.StreamIndex, g_savedFormat,
+                              g_stream.PeriodBytes, g_stream.PeriodCount);
+            Refill();
+            if (g_savedRunning) StartStream(g_stream.StreamIndex);
+        }
+
+        g_jackEventPending = false;
+        g_asleep = false;
+        g_powerLock.Release();
+    }
+
     // =========================================================================
     // Probe (called by PCI driver matching)
     // =========================================================================
@@ -952,8 +1226,7 @@ namespace Drivers::Audio::IntelHda {
         if (!AllocateDmaBuffers()) return false;
 
         // Set up DMA position buffer
-        Write32(REG_DPIBLBASE, (uint32_t)(g_dmaPosPhys & 0xFFFFFFFF) | 1);  // Bit 0 = enable
-        Write32(REG_DPIBUBASE, (uint32_t)(g_dmaPosPhys >> 32));
+        EnableDmaPosition();
 
         // Initialize CORB/RIRB
         if (!InitCorbRirb()) return false;
@@ -971,12 +1244,7 @@ namespace Drivers::Audio::IntelHda {
         }
 
         // Enable interrupts
-        uint32_t intctl = INTCTL_GIE | INTCTL_CIE;
-        // Enable interrupt for all output streams
-        for (uint8_t i = 0; i < g_numOutputStreams; i++) {
-            intctl |= (1u << (g_numInputStreams + i));
-        }
-        Write32(REG_INTCTL, intctl);
+        EnableInterrupts();
 
         // Discover codecs
         if (!DiscoverCodecs()) return false;
@@ -992,6 +1260,8 @@ namespace Drivers::Audio::IntelHda {
         }
 
         g_initialized = true;
+        Hal::AcpiSleep::RegisterDevice({"HDA", SuspendController, ResumeController,
+                                        Hal::AcpiSleep::ResumeStage::Deferred});
         KernelLogStream(OK, "HDA") << "Intel HDA initialized successfully";
 
         return true;
@@ -1009,12 +1279,17 @@ namespace Drivers::Audio::IntelHda {
         return g_codecVendorId;
     }
 
-    int Open(uint32_t sampleRate, uint8_t channels, uint8_t bitsPerSample) {
-        if (!g_initialized) return -1;
+    static bool ValidPeriods(uint32_t periodBytes, uint32_t periodCount) {
+        if (periodBytes < Montauk::AUDIO_PERIOD_MIN_BYTES || periodBytes % 128 != 0) return false;
+        if (periodCount < Montauk::AUDIO_PERIODS_MIN || periodCount > Montauk::AUDIO_PERIODS_MAX) return false;
+        return (uint64_t)periodBytes * periodCount <= RING_MAX_BYTES;
+    }
+
+    // g_powerLock held
+    static int OpenLocked(uint32_t sampleRate, uint8_t channels, uint8_t bitsPerSample,
+                          uint32_t periodBytes, uint32_t periodCount) {
+        if (g_asleep) return -1;
         if (g_stream.Active) return -1;  // Only one stream at a time
-        if (channels < 1 || channels > 8) return -1;
-        if (bitsPerSample != 8 && bitsPerSample != 16 && bitsPerSample != 20
-            && bitsPerSample != 24 && bitsPerSample != 32) return -1;
 
         // Output stream index = numInputStreams (first output stream)
         uint8_t streamIndex = g_numInputStreams;
@@ -1023,25 +1298,30 @@ namespace Drivers::Audio::IntelHda {
         // Encode the stream format
         uint16_t fmt = EncodeFormat(sampleRate, channels, bitsPerSample);
 
+        if (!AllocateRing()) return -1;
+
         // Configure the codec output path
         ConfigureOutputPath(fmt, streamTag);
 
-        // Set up the output stream DMA
-        if (!SetupOutputStream(streamIndex, fmt)) return -1;
-
-        // Zero the DMA buffer
-        memset(g_dmaBuffer, 0, TOTAL_BUFFER_SIZE);
-
         // Record stream state
-        g_stream.Active = true;
         g_stream.SampleRate = sampleRate;
         g_stream.Channels = channels;
         g_stream.BitsPerSample = bitsPerSample;
         g_stream.StreamIndex = streamIndex;
         g_stream.StreamTag = streamTag;
-        g_stream.WritePos = 0;
+        g_stream.PeriodBytes = periodBytes;
+        g_stream.PeriodCount = periodCount;
 
-        // Start the stream
+        // Set up the output stream DMA
+        if (!ConfigureRing(fmt)) {
+            g_ringObject->Release();
+            g_ringObject = nullptr;
+            return -1;
+        }
+        g_stream.Active = true;
+
+        // Start the stream with the ring full
+        Refill();
         StartStream(streamIndex);
 
         KernelLogStream(OK, "HDA") << "Stream opened: " << base::dec
@@ -1051,23 +1331,58 @@ namespace Drivers::Audio::IntelHda {
         return 0;  // Handle 0
     }
 
+    int Open(uint32_t sampleRate, uint8_t channels, uint8_t bitsPerSample,
+             uint32_t periodBytes, uint32_t periodCount) {
+        if (!g_initialized) return -1;
+        if (channels < 1 || channels > 8) return -1;
+        if (bitsPerSample != 8 && bitsPerSample != 16 && bitsPerSample != 20
+            && bitsPerSample != 24 && bitsPerSample != 32) return -1;
+        if (!ValidPeriods(periodBytes, periodCount)) return -1;
+
+        g_powerLock.Acquire();
+        int result = OpenLocked(sampleRate, channels, bitsPerSample, periodBytes, periodCount);
+        g_powerLock.Release();
+        return result;
+    }
+
     void Close(int handle) {
-        if (handle != 0 || !g_stream.Active) return;
+        if (handle != 0) return;
 
-        StopStream(g_stream.StreamIndex);
+        g_powerLock.Acquire();
+        if (!g_stream.Active) {
+            g_powerLock.Release();
+            return;
+        }
 
-        // Mute output
-        CodecCommand(g_codecAddr, g_dacNid,
-            0x30000 | AMP_SET_OUTPUT | AMP_SET_LEFT | AMP_SET_RIGHT | AMP_MUTE);
+        // Asleep, the stream is already stopped and the codec powered down
+        if (!g_asleep) {
+            StopStream(g_stream.StreamIndex);
+
+            // Mute output
+            CodecCommand(g_codecAddr, g_dacNid,
+                0x30000 | AMP_SET_OUTPUT | AMP_SET_LEFT | AMP_SET_RIGHT | AMP_MUTE);
+        }
 
         g_stream.Active = false;
+        g_ringObject->Release();
+        g_ringObject = nullptr;
+        g_powerLock.Release();
 
         KernelLogStream(OK, "HDA") << "Stream closed";
     }
 
-    int Write(int handle, const uint8_t* data, uint32_t size) {
-        if (handle != 0 || !g_stream.Active || !data || size == 0)
-            return -1;
+    void SetSource(SourceFn fill) {
+        g_source = fill;
+    }
+
+    void Service() {
+        if (!g_stream.Active) return;
+
+        g_powerLock.Acquire();
+        if (g_asleep) {
+            g_powerLock.Release();
+            return;
+        }
 
         // Drain unsolicited responses from the RIRB — during playback no
         // CodecCommands are sent, so ReadResponse() never runs and jack
@@ -1083,47 +1398,34 @@ namespace Drivers::Audio::IntelHda {
                 PollJackState();
             }
         }
+        g_powerLock.Release();
+    }
 
-        // Get current hardware playback position from DMA position buffer
-        // Each stream's position is at dmaPos[streamIndex * 2]
-        uint32_t hwPos = g_dmaPos[g_stream.StreamIndex * 2];
-        uint32_t writePos = g_stream.WritePos;
-
-        // Calculate available space in the ring buffer
-        uint32_t available;
-        if (writePos >= hwPos) {
-            available = TOTAL_BUFFER_SIZE - (writePos - hwPos);
-        } else {
-            available = hwPos - writePos;
-        }
-
-        // Leave a small gap to avoid write pointer catching up to read pointer
-        if (available > 64) available -= 64;
-        else available = 0;
-
-        if (size > available) size = available;
-        if (size == 0) return 0;
-
-        // Write data to DMA buffer (handle wrap-around)
-        uint32_t firstChunk = TOTAL_BUFFER_SIZE - writePos;
-        if (firstChunk > size) firstChunk = size;
+    // Change the period layout of the open stream, keeping it running if
+    // it was
+    static int Reconfigure(uint32_t periodBytes, uint32_t periodCount) {
+        if (!ValidPeriods(periodBytes, periodCount)) return -1;
 
-        memcpy(g_dmaBuffer + writePos, data, firstChunk);
-        if (size > firstChunk) {
-            memcpy(g_dmaBuffer, data + firstChunk, size - firstChunk);
-        }
+        uint8_t si = g_stream.StreamIndex;
+        bool running = (ReadSD8(si, SD_CTL) & SD_CTL0_RUN) != 0;
+        uint16_t fmt = ReadSD16(si, SD_FMT);
+        StopStream(si);
 
-        g_stream.WritePos = (writePos + size) % TOTAL_BUFFER_SIZE;
+        g_stream.PeriodBytes = periodBytes;
+        g_stream.PeriodCount = periodCount;
+        if (!ConfigureRing(fmt)) return -1;
 
-        return (int)size;
+        Refill();
+        if (running) StartStream(si);
+        return 0;
     }
 
-    int Control(int handle, int cmd, int value) {
-        if (handle != 0) return -1;
-
+    // g_powerLock held. Asleep, the volume and pause state are only
+    // recorded, for the resume to apply.
+    static int ControlLocked(int cmd, int value) {
         switch (cmd) {
             case AUDIO_CTL_SET_VOLUME:
-                if (!g_initialized) { g_volume = value; return 0; }
+                if (!g_initialized || g_asleep) { g_volume = value; return 0; }
                 SetOutputVolume(value);
                 return 0;
 
@@ -1132,19 +1434,39 @@ namespace Drivers::Audio::IntelHda {
 
             case AUDIO_CTL_GET_POS:
                 if (!g_stream.Active) return 0;
-                return (int)g_dmaPos[g_stream.StreamIndex * 2];
+                if (!g_asleep) SyncPosition();
+                return (int)(g_ringHeader->hwBytes % RingBytes());
 
             case AUDIO_CTL_PAUSE:
                 if (!g_stream.Active) return -1;
-                if (value)
+                if (g_asleep)
+                    g_savedRunning = !value;
+                else if (value)
                     StopStream(g_stream.StreamIndex);
                 else
                     StartStream(g_stream.StreamIndex);
                 return 0;
 
+            case AUDIO_CTL_SET_PERIOD_BYTES:
+                if (!g_stream.Active || g_asleep || value <= 0) return -1;
+                return Reconfigure((uint32_t)value, g_stream.PeriodCount);
+
+            case AUDIO_CTL_SET_PERIODS:
+                if (!g_stream.Active || g_asleep || value <= 0) return -1;
+                return Reconfigure(g_stream.PeriodBytes, (uint32_t)value);
+
             default:
                 return -1;
         }
     }
 
+    int Control(int handle, int cmd, int value) {
+        if (handle != 0) return -1;
+
+        g_powerLock.Acquire();
+        int result = ControlLocked(cmd, value);
+        g_powerLock.Release();
+        return result;
+    }
+
 };
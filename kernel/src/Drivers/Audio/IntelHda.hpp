@@ -7,6 +7,7 @@
 #pragma once
 #include <cstdint>
 #include <Pci/Pci.hpp>
+#include <Api/Syscall.hpp>
 
 namespace Drivers::Audio::IntelHda {
 
@@ -224,12 +225,22 @@ namespace Drivers::Audio::IntelHda {
     constexpr int BDL_MAX_ENTRIES     = 256;   // Max BDL entries per stream
 
     // =========================================================================
-    // DMA buffer configuration
+    // Output ring configuration
     // =========================================================================
 
-    constexpr int BUFFER_COUNT        = 2;     // Double-buffered
-    constexpr int BUFFER_SIZE         = 0x4000; // 16 KiB per buffer segment
-    constexpr int TOTAL_BUFFER_SIZE   = BUFFER_COUNT * BUFFER_SIZE;
+    // The ring is split into periods; the controller interrupts after each
+    // one. Streams open with the defaults and can be reconfigured through
+    // AUDIO_CTL_SET_PERIOD_BYTES / AUDIO_CTL_SET_PERIODS within the limits
+    // in Api/Syscall.hpp.
+    constexpr uint32_t DEFAULT_PERIOD_COUNT = 2;
+    constexpr uint32_t DEFAULT_PERIOD_BYTES = 0x4000;  // 16 KiB
+    constexpr uint32_t RING_MAX_BYTES       = Montauk::AUDIO_RING_MAX_BYTES;
+    constexpr uint32_t RING_MAX_PAGES       = RING_MAX_BYTES / 0x1000;
+    constexpr uint32_t RING_OFFSET          = 0x1000;  // Header page first
+
+    static_assert(DEFAULT_PERIOD_COUNT * DEFAULT_PERIOD_BYTES <= RING_MAX_BYTES);
+    static_assert(RING_MAX_PAGES + Montauk::AUDIO_PERIODS_MAX <= BDL_MAX_ENTRIES,
+                  "every period split at page boundaries must fit the BDL");
 
     // =========================================================================
     // MSI configuration
@@ -250,7 +261,10 @@ namespace Drivers::Audio::IntelHda {
         uint8_t     BitsPerSample;
         uint8_t     StreamIndex;     // HDA stream index
         uint8_t     StreamTag;       // HDA stream tag (1-15)
-        volatile uint32_t WritePos;  // Write position in ring buffer (bytes)
+        uint32_t    PeriodBytes;
+        uint32_t    PeriodCount;
+        uint32_t    LinkPos;         // Ring position last read from the controller
+        bool        Dry;             // Ran past the application's data, ring silenced
     };
 
     // =========================================================================
@@ -264,21 +278,30 @@ namespace Drivers::Audio::IntelHda {
     // Returns 0 if no codec was found.
     uint32_t GetCodecVendorId();
 
-    // Open an output stream. Returns stream handle (0) or -1 on failure.
-    int Open(uint32_t sampleRate, uint8_t channels, uint8_t bitsPerSample);
+    // Open the output stream with `periodCount` periods of `periodBytes`.
+    // Returns stream handle (0) or -1 on failure.
+    int Open(uint32_t sampleRate, uint8_t channels, uint8_t bitsPerSample,
+             uint32_t periodBytes = DEFAULT_PERIOD_BYTES, uint32_t periodCount = DEFAULT_PERIOD_COUNT);
 
     // Close an output stream.
     void Close(int handle);
 
-    // Write PCM sample data to the stream buffer.
-    // Returns number of bytes written (may be less than requested if buffer full).
-    int Write(int handle, const uint8_t* data, uint32_t size);
+    // Where the stream's PCM comes from: called with interrupts disabled,
+    // from the period interrupt, to fill `bytes` at `dst` (a multiple of 4,
+    // never crossing a page). Set before Open.
+    using SourceFn = void (*)(uint8_t* dst, uint32_t bytes);
+    void SetSource(SourceFn fill);
+
+    // Periodic work in process context while a stream is open (jack sense)
+    void Service();
 
     // Control commands
-    constexpr int AUDIO_CTL_SET_VOLUME = 0;   // value: 0-100
-    constexpr int AUDIO_CTL_GET_VOLUME = 1;
-    constexpr int AUDIO_CTL_GET_POS    = 2;   // returns playback position in bytes
-    constexpr int AUDIO_CTL_PAUSE      = 3;   // value: 1=pause, 0=resume
+    constexpr int AUDIO_CTL_SET_VOLUME       = 0;   // value: 0-100
+    constexpr int AUDIO_CTL_GET_VOLUME       = 1;
+    constexpr int AUDIO_CTL_GET_POS          = 2;   // returns playback position in the ring (bytes)
+    constexpr int AUDIO_CTL_PAUSE            = 3;   // value: 1=pause, 0=resume
+    constexpr int AUDIO_CTL_SET_PERIOD_BYTES = 7;   // value: bytes per period
+    constexpr int AUDIO_CTL_SET_PERIODS      = 8;   // value: number of periods
     int Control(int handle, int cmd, int value);
 
 };
@@ -0,0 +1,529 @@
+/*
+    * Mixer.cpp
+    * Kernel audio mixer: many client streams onto the HDA and A2DP sinks
+    * Copyright (c) 2026 Daniel Hammer
+*/
+
+#include "Mixer.hpp"
+#include "IntelHda.hpp"
+#include <Drivers/USB/Bluetooth/Bluetooth.hpp>
+#include <Drivers/USB/Bluetooth/A2dp.hpp>
+#include <Memory/MemObject.hpp>
+#include <Memory/HHDM.hpp>
+#include <Sched/Scheduler.hpp>
+#include <Timekeeping/ApicTimer.hpp>
+#include <CppLib/Spinlock.hpp>
+#include <Libraries/Memory.hpp>
+
+namespace Drivers::Audio::Mixer {
+
+    namespace A2dp = Drivers::USB::Bluetooth::A2dp;
+
+    // Each client writes into its own ring, the same AudioRingHeader
+    // protocol as a mapped ring (Api/Syscall.hpp): the client advances
+    // appBytes, the mixer advances hwBytes and never reads past appBytes.
+    //
+    // With an HDA controller the mixer runs in its period interrupt and
+    // fills the hardware ring directly. Without one the Bluetooth sink is
+    // clocked from the timer, mixing whatever is due whenever a client
+    // makes an audio syscall.
+    //
+    // The kernel is built without SSE (and #NM from ring 0 panics), so the
+    // resampler and mix are integer code: 16.16 linear interpolation,
+    // 32-bit accumulators and one saturation per output sample.
+
+    static constexpr uint32_t RING_MAX_PAGES = Montauk::AUDIO_RING_MAX_BYTES / 0x1000;
+    static constexpr uint32_t RING_OFFSET    = 0x1000;
+    static constexpr uint32_t FRAC_ONE       = 1u << 16;
+    static constexpr uint32_t MIX_CHUNK      = 128;     // Frames per pass (accumulators on the stack)
+
+    struct Stream {
+        bool used;
+        bool paused;
+        bool starved;                    // Ran out of client data, underrun counted
+        int tgid;                        // Owning process
+        uint32_t sampleRate;
+        uint8_t channels;
+        uint8_t bitsPerSample;
+        uint32_t frameBytes;
+        int volume;                      // 0-100
+        int32_t gain;                    // volume in Q15
+
+        // Resampler: output lies `frac` of the way from cur to nxt
+        uint32_t step;                   // Source frames per output frame (16.16)
+        uint32_t frac;
+        int32_t cur[2];
+        int32_t nxt[2];
+
+        Memory::MemObject* object;       // The mixer's own reference
+        Montauk::AudioRingHeader* header;
+        uint8_t* pages[RING_MAX_PAGES];  // Kernel aliases of the ring pages
+    };
+
+    static Stream g_streams[MAX_STREAMS];
+    static int g_streamCount = 0;
+
+    // g_mixLock guards the stream table and resampler state against the
+    // period interrupt. g_openLock serializes opening and closing, which
+    // bring the sinks up and down.
+    static kcp::Spinlock g_mixLock;
+    static kcp::Mutex g_openLock;
+
+    static bool g_hdaOpen = false;
+    static bool g_btActive = false;
+
+    // Mixed output for A2DP, drained in process context (the encoder
+    // sends over USB and cannot run in the interrupt)
+    static uint8_t g_btFifo[BT_FIFO_BYTES];
+    static uint32_t g_btHead = 0;        // Written by the mixer
+    static uint32_t g_btTail = 0;        // Consumed by the encoder
+    static kcp::Mutex g_btDrainLock;
+
+    // Timer clock for the Bluetooth sink when there is no HDA interrupt
+    static uint64_t g_btClockStartMs = 0;
+    static uint64_t g_btFramesMixed = 0;
+
+    static Stream* Lookup(int handle) {
+        if (handle < 1 || handle > MAX_STREAMS) return nullptr;
+        Stream* s = &g_streams[handle - 1];
+        return s->used ? s : nullptr;
+    }
+
+    // =========================================================================
+    // Resampling and mixing
+    // =========================================================================
+
+    // Read the client frame at `pos` as two 16-bit samples. The ring size
+    // is a multiple of 128 and frames are 1, 2 or 4 bytes, so a frame
+    // never straddles a page.
+    static void ReadFrame(const Stream& s, uint64_t pos, int32_t frame[2]) {
+        uint32_t offset = (uint32_t)(pos % s.header->ringBytes);
+        const uint8_t* p = s.pages[offset / 0x1000] + offset % 0x1000;
+
+        if (s.bitsPerSample == 8) {
+            frame[0] = ((int32_t)p[0] - 128) << 8;
+            frame[1] = s.channels == 2 ? ((int32_t)p[1] - 128) << 8 : frame[0];
+        } else {
+            const int16_t* q = (const int16_t*)p;
+            frame[0] = q[0];
+            frame[1] = s.channels == 2 ? q[1] : frame[0];
+        }
+    }
+
+    // Add `frames` output frames of stream `s` into `acc`, consuming its
+    // ring as far as the resampler needs. g_mixLock held.
+    static void MixStream(Stream& s, int32_t* acc, uint32_t frames) {
+        Montauk::AudioRingHeader* hdr = s.header;
+        uint64_t start = hdr->hwBytes;
+        uint64_t pos = start;
+        uint64_t app = __atomic_load_n(&hdr->appBytes, __ATOMIC_ACQUIRE);
+
+        for (uint32_t i = 0; i < frames; i++) {
+            while (s.frac >= FRAC_ONE) {
+                if (app - pos < s.frameBytes) {
+                    // Count one underrun per dry spell, not the wait for
+                    // the first write
+                    if (!s.starved && pos > 0) {
+                        __atomic_fetch_add(&hdr->underruns, 1, __ATOMIC_RELAXED);
+                    }
+                    s.starved = true;
+                    goto done;
+                }
+                s.cur[0] = s.nxt[0];
+                s.cur[1] = s.nxt[1];
+                ReadFrame(s, pos, s.nxt);
+                pos += s.frameBytes;
+                s.frac -= FRAC_ONE;
+                s.starved = false;
+            }
+
+            int32_t l = s.cur[0] + (int32_t)(((int64_t)(s.nxt[0] - s.cur[0]) * s.frac) >> 16);
+            int32_t r = s.cur[1] + (int32_t)(((int64_t)(s.nxt[1] - s.cur[1]) * s.frac) >> 16);
+            acc[i * 2]     += (l * s.gain) >> 15;
+            acc[i * 2 + 1] += (r * s.gain) >> 15;
+            s.frac += s.step;
+        }
+
+    done:
+        if (pos == start) return;
+        __atomic_store_n(&hdr->hwBytes, pos, __ATOMIC_RELEASE);
+
+        uint32_t periods = (uint32_t)(pos / hdr->periodBytes - start / hdr->periodBytes);
+        if (periods > 0) {
+            __atomic_fetch_add(&hdr->periodsDone, periods, __ATOMIC_RELEASE);
+            Sched::WakeAddress(&hdr->periodsDone, 0x7FFFFFFF);
+        }
+    }
+
+    static void BtFifoPush(const uint8_t* data, uint32_t bytes) {
+        if (BT_FIFO_BYTES - (g_btHead - g_btTail) < bytes) return;  // Encoder behind: drop
+        for (uint32_t i = 0; i < bytes; i++) {
+            g_btFifo[(g_btHead + i) % BT_FIFO_BYTES] = data[i];
+        }
+        __atomic_store_n(&g_btHead, g_btHead + bytes, __ATOMIC_RELEASE);
+    }
+
+    // Mix `frames` frames of 16-bit stereo into `out`. g_mixLock held.
+    static void MixLocked(int16_t* out, uint32_t frames) {
+        int32_t acc[MIX_CHUNK * 2];
+
+        while (frames > 0) {
+            uint32_t n = frames < MIX_CHUNK ? frames : MIX_CHUNK;
+            memset(acc, 0, n * 2 * sizeof(int32_t));
+
+            for (int i = 0; i < MAX_STREAMS; i++) {
+                Stream& s = g_streams[i];
+                if (s.used && !s.paused) MixStream(s, acc, n);
+            }
+
+            for (uint32_t i = 0; i < n * 2; i++) {
+                int32_t v = acc[i];
+                if (v > 32767) v = 32767;
+                else if (v < -32768) v = -32768;
+                out[i] = (int16_t)v;
+            }
+
+            if (g_btActive) BtFifoPush((const uint8_t*)out, n * MIX_FRAME_BYTES);
+            out += n * 2;
+            frames -= n;
+        }
+    }
+
+    // IntelHda source: runs in the period interrupt
+    static void FillHardware(uint8_t* dst, uint32_t bytes) {
+        g_mixLock.Acquire();
+        MixLocked((int16_t*)dst, bytes / MIX_FRAME_BYTES);
+        g_mixLock.Release();
+    }
+
+    // =========================================================================
+    // Process-context work
+    // =========================================================================
+
+    // Hand mixed output to the A2DP encoder. With no HDA interrupt to
+    // drive the mixer, first mix whatever the timer says is due (at most
+    // 100 ms, so a long gap does not come back as a burst).
+    static void Pump() {
+        if (g_hdaOpen) Drivers::Audio::IntelHda::Service();
+        if (!g_btActive) return;
+
+        g_btDrainLock.Acquire();
+
+        if (!g_hdaOpen) {
+            uint64_t elapsed = Timekeeping::GetMilliseconds() - g_btClockStartMs;
+            uint64_t due = elapsed * MIX_RATE / 1000 - g_btFramesMixed;
+            if (due > MIX_RATE / 10) {
+                g_btFramesMixed += due - MIX_RATE / 10;
+                due = MIX_RATE / 10;
+            }
+
+            int16_t buf[MIX_CHUNK * 2];
+            while (due > 0) {
+                uint32_t room = (BT_FIFO_BYTES - (g_btHead - g_btTail)) / MIX_FRAME_BYTES;
+                uint32_t n = due < MIX_CHUNK ? (uint32_t)due : MIX_CHUNK;
+                if (n > room) break;
+                g_mixLock.Acquire();
+                MixLocked(buf, n);
+                g_mixLock.Release();
+                g_btFramesMixed += n;
+                due -= n;
+            }
+        }
+
+        // WriteAudio takes whole SBC frames, several to a media packet;
+        // the rest waits for next time. The drain lock guards the chunk.
+        static uint8_t chunk[BT_FIFO_BYTES / 2];
+        for (;;) {
+            uint32_t tail = g_btTail;
+            uint32_t avail = __atomic_load_n(&g_btHead, __ATOMIC_ACQUIRE) - tail;
+            if (avail > sizeof(chunk)) avail = sizeof(chunk);
+            if (avail == 0) break;
+
+            for (uint32_t i = 0; i < avail; i++) {
+                chunk[i] = g_btFifo[(tail + i) % BT_FIFO_BYTES];
+            }
+            int used = A2dp::WriteAudio(chunk, avail);
+            if (used < 0) {
+                // Link gone: drop what is queued
+                __atomic_store_n(&g_btTail, g_btHead, __ATOMIC_RELEASE);
+                break;
+            }
+            if (used == 0) break;
+            __atomic_store_n(&g_btTail, tail + (uint32_t)used, __ATOMIC_RELEASE);
+        }
+
+        g_btDrainLock.Release();
+    }
+
+    static bool BluetoothReady() {
+        if (!Drivers::USB::Bluetooth::IsInitialized()) return false;
+        auto state = A2dp::GetState();
+        return state == A2dp::State::Open || state == A2dp::State::Streaming
+            || state == A2dp::State::Configured;
+    }
+
+    // Bring the sinks up for the first stream. g_openLock held.
+    static bool StartSinks() {
+        if (Drivers::Audio::IntelHda::IsInitialized()) {
+            Drivers::Audio::IntelHda::SetSource(FillHardware);
+            g_hdaOpen = Drivers::Audio::IntelHda::Open(MIX_RATE, 2, 16, HW_PERIOD_BYTES, HW_PERIODS) >= 0;
+        }
+
+        if (BluetoothReady()) {
+            A2dp::ConfigureStream(MIX_RATE, 2, 16);
+            A2dp::StartStream();
+            g_btHead = g_btTail = 0;
+            g_btClockStartMs = Timekeeping::GetMilliseconds();
+            g_btFramesMixed = 0;
+            g_btActive = true;
+        }
+
+        return g_hdaOpen || g_btActive;
+    }
+
+    static void StopSinks() {
+        if (g_hdaOpen) Drivers::Audio::IntelHda::Close(0);
+        if (g_btActive) A2dp::StopStream();
+        g_hdaOpen = false;
+        g_btActive = false;
+    }
+
+    // Reset a stream's ring to `periodCount` periods of `periodBytes`.
+    // g_mixLock held.
+    static void ResetRingLocked(Stream& s, uint32_t periodBytes, uint32_t periodCount) {
+        Montauk::AudioRingHeader* hdr = s.header;
+        hdr->hwBytes = 0;
+        hdr->appBytes = 0;
+        hdr->periodBytes = periodBytes;
+        hdr->periodCount = periodCount;
+        hdr->ringBytes = periodBytes * periodCount;
+        hdr->ringOffset = RING_OFFSET;
+
+        s.frac = 2 * FRAC_ONE;  // Load two frames before the first output
+        s.cur[0] = s.cur[1] = 0;
+        s.nxt[0] = s.nxt[1] = 0;
+        s.starved = false;
+    }
+
+    // Drop streams whose process exited without closing them.
+    // g_openLock held.
+    static void ReapStreamsLocked() {
+        for (int i = 0; i < MAX_STREAMS; i++) {
+            Stream& s = g_streams[i];
+            if (!s.used || Sched::IsAlive(s.tgid)) continue;
+
+            g_mixLock.Acquire();
+            s.used = false;
+            g_mixLock.Release();
+
+            s.object->Release();
+            s.object = nullptr;
+            g_streamCount--;
+        }
+        if (g_streamCount == 0) StopSinks();
+    }
+
+    // =========================================================================
+    // Public API
+    // =========================================================================
+
+    int Open(uint32_t sampleRate, uint8_t channels, uint8_t bitsPerSample) {
+        if (sampleRate < 8000 || sampleRate > 192000) return -1;
+        if (channels < 1 || channels > 2) return -1;
+        if (bitsPerSample != 8 && bitsPerSample != 16) return -1;
+
+        auto* proc = Sched::GetCurrentProcessPtr();
+        if (proc == nullptr) return -1;
+
+        g_openLock.Acquire();
+        ReapStreamsLocked();
+
+        int slot = -1;
+        for (int i = 0; i < MAX_STREAMS && slot < 0; i++) {
+            if (!g_streams[i].used) slot = i;
+        }
+        if (slot < 0) {
+            g_openLock.Release();
+            return -1;
+        }
+
+        // Back the ring in full: the interrupt handler must never fault
+        auto* object = Memory::MemObject::CreateAnonymous(RING_OFFSET + Montauk::AUDIO_RING_MAX_BYTES);
+        if (object == nullptr) {
+            g_openLock.Release();
+            return -1;
+        }
+        Stream& s = g_streams[slot];
+        uint64_t headerPhys = object->PageAt(0);
+        for (uint32_t i = 0; i < RING_MAX_PAGES && headerPhys != 0; i++) {
+            uint64_t phys = object->PageAt(1 + i);
+            if (phys == 0) headerPhys = 0;
+            else s.pages[i] = (uint8_t*)Memory::HHDM(phys);
+        }
+        if (headerPhys == 0 || (g_streamCount == 0 && !StartSinks())) {
+            object->Release();
+            g_openLock.Release();
+            return -1;
+        }
+
+        s.tgid = proc->pid;
+        s.sampleRate = sampleRate;
+        s.channels = channels;
+        s.bitsPerSample = bitsPerSample;
+        s.frameBytes = channels * (bitsPerSample / 8);
+        s.volume = 100;
+        s.gain = 1 << 15;
+        s.step = (uint32_t)(((uint64_t)sampleRate << 16) / MIX_RATE);
+        s.paused = false;
+        s.object = object;
+        s.header = (Montauk::AudioRingHeader*)Memory::HHDM(headerPhys);
+        s.header->periodsDone = 0;
+        s.header->underruns = 0;
+
+        g_mixLock.Acquire();
+        ResetRingLocked(s, STREAM_PERIOD_BYTES, STREAM_PERIODS);
+        s.used = true;
+        g_mixLock.Release();
+
+        g_streamCount++;
+        g_openLock.Release();
+        return slot + 1;
+    }
+
+    void Close(int handle) {
+        g_openLock.Acquire();
+        Stream* s = Lookup(handle);
+        if (s == nullptr) {
+            g_openLock.Release();
+            return;
+        }
+
+        g_mixLock.Acquire();
+        s->used = false;
+        g_mixLock.Release();
+
+        // Let period waiters see the stream is gone. A process that mapped
+        // the ring keeps its pages until it unmaps them.
+        Sched::WakeAddress(&s->header->periodsDone, 0x7FFFFFFF);
+        s->object->Release();
+        s->object = nullptr;
+
+        if (--g_streamCount == 0) StopSinks();
+        g_openLock.Release();
+    }
+
+    int Write(int handle, const uint8_t* data, uint32_t size) {
+        Stream* s = Lookup(handle);
+        if (s == nullptr || data == nullptr || size == 0) return -1;
+
+        Pump();
+
+        // Same protocol as a writer on the mapped ring
+        Montauk::AudioRingHeader* hdr = s->header;
+        uint32_t ringBytes = hdr->ringBytes;
+        uint64_t hw = __atomic_load_n(&hdr->hwBytes, __ATOMIC_ACQUIRE);
+        uint64_t app = hdr->appBytes;
+
+        uint32_t available = ringBytes - (uint32_t)(app - hw);
+        if (size > available) size = available;
+        if (size == 0) return 0;
+
+        // Copy page by page; the user buffer may fault, so not under a lock
+        for (uint32_t done = 0; done < size; ) {
+            uint32_t offset = (uint32_t)((app + done) % ringBytes);
+            uint32_t chunk = 0x1000 - offset % 0x1000;
+            if (chunk > size - done) chunk = size - done;
+            memcpy(s->pages[offset / 0x1000] + offset % 0x1000, data + done, chunk);
+            done += chunk;
+        }
+
+        __atomic_store_n(&hdr->appBytes, app + size, __ATOMIC_RELEASE);
+        return (int)size;
+    }
+
+    Memory::MemObject* AcquireRing(int handle) {
+        g_openLock.Acquire();
+        Stream* s = Lookup(handle);
+        if (s) s->object->Retain();
+        g_openLock.Release();
+        return s ? s->object : nullptr;
+    }
+
+    bool UsingBluetooth() {
+        return g_btActive;
+    }
+
+    // Reshape a stream's ring. Whatever was queued is dropped.
+    static int SetPeriods(Stream* s, uint32_t periodBytes, uint32_t periodCount) {
+        if (periodBytes < Montauk::AUDIO_PERIOD_MIN_BYTES || periodBytes % 128 != 0) return -1;
+        if (periodCount < Montauk::AUDIO_PERIODS_MIN || periodCount > Montauk::AUDIO_PERIODS_MAX) return -1;
+        if ((uint64_t)periodBytes * periodCount > Montauk::AUDIO_RING_MAX_BYTES) return -1;
+
+        g_mixLock.Acquire();
+        ResetRingLocked(*s, periodBytes, periodCount);
+        g_mixLock.Release();
+        return 0;
+    }
+
+    int Control(int handle, int cmd, int value) {
+        Stream* s = Lookup(handle);
+        if (s == nullptr) return -1;
+
+        switch (cmd) {
+            case Montauk::AUDIO_CTL_SET_VOLUME:
+                if (value < 0) value = 0;
+                if (value > 100) value = 100;
+                s->volume = value;
+                s->gain = (value << 15) / 100;
+                return 0;
+
+            case Montauk::AUDIO_CTL_GET_VOLUME:
+                return s->volume;
+
+            case Montauk::AUDIO_CTL_GET_POS:
+                Pump();
+                return (int)(s->header->hwBytes % s->header->ringBytes);
+
+            case Montauk::AUDIO_CTL_PAUSE:
+                s->paused = value != 0;
+                return 0;
+
+            case Montauk::AUDIO_CTL_SET_PERIOD_BYTES:
+                if (value <= 0) return -1;
+                return SetPeriods(s, (uint32_t)value, s->header->periodCount);
+
+            case Montauk::AUDIO_CTL_SET_PERIODS:
+                if (value <= 0) return -1;
+                return SetPeriods(s, s->header->periodBytes, (uint32_t)value);
+
+            case Montauk::AUDIO_CTL_WAIT_PERIOD: {
+                // Block until periodsDone moves past the count the caller
+                // last saw. Not while paused: nothing would end the wait.
+                if (s->paused) return -1;
+                Memory::MemObject* ring = AcquireRing(handle);
+                if (ring == nullptr) return -1;
+                volatile uint32_t* word = &s->header->periodsDone;
+
+                if (g_hdaOpen) {
+                    Pump();
+                    Sched::WaitOnAddress(word, (uint32_t)value);
+                } else {
+                    // Timer-clocked: mix on the caller's time
+                    while (s->used && *word == (uint32_t)value) {
+                        Pump();
+                        if (*word != (uint32_t)value) break;
+                        Sched::BlockForSleep(2);
+                    }
+                }
+
+                uint32_t done = __atomic_load_n(word, __ATOMIC_ACQUIRE);
+                ring->Release();
+                return (int)done;
+            }
+
+            default:
+                return -1;
+        }
+    }
+
+};
@@ -0,0 +1,66 @@
+/*
+    * Mixer.hpp
+    * Kernel audio mixer: many client streams onto the HDA and A2DP sinks
+    * Copyright (c) 2026 Daniel Hammer
+*/
+
+#pragma once
+#include <cstdint>
+#include <Api/Syscall.hpp>
+
+namespace Memory { class MemObject; }
+
+namespace Drivers::Audio::Mixer {
+
+    // =========================================================================
+    // Configuration
+    // =========================================================================
+
+    // Everything is mixed to 16-bit stereo at MIX_RATE; clients at other
+    // rates are resampled. Most sources (MP3, DOOM, the game engine) are
+    // 44.1 kHz already.
+    constexpr uint32_t MIX_RATE          = 44100;
+    constexpr uint32_t MIX_FRAME_BYTES   = 4;
+
+    // HDA output ring: 4 x 256 frames (~23 ms), mixed a period at a time
+    // from the period interrupt
+    constexpr uint32_t HW_PERIOD_BYTES   = 1024;
+    constexpr uint32_t HW_PERIODS        = 4;
+
+    // Handle 0 is the device itself (master volume, routing); streams are
+    // 1 .. MAX_STREAMS
+    constexpr int DEVICE_HANDLE          = 0;
+    constexpr int MAX_STREAMS            = 15;
+
+    // Client rings start as 4 x 4 KiB and can be reshaped per stream
+    constexpr uint32_t STREAM_PERIOD_BYTES = 0x1000;
+    constexpr uint32_t STREAM_PERIODS      = 4;
+
+    // Mixed output waiting for the Bluetooth encoder
+    constexpr uint32_t BT_FIFO_BYTES     = 0x4000;
+
+    // =========================================================================
+    // Public API
+    // =========================================================================
+
+    // Open a client stream (1 or 2 channels, 8- or 16-bit PCM at any rate
+    // from 8 to 192 kHz). The first stream brings up the sinks. Returns
+    // the handle or -1.
+    int Open(uint32_t sampleRate, uint8_t channels, uint8_t bitsPerSample);
+
+    // Close a client stream; the last one shuts the sinks down
+    void Close(int handle);
+
+    // Queue PCM in the stream's ring. Returns the bytes taken (0 if full).
+    int Write(int handle, const uint8_t* data, uint32_t size);
+
+    // Per-stream AUDIO_CTL_* commands (volume, pause, position, periods)
+    int Control(int handle, int cmd, int value);
+
+    // The stream's ring (AudioRingHeader page plus ring pages) with a
+    // reference taken for the caller, or nullptr for a bad handle
+    Memory::MemObject* AcquireRing(int handle);
+
+    // True while mixed output also goes to a Bluetooth A2DP sink
+    bool UsingBluetooth();
+};
@@ -15,6 +15,10 @@
 #include <Memory/PageFrameAllocator.hpp>
 #include <Io/IoPort.hpp>
 #include <Graphics/Cursor.hpp>
+#include <Libraries/Memory.hpp>
+#include <CppLib/Spinlock.hpp>
+#include <Timekeeping/ApicTimer.hpp>
+#include <ACPI/AcpiSleep.hpp>
 
 using namespace Kt;
 
@@ -45,6 +49,55 @@ namespace Drivers::Graphics::IntelGPU {
     static uint64_t  g_fbSize = 0;                 // Total framebuffer size in bytes
     static uint64_t  g_fbGttOffset = 0;            // GTT offset where FB starts (in bytes)
 
+    // Scanout buffers for page flipping; buffer 0 is the framebuffer above
+    static constexpr int MaxScanoutBuffers = 2;
+    static int       g_scanoutCount = 1;
+    static uint64_t  g_scanoutPhys[MaxScanoutBuffers] = {};
+    static uint64_t  g_scanoutGttOffset[MaxScanoutBuffers] = {};
+    static int       g_frontBuffer = 0;
+
+    // Cursor plane image, 64x64 ARGB, mapped in the GTT after the scanout buffers
+    static uint32_t* g_cursorImage = nullptr;
+    static uint64_t  g_cursorPhys = 0;
+    static uint64_t  g_cursorGttOffset = 0;
+    static bool      g_cursorVisible = false;
+    static int32_t   g_cursorHotX = 0;
+    static int32_t   g_cursorHotY = 0;
+    static int32_t   g_cursorX = 0;
+    static int32_t   g_cursorY = 0;
+    static kcp::Spinlock g_cursorLock;
+
+    // Blitter state. Its status page, its command ring and the surfaces it
+    // works on are mapped in the GTT behind the cursor image, each in a
+    // range of its own; g_surfaces keeps the ranges in address order.
+    // Blits are run one submission at a time, waited for under g_blitLock,
+    // so the ring is empty whenever a submission starts.
+    static constexpr uint64_t BlitRingPages = 4;
+    static constexpr uint64_t BlitRingSize = BlitRingPages * 0x1000;
+    static constexpr int BlitChunk = 64;                // Commands per submission
+    static constexpr uint64_t BlitTimeoutMs = 100;
+    static constexpr int MaxSurfaces = 256;
+
+    struct Surface {
+        uint64_t firstEntry;
+        uint64_t pageCount;
+        const uint64_t* physPages;
+    };
+
+    static bool      g_blitter = false;
+    static Surface   g_surfaces[MaxSurfaces];
+    static int       g_surfaceCount = 0;
+    static uint64_t  g_surfaceBase = 0;             // First GTT entry past the cursor image
+    static uint64_t  g_displayPteFlags = 0;         // Gen 8+: PPAT index of scanout memory
+    static uint64_t  g_blitPages[1 + BlitRingPages]; // Status page, then the ring
+    static volatile uint32_t* g_hwsPage = nullptr;
+    static uint32_t* g_ring = nullptr;
+    static uint64_t  g_hwsGpu = 0;
+    static uint64_t  g_ringGpu = 0;
+    static uint32_t  g_ringTail = 0;
+    static uint32_t  g_seqno = 0;
+    static kcp::Mutex g_blitLock;
+
     // =========================================================================
     // Register access helpers
     // =========================================================================
@@ -444,6 +497,105 @@ namespace Drivers::Graphics::IntelGPU {
         return true;
     }
 
+    // Point `pageCount` GTT entries from `firstEntry` on at contiguous pages
+    // of display memory (scanout buffers, the cursor image)
+    static void MapGttRange(uint64_t firstEntry, uint64_t phys, uint64_t pageCount) {
+        if (g_gpuGen >= 8) {
+            volatile uint64_t* gtt64 = (volatile uint64_t*)g_gttBase;
+            for (uint64_t i = 0; i < pageCount; i++) {
+                gtt64[firstEntry + i] = MakeGttPte64(phys + i * 0x1000) | g_displayPteFlags;
+            }
+            // Flush GTT writes
+            (void)gtt64[firstEntry + pageCount - 1];
+        } else {
+            volatile uint32_t* gtt32 = (volatile uint32_t*)g_gttBase;
+            for (uint64_t i = 0; i < pageCount; i++) {
+                gtt32[firstEntry + i] = MakeGttPte32(phys + i * 0x1000);
+            }
+            // Flush GTT writes
+            (void)gtt32[firstEntry + pageCount - 1];
+        }
+    }
+
+    // Allocate a second scanout buffer behind the framebuffer in the GTT,
+    // so the plane can be flipped between the two. Failure just leaves
+    // the display single-buffered.
+    static void SetupFlipBuffer() {
+        g_scanoutPhys[0] = g_fbPhysBase;
+        g_scanoutGttOffset[0] = g_fbGttOffset;
+        g_scanoutCount = 1;
+        g_frontBuffer = 0;
+
+        uint64_t pageCount = (g_fbSize + 0xFFF) / 0x1000;
+        uint64_t firstEntry = g_fbGttOffset / 0x1000 + pageCount;
+        if (firstEntry + pageCount > g_gttEntryCount) {
+            KernelLogStream(WARNING, "IntelGPU") << "No GTT room for a second scanout buffer";
+            return;
+        }
+
+        void* buffer = Memory::g_pfa->AllocateContiguous(pageCount);
+        if (buffer == nullptr) {
+            KernelLogStream(WARNING, "IntelGPU") << "No memory for a second scanout buffer";
+            return;
+        }
+        memcpy(buffer, g_fbBase, g_fbSize);
+
+        uint64_t phys = Memory::SubHHDM(buffer);
+        MapGttRange(firstEntry, phys, pageCount);
+
+        g_scanoutPhys[1] = phys;
+        g_scanoutGttOffset[1] = firstEntry * 0x1000;
+        g_scanoutCount = 2;
+
+        KernelLogStream(OK, "IntelGPU") << "Page flipping enabled: second scanout buffer at phys "
+            << base::hex << phys << ", GTT offset " << g_scanoutGttOffset[1];
+    }
+
+    // Allocate the cursor image behind the scanout buffers in the GTT.
+    // Without it the pointer stays a software sprite.
+    static void SetupCursorPlane() {
+        constexpr uint64_t pageCount = CursorSize * CursorSize * 4 / 0x1000;
+        uint64_t fbPages = (g_fbSize + 0xFFF) / 0x1000;
+        uint64_t firstEntry = g_scanoutGttOffset[g_scanoutCount - 1] / 0x1000 + fbPages;
+        if (firstEntry + pageCount > g_gttEntryCount) {
+            KernelLogStream(WARNING, "IntelGPU") << "No GTT room for the cursor plane";
+            return;
+        }
+
+        void* image = Memory::g_pfa->AllocateContiguous(pageCount);
+        if (image == nullptr) {
+            KernelLogStream(WARNING, "IntelGPU") << "No memory for the cursor plane";
+            return;
+        }
+        memset(image, 0, pageCount * 0x1000);
+
+        g_cursorImage = (uint32_t*)image;
+        g_cursorPhys = Memory::SubHHDM(image);
+        g_cursorGttOffset = firstEntry * 0x1000;
+        MapGttRange(firstEntry, g_cursorPhys, pageCount);
+
+        // Start hidden until a pointer image is loaded
+        WriteReg(CURACNTR, CURSOR_MODE_DISABLE);
+        WriteReg(CURABASE, (uint32_t)g_cursorGttOffset);
+
+        KernelLogStream(OK, "IntelGPU") << "Cursor plane at GTT offset " << base::hex << g_cursorGttOffset;
+    }
+
+    static uint32_t CursorPosition(int32_t x, int32_t y) {
+        uint32_t px = x < 0 ? (CURSOR_POS_SIGN | (uint32_t)(-x)) : (uint32_t)x;
+        uint32_t py = y < 0 ? (CURSOR_POS_SIGN | (uint32_t)(-y)) : (uint32_t)y;
+        return (py << 16) | (px & 0xFFFF);
+    }
+
+    // Program the cursor registers from the current state. CURABASE is
+    // written last: it arms the update of all three at the next vblank.
+    // Cursor lock held.
+    static void ProgramCursorLocked() {
+        WriteReg(CURACNTR, g_cursorVisible ? CURSOR_MODE_64_ARGB : CURSOR_MODE_DISABLE);
+        WriteReg(CURAPOS, CursorPosition(g_cursorX - g_cursorHotX, g_cursorY - g_cursorHotY));
+        WriteReg(CURABASE, (uint32_t)g_cursorGttOffset);
+    }
+
     static void ProgramDisplayPlane() {
         // Preserve the firmware's DSPACNTR value entirely. The firmware already
         // configured the correct pixel format, pipe assignment, and tiling mode.
@@ -467,9 +619,9 @@ namespace Drivers::Graphics::IntelGPU {
         // in the hardware's native format (bytes on Gen <9, 64-byte units on Gen 9+).
         // Writing our byte-converted g_fbPitch would corrupt it on Gen 9+.
 
-        // Write the GTT base offset to DSPASURF - this triggers the plane update
-        // Since we mapped at GTT entry 0, the offset is 0
-        uint32_t surfAddr = (uint32_t)g_fbGttOffset;
+        // Write the GTT offset of the front buffer to DSPASURF - this triggers
+        // the plane update. Buffer 0 is mapped at GTT entry 0, so offset 0.
+        uint32_t surfAddr = (uint32_t)g_scanoutGttOffset[g_frontBuffer];
         WriteReg(DSPASURF, surfAddr);
 
         // Read back to flush
@@ -481,6 +633,302 @@ namespace Drivers::Graphics::IntelGPU {
             << ", stride=" << base::dec << g_fbPitch;
     }
 
+    // =========================================================================
+    // Blitter engine
+    // =========================================================================
+
+    static uint32_t RingReg(uint32_t reg) {
+        return BCS_RING_BASE + reg;
+    }
+
+    // Make the GPU drop cached GTT translations
+    static void FlushGtt() {
+        WriteReg(GFX_FLSH_CNTL_GEN6, GFX_FLSH_CNTL_EN);
+        (void)ReadReg(GFX_FLSH_CNTL_GEN6);
+    }
+
+    // Point GTT entries at scattered pages of CPU-cached memory, through
+    // the LLC so the GPU sees what the CPU wrote and the other way round
+    static void MapGttPages(uint64_t firstEntry, const uint64_t* physPages, uint64_t pageCount) {
+        if (g_gpuGen >= 8) {
+            volatile uint64_t* gtt64 = (volatile uint64_t*)g_gttBase;
+            for (uint64_t i = 0; i < pageCount; i++) {
+                gtt64[firstEntry + i] = MakeGttPte64(physPages[i]);
+            }
+            (void)gtt64[firstEntry + pageCount - 1];
+        } else {
+            volatile uint32_t* gtt32 = (volatile uint32_t*)g_gttBase;
+            for (uint64_t i = 0; i < pageCount; i++) {
+                gtt32[firstEntry + i] = MakeGttPte32(physPages[i]) | GTT_PTE_WB_LLC;
+            }
+            (void)gtt32[firstEntry + pageCount - 1];
+        }
+        FlushGtt();
+    }
+
+    // Point GTT entries at the scratch page, so a stray access by the GPU
+    // lands somewhere harmless
+    static void ClearGttPages(uint64_t firstEntry, uint64_t pageCount) {
+        if (g_gpuGen >= 8) {
+            volatile uint64_t* gtt64 = (volatile uint64_t*)g_gttBase;
+            for (uint64_t i = 0; i < pageCount; i++) {
+                gtt64[firstEntry + i] = MakeGttPte64(g_scratchPagePhys);
+            }
+        } else {
+            volatile uint32_t* gtt32 = (volatile uint32_t*)g_gttBase;
+            for (uint64_t i = 0; i < pageCount; i++) {
+                gtt32[firstEntry + i] = MakeGttPte32(g_scratchPagePhys);
+            }
+        }
+        FlushGtt();
+    }
+
+    // Find GTT room for `pageCount` entries among the surfaces (first fit)
+    // and record the range. Returns its first entry, or 0. Blit lock held.
+    static uint64_t AddSurfaceLocked(const uint64_t* physPages, uint64_t pageCount) {
+        if (g_surfaceCount == MaxSurfaces || pageCount == 0) return 0;
+
+        int at = 0;
+        uint64_t entry = g_surfaceBase;
+        for (; at < g_surfaceCount; at++) {
+            if (entry + pageCount <= g_surfaces[at].firstEntry) break;
+            entry = g_surfaces[at].firstEntry + g_surfaces[at].pageCount;
+        }
+        if (entry + pageCount > g_gttEntryCount) return 0;
+
+        for (int i = g_surfaceCount; i > at; i--) g_surfaces[i] = g_surfaces[i - 1];
+        g_surfaces[at] = { entry, pageCount, physPages };
+        g_surfaceCount++;
+
+        MapGttPages(entry, physPages, pageCount);
+        return entry;
+    }
+
+    // Keep the GT awake (no RC6) so the ring registers stay reachable.
+    // Taken once and held: the blitter is only worth it while in use.
+    static bool ForceWake() {
+        uint32_t ackReg;
+        if (g_gpuGen == 6) {
+            WriteReg(FORCEWAKE_GEN6, FORCEWAKE_KERNEL);
+            ackReg = FORCEWAKE_ACK_GEN6;
+        } else {
+            bool ivyBridge = g_gpuGen == 7 && (g_gpuInfo.deviceId & 0xFF00) == 0x0100;
+            WriteReg(FORCEWAKE_MT, MaskedEnable(FORCEWAKE_KERNEL));
+            ackReg = ivyBridge ? FORCEWAKE_MT_ACK_IVB : FORCEWAKE_ACK_HSW;
+        }
+
+        for (int i = 0; i < 100000; i++) {
+            if (ReadReg(ackReg) & FORCEWAKE_KERNEL) return true;
+            asm volatile("pause");
+        }
+        return false;
+    }
+
+    // Gen 8+ pick GTT cacheability through the private PAT: index 0 for
+    // CPU-cached memory, index 3 for scanout memory, which the display
+    // engine reads without snooping the LLC
+    static void ProgramPrivatePat() {
+        uint64_t pat = (uint64_t)PPAT_WB_LLC | ((uint64_t)PPAT_UC << 24);
+        for (int i = 4; i < 8; i++) pat |= (uint64_t)PPAT_WB_LLC << (i * 8);
+        WriteReg(GEN8_PRIVATE_PAT_LO, (uint32_t)pat);
+        WriteReg(GEN8_PRIVATE_PAT_HI, (uint32_t)(pat >> 32));
+    }
+
+    // Point the blitter at its status page and an empty ring, in legacy
+    // ring buffer mode. Returns once the ring is running.
+    static bool StartBlitRing() {
+        if (g_gpuGen >= 8) {
+            WriteReg(RingReg(RING_GFX_MODE), MaskedDisable(GFX_RUN_LIST_ENABLE));
+        }
+        WriteReg(RingReg(RING_MI_MODE), MaskedDisable(MI_MODE_STOP_RING));
+
+        WriteReg(g_gpuGen == 6 ? BCS_HWS_PGA_GEN6 : RingReg(RING_HWS_PGA), (uint32_t)g_hwsGpu);
+
+        WriteReg(RingReg(RING_CTL), 0);
+        WriteReg(RingReg(RING_HEAD), 0);
+        WriteReg(RingReg(RING_TAIL), 0);
+        WriteReg(RingReg(RING_START), (uint32_t)g_ringGpu);
+        WriteReg(RingReg(RING_CTL), ((uint32_t)(BlitRingSize - 0x1000) & RING_CTL_SIZE_MASK) | RING_CTL_VALID);
+        g_ringTail = 0;
+
+        for (int i = 0; i < 100000; i++) {
+            if ((ReadReg(RingReg(RING_CTL)) & RING_CTL_VALID)
+                && ReadReg(RingReg(RING_START)) == (uint32_t)g_ringGpu
+                && (ReadReg(RingReg(RING_HEAD)) & RING_HEAD_ADDR) == 0) {
+                return true;
+            }
+            asm volatile("pause");
+        }
+        return false;
+    }
+
+    // Bring up the blitter behind the cursor image. Without it, every
+    // pixel stays with the CPU.
+    static void SetupBlitter() {
+        if (g_gpuGen < 6 || g_gpuGen > 9) {
+            KernelLogStream(INFO, "IntelGPU") << "No ring buffer blitter on gen "
+                << base::dec << (uint64_t)g_gpuGen << ", 2D stays on the CPU";
+            return;
+        }
+
+        uint64_t fbPages = (g_fbSize + 0xFFF) / 0x1000;
+        g_surfaceBase = g_scanoutGttOffset[g_scanoutCount - 1] / 0x1000 + fbPages;
+        if (g_cursorImage != nullptr) g_surfaceBase += CursorSize * CursorSize * 4 / 0x1000;
+
+        void* hws = Memory::g_pfa->AllocateZeroed();
+        void* ring = Memory::g_pfa->AllocateContiguous(BlitRingPages);
+        if (hws == nullptr || ring == nullptr) {
+            if (hws != nullptr) Memory::g_pfa->Free(hws);
+            if (ring != nullptr) Memory::g_pfa->Free(ring, (int)BlitRingPages);
+            KernelLogStream(WARNING, "IntelGPU") << "No memory for the blitter ring";
+            return;
+        }
+        memset(ring, 0, BlitRingSize);
+        g_hwsPage = (volatile uint32_t*)hws;
+        g_ring = (uint32_t*)ring;
+        g_blitPages[0] = Memory::SubHHDM(hws);
+        for (uint64_t i = 0; i < BlitRingPages; i++) g_blitPages[1 + i] = Memory::SubHHDM(ring) + i * 0x1000;
+
+        if (!ForceWake()) {
+            KernelLogStream(WARNING, "IntelGPU") << "GT did not wake up, blitter disabled";
+            return;
+        }
+
+        if (g_gpuGen >= 8) {
+            ProgramPrivatePat();
+            g_displayPteFlags = GTT_PTE64_PPAT_UC;
+            for (int i = 0; i < g_scanoutCount; i++) {
+                MapGttRange(g_scanoutGttOffset[i] / 0x1000, g_scanoutPhys[i], fbPages);
+            }
+            if (g_cursorImage != nullptr) {
+                MapGttRange(g_cursorGttOffset / 0x1000, g_cursorPhys, CursorSize * CursorSize * 4 / 0x1000);
+            }
+        }
+
+        g_blitLock.Acquire();
+        uint64_t hwsEntry = AddSurfaceLocked(&g_blitPages[0], 1);
+        uint64_t ringEntry = AddSurfaceLocked(&g_blitPages[1], BlitRingPages);
+        g_blitLock.Release();
+        if (hwsEntry == 0 || ringEntry == 0) {
+            KernelLogStream(WARNING, "IntelGPU") << "No GTT room for the blitter ring";
+            return;
+        }
+        g_hwsGpu = hwsEntry * 0x1000;
+        g_ringGpu = ringEntry * 0x1000;
+
+        if (!StartBlitRing()) {
+            KernelLogStream(WARNING, "IntelGPU") << "Blitter ring did not start (CTL="
+                << base::hex << (uint64_t)ReadReg(RingReg(RING_CTL)) << ")";
+            return;
+        }
+
+        g_seqno = g_hwsPage[HWS_SEQNO_INDEX];
+        g_blitter = true;
+        KernelLogStream(OK, "IntelGPU") << "Blitter ring at GTT offset " << base::hex << g_ringGpu
+            << ", surfaces from " << g_surfaceBase * 0x1000;
+    }
+
+    static void Emit(uint32_t dword) {
+        g_ring[g_ringTail / 4] = dword;
+        g_ringTail = (g_ringTail + 4) % BlitRingSize;
+    }
+
+    // Keep a command of `dwords` from running past the end of the ring
+    static void ReserveRing(uint32_t dwords) {
+        if (g_ringTail + dwords * 4 > BlitRingSize) {
+            while (g_ringTail != 0) Emit(MI_NOOP);
+        }
+    }
+
+    // Graphics address as the blitter takes it: a page aligned base plus
+    // (x, y) in pixels from it. False if out of the blitter's range.
+    static bool SplitAddress(uint64_t address, uint32_t pitch, uint32_t width, uint32_t height,
+                             uint64_t& base, uint32_t& x, uint32_t& y) {
+        if ((address & 3) != 0 || (pitch & 3) != 0 || pitch == 0 || pitch > BLT_MAX_PITCH) return false;
+        base = address & ~0xFFFULL;
+        uint64_t offset = address - base;
+        y = (uint32_t)(offset / pitch);
+        x = (uint32_t)(offset % pitch) / 4;
+        return x + width <= BLT_MAX_COORD && y + height <= BLT_MAX_COORD
+            && (g_gpuGen >= 8 || base + (uint64_t)(y + height) * pitch <= 0xFFFFFFFFULL);
+    }
+
+    static bool ValidBlit(const BlitCommand& cmd) {
+        if (cmd.width == 0 || cmd.height == 0) return true;
+        uint64_t base;
+        uint32_t x, y;
+        return SplitAddress(cmd.dst, cmd.dstPitch, cmd.width, cmd.height, base, x, y)
+            && (cmd.fill || SplitAddress(cmd.src, cmd.srcPitch, cmd.width, cmd.height, base, x, y));
+    }
+
+    // Source and destination must not overlap. The command is valid.
+    static void EmitBlit(const BlitCommand& cmd) {
+        if (cmd.width == 0 || cmd.height == 0) return;
+
+        uint64_t dstBase, srcBase = 0;
+        uint32_t dx, dy, sx = 0, sy = 0;
+        SplitAddress(cmd.dst, cmd.dstPitch, cmd.width, cmd.height, dstBase, dx, dy);
+        if (!cmd.fill) SplitAddress(cmd.src, cmd.srcPitch, cmd.width, cmd.height, srcBase, sx, sy);
+
+        bool wide = g_gpuGen >= 8;   // 64-bit addresses
+        uint32_t dstStart = (dy << 16) | dx;
+        uint32_t dstEnd = ((dy + cmd.height) << 16) | (dx + cmd.width);
+
+        if (cmd.fill) {
+            ReserveRing(wide ? 7 : 6);
+            Emit((XY_COLOR_BLT + (wide ? 1 : 0)) | BLT_WRITE_ARGB);
+            Emit(BR13_ROP_PATCOPY | BR13_32BPP | cmd.dstPitch);
+            Emit(dstStart);
+            Emit(dstEnd);
+            Emit((uint32_t)dstBase);
+            if (wide) Emit((uint32_t)(dstBase >> 32));
+            Emit(cmd.color);
+            return;
+        }
+
+        ReserveRing(wide ? 10 : 8);
+        Emit((XY_SRC_COPY_BLT + (wide ? 2 : 0)) | BLT_WRITE_ARGB);
+        Emit(BR13_ROP_SRCCOPY | BR13_32BPP | cmd.dstPitch);
+        Emit(dstStart);
+        Emit(dstEnd);
+        Emit((uint32_t)dstBase);
+        if (wide) Emit((uint32_t)(dstBase >> 32));
+        Emit((sy << 16) | sx);
+        Emit(cmd.srcPitch);
+        Emit((uint32_t)srcBase);
+        if (wide) Emit((uint32_t)(srcBase >> 32));
+    }
+
+    // Flush the blits before it and have the status page record `seqno`
+    static void EmitBreadcrumb(uint32_t seqno) {
+        bool wide = g_gpuGen >= 8;
+        ReserveRing(wide ? 6 : 4);
+        Emit((MI_FLUSH_DW + (wide ? 1 : 0)) | MI_FLUSH_DW_OP_STOREDW | MI_FLUSH_DW_STORE_INDEX);
+        Emit((HWS_SEQNO_INDEX * 4) | MI_FLUSH_DW_USE_GTT);
+        if (wide) Emit(0);
+        Emit(seqno);
+        Emit(MI_USER_INTERRUPT);
+        while (g_ringTail % 8 != 0) Emit(MI_NOOP);
+    }
+
+    // The submission is short (a full-screen copy takes a few
+    // milliseconds), so the caller spins for it. Blit lock held.
+    static bool WaitSeqno(uint32_t seqno) {
+        uint64_t deadline = Timekeeping::GetMilliseconds() + BlitTimeoutMs;
+        while ((int32_t)(g_hwsPage[HWS_SEQNO_INDEX] - seqno) < 0) {
+            if (Timekeeping::GetMilliseconds() > deadline) return false;
+            asm volatile("pause");
+        }
+        return true;
+    }
+
+    // The desktop draws straight into the GTT-mapped framebuffer, so the
+    // display comes back before anything else is scheduled
+    static void RegisterPowerHooks() {
+        Hal::AcpiSleep::RegisterDevice({"IntelGPU", nullptr, Reinitialize,
+                                        Hal::AcpiSleep::ResumeStage::Early});
+    }
+
     // =========================================================================
     // Public API
     // =========================================================================
@@ -567,8 +1015,12 @@ namespace Drivers::Graphics::IntelGPU {
             return false;
         }
 
+        SetupFlipBuffer();
+        SetupCursorPlane();
         ProgramDisplayPlane();
+        SetupBlitter();
         g_initialized = true;
+        RegisterPowerHooks();
 
         uint64_t fwWidth  = ::Graphics::Cursor::GetFramebufferWidth();
         uint64_t fwHeight = ::Graphics::Cursor::GetFramebufferHeight();
@@ -627,10 +1079,19 @@ namespace Drivers::Graphics::IntelGPU {
             return;
         }
 
-        // Step 7: Program the display plane to use our GTT-mapped framebuffer
+        // Step 7: Add a second scanout buffer for page flipping, and the
+        //         cursor plane image behind it
+        SetupFlipBuffer();
+        SetupCursorPlane();
+
+        // Step 8: Program the display plane to use our GTT-mapped framebuffer
         ProgramDisplayPlane();
 
+        // Step 9: Start the blitter for 2D fills and copies
+        SetupBlitter();
+
         g_initialized = true;
+        RegisterPowerHooks();
 
         // Diagnostic: compare GPU-detected values with firmware/Limine values
         uint64_t fwWidth  = ::Graphics::Cursor::GetFramebufferWidth();
@@ -680,6 +1141,77 @@ namespace Drivers::Graphics::IntelGPU {
         return g_fbPitch;
     }
 
+    int GetScanoutCount() {
+        return g_initialized ? g_scanoutCount : 1;
+    }
+
+    uint64_t GetScanoutPhysBase(int index) {
+        if (index < 0 || index >= g_scanoutCount) return 0;
+        return g_scanoutPhys[index];
+    }
+
+    bool Flip(int index) {
+        if (!g_initialized || index < 0 || index >= g_scanoutCount) return false;
+        g_frontBuffer = index;
+        WriteReg(DSPASURF, (uint32_t)g_scanoutGttOffset[index]);
+        (void)ReadReg(DSPASURF);
+        return true;
+    }
+
+    bool FlipDone() {
+        if (!g_initialized) return true;
+        return (ReadReg(DSPASURFLIVE) & ~0xFFFu) == (uint32_t)g_scanoutGttOffset[g_frontBuffer];
+    }
+
+    uint32_t GetVblankCount() {
+        if (!g_initialized) return 0;
+        return ReadReg(PIPEAFRMCOUNT);
+    }
+
+    bool HasCursorPlane() {
+        return g_initialized && g_cursorImage != nullptr;
+    }
+
+    bool SetCursorImage(const uint32_t* argb, int width, int height, int hotX, int hotY) {
+        if (!HasCursorPlane()) return false;
+        if (argb != nullptr && (width <= 0 || height <= 0 || width > CursorSize || height > CursorSize)) {
+            return false;
+        }
+
+        g_cursorLock.Acquire();
+        if (argb != nullptr) {
+            // The plane always scans out 64x64; clear what the image leaves
+            for (int y = 0; y < CursorSize; y++) {
+                uint32_t* row = g_cursorImage + y * CursorSize;
+                if (y < height) {
+                    memcpy(row, argb + y * width, width * 4);
+                    memset(row + width, 0, (CursorSize - width) * 4);
+                } else {
+                    memset(row, 0, CursorSize * 4);
+                }
+            }
+            g_cursorHotX = hotX;
+            g_cursorHotY = hotY;
+        }
+        g_cursorVisible = argb != nullptr;
+        ProgramCursorLocked();
+        g_cursorLock.Release();
+        return true;
+    }
+
+    void MoveCursor(int32_t x, int32_t y) {
+        if (g_cursorImage == nullptr) return;
+
+        g_cursorLock.Acquire();
+        g_cursorX = x;
+        g_cursorY = y;
+        if (g_cursorVisible) {
+            WriteReg(CURAPOS, CursorPosition(x - g_cursorHotX, y - g_cursorHotY));
+            WriteReg(CURABASE, (uint32_t)g_cursorGttOffset);
+        }
+        g_cursorLock.Release();
+    }
+
     void Reinitialize() {
         if (!g_initialized || !g_mmioBase) return;
 
@@ -716,22 +1248,14 @@ namespace Drivers::Graphics::IntelGPU {
         // 2. Disable VGA plane (firmware may have re-enabled it during POST)
         DisableVga();
 
-        // 3. Reprogram GTT entries (hardware lost all GTT state during S3)
+        // 3. Reprogram GTT entries (hardware lost all GTT state during S3),
+        //    for every scanout buffer
         uint64_t pageCount = (g_fbSize + 0xFFF) / 0x1000;
-        if (g_gpuGen >= 8) {
-            volatile uint64_t* gtt64 = (volatile uint64_t*)g_gttBase;
-            for (uint64_t i = 0; i < pageCount; i++) {
-                gtt64[i] = MakeGttPte64(g_fbPhysBase + i * 0x1000);
-            }
-            // Flush GTT writes by reading back the last entry
-            (void)gtt64[pageCount - 1];
-        } else {
-            volatile uint32_t* gtt32 = (volatile uint32_t*)g_gttBase;
-            for (uint64_t i = 0; i < pageCount; i++) {
-                gtt32[i] = MakeGttPte32(g_fbPhysBase + i * 0x1000);
-            }
-            // Flush GTT writes by reading back the last entry
-            (void)gtt32[pageCount - 1];
+        for (int i = 0; i < g_scanoutCount; i++) {
+            MapGttRange(g_scanoutGttOffset[i] / 0x1000, g_scanoutPhys[i], pageCount);
+        }
+        if (g_cursorImage != nullptr) {
+            MapGttRange(g_cursorGttOffset / 0x1000, g_cursorPhys, CursorSize * CursorSize * 4 / 0x1000);
         }
 
         KernelLogStream(DEBUG, "IntelGPU") << "GTT reprogrammed: " << base::dec << pageCount
@@ -757,10 +1281,93 @@ namespace Drivers::Graphics::IntelGPU {
             }
         }
 
-        // 5. Reprogram display plane to point at our GTT-mapped framebuffer
+        // 5. Reprogram display plane to point at our GTT-mapped framebuffer,
+        //    and the cursor plane with it
         ProgramDisplayPlane();
+        if (g_cursorImage != nullptr) {
+            g_cursorLock.Acquire();
+            ProgramCursorLocked();
+            g_cursorLock.Release();
+        }
+
+        // 6. Restart the blitter: the GT woke up without its forcewake,
+        //    private PAT and ring state, and with none of the surfaces
+        if (g_blitter) {
+            g_blitLock.Acquire();
+            if (g_gpuGen >= 8) ProgramPrivatePat();
+            for (int i = 0; i < g_surfaceCount; i++) {
+                MapGttPages(g_surfaces[i].firstEntry, g_surfaces[i].physPages, g_surfaces[i].pageCount);
+            }
+            if (!ForceWake() || !StartBlitRing()) {
+                g_blitter = false;
+                KernelLogStream(WARNING, "IntelGPU") << "Blitter did not restart after S3 resume";
+            }
+            g_blitLock.Release();
+        }
 
         KernelLogStream(OK, "IntelGPU") << "Display restored after S3 resume";
     }
 
+    bool HasBlitter() {
+        return g_blitter;
+    }
+
+    uint64_t MapSurface(const uint64_t* physPages, uint64_t pageCount) {
+        if (!g_blitter) return 0;
+        g_blitLock.Acquire();
+        uint64_t entry = AddSurfaceLocked(physPages, pageCount);
+        g_blitLock.Release();
+        return entry * 0x1000;
+    }
+
+    void UnmapSurface(uint64_t gpuAddress) {
+        if (gpuAddress == 0) return;
+        uint64_t entry = gpuAddress / 0x1000;
+
+        // Taking the lock waits out a submission that may use the surface
+        g_blitLock.Acquire();
+        for (int i = 0; i < g_surfaceCount; i++) {
+            if (g_surfaces[i].firstEntry != entry) continue;
+            ClearGttPages(entry, g_surfaces[i].pageCount);
+            for (int j = i; j < g_surfaceCount - 1; j++) g_surfaces[j] = g_surfaces[j + 1];
+            g_surfaceCount--;
+            break;
+        }
+        g_blitLock.Release();
+    }
+
+    uint64_t GetScanoutGpuAddress(int index) {
+        if (index < 0 || index >= g_scanoutCount) return 0;
+        return g_scanoutGttOffset[index];
+    }
+
+    bool Blit(const BlitCommand* commands, int count) {
+        if (!g_blitter || count <= 0) return false;
+
+        for (int i = 0; i < count; i++) {
+            if (!ValidBlit(commands[i])) return false;
+        }
+
+        g_blitLock.Acquire();
+        bool ok = g_blitter;
+        for (int first = 0; ok && first < count; first += BlitChunk) {
+            int last = first + BlitChunk < count ? first + BlitChunk : count;
+            for (int i = first; i < last; i++) EmitBlit(commands[i]);
+
+            uint32_t seqno = ++g_seqno;
+            EmitBreadcrumb(seqno);
+            WriteReg(RingReg(RING_TAIL), g_ringTail & RING_TAIL_ADDR);
+
+            if (!WaitSeqno(seqno)) {
+                g_blitter = false;
+                ok = false;
+                KernelLogStream(ERROR, "IntelGPU") << "Blitter hung (head "
+                    << base::hex << (uint64_t)ReadReg(RingReg(RING_HEAD)) << ", tail "
+                    << (uint64_t)g_ringTail << "), disabled";
+            }
+        }
+        g_blitLock.Release();
+        return ok;
+    }
+
 };
@@ -198,6 +198,10 @@ namespace Drivers::Graphics::IntelGPU {
     static constexpr uint32_t DSPASIZE   = 0x70190;
     static constexpr uint32_t DSPASURF   = 0x7019C;
     static constexpr uint32_t DSPATILEOFF = 0x701A4;
+    static constexpr uint32_t DSPASURFLIVE = 0x701AC;  // Surface being scanned out (Gen 4+)
+
+    // Pipe A frame counter, bumped at the start of every vertical blank (G4X+)
+    static constexpr uint32_t PIPEAFRMCOUNT = 0x70040;
 
     // --- Display plane control (Plane B) ---
     static constexpr uint32_t DSPBCNTR   = 0x71180;
@@ -226,6 +230,12 @@ namespace Drivers::Graphics::IntelGPU {
     static constexpr uint32_t CURABASE   = 0x70084;
     static constexpr uint32_t CURAPOS    = 0x70088;
 
+    // CURACNTR mode: 64x64 32bpp ARGB, pipe A
+    static constexpr uint32_t CURSOR_MODE_DISABLE  = 0x00;
+    static constexpr uint32_t CURSOR_MODE_64_ARGB  = 0x27;
+    static constexpr uint32_t CURSOR_POS_SIGN      = 0x8000;  // Per coordinate: sign + magnitude
+    static constexpr int      CursorSize = 64;
+
     // --- Output connectors ---
     static constexpr uint32_t ADPA       = 0x61100;  // Analog Display Port (VGA/CRT)
     static constexpr uint32_t DVOB       = 0x61140;  // DVO-B
@@ -258,6 +268,67 @@ namespace Drivers::Graphics::IntelGPU {
     // --- Hardware status page ---
     static constexpr uint32_t HWS_PGA    = 0x02080;
 
+    // --- Blitter engine (BCS) command ring, Gen 6+ ---
+    static constexpr uint32_t BCS_RING_BASE   = 0x22000;
+    static constexpr uint32_t RING_TAIL       = 0x30;    // Relative to the ring base
+    static constexpr uint32_t RING_HEAD       = 0x34;
+    static constexpr uint32_t RING_START      = 0x38;
+    static constexpr uint32_t RING_CTL        = 0x3C;
+    static constexpr uint32_t RING_HWS_PGA    = 0x80;    // Gen 7+
+    static constexpr uint32_t RING_MI_MODE    = 0x9C;
+    static constexpr uint32_t RING_GFX_MODE   = 0x29C;   // Gen 7+
+    static constexpr uint32_t BCS_HWS_PGA_GEN6 = 0x24080;
+
+    static constexpr uint32_t RING_CTL_VALID     = (1u << 0);
+    static constexpr uint32_t RING_CTL_SIZE_MASK = 0x1FF000;  // Ring size - 4K
+    static constexpr uint32_t RING_HEAD_ADDR     = 0x1FFFFC;
+    static constexpr uint32_t RING_TAIL_ADDR     = 0x1FFFF8;
+    static constexpr uint32_t MI_MODE_STOP_RING  = (1u << 8);
+    static constexpr uint32_t GFX_RUN_LIST_ENABLE = (1u << 15);
+
+    // Masked registers: the high half selects the bits the low half sets
+    static constexpr uint32_t MaskedEnable(uint32_t bits)  { return (bits << 16) | bits; }
+    static constexpr uint32_t MaskedDisable(uint32_t bits) { return bits << 16; }
+
+    // Invalidates the GPU's cached GTT translations after entries change
+    static constexpr uint32_t GFX_FLSH_CNTL_GEN6 = 0x101008;
+    static constexpr uint32_t GFX_FLSH_CNTL_EN   = (1u << 0);
+
+    // --- Forcewake (keeps the GT powered up for ring register access) ---
+    static constexpr uint32_t FORCEWAKE_GEN6     = 0xA18C;
+    static constexpr uint32_t FORCEWAKE_ACK_GEN6 = 0x130090;
+    static constexpr uint32_t FORCEWAKE_MT       = 0xA188;   // Blitter domain on Gen 9
+    static constexpr uint32_t FORCEWAKE_MT_ACK_IVB = 0x130040;
+    static constexpr uint32_t FORCEWAKE_ACK_HSW  = 0x130044;
+    static constexpr uint32_t FORCEWAKE_KERNEL   = (1u << 0);
+
+    // --- Private PAT (Gen 8+ GTT cacheability), one byte per index ---
+    static constexpr uint32_t GEN8_PRIVATE_PAT_LO = 0x40E0;
+    static constexpr uint32_t GEN8_PRIVATE_PAT_HI = 0x40E4;
+    static constexpr uint8_t  PPAT_UC       = 0x00;
+    static constexpr uint8_t  PPAT_WB_LLC   = 0x03 | (1u << 2) | (3u << 4);  // Write-back, LLC, age 3
+
+    // --- Blitter commands ---
+    static constexpr uint32_t MI_NOOP           = 0;
+    static constexpr uint32_t MI_USER_INTERRUPT = (0x02u << 23);
+    static constexpr uint32_t MI_FLUSH_DW       = (0x26u << 23) | 1;   // One more dword on Gen 8+
+    static constexpr uint32_t MI_FLUSH_DW_STORE_INDEX = (1u << 21);
+    static constexpr uint32_t MI_FLUSH_DW_OP_STOREDW  = (1u << 14);
+    static constexpr uint32_t MI_FLUSH_DW_USE_GTT     = (1u << 2);
+
+    static constexpr uint32_t XY_COLOR_BLT      = (2u << 29) | (0x50u << 22) | 4;   // One more dword on Gen 8+
+    static constexpr uint32_t XY_SRC_COPY_BLT   = (2u << 29) | (0x53u << 22) | 6;   // Two more dwords on Gen 8+
+    static constexpr uint32_t BLT_WRITE_ARGB    = (3u << 20);
+    static constexpr uint32_t BR13_32BPP        = (3u << 24);
+    static constexpr uint32_t BR13_ROP_PATCOPY  = (0xF0u << 16);
+    static constexpr uint32_t BR13_ROP_SRCCOPY  = (0xCCu << 16);
+    static constexpr uint32_t BLT_MAX_PITCH     = 32767;
+    static constexpr uint32_t BLT_MAX_COORD     = 32767;
+
+    // Hardware status page dword the blitter writes each submission's
+    // sequence number to (the first ones are reserved by the hardware)
+    static constexpr uint32_t HWS_SEQNO_INDEX = 0x30;
+
     // --- Fence registers (tiling) ---
     static constexpr uint32_t FENCE_REG_BASE = 0x02000;  // Gen 2-3
     static constexpr uint32_t FENCE_REG_965_BASE = 0x03000;  // Gen 4+
@@ -286,6 +357,10 @@ namespace Drivers::Graphics::IntelGPU {
         return pte;
     }
 
+    // Gen 8+ PTE bits picking a private PAT entry: index 0 (none set) is
+    // programmed write-back in the LLC, index 3 (PWT | PCD) uncached
+    static constexpr uint64_t GTT_PTE64_PPAT_UC = (1ULL << 3) | (1ULL << 4);
+
     // Helper: Build a Gen 8+ GTT PTE from a physical address
     static inline uint64_t MakeGttPte64(uint64_t physAddr) {
         return (physAddr & ~0xFFFULL) | GTT_PTE64_VALID;
@@ -434,4 +509,75 @@ namespace Drivers::Graphics::IntelGPU {
     uint64_t GetHeight();
     uint64_t GetPitch();
 
+    // Scanout buffers plane A can be flipped between: the firmware
+    // framebuffer (buffer 0) and, if memory allowed, a second one of the
+    // same size. 1 means flipping is unavailable.
+    int GetScanoutCount();
+
+    // Physical base of scanout buffer `index`
+    uint64_t GetScanoutPhysBase(int index);
+
+    // Point plane A at buffer `index`. The surface register is latched
+    // at the next vertical blank, so the switch never tears.
+    bool Flip(int index);
+
+    // Whether the last Flip() has reached the screen
+    bool FlipDone();
+
+    // Vertical blanks on pipe A so far (wraps)
+    uint32_t GetVblankCount();
+
+    // Whether the 64x64 ARGB cursor plane is available
+    bool HasCursorPlane();
+
+    // Load a `width` x `height` (at most 64x64) ARGB pointer image whose
+    // hotspot is at (hotX, hotY) and show it; nullptr hides the cursor
+    bool SetCursorImage(const uint32_t* argb, int width, int height, int hotX, int hotY);
+
+    // Put the cursor hotspot at (x, y). Only a register write, so the
+    // mouse interrupt calls it directly; takes effect at the next vblank.
+    void MoveCursor(int32_t x, int32_t y);
+
+    // =========================================================================
+    // Blitter (2D copies and fills, Gen 6 to Gen 9)
+    // =========================================================================
+
+    // Whether the blitter engine is up. Gen 11+ only accept work through
+    // execlists, Gen 5 has no separate engine; both keep pixels on the CPU.
+    bool HasBlitter();
+
+    // Map memory the blitter can reach into the GTT: `pageCount` pages at
+    // `physPages`, which must stay valid until UnmapSurface() (the entries
+    // are rewritten from it after S3). CPU-cached memory is mapped
+    // coherent with the CPU caches. Returns the surface's graphics
+    // address, or 0 if there is no blitter or no GTT room.
+    uint64_t MapSurface(const uint64_t* physPages, uint64_t pageCount);
+
+    // Remove a surface from the GTT, once no blit can be using it
+    void UnmapSurface(uint64_t gpuAddress);
+
+    // Graphics address of scanout buffer `index` < GetScanoutCount().
+    // Scanouts are always mapped; the first usually sits at address 0.
+    uint64_t GetScanoutGpuAddress(int index);
+
+    // A rectangle of 32-bit pixels: filled with `color`, or copied from
+    // `src`, which must not overlap it. Addresses are graphics addresses
+    // of the first pixel, pitches in bytes.
+    struct BlitCommand {
+        bool fill;
+        uint64_t dst;
+        uint64_t src;
+        uint32_t dstPitch;
+        uint32_t srcPitch;
+        uint32_t width;
+        uint32_t height;
+        uint32_t color;
+    };
+
+    // Run `count` blits in order and wait for them to land, so the CPU can
+    // read or draw over the results. False if the blitter is unavailable,
+    // a command is out of its limits (nothing is run then), or it stopped
+    // responding (it is then left off for good).
+    bool Blit(const BlitCommand* commands, int count);
+
 };
@@ -6,6 +6,8 @@
 
 #include "Init.hpp"
 #include <Pci/Pci.hpp>
+#include <Hal/BootTasks.hpp>
+#include <Timekeeping/BootProfile.hpp>
 #include <Drivers/Graphics/IntelGPU.hpp>
 #include <Drivers/Net/E1000.hpp>
 #include <Drivers/Net/E1000E.hpp>
@@ -29,6 +31,8 @@ namespace Drivers {
     };
 
     static constexpr uint16_t g_e1000eIds[] = {
+        // 82574L
+        0x10D3,
         // I217
         0x153A, 0x153B,
         // I218
@@ -166,6 +170,50 @@ namespace Drivers {
 
     static constexpr uint16_t g_driverTableCount = sizeof(g_driverTable) / sizeof(g_driverTable[0]);
 
+    // Which later boot step waits for each driver. Normal-phase drivers are
+    // probed in parallel, one boot task each, so no two of them may match
+    // the same device.
+    enum class Needed : uint8_t { None, Storage, Network };
+
+    static constexpr Needed g_driverNeeded[] = {
+        Needed::None,       // IntelGPU (Early phase, probed on the BSP)
+        Needed::Storage,    // xHCI: USB mass storage registers during the port scan
+        Needed::Network,    // E1000
+        Needed::Network,    // E1000E
+        Needed::Storage,    // AHCI
+        Needed::Storage,    // NVMe
+        Needed::None,       // IntelHDA
+    };
+
+    static_assert(sizeof(g_driverNeeded) / sizeof(g_driverNeeded[0]) == g_driverTableCount,
+                  "g_driverNeeded must have one entry per driver");
+
+    // -------------------------------------------------------------------------
+    // Boot tasks
+    // -------------------------------------------------------------------------
+
+    static Smp::BootTasks::TaskSet g_storageProbes = 0;
+    static Smp::BootTasks::TaskSet g_networkProbes = 0;
+    static int g_partitionTask = -1;
+
+    static void ProbeDriverTask(void* arg) {
+        Pci::ProbeAll((const Pci::PciDriverDesc*)arg, 1, Pci::ProbePhase::Normal);
+    }
+
+    static void NetworkTask(void*) {
+        int phase = Timekeeping::BootProfile::Begin("Network");
+        ::Net::Initialize();
+        Timekeeping::BootProfile::End(phase);
+    }
+
+    static void PartitionTask(void*) {
+        // Block devices registered by the storage probes. Now probe them
+        // for GPT partitions.
+        int phase = Timekeeping::BootProfile::Begin("Partitions");
+        Storage::Gpt::ProbeAll();
+        Timekeeping::BootProfile::End(phase);
+    }
+
     // -------------------------------------------------------------------------
     // Public API
     // -------------------------------------------------------------------------
@@ -186,17 +234,22 @@ namespace Drivers {
     }
 
     void ProbeNormal() {
-        Pci::ProbeAll(g_driverTable, g_driverTableCount, Pci::ProbePhase::Normal);
+        for (uint16_t i = 0; i < g_driverTableCount; i++) {
+            const Pci::PciDriverDesc& desc = g_driverTable[i];
+            if (desc.Phase != Pci::ProbePhase::Normal) continue;
+
+            int task = Smp::BootTasks::Add(desc.Name, ProbeDriverTask, (void*)&desc);
+            if (g_driverNeeded[i] == Needed::Storage) g_storageProbes |= Smp::BootTasks::Bit(task);
+            if (g_driverNeeded[i] == Needed::Network) g_networkProbes |= Smp::BootTasks::Bit(task);
+        }
     }
 
     void InitializeNetwork() {
-        ::Net::Initialize();
+        Smp::BootTasks::Add("Network", NetworkTask, nullptr, g_networkProbes);
     }
 
     void InitializeStorage() {
-        // AHCI driver registered SATA devices as block devices during
-        // ProbeNormal(). Now probe all block devices for GPT partitions.
-        Storage::Gpt::ProbeAll();
+        g_partitionTask = Smp::BootTasks::Add("Partitions", PartitionTask, nullptr, g_storageProbes);
     }
 
     void InitializeAudio() {
@@ -205,4 +258,12 @@ namespace Drivers {
         // when a Bluetooth adapter is detected by the xHCI driver.
     }
 
+    void WaitForStorage() {
+        Smp::BootTasks::Wait(Smp::BootTasks::Bit(g_partitionTask));
+    }
+
+    void FinishInitialization() {
+        Smp::BootTasks::Finish();
+    }
+
 }
@@ -16,15 +16,23 @@ namespace Drivers {
 
     // Probe PCI devices for Normal-phase drivers (xHCI, E1000, E1000E, AHCI, NVMe, IntelHDA).
     // USB class drivers (Bluetooth, etc.) initialize automatically during xHCI enumeration.
+    // Each driver is queued as a boot task, so controllers come up in parallel on
+    // whichever CPUs are online; the call returns before they are done.
     void ProbeNormal();
 
-    // Post-probe: initialize network stack.
+    // Post-probe: initialize network stack once the NIC probes finish.
     void InitializeNetwork();
 
-    // Post-probe: register SATA drives with VFS.
+    // Post-probe: probe block devices for partitions once the storage probes finish.
     void InitializeStorage();
 
     // Post-probe: initialize audio subsystem.
     void InitializeAudio();
 
+    // Wait until partitions are known (before mounting filesystems).
+    void WaitForStorage();
+
+    // Wait for every driver task and release the APs to the scheduler.
+    void FinishInitialization();
+
 }
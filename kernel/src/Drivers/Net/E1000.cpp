@@ -11,9 +11,12 @@
 #include <Memory/HHDM.hpp>
 #include <Memory/Paging.hpp>
 #include <Memory/PageFrameAllocator.hpp>
+#include <Memory/Dma.hpp>
 #include <Libraries/Memory.hpp>
 #include <Hal/Apic/Interrupts.hpp>
 #include <Hal/Apic/IoApic.hpp>
+#include <CppLib/Spinlock.hpp>
+#include <ACPI/AcpiSleep.hpp>
 
 using namespace Kt;
 
@@ -28,6 +31,9 @@ namespace Drivers::Net::E1000 {
     static volatile uint8_t* g_mmioBase = nullptr;
     static uint8_t g_macAddress[6] = {};
     static uint8_t g_irqLine = 0;
+    static uint8_t g_pciBus = 0, g_pciDevice = 0, g_pciFunction = 0;
+
+    static constexpr uint32_t InterruptMask = ICR_RXT0 | ICR_TXDW | ICR_TXQE | ICR_LSC | ICR_RXDMT0;
 
     // Descriptor rings (physical addresses for DMA, virtual for CPU access)
     static RxDescriptor* g_rxDescs = nullptr;
@@ -36,11 +42,14 @@ namespace Drivers::Net::E1000 {
     static uint64_t g_txDescsPhys = 0;
 
     // Packet buffers (virtual addresses)
-    static uint8_t* g_rxBuffers[RX_DESC_COUNT] = {};
     static uint8_t* g_txBuffers[TX_DESC_COUNT] = {};
-    static uint64_t g_rxBuffersPhys[RX_DESC_COUNT] = {};
     static uint64_t g_txBuffersPhys[TX_DESC_COUNT] = {};
 
+    // Pool buffers the NIC receives into, and those sent from in place
+    // (held until their descriptor is reused)
+    static ::Net::PacketBuffer* g_rxPackets[RX_DESC_COUNT] = {};
+    static ::Net::PacketBuffer* g_txPackets[TX_DESC_COUNT] = {};
+
     // Current descriptor indices
     static uint32_t g_rxTail = 0;
     static uint32_t g_txTail = 0;
@@ -52,6 +61,10 @@ namespace Drivers::Net::E1000 {
     // RX callback
     static RxCallback g_rxCallback = nullptr;
 
+    // Held while posting TX descriptors: frames are sent both from
+    // threads and from the receive path
+    static kcp::Spinlock g_txLock;
+
     // -------------------------------------------------------------------------
     // Register access helpers
     // -------------------------------------------------------------------------
@@ -64,6 +77,47 @@ namespace Drivers::Net::E1000 {
         return *(volatile uint32_t*)(g_mmioBase + reg);
     }
 
+    // RX_*_CSUM_OK flags for the checksums the NIC verified in a frame
+    static uint8_t RxChecksumFlags(const RxDescriptor& desc) {
+        if (desc.Status & RXSTA_IXSM) {
+            return 0;
+        }
+        uint8_t flags = 0;
+        if ((desc.Status & RXSTA_IPCS) && !(desc.Errors & RXERR_IPE)) flags |= RX_IP_CSUM_OK;
+        if ((desc.Status & RXSTA_TCPCS) && !(desc.Errors & RXERR_TCPE)) flags |= RX_L4_CSUM_OK;
+        return flags;
+    }
+
+    // Hand the frame in RX slot `idx` to the stack and give the slot a
+    // fresh buffer. With the pool empty the frame is dropped and the NIC
+    // keeps the old buffer.
+    static void DeliverRx(uint32_t idx, RxDescriptor& desc) {
+        ::Net::PacketBuffer* fresh = ::Net::PacketPool::Allocate();
+        if (fresh == nullptr) {
+            return;
+        }
+
+        ::Net::PacketBuffer* packet = g_rxPackets[idx];
+        g_rxPackets[idx] = fresh;
+        desc.BufferAddress = fresh->Phys;
+
+        packet->Data = packet->Head;
+        packet->Length = desc.Length;
+        if (g_rxCallback != nullptr) {
+            g_rxCallback(packet, RxChecksumFlags(desc));
+        }
+        ::Net::PacketPool::Release(packet);
+    }
+
+    // Drop the reference held for the last buffer sent from TX slot `idx`.
+    // g_txLock held, descriptor done.
+    static void ReclaimTx(uint32_t idx) {
+        if (g_txPackets[idx] != nullptr) {
+            ::Net::PacketPool::Release(g_txPackets[idx]);
+            g_txPackets[idx] = nullptr;
+        }
+    }
+
     // -------------------------------------------------------------------------
     // EEPROM access (fallback for MAC address)
     // -------------------------------------------------------------------------
@@ -89,6 +143,19 @@ namespace Drivers::Net::E1000 {
     // MAC address
     // -------------------------------------------------------------------------
 
+    // Write the MAC to RAL/RAH to ensure the filter is set
+    static void WriteMacFilter() {
+        WriteReg(REG_RAL,
+            (uint32_t)g_macAddress[0] |
+            ((uint32_t)g_macAddress[1] << 8) |
+            ((uint32_t)g_macAddress[2] << 16) |
+            ((uint32_t)g_macAddress[3] << 24));
+        WriteReg(REG_RAH,
+            (uint32_t)g_macAddress[4] |
+            ((uint32_t)g_macAddress[5] << 8) |
+            (1u << 31)); // AV (Address Valid) bit
+    }
+
     static void ReadMacAddress() {
         // Try reading from RAL/RAH first (QEMU usually has it here)
         uint32_t ral = ReadReg(REG_RAL);
@@ -115,48 +182,47 @@ namespace Drivers::Net::E1000 {
             g_macAddress[5] = (uint8_t)(word2 >> 8);
         }
 
-        // Write MAC back to RAL/RAH to ensure the filter is set
-        WriteReg(REG_RAL,
-            (uint32_t)g_macAddress[0] |
-            ((uint32_t)g_macAddress[1] << 8) |
-            ((uint32_t)g_macAddress[2] << 16) |
-            ((uint32_t)g_macAddress[3] << 24));
-        WriteReg(REG_RAH,
-            (uint32_t)g_macAddress[4] |
-            ((uint32_t)g_macAddress[5] << 8) |
-            (1u << 31)); // AV (Address Valid) bit
+        WriteMacFilter();
     }
 
     // -------------------------------------------------------------------------
-    // Allocate page-aligned DMA buffer, returns virtual address
+    // RX setup
     // -------------------------------------------------------------------------
 
-    static uint8_t* AllocateDmaBuffer(uint64_t& outPhysAddr) {
-        void* virt = Memory::g_pfa->AllocateZeroed();
-        outPhysAddr = Memory::SubHHDM(virt);
-        return (uint8_t*)virt;
-    }
+    // Point the NIC at the RX ring and enable the receiver
+    static void ProgramRx() {
+        // Program the descriptor ring base address
+        WriteReg(REG_RDBAL, (uint32_t)(g_rxDescsPhys & 0xFFFFFFFF));
+        WriteReg(REG_RDBAH, (uint32_t)(g_rxDescsPhys >> 32));
 
-    // -------------------------------------------------------------------------
-    // RX setup
-    // -------------------------------------------------------------------------
+        // Set descriptor ring length (in bytes)
+        WriteReg(REG_RDLEN, RX_DESC_COUNT * sizeof(RxDescriptor));
+
+        // Set head and tail pointers
+        WriteReg(REG_RDH, 0);
+        WriteReg(REG_RDT, RX_DESC_COUNT - 1);
+
+        g_rxTail = RX_DESC_COUNT - 1;
+
+        // Have the NIC verify IPv4 and TCP/UDP checksums
+        WriteReg(REG_RXCSUM, RXCSUM_IPOFLD | RXCSUM_TUOFLD);
+
+        // Configure RCTL: enable receiver, accept broadcast, strip CRC, 2048 byte buffers
+        uint32_t rctl = RCTL_EN | RCTL_BAM | RCTL_SECRC | RCTL_BSIZE_2048;
+        WriteReg(REG_RCTL, rctl);
+    }
 
     static void SetupRx() {
         // Allocate RX descriptor ring (needs to be 128-byte aligned, page-aligned is fine)
         uint64_t descPhys;
-        g_rxDescs = (RxDescriptor*)AllocateDmaBuffer(descPhys);
+        g_rxDescs = (RxDescriptor*)Memory::Dma::Allocate(0x1000, descPhys);
         g_rxDescsPhys = descPhys;
 
         // Allocate packet buffers for each descriptor
         for (uint32_t i = 0; i < RX_DESC_COUNT; i++) {
-            // Each buffer is one page (4096 bytes), sufficient for standard Ethernet frames
-            g_rxBuffers[i] = AllocateDmaBuffer(g_rxBuffersPhys[i]);
+            g_rxPackets[i] = ::Net::PacketPool::Allocate();
 
-            // For larger buffers (8192), allocate a second page
-            uint64_t secondPhys;
-            AllocateDmaBuffer(secondPhys);
-
-            g_rxDescs[i].BufferAddress = g_rxBuffersPhys[i];
+            g_rxDescs[i].BufferAddress = g_rxPackets[i]->Phys;
             g_rxDescs[i].Status = 0;
             g_rxDescs[i].Length = 0;
             g_rxDescs[i].Checksum = 0;
@@ -164,22 +230,7 @@ namespace Drivers::Net::E1000 {
             g_rxDescs[i].Special = 0;
         }
 
-        // Program the descriptor ring base address
-        WriteReg(REG_RDBAL, (uint32_t)(g_rxDescsPhys & 0xFFFFFFFF));
-        WriteReg(REG_RDBAH, (uint32_t)(g_rxDescsPhys >> 32));
-
-        // Set descriptor ring length (in bytes)
-        WriteReg(REG_RDLEN, RX_DESC_COUNT * sizeof(RxDescriptor));
-
-        // Set head and tail pointers
-        WriteReg(REG_RDH, 0);
-        WriteReg(REG_RDT, RX_DESC_COUNT - 1);
-
-        g_rxTail = RX_DESC_COUNT - 1;
-
-        // Configure RCTL: enable receiver, accept broadcast, strip CRC, 4096 byte buffers
-        uint32_t rctl = RCTL_EN | RCTL_BAM | RCTL_SECRC | RCTL_BSIZE_4096 | RCTL_BSEX;
-        WriteReg(REG_RCTL, rctl);
+        ProgramRx();
 
         KernelLogStream(OK, "E1000") << "RX ring configured: " << base::dec << (uint64_t)RX_DESC_COUNT << " descriptors";
     }
@@ -188,25 +239,8 @@ namespace Drivers::Net::E1000 {
     // TX setup
     // -------------------------------------------------------------------------
 
-    static void SetupTx() {
-        // Allocate TX descriptor ring
-        uint64_t descPhys;
-        g_txDescs = (TxDescriptor*)AllocateDmaBuffer(descPhys);
-        g_txDescsPhys = descPhys;
-
-        // Allocate packet buffers for each descriptor
-        for (uint32_t i = 0; i < TX_DESC_COUNT; i++) {
-            g_txBuffers[i] = AllocateDmaBuffer(g_txBuffersPhys[i]);
-
-            g_txDescs[i].BufferAddress = g_txBuffersPhys[i];
-            g_txDescs[i].Length = 0;
-            g_txDescs[i].Command = 0;
-            g_txDescs[i].Status = TXSTA_DD; // Mark as done (available for use)
-            g_txDescs[i].ChecksumOffset = 0;
-            g_txDescs[i].ChecksumStart = 0;
-            g_txDescs[i].Special = 0;
-        }
-
+    // Point the NIC at the TX ring and enable the transmitter
+    static void ProgramTx() {
         // Program the descriptor ring base address
         WriteReg(REG_TDBAL, (uint32_t)(g_txDescsPhys & 0xFFFFFFFF));
         WriteReg(REG_TDBAH, (uint32_t)(g_txDescsPhys >> 32));
@@ -230,6 +264,28 @@ namespace Drivers::Net::E1000 {
         // Set Inter Packet Gap (recommended values for IEEE 802.3)
         // IPGT=10, IPGR1=10, IPGR2=10
         WriteReg(REG_TIPG, 10 | (10 << 10) | (10 << 20));
+    }
+
+    static void SetupTx() {
+        // Allocate TX descriptor ring
+        uint64_t descPhys;
+        g_txDescs = (TxDescriptor*)Memory::Dma::Allocate(0x1000, descPhys);
+        g_txDescsPhys = descPhys;
+
+        // Allocate packet buffers for each descriptor
+        for (uint32_t i = 0; i < TX_DESC_COUNT; i++) {
+            g_txBuffers[i] = (uint8_t*)Memory::Dma::Allocate(0x1000, g_txBuffersPhys[i]);
+
+            g_txDescs[i].BufferAddress = g_txBuffersPhys[i];
+            g_txDescs[i].Length = 0;
+            g_txDescs[i].Command = 0;
+            g_txDescs[i].Status = TXSTA_DD; // Mark as done (available for use)
+            g_txDescs[i].ChecksumOffset = 0;
+            g_txDescs[i].ChecksumStart = 0;
+            g_txDescs[i].Special = 0;
+        }
+
+        ProgramTx();
 
         KernelLogStream(OK, "E1000") << "TX ring configured: " << base::dec << (uint64_t)TX_DESC_COUNT << " descriptors";
     }
@@ -260,13 +316,10 @@ namespace Drivers::Net::E1000 {
                     break; // No more packets
                 }
 
-                uint16_t length = desc.Length;
                 g_rxPacketCount++;
 
                 // Dispatch to the network stack callback
-                if (g_rxCallback != nullptr) {
-                    g_rxCallback(g_rxBuffers[nextIdx], length);
-                }
+                DeliverRx(nextIdx, desc);
 
                 // Reset descriptor for reuse
                 desc.Status = 0;
@@ -283,6 +336,80 @@ namespace Drivers::Net::E1000 {
         }
     }
 
+    // -------------------------------------------------------------------------
+    // Reset
+    // -------------------------------------------------------------------------
+
+    // Reset the device and set link up, with interrupts masked
+    static void ResetController() {
+        uint32_t ctrl = ReadReg(REG_CTRL);
+        WriteReg(REG_CTRL, ctrl | CTRL_RST);
+        for (int i = 0; i < 100000; i++) {
+            if (!(ReadReg(REG_CTRL) & CTRL_RST)) break;
+        }
+
+        WriteReg(REG_IMC, 0xFFFFFFFF);
+
+        ctrl = ReadReg(REG_CTRL);
+        ctrl |= CTRL_SLU;
+        ctrl &= ~(1u << 3);
+        ctrl &= ~(1u << 31);
+        ctrl &= ~(1u << 7);
+        WriteReg(REG_CTRL, ctrl);
+    }
+
+    // -------------------------------------------------------------------------
+    // S3 suspend/resume
+    // The rings and their buffers stay in RAM; only the registers pointing
+    // the NIC at them are lost, so resume reprograms those instead of
+    // setting the device up again.
+    // -------------------------------------------------------------------------
+
+    static void SuspendController() {
+        WriteReg(REG_IMC, 0xFFFFFFFF);
+        WriteReg(REG_RCTL, ReadReg(REG_RCTL) & ~RCTL_EN);
+        WriteReg(REG_TCTL, ReadReg(REG_TCTL) & ~TCTL_EN);
+    }
+
+    // Runs on its own thread after the desktop is back. Link negotiation
+    // finishes after it returns and is reported by the LSC interrupt.
+    static void ResumeController() {
+        Pci::EnableBusMaster(g_pciBus, g_pciDevice, g_pciFunction);
+        ResetController();
+        WriteMacFilter();
+        for (uint32_t i = 0; i < 128; i++) {
+            WriteReg(REG_MTA + (i * 4), 0);
+        }
+
+        // Frames the NIC had not handed back are dropped
+        for (uint32_t i = 0; i < RX_DESC_COUNT; i++) {
+            g_rxDescs[i].Status = 0;
+            g_rxDescs[i].Length = 0;
+            g_rxDescs[i].Errors = 0;
+        }
+        ProgramRx();
+
+        g_txLock.Acquire();
+        for (uint32_t i = 0; i < TX_DESC_COUNT; i++) {
+            ReclaimTx(i);
+            g_txDescs[i] = {};
+            g_txDescs[i].BufferAddress = g_txBuffersPhys[i];
+            g_txDescs[i].Status = TXSTA_DD;
+        }
+        ProgramTx();
+        g_txLock.Release();
+
+        WriteReg(REG_IMS, InterruptMask);
+    }
+
+    static void RegisterPowerHooks(uint8_t bus, uint8_t dev, uint8_t func) {
+        g_pciBus = bus;
+        g_pciDevice = dev;
+        g_pciFunction = func;
+        Hal::AcpiSleep::RegisterDevice({"E1000", SuspendController, ResumeController,
+                                        Hal::AcpiSleep::ResumeStage::Deferred});
+    }
+
     // -------------------------------------------------------------------------
     // Public API
     // -------------------------------------------------------------------------
@@ -317,21 +444,7 @@ namespace Drivers::Net::E1000 {
         g_irqLine = Pci::LegacyRead8(dev.Bus, dev.Device, dev.Function, (uint8_t)Pci::PCI_REG_INTERRUPT);
         KernelLogStream(INFO, "E1000") << "IRQ line: " << base::dec << (uint64_t)g_irqLine;
 
-        // Reset the device
-        uint32_t ctrl = ReadReg(REG_CTRL);
-        WriteReg(REG_CTRL, ctrl | CTRL_RST);
-        for (int i = 0; i < 100000; i++) {
-            if (!(ReadReg(REG_CTRL) & CTRL_RST)) break;
-        }
-
-        WriteReg(REG_IMC, 0xFFFFFFFF);
-
-        ctrl = ReadReg(REG_CTRL);
-        ctrl |= CTRL_SLU;
-        ctrl &= ~(1u << 3);
-        ctrl &= ~(1u << 31);
-        ctrl &= ~(1u << 7);
-        WriteReg(REG_CTRL, ctrl);
+        ResetController();
 
         ReadMacAddress();
         KernelLogStream(OK, "E1000") << "MAC: " << base::hex
@@ -348,9 +461,10 @@ namespace Drivers::Net::E1000 {
 
         Hal::RegisterIrqHandler(g_irqLine, HandleInterrupt);
         Hal::IoApic::UnmaskIrq(Hal::IoApic::GetGsiForIrq(g_irqLine));
-        WriteReg(REG_IMS, ICR_RXT0 | ICR_TXDW | ICR_TXQE | ICR_LSC | ICR_RXDMT0);
+        WriteReg(REG_IMS, InterruptMask);
 
         g_initialized = true;
+        RegisterPowerHooks(dev.Bus, dev.Device, dev.Function);
 
         uint32_t status = ReadReg(REG_STATUS);
         bool linkUp = (status & (1 << 1)) != 0;
@@ -455,9 +569,10 @@ namespace Drivers::Net::E1000 {
         Hal::IoApic::UnmaskIrq(Hal::IoApic::GetGsiForIrq(g_irqLine));
 
         // Enable interrupts: RX, TX, Link Status Change
-        WriteReg(REG_IMS, ICR_RXT0 | ICR_TXDW | ICR_TXQE | ICR_LSC | ICR_RXDMT0);
+        WriteReg(REG_IMS, InterruptMask);
 
         g_initialized = true;
+        RegisterPowerHooks(e1000Dev->Bus, e1000Dev->Device, e1000Dev->Function);
 
         // Report link status
         uint32_t status = ReadReg(REG_STATUS);
@@ -470,20 +585,27 @@ namespace Drivers::Net::E1000 {
             return false;
         }
 
+        g_txLock.Acquire();
+
         // Check if the current TX descriptor is available
         TxDescriptor& desc = g_txDescs[g_txTail];
         if (!(desc.Status & TXSTA_DD)) {
+            g_txLock.Release();
             KernelLogStream(WARNING, "E1000") << "TX ring full";
             return false;
         }
+        ReclaimTx(g_txTail);
 
         // Copy packet data into the TX buffer
         memcpy(g_txBuffers[g_txTail], data, length);
 
-        // Set up the descriptor
+        // Set up the descriptor (the slot may last have held an extended one)
         desc.BufferAddress = g_txBuffersPhys[g_txTail];
         desc.Length = length;
+        desc.ChecksumOffset = 0;
         desc.Command = TXCMD_EOP | TXCMD_IFCS | TXCMD_RS;
+        desc.ChecksumStart = 0;
+        desc.Special = 0;
         desc.Status = 0;
 
         // Advance the tail pointer (tells the NIC there's a new packet)
@@ -491,9 +613,140 @@ namespace Drivers::Net::E1000 {
         WriteReg(REG_TDT, g_txTail);
 
         g_txPacketCount++;
+        g_txLock.Release();
+        return true;
+    }
+
+    bool SendBuffer(::Net::PacketBuffer* packet) {
+        if (!g_initialized || packet == nullptr || packet->Length == 0 || packet->Length > 1518) {
+            return false;
+        }
+
+        g_txLock.Acquire();
+
+        TxDescriptor& desc = g_txDescs[g_txTail];
+        if (!(desc.Status & TXSTA_DD)) {
+            g_txLock.Release();
+            KernelLogStream(WARNING, "E1000") << "TX ring full";
+            return false;
+        }
+        ReclaimTx(g_txTail);
+
+        // The NIC reads the frame straight out of the pool buffer
+        ::Net::PacketPool::Retain(packet);
+        g_txPackets[g_txTail] = packet;
+
+        desc.BufferAddress = packet->DataPhys();
+        desc.Length = packet->Length;
+        desc.ChecksumOffset = 0;
+        desc.Command = TXCMD_EOP | TXCMD_IFCS | TXCMD_RS;
+        desc.ChecksumStart = 0;
+        desc.Special = 0;
+        desc.Status = 0;
+
+        g_txTail = (g_txTail + 1) % TX_DESC_COUNT;
+        WriteReg(REG_TDT, g_txTail);
+
+        g_txPacketCount++;
+        g_txLock.Release();
+        return true;
+    }
+
+    // A context descriptor tells the NIC where the headers are and what to
+    // do with them; the frame follows in data descriptors, one TX buffer
+    // each. With TSE set, the NIC sends the payload as Mss-sized segments.
+    bool SendPacketOffload(const TxFragment* fragments, uint32_t count, const TxOffload& off) {
+        if (!g_initialized || fragments == nullptr || count == 0) {
+            return false;
+        }
+
+        uint32_t length = 0;
+        for (uint32_t i = 0; i < count; i++) {
+            length += fragments[i].Length;
+        }
+
+        bool tso = off.Mss != 0;
+        uint32_t limit = tso ? TSO_MAX_FRAME_SIZE : 1518;
+        if (length <= off.HeaderLen || length > limit || off.L4Offset <= off.IpOffset) {
+            return false;
+        }
+
+        uint32_t needed = 1 + (length + TX_BUFFER_SIZE - 1) / TX_BUFFER_SIZE;
+
+        g_txLock.Acquire();
+
+        for (uint32_t i = 0; i < needed; i++) {
+            if (!(g_txDescs[(g_txTail + i) % TX_DESC_COUNT].Status & TXSTA_DD)) {
+                g_txLock.Release();
+                KernelLogStream(WARNING, "E1000") << "TX ring full";
+                return false;
+            }
+        }
+        for (uint32_t i = 0; i < needed; i++) {
+            ReclaimTx((g_txTail + i) % TX_DESC_COUNT);
+        }
+
+        uint8_t segmentCmd = tso ? TXCMD_TSE : 0;
+
+        TxContextDescriptor& ctx = *(TxContextDescriptor*)&g_txDescs[g_txTail];
+        ctx.IpStart = off.IpOffset;
+        ctx.IpOffset = off.IpOffset + 10;
+        ctx.IpEnd = off.L4Offset - 1;
+        ctx.TcpStart = off.L4Offset;
+        ctx.TcpOffset = off.L4Offset + 16;
+        ctx.TcpEnd = 0;
+        ctx.PayloadLenCmd = ((tso ? length - off.HeaderLen : 0) & 0xFFFFF)
+                          | ((uint32_t)TXDTYP_CONTEXT << 20)
+                          | ((uint32_t)(TXCMD_DEXT | TXCMD_RS | TUCMD_IP | TUCMD_TCP | segmentCmd) << 24);
+        ctx.Status = 0;
+        ctx.HeaderLen = tso ? off.HeaderLen : 0;
+        ctx.Mss = off.Mss;
+        g_txTail = (g_txTail + 1) % TX_DESC_COUNT;
+
+        // Gather the fragments into consecutive TX buffers
+        uint32_t frag = 0;
+        uint32_t fragOffset = 0;
+        uint32_t remaining = length;
+        while (remaining > 0) {
+            uint32_t chunk = remaining < TX_BUFFER_SIZE ? remaining : TX_BUFFER_SIZE;
+            uint8_t* buffer = g_txBuffers[g_txTail];
+            uint32_t filled = 0;
+            while (filled < chunk) {
+                uint32_t n = fragments[frag].Length - fragOffset;
+                if (n > chunk - filled) n = chunk - filled;
+                memcpy(buffer + filled, fragments[frag].Data + fragOffset, n);
+                filled += n;
+                fragOffset += n;
+                if (fragOffset == fragments[frag].Length) {
+                    frag++;
+                    fragOffset = 0;
+                }
+            }
+            remaining -= chunk;
+
+            uint8_t cmd = TXCMD_DEXT | TXCMD_IFCS | TXCMD_RS | segmentCmd;
+            if (remaining == 0) cmd |= TXCMD_EOP;
+
+            TxDataDescriptor& desc = *(TxDataDescriptor*)&g_txDescs[g_txTail];
+            desc.BufferAddress = g_txBuffersPhys[g_txTail];
+            desc.LengthCmd = chunk | ((uint32_t)TXDTYP_DATA << 20) | ((uint32_t)cmd << 24);
+            desc.Options = TXPOPTS_IXSM | TXPOPTS_TXSM;
+            desc.Special = 0;
+            desc.Status = 0;
+            g_txTail = (g_txTail + 1) % TX_DESC_COUNT;
+        }
+
+        WriteReg(REG_TDT, g_txTail);
+
+        g_txPacketCount++;
+        g_txLock.Release();
         return true;
     }
 
+    uint32_t GetOffloads() {
+        return OFFLOAD_TX_CSUM | OFFLOAD_TSO | OFFLOAD_RX_CSUM;
+    }
+
     const uint8_t* GetMacAddress() {
         return g_macAddress;
     }
@@ -7,6 +7,8 @@
 #pragma once
 #include <cstdint>
 #include <Pci/Pci.hpp>
+#include <Drivers/Net/Offload.hpp>
+#include <Net/PacketBuffer.hpp>
 
 namespace Drivers::Net::E1000 {
 
@@ -30,6 +32,7 @@ namespace Drivers::Net::E1000 {
     constexpr uint32_t REG_TDLEN  = 0x3808;  // TX Descriptor Length
     constexpr uint32_t REG_TDH    = 0x3810;  // TX Descriptor Head
     constexpr uint32_t REG_TDT    = 0x3818;  // TX Descriptor Tail
+    constexpr uint32_t REG_RXCSUM = 0x5000;  // RX Checksum Control
     constexpr uint32_t REG_MTA    = 0x5200;  // Multicast Table Array (128 entries)
     constexpr uint32_t REG_RAL    = 0x5400;  // Receive Address Low
     constexpr uint32_t REG_RAH    = 0x5404;  // Receive Address High
@@ -44,10 +47,15 @@ namespace Drivers::Net::E1000 {
     constexpr uint32_t RCTL_UPE   = (1 << 3);   // Unicast Promiscuous
     constexpr uint32_t RCTL_MPE   = (1 << 4);   // Multicast Promiscuous
     constexpr uint32_t RCTL_BAM   = (1 << 15);  // Broadcast Accept Mode
+    constexpr uint32_t RCTL_BSIZE_2048 = (0 << 16); // Buffer Size 2048
     constexpr uint32_t RCTL_BSIZE_4096 = (3 << 16); // Buffer Size 4096 (with BSEX)
     constexpr uint32_t RCTL_BSEX  = (1 << 25);  // Buffer Size Extension
     constexpr uint32_t RCTL_SECRC = (1 << 26);  // Strip Ethernet CRC
 
+    // RXCSUM register bits
+    constexpr uint32_t RXCSUM_IPOFLD = (1 << 8);  // IPv4 Checksum Offload
+    constexpr uint32_t RXCSUM_TUOFLD = (1 << 9);  // TCP/UDP Checksum Offload
+
     // TCTL register bits
     constexpr uint32_t TCTL_EN    = (1 << 1);   // Transmit Enable
     constexpr uint32_t TCTL_PSP   = (1 << 3);   // Pad Short Packets
@@ -62,10 +70,24 @@ namespace Drivers::Net::E1000 {
     constexpr uint32_t ICR_RXO    = (1 << 6);   // Receiver Overrun
     constexpr uint32_t ICR_RXT0   = (1 << 7);   // Receiver Timer Interrupt
 
-    // TX descriptor command bits
+    // TX descriptor command bits (legacy; DCMD/TUCMD of the extended formats)
     constexpr uint8_t TXCMD_EOP   = (1 << 0);   // End Of Packet
     constexpr uint8_t TXCMD_IFCS  = (1 << 1);   // Insert FCS/CRC
+    constexpr uint8_t TXCMD_TSE   = (1 << 2);   // TCP Segmentation Enable
     constexpr uint8_t TXCMD_RS    = (1 << 3);   // Report Status
+    constexpr uint8_t TXCMD_DEXT  = (1 << 5);   // Extended descriptor
+
+    // TUCMD bits of a context descriptor
+    constexpr uint8_t TUCMD_TCP   = (1 << 0);   // Packet is TCP
+    constexpr uint8_t TUCMD_IP    = (1 << 1);   // Packet is IPv4
+
+    // Extended descriptor types
+    constexpr uint8_t TXDTYP_CONTEXT = 0x0;
+    constexpr uint8_t TXDTYP_DATA    = 0x1;
+
+    // POPTS bits of a data descriptor
+    constexpr uint8_t TXPOPTS_IXSM = (1 << 0);  // Insert IP checksum
+    constexpr uint8_t TXPOPTS_TXSM = (1 << 1);  // Insert TCP/UDP checksum
 
     // TX descriptor status bits
     constexpr uint8_t TXSTA_DD    = (1 << 0);   // Descriptor Done
@@ -73,11 +95,19 @@ namespace Drivers::Net::E1000 {
     // RX descriptor status bits
     constexpr uint8_t RXSTA_DD    = (1 << 0);   // Descriptor Done
     constexpr uint8_t RXSTA_EOP   = (1 << 1);   // End Of Packet
+    constexpr uint8_t RXSTA_IXSM  = (1 << 2);   // Ignore Checksum Indication
+    constexpr uint8_t RXSTA_TCPCS = (1 << 5);   // TCP/UDP Checksum Calculated
+    constexpr uint8_t RXSTA_IPCS  = (1 << 6);   // IPv4 Checksum Calculated
+
+    // RX descriptor error bits
+    constexpr uint8_t RXERR_TCPE  = (1 << 5);   // TCP/UDP Checksum Error
+    constexpr uint8_t RXERR_IPE   = (1 << 6);   // IPv4 Checksum Error
 
     // Descriptor ring sizes
     constexpr uint32_t RX_DESC_COUNT = 32;
-    constexpr uint32_t TX_DESC_COUNT = 32;
-    constexpr uint32_t PACKET_BUFFER_SIZE = 8192;
+    constexpr uint32_t TX_DESC_COUNT = 64;      // Room for a segmentation frame (17 descriptors) and more
+    constexpr uint32_t TX_BUFFER_SIZE = 4096;
+    constexpr uint32_t RX_BUFFER_SIZE = ::Net::PACKET_BUFFER_SIZE;  // RX buffers come from the packet pool
 
     // RX descriptor (legacy format, 16 bytes)
     struct RxDescriptor {
@@ -100,6 +130,30 @@ namespace Drivers::Net::E1000 {
         uint16_t Special;
     } __attribute__((packed));
 
+    // TCP/IP context descriptor (16 bytes): sets up checksum insertion
+    // and segmentation for the data descriptors that follow
+    struct TxContextDescriptor {
+        uint8_t  IpStart;        // IPCSS
+        uint8_t  IpOffset;       // IPCSO: checksum field
+        uint16_t IpEnd;          // IPCSE: last byte of the IPv4 header
+        uint8_t  TcpStart;       // TUCSS
+        uint8_t  TcpOffset;      // TUCSO: checksum field
+        uint16_t TcpEnd;         // TUCSE (0 = to the end of the packet)
+        uint32_t PayloadLenCmd;  // PAYLEN[19:0] | DTYP[23:20] | TUCMD[31:24]
+        uint8_t  Status;
+        uint8_t  HeaderLen;
+        uint16_t Mss;
+    } __attribute__((packed));
+
+    // TCP/IP data descriptor (16 bytes)
+    struct TxDataDescriptor {
+        uint64_t BufferAddress;
+        uint32_t LengthCmd;      // DTALEN[19:0] | DTYP[23:20] | DCMD[31:24]
+        uint8_t  Status;
+        uint8_t  Options;        // POPTS
+        uint16_t Special;
+    } __attribute__((packed));
+
     // Initialize the E1000 driver (scans PCI for the device)
     void Initialize();
 
@@ -109,14 +163,26 @@ namespace Drivers::Net::E1000 {
     // Send a raw Ethernet frame
     bool SendPacket(const uint8_t* data, uint16_t length);
 
+    // Send the frame held in `packet` without copying it. The driver
+    // keeps a reference until the NIC is done with the buffer.
+    bool SendBuffer(::Net::PacketBuffer* packet);
+
+    // Send a TCP/IPv4 frame gathered from `count` fragments, leaving its
+    // checksums (and, with off.Mss set, its segmentation) to the NIC
+    bool SendPacketOffload(const TxFragment* fragments, uint32_t count, const TxOffload& off);
+
+    // OFFLOAD_* bits this device supports
+    uint32_t GetOffloads();
+
     // Get the MAC address (6 bytes)
     const uint8_t* GetMacAddress();
 
     // Check if the device was found and initialized
     bool IsInitialized();
 
-    // RX callback type: called with (packet data, length)
-    using RxCallback = void(*)(const uint8_t* data, uint16_t length);
+    // RX callback type: called with (frame, RX_*_CSUM_OK flags). The
+    // driver drops its reference to the frame when the callback returns.
+    using RxCallback = void(*)(::Net::PacketBuffer* packet, uint8_t flags);
 
     // Register a callback for received packets
     void SetRxCallback(RxCallback callback);
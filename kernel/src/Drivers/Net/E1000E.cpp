@@ -1,6 +1,6 @@
 /*
     * E1000E.cpp
-    * Intel I217/I218/I219 (E1000E) Ethernet driver
+    * Intel 82574 and I217/I218/I219 (E1000E) Ethernet driver
     * Copyright (c) 2025 Daniel Hammer
 */
 
@@ -11,9 +11,13 @@
 #include <Memory/HHDM.hpp>
 #include <Memory/Paging.hpp>
 #include <Memory/PageFrameAllocator.hpp>
+#include <Memory/Dma.hpp>
 #include <Libraries/Memory.hpp>
 #include <Hal/Apic/Interrupts.hpp>
 #include <Hal/Apic/IoApic.hpp>
+#include <Hal/SmpBoot.hpp>
+#include <CppLib/Spinlock.hpp>
+#include <ACPI/AcpiSleep.hpp>
 
 using namespace Kt;
 
@@ -28,8 +32,9 @@ namespace Drivers::Net::E1000E {
     // PCI vendor ID for Intel
     static constexpr uint16_t VendorIntel = 0x8086;
 
-    // Device ID table for I217/I218/I219 series
+    // Device ID table for the 82574 and the I217/I218/I219 series
     static constexpr DeviceEntry g_deviceTable[] = {
+        { 0x10D3, "82574L" },
         // I217
         { 0x153A, "I217-LM" },
         { 0x153B, "I217-V" },
@@ -82,32 +87,88 @@ namespace Drivers::Net::E1000E {
     static constexpr uint32_t MSI_VECTOR   = 56;       // IRQ_VECTOR_BASE + MSI_IRQ
     static constexpr uint32_t MSI_ADDR_BASE = 0xFEE00000; // Local APIC message address range
 
+    // With MSI-X, MSI-X vector n serves RX queue n and the one after the
+    // queues the other causes (link changes). Queue 0 keeps the MSI slot,
+    // the rest take the last free slots below the IPIs.
+    static constexpr uint8_t  MSIX_QUEUE_IRQ[MAX_QUEUES] = { MSI_IRQ, 44 };
+    static constexpr uint8_t  MSIX_OTHER_IRQ = 45;
+
+    // Receive path, NAPI style: an RX interrupt masks further RX
+    // interrupts and processes up to RX_BUDGET packets at the end of the
+    // handler. If the ring still holds more, the device stays in polling
+    // mode and the 1 ms housekeeping tick keeps draining it, a budget at a
+    // time; once a pass empties the ring, RX interrupts are unmasked again.
+    // ITR caps the interrupt rate, so a steady stream of packets arrives
+    // in batches instead of one interrupt per frame.
+    static constexpr uint32_t RX_BUDGET = 16;
+    static constexpr uint32_t ITR_INTERVAL = 488;  // 256 ns units: ~125 us, at most ~8000 interrupts/s
+    static constexpr uint32_t RX_INTERRUPTS = ICR_RXT0 | ICR_RXDMT0 | ICR_RXO;
+
+    // Multiple queues (82574 with MSI-X, one queue per CPU as far as the
+    // device goes): receive-side scaling hashes TCP flows by addresses and
+    // ports, other IPv4 by addresses, and the redirection table spreads
+    // the hash values over the RX queues. Each queue's vector is delivered
+    // to a CPU of its own, which runs the whole stack for the flows the
+    // queue holds, so all of one connection's segments are processed on
+    // one CPU. A queue's vector does not stay masked under load: a pass
+    // that leaves packets on the ring sets the queue's cause again, and
+    // the throttled vector comes back to the same CPU for the next budget.
+    // Frames go out on the TX queue picked by a hash of their flow, so one
+    // connection's segments never overtake each other in the NIC.
+    static constexpr uint8_t RSS_KEY[RSS_KEY_SIZE] = {
+        0x6d, 0x5a, 0x56, 0xda, 0x25, 0x5b, 0x0e, 0xc2, 0x41, 0x67,
+        0x25, 0x3d, 0x43, 0xa3, 0x8f, 0xb0, 0xd0, 0xca, 0x2b, 0xcb,
+        0xae, 0x7b, 0x30, 0xb4, 0x77, 0xcb, 0x2d, 0xa3, 0x80, 0x30,
+        0xf2, 0x0c, 0x6a, 0x42, 0xb7, 0x3b, 0xbe, 0xac, 0x01, 0xfa,
+    };
+
+    struct RxQueue {
+        uint32_t Index;
+        RxDescriptor* Descs;   // RxExtDescriptor entries with RSS
+        uint64_t DescsPhys;
+
+        // Pool buffers the NIC receives into
+        ::Net::PacketBuffer* Packets[RX_DESC_COUNT];
+        uint32_t Tail;
+        uint64_t PacketCount;
+
+        // Held while taking packets off the ring; whoever fails to get it
+        // leaves the work to the holder
+        kcp::Spinlock Lock;
+        volatile bool Polling;  // RX interrupts masked, the tick drains the ring
+    };
+
+    struct TxQueue {
+        uint32_t Index;
+        TxDescriptor* Descs;
+        uint64_t DescsPhys;
+        uint8_t* Buffers[TX_DESC_COUNT];
+        uint64_t BuffersPhys[TX_DESC_COUNT];
+
+        // Pool buffers sent from in place (held until their descriptor is reused)
+        ::Net::PacketBuffer* Packets[TX_DESC_COUNT];
+        uint32_t Tail;
+        uint64_t PacketCount;
+
+        // Held while posting descriptors: frames are sent both from
+        // threads and from the receive path
+        kcp::Spinlock Lock;
+    };
+
     // Driver state
     static bool g_initialized = false;
     static bool g_pollingMode = false;
     static volatile uint8_t* g_mmioBase = nullptr;
     static uint8_t g_macAddress[6] = {};
     static uint8_t g_irqLine = 0;
+    static uint8_t g_pciBus = 0, g_pciDevice = 0, g_pciFunction = 0;
+    static bool g_msiEnabled = false;
 
-    // Descriptor rings (physical addresses for DMA, virtual for CPU access)
-    static RxDescriptor* g_rxDescs = nullptr;
-    static TxDescriptor* g_txDescs = nullptr;
-    static uint64_t g_rxDescsPhys = 0;
-    static uint64_t g_txDescsPhys = 0;
-
-    // Packet buffers (virtual addresses)
-    static uint8_t* g_rxBuffers[RX_DESC_COUNT] = {};
-    static uint8_t* g_txBuffers[TX_DESC_COUNT] = {};
-    static uint64_t g_rxBuffersPhys[RX_DESC_COUNT] = {};
-    static uint64_t g_txBuffersPhys[TX_DESC_COUNT] = {};
-
-    // Current descriptor indices
-    static uint32_t g_rxTail = 0;
-    static uint32_t g_txTail = 0;
-
-    // Statistics
-    static uint64_t g_rxPacketCount = 0;
-    static uint64_t g_txPacketCount = 0;
+    static RxQueue g_rxQueues[MAX_QUEUES];
+    static TxQueue g_txQueues[MAX_QUEUES];
+    static uint32_t g_queueCount = 1;
+    static bool g_rss = false;                     // RX rings use the extended format
+    static volatile uint32_t* g_msixTable = nullptr;
 
     // RX callback
     static RxCallback g_rxCallback = nullptr;
@@ -124,6 +185,88 @@ namespace Drivers::Net::E1000E {
         return *(volatile uint32_t*)(g_mmioBase + reg);
     }
 
+    static uint32_t QueueReg(uint32_t reg, uint32_t queue) {
+        return reg + queue * QUEUE_REG_STRIDE;
+    }
+
+    // What the NIC wrote back to RX slot `idx`, in either descriptor
+    // format. Status is 0 while the NIC still owns the slot.
+    static void ReadRxDesc(const RxQueue& q, uint32_t idx, uint8_t& status, uint8_t& errors, uint16_t& length) {
+        if (g_rss) {
+            const RxExtDescriptor& desc = ((const RxExtDescriptor*)q.Descs)[idx];
+            uint32_t statusError = desc.Writeback.StatusError;
+            status = (uint8_t)statusError;
+            errors = (uint8_t)(statusError >> 24);
+            length = desc.Writeback.Length;
+        } else {
+            const RxDescriptor& desc = q.Descs[idx];
+            status = desc.Status;
+            errors = desc.Errors;
+            length = desc.Length;
+        }
+    }
+
+    // Give RX slot `idx` back to the NIC with the buffer at `phys`
+    static void PostRxDesc(RxQueue& q, uint32_t idx, uint64_t phys) {
+        if (g_rss) {
+            RxExtDescriptor& desc = ((RxExtDescriptor*)q.Descs)[idx];
+            desc.Read.BufferAddress = phys;
+            desc.Read.Reserved = 0;
+        } else {
+            RxDescriptor& desc = q.Descs[idx];
+            desc.BufferAddress = phys;
+            desc.Status = 0;
+            desc.Length = 0;
+            desc.Checksum = 0;
+            desc.Errors = 0;
+            desc.Special = 0;
+        }
+    }
+
+    // RX_*_CSUM_OK flags for the checksums the NIC verified in a frame
+    static uint8_t RxChecksumFlags(uint8_t status, uint8_t errors) {
+        if (status & RXSTA_IXSM) {
+            return 0;
+        }
+        uint8_t flags = 0;
+        if ((status & RXSTA_IPCS) && !(errors & RXERR_IPE)) flags |= RX_IP_CSUM_OK;
+        if ((status & RXSTA_TCPCS) && !(errors & RXERR_TCPE)) flags |= RX_L4_CSUM_OK;
+        return flags;
+    }
+
+    // Hand the frame in RX slot `idx` to the stack and give the slot a
+    // fresh buffer. With the pool empty the frame is dropped and the NIC
+    // keeps the old buffer.
+    static void DeliverRx(RxQueue& q, uint32_t idx) {
+        uint8_t status, errors;
+        uint16_t length;
+        ReadRxDesc(q, idx, status, errors, length);
+
+        ::Net::PacketBuffer* fresh = ::Net::PacketPool::Allocate();
+        if (fresh == nullptr) {
+            return;
+        }
+
+        ::Net::PacketBuffer* packet = q.Packets[idx];
+        q.Packets[idx] = fresh;
+
+        packet->Data = packet->Head;
+        packet->Length = length;
+        if (g_rxCallback != nullptr) {
+            g_rxCallback(packet, RxChecksumFlags(status, errors));
+        }
+        ::Net::PacketPool::Release(packet);
+    }
+
+    // Drop the reference held for the last buffer sent from TX slot `idx`.
+    // Queue lock held, descriptor done.
+    static void ReclaimTx(TxQueue& q, uint32_t idx) {
+        if (q.Packets[idx] != nullptr) {
+            ::Net::PacketPool::Release(q.Packets[idx]);
+            q.Packets[idx] = nullptr;
+        }
+    }
+
     // -------------------------------------------------------------------------
     // SW/FW semaphore (prevents conflicts with Intel Management Engine)
     // -------------------------------------------------------------------------
@@ -277,6 +420,19 @@ namespace Drivers::Net::E1000E {
     // MAC address
     // -------------------------------------------------------------------------
 
+    // Write the MAC to RAL/RAH to ensure the filter is set
+    static void WriteMacFilter() {
+        WriteReg(REG_RAL,
+            (uint32_t)g_macAddress[0] |
+            ((uint32_t)g_macAddress[1] << 8) |
+            ((uint32_t)g_macAddress[2] << 16) |
+            ((uint32_t)g_macAddress[3] << 24));
+        WriteReg(REG_RAH,
+            (uint32_t)g_macAddress[4] |
+            ((uint32_t)g_macAddress[5] << 8) |
+            (1u << 31)); // AV (Address Valid) bit
+    }
+
     static void ReadMacAddress() {
         // Try reading from RAL/RAH first
         uint32_t ral = ReadReg(REG_RAL);
@@ -303,103 +459,141 @@ namespace Drivers::Net::E1000E {
             g_macAddress[5] = (uint8_t)(word2 >> 8);
         }
 
-        // Write MAC back to RAL/RAH to ensure the filter is set
-        WriteReg(REG_RAL,
-            (uint32_t)g_macAddress[0] |
-            ((uint32_t)g_macAddress[1] << 8) |
-            ((uint32_t)g_macAddress[2] << 16) |
-            ((uint32_t)g_macAddress[3] << 24));
-        WriteReg(REG_RAH,
-            (uint32_t)g_macAddress[4] |
-            ((uint32_t)g_macAddress[5] << 8) |
-            (1u << 31)); // AV (Address Valid) bit
+        WriteMacFilter();
     }
 
     // -------------------------------------------------------------------------
-    // Allocate page-aligned DMA buffer, returns virtual address
+    // RX setup
     // -------------------------------------------------------------------------
 
-    static uint8_t* AllocateDmaBuffer(uint64_t& outPhysAddr) {
-        void* virt = Memory::g_pfa->AllocateZeroed();
-        outPhysAddr = Memory::SubHHDM(virt);
-        return (uint8_t*)virt;
-    }
+    // Point the NIC at a queue's ring, every descriptor posted
+    static void ProgramRxQueue(RxQueue& q) {
+        uint32_t index = q.Index;
+        WriteReg(QueueReg(REG_RDBAL, index), (uint32_t)(q.DescsPhys & 0xFFFFFFFF));
+        WriteReg(QueueReg(REG_RDBAH, index), (uint32_t)(q.DescsPhys >> 32));
+        WriteReg(QueueReg(REG_RDLEN, index), RX_DESC_COUNT * sizeof(RxDescriptor));
+        WriteReg(QueueReg(REG_RDH, index), 0);
+        WriteReg(QueueReg(REG_RDT, index), RX_DESC_COUNT - 1);
 
-    // -------------------------------------------------------------------------
-    // RX setup
-    // -------------------------------------------------------------------------
+        q.Tail = RX_DESC_COUNT - 1;
+    }
 
-    static void SetupRx() {
-        uint64_t descPhys;
-        g_rxDescs = (RxDescriptor*)AllocateDmaBuffer(descPhys);
-        g_rxDescsPhys = descPhys;
+    static void SetupRxQueue(RxQueue& q, uint32_t index) {
+        q.Index = index;
+        q.Descs = (RxDescriptor*)Memory::Dma::Allocate(0x1000, q.DescsPhys);
 
         for (uint32_t i = 0; i < RX_DESC_COUNT; i++) {
-            g_rxBuffers[i] = AllocateDmaBuffer(g_rxBuffersPhys[i]);
+            q.Packets[i] = ::Net::PacketPool::Allocate();
+            PostRxDesc(q, i, q.Packets[i]->Phys);
+        }
 
-            // Allocate second page for larger buffer support
-            uint64_t secondPhys;
-            AllocateDmaBuffer(secondPhys);
+        ProgramRxQueue(q);
+    }
 
-            g_rxDescs[i].BufferAddress = g_rxBuffersPhys[i];
-            g_rxDescs[i].Status = 0;
-            g_rxDescs[i].Length = 0;
-            g_rxDescs[i].Checksum = 0;
-            g_rxDescs[i].Errors = 0;
-            g_rxDescs[i].Special = 0;
+    // Spread flows over the RX queues: the low 7 bits of a flow's hash
+    // pick a redirection table entry, and the entries take turns among
+    // the queues. The hash is only reported in extended descriptors, in
+    // place of the packet checksum (the IP and TCP/UDP checks still are).
+    static void SetupRss() {
+        for (uint32_t i = 0; i < RSS_KEY_SIZE / 4; i++) {
+            uint32_t word = (uint32_t)RSS_KEY[i * 4] | ((uint32_t)RSS_KEY[i * 4 + 1] << 8)
+                          | ((uint32_t)RSS_KEY[i * 4 + 2] << 16) | ((uint32_t)RSS_KEY[i * 4 + 3] << 24);
+            WriteReg(REG_RSSRK + i * 4, word);
+        }
+        for (uint32_t i = 0; i < RETA_ENTRIES / 4; i++) {
+            uint32_t reta = 0;
+            for (uint32_t b = 0; b < 4; b++) {
+                reta |= (((i * 4 + b) % g_queueCount) << RETA_QUEUE_SHIFT) << (b * 8);
+            }
+            WriteReg(REG_RETA + i * 4, reta);
         }
 
-        WriteReg(REG_RDBAL, (uint32_t)(g_rxDescsPhys & 0xFFFFFFFF));
-        WriteReg(REG_RDBAH, (uint32_t)(g_rxDescsPhys >> 32));
-        WriteReg(REG_RDLEN, RX_DESC_COUNT * sizeof(RxDescriptor));
-        WriteReg(REG_RDH, 0);
-        WriteReg(REG_RDT, RX_DESC_COUNT - 1);
+        WriteReg(REG_RFCTL, ReadReg(REG_RFCTL) | RFCTL_EXTEN);
+        WriteReg(REG_MRQC, MRQC_RSS_ENABLE_2Q | MRQC_RSS_FIELD_IPV4_TCP | MRQC_RSS_FIELD_IPV4);
+    }
 
-        g_rxTail = RX_DESC_COUNT - 1;
+    // RSS, checksum offload and the receiver, once the queues are programmed
+    static void ProgramRx() {
+        uint32_t rxcsum = RXCSUM_IPOFLD | RXCSUM_TUOFLD;
+        if (g_rss) {
+            SetupRss();
+            rxcsum |= RXCSUM_PCSD;
+        }
+        WriteReg(REG_RXCSUM, rxcsum);
 
-        uint32_t rctl = RCTL_EN | RCTL_BAM | RCTL_SECRC | RCTL_BSIZE_4096 | RCTL_BSEX;
+        uint32_t rctl = RCTL_EN | RCTL_BAM | RCTL_SECRC | RCTL_BSIZE_2048;
         WriteReg(REG_RCTL, rctl);
+    }
+
+    static void SetupRx() {
+        g_rss = g_queueCount > 1;
+        for (uint32_t i = 0; i < g_queueCount; i++) {
+            SetupRxQueue(g_rxQueues[i], i);
+        }
+        ProgramRx();
 
-        KernelLogStream(OK, "E1000E") << "RX ring configured: " << base::dec << (uint64_t)RX_DESC_COUNT << " descriptors";
+        KernelLogStream(OK, "E1000E") << "RX ring configured: " << base::dec << (uint64_t)g_queueCount
+            << " x " << (uint64_t)RX_DESC_COUNT << " descriptors" << (g_rss ? ", RSS" : "");
     }
 
     // -------------------------------------------------------------------------
     // TX setup
     // -------------------------------------------------------------------------
 
-    static void SetupTx() {
-        uint64_t descPhys;
-        g_txDescs = (TxDescriptor*)AllocateDmaBuffer(descPhys);
-        g_txDescsPhys = descPhys;
+    // Point the NIC at a queue's ring, every descriptor free
+    static void ProgramTxQueue(TxQueue& q) {
+        uint32_t index = q.Index;
+        WriteReg(QueueReg(REG_TDBAL, index), (uint32_t)(q.DescsPhys & 0xFFFFFFFF));
+        WriteReg(QueueReg(REG_TDBAH, index), (uint32_t)(q.DescsPhys >> 32));
+        WriteReg(QueueReg(REG_TDLEN, index), TX_DESC_COUNT * sizeof(TxDescriptor));
+        WriteReg(QueueReg(REG_TDH, index), 0);
+        WriteReg(QueueReg(REG_TDT, index), 0);
+
+        q.Tail = 0;
+
+        // The queues take turns a frame at a time
+        if (g_queueCount > 1) {
+            uint32_t tarc = ReadReg(QueueReg(REG_TARC, index));
+            WriteReg(QueueReg(REG_TARC, index), (tarc & ~0x7Fu) | 1);
+        }
+    }
 
-        for (uint32_t i = 0; i < TX_DESC_COUNT; i++) {
-            g_txBuffers[i] = AllocateDmaBuffer(g_txBuffersPhys[i]);
+    static void SetupTxQueue(TxQueue& q, uint32_t index) {
+        q.Index = index;
+        q.Descs = (TxDescriptor*)Memory::Dma::Allocate(0x1000, q.DescsPhys);
 
-            g_txDescs[i].BufferAddress = g_txBuffersPhys[i];
-            g_txDescs[i].Length = 0;
-            g_txDescs[i].Command = 0;
-            g_txDescs[i].Status = TXSTA_DD;
-            g_txDescs[i].ChecksumOffset = 0;
-            g_txDescs[i].ChecksumStart = 0;
-            g_txDescs[i].Special = 0;
+        for (uint32_t i = 0; i < TX_DESC_COUNT; i++) {
+            q.Buffers[i] = (uint8_t*)Memory::Dma::Allocate(0x1000, q.BuffersPhys[i]);
+
+            q.Descs[i].BufferAddress = q.BuffersPhys[i];
+            q.Descs[i].Length = 0;
+            q.Descs[i].Command = 0;
+            q.Descs[i].Status = TXSTA_DD;
+            q.Descs[i].ChecksumOffset = 0;
+            q.Descs[i].ChecksumStart = 0;
+            q.Descs[i].Special = 0;
         }
 
-        WriteReg(REG_TDBAL, (uint32_t)(g_txDescsPhys & 0xFFFFFFFF));
-        WriteReg(REG_TDBAH, (uint32_t)(g_txDescsPhys >> 32));
-        WriteReg(REG_TDLEN, TX_DESC_COUNT * sizeof(TxDescriptor));
-        WriteReg(REG_TDH, 0);
-        WriteReg(REG_TDT, 0);
-
-        g_txTail = 0;
+        ProgramTxQueue(q);
+    }
 
+    static void ProgramTx() {
         uint32_t tctl = TCTL_EN | TCTL_PSP
                       | (15u << TCTL_CT_SHIFT)
                       | (64u << TCTL_COLD_SHIFT);
         WriteReg(REG_TCTL, tctl);
 
         WriteReg(REG_TIPG, 10 | (10 << 10) | (10 << 20));
+    }
 
-        KernelLogStream(OK, "E1000E") << "TX ring configured: " << base::dec << (uint64_t)TX_DESC_COUNT << " descriptors";
+    static void SetupTx() {
+        for (uint32_t i = 0; i < g_queueCount; i++) {
+            SetupTxQueue(g_txQueues[i], i);
+        }
+        ProgramTx();
+
+        KernelLogStream(OK, "E1000E") << "TX ring configured: " << base::dec << (uint64_t)g_queueCount
+            << " x " << (uint64_t)TX_DESC_COUNT << " descriptors";
     }
 
     // -------------------------------------------------------------------------
@@ -407,16 +601,11 @@ namespace Drivers::Net::E1000E {
     // -------------------------------------------------------------------------
 
     static void HandleInterrupt(uint8_t irq); // forward declaration
+    static void RunRx(RxQueue& q);
 
-    static bool SetupMsi(uint8_t bus, uint8_t dev, uint8_t func) {
-        uint8_t cap = Pci::FindCapability(bus, dev, func, Pci::PCI_CAP_MSI);
-        if (cap == 0) {
-            KernelLogStream(INFO, "E1000E") << "MSI capability not found";
-            return false;
-        }
-
-        KernelLogStream(INFO, "E1000E") << "MSI capability at offset " << base::hex << (uint64_t)cap;
-
+    // Program the MSI capability at `cap` and mask INTx. Returns whether
+    // the capability takes 64-bit addresses.
+    static bool ProgramMsi(uint8_t bus, uint8_t dev, uint8_t func, uint8_t cap) {
         // Read Message Control (cap+2)
         uint16_t msgCtrl = Pci::LegacyRead16(bus, dev, func, cap + 2);
         bool is64bit = (msgCtrl & (1 << 7)) != 0;
@@ -443,9 +632,23 @@ namespace Drivers::Net::E1000E {
         uint16_t pciCmd = Pci::LegacyRead16(bus, dev, func, (uint8_t)Pci::PCI_REG_COMMAND);
         pciCmd |= Pci::PCI_CMD_INTX_DISABLE;
         Pci::LegacyWrite16(bus, dev, func, (uint8_t)Pci::PCI_REG_COMMAND, pciCmd);
+        return is64bit;
+    }
+
+    static bool SetupMsi(uint8_t bus, uint8_t dev, uint8_t func) {
+        uint8_t cap = Pci::FindCapability(bus, dev, func, Pci::PCI_CAP_MSI);
+        if (cap == 0) {
+            KernelLogStream(INFO, "E1000E") << "MSI capability not found";
+            return false;
+        }
+
+        KernelLogStream(INFO, "E1000E") << "MSI capability at offset " << base::hex << (uint64_t)cap;
+
+        bool is64bit = ProgramMsi(bus, dev, func, cap);
 
         // Register the interrupt handler for MSI vector
         Hal::RegisterIrqHandler(MSI_IRQ, HandleInterrupt);
+        g_msiEnabled = true;
 
         KernelLogStream(OK, "E1000E") << "MSI enabled: vector " << base::dec << (uint64_t)MSI_VECTOR
             << " (IRQ slot " << (uint64_t)MSI_IRQ << ")" << (is64bit ? " [64-bit]" : " [32-bit]");
@@ -453,10 +656,108 @@ namespace Drivers::Net::E1000E {
         return true;
     }
 
+    // -------------------------------------------------------------------------
+    // MSI-X setup
+    // -------------------------------------------------------------------------
+
+    static void HandleQueueInterrupt(uint8_t irq);
+    static void HandleOtherInterrupt(uint8_t irq);
+
+    static void WriteMsixEntry(uint32_t entry, uint32_t lapicId, uint8_t irq) {
+        volatile uint32_t* e = g_msixTable + entry * 4;
+        e[MSIX_ENTRY_CTRL] = 1;
+        e[MSIX_ENTRY_ADDR_LO] = MSI_ADDR_BASE | (lapicId << 12);
+        e[MSIX_ENTRY_ADDR_HI] = 0;
+        e[MSIX_ENTRY_DATA] = Hal::IRQ_VECTOR_BASE + irq;
+        e[MSIX_ENTRY_CTRL] = 0;
+    }
+
+    // Fill the table (mapped at g_msixTable) for g_queueCount queues, turn
+    // MSI-X on at `cap` and mask INTx
+    static void ProgramMsix(uint8_t bus, uint8_t dev, uint8_t func, uint8_t cap) {
+        for (uint32_t i = 0; i < g_queueCount; i++) {
+            WriteMsixEntry(i, Smp::GetCpuData((int)i)->lapicId, MSIX_QUEUE_IRQ[i]);
+        }
+        WriteMsixEntry(g_queueCount, Smp::GetCpuData(0)->lapicId, MSIX_OTHER_IRQ);
+
+        uint16_t msgCtrl = Pci::LegacyRead16(bus, dev, func, cap + 2);
+        msgCtrl &= ~MSIX_CTRL_FMASK;
+        msgCtrl |= MSIX_CTRL_ENABLE;
+        Pci::LegacyWrite16(bus, dev, func, cap + 2, msgCtrl);
+
+        uint16_t pciCmd = Pci::LegacyRead16(bus, dev, func, (uint8_t)Pci::PCI_REG_COMMAND);
+        pciCmd |= Pci::PCI_CMD_INTX_DISABLE;
+        Pci::LegacyWrite16(bus, dev, func, (uint8_t)Pci::PCI_REG_COMMAND, pciCmd);
+    }
+
+    // Only the 82574 has MSI-X. Sets g_queueCount: one RX and TX queue per
+    // online CPU, as far as the device goes. RX queue n's vector goes to
+    // CPU n, the other causes to the BSP.
+    static bool SetupMsix(uint8_t bus, uint8_t dev, uint8_t func) {
+        uint8_t cap = Pci::FindCapability(bus, dev, func, Pci::PCI_CAP_MSIX);
+        if (cap == 0) {
+            return false;
+        }
+
+        uint16_t msgCtrl = Pci::LegacyRead16(bus, dev, func, cap + 2);
+        uint32_t tableSize = (msgCtrl & MSIX_TABLE_SIZE_MASK) + 1u;
+        if (tableSize < 2) return false;
+
+        uint32_t tableReg = Pci::LegacyRead32(bus, dev, func, cap + 4);
+        uint64_t barPhys = Pci::ReadBar(bus, dev, func, (int)(tableReg & 0x7));
+        if (barPhys == 0) return false;
+        uint64_t tablePhys = barPhys + (tableReg & ~0x7u);
+
+        uint64_t first = tablePhys & ~0xFFFULL;
+        uint64_t last = (tablePhys + (uint64_t)tableSize * 16 - 1) & ~0xFFFULL;
+        for (uint64_t page = first; page <= last; page += 0x1000) {
+            Memory::VMM::g_paging->MapMMIO(page, Memory::HHDM(page));
+        }
+        g_msixTable = (volatile uint32_t*)Memory::HHDM(tablePhys);
+
+        int cpus = Smp::GetCpuCount();
+        if (cpus < 1) cpus = 1;
+        g_queueCount = (uint32_t)cpus < MAX_QUEUES ? (uint32_t)cpus : MAX_QUEUES;
+        if (g_queueCount > tableSize - 1) g_queueCount = tableSize - 1;
+
+        for (uint32_t i = 0; i < g_queueCount; i++) {
+            Hal::RegisterIrqHandler(MSIX_QUEUE_IRQ[i], HandleQueueInterrupt);
+        }
+        Hal::RegisterIrqHandler(MSIX_OTHER_IRQ, HandleOtherInterrupt);
+        ProgramMsix(bus, dev, func, cap);
+
+        KernelLogStream(OK, "E1000E") << "MSI-X enabled: " << base::dec << (uint64_t)g_queueCount
+            << " RX queue vector(s) + link";
+        return true;
+    }
+
+    // Tie the causes to the vectors SetupMsix routed: RX queue n to vector
+    // n, the rest to the last one. Each vector clears its causes when it
+    // fires; TX completions are reaped lazily and get no vector.
+    static void EnableMsixCauses() {
+        uint32_t ivar = (IVAR_VALID | g_queueCount) << (IVAR_OTHER_FIELD * IVAR_FIELD_BITS);
+        uint32_t queueCauses = 0;
+        for (uint32_t i = 0; i < g_queueCount; i++) {
+            ivar |= (IVAR_VALID | i) << (i * IVAR_FIELD_BITS);
+            queueCauses |= ICR_RXQ0 << i;
+            WriteReg(REG_EITR + i * 4, ITR_INTERVAL);
+        }
+        WriteReg(REG_IVAR, ivar);
+        WriteReg(REG_EIAC, queueCauses);
+        WriteReg(REG_CTRL_EXT, ReadReg(REG_CTRL_EXT) | CTRL_EXT_PBA_CLR);
+        WriteReg(REG_IMS, queueCauses | ICR_OTHER | ICR_LSC);
+    }
+
     // -------------------------------------------------------------------------
     // Interrupt handler
     // -------------------------------------------------------------------------
 
+    static void LogLinkChange() {
+        uint32_t status = ReadReg(REG_STATUS);
+        bool linkUp = (status & (1 << 1)) != 0;
+        KernelLogStream(INFO, "E1000E") << "Link status change: " << (linkUp ? "UP" : "DOWN");
+    }
+
     static void HandleInterrupt(uint8_t irq) {
         (void)irq;
 
@@ -468,39 +769,38 @@ namespace Drivers::Net::E1000E {
         }
 
         if (icr & ICR_LSC) {
-            uint32_t status = ReadReg(REG_STATUS);
-            bool linkUp = (status & (1 << 1)) != 0;
-            KernelLogStream(INFO, "E1000E") << "Link status change: " << (linkUp ? "UP" : "DOWN");
+            LogLinkChange();
         }
 
-        if (icr & ICR_RXT0) {
-            while (true) {
-                uint32_t nextIdx = (g_rxTail + 1) % RX_DESC_COUNT;
-                RxDescriptor& desc = g_rxDescs[nextIdx];
-
-                if (!(desc.Status & RXSTA_DD)) {
-                    break;
-                }
-
-                uint16_t length = desc.Length;
-                g_rxPacketCount++;
-
-                if (g_rxCallback != nullptr) {
-                    g_rxCallback(g_rxBuffers[nextIdx], length);
-                }
-
-                desc.Status = 0;
-                desc.Length = 0;
-                desc.Errors = 0;
+        if (icr & RX_INTERRUPTS) {
+            RxQueue& q = g_rxQueues[0];
+            WriteReg(REG_IMC, RX_INTERRUPTS);
+            q.Polling = true;
+            RunRx(q);
+        }
+    }
 
-                g_rxTail = nextIdx;
-                WriteReg(REG_RDT, g_rxTail);
+    // MSI-X vector of one RX queue, on that queue's CPU
+    static void HandleQueueInterrupt(uint8_t irq) {
+        for (uint32_t i = 0; i < g_queueCount; i++) {
+            if (MSIX_QUEUE_IRQ[i] == irq) {
+                RunRx(g_rxQueues[i]);
+                return;
             }
         }
+    }
 
-        if (icr & (ICR_TXDW | ICR_TXQE)) {
-            // TX completion — nothing to do for now
+    // MSI-X vector of the other causes. Reading ICR clears every cause, so
+    // queue causes still waiting out their throttle are set again.
+    static void HandleOtherInterrupt(uint8_t irq) {
+        (void)irq;
+        uint32_t icr = ReadReg(REG_ICR);
+        if (icr & ICR_LSC) {
+            LogLinkChange();
         }
+        uint32_t queueCauses = icr & (((ICR_RXQ0 << g_queueCount) - 1) & ~(ICR_RXQ0 - 1));
+        if (queueCauses != 0) WriteReg(REG_ICS, queueCauses);
+        WriteReg(REG_IMS, ICR_OTHER | ICR_LSC);
     }
 
     // -------------------------------------------------------------------------
@@ -508,36 +808,10 @@ namespace Drivers::Net::E1000E {
     // -------------------------------------------------------------------------
 
     // -------------------------------------------------------------------------
-    // Shared init logic (used by both Probe and Initialize)
+    // ICH/PCH reset sequence, leaving interrupts masked and link up
     // -------------------------------------------------------------------------
 
-    static bool InitDevice(uint8_t bus, uint8_t device, uint8_t function, const char* deviceName) {
-        KernelLogStream(OK, "E1000E") << "Found " << deviceName << " at PCI "
-            << base::hex << (uint64_t)bus << ":"
-            << (uint64_t)device << "." << (uint64_t)function;
-
-        // Read BAR0
-        uint64_t mmioPhys = Pci::ReadBar0(bus, device, function);
-        KernelLogStream(INFO, "E1000E") << "BAR0 physical: " << base::hex << mmioPhys;
-
-        // Map the MMIO region (128KB = 32 pages)
-        constexpr uint64_t MmioSize = 0x20000;
-        for (uint64_t offset = 0; offset < MmioSize; offset += 0x1000) {
-            Memory::VMM::g_paging->MapMMIO(mmioPhys + offset, Memory::HHDM(mmioPhys + offset));
-        }
-
-        g_mmioBase = (volatile uint8_t*)Memory::HHDM(mmioPhys);
-
-        // Enable bus mastering and memory space
-        Pci::EnableBusMaster(bus, device, function);
-        KernelLogStream(OK, "E1000E") << "Bus mastering enabled";
-
-        // Read interrupt line from PCI config (used for legacy IRQ fallback)
-        g_irqLine = Pci::LegacyRead8(bus, device, function, (uint8_t)Pci::PCI_REG_INTERRUPT);
-        KernelLogStream(INFO, "E1000E") << "PCI IRQ line: " << base::dec << (uint64_t)g_irqLine;
-
-        // --- ICH/PCH reset sequence ---
-
+    static void ResetController() {
         KernelLogStream(INFO, "E1000E") << "Disabling interrupts...";
         WriteReg(REG_IMC, 0xFFFFFFFF);
         ReadReg(REG_ICR);
@@ -571,7 +845,115 @@ namespace Drivers::Net::E1000E {
         ctrl &= ~(1u << 31);
         ctrl &= ~(1u << 7);
         WriteReg(REG_CTRL, ctrl);
+    }
+
+    // -------------------------------------------------------------------------
+    // S3 suspend/resume
+    // The rings, their buffers and the MSI-X table mapping stay in RAM;
+    // resume puts the registers pointing at them back instead of setting
+    // the device up again.
+    // -------------------------------------------------------------------------
+
+    static void SuspendController() {
+        WriteReg(REG_IMC, 0xFFFFFFFF);
+        WriteReg(REG_RCTL, ReadReg(REG_RCTL) & ~RCTL_EN);
+        WriteReg(REG_TCTL, ReadReg(REG_TCTL) & ~TCTL_EN);
+    }
+
+    // Runs on its own thread after the desktop is back. Auto-negotiation
+    // finishes after it returns and is reported by the LSC interrupt.
+    static void ResumeController() {
+        Pci::EnableBusMaster(g_pciBus, g_pciDevice, g_pciFunction);
+        ResetController();
+        InitPhy();
+        WriteMacFilter();
+        for (uint32_t i = 0; i < 128; i++) {
+            WriteReg(REG_MTA + (i * 4), 0);
+        }
+
+        if (g_msixTable != nullptr) {
+            uint8_t cap = Pci::FindCapability(g_pciBus, g_pciDevice, g_pciFunction, Pci::PCI_CAP_MSIX);
+            if (cap != 0) ProgramMsix(g_pciBus, g_pciDevice, g_pciFunction, cap);
+        } else if (g_msiEnabled) {
+            uint8_t cap = Pci::FindCapability(g_pciBus, g_pciDevice, g_pciFunction, Pci::PCI_CAP_MSI);
+            if (cap != 0) ProgramMsi(g_pciBus, g_pciDevice, g_pciFunction, cap);
+        }
+
+        // Frames the NIC had not handed back are dropped
+        for (uint32_t n = 0; n < g_queueCount; n++) {
+            RxQueue& q = g_rxQueues[n];
+            q.Lock.Acquire();
+            for (uint32_t i = 0; i < RX_DESC_COUNT; i++) {
+                PostRxDesc(q, i, q.Packets[i]->Phys);
+            }
+            ProgramRxQueue(q);
+            q.Polling = false;
+            q.Lock.Release();
+        }
+        ProgramRx();
+
+        for (uint32_t n = 0; n < g_queueCount; n++) {
+            TxQueue& q = g_txQueues[n];
+            q.Lock.Acquire();
+            for (uint32_t i = 0; i < TX_DESC_COUNT; i++) {
+                ReclaimTx(q, i);
+                q.Descs[i] = {};
+                q.Descs[i].BufferAddress = q.BuffersPhys[i];
+                q.Descs[i].Status = TXSTA_DD;
+            }
+            ProgramTxQueue(q);
+            q.Lock.Release();
+        }
+        ProgramTx();
+
+        WriteReg(REG_ITR, ITR_INTERVAL);
+        WriteReg(REG_RDTR, 0);
+
+        if (g_msixTable != nullptr) {
+            EnableMsixCauses();
+        } else if (!g_pollingMode) {
+            WriteReg(REG_IMS, RX_INTERRUPTS | ICR_LSC);
+        }
+    }
+
+    static void RegisterPowerHooks(uint8_t bus, uint8_t dev, uint8_t func) {
+        g_pciBus = bus;
+        g_pciDevice = dev;
+        g_pciFunction = func;
+        Hal::AcpiSleep::RegisterDevice({"E1000E", SuspendController, ResumeController,
+                                        Hal::AcpiSleep::ResumeStage::Deferred});
+    }
+
+    // -------------------------------------------------------------------------
+    // Shared init logic (used by both Probe and Initialize)
+    // -------------------------------------------------------------------------
+
+    static bool InitDevice(uint8_t bus, uint8_t device, uint8_t function, const char* deviceName) {
+        KernelLogStream(OK, "E1000E") << "Found " << deviceName << " at PCI "
+            << base::hex << (uint64_t)bus << ":"
+            << (uint64_t)device << "." << (uint64_t)function;
+
+        // Read BAR0
+        uint64_t mmioPhys = Pci::ReadBar0(bus, device, function);
+        KernelLogStream(INFO, "E1000E") << "BAR0 physical: " << base::hex << mmioPhys;
+
+        // Map the MMIO region (128KB = 32 pages)
+        constexpr uint64_t MmioSize = 0x20000;
+        for (uint64_t offset = 0; offset < MmioSize; offset += 0x1000) {
+            Memory::VMM::g_paging->MapMMIO(mmioPhys + offset, Memory::HHDM(mmioPhys + offset));
+        }
+
+        g_mmioBase = (volatile uint8_t*)Memory::HHDM(mmioPhys);
+
+        // Enable bus mastering and memory space
+        Pci::EnableBusMaster(bus, device, function);
+        KernelLogStream(OK, "E1000E") << "Bus mastering enabled";
 
+        // Read interrupt line from PCI config (used for legacy IRQ fallback)
+        g_irqLine = Pci::LegacyRead8(bus, device, function, (uint8_t)Pci::PCI_REG_INTERRUPT);
+        KernelLogStream(INFO, "E1000E") << "PCI IRQ line: " << base::dec << (uint64_t)g_irqLine;
+
+        ResetController();
         InitPhy();
         ReadMacAddress();
 
@@ -584,22 +966,31 @@ namespace Drivers::Net::E1000E {
             WriteReg(REG_MTA + (i * 4), 0);
         }
 
+        // The queue count depends on MSI-X
+        bool msix = SetupMsix(bus, device, function);
         SetupRx();
         SetupTx();
 
-        if (SetupMsi(bus, device, function)) {
-            WriteReg(REG_IMS, ICR_RXT0 | ICR_TXDW | ICR_TXQE | ICR_LSC | ICR_RXDMT0);
+        // TX completions are reaped lazily in SendPacket and need no interrupt
+        WriteReg(REG_ITR, ITR_INTERVAL);
+        WriteReg(REG_RDTR, 0);
+
+        if (msix) {
+            EnableMsixCauses();
+        } else if (SetupMsi(bus, device, function)) {
+            WriteReg(REG_IMS, RX_INTERRUPTS | ICR_LSC);
         } else if (g_irqLine != 0xFF) {
             KernelLogStream(INFO, "E1000E") << "Falling back to legacy IRQ " << base::dec << (uint64_t)g_irqLine;
             Hal::RegisterIrqHandler(g_irqLine, HandleInterrupt);
             Hal::IoApic::UnmaskIrq(Hal::IoApic::GetGsiForIrq(g_irqLine));
-            WriteReg(REG_IMS, ICR_RXT0 | ICR_TXDW | ICR_TXQE | ICR_LSC | ICR_RXDMT0);
+            WriteReg(REG_IMS, RX_INTERRUPTS | ICR_LSC);
         } else {
             KernelLogStream(WARNING, "E1000E") << "No MSI or legacy IRQ available, using polling mode";
             g_pollingMode = true;
         }
 
         g_initialized = true;
+        RegisterPowerHooks(bus, device, function);
 
         uint32_t status = ReadReg(REG_STATUS);
         bool linkUp = (status & (1 << 1)) != 0;
@@ -662,71 +1053,237 @@ namespace Drivers::Net::E1000E {
     }
 
     // -------------------------------------------------------------------------
-    // Polling: process received packets (with reentrancy guard)
+    // Receive processing
     // -------------------------------------------------------------------------
 
-    static bool g_polling = false;
+    static bool RxPending(const RxQueue& q) {
+        uint8_t status, errors;
+        uint16_t length;
+        ReadRxDesc(q, (q.Tail + 1) % RX_DESC_COUNT, status, errors, length);
+        return (status & RXSTA_DD) != 0;
+    }
+
+    // Hand up to `budget` packets to the stack and give their descriptors
+    // back in one tail update. Returns true if the ring is empty. Queue lock held.
+    static bool ProcessRx(RxQueue& q, uint32_t budget) {
+        uint32_t done = 0;
+        while (done < budget && RxPending(q)) {
+            uint32_t nextIdx = (q.Tail + 1) % RX_DESC_COUNT;
+
+            q.PacketCount++;
+            DeliverRx(q, nextIdx);
+            PostRxDesc(q, nextIdx, q.Packets[nextIdx]->Phys);
+
+            q.Tail = nextIdx;
+            done++;
+        }
+        if (done > 0) WriteReg(QueueReg(REG_RDT, q.Index), q.Tail);
+        return !RxPending(q);
+    }
 
-    static void PollRx() {
-        // Guard against reentrancy: RX callback can trigger ARP reply →
-        // Ethernet::Send → SendPacket → PollRx(). Two concurrent callers
-        // modifying g_rxTail / RDT would corrupt the descriptor ring.
-        if (g_polling) {
+    // One budgeted pass over a queue's ring. Leaves polling mode (unmasks
+    // RX interrupts) once the ring is empty, unless there is no interrupt;
+    // with MSI-X, a pass that leaves packets behind raises the queue's
+    // cause again instead.
+    static void RunRx(RxQueue& q) {
+        // The RX callback can send (ARP replies, ACKs), and another CPU may
+        // be here already; either way the current holder does the work
+        if (!q.Lock.TryAcquire()) {
             return;
         }
-        g_polling = true;
 
-        while (true) {
-            uint32_t nextIdx = (g_rxTail + 1) % RX_DESC_COUNT;
-            RxDescriptor& desc = g_rxDescs[nextIdx];
+        bool drained = ProcessRx(q, RX_BUDGET);
+        if (g_msixTable != nullptr) {
+            if (!drained) WriteReg(REG_ICS, ICR_RXQ0 << q.Index);
+        } else if (drained && q.Polling && !g_pollingMode) {
+            q.Polling = false;
+            WriteReg(REG_IMS, RX_INTERRUPTS);
+        }
 
-            if (!(desc.Status & RXSTA_DD)) {
-                break;
-            }
+        q.Lock.Release();
+    }
 
-            uint16_t length = desc.Length;
-            g_rxPacketCount++;
+    // -------------------------------------------------------------------------
+    // Transmit
+    // -------------------------------------------------------------------------
 
-            if (g_rxCallback != nullptr) {
-                g_rxCallback(g_rxBuffers[nextIdx], length);
-            }
+    // The TX queue for a frame: a hash of its IPv4 addresses, and ports
+    // for TCP and UDP, so a flow always leaves through the same queue.
+    // `frame` holds at least the start of the frame, `length` bytes.
+    static TxQueue& TxQueueFor(const uint8_t* frame, uint32_t length) {
+        if (g_queueCount == 1 || length < 34 || frame[12] != 0x08 || frame[13] != 0x00) {
+            return g_txQueues[0];
+        }
 
-            desc.Status = 0;
-            desc.Length = 0;
-            desc.Errors = 0;
+        uint32_t hash = 0;
+        for (uint32_t i = 26; i < 34; i++) hash = hash * 31 + frame[i];
+        uint32_t l4 = 14 + (frame[14] & 0x0F) * 4u;
+        uint8_t protocol = frame[23];
+        if ((protocol == 6 || protocol == 17) && length >= l4 + 4) {
+            for (uint32_t i = l4; i < l4 + 4; i++) hash = hash * 31 + frame[i];
+        }
+        hash ^= hash >> 16;
+        hash ^= hash >> 8;
+        return g_txQueues[hash % g_queueCount];
+    }
 
-            g_rxTail = nextIdx;
-            WriteReg(REG_RDT, g_rxTail);
+    // Post one single-descriptor frame on `q`, from the TX buffer `data`
+    // was copied to, or from `packet` in place
+    static bool SendOne(TxQueue& q, const uint8_t* data, ::Net::PacketBuffer* packet, uint16_t length) {
+        q.Lock.Acquire();
+
+        TxDescriptor& desc = q.Descs[q.Tail];
+        if (!(desc.Status & TXSTA_DD)) {
+            q.Lock.Release();
+            KernelLogStream(WARNING, "E1000E") << "TX ring full";
+            return false;
         }
+        ReclaimTx(q, q.Tail);
 
-        g_polling = false;
+        if (packet != nullptr) {
+            // The NIC reads the frame straight out of the pool buffer
+            ::Net::PacketPool::Retain(packet);
+            q.Packets[q.Tail] = packet;
+            desc.BufferAddress = packet->DataPhys();
+        } else {
+            memcpy(q.Buffers[q.Tail], data, length);
+            desc.BufferAddress = q.BuffersPhys[q.Tail];
+        }
+        desc.Length = length;
+        desc.ChecksumOffset = 0;
+        desc.Command = TXCMD_EOP | TXCMD_IFCS | TXCMD_RS;
+        desc.ChecksumStart = 0;
+        desc.Special = 0;
+        desc.Status = 0;
+
+        q.Tail = (q.Tail + 1) % TX_DESC_COUNT;
+        WriteReg(QueueReg(REG_TDT, q.Index), q.Tail);
+
+        q.PacketCount++;
+        q.Lock.Release();
+        return true;
     }
 
     bool SendPacket(const uint8_t* data, uint16_t length) {
         if (!g_initialized || data == nullptr || length == 0 || length > 1518) {
             return false;
         }
+        return SendOne(TxQueueFor(data, length), data, nullptr, length);
+    }
 
-        TxDescriptor& desc = g_txDescs[g_txTail];
-        if (!(desc.Status & TXSTA_DD)) {
-            KernelLogStream(WARNING, "E1000E") << "TX ring full";
+    bool SendBuffer(::Net::PacketBuffer* packet) {
+        if (!g_initialized || packet == nullptr || packet->Length == 0 || packet->Length > 1518) {
             return false;
         }
+        return SendOne(TxQueueFor(packet->Data, packet->Length), nullptr, packet, packet->Length);
+    }
 
-        memcpy(g_txBuffers[g_txTail], data, length);
+    // A context descriptor tells the NIC where the headers are and what to
+    // do with them; the frame follows in data descriptors, one TX buffer
+    // each. With TSE set, the NIC sends the payload as Mss-sized segments.
+    bool SendPacketOffload(const TxFragment* fragments, uint32_t count, const TxOffload& off) {
+        if (!g_initialized || fragments == nullptr || count == 0) {
+            return false;
+        }
 
-        desc.BufferAddress = g_txBuffersPhys[g_txTail];
-        desc.Length = length;
-        desc.Command = TXCMD_EOP | TXCMD_IFCS | TXCMD_RS;
-        desc.Status = 0;
+        uint32_t length = 0;
+        for (uint32_t i = 0; i < count; i++) {
+            length += fragments[i].Length;
+        }
 
-        g_txTail = (g_txTail + 1) % TX_DESC_COUNT;
-        WriteReg(REG_TDT, g_txTail);
+        bool tso = off.Mss != 0;
+        uint32_t limit = tso ? TSO_MAX_FRAME_SIZE : 1518;
+        if (length <= off.HeaderLen || length > limit || off.L4Offset <= off.IpOffset) {
+            return false;
+        }
 
-        g_txPacketCount++;
+        // The queue hash only needs the headers
+        uint8_t headers[64];
+        uint32_t headerLen = 0;
+        for (uint32_t i = 0; i < count && headerLen < sizeof(headers); i++) {
+            uint32_t n = fragments[i].Length;
+            if (n > sizeof(headers) - headerLen) n = sizeof(headers) - headerLen;
+            memcpy(headers + headerLen, fragments[i].Data, n);
+            headerLen += n;
+        }
+        TxQueue& q = TxQueueFor(headers, headerLen);
+
+        uint32_t needed = 1 + (length + TX_BUFFER_SIZE - 1) / TX_BUFFER_SIZE;
+
+        q.Lock.Acquire();
+
+        for (uint32_t i = 0; i < needed; i++) {
+            if (!(q.Descs[(q.Tail + i) % TX_DESC_COUNT].Status & TXSTA_DD)) {
+                q.Lock.Release();
+                KernelLogStream(WARNING, "E1000E") << "TX ring full";
+                return false;
+            }
+        }
+        for (uint32_t i = 0; i < needed; i++) {
+            ReclaimTx(q, (q.Tail + i) % TX_DESC_COUNT);
+        }
+
+        uint8_t segmentCmd = tso ? TXCMD_TSE : 0;
+
+        TxContextDescriptor& ctx = *(TxContextDescriptor*)&q.Descs[q.Tail];
+        ctx.IpStart = off.IpOffset;
+        ctx.IpOffset = off.IpOffset + 10;
+        ctx.IpEnd = off.L4Offset - 1;
+        ctx.TcpStart = off.L4Offset;
+        ctx.TcpOffset = off.L4Offset + 16;
+        ctx.TcpEnd = 0;
+        ctx.PayloadLenCmd = ((tso ? length - off.HeaderLen : 0) & 0xFFFFF)
+                          | ((uint32_t)TXDTYP_CONTEXT << 20)
+                          | ((uint32_t)(TXCMD_DEXT | TXCMD_RS | TUCMD_IP | TUCMD_TCP | segmentCmd) << 24);
+        ctx.Status = 0;
+        ctx.HeaderLen = tso ? off.HeaderLen : 0;
+        ctx.Mss = off.Mss;
+        q.Tail = (q.Tail + 1) % TX_DESC_COUNT;
+
+        // Gather the fragments into consecutive TX buffers
+        uint32_t frag = 0;
+        uint32_t fragOffset = 0;
+        uint32_t remaining = length;
+        while (remaining > 0) {
+            uint32_t chunk = remaining < TX_BUFFER_SIZE ? remaining : TX_BUFFER_SIZE;
+            uint8_t* buffer = q.Buffers[q.Tail];
+            uint32_t filled = 0;
+            while (filled < chunk) {
+                uint32_t n = fragments[frag].Length - fragOffset;
+                if (n > chunk - filled) n = chunk - filled;
+                memcpy(buffer + filled, fragments[frag].Data + fragOffset, n);
+                filled += n;
+                fragOffset += n;
+                if (fragOffset == fragments[frag].Length) {
+                    frag++;
+                    fragOffset = 0;
+                }
+            }
+            remaining -= chunk;
+
+            uint8_t cmd = TXCMD_DEXT | TXCMD_IFCS | TXCMD_RS | segmentCmd;
+            if (remaining == 0) cmd |= TXCMD_EOP;
+
+            TxDataDescriptor& desc = *(TxDataDescriptor*)&q.Descs[q.Tail];
+            desc.BufferAddress = q.BuffersPhys[q.Tail];
+            desc.LengthCmd = chunk | ((uint32_t)TXDTYP_DATA << 20) | ((uint32_t)cmd << 24);
+            desc.Options = TXPOPTS_IXSM | TXPOPTS_TXSM;
+            desc.Special = 0;
+            desc.Status = 0;
+            q.Tail = (q.Tail + 1) % TX_DESC_COUNT;
+        }
+
+        WriteReg(QueueReg(REG_TDT, q.Index), q.Tail);
+
+        q.PacketCount++;
+        q.Lock.Release();
         return true;
     }
 
+    uint32_t GetOffloads() {
+        return OFFLOAD_TX_CSUM | OFFLOAD_TSO | OFFLOAD_RX_CSUM;
+    }
+
     const uint8_t* GetMacAddress() {
         return g_macAddress;
     }
@@ -743,7 +1300,10 @@ namespace Drivers::Net::E1000E {
         if (!g_initialized) {
             return;
         }
-        PollRx();
+        for (uint32_t i = 0; i < g_queueCount; i++) {
+            RxQueue& q = g_rxQueues[i];
+            if (q.Polling || g_pollingMode) RunRx(q);
+        }
     }
 
 };
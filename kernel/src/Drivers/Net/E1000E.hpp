@@ -1,12 +1,14 @@
 /*
     * E1000E.hpp
-    * Intel I217/I218/I219 (E1000E) Ethernet driver
+    * Intel 82574 and I217/I218/I219 (E1000E) Ethernet driver
     * Copyright (c) 2025 Daniel Hammer
 */
 
 #pragma once
 #include <cstdint>
 #include <Pci/Pci.hpp>
+#include <Drivers/Net/Offload.hpp>
+#include <Net/PacketBuffer.hpp>
 
 namespace Drivers::Net::E1000E {
 
@@ -17,8 +19,13 @@ namespace Drivers::Net::E1000E {
     constexpr uint32_t REG_CTRL_EXT = 0x0018;  // Extended Device Control
     constexpr uint32_t REG_MDIC     = 0x0020;  // MDI Control (PHY access)
     constexpr uint32_t REG_ICR      = 0x00C0;  // Interrupt Cause Read
+    constexpr uint32_t REG_ITR      = 0x00C4;  // Interrupt Throttling
+    constexpr uint32_t REG_ICS      = 0x00C8;  // Interrupt Cause Set
     constexpr uint32_t REG_IMS      = 0x00D0;  // Interrupt Mask Set
     constexpr uint32_t REG_IMC      = 0x00D8;  // Interrupt Mask Clear
+    constexpr uint32_t REG_EIAC     = 0x00DC;  // Interrupt Auto Clear (82574, MSI-X)
+    constexpr uint32_t REG_IVAR     = 0x00E4;  // Interrupt Vector Allocation (82574)
+    constexpr uint32_t REG_EITR     = 0x00E8;  // Per-vector Interrupt Throttling (82574, 4 bytes each)
     constexpr uint32_t REG_RCTL     = 0x0100;  // Receive Control
     constexpr uint32_t REG_TCTL     = 0x0400;  // Transmit Control
     constexpr uint32_t REG_TIPG     = 0x0410;  // Transmit IPG
@@ -27,24 +34,38 @@ namespace Drivers::Net::E1000E {
     constexpr uint32_t REG_RDLEN    = 0x2808;  // RX Descriptor Length
     constexpr uint32_t REG_RDH      = 0x2810;  // RX Descriptor Head
     constexpr uint32_t REG_RDT      = 0x2818;  // RX Descriptor Tail
+    constexpr uint32_t REG_RDTR     = 0x2820;  // RX Delay Timer
     constexpr uint32_t REG_TDBAL    = 0x3800;  // TX Descriptor Base Low
     constexpr uint32_t REG_TDBAH    = 0x3804;  // TX Descriptor Base High
     constexpr uint32_t REG_TDLEN    = 0x3808;  // TX Descriptor Length
     constexpr uint32_t REG_TDH      = 0x3810;  // TX Descriptor Head
     constexpr uint32_t REG_TDT      = 0x3818;  // TX Descriptor Tail
+    constexpr uint32_t REG_TARC     = 0x3840;  // TX Arbitration Count
+    constexpr uint32_t REG_RXCSUM   = 0x5000;  // RX Checksum Control
+    constexpr uint32_t REG_RFCTL    = 0x5008;  // Receive Filter Control
     constexpr uint32_t REG_MTA      = 0x5200;  // Multicast Table Array (128 entries)
     constexpr uint32_t REG_RAL      = 0x5400;  // Receive Address Low
     constexpr uint32_t REG_RAH      = 0x5404;  // Receive Address High
+    constexpr uint32_t REG_MRQC     = 0x5818;  // Multiple Receive Queues Command
+    constexpr uint32_t REG_RETA     = 0x5C00;  // RSS Redirection Table (32 registers)
+    constexpr uint32_t REG_RSSRK    = 0x5C80;  // RSS Random Key (10 registers)
     constexpr uint32_t REG_EXTCNF_CTRL = 0x0F00; // Extended Configuration Control
     constexpr uint32_t REG_SWSM     = 0x5B50;  // Software Semaphore
     constexpr uint32_t REG_FWSM     = 0x5B54;  // Firmware Semaphore
 
+    // Queue n's copy of the RDxxx, TDxxx and TARC registers is this much
+    // further on
+    constexpr uint32_t QUEUE_REG_STRIDE = 0x100;
+
     // CTRL register bits
     constexpr uint32_t CTRL_SLU     = (1 << 6);   // Set Link Up
     constexpr uint32_t CTRL_FRCSPD  = (1 << 11);  // Force Speed
     constexpr uint32_t CTRL_FRCDPLX = (1 << 12);  // Force Duplex
     constexpr uint32_t CTRL_RST     = (1 << 26);  // Device Reset
 
+    // CTRL_EXT register bits
+    constexpr uint32_t CTRL_EXT_PBA_CLR = (1u << 31); // Clear MSI-X pending bits on delivery
+
     // MDIC register
     constexpr uint32_t MDIC_DATA_MASK = 0x0000FFFF;
     constexpr uint32_t MDIC_REG_SHIFT = 16;       // PHY register address shift
@@ -76,10 +97,29 @@ namespace Drivers::Net::E1000E {
     constexpr uint32_t RCTL_UPE   = (1 << 3);   // Unicast Promiscuous
     constexpr uint32_t RCTL_MPE   = (1 << 4);   // Multicast Promiscuous
     constexpr uint32_t RCTL_BAM   = (1 << 15);  // Broadcast Accept Mode
+    constexpr uint32_t RCTL_BSIZE_2048 = (0 << 16); // Buffer Size 2048
     constexpr uint32_t RCTL_BSIZE_4096 = (3 << 16); // Buffer Size 4096 (with BSEX)
     constexpr uint32_t RCTL_BSEX  = (1 << 25);  // Buffer Size Extension
     constexpr uint32_t RCTL_SECRC = (1 << 26);  // Strip Ethernet CRC
 
+    // RXCSUM register bits
+    constexpr uint32_t RXCSUM_IPOFLD = (1 << 8);  // IPv4 Checksum Offload
+    constexpr uint32_t RXCSUM_TUOFLD = (1 << 9);  // TCP/UDP Checksum Offload
+    constexpr uint32_t RXCSUM_PCSD   = (1 << 13); // Report the RSS hash, not the packet checksum
+
+    // RFCTL register bits
+    constexpr uint32_t RFCTL_EXTEN   = (1 << 15); // Extended RX descriptors
+
+    // MRQC register bits
+    constexpr uint32_t MRQC_RSS_ENABLE_2Q      = (1 << 0);
+    constexpr uint32_t MRQC_RSS_FIELD_IPV4_TCP = (1 << 16);  // Hash TCP by addresses and ports
+    constexpr uint32_t MRQC_RSS_FIELD_IPV4     = (1 << 17);  // Hash other IPv4 by addresses
+
+    // RSS redirection table: 128 one-byte entries, the queue in bit 7
+    constexpr uint32_t RETA_ENTRIES    = 128;
+    constexpr uint32_t RETA_QUEUE_SHIFT = 7;
+    constexpr uint32_t RSS_KEY_SIZE    = 40;
+
     // TCTL register bits
     constexpr uint32_t TCTL_EN    = (1 << 1);   // Transmit Enable
     constexpr uint32_t TCTL_PSP   = (1 << 3);   // Pad Short Packets
@@ -93,11 +133,33 @@ namespace Drivers::Net::E1000E {
     constexpr uint32_t ICR_RXDMT0 = (1 << 4);   // RX Descriptor Minimum Threshold
     constexpr uint32_t ICR_RXO    = (1 << 6);   // Receiver Overrun
     constexpr uint32_t ICR_RXT0   = (1 << 7);   // Receiver Timer Interrupt
+    constexpr uint32_t ICR_RXQ0   = (1 << 20);  // RX queue 0 (82574, MSI-X); queue n is bit 20 + n
+    constexpr uint32_t ICR_OTHER  = (1 << 24);  // Other causes (82574, MSI-X)
+
+    // IVAR: a 4-bit field per cause (RX queue 0, RX queue 1, TX queue 0,
+    // TX queue 1, other), the vector number and a valid bit
+    constexpr uint32_t IVAR_VALID       = (1 << 3);
+    constexpr uint32_t IVAR_FIELD_BITS  = 4;
+    constexpr uint32_t IVAR_OTHER_FIELD = 4;
 
-    // TX descriptor command bits
+    // TX descriptor command bits (legacy; DCMD/TUCMD of the extended formats)
     constexpr uint8_t TXCMD_EOP   = (1 << 0);   // End Of Packet
     constexpr uint8_t TXCMD_IFCS  = (1 << 1);   // Insert FCS/CRC
+    constexpr uint8_t TXCMD_TSE   = (1 << 2);   // TCP Segmentation Enable
     constexpr uint8_t TXCMD_RS    = (1 << 3);   // Report Status
+    constexpr uint8_t TXCMD_DEXT  = (1 << 5);   // Extended descriptor
+
+    // TUCMD bits of a context descriptor
+    constexpr uint8_t TUCMD_TCP   = (1 << 0);   // Packet is TCP
+    constexpr uint8_t TUCMD_IP    = (1 << 1);   // Packet is IPv4
+
+    // Extended descriptor types
+    constexpr uint8_t TXDTYP_CONTEXT = 0x0;
+    constexpr uint8_t TXDTYP_DATA    = 0x1;
+
+    // POPTS bits of a data descriptor
+    constexpr uint8_t TXPOPTS_IXSM = (1 << 0);  // Insert IP checksum
+    constexpr uint8_t TXPOPTS_TXSM = (1 << 1);  // Insert TCP/UDP checksum
 
     // TX descriptor status bits
     constexpr uint8_t TXSTA_DD    = (1 << 0);   // Descriptor Done
@@ -105,11 +167,32 @@ namespace Drivers::Net::E1000E {
     // RX descriptor status bits
     constexpr uint8_t RXSTA_DD    = (1 << 0);   // Descriptor Done
     constexpr uint8_t RXSTA_EOP   = (1 << 1);   // End Of Packet
+    constexpr uint8_t RXSTA_IXSM  = (1 << 2);   // Ignore Checksum Indication
+    constexpr uint8_t RXSTA_TCPCS = (1 << 5);   // TCP/UDP Checksum Calculated
+    constexpr uint8_t RXSTA_IPCS  = (1 << 6);   // IPv4 Checksum Calculated
+
+    // RX descriptor error bits
+    constexpr uint8_t RXERR_TCPE  = (1 << 5);   // TCP/UDP Checksum Error
+    constexpr uint8_t RXERR_IPE   = (1 << 6);   // IPv4 Checksum Error
+
+    // The 82574 has two RX and two TX queues and MSI-X; the I217/I218/I219
+    // have one of each and MSI only
+    constexpr uint32_t MAX_QUEUES = 2;
+
+    // MSI-X table entry layout (16 bytes each)
+    constexpr uint32_t MSIX_ENTRY_ADDR_LO = 0;
+    constexpr uint32_t MSIX_ENTRY_ADDR_HI = 1;
+    constexpr uint32_t MSIX_ENTRY_DATA    = 2;
+    constexpr uint32_t MSIX_ENTRY_CTRL    = 3;    // Bit 0 = masked
+    constexpr uint16_t MSIX_CTRL_ENABLE   = (1u << 15);
+    constexpr uint16_t MSIX_CTRL_FMASK    = (1u << 14);
+    constexpr uint16_t MSIX_TABLE_SIZE_MASK = 0x7FF;
 
     // Descriptor ring sizes
     constexpr uint32_t RX_DESC_COUNT = 32;
-    constexpr uint32_t TX_DESC_COUNT = 32;
-    constexpr uint32_t PACKET_BUFFER_SIZE = 8192;
+    constexpr uint32_t TX_DESC_COUNT = 64;      // Room for a segmentation frame (17 descriptors) and more
+    constexpr uint32_t TX_BUFFER_SIZE = 4096;
+    constexpr uint32_t RX_BUFFER_SIZE = ::Net::PACKET_BUFFER_SIZE;  // RX buffers come from the packet pool
 
     // RX descriptor (legacy format, 16 bytes)
     struct RxDescriptor {
@@ -121,6 +204,24 @@ namespace Drivers::Net::E1000E {
         uint16_t Special;
     } __attribute__((packed));
 
+    // RX descriptor (extended format, 16 bytes), used with RSS: the buffer
+    // address goes in, and the NIC writes the RSS hash, the status and
+    // error bits (as in the legacy format, errors in the top byte) and the
+    // length back over it
+    union RxExtDescriptor {
+        struct {
+            uint64_t BufferAddress;
+            uint64_t Reserved;
+        } __attribute__((packed)) Read;
+        struct {
+            uint32_t Mrq;          // RSS type and queue
+            uint32_t RssHash;
+            uint32_t StatusError;  // Status [19:0], errors [31:24]
+            uint16_t Length;
+            uint16_t Vlan;
+        } __attribute__((packed)) Writeback;
+    };
+
     // TX descriptor (legacy format, 16 bytes)
     struct TxDescriptor {
         uint64_t BufferAddress;
@@ -132,6 +233,30 @@ namespace Drivers::Net::E1000E {
         uint16_t Special;
     } __attribute__((packed));
 
+    // TCP/IP context descriptor (16 bytes): sets up checksum insertion
+    // and segmentation for the data descriptors that follow
+    struct TxContextDescriptor {
+        uint8_t  IpStart;        // IPCSS
+        uint8_t  IpOffset;       // IPCSO: checksum field
+        uint16_t IpEnd;          // IPCSE: last byte of the IPv4 header
+        uint8_t  TcpStart;       // TUCSS
+        uint8_t  TcpOffset;      // TUCSO: checksum field
+        uint16_t TcpEnd;         // TUCSE (0 = to the end of the packet)
+        uint32_t PayloadLenCmd;  // PAYLEN[19:0] | DTYP[23:20] | TUCMD[31:24]
+        uint8_t  Status;
+        uint8_t  HeaderLen;
+        uint16_t Mss;
+    } __attribute__((packed));
+
+    // TCP/IP data descriptor (16 bytes)
+    struct TxDataDescriptor {
+        uint64_t BufferAddress;
+        uint32_t LengthCmd;      // DTALEN[19:0] | DTYP[23:20] | DCMD[31:24]
+        uint8_t  Status;
+        uint8_t  Options;        // POPTS
+        uint16_t Special;
+    } __attribute__((packed));
+
     // Initialize the E1000E driver (scans PCI for the device)
     void Initialize();
 
@@ -141,19 +266,32 @@ namespace Drivers::Net::E1000E {
     // Send a raw Ethernet frame
     bool SendPacket(const uint8_t* data, uint16_t length);
 
+    // Send the frame held in `packet` without copying it. The driver
+    // keeps a reference until the NIC is done with the buffer.
+    bool SendBuffer(::Net::PacketBuffer* packet);
+
+    // Send a TCP/IPv4 frame gathered from `count` fragments, leaving its
+    // checksums (and, with off.Mss set, its segmentation) to the NIC
+    bool SendPacketOffload(const TxFragment* fragments, uint32_t count, const TxOffload& off);
+
+    // OFFLOAD_* bits this device supports
+    uint32_t GetOffloads();
+
     // Get the MAC address (6 bytes)
     const uint8_t* GetMacAddress();
 
     // Check if the device was found and initialized
     bool IsInitialized();
 
-    // RX callback type: called with (packet data, length)
-    using RxCallback = void(*)(const uint8_t* data, uint16_t length);
+    // RX callback type: called with (frame, RX_*_CSUM_OK flags). The
+    // driver drops its reference to the frame when the callback returns.
+    using RxCallback = void(*)(::Net::PacketBuffer* packet, uint8_t flags);
 
     // Register a callback for received packets
     void SetRxCallback(RxCallback callback);
 
-    // Poll for received packets (used when legacy IRQ is unavailable)
+    // Housekeeping tick: drains the RX rings in polling mode (under load,
+    // or when no interrupt is available)
     void Poll();
 
 };
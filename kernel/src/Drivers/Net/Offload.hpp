@@ -0,0 +1,43 @@
+/*
+    * Offload.hpp
+    * Checksum and segmentation offload shared by the Intel NIC drivers
+    * Copyright (c) 2026 Daniel Hammer
+*/
+
+#pragma once
+#include <cstdint>
+
+namespace Drivers::Net {
+
+    // Offloads a driver reports through GetOffloads()
+    constexpr uint32_t OFFLOAD_TX_CSUM = (1 << 0);  // IPv4 header and TCP checksums on transmit
+    constexpr uint32_t OFFLOAD_TSO     = (1 << 1);  // TCP segmentation on transmit
+    constexpr uint32_t OFFLOAD_RX_CSUM = (1 << 2);  // IPv4, TCP and UDP checksums checked on receive
+
+    // Largest frame, headers included, accepted for segmentation
+    constexpr uint32_t TSO_MAX_FRAME_SIZE = 65536;
+
+    // Flags passed to the RX callback with each frame
+    constexpr uint8_t RX_IP_CSUM_OK = (1 << 0);  // The NIC verified the IPv4 header checksum
+    constexpr uint8_t RX_L4_CSUM_OK = (1 << 1);  // The NIC verified the TCP/UDP checksum
+
+    // One piece of a frame; offloaded frames are gathered from several
+    struct TxFragment {
+        const uint8_t* Data;
+        uint32_t       Length;
+    };
+
+    // Describes a TCP/IPv4 frame for SendPacketOffload. The IPv4 header
+    // checksum is filled in by the NIC and the TCP checksum field must
+    // hold the pseudo-header sum (without the length when segmenting).
+    // With Mss set, the NIC cuts the payload into Mss-sized segments,
+    // each with a copy of the headers, fixing up lengths, IP IDs and
+    // sequence numbers.
+    struct TxOffload {
+        uint8_t  IpOffset;       // Start of the IPv4 header in the frame
+        uint8_t  L4Offset;       // Start of the TCP header
+        uint8_t  HeaderLen;      // Bytes of headers before the payload
+        uint16_t Mss;            // Payload bytes per segment, 0 = checksums only
+    };
+
+}
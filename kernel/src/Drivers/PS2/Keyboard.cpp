@@ -13,6 +13,7 @@
 #include <Terminal/Terminal.hpp>
 #include <Hal/Apic/Interrupts.hpp>
 #include <Hal/Apic/IoApic.hpp>
+#include <Sched/Scheduler.hpp>
 
 namespace Drivers::PS2::Keyboard {
 
@@ -72,6 +73,7 @@ namespace Drivers::PS2::Keyboard {
     static KeyEvent g_KeyBuffer[KeyBufferSize];
     static volatile uint32_t g_BufferHead = 0;
     static volatile uint32_t g_BufferTail = 0;
+    static volatile uint32_t g_PushCount = 0;   // Events ever buffered
     static kcp::Spinlock g_BufferLock;
 
     // Current modifier state
@@ -94,6 +96,8 @@ namespace Drivers::PS2::Keyboard {
         }
         g_KeyBuffer[g_BufferHead] = event;
         g_BufferHead = nextHead;
+        g_PushCount = g_PushCount + 1;
+        Sched::NotifyReady(Montauk::POLL_SRC_KEYBOARD);
     }
 
     static bool BufferPop(KeyEvent& event) {
@@ -265,6 +269,10 @@ namespace Drivers::PS2::Keyboard {
         return g_BufferHead != g_BufferTail;
     }
 
+    uint32_t EventCount() {
+        return g_PushCount;
+    }
+
     KeyEvent GetKey() {
         KeyEvent event = {};
         g_BufferLock.Acquire();
@@ -46,6 +46,9 @@ namespace Drivers::PS2::Keyboard {
     KeyEvent GetKey();
     char GetChar();
 
+    // Number of events buffered so far; changes whenever a key arrives
+    uint32_t EventCount();
+
     // Modifier state query
     const ModifierState& GetModifiers();
 
@@ -13,6 +13,9 @@
 #include <Terminal/Terminal.hpp>
 #include <Hal/Apic/Interrupts.hpp>
 #include <Hal/Apic/IoApic.hpp>
+#include <Sched/Scheduler.hpp>
+#include <Drivers/Graphics/IntelGPU.hpp>
+#include <Timekeeping/ApicTimer.hpp>
 
 namespace Drivers::PS2::Mouse {
 
@@ -34,6 +37,13 @@ namespace Drivers::PS2::Mouse {
     // Mouse state
     static MouseState g_State = {};
     static kcp::Spinlock g_StateLock;
+    static uint32_t g_EventCount = 0;
+    static uint32_t g_ReadCount = 0;     // g_EventCount at the last GetMouseState or ReadEvents
+
+    // Event queue, under g_StateLock. Indices run freely.
+    static MouseEvent g_Events[EventQueueSize];
+    static uint32_t g_EventHead = 0;
+    static uint32_t g_EventTail = 0;
 
     // Screen bounds
     static int32_t g_MaxX = 1024;
@@ -92,6 +102,10 @@ namespace Drivers::PS2::Mouse {
             Kt::KernelLogStream(Kt::INFO, "PS2/Mouse") << "Standard 3-byte mouse protocol";
         }
 
+        // Detection leaves the rate at 80 reports/s; ask for the most
+        // PS/2 offers, so fast motion is sampled finely
+        SetSampleRate(200);
+
         // Enable data reporting
         ack = SendMouseCommand(CmdEnableReporting);
         if (ack != CmdAck) {
@@ -108,6 +122,60 @@ namespace Drivers::PS2::Mouse {
         Kt::KernelLogStream(Kt::OK, "PS2/Mouse") << "Mouse driver initialized";
     }
 
+    // g_StateLock must be held
+    static void QueueEvent(int32_t deltaX, int32_t deltaY, int32_t scroll) {
+        uint64_t now = Timekeeping::GetMicroseconds();
+        if (g_EventTail != g_EventHead) {
+            MouseEvent& last = g_Events[(g_EventTail - 1) % EventQueueSize];
+            if (last.Buttons == g_State.Buttons) {
+                last.X = g_State.X;
+                last.Y = g_State.Y;
+                last.DeltaX += deltaX;
+                last.DeltaY += deltaY;
+                last.Scroll += scroll;
+                last.TimeUs = now;
+                return;
+            }
+        }
+
+        // Full: the oldest event goes, so the queue ends in the current state
+        if (g_EventTail - g_EventHead == (uint32_t)EventQueueSize) g_EventHead++;
+        MouseEvent& e = g_Events[g_EventTail % EventQueueSize];
+        e = {};
+        e.X = g_State.X;
+        e.Y = g_State.Y;
+        e.DeltaX = deltaX;
+        e.DeltaY = deltaY;
+        e.Scroll = scroll;
+        e.Buttons = g_State.Buttons;
+        e.TimeUs = now;
+        g_EventTail++;
+    }
+
+    // Apply one report from either source
+    static void ApplyReport(uint8_t buttons, int32_t deltaX, int32_t deltaY, int32_t scrollDelta) {
+        g_StateLock.Acquire();
+
+        g_State.X += deltaX;
+        g_State.Y += deltaY;
+        g_State.Buttons = buttons;
+        g_State.ScrollDelta += scrollDelta;
+
+        // Clamp to screen bounds
+        if (g_State.X < 0) g_State.X = 0;
+        if (g_State.Y < 0) g_State.Y = 0;
+        if (g_State.X > g_MaxX) g_State.X = g_MaxX;
+        if (g_State.Y > g_MaxY) g_State.Y = g_MaxY;
+        g_EventCount++;
+        QueueEvent(deltaX, deltaY, scrollDelta);
+
+        // Pointer motion never waits for the compositor
+        Drivers::Graphics::IntelGPU::MoveCursor(g_State.X, g_State.Y);
+
+        g_StateLock.Release();
+        Sched::NotifyReady(Montauk::POLL_SRC_MOUSE);
+    }
+
     void HandleIRQ(uint8_t irq) {
         (void)irq;
         uint8_t data = Io::In8(DataPort);
@@ -156,30 +224,39 @@ namespace Drivers::PS2::Mouse {
             scrollDelta = (int8_t)g_PacketBuffer[3];
         }
 
-        g_StateLock.Acquire();
-
-        g_State.X += deltaX;
-        g_State.Y += deltaY;
-        g_State.Buttons = buttons;
-        g_State.ScrollDelta += scrollDelta;
-
-        // Clamp to screen bounds
-        if (g_State.X < 0) g_State.X = 0;
-        if (g_State.Y < 0) g_State.Y = 0;
-        if (g_State.X > g_MaxX) g_State.X = g_MaxX;
-        if (g_State.Y > g_MaxY) g_State.Y = g_MaxY;
-
-        g_StateLock.Release();
+        ApplyReport(buttons, deltaX, deltaY, scrollDelta);
     }
 
     MouseState GetMouseState() {
         g_StateLock.Acquire();
         MouseState state = g_State;
         g_State.ScrollDelta = 0;  // clear after read so deltas don't repeat
+        g_ReadCount = g_EventCount;
         g_StateLock.Release();
         return state;
     }
 
+    int ReadEvents(MouseEvent* out, int max) {
+        g_StateLock.Acquire();
+        int n = 0;
+        while (n < max && g_EventHead != g_EventTail) {
+            out[n++] = g_Events[g_EventHead % EventQueueSize];
+            g_EventHead++;
+        }
+        g_State.ScrollDelta = 0;  // the events carried it
+        g_ReadCount = g_EventCount;
+        g_StateLock.Release();
+        return n;
+    }
+
+    uint32_t EventCount() {
+        return g_EventCount;
+    }
+
+    bool HasNewState() {
+        return g_EventCount != g_ReadCount;
+    }
+
     int32_t GetX() {
         g_StateLock.Acquire();
         int32_t x = g_State.X;
@@ -221,21 +298,8 @@ namespace Drivers::PS2::Mouse {
         }
     }
 
-    void InjectMouseReport(uint8_t buttons, int8_t deltaX, int8_t deltaY, int8_t scroll) {
-        g_StateLock.Acquire();
-
-        g_State.X += (int32_t)deltaX;
-        g_State.Y += (int32_t)deltaY;
-        g_State.Buttons = buttons;
-        g_State.ScrollDelta += -(int32_t)scroll;
-
-        // Clamp to screen bounds
-        if (g_State.X < 0) g_State.X = 0;
-        if (g_State.Y < 0) g_State.Y = 0;
-        if (g_State.X > g_MaxX) g_State.X = g_MaxX;
-        if (g_State.Y > g_MaxY) g_State.Y = g_MaxY;
-
-        g_StateLock.Release();
+    void InjectMouseReport(uint8_t buttons, int32_t deltaX, int32_t deltaY, int32_t scroll) {
+        ApplyReport(buttons, deltaX, deltaY, -scroll);
     }
 
 };
\ No newline at end of file
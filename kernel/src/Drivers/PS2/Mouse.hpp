@@ -21,6 +21,21 @@ namespace Drivers::PS2::Mouse {
         uint8_t  Buttons;
     };
 
+    // One entry of the input event queue (SYS_MOUSEEVENTS). Same layout
+    // as Montauk::MouseEvent.
+    struct MouseEvent {
+        int32_t  X;           // Position after the event
+        int32_t  Y;
+        int32_t  DeltaX;      // Motion folded into the event, unclamped
+        int32_t  DeltaY;
+        int32_t  Scroll;
+        uint8_t  Buttons;     // Button state after the event
+        uint8_t  _pad[3];
+        uint64_t TimeUs;      // When its last report arrived
+    };
+
+    static constexpr int EventQueueSize = 64;
+
     void Initialize();
 
     // Interrupt handler -- called from IRQ dispatch (EOI is sent automatically)
@@ -28,18 +43,29 @@ namespace Drivers::PS2::Mouse {
 
     // Public interface
     MouseState GetMouseState();
+
+    // Take up to `max` queued events, oldest first. Reports are coalesced:
+    // one whose buttons match the newest unread event is folded into it,
+    // so any amount of motion between reads costs one event, while every
+    // button change starts a new one and keeps its order and position.
+    int ReadEvents(MouseEvent* out, int max);
     int32_t GetX();
     int32_t GetY();
     uint8_t GetButtons();
 
     void SetBounds(int32_t maxX, int32_t maxY);
 
+    // Reports (PS/2 or injected) ever received, and whether any arrived
+    // since the last GetMouseState (SYS_EPOLL_WAIT)
+    uint32_t EventCount();
+    bool HasNewState();
+
     // Reset packet assembly state and drain pending PS/2 data.
     // Call after boot to ensure clean mouse state regardless of
     // any bytes lost during interrupt-heavy boot sequence.
     void FlushState();
 
     // Inject a mouse report from an external source (e.g., USB HID mouse)
-    void InjectMouseReport(uint8_t buttons, int8_t deltaX, int8_t deltaY, int8_t scroll);
+    void InjectMouseReport(uint8_t buttons, int32_t deltaX, int32_t deltaY, int32_t scroll);
 
 };
\ No newline at end of file
@@ -12,9 +12,13 @@
 #include <Memory/HHDM.hpp>
 #include <Memory/Paging.hpp>
 #include <Memory/PageFrameAllocator.hpp>
+#include <Memory/Dma.hpp>
 #include <Libraries/Memory.hpp>
 #include <Hal/Apic/Interrupts.hpp>
 #include <Hal/Apic/IoApic.hpp>
+#include <CppLib/Spinlock.hpp>
+#include <Sched/Scheduler.hpp>
+#include <Timekeeping/ApicTimer.hpp>
 
 using namespace Kt;
 
@@ -29,6 +33,31 @@ namespace Drivers::Storage::Ahci {
     static uint32_t g_portsImplemented = 0;
     static int g_activePortCount = 0;
     static PortInfo g_ports[MAX_PORTS] = {};
+    static uint32_t g_hbaSlots = 1;        // Command slots per port (CAP.NCS + 1)
+    static bool g_hbaNcq = false;          // CAP.SNCQ
+    static bool g_interrupts = false;      // Port interrupts reach HandleInterrupt
+
+    // Per-port command queue. With NCQ every slot the HBA and the device
+    // both support carries a READ/WRITE FPDMA QUEUED command tagged with
+    // its slot number; without it, slot 0 carries one DMA EXT command at
+    // a time. A submitter sleeps on its slot's Done flag until the
+    // interrupt handler (or a recheck) sees the slot retire.
+    struct PortQueue {
+        kcp::Spinlock Lock;               // Also taken by the interrupt handler
+        bool     Ncq;
+        uint32_t SlotMask;                // Slots read/write commands may use
+        uint32_t Busy;                    // Slots handed to submitters
+        uint32_t Issued;                  // Slots issued and not yet retired
+        volatile uint32_t Done[CMD_HEADER_COUNT];
+        bool     Failed[CMD_HEADER_COUNT];
+    };
+
+    static PortQueue g_queues[MAX_PORTS];
+
+    // Longest a command may take, and how often a sleeping submitter
+    // checks the port itself in case an interrupt went missing
+    static constexpr uint64_t IoTimeoutMs = 5000;
+    static constexpr uint64_t IoRecheckMs = 10;
 
     // -------------------------------------------------------------------------
     // Register access
@@ -50,22 +79,6 @@ namespace Drivers::Storage::Ahci {
         return ReadReg(PORT_BASE + port * PORT_SIZE + reg);
     }
 
-    // -------------------------------------------------------------------------
-    // DMA buffer allocation
-    // -------------------------------------------------------------------------
-
-    static void* AllocateDmaBuffer(uint64_t& outPhys, int pages = 1) {
-        void* virt;
-        if (pages == 1) {
-            virt = Memory::g_pfa->AllocateZeroed();
-        } else {
-            virt = Memory::g_pfa->ReallocConsecutive(nullptr, pages);
-            memset(virt, 0, pages * 0x1000);
-        }
-        outPhys = Memory::SubHHDM(virt);
-        return virt;
-    }
-
     // -------------------------------------------------------------------------
     // BIOS/OS Handoff
     // -------------------------------------------------------------------------
@@ -196,7 +209,7 @@ namespace Drivers::Storage::Ahci {
         // and FIS area (256 bytes, 256-byte aligned)
         // Both fit in one 4 KiB page
         uint64_t clPhys;
-        void* clVirt = AllocateDmaBuffer(clPhys);
+        void* clVirt = Memory::Dma::Allocate(0x1000, clPhys);
         g_ports[port].CmdList = (CommandHeader*)clVirt;
         g_ports[port].CmdListPhys = clPhys;
 
@@ -216,7 +229,7 @@ namespace Drivers::Storage::Ahci {
         CommandHeader* headers = g_ports[port].CmdList;
         for (int i = 0; i < CMD_HEADER_COUNT; i++) {
             uint64_t ctPhys;
-            void* ctVirt = AllocateDmaBuffer(ctPhys);
+            void* ctVirt = Memory::Dma::Allocate(0x1000, ctPhys);
             g_ports[port].CmdTables[i] = (CommandTable*)ctVirt;
             g_ports[port].CmdTablesPhys[i] = ctPhys;
 
@@ -319,18 +332,17 @@ namespace Drivers::Storage::Ahci {
     }
 
     static void BuildReadWriteCommand(int port, int slot, uint64_t lba, uint32_t count,
-                                       uint64_t bufferPhys, bool write) {
+                                       int prdtCount, bool write, bool ncq) {
         CommandHeader* hdr = &g_ports[port].CmdList[slot];
         CommandTable* tbl = g_ports[port].CmdTables[slot];
 
-        // Clear the command table
-        memset(tbl, 0, sizeof(CommandTable) + sizeof(PrdtEntry) * MAX_PRDT_ENTRIES);
+        // Clear the command FIS (the PRDT is already filled in)
+        memset(tbl, 0, sizeof(CommandTable));
 
         // Build FIS
         FisRegH2D* fis = (FisRegH2D*)tbl->CommandFis;
         fis->FisType = (uint8_t)FisType::RegH2D;
         fis->CmdCtl = 1;  // Command
-        fis->Command = write ? ATA_CMD_WRITE_DMA_EX : ATA_CMD_READ_DMA_EX;
         fis->Device = (1 << 6); // LBA mode
 
         fis->Lba0 = (uint8_t)(lba);
@@ -340,40 +352,263 @@ namespace Drivers::Storage::Ahci {
         fis->Lba4 = (uint8_t)(lba >> 32);
         fis->Lba5 = (uint8_t)(lba >> 40);
 
-        fis->Count = (uint16_t)count;
+        if (ncq) {
+            // FPDMA QUEUED: sector count in the feature register, tag in
+            // bits 7:3 of the count register
+            fis->Command = write ? ATA_CMD_WRITE_FPDMA : ATA_CMD_READ_FPDMA;
+            fis->FeatureLow = (uint8_t)count;
+            fis->FeatureHigh = (uint8_t)(count >> 8);
+            fis->Count = (uint16_t)(slot << 3);
+        } else {
+            fis->Command = write ? ATA_CMD_WRITE_DMA_EX : ATA_CMD_READ_DMA_EX;
+            fis->Count = (uint16_t)count;
+        }
+
+        // Set up command header
+        // CFL = FIS length in dwords (5 for FisRegH2D = 20 bytes / 4)
+        hdr->CflPmpA = 5; // CFL bits [4:0]
+        hdr->Flags = write ? CMDHDR_WRITE : 0;
+        hdr->PrdtLength = (uint16_t)prdtCount;
+        hdr->PrdByteCount = 0;
+    }
+
+    // -------------------------------------------------------------------------
+    // Scatter-gather lists
+    // Kernel buffers and pinned user buffers are described page by page
+    // (merging physically adjacent pages); anything else goes through
+    // bounce pages.
+    // -------------------------------------------------------------------------
+
+    static constexpr uint64_t KernelSpaceStart = 0xFFFF800000000000ULL;
+
+    static uint64_t EntryAddress(const PrdtEntry& e) {
+        return (uint64_t)e.DataBaseLow | ((uint64_t)e.DataBaseHigh << 32);
+    }
+
+    static uint32_t EntryBytes(const PrdtEntry& e) {
+        return (e.ByteCount & (PRDT_MAX_BYTES - 1)) + 1;
+    }
 
-        // Build PRDT entries
-        uint32_t bytesRemaining = count * SECTOR_SIZE;
-        int prdtIdx = 0;
-        uint64_t currentPhys = bufferPhys;
+    static void SetEntry(PrdtEntry& e, uint64_t phys, uint32_t bytes) {
+        e.DataBaseLow = (uint32_t)(phys & 0xFFFFFFFF);
+        e.DataBaseHigh = (uint32_t)(phys >> 32);
+        e.Reserved = 0;
+        // Byte count is (actual bytes - 1)
+        e.ByteCount = bytes - 1;
+    }
 
-        while (bytesRemaining > 0 && prdtIdx < MAX_PRDT_ENTRIES) {
-            uint32_t chunkSize = bytesRemaining;
-            // Each PRDT entry can transfer up to 4 MiB (aligned to word boundary)
-            if (chunkSize > 0x400000) {
-                chunkSize = 0x400000;
+    // PRDT for `bytes` at `va`, kernel memory or a user buffer that gets
+    // pinned by `pin`. Returns the entry count, or 0 (holding no pin) if
+    // the buffer cannot be used directly.
+    static int BuildDirectPrdt(CommandTable* tbl, uint64_t va, uint32_t bytes, bool write, Memory::Dma::Pin& pin) {
+        if (va & 1) return 0;
+        if (va < KernelSpaceStart && !Memory::Dma::PinUser((const void*)va, bytes, !write, pin)) return 0;
+
+        int n = 0;
+        while (bytes > 0) {
+            uint32_t chunk = 0x1000 - (uint32_t)(va & 0xFFF);
+            if (chunk > bytes) chunk = bytes;
+            uint64_t phys = Memory::Dma::Address((const void*)va, pin);
+            if (phys == 0) {
+                Memory::Dma::Unpin(pin);
+                return 0;
             }
 
-            tbl->PrdtEntries[prdtIdx].DataBaseLow = (uint32_t)(currentPhys & 0xFFFFFFFF);
-            tbl->PrdtEntries[prdtIdx].DataBaseHigh = (uint32_t)(currentPhys >> 32);
-            tbl->PrdtEntries[prdtIdx].Reserved = 0;
-            // Byte count is (actual bytes - 1), bit 31 = interrupt on completion for last entry
-            tbl->PrdtEntries[prdtIdx].ByteCount = (chunkSize - 1);
-            if (bytesRemaining <= chunkSize) {
-                tbl->PrdtEntries[prdtIdx].ByteCount |= (1u << 31); // IOC
+            PrdtEntry* last = n > 0 ? &tbl->PrdtEntries[n - 1] : nullptr;
+            if (last && EntryAddress(*last) + EntryBytes(*last) == phys &&
+                EntryBytes(*last) + chunk <= PRDT_MAX_BYTES) {
+                last->ByteCount += chunk;
+            } else {
+                if (n == MAX_PRDT_ENTRIES) {
+                    Memory::Dma::Unpin(pin);
+                    return 0;
+                }
+                SetEntry(tbl->PrdtEntries[n++], phys, chunk);
             }
+            va += chunk;
+            bytes -= chunk;
+        }
+        return n;
+    }
 
-            currentPhys += chunkSize;
-            bytesRemaining -= chunkSize;
-            prdtIdx++;
+    static void FreeBouncePrdt(CommandTable* tbl, int count) {
+        for (int i = 0; i < count; i++) {
+            Memory::g_pfa->Free((void*)Memory::HHDM(EntryAddress(tbl->PrdtEntries[i])));
         }
+    }
 
-        // Set up command header
-        // CFL = FIS length in dwords (5 for FisRegH2D = 20 bytes / 4)
-        hdr->CflPmpA = 5; // CFL bits [4:0]
-        hdr->Flags = write ? CMDHDR_WRITE : 0;
-        hdr->PrdtLength = (uint16_t)prdtIdx;
-        hdr->PrdByteCount = 0;
+    // PRDT of freshly allocated pages for `bytes`. Returns the entry
+    // count, or 0 if memory ran out.
+    static int BuildBouncePrdt(CommandTable* tbl, uint32_t bytes) {
+        int n = 0;
+        while (bytes > 0) {
+            uint32_t chunk = bytes < 0x1000 ? bytes : 0x1000;
+            void* page = Memory::g_pfa->Allocate();
+            if (page == nullptr || n == MAX_PRDT_ENTRIES) {
+                if (page) Memory::g_pfa->Free(page);
+                FreeBouncePrdt(tbl, n);
+                return 0;
+            }
+            SetEntry(tbl->PrdtEntries[n++], Memory::SubHHDM(page), chunk);
+            bytes -= chunk;
+        }
+        return n;
+    }
+
+    static void CopyBounce(CommandTable* tbl, int count, uint8_t* buffer, bool toDevice) {
+        for (int i = 0; i < count; i++) {
+            uint8_t* bounce = (uint8_t*)Memory::HHDM(EntryAddress(tbl->PrdtEntries[i]));
+            uint32_t n = EntryBytes(tbl->PrdtEntries[i]);
+            if (toDevice) memcpy(bounce, buffer, n);
+            else memcpy(buffer, bounce, n);
+            buffer += n;
+        }
+    }
+
+    // -------------------------------------------------------------------------
+    // Command queue
+    // -------------------------------------------------------------------------
+
+    // Fail everything in flight and restart the port's command engine
+    // (which also aborts the device's queue). Queue lock held.
+    static void RecoverPortLocked(int port) {
+        PortQueue& q = g_queues[port];
+        KernelLogStream(ERROR, "AHCI") << "Port " << port << " error, TFD="
+            << base::hex << (uint64_t)ReadPortReg(port, PORT_TFD) << ", resetting command engine";
+
+        StopPort(port);
+        WritePortReg(port, PORT_SERR, 0xFFFFFFFF);
+        WritePortReg(port, PORT_IS, 0xFFFFFFFF);
+        StartPort(port);
+
+        for (int i = 0; i < CMD_HEADER_COUNT; i++) {
+            if (!(q.Issued & (1u << i))) continue;
+            q.Failed[i] = true;
+            __atomic_store_n(&q.Done[i], 1, __ATOMIC_RELEASE);
+            Sched::WakeAddress(&q.Done[i], 1);
+        }
+        q.Issued = 0;
+    }
+
+    // Retire the slots the HBA and device are done with. Queue lock held.
+    static void ReapPortLocked(int port) {
+        PortQueue& q = g_queues[port];
+        uint32_t is = ReadPortReg(port, PORT_IS);
+        if (is) WritePortReg(port, PORT_IS, is);
+        if (q.Issued == 0) return;
+
+        if (is & PORT_IS_TFES) {
+            RecoverPortLocked(port);
+            return;
+        }
+
+        // NCQ slots retire when the device clears their SACT bit, others
+        // when the HBA clears CI
+        uint32_t active = ReadPortReg(port, PORT_SACT) | ReadPortReg(port, PORT_CI);
+        uint32_t retired = q.Issued & ~active;
+        q.Issued &= ~retired;
+        for (int i = 0; retired; i++, retired >>= 1) {
+            if (!(retired & 1)) continue;
+            q.Failed[i] = false;
+            __atomic_store_n(&q.Done[i], 1, __ATOMIC_RELEASE);
+            Sched::WakeAddress(&q.Done[i], 1);
+        }
+    }
+
+    // A free slot of `port`, waiting for one if all are in use
+    static int AcquireSlot(int port) {
+        PortQueue& q = g_queues[port];
+        for (;;) {
+            q.Lock.Acquire();
+            uint32_t free = q.SlotMask & ~q.Busy;
+            if (free) {
+                int slot = __builtin_ctz(free);
+                q.Busy |= 1u << slot;
+                q.Lock.Release();
+                return slot;
+            }
+            ReapPortLocked(port);
+            q.Lock.Release();
+            asm volatile("pause");
+        }
+    }
+
+    static void ReleaseSlot(int port, int slot) {
+        PortQueue& q = g_queues[port];
+        q.Lock.Acquire();
+        q.Busy &= ~(1u << slot);
+        q.Lock.Release();
+    }
+
+    static void IssueSlot(int port, int slot) {
+        PortQueue& q = g_queues[port];
+        q.Lock.Acquire();
+        q.Done[slot] = 0;
+        q.Failed[slot] = false;
+        q.Issued |= 1u << slot;
+        if (q.Ncq) WritePortReg(port, PORT_SACT, 1u << slot);
+        WritePortReg(port, PORT_CI, 1u << slot);
+        q.Lock.Release();
+    }
+
+    // Wait for an issued slot. Sleeps until the interrupt when there is
+    // one and a thread to put to sleep; polls otherwise. A timeout
+    // resets the port, so the HBA is done with the buffers either way.
+    static bool WaitSlot(int port, int slot) {
+        PortQueue& q = g_queues[port];
+        volatile uint32_t* done = &q.Done[slot];
+        bool sleep = g_interrupts && Sched::GetCurrentThreadPtr() != nullptr;
+        uint64_t start = Timekeeping::GetMilliseconds();
+
+        while (__atomic_load_n(done, __ATOMIC_ACQUIRE) == 0) {
+            if (sleep) {
+                Sched::FutexWait((uint64_t)done, done, 0, IoRecheckMs);
+            } else {
+                asm volatile("pause");
+            }
+
+            q.Lock.Acquire();
+            ReapPortLocked(port);
+            if (*done == 0 && Timekeeping::GetMilliseconds() - start >= IoTimeoutMs) {
+                KernelLogStream(ERROR, "AHCI") << "Port " << port << " command timeout";
+                RecoverPortLocked(port);
+            }
+            q.Lock.Release();
+        }
+        return !q.Failed[slot];
+    }
+
+    // Read or write `count` sectors in one command
+    static bool Transfer(int port, bool write, uint64_t lba, uint32_t count, uint8_t* buffer) {
+        uint32_t totalBytes = count * SECTOR_SIZE;
+        int slot = AcquireSlot(port);
+        CommandTable* tbl = g_ports[port].CmdTables[slot];
+
+        Memory::Dma::Pin pin;
+        int prdtCount = BuildDirectPrdt(tbl, (uint64_t)buffer, totalBytes, write, pin);
+        bool bounce = prdtCount == 0;
+        if (bounce) {
+            prdtCount = BuildBouncePrdt(tbl, totalBytes);
+            if (prdtCount == 0) {
+                ReleaseSlot(port, slot);
+                return false;
+            }
+            if (write) CopyBounce(tbl, prdtCount, buffer, true);
+        }
+        tbl->PrdtEntries[prdtCount - 1].ByteCount |= (1u << 31); // IOC
+
+        BuildReadWriteCommand(port, slot, lba, count, prdtCount, write, g_queues[port].Ncq);
+        IssueSlot(port, slot);
+        bool ok = WaitSlot(port, slot);
+
+        if (bounce) {
+            tbl->PrdtEntries[prdtCount - 1].ByteCount &= ~(1u << 31);
+            if (ok && !write) CopyBounce(tbl, prdtCount, buffer, false);
+            FreeBouncePrdt(tbl, prdtCount);
+        }
+        Memory::Dma::Unpin(pin);
+        ReleaseSlot(port, slot);
+        return ok;
     }
 
     // -------------------------------------------------------------------------
@@ -405,7 +640,7 @@ namespace Drivers::Storage::Ahci {
 
         // Allocate a page for IDENTIFY data (512 bytes)
         uint64_t identPhys;
-        uint16_t* identData = (uint16_t*)AllocateDmaBuffer(identPhys);
+        uint16_t* identData = (uint16_t*)Memory::Dma::Allocate(0x1000, identPhys);
 
         CommandHeader* hdr = &g_ports[port].CmdList[slot];
         CommandTable* tbl = g_ports[port].CmdTables[slot];
@@ -429,7 +664,7 @@ namespace Drivers::Storage::Ahci {
 
         if (!IssueCommand(port, slot)) {
             KernelLogStream(ERROR, "AHCI") << "Port " << port << " IDENTIFY failed";
-            Memory::g_pfa->Free(identData);
+            Memory::Dma::Free(identData, 0x1000);
             return false;
         }
 
@@ -516,7 +751,7 @@ namespace Drivers::Storage::Ahci {
         // 0000h = not reported, 0001h = non-rotating (SSD), else RPM
         g_ports[port].Rpm = identData[217];
 
-        Memory::g_pfa->Free(identData);
+        Memory::Dma::Free(identData, 0x1000);
 
         uint64_t sizeBytes = sectors * SECTOR_SIZE;
         uint64_t sizeMB = sizeBytes / (1024 * 1024);
@@ -543,9 +778,14 @@ namespace Drivers::Storage::Ahci {
         uint32_t is = ReadReg(REG_IS);
         if (is == 0) return;
 
-        // Acknowledge each port's interrupt
+        // Acknowledge each port's interrupt and retire its finished slots
         for (int i = 0; i < MAX_PORTS; i++) {
-            if (is & (1u << i)) {
+            if (!(is & (1u << i))) continue;
+            if (g_ports[i].Active) {
+                g_queues[i].Lock.Acquire();
+                ReapPortLocked(i);
+                g_queues[i].Lock.Release();
+            } else {
                 uint32_t portIs = ReadPortReg(i, PORT_IS);
                 WritePortReg(i, PORT_IS, portIs);
             }
@@ -681,6 +921,8 @@ namespace Drivers::Storage::Ahci {
         uint32_t numPorts = (cap & 0x1F) + 1;
         uint32_t numSlots = ((cap >> 8) & 0x1F) + 1;
         bool supports64bit = (cap & CAP_S64A) != 0;
+        g_hbaSlots = numSlots;
+        g_hbaNcq = (cap & CAP_SNCQ) != 0;
 
         KernelLogStream(INFO, "AHCI") << "Ports: " << (uint64_t)numPorts
             << ", Command slots: " << (uint64_t)numSlots
@@ -691,15 +933,16 @@ namespace Drivers::Storage::Ahci {
         KernelLogStream(INFO, "AHCI") << "Ports implemented: " << base::hex << (uint64_t)g_portsImplemented;
 
         // Set up MSI (or fall back to legacy IRQ)
-        bool hasMsi = SetupMsi(dev.Bus, dev.Device, dev.Function);
+        g_interrupts = SetupMsi(dev.Bus, dev.Device, dev.Function);
 
-        if (!hasMsi) {
+        if (!g_interrupts) {
             uint8_t irqLine = Pci::LegacyRead8(dev.Bus, dev.Device, dev.Function,
                 (uint8_t)Pci::PCI_REG_INTERRUPT);
             if (irqLine != 0xFF) {
                 KernelLogStream(INFO, "AHCI") << "Using legacy IRQ " << base::dec << (uint64_t)irqLine;
                 Hal::RegisterIrqHandler(irqLine, HandleInterrupt);
                 Hal::IoApic::UnmaskIrq(Hal::IoApic::GetGsiForIrq(irqLine));
+                g_interrupts = true;
             }
         }
 
@@ -734,6 +977,19 @@ namespace Drivers::Storage::Ahci {
 
             if (type == PortType::Sata) {
                 if (IdentifyDevice(i)) {
+                    // Queue on every slot both ends support, else one at a time
+                    PortQueue& q = g_queues[i];
+                    q.Ncq = g_hbaNcq && g_ports[i].NcqDepth > 0;
+                    uint32_t depth = q.Ncq ? g_ports[i].NcqDepth : 1;
+                    if (depth > g_hbaSlots) depth = g_hbaSlots;
+                    q.SlotMask = depth >= 32 ? 0xFFFFFFFFu : (1u << depth) - 1;
+                    q.Busy = 0;
+                    q.Issued = 0;
+                    if (q.Ncq) {
+                        KernelLogStream(INFO, "AHCI") << "Port " << i << ": NCQ, "
+                            << base::dec << (uint64_t)depth << " queued commands";
+                    }
+
                     g_ports[i].Active = true;
                     g_activePortCount++;
 
@@ -748,6 +1004,7 @@ namespace Drivers::Storage::Ahci {
                     bdev.Ctx = (void*)(uintptr_t)i;
                     bdev.SectorCount = g_ports[i].SectorCount;
                     bdev.SectorSize = g_ports[i].SectorSizeLog;
+                    bdev.MaxTransfer = MAX_TRANSFER_SECTORS;
                     memcpy(bdev.Model, g_ports[i].Model, 41);
                     Storage::RegisterBlockDevice(bdev);
                 }
@@ -794,33 +1051,13 @@ namespace Drivers::Storage::Ahci {
         }
         if (count == 0 || buffer == nullptr) return false;
 
-        // Limit to 128 sectors per command (64 KiB)
-        if (count > 128) {
-            KernelLogStream(ERROR, "AHCI") << "ReadSectors: count " << count << " exceeds max 128";
-            return false;
-        }
-
-        int slot = FindFreeSlot(port);
-        if (slot < 0) {
-            KernelLogStream(ERROR, "AHCI") << "ReadSectors: no free command slot";
+        if (count > MAX_TRANSFER_SECTORS) {
+            KernelLogStream(ERROR, "AHCI") << "ReadSectors: count " << count
+                << " exceeds max " << MAX_TRANSFER_SECTORS;
             return false;
         }
 
-        // Allocate DMA buffer (we need physically contiguous memory for DMA)
-        uint32_t totalBytes = count * SECTOR_SIZE;
-        int pagesNeeded = (totalBytes + 0xFFF) / 0x1000;
-        uint64_t dmaPhys;
-        void* dmaVirt = AllocateDmaBuffer(dmaPhys, pagesNeeded);
-
-        BuildReadWriteCommand(port, slot, lba, count, dmaPhys, false);
-
-        bool ok = IssueCommand(port, slot);
-        if (ok) {
-            memcpy(buffer, dmaVirt, totalBytes);
-        }
-
-        Memory::g_pfa->Free(dmaVirt, pagesNeeded);
-        return ok;
+        return Transfer(port, false, lba, count, (uint8_t*)buffer);
     }
 
     bool WriteSectors(int port, uint64_t lba, uint32_t count, const void* buffer) {
@@ -829,30 +1066,13 @@ namespace Drivers::Storage::Ahci {
         }
         if (count == 0 || buffer == nullptr) return false;
 
-        if (count > 128) {
-            KernelLogStream(ERROR, "AHCI") << "WriteSectors: count " << count << " exceeds max 128";
-            return false;
-        }
-
-        int slot = FindFreeSlot(port);
-        if (slot < 0) {
-            KernelLogStream(ERROR, "AHCI") << "WriteSectors: no free command slot";
+        if (count > MAX_TRANSFER_SECTORS) {
+            KernelLogStream(ERROR, "AHCI") << "WriteSectors: count " << count
+                << " exceeds max " << MAX_TRANSFER_SECTORS;
             return false;
         }
 
-        uint32_t totalBytes = count * SECTOR_SIZE;
-        int pagesNeeded = (totalBytes + 0xFFF) / 0x1000;
-        uint64_t dmaPhys;
-        void* dmaVirt = AllocateDmaBuffer(dmaPhys, pagesNeeded);
-
-        memcpy(dmaVirt, buffer, totalBytes);
-
-        BuildReadWriteCommand(port, slot, lba, count, dmaPhys, true);
-
-        bool ok = IssueCommand(port, slot);
-
-        Memory::g_pfa->Free(dmaVirt, pagesNeeded);
-        return ok;
+        return Transfer(port, true, lba, count, (uint8_t*)buffer);
     }
 
 };
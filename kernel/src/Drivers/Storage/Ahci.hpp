@@ -29,6 +29,7 @@ namespace Drivers::Storage::Ahci {
 
     // CAP register bits
     constexpr uint32_t CAP_S64A       = (1u << 31);  // Supports 64-bit Addressing
+    constexpr uint32_t CAP_SNCQ       = (1u << 30);  // Supports Native Command Queuing
     constexpr uint32_t CAP_SSS        = (1u << 27);  // Supports Staggered Spin-up
 
     // BOHC register bits
@@ -170,6 +171,8 @@ namespace Drivers::Storage::Ahci {
     constexpr uint8_t ATA_CMD_IDENTIFY      = 0xEC;
     constexpr uint8_t ATA_CMD_READ_DMA_EX   = 0x25;  // READ DMA EXT (48-bit LBA)
     constexpr uint8_t ATA_CMD_WRITE_DMA_EX  = 0x35;  // WRITE DMA EXT (48-bit LBA)
+    constexpr uint8_t ATA_CMD_READ_FPDMA    = 0x60;  // READ FPDMA QUEUED (NCQ)
+    constexpr uint8_t ATA_CMD_WRITE_FPDMA   = 0x61;  // WRITE FPDMA QUEUED (NCQ)
 
     // =========================================================================
     // Constants
@@ -177,7 +180,9 @@ namespace Drivers::Storage::Ahci {
 
     constexpr int MAX_PORTS          = 32;
     constexpr int CMD_HEADER_COUNT   = 32;    // 32 command slots per port
-    constexpr int MAX_PRDT_ENTRIES   = 8;     // Max PRDT entries per command
+    constexpr int MAX_PRDT_ENTRIES   = 248;   // Max PRDT entries per command (fills the table's page)
+    constexpr uint32_t MAX_TRANSFER_SECTORS = 1024;  // 512 KiB: fits the PRDT however scattered
+    constexpr uint32_t PRDT_MAX_BYTES = 0x400000;    // Largest single PRDT entry
     constexpr int SECTOR_SIZE        = 512;
 
     // MSI configuration
@@ -244,9 +249,12 @@ namespace Drivers::Storage::Ahci {
     int GetPortCount();
 
     // Read sectors from a SATA device
-    // port: port index (0-31), lba: starting LBA, count: sector count (max 128)
+    // port: port index (0-31), lba: starting LBA, count: sector count (max
+    // MAX_TRANSFER_SECTORS)
     // buffer: destination buffer (must be large enough for count * 512 bytes)
-    // Returns true on success
+    // Returns true on success. With NCQ, up to NcqDepth callers can have
+    // commands queued on the device at once; each sleeps until the
+    // completion interrupt.
     bool ReadSectors(int port, uint64_t lba, uint32_t count, void* buffer);
 
     // Write sectors to a SATA device
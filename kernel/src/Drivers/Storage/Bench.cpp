@@ -0,0 +1,219 @@
+/*
+    * Bench.cpp
+    * Raw block device benchmark
+    * Copyright (c) 2026 Daniel Hammer
+*/
+
+#include "Bench.hpp"
+#include <Sched/Scheduler.hpp>
+#include <Timekeeping/ApicTimer.hpp>
+#include <Memory/PageFrameAllocator.hpp>
+#include <Memory/Heap.hpp>
+#include <Libraries/Memory.hpp>
+#include <Hal/Cpu.hpp>
+
+namespace Drivers::Storage::Bench {
+
+    // Latencies go into log-linear buckets: eight per power of two, so a
+    // percentile is within 12.5% of the true value
+    static constexpr int SubBuckets = 8;
+    static constexpr int Buckets = 64 * SubBuckets;
+
+    struct Slot {
+        BlockRequest req;
+        uint64_t submitTsc;
+    };
+
+    struct State {
+        const BlockDevice* dev;
+        bool write;
+        bool random;
+        uint32_t blockSectors;
+        uint64_t startLba;
+        uint64_t blocks;              // Whole blocks in the region
+        uint64_t nextBlock;           // Sequential cursor
+        uint64_t rng;
+        uint64_t endUs;
+        uint64_t tscPerUs;
+        bool stop;
+
+        // Completions of one device are serialized by its queue, so only
+        // the in-flight count is shared with the submitting thread
+        volatile uint32_t inflight;
+        uint64_t ops;
+        uint64_t errors;
+        uint64_t totalNs;
+        uint64_t minNs;
+        uint64_t maxNs;
+        uint64_t lastUs;
+        uint32_t histogram[Buckets];
+        Slot slots[Montauk::DISKBENCH_MAX_DEPTH];
+    };
+
+    static int BucketOf(uint64_t ns) {
+        if (ns < SubBuckets) return (int)ns;
+        int octave = 63 - __builtin_clzll(ns);
+        int sub = (int)(ns >> (octave - 3)) & (SubBuckets - 1);
+        return (octave - 2) * SubBuckets + sub;
+    }
+
+    // Largest latency that falls into `bucket`
+    static uint64_t BucketTop(int bucket) {
+        if (bucket < SubBuckets) return (uint64_t)bucket;
+        int octave = bucket / SubBuckets + 2;
+        uint64_t sub = (uint64_t)(bucket % SubBuckets);
+        return ((SubBuckets + sub + 1) << (octave - 3)) - 1;
+    }
+
+    static uint64_t Percentile(const State& s, uint64_t perMille) {
+        uint64_t rank = (s.ops * perMille + 999) / 1000;
+        if (rank == 0) rank = 1;
+        uint64_t seen = 0;
+        for (int b = 0; b < Buckets; b++) {
+            seen += s.histogram[b];
+            if (seen >= rank) return BucketTop(b) < s.maxNs ? BucketTop(b) : s.maxNs;
+        }
+        return s.maxNs;
+    }
+
+    static uint64_t NextLba(State& s) {
+        uint64_t block;
+        if (s.random) {
+            // xorshift64*
+            s.rng ^= s.rng >> 12;
+            s.rng ^= s.rng << 25;
+            s.rng ^= s.rng >> 27;
+            block = (s.rng * 0x2545F4914F6CDD1DULL) % s.blocks;
+        } else {
+            block = s.nextBlock;
+            s.nextBlock = (s.nextBlock + 1) % s.blocks;
+        }
+        return s.startLba + block * s.blockSectors;
+    }
+
+    static bool Submit(State& s, Slot& slot) {
+        slot.req.Lba = NextLba(s);
+        slot.submitTsc = Hal::ReadTsc();
+        return SubmitRequest(&slot.req);
+    }
+
+    static void Completed(BlockRequest* req, bool ok) {
+        State& s = *(State*)req->Cookie;
+        Slot& slot = *(Slot*)req;
+
+        uint64_t ns = (Hal::ReadTsc() - slot.submitTsc) * 1000 / s.tscPerUs;
+        uint64_t now = Timekeeping::GetMicroseconds();
+        s.lastUs = now;
+        if (ok) {
+            s.ops++;
+            s.totalNs += ns;
+            if (ns < s.minNs) s.minNs = ns;
+            if (ns > s.maxNs) s.maxNs = ns;
+            s.histogram[BucketOf(ns)]++;
+        } else {
+            s.errors++;
+            s.stop = true;
+        }
+
+        if (!s.stop && now < s.endUs && Submit(s, slot)) return;
+
+        __atomic_sub_fetch(&s.inflight, 1, __ATOMIC_ACQ_REL);
+        Sched::WakeAddress(&s.inflight, 1);
+    }
+
+    bool Run(const BlockDevice* dev, const Montauk::DiskBenchParams& params,
+             Montauk::DiskBenchResult& result) {
+        if (dev == nullptr || dev->SectorSize == 0) return false;
+
+        uint32_t blockSectors = params.blockBytes / dev->SectorSize;
+        if (blockSectors > GetMaxTransfer(dev)) blockSectors = GetMaxTransfer(dev);
+        uint32_t depth = params.depth;
+        if (depth > Montauk::DISKBENCH_MAX_DEPTH) depth = Montauk::DISKBENCH_MAX_DEPTH;
+        uint64_t blocks = blockSectors ? params.sectorCount / blockSectors : 0;
+        if (blockSectors == 0 || depth == 0 || blocks == 0) return false;
+
+        auto* s = (State*)Memory::g_heap->Request(sizeof(State));
+        if (s == nullptr) return false;
+        memset(s, 0, sizeof(State));
+        s->dev = dev;
+        s->write = params.flags & Montauk::DISKBENCH_WRITE;
+        s->random = params.flags & Montauk::DISKBENCH_RANDOM;
+        s->blockSectors = blockSectors;
+        s->startLba = params.startLba;
+        s->blocks = blocks;
+        s->rng = Hal::ReadTsc() | 1;
+        s->tscPerUs = Timekeeping::TscPerMicrosecond();
+        if (s->tscPerUs == 0) s->tscPerUs = 1;
+        s->minNs = ~0ULL;
+
+        int pages = (int)(((uint64_t)blockSectors * dev->SectorSize + 0xFFF) / 0x1000);
+        bool ok = true;
+        for (uint32_t i = 0; i < depth && ok; i++) {
+            void* buffer = Memory::g_pfa->AllocateContiguous(pages);
+            if (buffer == nullptr) {
+                ok = false;
+                break;
+            }
+            // Writes carry a recognizable pattern rather than zeros
+            memset(buffer, 0xA5, (uint64_t)pages * 0x1000);
+
+            BlockRequest& req = s->slots[i].req;
+            req.Device = dev;
+            req.Count = blockSectors;
+            req.Write = s->write;
+            req.Buffer = buffer;
+            req.Done = Completed;
+            req.Cookie = s;
+        }
+
+        if (ok) {
+            uint32_t duration = params.durationMs;
+            if (duration > Montauk::DISKBENCH_MAX_MS) duration = Montauk::DISKBENCH_MAX_MS;
+            uint64_t startUs = Timekeeping::GetMicroseconds();
+            s->endUs = startUs + (uint64_t)duration * 1000;
+            s->lastUs = startUs;
+
+            for (uint32_t i = 0; i < depth; i++) {
+                __atomic_add_fetch(&s->inflight, 1, __ATOMIC_ACQ_REL);
+                if (!Submit(*s, s->slots[i])) {
+                    __atomic_sub_fetch(&s->inflight, 1, __ATOMIC_ACQ_REL);
+                    s->errors++;
+                    break;
+                }
+            }
+
+            // Completions resubmit from whichever thread runs the queue;
+            // the buffers stay ours until the last one is in
+            for (;;) {
+                RunQueue(dev);
+                uint32_t left = __atomic_load_n(&s->inflight, __ATOMIC_ACQUIRE);
+                if (left == 0) break;
+                Sched::WaitOnAddress(&s->inflight, left);
+            }
+
+            memset(&result, 0, sizeof(result));
+            result.blockBytes = blockSectors * dev->SectorSize;
+            result.depth = depth;
+            result.ops = s->ops;
+            result.bytes = s->ops * result.blockBytes;
+            result.elapsedUs = s->lastUs - startUs;
+            result.errors = s->errors;
+            if (s->ops > 0) {
+                result.avgNs = s->totalNs / s->ops;
+                result.minNs = s->minNs;
+                result.p50Ns = Percentile(*s, 500);
+                result.p90Ns = Percentile(*s, 900);
+                result.p99Ns = Percentile(*s, 990);
+                result.p999Ns = Percentile(*s, 999);
+                result.maxNs = s->maxNs;
+            }
+        }
+
+        for (uint32_t i = 0; i < depth; i++) {
+            if (s->slots[i].req.Buffer) Memory::g_pfa->Free(s->slots[i].req.Buffer, pages);
+        }
+        Memory::g_heap->Free(s);
+        return ok;
+    }
+
+};
@@ -0,0 +1,22 @@
+/*
+    * Bench.hpp
+    * Raw block device benchmark
+    * Copyright (c) 2026 Daniel Hammer
+*/
+
+#pragma once
+#include <cstdint>
+#include <Api/Syscall.hpp>
+#include "BlockDevice.hpp"
+
+namespace Drivers::Storage::Bench {
+
+    // Keep params.depth requests in flight on `dev` for params.durationMs,
+    // resubmitting each from its completion, and fill `result`. Requests
+    // bypass the buffer cache, so writes must only target sectors nothing
+    // else uses (the caller checks). Returns false if the parameters are
+    // unusable or memory runs out.
+    bool Run(const BlockDevice* dev, const Montauk::DiskBenchParams& params,
+             Montauk::DiskBenchResult& result);
+
+};
@@ -1,20 +1,57 @@
 /*
     * BlockDevice.cpp
-    * Driver-agnostic block device registry
+    * Driver-agnostic block device registry and request queues
     * Copyright (c) 2026 Daniel Hammer
 */
 
 #include "BlockDevice.hpp"
+#include <CppLib/Spinlock.hpp>
+#include <Sched/Scheduler.hpp>
+#include <Timekeeping/ApicTimer.hpp>
+#include <Libraries/Memory.hpp>
+#include <Memory/PageFrameAllocator.hpp>
+#include <Common/Trace.hpp>
 
 namespace Drivers::Storage {
 
     static BlockDevice g_devices[MaxBlockDevices] = {};
     static int g_deviceCount = 0;
 
+    // Fallback transfer limit for devices that do not report one
+    static constexpr uint32_t DefaultMaxTransfer = 128;
+
+    // How long a request may be passed over by the elevator. Reads have
+    // someone waiting on them; writes are mostly write back.
+    static constexpr uint64_t ReadExpireMs = 250;
+    static constexpr uint64_t WriteExpireMs = 2500;
+
+    struct Queue {
+        kcp::Mutex    lock;          // Never held across a driver call
+        BlockRequest* head;          // Pending requests, ascending LBA
+        bool          running;       // A thread is dispatching
+        uint64_t      position;      // LBA after the last dispatched request
+
+        // Only touched by the dispatching thread
+        uint8_t* staging;            // One transfer, for merging scattered buffers
+        bool     stagingFailed;
+    };
+
+    static Queue g_queues[MaxBlockDevices];
+
+    // Controllers are brought up in parallel at boot
+    static kcp::Mutex g_registerLock;
+
     int RegisterBlockDevice(const BlockDevice& dev) {
-        if (g_deviceCount >= MaxBlockDevices) return -1;
-        g_devices[g_deviceCount] = dev;
-        return g_deviceCount++;
+        g_registerLock.Acquire();
+        if (g_deviceCount >= MaxBlockDevices) {
+            g_registerLock.Release();
+            return -1;
+        }
+        int index = g_deviceCount;
+        g_devices[index] = dev;
+        __atomic_store_n(&g_deviceCount, index + 1, __ATOMIC_RELEASE);
+        g_registerLock.Release();
+        return index;
     }
 
     const BlockDevice* GetBlockDevice(int index) {
@@ -26,4 +63,228 @@ namespace Drivers::Storage {
         return g_deviceCount;
     }
 
+    uint32_t GetMaxTransfer(const BlockDevice* dev) {
+        return dev->MaxTransfer ? dev->MaxTransfer : DefaultMaxTransfer;
+    }
+
+    // ====================================================================
+    // Request queue
+    // ====================================================================
+
+    static Queue* QueueOf(const BlockDevice* dev) {
+        if (dev < g_devices || dev >= g_devices + g_deviceCount) return nullptr;
+        return &g_queues[dev - g_devices];
+    }
+
+    static bool Issue(const BlockDevice* dev, bool write, uint64_t lba, uint32_t count, void* buffer) {
+        if (write) return dev->WriteSectors(dev->Ctx, lba, count, buffer);
+        return dev->ReadSectors(dev->Ctx, lba, count, buffer);
+    }
+
+    static void Finish(BlockRequest* req, bool ok) {
+        if (Trace::On(Montauk::TRACE_BLOCK)) {
+            Trace::Write(Montauk::TRACE_EV_BLOCK_COMPLETE,
+                         (uint32_t)(req->Device - g_devices) | (ok ? 0 : 1u << 31),
+                         req->Lba, req->Count | (uint64_t)req->Write << 31);
+        }
+
+        if (req->Done) {
+            req->Done(req, ok);
+            return;
+        }
+        req->Ok = ok;
+        __atomic_store_n(&req->Complete, 1, __ATOMIC_RELEASE);
+        Sched::WakeAddress(&req->Complete, 1);
+    }
+
+    static bool Adjacent(const BlockRequest* a, const BlockRequest* b) {
+        return a->Write == b->Write && a->Lba + a->Count == b->Lba;
+    }
+
+    // The request to serve next: the oldest if its deadline has passed,
+    // else the first at or above the head position, wrapping around to
+    // the lowest. Queue lock held.
+    static BlockRequest* PickLocked(Queue& q) {
+        if (q.head == nullptr) return nullptr;
+
+        BlockRequest* oldest = q.head;
+        for (BlockRequest* r = q.head->Next; r; r = r->Next) {
+            if (r->Deadline < oldest->Deadline) oldest = r;
+        }
+        if (oldest->Deadline <= Timekeeping::GetMilliseconds()) return oldest;
+
+        for (BlockRequest* r = q.head; r; r = r->Next) {
+            if (r->Lba >= q.position) return r;
+        }
+        return q.head;
+    }
+
+    // Serve the requests first..last (chained by Next, adjacent LBAs, same
+    // direction) with as few driver calls as possible
+    static void Dispatch(const BlockDevice* dev, Queue& q, BlockRequest* first, uint32_t total) {
+        bool write = first->Write;
+        uint64_t sectorSize = dev->SectorSize;
+
+        // One call when there is one request or the buffers follow each other
+        bool contiguous = true;
+        for (BlockRequest* r = first; r->Next && contiguous; r = r->Next) {
+            contiguous = (uint8_t*)r->Buffer + r->Count * sectorSize == (uint8_t*)r->Next->Buffer;
+        }
+
+        if (!contiguous && q.staging == nullptr && !q.stagingFailed) {
+            int pages = (int)((GetMaxTransfer(dev) * sectorSize + 0xFFF) / 0x1000);
+            q.staging = (uint8_t*)Memory::g_pfa->AllocateContiguous(pages);
+            q.stagingFailed = q.staging == nullptr;
+        }
+
+        if (contiguous || q.staging) {
+            uint8_t* buffer = contiguous ? (uint8_t*)first->Buffer : q.staging;
+            if (!contiguous && write) {
+                uint8_t* dst = q.staging;
+                for (BlockRequest* r = first; r; r = r->Next) {
+                    memcpy(dst, r->Buffer, r->Count * sectorSize);
+                    dst += r->Count * sectorSize;
+                }
+            }
+
+            bool ok = Issue(dev, write, first->Lba, total, buffer);
+
+            uint8_t* src = q.staging;
+            for (BlockRequest* r = first; r;) {
+                BlockRequest* next = r->Next;
+                if (ok && !contiguous && !write) {
+                    memcpy(r->Buffer, src, r->Count * sectorSize);
+                    src += r->Count * sectorSize;
+                }
+                Finish(r, ok);
+                r = next;
+            }
+            return;
+        }
+
+        // No staging memory: one call per request
+        for (BlockRequest* r = first; r;) {
+            BlockRequest* next = r->Next;
+            Finish(r, Issue(dev, write, r->Lba, r->Count, r->Buffer));
+            r = next;
+        }
+    }
+
+    bool SubmitRequest(BlockRequest* req) {
+        if (req == nullptr || req->Buffer == nullptr || req->Count == 0) return false;
+        Queue* q = QueueOf(req->Device);
+        if (q == nullptr || req->Count > GetMaxTransfer(req->Device)) return false;
+
+        req->Deadline = Timekeeping::GetMilliseconds() + (req->Write ? WriteExpireMs : ReadExpireMs);
+        req->Complete = 0;
+        req->Ok = false;
+
+        q->lock.Acquire();
+        BlockRequest* prev = nullptr;
+        BlockRequest* next = q->head;
+        while (next && next->Lba <= req->Lba) {
+            prev = next;
+            next = next->Next;
+        }
+        req->Prev = prev;
+        req->Next = next;
+        if (prev) prev->Next = req;
+        else q->head = req;
+        if (next) next->Prev = req;
+        q->lock.Release();
+
+        Trace::Emit(Montauk::TRACE_BLOCK, Montauk::TRACE_EV_BLOCK_SUBMIT, (uint32_t)(req->Device - g_devices),
+                    req->Lba, req->Count | (uint64_t)req->Write << 31);
+        return true;
+    }
+
+    void RunQueue(const BlockDevice* dev) {
+        Queue* q = QueueOf(dev);
+        if (q == nullptr) return;
+        uint32_t limit = GetMaxTransfer(dev);
+
+        q->lock.Acquire();
+        if (q->running) {
+            q->lock.Release();
+            return;
+        }
+        q->running = true;
+
+        for (;;) {
+            BlockRequest* first = PickLocked(*q);
+            if (first == nullptr) break;
+
+            // Merge the neighbours on both sides, up to one transfer
+            BlockRequest* last = first;
+            uint32_t total = first->Count;
+            while (first->Prev && Adjacent(first->Prev, first) && total + first->Prev->Count <= limit) {
+                first = first->Prev;
+                total += first->Count;
+            }
+            while (last->Next && Adjacent(last, last->Next) && total + last->Next->Count <= limit) {
+                last = last->Next;
+                total += last->Count;
+            }
+
+            // Unlink first..last, leaving it chained by Next
+            if (first->Prev) first->Prev->Next = last->Next;
+            else q->head = last->Next;
+            if (last->Next) last->Next->Prev = first->Prev;
+            last->Next = nullptr;
+            q->position = last->Lba + last->Count;
+
+            q->lock.Release();
+            Dispatch(dev, *q, first, total);
+            q->lock.Acquire();
+        }
+
+        q->running = false;
+        q->lock.Release();
+    }
+
+    bool WaitRequest(BlockRequest* req) {
+        // The dispatcher serves everything queued before it stops, so if
+        // another thread is running the queue, it will get to `req`
+        RunQueue(req->Device);
+        while (__atomic_load_n(&req->Complete, __ATOMIC_ACQUIRE) == 0) {
+            Sched::WaitOnAddress(&req->Complete, 0);
+        }
+        return req->Ok;
+    }
+
+    bool TransferSectors(const BlockDevice* dev, bool write, uint64_t lba, uint32_t count, void* buffer) {
+        static constexpr int Batch = 8;
+        if (dev == nullptr) return false;
+        uint32_t limit = GetMaxTransfer(dev);
+        uint8_t* pos = (uint8_t*)buffer;
+
+        while (count > 0) {
+            BlockRequest reqs[Batch];
+            int n = 0;
+            bool ok = true;
+            for (; n < Batch && count > 0; n++) {
+                uint32_t chunk = count > limit ? limit : count;
+                reqs[n] = {};
+                reqs[n].Device = dev;
+                reqs[n].Lba = lba;
+                reqs[n].Count = chunk;
+                reqs[n].Write = write;
+                reqs[n].Buffer = pos;
+                if (!SubmitRequest(&reqs[n])) {
+                    ok = false;
+                    break;
+                }
+                lba += chunk;
+                count -= chunk;
+                pos += (uint64_t)chunk * dev->SectorSize;
+            }
+
+            for (int i = 0; i < n; i++) {
+                if (!WaitRequest(&reqs[i])) ok = false;
+            }
+            if (!ok) return false;
+        }
+        return true;
+    }
+
 };
@@ -17,6 +17,7 @@ namespace Drivers::Storage {
         void*    Ctx;
         uint64_t SectorCount;
         uint16_t SectorSize;
+        uint32_t MaxTransfer;   // Most sectors per request (0 = 128)
         char     Model[41];
     };
 
@@ -29,4 +30,58 @@ namespace Drivers::Storage {
     // Get the number of registered block devices.
     int GetBlockDeviceCount();
 
+    // Most sectors the device takes in one request
+    uint32_t GetMaxTransfer(const BlockDevice* dev);
+
+    // ====================================================================
+    // Request queue
+    // ====================================================================
+
+    // Every device has a queue of pending requests kept in LBA order.
+    // SubmitRequest() only queues; whichever thread runs the queue next
+    // dispatches everything pending, so a caller that submits a batch
+    // before waiting lets adjacent requests reach the driver as one
+    // command. The next request is picked by a deadline elevator: sweep
+    // upward from where the last one ended (C-LOOK), unless the oldest
+    // request has waited past its deadline. Completions run on the
+    // dispatching thread. Overlapping requests in flight together are
+    // not ordered against each other.
+
+    struct BlockRequest;
+    using BlockRequestDone = void (*)(BlockRequest* req, bool ok);
+
+    struct BlockRequest {
+        const BlockDevice* Device;
+        uint64_t Lba;
+        uint32_t Count;            // At most GetMaxTransfer(Device)
+        bool     Write;
+        void*    Buffer;           // Only read from for writes
+        BlockRequestDone Done;     // nullptr: wait with WaitRequest()
+        void*    Cookie;           // For Done
+
+        // Owned by the queue while the request is pending
+        uint64_t Deadline;
+        BlockRequest* Prev;
+        BlockRequest* Next;
+        volatile uint32_t Complete;
+        bool     Ok;
+    };
+
+    // Queue `req`. Returns false (and queues nothing) if it is malformed.
+    // With a Done callback the queue never touches the request again after
+    // calling it, so the callback may free it.
+    bool SubmitRequest(BlockRequest* req);
+
+    // Dispatch the pending requests of `dev` until none are left, unless
+    // another thread is already doing so
+    void RunQueue(const BlockDevice* dev);
+
+    // Run the queue and sleep until `req` (submitted without Done) has
+    // completed. Returns whether it succeeded.
+    bool WaitRequest(BlockRequest* req);
+
+    // Read or write any number of sectors through the queue, split to the
+    // transfer limit. Returns false on a device error.
+    bool TransferSectors(const BlockDevice* dev, bool write, uint64_t lba, uint32_t count, void* buffer);
+
 };
@@ -0,0 +1,461 @@
+/*
+    * BufferCache.cpp
+    * Shared block buffer cache in front of every block device
+    * Copyright (c) 2026 Daniel Hammer
+*/
+
+#include "BufferCache.hpp"
+#include <Terminal/Terminal.hpp>
+#include <CppLib/Stream.hpp>
+#include <Sched/SleepLock.hpp>
+#include <Libraries/Memory.hpp>
+#include <Memory/PageFrameAllocator.hpp>
+#include <Memory/Pressure.hpp>
+
+using namespace Kt;
+
+namespace Drivers::Storage::BufferCache {
+
+    // At most this many buffers, and no more than 1/64 of physical memory
+    static constexpr int MaxBuffers = 4096;
+    static constexpr int MinBuffers = 64;
+    static constexpr int HashBuckets = 1024;
+
+    struct Buffer {
+        const BlockDevice* device;   // nullptr while unused
+        uint64_t lba;                // First sector, a multiple of the sectors per buffer
+        uint8_t* data;               // One page
+        bool     dirty;
+        Buffer*  hashNext;
+        Buffer*  lruPrev;            // Towards the most recently used
+        Buffer*  lruNext;
+    };
+
+    static Buffer g_buffers[MaxBuffers];
+    static Buffer* g_hash[HashBuckets];
+    static Buffer* g_lruHead = nullptr;
+    static Buffer* g_lruTail = nullptr;
+    static int g_capacity = 0;       // Set on first use
+    static int g_used = 0;           // Buffer slots handed out so far (they are never freed)
+    static int g_resident = 0;       // Buffers holding a page
+    static Buffer* g_spare = nullptr; // Slots whose page was given back, linked through hashNext
+    static int g_dirtyCount = 0;
+
+    // Largest prefetch request, in buffers, and its staging area
+    static constexpr int PrefetchBuffers = 64;
+    static uint8_t* g_staging = nullptr;
+
+    // Write backs in flight during Flush()
+    static constexpr int FlushBatch = 64;
+    static BlockRequest g_flushRequests[FlushBatch];
+    static Buffer* g_flushBuffers[FlushBatch];
+
+    // Held across device I/O, so waiters sleep instead of spinning
+    static Sched::SleepLock g_lock;
+
+    // ====================================================================
+    // Geometry and raw device access
+    // ====================================================================
+
+    // Sectors per buffer, or 0 if the sector size does not divide a page
+    static uint32_t SectorsPerBuffer(const BlockDevice* dev) {
+        if (dev->SectorSize == 0 || dev->SectorSize > BufferSize || BufferSize % dev->SectorSize) return 0;
+        return BufferSize / dev->SectorSize;
+    }
+
+    static bool DeviceRead(const BlockDevice* dev, uint64_t lba, uint32_t count, uint8_t* buffer) {
+        return TransferSectors(dev, false, lba, count, buffer);
+    }
+
+    static bool DeviceWrite(const BlockDevice* dev, uint64_t lba, uint32_t count, const uint8_t* buffer) {
+        return TransferSectors(dev, true, lba, count, (void*)buffer);
+    }
+
+    // Sectors of the buffer at `lba` that exist on the device (the last
+    // buffer of an odd-sized disk is partial)
+    static uint32_t ValidSectors(const BlockDevice* dev, uint64_t lba, uint32_t spb) {
+        uint64_t left = dev->SectorCount > lba ? dev->SectorCount - lba : 0;
+        return left < spb ? (uint32_t)left : spb;
+    }
+
+    // ====================================================================
+    // Hash and LRU lists (lock held)
+    // ====================================================================
+
+    static uint32_t Bucket(const BlockDevice* dev, uint64_t lba) {
+        uint64_t key = lba * 0x9E3779B97F4A7C15ULL ^ (uint64_t)dev;
+        return (uint32_t)(key >> 40) % HashBuckets;
+    }
+
+    static Buffer* Lookup(const BlockDevice* dev, uint64_t lba) {
+        for (Buffer* b = g_hash[Bucket(dev, lba)]; b; b = b->hashNext) {
+            if (b->device == dev && b->lba == lba) return b;
+        }
+        return nullptr;
+    }
+
+    static void HashRemove(Buffer* b) {
+        Buffer** link = &g_hash[Bucket(b->device, b->lba)];
+        while (*link && *link != b) link = &(*link)->hashNext;
+        if (*link) *link = b->hashNext;
+        b->hashNext = nullptr;
+    }
+
+    static void HashInsert(Buffer* b) {
+        Buffer** head = &g_hash[Bucket(b->device, b->lba)];
+        b->hashNext = *head;
+        *head = b;
+    }
+
+    static void LruUnlink(Buffer* b) {
+        if (b->lruPrev) b->lruPrev->lruNext = b->lruNext;
+        else g_lruHead = b->lruNext;
+        if (b->lruNext) b->lruNext->lruPrev = b->lruPrev;
+        else g_lruTail = b->lruPrev;
+        b->lruPrev = b->lruNext = nullptr;
+    }
+
+    static void LruPushFront(Buffer* b) {
+        b->lruPrev = nullptr;
+        b->lruNext = g_lruHead;
+        if (g_lruHead) g_lruHead->lruPrev = b;
+        else g_lruTail = b;
+        g_lruHead = b;
+    }
+
+    static void LruPushBack(Buffer* b) {
+        b->lruNext = nullptr;
+        b->lruPrev = g_lruTail;
+        if (g_lruTail) g_lruTail->lruNext = b;
+        else g_lruHead = b;
+        g_lruTail = b;
+    }
+
+    static void Touch(Buffer* b) {
+        if (b != g_lruHead) {
+            LruUnlink(b);
+            LruPushFront(b);
+        }
+    }
+
+    static bool WriteBack(Buffer* b) {
+        uint32_t spb = SectorsPerBuffer(b->device);
+        if (!DeviceWrite(b->device, b->lba, ValidSectors(b->device, b->lba, spb), b->data)) {
+            KernelLogStream(ERROR, "BufCache") << "Write back failed at LBA " << base::dec << b->lba;
+            return false;
+        }
+        b->dirty = false;
+        g_dirtyCount--;
+        return true;
+    }
+
+    // Memory pressure: give back the staging area and the pages of clean
+    // buffers, least recently used first. Dirty ones wait for a write back.
+    static uint64_t Shrink(uint64_t pages) {
+        if (!g_lock.TryAcquire()) return 0;
+
+        uint64_t freed = 0;
+        if (g_staging != nullptr) {
+            Memory::g_pfa->Free(g_staging, PrefetchBuffers);
+            g_staging = nullptr;
+            freed += PrefetchBuffers;
+        }
+
+        Buffer* b = g_lruTail;
+        while (b != nullptr && freed < pages) {
+            Buffer* prev = b->lruPrev;
+            if (!b->dirty) {
+                LruUnlink(b);
+                if (b->device) HashRemove(b);
+                b->device = nullptr;
+                Memory::g_pfa->Free(b->data);
+                b->data = nullptr;
+                b->hashNext = g_spare;
+                g_spare = b;
+                g_resident--;
+                freed++;
+            }
+            b = prev;
+        }
+
+        g_lock.Release();
+        return freed;
+    }
+
+    static void InitializeLocked() {
+        Montauk::MemStats stats = {};
+        Memory::g_pfa->GetStats(&stats);
+        uint64_t limit = stats.totalBytes / 0x1000 / 64;
+        g_capacity = limit > MaxBuffers ? MaxBuffers : limit < MinBuffers ? MinBuffers : (int)limit;
+        Memory::Pressure::RegisterShrinker("bufcache", Shrink);
+
+        KernelLogStream(OK, "BufCache") << "Up to " << base::dec << (uint64_t)g_capacity
+            << " buffers (" << (uint64_t)g_capacity * BufferSize / 1024 << " KiB)";
+    }
+
+    // A buffer to hold (dev, lba): a fresh one while below capacity and
+    // memory is not short, else the least recently used, written back
+    // first if dirty. Returns nullptr if memory is out or the write back
+    // failed.
+    static Buffer* Recycle() {
+        if (g_capacity == 0) InitializeLocked();
+
+        bool grow = g_lruTail == nullptr || Memory::Pressure::Level() < Montauk::MEM_PRESSURE_MEDIUM;
+        if (g_resident < g_capacity && grow) {
+            void* page = Memory::g_pfa->Allocate();
+            if (page) {
+                Buffer* b = g_spare;
+                if (b) g_spare = b->hashNext;
+                else b = &g_buffers[g_used++];
+                b->hashNext = nullptr;
+                b->data = (uint8_t*)page;
+                g_resident++;
+                return b;
+            }
+            if (g_lruTail == nullptr) return nullptr;
+        }
+
+        Buffer* b = g_lruTail;
+        if (b->dirty && !WriteBack(b)) return nullptr;
+        LruUnlink(b);
+        if (b->device) HashRemove(b);
+        b->device = nullptr;
+        return b;
+    }
+
+    // The buffer for (dev, lba), loaded from the device unless `load` is
+    // false (the caller is about to overwrite all of it)
+    static Buffer* Get(const BlockDevice* dev, uint64_t lba, uint32_t spb, bool load) {
+        Buffer* b = Lookup(dev, lba);
+        if (b) {
+            Touch(b);
+            return b;
+        }
+
+        b = Recycle();
+        if (b == nullptr) return nullptr;
+
+        if (load) {
+            uint32_t valid = ValidSectors(dev, lba, spb);
+            if (!DeviceRead(dev, lba, valid, b->data)) {
+                // Unhashed, so it is the next one recycled
+                b->dirty = false;
+                LruPushBack(b);
+                return nullptr;
+            }
+            if (valid < spb) memset(b->data + valid * dev->SectorSize, 0, (spb - valid) * dev->SectorSize);
+        }
+
+        b->device = dev;
+        b->lba = lba;
+        b->dirty = false;
+        HashInsert(b);
+        LruPushFront(b);
+        return b;
+    }
+
+    // ====================================================================
+    // Public API
+    // ====================================================================
+
+    bool Read(const BlockDevice* dev, uint64_t lba, uint32_t count, void* buffer) {
+        if (dev == nullptr || buffer == nullptr) return false;
+        uint32_t spb = SectorsPerBuffer(dev);
+        if (spb == 0) return DeviceRead(dev, lba, count, (uint8_t*)buffer);
+
+        uint32_t sectorSize = dev->SectorSize;
+        uint8_t* dst = (uint8_t*)buffer;
+        g_lock.Acquire();
+
+        // Large reads take what is cached (prefetched or dirty data) from
+        // the buffers and read each uncached stretch straight into `buffer`
+        if ((uint64_t)count * sectorSize >= BypassBytes) {
+            bool ok = true;
+            uint64_t pos = lba, end = lba + count;
+            while (ok && pos < end) {
+                uint64_t base = pos - pos % spb;
+                uint64_t next = base + spb < end ? base + spb : end;
+                Buffer* b = Lookup(dev, base);
+                if (b) {
+                    Touch(b);
+                    memcpy(dst + (pos - lba) * sectorSize, b->data + (pos - base) * sectorSize,
+                           (next - pos) * sectorSize);
+                    pos = next;
+                    continue;
+                }
+
+                while (next < end && !Lookup(dev, next)) next = next + spb < end ? next + spb : end;
+                ok = DeviceRead(dev, pos, (uint32_t)(next - pos), dst + (pos - lba) * sectorSize);
+                pos = next;
+            }
+            g_lock.Release();
+            return ok;
+        }
+
+        while (count > 0) {
+            uint64_t base = lba - lba % spb;
+            uint32_t offset = (uint32_t)(lba - base);
+            uint32_t n = spb - offset;
+            if (n > count) n = count;
+
+            Buffer* b = Get(dev, base, spb, true);
+            if (b == nullptr) {
+                g_lock.Release();
+                return false;
+            }
+            memcpy(dst, b->data + offset * sectorSize, (uint64_t)n * sectorSize);
+
+            dst += (uint64_t)n * sectorSize;
+            lba += n;
+            count -= n;
+        }
+
+        g_lock.Release();
+        return true;
+    }
+
+    bool Write(const BlockDevice* dev, uint64_t lba, uint32_t count, const void* buffer) {
+        if (dev == nullptr || buffer == nullptr) return false;
+        uint32_t spb = SectorsPerBuffer(dev);
+        if (spb == 0) return DeviceWrite(dev, lba, count, (const uint8_t*)buffer);
+
+        uint32_t sectorSize = dev->SectorSize;
+        const uint8_t* src = (const uint8_t*)buffer;
+        g_lock.Acquire();
+
+        // Large writes go straight to the device; cached copies of the
+        // range are updated in place (their other sectors keep their state)
+        if ((uint64_t)count * sectorSize >= BypassBytes) {
+            bool ok = DeviceWrite(dev, lba, count, src);
+            uint64_t first = lba - lba % spb;
+            for (uint64_t bl = first; bl < lba + count; bl += spb) {
+                Buffer* b = Lookup(dev, bl);
+                if (b == nullptr) continue;
+                uint64_t from = bl > lba ? bl : lba;
+                uint64_t to = bl + spb < lba + count ? bl + spb : lba + count;
+                memcpy(b->data + (from - bl) * sectorSize, src + (from - lba) * sectorSize,
+                       (to - from) * sectorSize);
+            }
+            g_lock.Release();
+            return ok;
+        }
+
+        while (count > 0) {
+            uint64_t base = lba - lba % spb;
+            uint32_t offset = (uint32_t)(lba - base);
+            uint32_t n = spb - offset;
+            if (n > count) n = count;
+
+            // A write covering the whole buffer need not read it first
+            Buffer* b = Get(dev, base, spb, n != ValidSectors(dev, base, spb));
+            if (b == nullptr) {
+                g_lock.Release();
+                return false;
+            }
+            memcpy(b->data + offset * sectorSize, src, (uint64_t)n * sectorSize);
+            if (!b->dirty) {
+                b->dirty = true;
+                g_dirtyCount++;
+            }
+
+            src += (uint64_t)n * sectorSize;
+            lba += n;
+            count -= n;
+        }
+
+        g_lock.Release();
+        return true;
+    }
+
+    void Prefetch(const BlockDevice* dev, uint64_t lba, uint32_t count) {
+        if (dev == nullptr || count == 0) return;
+        uint32_t spb = SectorsPerBuffer(dev);
+        if (spb == 0) return;
+
+        // Whole buffers only, none past the last full one on the device
+        uint64_t pos = lba - lba % spb;
+        uint64_t end = lba + count;
+        if (end > dev->SectorCount) end = dev->SectorCount;
+        end -= end % spb;
+
+        g_lock.Acquire();
+        if (g_staging == nullptr) g_staging = (uint8_t*)Memory::g_pfa->AllocateContiguous(PrefetchBuffers);
+        if (g_staging == nullptr) {
+            g_lock.Release();
+            return;
+        }
+
+        while (pos < end) {
+            if (Lookup(dev, pos)) {
+                pos += spb;
+                continue;
+            }
+
+            // The next stretch of uncached buffers, in one request
+            uint64_t next = pos + spb;
+            while (next < end && next - pos < (uint64_t)PrefetchBuffers * spb && !Lookup(dev, next)) next += spb;
+            if (!DeviceRead(dev, pos, (uint32_t)(next - pos), g_staging)) break;
+
+            for (uint64_t bl = pos; bl < next; bl += spb) {
+                Buffer* b = Get(dev, bl, spb, false);
+                if (b == nullptr) break;
+                memcpy(b->data, g_staging + (bl - pos) * dev->SectorSize, BufferSize);
+            }
+            pos = next;
+        }
+        g_lock.Release();
+    }
+
+    // Wait for a batch of write backs queued by Flush(). Lock held.
+    static bool FinishFlushBatch(int n) {
+        bool ok = true;
+        for (int i = 0; i < n; i++) {
+            Buffer* b = g_flushBuffers[i];
+            if (!WaitRequest(&g_flushRequests[i])) {
+                KernelLogStream(ERROR, "BufCache") << "Write back failed at LBA " << base::dec << b->lba;
+                ok = false;
+                continue;
+            }
+            b->dirty = false;
+            g_dirtyCount--;
+        }
+        return ok;
+    }
+
+    bool Flush(const BlockDevice* dev) {
+        g_lock.Acquire();
+        bool ok = true;
+        int n = 0;
+
+        // Queue the dirty buffers in batches, so the device queue can sort
+        // them and merge neighbours into single writes
+        for (int i = 0; i < g_used && g_dirtyCount > 0; i++) {
+            Buffer* b = &g_buffers[i];
+            if (!b->dirty || (dev != nullptr && b->device != dev)) continue;
+
+            uint32_t spb = SectorsPerBuffer(b->device);
+            BlockRequest& req = g_flushRequests[n];
+            req = {};
+            req.Device = b->device;
+            req.Lba = b->lba;
+            req.Count = ValidSectors(b->device, b->lba, spb);
+            req.Write = true;
+            req.Buffer = b->data;
+            if (req.Count > GetMaxTransfer(b->device) || !SubmitRequest(&req)) {
+                if (!WriteBack(b)) ok = false;
+                continue;
+            }
+
+            g_flushBuffers[n++] = b;
+            if (n == FlushBatch) {
+                if (!FinishFlushBatch(n)) ok = false;
+                n = 0;
+            }
+        }
+        if (n > 0 && !FinishFlushBatch(n)) ok = false;
+
+        g_lock.Release();
+        return ok;
+    }
+
+};
@@ -0,0 +1,43 @@
+/*
+    * BufferCache.hpp
+    * Shared block buffer cache in front of every block device
+    * Copyright (c) 2026 Daniel Hammer
+*/
+
+#pragma once
+#include <cstdint>
+#include "BlockDevice.hpp"
+
+namespace Drivers::Storage::BufferCache {
+
+    // Sector I/O for filesystems, the GPT code and raw disk syscalls goes
+    // through here instead of BlockDevice::ReadSectors/WriteSectors. Data
+    // is cached in page-sized buffers keyed by (device, LBA) and recycled
+    // least-recently-used first. Writes only dirty the buffers; they reach
+    // the disk on eviction or Flush().
+    //
+    // Transfers of BypassBytes or more do not fill the buffers (streaming
+    // would only evict the metadata worth keeping) but use and update the
+    // ones already cached.
+    // Requests of any length are split to the device's transfer limit and
+    // go through its request queue (see BlockDevice.hpp).
+
+    static constexpr uint32_t BufferSize = 0x1000;
+    static constexpr uint32_t BypassBytes = 0x10000;
+
+    // Read `count` sectors starting at `lba`. Returns false on a device error.
+    bool Read(const BlockDevice* dev, uint64_t lba, uint32_t count, void* buffer);
+
+    // Write `count` sectors starting at `lba` into the cache
+    bool Write(const BlockDevice* dev, uint64_t lba, uint32_t count, const void* buffer);
+
+    // Load the buffers covering [lba, lba + count) that are not cached yet,
+    // in as few device requests as possible. Best effort: errors and
+    // memory shortage only mean less is prefetched.
+    void Prefetch(const BlockDevice* dev, uint64_t lba, uint32_t count);
+
+    // Write back every dirty buffer of `dev`, or of all devices if nullptr.
+    // Returns false if any write failed (those buffers stay dirty).
+    bool Flush(const BlockDevice* dev = nullptr);
+
+};
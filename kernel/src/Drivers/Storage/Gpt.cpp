@@ -6,6 +6,7 @@
 
 #include "Gpt.hpp"
 #include "BlockDevice.hpp"
+#include "BufferCache.hpp"
 #include <Terminal/Terminal.hpp>
 #include <CppLib/Stream.hpp>
 #include <Libraries/Memory.hpp>
@@ -171,7 +172,7 @@ namespace Drivers::Storage::Gpt {
 
         while (remaining > 0) {
             uint32_t chunk = remaining > 128 ? 128 : remaining;
-            if (!dev->ReadSectors(dev->Ctx, lba, chunk, dst)) {
+            if (!BufferCache::Read(dev, lba, chunk, dst)) {
                 KernelLogStream(ERROR, "GPT") << "Failed to read partition entries at LBA " << lba;
                 Memory::g_pfa->Free(buf, pagesNeeded);
                 return false;
@@ -219,7 +220,7 @@ namespace Drivers::Storage::Gpt {
 
         while (remaining > 0) {
             uint32_t chunk = remaining > 128 ? 128 : remaining;
-            if (!dev->ReadSectors(dev->Ctx, lba, chunk, dst)) {
+            if (!BufferCache::Read(dev, lba, chunk, dst)) {
                 Memory::g_pfa->Free(buf, pagesNeeded);
                 return 0;
             }
@@ -280,7 +281,7 @@ namespace Drivers::Storage::Gpt {
         // Read LBA 0 (protective MBR) and LBA 1 (GPT header) — 2 sectors
         uint8_t sectorBuf[1024];
 
-        if (!dev->ReadSectors(dev->Ctx, 0, 2, sectorBuf)) {
+        if (!BufferCache::Read(dev, 0, 2, sectorBuf)) {
             return 0;
         }
 
@@ -298,7 +299,7 @@ namespace Drivers::Storage::Gpt {
 
             // Try backup header at last LBA
             uint64_t lastLba = dev->SectorCount - 1;
-            if (!dev->ReadSectors(dev->Ctx, lastLba, 1, sectorBuf + 512)) {
+            if (!BufferCache::Read(dev, lastLba, 1, sectorBuf + 512)) {
                 KernelLogStream(ERROR, "GPT") << "Failed to read backup header";
                 return 0;
             }
@@ -421,7 +422,7 @@ namespace Drivers::Storage::Gpt {
     // -------------------------------------------------------------------------
 
     static bool WriteSector(const BlockDevice* dev, uint64_t lba, const void* buf) {
-        return dev->WriteSectors(dev->Ctx, lba, 1, buf);
+        return BufferCache::Write(dev, lba, 1, buf);
     }
 
     // Rebuild and write the partition entry array + both GPT headers.
@@ -436,7 +437,7 @@ namespace Drivers::Storage::Gpt {
 
         // Write primary entry array (starts at LBA 2)
         for (uint32_t s = 0; s < entryArraySectors; s++) {
-            if (!dev->WriteSectors(dev->Ctx, primary->PartitionEntryLba + s, 1,
+            if (!BufferCache::Write(dev, primary->PartitionEntryLba + s, 1,
                                    entryArray + s * 512))
                 return false;
         }
@@ -459,7 +460,7 @@ namespace Drivers::Storage::Gpt {
 
         // Write backup entry array
         for (uint32_t s = 0; s < entryArraySectors; s++) {
-            if (!dev->WriteSectors(dev->Ctx, backup.PartitionEntryLba + s, 1,
+            if (!BufferCache::Write(dev, backup.PartitionEntryLba + s, 1,
                                    entryArray + s * 512))
                 return false;
         }
@@ -471,7 +472,8 @@ namespace Drivers::Storage::Gpt {
         memcpy(hdrSector, &backup, backup.HeaderSize);
         if (!WriteSector(dev, backup.MyLba, hdrSector)) return false;
 
-        return true;
+        // The table must be on disk before anyone repartitions or reboots
+        return BufferCache::Flush(dev);
     }
 
     // -------------------------------------------------------------------------
@@ -558,7 +560,7 @@ namespace Drivers::Storage::Gpt {
 
         // Read existing primary GPT header
         uint8_t hdrBuf[512];
-        if (!dev->ReadSectors(dev->Ctx, 1, 1, hdrBuf)) return -1;
+        if (!BufferCache::Read(dev, 1, 1, hdrBuf)) return -1;
 
         GptHeader* hdr = (GptHeader*)hdrBuf;
         if (!ValidateHeader(hdr, 1)) {
@@ -574,7 +576,7 @@ namespace Drivers::Storage::Gpt {
 
         uint32_t entryArraySectors = (entryArrayBytes + 511) / 512;
         for (uint32_t s = 0; s < entryArraySectors; s++) {
-            if (!dev->ReadSectors(dev->Ctx, hdr->PartitionEntryLba + s, 1, entryArray + s * 512)) {
+            if (!BufferCache::Read(dev, hdr->PartitionEntryLba + s, 1, entryArray + s * 512)) {
                 Memory::g_pfa->Free(entryArray, pages);
                 return -1;
             }
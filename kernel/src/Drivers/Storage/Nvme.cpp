@@ -12,9 +12,15 @@
 #include <Memory/HHDM.hpp>
 #include <Memory/Paging.hpp>
 #include <Memory/PageFrameAllocator.hpp>
+#include <Memory/Dma.hpp>
 #include <Libraries/Memory.hpp>
 #include <Hal/Apic/Interrupts.hpp>
 #include <Hal/Apic/IoApic.hpp>
+#include <Hal/Apic/ApicInit.hpp>
+#include <Hal/SmpBoot.hpp>
+#include <CppLib/Spinlock.hpp>
+#include <Sched/Scheduler.hpp>
+#include <Timekeeping/ApicTimer.hpp>
 
 using namespace Kt;
 
@@ -39,17 +45,46 @@ namespace Drivers::Storage::Nvme {
     static uint8_t   g_adminCqPhase = 1;    // Expected phase bit starts at 1
     static uint16_t  g_adminCmdId = 0;
 
-    // I/O queue state (single I/O queue pair)
-    static SqEntry*  g_ioSq = nullptr;
-    static CqEntry*  g_ioCq = nullptr;
-    static uint64_t  g_ioSqPhys = 0;
-    static uint64_t  g_ioCqPhys = 0;
-    static uint16_t  g_ioSqTail = 0;
-    static uint16_t  g_ioCqHead = 0;
-    static uint8_t   g_ioCqPhase = 1;
-    static uint16_t  g_ioCmdId = 0;
-    static uint16_t  g_ioSqDepth = 0;
-    static uint16_t  g_ioCqDepth = 0;
+    // I/O queue pairs: queue ID n belongs to CPU n - 1 (CPUs beyond the
+    // last queue share them). A command is identified by its slot in
+    // Cmds, so up to Depth - 1 are in flight per queue. The submitter
+    // sleeps on its slot's Done flag until the completion interrupt.
+    struct IoCommand {
+        volatile uint32_t Done;
+        uint16_t Status;
+        bool     Busy;
+        bool     Abandoned;      // Timed out: free the slot when it completes
+    };
+
+    struct IoQueue {
+        uint16_t  Id;
+        SqEntry*  Sq;
+        CqEntry*  Cq;
+        uint64_t  SqPhys;
+        uint64_t  CqPhys;
+        uint16_t  SqTail;
+        uint16_t  CqHead;
+        uint8_t   CqPhase;
+        uint16_t  Depth;
+        uint16_t  InFlight;
+        uint16_t  NextCmd;
+        uint32_t  BoundLapic;    // Where its MSI-X vector is delivered
+        kcp::Spinlock Lock;      // Also taken by the interrupt handler
+        IoCommand Cmds[IO_QUEUE_DEPTH];
+    };
+
+    static IoQueue  g_ioQueues[MAX_IO_QUEUES];
+    static int      g_ioQueueCount = 0;
+
+    // Interrupt delivery
+    static bool     g_ioInterrupts = false;       // Completions raise an interrupt we handle
+    static volatile uint32_t* g_msixTable = nullptr;
+    static int      g_msixEntries = 0;
+
+    // Longest a command may take, and how often a sleeping submitter
+    // checks the queue itself in case an interrupt went missing
+    static constexpr uint64_t IoTimeoutMs = 5000;
+    static constexpr uint64_t IoRecheckMs = 10;
 
     // Namespace state
     static int g_nsCount = 0;
@@ -97,22 +132,6 @@ namespace Drivers::Storage::Nvme {
         *(volatile uint32_t*)(g_mmioBase + offset) = value;
     }
 
-    // -------------------------------------------------------------------------
-    // DMA buffer allocation
-    // -------------------------------------------------------------------------
-
-    static void* AllocateDmaBuffer(uint64_t& outPhys, int pages = 1) {
-        void* virt;
-        if (pages == 1) {
-            virt = Memory::g_pfa->AllocateZeroed();
-        } else {
-            virt = Memory::g_pfa->ReallocConsecutive(nullptr, pages);
-            memset(virt, 0, pages * 0x1000);
-        }
-        outPhys = Memory::SubHHDM(virt);
-        return virt;
-    }
-
     // -------------------------------------------------------------------------
     // Admin command submission
     // -------------------------------------------------------------------------
@@ -166,40 +185,241 @@ namespace Drivers::Storage::Nvme {
     // I/O command submission
     // -------------------------------------------------------------------------
 
-    static void SubmitIoCommand(SqEntry& cmd) {
-        cmd.CommandId = g_ioCmdId++;
-        g_ioSq[g_ioSqTail] = cmd;
-        g_ioSqTail = (g_ioSqTail + 1) % g_ioSqDepth;
-        WriteSqTailDoorbell(1, g_ioSqTail);
+    // Bind queue `q`'s MSI-X vector to the local APIC `lapicId`
+    static void RouteQueueVector(IoQueue& q, uint32_t lapicId) {
+        volatile uint32_t* entry = g_msixTable + q.Id * 4;
+        entry[MSIX_ENTRY_CTRL] = 1;
+        entry[MSIX_ENTRY_ADDR_LO] = MSI_ADDR_BASE | (lapicId << 12);
+        entry[MSIX_ENTRY_ADDR_HI] = 0;
+        entry[MSIX_ENTRY_DATA] = Hal::IRQ_VECTOR_BASE + MSIX_IRQ_BASE + q.Id - 1;
+        entry[MSIX_ENTRY_CTRL] = 0;
+        q.BoundLapic = lapicId;
     }
 
-    static bool WaitIoCompletion(CqEntry& out) {
-        for (int i = 0; i < 5000000; i++) {
-            CqEntry* cqe = &g_ioCq[g_ioCqHead];
-            uint16_t status = cqe->Status;
+    static void ReleaseCommandLocked(IoQueue& q, uint16_t id) {
+        q.Cmds[id].Busy = false;
+        q.InFlight--;
+    }
 
-            if ((status & CQE_PHASE_BIT) == g_ioCqPhase) {
-                out = *cqe;
+    // Consume every posted completion of `q` and wake the submitters.
+    // Queue lock held.
+    static void ReapQueueLocked(IoQueue& q) {
+        bool any = false;
+        for (;;) {
+            CqEntry* cqe = &q.Cq[q.CqHead];
+            uint16_t status = *(volatile uint16_t*)&cqe->Status;
+            if ((status & CQE_PHASE_BIT) != q.CqPhase) break;
+            uint16_t id = *(volatile uint16_t*)&cqe->CommandId;
+
+            q.CqHead++;
+            if (q.CqHead >= q.Depth) {
+                q.CqHead = 0;
+                q.CqPhase ^= 1;
+            }
+            any = true;
 
-                g_ioCqHead++;
-                if (g_ioCqHead >= g_ioCqDepth) {
-                    g_ioCqHead = 0;
-                    g_ioCqPhase ^= 1;
-                }
-                WriteCqHeadDoorbell(1, g_ioCqHead);
+            if (id >= q.Depth || !q.Cmds[id].Busy) continue;
+            IoCommand& cmd = q.Cmds[id];
+            if (cmd.Abandoned) {
+                ReleaseCommandLocked(q, id);
+                continue;
+            }
+            cmd.Status = status;
+            __atomic_store_n(&cmd.Done, 1, __ATOMIC_RELEASE);
+            Sched::WakeAddress(&cmd.Done, 1);
+        }
+        if (any) WriteCqHeadDoorbell(q.Id, q.CqHead);
+    }
 
-                if (status & CQE_STATUS_MASK) {
-                    KernelLogStream(ERROR, "NVMe") << "I/O command failed, status="
-                        << base::hex << (uint64_t)(status >> 1);
-                    return false;
-                }
-                return true;
+    static IoQueue& QueueForCpu() {
+        return g_ioQueues[Smp::GetCurrentCpuData()->cpuIndex % g_ioQueueCount];
+    }
+
+    // Place `cmd` on `q`. Returns its command slot.
+    static uint16_t SubmitIoCommand(IoQueue& q, SqEntry& cmd) {
+        for (;;) {
+            q.Lock.Acquire();
+
+            // The queue's own CPU routes its vector to itself on first use
+            // (only the BSP is online when the queues are created)
+            auto* cpu = Smp::GetCurrentCpuData();
+            if (g_msixTable && cpu->cpuIndex == q.Id - 1 && q.BoundLapic != cpu->lapicId) {
+                RouteQueueVector(q, cpu->lapicId);
             }
-            asm volatile("" ::: "memory");
+
+            if (q.InFlight < q.Depth - 1) break;
+
+            // Full: rare enough to just poll for a free slot
+            ReapQueueLocked(q);
+            q.Lock.Release();
+            asm volatile("pause");
         }
 
-        KernelLogStream(ERROR, "NVMe") << "I/O command timeout";
-        return false;
+        uint16_t id = q.NextCmd;
+        while (q.Cmds[id].Busy) id = (id + 1) % q.Depth;
+        q.NextCmd = (id + 1) % q.Depth;
+
+        IoCommand& slot = q.Cmds[id];
+        slot.Busy = true;
+        slot.Abandoned = false;
+        slot.Done = 0;
+        q.InFlight++;
+
+        cmd.CommandId = id;
+        q.Sq[q.SqTail] = cmd;
+        q.SqTail = (q.SqTail + 1) % q.Depth;
+        WriteSqTailDoorbell(q.Id, q.SqTail);
+
+        q.Lock.Release();
+        return id;
+    }
+
+    // Result of waiting for an I/O command
+    enum class IoResult { Ok, Failed, TimedOut };
+
+    // Wait for command `id` of `q`. Sleeps until the completion interrupt
+    // when there is one and a thread to put to sleep; polls otherwise.
+    // On TimedOut the device may still use the command's buffers.
+    static IoResult WaitIoCompletion(IoQueue& q, uint16_t id) {
+        IoCommand& cmd = q.Cmds[id];
+        bool sleep = g_ioInterrupts && Sched::GetCurrentThreadPtr() != nullptr;
+        uint64_t start = Timekeeping::GetMilliseconds();
+
+        while (__atomic_load_n(&cmd.Done, __ATOMIC_ACQUIRE) == 0) {
+            if (sleep) {
+                Sched::FutexWait((uint64_t)&cmd.Done, &cmd.Done, 0, IoRecheckMs);
+            } else {
+                asm volatile("pause");
+            }
+
+            q.Lock.Acquire();
+            ReapQueueLocked(q);
+            if (cmd.Done == 0 && Timekeeping::GetMilliseconds() - start >= IoTimeoutMs) {
+                cmd.Abandoned = true;
+                q.Lock.Release();
+                KernelLogStream(ERROR, "NVMe") << "I/O command timeout";
+                return IoResult::TimedOut;
+            }
+            q.Lock.Release();
+        }
+
+        q.Lock.Acquire();
+        uint16_t status = cmd.Status;
+        ReleaseCommandLocked(q, id);
+        q.Lock.Release();
+
+        if (status & CQE_STATUS_MASK) {
+            KernelLogStream(ERROR, "NVMe") << "I/O command failed, status="
+                << base::hex << (uint64_t)(status >> 1);
+            return IoResult::Failed;
+        }
+        return IoResult::Ok;
+    }
+
+    // Issue `cmd` (PRPs filled in) on this CPU's queue and wait for it
+    static IoResult RunIoCommand(SqEntry& cmd) {
+        IoQueue& q = QueueForCpu();
+        uint16_t id = SubmitIoCommand(q, cmd);
+        return WaitIoCompletion(q, id);
+    }
+
+    // -------------------------------------------------------------------------
+    // PRP lists
+    // A transfer of n pages is PRP1 (the first page, any dword offset) plus,
+    // for two pages, PRP2 = the second page, or for more, PRP2 = a list of
+    // the remaining pages. A list page holds 512 entries; when more remain
+    // than fit, its last entry points to the next list page instead.
+    // -------------------------------------------------------------------------
+
+    static constexpr int PrpsPerList = 0x1000 / sizeof(uint64_t);
+    static constexpr uint64_t KernelSpaceStart = 0xFFFF800000000000ULL;
+
+    // Fill in the PRPs of `cmd` for `pages` pages, page i at page(i)
+    // (0 = unavailable). Returns how many pages were mapped; on a shortfall
+    // the list pages built so far are still attached to `cmd`.
+    template <typename PageFn>
+    static int BuildPrps(SqEntry& cmd, int pages, PageFn page) {
+        cmd.Prp1 = page(0);
+        if (cmd.Prp1 == 0) return 0;
+        if (pages == 1) return 1;
+        if (pages == 2) {
+            cmd.Prp2 = page(1);
+            return cmd.Prp2 ? 2 : 1;
+        }
+
+        uint64_t listPhys;
+        uint64_t* list = (uint64_t*)Memory::Dma::Allocate(0x1000, listPhys);
+        if (list == nullptr) return 1;
+        cmd.Prp2 = listPhys;
+
+        int i = 1, slot = 0;
+        while (i < pages) {
+            // Chain on when this list cannot hold everything that is left
+            if (slot == PrpsPerList - 1 && pages - i > 1) {
+                uint64_t nextPhys;
+                uint64_t* next = (uint64_t*)Memory::Dma::Allocate(0x1000, nextPhys);
+                if (next == nullptr) return i;
+                list[slot] = nextPhys;
+                list = next;
+                slot = 0;
+            }
+            uint64_t phys = page(i);
+            if (phys == 0) return i;
+            list[slot++] = phys;
+            i++;
+        }
+        return pages;
+    }
+
+    // Physical address of page i of a command built by BuildPrps
+    static uint64_t PrpPage(const SqEntry& cmd, int pages, int i) {
+        if (i == 0) return cmd.Prp1;
+        if (pages == 2) return cmd.Prp2;
+
+        uint64_t* list = (uint64_t*)Memory::HHDM(cmd.Prp2);
+        int index = i - 1, left = pages - 1;
+        while (left > PrpsPerList && index >= PrpsPerList - 1) {
+            index -= PrpsPerList - 1;
+            left -= PrpsPerList - 1;
+            list = (uint64_t*)Memory::HHDM(list[PrpsPerList - 1]);
+        }
+        return list[index];
+    }
+
+    static void FreePrpLists(SqEntry& cmd, int pages) {
+        if (pages <= 2 || cmd.Prp2 == 0) return;
+
+        uint64_t phys = cmd.Prp2;
+        int left = pages - 1;
+        while (phys) {
+            uint64_t* list = (uint64_t*)Memory::HHDM(phys);
+            phys = 0;
+            if (left > PrpsPerList) {
+                phys = list[PrpsPerList - 1];
+                left -= PrpsPerList - 1;
+            }
+            Memory::Dma::Free(list, 0x1000);
+        }
+        cmd.Prp2 = 0;
+    }
+
+    // Free the first `built` bounce pages of `cmd`
+    static void FreeBouncePages(const SqEntry& cmd, int pages, int built) {
+        for (int i = 0; i < built; i++) {
+            Memory::g_pfa->Free((void*)Memory::HHDM(PrpPage(cmd, pages, i)));
+        }
+    }
+
+    // Copy between `buffer` and the bounce pages of `cmd`
+    static void CopyBounce(const SqEntry& cmd, int pages, uint8_t* buffer, uint32_t bytes, bool toDevice) {
+        for (int i = 0; i < pages && bytes > 0; i++) {
+            uint32_t n = bytes < 0x1000 ? bytes : 0x1000;
+            uint8_t* bounce = (uint8_t*)Memory::HHDM(PrpPage(cmd, pages, i));
+            if (toDevice) memcpy(bounce, buffer, n);
+            else memcpy(buffer, bounce, n);
+            buffer += n;
+            bytes -= n;
+        }
     }
 
     // -------------------------------------------------------------------------
@@ -261,11 +481,11 @@ namespace Drivers::Storage::Nvme {
     static bool SetupAdminQueues() {
         // Allocate Admin Submission Queue (ADMIN_QUEUE_DEPTH * 64 bytes)
         // At 32 entries * 64 bytes = 2048 bytes, fits in 1 page
-        g_adminSq = (SqEntry*)AllocateDmaBuffer(g_adminSqPhys);
+        g_adminSq = (SqEntry*)Memory::Dma::Allocate(0x1000, g_adminSqPhys);
 
         // Allocate Admin Completion Queue (ADMIN_QUEUE_DEPTH * 16 bytes)
         // At 32 entries * 16 bytes = 512 bytes, fits in 1 page
-        g_adminCq = (CqEntry*)AllocateDmaBuffer(g_adminCqPhys);
+        g_adminCq = (CqEntry*)Memory::Dma::Allocate(0x1000, g_adminCqPhys);
 
         g_adminSqTail = 0;
         g_adminCqHead = 0;
@@ -290,7 +510,7 @@ namespace Drivers::Storage::Nvme {
 
     static bool IdentifyController() {
         uint64_t identPhys;
-        uint8_t* identData = (uint8_t*)AllocateDmaBuffer(identPhys);
+        uint8_t* identData = (uint8_t*)Memory::Dma::Allocate(0x1000, identPhys);
 
         SqEntry cmd = {};
         cmd.Opcode = ADMIN_IDENTIFY;
@@ -302,7 +522,7 @@ namespace Drivers::Storage::Nvme {
         CqEntry cqe;
         if (!AdminCommand(cmd, cqe)) {
             KernelLogStream(ERROR, "NVMe") << "Identify Controller failed";
-            Memory::g_pfa->Free(identData);
+            Memory::Dma::Free(identData, 0x1000);
             return false;
         }
 
@@ -327,6 +547,7 @@ namespace Drivers::Storage::Nvme {
 
         // MDTS
         uint8_t mdtsPower = identData[77];
+        if (mdtsPower > 20) mdtsPower = 20;  // Far beyond MAX_TRANSFER_BYTES
         if (mdtsPower > 0) {
             g_mdts = (1u << mdtsPower);  // In minimum page size units (4 KiB pages)
         } else {
@@ -351,7 +572,7 @@ namespace Drivers::Storage::Nvme {
         for (uint32_t nsid = 1; nsid <= nn; nsid++) {
             // Identify Namespace
             uint64_t nsIdentPhys;
-            uint8_t* nsIdentData = (uint8_t*)AllocateDmaBuffer(nsIdentPhys);
+            uint8_t* nsIdentData = (uint8_t*)Memory::Dma::Allocate(0x1000, nsIdentPhys);
 
             SqEntry nsCmd = {};
             nsCmd.Opcode = ADMIN_IDENTIFY;
@@ -363,7 +584,7 @@ namespace Drivers::Storage::Nvme {
             CqEntry nsCqe;
             if (!AdminCommand(nsCmd, nsCqe)) {
                 KernelLogStream(WARNING, "NVMe") << "Identify Namespace " << (uint64_t)nsid << " failed";
-                Memory::g_pfa->Free(nsIdentData);
+                Memory::Dma::Free(nsIdentData, 0x1000);
                 continue;
             }
 
@@ -371,7 +592,7 @@ namespace Drivers::Storage::Nvme {
             uint64_t nsze = *(uint64_t*)(nsIdentData + 0);
 
             if (nsze == 0) {
-                Memory::g_pfa->Free(nsIdentData);
+                Memory::Dma::Free(nsIdentData, 0x1000);
                 continue;
             }
 
@@ -393,13 +614,11 @@ namespace Drivers::Storage::Nvme {
             g_namespaces[idx].SectorCount = nsze;
             g_namespaces[idx].SectorSize = sectorSize;
 
-            // Compute max transfer in blocks
-            if (g_mdts > 0) {
-                g_namespaces[idx].MaxTransferBlocks = (g_mdts * 0x1000) / sectorSize;
-            } else {
-                // Conservative default: 128 sectors (64 KiB for 512-byte sectors)
-                g_namespaces[idx].MaxTransferBlocks = 128;
-            }
+            // Compute max transfer in blocks: MDTS, within what one
+            // command's PRP lists are built for
+            uint64_t maxBytes = MAX_TRANSFER_BYTES;
+            if (g_mdts > 0 && (uint64_t)g_mdts * 0x1000 < maxBytes) maxBytes = (uint64_t)g_mdts * 0x1000;
+            g_namespaces[idx].MaxTransferBlocks = (uint32_t)(maxBytes / sectorSize);
 
             g_nsCount++;
 
@@ -415,10 +634,10 @@ namespace Drivers::Storage::Nvme {
                     << ": " << sizeMB << " MiB (" << (uint64_t)sectorSize << " B/sector)";
             }
 
-            Memory::g_pfa->Free(nsIdentData);
+            Memory::Dma::Free(nsIdentData, 0x1000);
         }
 
-        Memory::g_pfa->Free(identData);
+        Memory::Dma::Free(identData, 0x1000);
         return g_nsCount > 0;
     }
 
@@ -445,72 +664,111 @@ namespace Drivers::Storage::Nvme {
         return true;
     }
 
-    static bool CreateIoQueues() {
-        // Request 1 SQ + 1 CQ
-        uint16_t sqCount = 1;
-        uint16_t cqCount = 1;
-        if (!SetNumberOfQueues(sqCount, cqCount)) {
-            KernelLogStream(ERROR, "NVMe") << "Set Number of Queues failed";
-            return false;
-        }
-
-        KernelLogStream(INFO, "NVMe") << "Allocated " << (uint64_t)sqCount
-            << " SQ(s), " << (uint64_t)cqCount << " CQ(s)";
-
-        // Determine queue depths (capped by controller max)
-        g_ioSqDepth = IO_QUEUE_DEPTH;
-        g_ioCqDepth = IO_QUEUE_DEPTH;
-        if (g_ioSqDepth > g_maxQueueEntries) g_ioSqDepth = g_maxQueueEntries;
-        if (g_ioCqDepth > g_maxQueueEntries) g_ioCqDepth = g_maxQueueEntries;
+    // Create I/O queue pair `q` with queue ID `id`, completions signalled
+    // on MSI-X table entry `vector` (0 for MSI or a legacy line)
+    static bool CreateIoQueuePair(IoQueue& q, uint16_t id, uint16_t depth, uint16_t vector) {
+        q.Id = id;
+        q.Depth = depth;
+        q.SqTail = 0;
+        q.CqHead = 0;
+        q.CqPhase = 1;
+        q.InFlight = 0;
+        q.NextCmd = 0;
+        q.BoundLapic = Smp::GetCurrentCpuData()->lapicId;
 
         // Allocate I/O CQ
-        int cqPages = ((uint32_t)g_ioCqDepth * sizeof(CqEntry) + 0xFFF) / 0x1000;
-        g_ioCq = (CqEntry*)AllocateDmaBuffer(g_ioCqPhys, cqPages);
-        g_ioCqHead = 0;
-        g_ioCqPhase = 1;
+        int cqPages = ((uint32_t)depth * sizeof(CqEntry) + 0xFFF) / 0x1000;
+        q.Cq = (CqEntry*)Memory::Dma::Allocate(cqPages * 0x1000, q.CqPhys);
+        if (q.Cq == nullptr) return false;
 
-        // Create I/O Completion Queue (queue ID = 1)
+        // Create I/O Completion Queue
         {
             SqEntry cmd = {};
             cmd.Opcode = ADMIN_CREATE_IO_CQ;
-            cmd.Prp1 = g_ioCqPhys;
+            cmd.Prp1 = q.CqPhys;
             // CDW10: bits 31:16 = queue size (0-based), bits 15:0 = queue ID
-            cmd.Cdw10 = ((uint32_t)(g_ioCqDepth - 1) << 16) | 1;
+            cmd.Cdw10 = ((uint32_t)(depth - 1) << 16) | id;
             // CDW11: bit 0 = physically contiguous, bit 1 = interrupts enabled
             //        bits 31:16 = interrupt vector
-            cmd.Cdw11 = (1u << 0) | (1u << 1) | (0u << 16);
+            cmd.Cdw11 = (1u << 0) | (1u << 1) | ((uint32_t)vector << 16);
 
             CqEntry cqe;
             if (!AdminCommand(cmd, cqe)) {
-                KernelLogStream(ERROR, "NVMe") << "Create I/O CQ failed";
+                KernelLogStream(ERROR, "NVMe") << "Create I/O CQ " << base::dec << (uint64_t)id << " failed";
+                Memory::Dma::Free(q.Cq, cqPages * 0x1000);
                 return false;
             }
         }
 
         // Allocate I/O SQ
-        int sqPages = ((uint32_t)g_ioSqDepth * sizeof(SqEntry) + 0xFFF) / 0x1000;
-        g_ioSq = (SqEntry*)AllocateDmaBuffer(g_ioSqPhys, sqPages);
-        g_ioSqTail = 0;
-        g_ioCmdId = 0;
+        int sqPages = ((uint32_t)depth * sizeof(SqEntry) + 0xFFF) / 0x1000;
+        q.Sq = (SqEntry*)Memory::Dma::Allocate(sqPages * 0x1000, q.SqPhys);
+        if (q.Sq == nullptr) return false;
 
-        // Create I/O Submission Queue (queue ID = 1, linked to CQ ID = 1)
+        // Create I/O Submission Queue (linked to the CQ of the same ID)
         {
             SqEntry cmd = {};
             cmd.Opcode = ADMIN_CREATE_IO_SQ;
-            cmd.Prp1 = g_ioSqPhys;
+            cmd.Prp1 = q.SqPhys;
             // CDW10: bits 31:16 = queue size (0-based), bits 15:0 = queue ID
-            cmd.Cdw10 = ((uint32_t)(g_ioSqDepth - 1) << 16) | 1;
+            cmd.Cdw10 = ((uint32_t)(depth - 1) << 16) | id;
             // CDW11: bit 0 = physically contiguous, bits 31:16 = CQ ID
-            cmd.Cdw11 = (1u << 0) | (1u << 16);
+            cmd.Cdw11 = (1u << 0) | ((uint32_t)id << 16);
 
             CqEntry cqe;
             if (!AdminCommand(cmd, cqe)) {
-                KernelLogStream(ERROR, "NVMe") << "Create I/O SQ failed";
+                KernelLogStream(ERROR, "NVMe") << "Create I/O SQ " << base::dec << (uint64_t)id << " failed";
+                Memory::Dma::Free(q.Sq, sqPages * 0x1000);
+
+                // The CQ is unusable without its SQ
+                SqEntry del = {};
+                del.Opcode = ADMIN_DELETE_IO_CQ;
+                del.Cdw10 = id;
+                CqEntry delCqe;
+                if (AdminCommand(del, delCqe)) Memory::Dma::Free(q.Cq, cqPages * 0x1000);
                 return false;
             }
         }
 
-        KernelLogStream(OK, "NVMe") << "I/O queues created (depth " << (uint64_t)g_ioSqDepth << ")";
+        return true;
+    }
+
+    static bool CreateIoQueues() {
+        // One queue pair per CPU, as far as the controller and the MSI-X
+        // table go; a single pair without MSI-X
+        int wanted = Hal::GetDetectedCpuCount();
+        if (wanted < 1) wanted = 1;
+        if (wanted > MAX_IO_QUEUES) wanted = MAX_IO_QUEUES;
+        if (g_msixTable == nullptr) wanted = 1;
+        else if (wanted > g_msixEntries - 1) wanted = g_msixEntries - 1;
+
+        uint16_t sqCount = (uint16_t)wanted;
+        uint16_t cqCount = (uint16_t)wanted;
+        if (!SetNumberOfQueues(sqCount, cqCount)) {
+            KernelLogStream(ERROR, "NVMe") << "Set Number of Queues failed";
+            return false;
+        }
+
+        KernelLogStream(INFO, "NVMe") << "Allocated " << (uint64_t)sqCount
+            << " SQ(s), " << (uint64_t)cqCount << " CQ(s)";
+
+        if (sqCount < wanted) wanted = sqCount;
+        if (cqCount < wanted) wanted = cqCount;
+
+        // Determine queue depth (capped by controller max)
+        uint16_t depth = IO_QUEUE_DEPTH;
+        if (depth > g_maxQueueEntries) depth = g_maxQueueEntries;
+
+        g_ioQueueCount = 0;
+        for (int i = 0; i < wanted; i++) {
+            uint16_t id = (uint16_t)(i + 1);
+            if (!CreateIoQueuePair(g_ioQueues[i], id, depth, g_msixTable ? id : 0)) break;
+            g_ioQueueCount++;
+        }
+        if (g_ioQueueCount == 0) return false;
+
+        KernelLogStream(OK, "NVMe") << "I/O queues created: " << base::dec << (uint64_t)g_ioQueueCount
+            << " x depth " << (uint64_t)depth;
         return true;
     }
 
@@ -518,11 +776,79 @@ namespace Drivers::Storage::Nvme {
     // Interrupt handler
     // -------------------------------------------------------------------------
 
+    // Admin commands are polled, so only I/O completions matter here.
+    // A per-queue MSI-X vector reaps its own queue; MSI, a legacy line or
+    // the admin vector may stand for any of them.
     static void HandleInterrupt(uint8_t irq) {
-        (void)irq;
-        // NVMe uses polling-based completion in this driver.
-        // The interrupt handler just acknowledges the interrupt.
-        // Completions are consumed in the polling loops above.
+        int n = g_ioQueueCount;
+        if (irq >= MSIX_IRQ_BASE && irq < MSIX_IRQ_BASE + n) {
+            IoQueue& q = g_ioQueues[irq - MSIX_IRQ_BASE];
+            q.Lock.Acquire();
+            ReapQueueLocked(q);
+            q.Lock.Release();
+            return;
+        }
+
+        for (int i = 0; i < n; i++) {
+            g_ioQueues[i].Lock.Acquire();
+            ReapQueueLocked(g_ioQueues[i]);
+            g_ioQueues[i].Lock.Release();
+        }
+    }
+
+    // -------------------------------------------------------------------------
+    // MSI-X setup
+    // -------------------------------------------------------------------------
+
+    // Entry 0 (admin) and one entry per possible I/O queue, all delivered
+    // to the BSP until each queue's CPU claims its own
+    static bool SetupMsix(uint8_t bus, uint8_t dev, uint8_t func) {
+        uint8_t cap = Pci::FindCapability(bus, dev, func, Pci::PCI_CAP_MSIX);
+        if (cap == 0) {
+            KernelLogStream(INFO, "NVMe") << "MSI-X capability not found";
+            return false;
+        }
+
+        uint16_t msgCtrl = Pci::LegacyRead16(bus, dev, func, cap + 2);
+        int tableSize = (msgCtrl & MSIX_TABLE_SIZE_MASK) + 1;
+        if (tableSize < 2) return false;
+        if (tableSize > MAX_IO_QUEUES + 1) tableSize = MAX_IO_QUEUES + 1;
+
+        uint32_t tableReg = Pci::LegacyRead32(bus, dev, func, cap + 4);
+        uint64_t barPhys = Pci::ReadBar(bus, dev, func, (int)(tableReg & 0x7));
+        if (barPhys == 0) return false;
+        uint64_t tablePhys = barPhys + (tableReg & ~0x7u);
+
+        uint64_t first = tablePhys & ~0xFFFULL;
+        uint64_t last = (tablePhys + (uint64_t)tableSize * 16 - 1) & ~0xFFFULL;
+        for (uint64_t page = first; page <= last; page += 0x1000) {
+            Memory::VMM::g_paging->MapMMIO(page, Memory::HHDM(page));
+        }
+        g_msixTable = (volatile uint32_t*)Memory::HHDM(tablePhys);
+        g_msixEntries = tableSize;
+
+        uint32_t bsp = Smp::GetCurrentCpuData()->lapicId;
+        for (int i = 0; i < tableSize; i++) {
+            volatile uint32_t* entry = g_msixTable + i * 4;
+            uint8_t irq = i == 0 ? MSI_IRQ : (uint8_t)(MSIX_IRQ_BASE + i - 1);
+            entry[MSIX_ENTRY_CTRL] = 1;
+            entry[MSIX_ENTRY_ADDR_LO] = MSI_ADDR_BASE | (bsp << 12);
+            entry[MSIX_ENTRY_ADDR_HI] = 0;
+            entry[MSIX_ENTRY_DATA] = Hal::IRQ_VECTOR_BASE + irq;
+            entry[MSIX_ENTRY_CTRL] = 0;
+            Hal::RegisterIrqHandler(irq, HandleInterrupt);
+        }
+
+        msgCtrl &= ~MSIX_CTRL_FMASK;
+        msgCtrl |= MSIX_CTRL_ENABLE;
+        Pci::LegacyWrite16(bus, dev, func, cap + 2, msgCtrl);
+
+        uint16_t pciCmd = Pci::LegacyRead16(bus, dev, func, (uint8_t)Pci::PCI_REG_COMMAND);
+        pciCmd |= Pci::PCI_CMD_INTX_DISABLE;
+        Pci::LegacyWrite16(bus, dev, func, (uint8_t)Pci::PCI_REG_COMMAND, pciCmd);
+
+        KernelLogStream(OK, "NVMe") << "MSI-X enabled: " << base::dec << (uint64_t)tableSize << " vectors";
+        return true;
     }
 
     // -------------------------------------------------------------------------
@@ -601,6 +927,12 @@ namespace Drivers::Storage::Nvme {
         uint32_t dstrd = (uint32_t)((cap & CAP_DSTRD_MASK) >> CAP_DSTRD_SHIFT);
         g_doorbellStride = 4u << dstrd;
 
+        // Map the rest of the doorbells if a wide stride pushes them out
+        uint64_t doorbellEnd = 0x1000 + (uint64_t)(2 * (MAX_IO_QUEUES + 1)) * g_doorbellStride;
+        for (uint64_t offset = MmioSize; offset < doorbellEnd; offset += 0x1000) {
+            Memory::VMM::g_paging->MapMMIO(mmioPhys + offset, Memory::HHDM(mmioPhys + offset));
+        }
+
         // Read version
         uint32_t vs = ReadReg32(REG_VS);
         uint32_t vsMajor = (vs >> 16) & 0xFFFF;
@@ -618,15 +950,18 @@ namespace Drivers::Storage::Nvme {
             return false;
         }
 
-        // Step 2: Set up MSI
-        bool hasMsi = SetupMsi(dev.Bus, dev.Device, dev.Function);
-        if (!hasMsi) {
+        // Step 2: Set up MSI-X (one vector per I/O queue), else MSI, else
+        // the legacy line
+        g_ioInterrupts = SetupMsix(dev.Bus, dev.Device, dev.Function) ||
+                         SetupMsi(dev.Bus, dev.Device, dev.Function);
+        if (!g_ioInterrupts) {
             uint8_t irqLine = Pci::LegacyRead8(dev.Bus, dev.Device, dev.Function,
                 (uint8_t)Pci::PCI_REG_INTERRUPT);
             if (irqLine != 0xFF) {
                 KernelLogStream(INFO, "NVMe") << "Using legacy IRQ " << base::dec << (uint64_t)irqLine;
                 Hal::RegisterIrqHandler(irqLine, HandleInterrupt);
                 Hal::IoApic::UnmaskIrq(Hal::IoApic::GetGsiForIrq(irqLine));
+                g_ioInterrupts = true;
             }
         }
 
@@ -668,6 +1003,7 @@ namespace Drivers::Storage::Nvme {
             bdev.Ctx = (void*)(uintptr_t)i;
             bdev.SectorCount = g_namespaces[i].SectorCount;
             bdev.SectorSize = (uint16_t)g_namespaces[i].SectorSize;
+            bdev.MaxTransfer = g_namespaces[i].MaxTransferBlocks;
             memcpy(bdev.Model, g_namespaces[i].Model, 41);
             Storage::RegisterBlockDevice(bdev);
         }
@@ -699,52 +1035,19 @@ namespace Drivers::Storage::Nvme {
         return &g_namespaces[ns];
     }
 
-    bool ReadSectors(int ns, uint64_t lba, uint32_t count, void* buffer) {
-        if (!g_initialized || ns < 0 || ns >= g_nsCount || !g_namespaces[ns].Active) {
-            return false;
-        }
-        if (count == 0 || buffer == nullptr) return false;
-
-        // Limit to max transfer size
-        uint32_t maxBlocks = g_namespaces[ns].MaxTransferBlocks;
-        if (count > maxBlocks) {
-            KernelLogStream(ERROR, "NVMe") << "ReadSectors: count " << count
-                << " exceeds max " << maxBlocks;
-            return false;
-        }
-
-        uint32_t sectorSize = g_namespaces[ns].SectorSize;
-        uint32_t totalBytes = count * sectorSize;
-        int pagesNeeded = (totalBytes + 0xFFF) / 0x1000;
+    // Read or write `count` sectors between `buffer` and namespace `ns`
+    // in one command. Kernel buffers and pinned user buffers are handed
+    // to the controller as they are, through PRP lists; anything else
+    // (unaligned, or user memory that cannot be pinned) goes through
+    // bounce pages.
+    static bool Transfer(int ns, bool write, uint64_t lba, uint32_t count, uint8_t* buffer) {
+        const NamespaceInfo& info = g_namespaces[ns];
+        uint32_t totalBytes = count * info.SectorSize;
+        uint64_t va = (uint64_t)buffer;
 
-        uint64_t dmaPhys;
-        void* dmaVirt = AllocateDmaBuffer(dmaPhys, pagesNeeded);
-
-        // Build NVMe Read command
         SqEntry cmd = {};
-        cmd.Opcode = IO_CMD_READ;
-        cmd.Nsid = g_namespaces[ns].Nsid;
-        cmd.Prp1 = dmaPhys;
-
-        // PRP2: If transfer spans more than one page, set PRP2
-        if (totalBytes > 0x1000) {
-            // For transfers spanning exactly 2 pages, PRP2 = second page address
-            // For transfers spanning more pages, PRP2 should point to a PRP list.
-            // Since our DMA buffer is physically contiguous, we can point to the
-            // second page directly for 2-page transfers. For larger transfers,
-            // we build a PRP list.
-            if (pagesNeeded == 2) {
-                cmd.Prp2 = dmaPhys + 0x1000;
-            } else {
-                // Build a PRP list (array of physical page addresses)
-                uint64_t prpListPhys;
-                uint64_t* prpList = (uint64_t*)AllocateDmaBuffer(prpListPhys);
-                for (int i = 1; i < pagesNeeded; i++) {
-                    prpList[i - 1] = dmaPhys + (uint64_t)i * 0x1000;
-                }
-                cmd.Prp2 = prpListPhys;
-            }
-        }
+        cmd.Opcode = write ? IO_CMD_WRITE : IO_CMD_READ;
+        cmd.Nsid = info.Nsid;
 
         // CDW10-11: Starting LBA (64-bit)
         cmd.Cdw10 = (uint32_t)(lba & 0xFFFFFFFF);
@@ -752,78 +1055,78 @@ namespace Drivers::Storage::Nvme {
         // CDW12: bits 15:0 = Number of Logical Blocks (0-based)
         cmd.Cdw12 = count - 1;
 
-        SubmitIoCommand(cmd);
-
-        CqEntry cqe;
-        bool ok = WaitIoCompletion(cqe);
-        if (ok) {
-            memcpy(buffer, dmaVirt, totalBytes);
+        Memory::Dma::Pin pin;
+        int pages = (int)(((va & 0xFFF) + totalBytes + 0xFFF) / 0x1000);
+        bool direct = (va & 3) == 0
+            && (va >= KernelSpaceStart || Memory::Dma::PinUser(buffer, totalBytes, !write, pin))
+            && BuildPrps(cmd, pages, [&](int i) {
+                uint64_t pageVa = i == 0 ? va : (va & ~0xFFFULL) + (uint64_t)i * 0x1000;
+                return Memory::Dma::Address((const void*)pageVa, pin);
+            }) == pages;
+
+        if (!direct) {
+            Memory::Dma::Unpin(pin);
+            FreePrpLists(cmd, pages);
+            cmd.Prp1 = cmd.Prp2 = 0;
+            pages = (int)((totalBytes + 0xFFF) / 0x1000);
+            int built = BuildPrps(cmd, pages, [](int) -> uint64_t {
+                void* page = Memory::g_pfa->Allocate();
+                return page ? Memory::SubHHDM(page) : 0;
+            });
+            if (built < pages) {
+                FreeBouncePages(cmd, pages, built);
+                FreePrpLists(cmd, pages);
+                return false;
+            }
+            if (write) CopyBounce(cmd, pages, buffer, totalBytes, true);
         }
 
-        // Free PRP list if we allocated one
-        if (pagesNeeded > 2 && cmd.Prp2 != 0 && cmd.Prp2 != dmaPhys + 0x1000) {
-            Memory::g_pfa->Free((void*)Memory::HHDM(cmd.Prp2));
-        }
+        IoResult result = RunIoCommand(cmd);
+
+        // The controller may still use the pages: leave them be, pinned
+        if (result == IoResult::TimedOut) return false;
 
-        Memory::g_pfa->Free(dmaVirt, pagesNeeded);
+        bool ok = result == IoResult::Ok;
+        if (!direct) {
+            if (ok && !write) CopyBounce(cmd, pages, buffer, totalBytes, false);
+            FreeBouncePages(cmd, pages, pages);
+        }
+        Memory::Dma::Unpin(pin);
+        FreePrpLists(cmd, pages);
         return ok;
     }
 
-    bool WriteSectors(int ns, uint64_t lba, uint32_t count, const void* buffer) {
+    bool ReadSectors(int ns, uint64_t lba, uint32_t count, void* buffer) {
         if (!g_initialized || ns < 0 || ns >= g_nsCount || !g_namespaces[ns].Active) {
             return false;
         }
         if (count == 0 || buffer == nullptr) return false;
 
+        // Limit to max transfer size
         uint32_t maxBlocks = g_namespaces[ns].MaxTransferBlocks;
         if (count > maxBlocks) {
-            KernelLogStream(ERROR, "NVMe") << "WriteSectors: count " << count
+            KernelLogStream(ERROR, "NVMe") << "ReadSectors: count " << count
                 << " exceeds max " << maxBlocks;
             return false;
         }
 
-        uint32_t sectorSize = g_namespaces[ns].SectorSize;
-        uint32_t totalBytes = count * sectorSize;
-        int pagesNeeded = (totalBytes + 0xFFF) / 0x1000;
-
-        uint64_t dmaPhys;
-        void* dmaVirt = AllocateDmaBuffer(dmaPhys, pagesNeeded);
-        memcpy(dmaVirt, buffer, totalBytes);
-
-        // Build NVMe Write command
-        SqEntry cmd = {};
-        cmd.Opcode = IO_CMD_WRITE;
-        cmd.Nsid = g_namespaces[ns].Nsid;
-        cmd.Prp1 = dmaPhys;
+        return Transfer(ns, false, lba, count, (uint8_t*)buffer);
+    }
 
-        if (totalBytes > 0x1000) {
-            if (pagesNeeded == 2) {
-                cmd.Prp2 = dmaPhys + 0x1000;
-            } else {
-                uint64_t prpListPhys;
-                uint64_t* prpList = (uint64_t*)AllocateDmaBuffer(prpListPhys);
-                for (int i = 1; i < pagesNeeded; i++) {
-                    prpList[i - 1] = dmaPhys + (uint64_t)i * 0x1000;
-                }
-                cmd.Prp2 = prpListPhys;
-            }
+    bool WriteSectors(int ns, uint64_t lba, uint32_t count, const void* buffer) {
+        if (!g_initialized || ns < 0 || ns >= g_nsCount || !g_namespaces[ns].Active) {
+            return false;
         }
+        if (count == 0 || buffer == nullptr) return false;
 
-        cmd.Cdw10 = (uint32_t)(lba & 0xFFFFFFFF);
-        cmd.Cdw11 = (uint32_t)(lba >> 32);
-        cmd.Cdw12 = count - 1;
-
-        SubmitIoCommand(cmd);
-
-        CqEntry cqe;
-        bool ok = WaitIoCompletion(cqe);
-
-        if (pagesNeeded > 2 && cmd.Prp2 != 0 && cmd.Prp2 != dmaPhys + 0x1000) {
-            Memory::g_pfa->Free((void*)Memory::HHDM(cmd.Prp2));
+        uint32_t maxBlocks = g_namespaces[ns].MaxTransferBlocks;
+        if (count > maxBlocks) {
+            KernelLogStream(ERROR, "NVMe") << "WriteSectors: count " << count
+                << " exceeds max " << maxBlocks;
+            return false;
         }
 
-        Memory::g_pfa->Free(dmaVirt, pagesNeeded);
-        return ok;
+        return Transfer(ns, true, lba, count, (uint8_t*)buffer);
     }
 
 };
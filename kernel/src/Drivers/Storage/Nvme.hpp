@@ -141,8 +141,10 @@ namespace Drivers::Storage::Nvme {
     // =========================================================================
 
     constexpr int ADMIN_QUEUE_DEPTH = 32;    // Admin queue entries
-    constexpr int IO_QUEUE_DEPTH    = 64;    // I/O queue entries
+    constexpr int IO_QUEUE_DEPTH    = 64;    // I/O queue entries (per queue pair)
+    constexpr int MAX_IO_QUEUES     = 16;    // I/O queue pairs, one per CPU
     constexpr int MAX_NAMESPACES    = 8;
+    constexpr uint32_t MAX_TRANSFER_BYTES = 0x400000;  // Largest command, if MDTS allows
 
     // =========================================================================
     // Namespace info
@@ -165,6 +167,19 @@ namespace Drivers::Storage::Nvme {
     constexpr uint32_t MSI_VECTOR    = 58;
     constexpr uint32_t MSI_ADDR_BASE = 0xFEE00000;
 
+    // With MSI-X, table entry 0 (admin queue) uses MSI_IRQ and entry
+    // n (I/O queue n) uses slot MSIX_IRQ_BASE + n - 1
+    constexpr uint8_t  MSIX_IRQ_BASE = 28;    // IRQ slots 28-43 = vectors 60-75
+
+    // MSI-X table entry layout (16 bytes each)
+    constexpr uint32_t MSIX_ENTRY_ADDR_LO = 0;
+    constexpr uint32_t MSIX_ENTRY_ADDR_HI = 1;
+    constexpr uint32_t MSIX_ENTRY_DATA    = 2;
+    constexpr uint32_t MSIX_ENTRY_CTRL    = 3;    // Bit 0 = masked
+    constexpr uint16_t MSIX_CTRL_ENABLE   = (1u << 15);
+    constexpr uint16_t MSIX_CTRL_FMASK    = (1u << 14);
+    constexpr uint16_t MSIX_TABLE_SIZE_MASK = 0x7FF;
+
     // =========================================================================
     // Public API
     // =========================================================================
@@ -179,9 +194,12 @@ namespace Drivers::Storage::Nvme {
     int GetNamespaceCount();
 
     // Read sectors from an NVMe namespace
-    // ns: namespace index, lba: starting LBA, count: sector count (max 128)
+    // ns: namespace index, lba: starting LBA, count: sector count (at most
+    // the namespace's MaxTransferBlocks)
     // buffer: destination buffer
-    // Returns true on success
+    // Returns true on success. Goes through the calling CPU's I/O queue
+    // and sleeps until the completion interrupt, so any number of callers
+    // can have commands in flight at once.
     bool ReadSectors(int ns, uint64_t lba, uint32_t count, void* buffer);
 
     // Write sectors to an NVMe namespace
@@ -78,6 +78,21 @@ namespace Drivers::USB::Bluetooth::A2dp {
     static uint16_t g_seqNum = 0;
     static uint32_t g_timestamp = 0;
 
+    // Media packets carry as many SBC frames as fit (the header's frame
+    // count is 4 bits). L2cap::SendData builds packets in a 1 KiB buffer.
+    constexpr uint32_t MEDIA_HEADER_LEN  = 13;
+    constexpr uint32_t MEDIA_MAX_FRAMES  = 15;
+    constexpr uint32_t MEDIA_MAX_PAYLOAD = 1020;
+
+    // Bitpool adaptation: every BITPOOL_WINDOW packets, back off if more
+    // than a quarter of them left a packet's worth of PCM still waiting,
+    // and creep back up after a window with none
+    constexpr uint32_t BITPOOL_WINDOW    = 32;
+    constexpr uint8_t  BITPOOL_STEP_DOWN = 4;
+    constexpr uint8_t  BITPOOL_STEP_UP   = 2;
+    static uint32_t g_windowPackets = 0;
+    static uint32_t g_windowBacklogged = 0;
+
     // Volume
     static int g_volume = 80;
 
@@ -378,6 +393,8 @@ namespace Drivers::USB::Bluetooth::A2dp {
         g_sbcInitialized = true;
         g_seqNum = 0;
         g_timestamp = 0;
+        g_windowPackets = 0;
+        g_windowBacklogged = 0;
 
         KernelLogStream(OK, "BT-A2DP") << "SBC encoder initialized: "
             << (uint64_t)sampleRate << "Hz " << (uint64_t)bitsPerSample << "-bit "
@@ -414,6 +431,38 @@ namespace Drivers::USB::Bluetooth::A2dp {
     // WriteAudio — encode PCM to SBC and stream over Bluetooth
     // =========================================================================
 
+    static uint32_t MediaPayloadLimit() {
+        uint32_t limit = MEDIA_MAX_PAYLOAD;
+        auto* ch = L2cap::GetChannel(g_mediaCid);
+        if (ch && ch->RemoteMtu && ch->RemoteMtu < limit) limit = ch->RemoteMtu;
+
+        // No ACL fragmentation: the L2CAP packet must fit one ACL packet
+        uint16_t aclMax = Hci::AclMaxLength();
+        if (aclMax > sizeof(L2cap::L2capHeader) && aclMax - sizeof(L2cap::L2capHeader) < limit) {
+            limit = aclMax - sizeof(L2cap::L2capHeader);
+        }
+        return limit;
+    }
+
+    static void AdaptBitpool(bool backlogged) {
+        g_windowPackets++;
+        if (backlogged) g_windowBacklogged++;
+        if (g_windowPackets < BITPOOL_WINDOW) return;
+
+        uint8_t bitpool = g_sbcEncoder.Bitpool;
+        if (g_windowBacklogged * 4 > g_windowPackets) {
+            bitpool = bitpool > Sbc::SBC_BITPOOL_MIN_ADAPT + BITPOOL_STEP_DOWN
+                ? bitpool - BITPOOL_STEP_DOWN : Sbc::SBC_BITPOOL_MIN_ADAPT;
+        } else if (g_windowBacklogged == 0) {
+            bitpool = bitpool + BITPOOL_STEP_UP < Sbc::SBC_BITPOOL
+                ? bitpool + BITPOOL_STEP_UP : Sbc::SBC_BITPOOL;
+        }
+        if (bitpool != g_sbcEncoder.Bitpool) Sbc::SetBitpool(&g_sbcEncoder, bitpool);
+
+        g_windowPackets = 0;
+        g_windowBacklogged = 0;
+    }
+
     int WriteAudio(const uint8_t* pcmData, uint32_t pcmLen) {
         if (!g_sbcInitialized || g_state != State::Streaming || g_mediaCid == 0) {
             return -1;
@@ -421,25 +470,27 @@ namespace Drivers::USB::Bluetooth::A2dp {
 
         uint32_t samplesPerFrame = Sbc::GetSamplesPerFrame(&g_sbcEncoder);
         uint32_t bytesPerFrame = samplesPerFrame * g_sbcEncoder.Channels * 2; // 16-bit samples
-        uint32_t sbcFrameSize = Sbc::GetFrameSize(&g_sbcEncoder);
 
         // Apply volume scaling to PCM data
         // We work on a local copy for volume adjustment
         int16_t scaledPcm[512];  // Max ~128 samples * 2 channels = 256 samples
         if (bytesPerFrame > sizeof(scaledPcm)) return -1;
 
+        uint32_t payloadLimit = MediaPayloadLimit();
         uint32_t consumed = 0;
 
         while (consumed + bytesPerFrame <= pcmLen) {
-            // Copy and scale by volume
-            const int16_t* src = (const int16_t*)(pcmData + consumed);
-            uint32_t numSamples = samplesPerFrame * g_sbcEncoder.Channels;
-            for (uint32_t i = 0; i < numSamples; i++) {
-                scaledPcm[i] = (int16_t)(((int32_t)src[i] * g_volume) / 100);
-            }
+            // There is one ACL transmit buffer: wait for the controller to
+            // finish with it. The caller keeps the rest and comes back.
+            if (Hci::AclPending() > 0) break;
+
+            uint32_t sbcFrameSize = Sbc::GetFrameSize(&g_sbcEncoder);
+            uint32_t maxFrames = (payloadLimit - MEDIA_HEADER_LEN) / sbcFrameSize;
+            if (maxFrames > MEDIA_MAX_FRAMES) maxFrames = MEDIA_MAX_FRAMES;
+            if (maxFrames == 0) return -1;
 
             // Build media packet: RTP-like header (12 bytes) + SBC payload header (1 byte) + SBC frames
-            uint8_t mediaPkt[256] = {};
+            uint8_t mediaPkt[MEDIA_MAX_PAYLOAD] = {};
 
             // Simplified media packet header (AVDTP media packet)
             // Byte 0: V=2, P=0, X=0, CC=0 -> 0x80
@@ -457,19 +508,32 @@ namespace Drivers::USB::Bluetooth::A2dp {
             mediaPkt[6] = (uint8_t)(g_timestamp >> 8);
             mediaPkt[7] = (uint8_t)(g_timestamp & 0xFF);
             mediaPkt[8] = 0; mediaPkt[9] = 0; mediaPkt[10] = 0; mediaPkt[11] = 0x01;  // SSRC
-            mediaPkt[12] = 1;  // Number of SBC frames in this packet
 
-            // Encode SBC frame
-            uint32_t encodedSize = Sbc::Encode(&g_sbcEncoder, scaledPcm, &mediaPkt[13]);
+            uint32_t totalLen = MEDIA_HEADER_LEN;
+            uint32_t frames = 0;
+            while (frames < maxFrames && consumed + bytesPerFrame <= pcmLen) {
+                // Copy and scale by volume
+                const int16_t* src = (const int16_t*)(pcmData + consumed);
+                uint32_t numSamples = samplesPerFrame * g_sbcEncoder.Channels;
+                for (uint32_t i = 0; i < numSamples; i++) {
+                    scaledPcm[i] = (int16_t)(((int32_t)src[i] * g_volume) / 100);
+                }
 
-            uint32_t totalLen = 13 + encodedSize;
+                totalLen += Sbc::Encode(&g_sbcEncoder, scaledPcm, &mediaPkt[totalLen]);
+                consumed += bytesPerFrame;
+                frames++;
+            }
+            mediaPkt[12] = (uint8_t)frames;  // Number of SBC frames in this packet
 
             // Send via L2CAP on media channel
             L2cap::SendData(g_mediaCid, mediaPkt, (uint16_t)totalLen);
 
             g_seqNum++;
-            g_timestamp += samplesPerFrame;
-            consumed += bytesPerFrame;
+            g_timestamp += frames * samplesPerFrame;
+
+            // Still a full packet of PCM waiting after this one: the link
+            // is not keeping up at this bitrate
+            AdaptBitpool(pcmLen - consumed >= maxFrames * bytesPerFrame);
         }
 
         return (int)consumed;
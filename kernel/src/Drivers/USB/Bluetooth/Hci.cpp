@@ -330,6 +330,14 @@ namespace Drivers::USB::Bluetooth::Hci {
         return true;
     }
 
+    uint16_t AclPending() {
+        return g_aclPendingCount;
+    }
+
+    uint16_t AclMaxLength() {
+        return g_aclMaxLen;
+    }
+
     // =========================================================================
     // ProcessEvent — handle HCI events
     // =========================================================================
@@ -180,6 +180,12 @@ namespace Drivers::USB::Bluetooth::Hci {
     // Send ACL data via USB bulk OUT
     bool SendAcl(uint16_t handle, uint16_t pbFlag, const uint8_t* data, uint16_t len);
 
+    // ACL packets handed to the controller and not yet completed
+    uint16_t AclPending();
+
+    // Largest ACL data payload the controller accepts (0 until read)
+    uint16_t AclMaxLength();
+
     // Process an HCI event received on the interrupt IN endpoint
     void ProcessEvent(const uint8_t* data, uint32_t len);
 
@@ -71,6 +71,16 @@ namespace Drivers::USB::Bluetooth::Sbc {
     // Init
     // =========================================================================
 
+    static void ComputeFrameSize(SbcEncoder* enc) {
+        // For joint stereo: 4 + (4 * subbands * channels) / 8 + ceil(blocks * bitpool / 8) + subbands/8
+        uint32_t headerBits = 32 + (4 * enc->Subbands * enc->Channels);
+        if (enc->ChannelMode == MODE_JOINT_STEREO) {
+            headerBits += enc->Subbands;  // join bits
+        }
+        uint32_t dataBits = enc->Blocks * enc->Bitpool;
+        enc->FrameSize = (headerBits + dataBits + 7) / 8;
+    }
+
     void Init(SbcEncoder* enc, uint32_t sampleRate, uint8_t channels, uint8_t /*bitsPerSample*/) {
         memset(enc, 0, sizeof(SbcEncoder));
 
@@ -95,56 +105,69 @@ namespace Drivers::USB::Bluetooth::Sbc {
         }
 
         enc->SamplesPerFrame = enc->Blocks * enc->Subbands;
+        ComputeFrameSize(enc);
+    }
 
-        // Calculate frame size
-        // For joint stereo: 4 + (4 * subbands * channels) / 8 + ceil(blocks * bitpool / 8) + subbands/8
-        uint32_t headerBits = 32 + (4 * enc->Subbands * enc->Channels);
-        if (enc->ChannelMode == MODE_JOINT_STEREO) {
-            headerBits += enc->Subbands;  // join bits
-        }
-        uint32_t dataBits = enc->Blocks * enc->Bitpool;
-        enc->FrameSize = (headerBits + dataBits + 7) / 8;
+    void SetBitpool(SbcEncoder* enc, uint8_t bitpool) {
+        if (bitpool < 2) bitpool = 2;
+        if (bitpool > SBC_BITPOOL) bitpool = SBC_BITPOOL;
+        enc->Bitpool = bitpool;
+        ComputeFrameSize(enc);
     }
 
     // =========================================================================
     // Analysis filter bank (8 subbands)
     // =========================================================================
 
+    // The kernel has no SSE, so the filter is kept cheap in plain integer
+    // code instead: no modulo in the tap loops (the doubled history makes
+    // every window contiguous) and 32-bit products, which cannot overflow
+    // for 16-bit input and these coefficient magnitudes.
     static void AnalysisFilter(SbcEncoder* enc, const int16_t* pcm, int ch,
                                int32_t sb_samples[SBC_BLOCKS][SBC_SUBBANDS]) {
+        constexpr int HISTORY = SBC_SUBBANDS * 10;
+        const int stride = enc->Channels;
+        int32_t* X = enc->X[ch];
+
         for (int blk = 0; blk < enc->Blocks; blk++) {
             // Shift in new samples
+            const int16_t* in = pcm + blk * SBC_SUBBANDS * stride + ch;
             int pos = enc->XPos[ch];
-            for (int i = enc->Subbands - 1; i >= 0; i--) {
-                pos = (pos + 1) % (enc->Subbands * 10);
-                enc->X[ch][pos] = (int32_t)pcm[blk * enc->Subbands * enc->Channels + i * enc->Channels + ch];
+            for (int i = SBC_SUBBANDS - 1; i >= 0; i--) {
+                pos = pos == HISTORY - 1 ? 0 : pos + 1;
+                X[pos] = X[pos + HISTORY] = in[i * stride];
             }
             enc->XPos[ch] = pos;
 
             // Windowing and partial calculation
+            const int32_t* win = X + pos;
             int32_t Z[2 * SBC_SUBBANDS];
-            for (int i = 0; i < 2 * enc->Subbands; i++) {
-                Z[i] = 0;
+            for (int i = 0; i < 2 * SBC_SUBBANDS; i++) {
+                int32_t z = 0;
                 for (int j = 0; j < 5; j++) {
-                    int idx = (pos + i + j * 2 * enc->Subbands) % (enc->Subbands * 10);
-                    int protoIdx = i + j * 2 * enc->Subbands;
-                    if (protoIdx < 80) {
-                        Z[i] += (int32_t)(((int64_t)enc->X[ch][idx] * g_proto8[protoIdx]) >> 15);
-                    }
+                    int k = i + j * 2 * SBC_SUBBANDS;
+                    z += (win[k] * g_proto8[k]) >> 15;
                 }
+                Z[i] = z;
             }
 
             // Matrixing (DCT)
-            for (int k = 0; k < enc->Subbands; k++) {
+            for (int k = 0; k < SBC_SUBBANDS; k++) {
+                const int32_t* row = g_cosMatrix8[k];
                 int32_t sum = 0;
-                for (int i = 0; i < 2 * enc->Subbands; i++) {
-                    sum += (int32_t)(((int64_t)Z[i] * g_cosMatrix8[k][i]) >> 15);
+                for (int i = 0; i < 2 * SBC_SUBBANDS; i++) {
+                    sum += (Z[i] * row[i]) >> 15;
                 }
                 sb_samples[blk][k] = sum;
             }
         }
     }
 
+    // Scale factor of a subband: bit length of its largest magnitude
+    static int32_t ScaleFactor(int32_t maxVal) {
+        return maxVal > 0 ? 32 - __builtin_clz((uint32_t)maxVal) : 0;
+    }
+
     // =========================================================================
     // Bit allocation (Loudness method)
     // =========================================================================
@@ -163,13 +186,7 @@ namespace Drivers::USB::Bluetooth::Sbc {
                 if (val > maxVal) maxVal = val;
             }
 
-            // Find scale factor (highest bit position)
-            scale_factors[sb] = 0;
-            int32_t tmp = maxVal;
-            while (tmp > 0) {
-                scale_factors[sb]++;
-                tmp >>= 1;
-            }
+            scale_factors[sb] = ScaleFactor(maxVal);
         }
 
         // Loudness offset table for 8 subbands (from SBC spec)
@@ -258,19 +275,29 @@ namespace Drivers::USB::Bluetooth::Sbc {
     // Bit packing helpers
     // =========================================================================
 
+    // Bits collect MSB-first in a 64-bit accumulator and go out a byte at
+    // a time; FlushBits writes the last partial byte.
     struct BitWriter {
         uint8_t* Data;
         uint32_t BitPos;
+        uint64_t Acc;
+        uint32_t AccBits;
     };
 
     static void WriteBits(BitWriter* bw, uint32_t value, uint8_t nbits) {
-        for (int i = nbits - 1; i >= 0; i--) {
-            uint32_t bytePos = bw->BitPos / 8;
-            uint8_t bitOff = 7 - (bw->BitPos % 8);
-            if (value & (1u << i)) {
-                bw->Data[bytePos] |= (1u << bitOff);
-            }
-            bw->BitPos++;
+        bw->Acc = (bw->Acc << nbits) | (value & ((1u << nbits) - 1));
+        bw->AccBits += nbits;
+        bw->BitPos += nbits;
+        while (bw->AccBits >= 8) {
+            bw->AccBits -= 8;
+            *bw->Data++ = (uint8_t)(bw->Acc >> bw->AccBits);
+        }
+    }
+
+    static void FlushBits(BitWriter* bw) {
+        if (bw->AccBits > 0) {
+            *bw->Data++ = (uint8_t)(bw->Acc << (8 - bw->AccBits));
+            bw->AccBits = 0;
         }
     }
 
@@ -329,9 +356,7 @@ namespace Drivers::USB::Bluetooth::Sbc {
                             if (val < 0) val = -val;
                             if (val > maxVal) maxVal = val;
                         }
-                        scale_factors[ch][sb] = 0;
-                        int32_t tmp = maxVal;
-                        while (tmp > 0) { scale_factors[ch][sb]++; tmp >>= 1; }
+                        scale_factors[ch][sb] = ScaleFactor(maxVal);
                     }
                 }
             }
@@ -346,7 +371,7 @@ namespace Drivers::USB::Bluetooth::Sbc {
         // CRC (computed over header bytes 1-2 and scale factors)
         // Will be filled after scale factors are packed
 
-        BitWriter bw = {out, 32};  // Start after 4-byte header
+        BitWriter bw = {out + 4, 32, 0, 0};  // Start after 4-byte header
 
         // Joint stereo flags
         if (enc->ChannelMode == MODE_JOINT_STEREO) {
@@ -362,10 +387,21 @@ namespace Drivers::USB::Bluetooth::Sbc {
             }
         }
 
+        // The CRC covers the scale factors: get the partial byte out first
+        // (later bits are ORed in below it, so restart the accumulator there)
+        uint32_t sfBits = bw.AccBits;
+        uint64_t sfAcc = bw.Acc;
+        FlushBits(&bw);
+
         // Compute CRC (over bytes 1, 2, and scale factor bits)
         uint32_t crcBits = 16 + (enc->Channels * enc->Subbands * 4);
         if (enc->ChannelMode == MODE_JOINT_STEREO) crcBits += enc->Subbands;
         out[3] = SbcCrc8(&out[1], (crcBits + 7) / 8, crcBits % 8 ? crcBits % 8 : 8);
+        if (sfBits > 0) {
+            bw.Data--;
+            bw.Acc = sfAcc;
+            bw.AccBits = sfBits;
+        }
 
         // Pack audio samples
         for (int blk = 0; blk < enc->Blocks; blk++) {
@@ -376,14 +412,15 @@ namespace Drivers::USB::Bluetooth::Sbc {
                     int32_t sf = scale_factors[ch][sb];
                     int32_t sample = sb_samples[ch][blk][sb];
 
-                    // Quantize: levels = (1 << bits) - 1
+                    // Quantize: levels = (1 << bits) - 1. |sample| < 2^sf, so
+                    // the numerator is positive and the division by the
+                    // power of two 2^(sf + 1) is a shift.
                     uint32_t levels = (1u << bits[ch][sb]) - 1;
                     int32_t quantized;
 
                     if (sf > 0) {
-                        // Normalize and quantize
                         int32_t maxRange = (1 << sf);
-                        quantized = (int32_t)(((int64_t)(sample + maxRange) * levels) / (2 * maxRange));
+                        quantized = (int32_t)(((int64_t)(sample + maxRange) * levels) >> (sf + 1));
                     } else {
                         quantized = levels / 2;
                     }
@@ -397,6 +434,7 @@ namespace Drivers::USB::Bluetooth::Sbc {
         }
 
         // Pad to byte boundary
+        FlushBits(&bw);
         uint32_t totalBytes = (bw.BitPos + 7) / 8;
         return totalBytes > enc->FrameSize ? enc->FrameSize : totalBytes;
     }
@@ -18,7 +18,8 @@ namespace Drivers::USB::Bluetooth::Sbc {
     constexpr int SBC_SUBBANDS   = 8;
     constexpr int SBC_BLOCKS     = 16;
     constexpr int SBC_CHANNELS   = 2;    // Stereo
-    constexpr int SBC_BITPOOL    = 53;   // Standard quality
+    constexpr int SBC_BITPOOL    = 53;   // Standard quality (the most we offer)
+    constexpr int SBC_BITPOOL_MIN_ADAPT = 19;  // Floor when backing off for a busy link
 
     // Allocation method
     constexpr uint8_t ALLOC_SNR    = 0;
@@ -57,8 +58,10 @@ namespace Drivers::USB::Bluetooth::Sbc {
         uint8_t  Bitpool;
         uint8_t  Channels;
 
-        // Analysis filter state (per-channel windowed buffer)
-        int32_t  X[SBC_CHANNELS][SBC_SUBBANDS * 10];
+        // Analysis filter state (per-channel windowed buffer). Each sample
+        // is stored twice, at XPos and XPos + 80, so the 80-tap window is
+        // always a contiguous run starting at XPos.
+        int32_t  X[SBC_CHANNELS][SBC_SUBBANDS * 20];
         int      XPos[SBC_CHANNELS];
 
         // Computed frame size in bytes
@@ -81,6 +84,10 @@ namespace Drivers::USB::Bluetooth::Sbc {
     // Returns number of bytes written to out
     uint32_t Encode(SbcEncoder* enc, const int16_t* pcm, uint8_t* out);
 
+    // Change the bitpool for the following frames (the frame size changes
+    // with it). Clamped to 2..SBC_BITPOOL.
+    void SetBitpool(SbcEncoder* enc, uint8_t bitpool);
+
     // Get the frame size in bytes for the current configuration
     uint32_t GetFrameSize(const SbcEncoder* enc);
 
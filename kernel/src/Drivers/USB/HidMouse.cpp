@@ -223,22 +223,14 @@ namespace Drivers::USB::HidMouse {
         int32_t rawX = ExtractSigned(data, byteOffset + g_Format.xBitOffset, g_Format.xBitSize);
         int32_t rawY = ExtractSigned(data, byteOffset + g_Format.yBitOffset, g_Format.yBitSize);
 
-        // Clamp to int8_t range for InjectMouseReport
-        if (rawX > 127) rawX = 127;
-        if (rawX < -128) rawX = -128;
-        if (rawY > 127) rawY = 127;
-        if (rawY < -128) rawY = -128;
-
-        // Extract scroll wheel
-        int8_t scroll = 0;
+        // Extract scroll wheel. 16-bit axes pass through whole: a fast
+        // flick is not clipped to the boot protocol's byte range.
+        int32_t scroll = 0;
         if (g_Format.scrollBitSize > 0) {
-            int32_t rawScroll = ExtractSigned(data, byteOffset + g_Format.scrollBitOffset, g_Format.scrollBitSize);
-            if (rawScroll > 127) rawScroll = 127;
-            if (rawScroll < -128) rawScroll = -128;
-            scroll = (int8_t)rawScroll;
+            scroll = ExtractSigned(data, byteOffset + g_Format.scrollBitOffset, g_Format.scrollBitSize);
         }
 
-        Drivers::PS2::Mouse::InjectMouseReport(buttons, (int8_t)rawX, (int8_t)rawY, scroll);
+        Drivers::PS2::Mouse::InjectMouseReport(buttons, rawX, rawY, scroll);
     }
 
 }
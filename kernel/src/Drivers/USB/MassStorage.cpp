@@ -0,0 +1,634 @@
+/*
+    * MassStorage.cpp
+    * USB mass storage class driver (Bulk-Only Transport, SCSI)
+    * Copyright (c) 2026 Daniel Hammer
+*/
+
+#include "MassStorage.hpp"
+#include "UsbDevice.hpp"
+#include "Xhci.hpp"
+#include <Drivers/Storage/BlockDevice.hpp>
+#include <Terminal/Terminal.hpp>
+#include <CppLib/Stream.hpp>
+#include <CppLib/Spinlock.hpp>
+#include <Memory/HHDM.hpp>
+#include <Memory/Paging.hpp>
+#include <Memory/PageFrameAllocator.hpp>
+#include <Memory/Dma.hpp>
+#include <Libraries/Memory.hpp>
+#include <Sched/Scheduler.hpp>
+#include <Timekeeping/ApicTimer.hpp>
+
+using namespace Kt;
+
+static void BusyWaitMs(uint64_t ms) {
+    uint64_t flags;
+    asm volatile("pushfq; pop %0" : "=r"(flags));
+    if (flags & (1 << 9)) {
+        uint64_t start = Timekeeping::GetMilliseconds();
+        while (Timekeeping::GetMilliseconds() - start < ms) {
+            asm volatile("pause" ::: "memory");
+        }
+    } else {
+        // Interrupts disabled (hot-plug from the timer tick): ~1us per outb
+        for (uint64_t i = 0; i < ms * 1000; i++) {
+            asm volatile("outb %%al, $0x80" ::: "memory");
+        }
+    }
+}
+
+namespace Drivers::USB::MassStorage {
+
+    // -------------------------------------------------------------------------
+    // Bulk-Only Transport
+    // -------------------------------------------------------------------------
+
+    struct CommandBlockWrapper {
+        uint32_t Signature;
+        uint32_t Tag;
+        uint32_t DataLength;
+        uint8_t  Flags;
+        uint8_t  Lun;
+        uint8_t  CbLength;
+        uint8_t  Cb[16];
+    } __attribute__((packed));
+
+    struct CommandStatusWrapper {
+        uint32_t Signature;
+        uint32_t Tag;
+        uint32_t Residue;
+        uint8_t  Status;
+    } __attribute__((packed));
+
+    constexpr uint32_t CBW_SIGNATURE   = 0x43425355;
+    constexpr uint32_t CSW_SIGNATURE   = 0x53425355;
+    constexpr uint8_t  CBW_DATA_IN     = 0x80;
+    constexpr uint8_t  CSW_PASSED      = 0;
+    constexpr uint8_t  CSW_FAILED      = 1;
+    constexpr uint8_t  CSW_PHASE_ERROR = 2;
+
+    // Class requests
+    constexpr uint8_t REQ_BOT_RESET          = 0xFF;
+    constexpr uint8_t REQ_GET_MAX_LUN        = 0xFE;
+    constexpr uint8_t REQTYPE_CLASS_IFACE_IN = 0xA1;
+
+    // SCSI commands
+    constexpr uint8_t SCSI_TEST_UNIT_READY  = 0x00;
+    constexpr uint8_t SCSI_REQUEST_SENSE    = 0x03;
+    constexpr uint8_t SCSI_INQUIRY          = 0x12;
+    constexpr uint8_t SCSI_READ_CAPACITY_10 = 0x25;
+    constexpr uint8_t SCSI_READ_10          = 0x28;
+    constexpr uint8_t SCSI_WRITE_10         = 0x2A;
+    constexpr uint8_t SCSI_READ_16          = 0x88;
+    constexpr uint8_t SCSI_WRITE_16         = 0x8A;
+    constexpr uint8_t SCSI_SERVICE_ACTION_IN = 0x9E;
+    constexpr uint8_t SA_READ_CAPACITY_16   = 0x10;
+
+    constexpr uint8_t PERIPHERAL_DIRECT_ACCESS = 0x00;
+
+    // Spin-up and slow flash can take seconds per command
+    static constexpr uint64_t CMD_TIMEOUT_MS = 10000;
+
+    static constexpr uint64_t KernelSpaceStart = 0xFFFF800000000000ULL;
+    static constexpr uint32_t BOUNCE_PAGES = MAX_TRANSFER_BYTES / 0x1000;
+    static constexpr uint32_t MAX_SEGMENTS = BOUNCE_PAGES + 1;
+
+    // Layout of an adapter's DMA page
+    static constexpr uint32_t DMA_CBW  = 0;
+    static constexpr uint32_t DMA_CSW  = 64;
+    static constexpr uint32_t DMA_DATA = 128;   // small command data (inquiry, sense, capacity)
+
+    // CBW, data and CSW of one command, queued together so the phases
+    // run back to back without a round trip through the driver
+    struct Command {
+        Xhci::Urb         Cbw;
+        Xhci::Urb         Data;
+        Xhci::Urb         Csw;
+        Xhci::UrbSegment  CbwSeg;
+        Xhci::UrbSegment  CswSeg;
+        Xhci::UrbSegment  DataSegs[MAX_SEGMENTS];
+        volatile uint32_t Pending;    // URBs not completed yet
+        volatile uint32_t Signal;     // futex word: all completed, or one failed
+    };
+
+    struct Adapter {
+        bool       Active;
+        uint8_t    SlotId;
+        uint8_t    Interface;
+        uint8_t    BulkIn;            // endpoint addresses
+        uint8_t    BulkOut;
+        uint32_t   Tag;
+        uint8_t*   Dma;
+        uint64_t   DmaPhys;
+        uint8_t*   Bounce;            // for buffers outside kernel memory
+        uint64_t   BouncePhys;
+        Command    Cmd;
+        kcp::Mutex Lock;              // one command at a time on the pipes
+    };
+
+    struct Lun {
+        Adapter* Owner;
+        uint8_t  Number;
+        uint32_t BlockSize;
+        uint64_t Blocks;
+    };
+
+    static Adapter  g_adapters[MAX_ADAPTERS];
+    static Lun      g_luns[MAX_ADAPTERS * MAX_LUNS] = {};
+    static uint32_t g_lunCount = 0;
+
+    // -------------------------------------------------------------------------
+    // URB plumbing
+    // -------------------------------------------------------------------------
+
+    static void UrbDone(Xhci::Urb* urb) {
+        auto* cmd = (Command*)urb->Context;
+        bool ok = urb->Status == Xhci::CC_SUCCESS || urb->Status == Xhci::CC_SHORT_PACKET;
+        uint32_t left = __atomic_sub_fetch(&cmd->Pending, 1, __ATOMIC_ACQ_REL);
+        if (left == 0 || !ok) {
+            cmd->Signal = 1;
+            Sched::WakeAddress(&cmd->Signal, 1);
+        }
+    }
+
+    static void InitUrb(Xhci::Urb& urb, Adapter& a, uint8_t ep,
+                        const Xhci::UrbSegment* segs, uint32_t count) {
+        urb = {};
+        urb.SlotId       = a.SlotId;
+        urb.EpDci        = UsbDevice::EndpointDci(ep);
+        urb.Segments     = segs;
+        urb.SegmentCount = count;
+        urb.Complete     = UrbDone;
+        urb.Context      = &a.Cmd;
+    }
+
+    // Completion code of a URB; 0 while it is still queued
+    static uint32_t UrbStatus(const Xhci::Urb& urb) {
+        return __atomic_load_n(&urb.Status, __ATOMIC_ACQUIRE);
+    }
+
+    static bool UrbFailed(const Xhci::Urb& urb) {
+        uint32_t cc = UrbStatus(urb);
+        return cc != 0 && cc != Xhci::CC_SUCCESS && cc != Xhci::CC_SHORT_PACKET;
+    }
+
+    // Wait until every queued URB of the command has completed, or (with
+    // `stopOnError`) one has failed. Returns false on timeout.
+    static bool WaitUrbs(Command& cmd, bool stopOnError) {
+        while (cmd.Pending != 0) {
+            cmd.Signal = 0;
+            if (cmd.Pending == 0) break;
+            if (stopOnError &&
+                (UrbFailed(cmd.Cbw) || UrbFailed(cmd.Data) || UrbFailed(cmd.Csw))) {
+                return true;
+            }
+            if (!Xhci::WaitCompletion(&cmd.Signal, CMD_TIMEOUT_MS)) return false;
+        }
+        return true;
+    }
+
+    // Submit the URBs in order; the ones that did not make it come off
+    // Pending. Returns how many were queued.
+    static uint32_t SubmitAll(Command& cmd, Xhci::Urb* const* urbs, uint32_t count) {
+        cmd.Signal = 0;
+        cmd.Pending = count;
+        uint32_t queued = 0;
+        while (queued < count && Xhci::SubmitUrb(urbs[queued])) {
+            queued++;
+        }
+        if (queued < count) {
+            __atomic_sub_fetch(&cmd.Pending, count - queued, __ATOMIC_ACQ_REL);
+        }
+        return queued;
+    }
+
+    // Bulk-Only reset recovery: class reset, then clear both halts, which
+    // also cancels whatever was still queued. An adapter whose URBs do not
+    // all come back is retired, since the controller may still own them.
+    static void ResetRecovery(Adapter& a) {
+        KernelLogStream(WARNING, "USB-MS") << "Slot " << base::dec << (uint64_t)a.SlotId
+            << ": reset recovery";
+
+        Xhci::ControlTransfer(a.SlotId, UsbDevice::REQTYPE_CLASS_IFACE, REQ_BOT_RESET,
+                              0, a.Interface, 0, nullptr, false);
+        UsbDevice::ResetEndpoint(a.SlotId, a.BulkIn);
+        UsbDevice::ResetEndpoint(a.SlotId, a.BulkOut);
+
+        if (!WaitUrbs(a.Cmd, false)) {
+            KernelLogStream(ERROR, "USB-MS") << "Slot " << base::dec << (uint64_t)a.SlotId
+                << ": transfers stuck, adapter disabled";
+            a.Active = false;
+        }
+    }
+
+    // Run one SCSI command. The data phase, if any, is `length` bytes over
+    // a.Cmd.DataSegs[0..segCount). Returns the CSW status, or -1 if the
+    // transport failed; `actual` gets the bytes moved.
+    static int Transport(Adapter& a, uint8_t lun, const uint8_t* cdb, uint8_t cdbLen,
+                         bool dirIn, uint32_t segCount, uint32_t length, uint32_t& actual) {
+        Command& cmd = a.Cmd;
+        actual = 0;
+        if (!a.Active) return -1;
+
+        auto* cbw = (CommandBlockWrapper*)(a.Dma + DMA_CBW);
+        memset(cbw, 0, sizeof(CommandBlockWrapper));
+        cbw->Signature  = CBW_SIGNATURE;
+        cbw->Tag        = ++a.Tag;
+        cbw->DataLength = length;
+        cbw->Flags      = dirIn ? CBW_DATA_IN : 0;
+        cbw->Lun        = lun;
+        cbw->CbLength   = cdbLen;
+        memcpy(cbw->Cb, cdb, cdbLen);
+
+        auto* csw = (CommandStatusWrapper*)(a.Dma + DMA_CSW);
+        memset(csw, 0, sizeof(CommandStatusWrapper));
+
+        cmd.CbwSeg = { a.DmaPhys + DMA_CBW, sizeof(CommandBlockWrapper) };
+        cmd.CswSeg = { a.DmaPhys + DMA_CSW, sizeof(CommandStatusWrapper) };
+        uint8_t dataEp = dirIn ? a.BulkIn : a.BulkOut;
+        InitUrb(cmd.Cbw, a, a.BulkOut, &cmd.CbwSeg, 1);
+        InitUrb(cmd.Data, a, dataEp, cmd.DataSegs, segCount);
+        InitUrb(cmd.Csw, a, a.BulkIn, &cmd.CswSeg, 1);
+
+        Xhci::Urb* urbs[3];
+        uint32_t count = 0;
+        urbs[count++] = &cmd.Cbw;
+        if (length > 0) urbs[count++] = &cmd.Data;
+        urbs[count++] = &cmd.Csw;
+
+        uint32_t queued = SubmitAll(cmd, urbs, count);
+        if (queued == 0) return -1;
+        if (queued < count) {
+            ResetRecovery(a);
+            return -1;
+        }
+
+        if (!WaitUrbs(cmd, true) || UrbFailed(cmd.Cbw)) {
+            ResetRecovery(a);
+            return -1;
+        }
+
+        // A stalled data phase ends early; clear the halt and the CSW follows
+        if (length > 0 && UrbFailed(cmd.Data)) {
+            if (UrbStatus(cmd.Data) != Xhci::CC_STALL) {
+                ResetRecovery(a);
+                return -1;
+            }
+            UsbDevice::ResetEndpoint(a.SlotId, dataEp);
+        }
+
+        if (!WaitUrbs(cmd, false)) {
+            ResetRecovery(a);
+            return -1;
+        }
+
+        // The CSW was cancelled by clearing the IN halt, or stalled itself:
+        // read it (once more)
+        if (UrbStatus(cmd.Csw) != Xhci::CC_SUCCESS) {
+            if (UrbStatus(cmd.Csw) == Xhci::CC_STALL) {
+                UsbDevice::ResetEndpoint(a.SlotId, a.BulkIn);
+            }
+            InitUrb(cmd.Csw, a, a.BulkIn, &cmd.CswSeg, 1);
+            Xhci::Urb* retry = &cmd.Csw;
+            if (SubmitAll(cmd, &retry, 1) != 1 || !WaitUrbs(cmd, false) ||
+                UrbStatus(cmd.Csw) != Xhci::CC_SUCCESS) {
+                ResetRecovery(a);
+                return -1;
+            }
+        }
+
+        if (cmd.Csw.Actual != sizeof(CommandStatusWrapper) ||
+            csw->Signature != CSW_SIGNATURE || csw->Tag != cbw->Tag ||
+            csw->Status == CSW_PHASE_ERROR) {
+            ResetRecovery(a);
+            return -1;
+        }
+
+        if (length > 0) {
+            actual = cmd.Data.Actual;
+            if (csw->Residue <= length && actual > length - csw->Residue) {
+                actual = length - csw->Residue;
+            }
+        }
+        return csw->Status;
+    }
+
+    // Command with a small data-in phase into the DMA page
+    static int SmallIn(Adapter& a, uint8_t lun, const uint8_t* cdb, uint8_t cdbLen,
+                       uint32_t length, uint32_t& actual) {
+        memset(a.Dma + DMA_DATA, 0, length);
+        a.Cmd.DataSegs[0] = { a.DmaPhys + DMA_DATA, length };
+        return Transport(a, lun, cdb, cdbLen, true, 1, length, actual);
+    }
+
+    // -------------------------------------------------------------------------
+    // SCSI
+    // -------------------------------------------------------------------------
+
+    // REQUEST SENSE, which also clears a pending unit attention. Returns
+    // the sense key, or -1.
+    static int RequestSense(Adapter& a, uint8_t lun) {
+        uint8_t cdb[6] = { SCSI_REQUEST_SENSE, 0, 0, 0, 18, 0 };
+        uint32_t actual;
+        if (SmallIn(a, lun, cdb, 6, 18, actual) != CSW_PASSED || actual < 3) return -1;
+        return a.Dma[DMA_DATA + 2] & 0x0F;
+    }
+
+    static bool TestUnitReady(Adapter& a, uint8_t lun) {
+        uint8_t cdb[6] = { SCSI_TEST_UNIT_READY, 0, 0, 0, 0, 0 };
+        uint32_t actual;
+        for (int attempt = 0; attempt < 20; attempt++) {
+            int status = Transport(a, lun, cdb, 6, false, 0, 0, actual);
+            if (status == CSW_PASSED) return true;
+            if (status < 0) return false;
+            RequestSense(a, lun);
+            BusyWaitMs(100);
+        }
+        return false;
+    }
+
+    static bool ReadCapacity(Adapter& a, Lun& l) {
+        uint32_t actual;
+        uint8_t cdb10[10] = { SCSI_READ_CAPACITY_10 };
+        if (SmallIn(a, l.Number, cdb10, 10, 8, actual) != CSW_PASSED || actual < 8) return false;
+
+        const uint8_t* d = a.Dma + DMA_DATA;
+        uint32_t lastLba = ((uint32_t)d[0] << 24) | ((uint32_t)d[1] << 16)
+                         | ((uint32_t)d[2] << 8) | d[3];
+        l.BlockSize = ((uint32_t)d[4] << 24) | ((uint32_t)d[5] << 16)
+                    | ((uint32_t)d[6] << 8) | d[7];
+        l.Blocks = (uint64_t)lastLba + 1;
+
+        if (lastLba == 0xFFFFFFFF) {
+            // Over 2 TiB of 512-byte blocks: READ CAPACITY(16)
+            uint8_t cdb16[16] = { SCSI_SERVICE_ACTION_IN, SA_READ_CAPACITY_16 };
+            cdb16[13] = 32;
+            if (SmallIn(a, l.Number, cdb16, 16, 32, actual) != CSW_PASSED || actual < 12) return false;
+            uint64_t last = 0;
+            for (int i = 0; i < 8; i++) last = (last << 8) | d[i];
+            l.Blocks = last + 1;
+            l.BlockSize = ((uint32_t)d[8] << 24) | ((uint32_t)d[9] << 16)
+                        | ((uint32_t)d[10] << 8) | d[11];
+        }
+
+        return l.BlockSize >= 512 && l.BlockSize <= 4096 && l.Blocks > 0;
+    }
+
+    // Describe `buffer` as the data segments, merging physically adjacent
+    // pages. Kernel memory and user memory that can be pinned go to the
+    // device as they are (pinned by `pin`, which a retry reuses); anything
+    // else through the bounce buffer.
+    static uint32_t MapBuffer(Adapter& a, void* buffer, uint32_t length, bool write,
+                              Memory::Dma::Pin& pin, bool& bounced) {
+        Xhci::UrbSegment* segs = a.Cmd.DataSegs;
+        uint64_t va = (uint64_t)buffer;
+        bounced = false;
+
+        uint32_t count = 0;
+        if (va >= KernelSpaceStart || pin.leaderSlot >= 0 || Memory::Dma::PinUser(buffer, length, !write, pin)) {
+            uint32_t done = 0;
+            while (done < length) {
+                uint64_t phys = Memory::Dma::Address((const void*)(va + done), pin);
+                if (phys == 0) break;
+                uint32_t chunk = 0x1000 - (uint32_t)((va + done) & 0xFFF);
+                if (chunk > length - done) chunk = length - done;
+
+                if (count > 0 && segs[count - 1].Phys + segs[count - 1].Length == phys) {
+                    segs[count - 1].Length += chunk;
+                } else if (count < MAX_SEGMENTS) {
+                    segs[count++] = { phys, chunk };
+                } else {
+                    break;
+                }
+                done += chunk;
+            }
+            if (done == length) return count;
+            Memory::Dma::Unpin(pin);
+        }
+
+        bounced = true;
+        segs[0] = { a.BouncePhys, length };
+        return 1;
+    }
+
+    static bool Io(Lun& l, bool write, uint64_t lba, uint32_t count, void* buffer) {
+        Adapter& a = *l.Owner;
+        uint64_t bytes64 = (uint64_t)count * l.BlockSize;
+        if (count == 0 || buffer == nullptr || bytes64 > MAX_TRANSFER_BYTES) return false;
+        if (lba + count > l.Blocks) return false;
+        uint32_t bytes = (uint32_t)bytes64;
+
+        uint8_t cdb[16] = {};
+        uint8_t cdbLen;
+        if (lba + count > 0xFFFFFFFFULL) {
+            cdb[0] = write ? SCSI_WRITE_16 : SCSI_READ_16;
+            for (int i = 0; i < 8; i++) cdb[2 + i] = (uint8_t)(lba >> (56 - 8 * i));
+            for (int i = 0; i < 4; i++) cdb[10 + i] = (uint8_t)(count >> (24 - 8 * i));
+            cdbLen = 16;
+        } else {
+            cdb[0] = write ? SCSI_WRITE_10 : SCSI_READ_10;
+            for (int i = 0; i < 4; i++) cdb[2 + i] = (uint8_t)(lba >> (24 - 8 * i));
+            cdb[7] = (uint8_t)(count >> 8);
+            cdb[8] = (uint8_t)count;
+            cdbLen = 10;
+        }
+
+        a.Lock.Acquire();
+        bool ok = false;
+        if (a.Active) {
+            bool bounced;
+            Memory::Dma::Pin pin;
+            uint32_t segCount = MapBuffer(a, buffer, bytes, write, pin, bounced);
+            if (bounced && write) memcpy(a.Bounce, buffer, bytes);
+
+            // One retry, after REQUEST SENSE clears a unit attention
+            for (int attempt = 0; attempt < 2 && !ok; attempt++) {
+                if (attempt > 0) segCount = MapBuffer(a, buffer, bytes, write, pin, bounced);
+                uint32_t actual;
+                int status = Transport(a, l.Number, cdb, cdbLen, !write, segCount, bytes, actual);
+                if (status == CSW_PASSED && actual == bytes) {
+                    ok = true;
+                } else if (status == CSW_FAILED) {
+                    RequestSense(a, l.Number);
+                } else {
+                    break;
+                }
+            }
+
+            if (ok && bounced && !write) memcpy(buffer, a.Bounce, bytes);
+            Memory::Dma::Unpin(pin);
+        }
+        a.Lock.Release();
+        return ok;
+    }
+
+    // -------------------------------------------------------------------------
+    // Registration
+    // -------------------------------------------------------------------------
+
+    // Copy `len` bytes of space-padded SCSI ASCII, dropping trailing spaces
+    static int CopyTrimmed(char* dst, const uint8_t* src, int len) {
+        while (len > 0 && (src[len - 1] == ' ' || src[len - 1] == 0)) len--;
+        for (int i = 0; i < len; i++) {
+            dst[i] = (src[i] >= 0x20 && src[i] < 0x7F) ? (char)src[i] : '?';
+        }
+        return len;
+    }
+
+    static bool RegisterLun(Adapter& a, uint8_t number) {
+        if (g_lunCount >= MAX_ADAPTERS * MAX_LUNS) return false;
+        Lun& l = g_luns[g_lunCount];
+        l = {};
+        l.Owner  = &a;
+        l.Number = number;
+
+        uint8_t inquiry[6] = { SCSI_INQUIRY, 0, 0, 0, 36, 0 };
+        uint32_t actual;
+        if (SmallIn(a, number, inquiry, 6, 36, actual) != CSW_PASSED || actual < 32) return false;
+
+        uint8_t id[36];
+        memcpy(id, a.Dma + DMA_DATA, sizeof(id));
+        if ((id[0] & 0x1F) != PERIPHERAL_DIRECT_ACCESS || (id[0] >> 5) != 0) return false;
+
+        if (!TestUnitReady(a, number)) {
+            KernelLogStream(WARNING, "USB-MS") << "Slot " << base::dec << (uint64_t)a.SlotId
+                << " LUN " << (uint64_t)number << ": not ready (no medium?)";
+            return false;
+        }
+        if (!ReadCapacity(a, l)) {
+            KernelLogStream(WARNING, "USB-MS") << "Slot " << base::dec << (uint64_t)a.SlotId
+                << " LUN " << (uint64_t)number << ": READ CAPACITY failed";
+            return false;
+        }
+
+        Storage::BlockDevice bdev = {};
+        bdev.ReadSectors = [](void* ctx, uint64_t lba, uint32_t count, void* buffer) -> bool {
+            return Io(*(Lun*)ctx, false, lba, count, buffer);
+        };
+        bdev.WriteSectors = [](void* ctx, uint64_t lba, uint32_t count, const void* buffer) -> bool {
+            return Io(*(Lun*)ctx, true, lba, count, (void*)buffer);
+        };
+        bdev.Ctx = &l;
+        bdev.SectorCount = l.Blocks;
+        bdev.SectorSize = (uint16_t)l.BlockSize;
+        bdev.MaxTransfer = MAX_TRANSFER_BYTES / l.BlockSize;
+
+        // "Vendor Product", from the INQUIRY identification fields
+        int n = CopyTrimmed(bdev.Model, &id[8], 8);
+        if (n > 0) bdev.Model[n++] = ' ';
+        n += CopyTrimmed(bdev.Model + n, &id[16], 16);
+        bdev.Model[n] = '\0';
+
+        int index = Storage::RegisterBlockDevice(bdev);
+        if (index < 0) return false;
+        g_lunCount++;
+
+        KernelLogStream(OK, "USB-MS") << "Slot " << base::dec << (uint64_t)a.SlotId
+            << " LUN " << (uint64_t)number << ": " << bdev.Model << ", "
+            << l.Blocks << " x " << (uint64_t)l.BlockSize << " bytes, block device "
+            << (uint64_t)index;
+        return true;
+    }
+
+    bool RegisterDevice(uint8_t slotId) {
+        uint16_t cfgLen;
+        const uint8_t* cfg = UsbDevice::GetConfigDescriptor(slotId, cfgLen);
+        if (!cfg) return false;
+
+        // Find the Bulk-Only interface (alternate setting 0) and its pipes.
+        // UAS alternates need bulk streams, which the xHCI driver does not
+        // set up, so they are only noted.
+        const UsbDevice::EndpointDescriptor* epIn = nullptr;
+        const UsbDevice::EndpointDescriptor* epOut = nullptr;
+        int iface = -1;
+        bool inBot = false;
+        bool hasUas = false;
+        for (uint16_t off = 0; off + 2 <= cfgLen && cfg[off] != 0; off += cfg[off]) {
+            uint8_t type = cfg[off + 1];
+            if (type == UsbDevice::DESC_INTERFACE &&
+                off + sizeof(UsbDevice::InterfaceDescriptor) <= cfgLen) {
+                auto* id = (const UsbDevice::InterfaceDescriptor*)&cfg[off];
+                bool storage = id->bInterfaceClass == UsbDevice::CLASS_MASS_STORAGE &&
+                               id->bInterfaceSubClass == UsbDevice::SUBCLASS_SCSI;
+                if (storage && id->bInterfaceProtocol == UsbDevice::PROTOCOL_UAS) hasUas = true;
+                inBot = storage && iface < 0 && id->bAlternateSetting == 0 &&
+                        id->bInterfaceProtocol == UsbDevice::PROTOCOL_BOT;
+                if (inBot) iface = id->bInterfaceNumber;
+            } else if (type == UsbDevice::DESC_ENDPOINT && inBot &&
+                       off + sizeof(UsbDevice::EndpointDescriptor) <= cfgLen) {
+                auto* ep = (const UsbDevice::EndpointDescriptor*)&cfg[off];
+                if ((ep->bmAttributes & UsbDevice::EP_XFER_TYPE_MASK) != UsbDevice::EP_XFER_BULK) continue;
+                if (ep->bEndpointAddress & UsbDevice::EP_DIR_IN) {
+                    if (!epIn) epIn = ep;
+                } else if (!epOut) {
+                    epOut = ep;
+                }
+            }
+        }
+
+        if (iface < 0 || !epIn || !epOut) {
+            KernelLogStream(WARNING, "USB-MS") << "Slot " << base::dec << (uint64_t)slotId
+                << ": no Bulk-Only interface";
+            return false;
+        }
+        if (hasUas) {
+            KernelLogStream(INFO, "USB-MS") << "Slot " << base::dec << (uint64_t)slotId
+                << ": UAS alternate present, using Bulk-Only";
+        }
+
+        Adapter* a = nullptr;
+        for (uint32_t i = 0; i < MAX_ADAPTERS; i++) {
+            if (!g_adapters[i].Active && g_adapters[i].Dma == nullptr) {
+                a = &g_adapters[i];
+                break;
+            }
+        }
+        if (!a) return false;
+
+        a->Dma = (uint8_t*)Memory::Dma::Allocate(0x1000, a->DmaPhys);
+        a->Bounce = (uint8_t*)Memory::Dma::Allocate(BOUNCE_PAGES * 0x1000, a->BouncePhys);
+        if (!a->Dma || !a->Bounce) {
+            KernelLogStream(ERROR, "USB-MS") << "Out of memory for DMA buffers";
+            Memory::Dma::Free(a->Dma, 0x1000);
+            Memory::Dma::Free(a->Bounce, BOUNCE_PAGES * 0x1000);
+            a->Dma = nullptr;
+            a->Bounce = nullptr;
+            return false;
+        }
+        a->SlotId     = slotId;
+        a->Interface  = (uint8_t)iface;
+        a->BulkIn     = epIn->bEndpointAddress;
+        a->BulkOut    = epOut->bEndpointAddress;
+        a->Tag        = 0;
+
+        if (!UsbDevice::OpenEndpoint(slotId, *epIn) || !UsbDevice::OpenEndpoint(slotId, *epOut)) {
+            UsbDevice::CloseEndpoint(slotId, a->BulkIn);
+            UsbDevice::CloseEndpoint(slotId, a->BulkOut);
+            Memory::Dma::Free(a->Dma, 0x1000);
+            Memory::Dma::Free(a->Bounce, BOUNCE_PAGES * 0x1000);
+            a->Dma = nullptr;
+            a->Bounce = nullptr;
+            return false;
+        }
+        a->Active = true;
+
+        // GET MAX LUN; single-LUN devices may stall it
+        uint8_t maxLun = 0;
+        uint32_t cc = Xhci::ControlTransfer(slotId, REQTYPE_CLASS_IFACE_IN, REQ_GET_MAX_LUN,
+                                            0, a->Interface, 1, a->Dma + DMA_DATA, true);
+        if (cc == Xhci::CC_SUCCESS || cc == Xhci::CC_SHORT_PACKET) {
+            maxLun = a->Dma[DMA_DATA] & 0x0F;
+            if (maxLun >= MAX_LUNS) maxLun = MAX_LUNS - 1;
+        }
+
+        a->Lock.Acquire();
+        uint32_t registered = 0;
+        for (uint8_t lun = 0; lun <= maxLun && a->Active; lun++) {
+            if (RegisterLun(*a, lun)) registered++;
+        }
+        a->Lock.Release();
+
+        return registered > 0;
+    }
+
+};
@@ -0,0 +1,23 @@
+/*
+    * MassStorage.hpp
+    * USB mass storage class driver (Bulk-Only Transport, SCSI)
+    * Copyright (c) 2026 Daniel Hammer
+*/
+
+#pragma once
+#include <cstdint>
+
+namespace Drivers::USB::MassStorage {
+
+    constexpr uint32_t MAX_ADAPTERS = 4;
+    constexpr uint32_t MAX_LUNS     = 8;
+
+    // Largest data phase of one command
+    constexpr uint32_t MAX_TRANSFER_BYTES = 120 * 1024;
+
+    // Bring up the Bulk-Only interface of an enumerated device and register
+    // each ready LUN as a block device. Drives present at boot get their
+    // partitions probed by InitializeStorage().
+    bool RegisterDevice(uint8_t slotId);
+
+};
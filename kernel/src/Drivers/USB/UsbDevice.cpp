@@ -8,6 +8,7 @@
 #include "Xhci.hpp"
 #include "HidKeyboard.hpp"
 #include "HidMouse.hpp"
+#include "MassStorage.hpp"
 #include "Bluetooth/Bluetooth.hpp"
 #include <Terminal/Terminal.hpp>
 #include <CppLib/Stream.hpp>
@@ -44,6 +45,10 @@ namespace Drivers::USB::Xhci {
 
 namespace Drivers::USB::UsbDevice {
 
+    // Configuration descriptors, per slot
+    static uint8_t  g_configDesc[Xhci::MAX_SLOTS + 1][CONFIG_DESC_MAX] = {};
+    static uint16_t g_configDescLen[Xhci::MAX_SLOTS + 1] = {};
+
     // ---------------------------------------------------------------------------
     // Helpers
     // ---------------------------------------------------------------------------
@@ -65,6 +70,10 @@ namespace Drivers::USB::UsbDevice {
         return speed;  // Same encoding
     }
 
+    // xHCI Interval for HID mouse endpoints: 2^3 * 125us = 1 ms, the
+    // fastest full/low-speed devices can be polled at
+    static constexpr uint32_t MousePollInterval = 3;
+
     // Convert USB endpoint bInterval to xHCI Endpoint Context Interval value.
     // HS/SS: bInterval is already in 2^(n-1) * 125µs encoding — use directly.
     // FS/LS: bInterval is in milliseconds (frames) — convert via fls(bInterval * 8).
@@ -322,9 +331,10 @@ namespace Drivers::USB::UsbDevice {
             return 0;
         }
 
-        uint8_t cfgBuf[256] = {};
+        uint8_t cfgBuf[CONFIG_DESC_MAX] = {};
+        g_configDescLen[slotId] = 0;
         uint16_t totalLen = cfgHdr.wTotalLength;
-        if (totalLen > 256) totalLen = 256;
+        if (totalLen > CONFIG_DESC_MAX) totalLen = CONFIG_DESC_MAX;
 
         cc = Xhci::ControlTransfer(slotId, REQTYPE_DEV_TO_HOST, REQ_GET_DESCRIPTOR,
                                    (DESC_CONFIGURATION << 8), 0, totalLen,
@@ -334,6 +344,8 @@ namespace Drivers::USB::UsbDevice {
             dev->Active = false;
             return 0;
         }
+        memcpy(g_configDesc[slotId], cfgBuf, totalLen);
+        g_configDescLen[slotId] = totalLen;
 
         // -----------------------------------------------------------------
         // Step 7: Parse configuration descriptor blob
@@ -377,6 +389,17 @@ namespace Drivers::USB::UsbDevice {
                     }
                     foundBt = true;
                 }
+
+                // Bulk-Only mass storage (alternate setting 0); the class
+                // driver opens its own endpoints
+                if (iface->bInterfaceClass == CLASS_MASS_STORAGE &&
+                    iface->bInterfaceSubClass == SUBCLASS_SCSI &&
+                    iface->bInterfaceProtocol == PROTOCOL_BOT &&
+                    iface->bAlternateSetting == 0 && dev->InterfaceClass == 0) {
+                    dev->InterfaceClass    = iface->bInterfaceClass;
+                    dev->InterfaceSubClass = iface->bInterfaceSubClass;
+                    dev->InterfaceProtocol = iface->bInterfaceProtocol;
+                }
             }
 
             // HID descriptor (0x21): extract report descriptor length
@@ -481,6 +504,13 @@ namespace Drivers::USB::UsbDevice {
 
                 auto& epCtx = inputCtx2->EP[dci - 1];
                 uint32_t xhciInterval = ConvertInterval(speed, dev->InterruptInterval);
+
+                // bInterval is the longest a device may wait to be polled;
+                // mice are polled every MousePollInterval instead, so
+                // motion arrives in fine steps rather than every 8-10 ms
+                bool isMouse = foundHid && dev->InterfaceClass == CLASS_HID &&
+                               dev->InterfaceProtocol == PROTOCOL_MOUSE;
+                if (isMouse && xhciInterval > MousePollInterval) xhciInterval = MousePollInterval;
                 epCtx.Field0 = (xhciInterval << 16);
                 epCtx.Field1 = (3 << 1)
                              | (Xhci::EP_TYPE_INTERRUPT_IN << 3)
@@ -647,6 +677,11 @@ namespace Drivers::USB::UsbDevice {
             KernelLogStream(OK, "USB") << "Slot " << (uint64_t)slotId << ": Bluetooth Adapter"
                 << " VID:" << base::hex << (uint64_t)dev->VendorId
                 << " PID:" << (uint64_t)dev->ProductId << base::dec;
+        } else if (dev->InterfaceClass == CLASS_MASS_STORAGE) {
+            KernelLogStream(OK, "USB") << "Slot " << (uint64_t)slotId << ": Mass Storage"
+                << " VID:" << base::hex << (uint64_t)dev->VendorId
+                << " PID:" << (uint64_t)dev->ProductId << base::dec;
+            MassStorage::RegisterDevice(slotId);
         } else if (foundEp) {
             KernelLogStream(INFO, "USB") << "Slot " << (uint64_t)slotId
                 << ": USB device, class=" << (uint64_t)dev->InterfaceClass
@@ -659,4 +694,178 @@ namespace Drivers::USB::UsbDevice {
         return slotId;
     }
 
+    // ---------------------------------------------------------------------------
+    // GetConfigDescriptor
+    // ---------------------------------------------------------------------------
+
+    const uint8_t* GetConfigDescriptor(uint8_t slotId, uint16_t& length) {
+        length = 0;
+        if (slotId == 0 || slotId > Xhci::MAX_SLOTS) return nullptr;
+        length = g_configDescLen[slotId];
+        return length ? g_configDesc[slotId] : nullptr;
+    }
+
+    // ---------------------------------------------------------------------------
+    // Endpoints and URBs
+    // ---------------------------------------------------------------------------
+
+    // xHCI Interval for a periodic endpoint (2^Interval * 125us)
+    static uint32_t EndpointInterval(uint32_t speed, uint8_t xferType, uint8_t bInterval) {
+        if (xferType == EP_XFER_INTERRUPT) return ConvertInterval(speed, bInterval);
+        if (xferType != EP_XFER_ISOCH || bInterval == 0) return 0;
+
+        // Isochronous bInterval is already an exponent: 2^(bInterval-1)
+        // microframes at high/super speed, frames at full speed
+        uint32_t interval = bInterval - 1;
+        if (speed == Xhci::SPEED_FULL || speed == Xhci::SPEED_LOW) interval += 3;
+        return interval > 15 ? 15 : interval;
+    }
+
+    // SuperSpeed endpoint companion following `epAddress` in the config blob
+    static const uint8_t* FindCompanion(uint8_t slotId, uint8_t epAddress) {
+        uint16_t len = g_configDescLen[slotId];
+        const uint8_t* cfg = g_configDesc[slotId];
+        for (uint16_t off = 0; off + 2 <= len && cfg[off] != 0; off += cfg[off]) {
+            if (cfg[off + 1] != DESC_ENDPOINT || off + sizeof(EndpointDescriptor) > len) continue;
+            if (((const EndpointDescriptor*)&cfg[off])->bEndpointAddress != epAddress) continue;
+
+            uint16_t next = off + cfg[off];
+            if (next + 6 <= len && cfg[next + 1] == DESC_SS_EP_COMPANION) return &cfg[next];
+            return nullptr;
+        }
+        return nullptr;
+    }
+
+    // Configure Endpoint with one endpoint added or dropped
+    static uint32_t ConfigureOneEndpoint(Xhci::UsbDeviceInfo* dev, uint8_t slotId, uint8_t dci,
+                                         bool add, const Xhci::EndpointContext* epCtx) {
+        auto* inputCtx = (Xhci::InputContext*)Memory::g_pfa->AllocateZeroed();
+        if (!inputCtx) return 0xFF;
+
+        inputCtx->ICC.AddFlags = (1 << 0);
+        inputCtx->Slot = dev->OutputContext->Slot;
+        if (add) {
+            inputCtx->ICC.AddFlags |= (1u << dci);
+            inputCtx->EP[dci - 1] = *epCtx;
+
+            uint32_t entries = (inputCtx->Slot.Field0 >> 27) & 0x1F;
+            if (dci > entries) {
+                inputCtx->Slot.Field0 = (inputCtx->Slot.Field0 & ~(0x1Fu << 27))
+                                      | ((uint32_t)dci << 27);
+            }
+        } else {
+            inputCtx->ICC.DropFlags = (1u << dci);
+        }
+
+        Xhci::TRB cfgTrb = {};
+        uint64_t inputCtxPhys = Memory::SubHHDM(inputCtx);
+        cfgTrb.Parameter0 = (uint32_t)(inputCtxPhys & 0xFFFFFFFF);
+        cfgTrb.Parameter1 = (uint32_t)(inputCtxPhys >> 32);
+        cfgTrb.Control    = (Xhci::TRB_CONFIGURE_ENDPOINT << Xhci::TRB_TYPE_SHIFT)
+                          | ((uint32_t)slotId << 24);
+
+        uint32_t cc = Xhci::SendCommand(cfgTrb);
+        Memory::g_pfa->Free(inputCtx);
+        return cc;
+    }
+
+    bool OpenEndpoint(uint8_t slotId, const EndpointDescriptor& ep) {
+        auto* dev = Xhci::GetDevice(slotId);
+        if (!dev || !dev->Active) return false;
+
+        uint8_t xferType = ep.bmAttributes & EP_XFER_TYPE_MASK;
+        if (xferType == EP_XFER_CONTROL) return false;
+
+        bool isIn = (ep.bEndpointAddress & EP_DIR_IN) != 0;
+        uint8_t dci = EndpointDci(ep.bEndpointAddress);
+        if (dci < 2) return false;
+
+        uint32_t epType;
+        switch (xferType) {
+            case EP_XFER_ISOCH: epType = isIn ? Xhci::EP_TYPE_ISOCH_IN : Xhci::EP_TYPE_ISOCH_OUT; break;
+            case EP_XFER_BULK:  epType = isIn ? Xhci::EP_TYPE_BULK_IN : Xhci::EP_TYPE_BULK_OUT; break;
+            default:            epType = isIn ? Xhci::EP_TYPE_INTERRUPT_IN : Xhci::EP_TYPE_INTERRUPT_OUT; break;
+        }
+
+        // Packet size and burst: high-speed periodic endpoints encode extra
+        // transactions per microframe in wMaxPacketSize bits 12:11,
+        // SuperSpeed ones use the companion descriptor
+        uint16_t maxPacket = ep.wMaxPacketSize & 0x7FF;
+        uint32_t maxBurst = 0;
+        uint32_t mult = 0;
+        if (dev->Speed == Xhci::SPEED_SUPER) {
+            const uint8_t* comp = FindCompanion(slotId, ep.bEndpointAddress);
+            if (comp) {
+                maxBurst = comp[2];
+                if (xferType == EP_XFER_ISOCH) mult = comp[3] & 0x3;
+            }
+        } else if (dev->Speed == Xhci::SPEED_HIGH && xferType != EP_XFER_BULK) {
+            maxBurst = (ep.wMaxPacketSize >> 11) & 0x3;
+        }
+        uint32_t maxEsit = (xferType == EP_XFER_BULK) ? 0
+                         : (uint32_t)maxPacket * (maxBurst + 1) * (mult + 1);
+
+        uint64_t ringPhys = Xhci::CreateEndpointRing(slotId, dci, epType, maxPacket);
+        if (ringPhys == 0) {
+            KernelLogStream(ERROR, "USB") << "Slot " << (uint64_t)slotId
+                << ": no ring for EP " << base::hex << (uint64_t)ep.bEndpointAddress << base::dec;
+            return false;
+        }
+
+        Xhci::EndpointContext epCtx = {};
+        epCtx.Field0 = (EndpointInterval(dev->Speed, xferType, ep.bInterval) << 16)
+                     | (mult << 8);
+        epCtx.Field1 = ((xferType == EP_XFER_ISOCH ? 0u : 3u) << 1)
+                     | (epType << 3)
+                     | (maxBurst << 8)
+                     | ((uint32_t)maxPacket << 16);
+        epCtx.TRDequeuePtr = ringPhys;
+        uint32_t avgTrb = (xferType == EP_XFER_INTERRUPT) ? 1024 : 3072;
+        epCtx.Field2 = avgTrb | ((maxEsit & 0xFFFF) << 16);
+        epCtx.Field0 |= ((maxEsit >> 16) & 0xFF) << 24;
+
+        uint32_t cc = ConfigureOneEndpoint(dev, slotId, dci, true, &epCtx);
+        if (cc != Xhci::CC_SUCCESS) {
+            KernelLogStream(ERROR, "USB") << "Configure Endpoint failed, slot="
+                << (uint64_t)slotId << " dci=" << (uint64_t)dci << " cc=" << (uint64_t)cc;
+            Xhci::DestroyEndpointRing(slotId, dci);
+            return false;
+        }
+
+        KernelLogStream(INFO, "USB") << "Slot " << (uint64_t)slotId << ": EP "
+            << base::hex << (uint64_t)ep.bEndpointAddress << base::dec
+            << " opened, dci=" << (uint64_t)dci;
+        return true;
+    }
+
+    void CloseEndpoint(uint8_t slotId, uint8_t epAddress) {
+        auto* dev = Xhci::GetDevice(slotId);
+        if (!dev) return;
+
+        uint8_t dci = EndpointDci(epAddress);
+        if (dci < 2 || !dev->EpRings[dci]) return;
+
+        if (dev->Active) {
+            ConfigureOneEndpoint(dev, slotId, dci, false, nullptr);
+        }
+        Xhci::DestroyEndpointRing(slotId, dci);
+    }
+
+    bool Submit(Xhci::Urb* urb) {
+        return Xhci::SubmitUrb(urb);
+    }
+
+    bool ResetEndpoint(uint8_t slotId, uint8_t epAddress) {
+        auto* dev = Xhci::GetDevice(slotId);
+        if (!dev || !dev->Active) return false;
+
+        uint8_t dci = EndpointDci(epAddress);
+        if (!Xhci::ResetEndpointRing(slotId, dci)) return false;
+
+        // The device keeps its own halt (and data toggle) until told
+        uint32_t cc = Xhci::ControlTransfer(slotId, REQTYPE_STD_EP, REQ_CLEAR_FEATURE,
+                                            FEATURE_ENDPOINT_HALT, epAddress, 0, nullptr, false);
+        return cc == Xhci::CC_SUCCESS;
+    }
+
 }
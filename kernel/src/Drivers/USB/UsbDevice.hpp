@@ -6,6 +6,7 @@
 
 #pragma once
 #include <cstdint>
+#include "Xhci.hpp"
 
 namespace Drivers::USB::UsbDevice {
 
@@ -71,6 +72,7 @@ namespace Drivers::USB::UsbDevice {
     constexpr uint8_t DESC_CONFIGURATION = 2;
     constexpr uint8_t DESC_INTERFACE     = 4;
     constexpr uint8_t DESC_ENDPOINT      = 5;
+    constexpr uint8_t DESC_SS_EP_COMPANION = 0x30;
     constexpr uint8_t DESC_HID           = 0x21;
     constexpr uint8_t DESC_HID_REPORT    = 0x22;
 
@@ -80,12 +82,20 @@ namespace Drivers::USB::UsbDevice {
     constexpr uint8_t PROTOCOL_KEYBOARD  = 0x01;
     constexpr uint8_t PROTOCOL_MOUSE     = 0x02;
 
+    // Mass Storage class: SCSI transparent command set over Bulk-Only
+    // Transport, or the USB Attached SCSI protocol
+    constexpr uint8_t CLASS_MASS_STORAGE = 0x08;
+    constexpr uint8_t SUBCLASS_SCSI      = 0x06;
+    constexpr uint8_t PROTOCOL_BOT       = 0x50;
+    constexpr uint8_t PROTOCOL_UAS       = 0x62;
+
     // Wireless Controller class (Bluetooth)
     constexpr uint8_t CLASS_WIRELESS     = 0xE0;
     constexpr uint8_t SUBCLASS_RF        = 0x01;
     constexpr uint8_t PROTOCOL_BLUETOOTH = 0x01;
 
     // USB standard requests (bRequest)
+    constexpr uint8_t REQ_CLEAR_FEATURE     = 0x01;
     constexpr uint8_t REQ_GET_DESCRIPTOR    = 0x06;
     constexpr uint8_t REQ_SET_CONFIGURATION = 0x09;
     constexpr uint8_t REQ_SET_INTERFACE     = 0x0B;
@@ -99,6 +109,13 @@ namespace Drivers::USB::UsbDevice {
     constexpr uint8_t REQTYPE_HOST_TO_DEV    = 0x00;
     constexpr uint8_t REQTYPE_CLASS_IFACE    = 0x21;  // Host-to-device, class, interface
     constexpr uint8_t REQTYPE_STD_IFACE_IN   = 0x81;  // Dev-to-host, standard, interface
+    constexpr uint8_t REQTYPE_STD_EP         = 0x02;  // Host-to-device, standard, endpoint
+
+    // Feature selectors
+    constexpr uint16_t FEATURE_ENDPOINT_HALT = 0;
+
+    // Configuration descriptor blob kept per device
+    constexpr uint16_t CONFIG_DESC_MAX = 512;
 
     // Endpoint direction mask
     constexpr uint8_t EP_DIR_IN = 0x80;
@@ -118,4 +135,29 @@ namespace Drivers::USB::UsbDevice {
     // Returns the assigned slot ID, or 0 on failure.
     uint8_t EnumerateDevice(uint8_t portId, uint32_t speed);
 
+    // The full configuration descriptor read at enumeration, for class
+    // drivers to find their interfaces and endpoints in
+    const uint8_t* GetConfigDescriptor(uint8_t slotId, uint16_t& length);
+
+    // Device Context Index of an endpoint address (bEndpointAddress)
+    constexpr uint8_t EndpointDci(uint8_t epAddress) {
+        return (uint8_t)((epAddress & 0x0F) * 2 + ((epAddress & EP_DIR_IN) ? 1 : 0));
+    }
+
+    // Give a bulk, isochronous or interrupt endpoint a URB ring and configure
+    // it on the controller. The endpoint's interface (and alternate setting)
+    // must already be selected on the device. Thread context.
+    bool OpenEndpoint(uint8_t slotId, const EndpointDescriptor& ep);
+
+    // Drop an endpoint again, completing queued URBs with CC_STOPPED
+    void CloseEndpoint(uint8_t slotId, uint8_t epAddress);
+
+    // Queue an asynchronous transfer; urb->EpDci is EndpointDci(address).
+    // Many URBs may be in flight per endpoint, completing in order.
+    bool Submit(Xhci::Urb* urb);
+
+    // Recover an endpoint after a stall or other halt: clear the halt on
+    // both ends and cancel what was queued. Thread context.
+    bool ResetEndpoint(uint8_t slotId, uint8_t epAddress);
+
 };
@@ -14,9 +14,14 @@
 #include <Memory/HHDM.hpp>
 #include <Memory/Paging.hpp>
 #include <Memory/PageFrameAllocator.hpp>
+#include <Memory/Dma.hpp>
 #include <Libraries/Memory.hpp>
 #include <Hal/Apic/Interrupts.hpp>
+#include <Hal/SmpBoot.hpp>
 #include <Timekeeping/ApicTimer.hpp>
+#include <Sched/Scheduler.hpp>
+#include <CppLib/Spinlock.hpp>
+#include <ACPI/AcpiSleep.hpp>
 
 using namespace Kt;
 
@@ -46,6 +51,15 @@ namespace Drivers::USB::Xhci {
 
     static bool g_initialized = false;
     static bool g_bootScanComplete = false;  // true after initial port scan finishes
+    static bool g_msiEnabled = false;        // false: poll mode, the tick drains events
+    static volatile bool g_suspended = false; // between the S3 suspend and resume hooks
+
+    // PCI location, and what the controller's registers lose across S3
+    static uint8_t  g_pciBus = 0, g_pciDevice = 0, g_pciFunction = 0;
+    static uint32_t g_savedDnctrl = 0;
+    static uint32_t g_savedConfig = 0;
+    static uint32_t g_savedIman = 0;
+    static uint32_t g_savedImod = 0;
 
     // Hot-plug deferred work
     static volatile bool g_hotplugPending[MAX_PORTS] = {};
@@ -82,15 +96,25 @@ namespace Drivers::USB::Xhci {
     static ERSTEntry* g_erst = nullptr;
     static uint64_t   g_erstPhys = 0;
 
-    // Command completion tracking
-    static volatile bool     g_cmdCompleted = false;
+    // One CPU drains the event ring at a time. The owner may re-enter
+    // PollEvents() from a transfer callback (a class driver sending a
+    // control transfer); anyone else finds it busy and leaves it be.
+    static kcp::Spinlock g_evtLock;
+    static volatile int  g_evtOwnerCpu = -1;
+
+    // Command completion tracking. The completed flags are also the words
+    // sleeping waiters block on (see WaitCompletion).
+    static volatile uint32_t g_cmdCompleted = 0;
     static volatile uint32_t g_cmdCompletionCode = 0;
     volatile uint32_t g_cmdCompletionSlotId = 0;  // not static: accessed by UsbDevice.cpp
 
-    // Transfer completion tracking (for EP0 control transfers during init)
-    static volatile bool     g_xferCompleted = false;
+    // Transfer completion tracking (for EP0 control transfers)
+    static volatile uint32_t g_xferCompleted = 0;
     static volatile uint32_t g_xferCompletionCode = 0;
 
+    static constexpr uint64_t CMD_TIMEOUT_MS  = 1000;
+    static constexpr uint64_t XFER_TIMEOUT_MS = 1000;
+
     // Per-device info
     static UsbDeviceInfo g_devices[MAX_SLOTS + 1] = {};
 
@@ -136,16 +160,6 @@ namespace Drivers::USB::Xhci {
         *(volatile uint32_t*)(g_dbBase + index * 4) = value;
     }
 
-    // -------------------------------------------------------------------------
-    // DMA buffer allocation
-    // -------------------------------------------------------------------------
-
-    static uint8_t* AllocateDmaBuffer(uint64_t& outPhysAddr) {
-        void* virt = Memory::g_pfa->AllocateZeroed();
-        outPhysAddr = Memory::SubHHDM(virt);
-        return (uint8_t*)virt;
-    }
-
     // -------------------------------------------------------------------------
     // Transfer ring advance helpers (handle Link TRB wrap)
     // -------------------------------------------------------------------------
@@ -211,6 +225,217 @@ namespace Drivers::USB::Xhci {
         }
     }
 
+    // -------------------------------------------------------------------------
+    // URB endpoint rings
+    // -------------------------------------------------------------------------
+
+    // Per-TRB bookkeeping: the URB a TRB belongs to and where its buffer
+    // starts within the URB (bulk) or within its packet (isochronous)
+    struct RingSlot {
+        Urb*     Owner;
+        uint32_t Offset;
+        uint16_t Packet;
+        uint16_t Last;        // last TRB of a TD
+    };
+
+    struct TransferRing {
+        bool      InUse;
+        bool      Isoch;
+        bool      Halted;
+        bool      CCS;
+        uint16_t  MaxPacket;
+        uint32_t  Enqueue;
+        uint32_t  Free;       // TRBs available, the Link TRB not counted
+        TRB*      Ring;
+        uint64_t  Phys;
+        RingSlot* Slots;
+        Urb*      Head;       // in flight, oldest first
+        Urb*      Tail;
+    };
+
+    static_assert(sizeof(RingSlot) * EP_RING_SIZE <= 0x1000, "RingSlot table must fit a page");
+
+    // Guards every URB ring and the EpRings tables
+    static kcp::Spinlock g_urbLock;
+    static TransferRing  g_epRings[MAX_EP_RINGS] = {};
+
+    static bool IsHaltError(uint32_t cc) {
+        return cc == CC_STALL || cc == CC_BABBLE || cc == CC_USB_TRANSACTION;
+    }
+
+    // TRBs needed for a buffer, split at 64 KiB boundaries
+    static uint32_t TrbsFor(uint64_t phys, uint32_t length) {
+        if (length == 0) return 1;
+        uint32_t first = TRB_MAX_BUFFER - (uint32_t)(phys & (TRB_MAX_BUFFER - 1));
+        if (length <= first) return 1;
+        return 1 + (length - first + TRB_MAX_BUFFER - 1) / TRB_MAX_BUFFER;
+    }
+
+    // Packets still to go after this TRB, the TD Size field
+    static uint32_t TdSize(uint32_t remaining, uint16_t maxPacket) {
+        if (maxPacket == 0) return 0;
+        uint32_t packets = (remaining + maxPacket - 1) / maxPacket;
+        return packets > 31 ? 31 : packets;
+    }
+
+    // Write one TRB at the enqueue pointer and advance over the Link TRB,
+    // carrying the chain bit across it when the TD continues
+    static void PutTrb(TransferRing& r, Urb* urb, uint64_t phys, uint32_t length,
+                       uint32_t tdSize, uint32_t control, uint32_t offset,
+                       uint16_t packet, bool last) {
+        uint32_t idx = r.Enqueue;
+        TRB& trb = r.Ring[idx];
+        trb.Parameter0 = (uint32_t)(phys & 0xFFFFFFFF);
+        trb.Parameter1 = (uint32_t)(phys >> 32);
+        trb.Status     = length | (tdSize << TRB_TD_SIZE_SHIFT);
+
+        // The first TRB of a URB gets its cycle bit last, in SubmitUrb, so
+        // the controller never starts on a half-written TD
+        bool cycle = r.CCS;
+        if (idx == urb->FirstTrb && urb->TrbCount == 0) cycle = !cycle;
+        trb.Control = control | (cycle ? TRB_CYCLE_BIT : 0);
+
+        r.Slots[idx] = { urb, offset, packet, (uint16_t)(last ? 1 : 0) };
+        urb->TrbCount++;
+        r.Free--;
+
+        r.Enqueue++;
+        if (r.Enqueue >= EP_RING_SIZE - 1) {
+            TRB& link = r.Ring[EP_RING_SIZE - 1];
+            uint32_t linkControl = (TRB_LINK << TRB_TYPE_SHIFT) | TRB_TC;
+            if (control & TRB_CHAIN) linkControl |= TRB_CHAIN;
+            if (r.CCS) linkControl |= TRB_CYCLE_BIT;
+            link.Control = linkControl;
+            r.CCS = !r.CCS;
+            r.Enqueue = 0;
+        }
+    }
+
+    // Queue a buffer as TRBs of the current TD; the TD ends with the TRB
+    // that brings `remaining` to zero
+    static void PutBuffer(TransferRing& r, Urb* urb, uint64_t phys, uint32_t length,
+                          uint32_t& remaining, uint32_t firstType, uint32_t tdControl,
+                          uint32_t& offset, uint16_t packet, bool endsTd) {
+        uint32_t type = firstType;
+        do {
+            uint32_t chunk = TRB_MAX_BUFFER - (uint32_t)(phys & (TRB_MAX_BUFFER - 1));
+            if (chunk > length) chunk = length;
+            remaining -= chunk;
+
+            bool last = endsTd && remaining == 0;
+            uint32_t control = (type << TRB_TYPE_SHIFT) | TRB_ISP;
+            control |= last ? tdControl : TRB_CHAIN;
+            if (type == TRB_ISOCH) control |= TRB_SIA;
+
+            PutTrb(r, urb, phys, chunk, last ? 0 : TdSize(remaining, r.MaxPacket),
+                   control, offset, packet, last);
+            type = TRB_NORMAL;
+            phys += chunk;
+            offset += chunk;
+            length -= chunk;
+        } while (length > 0);
+    }
+
+    // Take a URB off its ring (g_urbLock held), freeing its TRBs
+    static void RetireUrb(TransferRing& r, Urb* urb) {
+        uint32_t idx = urb->FirstTrb;
+        for (uint32_t i = 0; i < urb->TrbCount; i++) {
+            if (r.Slots[idx].Owner == urb) r.Slots[idx].Owner = nullptr;
+            if (++idx >= EP_RING_SIZE - 1) idx = 0;
+        }
+        r.Free += urb->TrbCount;
+
+        Urb** link = &r.Head;
+        Urb* prev = nullptr;
+        while (*link && *link != urb) {
+            prev = *link;
+            link = &(*link)->Next;
+        }
+        if (*link) {
+            *link = urb->Next;
+            if (r.Tail == urb) r.Tail = prev;
+        }
+        urb->Next = nullptr;
+    }
+
+    static void CompleteUrbs(Urb* list) {
+        while (list) {
+            Urb* next = list->Next;
+            list->Next = nullptr;
+            if (list->Complete) list->Complete(list);
+            list = next;
+        }
+    }
+
+    // Transfer event on a URB ring. Returns false if the endpoint has none.
+    static bool HandleRingEvent(uint8_t slotId, uint8_t dci, const TRB& evt) {
+        Urb* done = nullptr;
+
+        g_urbLock.Acquire();
+        TransferRing* r = g_devices[slotId].EpRings[dci];
+        if (r == nullptr) {
+            g_urbLock.Release();
+            return false;
+        }
+
+        uint32_t cc = (evt.Status >> 24) & 0xFF;
+        uint32_t residual = evt.Status & 0x00FFFFFF;
+        uint64_t ptr = (uint64_t)evt.Parameter0 | ((uint64_t)evt.Parameter1 << 32);
+
+        // Underrun/overrun events carry no TRB; stop events are the tail
+        // of ResetEndpointRing, which cancels what is left itself
+        bool inRing = ptr >= r->Phys && ptr < r->Phys + (EP_RING_SIZE - 1) * sizeof(TRB);
+        if (!inRing || cc == CC_STOPPED || cc == CC_STOPPED_LEN_INVALID) {
+            g_urbLock.Release();
+            return true;
+        }
+
+        uint32_t idx = (uint32_t)((ptr - r->Phys) / sizeof(TRB));
+        RingSlot& slot = r->Slots[idx];
+        Urb* urb = slot.Owner;
+        if (urb == nullptr) {
+            // Already retired, e.g. the IOC event some controllers still
+            // send after an earlier short packet ended the TD
+            g_urbLock.Release();
+            return true;
+        }
+
+        uint32_t trbLen = r->Ring[idx].Status & 0x1FFFF;
+        if (residual > trbLen) residual = trbLen;
+        uint32_t moved = slot.Offset + trbLen - residual;
+
+        bool success = cc == CC_SUCCESS || cc == CC_SHORT_PACKET;
+        if (r->Isoch) {
+            IsoPacket& pkt = urb->Packets[slot.Packet];
+            if (pkt.Status == 0) {
+                pkt.Actual = success ? moved : 0;
+                pkt.Status = cc;
+                urb->Actual += pkt.Actual;
+                urb->PacketsLeft--;
+            }
+            if (urb->PacketsLeft == 0) {
+                urb->Status = CC_SUCCESS;
+                RetireUrb(*r, urb);
+                done = urb;
+            }
+        } else {
+            urb->Actual = success ? moved : slot.Offset;
+            urb->Status = cc;
+            if (!success) {
+                if (IsHaltError(cc)) r->Halted = true;
+                KernelLogStream(WARNING, "xHCI") << "URB error on slot "
+                    << base::dec << (uint64_t)slotId << " ep " << (uint64_t)dci
+                    << " cc=" << (uint64_t)cc;
+            }
+            RetireUrb(*r, urb);
+            done = urb;
+        }
+        g_urbLock.Release();
+
+        CompleteUrbs(done);
+        return true;
+    }
+
     // -------------------------------------------------------------------------
     // Forward declarations
     // -------------------------------------------------------------------------
@@ -221,15 +446,9 @@ namespace Drivers::USB::Xhci {
     // MSI setup (same pattern as E1000E)
     // -------------------------------------------------------------------------
 
-    static bool SetupMsi(uint8_t bus, uint8_t dev, uint8_t func) {
-        uint8_t cap = Pci::FindCapability(bus, dev, func, Pci::PCI_CAP_MSI);
-        if (cap == 0) {
-            KernelLogStream(INFO, "xHCI") << "MSI capability not found";
-            return false;
-        }
-
-        KernelLogStream(INFO, "xHCI") << "MSI capability at offset " << base::hex << (uint64_t)cap;
-
+    // Program the MSI capability at `cap` and mask INTx. Returns whether
+    // the capability takes 64-bit addresses.
+    static bool ProgramMsi(uint8_t bus, uint8_t dev, uint8_t func, uint8_t cap) {
         // Read Message Control (cap+2)
         uint16_t msgCtrl = Pci::LegacyRead16(bus, dev, func, cap + 2);
         bool is64bit = (msgCtrl & (1 << 7)) != 0;
@@ -256,9 +475,23 @@ namespace Drivers::USB::Xhci {
         uint16_t pciCmd = Pci::LegacyRead16(bus, dev, func, (uint8_t)Pci::PCI_REG_COMMAND);
         pciCmd |= Pci::PCI_CMD_INTX_DISABLE;
         Pci::LegacyWrite16(bus, dev, func, (uint8_t)Pci::PCI_REG_COMMAND, pciCmd);
+        return is64bit;
+    }
+
+    static bool SetupMsi(uint8_t bus, uint8_t dev, uint8_t func) {
+        uint8_t cap = Pci::FindCapability(bus, dev, func, Pci::PCI_CAP_MSI);
+        if (cap == 0) {
+            KernelLogStream(INFO, "xHCI") << "MSI capability not found";
+            return false;
+        }
+
+        KernelLogStream(INFO, "xHCI") << "MSI capability at offset " << base::hex << (uint64_t)cap;
+
+        bool is64bit = ProgramMsi(bus, dev, func, cap);
 
         // Register the interrupt handler for MSI vector
         Hal::RegisterIrqHandler(MSI_IRQ, HandleInterrupt);
+        g_msiEnabled = true;
 
         KernelLogStream(OK, "xHCI") << "MSI enabled: vector " << base::dec << (uint64_t)MSI_VECTOR
             << " (IRQ slot " << (uint64_t)MSI_IRQ << ")" << (is64bit ? " [64-bit]" : " [32-bit]");
@@ -267,10 +500,10 @@ namespace Drivers::USB::Xhci {
     }
 
     // -------------------------------------------------------------------------
-    // PollEvents - process event ring
+    // DrainEvents - process event ring (event lock held)
     // -------------------------------------------------------------------------
 
-    void PollEvents() {
+    static void DrainEvents() {
         while (true) {
             TRB& evt = g_evtRing[g_evtRingDequeue];
 
@@ -288,7 +521,8 @@ namespace Drivers::USB::Xhci {
                     uint32_t slotId = (evt.Control >> 24) & 0xFF;
                     g_cmdCompletionCode = completionCode;
                     g_cmdCompletionSlotId = slotId;
-                    g_cmdCompleted = true;
+                    g_cmdCompleted = 1;
+                    Sched::WakeAddress(&g_cmdCompleted, 1);
                     break;
                 }
 
@@ -311,10 +545,14 @@ namespace Drivers::USB::Xhci {
                     uint32_t slotId = (evt.Control >> 24) & 0xFF;
                     uint32_t epDci = (evt.Control >> 16) & 0x1F;
 
-                    if (epDci == 1) {
+                    if (slotId > 0 && slotId <= MAX_SLOTS && epDci > 1 &&
+                        HandleRingEvent((uint8_t)slotId, (uint8_t)epDci, evt)) {
+                        // URB ring - completed above
+                    } else if (epDci == 1) {
                         // EP0 (DCI 1) - control transfer completion
                         g_xferCompletionCode = completionCode;
-                        g_xferCompleted = true;
+                        g_xferCompleted = 1;
+                        Sched::WakeAddress(&g_xferCompleted, 1);
                     } else if (slotId > 0 && slotId <= MAX_SLOTS && g_devices[slotId].Active) {
                         UsbDeviceInfo& dev = g_devices[slotId];
 
@@ -397,6 +635,81 @@ namespace Drivers::USB::Xhci {
 
     }
 
+    // -------------------------------------------------------------------------
+    // PollEvents
+    // -------------------------------------------------------------------------
+
+    void PollEvents() {
+        if (g_evtRing == nullptr) return;
+
+        int cpu = Smp::GetCurrentCpuData()->cpuIndex;
+        if (g_evtOwnerCpu == cpu) {
+            // Nested, from a callback of the drain already running here
+            DrainEvents();
+            return;
+        }
+
+        if (!g_evtLock.TryAcquire()) return;
+        g_evtOwnerCpu = cpu;
+        DrainEvents();
+        g_evtOwnerCpu = -1;
+        g_evtLock.Release();
+    }
+
+    // -------------------------------------------------------------------------
+    // WaitCompletion - wait for the event handler to set `*done`
+    // -------------------------------------------------------------------------
+
+    // Sleeping needs the completion interrupt to wake us and a thread to
+    // put to sleep, with interrupts on and outside the event drain
+    static bool CanSleep() {
+        if (!g_msiEnabled || !g_bootScanComplete) return false;
+
+        uint64_t flags;
+        asm volatile("pushfq; pop %0" : "=r"(flags));
+        if (!(flags & (1 << 9))) return false;
+
+        if (Sched::GetCurrentThreadPtr() == nullptr) return false;
+        return g_evtOwnerCpu != (int)Smp::GetCurrentCpuData()->cpuIndex;
+    }
+
+    bool WaitCompletion(volatile uint32_t* done, uint64_t timeoutMs) {
+        if (CanSleep()) {
+            uint64_t start = Timekeeping::GetMilliseconds();
+            while (!*done) {
+                uint64_t elapsed = Timekeeping::GetMilliseconds() - start;
+                if (elapsed >= timeoutMs) break;
+                Sched::FutexWait((uint64_t)done, done, 0, timeoutMs - elapsed);
+            }
+
+            // One last look, in case the interrupt went missing
+            if (!*done) PollEvents();
+            return *done != 0;
+        }
+
+        // With interrupts on the clock runs and bounds the spin; without,
+        // count iterations (about 100 per millisecond)
+        uint64_t flags;
+        asm volatile("pushfq; pop %0" : "=r"(flags));
+        bool clocked = (flags & (1 << 9)) != 0;
+        uint64_t start = Timekeeping::GetMilliseconds();
+
+        for (uint64_t i = 0; ; i++) {
+            PollEvents();
+            if (*done) {
+                return true;
+            }
+            if (clocked ? Timekeeping::GetMilliseconds() - start >= timeoutMs
+                        : i >= timeoutMs * 100) {
+                return false;
+            }
+            // Small delay
+            for (int j = 0; j < 100; j++) {
+                asm volatile("" ::: "memory");
+            }
+        }
+    }
+
     // -------------------------------------------------------------------------
     // HandleInterrupt
     // -------------------------------------------------------------------------
@@ -447,19 +760,11 @@ namespace Drivers::USB::Xhci {
         }
 
         // Clear completion flag and ring the host controller doorbell
-        g_cmdCompleted = false;
+        g_cmdCompleted = 0;
         WriteDoorbell(0, 0);
 
-        // Poll until command completes (with timeout)
-        for (uint32_t i = 0; i < 100000; i++) {
-            PollEvents();
-            if (g_cmdCompleted) {
-                return g_cmdCompletionCode;
-            }
-            // Small delay
-            for (int j = 0; j < 100; j++) {
-                asm volatile("" ::: "memory");
-            }
+        if (WaitCompletion(&g_cmdCompleted, CMD_TIMEOUT_MS)) {
+            return g_cmdCompletionCode;
         }
 
         KernelLogStream(WARNING, "xHCI") << "Command timeout";
@@ -542,18 +847,34 @@ namespace Drivers::USB::Xhci {
         AdvanceEP0Ring(dev);
 
         // Ring doorbell for this slot, target EP0 (DCI 1)
-        g_xferCompleted = false;
+        g_xferCompleted = 0;
         WriteDoorbell(slotId, 1);
 
-        // Poll until transfer completes
-        for (uint32_t i = 0; i < 100000; i++) {
-            PollEvents();
-            if (g_xferCompleted) {
-                return g_xferCompletionCode;
-            }
-            for (int j = 0; j < 100; j++) {
-                asm volatile("" ::: "memory");
+        if (WaitCompletion(&g_xferCompleted, XFER_TIMEOUT_MS)) {
+            uint32_t cc = g_xferCompletionCode;
+            if (cc == CC_STALL) {
+                // A request the device refuses (GET MAX LUN on single-LUN
+                // drives, say) halts EP0: reset it and skip what is left
+                // of the transfer so the next request goes through
+                TRB resetTrb = {};
+                resetTrb.Control = (TRB_RESET_ENDPOINT << TRB_TYPE_SHIFT)
+                                 | ((uint32_t)slotId << 24)
+                                 | (1 << 16);  // DCI=1 (EP0)
+                SendCommand(resetTrb);
+
+                uint64_t deq = dev.EP0RingPhys + (uint64_t)dev.EP0RingEnqueue * sizeof(TRB);
+                if (dev.EP0RingCCS) {
+                    deq |= 1; // DCS bit
+                }
+                TRB deqTrb = {};
+                deqTrb.Parameter0 = (uint32_t)(deq & 0xFFFFFFFF);
+                deqTrb.Parameter1 = (uint32_t)(deq >> 32);
+                deqTrb.Control    = (TRB_SET_TR_DEQUEUE << TRB_TYPE_SHIFT)
+                                  | ((uint32_t)slotId << 24)
+                                  | (1 << 16);
+                SendCommand(deqTrb);
             }
+            return cc;
         }
 
         KernelLogStream(WARNING, "xHCI") << "Control transfer timeout on slot " << base::dec << (uint64_t)slotId;
@@ -598,7 +919,7 @@ namespace Drivers::USB::Xhci {
 
         // Allocate interrupt data buffer if not yet allocated
         if (g_interruptDataBuf[slotId] == nullptr) {
-            g_interruptDataBuf[slotId] = AllocateDmaBuffer(g_interruptDataBufPhys[slotId]);
+            g_interruptDataBuf[slotId] = (uint8_t*)Memory::Dma::Allocate(0x1000, g_interruptDataBufPhys[slotId]);
         }
 
         // Build a Normal TRB on the interrupt ring
@@ -634,7 +955,7 @@ namespace Drivers::USB::Xhci {
         // If caller provides nullptr, use the per-slot bulk IN DMA buffer
         if (data == nullptr) {
             if (g_bulkInDataBuf[slotId] == nullptr) {
-                g_bulkInDataBuf[slotId] = AllocateDmaBuffer(g_bulkInDataBufPhys[slotId]);
+                g_bulkInDataBuf[slotId] = (uint8_t*)Memory::Dma::Allocate(0x1000, g_bulkInDataBufPhys[slotId]);
             }
             data = g_bulkInDataBuf[slotId];
             dataPhys = g_bulkInDataBufPhys[slotId];
@@ -686,6 +1007,246 @@ namespace Drivers::USB::Xhci {
         WriteDoorbell(slotId, target);
     }
 
+    // -------------------------------------------------------------------------
+    // CreateEndpointRing / DestroyEndpointRing
+    // -------------------------------------------------------------------------
+
+    uint64_t CreateEndpointRing(uint8_t slotId, uint8_t dci, uint32_t epType, uint16_t maxPacket) {
+        if (slotId == 0 || slotId > MAX_SLOTS || dci < 2 || dci > 31) return 0;
+
+        auto* ring = (TRB*)Memory::g_pfa->AllocateZeroed();
+        auto* slots = (RingSlot*)Memory::g_pfa->AllocateZeroed();
+        if (!ring || !slots) {
+            if (ring) Memory::g_pfa->Free(ring);
+            if (slots) Memory::g_pfa->Free(slots);
+            return 0;
+        }
+
+        g_urbLock.Acquire();
+        TransferRing* r = nullptr;
+        if (g_devices[slotId].EpRings[dci] == nullptr) {
+            for (uint32_t i = 0; i < MAX_EP_RINGS; i++) {
+                if (!g_epRings[i].InUse) {
+                    r = &g_epRings[i];
+                    break;
+                }
+            }
+        }
+        if (r == nullptr) {
+            g_urbLock.Release();
+            Memory::g_pfa->Free(ring);
+            Memory::g_pfa->Free(slots);
+            return 0;
+        }
+
+        *r = {};
+        r->InUse     = true;
+        r->Isoch     = epType == EP_TYPE_ISOCH_IN || epType == EP_TYPE_ISOCH_OUT;
+        r->CCS       = true;
+        r->MaxPacket = maxPacket;
+        r->Free      = EP_RING_SIZE - 1;
+        r->Ring      = ring;
+        r->Phys      = Memory::SubHHDM(ring);
+        r->Slots     = slots;
+
+        TRB& link = ring[EP_RING_SIZE - 1];
+        link.Parameter0 = (uint32_t)(r->Phys & 0xFFFFFFFF);
+        link.Parameter1 = (uint32_t)(r->Phys >> 32);
+        link.Control    = (TRB_LINK << TRB_TYPE_SHIFT) | TRB_TC;
+
+        g_devices[slotId].EpRings[dci] = r;
+        uint64_t phys = r->Phys;
+        g_urbLock.Release();
+
+        return phys | 1;
+    }
+
+    void DestroyEndpointRing(uint8_t slotId, uint8_t dci) {
+        if (slotId == 0 || slotId > MAX_SLOTS || dci > 31) return;
+
+        g_urbLock.Acquire();
+        TransferRing* r = g_devices[slotId].EpRings[dci];
+        if (r == nullptr) {
+            g_urbLock.Release();
+            return;
+        }
+        g_devices[slotId].EpRings[dci] = nullptr;
+
+        Urb* cancelled = r->Head;
+        for (Urb* u = cancelled; u; u = u->Next) {
+            u->Status = CC_STOPPED;
+        }
+        TRB* ring = r->Ring;
+        RingSlot* slots = r->Slots;
+        *r = {};
+        g_urbLock.Release();
+
+        Memory::g_pfa->Free(ring);
+        Memory::g_pfa->Free(slots);
+        CompleteUrbs(cancelled);
+    }
+
+    // -------------------------------------------------------------------------
+    // SubmitUrb
+    // -------------------------------------------------------------------------
+
+    bool SubmitUrb(Urb* urb) {
+        if (urb == nullptr || urb->SlotId == 0 || urb->SlotId > MAX_SLOTS ||
+            urb->EpDci < 2 || urb->EpDci > 31) {
+            return false;
+        }
+        if (urb->SegmentCount > 0 && urb->Segments == nullptr) return false;
+
+        g_urbLock.Acquire();
+        UsbDeviceInfo& dev = g_devices[urb->SlotId];
+        TransferRing* r = dev.EpRings[urb->EpDci];
+        if (!dev.Active || r == nullptr || r->Halted) {
+            g_urbLock.Release();
+            return false;
+        }
+
+        // Count the TRBs first so a URB is queued whole or not at all
+        uint32_t need = 0;
+        if (r->Isoch) {
+            if (urb->SegmentCount != 1 || urb->PacketCount == 0 || urb->Packets == nullptr) {
+                g_urbLock.Release();
+                return false;
+            }
+            uint64_t off = 0;
+            for (uint32_t p = 0; p < urb->PacketCount; p++) {
+                need += TrbsFor(urb->Segments[0].Phys + off, urb->Packets[p].Length);
+                off += urb->Packets[p].Length;
+            }
+            if (off > urb->Segments[0].Length) need = EP_RING_SIZE;
+        } else {
+            for (uint32_t s = 0; s < urb->SegmentCount; s++) {
+                if (urb->Segments[s].Length == 0) continue;
+                need += TrbsFor(urb->Segments[s].Phys, urb->Segments[s].Length);
+            }
+            if (need == 0) need = 1;
+        }
+        if (need > r->Free) {
+            g_urbLock.Release();
+            return false;
+        }
+
+        urb->Actual      = 0;
+        urb->Status      = 0;
+        urb->FirstTrb    = r->Enqueue;
+        urb->TrbCount    = 0;
+        urb->PacketsLeft = urb->PacketCount;
+        urb->Next        = nullptr;
+        bool firstCycle  = r->CCS;
+
+        if (r->Isoch) {
+            // One TD per packet. Every packet gets an event for its result,
+            // but only the last one interrupts.
+            uint64_t phys = urb->Segments[0].Phys;
+            for (uint32_t p = 0; p < urb->PacketCount; p++) {
+                IsoPacket& pkt = urb->Packets[p];
+                pkt.Actual = 0;
+                pkt.Status = 0;
+                uint32_t tdControl = TRB_IOC;
+                if (p + 1 < urb->PacketCount) tdControl |= TRB_BEI;
+                uint32_t remaining = pkt.Length;
+                uint32_t offset = 0;
+                PutBuffer(*r, urb, phys, pkt.Length, remaining, TRB_ISOCH, tdControl,
+                          offset, (uint16_t)p, true);
+                phys += pkt.Length;
+            }
+        } else {
+            uint32_t remaining = 0;
+            for (uint32_t s = 0; s < urb->SegmentCount; s++) {
+                remaining += urb->Segments[s].Length;
+            }
+            uint32_t offset = 0;
+            for (uint32_t s = 0; s < urb->SegmentCount; s++) {
+                const UrbSegment& seg = urb->Segments[s];
+                if (seg.Length == 0) continue;
+                PutBuffer(*r, urb, seg.Phys, seg.Length, remaining, TRB_NORMAL, TRB_IOC,
+                          offset, 0, true);
+            }
+            if (urb->TrbCount == 0) {
+                // Zero-length packet
+                PutBuffer(*r, urb, 0, 0, remaining, TRB_NORMAL, TRB_IOC, offset, 0, true);
+            }
+        }
+
+        if (r->Tail) {
+            r->Tail->Next = urb;
+        } else {
+            r->Head = urb;
+        }
+        r->Tail = urb;
+
+        // Hand the TD over: flip the first TRB's cycle bit last
+        asm volatile("" ::: "memory");
+        TRB& first = r->Ring[urb->FirstTrb];
+        if (firstCycle) {
+            first.Control |= TRB_CYCLE_BIT;
+        } else {
+            first.Control &= ~TRB_CYCLE_BIT;
+        }
+        g_urbLock.Release();
+
+        WriteDoorbell(urb->SlotId, urb->EpDci);
+        return true;
+    }
+
+    // -------------------------------------------------------------------------
+    // ResetEndpointRing
+    // -------------------------------------------------------------------------
+
+    bool ResetEndpointRing(uint8_t slotId, uint8_t dci) {
+        if (slotId == 0 || slotId > MAX_SLOTS || dci < 2 || dci > 31) return false;
+
+        g_urbLock.Acquire();
+        TransferRing* r = g_devices[slotId].EpRings[dci];
+        bool halted = r && r->Halted;
+        g_urbLock.Release();
+        if (r == nullptr) return false;
+
+        // A halted endpoint needs Reset Endpoint; a running one is stopped
+        TRB stopTrb = {};
+        stopTrb.Control = ((halted ? TRB_RESET_ENDPOINT : TRB_STOP_ENDPOINT) << TRB_TYPE_SHIFT)
+                        | ((uint32_t)slotId << 24)
+                        | ((uint32_t)dci << 16);
+        SendCommand(stopTrb);
+
+        g_urbLock.Acquire();
+        if (g_devices[slotId].EpRings[dci] != r) {
+            g_urbLock.Release();
+            return false;
+        }
+        Urb* cancelled = r->Head;
+        for (Urb* u = cancelled; u; u = u->Next) {
+            u->Status = CC_STOPPED;
+        }
+        for (uint32_t i = 0; i < EP_RING_SIZE; i++) {
+            r->Slots[i].Owner = nullptr;
+        }
+        r->Head = r->Tail = nullptr;
+        r->Free = EP_RING_SIZE - 1;
+        r->Halted = false;
+
+        uint64_t newDeq = r->Phys + (uint64_t)r->Enqueue * sizeof(TRB);
+        if (r->CCS) {
+            newDeq |= 1; // DCS bit
+        }
+        g_urbLock.Release();
+
+        TRB deqTrb = {};
+        deqTrb.Parameter0 = (uint32_t)(newDeq & 0xFFFFFFFF);
+        deqTrb.Parameter1 = (uint32_t)(newDeq >> 32);
+        deqTrb.Control    = (TRB_SET_TR_DEQUEUE << TRB_TYPE_SHIFT)
+                          | ((uint32_t)slotId << 24)
+                          | ((uint32_t)dci << 16);
+        uint32_t cc = SendCommand(deqTrb);
+
+        CompleteUrbs(cancelled);
+        return cc == CC_SUCCESS;
+    }
+
     // -------------------------------------------------------------------------
     // RegisterTransferCallback
     // -------------------------------------------------------------------------
@@ -724,12 +1285,33 @@ namespace Drivers::USB::Xhci {
     }
 
     // -------------------------------------------------------------------------
-    // ProcessDeferredWork - handle hot-plug outside interrupt context
+    // ProcessDeferredWork - handle hot-plug outside the event handler
     // Called from timer tick (same pattern as E1000E::Poll)
     // -------------------------------------------------------------------------
 
+    // Forget the device on `port` (0-based), if any: it was unplugged, or
+    // lost its enumeration across S3
+    static void DeactivatePortSlot(uint32_t port) {
+        for (uint8_t s = 1; s <= MAX_SLOTS; s++) {
+            if (g_devices[s].Active && g_devices[s].PortId == port + 1) {
+                g_devices[s].Active = false;
+                for (uint8_t dci = 2; dci < 32; dci++) {
+                    DestroyEndpointRing(s, dci);
+                }
+                KernelLogStream(INFO, "xHCI") << "Hot-unplug: slot "
+                    << base::dec << (uint64_t)s << " (port "
+                    << (uint64_t)(port + 1) << ") deactivated";
+                break;
+            }
+        }
+    }
+
     void ProcessDeferredWork() {
-        if (!g_initialized || !g_bootScanComplete) return;
+        if (!g_initialized || !g_bootScanComplete || g_suspended) return;
+
+        // Without MSI nothing else drains the event ring
+        if (!g_msiEnabled) PollEvents();
+
         if (g_hotplugProcessing) return;
         g_hotplugProcessing = true;
 
@@ -793,21 +1375,192 @@ namespace Drivers::USB::Xhci {
                 }
             } else {
                 // Device disconnected — deactivate its slot
-                for (uint8_t s = 1; s <= MAX_SLOTS; s++) {
-                    if (g_devices[s].Active && g_devices[s].PortId == port + 1) {
-                        g_devices[s].Active = false;
-                        KernelLogStream(INFO, "xHCI") << "Hot-unplug: slot "
-                            << base::dec << (uint64_t)s << " (port "
-                            << (uint64_t)(port + 1) << ") deactivated";
-                        break;
-                    }
-                }
+                DeactivatePortSlot(port);
             }
         }
 
         g_hotplugProcessing = false;
     }
 
+    // -------------------------------------------------------------------------
+    // S3 suspend/resume - Save and Restore State (xHCI spec 4.23.2)
+    // The controller keeps its slots, endpoints and port state in the save
+    // area, so devices that stayed connected need no enumeration on wake.
+    // -------------------------------------------------------------------------
+
+    static constexpr uint32_t PortReg(uint32_t port) {
+        return OP_PORTSC_BASE + port * OP_PORTSC_STRIDE;
+    }
+
+    // Poll USBSTS until the `mask` bits read as `set`. False on timeout.
+    static bool WaitStatus(uint32_t mask, bool set, uint64_t timeoutMs) {
+        uint64_t start = Timekeeping::GetMilliseconds();
+        for (;;) {
+            if (((ReadOp(OP_USBSTS) & mask) != 0) == set) return true;
+            if (Timekeeping::GetMilliseconds() - start >= timeoutMs) return false;
+            asm volatile("pause" ::: "memory");
+        }
+    }
+
+    static void WriteCommandRingPointer() {
+        uint64_t crcr = g_cmdRingPhys + (uint64_t)g_cmdRingEnqueue * sizeof(TRB);
+        if (g_cmdRingCCS) crcr |= TRB_CYCLE_BIT;
+        WriteOp(OP_CRCR, (uint32_t)(crcr & 0xFFFFFFFF));
+        WriteOp(OP_CRCR + 4, (uint32_t)(crcr >> 32));
+    }
+
+    static void WriteEventRingRegisters() {
+        uint64_t erdp = g_evtRingPhys + (uint64_t)g_evtRingDequeue * sizeof(TRB);
+        WriteRt(IR0_ERSTSZ, 1);
+        WriteRt(IR0_ERDP, (uint32_t)(erdp & 0xFFFFFFFF));
+        WriteRt(IR0_ERDP + 4, (uint32_t)(erdp >> 32));
+        WriteRt(IR0_ERSTBA, (uint32_t)(g_erstPhys & 0xFFFFFFFF));
+        WriteRt(IR0_ERSTBA + 4, (uint32_t)(g_erstPhys >> 32));
+    }
+
+    static void SuspendController() {
+        g_suspended = true;
+
+        // Put the enabled ports in U3 so their devices keep their addresses
+        for (uint32_t port = 0; port < g_maxPorts; port++) {
+            uint32_t portsc = ReadOp(PortReg(port));
+            if (!(portsc & PORTSC_PED)) continue;
+            if (((portsc & PORTSC_PLS_MASK) >> PLS_SHIFT) != PLS_U0) continue;
+            WriteOp(PortReg(port), (portsc & PORTSC_PRESERVE) | PORTSC_LWS | (PLS_U3 << PLS_SHIFT));
+        }
+        BusyWaitMs(10);
+
+        // Halt, then take in what the event ring still holds
+        WriteOp(OP_USBCMD, ReadOp(OP_USBCMD) & ~USBCMD_RS);
+        if (!WaitStatus(USBSTS_HCH, true, 20)) {
+            KernelLogStream(WARNING, "xHCI") << "Controller failed to halt for S3";
+        }
+        PollEvents();
+
+        g_savedDnctrl = ReadOp(OP_DNCTRL);
+        g_savedConfig = ReadOp(OP_CONFIG);
+        g_savedIman = ReadRt(IR0_IMAN);
+        g_savedImod = ReadRt(IR0_IMOD);
+
+        WriteOp(OP_USBCMD, ReadOp(OP_USBCMD) | USBCMD_CSS);
+        if (!WaitStatus(USBSTS_SSS, false, 100)) {
+            KernelLogStream(WARNING, "xHCI") << "Save state timed out";
+        }
+    }
+
+    // The save area did not survive: start over from a reset controller
+    // with empty rings, and let the hot-plug path enumerate every device
+    static void ResetAfterResume() {
+        WriteOp(OP_USBCMD, USBCMD_HCRST);
+        for (uint32_t i = 0; i < 100000; i++) {
+            if (!(ReadOp(OP_USBCMD) & USBCMD_HCRST)) break;
+            for (int j = 0; j < 10; j++) asm volatile("" ::: "memory");
+        }
+        WaitStatus(USBSTS_CNR, false, 1000);
+
+        for (uint32_t port = 0; port < g_maxPorts; port++) {
+            DeactivatePortSlot(port);
+        }
+        for (uint32_t s = 1; s <= g_maxSlots; s++) {
+            g_dcbaa[s] = 0;
+        }
+
+        WriteOp(OP_CONFIG, g_maxSlots);
+        WriteOp(OP_DCBAAP, (uint32_t)(g_dcbaaPhys & 0xFFFFFFFF));
+        WriteOp(OP_DCBAAP + 4, (uint32_t)(g_dcbaaPhys >> 32));
+
+        memset(g_cmdRing, 0, CMD_RING_SIZE * sizeof(TRB));
+        TRB& linkTrb = g_cmdRing[CMD_RING_SIZE - 1];
+        linkTrb.Parameter0 = (uint32_t)(g_cmdRingPhys & 0xFFFFFFFF);
+        linkTrb.Parameter1 = (uint32_t)(g_cmdRingPhys >> 32);
+        linkTrb.Control = (TRB_LINK << TRB_TYPE_SHIFT) | TRB_ENT;
+        g_cmdRingEnqueue = 0;
+        g_cmdRingCCS = true;
+        WriteCommandRingPointer();
+
+        memset(g_evtRing, 0, EVT_RING_SIZE * sizeof(TRB));
+        g_evtRingDequeue = 0;
+        g_evtRingCCS = true;
+        WriteEventRingRegisters();
+
+        WriteRt(IR0_IMAN, IMAN_IE);
+        WriteRt(IR0_IMOD, IMOD_INTERVAL);
+
+        for (uint32_t port = 0; port < g_maxPorts; port++) {
+            if (!(ReadOp(PortReg(port)) & PORTSC_PP)) WriteOp(PortReg(port), PORTSC_PP);
+        }
+    }
+
+    // Runs on its own thread after the desktop is back
+    static void ResumeController() {
+        // S3 clears PCI config space
+        Pci::EnableBusMaster(g_pciBus, g_pciDevice, g_pciFunction);
+        if (g_msiEnabled) {
+            uint8_t cap = Pci::FindCapability(g_pciBus, g_pciDevice, g_pciFunction, Pci::PCI_CAP_MSI);
+            if (cap != 0) ProgramMsi(g_pciBus, g_pciDevice, g_pciFunction, cap);
+        }
+
+        if (!WaitStatus(USBSTS_CNR, false, 1000)) {
+            KernelLogStream(ERROR, "xHCI") << "Controller not ready after S3, USB stays down";
+            return;
+        }
+
+        // Give the registers back what they held, then have the controller
+        // reload its internal state from the save area
+        WriteOp(OP_DNCTRL, g_savedDnctrl);
+        WriteCommandRingPointer();
+        WriteOp(OP_DCBAAP, (uint32_t)(g_dcbaaPhys & 0xFFFFFFFF));
+        WriteOp(OP_DCBAAP + 4, (uint32_t)(g_dcbaaPhys >> 32));
+        WriteOp(OP_CONFIG, g_savedConfig);
+        WriteEventRingRegisters();
+        WriteRt(IR0_IMAN, g_savedIman & IMAN_IE);
+        WriteRt(IR0_IMOD, g_savedImod);
+
+        WriteOp(OP_USBCMD, ReadOp(OP_USBCMD) | USBCMD_CRS);
+        bool restored = WaitStatus(USBSTS_RSS, false, 100);
+        if (!restored || (ReadOp(OP_USBSTS) & USBSTS_SRE)) {
+            KernelLogStream(WARNING, "xHCI") << "Controller state lost in S3, resetting";
+            ResetAfterResume();
+        }
+
+        WriteOp(OP_USBCMD, USBCMD_RS | USBCMD_INTE | USBCMD_HSEE);
+        WaitStatus(USBSTS_HCH, false, 20);
+
+        // Wake the suspended ports. USB3 links go straight to U0; USB2
+        // ports drive resume signaling for 20 ms first.
+        for (uint32_t port = 0; port < g_maxPorts; port++) {
+            uint32_t portsc = ReadOp(PortReg(port));
+            if (((portsc & PORTSC_PLS_MASK) >> PLS_SHIFT) != PLS_U3) continue;
+            uint32_t speed = (portsc & PORTSC_SPEED_MASK) >> 10;
+            uint32_t pls = speed >= SPEED_SUPER ? PLS_U0 : PLS_RESUME;
+            WriteOp(PortReg(port), (portsc & PORTSC_PRESERVE) | PORTSC_LWS | (pls << PLS_SHIFT));
+        }
+        BusyWaitMs(20);
+        for (uint32_t port = 0; port < g_maxPorts; port++) {
+            uint32_t portsc = ReadOp(PortReg(port));
+            if (((portsc & PORTSC_PLS_MASK) >> PLS_SHIFT) != PLS_RESUME) continue;
+            WriteOp(PortReg(port), (portsc & PORTSC_PRESERVE) | PORTSC_LWS | (PLS_U0 << PLS_SHIFT));
+        }
+        BusyWaitMs(10);
+
+        // Devices that went away or lost their link are dropped; the hot-plug
+        // path then picks up whatever is connected and not yet known
+        for (uint32_t port = 0; port < g_maxPorts; port++) {
+            uint32_t portsc = ReadOp(PortReg(port));
+            if (!(portsc & PORTSC_CCS) || !(portsc & PORTSC_PED)) DeactivatePortSlot(port);
+            g_hotplugPending[port] = true;
+        }
+        g_suspended = false;
+    }
+
+    static void RegisterPowerHooks(uint8_t bus, uint8_t dev, uint8_t func) {
+        g_pciBus = bus;
+        g_pciDevice = dev;
+        g_pciFunction = func;
+        Hal::AcpiSleep::RegisterDevice({"xHCI", SuspendController, ResumeController,
+                                        Hal::AcpiSleep::ResumeStage::Deferred});
+    }
+
     // -------------------------------------------------------------------------
     // Probe (called by PCI driver matching framework)
     // -------------------------------------------------------------------------
@@ -898,7 +1651,7 @@ namespace Drivers::USB::Xhci {
         WriteOp(OP_CONFIG, g_maxSlots);
 
         // Allocate DCBAA
-        g_dcbaa = (uint64_t*)AllocateDmaBuffer(g_dcbaaPhys);
+        g_dcbaa = (uint64_t*)Memory::Dma::Allocate(0x1000, g_dcbaaPhys);
         WriteOp(OP_DCBAAP, (uint32_t)(g_dcbaaPhys & 0xFFFFFFFF));
         WriteOp(OP_DCBAAP + 4, (uint32_t)(g_dcbaaPhys >> 32));
         KernelLogStream(OK, "xHCI") << "DCBAA at phys " << base::hex << g_dcbaaPhys;
@@ -906,10 +1659,10 @@ namespace Drivers::USB::Xhci {
         // Scratchpad buffers
         if (maxScratchpadBufs > 0) {
             uint64_t spArrayPhys;
-            g_scratchpadBufs = (uint64_t*)AllocateDmaBuffer(spArrayPhys);
+            g_scratchpadBufs = (uint64_t*)Memory::Dma::Allocate(0x1000, spArrayPhys);
             for (uint32_t i = 0; i < maxScratchpadBufs; i++) {
                 uint64_t bufPhys;
-                AllocateDmaBuffer(bufPhys);
+                Memory::Dma::Allocate(0x1000, bufPhys);
                 g_scratchpadBufs[i] = bufPhys;
             }
             g_dcbaa[0] = spArrayPhys;
@@ -917,7 +1670,7 @@ namespace Drivers::USB::Xhci {
         }
 
         // Command ring
-        g_cmdRing = (TRB*)AllocateDmaBuffer(g_cmdRingPhys);
+        g_cmdRing = (TRB*)Memory::Dma::Allocate(0x1000, g_cmdRingPhys);
         TRB& linkTrb = g_cmdRing[CMD_RING_SIZE - 1];
         linkTrb.Parameter0 = (uint32_t)(g_cmdRingPhys & 0xFFFFFFFF);
         linkTrb.Parameter1 = (uint32_t)(g_cmdRingPhys >> 32);
@@ -931,8 +1684,8 @@ namespace Drivers::USB::Xhci {
         KernelLogStream(OK, "xHCI") << "Command ring at phys " << base::hex << g_cmdRingPhys;
 
         // Event ring + ERST
-        g_evtRing = (TRB*)AllocateDmaBuffer(g_evtRingPhys);
-        g_erst = (ERSTEntry*)AllocateDmaBuffer(g_erstPhys);
+        g_evtRing = (TRB*)Memory::Dma::Allocate(0x1000, g_evtRingPhys);
+        g_erst = (ERSTEntry*)Memory::Dma::Allocate(0x1000, g_erstPhys);
         g_erst[0].RingSegmentBase = g_evtRingPhys;
         g_erst[0].RingSegmentSize = EVT_RING_SIZE;
         g_erst[0].Reserved = 0;
@@ -952,7 +1705,7 @@ namespace Drivers::USB::Xhci {
 
         // Enable interrupter 0
         WriteRt(IR0_IMAN, IMAN_IE);
-        WriteRt(IR0_IMOD, 0);
+        WriteRt(IR0_IMOD, IMOD_INTERVAL);
 
         // Start controller
         WriteOp(OP_USBCMD, USBCMD_RS | USBCMD_INTE | USBCMD_HSEE);
@@ -1018,6 +1771,7 @@ namespace Drivers::USB::Xhci {
         }
 
         g_bootScanComplete = true;
+        RegisterPowerHooks(dev.Bus, dev.Device, dev.Function);
         KernelLogStream(OK, "xHCI") << "Initialization complete";
         return true;
     }
@@ -1174,7 +1928,7 @@ namespace Drivers::USB::Xhci {
         // -----------------------------------------------------------------
         // Step 8: Allocate DCBAA
         // -----------------------------------------------------------------
-        g_dcbaa = (uint64_t*)AllocateDmaBuffer(g_dcbaaPhys);
+        g_dcbaa = (uint64_t*)Memory::Dma::Allocate(0x1000, g_dcbaaPhys);
 
         // Write DCBAAP (64-bit, split into two 32-bit writes)
         WriteOp(OP_DCBAAP, (uint32_t)(g_dcbaaPhys & 0xFFFFFFFF));
@@ -1187,11 +1941,11 @@ namespace Drivers::USB::Xhci {
         // -----------------------------------------------------------------
         if (maxScratchpadBufs > 0) {
             uint64_t spArrayPhys;
-            g_scratchpadBufs = (uint64_t*)AllocateDmaBuffer(spArrayPhys);
+            g_scratchpadBufs = (uint64_t*)Memory::Dma::Allocate(0x1000, spArrayPhys);
 
             for (uint32_t i = 0; i < maxScratchpadBufs; i++) {
                 uint64_t bufPhys;
-                AllocateDmaBuffer(bufPhys);
+                Memory::Dma::Allocate(0x1000, bufPhys);
                 g_scratchpadBufs[i] = bufPhys;
             }
 
@@ -1204,7 +1958,7 @@ namespace Drivers::USB::Xhci {
         // -----------------------------------------------------------------
         // Step 10: Command ring
         // -----------------------------------------------------------------
-        g_cmdRing = (TRB*)AllocateDmaBuffer(g_cmdRingPhys);
+        g_cmdRing = (TRB*)Memory::Dma::Allocate(0x1000, g_cmdRingPhys);
 
         // Set up Link TRB at the last position
         TRB& linkTrb = g_cmdRing[CMD_RING_SIZE - 1];
@@ -1227,8 +1981,8 @@ namespace Drivers::USB::Xhci {
         // -----------------------------------------------------------------
         // Step 11: Event ring + ERST
         // -----------------------------------------------------------------
-        g_evtRing = (TRB*)AllocateDmaBuffer(g_evtRingPhys);
-        g_erst = (ERSTEntry*)AllocateDmaBuffer(g_erstPhys);
+        g_evtRing = (TRB*)Memory::Dma::Allocate(0x1000, g_evtRingPhys);
+        g_erst = (ERSTEntry*)Memory::Dma::Allocate(0x1000, g_erstPhys);
 
         // Set up ERST entry 0
         g_erst[0].RingSegmentBase = g_evtRingPhys;
@@ -1262,7 +2016,7 @@ namespace Drivers::USB::Xhci {
         // Step 13: Enable interrupter 0
         // -----------------------------------------------------------------
         WriteRt(IR0_IMAN, IMAN_IE);
-        WriteRt(IR0_IMOD, 0); // No moderation
+        WriteRt(IR0_IMOD, IMOD_INTERVAL);
 
         // -----------------------------------------------------------------
         // Step 14: Start controller
@@ -1360,6 +2114,7 @@ namespace Drivers::USB::Xhci {
         }
 
         g_bootScanComplete = true;
+        RegisterPowerHooks(foundDev->Bus, foundDev->Device, foundDev->Function);
         KernelLogStream(OK, "xHCI") << "Initialization complete";
     }
 
@@ -19,6 +19,8 @@ namespace Drivers::USB::Xhci {
     constexpr uint32_t CMD_RING_SIZE   = 64;
     constexpr uint32_t EVT_RING_SIZE   = 64;
     constexpr uint32_t XFER_RING_SIZE  = 32;
+    constexpr uint32_t EP_RING_SIZE    = 256;   // URB endpoint rings: one page of TRBs
+    constexpr uint32_t MAX_EP_RINGS    = 64;
 
     // MSI configuration (E1000E uses IRQ 24/vector 56, we use 25/57)
     constexpr uint8_t  MSI_IRQ         = 25;
@@ -62,12 +64,17 @@ namespace Drivers::USB::Xhci {
     constexpr uint32_t USBCMD_HCRST    = (1 << 1);   // Host Controller Reset
     constexpr uint32_t USBCMD_INTE     = (1 << 2);   // Interrupter Enable
     constexpr uint32_t USBCMD_HSEE     = (1 << 3);   // Host System Error Enable
+    constexpr uint32_t USBCMD_CSS      = (1 << 8);   // Controller Save State
+    constexpr uint32_t USBCMD_CRS      = (1 << 9);   // Controller Restore State
 
     // USBSTS bits
     constexpr uint32_t USBSTS_HCH      = (1 << 0);   // HC Halted
     constexpr uint32_t USBSTS_HSE      = (1 << 2);   // Host System Error
     constexpr uint32_t USBSTS_EINT     = (1 << 3);   // Event Interrupt
     constexpr uint32_t USBSTS_PCD      = (1 << 4);   // Port Change Detect
+    constexpr uint32_t USBSTS_SSS      = (1 << 8);   // Save State Status
+    constexpr uint32_t USBSTS_RSS      = (1 << 9);   // Restore State Status
+    constexpr uint32_t USBSTS_SRE      = (1 << 10);  // Save/Restore Error
     constexpr uint32_t USBSTS_CNR      = (1 << 11);  // Controller Not Ready
 
     // PORTSC bits
@@ -76,6 +83,7 @@ namespace Drivers::USB::Xhci {
     constexpr uint32_t PORTSC_PR       = (1 << 4);   // Port Reset
     constexpr uint32_t PORTSC_PLS_MASK = (0xF << 5);  // Port Link State
     constexpr uint32_t PORTSC_PP       = (1 << 9);   // Port Power
+    constexpr uint32_t PORTSC_LWS      = (1 << 16);  // Port Link State Write Strobe
     constexpr uint32_t PORTSC_SPEED_MASK = (0xF << 10); // Port Speed
     constexpr uint32_t PORTSC_PRC      = (1 << 21);  // Port Reset Change
     constexpr uint32_t PORTSC_CSC      = (1 << 17);  // Connect Status Change
@@ -90,6 +98,12 @@ namespace Drivers::USB::Xhci {
     // Bits that must be preserved when writing PORTSC (RW1S/RW1CS excluded)
     constexpr uint32_t PORTSC_PRESERVE = PORTSC_PP;
 
+    // Port link states (PORTSC bits 8:5)
+    constexpr uint32_t PLS_SHIFT       = 5;
+    constexpr uint32_t PLS_U0          = 0;
+    constexpr uint32_t PLS_U3          = 3;    // Suspended
+    constexpr uint32_t PLS_RESUME      = 15;   // USB2 ports only
+
     // Port speed values (from PORTSC bits 13:10)
     constexpr uint32_t SPEED_FULL      = 1;
     constexpr uint32_t SPEED_LOW       = 2;
@@ -111,6 +125,10 @@ namespace Drivers::USB::Xhci {
     constexpr uint32_t IMAN_IP         = (1 << 0);   // Interrupt Pending
     constexpr uint32_t IMAN_IE         = (1 << 1);   // Interrupt Enable
 
+    // IMOD interval in 250 ns units: at most one interrupt per 250 us, well
+    // under the 1 ms a full-speed HID device can report at
+    constexpr uint32_t IMOD_INTERVAL   = 1000;
+
     // ---------------------------------------------------------------------------
     // TRB (Transfer Request Block) - 16 bytes
     // ---------------------------------------------------------------------------
@@ -128,6 +146,7 @@ namespace Drivers::USB::Xhci {
 
     // TRB types
     constexpr uint32_t TRB_NORMAL              = 1;
+    constexpr uint32_t TRB_ISOCH               = 5;
     constexpr uint32_t TRB_SETUP_STAGE         = 2;
     constexpr uint32_t TRB_DATA_STAGE          = 3;
     constexpr uint32_t TRB_STATUS_STAGE        = 4;
@@ -157,10 +176,25 @@ namespace Drivers::USB::Xhci {
     constexpr uint32_t TRB_ISP         = (1 << 2);   // Interrupt on Short Packet
     constexpr uint32_t TRB_CHAIN       = (1 << 4);   // Chain bit
     constexpr uint32_t TRB_ENT         = (1 << 1);   // Evaluate Next TRB
+    constexpr uint32_t TRB_TC          = (1 << 1);   // Toggle Cycle (Link TRB)
+    constexpr uint32_t TRB_BEI         = (1 << 9);   // Block Event Interrupt (Normal/Isoch)
+    constexpr uint32_t TRB_SIA         = (1u << 31); // Start Isoch ASAP
+    constexpr uint32_t TRB_TD_SIZE_SHIFT = 17;       // Status: packets left in the TD
+
+    // A TRB's data buffer may not cross a 64 KiB boundary
+    constexpr uint32_t TRB_MAX_BUFFER  = 0x10000;
 
     // Completion codes (from Status field bits 31:24)
     constexpr uint32_t CC_SUCCESS             = 1;
+    constexpr uint32_t CC_BABBLE              = 3;
+    constexpr uint32_t CC_USB_TRANSACTION     = 4;
+    constexpr uint32_t CC_STALL               = 6;
     constexpr uint32_t CC_SHORT_PACKET        = 13;
+    constexpr uint32_t CC_RING_UNDERRUN       = 14;
+    constexpr uint32_t CC_RING_OVERRUN        = 15;
+    constexpr uint32_t CC_MISSED_SERVICE      = 23;
+    constexpr uint32_t CC_STOPPED             = 26;
+    constexpr uint32_t CC_STOPPED_LEN_INVALID = 27;
 
     // ---------------------------------------------------------------------------
     // Event Ring Segment Table Entry
@@ -224,6 +258,55 @@ namespace Drivers::USB::Xhci {
         EndpointContext EP[31];
     } __attribute__((packed));
 
+    // ---------------------------------------------------------------------------
+    // Asynchronous transfers (URBs) on bulk, isochronous and interrupt endpoints
+    // ---------------------------------------------------------------------------
+
+    struct UrbSegment {
+        uint64_t Phys;
+        uint32_t Length;
+    };
+
+    struct IsoPacket {
+        uint32_t Length;
+        uint32_t Actual;      // set on completion
+        uint32_t Status;      // completion code, set on completion
+    };
+
+    struct Urb;
+    using UrbCallback = void (*)(Urb* urb);
+
+    // A transfer queued on an endpoint ring. The submitter owns the memory
+    // and must keep it (and the buffers) alive until Complete is called.
+    //
+    // Bulk and interrupt: the segments form one TD, chained TRB to TRB.
+    // Isochronous: Segments[0] is carved into PacketCount packets laid out
+    // back to back, each its own TD, all started as soon as possible.
+    struct Urb {
+        uint8_t           SlotId;
+        uint8_t           EpDci;
+        const UrbSegment* Segments;
+        uint32_t          SegmentCount;
+        IsoPacket*        Packets;
+        uint32_t          PacketCount;
+        UrbCallback       Complete;   // from the event handler, or from
+                                      // ResetEndpointRing/DestroyEndpointRing
+        void*             Context;
+
+        // Set on completion. Isochronous URBs report CC_SUCCESS here and
+        // per-packet results in Packets.
+        uint32_t          Actual;
+        uint32_t          Status;
+
+        // Host controller private
+        uint32_t          FirstTrb;
+        uint32_t          TrbCount;
+        uint32_t          PacketsLeft;
+        Urb*              Next;
+    };
+
+    struct TransferRing;
+
     // ---------------------------------------------------------------------------
     // Per-device tracking
     // ---------------------------------------------------------------------------
@@ -275,6 +358,9 @@ namespace Drivers::USB::Xhci {
         // Device context (output)
         DeviceContext* OutputContext;
         uint64_t       OutputContextPhys;
+
+        // URB rings, by DCI (see UsbDevice::OpenEndpoint)
+        TransferRing*  EpRings[32];
     };
 
     // ---------------------------------------------------------------------------
@@ -293,11 +379,14 @@ namespace Drivers::USB::Xhci {
     bool Probe(const Pci::PciDevice& dev);
     bool IsInitialized();
 
-    // Deferred hot-plug processing (call from timer tick, not interrupt context)
+    // Deferred hot-plug processing, from the BSP housekeeping tick. Also
+    // drains the event ring there when the controller has no MSI.
     void ProcessDeferredWork();
 
     // Send a command on the command ring, wait for completion.
-    // Returns completion code.
+    // Returns completion code. Callers in thread context sleep until the
+    // completion interrupt; during boot (or with interrupts off, or in
+    // poll mode) they spin on the event ring instead.
     uint32_t SendCommand(const TRB& trb);
 
     // Perform a control transfer on slot's EP0.
@@ -316,6 +405,27 @@ namespace Drivers::USB::Xhci {
     void QueueBulkInTransfer(uint8_t slotId, uint8_t* data, uint64_t dataPhys, uint32_t length);
     void QueueBulkOutTransfer(uint8_t slotId, uint8_t* data, uint64_t dataPhys, uint32_t length);
 
+    // Allocate a URB ring for endpoint `dci` of a slot. Returns its physical
+    // address (cycle state 1) for the endpoint context, or 0 on failure.
+    uint64_t CreateEndpointRing(uint8_t slotId, uint8_t dci, uint32_t epType, uint16_t maxPacket);
+
+    // Free a slot's URB ring, completing whatever is queued with CC_STOPPED
+    void DestroyEndpointRing(uint8_t slotId, uint8_t dci);
+
+    // Queue a URB on its endpoint ring. Returns false if the endpoint has no
+    // ring, is halted, or the ring has no room; Complete is not called then.
+    bool SubmitUrb(Urb* urb);
+
+    // Bring a URB ring back after a halt (or to cancel it): reset or stop the
+    // endpoint, move its dequeue pointer past everything queued and complete
+    // those URBs with CC_STOPPED. Thread context only.
+    bool ResetEndpointRing(uint8_t slotId, uint8_t dci);
+
+    // Wait up to `timeoutMs` for the event handler (a URB callback, say) to
+    // set `*done`, sleeping or spinning as SendCommand does. Returns
+    // whether it was set.
+    bool WaitCompletion(volatile uint32_t* done, uint64_t timeoutMs);
+
     // Register a transfer callback for a specific slot (used by non-HID class drivers)
     void RegisterTransferCallback(uint8_t slotId, TransferCallback cb);
 
@@ -325,7 +435,8 @@ namespace Drivers::USB::Xhci {
     // Access device info
     UsbDeviceInfo* GetDevice(uint8_t slotId);
 
-    // Poll event ring (called from interrupt handler or during init)
+    // Poll event ring (called from interrupt handler or during init).
+    // Returns at once if another CPU is already draining it.
     void PollEvents();
 
 };
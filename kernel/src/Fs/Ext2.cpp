@@ -7,6 +7,7 @@
 #include "Ext2.hpp"
 #include "FsProbe.hpp"
 #include <Drivers/Storage/BlockDevice.hpp>
+#include <Drivers/Storage/BufferCache.hpp>
 #include <Terminal/Terminal.hpp>
 #include <Libraries/Memory.hpp>
 #include <Memory/PageFrameAllocator.hpp>
@@ -24,6 +25,16 @@ namespace Fs::Ext2 {
     static constexpr int MaxDirEntries = 128;
     static constexpr int MaxNameLen = 256;
 
+    // Largest single read of a contiguous block run, and the largest
+    // readahead window of a sequentially read file
+    static constexpr uint32_t MaxRunBytes = 1024 * 1024;
+    static constexpr uint32_t MaxReadaheadBytes = 256 * 1024;
+    static constexpr uint32_t MinReadaheadBlocks = 4;
+
+    // Inodes kept in memory per volume, and block runs kept per open file
+    static constexpr int InodeCacheSize = 32;
+    static constexpr int MaxMapExtents = 64;
+
     static constexpr uint16_t EXT2_MAGIC = 0xEF53;
 
     // Inode types (from i_mode, upper 4 bits)
@@ -49,6 +60,18 @@ namespace Fs::Ext2 {
     // Special inode numbers
     static constexpr uint32_t EXT2_ROOT_INODE = 2;
 
+    // Hashed directory indexes
+    static constexpr uint32_t EXT2_FEATURE_COMPAT_DIR_INDEX = 0x0020;
+    static constexpr uint32_t EXT2_INDEX_FL = 0x1000;              // i_flags
+    static constexpr uint32_t EXT2_FLAGS_SIGNED_HASH = 0x0001;     // s_flags
+    static constexpr uint32_t EXT2_FLAGS_UNSIGNED_HASH = 0x0002;
+    static constexpr uint8_t DX_HASH_LEGACY   = 0;
+    static constexpr uint8_t DX_HASH_HALF_MD4 = 1;
+    static constexpr uint8_t DX_HASH_TEA      = 2;
+    static constexpr uint8_t DX_HASH_UNSIGNED = 3;    // Added for the unsigned-char variants
+    static constexpr uint32_t DxBlockMask = 0x0FFFFFFF;
+    static constexpr int DxMaxLevels = 2;             // The root and one level of nodes
+
     // =========================================================================
     // On-disk structures
     // =========================================================================
@@ -88,6 +111,29 @@ namespace Fs::Ext2 {
         uint32_t s_feature_ro_compat;
         uint8_t  s_uuid[16];
         char     s_volume_name[16];
+        char     s_last_mounted[64];
+        uint32_t s_algorithm_usage_bitmap;
+        uint8_t  s_prealloc_blocks;
+        uint8_t  s_prealloc_dir_blocks;
+        uint16_t s_reserved_gdt_blocks;
+        uint8_t  s_journal_uuid[16];
+        uint32_t s_journal_inum;
+        uint32_t s_journal_dev;
+        uint32_t s_last_orphan;
+        uint32_t s_hash_seed[4];
+        uint8_t  s_def_hash_version;
+        uint8_t  s_jnl_backup_type;
+        uint16_t s_desc_size;
+        uint32_t s_default_mount_opts;
+        uint32_t s_first_meta_bg;
+        uint32_t s_mkfs_time;
+        uint32_t s_jnl_blocks[17];
+        uint32_t s_blocks_count_hi;
+        uint32_t s_r_blocks_count_hi;
+        uint32_t s_free_blocks_hi;
+        uint16_t s_min_extra_isize;
+        uint16_t s_want_extra_isize;
+        uint32_t s_flags;
         // ... more fields follow but are not needed
     } __attribute__((packed));
 
@@ -131,15 +177,81 @@ namespace Fs::Ext2 {
         // name follows (up to 255 bytes, NOT null-terminated on disk)
     } __attribute__((packed));
 
+    // Follows the "." and ".." records in the first block of an indexed
+    // directory
+    struct DxRootInfo {
+        uint32_t reserved_zero;
+        uint8_t  hash_version;
+        uint8_t  info_length;      // 8
+        uint8_t  indirect_levels;
+        uint8_t  unused_flags;
+    } __attribute__((packed));
+
+    // An index entry. The first one of a block holds DxCountLimit in place
+    // of a hash; its block takes the hashes below the second entry's.
+    struct DxEntry {
+        uint32_t hash;
+        uint32_t block;            // Logical block of the directory
+    } __attribute__((packed));
+
+    struct DxCountLimit {
+        uint16_t limit;
+        uint16_t count;
+    } __attribute__((packed));
+
     // =========================================================================
     // Types
     // =========================================================================
 
-    struct Ext2File {
-        bool     inUse;
-        uint32_t inodeNum;
+    struct Readahead {
+        uint32_t nextBlock;    // Where a sequential read would start
+        uint32_t end;          // Blocks before this one have been prefetched
+        uint32_t window;       // In blocks; 0 while the access is not sequential
+    };
+
+    // In-memory allocation state of one block group. The bitmaps are read
+    // the first time the group is allocated from (or freed into) and kept;
+    // the dirty flags say what WriteBackAllocState still has to write.
+    struct GroupState {
+        uint8_t* blockBitmap;
+        uint8_t* inodeBitmap;
+        bool     blockDirty;
+        bool     inodeDirty;
+        bool     descDirty;      // This group's descriptor in `bgdt`
+    };
+
+    // A run of a file's blocks that are physically contiguous, or a hole
+    // (phys 0)
+    struct BlockExtent {
+        uint32_t logical;
+        uint32_t phys;
+        uint32_t count;
+    };
+
+    // The block pointers of an open file as runs, sorted by logical block.
+    // Filled lazily: a lookup that misses decodes the rest of the pointer
+    // block holding the wanted pointer, so a later one is a memory probe.
+    struct BlockMap {
+        BlockExtent extents[MaxMapExtents];
+        int         count;
+    };
+
+    struct CachedInode {
+        uint32_t inodeNum;       // 0 if the slot is free
+        uint32_t lastUse;
         Inode    inode;
-        bool     isDirectory;
+    };
+
+    struct Ext2File {
+        bool      inUse;
+        uint32_t  inodeNum;
+        Inode     inode;
+        bool      isDirectory;
+        Readahead ra;
+        BlockMap  map;
+        // Inode changed by writes since it was written back; kept until
+        // SyncImpl, even after the handle is closed
+        bool      inodeDirty;
     };
 
     struct Ext2Instance {
@@ -162,6 +274,16 @@ namespace Fs::Ext2 {
         BlockGroupDescriptor* bgdt;
         int bgdtPages;
 
+        // Per-group bitmaps (one entry per group)
+        GroupState* groups;
+        int groupsPages;
+
+        // Hashed directory indexes, if the volume has the dir_index feature
+        bool     dirIndex;
+        uint32_t hashSeed[4];
+        uint8_t  hashUnsigned;     // DX_HASH_UNSIGNED if names hash as unsigned chars
+        uint8_t  defHashVersion;   // For the indexes this driver builds
+
         // Temporary block buffer (one block, page-aligned)
         uint8_t* blockBuf;
         int      blockBufPages;
@@ -169,6 +291,10 @@ namespace Fs::Ext2 {
         // Open file handles
         Ext2File files[MaxFilesPerInstance];
 
+        // Recently used inodes, least recently used replaced first
+        CachedInode inodeCache[InodeCacheSize];
+        uint32_t    inodeTick;
+
         // ReadDir name cache
         char dirNames[MaxDirEntries][MaxNameLen];
         int  dirNameCount;
@@ -189,14 +315,14 @@ namespace Fs::Ext2 {
                                  uint32_t count, void* buf) {
         auto* dev = Drivers::Storage::GetBlockDevice(inst.blockDevIndex);
         if (!dev) return false;
-        return dev->ReadSectors(dev->Ctx, inst.partStartLba + partSector, count, buf);
+        return Drivers::Storage::BufferCache::Read(dev, inst.partStartLba + partSector, count, buf);
     }
 
     static bool WritePartSectors(const Ext2Instance& inst, uint64_t partSector,
                                   uint32_t count, const void* buf) {
         auto* dev = Drivers::Storage::GetBlockDevice(inst.blockDevIndex);
         if (!dev) return false;
-        return dev->WriteSectors(dev->Ctx, inst.partStartLba + partSector, count, buf);
+        return Drivers::Storage::BufferCache::Write(dev, inst.partStartLba + partSector, count, buf);
     }
 
     // Convert a block number to a partition-relative sector number
@@ -224,9 +350,44 @@ namespace Fs::Ext2 {
     // Inode operations
     // =========================================================================
 
+    static CachedInode* FindCachedInode(Ext2Instance& inst, uint32_t inodeNum) {
+        for (auto& cached : inst.inodeCache) {
+            if (cached.inodeNum == inodeNum) {
+                cached.lastUse = ++inst.inodeTick;
+                return &cached;
+            }
+        }
+        return nullptr;
+    }
+
+    static void CacheInode(Ext2Instance& inst, uint32_t inodeNum, const Inode& inode) {
+        CachedInode* slot = FindCachedInode(inst, inodeNum);
+        if (!slot) {
+            slot = &inst.inodeCache[0];
+            for (auto& cached : inst.inodeCache) {
+                if (cached.lastUse < slot->lastUse) slot = &cached;
+            }
+        }
+        slot->inodeNum = inodeNum;
+        slot->inode = inode;
+        slot->lastUse = ++inst.inodeTick;
+    }
+
     static bool ReadInode(Ext2Instance& inst, uint32_t inodeNum, Inode* out) {
         if (inodeNum == 0 || inodeNum > inst.totalInodes) return false;
 
+        // A file with writes not yet written back has the newest copy
+        for (auto& file : inst.files) {
+            if (file.inodeDirty && file.inodeNum == inodeNum) {
+                *out = file.inode;
+                return true;
+            }
+        }
+        if (CachedInode* cached = FindCachedInode(inst, inodeNum)) {
+            *out = cached->inode;
+            return true;
+        }
+
         uint32_t group = (inodeNum - 1) / inst.inodesPerGroup;
         uint32_t indexInGroup = (inodeNum - 1) % inst.inodesPerGroup;
 
@@ -240,6 +401,7 @@ namespace Fs::Ext2 {
         if (!ReadBlock(inst, inodeTableBlock + blockOffset, inst.blockBuf)) return false;
 
         memcpy(out, inst.blockBuf + offsetInBlock, sizeof(Inode));
+        CacheInode(inst, inodeNum, *out);
         return true;
     }
 
@@ -256,9 +418,16 @@ namespace Fs::Ext2 {
         uint32_t blockOffset = inodeByteOffset / inst.blockSize;
         uint32_t offsetInBlock = inodeByteOffset % inst.blockSize;
 
+        // The cache is written through; a failed write leaves the disk's
+        // copy to be read again
+        CachedInode* cached = FindCachedInode(inst, inodeNum);
+        if (cached) *cached = {};
+
         if (!ReadBlock(inst, inodeTableBlock + blockOffset, inst.blockBuf)) return false;
         memcpy(inst.blockBuf + offsetInBlock, inode, sizeof(Inode));
-        return WriteBlock(inst, inodeTableBlock + blockOffset, inst.blockBuf);
+        if (!WriteBlock(inst, inodeTableBlock + blockOffset, inst.blockBuf)) return false;
+        CacheInode(inst, inodeNum, *inode);
+        return true;
     }
 
     // =========================================================================
@@ -337,56 +506,295 @@ namespace Fs::Ext2 {
         return 0; // beyond addressable range
     }
 
+    // Read the block pointers that map logical block `logical`: the
+    // direct ones, or the indirect block holding its pointer, into
+    // inst.blockBuf. `first` is the logical block of ptrs[0]; ptrs is
+    // nullptr if all `count` blocks from `first` are a hole.
+    static bool LoadPointers(Ext2Instance& inst, const Inode& inode, uint32_t logical,
+                             const uint32_t*& ptrs, uint32_t& first, uint32_t& count) {
+        uint32_t ptrsPerBlock = inst.blockSize / 4;
+        if (logical < 12) {
+            memcpy(inst.blockBuf, inode.i_block, 12 * sizeof(uint32_t));
+            ptrs = (const uint32_t*)inst.blockBuf;
+            first = 0;
+            count = 12;
+            return true;
+        }
+
+        // Find the tree the pointer is in and how many blocks one pointer
+        // of its top block stands for
+        uint64_t index = logical - 12;
+        uint64_t base = 12;
+        uint64_t span = 1;
+        int level = 12;
+        while (index >= span * ptrsPerBlock) {
+            index -= span * ptrsPerBlock;
+            base += span * ptrsPerBlock;
+            span *= ptrsPerBlock;
+            if (++level > 14) return false;
+        }
+
+        uint32_t block = inode.i_block[level];
+        while (true) {
+            if (block == 0) {
+                uint64_t holeEnd = base + span * ptrsPerBlock;
+                ptrs = nullptr;
+                first = (uint32_t)base;
+                count = (uint32_t)((holeEnd > 0xFFFFFFFFull ? 0xFFFFFFFFull : holeEnd) - base);
+                return true;
+            }
+            if (!ReadBlock(inst, block, inst.blockBuf)) return false;
+            if (span == 1) {
+                ptrs = (const uint32_t*)inst.blockBuf;
+                first = (uint32_t)base;
+                count = ptrsPerBlock;
+                return true;
+            }
+
+            uint64_t slot = index / span;
+            memcpy(&block, inst.blockBuf + slot * 4, 4);
+            base += slot * span;
+            index %= span;
+            span /= ptrsPerBlock;
+        }
+    }
+
+    // Physical block of `logical` in an open file, 0 for a hole; `run` is
+    // set to how many blocks from there on continue the same run
+    static uint32_t MapBlock(Ext2Instance& inst, Ext2File& file, uint32_t logical, uint32_t& run) {
+        BlockMap& map = file.map;
+
+        // The first extent starting past `logical`
+        int pos = 0, hi = map.count;
+        while (pos < hi) {
+            int mid = (pos + hi) / 2;
+            if (map.extents[mid].logical <= logical) pos = mid + 1;
+            else hi = mid;
+        }
+        if (pos > 0) {
+            const BlockExtent& e = map.extents[pos - 1];
+            if (logical - e.logical < e.count) {
+                run = e.count - (logical - e.logical);
+                return e.phys ? e.phys + (logical - e.logical) : 0;
+            }
+        }
+
+        // A miss: decode the pointers from `logical` on as runs
+        const uint32_t* ptrs;
+        uint32_t first, count;
+        run = 1;
+        if (!LoadPointers(inst, file.inode, logical, ptrs, first, count)) return 0;
+
+        BlockExtent fresh[MaxMapExtents];
+        int n = 0;
+        if (ptrs == nullptr) {
+            fresh[n++] = { logical, 0, first + count - logical };
+        } else {
+            for (uint32_t i = logical - first; i < count; i++) {
+                BlockExtent* last = n > 0 ? &fresh[n - 1] : nullptr;
+                if (last && (ptrs[i] == 0 ? last->phys == 0
+                                          : last->phys != 0 && last->phys + last->count == ptrs[i])) {
+                    last->count++;
+                } else if (n < MaxMapExtents) {
+                    fresh[n++] = { first + i, ptrs[i], 1 };
+                } else {
+                    break;
+                }
+            }
+        }
+
+        // They replace the extents they overlap; a full map starts over
+        uint32_t end = fresh[n - 1].logical + fresh[n - 1].count;
+        int overlap = 0;
+        while (pos + overlap < map.count && map.extents[pos + overlap].logical < end) overlap++;
+        if (map.count - overlap + n > MaxMapExtents) {
+            map.count = 0;
+            pos = 0;
+            overlap = 0;
+        }
+        memmove(&map.extents[pos + n], &map.extents[pos + overlap],
+                (map.count - pos - overlap) * sizeof(BlockExtent));
+        memcpy(&map.extents[pos], fresh, n * sizeof(BlockExtent));
+        map.count += n - overlap;
+
+        run = fresh[0].count;
+        return fresh[0].phys;
+    }
+
+    // The block pointers of an inode changed: drop what open files mapped
+    static void InvalidateBlockMaps(Ext2Instance& inst, uint32_t inodeNum) {
+        for (auto& file : inst.files) {
+            if (file.inodeNum == inodeNum) file.map.count = 0;
+        }
+    }
+
+    // =========================================================================
+    // Allocation state
+    // =========================================================================
+
+    static uint8_t* AllocateBlockSized(const Ext2Instance& inst) {
+        int pages = ((int)inst.blockSize + 0xFFF) / 0x1000;
+        if (pages == 1) return (uint8_t*)Memory::g_pfa->AllocateZeroed();
+        return (uint8_t*)Memory::g_pfa->ReallocConsecutive(nullptr, pages);
+    }
+
+    static void FreeBlockSized(const Ext2Instance& inst, uint8_t* buf) {
+        Memory::g_pfa->Free(buf, ((int)inst.blockSize + 0xFFF) / 0x1000);
+    }
+
+    // The cached copy of a bitmap block, read on first use
+    static uint8_t* LoadBitmap(Ext2Instance& inst, uint8_t*& cached, uint32_t bitmapBlock) {
+        if (cached) return cached;
+        uint8_t* buf = AllocateBlockSized(inst);
+        if (!buf) return nullptr;
+        if (!ReadBlock(inst, bitmapBlock, buf)) {
+            FreeBlockSized(inst, buf);
+            return nullptr;
+        }
+        cached = buf;
+        return buf;
+    }
+
+    static uint8_t* BlockBitmap(Ext2Instance& inst, uint32_t g) {
+        return LoadBitmap(inst, inst.groups[g].blockBitmap, inst.bgdt[g].bg_block_bitmap);
+    }
+
+    static uint8_t* InodeBitmap(Ext2Instance& inst, uint32_t g) {
+        return LoadBitmap(inst, inst.groups[g].inodeBitmap, inst.bgdt[g].bg_inode_bitmap);
+    }
+
+    static bool TestBit(const uint8_t* bitmap, uint32_t bit) {
+        return bitmap[bit / 8] & (1 << (bit % 8));
+    }
+
+    static uint32_t BlocksInGroup(const Ext2Instance& inst, uint32_t g) {
+        // Last group may have fewer blocks
+        uint32_t remaining = inst.totalBlocks - inst.firstDataBlock - g * inst.blocksPerGroup;
+        return remaining < inst.blocksPerGroup ? remaining : inst.blocksPerGroup;
+    }
+
+    // Write the dirty bitmaps and descriptors back through the buffer
+    // cache. Called once at the end of every operation that allocates or
+    // frees, instead of after every bit.
+    static void WriteBackAllocState(Ext2Instance& inst) {
+        if (!inst.groups) return;
+
+        bool descDirty = false;
+        for (uint32_t g = 0; g < inst.groupCount; g++) {
+            GroupState& gs = inst.groups[g];
+            if (gs.blockDirty && WriteBlock(inst, inst.bgdt[g].bg_block_bitmap, gs.blockBitmap)) {
+                gs.blockDirty = false;
+            }
+            if (gs.inodeDirty && WriteBlock(inst, inst.bgdt[g].bg_inode_bitmap, gs.inodeBitmap)) {
+                gs.inodeDirty = false;
+            }
+            descDirty |= gs.descDirty;
+        }
+        if (!descDirty) return;
+
+        // Each descriptor table block that holds a changed descriptor
+        uint32_t bgdtBlock = inst.firstDataBlock + 1;
+        uint32_t perBlock = inst.blockSize / sizeof(BlockGroupDescriptor);
+        for (uint32_t first = 0; first < inst.groupCount; first += perBlock) {
+            uint32_t last = first + perBlock < inst.groupCount ? first + perBlock : inst.groupCount;
+            bool dirty = false;
+            for (uint32_t g = first; g < last; g++) dirty |= inst.groups[g].descDirty;
+            if (!dirty) continue;
+
+            uint32_t blockIdx = bgdtBlock + first / perBlock;
+            if (!ReadBlock(inst, blockIdx, inst.blockBuf)) continue;
+            memcpy(inst.blockBuf, &inst.bgdt[first], (last - first) * sizeof(BlockGroupDescriptor));
+            if (!WriteBlock(inst, blockIdx, inst.blockBuf)) continue;
+            for (uint32_t g = first; g < last; g++) inst.groups[g].descDirty = false;
+        }
+    }
+
     // =========================================================================
     // Block allocation
     // =========================================================================
 
-    static uint32_t AllocateBlock(Ext2Instance& inst, uint32_t preferGroup) {
-        // Try the preferred group first, then scan all groups
+    // The first free run in bits [start, end) of at least `want` bits, else
+    // the longest one there. Returns its length (0 if everything is used)
+    // and its start in `found`.
+    static uint32_t FindFreeRun(const uint8_t* bitmap, uint32_t start, uint32_t end,
+                                uint32_t want, uint32_t& found) {
+        uint32_t bestLen = 0;
+        uint32_t bit = start;
+        while (bit < end) {
+            // Skip fully used bytes
+            if (bit % 8 == 0 && bitmap[bit / 8] == 0xFF) {
+                bit += 8;
+                continue;
+            }
+            if (TestBit(bitmap, bit)) {
+                bit++;
+                continue;
+            }
+
+            uint32_t runStart = bit;
+            while (bit < end && bit - runStart < want && !TestBit(bitmap, bit)) bit++;
+            uint32_t len = bit - runStart;
+            if (len > bestLen) {
+                bestLen = len;
+                found = runStart;
+                if (len >= want) break;
+            }
+        }
+        return bestLen;
+    }
+
+    // Allocate up to `want` contiguous blocks, starting at `goal` if it is
+    // free (so a file grows in place), else at the first run of `want`
+    // free blocks in goal's group (or `preferGroup` without a goal) and
+    // then the following groups. Settles for the longest shorter run a
+    // group has. Returns the first block and sets `count`, or returns 0.
+    static uint32_t AllocateBlocks(Ext2Instance& inst, uint32_t goal, uint32_t preferGroup,
+                                   uint32_t want, uint32_t& count) {
+        count = 0;
+        if (want == 0) return 0;
+
+        uint32_t goalGroup = preferGroup % inst.groupCount;
+        uint32_t goalBit = 0;
+        if (goal >= inst.firstDataBlock && goal < inst.totalBlocks) {
+            goalGroup = (goal - inst.firstDataBlock) / inst.blocksPerGroup;
+            goalBit = (goal - inst.firstDataBlock) % inst.blocksPerGroup;
+        }
+
         for (uint32_t attempt = 0; attempt < inst.groupCount; attempt++) {
-            uint32_t g = (preferGroup + attempt) % inst.groupCount;
+            uint32_t g = (goalGroup + attempt) % inst.groupCount;
             if (inst.bgdt[g].bg_free_blocks_count == 0) continue;
 
-            uint32_t bitmapBlock = inst.bgdt[g].bg_block_bitmap;
-            if (!ReadBlock(inst, bitmapBlock, inst.blockBuf)) continue;
+            uint8_t* bitmap = BlockBitmap(inst, g);
+            if (!bitmap) continue;
 
-            uint32_t blocksInGroup = inst.blocksPerGroup;
-            // Last group may have fewer blocks
-            if (g == inst.groupCount - 1) {
-                uint32_t remaining = inst.totalBlocks - g * inst.blocksPerGroup;
-                if (remaining < blocksInGroup) blocksInGroup = remaining;
+            uint32_t blocksInGroup = BlocksInGroup(inst, g);
+            uint32_t first = 0, len = 0;
+            if (attempt == 0 && goalBit < blocksInGroup && !TestBit(bitmap, goalBit)) {
+                first = goalBit;
+                while (len < want && first + len < blocksInGroup && !TestBit(bitmap, first + len)) len++;
+            } else {
+                len = FindFreeRun(bitmap, 0, blocksInGroup, want, first);
             }
+            if (len == 0) continue;
 
-            for (uint32_t bit = 0; bit < blocksInGroup; bit++) {
-                uint32_t byteIdx = bit / 8;
-                uint8_t bitMask = 1 << (bit % 8);
-                if (!(inst.blockBuf[byteIdx] & bitMask)) {
-                    // Found a free block — mark it used
-                    inst.blockBuf[byteIdx] |= bitMask;
-                    if (!WriteBlock(inst, bitmapBlock, inst.blockBuf)) continue;
-
-                    inst.bgdt[g].bg_free_blocks_count--;
-
-                    // Write updated BGDT entry back to disk
-                    uint32_t bgdtBlock = inst.firstDataBlock + 1;
-                    uint32_t bgdtOffset = g * sizeof(BlockGroupDescriptor);
-                    uint32_t bgdtBlockIdx = bgdtBlock + bgdtOffset / inst.blockSize;
-                    uint32_t bgdtOffInBlock = bgdtOffset % inst.blockSize;
-
-                    uint8_t* tmpBuf = inst.blockBuf;
-                    if (ReadBlock(inst, bgdtBlockIdx, tmpBuf)) {
-                        memcpy(tmpBuf + bgdtOffInBlock, &inst.bgdt[g],
-                               sizeof(BlockGroupDescriptor));
-                        WriteBlock(inst, bgdtBlockIdx, tmpBuf);
-                    }
-
-                    return inst.firstDataBlock + g * inst.blocksPerGroup + bit;
-                }
+            for (uint32_t bit = first; bit < first + len; bit++) {
+                bitmap[bit / 8] |= 1 << (bit % 8);
             }
+            inst.bgdt[g].bg_free_blocks_count -= len;
+            inst.groups[g].blockDirty = true;
+            inst.groups[g].descDirty = true;
+
+            count = len;
+            return inst.firstDataBlock + g * inst.blocksPerGroup + first;
         }
         return 0; // no free blocks
     }
 
+    static uint32_t AllocateBlock(Ext2Instance& inst, uint32_t preferGroup) {
+        uint32_t count;
+        return AllocateBlocks(inst, 0, preferGroup, 1, count);
+    }
+
     static void FreeBlock(Ext2Instance& inst, uint32_t blockNum) {
         if (blockNum < inst.firstDataBlock || blockNum >= inst.totalBlocks) return;
 
@@ -396,27 +804,13 @@ namespace Fs::Ext2 {
 
         if (g >= inst.groupCount) return;
 
-        uint32_t bitmapBlock = inst.bgdt[g].bg_block_bitmap;
-        if (!ReadBlock(inst, bitmapBlock, inst.blockBuf)) return;
-
-        uint32_t byteIdx = bit / 8;
-        uint8_t bitMask = 1 << (bit % 8);
-        inst.blockBuf[byteIdx] &= ~bitMask;
-        WriteBlock(inst, bitmapBlock, inst.blockBuf);
+        uint8_t* bitmap = BlockBitmap(inst, g);
+        if (!bitmap || !TestBit(bitmap, bit)) return;
 
+        bitmap[bit / 8] &= ~(1 << (bit % 8));
         inst.bgdt[g].bg_free_blocks_count++;
-
-        // Write updated BGDT
-        uint32_t bgdtBlock = inst.firstDataBlock + 1;
-        uint32_t bgdtOffset = g * sizeof(BlockGroupDescriptor);
-        uint32_t bgdtBlockIdx = bgdtBlock + bgdtOffset / inst.blockSize;
-        uint32_t bgdtOffInBlock = bgdtOffset % inst.blockSize;
-
-        if (ReadBlock(inst, bgdtBlockIdx, inst.blockBuf)) {
-            memcpy(inst.blockBuf + bgdtOffInBlock, &inst.bgdt[g],
-                   sizeof(BlockGroupDescriptor));
-            WriteBlock(inst, bgdtBlockIdx, inst.blockBuf);
-        }
+        inst.groups[g].blockDirty = true;
+        inst.groups[g].descDirty = true;
     }
 
     // =========================================================================
@@ -428,33 +822,18 @@ namespace Fs::Ext2 {
             uint32_t g = (preferGroup + attempt) % inst.groupCount;
             if (inst.bgdt[g].bg_free_inodes_count == 0) continue;
 
-            uint32_t bitmapBlock = inst.bgdt[g].bg_inode_bitmap;
-            if (!ReadBlock(inst, bitmapBlock, inst.blockBuf)) continue;
-
-            for (uint32_t bit = 0; bit < inst.inodesPerGroup; bit++) {
-                uint32_t byteIdx = bit / 8;
-                uint8_t bitMask = 1 << (bit % 8);
-                if (!(inst.blockBuf[byteIdx] & bitMask)) {
-                    inst.blockBuf[byteIdx] |= bitMask;
-                    if (!WriteBlock(inst, bitmapBlock, inst.blockBuf)) continue;
-
-                    inst.bgdt[g].bg_free_inodes_count--;
+            uint8_t* bitmap = InodeBitmap(inst, g);
+            if (!bitmap) continue;
 
-                    // Write updated BGDT entry
-                    uint32_t bgdtBlock = inst.firstDataBlock + 1;
-                    uint32_t bgdtOffset = g * sizeof(BlockGroupDescriptor);
-                    uint32_t bgdtBlockIdx = bgdtBlock + bgdtOffset / inst.blockSize;
-                    uint32_t bgdtOffInBlock = bgdtOffset % inst.blockSize;
+            uint32_t bit;
+            if (FindFreeRun(bitmap, 0, inst.inodesPerGroup, 1, bit) == 0) continue;
 
-                    if (ReadBlock(inst, bgdtBlockIdx, inst.blockBuf)) {
-                        memcpy(inst.blockBuf + bgdtOffInBlock, &inst.bgdt[g],
-                               sizeof(BlockGroupDescriptor));
-                        WriteBlock(inst, bgdtBlockIdx, inst.blockBuf);
-                    }
+            bitmap[bit / 8] |= 1 << (bit % 8);
+            inst.bgdt[g].bg_free_inodes_count--;
+            inst.groups[g].inodeDirty = true;
+            inst.groups[g].descDirty = true;
 
-                    return g * inst.inodesPerGroup + bit + 1; // inodes are 1-based
-                }
-            }
+            return g * inst.inodesPerGroup + bit + 1; // inodes are 1-based
         }
         return 0;
     }
@@ -467,26 +846,13 @@ namespace Fs::Ext2 {
 
         if (g >= inst.groupCount) return;
 
-        uint32_t bitmapBlock = inst.bgdt[g].bg_inode_bitmap;
-        if (!ReadBlock(inst, bitmapBlock, inst.blockBuf)) return;
-
-        uint32_t byteIdx = bit / 8;
-        uint8_t bitMask = 1 << (bit % 8);
-        inst.blockBuf[byteIdx] &= ~bitMask;
-        WriteBlock(inst, bitmapBlock, inst.blockBuf);
+        uint8_t* bitmap = InodeBitmap(inst, g);
+        if (!bitmap || !TestBit(bitmap, bit)) return;
 
+        bitmap[bit / 8] &= ~(1 << (bit % 8));
         inst.bgdt[g].bg_free_inodes_count++;
-
-        uint32_t bgdtBlock = inst.firstDataBlock + 1;
-        uint32_t bgdtOffset = g * sizeof(BlockGroupDescriptor);
-        uint32_t bgdtBlockIdx = bgdtBlock + bgdtOffset / inst.blockSize;
-        uint32_t bgdtOffInBlock = bgdtOffset % inst.blockSize;
-
-        if (ReadBlock(inst, bgdtBlockIdx, inst.blockBuf)) {
-            memcpy(inst.blockBuf + bgdtOffInBlock, &inst.bgdt[g],
-                   sizeof(BlockGroupDescriptor));
-            WriteBlock(inst, bgdtBlockIdx, inst.blockBuf);
-        }
+        inst.groups[g].inodeDirty = true;
+        inst.groups[g].descDirty = true;
     }
 
     // =========================================================================
@@ -675,126 +1041,763 @@ namespace Fs::Ext2 {
             for (int i = 0; i < lastSlash && j < parentMax - 1; i++) {
                 parentPath[j++] = path[i];
             }
-            parentPath[j] = '\0';
+            parentPath[j] = '\0';
+
+            j = 0;
+            for (int i = lastSlash + 1; i < len && j < nameMax - 1; i++) {
+                fileName[j++] = path[i];
+            }
+            fileName[j] = '\0';
+        }
+    }
+
+    // =========================================================================
+    // Directory records
+    // =========================================================================
+
+    struct ParsedEntry {
+        char     name[MaxNameLen];
+        uint32_t inodeNum;
+        uint8_t  fileType;
+    };
+
+    static uint32_t RecordLength(uint32_t nameLen) {
+        return ((sizeof(DirEntry) + nameLen + 3) / 4) * 4; // 4-byte aligned
+    }
+
+    // Look for `name` among the records in the first `limit` bytes of a
+    // directory block
+    static bool FindInBlock(const uint8_t* buf, uint32_t limit, uint32_t blockSize,
+                            const char* name, uint32_t nameLen, ParsedEntry* out) {
+        uint32_t pos = 0;
+        while (pos + 8 <= limit) {
+            const DirEntry* de = (const DirEntry*)(buf + pos);
+            if (de->rec_len < 8 || pos + de->rec_len > blockSize) break;
+
+            if (de->inode != 0 && de->name_len == nameLen &&
+                memcmp((const uint8_t*)de + sizeof(DirEntry), name, nameLen) == 0) {
+                out->inodeNum = de->inode;
+                out->fileType = de->file_type;
+                memcpy(out->name, name, nameLen);
+                out->name[nameLen] = '\0';
+                return true;
+            }
+
+            pos += de->rec_len;
+        }
+        return false;
+    }
+
+    // Put a record for `name` in the first record of the block with
+    // enough slack; false if none has
+    static bool InsertInBlock(uint8_t* buf, uint32_t blockSize, uint32_t childInodeNum,
+                              const char* name, uint32_t nameLen, uint8_t fileType) {
+        uint32_t neededLen = RecordLength(nameLen);
+        uint32_t pos = 0;
+        while (pos + 8 <= blockSize) {
+            DirEntry* de = (DirEntry*)(buf + pos);
+            if (de->rec_len < 8 || pos + de->rec_len > blockSize) break;
+
+            // An unused record has its entire rec_len available
+            uint32_t actualLen = de->inode == 0 ? 0 : RecordLength(de->name_len);
+            if (de->rec_len - actualLen >= neededLen) {
+                if (de->inode != 0) {
+                    // Split this entry
+                    uint16_t oldRecLen = de->rec_len;
+                    de->rec_len = (uint16_t)actualLen;
+                    de = (DirEntry*)(buf + pos + actualLen);
+                    de->rec_len = (uint16_t)(oldRecLen - actualLen);
+                }
+                de->inode = childInodeNum;
+                de->name_len = (uint8_t)nameLen;
+                de->file_type = fileType;
+                memcpy((uint8_t*)de + sizeof(DirEntry), name, nameLen);
+                return true;
+            }
+
+            pos += de->rec_len;
+        }
+        return false;
+    }
+
+    // Drop the record for `name` from a directory block, merging it into
+    // the one before
+    static bool RemoveFromBlock(uint8_t* buf, uint32_t limit, uint32_t blockSize,
+                                const char* name, uint32_t nameLen) {
+        uint32_t pos = 0;
+        DirEntry* prevDe = nullptr;
+        while (pos + 8 <= limit) {
+            DirEntry* de = (DirEntry*)(buf + pos);
+            if (de->rec_len < 8 || pos + de->rec_len > blockSize) break;
+
+            if (de->inode != 0 && de->name_len == nameLen &&
+                memcmp((uint8_t*)de + sizeof(DirEntry), name, nameLen) == 0) {
+                if (prevDe) {
+                    prevDe->rec_len += de->rec_len;
+                } else {
+                    // First entry in block — just zero the inode
+                    de->inode = 0;
+                }
+                return true;
+            }
+
+            prevDe = de;
+            pos += de->rec_len;
+        }
+        return false;
+    }
+
+    // Where a directory record lives before PackRecords lays it out again
+    struct RecordRef {
+        uint32_t hash;
+        uint16_t offset;
+        uint16_t length;           // Without slack
+    };
+
+    // Lay the records `refs` points to in `src` out back to back in `dst`,
+    // the last one taking the rest of the block
+    static void PackRecords(uint8_t* dst, const uint8_t* src, const RecordRef* refs, int count,
+                            uint32_t blockSize) {
+        memset(dst, 0, blockSize);
+        DirEntry* last = (DirEntry*)dst;
+        uint32_t pos = 0;
+        for (int i = 0; i < count; i++) {
+            last = (DirEntry*)(dst + pos);
+            memcpy(last, src + refs[i].offset, refs[i].length);
+            last->rec_len = refs[i].length;
+            pos += refs[i].length;
+        }
+        last->rec_len = (uint16_t)(blockSize - pos + (count > 0 ? last->rec_len : 0));
+    }
+
+    // Map a new block, already holding `content`, at the end of a
+    // directory. Returns its logical index and physical number.
+    static bool AppendDirBlock(Ext2Instance& inst, uint32_t dirInodeNum, Inode& dirInode,
+                               const uint8_t* content, uint32_t& logical, uint32_t& phys) {
+        uint32_t blockSize = inst.blockSize;
+        uint32_t group = (dirInodeNum - 1) / inst.inodesPerGroup;
+        logical = (dirInode.i_size + blockSize - 1) / blockSize;
+        phys = AllocateBlock(inst, group);
+        if (phys == 0) return false;
+
+        if (!WriteBlock(inst, phys, content) ||
+            !SetPhysicalBlock(inst, dirInode, logical, phys, group)) {
+            FreeBlock(inst, phys);
+            return false;
+        }
+
+        dirInode.i_size += blockSize;
+        dirInode.i_blocks += blockSize / 512;
+        WriteInode(inst, dirInodeNum, &dirInode);
+        return true;
+    }
+
+    // =========================================================================
+    // Hashed directory index (HTree)
+    // =========================================================================
+
+    // A directory with EXT2_INDEX_FL keeps an index of name hashes in its
+    // first block, after the "." and ".." records (the dx_root), and for a
+    // larger directory in a level of interior blocks (dx_nodes), each
+    // disguised as one unused record spanning the block. An index entry
+    // sends the hashes from its own up to the next entry's to a leaf, an
+    // ordinary block of records; the low bit of an entry's hash says the
+    // leaf before it ends with names of that same hash. A lookup reads one
+    // block per level and (barring collisions) one leaf, instead of all of
+    // the directory.
+    //
+    // Leaves split in two by hash when they fill up, and the index grows a
+    // level when the root does. An index that is damaged, deeper than two
+    // levels or full is dropped instead (EXT2_INDEX_FL is cleared, as
+    // drivers that do not know about indexes do, and e2fsck -D rebuilds
+    // it); the directory is then searched record by record.
+
+    static void Str2HashBuf(const char* msg, int len, uint32_t* buf, int num, bool unsignedChars) {
+        uint32_t pad = (uint32_t)len | ((uint32_t)len << 8);
+        pad |= pad << 16;
+
+        uint32_t val = pad;
+        if (len > num * 4) len = num * 4;
+        for (int i = 0; i < len; i++) {
+            int c = unsignedChars ? (int)(uint8_t)msg[i] : (int)(int8_t)msg[i];
+            val = (uint32_t)c + (val << 8);
+            if (i % 4 == 3) {
+                *buf++ = val;
+                val = pad;
+                num--;
+            }
+        }
+        if (--num >= 0) *buf++ = val;
+        while (--num >= 0) *buf++ = pad;
+    }
+
+    static uint32_t Rol32(uint32_t x, int s) {
+        return (x << s) | (x >> (32 - s));
+    }
+
+    // The three rounds of MD4, cut down to 8 steps each
+    static void HalfMd4Transform(uint32_t buf[4], const uint32_t in[8]) {
+        static const uint8_t order[3][8] = {
+            { 0, 1, 2, 3, 4, 5, 6, 7 },
+            { 1, 3, 5, 7, 0, 2, 4, 6 },
+            { 3, 7, 2, 6, 1, 5, 0, 4 },
+        };
+        static const uint8_t shift[3][4] = { { 3, 7, 11, 19 }, { 3, 5, 9, 13 }, { 3, 9, 11, 15 } };
+        static const uint32_t constant[3] = { 0, 0x5A827999, 0x6ED9EBA1 };
+
+        uint32_t v[4] = { buf[0], buf[1], buf[2], buf[3] };
+        for (int round = 0; round < 3; round++) {
+            for (int i = 0; i < 8; i++) {
+                // Steps update a, d, c, b in turn from the other three
+                int t = (4 - i % 4) % 4;
+                uint32_t x = v[(t + 1) % 4], y = v[(t + 2) % 4], z = v[(t + 3) % 4];
+                uint32_t f = round == 0 ? (z ^ (x & (y ^ z)))
+                           : round == 1 ? ((x & y) + ((x ^ y) & z))
+                           : (x ^ y ^ z);
+                v[t] = Rol32(v[t] + f + in[order[round][i]] + constant[round], shift[round][i % 4]);
+            }
+        }
+        for (int i = 0; i < 4; i++) buf[i] += v[i];
+    }
+
+    static void TeaTransform(uint32_t buf[4], const uint32_t in[4]) {
+        uint32_t sum = 0, b0 = buf[0], b1 = buf[1];
+        for (int n = 0; n < 16; n++) {
+            sum += 0x9E3779B9;
+            b0 += ((b1 << 4) + in[0]) ^ (b1 + sum) ^ ((b1 >> 5) + in[1]);
+            b1 += ((b0 << 4) + in[2]) ^ (b0 + sum) ^ ((b0 >> 5) + in[3]);
+        }
+        buf[0] += b0;
+        buf[1] += b1;
+    }
+
+    static uint32_t LegacyHash(const char* name, int len, bool unsignedChars) {
+        uint32_t hash0 = 0x12A3FE2D, hash1 = 0x37ABE8F9;
+        for (int i = 0; i < len; i++) {
+            int c = unsignedChars ? (int)(uint8_t)name[i] : (int)(int8_t)name[i];
+            uint32_t hash = hash1 + (hash0 ^ (uint32_t)(c * 7152373));
+            if (hash & 0x80000000) hash -= 0x7FFFFFFF;
+            hash1 = hash0;
+            hash0 = hash;
+        }
+        return hash0 << 1;
+    }
+
+    // The hash of a name under an index's hash version (including the
+    // unsigned offset), low bit clear
+    static uint32_t DxHash(const Ext2Instance& inst, uint8_t version, const char* name, int len) {
+        uint32_t buf[4] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476 };
+        if (inst.hashSeed[0] | inst.hashSeed[1] | inst.hashSeed[2] | inst.hashSeed[3]) {
+            memcpy(buf, inst.hashSeed, sizeof(buf));
+        }
+
+        bool unsignedChars = version >= DX_HASH_UNSIGNED;
+        uint32_t hash;
+        uint32_t in[8];
+        switch (version % DX_HASH_UNSIGNED) {
+        case DX_HASH_LEGACY:
+            hash = LegacyHash(name, len, unsignedChars);
+            break;
+        case DX_HASH_HALF_MD4:
+            for (; len > 0; len -= 32, name += 32) {
+                Str2HashBuf(name, len, in, 8, unsignedChars);
+                HalfMd4Transform(buf, in);
+            }
+            hash = buf[1];
+            break;
+        default:
+            for (; len > 0; len -= 16, name += 16) {
+                Str2HashBuf(name, len, in, 4, unsignedChars);
+                TeaTransform(buf, in);
+            }
+            hash = buf[0];
+            break;
+        }
+
+        // The largest hash is kept free as an end-of-directory marker
+        hash &= ~1u;
+        if (hash == 0xFFFFFFFE) hash = 0xFFFFFFFC;
+        return hash;
+    }
+
+    struct DxFrame {
+        uint8_t* buf;              // The index block
+        uint32_t phys;
+        DxEntry* entries;
+        DxEntry* at;               // The entry whose range holds the hash
+    };
+
+    // The index blocks from the root down to a leaf
+    struct DxPath {
+        DxFrame  frames[DxMaxLevels];
+        int      levels;
+        uint8_t  version;
+        uint32_t hash;
+    };
+
+    static uint16_t DxCount(const DxEntry* entries) { return ((const DxCountLimit*)entries)->count; }
+    static uint16_t DxLimit(const DxEntry* entries) { return ((const DxCountLimit*)entries)->limit; }
+    static void DxSetCount(DxEntry* entries, uint16_t count) { ((DxCountLimit*)entries)->count = count; }
+
+    static uint16_t DxRootLimit(const Ext2Instance& inst) {
+        return (uint16_t)((inst.blockSize - 24 - sizeof(DxRootInfo)) / sizeof(DxEntry));
+    }
+
+    static uint16_t DxNodeLimit(const Ext2Instance& inst) {
+        return (uint16_t)((inst.blockSize - sizeof(DirEntry)) / sizeof(DxEntry));
+    }
+
+    static void DxRelease(const Ext2Instance& inst, DxPath& path) {
+        for (int i = 0; i < DxMaxLevels; i++) {
+            if (path.frames[i].buf) FreeBlockSized(inst, path.frames[i].buf);
+            path.frames[i].buf = nullptr;
+        }
+    }
+
+    static bool DxAllocate(const Ext2Instance& inst, DxPath& path) {
+        path = {};
+        for (int i = 0; i < DxMaxLevels; i++) {
+            path.frames[i].buf = AllocateBlockSized(inst);
+            if (!path.frames[i].buf) {
+                DxRelease(inst, path);
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // The last entry whose hash is not above `hash`
+    static DxEntry* DxSearch(DxEntry* entries, uint32_t hash) {
+        DxEntry* p = entries + 1;
+        DxEntry* q = entries + DxCount(entries) - 1;
+        while (p <= q) {
+            DxEntry* m = p + (q - p) / 2;
+            if (m->hash > hash) q = m - 1;
+            else p = m + 1;
+        }
+        return p - 1;
+    }
+
+    static bool DxLoadNode(Ext2Instance& inst, const Inode& dir, uint32_t logical, DxFrame& frame) {
+        logical &= DxBlockMask;
+        if (logical == 0 || logical >= (dir.i_size + inst.blockSize - 1) / inst.blockSize) return false;
+
+        frame.phys = GetPhysicalBlock(inst, dir, logical);
+        if (frame.phys == 0 || !ReadBlock(inst, frame.phys, frame.buf)) return false;
+        frame.entries = (DxEntry*)(frame.buf + sizeof(DirEntry));
+        uint16_t count = DxCount(frame.entries);
+        return DxLimit(frame.entries) == DxNodeLimit(inst) && count > 0 && count <= DxNodeLimit(inst);
+    }
+
+    // Walk the index of `dir` down to the leaf that would hold `name`.
+    // False if the directory has no index this driver can use.
+    static bool DxProbe(Ext2Instance& inst, const Inode& dir, const char* name, int len, DxPath& path) {
+        if (!inst.dirIndex || !(dir.i_flags & EXT2_INDEX_FL)) return false;
+
+        DxFrame& root = path.frames[0];
+        root.phys = GetPhysicalBlock(inst, dir, 0);
+        if (root.phys == 0 || !ReadBlock(inst, root.phys, root.buf)) return false;
+
+        const DxRootInfo* info = (const DxRootInfo*)(root.buf + 24);
+        if (info->reserved_zero != 0 || info->info_length != sizeof(DxRootInfo)) return false;
+        if (info->hash_version > DX_HASH_TEA || info->indirect_levels >= DxMaxLevels) return false;
+
+        root.entries = (DxEntry*)(root.buf + 24 + sizeof(DxRootInfo));
+        uint16_t count = DxCount(root.entries);
+        if (DxLimit(root.entries) != DxRootLimit(inst) || count == 0 || count > DxRootLimit(inst)) {
+            return false;
+        }
+
+        path.levels = info->indirect_levels + 1;
+        path.version = info->hash_version + inst.hashUnsigned;
+        path.hash = DxHash(inst, path.version, name, len);
+
+        for (int level = 0; ; level++) {
+            DxFrame& frame = path.frames[level];
+            frame.at = DxSearch(frame.entries, path.hash);
+            if (level + 1 == path.levels) return true;
+            if (!DxLoadNode(inst, dir, frame.at->block, path.frames[level + 1])) return false;
+        }
+    }
+
+    static uint32_t DxLeaf(const DxPath& path) {
+        return path.frames[path.levels - 1].at->block & DxBlockMask;
+    }
+
+    // Move to the next leaf if it continues the names of the probed hash
+    static bool DxNextLeaf(Ext2Instance& inst, const Inode& dir, DxPath& path) {
+        int level = path.levels - 1;
+        while (level >= 0 && path.frames[level].at + 1 ==
+                                 path.frames[level].entries + DxCount(path.frames[level].entries)) {
+            level--;
+        }
+        if (level < 0) return false;
+
+        DxFrame& frame = path.frames[level];
+        if ((frame.at[1].hash & ~1u) != path.hash) return false;
+        frame.at++;
+
+        for (; level + 1 < path.levels; level++) {
+            if (!DxLoadNode(inst, dir, path.frames[level].at->block, path.frames[level + 1])) return false;
+            path.frames[level + 1].at = path.frames[level + 1].entries;
+        }
+        return true;
+    }
+
+    // Call `visit(phys, limit)` with each directory block that may hold
+    // `name` read into `buf` (of which the first `limit` bytes are in
+    // use), until it returns true: the leaves the index leads to, or every
+    // block if there is no usable index.
+    template<typename Visit>
+    static bool VisitNameBlocks(Ext2Instance& inst, const Inode& dirInode, const char* name,
+                                uint32_t nameLen, uint8_t* buf, Visit visit) {
+        uint32_t blockSize = inst.blockSize;
+        uint32_t numBlocks = (dirInode.i_size + blockSize - 1) / blockSize;
+
+        DxPath path;
+        if ((dirInode.i_flags & EXT2_INDEX_FL) && DxAllocate(inst, path)) {
+            bool indexed = DxProbe(inst, dirInode, name, (int)nameLen, path);
+            bool found = false;
+            while (indexed && !found) {
+                uint32_t leaf = DxLeaf(path);
+                uint32_t physBlock = leaf < numBlocks ? GetPhysicalBlock(inst, dirInode, leaf) : 0;
+                if (physBlock != 0 && ReadBlock(inst, physBlock, buf)) found = visit(physBlock, blockSize);
+                if (!found && !DxNextLeaf(inst, dirInode, path)) break;
+            }
+            DxRelease(inst, path);
+            if (indexed) return found;
+        }
+
+        for (uint32_t bi = 0; bi < numBlocks; bi++) {
+            uint32_t physBlock = GetPhysicalBlock(inst, dirInode, bi);
+            if (physBlock == 0) continue;
+            if (!ReadBlock(inst, physBlock, buf)) continue;
+
+            uint32_t remaining = dirInode.i_size - bi * blockSize;
+            if (remaining > blockSize) remaining = blockSize;
+            if (visit(physBlock, remaining)) return true;
+        }
+        return false;
+    }
+
+    // Insert a new entry (hash and block) after the frame's current one
+    static void DxInsertEntry(DxFrame& frame, uint32_t hash, uint32_t block) {
+        uint16_t count = DxCount(frame.entries);
+        DxEntry* slot = frame.at + 1;
+        memmove(slot + 1, slot, (uint8_t*)(frame.entries + count) - (uint8_t*)slot);
+        slot->hash = hash;
+        slot->block = block;
+        DxSetCount(frame.entries, count + 1);
+    }
+
+    static void DxInitNode(const Ext2Instance& inst, uint8_t* buf) {
+        memset(buf, 0, inst.blockSize);
+        DirEntry* fake = (DirEntry*)buf;
+        fake->rec_len = (uint16_t)inst.blockSize;
+    }
+
+    // Make room for one more entry in the deepest index block of `path`:
+    // move the entries of a full root down into a new node, or split a
+    // full node in two. Returns 1 once there is room, 0 (having changed
+    // nothing) if the index is as large as it gets, -1 on failure.
+    static int DxGrow(Ext2Instance& inst, uint32_t dirInodeNum, Inode& dir, DxPath& path) {
+        DxFrame& root = path.frames[0];
+        DxFrame& node = path.frames[1];
+
+        if (path.levels == 1) {
+            uint16_t count = DxCount(root.entries);
+            DxInitNode(inst, node.buf);
+            node.entries = (DxEntry*)(node.buf + sizeof(DirEntry));
+            memcpy(node.entries, root.entries, count * sizeof(DxEntry));
+            ((DxCountLimit*)node.entries)->limit = DxNodeLimit(inst);
+
+            uint32_t logical;
+            if (!AppendDirBlock(inst, dirInodeNum, dir, node.buf, logical, node.phys)) return -1;
+            node.at = node.entries + (root.at - root.entries);
+
+            DxSetCount(root.entries, 1);
+            root.entries[0].block = logical;
+            root.at = root.entries;
+            ((DxRootInfo*)(root.buf + 24))->indirect_levels = 1;
+            path.levels = 2;
+            return WriteBlock(inst, root.phys, root.buf) ? 1 : -1;
+        }
+
+        if (DxCount(root.entries) == DxLimit(root.entries)) return 0;
+
+        uint8_t* upper = AllocateBlockSized(inst);
+        if (!upper) return -1;
+
+        uint16_t count = DxCount(node.entries);
+        uint16_t half = count / 2;
+        DxInitNode(inst, upper);
+        DxEntry* upperEntries = (DxEntry*)(upper + sizeof(DirEntry));
+        memcpy(upperEntries, node.entries + half, (count - half) * sizeof(DxEntry));
+        uint32_t hash2 = node.entries[half].hash;
+        ((DxCountLimit*)upperEntries)->limit = DxNodeLimit(inst);
+        DxSetCount(upperEntries, count - half);
+
+        uint32_t logical, phys;
+        if (!AppendDirBlock(inst, dirInodeNum, dir, upper, logical, phys)) {
+            FreeBlockSized(inst, upper);
+            return -1;
+        }
+        DxSetCount(node.entries, half);
+        bool written = WriteBlock(inst, node.phys, node.buf);
+        DxInsertEntry(root, hash2, logical);
+        written = WriteBlock(inst, root.phys, root.buf) && written;
+
+        // Follow the hash into whichever half holds it now
+        if (node.at >= node.entries + half) {
+            int index = (int)(node.at - node.entries) - half;
+            FreeBlockSized(inst, node.buf);
+            node.buf = upper;
+            node.phys = phys;
+            node.entries = upperEntries;
+            node.at = upperEntries + index;
+            root.at++;
+        } else {
+            FreeBlockSized(inst, upper);
+        }
+        return written ? 1 : -1;
+    }
+
+    // Split the full leaf in `leaf` in two by hash, with the new entry
+    // going to the half its hash falls in
+    static int DxSplitLeaf(Ext2Instance& inst, uint32_t dirInodeNum, Inode& dir, DxPath& path,
+                           uint8_t* leaf, uint32_t leafPhys, uint32_t childInodeNum,
+                           const char* name, uint32_t nameLen, uint8_t fileType) {
+        uint32_t blockSize = inst.blockSize;
+        uint8_t* copy = AllocateBlockSized(inst);
+        uint8_t* upper = AllocateBlockSized(inst);
+        RecordRef* refs = (RecordRef*)AllocateBlockSized(inst);
+        int result = -1;
+        if (!copy || !upper || !refs) goto done;
+
+        {
+            // Records are at least 12 bytes, so their refs fit a block
+            memcpy(copy, leaf, blockSize);
+            int count = 0;
+            uint32_t pos = 0;
+            while (pos + 8 <= blockSize) {
+                const DirEntry* de = (const DirEntry*)(copy + pos);
+                if (de->rec_len < 8 || pos + de->rec_len > blockSize) break;
+                if (de->inode != 0) {
+                    refs[count++] = { DxHash(inst, path.version, (const char*)de + sizeof(DirEntry), de->name_len),
+                                      (uint16_t)pos, (uint16_t)RecordLength(de->name_len) };
+                }
+                pos += de->rec_len;
+            }
+            if (count < 2) goto done;
+
+            for (int i = 1; i < count; i++) {
+                RecordRef ref = refs[i];
+                int j = i - 1;
+                while (j >= 0 && refs[j].hash > ref.hash) {
+                    refs[j + 1] = refs[j];
+                    j--;
+                }
+                refs[j + 1] = ref;
+            }
+
+            // A hash shared across the split marks the upper half as continued
+            int split = count / 2;
+            uint32_t hash2 = refs[split].hash;
+            uint32_t continued = refs[split - 1].hash == hash2 ? 1 : 0;
+
+            PackRecords(upper, copy, refs + split, count - split, blockSize);
+            PackRecords(leaf, copy, refs, split, blockSize);
+            if (!InsertInBlock(path.hash >= hash2 ? upper : leaf, blockSize,
+                               childInodeNum, name, nameLen, fileType)) {
+                goto done;
+            }
+
+            uint32_t logical, phys;
+            if (!AppendDirBlock(inst, dirInodeNum, dir, upper, logical, phys)) goto done;
+            if (!WriteBlock(inst, leafPhys, leaf)) goto done;
+
+            DxFrame& parent = path.frames[path.levels - 1];
+            DxInsertEntry(parent, hash2 | continued, logical);
+            if (WriteBlock(inst, parent.phys, parent.buf)) result = 1;
+        }
+
+    done:
+        if (copy) FreeBlockSized(inst, copy);
+        if (upper) FreeBlockSized(inst, upper);
+        if (refs) FreeBlockSized(inst, (uint8_t*)refs);
+        return result;
+    }
+
+    // Add an entry to an indexed directory. Returns 1 once added, -1 on
+    // failure, and 0 (having changed nothing) if the index cannot take it.
+    static int DxAdd(Ext2Instance& inst, uint32_t dirInodeNum, Inode& dir, uint32_t childInodeNum,
+                     const char* name, uint32_t nameLen, uint8_t fileType) {
+        DxPath path;
+        if (!DxAllocate(inst, path)) return -1;
+        uint8_t* leaf = AllocateBlockSized(inst);
+        if (!leaf) {
+            DxRelease(inst, path);
+            return -1;
+        }
+
+        int result = 0;
+        uint32_t numBlocks = (dir.i_size + inst.blockSize - 1) / inst.blockSize;
+        if (DxProbe(inst, dir, name, (int)nameLen, path)) {
+            uint32_t leafLogical = DxLeaf(path);
+            uint32_t leafPhys = leafLogical < numBlocks ? GetPhysicalBlock(inst, dir, leafLogical) : 0;
+            if (leafPhys == 0 || !ReadBlock(inst, leafPhys, leaf)) {
+                result = 0;
+            } else if (InsertInBlock(leaf, inst.blockSize, childInodeNum, name, nameLen, fileType)) {
+                result = WriteBlock(inst, leafPhys, leaf) ? 1 : -1;
+            } else {
+                // The leaf is full; splitting it takes a slot in its parent
+                DxFrame& parent = path.frames[path.levels - 1];
+                result = 1;
+                if (DxCount(parent.entries) == DxLimit(parent.entries)) {
+                    result = DxGrow(inst, dirInodeNum, dir, path);
+                }
+                if (result > 0) {
+                    result = DxSplitLeaf(inst, dirInodeNum, dir, path, leaf, leafPhys,
+                                         childInodeNum, name, nameLen, fileType);
+                }
+            }
+        }
 
-            j = 0;
-            for (int i = lastSlash + 1; i < len && j < nameMax - 1; i++) {
-                fileName[j++] = path[i];
+        FreeBlockSized(inst, leaf);
+        DxRelease(inst, path);
+        return result;
+    }
+
+    // Index a directory that is outgrowing its only block: the records
+    // but "." and ".." move to a new leaf, and the first block becomes the
+    // root. False, with nothing changed, unless the block starts with "."
+    // and ".." as mkdir lays them out.
+    static bool DxCreate(Ext2Instance& inst, uint32_t dirInodeNum, Inode& dir) {
+        uint32_t blockSize = inst.blockSize;
+        uint8_t* root = AllocateBlockSized(inst);
+        uint8_t* leaf = AllocateBlockSized(inst);
+        RecordRef* refs = (RecordRef*)AllocateBlockSized(inst);
+        uint32_t rootPhys = GetPhysicalBlock(inst, dir, 0);
+        bool created = false;
+
+        if (root && leaf && refs && rootPhys != 0 && ReadBlock(inst, rootPhys, root)) {
+            DirEntry* dot = (DirEntry*)root;
+            DirEntry* dotdot = (DirEntry*)(root + 12);
+            if (dot->rec_len == 12 && dot->name_len == 1 && root[8] == '.' &&
+                dotdot->name_len == 2 && root[20] == '.' && root[21] == '.' &&
+                dotdot->rec_len >= 12 && 12 + (uint32_t)dotdot->rec_len < blockSize) {
+                int count = 0;
+                uint32_t pos = 12 + dotdot->rec_len;
+                while (pos + 8 <= blockSize) {
+                    const DirEntry* de = (const DirEntry*)(root + pos);
+                    if (de->rec_len < 8 || pos + de->rec_len > blockSize) break;
+                    if (de->inode != 0) refs[count++] = { 0, (uint16_t)pos, (uint16_t)RecordLength(de->name_len) };
+                    pos += de->rec_len;
+                }
+                PackRecords(leaf, root, refs, count, blockSize);
+
+                uint32_t logical, phys;
+                if (AppendDirBlock(inst, dirInodeNum, dir, leaf, logical, phys)) {
+                    dotdot->rec_len = (uint16_t)(blockSize - 12);
+                    memset(root + 24, 0, blockSize - 24);
+                    DxRootInfo* info = (DxRootInfo*)(root + 24);
+                    info->hash_version = inst.defHashVersion;
+                    info->info_length = sizeof(DxRootInfo);
+                    DxEntry* entries = (DxEntry*)(root + 24 + sizeof(DxRootInfo));
+                    ((DxCountLimit*)entries)->limit = DxRootLimit(inst);
+                    DxSetCount(entries, 1);
+                    entries[0].block = logical;
+
+                    created = WriteBlock(inst, rootPhys, root);
+                    if (created) {
+                        dir.i_flags |= EXT2_INDEX_FL;
+                        WriteInode(inst, dirInodeNum, &dir);
+                    }
+                }
             }
-            fileName[j] = '\0';
         }
+
+        if (root) FreeBlockSized(inst, root);
+        if (leaf) FreeBlockSized(inst, leaf);
+        if (refs) FreeBlockSized(inst, (uint8_t*)refs);
+        return created;
     }
 
     // =========================================================================
     // Directory operations
     // =========================================================================
 
-    struct ParsedEntry {
-        char     name[MaxNameLen];
-        uint32_t inodeNum;
-        uint8_t  fileType;
-    };
-
     // Find a single entry by name in a directory inode.
     static bool FindInDirectory(Ext2Instance& inst, const Inode& dirInode,
                                  const char* name, ParsedEntry* out) {
-        uint32_t dirSize = dirInode.i_size;
-        uint32_t blockSize = inst.blockSize;
-        uint32_t numBlocks = (dirSize + blockSize - 1) / blockSize;
+        uint32_t nameLen = 0;
+        while (name[nameLen]) nameLen++;
 
         // We need a separate buffer for directory data since GetPhysicalBlock
         // uses inst.blockBuf for indirect block reads
-        uint8_t* dirBuf = (uint8_t*)Memory::g_pfa->AllocateZeroed();
+        uint8_t* dirBuf = AllocateBlockSized(inst);
         if (!dirBuf) return false;
 
-        for (uint32_t bi = 0; bi < numBlocks; bi++) {
-            uint32_t physBlock = GetPhysicalBlock(inst, dirInode, bi);
-            if (physBlock == 0) continue;
-            if (!ReadBlock(inst, physBlock, dirBuf)) continue;
-
-            uint32_t pos = 0;
-            uint32_t remaining = dirSize - bi * blockSize;
-            if (remaining > blockSize) remaining = blockSize;
-
-            while (pos + 8 <= remaining) {
-                DirEntry* de = (DirEntry*)(dirBuf + pos);
-                if (de->rec_len == 0) break;
-                if (de->rec_len < 8 || pos + de->rec_len > blockSize) break;
-
-                if (de->inode != 0 && de->name_len > 0) {
-                    char entryName[MaxNameLen];
-                    int nameLen = de->name_len;
-                    if (nameLen >= MaxNameLen) nameLen = MaxNameLen - 1;
-                    memcpy(entryName, (uint8_t*)de + sizeof(DirEntry), nameLen);
-                    entryName[nameLen] = '\0';
-
-                    if (StrEqual(entryName, name)) {
-                        out->inodeNum = de->inode;
-                        out->fileType = de->file_type;
-                        memcpy(out->name, entryName, nameLen + 1);
-                        Memory::g_pfa->Free(dirBuf);
-                        return true;
-                    }
-                }
-
-                pos += de->rec_len;
-            }
-        }
+        bool found = VisitNameBlocks(inst, dirInode, name, nameLen, dirBuf,
+            [&](uint32_t, uint32_t limit) {
+                return FindInBlock(dirBuf, limit, inst.blockSize, name, nameLen, out);
+            });
 
-        Memory::g_pfa->Free(dirBuf);
-        return false;
+        FreeBlockSized(inst, dirBuf);
+        return found;
     }
 
-    // Read all entries from a directory
-    static int ReadDirectoryEntries(Ext2Instance& inst, const Inode& dirInode,
+    // Read entries from a directory, starting at byte offset `cursor` and
+    // leaving it past the last record returned
+    static int ReadDirectoryEntries(Ext2Instance& inst, const Inode& dirInode, uint64_t& cursor,
                                      ParsedEntry* entries, int maxEntries) {
         uint32_t dirSize = dirInode.i_size;
         uint32_t blockSize = inst.blockSize;
-        uint32_t numBlocks = (dirSize + blockSize - 1) / blockSize;
+        uint64_t pos = cursor;
         int count = 0;
 
-        uint8_t* dirBuf = (uint8_t*)Memory::g_pfa->AllocateZeroed();
+        uint8_t* dirBuf = AllocateBlockSized(inst);
         if (!dirBuf) return 0;
 
-        for (uint32_t bi = 0; bi < numBlocks && count < maxEntries; bi++) {
+        while (pos < dirSize && count < maxEntries) {
+            uint32_t bi = (uint32_t)(pos / blockSize);
+            uint32_t blockStart = bi * blockSize;
             uint32_t physBlock = GetPhysicalBlock(inst, dirInode, bi);
-            if (physBlock == 0) continue;
-            if (!ReadBlock(inst, physBlock, dirBuf)) continue;
+            if (physBlock == 0 || !ReadBlock(inst, physBlock, dirBuf)) {
+                pos = blockStart + blockSize;
+                continue;
+            }
 
-            uint32_t pos = 0;
-            uint32_t remaining = dirSize - bi * blockSize;
+            uint32_t remaining = dirSize - blockStart;
             if (remaining > blockSize) remaining = blockSize;
+            uint32_t off = (uint32_t)(pos - blockStart);
 
-            while (pos + 8 <= remaining && count < maxEntries) {
-                DirEntry* de = (DirEntry*)(dirBuf + pos);
-                if (de->rec_len == 0) break;
-                if (de->rec_len < 8 || pos + de->rec_len > blockSize) break;
+            while (off + 8 <= remaining && count < maxEntries) {
+                DirEntry* de = (DirEntry*)(dirBuf + off);
+                if (de->rec_len < 8 || off + de->rec_len > blockSize) {
+                    off = blockSize;
+                    break;
+                }
+                off += de->rec_len;
 
-                if (de->inode != 0 && de->name_len > 0) {
-                    int nameLen = de->name_len;
-                    if (nameLen >= MaxNameLen) nameLen = MaxNameLen - 1;
-                    memcpy(entries[count].name,
-                           (uint8_t*)de + sizeof(DirEntry), nameLen);
-                    entries[count].name[nameLen] = '\0';
-
-                    // Skip . and ..
-                    if (entries[count].name[0] == '.' &&
-                        (entries[count].name[1] == '\0' ||
-                         (entries[count].name[1] == '.' && entries[count].name[2] == '\0'))) {
-                        pos += de->rec_len;
-                        continue;
-                    }
+                if (de->inode == 0 || de->name_len == 0) continue;
+                const char* name = (const char*)de + sizeof(DirEntry);
 
-                    entries[count].inodeNum = de->inode;
-                    entries[count].fileType = de->file_type;
-                    count++;
-                }
+                // Skip . and ..
+                if (name[0] == '.' && (de->name_len == 1 || (de->name_len == 2 && name[1] == '.'))) continue;
 
-                pos += de->rec_len;
+                memcpy(entries[count].name, name, de->name_len);
+                entries[count].name[de->name_len] = '\0';
+                entries[count].inodeNum = de->inode;
+                entries[count].fileType = de->file_type;
+                count++;
             }
+
+            pos = off >= remaining ? blockStart + blockSize : blockStart + off;
         }
 
-        Memory::g_pfa->Free(dirBuf);
+        FreeBlockSized(inst, dirBuf);
+        cursor = pos;
         return count;
     }
 
@@ -804,11 +1807,17 @@ namespace Fs::Ext2 {
         uint32_t nameLen = 0;
         while (name[nameLen]) nameLen++;
 
-        uint32_t neededLen = ((sizeof(DirEntry) + nameLen + 3) / 4) * 4; // 4-byte aligned
+        if (dirInode.i_flags & EXT2_INDEX_FL) {
+            int added = DxAdd(inst, dirInodeNum, dirInode, childInodeNum, name, nameLen, fileType);
+            if (added != 0) return added > 0;
+            dirInode.i_flags &= ~EXT2_INDEX_FL;
+            WriteInode(inst, dirInodeNum, &dirInode);
+        }
+
         uint32_t blockSize = inst.blockSize;
         uint32_t numBlocks = (dirInode.i_size + blockSize - 1) / blockSize;
 
-        uint8_t* dirBuf = (uint8_t*)Memory::g_pfa->AllocateZeroed();
+        uint8_t* dirBuf = AllocateBlockSized(inst);
         if (!dirBuf) return false;
 
         // Try to find space in existing directory blocks
@@ -817,141 +1826,54 @@ namespace Fs::Ext2 {
             if (physBlock == 0) continue;
             if (!ReadBlock(inst, physBlock, dirBuf)) continue;
 
-            uint32_t pos = 0;
-            while (pos + 8 <= blockSize) {
-                DirEntry* de = (DirEntry*)(dirBuf + pos);
-                if (de->rec_len == 0) break;
-                if (de->rec_len < 8 || pos + de->rec_len > blockSize) break;
-
-                // Check if this entry has slack space we can use
-                uint32_t actualLen;
-                if (de->inode == 0) {
-                    actualLen = 0; // unused entry — entire rec_len is available
-                } else {
-                    actualLen = ((sizeof(DirEntry) + de->name_len + 3) / 4) * 4;
-                }
-
-                uint32_t slack = de->rec_len - actualLen;
-                if (slack >= neededLen) {
-                    // Split this entry
-                    if (de->inode != 0) {
-                        uint16_t oldRecLen = de->rec_len;
-                        de->rec_len = (uint16_t)actualLen;
-
-                        DirEntry* newDe = (DirEntry*)(dirBuf + pos + actualLen);
-                        newDe->inode = childInodeNum;
-                        newDe->rec_len = (uint16_t)(oldRecLen - actualLen);
-                        newDe->name_len = (uint8_t)nameLen;
-                        newDe->file_type = fileType;
-                        memcpy((uint8_t*)newDe + sizeof(DirEntry), name, nameLen);
-                    } else {
-                        // Reuse this empty entry
-                        de->inode = childInodeNum;
-                        // Keep rec_len as-is
-                        de->name_len = (uint8_t)nameLen;
-                        de->file_type = fileType;
-                        memcpy((uint8_t*)de + sizeof(DirEntry), name, nameLen);
-                    }
-
-                    WriteBlock(inst, physBlock, dirBuf);
-                    Memory::g_pfa->Free(dirBuf);
-                    return true;
-                }
-
-                pos += de->rec_len;
+            if (InsertInBlock(dirBuf, blockSize, childInodeNum, name, nameLen, fileType)) {
+                WriteBlock(inst, physBlock, dirBuf);
+                FreeBlockSized(inst, dirBuf);
+                return true;
             }
         }
 
-        // No space — allocate a new block for the directory
-        uint32_t group = (dirInodeNum - 1) / inst.inodesPerGroup;
-        uint32_t newBlock = AllocateBlock(inst, group);
-        if (newBlock == 0) {
-            Memory::g_pfa->Free(dirBuf);
-            return false;
+        // A directory outgrowing its first block gets an index
+        if (numBlocks == 1 && inst.dirIndex && DxCreate(inst, dirInodeNum, dirInode)) {
+            int added = DxAdd(inst, dirInodeNum, dirInode, childInodeNum, name, nameLen, fileType);
+            if (added != 0) {
+                FreeBlockSized(inst, dirBuf);
+                return added > 0;
+            }
+            dirInode.i_flags &= ~EXT2_INDEX_FL;
+            WriteInode(inst, dirInodeNum, &dirInode);
         }
 
-        // Initialize new block with the entry
+        // No space — add a new block holding just the entry
         memset(dirBuf, 0, blockSize);
         DirEntry* de = (DirEntry*)dirBuf;
-        de->inode = childInodeNum;
         de->rec_len = (uint16_t)blockSize; // fills entire block
-        de->name_len = (uint8_t)nameLen;
-        de->file_type = fileType;
-        memcpy((uint8_t*)de + sizeof(DirEntry), name, nameLen);
-
-        if (!WriteBlock(inst, newBlock, dirBuf)) {
-            FreeBlock(inst, newBlock);
-            Memory::g_pfa->Free(dirBuf);
-            return false;
-        }
+        InsertInBlock(dirBuf, blockSize, childInodeNum, name, nameLen, fileType);
 
-        // Assign new block to directory inode
-        uint32_t newLogicalIdx = numBlocks;
-        if (!SetPhysicalBlock(inst, dirInode, newLogicalIdx, newBlock, group)) {
-            FreeBlock(inst, newBlock);
-            Memory::g_pfa->Free(dirBuf);
-            return false;
-        }
-
-        dirInode.i_size += blockSize;
-        dirInode.i_blocks += blockSize / 512;
-        WriteInode(inst, dirInodeNum, &dirInode);
-
-        Memory::g_pfa->Free(dirBuf);
-        return true;
+        uint32_t logical, physBlock;
+        bool added = AppendDirBlock(inst, dirInodeNum, dirInode, dirBuf, logical, physBlock);
+        FreeBlockSized(inst, dirBuf);
+        return added;
     }
 
     // Remove a directory entry by name
     static bool RemoveDirEntry(Ext2Instance& inst, const Inode& dirInode,
                                 const char* name) {
-        uint32_t dirSize = dirInode.i_size;
-        uint32_t blockSize = inst.blockSize;
-        uint32_t numBlocks = (dirSize + blockSize - 1) / blockSize;
+        uint32_t nameLen = 0;
+        while (name[nameLen]) nameLen++;
 
-        uint8_t* dirBuf = (uint8_t*)Memory::g_pfa->AllocateZeroed();
+        uint8_t* dirBuf = AllocateBlockSized(inst);
         if (!dirBuf) return false;
 
-        for (uint32_t bi = 0; bi < numBlocks; bi++) {
-            uint32_t physBlock = GetPhysicalBlock(inst, dirInode, bi);
-            if (physBlock == 0) continue;
-            if (!ReadBlock(inst, physBlock, dirBuf)) continue;
-
-            uint32_t pos = 0;
-            DirEntry* prevDe = nullptr;
-
-            while (pos + 8 <= blockSize) {
-                DirEntry* de = (DirEntry*)(dirBuf + pos);
-                if (de->rec_len == 0) break;
-                if (de->rec_len < 8 || pos + de->rec_len > blockSize) break;
-
-                if (de->inode != 0 && de->name_len > 0) {
-                    char entryName[MaxNameLen];
-                    int nameLen = de->name_len;
-                    if (nameLen >= MaxNameLen) nameLen = MaxNameLen - 1;
-                    memcpy(entryName, (uint8_t*)de + sizeof(DirEntry), nameLen);
-                    entryName[nameLen] = '\0';
-
-                    if (StrEqual(entryName, name)) {
-                        if (prevDe) {
-                            // Merge with previous entry
-                            prevDe->rec_len += de->rec_len;
-                        } else {
-                            // First entry in block — just zero the inode
-                            de->inode = 0;
-                        }
-                        WriteBlock(inst, physBlock, dirBuf);
-                        Memory::g_pfa->Free(dirBuf);
-                        return true;
-                    }
-                }
-
-                prevDe = de;
-                pos += de->rec_len;
-            }
-        }
+        bool removed = VisitNameBlocks(inst, dirInode, name, nameLen, dirBuf,
+            [&](uint32_t physBlock, uint32_t limit) {
+                if (!RemoveFromBlock(dirBuf, limit, inst.blockSize, name, nameLen)) return false;
+                WriteBlock(inst, physBlock, dirBuf);
+                return true;
+            });
 
-        Memory::g_pfa->Free(dirBuf);
-        return false;
+        FreeBlockSized(inst, dirBuf);
+        return removed;
     }
 
     // =========================================================================
@@ -1008,21 +1930,41 @@ namespace Fs::Ext2 {
     // FsDriver implementation functions
     // =========================================================================
 
-    static int OpenImpl(int inst, const char* path) {
-        if (inst < 0 || inst >= g_instanceCount || !g_instances[inst].active) return -1;
-        auto& self = g_instances[inst];
-
-        uint32_t inodeNum;
-        Inode inode;
-        if (!TraversePath(self, path, &inodeNum, &inode)) return -1;
+    // The blocks of an inode were freed by a truncate or delete, which
+    // writes the emptied inode itself. Handles still open on it take that
+    // copy, and no write-back still pending may restore the old pointers.
+    static void ForgetOpenInode(Ext2Instance& self, uint32_t inodeNum, const Inode& inode) {
+        for (auto& file : self.files) {
+            if (file.inodeNum != inodeNum) continue;
+            if (file.inUse) file.inode = inode;
+            file.inodeDirty = false;
+            file.map.count = 0;
+            file.ra = {};
+        }
+    }
 
+    static int OpenInode(Ext2Instance& self, uint32_t inodeNum, const Inode& inode) {
         for (int i = 0; i < MaxFilesPerInstance; i++) {
             if (!self.files[i].inUse) {
+                if (self.files[i].inodeDirty) {
+                    WriteInode(self, self.files[i].inodeNum, &self.files[i].inode);
+                }
+                self.files[i].inodeDirty = false;
                 self.files[i].inUse = true;
                 self.files[i].inodeNum = inodeNum;
                 self.files[i].inode = inode;
                 self.files[i].isDirectory =
                     (inode.i_mode & IMODE_TYPE_MASK) == IMODE_DIR;
+                self.files[i].ra = {};
+
+                // Another open of the file has mapped its blocks already
+                self.files[i].map.count = 0;
+                for (int j = 0; j < MaxFilesPerInstance; j++) {
+                    if (j != i && self.files[j].inUse && self.files[j].inodeNum == inodeNum) {
+                        self.files[i].map = self.files[j].map;
+                        break;
+                    }
+                }
                 return i;
             }
         }
@@ -1030,6 +1972,91 @@ namespace Fs::Ext2 {
         return -1;
     }
 
+    static int OpenImpl(int inst, const char* path) {
+        if (inst < 0 || inst >= g_instanceCount || !g_instances[inst].active) return -1;
+        auto& self = g_instances[inst];
+
+        uint32_t inodeNum;
+        Inode inode;
+        if (!TraversePath(self, path, &inodeNum, &inode)) return -1;
+        return OpenInode(self, inodeNum, inode);
+    }
+
+    // Name cache nodes are inode numbers, 0 standing for the root
+    static int64_t LookupImpl(int inst, uint64_t dir, const char* name) {
+        if (inst < 0 || inst >= g_instanceCount || !g_instances[inst].active) return -2;
+        auto& self = g_instances[inst];
+
+        Inode dirInode;
+        if (!ReadInode(self, dir == 0 ? EXT2_ROOT_INODE : (uint32_t)dir, &dirInode)) return -2;
+        if ((dirInode.i_mode & IMODE_TYPE_MASK) != IMODE_DIR) return -1;
+
+        ParsedEntry found;
+        if (!FindInDirectory(self, dirInode, name, &found)) return -1;
+        return found.inodeNum;
+    }
+
+    static int OpenNodeImpl(int inst, uint64_t node) {
+        if (inst < 0 || inst >= g_instanceCount || !g_instances[inst].active) return -1;
+        auto& self = g_instances[inst];
+
+        uint32_t inodeNum = node == 0 ? EXT2_ROOT_INODE : (uint32_t)node;
+        Inode inode;
+        if (!ReadInode(self, inodeNum, &inode)) return -1;
+        return OpenInode(self, inodeNum, inode);
+    }
+
+    // Length of the run of physically contiguous blocks starting at
+    // `logicalIdx` (which maps to `physBlock`), at most `maxRun`
+    static uint32_t ContiguousRun(Ext2Instance& inst, Ext2File& file,
+                                  uint32_t logicalIdx, uint32_t physBlock, uint32_t maxRun) {
+        uint32_t run, more;
+        MapBlock(inst, file, logicalIdx, run);
+        while (run < maxRun && MapBlock(inst, file, logicalIdx + run, more) == physBlock + run) run += more;
+        return run < maxRun ? run : maxRun;
+    }
+
+    // Adaptive sequential readahead. A read that starts where the last one
+    // ended doubles the window, up to MaxReadaheadBytes; any other read
+    // drops it. Once the reader gets within half a window of what has been
+    // prefetched, the next window is loaded into the buffer cache in large
+    // requests, so a file read in small pieces still hits the disk in big ones.
+    static void ReadAhead(Ext2Instance& inst, Ext2File& file, uint64_t offset, uint64_t bytesRead) {
+        uint32_t blockSize = inst.blockSize;
+        auto& ra = file.ra;
+        uint32_t first = (uint32_t)(offset / blockSize);
+        uint32_t next = (uint32_t)((offset + bytesRead) / blockSize);
+
+        bool sequential = bytesRead > 0 && first == ra.nextBlock;
+        ra.nextBlock = next;
+        if (!sequential) {
+            ra.window = 0;
+            ra.end = next;
+            return;
+        }
+
+        uint32_t maxWindow = MaxReadaheadBytes / blockSize;
+        ra.window = ra.window == 0 ? MinReadaheadBlocks : ra.window * 2;
+        if (ra.window > maxWindow) ra.window = maxWindow;
+        if (ra.end < next) ra.end = next;
+        if (ra.end - next > ra.window / 2) return;
+
+        auto* dev = Drivers::Storage::GetBlockDevice(inst.blockDevIndex);
+        if (!dev) return;
+
+        uint32_t fileBlocks = (uint32_t)(((uint64_t)file.inode.i_size + blockSize - 1) / blockSize);
+        uint32_t target = next + ra.window < fileBlocks ? next + ra.window : fileBlocks;
+        while (ra.end < target) {
+            uint32_t run;
+            uint32_t physBlock = MapBlock(inst, file, ra.end, run);
+            if (physBlock == 0) break;
+            run = ContiguousRun(inst, file, ra.end, physBlock, target - ra.end);
+            Drivers::Storage::BufferCache::Prefetch(dev, inst.partStartLba + BlockToPartSector(inst, physBlock),
+                                                    run * SectorsPerBlock(inst));
+            ra.end += run;
+        }
+    }
+
     static int ReadImpl(int inst, int handle, uint8_t* buffer,
                          uint64_t offset, uint64_t size) {
         if (inst < 0 || inst >= g_instanceCount) return -1;
@@ -1047,28 +2074,56 @@ namespace Fs::Ext2 {
         uint32_t blockSize = self.blockSize;
         uint64_t bytesRead = 0;
 
-        // We need a separate buffer for data reads since GetPhysicalBlock uses blockBuf
-        uint8_t* dataBuf = (uint8_t*)Memory::g_pfa->AllocateZeroed();
-        if (!dataBuf) return -1;
+        // Partial blocks need a separate buffer, since GetPhysicalBlock uses blockBuf
+        uint8_t* dataBuf = nullptr;
 
         while (bytesRead < size) {
             uint32_t logicalBlock = (uint32_t)((offset + bytesRead) / blockSize);
             uint32_t blockOff = (uint32_t)((offset + bytesRead) % blockSize);
+            uint64_t toRead = size - bytesRead;
 
-            uint32_t physBlock = GetPhysicalBlock(self, file.inode, logicalBlock);
-            if (physBlock == 0) break;
+            uint32_t run;
+            uint32_t physBlock = MapBlock(self, file, logicalBlock, run);
+
+            // A hole inside the file reads as zeros
+            if (physBlock == 0) {
+                uint64_t zeros = (uint64_t)run * blockSize - blockOff;
+                if (zeros > toRead) zeros = toRead;
+                memset(buffer + bytesRead, 0, zeros);
+                bytesRead += zeros;
+                continue;
+            }
+
+            // Whole blocks: read the physically contiguous run in one
+            // request, straight into the caller's buffer
+            if (blockOff == 0 && toRead >= blockSize) {
+                uint64_t maxRun = toRead / blockSize;
+                if (maxRun > MaxRunBytes / blockSize) maxRun = MaxRunBytes / blockSize;
+                run = ContiguousRun(self, file, logicalBlock, physBlock, (uint32_t)maxRun);
+                if (!ReadPartSectors(self, BlockToPartSector(self, physBlock),
+                                     run * SectorsPerBlock(self), buffer + bytesRead)) break;
+                bytesRead += (uint64_t)run * blockSize;
+                continue;
+            }
 
+            if (dataBuf == nullptr) {
+                dataBuf = (uint8_t*)Memory::g_pfa->AllocateZeroed();
+                if (dataBuf == nullptr) {
+                    if (bytesRead == 0) return -1;
+                    break;
+                }
+            }
             if (!ReadBlock(self, physBlock, dataBuf)) break;
 
             uint32_t available = blockSize - blockOff;
-            uint64_t toRead = size - bytesRead;
             if (toRead > available) toRead = available;
 
             memcpy(buffer + bytesRead, dataBuf + blockOff, toRead);
             bytesRead += toRead;
         }
 
-        Memory::g_pfa->Free(dataBuf);
+        if (dataBuf) Memory::g_pfa->Free(dataBuf);
+        ReadAhead(self, file, offset, bytesRead);
         return (int)bytesRead;
     }
 
@@ -1096,28 +2151,145 @@ namespace Fs::Ext2 {
         if (!TraversePath(self, path, &inodeNum, &inode)) return -1;
         if ((inode.i_mode & IMODE_TYPE_MASK) != IMODE_DIR) return -1;
 
-        ParsedEntry entries[MaxDirEntries];
+        // The names are kept in dirNames, which caps the count; the
+        // records are read a few at a time
+        ParsedEntry entries[8];
         int limit = maxEntries < MaxDirEntries ? maxEntries : MaxDirEntries;
-        int count = ReadDirectoryEntries(self, inode, entries, limit);
+        uint64_t cursor = 0;
+        int count = 0;
+
+        while (count < limit) {
+            int want = limit - count < 8 ? limit - count : 8;
+            int got = ReadDirectoryEntries(self, inode, cursor, entries, want);
+            for (int i = 0; i < got; i++, count++) {
+                int j = 0;
+                while (entries[i].name[j] && j < MaxNameLen - 2) {
+                    self.dirNames[count][j] = entries[i].name[j];
+                    j++;
+                }
+                // Append trailing '/' for directories so userspace can distinguish them
+                if (entries[i].fileType == EXT2_FT_DIR && j < MaxNameLen - 1) {
+                    self.dirNames[count][j++] = '/';
+                }
+                self.dirNames[count][j] = '\0';
+                outNames[count] = self.dirNames[count];
+            }
+            if (got < want) break;
+        }
 
         self.dirNameCount = count;
-        for (int i = 0; i < count; i++) {
-            int j = 0;
-            while (entries[i].name[j] && j < MaxNameLen - 2) {
-                self.dirNames[i][j] = entries[i].name[j];
-                j++;
+        return count;
+    }
+
+    // The cursor is the byte offset of the next directory record. Each
+    // entry's inode is read for its type, size and mtime.
+    static int ReadDirStatImpl(int inst, const char* path, uint64_t* cursor,
+                               Vfs::DirStat* out, int maxEntries) {
+        if (inst < 0 || inst >= g_instanceCount) return -1;
+        auto& self = g_instances[inst];
+
+        uint32_t inodeNum;
+        Inode dirInode;
+        if (!TraversePath(self, path, &inodeNum, &dirInode)) return -1;
+        if ((dirInode.i_mode & IMODE_TYPE_MASK) != IMODE_DIR) return -1;
+
+        uint8_t* dirBuf = (uint8_t*)Memory::g_pfa->AllocateZeroed();
+        if (!dirBuf) return -1;
+
+        uint32_t dirSize = dirInode.i_size;
+        uint32_t blockSize = self.blockSize;
+        uint64_t pos = *cursor;
+        int count = 0;
+
+        while (pos < dirSize && count < maxEntries) {
+            uint32_t bi = (uint32_t)(pos / blockSize);
+            uint32_t blockStart = bi * blockSize;
+            uint32_t physBlock = GetPhysicalBlock(self, dirInode, bi);
+            if (physBlock == 0 || !ReadBlock(self, physBlock, dirBuf)) {
+                pos = blockStart + blockSize;
+                continue;
             }
-            // Append trailing '/' for directories so userspace can distinguish them
-            if (entries[i].fileType == EXT2_FT_DIR && j < MaxNameLen - 1) {
-                self.dirNames[i][j++] = '/';
+
+            uint32_t remaining = dirSize - blockStart;
+            if (remaining > blockSize) remaining = blockSize;
+            uint32_t off = (uint32_t)(pos - blockStart);
+
+            while (off + 8 <= remaining && count < maxEntries) {
+                DirEntry* de = (DirEntry*)(dirBuf + off);
+                if (de->rec_len < 8 || off + de->rec_len > blockSize) {
+                    off = blockSize;
+                    break;
+                }
+                off += de->rec_len;
+
+                if (de->inode == 0 || de->name_len == 0) continue;
+                if (sizeof(DirEntry) + de->name_len > de->rec_len) continue;
+                const char* name = (const char*)de + sizeof(DirEntry);
+                if (name[0] == '.' && (de->name_len == 1 || (de->name_len == 2 && name[1] == '.'))) continue;
+
+                Inode child;
+                if (!ReadInode(self, de->inode, &child)) continue;
+
+                Vfs::DirStat& st = out[count++];
+                memcpy(st.name, name, de->name_len);
+                st.name[de->name_len] = '\0';
+                uint16_t type = child.i_mode & IMODE_TYPE_MASK;
+                st.type = type == IMODE_DIR ? Vfs::EntryDirectory
+                        : type == IMODE_REG ? Vfs::EntryFile : Vfs::EntryUnknown;
+                st.size = type == IMODE_DIR ? 0 : child.i_size;
+                st.mtime = child.i_mtime;
             }
-            self.dirNames[i][j] = '\0';
-            outNames[i] = self.dirNames[i];
+
+            pos = off >= remaining ? blockStart + blockSize : blockStart + off;
         }
 
+        Memory::g_pfa->Free(dirBuf);
+        *cursor = pos;
         return count;
     }
 
+    // Fill `count` newly allocated blocks from `physStart` with `bytes` of
+    // `src`, starting `blockOff` into the first block and zeroing what the
+    // data leaves uncovered. The whole blocks in between go to the disk
+    // as one request.
+    static bool WriteNewBlocks(Ext2Instance& inst, uint32_t physStart, uint32_t count,
+                               uint32_t blockOff, const uint8_t* src, uint64_t bytes,
+                               uint8_t* dataBuf) {
+        uint32_t blockSize = inst.blockSize;
+        uint32_t i = 0;
+
+        if (blockOff != 0 || bytes < blockSize) {
+            uint64_t n = blockSize - blockOff;
+            if (n > bytes) n = bytes;
+            memset(dataBuf, 0, blockSize);
+            memcpy(dataBuf + blockOff, src, n);
+            if (!WriteBlock(inst, physStart, dataBuf)) return false;
+            src += n;
+            bytes -= n;
+            i = 1;
+        }
+
+        uint32_t wholeBlocks = (uint32_t)(bytes / blockSize);
+        if (wholeBlocks > count - i) wholeBlocks = count - i;
+        if (wholeBlocks > 0) {
+            if (!WritePartSectors(inst, BlockToPartSector(inst, physStart + i),
+                                  wholeBlocks * SectorsPerBlock(inst), src)) return false;
+            src += (uint64_t)wholeBlocks * blockSize;
+            bytes -= (uint64_t)wholeBlocks * blockSize;
+            i += wholeBlocks;
+        }
+
+        for (; i < count; i++) {
+            uint64_t n = bytes < blockSize ? bytes : blockSize;
+            memset(dataBuf, 0, blockSize);
+            memcpy(dataBuf, src, n);
+            if (!WriteBlock(inst, physStart + i, dataBuf)) return false;
+            src += n;
+            bytes -= n;
+        }
+        return true;
+    }
+
     static int WriteImpl(int inst, int handle, const uint8_t* buffer,
                           uint64_t offset, uint64_t size) {
         if (inst < 0 || inst >= g_instanceCount) return -1;
@@ -1137,30 +2309,53 @@ namespace Fs::Ext2 {
 
         uint64_t bytesWritten = 0;
 
+        uint32_t lastBlock = (uint32_t)((offset + size - 1) / blockSize);
+
         while (bytesWritten < size) {
             uint32_t logicalBlock = (uint32_t)((offset + bytesWritten) / blockSize);
             uint32_t blockOff = (uint32_t)((offset + bytesWritten) % blockSize);
 
-            uint32_t physBlock = GetPhysicalBlock(self, file.inode, logicalBlock);
+            uint32_t run;
+            uint32_t physBlock = MapBlock(self, file, logicalBlock, run);
 
             if (physBlock == 0) {
-                // Need to allocate a new block
-                physBlock = AllocateBlock(self, group);
-                if (physBlock == 0) break;
+                // Allocate the whole unmapped stretch of this write at once,
+                // right after the file's previous block if possible
+                uint32_t want = lastBlock - logicalBlock + 1;
+                if (want > MaxRunBytes / blockSize) want = MaxRunBytes / blockSize;
+                if (want > run) want = run;
+                uint32_t goal = 0;
+                if (logicalBlock > 0) {
+                    goal = MapBlock(self, file, logicalBlock - 1, run);
+                    if (goal) goal++;
+                }
 
-                // Zero the new block
-                memset(dataBuf, 0, blockSize);
-                WriteBlock(self, physBlock, dataBuf);
+                uint32_t count;
+                physBlock = AllocateBlocks(self, goal, group, want, count);
+                if (physBlock == 0) break;
 
-                if (!SetPhysicalBlock(self, file.inode, logicalBlock, physBlock, group)) {
-                    FreeBlock(self, physBlock);
-                    break;
+                uint32_t mapped = 0;
+                while (mapped < count &&
+                       SetPhysicalBlock(self, file.inode, logicalBlock + mapped, physBlock + mapped, group)) {
+                    file.inode.i_blocks += blockSize / 512;
+                    mapped++;
                 }
-                file.inode.i_blocks += blockSize / 512;
+                for (uint32_t i = mapped; i < count; i++) FreeBlock(self, physBlock + i);
+                InvalidateBlockMaps(self, file.inodeNum);
+                if (mapped == 0) break;
+
+                uint64_t toWrite = (uint64_t)mapped * blockSize - blockOff;
+                if (toWrite > size - bytesWritten) toWrite = size - bytesWritten;
+                if (!WriteNewBlocks(self, physBlock, mapped, blockOff,
+                                    buffer + bytesWritten, toWrite, dataBuf)) break;
+
+                bytesWritten += toWrite;
+                continue;
             }
 
             // Read existing block for partial writes
-            if (!ReadBlock(self, physBlock, dataBuf)) break;
+            bool whole = blockOff == 0 && size - bytesWritten >= blockSize;
+            if (!whole && !ReadBlock(self, physBlock, dataBuf)) break;
 
             uint32_t available = blockSize - blockOff;
             uint64_t toWrite = size - bytesWritten;
@@ -1180,14 +2375,33 @@ namespace Fs::Ext2 {
             file.inode.i_size = (uint32_t)endPos;
         }
 
-        // Write updated inode to disk
+        // The inode and allocation state follow in SyncImpl, once the
+        // data is on disk. Other handles of the file see the new size and
+        // blocks right away.
         if (bytesWritten > 0) {
-            WriteInode(self, file.inodeNum, &file.inode);
+            file.inodeDirty = true;
+            for (auto& other : self.files) {
+                if (other.inUse && other.inodeNum == file.inodeNum) other.inode = file.inode;
+            }
         }
 
         return (int)bytesWritten;
     }
 
+    // Write back the inodes of files changed by writes, open or closed
+    // since, and the allocation state
+    static void SyncImpl(int inst) {
+        if (inst < 0 || inst >= g_instanceCount) return;
+        auto& self = g_instances[inst];
+        for (int i = 0; i < MaxFilesPerInstance; i++) {
+            Ext2File& file = self.files[i];
+            if (!file.inodeDirty) continue;
+            WriteInode(self, file.inodeNum, &file.inode);
+            file.inodeDirty = false;
+        }
+        WriteBackAllocState(self);
+    }
+
     static int CreateImpl(int inst, const char* path) {
         if (inst < 0 || inst >= g_instanceCount || !g_instances[inst].active) return -1;
         auto& self = g_instances[inst];
@@ -1215,19 +2429,10 @@ namespace Fs::Ext2 {
             FreeInodeBlocks(self, existInode);
             existInode.i_size = 0;
             existInode.i_blocks = 0;
+            ForgetOpenInode(self, existing.inodeNum, existInode);
             WriteInode(self, existing.inodeNum, &existInode);
 
-            // Open a handle
-            for (int i = 0; i < MaxFilesPerInstance; i++) {
-                if (!self.files[i].inUse) {
-                    self.files[i].inUse = true;
-                    self.files[i].inodeNum = existing.inodeNum;
-                    self.files[i].inode = existInode;
-                    self.files[i].isDirectory = false;
-                    return i;
-                }
-            }
-            return -1;
+            return OpenInode(self, existing.inodeNum, existInode);
         }
 
         // Allocate a new inode
@@ -1249,18 +2454,7 @@ namespace Fs::Ext2 {
             return -1;
         }
 
-        // Open a handle
-        for (int i = 0; i < MaxFilesPerInstance; i++) {
-            if (!self.files[i].inUse) {
-                self.files[i].inUse = true;
-                self.files[i].inodeNum = newInodeNum;
-                self.files[i].inode = newInode;
-                self.files[i].isDirectory = false;
-                return i;
-            }
-        }
-
-        return -1;
+        return OpenInode(self, newInodeNum, newInode);
     }
 
     static int DeleteImpl(int inst, const char* path) {
@@ -1287,7 +2481,8 @@ namespace Fs::Ext2 {
         if (isDir) {
             // Only allow deleting empty directories
             ParsedEntry children[1];
-            int childCount = ReadDirectoryEntries(self, targetInode, children, 1);
+            uint64_t cursor = 0;
+            int childCount = ReadDirectoryEntries(self, targetInode, cursor, children, 1);
             if (childCount > 0) return -1;
         }
 
@@ -1307,6 +2502,7 @@ namespace Fs::Ext2 {
             // Free all blocks and the inode
             FreeInodeBlocks(self, targetInode);
             targetInode.i_mode = 0;
+            ForgetOpenInode(self, existing.inodeNum, targetInode);
             WriteInode(self, existing.inodeNum, &targetInode);
             FreeInode(self, existing.inodeNum);
         } else {
@@ -1417,21 +2613,7 @@ namespace Fs::Ext2 {
         uint32_t newGroup = (newInodeNum - 1) / self.inodesPerGroup;
         if (newGroup < self.groupCount) {
             self.bgdt[newGroup].bg_used_dirs_count++;
-
-            uint32_t bgdtBlock = self.firstDataBlock + 1;
-            uint32_t bgdtOffset = newGroup * sizeof(BlockGroupDescriptor);
-            uint32_t bgdtBlockIdx = bgdtBlock + bgdtOffset / self.blockSize;
-            uint32_t bgdtOffInBlock = bgdtOffset % self.blockSize;
-
-            uint8_t* tmpBuf = (uint8_t*)Memory::g_pfa->AllocateZeroed();
-            if (tmpBuf) {
-                if (ReadBlock(self, bgdtBlockIdx, tmpBuf)) {
-                    memcpy(tmpBuf + bgdtOffInBlock, &self.bgdt[newGroup],
-                           sizeof(BlockGroupDescriptor));
-                    WriteBlock(self, bgdtBlockIdx, tmpBuf);
-                }
-                Memory::g_pfa->Free(tmpBuf);
-            }
+            self.groups[newGroup].descDirty = true;
         }
 
         return 0;
@@ -1481,7 +2663,8 @@ namespace Fs::Ext2 {
             bool destIsDir = (destInode.i_mode & IMODE_TYPE_MASK) == IMODE_DIR;
             if (destIsDir) {
                 ParsedEntry children[1];
-                int childCount = ReadDirectoryEntries(self, destInode, children, 1);
+                uint64_t cursor = 0;
+                int childCount = ReadDirectoryEntries(self, destInode, cursor, children, 1);
                 if (childCount > 0) return -1;
             }
 
@@ -1497,6 +2680,7 @@ namespace Fs::Ext2 {
             if (destInode.i_links_count <= 0) {
                 FreeInodeBlocks(self, destInode);
                 destInode.i_mode = 0;
+                ForgetOpenInode(self, destEntry.inodeNum, destInode);
                 WriteInode(self, destEntry.inodeNum, &destInode);
                 FreeInode(self, destEntry.inodeNum);
             } else {
@@ -1545,16 +2729,27 @@ namespace Fs::Ext2 {
     // =========================================================================
 
     template<int N> struct Thunks {
+        // Operations that may allocate or free write the bitmaps back
+        // after; Write leaves that to Sync
+        static int Commit(int result) {
+            if (N < g_instanceCount) WriteBackAllocState(g_instances[N]);
+            return result;
+        }
+
         static int Open(const char* p) { return OpenImpl(N, p); }
         static int Read(int h, uint8_t* b, uint64_t o, uint64_t s) { return ReadImpl(N, h, b, o, s); }
         static uint64_t GetSize(int h) { return GetSizeImpl(N, h); }
         static void Close(int h) { CloseImpl(N, h); }
         static int ReadDir(const char* p, const char** o, int m) { return ReadDirImpl(N, p, o, m); }
         static int Write(int h, const uint8_t* b, uint64_t o, uint64_t s) { return WriteImpl(N, h, b, o, s); }
-        static int Create(const char* p) { return CreateImpl(N, p); }
-        static int Delete(const char* p) { return DeleteImpl(N, p); }
-        static int Mkdir(const char* p) { return MkdirImpl(N, p); }
-        static int Rename(const char* o, const char* n) { return RenameImpl(N, o, n); }
+        static int Create(const char* p) { return Commit(CreateImpl(N, p)); }
+        static int Delete(const char* p) { return Commit(DeleteImpl(N, p)); }
+        static int Mkdir(const char* p) { return Commit(MkdirImpl(N, p)); }
+        static int Rename(const char* o, const char* n) { return Commit(RenameImpl(N, o, n)); }
+        static int64_t Lookup(uint64_t d, const char* n) { return LookupImpl(N, d, n); }
+        static int OpenNode(uint64_t n) { return OpenNodeImpl(N, n); }
+        static int ReadDirStat(const char* p, uint64_t* c, Vfs::DirStat* o, int m) { return ReadDirStatImpl(N, p, c, o, m); }
+        static void Sync() { SyncImpl(N); }
     };
 
     template<int N>
@@ -1570,6 +2765,10 @@ namespace Fs::Ext2 {
             Thunks<N>::Delete,
             Thunks<N>::Mkdir,
             Thunks<N>::Rename,
+            Thunks<N>::Lookup,
+            Thunks<N>::OpenNode,
+            Thunks<N>::ReadDirStat,
+            Thunks<N>::Sync,
         };
     }
 
@@ -1590,7 +2789,7 @@ namespace Fs::Ext2 {
 
         // ext2 superblock is at byte offset 1024 from partition start (sector 2)
         uint8_t sbBuf[1024];
-        if (!dev->ReadSectors(dev->Ctx, startLba + 2, 2, sbBuf)) return nullptr;
+        if (!Drivers::Storage::BufferCache::Read(dev, startLba + 2, 2, sbBuf)) return nullptr;
 
         Superblock* sb = (Superblock*)sbBuf;
 
@@ -1640,6 +2839,11 @@ namespace Fs::Ext2 {
         inst.firstDataBlock = sb->s_first_data_block;
         inst.groupCount = groupCount;
 
+        inst.dirIndex = sb->s_rev_level >= 1 && (sb->s_feature_compat & EXT2_FEATURE_COMPAT_DIR_INDEX);
+        memcpy(inst.hashSeed, sb->s_hash_seed, sizeof(inst.hashSeed));
+        inst.hashUnsigned = (sb->s_flags & EXT2_FLAGS_UNSIGNED_HASH) ? DX_HASH_UNSIGNED : 0;
+        inst.defHashVersion = sb->s_def_hash_version <= DX_HASH_TEA ? sb->s_def_hash_version : DX_HASH_HALF_MD4;
+
         // Volume label
         memcpy(inst.volumeLabel, sb->s_volume_name, 16);
         inst.volumeLabel[16] = '\0';
@@ -1694,10 +2898,27 @@ namespace Fs::Ext2 {
             memcpy(dst + b * blockSize, inst.blockBuf, copyLen);
         }
 
-        // Clear file handles
+        // Group allocation state; bitmaps are loaded on demand
+        inst.groupsPages = (int)((groupCount * sizeof(GroupState) + 0xFFF) / 0x1000);
+        if (inst.groupsPages == 1) {
+            inst.groups = (GroupState*)Memory::g_pfa->AllocateZeroed();
+        } else {
+            inst.groups = (GroupState*)Memory::g_pfa->ReallocConsecutive(
+                nullptr, inst.groupsPages);
+            if (inst.groups) memset(inst.groups, 0, (uint64_t)inst.groupsPages * 0x1000);
+        }
+        if (!inst.groups) {
+            inst.active = false;
+            return nullptr;
+        }
+
+        // Clear file handles and the inode cache
         for (int i = 0; i < MaxFilesPerInstance; i++) {
             inst.files[i].inUse = false;
+            inst.files[i].inodeDirty = false;
         }
+        memset(inst.inodeCache, 0, sizeof(inst.inodeCache));
+        inst.inodeTick = 0;
 
         g_instanceCount++;
 
@@ -1767,7 +2988,7 @@ namespace Fs::Ext2 {
         auto writeBlock = [&](uint32_t blockNum) -> bool {
             uint64_t sector = startLba + (uint64_t)blockNum * sectorsPerBlock;
             for (uint32_t s = 0; s < sectorsPerBlock; s++) {
-                if (!dev->WriteSectors(dev->Ctx, sector + s, 1, buf + s * 512))
+                if (!Drivers::Storage::BufferCache::Write(dev, sector + s, 1, buf + s * 512))
                     return false;
             }
             return true;
@@ -1806,8 +3027,11 @@ namespace Fs::Ext2 {
         sb->s_inode_size = inodeSize;
         sb->s_block_group_nr = 0;
         sb->s_feature_incompat = 0x0002; // FILETYPE
+        sb->s_feature_compat = EXT2_FEATURE_COMPAT_DIR_INDEX;
+        sb->s_def_hash_version = DX_HASH_HALF_MD4;
+        sb->s_flags = EXT2_FLAGS_SIGNED_HASH;
 
-        // Generate UUID from RDTSC
+        // Generate UUID and directory hash seed from RDTSC
         uint32_t lo, hi;
         asm volatile ("rdtsc" : "=a"(lo), "=d"(hi));
         uint32_t seed = lo ^ hi;
@@ -1815,6 +3039,10 @@ namespace Fs::Ext2 {
             seed = seed * 1103515245 + 12345;
             sb->s_uuid[i] = (uint8_t)(seed >> 16);
         }
+        for (int i = 0; i < 4; i++) {
+            seed = seed * 1103515245 + 12345;
+            sb->s_hash_seed[i] = seed;
+        }
 
         memset(sb->s_volume_name, 0, 16);
         if (volumeLabel) {
@@ -1936,6 +3164,8 @@ namespace Fs::Ext2 {
 
         Memory::g_pfa->Free(buf, 1);
 
+        if (!Drivers::Storage::BufferCache::Flush(dev)) return -1;
+
         KernelLogStream(OK, "Ext2") << "Formatted: " << (uint64_t)totalBlocks
             << " blocks (4K), " << (uint64_t)groupCount
             << " groups, " << (uint64_t)totalInodes << " inodes";
@@ -7,9 +7,11 @@
 #include "Fat32.hpp"
 #include "FsProbe.hpp"
 #include <Drivers/Storage/BlockDevice.hpp>
+#include <Drivers/Storage/BufferCache.hpp>
 #include <Terminal/Terminal.hpp>
 #include <Libraries/Memory.hpp>
 #include <Memory/PageFrameAllocator.hpp>
+#include <Timekeeping/Time.hpp>
 
 using namespace Kt;
 
@@ -24,6 +26,9 @@ namespace Fs::Fat32 {
     static constexpr int MaxDirEntries = 128;
     static constexpr int MaxNameLen = 256;
 
+    // Largest single transfer of a contiguous cluster run
+    static constexpr uint32_t MaxRunBytes = 1024 * 1024;
+
     // Directory entry attributes
     static constexpr uint8_t ATTR_READ_ONLY = 0x01;
     static constexpr uint8_t ATTR_HIDDEN    = 0x02;
@@ -53,6 +58,9 @@ namespace Fs::Fat32 {
         // Cached position for sequential access (avoids O(n²) chain walks)
         uint32_t cachedClusterIdx;  // cluster index in chain
         uint32_t cachedCluster;     // cluster number at that index
+        // Size or first cluster changed since the directory entry was
+        // written; kept until SyncImpl, even after the handle is closed
+        bool     entryDirty;
     };
 
     struct Fat32Instance {
@@ -84,6 +92,12 @@ namespace Fs::Fat32 {
         int       fatCachePages;
         uint32_t  fatCacheEntries;  // number of valid 4-byte entries
 
+        // Bitmap of clusters in use, built from the FAT cache (nullptr
+        // without one), and the lowest cluster that may be free
+        uint64_t* usedMap;
+        int       usedMapPages;
+        uint32_t  nextFree;
+
         // Open file handles
         Fat32File files[MaxFilesPerInstance];
 
@@ -117,7 +131,7 @@ namespace Fs::Fat32 {
                                  uint32_t count, void* buf) {
         auto* dev = Drivers::Storage::GetBlockDevice(inst.blockDevIndex);
         if (!dev) return false;
-        return dev->ReadSectors(dev->Ctx, inst.partStartLba + partSector, count, buf);
+        return Drivers::Storage::BufferCache::Read(dev, inst.partStartLba + partSector, count, buf);
     }
 
     static uint64_t ClusterToPartSector(const Fat32Instance& inst, uint32_t cluster) {
@@ -164,7 +178,7 @@ namespace Fs::Fat32 {
                                   uint32_t count, const void* buf) {
         auto* dev = Drivers::Storage::GetBlockDevice(inst.blockDevIndex);
         if (!dev) return false;
-        return dev->WriteSectors(dev->Ctx, inst.partStartLba + partSector, count, buf);
+        return Drivers::Storage::BufferCache::Write(dev, inst.partStartLba + partSector, count, buf);
     }
 
     static bool WriteClusterData(Fat32Instance& inst, uint32_t cluster, const void* data) {
@@ -173,7 +187,44 @@ namespace Fs::Fat32 {
                                 inst.sectorsPerCluster, data);
     }
 
+    static bool ClusterInUse(const Fat32Instance& inst, uint32_t cluster) {
+        return inst.usedMap[cluster / 64] & (1ULL << (cluster % 64));
+    }
+
+    static void MarkCluster(Fat32Instance& inst, uint32_t cluster, bool used) {
+        if (!inst.usedMap || cluster < 2 || cluster >= inst.clusterCount + 2) return;
+        if (used) {
+            inst.usedMap[cluster / 64] |= 1ULL << (cluster % 64);
+        } else {
+            inst.usedMap[cluster / 64] &= ~(1ULL << (cluster % 64));
+            if (cluster < inst.nextFree) inst.nextFree = cluster;
+        }
+    }
+
+    // Write the cached FAT sectors holding entries [first, first + count)
+    // to every copy of the FAT
+    static bool WriteFatCacheRange(Fat32Instance& inst, uint32_t first, uint32_t count) {
+        uint32_t perSector = inst.bytesPerSector / 4;
+        uint32_t firstSector = first / perSector;
+        uint32_t sectors = (first + count - 1) / perSector - firstSector + 1;
+        const uint8_t* data = (const uint8_t*)inst.fatCache + (uint64_t)firstSector * inst.bytesPerSector;
+
+        for (int f = 0; f < inst.numFats; f++) {
+            uint64_t fatStart = inst.reservedSectors + (uint64_t)f * inst.fatSize32;
+            if (!WritePartSectors(inst, fatStart + firstSector, sectors, data)) return false;
+        }
+        return true;
+    }
+
     static bool WriteFatEntry(Fat32Instance& inst, uint32_t cluster, uint32_t value) {
+        // With the FAT cached, update the entry there and write its sector out
+        if (inst.fatCache && cluster < inst.fatCacheEntries) {
+            uint32_t existing = inst.fatCache[cluster];
+            inst.fatCache[cluster] = (existing & 0xF0000000) | (value & 0x0FFFFFFF);
+            MarkCluster(inst, cluster, (value & 0x0FFFFFFF) != CLUSTER_FREE);
+            return WriteFatCacheRange(inst, cluster, 1);
+        }
+
         uint32_t fatOffset = cluster * 4;
         uint32_t fatSector = fatOffset / inst.bytesPerSector;
         uint32_t entryOffset = fatOffset % inst.bytesPerSector;
@@ -194,17 +245,12 @@ namespace Fs::Fat32 {
             if (!WritePartSectors(inst, fatStart + fatSector, 1, sectorBuf)) return false;
         }
 
-        // Keep in-memory FAT cache in sync
-        if (inst.fatCache && cluster < inst.fatCacheEntries) {
-            uint32_t existing = inst.fatCache[cluster];
-            inst.fatCache[cluster] = (existing & 0xF0000000) | (value & 0x0FFFFFFF);
-        }
-
         return true;
     }
 
-    static uint32_t AllocateCluster(Fat32Instance& inst) {
-        // Fast path: scan the in-memory FAT cache
+    // Without a bitmap: the first free cluster, found in the FAT cache or
+    // read from disk a sector at a time
+    static uint32_t AllocateClusterSlow(Fat32Instance& inst) {
         if (inst.fatCache) {
             uint32_t limit = inst.clusterCount + 2;
             if (limit > inst.fatCacheEntries) limit = inst.fatCacheEntries;
@@ -217,7 +263,6 @@ namespace Fs::Fat32 {
             return 0;
         }
 
-        // Slow path: read FAT sectors from disk
         uint8_t sectorBuf[512];
         uint32_t entriesPerSector = inst.bytesPerSector / 4;
 
@@ -241,12 +286,92 @@ namespace Fs::Fat32 {
         return 0;
     }
 
-    // Update the file size field in a file's SFN directory entry on disk
-    static bool UpdateDirEntrySize(Fat32Instance& inst, const Fat32File& file) {
-        uint8_t sectorBuf[512];
-        if (!ReadPartSectors(inst, file.sfnPartSector, 1, sectorBuf)) return false;
-        memcpy(sectorBuf + file.sfnOffInSector + 28, &file.fileSize, 4);
-        return WritePartSectors(inst, file.sfnPartSector, 1, sectorBuf);
+    // The first free run in clusters [start, end) of at least `want`
+    // clusters, else the longest one there. Returns its length (0 if
+    // everything is used) and its start in `found`.
+    static uint32_t FindFreeRun(const Fat32Instance& inst, uint32_t start, uint32_t end,
+                                uint32_t want, uint32_t& found) {
+        uint32_t bestLen = 0;
+        uint32_t cluster = start;
+        while (cluster < end) {
+            // Skip fully used words
+            if (cluster % 64 == 0 && inst.usedMap[cluster / 64] == ~0ULL) {
+                cluster += 64;
+                continue;
+            }
+            if (ClusterInUse(inst, cluster)) {
+                cluster++;
+                continue;
+            }
+
+            uint32_t runStart = cluster;
+            while (cluster < end && cluster - runStart < want && !ClusterInUse(inst, cluster)) cluster++;
+            uint32_t len = cluster - runStart;
+            if (len > bestLen) {
+                bestLen = len;
+                found = runStart;
+                if (len >= want) break;
+            }
+        }
+        return bestLen;
+    }
+
+    // Allocate up to `want` contiguous clusters, linked into a chain that
+    // ends at the last of them: at `goal` if it is free (so a file grows
+    // in place), else at the first run of `want` free clusters, settling
+    // for the longest shorter one. Returns the first cluster and sets
+    // `count`, or returns 0 if the volume is full.
+    static uint32_t AllocateClusters(Fat32Instance& inst, uint32_t goal, uint32_t want, uint32_t& count) {
+        count = 0;
+        if (want == 0) return 0;
+        if (!inst.usedMap) {
+            uint32_t cluster = AllocateClusterSlow(inst);
+            if (cluster) count = 1;
+            return cluster;
+        }
+
+        uint32_t limit = inst.clusterCount + 2;
+        uint32_t first = 0, len = 0;
+        if (goal >= inst.nextFree && goal < limit && !ClusterInUse(inst, goal)) {
+            first = goal;
+            while (len < want && first + len < limit && !ClusterInUse(inst, first + len)) len++;
+        } else {
+            len = FindFreeRun(inst, inst.nextFree, limit, want, first);
+        }
+        if (len == 0) return 0;
+
+        for (uint32_t i = 0; i < len; i++) {
+            uint32_t next = i + 1 < len ? first + i + 1 : 0x0FFFFFFF;
+            inst.fatCache[first + i] = (inst.fatCache[first + i] & 0xF0000000) | next;
+            MarkCluster(inst, first + i, true);
+        }
+        if (!WriteFatCacheRange(inst, first, len)) return 0;
+
+        // Nothing below nextFree is free
+        while (inst.nextFree < limit && ClusterInUse(inst, inst.nextFree)) {
+            if (inst.nextFree % 64 == 0 && inst.usedMap[inst.nextFree / 64] == ~0ULL) inst.nextFree += 64;
+            else inst.nextFree++;
+        }
+
+        count = len;
+        return first;
+    }
+
+    static uint32_t AllocateCluster(Fat32Instance& inst) {
+        uint32_t count;
+        return AllocateClusters(inst, 0, 1, count);
+    }
+
+    // Number of clusters from `cluster` on that follow each other on
+    // disk in the chain, at most `maxRun`; `next` is the cluster after them
+    static uint32_t ChainRun(const Fat32Instance& inst, uint32_t cluster, uint32_t maxRun, uint32_t& next) {
+        uint32_t run = 1;
+        next = GetNextCluster(inst, cluster);
+        while (run < maxRun && next == cluster + run) {
+            next = GetNextCluster(inst, next);
+            run++;
+        }
+        return run;
     }
 
     // Update both first-cluster and file-size in a file's SFN directory entry
@@ -823,16 +948,12 @@ namespace Fs::Fat32 {
     // FsDriver implementation functions
     // =========================================================================
 
-    static int OpenImpl(int inst, const char* path) {
-        if (inst < 0 || inst >= g_instanceCount || !g_instances[inst].active) return -1;
-
-        ParsedEntry entry;
-        if (!TraversePath(inst, path, &entry)) return -1;
-
+    static int OpenEntry(Fat32Instance& self, const ParsedEntry& entry) {
         // Find a free file handle
-        auto& self = g_instances[inst];
         for (int i = 0; i < MaxFilesPerInstance; i++) {
             if (!self.files[i].inUse) {
+                if (self.files[i].entryDirty) UpdateDirEntry(self, self.files[i]);
+                self.files[i].entryDirty = false;
                 self.files[i].inUse = true;
                 self.files[i].firstCluster = entry.firstCluster;
                 self.files[i].fileSize = entry.fileSize;
@@ -848,6 +969,66 @@ namespace Fs::Fat32 {
         return -1; // no free handle
     }
 
+    static int OpenImpl(int inst, const char* path) {
+        if (inst < 0 || inst >= g_instanceCount || !g_instances[inst].active) return -1;
+
+        ParsedEntry entry;
+        if (!TraversePath(inst, path, &entry)) return -1;
+        return OpenEntry(g_instances[inst], entry);
+    }
+
+    // Name cache nodes locate an entry's SFN record on disk: partition
+    // sector << 16 | byte offset in it. 0 stands for the root directory,
+    // which has no record (sector 0 is the boot sector).
+    static uint64_t NodeOf(const ParsedEntry& entry) {
+        return (entry.sfnPartSector << 16) | entry.sfnOffInSector;
+    }
+
+    // Load the directory entry a node points at
+    static bool ReadNode(int inst, uint64_t node, ParsedEntry* out) {
+        if (node == 0) return TraversePath(inst, "", out);
+
+        uint8_t sectorBuf[512];
+        uint64_t sector = node >> 16;
+        uint32_t off = (uint32_t)(node & 0xFFFF);
+        if (off > sizeof(sectorBuf) - 32) return false;
+        if (!ReadPartSectors(g_instances[inst], sector, 1, sectorBuf)) return false;
+
+        uint8_t* e = sectorBuf + off;
+        if (e[0] == 0x00 || e[0] == 0xE5 || e[11] == ATTR_LFN) return false;
+
+        uint16_t clHi, clLo;
+        memcpy(&clHi, e + 20, 2);
+        memcpy(&clLo, e + 26, 2);
+        out->firstCluster = ((uint32_t)clHi << 16) | (uint32_t)clLo;
+        memcpy(&out->fileSize, e + 28, 4);
+        out->attributes = e[11];
+        out->name[0] = '\0';
+        out->sfnPartSector = sector;
+        out->sfnOffInSector = off;
+        return true;
+    }
+
+    static int64_t LookupImpl(int inst, uint64_t dir, const char* name) {
+        if (inst < 0 || inst >= g_instanceCount || !g_instances[inst].active) return -2;
+
+        ParsedEntry dirEntry;
+        if (!ReadNode(inst, dir, &dirEntry)) return -2;
+        if (!(dirEntry.attributes & ATTR_DIRECTORY)) return -1;
+
+        ParsedEntry found;
+        if (!FindInDirectory(inst, dirEntry.firstCluster, name, &found)) return -1;
+        return (int64_t)NodeOf(found);
+    }
+
+    static int OpenNodeImpl(int inst, uint64_t node) {
+        if (inst < 0 || inst >= g_instanceCount || !g_instances[inst].active) return -1;
+
+        ParsedEntry entry;
+        if (!ReadNode(inst, node, &entry)) return -1;
+        return OpenEntry(g_instances[inst], entry);
+    }
+
     static int ReadImpl(int inst, int handle, uint8_t* buffer,
                          uint64_t offset, uint64_t size) {
         if (inst < 0 || inst >= g_instanceCount) return -1;
@@ -885,10 +1066,26 @@ namespace Fs::Fat32 {
         uint64_t bytesRead = 0;
         uint32_t lastCluster = cluster;
         while (bytesRead < size && !IsEndOfChain(cluster)) {
+            uint64_t toRead = size - bytesRead;
+
+            // Whole clusters: read the run that lies contiguous on disk in
+            // one request, straight into the caller's buffer
+            if (clusterOff == 0 && toRead >= clusterSize) {
+                uint64_t maxRun = toRead / clusterSize;
+                if (maxRun > MaxRunBytes / clusterSize) maxRun = MaxRunBytes / clusterSize;
+                uint32_t next;
+                uint32_t run = ChainRun(self, cluster, (uint32_t)maxRun, next);
+                if (!ReadPartSectors(self, ClusterToPartSector(self, cluster),
+                                     run * self.sectorsPerCluster, buffer + bytesRead)) break;
+                bytesRead += (uint64_t)run * clusterSize;
+                lastCluster = cluster + run - 1;
+                cluster = next;
+                continue;
+            }
+
             if (!ReadCluster(self, cluster)) break;
 
             uint32_t available = clusterSize - clusterOff;
-            uint64_t toRead = size - bytesRead;
             if (toRead > available) toRead = available;
 
             memcpy(buffer + bytesRead, self.clusterBuf + clusterOff, toRead);
@@ -955,6 +1152,126 @@ namespace Fs::Fat32 {
         return count;
     }
 
+    // FAT stores local date and time with 2-second resolution; 0 if unset
+    static int64_t EntryMtime(const uint8_t* e) {
+        uint16_t time, date;
+        memcpy(&time, e + 22, 2);
+        memcpy(&date, e + 24, 2);
+        uint8_t month = (date >> 5) & 0x0F, day = date & 0x1F;
+        if (month < 1 || month > 12 || day == 0) return 0;
+        return Timekeeping::DateToUnixTimestamp(1980 + (date >> 9), month, day,
+                                                time >> 11, (time >> 5) & 0x3F, (time & 0x1F) * 2);
+    }
+
+    // The cursor is the byte offset of the next 32-byte entry in the
+    // directory's cluster chain. It only ever stops after a complete
+    // entry, so a long name is never split across calls.
+    static int ReadDirStatImpl(int inst, const char* path, uint64_t* cursor,
+                               Vfs::DirStat* out, int maxEntries) {
+        if (inst < 0 || inst >= g_instanceCount) return -1;
+        auto& self = g_instances[inst];
+
+        ParsedEntry dirEntry;
+        if (!TraversePath(inst, path, &dirEntry)) return -1;
+        if (!(dirEntry.attributes & ATTR_DIRECTORY)) return -1;
+
+        uint64_t pos = *cursor & ~31ULL;
+        uint32_t cluster = dirEntry.firstCluster;
+        for (uint64_t skip = pos / self.clusterSize; skip > 0 && !IsEndOfChain(cluster); skip--) {
+            cluster = GetNextCluster(self, cluster);
+        }
+
+        uint16_t lfnBuf[MaxNameLen];
+        bool hasLfn = false;
+        int count = 0;
+        int perCluster = (int)(self.clusterSize / 32);
+
+        while (!IsEndOfChain(cluster) && count < maxEntries) {
+            if (!ReadCluster(self, cluster)) break;
+
+            for (int i = (int)((pos % self.clusterSize) / 32);
+                 i < perCluster && count < maxEntries; i++, pos += 32) {
+                uint8_t* e = self.clusterBuf + i * 32;
+
+                if (e[0] == 0x00) {  // end of directory
+                    *cursor = pos;
+                    return count;
+                }
+                if (e[0] == 0xE5) { hasLfn = false; continue; }
+
+                uint8_t attr = e[11];
+
+                if (attr == ATTR_LFN) {
+                    uint8_t seq = e[0];
+                    int seqNum = seq & 0x1F;
+                    if (seq & 0x40) {
+                        for (int k = 0; k < MaxNameLen; k++) lfnBuf[k] = 0;
+                        hasLfn = true;
+                    }
+                    if (hasLfn && seqNum >= 1 && seqNum <= 20) {
+                        uint16_t chars[13];
+                        ExtractLfnChars(e, chars);
+                        int offset = (seqNum - 1) * 13;
+                        for (int k = 0; k < 13 && offset + k < MaxNameLen; k++) {
+                            lfnBuf[offset + k] = chars[k];
+                        }
+                    }
+                    continue;
+                }
+
+                if (attr & ATTR_VOLUME_ID) { hasLfn = false; continue; }
+
+                char name[MaxNameLen];
+                if (hasLfn) {
+                    Utf16ToAscii(lfnBuf, MaxNameLen, name);
+                } else {
+                    ParseShortName(e, name);
+                }
+                hasLfn = false;
+
+                if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) {
+                    continue;
+                }
+
+                Vfs::DirStat& st = out[count++];
+                int j = 0;
+                while (name[j] && j < (int)sizeof(st.name) - 1) {
+                    st.name[j] = name[j];
+                    j++;
+                }
+                st.name[j] = '\0';
+                bool isDir = (attr & ATTR_DIRECTORY) != 0;
+                st.type = isDir ? Vfs::EntryDirectory : Vfs::EntryFile;
+                uint32_t fileSize;
+                memcpy(&fileSize, e + 28, 4);
+                st.size = isDir ? 0 : fileSize;
+                st.mtime = EntryMtime(e);
+            }
+
+            cluster = GetNextCluster(self, cluster);
+        }
+
+        *cursor = pos;
+        return count;
+    }
+
+    // Allocate up to `want` clusters for the end of a file's chain and
+    // link them in after `last` (0 if the file has none yet), right behind
+    // it on disk if there is room. Returns the first, or 0 if the volume
+    // is full.
+    static uint32_t ExtendChain(Fat32Instance& inst, Fat32File& file, uint32_t last,
+                                uint32_t want, uint32_t& count) {
+        uint32_t first = AllocateClusters(inst, last >= 2 ? last + 1 : 0, want, count);
+        if (first == 0) return 0;
+        if (last >= 2) {
+            WriteFatEntry(inst, last, first);
+        } else {
+            file.firstCluster = first;
+            file.entryDirty = true;
+        }
+        return first;
+    }
+
     static int WriteImpl(int inst, int handle, const uint8_t* buffer,
                           uint64_t offset, uint64_t size) {
         if (inst < 0 || inst >= g_instanceCount) return -1;
@@ -966,68 +1283,80 @@ namespace Fs::Fat32 {
         if (size == 0) return 0;
 
         uint32_t clusterSize = self.clusterSize;
-
-        // If file has no clusters yet, allocate the first one
-        if (file.firstCluster < 2) {
-            uint32_t cl = AllocateCluster(self);
-            if (cl == 0) return -1;
-            file.firstCluster = cl;
-            // Zero the new cluster
-            memset(self.clusterBuf, 0, clusterSize);
-            WriteClusterData(self, cl, self.clusterBuf);
-            UpdateDirEntry(self, file);
-        }
-
         uint64_t bytesWritten = 0;
 
-        // Walk cluster chain to the starting cluster for this offset
         uint32_t clusterIdx = (uint32_t)(offset / clusterSize);
         uint32_t clusterOff = (uint32_t)(offset % clusterSize);
 
-        // Use cached position if we can skip ahead
+        // Use cached position if we can skip ahead. A file without
+        // clusters starts at the end of its (empty) chain.
         uint32_t cluster;
         uint32_t prevCluster = 0;
-        uint32_t startIdx = 0;
-        if (file.cachedCluster >= 2 && file.cachedClusterIdx <= clusterIdx) {
+        uint32_t idx = 0;
+        if (file.firstCluster >= 2 && file.cachedCluster >= 2 && file.cachedClusterIdx <= clusterIdx) {
             cluster = file.cachedCluster;
-            startIdx = file.cachedClusterIdx;
+            idx = file.cachedClusterIdx;
         } else {
             cluster = file.firstCluster;
         }
 
-        for (uint32_t i = startIdx; i < clusterIdx; i++) {
-            prevCluster = cluster;
-            uint32_t next = GetNextCluster(self, cluster);
-            if (IsEndOfChain(next)) {
-                // Need to extend the chain
-                next = AllocateCluster(self);
-                if (next == 0) goto done;
-                WriteFatEntry(self, cluster, next);
+        // Clusters allocated by this write, which hold nothing to merge with
+        uint32_t freshFirst = 0;
+        uint32_t freshEnd = 0;
+
+        // Walk the chain to the cluster for this offset, filling a gap
+        // past its end with zeroed clusters
+        for (; idx < clusterIdx; idx++) {
+            if (IsEndOfChain(cluster)) {
+                uint32_t count;
+                cluster = ExtendChain(self, file, prevCluster, 1, count);
+                if (cluster == 0) goto done;
                 memset(self.clusterBuf, 0, clusterSize);
-                WriteClusterData(self, next, self.clusterBuf);
+                if (!WriteClusterData(self, cluster, self.clusterBuf)) goto done;
             }
-            cluster = next;
+            prevCluster = cluster;
+            cluster = GetNextCluster(self, cluster);
         }
 
-        // Write data cluster by cluster
         while (bytesWritten < size) {
-            if (IsEndOfChain(cluster) || cluster < 2) {
-                // Allocate a new cluster and link it
-                uint32_t newCl = AllocateCluster(self);
-                if (newCl == 0) goto done;
-                if (prevCluster != 0) {
-                    WriteFatEntry(self, prevCluster, newCl);
-                }
-                memset(self.clusterBuf, 0, clusterSize);
-                WriteClusterData(self, newCl, self.clusterBuf);
-                cluster = newCl;
+            uint64_t remaining = size - bytesWritten;
+
+            if (IsEndOfChain(cluster)) {
+                // Allocate what the rest of the write needs, in one run
+                // right behind the chain if possible
+                uint64_t want = (clusterOff + remaining + clusterSize - 1) / clusterSize;
+                if (want > MaxRunBytes / clusterSize) want = MaxRunBytes / clusterSize;
+                uint32_t count;
+                cluster = ExtendChain(self, file, prevCluster, (uint32_t)want, count);
+                if (cluster == 0) goto done;
+                freshFirst = cluster;
+                freshEnd = cluster + count;
             }
 
-            // Read existing cluster data (for partial writes)
-            if (!ReadCluster(self, cluster)) goto done;
+            // Whole clusters: write the run that lies contiguous on disk
+            // in one request, straight from the caller's buffer
+            if (clusterOff == 0 && remaining >= clusterSize) {
+                uint64_t maxRun = remaining / clusterSize;
+                if (maxRun > MaxRunBytes / clusterSize) maxRun = MaxRunBytes / clusterSize;
+                uint32_t next;
+                uint32_t run = ChainRun(self, cluster, (uint32_t)maxRun, next);
+                if (!WritePartSectors(self, ClusterToPartSector(self, cluster),
+                                      run * self.sectorsPerCluster, buffer + bytesWritten)) goto done;
+                bytesWritten += (uint64_t)run * clusterSize;
+                prevCluster = cluster + run - 1;
+                cluster = next;
+                continue;
+            }
+
+            // Partial cluster: merge with the existing data, or zeros
+            if (cluster >= freshFirst && cluster < freshEnd) {
+                memset(self.clusterBuf, 0, clusterSize);
+            } else if (!ReadCluster(self, cluster)) {
+                goto done;
+            }
 
             uint32_t available = clusterSize - clusterOff;
-            uint64_t toWrite = size - bytesWritten;
+            uint64_t toWrite = remaining;
             if (toWrite > available) toWrite = available;
 
             memcpy(self.clusterBuf + clusterOff, buffer + bytesWritten, toWrite);
@@ -1049,16 +1378,29 @@ namespace Fs::Fat32 {
             file.cachedCluster = prevCluster;
         }
 
-        // Update file size if we wrote past the end
+        // Update file size if we wrote past the end. The directory entry
+        // follows in SyncImpl, once the data and FAT are on disk.
         uint64_t endPos = offset + bytesWritten;
         if (endPos > file.fileSize) {
             file.fileSize = (uint32_t)endPos;
-            UpdateDirEntrySize(self, file);
+            file.entryDirty = true;
         }
 
         return (int)bytesWritten;
     }
 
+    // Write the directory entries of files whose size or first cluster
+    // changed, open or closed since
+    static void SyncImpl(int inst) {
+        if (inst < 0 || inst >= g_instanceCount) return;
+        auto& self = g_instances[inst];
+        for (int i = 0; i < MaxFilesPerInstance; i++) {
+            if (!self.files[i].entryDirty) continue;
+            UpdateDirEntry(self, self.files[i]);
+            self.files[i].entryDirty = false;
+        }
+    }
+
     static int CreateImpl(int inst, const char* path) {
         if (inst < 0 || inst >= g_instanceCount || !g_instances[inst].active) return -1;
         auto& self = g_instances[inst];
@@ -1698,6 +2040,10 @@ namespace Fs::Fat32 {
         static int Delete(const char* p) { return DeleteImpl(N, p); }
         static int Mkdir(const char* p) { return MkdirImpl(N, p); }
         static int Rename(const char* o, const char* n) { return RenameImpl(N, o, n); }
+        static int64_t Lookup(uint64_t d, const char* n) { return LookupImpl(N, d, n); }
+        static int OpenNode(uint64_t n) { return OpenNodeImpl(N, n); }
+        static int ReadDirStat(const char* p, uint64_t* c, Vfs::DirStat* o, int m) { return ReadDirStatImpl(N, p, c, o, m); }
+        static void Sync() { SyncImpl(N); }
     };
 
     template<int N>
@@ -1713,6 +2059,10 @@ namespace Fs::Fat32 {
             Thunks<N>::Delete,
             Thunks<N>::Mkdir,
             Thunks<N>::Rename,
+            Thunks<N>::Lookup,
+            Thunks<N>::OpenNode,
+            Thunks<N>::ReadDirStat,
+            Thunks<N>::Sync,
         };
     }
 
@@ -1733,7 +2083,7 @@ namespace Fs::Fat32 {
 
         // Read the first sector of the partition (BPB / VBR)
         uint8_t bpb[512];
-        if (!dev->ReadSectors(dev->Ctx, startLba, 1, bpb)) return nullptr;
+        if (!Drivers::Storage::BufferCache::Read(dev, startLba, 1, bpb)) return nullptr;
 
         // Validate boot signature
         if (bpb[510] != 0x55 || bpb[511] != 0xAA) return nullptr;
@@ -1856,9 +2206,31 @@ namespace Fs::Fat32 {
             }
         }
 
+        // Build the free-cluster bitmap from the cached FAT. Entries the
+        // cache does not hold count as used.
+        inst.usedMap = nullptr;
+        inst.nextFree = clusterCount + 2;
+        if (inst.fatCache) {
+            uint32_t limit = clusterCount + 2;
+            uint64_t words = (limit + 63) / 64;
+            inst.usedMapPages = (int)((words * 8 + 0xFFF) / 0x1000);
+            inst.usedMap = (uint64_t*)Memory::g_pfa->AllocateContiguous(inst.usedMapPages);
+        }
+        if (inst.usedMap) {
+            memset(inst.usedMap, 0xFF, (uint64_t)inst.usedMapPages * 0x1000);
+            uint32_t limit = clusterCount + 2;
+            if (limit > inst.fatCacheEntries) limit = inst.fatCacheEntries;
+            for (uint32_t cluster = limit; cluster-- > 2;) {
+                if ((inst.fatCache[cluster] & 0x0FFFFFFF) != CLUSTER_FREE) continue;
+                inst.usedMap[cluster / 64] &= ~(1ULL << (cluster % 64));
+                inst.nextFree = cluster;
+            }
+        }
+
         // Clear file handles
         for (int i = 0; i < MaxFilesPerInstance; i++) {
             inst.files[i].inUse = false;
+            inst.files[i].entryDirty = false;
         }
 
         g_instanceCount++;
@@ -1993,13 +2365,13 @@ namespace Fs::Fat32 {
         bpb[511] = 0xAA;
 
         // --- Write boot sector ---
-        if (!dev->WriteSectors(dev->Ctx, startLba, 1, bpb)) {
+        if (!Drivers::Storage::BufferCache::Write(dev, startLba, 1, bpb)) {
             KernelLogStream(ERROR, "FAT32") << "Failed to write boot sector";
             return -1;
         }
 
         // --- Write backup boot sector at sector 6 ---
-        if (!dev->WriteSectors(dev->Ctx, startLba + backupBootSector, 1, bpb)) {
+        if (!Drivers::Storage::BufferCache::Write(dev, startLba + backupBootSector, 1, bpb)) {
             KernelLogStream(ERROR, "FAT32") << "Failed to write backup boot sector";
             return -1;
         }
@@ -2015,12 +2387,12 @@ namespace Fs::Fat32 {
         memcpy(fsinfo + 492, &nextFree, 4);
         uint32_t fsInfoSig3 = 0xAA550000; memcpy(fsinfo + 508, &fsInfoSig3, 4);
 
-        if (!dev->WriteSectors(dev->Ctx, startLba + 1, 1, fsinfo)) {
+        if (!Drivers::Storage::BufferCache::Write(dev, startLba + 1, 1, fsinfo)) {
             KernelLogStream(ERROR, "FAT32") << "Failed to write FSInfo";
             return -1;
         }
         // Backup FSInfo at sector 7
-        if (!dev->WriteSectors(dev->Ctx, startLba + 7, 1, fsinfo)) {
+        if (!Drivers::Storage::BufferCache::Write(dev, startLba + 7, 1, fsinfo)) {
             KernelLogStream(ERROR, "FAT32") << "Failed to write backup FSInfo";
             return -1;
         }
@@ -2030,7 +2402,7 @@ namespace Fs::Fat32 {
         memset(zeroBuf, 0, 512);
         for (uint16_t s = 2; s < reservedSectors; s++) {
             if (s == backupBootSector || s == 7) continue; // already written
-            dev->WriteSectors(dev->Ctx, startLba + s, 1, zeroBuf);
+            Drivers::Storage::BufferCache::Write(dev, startLba + s, 1, zeroBuf);
         }
 
         // --- Write FAT tables ---
@@ -2045,23 +2417,25 @@ namespace Fs::Fat32 {
             uint64_t fatStart = startLba + reservedSectors + (uint64_t)f * fatSize;
 
             // Write first sector with media byte + root cluster entry
-            if (!dev->WriteSectors(dev->Ctx, fatStart, 1, fatFirstSector)) {
+            if (!Drivers::Storage::BufferCache::Write(dev, fatStart, 1, fatFirstSector)) {
                 KernelLogStream(ERROR, "FAT32") << "Failed to write FAT " << f;
                 return -1;
             }
 
             // Zero remaining FAT sectors
             for (uint32_t s = 1; s < fatSize; s++) {
-                dev->WriteSectors(dev->Ctx, fatStart + s, 1, zeroBuf);
+                Drivers::Storage::BufferCache::Write(dev, fatStart + s, 1, zeroBuf);
             }
         }
 
         // --- Zero root directory cluster ---
         uint64_t rootSector = startLba + dataStart;
         for (uint8_t s = 0; s < sectorsPerCluster; s++) {
-            dev->WriteSectors(dev->Ctx, rootSector + s, 1, zeroBuf);
+            Drivers::Storage::BufferCache::Write(dev, rootSector + s, 1, zeroBuf);
         }
 
+        if (!Drivers::Storage::BufferCache::Flush(dev)) return -1;
+
         KernelLogStream(OK, "FAT32") << "Formatted: " << (uint64_t)clusterCount
             << " clusters, " << (uint64_t)sectorsPerCluster << " sec/cluster, FAT="
             << (uint64_t)fatSize << " sectors";
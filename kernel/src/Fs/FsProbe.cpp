@@ -14,6 +14,22 @@ namespace Fs::FsProbe {
     static ProbeFn g_probes[MaxProbes] = {};
     static int g_probeCount = 0;
 
+    // VFS drive each partition is mounted as, plus one (0 = not mounted)
+    static int g_partDrive[Drivers::Storage::Gpt::MaxPartitions] = {};
+
+    static void RecordMount(int partIndex, int driveNum) {
+        if (partIndex < 0 || partIndex >= Drivers::Storage::Gpt::MaxPartitions) return;
+        for (int i = 0; i < Drivers::Storage::Gpt::MaxPartitions; i++) {
+            if (g_partDrive[i] == driveNum + 1) g_partDrive[i] = 0;
+        }
+        g_partDrive[partIndex] = driveNum + 1;
+    }
+
+    int DriveOf(int partIndex) {
+        if (partIndex < 0 || partIndex >= Drivers::Storage::Gpt::MaxPartitions) return -1;
+        return g_partDrive[partIndex] - 1;
+    }
+
     void Register(ProbeFn fn) {
         if (g_probeCount < MaxProbes && fn) {
             g_probes[g_probeCount++] = fn;
@@ -45,6 +61,7 @@ namespace Fs::FsProbe {
 
                 if (driver) {
                     Vfs::RegisterDrive(driveNum, driver);
+                    RecordMount(i, driveNum);
                     Kt::KernelLogStream(Kt::OK, "FsProbe") << "Mounted partition "
                         << i << " as drive " << driveNum;
                     driveNum++;
@@ -65,6 +82,7 @@ namespace Fs::FsProbe {
 
                 if (driver) {
                     Vfs::RegisterDrive(driveNum, driver);
+                    RecordMount(i, driveNum);
                     Kt::KernelLogStream(Kt::OK, "FsProbe") << "Mounted EFI partition "
                         << i << " as drive " << driveNum;
                     driveNum++;
@@ -87,6 +105,7 @@ namespace Fs::FsProbe {
 
             if (driver) {
                 Vfs::RegisterDrive(driveNum, driver);
+                RecordMount(partIndex, driveNum);
                 Kt::KernelLogStream(Kt::OK, "FsProbe") << "Mounted partition "
                     << partIndex << " as drive " << driveNum;
                 return 0;
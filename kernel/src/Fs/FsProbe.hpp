@@ -26,4 +26,7 @@ namespace Fs::FsProbe {
     // Returns 0 on success, -1 if no probe recognized the filesystem.
     int MountPartition(int partIndex, int driveNum);
 
+    // VFS drive a partition (by global index) is mounted as, or -1
+    int DriveOf(int partIndex);
+
 };
@@ -0,0 +1,124 @@
+/*
+    * NameCache.cpp
+    * Path component lookup cache shared by all filesystem drivers
+    * Copyright (c) 2026 Daniel Hammer
+*/
+
+#include "NameCache.hpp"
+#include <CppLib/Spinlock.hpp>
+#include <Libraries/Memory.hpp>
+
+namespace Fs::NameCache {
+
+    static constexpr int Sets = 256;
+    static constexpr int Ways = 4;
+
+    struct Entry {
+        bool     valid;
+        uint8_t  drive;
+        uint8_t  len;
+        uint32_t hash;
+        uint64_t parent;
+        int64_t  node;
+        uint64_t lastUse;
+        char     name[MaxName];
+    };
+
+    // Entries are only read and written under the lock, which is never
+    // held across a driver call
+    static Entry g_sets[Sets][Ways];
+    static uint64_t g_clock = 0;
+    static kcp::Mutex g_lock;
+
+    static uint32_t Hash(int drive, uint64_t parent, const char* name, int len) {
+        uint32_t hash = 2166136261u;
+        hash = (hash ^ (uint8_t)drive) * 16777619u;
+        for (int i = 0; i < 8; i++) hash = (hash ^ (uint8_t)(parent >> (i * 8))) * 16777619u;
+        for (int i = 0; i < len; i++) hash = (hash ^ (uint8_t)name[i]) * 16777619u;
+        return hash;
+    }
+
+    static Entry* Find(Entry* set, uint32_t hash, int drive, uint64_t parent, const char* name, int len) {
+        for (int w = 0; w < Ways; w++) {
+            Entry& e = set[w];
+            if (e.valid && e.hash == hash && e.drive == drive && e.parent == parent &&
+                e.len == len && memcmp(e.name, name, len) == 0) return &e;
+        }
+        return nullptr;
+    }
+
+    static bool EqualNoCase(const char* a, const char* b, int len) {
+        for (int i = 0; i < len; i++) {
+            char ca = a[i], cb = b[i];
+            if (ca >= 'A' && ca <= 'Z') ca += 'a' - 'A';
+            if (cb >= 'A' && cb <= 'Z') cb += 'a' - 'A';
+            if (ca != cb) return false;
+        }
+        return true;
+    }
+
+    bool Lookup(int drive, uint64_t parent, const char* name, int len, int64_t& node) {
+        if (len <= 0 || len > MaxName) return false;
+        uint32_t hash = Hash(drive, parent, name, len);
+
+        g_lock.Acquire();
+        Entry* e = Find(g_sets[hash % Sets], hash, drive, parent, name, len);
+        if (e) {
+            e->lastUse = ++g_clock;
+            node = e->node;
+        }
+        g_lock.Release();
+        return e != nullptr;
+    }
+
+    void Insert(int drive, uint64_t parent, const char* name, int len, int64_t node) {
+        if (len <= 0 || len > MaxName) return;
+        uint32_t hash = Hash(drive, parent, name, len);
+        Entry* set = g_sets[hash % Sets];
+
+        g_lock.Acquire();
+        Entry* e = Find(set, hash, drive, parent, name, len);
+        if (e == nullptr) {
+            // A free way, else the least recently used one
+            e = &set[0];
+            for (int w = 0; w < Ways && e->valid; w++) {
+                if (!set[w].valid || set[w].lastUse < e->lastUse) e = &set[w];
+            }
+            e->valid = true;
+            e->drive = (uint8_t)drive;
+            e->len = (uint8_t)len;
+            e->hash = hash;
+            e->parent = parent;
+            memcpy(e->name, name, len);
+        }
+        e->node = node;
+        e->lastUse = ++g_clock;
+        g_lock.Release();
+    }
+
+    void ForgetName(int drive, const char* name, int len) {
+        if (len <= 0 || len > MaxName) return;
+
+        g_lock.Acquire();
+        for (int s = 0; s < Sets; s++) {
+            for (int w = 0; w < Ways; w++) {
+                Entry& e = g_sets[s][w];
+                if (e.valid && e.drive == drive && e.len == len && EqualNoCase(e.name, name, len)) {
+                    e.valid = false;
+                }
+            }
+        }
+        g_lock.Release();
+    }
+
+    void ForgetDrive(int drive) {
+        g_lock.Acquire();
+        for (int s = 0; s < Sets; s++) {
+            for (int w = 0; w < Ways; w++) {
+                if (g_sets[s][w].drive == drive) g_sets[s][w].valid = false;
+            }
+        }
+        g_lock.Release();
+    }
+
+};
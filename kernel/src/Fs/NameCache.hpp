@@ -0,0 +1,36 @@
+/*
+    * NameCache.hpp
+    * Path component lookup cache shared by all filesystem drivers
+    * Copyright (c) 2026 Daniel Hammer
+*/
+
+#pragma once
+#include <cstdint>
+
+namespace Fs::NameCache {
+
+    // Maps (drive, parent directory node, component name) to the child's
+    // node, or records that the parent has no such entry. Nodes are the
+    // driver-defined ids of FsDriver::Lookup. Entries are recycled least
+    // recently used first within a small hash set; names longer than
+    // MaxName are never cached.
+
+    static constexpr int64_t Missing = -1;   // Negative entry: no such name
+    static constexpr int MaxName = 47;
+
+    // Returns true on a hit and sets `node` (Missing for a negative entry)
+    bool Lookup(int drive, uint64_t parent, const char* name, int len, int64_t& node);
+
+    // Record the result of a driver lookup, positive or Missing
+    void Insert(int drive, uint64_t parent, const char* name, int len, int64_t node);
+
+    // Drop every entry of `drive` called `name` (compared without case, so
+    // it covers FAT), under any parent. For creates: the new file may be
+    // hiding behind a negative entry.
+    void ForgetName(int drive, const char* name, int len);
+
+    // Drop every entry of `drive`. For deletes, renames and remounts, which
+    // can free or move nodes that other entries still point at.
+    void ForgetDrive(int drive);
+
+};
@@ -8,7 +8,9 @@
 #include <Terminal/Terminal.hpp>
 #include <Libraries/String.hpp>
 #include <Libraries/Memory.hpp>
+#include <Libraries/Lz4.hpp>
 #include <Memory/Heap.hpp>
+#include <Timekeeping/Time.hpp>
 
 namespace Fs::Ramdisk {
 
@@ -23,30 +25,222 @@ namespace Fs::Ramdisk {
         return result;
     }
 
-    static bool StrEqual(const char* a, const char* b) {
-        while (*a && *b) {
-            if (*a != *b) return false;
-            a++;
-            b++;
-        }
-        return *a == *b;
-    }
-
     static int StrLen(const char* s) {
         int n = 0;
         while (s[n]) n++;
         return n;
     }
 
-    static bool StartsWith(const char* str, const char* prefix) {
-        while (*prefix) {
-            if (*str != *prefix) return false;
-            str++;
-            prefix++;
+    // Path index. Two open-addressed tables, both at most half full: full paths to
+    // entries, and directory paths to the list of entries directly inside
+    // them. A directory does not need an entry of its own to be listed,
+    // as tar archives may leave them out.
+    static constexpr int HashSlots = MaxFiles * 2;
+    static_assert((HashSlots & (HashSlots - 1)) == 0, "HashSlots must be a power of two");
+
+    struct DirList {
+        int16_t head;           // first child, -1 = slot unused
+        int16_t tail;
+    };
+
+    static int16_t pathSlots[HashSlots];
+    static DirList dirSlots[HashSlots];
+
+    static uint32_t HashPath(const char* path, int len) {
+        uint32_t h = 2166136261u;
+        for (int i = 0; i < len; i++) {
+            h ^= (uint8_t)path[i];
+            h *= 16777619u;
+        }
+        return h;
+    }
+
+    // `path` without leading or trailing '/'
+    static int Normalize(const char*& path) {
+        if (path[0] == '/') path++;
+        int len = StrLen(path);
+        if (len > 0 && path[len - 1] == '/') len--;
+        return len;
+    }
+
+    static int FindPath(const char* path, int len) {
+        for (uint32_t s = HashPath(path, len) & (HashSlots - 1); pathSlots[s] >= 0; s = (s + 1) & (HashSlots - 1)) {
+            const FileEntry& entry = fileTable[pathSlots[s]];
+            if (entry.keyLen == len && memcmp(entry.name, path, len) == 0) return pathSlots[s];
+        }
+        return -1;
+    }
+
+    // The list for directory `path`, or the free slot it would go in
+    static DirList& FindDir(const char* path, int len) {
+        uint32_t s = HashPath(path, len) & (HashSlots - 1);
+        for (; dirSlots[s].head >= 0; s = (s + 1) & (HashSlots - 1)) {
+            const FileEntry& child = fileTable[dirSlots[s].head];
+            if (child.parentLen == len && memcmp(child.name, path, len) == 0) break;
         }
+        return dirSlots[s];
+    }
+
+    static void IndexEntry(int index) {
+        FileEntry& entry = fileTable[index];
+        int len = StrLen(entry.name);
+        if (len > 0 && entry.name[len - 1] == '/') len--;
+
+        int slash = len - 1;
+        while (slash >= 0 && entry.name[slash] != '/') slash--;
+
+        entry.keyLen = (uint8_t)len;
+        entry.parentLen = (uint8_t)(slash > 0 ? slash : 0);
+        entry.nextSibling = -1;
+
+        // A duplicate path keeps resolving to the first entry
+        if (FindPath(entry.name, len) < 0) {
+            uint32_t s = HashPath(entry.name, len) & (HashSlots - 1);
+            while (pathSlots[s] >= 0) s = (s + 1) & (HashSlots - 1);
+            pathSlots[s] = (int16_t)index;
+        }
+
+        DirList& dir = FindDir(entry.name, entry.parentLen);
+        if (dir.head < 0) dir.head = (int16_t)index;
+        else fileTable[dir.tail].nextSibling = (int16_t)index;
+        dir.tail = (int16_t)index;
+    }
+
+    // Packed files
+
+    static const uint32_t* BlockEnds(const PackedHeader* hdr) {
+        return (const uint32_t*)(hdr + 1);
+    }
+
+    static bool ValidPacked(const uint8_t* data, uint64_t stored) {
+        if (stored < sizeof(PackedHeader)) return false;
+        const PackedHeader* hdr = (const PackedHeader*)data;
+        if (hdr->magic != PackedMagic) return false;
+        if (hdr->blockSize == 0 || hdr->blockSize > MaxPackedBlockSize) return false;
+        if (hdr->blockSize & (hdr->blockSize - 1)) return false;
+        if (hdr->blockCount != (hdr->size + hdr->blockSize - 1) / hdr->blockSize) return false;
+
+        uint64_t table = sizeof(PackedHeader) + (uint64_t)hdr->blockCount * sizeof(uint32_t);
+        if (table > stored) return false;
+
+        // Block ends only grow and stay inside the member
+        const uint32_t* ends = BlockEnds(hdr);
+        uint32_t prev = 0;
+        for (uint32_t i = 0; i < hdr->blockCount; i++) {
+            uint32_t end = ends[i] & ~PackedStored;
+            if (end < prev) return false;
+            prev = end;
+        }
+        return table + prev <= stored;
+    }
+
+    // Block `index` of a packed file, unpacking it on first use. Stored
+    // blocks are read straight from the initrd. Null on a corrupt block
+    // or when out of memory.
+    static const uint8_t* PackedBlock(FileEntry& entry, uint32_t index) {
+        const PackedHeader* hdr = entry.packed;
+        const uint32_t* ends = BlockEnds(hdr);
+        const uint8_t* base = (const uint8_t*)(ends + hdr->blockCount);
+
+        uint32_t start = index > 0 ? ends[index - 1] & ~PackedStored : 0;
+        uint32_t end = ends[index] & ~PackedStored;
+        uint64_t want = hdr->size - (uint64_t)index * hdr->blockSize;
+        if (want > hdr->blockSize) want = hdr->blockSize;
+
+        if (ends[index] & PackedStored) {
+            return (end - start == want) ? base + start : nullptr;
+        }
+
+        // Readers may race to unpack the same block; the first one to
+        // publish its copy wins and the others free theirs
+        uint8_t** blocks = __atomic_load_n(&entry.blocks, __ATOMIC_ACQUIRE);
+        if (blocks == nullptr) {
+            uint64_t bytes = (uint64_t)hdr->blockCount * sizeof(uint8_t*);
+            uint8_t** fresh = (uint8_t**)Memory::g_heap->Request(bytes);
+            if (fresh == nullptr) return nullptr;
+            memset(fresh, 0, bytes);
+            if (__atomic_compare_exchange_n(&entry.blocks, &blocks, fresh, false,
+                                            __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+                blocks = fresh;
+            } else {
+                Memory::g_heap->Free(fresh);
+            }
+        }
+
+        uint8_t* cached = __atomic_load_n(&blocks[index], __ATOMIC_ACQUIRE);
+        if (cached) return cached;
+
+        uint8_t* buf = (uint8_t*)Memory::g_heap->Request(want);
+        if (buf == nullptr) return nullptr;
+        if (Lib::Lz4DecompressBlock(base + start, end - start, buf, want) != (int64_t)want) {
+            Memory::g_heap->Free(buf);
+            Kt::KernelLogStream(Kt::ERROR, "Ramdisk") << "Corrupt block " << (uint64_t)index
+                << " in " << entry.name;
+            return nullptr;
+        }
+
+        if (!__atomic_compare_exchange_n(&blocks[index], &cached, buf, false,
+                                         __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            Memory::g_heap->Free(buf);
+            return cached;
+        }
+        return buf;
+    }
+
+    static int ReadPacked(FileEntry& entry, uint8_t* buffer, uint64_t offset, uint64_t size) {
+        uint32_t blockSize = entry.packed->blockSize;
+        uint64_t done = 0;
+        while (done < size) {
+            uint64_t pos = offset + done;
+            const uint8_t* block = PackedBlock(entry, (uint32_t)(pos / blockSize));
+            if (block == nullptr) return done > 0 ? (int)done : -1;
+
+            uint64_t within = pos % blockSize;
+            uint64_t chunk = blockSize - within;
+            if (chunk > size - done) chunk = size - done;
+            memcpy(buffer + done, block + within, chunk);
+            done += chunk;
+        }
+        return (int)done;
+    }
+
+    // Forget the packed form and its unpacked blocks
+    static void DropPacked(FileEntry& entry) {
+        if (entry.blocks) {
+            for (uint32_t i = 0; i < entry.packed->blockCount; i++) {
+                if (entry.blocks[i]) Memory::g_heap->Free(entry.blocks[i]);
+            }
+            Memory::g_heap->Free(entry.blocks);
+        }
+        entry.packed = nullptr;
+        entry.packedSize = 0;
+        entry.blocks = nullptr;
+    }
+
+    // Turn a packed file into an ordinary heap-backed one
+    static bool Unpack(FileEntry& entry) {
+        uint8_t* buf = (uint8_t*)Memory::g_heap->Request(entry.size);
+        if (buf == nullptr) return false;
+        if (ReadPacked(entry, buf, 0, entry.size) != (int)entry.size) {
+            Memory::g_heap->Free(buf);
+            return false;
+        }
+
+        DropPacked(entry);
+        entry.data = buf;
+        entry.capacity = entry.size;
+        entry.heapAllocated = true;
         return true;
     }
 
+    static void RebuildIndex() {
+        for (int s = 0; s < HashSlots; s++) {
+            pathSlots[s] = -1;
+            dirSlots[s] = { -1, -1 };
+        }
+        for (int i = 0; i < fileCount; i++) IndexEntry(i);
+    }
+
     void Initialize(void* moduleData, uint64_t moduleSize) {
         Kt::KernelLogStream(Kt::OK, "Ramdisk") << "Parsing USTAR archive (" << moduleSize << " bytes)";
 
@@ -54,6 +248,10 @@ namespace Fs::Ramdisk {
         uint8_t* end = ptr + moduleSize;
         fileCount = 0;
 
+        int packedCount = 0;
+        uint64_t packedBytes = 0;
+        uint64_t unpackedBytes = 0;
+
         while (ptr + 512 <= end && fileCount < MaxFiles) {
             // Check for end-of-archive (two consecutive zero blocks)
             bool allZero = true;
@@ -77,6 +275,8 @@ namespace Fs::Ramdisk {
             const char* name = (const char*)ptr;
             // File size at offset 124 (12 bytes, octal ASCII)
             uint64_t size = OctalToUint((const char*)(ptr + 124), 12);
+            // Modification time at offset 136 (12 bytes, octal ASCII)
+            uint64_t mtime = OctalToUint((const char*)(ptr + 136), 12);
             // Type flag at offset 156
             char typeFlag = (char)ptr[156];
 
@@ -105,13 +305,33 @@ namespace Fs::Ramdisk {
             }
 
             entry.isDirectory = (typeFlag == '5');
+            entry.mtime = (int64_t)mtime;
             entry.size = size;
             entry.capacity = size;
             entry.heapAllocated = false;
+            entry.packed = nullptr;
+            entry.packedSize = 0;
+            entry.blocks = nullptr;
 
             // Data starts at next 512-byte block
             entry.data = ptr + 512;
 
+            if (typeFlag == PackedType) {
+                if (ptr + 512 + size <= end && ValidPacked(ptr + 512, size)) {
+                    entry.packed = (const PackedHeader*)(ptr + 512);
+                    entry.packedSize = size;
+                    entry.size = entry.packed->size;
+                    entry.capacity = entry.size;
+                    entry.data = nullptr;
+                    packedCount++;
+                    packedBytes += size;
+                    unpackedBytes += entry.size;
+                } else {
+                    Kt::KernelLogStream(Kt::WARNING, "Ramdisk") << "Bad packed file " << entry.name << ", skipped";
+                    entry.name[0] = '\0';
+                }
+            }
+
             // Skip entries that are just the root "." or empty name
             if (entry.name[0] == '\0' || (entry.name[0] == '.' && entry.name[1] == '\0')) {
                 // Advance past header + data blocks
@@ -127,41 +347,27 @@ namespace Fs::Ramdisk {
             ptr += 512 + dataBlocks * 512;
         }
 
+        RebuildIndex();
         Kt::KernelLogStream(Kt::OK, "Ramdisk") << "Loaded " << fileCount << " entries";
+        if (packedCount > 0) {
+            Kt::KernelLogStream(Kt::OK, "Ramdisk") << packedCount << " packed files, "
+                << packedBytes / 1024 << " KiB holding " << unpackedBytes / 1024 << " KiB";
+        }
     }
 
     int Open(const char* path) {
-        // Normalize: skip leading '/'
-        if (path[0] == '/') path++;
+        int len = Normalize(path);
+        int index = FindPath(path, len);
 
-        for (int i = 0; i < fileCount; i++) {
-            if (StrEqual(fileTable[i].name, path)) {
-                return i;
-            }
-            // Also try matching with trailing slash stripped from table entry
-            int entryLen = StrLen(fileTable[i].name);
-            if (entryLen > 0 && fileTable[i].name[entryLen - 1] == '/') {
-                // Compare without trailing slash
-                bool match = true;
-                int pathLen = StrLen(path);
-                if (pathLen == entryLen - 1) {
-                    for (int j = 0; j < pathLen; j++) {
-                        if (path[j] != fileTable[i].name[j]) {
-                            match = false;
-                            break;
-                        }
-                    }
-                    if (match) return i;
-                }
-            }
-        }
-        return -1;
+        // "dir/" only names a directory
+        if (index >= 0 && path[len] == '/' && !fileTable[index].isDirectory) return -1;
+        return index;
     }
 
     int Read(int handle, uint8_t* buffer, uint64_t offset, uint64_t size) {
         if (handle < 0 || handle >= fileCount) return -1;
 
-        const FileEntry& entry = fileTable[handle];
+        FileEntry& entry = fileTable[handle];
         if (offset >= entry.size) return 0;
 
         uint64_t bytesToRead = size;
@@ -169,6 +375,8 @@ namespace Fs::Ramdisk {
             bytesToRead = entry.size - offset;
         }
 
+        if (entry.packed) return ReadPacked(entry, buffer, offset, bytesToRead);
+
         memcpy(buffer, entry.data + offset, bytesToRead);
         return (int)bytesToRead;
     }
@@ -183,54 +391,60 @@ namespace Fs::Ramdisk {
         (void)handle;
     }
 
+    const uint8_t* GetData(int handle, uint64_t* size) {
+        if (handle < 0 || handle >= fileCount) return nullptr;
+        FileEntry& entry = fileTable[handle];
+        if (entry.packed && !Unpack(entry)) return nullptr;
+        if (size) *size = entry.size;
+        return entry.data;
+    }
+
     int ReadDir(const char* path, const char** outNames, int maxEntries) {
-        // Normalize path: skip leading '/'
-        if (path[0] == '/') path++;
+        int len = Normalize(path);
+        DirList& dir = FindDir(path, len);
 
-        int pathLen = StrLen(path);
         int count = 0;
+        for (int i = dir.head; i >= 0 && count < maxEntries; i = fileTable[i].nextSibling) {
+            outNames[count++] = fileTable[i].name;
+        }
+        return count;
+    }
 
-        for (int i = 0; i < fileCount && count < maxEntries; i++) {
-            const char* entryName = fileTable[i].name;
-
-            if (pathLen == 0) {
-                // Root directory: find entries without '/' in them (or only trailing '/')
-                bool hasSlash = false;
-                int entryLen = StrLen(entryName);
-                for (int j = 0; j < entryLen; j++) {
-                    if (entryName[j] == '/' && j < entryLen - 1) {
-                        hasSlash = true;
-                        break;
-                    }
-                }
-                if (!hasSlash) {
-                    outNames[count++] = entryName;
-                }
-            } else {
-                // Subdirectory: match entries starting with "path/"
-                // and that are direct children (no additional '/' beyond the prefix)
-                if (!StartsWith(entryName, path)) continue;
-
-                // Check that path prefix is followed by '/'
-                char separator = entryName[pathLen];
-                if (separator != '/') continue;
-
-                // Check it's a direct child (no more '/' except trailing)
-                const char* rest = entryName + pathLen + 1;
-                int restLen = StrLen(rest);
-                bool hasDeepSlash = false;
-                for (int j = 0; j < restLen; j++) {
-                    if (rest[j] == '/' && j < restLen - 1) {
-                        hasDeepSlash = true;
-                        break;
-                    }
-                }
-                if (!hasDeepSlash && restLen > 0) {
-                    outNames[count++] = entryName;
-                }
+    // The cursor is the next entry of the directory's list plus one, with
+    // CursorEnd once the list is done
+    static constexpr uint64_t CursorEnd = ~0ull;
+
+    int ReadDirStat(const char* path, uint64_t* cursor, Vfs::DirStat* out, int maxEntries) {
+        int len = Normalize(path);
+
+        int i;
+        if (*cursor == 0) {
+            i = FindDir(path, len).head;
+        } else if (*cursor == CursorEnd || *cursor > (uint64_t)fileCount) {
+            i = -1;
+        } else {
+            i = (int)(*cursor - 1);
+        }
+
+        int count = 0;
+        for (; i >= 0 && count < maxEntries; i = fileTable[i].nextSibling) {
+            const FileEntry& entry = fileTable[i];
+
+            // Bare name: drop the directory prefix and a trailing '/'
+            int start = entry.parentLen > 0 ? entry.parentLen + 1 : 0;
+            Vfs::DirStat& st = out[count++];
+            int n = 0;
+            while (start + n < entry.keyLen && n < (int)sizeof(st.name) - 1) {
+                st.name[n] = entry.name[start + n];
+                n++;
             }
+            st.name[n] = '\0';
+            st.size = entry.isDirectory ? 0 : entry.size;
+            st.mtime = entry.mtime;
+            st.type = entry.isDirectory ? Vfs::EntryDirectory : Vfs::EntryFile;
         }
 
+        *cursor = (i >= 0) ? (uint64_t)i + 1 : CursorEnd;
         return count;
     }
 
@@ -243,6 +457,8 @@ namespace Fs::Ramdisk {
 
         uint64_t endOffset = offset + size;
 
+        if (entry.packed && !Unpack(entry)) return -1;
+
         // Copy-on-write: if data points into tar memory, copy to heap
         if (!entry.heapAllocated) {
             uint64_t newCap = entry.size;
@@ -287,6 +503,7 @@ namespace Fs::Ramdisk {
         if (endOffset > entry.size) {
             entry.size = endOffset;
         }
+        entry.mtime = Timekeeping::GetUnixTimestamp();
 
         return (int)size;
     }
@@ -295,25 +512,25 @@ namespace Fs::Ramdisk {
         if (path == nullptr) return -1;
         if (fileCount >= MaxFiles) return -1;
 
-        // Normalize: skip leading '/'
-        if (path[0] == '/') path++;
+        int len = Normalize(path);
 
         // Check if file already exists
-        for (int i = 0; i < fileCount; i++) {
-            if (StrEqual(fileTable[i].name, path)) {
-                // File exists — truncate it
-                FileEntry& entry = fileTable[i];
-                if (!entry.heapAllocated) {
-                    uint8_t* newBuf = (uint8_t*)Memory::g_heap->Request(256);
-                    if (newBuf == nullptr) return -1;
-                    entry.data = newBuf;
-                    entry.capacity = 256;
-                    entry.heapAllocated = true;
-                }
-                entry.size = 0;
-                entry.isDirectory = false;
-                return i;
+        int existing = FindPath(path, len);
+        if (existing >= 0) {
+            // File exists — truncate it
+            FileEntry& entry = fileTable[existing];
+            if (entry.isDirectory) return -1;
+            if (entry.packed) DropPacked(entry);
+            if (!entry.heapAllocated) {
+                uint8_t* newBuf = (uint8_t*)Memory::g_heap->Request(256);
+                if (newBuf == nullptr) return -1;
+                entry.data = newBuf;
+                entry.capacity = 256;
+                entry.heapAllocated = true;
             }
+            entry.size = 0;
+            entry.mtime = Timekeeping::GetUnixTimestamp();
+            return existing;
         }
 
         // Create new file entry
@@ -332,62 +549,53 @@ namespace Fs::Ramdisk {
         entry.data = buf;
         entry.size = 0;
         entry.capacity = 256;
+        entry.mtime = Timekeeping::GetUnixTimestamp();
         entry.isDirectory = false;
         entry.heapAllocated = true;
+        entry.packed = nullptr;
+        entry.packedSize = 0;
+        entry.blocks = nullptr;
 
+        IndexEntry(fileCount);
         return fileCount++;
     }
 
     int Delete(const char* path) {
         if (path == nullptr) return -1;
-        if (path[0] == '/') path++;
+        int len = Normalize(path);
+        int i = FindPath(path, len);
+        if (i < 0) return -1;  // not found
 
-        for (int i = 0; i < fileCount; i++) {
-            if (StrEqual(fileTable[i].name, path)) {
-                // Free heap-allocated data
-                if (fileTable[i].heapAllocated && fileTable[i].data) {
-                    Memory::g_heap->Free(fileTable[i].data);
-                }
+        // Free heap-allocated data
+        if (fileTable[i].heapAllocated && fileTable[i].data) {
+            Memory::g_heap->Free(fileTable[i].data);
+        }
+        if (fileTable[i].packed) DropPacked(fileTable[i]);
 
-                // Shift remaining entries down
-                for (int j = i; j < fileCount - 1; j++) {
-                    fileTable[j] = fileTable[j + 1];
-                }
-                fileCount--;
-                return 0;
-            }
+        // Shift remaining entries down; that renumbers them, so the
+        // index starts over
+        for (int j = i; j < fileCount - 1; j++) {
+            fileTable[j] = fileTable[j + 1];
         }
-        return -1;  // not found
+        fileCount--;
+        RebuildIndex();
+        return 0;
     }
 
     int Mkdir(const char* path) {
         if (path == nullptr) return -1;
         if (fileCount >= MaxFiles) return -1;
-        if (path[0] == '/') path++;
+        int len = Normalize(path);
 
         // Check if directory already exists
-        for (int i = 0; i < fileCount; i++) {
-            if (StrEqual(fileTable[i].name, path) && fileTable[i].isDirectory) {
-                return 0;  // already exists
-            }
-            // Also check with trailing slash
-            int pathLen = StrLen(path);
-            int entryLen = StrLen(fileTable[i].name);
-            if (entryLen == pathLen + 1 && fileTable[i].name[entryLen - 1] == '/' &&
-                fileTable[i].isDirectory) {
-                bool match = true;
-                for (int j = 0; j < pathLen; j++) {
-                    if (path[j] != fileTable[i].name[j]) { match = false; break; }
-                }
-                if (match) return 0;
-            }
-        }
+        int existing = FindPath(path, len);
+        if (existing >= 0) return fileTable[existing].isDirectory ? 0 : -1;
 
         // Create directory entry (stored with trailing slash for tar convention)
         FileEntry& entry = fileTable[fileCount];
 
         int nameLen = 0;
-        while (nameLen < MaxNameLen - 2 && path[nameLen] != '\0') {
+        while (nameLen < MaxNameLen - 2 && nameLen < len) {
             entry.name[nameLen] = path[nameLen];
             nameLen++;
         }
@@ -398,9 +606,14 @@ namespace Fs::Ramdisk {
         entry.data = nullptr;
         entry.size = 0;
         entry.capacity = 0;
+        entry.mtime = Timekeeping::GetUnixTimestamp();
         entry.isDirectory = true;
         entry.heapAllocated = false;
+        entry.packed = nullptr;
+        entry.packedSize = 0;
+        entry.blocks = nullptr;
 
+        IndexEntry(fileCount);
         fileCount++;
         return 0;
     }
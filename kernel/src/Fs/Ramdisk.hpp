@@ -7,19 +7,50 @@
 #pragma once
 #include <cstdint>
 #include <cstddef>
+#include "Vfs.hpp"
 
 namespace Fs::Ramdisk {
 
     static constexpr int MaxFiles = 512;
     static constexpr int MaxNameLen = 100;
 
+    // A tar member of type 'Z' is a packed file: this header, a table of
+    // blockCount uint32_t block end offsets (counted from the first block,
+    // PackedStored set for a block kept as is), then the LZ4 blocks. Each
+    // block holds blockSize bytes of the file, the last one the rest.
+    // scripts/mkramdisk.py writes them.
+    static constexpr char     PackedType   = 'Z';
+    static constexpr uint32_t PackedMagic  = 0x315A524D;   // "MRZ1"
+    static constexpr uint32_t PackedStored = 0x80000000;
+    static constexpr uint32_t MaxPackedBlockSize = 1024 * 1024;
+
+    struct PackedHeader {
+        uint32_t magic;
+        uint32_t blockSize;     // power of two
+        uint64_t size;          // unpacked file size
+        uint32_t blockCount;
+        uint32_t reserved;
+    };
+
     struct FileEntry {
         char name[MaxNameLen];
         uint8_t* data;
         uint64_t size;
         uint64_t capacity;
+        int64_t mtime;          // Unix seconds
         bool isDirectory;
         bool heapAllocated;
+
+        // Packed files: data is null until the file is written or mapped
+        // whole. Blocks are unpacked into `blocks` on first read.
+        const PackedHeader* packed;
+        uint64_t packedSize;
+        uint8_t** blocks;
+
+        // Index fields, filled in when the entry is added
+        uint8_t keyLen;         // name without a trailing '/'
+        uint8_t parentLen;      // directory part of name, 0 in the root
+        int16_t nextSibling;    // next entry in the same directory, -1 = last
     };
 
     void Initialize(void* moduleData, uint64_t moduleSize);
@@ -31,7 +62,14 @@ namespace Fs::Ramdisk {
     uint64_t GetSize(int handle);
     void Close(int handle);
 
+    // The file's bytes where they live: inside the initrd until the file
+    // is first written, then in its heap copy. A packed file is unpacked
+    // whole into the heap first. Valid until the next write or delete.
+    // For zero-copy users such as file mappings.
+    const uint8_t* GetData(int handle, uint64_t* size);
+
     int ReadDir(const char* path, const char** outNames, int maxEntries);
+    int ReadDirStat(const char* path, uint64_t* cursor, Vfs::DirStat* out, int maxEntries);
     int Delete(const char* path);
     int Mkdir(const char* path);
     int GetFileCount();
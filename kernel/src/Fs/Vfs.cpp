@@ -7,22 +7,97 @@
 #include "Vfs.hpp"
 #include <Terminal/Terminal.hpp>
 #include <CppLib/Spinlock.hpp>
+#include <Drivers/Storage/BufferCache.hpp>
+#include <Sched/SleepLock.hpp>
+#include <Sched/Scheduler.hpp>
+#include <Libraries/Memory.hpp>
+#include <Memory/Heap.hpp>
+#include "NameCache.hpp"
 
 namespace Fs::Vfs {
 
     struct HandleEntry {
-        bool inUse;
+        bool inUse;            // Changed under tableLock
         int driveNumber;
         int localHandle;
+        uint32_t pathBucket;   // pathGeneration[] slot of the file's path
+        Sched::SleepLock lock; // Held across each operation on the handle
     };
 
     static FsDriver* driveTable[MaxDrives];
     static HandleEntry handleTable[MaxHandles];
 
-    // Protects handle table and driver dispatch from concurrent CPU access.
-    // Uses Mutex (not Spinlock) so interrupts stay enabled while held --
+    // Locking, outermost first:
+    //  - a handle's lock, so it cannot be closed under a read or write;
+    //  - the drive's lock, held for each call into its driver. Drivers keep
+    //    per-mount scratch state (block buffers, directory name caches), so
+    //    a mount runs one call at a time, but different drives run in
+    //    parallel. Both sleep rather than spin, as calls may wait on disk;
+    //  - tableLock, only while a handle slot is taken or given back.
     // VFS is never called from interrupt context.
-    static kcp::Mutex vfsLock;
+    static Sched::SleepLock driveLocks[MaxDrives];
+    static kcp::LockStat tableLockStat{"vfs"};
+    static kcp::Mutex tableLock{&tableLockStat};
+
+    // Bumped whenever a file whose path hashes to the bucket may have
+    // changed (written, created, deleted, renamed). Collisions only cost
+    // callers a spurious reload. Updated atomically.
+    static constexpr int PathGenerationBuckets = 256;
+    static uint64_t pathGeneration[PathGenerationBuckets];
+
+    // Operations that modify a filesystem end by writing back the block
+    // buffers they dirtied. Within one operation, repeated updates of the
+    // same bitmap, inode table or directory block reach the disk once.
+    static void WriteBack() {
+        Drivers::Storage::BufferCache::Flush();
+    }
+
+    // File writes are the exception: they only mark their drive dirty,
+    // and the writeback thread (or fsync, or the next path operation on
+    // the drive) writes back in order. The data and FAT or bitmaps go
+    // first, then what the driver's Sync held back, so a crash in between
+    // leaves allocated space nothing points to yet, never a file size
+    // covering data that did not make it. Under driveLocks[drive].
+    static bool driveDirty[MaxDrives];
+    static bool writebackRunning = false;
+
+    // driveLocks[drive] held
+    static bool SyncDriveLocked(int drive) {
+        driveDirty[drive] = false;
+        bool ok = Drivers::Storage::BufferCache::Flush();
+        if (driveTable[drive]->Sync != nullptr) {
+            driveTable[drive]->Sync();
+            ok = Drivers::Storage::BufferCache::Flush() && ok;
+        }
+        return ok;
+    }
+
+    // Path operations must see the metadata held back for written files.
+    // driveLocks[drive] held.
+    static void SettleLocked(int drive) {
+        if (driveDirty[drive]) SyncDriveLocked(drive);
+    }
+
+    // After a file write. driveLocks[drive] held.
+    static void MarkDirtyLocked(int drive) {
+        if (writebackRunning) driveDirty[drive] = true;
+        else SyncDriveLocked(drive);
+    }
+
+    // Drive number plus the local path without leading slashes, case-folded
+    // like FAT. Only called on paths ParsePath() accepted.
+    static uint32_t PathBucket(const char* path) {
+        uint32_t hash = 2166136261u;
+        while (*path && *path != ':') hash = (hash ^ (uint8_t)*path++) * 16777619u;
+        if (*path == ':') path++;
+        while (*path == '/') path++;
+        for (; *path; path++) {
+            char c = *path;
+            if (c >= 'A' && c <= 'Z') c += 'a' - 'A';
+            hash = (hash ^ (uint8_t)c) * 16777619u;
+        }
+        return hash % PathGenerationBuckets;
+    }
 
     // Parse "N:/path" into drive number and local path.
     // Returns true on success, sets outDrive and outPath.
@@ -49,13 +124,97 @@ namespace Fs::Vfs {
         return true;
     }
 
-    static int AllocHandle() {
+    static void BumpGeneration(const char* path) {
+        __atomic_fetch_add(&pathGeneration[PathBucket(path)], 1, __ATOMIC_RELAXED);
+    }
+
+    // Take a free handle slot for an open local handle. Returns -1 if the
+    // table is full.
+    static int AllocHandle(int drive, int localHandle, const char* path) {
+        tableLock.Acquire();
         for (int i = 0; i < MaxHandles; i++) {
-            if (!handleTable[i].inUse) return i;
+            if (!handleTable[i].inUse) {
+                handleTable[i].inUse = true;
+                handleTable[i].driveNumber = drive;
+                handleTable[i].localHandle = localHandle;
+                handleTable[i].pathBucket = PathBucket(path);
+                tableLock.Release();
+                return i;
+            }
         }
+        tableLock.Release();
         return -1;
     }
 
+    // Lock an open handle. Returns nullptr (nothing held) if it is not open.
+    static HandleEntry* LockHandle(int handle) {
+        if (handle < 0 || handle >= MaxHandles) return nullptr;
+        HandleEntry& entry = handleTable[handle];
+        entry.lock.Acquire();
+        if (!entry.inUse) {
+            entry.lock.Release();
+            return nullptr;
+        }
+        return &entry;
+    }
+
+    static FsDriver* DriverOf(int drive) {
+        return drive >= 0 && drive < MaxDrives ? driveTable[drive] : nullptr;
+    }
+
+    // Walk a local path through the name cache, asking the driver only
+    // about components the cache has not seen. Returns the node,
+    // NameCache::Missing, or another negative value if the walk failed on
+    // an I/O error or a component too long to handle.
+    // driveLocks[drive] must be held.
+    static int64_t ResolveLocked(int drive, FsDriver* driver, const char* path) {
+        static constexpr int MaxComponent = 255;
+        char component[MaxComponent + 1];
+        uint64_t node = 0;
+
+        while (*path == '/') path++;
+        while (*path) {
+            int len = 0;
+            while (path[len] && path[len] != '/') len++;
+            if (len > MaxComponent) return -2;
+            memcpy(component, path, len);
+            component[len] = '\0';
+            path += len;
+            while (*path == '/') path++;
+
+            int64_t child;
+            if (!NameCache::Lookup(drive, node, component, len, child)) {
+                child = driver->Lookup(node, component);
+                if (child < 0 && child != NameCache::Missing) return child;
+                NameCache::Insert(drive, node, component, len, child);
+            }
+            if (child < 0) return NameCache::Missing;
+            node = (uint64_t)child;
+        }
+        return (int64_t)node;
+    }
+
+    // driveLocks[drive] must be held
+    static int OpenLocked(int drive, const char* localPath) {
+        FsDriver* driver = driveTable[drive];
+        if (driver->Lookup == nullptr || driver->OpenNode == nullptr) return driver->Open(localPath);
+
+        int64_t node = ResolveLocked(drive, driver, localPath);
+        if (node == NameCache::Missing) return -1;
+        if (node < 0) return driver->Open(localPath);
+        return driver->OpenNode((uint64_t)node);
+    }
+
+    // A new file or directory may be hiding behind a negative entry
+    static void ForgetLastComponent(int drive, const char* localPath) {
+        int end = 0;
+        while (localPath[end]) end++;
+        while (end > 0 && localPath[end - 1] == '/') end--;
+        int start = end;
+        while (start > 0 && localPath[start - 1] != '/') start--;
+        NameCache::ForgetName(drive, localPath + start, end - start);
+    }
+
     void Initialize() {
         for (int i = 0; i < MaxDrives; i++) {
             driveTable[i] = nullptr;
@@ -72,6 +231,7 @@ namespace Fs::Vfs {
         if (driver == nullptr) return -1;
 
         driveTable[driveNumber] = driver;
+        NameCache::ForgetDrive(driveNumber);
         Kt::KernelLogStream(Kt::OK, "VFS") << "Registered drive " << driveNumber;
         return 0;
     }
@@ -81,93 +241,168 @@ namespace Fs::Vfs {
         const char* localPath;
 
         if (!ParsePath(path, drive, localPath)) return -1;
-        if (drive < 0 || drive >= MaxDrives || driveTable[drive] == nullptr) return -1;
+        if (DriverOf(drive) == nullptr || DriverOf(drive)->Open == nullptr) return -1;
 
-        vfsLock.Acquire();
+        driveLocks[drive].Acquire();
+        SettleLocked(drive);
+        int localHandle = OpenLocked(drive, localPath);
+        driveLocks[drive].Release();
+        if (localHandle < 0) return -1;
 
-        int localHandle = driveTable[drive]->Open(localPath);
-        if (localHandle < 0) { vfsLock.Release(); return -1; }
-
-        int globalHandle = AllocHandle();
+        int globalHandle = AllocHandle(drive, localHandle, path);
         if (globalHandle < 0) {
+            driveLocks[drive].Acquire();
             driveTable[drive]->Close(localHandle);
-            vfsLock.Release();
-            return -1;
+            driveLocks[drive].Release();
         }
-
-        handleTable[globalHandle].inUse = true;
-        handleTable[globalHandle].driveNumber = drive;
-        handleTable[globalHandle].localHandle = localHandle;
-
-        vfsLock.Release();
         return globalHandle;
     }
 
     int VfsRead(int handle, uint8_t* buffer, uint64_t offset, uint64_t size) {
-        vfsLock.Acquire();
-        if (handle < 0 || handle >= MaxHandles || !handleTable[handle].inUse) { vfsLock.Release(); return -1; }
+        HandleEntry* entry = LockHandle(handle);
+        if (entry == nullptr) return -1;
 
-        HandleEntry& entry = handleTable[handle];
-        int result = driveTable[entry.driveNumber]->Read(entry.localHandle, buffer, offset, size);
-        vfsLock.Release();
+        int drive = entry->driveNumber;
+        driveLocks[drive].Acquire();
+        int result = driveTable[drive]->Read(entry->localHandle, buffer, offset, size);
+        driveLocks[drive].Release();
+
+        entry->lock.Release();
         return result;
     }
 
     uint64_t VfsGetSize(int handle) {
-        vfsLock.Acquire();
-        if (handle < 0 || handle >= MaxHandles || !handleTable[handle].inUse) { vfsLock.Release(); return 0; }
+        HandleEntry* entry = LockHandle(handle);
+        if (entry == nullptr) return 0;
 
-        HandleEntry& entry = handleTable[handle];
-        uint64_t result = driveTable[entry.driveNumber]->GetSize(entry.localHandle);
-        vfsLock.Release();
+        int drive = entry->driveNumber;
+        driveLocks[drive].Acquire();
+        uint64_t result = driveTable[drive]->GetSize(entry->localHandle);
+        driveLocks[drive].Release();
+
+        entry->lock.Release();
         return result;
     }
 
     void VfsClose(int handle) {
-        vfsLock.Acquire();
-        if (handle < 0 || handle >= MaxHandles || !handleTable[handle].inUse) { vfsLock.Release(); return; }
-
-        HandleEntry& entry = handleTable[handle];
-        driveTable[entry.driveNumber]->Close(entry.localHandle);
-        entry.inUse = false;
-        vfsLock.Release();
+        HandleEntry* entry = LockHandle(handle);
+        if (entry == nullptr) return;
+
+        int drive = entry->driveNumber;
+        driveLocks[drive].Acquire();
+        driveTable[drive]->Close(entry->localHandle);
+        driveLocks[drive].Release();
+
+        tableLock.Acquire();
+        entry->inUse = false;
+        tableLock.Release();
+        entry->lock.Release();
     }
 
     int VfsWrite(int handle, const uint8_t* buffer, uint64_t offset, uint64_t size) {
-        vfsLock.Acquire();
-        if (handle < 0 || handle >= MaxHandles || !handleTable[handle].inUse) { vfsLock.Release(); return -1; }
+        HandleEntry* entry = LockHandle(handle);
+        if (entry == nullptr) return -1;
 
-        HandleEntry& entry = handleTable[handle];
-        if (driveTable[entry.driveNumber]->Write == nullptr) { vfsLock.Release(); return -1; }
-        int result = driveTable[entry.driveNumber]->Write(entry.localHandle, buffer, offset, size);
-        vfsLock.Release();
+        int drive = entry->driveNumber;
+        if (driveTable[drive]->Write == nullptr) {
+            entry->lock.Release();
+            return -1;
+        }
+
+        driveLocks[drive].Acquire();
+        int result = driveTable[drive]->Write(entry->localHandle, buffer, offset, size);
+        __atomic_fetch_add(&pathGeneration[entry->pathBucket], 1, __ATOMIC_RELAXED);
+        MarkDirtyLocked(drive);
+        driveLocks[drive].Release();
+
+        entry->lock.Release();
         return result;
     }
 
+    // Chunks go from the source's driver to the destination's through one
+    // kernel buffer. Each drive's lock is taken for its own half of a
+    // chunk only, never both at once; the two handle locks are held
+    // throughout, lower index first.
+    int64_t VfsCopy(int srcHandle, uint64_t srcOffset, int dstHandle, uint64_t dstOffset, uint64_t size) {
+        if (srcHandle == dstHandle) return -1;
+        int first = srcHandle < dstHandle ? srcHandle : dstHandle;
+        int second = srcHandle < dstHandle ? dstHandle : srcHandle;
+
+        HandleEntry* a = LockHandle(first);
+        if (a == nullptr) return -1;
+        HandleEntry* b = LockHandle(second);
+        if (b == nullptr) {
+            a->lock.Release();
+            return -1;
+        }
+        HandleEntry* src = first == srcHandle ? a : b;
+        HandleEntry* dst = first == srcHandle ? b : a;
+
+        int srcDrive = src->driveNumber;
+        int dstDrive = dst->driveNumber;
+        uint8_t* buffer = nullptr;
+        if (driveTable[dstDrive]->Write != nullptr && size > 0) {
+            buffer = (uint8_t*)Memory::g_heap->Request(CopyChunkBytes);
+        }
+        if (buffer == nullptr) {
+            b->lock.Release();
+            a->lock.Release();
+            return size == 0 ? 0 : -1;
+        }
+
+        int64_t copied = 0;
+        while ((uint64_t)copied < size) {
+            uint64_t want = size - copied < CopyChunkBytes ? size - copied : CopyChunkBytes;
+
+            driveLocks[srcDrive].Acquire();
+            int got = driveTable[srcDrive]->Read(src->localHandle, buffer, srcOffset + copied, want);
+            driveLocks[srcDrive].Release();
+            if (got <= 0) break;
+
+            driveLocks[dstDrive].Acquire();
+            int put = driveTable[dstDrive]->Write(dst->localHandle, buffer, dstOffset + copied, got);
+            driveLocks[dstDrive].Release();
+            if (put > 0) copied += put;
+            if (put != got) break;
+        }
+
+        if (copied > 0) {
+            __atomic_fetch_add(&pathGeneration[dst->pathBucket], 1, __ATOMIC_RELAXED);
+            driveLocks[dstDrive].Acquire();
+            MarkDirtyLocked(dstDrive);
+            driveLocks[dstDrive].Release();
+        }
+
+        Memory::g_heap->Free(buffer);
+        b->lock.Release();
+        a->lock.Release();
+        return copied;
+    }
+
     int VfsCreate(const char* path) {
         int drive;
         const char* localPath;
 
         if (!ParsePath(path, drive, localPath)) return -1;
-        if (drive < 0 || drive >= MaxDrives || driveTable[drive] == nullptr) return -1;
-        if (driveTable[drive]->Create == nullptr) return -1;
-
-        vfsLock.Acquire();
+        if (DriverOf(drive) == nullptr || DriverOf(drive)->Create == nullptr) return -1;
 
+        driveLocks[drive].Acquire();
+        SettleLocked(drive);
         int localHandle = driveTable[drive]->Create(localPath);
-        if (localHandle < 0) { vfsLock.Release(); return -1; }
+        ForgetLastComponent(drive, localPath);
+        if (localHandle >= 0) {
+            BumpGeneration(path);  // May have truncated an existing file
+            WriteBack();
+        }
+        driveLocks[drive].Release();
+        if (localHandle < 0) return -1;
 
-        int globalHandle = AllocHandle();
+        int globalHandle = AllocHandle(drive, localHandle, path);
         if (globalHandle < 0) {
-            vfsLock.Release();
-            return -1;
+            driveLocks[drive].Acquire();
+            driveTable[drive]->Close(localHandle);
+            driveLocks[drive].Release();
         }
-
-        handleTable[globalHandle].inUse = true;
-        handleTable[globalHandle].driveNumber = drive;
-        handleTable[globalHandle].localHandle = localHandle;
-
-        vfsLock.Release();
         return globalHandle;
     }
 
@@ -176,12 +411,15 @@ namespace Fs::Vfs {
         const char* localPath;
 
         if (!ParsePath(path, drive, localPath)) return -1;
-        if (drive < 0 || drive >= MaxDrives || driveTable[drive] == nullptr) return -1;
-        if (driveTable[drive]->Delete == nullptr) return -1;
+        if (DriverOf(drive) == nullptr || DriverOf(drive)->Delete == nullptr) return -1;
 
-        vfsLock.Acquire();
+        driveLocks[drive].Acquire();
+        SettleLocked(drive);
         int result = driveTable[drive]->Delete(localPath);
-        vfsLock.Release();
+        NameCache::ForgetDrive(drive);
+        BumpGeneration(path);
+        WriteBack();
+        driveLocks[drive].Release();
         return result;
     }
 
@@ -190,24 +428,32 @@ namespace Fs::Vfs {
         const char* localPath;
 
         if (!ParsePath(path, drive, localPath)) return -1;
-        if (drive < 0 || drive >= MaxDrives || driveTable[drive] == nullptr) return -1;
-        if (driveTable[drive]->Mkdir == nullptr) return -1;
+        if (DriverOf(drive) == nullptr || DriverOf(drive)->Mkdir == nullptr) return -1;
 
-        vfsLock.Acquire();
+        driveLocks[drive].Acquire();
+        SettleLocked(drive);
         int result = driveTable[drive]->Mkdir(localPath);
-        vfsLock.Release();
+        ForgetLastComponent(drive, localPath);
+        WriteBack();
+        driveLocks[drive].Release();
         return result;
     }
 
+    uint64_t VfsPathGeneration(const char* path) {
+        int drive;
+        const char* localPath;
+        if (!ParsePath(path, drive, localPath)) return 0;
+
+        return __atomic_load_n(&pathGeneration[PathBucket(path)], __ATOMIC_RELAXED);
+    }
+
     int VfsDriveList(int* outDrives, int maxEntries) {
-        vfsLock.Acquire();
         int count = 0;
         for (int i = 0; i < MaxDrives && count < maxEntries; i++) {
             if (driveTable[i] != nullptr) {
                 outDrives[count++] = i;
             }
         }
-        vfsLock.Release();
         return count;
     }
 
@@ -221,12 +467,16 @@ namespace Fs::Vfs {
 
         // Cross-drive rename not supported
         if (oldDrive != newDrive) return -1;
-        if (oldDrive < 0 || oldDrive >= MaxDrives || driveTable[oldDrive] == nullptr) return -1;
-        if (driveTable[oldDrive]->Rename == nullptr) return -1;
+        if (DriverOf(oldDrive) == nullptr || DriverOf(oldDrive)->Rename == nullptr) return -1;
 
-        vfsLock.Acquire();
+        driveLocks[oldDrive].Acquire();
+        SettleLocked(oldDrive);
         int result = driveTable[oldDrive]->Rename(oldLocal, newLocal);
-        vfsLock.Release();
+        NameCache::ForgetDrive(oldDrive);
+        BumpGeneration(oldPath);
+        BumpGeneration(newPath);
+        WriteBack();
+        driveLocks[oldDrive].Release();
         return result;
     }
 
@@ -235,12 +485,72 @@ namespace Fs::Vfs {
         const char* localPath;
 
         if (!ParsePath(path, drive, localPath)) return -1;
-        if (drive < 0 || drive >= MaxDrives || driveTable[drive] == nullptr) return -1;
+        if (DriverOf(drive) == nullptr || DriverOf(drive)->ReadDir == nullptr) return -1;
 
-        vfsLock.Acquire();
+        driveLocks[drive].Acquire();
+        SettleLocked(drive);
         int result = driveTable[drive]->ReadDir(localPath, outNames, maxEntries);
-        vfsLock.Release();
+        driveLocks[drive].Release();
         return result;
     }
 
+    int VfsReadDirStat(const char* path, uint64_t* cursor, DirStat* out, int maxEntries) {
+        int drive;
+        const char* localPath;
+
+        if (!ParsePath(path, drive, localPath)) return -1;
+        if (DriverOf(drive) == nullptr || DriverOf(drive)->ReadDirStat == nullptr) return -1;
+        if (maxEntries <= 0) return 0;
+
+        driveLocks[drive].Acquire();
+        SettleLocked(drive);
+        int result = driveTable[drive]->ReadDirStat(localPath, cursor, out, maxEntries);
+        driveLocks[drive].Release();
+        return result;
+    }
+
+    int VfsFsync(int handle) {
+        HandleEntry* entry = LockHandle(handle);
+        if (entry == nullptr) return -1;
+
+        int drive = entry->driveNumber;
+        driveLocks[drive].Acquire();
+        bool ok = SyncDriveLocked(drive);
+        driveLocks[drive].Release();
+
+        entry->lock.Release();
+        return ok ? 0 : -1;
+    }
+
+    int VfsSync() {
+        bool ok = true;
+        for (int drive = 0; drive < MaxDrives; drive++) {
+            if (driveTable[drive] == nullptr) continue;
+            driveLocks[drive].Acquire();
+            if (driveDirty[drive]) ok = SyncDriveLocked(drive) && ok;
+            driveLocks[drive].Release();
+        }
+        return Drivers::Storage::BufferCache::Flush() && ok ? 0 : -1;
+    }
+
+    static void WritebackThread(uint64_t) {
+        for (;;) {
+            Sched::BlockForSleep(WritebackIntervalMs);
+            for (int drive = 0; drive < MaxDrives; drive++) {
+                if (!__atomic_load_n(&driveDirty[drive], __ATOMIC_RELAXED)) continue;
+                driveLocks[drive].Acquire();
+                SettleLocked(drive);
+                driveLocks[drive].Release();
+            }
+        }
+    }
+
+    void StartWriteback() {
+        if (Sched::CreateSystemThread(WritebackThread, 0) < 0) {
+            Kt::KernelLogStream(Kt::WARNING, "VFS") << "No writeback thread, writes stay synchronous";
+            return;
+        }
+        writebackRunning = true;
+    }
+
 }
@@ -13,6 +13,23 @@ namespace Fs::Vfs {
     static constexpr int MaxDrives = 16;
     static constexpr int MaxHandles = 64;
 
+    // Largest piece VfsCopy moves per driver call
+    static constexpr uint64_t CopyChunkBytes = 1024 * 1024;
+
+    static constexpr uint8_t EntryUnknown   = 0;
+    static constexpr uint8_t EntryFile      = 1;
+    static constexpr uint8_t EntryDirectory = 2;
+
+    // One directory entry with its metadata, as returned by ReadDirStat.
+    // Same layout as Montauk::DirEntryInfo, which userspace receives.
+    struct DirStat {
+        char     name[256];   // Bare name, no trailing '/' for directories
+        uint64_t size;
+        int64_t  mtime;       // Unix seconds, 0 if unknown
+        uint8_t  type;        // Entry*
+        uint8_t  _pad[7];
+    };
+
     struct FsDriver {
         int (*Open)(const char* path);
         int (*Read)(int handle, uint8_t* buffer, uint64_t offset, uint64_t size);
@@ -24,6 +41,29 @@ namespace Fs::Vfs {
         int (*Delete)(const char* path);
         int (*Mkdir)(const char* path);
         int (*Rename)(const char* oldPath, const char* newPath);
+
+        // Optional, for the name cache (see NameCache.hpp): resolve one path
+        // component at a time by driver-defined node ids, 0 being the root.
+        // Lookup returns the child's node, -1 if `dir` has no entry `name`
+        // (or is not a directory), or another negative value on an I/O
+        // error. OpenNode opens a node like Open opens a path. Drivers
+        // without them get every Open passed through.
+        int64_t (*Lookup)(uint64_t dir, const char* name);
+        int (*OpenNode)(uint64_t node);
+
+        // Optional: list a directory as DirStat records, starting at
+        // `*cursor` (0 for the first entry) and advancing it past the
+        // entries returned. The cursor's meaning is up to the driver.
+        // Returns the count, 0 at the end, or -1 if `path` is not a
+        // directory. Not capped at MaxDirEntries like ReadDir.
+        int (*ReadDirStat)(const char* path, uint64_t* cursor, DirStat* out, int maxEntries);
+
+        // Optional: Write may hold back the metadata that makes its data
+        // reachable (file sizes, first clusters, inodes, allocation state),
+        // also past Close. Sync puts it into the buffer cache. The VFS
+        // calls it only once the written data is on disk, and before any
+        // path operation on the drive.
+        void (*Sync)();
     };
 
     void Initialize();
@@ -33,12 +73,33 @@ namespace Fs::Vfs {
     int VfsRead(int handle, uint8_t* buffer, uint64_t offset, uint64_t size);
     int VfsWrite(int handle, const uint8_t* buffer, uint64_t offset, uint64_t size);
     int VfsCreate(const char* path);
+
+    // Copy `size` bytes at `srcOffset` of one open file to `dstOffset` of
+    // another, without the data leaving the kernel. Stops early at the end
+    // of the source. Returns the bytes copied, or -1.
+    int64_t VfsCopy(int srcHandle, uint64_t srcOffset, int dstHandle, uint64_t dstOffset, uint64_t size);
     int VfsDelete(const char* path);
     uint64_t VfsGetSize(int handle);
     void VfsClose(int handle);
     int VfsReadDir(const char* path, const char** outNames, int maxEntries);
     int VfsMkdir(const char* path);
     int VfsRename(const char* oldPath, const char* newPath);
+    int VfsReadDirStat(const char* path, uint64_t* cursor, DirStat* out, int maxEntries);
+
+    // Writes are written back in the background, every
+    // WritebackIntervalMs. VfsFsync writes back the drive of an open file
+    // now and VfsSync every drive; both return -1 if a write failed.
+    static constexpr uint64_t WritebackIntervalMs = 5000;
+    int VfsFsync(int handle);
+    int VfsSync();
+
+    // Start the writeback thread. Called once init is running; until then
+    // every write is written back before it returns.
+    void StartWriteback();
+
+    // Changes whenever the file at `path` may have been modified, so
+    // caches of file contents can tell when they are stale
+    uint64_t VfsPathGeneration(const char* path);
 
     // Returns number of registered drives, fills outDrives[] with their indices
     int VfsDriveList(int* outDrives, int maxEntries);
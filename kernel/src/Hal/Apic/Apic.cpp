@@ -116,5 +116,14 @@ namespace Hal {
         uint32_t GetId() {
             return (ReadRegister(REG_ID) >> 24) & 0xFF;
         }
+
+        void SendIpi(uint32_t lapicId, uint8_t vector) {
+            // Wait for any previous IPI to leave the ICR (delivery status, bit 12)
+            while (ReadRegister(REG_ICR_LOW) & (1 << 12)) {
+                asm volatile("pause");
+            }
+            WriteRegister(REG_ICR_HIGH, lapicId << 24);
+            WriteRegister(REG_ICR_LOW, (uint32_t)vector | (1 << 14));  // Fixed, assert
+        }
     };
 };
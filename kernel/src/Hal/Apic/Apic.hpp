@@ -46,6 +46,10 @@ namespace Hal {
         void SendEOI();
         uint32_t GetId();
 
+        // Send a fixed-delivery IPI with the given vector to one CPU.
+        // Call with interrupts disabled.
+        void SendIpi(uint32_t lapicId, uint8_t vector);
+
         uint32_t ReadRegister(uint32_t reg);
         void WriteRegister(uint32_t reg, uint32_t value);
     };
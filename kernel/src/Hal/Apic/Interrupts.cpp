@@ -9,6 +9,8 @@
 #include <Hal/IDT.hpp>
 #include <Terminal/Terminal.hpp>
 #include <CppLib/Stream.hpp>
+#include <Common/Trace.hpp>
+#include <Common/Profiler.hpp>
 
 // Assembly-defined stub table and spurious handler
 extern "C" void* IrqStubTable[Hal::IRQ_COUNT];
@@ -41,7 +43,7 @@ namespace Hal {
 };
 
 // C linkage dispatch function called from assembly stubs
-extern "C" void HalIrqDispatch(uint64_t irqNumber) {
+extern "C" void HalIrqDispatch(uint64_t irqNumber, Hal::IrqFrame* frame) {
     // Send EOI BEFORE calling the handler. The handler may context-switch
     // (via Tick -> Schedule -> SchedContextSwitch) and never return here.
     // If EOI is deferred until after the handler, the LAPIC timer vector
@@ -51,6 +53,13 @@ extern "C" void HalIrqDispatch(uint64_t irqNumber) {
     // deliver a new interrupt until iretq re-enables them.
     Hal::LocalApic::SendEOI();
 
+    Trace::Emit(Montauk::TRACE_IRQ, Montauk::TRACE_EV_IRQ, (uint32_t)irqNumber);
+
+    // Before the handler, which may switch away from the sampled context
+    if (irqNumber == Hal::IRQ_TIMER && Prof::On()) {
+        Prof::Sample(frame);
+    }
+
     if (irqNumber < Hal::IRQ_COUNT && Hal::g_irqHandlers[irqNumber] != nullptr) {
         Hal::g_irqHandlers[irqNumber]((uint8_t)irqNumber);
     }
@@ -29,6 +29,18 @@ namespace Hal {
     constexpr uint8_t IRQ_ATA1     = 14;
     constexpr uint8_t IRQ_ATA2     = 15;
 
+    // Inter-processor interrupts use the last MSI slots
+    constexpr uint8_t IRQ_RESCHEDULE     = IRQ_COUNT - 1;
+    constexpr uint8_t IRQ_TLB_SHOOTDOWN  = IRQ_COUNT - 2;
+
+    // Registers saved by IrqCommon (IsrStubs.asm), then the frame the CPU
+    // pushed. HalIrqDispatch gets a pointer to it.
+    struct IrqFrame {
+        uint64_t r15, r14, r13, r12, r11, r10, r9, r8;
+        uint64_t rdi, rsi, rbp, rbx, rdx, rcx, rax;
+        uint64_t rip, cs, rflags, rsp, ss;
+    };
+
     // Register a handler for the given IRQ number (0-47)
     void RegisterIrqHandler(uint8_t irq, IrqHandler handler);
 
@@ -48,8 +48,10 @@ IrqCommon:
     push r14
     push r15
 
-    ; Pass IRQ number as first argument (rdi)
+    ; Pass IRQ number as first argument (rdi), the saved registers and
+    ; interrupt frame (Hal::IrqFrame) as the second (rsi)
     mov  rdi, rax
+    mov  rsi, rsp
 
     ; Align stack to 16 bytes before call (we pushed 15 registers x 8 = 120 bytes
     ; + return address 8 = 128, which is 16-byte aligned, so we're good)
@@ -0,0 +1,96 @@
+/*
+    * BootTasks.cpp
+    * Boot-time tasks run in parallel on the BSP and idle APs
+    * Copyright (c) 2026 Daniel Hammer
+*/
+
+#include "BootTasks.hpp"
+#include <Hal/SmpBoot.hpp>
+#include <CppLib/Spinlock.hpp>
+#include <CppLib/Stream.hpp>
+#include <Terminal/Terminal.hpp>
+#include <Timekeeping/ApicTimer.hpp>
+
+using namespace Kt;
+
+namespace Smp::BootTasks {
+
+    struct Task {
+        const char* name;
+        TaskFunc    func;
+        void*       arg;
+        TaskSet     after;
+    };
+
+    static Task g_tasks[MaxTasks];
+    static int g_taskCount = 0;
+
+    // Tasks handed to a CPU, and tasks finished. Both only grow.
+    static TaskSet g_started = 0;
+    static volatile TaskSet g_done = 0;
+
+    static volatile bool g_finished = false;
+    static kcp::Spinlock g_lock;
+
+    static void Run(const Task& task) {
+        uint64_t start = Timekeeping::GetMicroseconds();
+        task.func(task.arg);
+        uint64_t us = Timekeeping::GetMicroseconds() - start;
+
+        KernelLogStream(OK, "Boot") << task.name << " done in " << base::dec
+            << us / 1000 << " ms on CPU " << (uint64_t)GetCurrentCpuData()->cpuIndex;
+    }
+
+    // Start the first queued task whose dependencies are done
+    static bool RunOne() {
+        g_lock.Acquire();
+        int id = -1;
+        for (int i = 0; i < g_taskCount; i++) {
+            if (g_started & Bit(i)) continue;
+            if ((g_tasks[i].after & g_done) != g_tasks[i].after) continue;
+            id = i;
+            break;
+        }
+        if (id >= 0) g_started |= Bit(id);
+        g_lock.Release();
+
+        if (id < 0) return false;
+
+        Run(g_tasks[id]);
+        __atomic_fetch_or(&g_done, Bit(id), __ATOMIC_RELEASE);
+        return true;
+    }
+
+    int Add(const char* name, TaskFunc func, void* arg, TaskSet after) {
+        g_lock.Acquire();
+        if (g_finished || g_taskCount >= MaxTasks) {
+            g_lock.Release();
+            Wait(after);
+            Run({ name, func, arg, after });
+            return -1;
+        }
+        int id = g_taskCount;
+        g_tasks[id] = { name, func, arg, after };
+        __atomic_store_n(&g_taskCount, id + 1, __ATOMIC_RELEASE);
+        g_lock.Release();
+        return id;
+    }
+
+    void Wait(TaskSet tasks) {
+        while ((__atomic_load_n(&g_done, __ATOMIC_ACQUIRE) & tasks) != tasks) {
+            if (!RunOne()) asm volatile("pause");
+        }
+    }
+
+    void Finish() {
+        int count = __atomic_load_n(&g_taskCount, __ATOMIC_ACQUIRE);
+        Wait((count == MaxTasks) ? ~0u : Bit(count) - 1);
+        g_finished = true;
+    }
+
+    void Worker() {
+        while (!g_finished) {
+            if (!RunOne()) asm volatile("pause");
+        }
+    }
+}
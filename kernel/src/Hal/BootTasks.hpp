@@ -0,0 +1,38 @@
+/*
+    * BootTasks.hpp
+    * Boot-time tasks run in parallel on the BSP and idle APs
+    * Copyright (c) 2026 Daniel Hammer
+*/
+
+#pragma once
+#include <cstdint>
+
+namespace Smp::BootTasks {
+
+    static constexpr int MaxTasks = 32;
+
+    using TaskFunc = void(*)(void* arg);
+
+    // Set of task ids, as returned by Bit()
+    using TaskSet = uint32_t;
+
+    inline TaskSet Bit(int id) {
+        return (id < 0) ? 0 : (1u << id);
+    }
+
+    // Queue `func(arg)` to run once every task in `after` has finished. Any
+    // online CPU may pick it up. Returns the task id, or -1 if the table is
+    // full (the task then runs right away on the caller).
+    int Add(const char* name, TaskFunc func, void* arg, TaskSet after = 0);
+
+    // Return once every task in `tasks` has finished, running ready tasks
+    // on this CPU meanwhile, so a single-CPU boot still gets through.
+    void Wait(TaskSet tasks);
+
+    // Wait for all queued tasks, then send the APs on to their idle loops.
+    // No tasks may be added afterwards.
+    void Finish();
+
+    // AP side: run tasks as they become ready until Finish()
+    void Worker();
+}
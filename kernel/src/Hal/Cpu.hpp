@@ -19,6 +19,23 @@ namespace Hal {
         return (ecx & (1 << 3)) != 0;
     }
 
+    // Check for an invariant TSC (CPUID.80000007H:EDX bit 8): constant
+    // rate across P-/C-states, so it can serve as the monotonic clock.
+    inline bool HasInvariantTsc() {
+        uint32_t maxLeaf;
+        asm volatile("cpuid" : "=a"(maxLeaf) : "a"(0x80000000) : "ebx", "ecx", "edx");
+        if (maxLeaf < 0x80000007) return false;
+        uint32_t edx;
+        asm volatile("cpuid" : "=d"(edx) : "a"(0x80000007) : "ebx", "ecx");
+        return (edx & (1 << 8)) != 0;
+    }
+
+    inline uint64_t ReadTsc() {
+        uint32_t lo, hi;
+        asm volatile("rdtsc" : "=a"(lo), "=d"(hi));
+        return ((uint64_t)hi << 32) | lo;
+    }
+
     // Idle using MWAIT if available, otherwise HLT.
     // MWAIT can enter deeper C-states (C1E/C3/C6) for better
     // power and thermal efficiency than HLT (C1 only).
@@ -31,6 +48,15 @@ namespace Hal {
         asm volatile("mwait" :: "a"(0x00), "c"(0));
     }
 
+    // Make supervisor writes honour read-only pages, so the kernel writing
+    // into a copy-on-write user page faults like the process would
+    inline void EnableWriteProtect() {
+        uint64_t cr0;
+        asm volatile("mov %%cr0, %0" : "=r"(cr0));
+        cr0 |= (1ULL << 16);  // Set WP
+        asm volatile("mov %0, %%cr0" :: "r"(cr0));
+    }
+
     inline void EnableSSE() {
         uint64_t cr0;
         asm volatile("mov %%cr0, %0" : "=r"(cr0));
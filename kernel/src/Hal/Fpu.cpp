@@ -0,0 +1,141 @@
+/*
+    * Fpu.cpp
+    * FPU/SSE/AVX state management (FXSAVE or XSAVE family)
+    * Copyright (c) 2026 Daniel Hammer
+*/
+
+#include "Fpu.hpp"
+#include <Terminal/Terminal.hpp>
+#include <CppLib/Stream.hpp>
+#include <Libraries/Memory.hpp>
+
+using namespace Kt;
+
+namespace Hal {
+    namespace Fpu {
+        enum class Mode {
+            Fxsave,
+            Xsave,
+            XsaveOpt,
+            Xsaves
+        };
+
+        // XCR0 / XSTATE_BV component bits
+        constexpr uint64_t XFEATURE_X87 = 1ULL << 0;
+        constexpr uint64_t XFEATURE_SSE = 1ULL << 1;
+        constexpr uint64_t XFEATURE_AVX = 1ULL << 2;
+
+        // XSAVE header: XSTATE_BV at +512, XCOMP_BV at +520
+        constexpr uint32_t XSAVE_HEADER = 512;
+        constexpr uint64_t XCOMP_BV_COMPACTED = 1ULL << 63;
+
+        static Mode g_mode = Mode::Fxsave;
+        static uint64_t g_xcr0 = XFEATURE_X87 | XFEATURE_SSE;
+        static uint32_t g_areaSize = 512;
+
+        static inline void Cpuid(uint32_t leaf, uint32_t sub, uint32_t& a, uint32_t& b,
+                                 uint32_t& c, uint32_t& d) {
+            asm volatile("cpuid" : "=a"(a), "=b"(b), "=c"(c), "=d"(d) : "a"(leaf), "c"(sub));
+        }
+
+        static inline void WriteXcr0(uint64_t value) {
+            asm volatile("xsetbv" :: "c"(0), "a"((uint32_t)value), "d"((uint32_t)(value >> 32)));
+        }
+
+        static void EnableXsave() {
+            uint64_t cr4;
+            asm volatile("mov %%cr4, %0" : "=r"(cr4));
+            cr4 |= (1ULL << 18);  // OSXSAVE
+            asm volatile("mov %0, %%cr4" :: "r"(cr4));
+            WriteXcr0(g_xcr0);
+        }
+
+        void Initialize() {
+            uint32_t a, b, c, d;
+            Cpuid(1, 0, a, b, c, d);
+            bool hasXsave = (c & (1u << 26)) != 0;
+            bool hasAvx = (c & (1u << 28)) != 0;
+
+            if (hasXsave) {
+                Cpuid(0xD, 0, a, b, c, d);
+                uint64_t supported = ((uint64_t)d << 32) | a;
+                g_xcr0 = XFEATURE_X87 | XFEATURE_SSE;
+                if (hasAvx && (supported & XFEATURE_AVX)) g_xcr0 |= XFEATURE_AVX;
+                EnableXsave();
+
+                // EBX: area size for the features now enabled in XCR0
+                Cpuid(0xD, 0, a, b, c, d);
+                if (b > MaxAreaSize) {
+                    g_xcr0 = XFEATURE_X87 | XFEATURE_SSE;
+                    WriteXcr0(g_xcr0);
+                    Cpuid(0xD, 0, a, b, c, d);
+                }
+                g_areaSize = b;
+
+                Cpuid(0xD, 1, a, b, c, d);
+                if (a & (1u << 3)) g_mode = Mode::Xsaves;
+                else if (a & (1u << 0)) g_mode = Mode::XsaveOpt;
+                else g_mode = Mode::Xsave;
+            }
+
+            const char* name = "FXSAVE";
+            if (g_mode == Mode::Xsave) name = "XSAVE";
+            else if (g_mode == Mode::XsaveOpt) name = "XSAVEOPT";
+            else if (g_mode == Mode::Xsaves) name = "XSAVES";
+            KernelLogStream(OK, "Fpu") << name << ", " << base::dec << (uint64_t)g_areaSize
+                << " byte context" << ((g_xcr0 & XFEATURE_AVX) ? ", AVX enabled" : "");
+        }
+
+        void InitializeAP() {
+            if (g_mode != Mode::Fxsave) EnableXsave();
+        }
+
+        void InitArea(uint8_t* area) {
+            memset(area, 0, MaxAreaSize);
+            *(uint16_t*)&area[0] = 0x037F;   // FCW: default x87 control word
+            *(uint32_t*)&area[24] = 0x1F80;  // MXCSR: default SSE control/status
+
+            // XSTATE_BV = 0 leaves every component in its init state (MXCSR is
+            // still loaded). XRSTORS only accepts the compacted format.
+            if (g_mode == Mode::Xsaves) {
+                *(uint64_t*)&area[XSAVE_HEADER + 8] = XCOMP_BV_COMPACTED | g_xcr0;
+            }
+        }
+
+        void Save(uint8_t* area) {
+            uint32_t lo = (uint32_t)g_xcr0;
+            uint32_t hi = (uint32_t)(g_xcr0 >> 32);
+            switch (g_mode) {
+                case Mode::Xsaves:
+                    asm volatile("xsaves64 (%0)" :: "r"(area), "a"(lo), "d"(hi) : "memory");
+                    break;
+                case Mode::XsaveOpt:
+                    asm volatile("xsaveopt64 (%0)" :: "r"(area), "a"(lo), "d"(hi) : "memory");
+                    break;
+                case Mode::Xsave:
+                    asm volatile("xsave64 (%0)" :: "r"(area), "a"(lo), "d"(hi) : "memory");
+                    break;
+                default:
+                    asm volatile("fxsave64 (%0)" :: "r"(area) : "memory");
+                    break;
+            }
+        }
+
+        void Restore(const uint8_t* area) {
+            uint32_t lo = (uint32_t)g_xcr0;
+            uint32_t hi = (uint32_t)(g_xcr0 >> 32);
+            switch (g_mode) {
+                case Mode::Xsaves:
+                    asm volatile("xrstors64 (%0)" :: "r"(area), "a"(lo), "d"(hi) : "memory");
+                    break;
+                case Mode::XsaveOpt:
+                case Mode::Xsave:
+                    asm volatile("xrstor64 (%0)" :: "r"(area), "a"(lo), "d"(hi) : "memory");
+                    break;
+                default:
+                    asm volatile("fxrstor64 (%0)" :: "r"(area) : "memory");
+                    break;
+            }
+        }
+    };
+};
@@ -0,0 +1,42 @@
+/*
+    * Fpu.hpp
+    * FPU/SSE/AVX state management (FXSAVE or XSAVE family)
+    * Copyright (c) 2026 Daniel Hammer
+*/
+
+#pragma once
+#include <cstdint>
+
+namespace Hal {
+    namespace Fpu {
+        // Space reserved for one saved FPU context. Fits x87 + SSE + AVX in
+        // the XSAVE layout (832 bytes); larger feature sets stay disabled.
+        constexpr uint32_t MaxAreaSize = 1024;
+
+        // Pick the save mechanism (XSAVES > XSAVEOPT > XSAVE > FXSAVE) and
+        // enable it on the BSP. Call after EnableSSE() once logging works.
+        void Initialize();
+
+        // Apply the BSP's configuration (CR4.OSXSAVE, XCR0) on the
+        // calling CPU. Used by APs and after S3 resume.
+        void InitializeAP();
+
+        // Fill a save area with the power-on FPU state
+        void InitArea(uint8_t* area);
+
+        // Save/restore the FPU state of this CPU (area is 64-byte aligned)
+        void Save(uint8_t* area);
+        void Restore(const uint8_t* area);
+
+        // CR0.TS: the next FPU/SSE instruction raises #NM
+        inline void SetTaskSwitched() {
+            uint64_t cr0;
+            asm volatile("mov %%cr0, %0" : "=r"(cr0));
+            asm volatile("mov %0, %%cr0" :: "r"(cr0 | (1ULL << 3)) : "memory");
+        }
+
+        inline void ClearTaskSwitched() {
+            asm volatile("clts" ::: "memory");
+        }
+    };
+};
@@ -12,6 +12,8 @@
 #include <CppLib/Stream.hpp>
 #include <Memory/PageFrameAllocator.hpp>
 #include <Sched/Scheduler.hpp>
+#include <Api/Syscall.hpp>
+#include <Common/Trace.hpp>
 
 namespace Hal {
     constexpr auto InterruptGate = 0x8E;
@@ -69,36 +71,95 @@ namespace Hal {
         return frame->CS;
     }
 
-    template<size_t i>
-    __attribute__((interrupt)) void ExceptionHandler(System::PanicFrame* frame)
-    {
-        uint64_t cs = GetExceptionCS(i, frame);
-        bool fromUser = (cs & 3) == 3;
-
-        // SWAPGS: if from user mode, GS base is user-defined.
-        // Swap to kernel per-CPU GS base so scheduler calls work.
-        if (fromUser) asm volatile("swapgs");
-
+    // Kill the faulting process for an exception from user mode (GS already
+    // swapped to the kernel's), panic for one from the kernel.
+    static void FatalException(uint8_t vector, System::PanicFrame* frame, bool fromUser) {
         // If the fault originated in user-mode (ring 3), kill the process
         // instead of panicking the entire system.
         if (fromUser && Sched::GetCurrentPid() >= 0) {
             auto* proc = Sched::GetCurrentProcessPtr();
             Kt::KernelLogStream(Kt::ERROR, "Exception")
-                << ExceptionStrings[i] << " in process \""
+                << ExceptionStrings[vector] << " in process \""
                 << proc->name << "\" (pid " << proc->pid
                 << ") - process terminated";
             Sched::ExitProcess();
             __builtin_unreachable();
         } else {
-            frame->InterruptVector = i;
-            Panic(ExceptionStrings[i], frame);
+            frame->InterruptVector = vector;
+            Panic(ExceptionStrings[vector], frame);
         }
+    }
+
+    template<size_t i>
+    __attribute__((interrupt)) void ExceptionHandler(System::PanicFrame* frame)
+    {
+        uint64_t cs = GetExceptionCS(i, frame);
+        bool fromUser = (cs & 3) == 3;
+
+        // SWAPGS: if from user mode, GS base is user-defined.
+        // Swap to kernel per-CPU GS base so scheduler calls work.
+        if (fromUser) asm volatile("swapgs");
+
+        FatalException(i, frame, fromUser);
 
         // Unreachable in practice (user faults exit, kernel faults panic),
         // but balance the SWAPGS for correctness.
         if (fromUser) asm volatile("swapgs");
     }
 
+    // #PF: a not-present fault on a user address may be the first touch of
+    // a demand-paged heap page, either by the process itself or by a
+    // syscall copying into its buffer. A write to a present read-only page
+    // may hit a copy-on-write ELF data page (CR0.WP makes kernel writes
+    // fault too). Those are filled in and retried.
+    __attribute__((interrupt)) void PageFaultHandler(System::PanicFrame* frame, uint64_t errorCode)
+    {
+        uint64_t addr;
+        asm volatile("mov %%cr2, %0" : "=r"(addr));
+        bool fromUser = (frame->CS & 3) == 3;
+
+        if (fromUser) asm volatile("swapgs");
+
+        if ((errorCode & 1) == 0 && Sched::GetCurrentPid() >= 0
+            && Montauk::HandleUserPageFault(addr)) {
+            Trace::Emit(Montauk::TRACE_FAULT, Montauk::TRACE_EV_PAGE_FAULT, (uint32_t)errorCode, addr, 1);
+            if (fromUser) asm volatile("swapgs");
+            return;
+        }
+
+        if ((errorCode & 3) == 3 && Sched::GetCurrentPid() >= 0
+            && Montauk::HandleUserWriteFault(addr)) {
+            Trace::Emit(Montauk::TRACE_FAULT, Montauk::TRACE_EV_PAGE_FAULT, (uint32_t)errorCode, addr, 1);
+            if (fromUser) asm volatile("swapgs");
+            return;
+        }
+
+        Trace::Emit(Montauk::TRACE_FAULT, Montauk::TRACE_EV_PAGE_FAULT, (uint32_t)errorCode, addr, 0);
+
+        if (fromUser) {
+            Kt::KernelLogStream(Kt::ERROR, "Exception") << "Page fault at 0x"
+                << base::hex << addr << " (error " << errorCode << ")";
+        }
+        FatalException(14, frame, fromUser);
+
+        if (fromUser) asm volatile("swapgs");
+    }
+
+    // #NM (Device Not Available): CR0.TS is set after a context switch, so
+    // a process's first FPU/SSE instruction lands here and the scheduler
+    // loads its FPU state. The kernel is built without SSE and never traps.
+    __attribute__((interrupt)) void FpuTrapHandler(System::PanicFrame* frame)
+    {
+        if ((frame->CS & 3) != 3) {
+            frame->InterruptVector = 7;
+            Panic(ExceptionStrings[7], frame);
+        }
+
+        asm volatile("swapgs");
+        Sched::HandleFpuTrap();
+        asm volatile("swapgs");
+    }
+
     void LoadIDT(IDTRStruct& idtr) {
         asm("lidt %0" : : "m"(idtr));
     }
@@ -158,6 +219,9 @@ namespace Hal {
         Kt::KernelLogStream(Kt::DEBUG, "IDT") << "Set IDTR Base to " << base::hex << IDTR.Base << " and Limit to " << base::hex << IDTR.Limit;
 
         SetHandler<0, 31>::run();
+        // Interrupt gate: no preemption between loading the state and returning
+        IDTEncodeInterrupt(7, (void*)FpuTrapHandler, InterruptGate, 0);
+        IDTEncodeInterrupt(14, (void*)PageFaultHandler, TrapGate, 0);
 
         Kt::KernelLogStream(Kt::OK, "Hal") << "Created exception interrupt vectors";
 
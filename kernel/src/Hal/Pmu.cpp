@@ -0,0 +1,154 @@
+/*
+    * Pmu.cpp
+    * Architectural performance monitoring counters
+    * Copyright (c) 2026 Daniel Hammer
+*/
+
+#include "Pmu.hpp"
+#include "MSR.hpp"
+#include <Api/Syscall.hpp>
+#include <Terminal/Terminal.hpp>
+#include <CppLib/Stream.hpp>
+
+using namespace Kt;
+
+namespace Hal {
+    namespace Pmu {
+
+        static constexpr uint32_t IA32_PMC0              = 0x0C1;
+        static constexpr uint32_t IA32_PERFEVTSEL0       = 0x186;
+        static constexpr uint32_t IA32_FIXED_CTR0        = 0x309;   // Instructions retired
+        static constexpr uint32_t IA32_FIXED_CTR1        = 0x30A;   // Core cycles
+        static constexpr uint32_t IA32_FIXED_CTR_CTRL    = 0x38D;
+        static constexpr uint32_t IA32_PERF_GLOBAL_CTRL  = 0x38F;
+
+        static constexpr uint64_t EVTSEL_USR = 1ULL << 16;
+        static constexpr uint64_t EVTSEL_OS  = 1ULL << 17;
+        static constexpr uint64_t EVTSEL_EN  = 1ULL << 22;
+
+        static constexpr uint64_t FIXED_OS  = 1;
+        static constexpr uint64_t FIXED_USR = 2;
+
+        // Event select and unit mask of each Montauk::PERF_* event on a
+        // general-purpose counter. The first four are architectural; the
+        // dTLB one is DTLB_LOAD_MISSES.WALK_COMPLETED (Haswell and later).
+        static constexpr uint16_t g_encoding[Montauk::PERF_MAX_EVENTS] = {
+            0x003C, 0x00C0, 0x412E, 0x00C5, 0x0E08
+        };
+
+        // CPUID.0AH:EBX bit that marks each event unavailable (-1: not
+        // architectural, usable on Intel only)
+        static constexpr int g_missingBit[Montauk::PERF_MAX_EVENTS] = { 0, 1, 4, 6, -1 };
+
+        static int g_version = 0;
+        static int g_gpCounters = 0;
+        static int g_fixedCounters = 0;
+        static uint32_t g_available = 0;
+
+        // Where each event is counted: a fixed counter (index | FixedSlot)
+        // or a general-purpose one
+        static constexpr int FixedSlot = 0x100;
+
+        static inline void Cpuid(uint32_t leaf, uint32_t& a, uint32_t& b, uint32_t& c, uint32_t& d) {
+            asm volatile("cpuid" : "=a"(a), "=b"(b), "=c"(c), "=d"(d) : "a"(leaf), "c"(0));
+        }
+
+        void Initialize() {
+            uint32_t a, b, c, d;
+            Cpuid(0, a, b, c, d);
+            bool intel = b == 0x756E6547 && d == 0x49656E69 && c == 0x6C65746E;  // "GenuineIntel"
+            if (a < 0xA) return;
+
+            Cpuid(0xA, a, b, c, d);
+            g_version = a & 0xFF;
+            if (g_version == 0) return;
+
+            g_gpCounters = (a >> 8) & 0xFF;
+            g_fixedCounters = g_version >= 2 ? (int)(d & 0x1F) : 0;
+            int ebxLength = (a >> 24) & 0xFF;
+
+            for (int e = 0; e < Montauk::PERF_MAX_EVENTS; e++) {
+                int bit = g_missingBit[e];
+                bool present = bit < 0 ? intel : (bit < ebxLength && !(b & (1u << bit)));
+                if (present) g_available |= 1u << e;
+            }
+
+            KernelLogStream(OK, "Pmu") << "Perfmon v" << base::dec << (uint64_t)g_version
+                << ", " << (uint64_t)g_gpCounters << " general and " << (uint64_t)g_fixedCounters
+                << " fixed counters";
+        }
+
+        // Assign counters to `events` in bit order; returns what fits
+        static uint32_t Assign(uint32_t events, int* slots) {
+            uint32_t assigned = 0;
+            int gp = 0;
+            for (int e = 0; e < Montauk::PERF_MAX_EVENTS; e++) {
+                uint32_t bit = 1u << e;
+                if (!(events & bit) || !(g_available & bit)) continue;
+                if (bit == Montauk::PERF_INSTRUCTIONS && g_fixedCounters >= 1) {
+                    slots[e] = FixedSlot | 0;
+                } else if (bit == Montauk::PERF_CYCLES && g_fixedCounters >= 2) {
+                    slots[e] = FixedSlot | 1;
+                } else if (gp < g_gpCounters) {
+                    slots[e] = gp++;
+                } else {
+                    continue;
+                }
+                assigned |= bit;
+            }
+            return assigned;
+        }
+
+        uint32_t Supported(uint32_t events) {
+            int slots[Montauk::PERF_MAX_EVENTS];
+            return Assign(events, slots);
+        }
+
+        void Start(uint32_t events, bool userOnly) {
+            int slots[Montauk::PERF_MAX_EVENTS];
+            events = Assign(events, slots);
+            Stop();
+
+            uint64_t global = 0;
+            uint64_t fixedCtrl = 0;
+            for (int e = 0; e < Montauk::PERF_MAX_EVENTS; e++) {
+                if (!(events & (1u << e))) continue;
+                if (slots[e] & FixedSlot) {
+                    int index = slots[e] & 0xFF;
+                    WriteMSR(IA32_FIXED_CTR0 + index, 0);
+                    fixedCtrl |= (FIXED_USR | (userOnly ? 0 : FIXED_OS)) << (index * 4);
+                    global |= 1ULL << (32 + index);
+                } else {
+                    int index = slots[e];
+                    WriteMSR(IA32_PMC0 + index, 0);
+                    WriteMSR(IA32_PERFEVTSEL0 + index, g_encoding[e] | EVTSEL_USR |
+                             (userOnly ? 0 : EVTSEL_OS) | EVTSEL_EN);
+                    global |= 1ULL << index;
+                }
+            }
+
+            if (g_fixedCounters > 0) WriteMSR(IA32_FIXED_CTR_CTRL, fixedCtrl);
+            if (g_version >= 2) WriteMSR(IA32_PERF_GLOBAL_CTRL, global);
+        }
+
+        void Read(uint32_t events, uint64_t* counts) {
+            int slots[Montauk::PERF_MAX_EVENTS];
+            events = Assign(events, slots);
+            for (int e = 0; e < Montauk::PERF_MAX_EVENTS; e++) {
+                if (!(events & (1u << e))) continue;
+                if (slots[e] & FixedSlot) {
+                    counts[e] += ReadMSR(IA32_FIXED_CTR0 + (slots[e] & 0xFF));
+                } else {
+                    counts[e] += ReadMSR(IA32_PMC0 + slots[e]);
+                }
+            }
+        }
+
+        void Stop() {
+            if (g_version == 0) return;
+            if (g_version >= 2) WriteMSR(IA32_PERF_GLOBAL_CTRL, 0);
+            if (g_fixedCounters > 0) WriteMSR(IA32_FIXED_CTR_CTRL, 0);
+            for (int i = 0; i < g_gpCounters; i++) WriteMSR(IA32_PERFEVTSEL0 + i, 0);
+        }
+    };
+};
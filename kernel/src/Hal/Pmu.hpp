@@ -0,0 +1,31 @@
+/*
+    * Pmu.hpp
+    * Architectural performance monitoring counters
+    * Copyright (c) 2026 Daniel Hammer
+*/
+
+#pragma once
+#include <cstdint>
+
+namespace Hal {
+    namespace Pmu {
+        // Probe CPUID leaf 0xA on the BSP. Every CPU is assumed to have the
+        // same counters.
+        void Initialize();
+
+        // The Montauk::PERF_* events of `events` that can be counted at
+        // the same time on this machine; 0 without a usable PMU.
+        uint32_t Supported(uint32_t events);
+
+        // Zero the counters of this CPU and start counting `events` (as
+        // returned by Supported). Interrupts must be off.
+        void Start(uint32_t events, bool userOnly);
+
+        // Add the counts since Start() to counts[] (indexed by event bit)
+        // without stopping. Interrupts must be off.
+        void Read(uint32_t events, uint64_t* counts);
+
+        // Stop every counter on this CPU
+        void Stop();
+    };
+};
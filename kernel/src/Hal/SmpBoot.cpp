@@ -5,13 +5,17 @@
 */
 
 #include "SmpBoot.hpp"
+#include <Hal/BootTasks.hpp>
 #include <Hal/Apic/Apic.hpp>
 #include <Hal/Apic/Interrupts.hpp>
 #include <Hal/IDT.hpp>
 #include <Hal/MSR.hpp>
 #include <Hal/Cpu.hpp>
+#include <Hal/Fpu.hpp>
 #include <Memory/Paging.hpp>
+#include <Memory/Pcid.hpp>
 #include <Memory/PageFrameAllocator.hpp>
+#include <Memory/Pressure.hpp>
 #include <Memory/HHDM.hpp>
 #include <Terminal/Terminal.hpp>
 #include <CppLib/Stream.hpp>
@@ -130,6 +134,7 @@ namespace Smp {
         bsp.cpuIndex = 0;
         bsp.lapicId = Hal::LocalApic::GetId();
         bsp.currentSlot = -1;
+        bsp.fpuOwner = -1;
         bsp.started = true;
         bsp.hasMwait = Hal::HasMwait();
 
@@ -144,6 +149,7 @@ namespace Smp {
 
         // Set GS base for BSP
         SetGSBase(&bsp);
+        Memory::g_pfa->EnableCpuCaches();
 
         g_cpuCount = 1;
 
@@ -180,6 +186,9 @@ namespace Smp {
 
         // --- Enable SSE ---
         Hal::EnableSSE();
+        Hal::EnableWriteProtect();
+        Hal::Fpu::InitializeAP();
+        Memory::VMM::Pcid::InitializeAP();
 
         // --- Set GS base ---
         SetGSBase(cpu);
@@ -209,17 +218,25 @@ namespace Smp {
         // --- Signal that we are online ---
         cpu->started = true;
 
-        // --- Enable interrupts and enter idle loop ---
+        // --- Enable interrupts, help with boot tasks, then idle ---
         asm volatile("sti");
 
+        BootTasks::Worker();
+
         // Use MWAIT for deeper C-states if available, otherwise HLT.
+        // Before sleeping, shrink caches if memory is short and top up
+        // the pre-zeroed page pool.
         static volatile uint64_t s_idleMonitor = 0;
         if (cpu->hasMwait) {
             for (;;) {
+                if (Memory::Pressure::Balance()) continue;
+                if (Memory::g_pfa->RefillZeroPool()) continue;
                 Hal::IdleWait(&s_idleMonitor);
             }
         } else {
             for (;;) {
+                if (Memory::Pressure::Balance()) continue;
+                if (Memory::g_pfa->RefillZeroPool()) continue;
                 asm volatile("hlt");
             }
         }
@@ -253,8 +270,9 @@ namespace Smp {
 
         // Prepare all APs, then wake them all at once. This is safe because:
         // - APs use BSP's timer calibration (no PIT contention)
-        // - APs don't log (no terminal contention)
+        // - APs don't log during bring-up (no terminal contention)
         // - Each AP's init is purely local (GDT, TSS, APIC, MSRs)
+        // Once online they run boot tasks until BootTasks::Finish().
         int apIndex = 1;  // BSP is index 0
         for (uint64_t i = 0; i < cpuCount; i++) {
             limine_mp_info* info = resp->cpus[i];
@@ -267,9 +285,11 @@ namespace Smp {
             ap.cpuIndex = apIndex;
             ap.lapicId = info->lapic_id;
             ap.currentSlot = -1;
+            ap.fpuOwner = -1;
             ap.started = false;
 
             SetupPerCpuGdtTss(ap);
+            Kt::AttachLogRing(apIndex);
             info->extra_argument = (uint64_t)&ap;
 
             // Wake this AP (it runs ApEntry in parallel with other APs)
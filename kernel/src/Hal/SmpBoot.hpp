@@ -39,6 +39,9 @@ namespace Smp {
         Hal::TSS64* tss;          // pointer to this CPU's TSS
         bool hasMwait;            // CPU supports MONITOR/MWAIT
 
+        int fpuOwner;             // Slot whose FPU state is in the registers (-1 = none)
+        bool fpuLive;             // CR0.TS clear: fpuOwner is running and may use the FPU
+
         // Per-CPU GDT and TSS (APs use these; BSP uses globals)
         Hal::BasicGDT cpuGdt __attribute__((aligned(16)));
         Hal::TSS64    cpuTss __attribute__((aligned(16)));
@@ -57,6 +60,13 @@ namespace Smp {
     // Number of online CPUs
     int GetCpuCount();
 
+    // Index of the current CPU, usable from early boot on: GS only points
+    // at CpuData once InitBsp() has run, and until then the BSP is CPU 0
+    inline int CurrentCpuIndex() {
+        if (GetCpuCount() == 0) return 0;
+        return GetCurrentCpuData()->cpuIndex;
+    }
+
     // Initialize BSP per-CPU data (call before interrupts are enabled)
     void InitBsp();
 
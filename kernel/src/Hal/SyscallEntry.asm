@@ -74,6 +74,7 @@ SyscallEntry:
 ; JumpToUserMode -- initial transition to ring 3 via IRETQ
 ;   RDI = user RIP (entry point)
 ;   RSI = user RSP (top of user stack)
+;   RDX = first argument for the entry point (passed in RDI)
 ; ====================================================================
 global JumpToUserMode
 JumpToUserMode:
@@ -86,5 +87,6 @@ JumpToUserMode:
     push 0x202                          ; RFLAGS (IF=1)
     push 0x23                           ; CS  = UserCode | RPL3
     push rdi                            ; RIP = entry point
+    mov rdi, rdx                        ; entry point's first argument
     swapgs                              ; switch from kernel GS to user GS
     iretq
@@ -0,0 +1,152 @@
+/*
+    * Lz4.cpp
+    * LZ4 block format compression and decompression
+    * Copyright (c) 2026 Daniel Hammer
+*/
+
+#include "Lz4.hpp"
+#include "Memory.hpp"
+
+namespace Lib {
+
+    static constexpr int MinMatch = 4;
+
+    // A length field: 15 in the token means more bytes follow, each
+    // added on until one is below 255
+    static bool ReadLength(const uint8_t*& ip, const uint8_t* end, uint64_t& length) {
+        if (length != 15) return true;
+        uint8_t b;
+        do {
+            if (ip >= end) return false;
+            b = *ip++;
+            length += b;
+        } while (b == 255);
+        return true;
+    }
+
+    int64_t Lz4DecompressBlock(const uint8_t* src, uint64_t srcLen, uint8_t* dst, uint64_t dstCap) {
+        const uint8_t* ip = src;
+        const uint8_t* ipEnd = src + srcLen;
+        uint8_t* op = dst;
+        uint8_t* opEnd = dst + dstCap;
+
+        while (ip < ipEnd) {
+            uint8_t token = *ip++;
+
+            // Literals
+            uint64_t literals = token >> 4;
+            if (!ReadLength(ip, ipEnd, literals)) return -1;
+            if (literals > (uint64_t)(ipEnd - ip) || literals > (uint64_t)(opEnd - op)) return -1;
+            memcpy(op, ip, literals);
+            ip += literals;
+            op += literals;
+
+            // The last sequence is literals only
+            if (ip == ipEnd) break;
+
+            // Match: 16-bit little-endian offset back into the output
+            if (ipEnd - ip < 2) return -1;
+            uint64_t offset = (uint64_t)ip[0] | ((uint64_t)ip[1] << 8);
+            ip += 2;
+            if (offset == 0 || offset > (uint64_t)(op - dst)) return -1;
+
+            uint64_t length = token & 0x0F;
+            if (!ReadLength(ip, ipEnd, length)) return -1;
+            length += MinMatch;
+            if (length > (uint64_t)(opEnd - op)) return -1;
+
+            // A match closer than its length repeats bytes it is still
+            // writing, so that case goes byte by byte
+            const uint8_t* match = op - offset;
+            if (offset >= length) {
+                memcpy(op, match, length);
+                op += length;
+            } else {
+                for (uint64_t i = 0; i < length; i++) *op++ = *match++;
+            }
+        }
+
+        return op - dst;
+    }
+
+    // The format ends every block with at least LastLiterals literals, and
+    // no match starts within MatchLimit bytes of the end
+    static constexpr uint64_t LastLiterals = 5;
+    static constexpr uint64_t MatchLimit = 12;
+
+    static uint32_t Read32(const uint8_t* p) {
+        return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+    }
+
+    static uint32_t Hash(uint32_t sequence) {
+        return (sequence * 2654435761u) >> 20;   // 12 bits: Lz4HashEntries
+    }
+
+    // Write the extra bytes of a length whose token field is 15
+    static bool WriteLength(uint8_t*& op, const uint8_t* end, uint64_t length) {
+        if (length < 15) return true;
+        length -= 15;
+        while (length >= 255) {
+            if (op >= end) return false;
+            *op++ = 255;
+            length -= 255;
+        }
+        if (op >= end) return false;
+        *op++ = (uint8_t)length;
+        return true;
+    }
+
+    // One sequence: `literals` bytes from `lit`, then (if matchLength is
+    // non-zero) a match `offset` bytes back
+    static bool WriteSequence(uint8_t*& op, const uint8_t* end, const uint8_t* lit, uint64_t literals,
+                              uint64_t offset, uint64_t matchLength) {
+        if (op >= end) return false;
+        uint8_t* token = op++;
+        *token = (uint8_t)((literals < 15 ? literals : 15) << 4);
+        if (!WriteLength(op, end, literals)) return false;
+        if (literals > (uint64_t)(end - op)) return false;
+        memcpy(op, lit, literals);
+        op += literals;
+        if (matchLength == 0) return true;
+
+        if (end - op < 2) return false;
+        *op++ = (uint8_t)offset;
+        *op++ = (uint8_t)(offset >> 8);
+        uint64_t length = matchLength - MinMatch;
+        *token |= (uint8_t)(length < 15 ? length : 15);
+        return WriteLength(op, end, length);
+    }
+
+    int64_t Lz4CompressBlock(const uint8_t* src, uint64_t srcLen, uint8_t* dst, uint64_t dstCap,
+                             uint16_t* table) {
+        if (srcLen > Lz4MaxInput) return -1;
+        memset(table, 0, Lz4HashEntries * sizeof(uint16_t));
+
+        uint8_t* op = dst;
+        const uint8_t* opEnd = dst + dstCap;
+        uint64_t anchor = 0;
+        uint64_t ip = 0;
+        uint64_t matchEnd = srcLen > LastLiterals ? srcLen - LastLiterals : 0;
+
+        while (ip + MatchLimit < srcLen) {
+            uint32_t sequence = Read32(src + ip);
+            uint32_t h = Hash(sequence);
+            uint64_t ref = table[h];
+            table[h] = (uint16_t)ip;
+            if (ref >= ip || Read32(src + ref) != sequence) {
+                ip++;
+                continue;
+            }
+
+            uint64_t length = MinMatch;
+            while (ip + length < matchEnd && src[ref + length] == src[ip + length]) length++;
+
+            if (!WriteSequence(op, opEnd, src + anchor, ip - anchor, ip - ref, length)) return -1;
+            ip += length;
+            anchor = ip;
+        }
+
+        if (!WriteSequence(op, opEnd, src + anchor, srcLen - anchor, 0, 0)) return -1;
+        return op - dst;
+    }
+}
@@ -0,0 +1,28 @@
+/*
+    * Lz4.hpp
+    * LZ4 block format compression and decompression
+    * Copyright (c) 2026 Daniel Hammer
+*/
+
+#pragma once
+#include <cstdint>
+
+namespace Lib {
+
+    // Decompress one raw LZ4 block (no frame header) of `srcLen` bytes
+    // into `dst`. Returns the decompressed length, or -1 if the block is
+    // malformed or would not fit in `dstCap` bytes.
+    int64_t Lz4DecompressBlock(const uint8_t* src, uint64_t srcLen, uint8_t* dst, uint64_t dstCap);
+
+    // Hash table entries Lz4CompressBlock needs as scratch, and the
+    // largest input it takes (match offsets are 16 bits)
+    static constexpr int Lz4HashEntries = 4096;
+    static constexpr uint64_t Lz4MaxInput = 0xFFFF;
+
+    // Compress `srcLen` bytes into one raw LZ4 block in `dst`, greedily,
+    // finding matches through `table` (Lz4HashEntries entries, contents
+    // ignored). Fast rather than thorough. Returns the block length, or
+    // -1 if it would not fit in `dstCap` bytes or the input is too long.
+    int64_t Lz4CompressBlock(const uint8_t* src, uint64_t srcLen, uint8_t* dst, uint64_t dstCap,
+                             uint16_t* table);
+}
@@ -14,4 +14,11 @@ extern "C"
     void *memset(void *s, int c, std::size_t n);
     void *memmove(void *dest, const void *src, std::size_t n);
     int memcmp(const void *s1, const void *s2, std::size_t n);
-}
\ No newline at end of file
+}
+
+namespace Lib {
+    // Pick the fastest copy/fill instructions this CPU supports (REP
+    // MOVSB/STOSB with ERMS/FSRM). Needs the kernel heap; before it runs
+    // the routines use a qword path.
+    void InitializeMemoryRoutines();
+}
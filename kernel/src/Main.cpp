@@ -18,13 +18,19 @@
 #include <Platform/Util.hpp>
 #include <Hal/IDT.hpp>
 #include <Memory/PageFrameAllocator.hpp>
+#include <Memory/Pressure.hpp>
+#include <Memory/Zram.hpp>
 #include <Memory/Paging.hpp>
+#include <Memory/Pcid.hpp>
+#include <Memory/Tlb.hpp>
+#include <Libraries/Memory.hpp>
 #include <ACPI/ACPI.hpp>
 #include <ACPI/AcpiShutdown.hpp>
 #include <ACPI/AcpiEvents.hpp>
 #include <Hal/Apic/ApicInit.hpp>
 #include <Pci/Pci.hpp>
 #include <Timekeeping/ApicTimer.hpp>
+#include <Timekeeping/BootProfile.hpp>
 #include <Drivers/PS2/PS2Controller.hpp>
 #include <Drivers/PS2/Keyboard.hpp>
 #include <Drivers/PS2/Mouse.hpp>
@@ -32,6 +38,8 @@
 #include <Graphics/Cursor.hpp>
 #include <Hal/MSR.hpp>
 #include <Hal/Cpu.hpp>
+#include <Hal/Fpu.hpp>
+#include <Hal/Pmu.hpp>
 #include <Fs/Ramdisk.hpp>
 #include <Fs/Vfs.hpp>
 #include <Fs/Fat32.hpp>
@@ -59,6 +67,9 @@ extern "C" uint64_t KernelStartSymbol;
 extern "C" uint64_t KernelEndSymbol;
 
 extern "C" void kmain() {
+    // Everything before this point is firmware and the bootloader
+    Timekeeping::BootProfile::Mark("Limine handoff");
+
     if (LIMINE_BASE_REVISION_SUPPORTED == false) {
         Hal::Halt();
     }
@@ -94,6 +105,7 @@ extern "C" void kmain() {
     Hal::BridgeLoadGDT();
 
     Hal::EnableSSE();
+    Hal::EnableWriteProtect();
 #endif
 
     uint64_t hhdm_offset = hhdm_request.response->offset;
@@ -103,6 +115,7 @@ extern "C" void kmain() {
         Panic("System memory map missing!", nullptr);
     }
 
+    int memPhase = Timekeeping::BootProfile::Begin("Memory");
     Kt::KernelLogStream(OK, "Mem") << "Creating PageFrameAllocator";
     Memory::PageFrameAllocator pmm(Memory::Scan(memmap_request.response));
     Memory::g_pfa = &pmm;
@@ -113,6 +126,8 @@ extern "C" void kmain() {
 
     heap.Walk();
 
+    Lib::InitializeMemoryRoutines();
+
 
 #if defined (__x86_64__)
     Hal::IDTInitialize();
@@ -125,6 +140,7 @@ extern "C" void kmain() {
     // Must be done after paging init and before any WC mappings.
     Hal::InitializePAT();
     Kt::KernelLogStream(OK, "Hal") << "PAT reprogrammed (entry 1 = WC)";
+    Timekeeping::BootProfile::End(memPhase);
 
 #endif
 
@@ -138,11 +154,23 @@ extern "C" void kmain() {
     Graphics::Cursor::MapWriteCombining();
 #endif
 
+    int acpiPhase = Timekeeping::BootProfile::Begin("ACPI tables");
     Hal::ACPI g_acpi((Hal::ACPI::XSDP*)Memory::HHDM(rsdp_request.response->address));
+    Timekeeping::BootProfile::End(acpiPhase);
+
+    // Per-CPU features the APs copy at bring-up, and the shootdown IPI
+    // they must answer once online
+    Hal::Fpu::Initialize();
+    Hal::Pmu::Initialize();
+    Memory::VMM::Pcid::Initialize();
+    Memory::VMM::Tlb::Initialize();
 
 #if defined (__x86_64__)
     if (g_acpi.GetXSDT() != nullptr) {
+        // Loads the DSDT into the AML namespace
+        int amlPhase = Timekeeping::BootProfile::Begin("ACPI/AML load");
         Hal::AcpiShutdown::Initialize(g_acpi.GetXSDT());
+        Timekeeping::BootProfile::End(amlPhase);
 
         Hal::ApicInitialize(g_acpi.GetXSDT());
 
@@ -163,6 +191,12 @@ extern "C" void kmain() {
 
         Timekeeping::ApicTimerInitialize();
 
+        // Bring up the APs now (they only need the calibrated timer) so they
+        // can run driver initialization alongside the BSP
+        int smpPhase = Timekeeping::BootProfile::Begin("SMP boot");
+        Smp::BootAPs();
+        Timekeeping::BootProfile::End(smpPhase);
+
         Drivers::PS2::Initialize();
         Drivers::PS2::Keyboard::Initialize();
         Drivers::PS2::Mouse::Initialize();
@@ -212,7 +246,12 @@ extern "C" void kmain() {
             Fs::Ramdisk::Write,
             Fs::Ramdisk::Create,
             Fs::Ramdisk::Delete,
-            Fs::Ramdisk::Mkdir
+            Fs::Ramdisk::Mkdir,
+            nullptr,    // Rename
+            nullptr,    // Lookup
+            nullptr,    // OpenNode
+            Fs::Ramdisk::ReadDirStat,
+            nullptr     // Sync
         };
         Fs::Vfs::RegisterDrive(0, &ramdiskDriver);
     }
@@ -221,36 +260,53 @@ extern "C" void kmain() {
     // When no ramdisk, disk partitions start at drive 0 so init.elf is found there.
     Fs::Fat32::RegisterProbe();
     Fs::Ext2::RegisterProbe();
+    Drivers::WaitForStorage();
+    int mountPhase = Timekeeping::BootProfile::Begin("VFS mount");
     Fs::FsProbe::MountPartitions(hasRamdisk ? 1 : 0);
+    Timekeeping::BootProfile::End(mountPhase);
 
     Hal::LoadTSS();
     Montauk::InitializeSyscalls();
 
     Sched::Initialize();
 
-    // Boot Application Processors (all subsystems ready, APs can schedule)
-    Smp::BootAPs();
+    // Registered after the caches that are cheaper to rebuild, so it is
+    // the last shrinker asked
+    Memory::Zram::Initialize();
+
+    // Remaining driver tasks (network, audio, ...) finish before the
+    // APs move on to scheduling processes
+    Drivers::FinishInitialization();
 
     // Flush any stale PS/2 mouse bytes that accumulated during boot
     // (edge-triggered IRQs can be lost while spinlocks disable interrupts)
     Drivers::PS2::Mouse::FlushState();
 
     Kt::SuppressKernelLog();
+    Timekeeping::BootProfile::Mark("init spawn");
     Sched::Spawn("0:/os/init.elf");
 
+    // Runs as a thread of init, which is never killed
+    Fs::Vfs::StartWriteback();
+
     // Enable preemptive scheduling via the APIC timer
     Timekeeping::EnableSchedulerTick();
 
-    // Main loop: idle until next interrupt.
-    // Use MWAIT for deeper C-states if available, otherwise HLT.
+    // Main loop: idle until next interrupt, after shrinking caches if
+    // memory is short and topping up the pre-zeroed page pool. Use MWAIT
+    // for deeper C-states if available, otherwise HLT.
     auto* bspCpu = Smp::GetCpuData(0);
     if (bspCpu && bspCpu->hasMwait) {
         static volatile uint64_t s_bspIdleMonitor = 0;
         for (;;) {
+            if (Memory::Pressure::Balance()) continue;
+            if (Memory::g_pfa->RefillZeroPool()) continue;
             Hal::IdleWait(&s_bspIdleMonitor);
         }
     } else {
         for (;;) {
+            if (Memory::Pressure::Balance()) continue;
+            if (Memory::g_pfa->RefillZeroPool()) continue;
             asm volatile("hlt");
         }
     }
@@ -0,0 +1,129 @@
+/*
+    * Dma.cpp
+    * Memory for device DMA: coherent buffers and scatter-gather mapping
+    * Copyright (c) 2026 Daniel Hammer
+*/
+
+#include "Dma.hpp"
+#include "Paging.hpp"
+#include "HHDM.hpp"
+#include "PageFrameAllocator.hpp"
+#include <Sched/Scheduler.hpp>
+#include <Libraries/Memory.hpp>
+
+namespace Memory::Dma {
+
+    using VMM::Paging;
+
+    static constexpr uint64_t KernelSpaceStart = 0xFFFF800000000000ULL;
+    static constexpr uint64_t UserSpaceEnd = 0x0000800000000000ULL;
+
+    void* Allocate(uint64_t size, uint64_t& outPhys, uint64_t align) {
+        uint64_t pages = (size + 0xFFF) / 0x1000;
+        if (pages == 0) pages = 1;
+
+        // Buddy blocks are aligned to their size, so asking for at least
+        // `align` bytes gives the alignment; the extra pages go back
+        uint64_t alignPages = align > 0x1000 ? align / 0x1000 : 1;
+        uint64_t blockPages = pages > alignPages ? pages : alignPages;
+
+        void* block = blockPages == 1 ? g_pfa->Allocate() : g_pfa->AllocateContiguous((int)blockPages);
+        if (block == nullptr) return nullptr;
+        if (blockPages > pages) g_pfa->Free((uint8_t*)block + pages * 0x1000, (int)(blockPages - pages));
+
+        memset(block, 0, pages * 0x1000);
+        outPhys = SubHHDM(block);
+        return block;
+    }
+
+    void Free(void* buffer, uint64_t size) {
+        if (buffer == nullptr) return;
+        uint64_t pages = (size + 0xFFF) / 0x1000;
+        if (pages <= 1) g_pfa->Free(buffer);
+        else g_pfa->Free(buffer, (int)pages);
+    }
+
+    bool PinUser(const void* buffer, uint64_t length, bool deviceWrites, Pin& pin) {
+        pin = Pin();
+        uint64_t va = (uint64_t)buffer;
+        if (length == 0 || va + length < va || va + length > UserSpaceEnd) return false;
+
+        Sched::Process* proc = Sched::GetCurrentProcessPtr();
+        if (proc == nullptr || proc->kernelMode) return false;
+
+        // Fault the pages in as the access would have
+        for (uint64_t page = va & ~0xFFFULL; page < va + length; page += 0x1000) {
+            (void)*(volatile const uint8_t*)(page < va ? va : page);
+        }
+
+        // Under vmLock nothing can unmap or swap the pages between the
+        // check and the pin
+        proc->vmLock.Acquire();
+        bool usable = true;
+        for (uint64_t page = va & ~0xFFFULL; page < va + length && usable; page += 0x1000) {
+            usable = Paging::GetUserDmaAddr(proc->pml4Phys, page, deviceWrites) != 0;
+        }
+        if (usable) {
+            __atomic_add_fetch(&proc->dmaPins, 1, __ATOMIC_ACQ_REL);
+            pin.leaderSlot = proc->leaderSlot;
+            pin.pml4Phys = proc->pml4Phys;
+            pin.deviceWrites = deviceWrites;
+        }
+        proc->vmLock.Release();
+        return usable;
+    }
+
+    void Unpin(Pin& pin) {
+        if (pin.leaderSlot < 0) return;
+        __atomic_sub_fetch(&Sched::GetProcessSlot(pin.leaderSlot)->dmaPins, 1, __ATOMIC_ACQ_REL);
+        pin = Pin();
+    }
+
+    uint64_t Address(const void* va, const Pin& pin) {
+        uint64_t addr = (uint64_t)va;
+        if (addr >= KernelSpaceStart) {
+            uint64_t page = VMM::g_paging->GetPhysAddr(addr & ~0xFFFULL);
+            return page ? page | (addr & 0xFFF) : 0;
+        }
+        if (pin.leaderSlot < 0) return 0;
+        return Paging::GetUserDmaAddr(pin.pml4Phys, addr, pin.deviceWrites);
+    }
+
+    int Map(const void* buffer, uint64_t length, bool deviceWrites,
+            Segment* out, int max, uint32_t maxSegment, Pin& pin) {
+        pin = Pin();
+        uint64_t va = (uint64_t)buffer;
+        if (length == 0 || max <= 0) return 0;
+        if (va < KernelSpaceStart && !PinUser(buffer, length, deviceWrites, pin)) return 0;
+
+        int count = 0;
+        uint64_t done = 0;
+        while (done < length) {
+            uint64_t phys = Address((const void*)(va + done), pin);
+            uint64_t chunk = 0x1000 - ((va + done) & 0xFFF);
+            if (chunk > length - done) chunk = length - done;
+            if (phys == 0 || chunk > maxSegment) break;
+
+            Segment* last = count > 0 ? &out[count - 1] : nullptr;
+            if (last && last->phys + last->length == phys && last->length + chunk <= maxSegment) {
+                last->length += (uint32_t)chunk;
+            } else if (count < max) {
+                out[count++] = { phys, (uint32_t)chunk };
+            } else {
+                break;
+            }
+            done += chunk;
+        }
+
+        if (done < length) {
+            Unpin(pin);
+            return 0;
+        }
+        return count;
+    }
+
+    bool IsPinned(int leaderSlot) {
+        return __atomic_load_n(&Sched::GetProcessSlot(leaderSlot)->dmaPins, __ATOMIC_ACQUIRE) > 0;
+    }
+
+};
@@ -0,0 +1,65 @@
+/*
+    * Dma.hpp
+    * Memory for device DMA: coherent buffers and scatter-gather mapping
+    * Copyright (c) 2026 Daniel Hammer
+*/
+
+#pragma once
+#include <cstdint>
+
+namespace Memory::Dma {
+
+    // There is no IOMMU in the picture: devices are handed physical
+    // addresses, and x86 keeps DMA coherent with the caches, so nothing
+    // is flushed around a transfer.
+
+    // Physically contiguous, zeroed memory for rings, descriptor tables
+    // and the like: `size` bytes (rounded up to pages), starting on an
+    // `align` boundary (a power of two, at least a page). Returns the HHDM
+    // address and the physical one in `outPhys`, or nullptr if no free
+    // block is large enough.
+    void* Allocate(uint64_t size, uint64_t& outPhys, uint64_t align = 0x1000);
+    void Free(void* buffer, uint64_t size);
+
+    // Pages of a user buffer stay in place (they are neither freed nor
+    // swapped out) while a Pin on their process is held
+    struct Pin {
+        int leaderSlot = -1;
+        uint64_t pml4Phys = 0;
+        bool deviceWrites = false;
+    };
+
+    // Pin the `length` bytes at user address `buffer` of the current
+    // process, faulting its pages in first. `deviceWrites` is set for
+    // transfers into the buffer. Only private memory qualifies (and no
+    // copy-on-write pages for device writes); false if any page does not,
+    // and the buffer has to go through a bounce buffer.
+    bool PinUser(const void* buffer, uint64_t length, bool deviceWrites, Pin& pin);
+
+    // Release the pin taken by PinUser() or Map(), once the device is
+    // done with the buffer (does nothing if no pin was taken)
+    void Unpin(Pin& pin);
+
+    // Physical address of kernel address `va`, or of a byte of a user
+    // buffer pinned by `pin`. 0 if there is none.
+    uint64_t Address(const void* va, const Pin& pin = Pin());
+
+    struct Segment {
+        uint64_t phys;
+        uint32_t length;
+    };
+
+    // Describe the `length` bytes at `buffer`, kernel memory or a user
+    // buffer (pinned as by PinUser), as at most `max` physically
+    // contiguous segments of at most `maxSegment` bytes each, merging
+    // adjacent pages, so a device can transfer straight to or from it.
+    // Returns the segment count, or 0 (holding no pin) if the buffer has
+    // to go through a bounce buffer.
+    int Map(const void* buffer, uint64_t length, bool deviceWrites,
+            Segment* out, int max, uint32_t maxSegment, Pin& pin);
+
+    // Whether a process has user buffers pinned. Checked under its vmLock
+    // by whatever would unmap or swap out its pages.
+    bool IsPinned(int leaderSlot);
+
+};
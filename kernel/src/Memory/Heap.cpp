@@ -17,14 +17,18 @@
 #include <CppLib/Vector.hpp>
 
 #include "PageFrameAllocator.hpp"
+#include "Slab.hpp"
 
 namespace Memory
 {
+    static kcp::LockStat g_heapLockStat{"heap"};
+
     HeapAllocator::Header* HeapAllocator::GetHeader(void* block) {
         return (Header*)(block - sizeof(Header));
     }
 
     size_t HeapAllocator::GetAllocatedBlockSize(void* ptr) {
+        if (SlabCache* cache = SlabCache::CacheOf(ptr)) return cache->ObjectSize();
         Header* header = GetHeader(ptr);
         return header->size;
     }
@@ -50,10 +54,18 @@ namespace Memory
 
     HeapAllocator::HeapAllocator()
     {
+        Lock.Track(&g_heapLockStat);
         InsertPagesToFreelist(0x32);
     }
 
     void* HeapAllocator::Request(size_t size) {
+        // Small requests come from the slab size classes; the first-fit
+        // list below only sees large or odd sizes.
+        if (size <= Slab::MaxSize) {
+            void* object = Slab::Allocate(size);
+            if (object != nullptr) return object;
+        }
+
         Lock.Acquire();
 
         size_t sizeNeeded = size + sizeof(Header);
@@ -111,6 +123,11 @@ namespace Memory
     }
 
     void HeapAllocator::Free(void* ptr) {
+        if (SlabCache* cache = SlabCache::CacheOf(ptr)) {
+            cache->Free(ptr);
+            return;
+        }
+
         Lock.Acquire();
         
         Header* header = GetHeader(ptr);
@@ -5,7 +5,7 @@
 namespace Memory {
     class HeapAllocator {
         static constexpr std::size_t headerMagic = 0x6CEF9AB4;
-        kcp::Spinlock Lock;
+        kcp::TicketLock Lock;
 
         struct Node {
             size_t size;
@@ -0,0 +1,204 @@
+/*
+    * MemObject.cpp
+    * Shared memory objects: mapped files and named shared memory
+    * Copyright (c) 2026 Daniel Hammer
+*/
+
+#include "MemObject.hpp"
+#include "PageFrameAllocator.hpp"
+#include "Heap.hpp"
+#include "HHDM.hpp"
+#include <Fs/Vfs.hpp>
+#include <Libraries/Memory.hpp>
+
+namespace Memory {
+    static MemObject g_objects[MemObject::MaxObjects];
+
+    // Guards the table and every reference count
+    static kcp::LockStat g_objectsLockStat{"memobject"};
+    static kcp::Mutex g_objectsLock{&g_objectsLockStat};
+
+    static bool StrEqual(const char* a, const char* b) {
+        while (*a && *b) {
+            if (*a != *b) return false;
+            a++;
+            b++;
+        }
+        return *a == *b;
+    }
+
+    MemObject* MemObject::Find(const char* name, bool file) {
+        for (int i = 0; i < MaxObjects; i++) {
+            MemObject& obj = g_objects[i];
+            if (obj.used && !obj.unlinked && obj.isFile == file && StrEqual(obj.name, name)) {
+                return &obj;
+            }
+        }
+        return nullptr;
+    }
+
+    MemObject* MemObject::Create(const char* name, bool file, uint64_t size, int vfsHandle) {
+        MemObject* obj = nullptr;
+        for (int i = 0; i < MaxObjects && obj == nullptr; i++) {
+            if (!g_objects[i].used) obj = &g_objects[i];
+        }
+        if (obj == nullptr) return nullptr;
+
+        uint64_t pageCount = (size + 0xFFF) / 0x1000;
+        uint64_t* frames = (uint64_t*)g_heap->Request(pageCount * sizeof(uint64_t));
+        if (frames == nullptr) return nullptr;
+        memset(frames, 0, pageCount * sizeof(uint64_t));
+
+        obj->used = true;
+        obj->isFile = file;
+        obj->unlinked = false;
+        obj->refs = 1;
+        obj->vfsHandle = vfsHandle;
+        obj->size = size;
+        obj->pages = pageCount;
+        obj->frames = frames;
+
+        int len = 0;
+        while (name[len] && len < MaxNameLength - 1) {
+            obj->name[len] = name[len];
+            len++;
+        }
+        obj->name[len] = '\0';
+        return obj;
+    }
+
+    // Free the frames and the slot. Table lock held, no references left.
+    void MemObject::Destroy() {
+        for (uint64_t i = 0; i < pages; i++) {
+            if (frames[i] != 0) g_pfa->Free((void*)HHDM(frames[i]));
+        }
+        g_heap->Free(frames);
+        if (vfsHandle >= 0) Fs::Vfs::VfsClose(vfsHandle);
+
+        frames = nullptr;
+        vfsHandle = -1;
+        pages = 0;
+        size = 0;
+        used = false;
+    }
+
+    MemObject* MemObject::OpenFile(const char* path) {
+        g_objectsLock.Acquire();
+
+        // A file changed since it was opened keeps serving its current
+        // mappings under a hidden name; new ones get a fresh object
+        uint64_t generation = Fs::Vfs::VfsPathGeneration(path);
+        MemObject* obj = Find(path, true);
+        if (obj && obj->generation != generation) {
+            obj->unlinked = true;
+            obj = nullptr;
+        }
+        if (obj) {
+            obj->refs++;
+            g_objectsLock.Release();
+            return obj;
+        }
+
+        int handle = Fs::Vfs::VfsOpen(path);
+        if (handle < 0) {
+            g_objectsLock.Release();
+            return nullptr;
+        }
+
+        uint64_t size = Fs::Vfs::VfsGetSize(handle);
+        obj = size > 0 ? Create(path, true, size, handle) : nullptr;
+        if (obj == nullptr) Fs::Vfs::VfsClose(handle);
+        else obj->generation = generation;
+
+        g_objectsLock.Release();
+        return obj;
+    }
+
+    MemObject* MemObject::OpenShared(const char* name, uint64_t size) {
+        g_objectsLock.Acquire();
+
+        MemObject* obj = Find(name, false);
+        if (obj) {
+            if (obj->size < size) obj = nullptr;
+            else obj->refs++;
+        } else if (size > 0) {
+            obj = Create(name, false, size, -1);
+        }
+
+        g_objectsLock.Release();
+        return obj;
+    }
+
+    MemObject* MemObject::CreateAnonymous(uint64_t size) {
+        if (size == 0) return nullptr;
+        g_objectsLock.Acquire();
+
+        MemObject* obj = Create("", false, size, -1);
+        if (obj) obj->unlinked = true;
+
+        g_objectsLock.Release();
+        return obj;
+    }
+
+    bool MemObject::Unlink(const char* name) {
+        g_objectsLock.Acquire();
+
+        MemObject* obj = Find(name, false);
+        if (obj) {
+            obj->unlinked = true;
+            if (obj->refs == 0) obj->Destroy();
+        }
+
+        g_objectsLock.Release();
+        return obj != nullptr;
+    }
+
+    void MemObject::Retain() {
+        g_objectsLock.Acquire();
+        refs++;
+        g_objectsLock.Release();
+    }
+
+    void MemObject::Release() {
+        g_objectsLock.Acquire();
+        refs--;
+
+        // An unmapped file is dropped; a named object waits for Unlink()
+        if (refs == 0 && (isFile || unlinked)) Destroy();
+
+        g_objectsLock.Release();
+    }
+
+    uint64_t MemObject::PageAt(uint64_t index) {
+        if (index >= pages) return 0;
+
+        lock.Acquire();
+        if (frames[index] != 0) {
+            uint64_t phys = frames[index];
+            lock.Release();
+            return phys;
+        }
+
+        void* page = g_pfa->AllocateZeroed();
+        if (page == nullptr) {
+            lock.Release();
+            return 0;
+        }
+
+        if (isFile) {
+            // The tail of the last page stays zero
+            uint64_t offset = index * 0x1000;
+            uint64_t length = size - offset < 0x1000 ? size - offset : 0x1000;
+            if (Fs::Vfs::VfsRead(vfsHandle, (uint8_t*)page, offset, length) < 0) {
+                g_pfa->Free(page);
+                lock.Release();
+                return 0;
+            }
+        }
+
+        frames[index] = SubHHDM((uint64_t)page);
+        uint64_t phys = frames[index];
+        lock.Release();
+        return phys;
+    }
+};
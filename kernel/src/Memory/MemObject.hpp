@@ -0,0 +1,74 @@
+/*
+    * MemObject.hpp
+    * Shared memory objects: mapped files and named shared memory
+    * Copyright (c) 2026 Daniel Hammer
+*/
+
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <CppLib/Spinlock.hpp>
+
+namespace Memory {
+    // A set of frames shared by every mapping of it. Either the contents
+    // of a file (read-only, each page read from the VFS on first touch),
+    // or a named anonymous region (zero-filled, writable). Mappings hold
+    // references: a file stays cached while anyone maps it, a shared
+    // object until it is unlinked and no longer mapped.
+    class MemObject {
+    public:
+        static constexpr int MaxObjects = 192;  // Each window's event queue takes one
+        static constexpr int MaxNameLength = 256;
+
+        // Take a reference to the object for the file at `path` (an
+        // absolute VFS path), opening it if nobody maps it yet. Writes to
+        // the file are not seen by existing mappings; mapping it again
+        // afterwards reads the new contents.
+        static MemObject* OpenFile(const char* path);
+
+        // Take a reference to the shared object `name`, creating it with
+        // `size` bytes if it does not exist. An existing object must be at
+        // least `size` bytes; size 0 only opens.
+        static MemObject* OpenShared(const char* name, uint64_t size);
+
+        // A new nameless, zero-filled, writable object of `size` bytes,
+        // freed when its last reference goes. For memory the kernel shares
+        // with one process.
+        static MemObject* CreateAnonymous(uint64_t size);
+
+        // Remove the name of a shared object. It is freed once the last
+        // mapping is gone. Returns false if there is no such object.
+        static bool Unlink(const char* name);
+
+        void Retain();
+        void Release();
+
+        uint64_t Pages() const { return pages; }
+
+        // References held right now. Only meaningful to a holder: at 1 it
+        // knows nobody else can reach the object any more.
+        int References() const { return __atomic_load_n(&refs, __ATOMIC_RELAXED); }
+        bool IsWritable() const { return !isFile; }
+
+        // Physical address of page `index`, filled in on first use.
+        // Returns 0 past the end, on OOM or when the read fails.
+        uint64_t PageAt(uint64_t index);
+
+    private:
+        bool used = false;
+        bool isFile = false;
+        bool unlinked = false;
+        int refs = 0;
+        int vfsHandle = -1;
+        uint64_t size = 0;
+        uint64_t pages = 0;
+        uint64_t generation = 0;      // Files: VfsPathGeneration() when opened
+        uint64_t* frames = nullptr;   // Physical address per page, 0 = not loaded yet
+        kcp::Mutex lock{};
+        char name[MaxNameLength]{};
+
+        static MemObject* Find(const char* name, bool file);
+        static MemObject* Create(const char* name, bool file, uint64_t size, int vfsHandle);
+        void Destroy();
+    };
+};
@@ -6,203 +6,396 @@
 
 #include "PageFrameAllocator.hpp"
 #include "HHDM.hpp"
+#include "Pressure.hpp"
 #include <Libraries/Memory.hpp>
 #include <Terminal/Terminal.hpp>
 #include <CppLib/Spinlock.hpp>
 #include <Common/Panic.hpp>
+#include <Hal/SmpBoot.hpp>
 
 namespace Memory {
+    // ====================================================================
+    // Per-CPU single page cache
+    //
+    // Only touched by its own CPU with interrupts disabled. It is refilled
+    // from and drained to the buddy lists in batches, so a run of Allocate()
+    // or Free() calls takes the global lock once per CacheBatch pages.
+    // ====================================================================
+
+    static constexpr int CacheSize = 64;
+    static constexpr int CacheBatch = 32;
+
+    struct PageCache {
+        int count;
+        void* pages[CacheSize];
+    };
+
+    static PageCache g_caches[Smp::MaxCPUs];
+
+    static kcp::LockStat g_pfaLockStat{"pfa"};
+
+    static inline uint64_t SaveAndDisableInterrupts() {
+        uint64_t flags;
+        asm volatile("pushfq; pop %0; cli" : "=r"(flags) :: "memory");
+        return flags;
+    }
+
+    static inline void RestoreInterrupts(uint64_t flags) {
+        asm volatile("push %0; popfq" :: "r"(flags) : "memory");
+    }
+
+    static inline bool InterruptsEnabled() {
+        uint64_t flags;
+        asm volatile("pushfq; pop %0" : "=r"(flags) :: "memory");
+        return (flags & 0x200) != 0;
+    }
+
+    static inline int OrderFor(size_t pages) {
+        int order = 0;
+        while (((size_t)1 << order) < pages) order++;
+        return order;
+    }
+
     PageFrameAllocator::PageFrameAllocator(LargestSection section) {
+        Lock.Track(&g_pfaLockStat);
+
         /* we need the virtual address rather than the physical address, so we call the helper */
         g_section = LargestSection{
             .address = HHDM(section.address),
             .size = section.size
         };
 
-        head.next = (Page*)g_section.address;
-        head.next->size = section.size;
-        head.next->next = nullptr;
+        // Page indices count from the 2 MiB boundary at or below the section,
+        // so every block of up to 512 pages is also physically 2 MiB aligned
+        // (huge-page mappable). The pages before the section are never free.
+        uint64_t alignedPhys = section.address & ~(HugePageSize - 1);
+        poolBase = HHDM(alignedPhys);
+        firstPage = (section.address - alignedPhys) / 0x1000;
+
+        // The per-page order table lives in the first pages of the section
+        pageCount = firstPage + section.size / 0x1000;
+        size_t metaPages = (pageCount + 0xFFF) / 0x1000;
+        blockOrder = (uint8_t*)g_section.address;
+        memset(blockOrder, NotFree, pageCount);
+
+        FreeRangeLocked(firstPage + metaPages, pageCount - firstPage - metaPages);
 
         Kt::KernelLogStream(Kt::DEBUG, "PageFrameAllocator") << "New pool size: " << section.size;
     }
 
-    void* PageFrameAllocator::Allocate() {
-        Lock.Acquire();
+    void PageFrameAllocator::EnableCpuCaches() {
+        cachesEnabled = true;
+    }
 
-        Page* current = head.next;
-        Page* prev = &head;
+    void PageFrameAllocator::SetSlabPage(void* page, bool slab) {
+        size_t index = IndexOf(page);
+        if (index < pageCount) blockOrder[index] = slab ? SlabPage : NotFree;
+    }
 
-        while (current != nullptr) {
-            if (current->size >= 0x1000) {
-                uint64_t current_addr = (uint64_t)current;
-                uint64_t current_end_addr = current_addr + current->size;
-                uint64_t new_size = current->size - 0x1000;
+    bool PageFrameAllocator::IsSlabPage(void* ptr) const {
+        size_t index = IndexOf(ptr);
+        return index < pageCount && blockOrder[index] == SlabPage;
+    }
 
-                if (new_size == 0) {
-                    prev->next = current->next;
+    size_t PageFrameAllocator::IndexOf(void* ptr) const {
+        return ((uint64_t)ptr - poolBase) / 0x1000;
+    }
 
-                    Lock.Release();
-                    return (void*)current;
-                }
-                else
-                {
-                    current->size -= 0x1000;
+    void* PageFrameAllocator::AddressOf(size_t index) const {
+        return (void*)(poolBase + index * 0x1000);
+    }
+
+    // A page is free if some free block covers it. Blocks are aligned to
+    // their size, so the only candidate of each order starts at the page
+    // index rounded down to that order.
+    bool PageFrameAllocator::IsFree(size_t index) const {
+        for (int order = 0; order <= MaxOrder; order++) {
+            size_t head = index & ~(((size_t)1 << order) - 1);
+            if (blockOrder[head] == order) return true;
+        }
+        return false;
+    }
+
+    void PageFrameAllocator::PushBlock(size_t index, int order) {
+        FreeBlock* block = (FreeBlock*)AddressOf(index);
+        block->prev = nullptr;
+        block->next = freeLists[order];
+        if (block->next) block->next->prev = block;
+        freeLists[order] = block;
+        blockOrder[index] = (uint8_t)order;
+    }
+
+    void PageFrameAllocator::RemoveBlock(size_t index, int order) {
+        FreeBlock* block = (FreeBlock*)AddressOf(index);
+        if (block->prev) block->prev->next = block->next;
+        else freeLists[order] = block->next;
+        if (block->next) block->next->prev = block->prev;
+        blockOrder[index] = NotFree;
+    }
 
-                    Lock.Release();
-                    return (void*)current_end_addr - 0x1000;
+    // Take a block of exactly 2^order pages, splitting a larger one if
+    // needed. Returns its page index, or -1. Lock must be held.
+    long PageFrameAllocator::AllocateBlock(int order) {
+        int found = order;
+        while (found <= MaxOrder && freeLists[found] == nullptr) found++;
+        if (found > MaxOrder) return -1;
+
+        size_t index = IndexOf(freeLists[found]);
+        RemoveBlock(index, found);
+
+        // Return the upper halves to the lists until the block fits
+        while (found > order) {
+            found--;
+            PushBlock(index + ((size_t)1 << found), found);
+        }
+
+        freePages -= (size_t)1 << order;
+        return (long)index;
+    }
+
+    // Insert a free block, merging it with its buddy for as long as the
+    // buddy is a free block of the same order. Lock must be held.
+    void PageFrameAllocator::FreeBlockAt(size_t index, int order) {
+        while (order < MaxOrder) {
+            size_t buddy = index ^ ((size_t)1 << order);
+            if (buddy + ((size_t)1 << order) > pageCount || blockOrder[buddy] != order) break;
+            RemoveBlock(buddy, order);
+            if (buddy < index) index = buddy;
+            order++;
+        }
+        PushBlock(index, order);
+    }
+
+    // Free an arbitrary page range by splitting it into the largest aligned
+    // power-of-two blocks it contains. Lock must be held.
+    void PageFrameAllocator::FreeRangeLocked(size_t index, size_t pages) {
+        if (index < firstPage || index >= pageCount || pages > pageCount - index) {
+            Kt::KernelLogStream(Kt::WARNING, "PFA")
+                << "Free of pages outside the pool at " << (uint64_t)AddressOf(index) << ", ignoring";
+            return;
+        }
+
+        while (pages > 0) {
+            int order = 0;
+            while (order < MaxOrder
+                   && (index & (((size_t)1 << (order + 1)) - 1)) == 0
+                   && ((size_t)1 << (order + 1)) <= pages) {
+                order++;
+            }
+
+            if (IsFree(index)) {
+                Kt::KernelLogStream(Kt::WARNING, "PFA")
+                    << "Double-free detected at " << (uint64_t)AddressOf(index) << ", ignoring";
+            } else {
+                FreeBlockAt(index, order);
+                freePages += (size_t)1 << order;
+            }
+
+            index += (size_t)1 << order;
+            pages -= (size_t)1 << order;
+        }
+    }
+
+    void* PageFrameAllocator::AllocateFree() {
+        if (cachesEnabled) {
+            uint64_t flags = SaveAndDisableInterrupts();
+            PageCache& cache = g_caches[Smp::GetCurrentCpuData()->cpuIndex];
+
+            bool refilled = false;
+            if (cache.count == 0) {
+                Lock.Acquire();
+                while (cache.count < CacheBatch) {
+                    long index = AllocateBlock(0);
+                    if (index < 0) break;
+                    cache.pages[cache.count++] = AddressOf((size_t)index);
                 }
+                Lock.Release();
+                refilled = true;
             }
 
-            prev = current;
-            current = current->next;
+            void* page = cache.count > 0 ? cache.pages[--cache.count] : nullptr;
+            RestoreInterrupts(flags);
+            if (refilled) UpdatePressure();
+            return page != nullptr ? page : TakeZeroed();
         }
 
+        Lock.Acquire();
+        long index = AllocateBlock(0);
         Lock.Release();
-        return nullptr;
+        return index < 0 ? TakeZeroed() : AddressOf((size_t)index);
+    }
+
+    void* PageFrameAllocator::Allocate() {
+        void* page = AllocateFree();
+        if (page != nullptr) return page;
+
+        // Out of pages. Shrinkers never block, but they may still wake a
+        // thread waiting on their cache, which is not safe from interrupt
+        // context or under a spinlock: both run with interrupts off.
+        if (!InterruptsEnabled()) return nullptr;
+        if (Pressure::Reclaim(CacheBatch) == 0) return nullptr;
+        return AllocateFree();
     }
 
     void* PageFrameAllocator::AllocateZeroed() {
-        auto page = Allocate();
+        void* page = TakeZeroed();
+        if (page != nullptr) return page;
+
+        page = Allocate();
         if (page == nullptr) return nullptr;
         memset(page, 0, 0x1000);
 
         return page;
     }
 
-    void* PageFrameAllocator::ReallocConsecutive(void* ptr, int n) {
+    // ====================================================================
+    // Pre-zeroed page pool
+    //
+    // Idle CPUs zero free pages ahead of time, so large runs of
+    // AllocateZeroed() (user heap, window buffers) mostly skip the memset.
+    // Pooled pages still count as free and are handed out by Allocate()
+    // when the buddy lists run dry.
+    // ====================================================================
+
+    void* PageFrameAllocator::TakeZeroed() {
+        if (zeroCount == 0) return nullptr;
+
+        ZeroLock.Acquire();
+        ZeroPage* page = zeroPool;
+        if (page != nullptr) {
+            zeroPool = page->next;
+            zeroCount = zeroCount - 1;
+        }
+        ZeroLock.Release();
+
+        if (page != nullptr) page->next = nullptr;
+        return page;
+    }
+
+    bool PageFrameAllocator::RefillZeroPool() {
+        for (int i = 0; i < ZeroRefillBatch; i++) {
+            // Leave headroom so the pool never holds the last free memory
+            if (zeroCount >= ZeroPoolTarget || freePages < ZeroPoolTarget * 4) return false;
+
+            void* page = Allocate();
+            if (page == nullptr) return false;
+            memset(page, 0, 0x1000);
+
+            ZeroLock.Acquire();
+            ZeroPage* zp = (ZeroPage*)page;
+            zp->next = zeroPool;
+            zeroPool = zp;
+            zeroCount = zeroCount + 1;
+            ZeroLock.Release();
+        }
+        return true;
+    }
+
+    void* PageFrameAllocator::AllocateContiguous(int n) {
+        if (n <= 0) return nullptr;
+        if (n == 1) return Allocate();
+
+        int order = OrderFor((size_t)n);
+        if (order > MaxOrder) return nullptr;
+
         Lock.Acquire();
+        long index = AllocateBlock(order);
+        if (index >= 0 && ((size_t)1 << order) > (size_t)n) {
+            // Give back the tail beyond the n pages asked for
+            FreeRangeLocked((size_t)index + n, ((size_t)1 << order) - n);
+        }
+        Lock.Release();
+        UpdatePressure();
 
-        // Search the free list for a single contiguous region >= n pages.
-        // The old implementation assumed N consecutive Allocate() calls gave
-        // adjacent pages, which breaks when individual pages are freed back.
-        size_t needed = (size_t)n * 0x1000;
-        Page* current = head.next;
-        Page* prev = &head;
-
-        while (current != nullptr) {
-            if (current->size >= needed) {
-                // Carve from the top of this contiguous region
-                current->size -= needed;
-                void* base;
-                if (current->size == 0) {
-                    base = (void*)current;
-                    prev->next = current->next;
-                } else {
-                    base = (void*)((uint64_t)current + current->size);
-                }
+        return index < 0 ? nullptr : AddressOf((size_t)index);
+    }
 
-                Lock.Release();
+    void* PageFrameAllocator::AllocateHuge() {
+        return AllocateContiguous(HugePageSize / 0x1000);
+    }
 
-                if (ptr != nullptr) {
-                    memcpy(base, ptr, 0x1000);  // copy one page (ptr is always a single page)
-                    Free(ptr);
-                }
+    void* PageFrameAllocator::ReallocConsecutive(void* ptr, int n) {
+        void* base = AllocateContiguous(n);
+        if (base == nullptr) {
+            Panic("PageFrameAllocator: no contiguous region available", nullptr);
+            return nullptr;
+        }
 
-                return base;
-            }
-            prev = current;
-            current = current->next;
+        if (ptr != nullptr) {
+            memcpy(base, ptr, 0x1000);  // copy one page (ptr is always a single page)
+            Free(ptr);
         }
 
-        Lock.Release();
-        Panic("PageFrameAllocator: no contiguous region available", nullptr);
-        return nullptr;
+        return base;
     }
 
-    // Core free implementation: sorted-insert with coalescing.
-    // The free list is kept sorted by address so adjacent blocks can be merged,
-    // preventing fragmentation from accumulating over time.
     void PageFrameAllocator::FreeRange(void* ptr, size_t size) {
         if (ptr == nullptr || size == 0) return;
 
         Lock.Acquire();
+        FreeRangeLocked(IndexOf(ptr), size / 0x1000);
+        Lock.Release();
+        UpdatePressure();
+    }
 
-        uint64_t addr = (uint64_t)ptr;
+    void PageFrameAllocator::Free(void* ptr) {
+        if (ptr == nullptr) return;
 
-        // Walk to find the sorted insertion point: prev < addr < current
-        Page* prev = &head;
-        Page* current = head.next;
+        if (cachesEnabled && IndexOf(ptr) < pageCount) {
+            uint64_t flags = SaveAndDisableInterrupts();
+            PageCache& cache = g_caches[Smp::GetCurrentCpuData()->cpuIndex];
 
-        while (current != nullptr && (uint64_t)current < addr) {
-            // Double-free check: addr falls within an existing free block
-            if (addr < (uint64_t)current + current->size) {
-                Kt::KernelLogStream(Kt::WARNING, "PFA")
-                    << "Double-free detected at " << addr << ", ignoring";
+            bool drained = false;
+            if (cache.count == CacheSize) {
+                Lock.Acquire();
+                while (cache.count > CacheSize - CacheBatch) {
+                    FreeRangeLocked(IndexOf(cache.pages[--cache.count]), 1);
+                }
                 Lock.Release();
-                return;
+                drained = true;
             }
-            prev = current;
-            current = current->next;
-        }
 
-        // Double-free check: exact match with next block
-        if (current != nullptr && (uint64_t)current == addr) {
-            Kt::KernelLogStream(Kt::WARNING, "PFA")
-                << "Double-free detected at " << addr << ", ignoring";
-            Lock.Release();
+            cache.pages[cache.count++] = ptr;
+            RestoreInterrupts(flags);
+            if (drained) UpdatePressure();
             return;
         }
 
-        // Try to coalesce with previous block (if prev ends where new block starts)
-        bool merged_prev = false;
-        if (prev != &head) {
-            uint64_t prev_end = (uint64_t)prev + prev->size;
-            if (prev_end == addr) {
-                prev->size += size;
-                merged_prev = true;
-            }
-        }
-
-        // Try to coalesce with next block (if new block ends where next starts)
-        if (current != nullptr && addr + size == (uint64_t)current) {
-            if (merged_prev) {
-                // Three-way merge: prev absorbs new block and current
-                prev->size += current->size;
-                prev->next = current->next;
-            } else {
-                // Forward merge: new block absorbs current
-                Page* new_page = (Page*)addr;
-                new_page->size = size + current->size;
-                new_page->next = current->next;
-                prev->next = new_page;
-            }
-        } else if (!merged_prev) {
-            // No merging possible: insert new block between prev and current
-            Page* new_page = (Page*)addr;
-            new_page->size = size;
-            new_page->next = current;
-            prev->next = new_page;
-        }
-
-        Lock.Release();
-    }
-
-    void PageFrameAllocator::Free(void* ptr) {
         FreeRange(ptr, 0x1000);
     }
 
     void PageFrameAllocator::Free(void* ptr, int n) {
         if (ptr == nullptr || n <= 0) return;
-        // Free the entire contiguous range as a single block.
-        // This is more efficient than freeing one page at a time and
-        // guarantees the range stays coalesced.
+        if (n == 1) {
+            Free(ptr);
+            return;
+        }
+        // Free the entire contiguous range at once so it goes back as the
+        // largest blocks it can form.
         FreeRange(ptr, (size_t)n * 0x1000);
     }
 
     void PageFrameAllocator::GetStats(Montauk::MemStats* out) {
         if (!out) return;
         Lock.Acquire();
-        uint64_t freeBytes = 0;
-        Page* current = head.next;
-        while (current != nullptr) {
-            freeBytes += current->size;
-            current = current->next;
-        }
+        uint64_t freeBytes = (uint64_t)freePages * 0x1000;
         Lock.Release();
 
+        freeBytes += (uint64_t)zeroCount * 0x1000;
+
+        for (int i = 0; i < Smp::MaxCPUs; i++) {
+            freeBytes += (uint64_t)g_caches[i].count * 0x1000;
+        }
+
         out->totalBytes = g_section.size;
         out->freeBytes = freeBytes;
         out->usedBytes = g_section.size > freeBytes ? g_section.size - freeBytes : 0;
         out->pageSize = 0x1000;
+        out->pressure = Pressure::Level();
+        out->pressureEvents = Pressure::EventCount();
+    }
+
+    void PageFrameAllocator::UpdatePressure() {
+        Pressure::Update(freePages + zeroCount, g_section.size / 0x1000);
     }
 };
@@ -11,28 +11,97 @@
 #include <CppLib/Spinlock.hpp>
 
 namespace Memory {
+    // Binary buddy allocator over the largest usable memory section. Free
+    // blocks of 2^order pages sit on one list per order and merge with their
+    // buddy when both halves are free. Single pages go through a small
+    // per-CPU cache first, so the common case takes no global lock.
     class PageFrameAllocator {
-        struct Page {
-            std::size_t size;
-            Page* next;
+        static constexpr int MaxOrder = 15;          // Largest block: 2^15 pages (128 MiB)
+        static constexpr uint8_t NotFree = 0xFF;     // blockOrder[] entry of a page not heading a free block
+        static constexpr uint8_t SlabPage = 0xFE;    // blockOrder[] entry of an allocated slab page
+
+        static constexpr size_t ZeroPoolTarget = 2048;  // Pre-zeroed pages kept ready (8 MiB)
+        static constexpr int ZeroRefillBatch = 8;       // Pages zeroed per RefillZeroPool() call
+
+        struct FreeBlock {
+            FreeBlock* next;
+            FreeBlock* prev;
+        };
+
+        struct ZeroPage {
+            ZeroPage* next;             // The only non-zero word of a pooled page
         };
 
-        Page head{};
-        kcp::Spinlock Lock{};
+        FreeBlock* freeLists[MaxOrder + 1]{};
+        uint8_t* blockOrder = nullptr;  // Per page: order of the free block starting there, or a tag
+        size_t pageCount = 0;
+        size_t freePages = 0;           // In the buddy lists (not counting per-CPU caches)
+        bool cachesEnabled = false;
+        kcp::TicketLock Lock{};
+        uint64_t poolBase = 0;          // Address of page index 0 (2 MiB aligned)
+        size_t firstPage = 0;           // Index of the section's first page
+        ZeroPage* zeroPool = nullptr;
+        volatile size_t zeroCount = 0;
+        kcp::Spinlock ZeroLock{};
         LargestSection g_section;
 
+        size_t IndexOf(void* ptr) const;
+        void* AddressOf(size_t index) const;
+        bool IsFree(size_t index) const;
+        void PushBlock(size_t index, int order);
+        void RemoveBlock(size_t index, int order);
+        long AllocateBlock(int order);
+        void FreeBlockAt(size_t index, int order);
         void FreeRange(void* ptr, std::size_t size);
+        void FreeRangeLocked(size_t index, size_t pages);
+        void* TakeZeroed();
+        void* AllocateFree();
 public:
+        static constexpr uint64_t HugePageSize = 0x200000;  // 2 MiB, 512 pages
+
         PageFrameAllocator(LargestSection section);
 
+        // Turn on the per-CPU single page caches (needs the GS base set up)
+        void EnableCpuCaches();
+        bool CpuCachesEnabled() const { return cachesEnabled; }
+
+        // Tag an allocated page as owned by the slab allocator, so Free()
+        // on any pointer into it can be routed there. Clear before freeing.
+        void SetSlabPage(void* page, bool slab);
+        bool IsSlabPage(void* ptr) const;
+
+        // Single pages. When none is free, the caches registered with
+        // Memory::Pressure are asked to give some back first.
         void* Allocate();
         void* AllocateZeroed();
+
+        // Zero a few free pages into the pre-zeroed pool that AllocateZeroed()
+        // draws from. Called from the idle loops; returns false once the pool
+        // is full (or memory is short), i.e. when the CPU may go to sleep.
+        bool RefillZeroPool();
+
+        // Allocate `n` physically contiguous pages (not zeroed). Returns
+        // nullptr if no free block is large enough.
+        void* AllocateContiguous(int n);
+
+        // Allocate 512 contiguous pages starting on a 2 MiB physical
+        // boundary (not zeroed), for a huge-page mapping. Returns nullptr
+        // when memory is too fragmented.
+        void* AllocateHuge();
+
+        // Allocate `n` contiguous pages, copying the single page at `ptr`
+        // (if non-null) into the first one and freeing it. Panics on failure.
         void* ReallocConsecutive(void* ptr, int n);
         void Free(void* ptr);
         void Free(void* ptr, int n);
 
         void GetStats(Montauk::MemStats* out);
+
+        // Recompute the pressure level from the free page count. The
+        // allocator does this on its slow paths (per-CPU cache refills
+        // and drains, multi-page blocks), not for every page.
+        void UpdatePressure();
     };
 
     extern PageFrameAllocator* g_pfa;
-};
\ No newline at end of file
+};
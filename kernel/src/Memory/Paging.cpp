@@ -2,13 +2,18 @@
 #include <Memory/PageFrameAllocator.hpp>
 #include <Common/Panic.hpp>
 #include <Memory/HHDM.hpp>
+#include <Libraries/Memory.hpp>
 #include <CppLib/Spinlock.hpp>
+#include "Pcid.hpp"
+#include "Tlb.hpp"
+#include "Zram.hpp"
 
 namespace Memory::VMM {
     Paging* g_paging = nullptr;
 
     // Protects user page table modifications from concurrent SMP access
-    static kcp::Mutex pagingLock;
+    static kcp::LockStat pagingLockStat{"paging"};
+    static kcp::Mutex pagingLock{&pagingLockStat};
 
     void LockUserPaging()   { pagingLock.Acquire(); }
     void UnlockUserPaging() { pagingLock.Release(); }
@@ -190,6 +195,25 @@ namespace Memory::VMM {
         return newPml4Phys;
     }
 
+    // Walk/create one level of user page tables, setting the User bit on
+    // the way. Returns nullptr on OOM or when the entry is a 2 MiB page.
+    static PageTable* WalkUserLevel(PageTable* table, uint64_t index) {
+        PageTableEntry* entry = (PageTableEntry*)Memory::HHDM(&table->entries[index]);
+        if (!entry->Present) {
+            void* newPage = Memory::g_pfa->AllocateZeroed();
+            if (newPage == nullptr) return nullptr;
+            uint64_t newPhys = Memory::SubHHDM((uint64_t)newPage);
+            entry->Present = true;
+            entry->Writable = true;
+            entry->Supervisor = 1;  // User-accessible
+            entry->Address = newPhys >> 12;
+            return (PageTable*)newPhys;
+        }
+        if (entry->LargerPages) return nullptr;  // Inside a 2 MiB page
+        entry->Supervisor = 1;
+        return (PageTable*)(entry->Address << 12);
+    }
+
     bool Paging::MapUserIn(std::uint64_t pml4Phys, std::uint64_t physicalAddress, std::uint64_t virtualAddress) {
         pagingLock.Acquire();
         if (virtualAddress % 0x1000 != 0 || physicalAddress % 0x1000 != 0) {
@@ -199,37 +223,21 @@ namespace Memory::VMM {
 
         VirtualAddress va(virtualAddress);
 
-        // Walk/create page tables from the given PML4, setting User bit at each level.
-        // Returns nullptr on OOM.
-        auto walkLevel = [](PageTable* table, uint64_t index) -> PageTable* {
-            PageTableEntry* entry = (PageTableEntry*)Memory::HHDM(&table->entries[index]);
-            if (!entry->Present) {
-                void* newPage = Memory::g_pfa->AllocateZeroed();
-                if (newPage == nullptr) return nullptr;
-                uint64_t newPhys = Memory::SubHHDM((uint64_t)newPage);
-                entry->Present = true;
-                entry->Writable = true;
-                entry->Supervisor = 1;  // User-accessible
-                entry->Address = newPhys >> 12;
-                return (PageTable*)newPhys;
-            } else {
-                entry->Supervisor = 1;
-                return (PageTable*)(entry->Address << 12);
-            }
-        };
 
         PageTable* pml4 = (PageTable*)pml4Phys;
-        auto pml3 = walkLevel(pml4, va.GetL4Index());
+        auto pml3 = WalkUserLevel(pml4, va.GetL4Index());
         if (!pml3) { pagingLock.Release(); return false; }
-        auto pml2 = walkLevel(pml3, va.GetL3Index());
+        auto pml2 = WalkUserLevel(pml3, va.GetL3Index());
         if (!pml2) { pagingLock.Release(); return false; }
-        auto pml1 = walkLevel(pml2, va.GetL2Index());
+        auto pml1 = WalkUserLevel(pml2, va.GetL2Index());
         if (!pml1) { pagingLock.Release(); return false; }
 
         PageTableEntry* pageEntry = (PageTableEntry*)Memory::HHDM(&pml1->entries[va.GetPageIndex()]);
+        if (pageEntry->Present) Pcid::Invalidate(pml4Phys);  // Replacing a live mapping
         pageEntry->Present = true;
         pageEntry->Writable = true;
         pageEntry->Supervisor = 1;
+        pageEntry->Available = 0;   // May have been a swap entry
         pageEntry->Address = physicalAddress >> 12;
         pagingLock.Release();
         return true;
@@ -244,32 +252,17 @@ namespace Memory::VMM {
 
         VirtualAddress va(virtualAddress);
 
-        auto walkLevel = [](PageTable* table, uint64_t index) -> PageTable* {
-            PageTableEntry* entry = (PageTableEntry*)Memory::HHDM(&table->entries[index]);
-            if (!entry->Present) {
-                void* newPage = Memory::g_pfa->AllocateZeroed();
-                if (newPage == nullptr) return nullptr;
-                uint64_t newPhys = Memory::SubHHDM((uint64_t)newPage);
-                entry->Present = true;
-                entry->Writable = true;
-                entry->Supervisor = 1;
-                entry->Address = newPhys >> 12;
-                return (PageTable*)newPhys;
-            } else {
-                entry->Supervisor = 1;
-                return (PageTable*)(entry->Address << 12);
-            }
-        };
 
         PageTable* pml4 = (PageTable*)pml4Phys;
-        auto pml3 = walkLevel(pml4, va.GetL4Index());
+        auto pml3 = WalkUserLevel(pml4, va.GetL4Index());
         if (!pml3) { pagingLock.Release(); return false; }
-        auto pml2 = walkLevel(pml3, va.GetL3Index());
+        auto pml2 = WalkUserLevel(pml3, va.GetL3Index());
         if (!pml2) { pagingLock.Release(); return false; }
-        auto pml1 = walkLevel(pml2, va.GetL2Index());
+        auto pml1 = WalkUserLevel(pml2, va.GetL2Index());
         if (!pml1) { pagingLock.Release(); return false; }
 
         PageTableEntry* pageEntry = (PageTableEntry*)Memory::HHDM(&pml1->entries[va.GetPageIndex()]);
+        if (pageEntry->Present) Pcid::Invalidate(pml4Phys);  // Replacing a live mapping
         pageEntry->Present = true;
         pageEntry->Writable = true;
         pageEntry->Supervisor = 1;
@@ -279,7 +272,134 @@ namespace Memory::VMM {
         return true;
     }
 
+    // Map a frame the mapping does not own, tagged with `available`
+    static bool MapUserOwnedElsewhere(std::uint64_t pml4Phys, std::uint64_t physicalAddress, std::uint64_t virtualAddress,
+                                      bool writable, std::uint64_t available) {
+        pagingLock.Acquire();
+        if (virtualAddress % 0x1000 != 0 || physicalAddress % 0x1000 != 0) {
+            pagingLock.Release();
+            Panic("Non-aligned address in Paging::MapUserOwnedElsewhere!", nullptr);
+        }
+
+        VirtualAddress va(virtualAddress);
+
+        PageTable* pml4 = (PageTable*)pml4Phys;
+        auto pml3 = WalkUserLevel(pml4, va.GetL4Index());
+        if (!pml3) { pagingLock.Release(); return false; }
+        auto pml2 = WalkUserLevel(pml3, va.GetL3Index());
+        if (!pml2) { pagingLock.Release(); return false; }
+        auto pml1 = WalkUserLevel(pml2, va.GetL2Index());
+        if (!pml1) { pagingLock.Release(); return false; }
+
+        PageTableEntry* pageEntry = (PageTableEntry*)Memory::HHDM(&pml1->entries[va.GetPageIndex()]);
+        if (pageEntry->Present) Pcid::Invalidate(pml4Phys);  // Replacing a live mapping
+        pageEntry->Present = true;
+        pageEntry->Writable = writable;
+        pageEntry->Supervisor = 1;
+        pageEntry->Available = available;
+        pageEntry->Address = physicalAddress >> 12;
+        pagingLock.Release();
+        return true;
+    }
+
+    bool Paging::MapUserInShared(std::uint64_t pml4Phys, std::uint64_t physicalAddress, std::uint64_t virtualAddress,
+                                 bool writable) {
+        return MapUserOwnedElsewhere(pml4Phys, physicalAddress, virtualAddress, writable, PteShared);
+    }
+
+    bool Paging::MapUserInCopyOnWrite(std::uint64_t pml4Phys, std::uint64_t physicalAddress, std::uint64_t virtualAddress) {
+        return MapUserOwnedElsewhere(pml4Phys, physicalAddress, virtualAddress, false, PteShared | PteCopyOnWrite);
+    }
+
+    bool Paging::BreakCopyOnWrite(std::uint64_t pml4Phys, std::uint64_t virtualAddress) {
+        pagingLock.Acquire();
+        VirtualAddress va(virtualAddress & ~0xFFFULL);
+
+        PageTable* table = (PageTable*)pml4Phys;
+        PageTableEntry* pageEntry = nullptr;
+        for (size_t level = 4; level >= 1; level--) {
+            PageTableEntry* entry = (PageTableEntry*)Memory::HHDM(&table->entries[va.GetIndex(level)]);
+            if (!entry->Present || !entry->Supervisor) { pagingLock.Release(); return false; }
+            if (level == 1) { pageEntry = entry; break; }
+            if (entry->LargerPages) {
+                bool writable = entry->Writable;
+                pagingLock.Release();
+                return writable;
+            }
+            table = (PageTable*)(entry->Address << 12);
+        }
+
+        // Another thread of the process may have taken the copy first
+        if (!(pageEntry->Available & PteCopyOnWrite)) {
+            bool writable = pageEntry->Writable;
+            pagingLock.Release();
+            return writable;
+        }
+
+        void* copy = Memory::g_pfa->Allocate();
+        if (copy == nullptr) { pagingLock.Release(); return false; }
+        memcpy(copy, (void*)Memory::HHDM((uint64_t)pageEntry->Address << 12), 0x1000);
+
+        pageEntry->Address = Memory::SubHHDM((uint64_t)copy) >> 12;
+        pageEntry->Available = 0;
+        pageEntry->Writable = true;
+
+        // Other CPUs running the process may still read the shared frame
+        pagingLock.Release();
+        Tlb::Batch batch(pml4Phys);
+        batch.Add(virtualAddress & ~0xFFFULL);
+        return true;
+    }
+
+    bool Paging::MapUserHugeIn(std::uint64_t pml4Phys, std::uint64_t physicalAddress, std::uint64_t virtualAddress,
+                               bool writeCombining) {
+        if (virtualAddress % HugePageSize != 0 || physicalAddress % HugePageSize != 0) {
+            Panic("Non-aligned address in Paging::MapUserHugeIn!", nullptr);
+        }
+
+        pagingLock.Acquire();
+        VirtualAddress va(virtualAddress);
+
+
+        PageTable* pml4 = (PageTable*)pml4Phys;
+        auto pml3 = WalkUserLevel(pml4, va.GetL4Index());
+        if (!pml3) { pagingLock.Release(); return false; }
+        auto pml2 = WalkUserLevel(pml3, va.GetL3Index());
+        if (!pml2) { pagingLock.Release(); return false; }
+
+        // Something (a page table or another huge page) already covers the range
+        PageTableEntry* pde = (PageTableEntry*)Memory::HHDM(&pml2->entries[va.GetL2Index()]);
+        if (pde->Present) { pagingLock.Release(); return false; }
+
+        pde->Writable = true;
+        pde->Supervisor = 1;
+        pde->LargerPages = 1;
+        pde->WriteThrough = writeCombining;   // PWT=1, PCD=0 -> PAT entry 1 = WC
+        pde->Address = physicalAddress >> 12;
+        pde->Present = true;
+        pagingLock.Release();
+        return true;
+    }
+
+    bool Paging::IsUserHugePage(std::uint64_t pml4Phys, std::uint64_t virtualAddress) {
+        VirtualAddress va(virtualAddress & ~(HugePageSize - 1));
+        PageTable* table = (PageTable*)pml4Phys;
+
+        for (size_t level = 4; level >= 2; level--) {
+            PageTableEntry* entry = (PageTableEntry*)Memory::HHDM(&table->entries[va.GetIndex(level)]);
+            if (!entry->Present) return false;
+            if (level == 2) return entry->LargerPages;
+            table = (PageTable*)(entry->Address << 12);
+        }
+        return false;
+    }
+
     void Paging::UnmapUserIn(std::uint64_t pml4Phys, std::uint64_t virtualAddress) {
+        Tlb::Batch batch(pml4Phys);
+        UnmapUserIn(pml4Phys, virtualAddress, batch);
+    }
+
+    void Paging::UnmapUserIn(std::uint64_t pml4Phys, std::uint64_t virtualAddress, Tlb::Batch& batch) {
         pagingLock.Acquire();
         VirtualAddress va(virtualAddress);
 
@@ -295,6 +415,16 @@ namespace Memory::VMM {
         if (!pml3) { pagingLock.Release(); return; }
         auto pml2 = walkRead(pml3, va.GetL3Index());
         if (!pml2) { pagingLock.Release(); return; }
+
+        // A 2 MiB page goes away as a whole
+        PageTableEntry* pde = (PageTableEntry*)Memory::HHDM(&pml2->entries[va.GetL2Index()]);
+        if (pde->Present && pde->LargerPages) {
+            *(uint64_t*)pde = 0;
+            pagingLock.Release();
+            batch.Add(virtualAddress & ~(HugePageSize - 1));
+            return;
+        }
+
         auto pml1 = walkRead(pml2, va.GetL2Index());
         if (!pml1) { pagingLock.Release(); return; }
 
@@ -304,9 +434,89 @@ namespace Memory::VMM {
         // Clear the entire 8-byte PTE
         *(uint64_t*)pageEntry = 0;
 
-        // Invalidate TLB for this virtual address
-        asm volatile("invlpg (%0)" :: "r"(virtualAddress) : "memory");
+        // The batch invalidates the TLB entry on every CPU running this
+        // address space (outside pagingLock, the targets may want it)
+        pagingLock.Release();
+        batch.Add(virtualAddress);
+    }
+
+    // The PTE for a 4 KiB user page, or nullptr if a level above it is
+    // absent or it lies in a 2 MiB page. pagingLock must be held.
+    static PageTableEntry* FindUserPte(std::uint64_t pml4Phys, std::uint64_t virtualAddress) {
+        VirtualAddress va(virtualAddress & ~0xFFFULL);
+        PageTable* table = (PageTable*)pml4Phys;
+        for (size_t level = 4; level >= 2; level--) {
+            PageTableEntry* entry = (PageTableEntry*)Memory::HHDM(&table->entries[va.GetIndex(level)]);
+            if (!entry->Present || entry->LargerPages) return nullptr;
+            table = (PageTable*)(entry->Address << 12);
+        }
+        return (PageTableEntry*)Memory::HHDM(&table->entries[va.GetPageIndex()]);
+    }
+
+    static bool IsSwapEntry(const PageTableEntry* pte) {
+        return pte != nullptr && !pte->Present && (pte->Available & Paging::PteSwapped);
+    }
+
+    std::uint64_t Paging::TakeUserPageForSwap(std::uint64_t pml4Phys, std::uint64_t virtualAddress,
+                                              Tlb::Batch& batch) {
+        // Reached from the allocator's reclaim, possibly by a thread that
+        // holds the lock already
+        if (!pagingLock.TryAcquire()) return 0;
+        PageTableEntry* pte = FindUserPte(pml4Phys, virtualAddress);
+        if (pte == nullptr || !pte->Present || !pte->Supervisor || pte->Available
+            || pte->WriteThrough || pte->CacheDisabled) {
+            pagingLock.Release();
+            return 0;
+        }
+        if (pte->Accessed) {
+            pte->Accessed = 0;
+            pagingLock.Release();
+            return 0;
+        }
+
+        uint64_t phys = (uint64_t)pte->Address << 12;
+        pte->Present = 0;
+        pte->Available = PteSwapped;
+        pagingLock.Release();
+        batch.Add(virtualAddress & ~0xFFFULL);
+        return phys;
+    }
+
+    void Paging::SetUserSwapSlot(std::uint64_t pml4Phys, std::uint64_t virtualAddress, std::uint64_t slot) {
+        pagingLock.Acquire();
+        PageTableEntry* pte = FindUserPte(pml4Phys, virtualAddress);
+        if (IsSwapEntry(pte)) pte->Address = slot;
+        pagingLock.Release();
+    }
+
+    void Paging::RestoreUserPage(std::uint64_t pml4Phys, std::uint64_t virtualAddress) {
+        pagingLock.Acquire();
+        PageTableEntry* pte = FindUserPte(pml4Phys, virtualAddress);
+        if (IsSwapEntry(pte)) {
+            pte->Available = 0;
+            pte->Present = 1;
+        }
+        pagingLock.Release();
+    }
+
+    std::uint64_t Paging::GetUserSwapSlot(std::uint64_t pml4Phys, std::uint64_t virtualAddress) {
+        pagingLock.Acquire();
+        PageTableEntry* pte = FindUserPte(pml4Phys, virtualAddress);
+        uint64_t slot = IsSwapEntry(pte) ? pte->Address : 0;
+        pagingLock.Release();
+        return slot;
+    }
+
+    std::uint64_t Paging::DropUserSwapEntry(std::uint64_t pml4Phys, std::uint64_t virtualAddress) {
+        pagingLock.Acquire();
+        PageTableEntry* pte = FindUserPte(pml4Phys, virtualAddress);
+        uint64_t slot = 0;
+        if (IsSwapEntry(pte)) {
+            slot = pte->Address;
+            *(uint64_t*)pte = 0;
+        }
         pagingLock.Release();
+        return slot;
     }
 
     void Paging::FreeUserHalf(std::uint64_t pml4Phys) {
@@ -314,6 +524,9 @@ namespace Memory::VMM {
         // Each individual entry access goes through HHDM() to get a valid virtual pointer.
         PageTable* pml4 = (PageTable*)pml4Phys;
 
+        // The PML4 (and its PCID tag) may be reused for another process
+        Pcid::Invalidate(pml4Phys);
+
         // Walk user-half entries (0-255); kernel-half (256-511) is shared and must not be touched.
         for (int i4 = 0; i4 < 256; i4++) {
             PageTableEntry* pml4e = (PageTableEntry*)Memory::HHDM(&pml4->entries[i4]);
@@ -334,15 +547,30 @@ namespace Memory::VMM {
                     if (!pde->Present) continue;
 
                     uint64_t ptPhys = (uint64_t)pde->Address << 12;
+
+                    // 2 MiB page: no PT below it, free the 512 frames at once
+                    if (pde->LargerPages) {
+                        if (!pde->WriteThrough && !pde->CacheDisabled) {
+                            Memory::g_pfa->Free((void*)Memory::HHDM(ptPhys), (int)(HugePageSize / 0x1000));
+                        }
+                        continue;
+                    }
+
                     PageTable* pt = (PageTable*)ptPhys;
 
                     // Free all leaf physical pages
                     for (int i1 = 0; i1 < 512; i1++) {
                         PageTableEntry* pte = (PageTableEntry*)Memory::HHDM(&pt->entries[i1]);
+                        if (IsSwapEntry(pte)) {
+                            Zram::Release(pte->Address);
+                            continue;
+                        }
                         if (!pte->Present) continue;
 
-                        // Skip MMIO/WC pages (not PFA-managed)
+                        // Skip MMIO/WC pages (not PFA-managed) and frames
+                        // owned by a shared memory object
                         if (pte->WriteThrough || pte->CacheDisabled) continue;
+                        if (pte->Available & PteShared) continue;
 
                         uint64_t pagePhys = (uint64_t)pte->Address << 12;
                         if (pagePhys != 0) {
@@ -408,6 +636,51 @@ namespace Memory::VMM {
         return GetPhysAddr((std::uint64_t)PML4, virtualAddress, false);
     }
 
+    std::uint64_t Paging::GetUserPhysAddr(std::uint64_t pml4Phys, std::uint64_t virtualAddress) {
+        VirtualAddress va(virtualAddress);
+        PageTable* table = (PageTable*)HHDM(pml4Phys);
+
+        for (size_t level = 4; level >= 1; level--) {
+            PageTableEntry* entry = &table->entries[va.GetIndex(level)];
+            if (!entry->Present || !entry->Supervisor) return 0;
+
+            uint64_t phys = (uint64_t)(entry->Address & kPhysAddrMask) << 12;
+            if (level == 1) return phys | (virtualAddress & 0xFFF);
+            if (entry->LargerPages && level == 3) return (phys & ~0x3FFFFFFFULL) | (virtualAddress & 0x3FFFFFFFULL);
+            if (entry->LargerPages && level == 2) return (phys & ~0x1FFFFFULL) | (virtualAddress & 0x1FFFFFULL);
+
+            table = (PageTable*)HHDM(phys);
+        }
+        return 0;
+    }
+
+    std::uint64_t Paging::GetUserDmaAddr(std::uint64_t pml4Phys, std::uint64_t virtualAddress, bool deviceWrites) {
+        VirtualAddress va(virtualAddress);
+        PageTable* table = (PageTable*)HHDM(pml4Phys);
+
+        for (size_t level = 4; level >= 1; level--) {
+            PageTableEntry* entry = &table->entries[va.GetIndex(level)];
+            if (!entry->Present || !entry->Supervisor) return 0;
+            if (deviceWrites && !entry->Writable) return 0;
+
+            uint64_t phys = (uint64_t)(entry->Address & kPhysAddrMask) << 12;
+            bool leaf = level == 1 || (entry->LargerPages && level <= 3);
+            if (leaf) {
+                if (entry->WriteThrough || entry->CacheDisabled) return 0;
+                if (deviceWrites && (entry->Available & PteCopyOnWrite)) return 0;
+                uint64_t offsetMask = level == 1 ? 0xFFFULL : level == 2 ? 0x1FFFFFULL : 0x3FFFFFFFULL;
+                return (phys & ~offsetMask) | (virtualAddress & offsetMask);
+            }
+
+            table = (PageTable*)HHDM(phys);
+        }
+        return 0;
+    }
+
+    void FlushTLB() {
+        Pcid::FlushAll();
+    }
+
     void Paging::MapEfiRuntime(limine_efi_memmap_response* efiMemmap) {
         if (!efiMemmap) return;
 
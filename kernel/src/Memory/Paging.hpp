@@ -4,6 +4,8 @@
 #include <Terminal/Terminal.hpp>
 
 namespace Memory::VMM {
+    namespace Tlb { class Batch; }
+
     struct PageTableEntry {
         std::uint8_t Present : 1;
         std::uint8_t Writable : 1;
@@ -88,6 +90,11 @@ namespace Memory::VMM {
         PageTable* HandleLevel(VirtualAddress virtualAddress, PageTable* table, size_t level);
         PageTable* HandleLevelUser(VirtualAddress virtualAddress, PageTable* table, size_t level);
 public:
+        static constexpr std::uint64_t HugePageSize = 0x200000;  // 2 MiB PDE mapping
+        static constexpr std::uint64_t PteShared = 1;            // Available bits: frame not owned by the mapping
+        static constexpr std::uint64_t PteCopyOnWrite = 2;       // Available bits: private copy taken on first write
+        static constexpr std::uint64_t PteSwapped = 4;           // Available bits: not present, Address holds a Zram slot
+
         PageTable* PML4{};
 
         Paging();
@@ -99,6 +106,15 @@ public:
         static std::uint64_t GetPhysAddr(std::uint64_t PML4, std::uint64_t virtualAddress, bool use40BitL1 = false);
         std::uint64_t GetPhysAddr(std::uint64_t virtualAddress);
 
+        // Physical address backing a user virtual address, checking that
+        // every level is present and user-accessible. Returns 0 if not.
+        static std::uint64_t GetUserPhysAddr(std::uint64_t pml4Phys, std::uint64_t virtualAddress);
+
+        // The same for a page a device may access: ordinary memory (not
+        // MMIO or write-combined), and with `deviceWrites` writable and
+        // not copy-on-write. Returns 0 otherwise.
+        static std::uint64_t GetUserDmaAddr(std::uint64_t pml4Phys, std::uint64_t virtualAddress, bool deviceWrites);
+
         // Create a new PML4 with kernel-half (entries 256-511) copied from g_paging.
         // Returns the physical address of the new PML4.
         static std::uint64_t CreateUserPML4();
@@ -109,12 +125,71 @@ public:
         // Map a page into an arbitrary PML4 with User + Write-Combining attributes.
         static bool MapUserInWC(std::uint64_t pml4Phys, std::uint64_t physicalAddress, std::uint64_t virtualAddress);
 
+        // Map a frame owned by a shared memory object (see MemObject.hpp) with
+        // User set and read-only unless `writable`. The PTE is tagged so
+        // FreeUserHalf() leaves the frame to its owner.
+        static bool MapUserInShared(std::uint64_t pml4Phys, std::uint64_t physicalAddress, std::uint64_t virtualAddress,
+                                    bool writable);
+
+        // Map a shared frame read-only for copy-on-write: the first write
+        // faults and BreakCopyOnWrite() gives the process its own copy.
+        static bool MapUserInCopyOnWrite(std::uint64_t pml4Phys, std::uint64_t physicalAddress, std::uint64_t virtualAddress);
+
+        // Replace the copy-on-write page at `virtualAddress` with a private
+        // writable copy. Returns true if the page is writable afterwards
+        // (also when another thread already took the copy), false if it is
+        // not mapped, genuinely read-only, or on OOM.
+        static bool BreakCopyOnWrite(std::uint64_t pml4Phys, std::uint64_t virtualAddress);
+
+        // Map a 2 MiB page (both addresses 2 MiB aligned) with User set, and
+        // Write-Combining if asked. Fails if anything is already mapped in
+        // the range or on OOM; callers fall back to 4 KiB pages.
+        static bool MapUserHugeIn(std::uint64_t pml4Phys, std::uint64_t physicalAddress, std::uint64_t virtualAddress,
+                                  bool writeCombining = false);
+
+        // Whether the 2 MiB range containing `virtualAddress` is one huge page
+        static bool IsUserHugePage(std::uint64_t pml4Phys, std::uint64_t virtualAddress);
+
         // Unmap a single page from an arbitrary PML4 (clears PTE + invalidates TLB).
+        // If the address lies in a 2 MiB page, the whole huge page is unmapped.
+        // Returns after every CPU has dropped the entry.
         static void UnmapUserIn(std::uint64_t pml4Phys, std::uint64_t virtualAddress);
 
+        // Same, but the invalidation is queued on `batch` (see Tlb.hpp): the
+        // backing frame must not be freed before the batch is flushed.
+        static void UnmapUserIn(std::uint64_t pml4Phys, std::uint64_t virtualAddress, Tlb::Batch& batch);
+
+        // Swap entries (see Zram.hpp). A private 4 KiB page moved out of
+        // memory leaves a not-present PTE tagged PteSwapped, whose address
+        // field holds the slot its contents went to.
+        //
+        // Start swapping out the page at `virtualAddress`: if it is a
+        // private, present 4 KiB page not accessed since the last call,
+        // turn its PTE into a swap entry with no slot yet and return the
+        // frame's physical address. The frame may only be read once
+        // `batch` has been flushed. A page that was accessed has the bit
+        // cleared instead (without invalidating TLBs, so it is only an
+        // approximation of recent use) and 0 is returned, as for any page
+        // that cannot be swapped or when the page tables are busy.
+        static std::uint64_t TakeUserPageForSwap(std::uint64_t pml4Phys, std::uint64_t virtualAddress,
+                                                 Tlb::Batch& batch);
+
+        // Finish a TakeUserPageForSwap(): record the slot, or map the frame
+        // back as it was if the page could not be stored
+        static void SetUserSwapSlot(std::uint64_t pml4Phys, std::uint64_t virtualAddress, std::uint64_t slot);
+        static void RestoreUserPage(std::uint64_t pml4Phys, std::uint64_t virtualAddress);
+
+        // Slot of the swap entry at `virtualAddress`, or 0 if there is none
+        static std::uint64_t GetUserSwapSlot(std::uint64_t pml4Phys, std::uint64_t virtualAddress);
+
+        // Clear the swap entry at `virtualAddress`; returns its slot, or 0
+        // if there is none. The caller releases the slot.
+        static std::uint64_t DropUserSwapEntry(std::uint64_t pml4Phys, std::uint64_t virtualAddress);
+
         // Free all user-half page table structures and physical pages (PML4 entries 0-255).
         // Does NOT free the PML4 page itself (caller handles that).
-        // Skips MMIO/WC pages (WriteThrough or CacheDisabled set in PTE).
+        // Skips MMIO/WC pages (WriteThrough or CacheDisabled set in PTE) and
+        // shared-object frames (PteShared). Swap entries release their slot.
         static void FreeUserHalf(std::uint64_t pml4Phys);
 
         // Identity-map EFI runtime service regions so firmware code can
@@ -134,7 +209,6 @@ public:
     extern "C" uint64_t GetCR3();
     extern "C" void LoadCR3(PageTable* PML4);
 
-    inline void FlushTLB() {
-        asm volatile("mov %%cr3, %%rax; mov %%rax, %%cr3" ::: "rax", "memory");
-    }
+    // Flush all non-global TLB entries on this CPU, for every PCID
+    void FlushTLB();
 };
@@ -0,0 +1,143 @@
+/*
+    * Pcid.cpp
+    * Process-context identifiers: TLB entries tagged per address space
+    * Copyright (c) 2026 Daniel Hammer
+*/
+
+#include "Pcid.hpp"
+#include <Hal/SmpBoot.hpp>
+#include <CppLib/Spinlock.hpp>
+#include <Terminal/Terminal.hpp>
+
+namespace Memory::VMM::Pcid {
+    static constexpr uint64_t NoFlush = 1ULL << 63;     // CR3 bit 63: keep the tag's TLB entries
+    static constexpr uint64_t Cr4Pcide = 1ULL << 17;
+    static constexpr int GenerationBuckets = 1024;
+
+    // What a CPU last loaded under each tag. The generation is that of the
+    // PML4's bucket at the time, so any later Invalidate() makes it stale.
+    struct Loaded {
+        uint32_t pml4Page;
+        uint32_t generation;
+    };
+
+    static bool g_enabled = false;
+    static bool g_invpcid = false;
+
+    // Bumped by Invalidate(), read atomically. PML4s sharing a bucket only
+    // cost each other an extra flush.
+    static uint32_t g_generation[GenerationBuckets];
+    static Loaded g_loaded[Smp::MaxCPUs][MaxPcids];
+
+    // Address spaces holding each tag, and where Allocate() looks next
+    static kcp::Spinlock g_tagLock;
+    static uint16_t g_tagUsers[MaxPcids];
+    static int g_nextTag = 1;
+
+    static inline uint32_t& Bucket(uint64_t pml4Phys) {
+        return g_generation[(pml4Phys >> 12) % GenerationBuckets];
+    }
+
+    static inline void Cpuid(uint32_t leaf, uint32_t sub, uint32_t& a, uint32_t& b,
+                             uint32_t& c, uint32_t& d) {
+        asm volatile("cpuid" : "=a"(a), "=b"(b), "=c"(c), "=d"(d) : "a"(leaf), "c"(sub));
+    }
+
+    static void EnablePcide() {
+        uint64_t cr4;
+        asm volatile("mov %%cr4, %0" : "=r"(cr4));
+        asm volatile("mov %0, %%cr4" :: "r"(cr4 | Cr4Pcide) : "memory");
+    }
+
+    void Initialize() {
+        uint32_t a, b, c, d;
+        Cpuid(0, 0, a, b, c, d);
+        uint32_t maxLeaf = a;
+
+        Cpuid(1, 0, a, b, c, d);
+        bool hasPcid = (c & (1u << 17)) != 0;
+
+        if (maxLeaf >= 7) {
+            Cpuid(7, 0, a, b, c, d);
+            g_invpcid = (b & (1u << 10)) != 0;
+        }
+
+        if (!hasPcid) {
+            Kt::KernelLogStream(Kt::INFO, "PCID") << "Not supported, CR3 loads flush the TLB";
+            return;
+        }
+
+        EnablePcide();
+        g_enabled = true;
+
+        Kt::KernelLogStream(Kt::OK, "PCID") << "Enabled"
+            << (g_invpcid ? " (INVPCID available)" : "");
+    }
+
+    void InitializeAP() {
+        if (g_enabled) EnablePcide();
+    }
+
+    bool Enabled() {
+        return g_enabled;
+    }
+
+    uint64_t MakeCR3(int cpuIndex, uint64_t pml4Phys, uint16_t pcid) {
+        if (!g_enabled || pcid >= MaxPcids) return pml4Phys;
+
+        uint32_t page = (uint32_t)(pml4Phys >> 12);
+        uint32_t generation = __atomic_load_n(&Bucket(pml4Phys), __ATOMIC_ACQUIRE);
+
+        Loaded& loaded = g_loaded[cpuIndex][pcid];
+        bool warm = loaded.pml4Page == page && loaded.generation == generation;
+        loaded.pml4Page = page;
+        loaded.generation = generation;
+
+        return pml4Phys | pcid | (warm ? NoFlush : 0);
+    }
+
+    uint16_t Allocate() {
+        g_tagLock.Acquire();
+        int best = g_nextTag;
+        for (int i = 0; i < MaxPcids - 1 && g_tagUsers[best] != 0; i++) {
+            int tag = 1 + (g_nextTag - 1 + i) % (MaxPcids - 1);
+            if (g_tagUsers[tag] < g_tagUsers[best]) best = tag;
+        }
+        g_tagUsers[best]++;
+        g_nextTag = best % (MaxPcids - 1) + 1;
+        g_tagLock.Release();
+        return (uint16_t)best;
+    }
+
+    void Free(uint16_t pcid) {
+        if (pcid == 0 || pcid >= MaxPcids) return;
+        g_tagLock.Acquire();
+        if (g_tagUsers[pcid] > 0) g_tagUsers[pcid]--;
+        g_tagLock.Release();
+    }
+
+    void Invalidate(uint64_t pml4Phys) {
+        if (!g_enabled) return;
+        __atomic_fetch_add(&Bucket(pml4Phys), 1, __ATOMIC_RELEASE);
+    }
+
+    void FlushAll() {
+        if (g_invpcid) {
+            // Type 2: all PCIDs, all addresses, except global entries
+            struct { uint64_t pcid; uint64_t address; } descriptor = { 0, 0 };
+            asm volatile("invpcid %0, %1" :: "m"(descriptor), "r"(2ULL) : "memory");
+            return;
+        }
+
+        if (g_enabled) {
+            // Toggling CR4.PGE flushes every PCID (globals included)
+            uint64_t cr4;
+            asm volatile("mov %%cr4, %0" : "=r"(cr4));
+            asm volatile("mov %0, %%cr4" :: "r"(cr4 ^ (1ULL << 7)) : "memory");
+            asm volatile("mov %0, %%cr4" :: "r"(cr4) : "memory");
+            return;
+        }
+
+        asm volatile("mov %%cr3, %%rax; mov %%rax, %%cr3" ::: "rax", "memory");
+    }
+};
@@ -0,0 +1,44 @@
+/*
+    * Pcid.hpp
+    * Process-context identifiers: TLB entries tagged per address space
+    * Copyright (c) 2026 Daniel Hammer
+*/
+
+#pragma once
+#include <cstdint>
+
+namespace Memory::VMM::Pcid {
+    // Tags below this are tracked. PCID 0 belongs to the kernel PML4; the
+    // rest are handed to processes by Allocate().
+    constexpr int MaxPcids = 512;
+
+    // Detect PCID/INVPCID and set CR4.PCIDE on the BSP. CR3 must hold the
+    // kernel PML4 (PCID 0). Without PCID support everything below is a
+    // no-op and CR3 loads flush as before.
+    void Initialize();
+
+    // Enable PCIDs on the calling CPU (APs; CR3 must have PCID 0)
+    void InitializeAP();
+
+    bool Enabled();
+
+    // CR3 value that switches CPU `cpuIndex` to `pml4Phys` tagged `pcid`.
+    // The no-flush bit is set when the entries this CPU cached under the
+    // tag are still valid for that PML4, so they survive the switch.
+    uint64_t MakeCR3(int cpuIndex, uint64_t pml4Phys, uint16_t pcid);
+
+    // Tag for a new address space: an unused one, or the least shared one
+    // once every tag is in use. Sharing is safe, since MakeCR3 flushes a
+    // tag whenever it changes hands; it only costs TLB warmth.
+    uint16_t Allocate();
+
+    // The address space given `pcid` by Allocate() is gone
+    void Free(uint16_t pcid);
+
+    // A mapping of `pml4Phys` was removed or changed. Every CPU drops the
+    // entries it cached for it the next time it loads that address space.
+    void Invalidate(uint64_t pml4Phys);
+
+    // Flush non-global TLB entries of every PCID on this CPU
+    void FlushAll();
+};
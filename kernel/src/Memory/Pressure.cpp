@@ -0,0 +1,109 @@
+/*
+    * Pressure.cpp
+    * Memory pressure levels and the shrinker registry for kernel caches
+    * Copyright (c) 2026 Daniel Hammer
+*/
+
+#include "Pressure.hpp"
+#include "PageFrameAllocator.hpp"
+#include <Sched/Scheduler.hpp>
+#include <Terminal/Terminal.hpp>
+#include <CppLib/Spinlock.hpp>
+
+using namespace Kt;
+
+namespace Memory::Pressure {
+
+    // Levels are entered below 1/8, 1/16 and 1/32 of memory free, and left
+    // once another 1/64 is free
+    static constexpr uint64_t LowShare = 8;
+    static constexpr uint64_t MediumShare = 16;
+    static constexpr uint64_t CriticalShare = 32;
+    static constexpr uint64_t MarginShare = 64;
+
+    // Pages asked of the shrinkers per Balance() call
+    static constexpr uint64_t BalanceBatch = 64;
+
+    struct Shrinker {
+        const char* name;
+        ShrinkFn fn;
+    };
+
+    static Shrinker g_shrinkers[MaxShrinkers];
+    static int g_shrinkerCount = 0;
+    static kcp::Spinlock g_registryLock;
+
+    static volatile uint32_t g_level = Montauk::MEM_PRESSURE_NONE;
+    static volatile uint32_t g_events = 0;
+    static kcp::Spinlock g_updateLock;
+    static volatile bool g_reclaiming = false;
+
+    static uint32_t LevelFor(uint64_t freePages, uint64_t totalPages) {
+        if (freePages < totalPages / CriticalShare) return Montauk::MEM_PRESSURE_CRITICAL;
+        if (freePages < totalPages / MediumShare) return Montauk::MEM_PRESSURE_MEDIUM;
+        if (freePages < totalPages / LowShare) return Montauk::MEM_PRESSURE_LOW;
+        return Montauk::MEM_PRESSURE_NONE;
+    }
+
+    void RegisterShrinker(const char* name, ShrinkFn fn) {
+        g_registryLock.Acquire();
+        if (g_shrinkerCount < MaxShrinkers) {
+            g_shrinkers[g_shrinkerCount] = { name, fn };
+            __atomic_store_n(&g_shrinkerCount, g_shrinkerCount + 1, __ATOMIC_RELEASE);
+        }
+        g_registryLock.Release();
+
+        KernelLogStream(DEBUG, "Pressure") << "Shrinker registered: " << name;
+    }
+
+    uint32_t Level() {
+        return g_level;
+    }
+
+    uint32_t EventCount() {
+        return g_events;
+    }
+
+    void Update(uint64_t freePages, uint64_t totalPages) {
+        // Whoever is updating already will get there
+        if (!g_updateLock.TryAcquire()) return;
+
+        uint32_t level = g_level;
+        uint32_t raised = LevelFor(freePages, totalPages);
+        uint64_t margin = totalPages / MarginShare;
+        uint32_t lowered = LevelFor(freePages > margin ? freePages - margin : 0, totalPages);
+
+        uint32_t next = level;
+        if (raised > level) next = raised;
+        else if (lowered < level) next = lowered;
+
+        if (next != level) {
+            g_level = next;
+            __atomic_add_fetch(&g_events, 1, __ATOMIC_RELEASE);
+        }
+        g_updateLock.Release();
+
+        if (next != level) Sched::NotifyReady(Montauk::POLL_SRC_MEMORY);
+    }
+
+    uint64_t Reclaim(uint64_t pages) {
+        if (__atomic_exchange_n(&g_reclaiming, true, __ATOMIC_ACQUIRE)) return 0;
+
+        uint64_t freed = 0;
+        int count = __atomic_load_n(&g_shrinkerCount, __ATOMIC_ACQUIRE);
+        for (int i = 0; i < count && freed < pages; i++) {
+            freed += g_shrinkers[i].fn(pages - freed);
+        }
+
+        __atomic_store_n(&g_reclaiming, false, __ATOMIC_RELEASE);
+        return freed;
+    }
+
+    bool Balance() {
+        if (g_level < Montauk::MEM_PRESSURE_MEDIUM) return false;
+        uint64_t freed = Reclaim(BalanceBatch);
+        g_pfa->UpdatePressure();
+        return freed > 0;
+    }
+
+};
@@ -0,0 +1,45 @@
+/*
+    * Pressure.hpp
+    * Memory pressure levels and the shrinker registry for kernel caches
+    * Copyright (c) 2026 Daniel Hammer
+*/
+
+#pragma once
+#include <cstdint>
+#include <Api/Syscall.hpp>
+
+namespace Memory::Pressure {
+
+    // The level (Montauk::MEM_PRESSURE_*) follows the share of physical
+    // pages that are free, and only drops back once a margin above the
+    // threshold is free again, so it does not flap. Each change bumps
+    // EventCount() and wakes epoll waiters on POLL_SRC_MEMORY.
+    //
+    // Caches that can be rebuilt register a shrinker. Shrinkers run from
+    // the idle loops while the level is MEDIUM or worse, and at once when
+    // a page allocation finds nothing free, in the order they were
+    // registered. That can be with any lock held, so a shrinker never
+    // blocks: it try-locks its cache and frees nothing if it is busy.
+
+    static constexpr int MaxShrinkers = 16;
+
+    // Free up to `pages` pages; returns how many it freed
+    typedef uint64_t (*ShrinkFn)(uint64_t pages);
+
+    void RegisterShrinker(const char* name, ShrinkFn fn);
+
+    uint32_t Level();
+    uint32_t EventCount();
+
+    // Recompute the level from the allocator's counts
+    void Update(uint64_t freePages, uint64_t totalPages);
+
+    // Run the shrinkers until `pages` are freed or none has more to
+    // give. Returns the pages freed (0 if a reclaim is already running).
+    uint64_t Reclaim(uint64_t pages);
+
+    // For the idle loops: shrink the caches a batch at a time while the
+    // level is MEDIUM or worse. Returns true if anything was freed.
+    bool Balance();
+
+};
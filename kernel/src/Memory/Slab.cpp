@@ -0,0 +1,224 @@
+/*
+    * Slab.cpp
+    * Slab allocator for small and fixed-size kernel objects
+    * Copyright (c) 2026 Daniel Hammer
+*/
+
+#include "Slab.hpp"
+#include "PageFrameAllocator.hpp"
+#include <Terminal/Terminal.hpp>
+#include <CppLib/Stream.hpp>
+
+namespace Memory {
+    static constexpr size_t SlabHeaderSize = 48;  // sizeof(Slab) rounded up to 16
+
+    static inline uint64_t SaveAndDisableInterrupts() {
+        uint64_t flags;
+        asm volatile("pushfq; pop %0; cli" : "=r"(flags) :: "memory");
+        return flags;
+    }
+
+    static inline void RestoreInterrupts(uint64_t flags) {
+        asm volatile("push %0; popfq" :: "r"(flags) : "memory");
+    }
+
+    SlabCache::Slab* SlabCache::SlabOf(void* object) {
+        return (Slab*)((uint64_t)object & ~0xFFFULL);
+    }
+
+    SlabCache* SlabCache::CacheOf(void* object) {
+        if (object == nullptr || !g_pfa->IsSlabPage(object)) return nullptr;
+        return SlabOf(object)->cache;
+    }
+
+    void SlabCache::Unlink(Slab*& list, Slab* slab) {
+        if (slab->prev) slab->prev->next = slab->next;
+        else list = slab->next;
+        if (slab->next) slab->next->prev = slab->prev;
+        slab->next = slab->prev = nullptr;
+    }
+
+    void SlabCache::Push(Slab*& list, Slab* slab) {
+        slab->prev = nullptr;
+        slab->next = list;
+        if (list) list->prev = slab;
+        list = slab;
+    }
+
+    // Carve a fresh page into objects. Lock must be held.
+    SlabCache::Slab* SlabCache::Grow() {
+        static_assert(sizeof(Slab) <= SlabHeaderSize);
+        void* page = g_pfa->Allocate();
+        if (page == nullptr) return nullptr;
+        g_pfa->SetSlabPage(page, true);
+
+        Slab* slab = (Slab*)page;
+        slab->cache = this;
+        slab->next = slab->prev = nullptr;
+        slab->inUse = 0;
+        slab->capacity = (uint32_t)((0x1000 - SlabHeaderSize) / objectSize);
+        slab->freeList = nullptr;
+
+        // Link back to front so objects are handed out in address order
+        uint8_t* base = (uint8_t*)page + SlabHeaderSize;
+        for (uint32_t i = slab->capacity; i > 0; i--) {
+            void* object = base + (size_t)(i - 1) * objectSize;
+            *(void**)object = slab->freeList;
+            slab->freeList = object;
+        }
+
+        slabCount++;
+        return slab;
+    }
+
+    // Take one object from the slab lists. Lock must be held.
+    void* SlabCache::TakeLocked() {
+        Slab* slab = partial;
+        if (slab == nullptr) {
+            slab = empty;
+            if (slab) empty = nullptr;
+            else slab = Grow();
+            if (slab == nullptr) return nullptr;
+            Push(partial, slab);
+        }
+
+        void* object = slab->freeList;
+        slab->freeList = *(void**)object;
+        slab->inUse++;
+
+        if (slab->freeList == nullptr) {
+            Unlink(partial, slab);
+            Push(full, slab);
+        }
+        return object;
+    }
+
+    // Return one object to its slab. Lock must be held.
+    void SlabCache::PutLocked(void* object) {
+        Slab* slab = SlabOf(object);
+        bool wasFull = slab->freeList == nullptr;
+
+        *(void**)object = slab->freeList;
+        slab->freeList = object;
+        slab->inUse--;
+
+        if (wasFull) {
+            Unlink(full, slab);
+            Push(partial, slab);
+        }
+
+        if (slab->inUse == 0) {
+            Unlink(partial, slab);
+            if (empty == nullptr) {
+                empty = slab;
+            } else {
+                // Keep one empty slab around; give the rest back
+                slabCount--;
+                g_pfa->SetSlabPage(slab, false);
+                g_pfa->Free(slab);
+            }
+        }
+    }
+
+    void* SlabCache::Allocate() {
+        if (g_pfa->CpuCachesEnabled()) {
+            uint64_t flags = SaveAndDisableInterrupts();
+            Magazine& mag = magazines[Smp::GetCurrentCpuData()->cpuIndex];
+
+            if (mag.count == 0) {
+                Lock.Acquire();
+                while (mag.count < MagazineSize / 2) {
+                    void* object = TakeLocked();
+                    if (object == nullptr) break;
+                    mag.objects[mag.count++] = object;
+                }
+                objectsInUse += mag.count;
+                Lock.Release();
+            }
+
+            void* object = mag.count > 0 ? mag.objects[--mag.count] : nullptr;
+            RestoreInterrupts(flags);
+            return object;
+        }
+
+        Lock.Acquire();
+        void* object = TakeLocked();
+        if (object) objectsInUse++;
+        Lock.Release();
+        return object;
+    }
+
+    void SlabCache::Free(void* object) {
+        if (object == nullptr) return;
+
+        if (g_pfa->CpuCachesEnabled()) {
+            uint64_t flags = SaveAndDisableInterrupts();
+            Magazine& mag = magazines[Smp::GetCurrentCpuData()->cpuIndex];
+
+            if (mag.count == MagazineSize) {
+                Lock.Acquire();
+                while (mag.count > MagazineSize / 2) {
+                    PutLocked(mag.objects[--mag.count]);
+                    objectsInUse--;
+                }
+                Lock.Release();
+            }
+
+            mag.objects[mag.count++] = object;
+            RestoreInterrupts(flags);
+            return;
+        }
+
+        Lock.Acquire();
+        PutLocked(object);
+        objectsInUse--;
+        Lock.Release();
+    }
+
+    void SlabCache::Dump() {
+        Lock.Acquire();
+        size_t slabs = slabCount;
+        size_t inUse = objectsInUse;
+        Lock.Release();
+
+        Kt::KernelLogStream(Kt::DEBUG, "Slab") << name << ": " << base::dec
+            << (uint64_t)objectSize << " byte objects, " << (uint64_t)inUse
+            << " allocated, " << (uint64_t)slabs << " slabs";
+    }
+
+    // ====================================================================
+    // Generic size classes
+    // ====================================================================
+
+    namespace Slab {
+        static SlabCache g_sizeClasses[] = {
+            SlabCache("kmalloc-16", 16),
+            SlabCache("kmalloc-32", 32),
+            SlabCache("kmalloc-64", 64),
+            SlabCache("kmalloc-128", 128),
+            SlabCache("kmalloc-256", 256),
+            SlabCache("kmalloc-512", 512),
+            SlabCache("kmalloc-1024", 1024),
+        };
+
+        static constexpr int SizeClassCount = sizeof(g_sizeClasses) / sizeof(g_sizeClasses[0]);
+
+        void* Allocate(size_t size) {
+            for (int i = 0; i < SizeClassCount; i++) {
+                if (size <= g_sizeClasses[i].ObjectSize()) return g_sizeClasses[i].Allocate();
+            }
+            return nullptr;
+        }
+
+        void Free(void* object) {
+            SlabCache* cache = SlabCache::CacheOf(object);
+            if (cache) cache->Free(object);
+        }
+
+        void Dump() {
+            for (int i = 0; i < SizeClassCount; i++) {
+                g_sizeClasses[i].Dump();
+            }
+        }
+    };
+};
@@ -0,0 +1,83 @@
+/*
+    * Slab.hpp
+    * Slab allocator for small and fixed-size kernel objects
+    * Copyright (c) 2026 Daniel Hammer
+*/
+
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <CppLib/Spinlock.hpp>
+#include <Hal/SmpBoot.hpp>
+
+namespace Memory {
+    // A cache of equally sized objects carved out of single-page slabs.
+    // Each CPU keeps a magazine of free objects in front of the slab lists,
+    // so most allocations and frees touch no shared state. Caches are
+    // usually global objects; the constructor allocates nothing.
+    class SlabCache {
+        static constexpr int MagazineSize = 16;
+
+        struct Slab {
+            SlabCache* cache;
+            Slab* next;
+            Slab* prev;
+            void* freeList;       // Free objects, linked through their first word
+            uint32_t inUse;
+            uint32_t capacity;
+        };
+
+        struct Magazine {
+            int count;
+            void* objects[MagazineSize];
+        };
+
+        const char* name;
+        size_t objectSize;
+        kcp::Spinlock Lock{};
+        Slab* partial = nullptr;  // Some objects free
+        Slab* full = nullptr;     // No objects free
+        Slab* empty = nullptr;    // At most one fully free slab kept for reuse
+        size_t slabCount = 0;
+        size_t objectsInUse = 0;  // Handed out, including magazine contents
+        Magazine magazines[Smp::MaxCPUs]{};
+
+        static Slab* SlabOf(void* object);
+        static void Unlink(Slab*& list, Slab* slab);
+        static void Push(Slab*& list, Slab* slab);
+        Slab* Grow();
+        void* TakeLocked();
+        void PutLocked(void* object);
+    public:
+        constexpr SlabCache(const char* name, size_t objectSize)
+            : name(name), objectSize(objectSize < sizeof(void*) ? sizeof(void*) : (objectSize + 15) & ~(size_t)15) {}
+
+        void* Allocate();
+        void Free(void* object);
+
+        const char* Name() const { return name; }
+        size_t ObjectSize() const { return objectSize; }
+
+        // Write a one-line summary of the cache to the kernel log
+        void Dump();
+
+        // The cache an object from any SlabCache belongs to (nullptr if
+        // `object` does not point into a slab page)
+        static SlabCache* CacheOf(void* object);
+    };
+
+    namespace Slab {
+        // Largest request served by the generic size classes; anything
+        // bigger goes to the first-fit HeapAllocator.
+        constexpr size_t MaxSize = 1024;
+
+        // Allocate from the smallest size class that fits `size` bytes
+        void* Allocate(size_t size);
+
+        // Free an object from any cache
+        void Free(void* object);
+
+        // Log the size classes and their usage
+        void Dump();
+    };
+};
@@ -0,0 +1,130 @@
+/*
+    * Tlb.cpp
+    * Cross-CPU TLB shootdown
+    * Copyright (c) 2026 Daniel Hammer
+*/
+
+#include "Tlb.hpp"
+#include "Pcid.hpp"
+#include "PageFrameAllocator.hpp"
+#include <Hal/SmpBoot.hpp>
+#include <Hal/Apic/Apic.hpp>
+#include <Hal/Apic/Interrupts.hpp>
+#include <CppLib/Spinlock.hpp>
+
+namespace Memory::VMM::Tlb {
+    // One shootdown is in flight at a time. The initiator fills in the
+    // request, raises the pending flag of each target and spins until all
+    // of them have dropped it again.
+    struct Request {
+        uint64_t pml4Phys;
+        const uint64_t* addresses;
+        int count;
+    };
+
+    static kcp::Spinlock g_lock;
+    static Request g_request;
+    static bool g_pending[Smp::MaxCPUs];
+    static uint64_t g_active[Smp::MaxCPUs];
+
+    static void InvalidateLocal(const uint64_t* addresses, int count) {
+        if (count > BatchSize) {
+            // Reloading CR3 without the no-flush bit drops the current PCID
+            asm volatile("mov %%cr3, %%rax; mov %%rax, %%cr3" ::: "rax", "memory");
+            return;
+        }
+        for (int i = 0; i < count; i++) {
+            asm volatile("invlpg (%0)" :: "r"(addresses[i]) : "memory");
+        }
+    }
+
+    // Answer a shootdown aimed at this CPU, if there is one. Interrupts
+    // are off (IPI handler, or spinning for g_lock).
+    static void ServicePending() {
+        int self = Smp::GetCurrentCpuData()->cpuIndex;
+        if (!__atomic_load_n(&g_pending[self], __ATOMIC_ACQUIRE)) return;
+
+        // The CPU may have switched away since; then there is nothing
+        // loaded to fix, and the PCID generation covers the cached tag
+        if (__atomic_load_n(&g_active[self], __ATOMIC_RELAXED) == g_request.pml4Phys) {
+            InvalidateLocal(g_request.addresses, g_request.count);
+        }
+        __atomic_store_n(&g_pending[self], false, __ATOMIC_RELEASE);
+    }
+
+    static void ShootdownHandler(uint8_t) {
+        ServicePending();
+    }
+
+    void Initialize() {
+        Hal::RegisterIrqHandler(Hal::IRQ_TLB_SHOOTDOWN, ShootdownHandler);
+    }
+
+    void SetActive(int cpuIndex, uint64_t pml4Phys) {
+        // Full barrier: a concurrent Shootdown() either sees this CPU as a
+        // target, or this CPU sees the bumped PCID generation and flushes
+        __atomic_store_n(&g_active[cpuIndex], pml4Phys, __ATOMIC_SEQ_CST);
+    }
+
+    static void Shootdown(uint64_t pml4Phys, const uint64_t* addresses, int count) {
+        Pcid::Invalidate(pml4Phys);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+        // Spinning for the lock services other initiators, who may be
+        // waiting for this CPU while it waits for them
+        while (!g_lock.TryAcquire()) {
+            uint64_t flags;
+            asm volatile("pushfq; pop %0; cli" : "=r"(flags) :: "memory");
+            ServicePending();
+            asm volatile("push %0; popfq" :: "r"(flags) : "memory");
+            asm volatile("pause");
+        }
+
+        int self = Smp::GetCurrentCpuData()->cpuIndex;
+        if (g_active[self] == pml4Phys) InvalidateLocal(addresses, count);
+
+        g_request = { pml4Phys, addresses, count };
+
+        int cpuCount = Smp::GetCpuCount();
+        bool sent = false;
+        for (int i = 0; i < cpuCount; i++) {
+            if (i == self || __atomic_load_n(&g_active[i], __ATOMIC_SEQ_CST) != pml4Phys) continue;
+            auto* cpu = Smp::GetCpuData(i);
+            if (cpu == nullptr || !cpu->started) continue;
+
+            __atomic_store_n(&g_pending[i], true, __ATOMIC_RELEASE);
+            Hal::LocalApic::SendIpi(cpu->lapicId, Hal::IRQ_VECTOR_BASE + Hal::IRQ_TLB_SHOOTDOWN);
+            sent = true;
+        }
+
+        if (sent) {
+            for (int i = 0; i < cpuCount; i++) {
+                while (__atomic_load_n(&g_pending[i], __ATOMIC_ACQUIRE)) {
+                    asm volatile("pause");
+                }
+            }
+        }
+
+        g_lock.Release();
+    }
+
+    void Batch::Add(uint64_t va) {
+        if (count < BatchSize) addresses[count] = va;
+        if (count <= BatchSize) count++;
+    }
+
+    void Batch::FreeAfter(void* pages, int pageCount) {
+        if (freeCount == BatchSize) Flush();
+        frees[freeCount++] = { pages, pageCount };
+    }
+
+    void Batch::Flush() {
+        if (count > 0) Shootdown(pml4Phys, addresses, count);
+
+        for (int i = 0; i < freeCount; i++) {
+            g_pfa->Free(frees[i].pages, frees[i].count);
+        }
+        count = 0;
+        freeCount = 0;
+    }
+};
@@ -0,0 +1,56 @@
+/*
+    * Tlb.hpp
+    * Cross-CPU TLB shootdown
+    * Copyright (c) 2026 Daniel Hammer
+*/
+
+#pragma once
+#include <cstdint>
+
+namespace Memory::VMM::Tlb {
+    // Addresses a Batch invalidates one by one; beyond this the targets
+    // flush the whole address space instead. Also the number of frees it
+    // holds before it has to flush.
+    constexpr int BatchSize = 32;
+
+    // Register the shootdown IPI handler (BSP, after the IRQ table is up)
+    void Initialize();
+
+    // The scheduler records the PML4 each CPU is about to run, so a
+    // shootdown only interrupts CPUs that can hold entries for it
+    void SetActive(int cpuIndex, uint64_t pml4Phys);
+
+    // Gathers the unmappings made in one address space and invalidates
+    // them on every CPU that has it loaded with a single IPI round, then
+    // frees the frames handed to it. Until Flush() returns, unmapped pages
+    // can still be reached through stale TLB entries, so
+    // they must not be reused. Flushes on destruction; never flush while
+    // holding a Spinlock (the targets need interrupts to answer).
+    class Batch {
+        struct PendingFree {
+            void* pages;
+            int count;
+        };
+
+        uint64_t pml4Phys;
+        int count = 0;            // BatchSize + 1: flush everything
+        int freeCount = 0;
+        uint64_t addresses[BatchSize];
+        PendingFree frees[BatchSize];
+    public:
+        explicit Batch(uint64_t pml4Phys) : pml4Phys(pml4Phys) {}
+        ~Batch() { Flush(); }
+
+        Batch(const Batch&) = delete;
+        Batch& operator=(const Batch&) = delete;
+
+        // `va` was unmapped (Paging::UnmapUserIn calls this)
+        void Add(uint64_t va);
+
+        // Free `pageCount` frames at HHDM address `pages` once the
+        // invalidations gathered so far have completed
+        void FreeAfter(void* pages, int pageCount = 1);
+
+        void Flush();
+    };
+};
@@ -0,0 +1,254 @@
+/*
+    * Vma.cpp
+    * Per-process map of user heap regions and address-space holes
+    * Copyright (c) 2026 Daniel Hammer
+*/
+
+#include "Vma.hpp"
+#include "Slab.hpp"
+#include "MemObject.hpp"
+
+namespace Memory {
+    using Node = VmaTree::Node;
+
+    static SlabCache g_vmaCache("vma", sizeof(VmaTree::Node));
+
+    // ====================================================================
+    // AVL primitives
+    // ====================================================================
+
+    static int Height(const Node* n) { return n ? n->height : 0; }
+    static uint64_t MaxPages(const Node* n) { return n ? n->maxPages : 0; }
+
+    static void Update(Node* n) {
+        int hl = Height(n->left), hr = Height(n->right);
+        n->height = (hl > hr ? hl : hr) + 1;
+        uint64_t m = n->pages;
+        if (MaxPages(n->left) > m) m = MaxPages(n->left);
+        if (MaxPages(n->right) > m) m = MaxPages(n->right);
+        n->maxPages = m;
+    }
+
+    static Node* RotateRight(Node* n) {
+        Node* l = n->left;
+        n->left = l->right;
+        l->right = n;
+        Update(n);
+        Update(l);
+        return l;
+    }
+
+    static Node* RotateLeft(Node* n) {
+        Node* r = n->right;
+        n->right = r->left;
+        r->left = n;
+        Update(n);
+        Update(r);
+        return r;
+    }
+
+    static Node* Balance(Node* n) {
+        Update(n);
+        int bf = Height(n->left) - Height(n->right);
+        if (bf > 1) {
+            if (Height(n->left->left) < Height(n->left->right)) n->left = RotateLeft(n->left);
+            return RotateRight(n);
+        }
+        if (bf < -1) {
+            if (Height(n->right->right) < Height(n->right->left)) n->right = RotateRight(n->right);
+            return RotateLeft(n);
+        }
+        return n;
+    }
+
+    static Node* InsertNode(Node* root, Node* n) {
+        if (root == nullptr) return n;
+        if (n->start < root->start) root->left = InsertNode(root->left, n);
+        else root->right = InsertNode(root->right, n);
+        return Balance(root);
+    }
+
+    static Node* DetachMin(Node* root, Node*& min) {
+        if (root->left == nullptr) {
+            min = root;
+            return root->right;
+        }
+        root->left = DetachMin(root->left, min);
+        return Balance(root);
+    }
+
+    // Unlink the node starting at `start`; `removed` receives it (or nullptr)
+    static Node* RemoveNode(Node* root, uint64_t start, Node*& removed) {
+        if (root == nullptr) return nullptr;
+        if (start < root->start) {
+            root->left = RemoveNode(root->left, start, removed);
+        } else if (start > root->start) {
+            root->right = RemoveNode(root->right, start, removed);
+        } else {
+            removed = root;
+            if (root->left == nullptr) return root->right;
+            if (root->right == nullptr) return root->left;
+            Node* successor;
+            Node* right = DetachMin(root->right, successor);
+            successor->left = root->left;
+            successor->right = right;
+            return Balance(successor);
+        }
+        return Balance(root);
+    }
+
+    // Node with the greatest start <= va
+    static Node* Floor(Node* n, uint64_t va) {
+        Node* best = nullptr;
+        while (n) {
+            if (n->start <= va) {
+                best = n;
+                n = n->right;
+            } else {
+                n = n->left;
+            }
+        }
+        return best;
+    }
+
+    static Node* NewNode(uint64_t start, uint64_t pages) {
+        Node* n = (Node*)g_vmaCache.Allocate();
+        if (n == nullptr) return nullptr;
+        n->start = start;
+        n->pages = pages;
+        n->maxPages = pages;
+        n->left = n->right = nullptr;
+        n->height = 1;
+        n->object = nullptr;
+        n->objectPage = 0;
+        return n;
+    }
+
+    static void FreeTree(Node* n) {
+        if (n == nullptr) return;
+        FreeTree(n->left);
+        FreeTree(n->right);
+        if (n->object) n->object->Release();
+        g_vmaCache.Free(n);
+    }
+
+    static uint64_t End(const Node* n) { return n->start + n->pages * 0x1000; }
+
+    // ====================================================================
+    // VmaTree
+    // ====================================================================
+
+    bool VmaTree::Insert(uint64_t start, uint64_t pages, MemObject* object, uint64_t objectPage) {
+        Node* n = NewNode(start, pages);
+        if (n == nullptr) return false;
+        n->object = object;
+        n->objectPage = objectPage;
+        regions = InsertNode(regions, n);
+        regionCount++;
+        return true;
+    }
+
+    uint64_t VmaTree::Remove(uint64_t start, MemObject** object) {
+        Node* removed = nullptr;
+        regions = RemoveNode(regions, start, removed);
+        if (removed == nullptr) return 0;
+        uint64_t pages = removed->pages;
+        if (object) *object = removed->object;
+        else if (removed->object) removed->object->Release();
+        g_vmaCache.Free(removed);
+        regionCount--;
+        return pages;
+    }
+
+    const VmaTree::Node* VmaTree::Find(uint64_t va) const {
+        Node* n = Floor(regions, va);
+        if (n == nullptr || va >= End(n)) return nullptr;
+        return n;
+    }
+
+    const VmaTree::Node* VmaTree::FindFrom(uint64_t va) const {
+        const Node* n = Find(va);
+        if (n) return n;
+
+        // Smallest start above `va`
+        const Node* best = nullptr;
+        for (Node* c = regions; c; ) {
+            if (c->start > va) {
+                best = c;
+                c = c->left;
+            } else {
+                c = c->right;
+            }
+        }
+        return best;
+    }
+
+    uint64_t VmaTree::TakeHole(uint64_t pages) {
+        if (MaxPages(holes) < pages) return 0;
+
+        // Lowest-addressed hole that fits: prefer the left subtree
+        Node* n = holes;
+        for (;;) {
+            if (MaxPages(n->left) >= pages) n = n->left;
+            else if (n->pages >= pages) break;
+            else n = n->right;
+        }
+
+        uint64_t start = n->start;
+        uint64_t rest = n->pages - pages;
+        Node* removed = nullptr;
+        holes = RemoveNode(holes, start, removed);
+
+        if (rest == 0) {
+            g_vmaCache.Free(removed);
+        } else {
+            // Reuse the node for the remainder
+            removed->start = start + pages * 0x1000;
+            removed->pages = rest;
+            removed->maxPages = rest;
+            removed->left = removed->right = nullptr;
+            removed->height = 1;
+            holes = InsertNode(holes, removed);
+        }
+        return start;
+    }
+
+    bool VmaTree::AddHole(uint64_t& start, uint64_t& pages) {
+        uint64_t end = start + pages * 0x1000;
+
+        Node* prev = start > 0 ? Floor(holes, start - 1) : nullptr;
+        if (prev && End(prev) == start) {
+            Node* removed = nullptr;
+            holes = RemoveNode(holes, prev->start, removed);
+            start = removed->start;
+            g_vmaCache.Free(removed);
+        }
+
+        Node* next = Floor(holes, end);
+        if (next && next->start == end) {
+            Node* removed = nullptr;
+            holes = RemoveNode(holes, next->start, removed);
+            end = End(removed);
+            g_vmaCache.Free(removed);
+        }
+
+        pages = (end - start) / 0x1000;
+        Node* n = NewNode(start, pages);
+        if (n == nullptr) return false;
+        holes = InsertNode(holes, n);
+        return true;
+    }
+
+    void VmaTree::RemoveHole(uint64_t start) {
+        Node* removed = nullptr;
+        holes = RemoveNode(holes, start, removed);
+        if (removed) g_vmaCache.Free(removed);
+    }
+
+    void VmaTree::Clear() {
+        FreeTree(regions);
+        FreeTree(holes);
+        regions = holes = nullptr;
+        regionCount = 0;
+    }
+};
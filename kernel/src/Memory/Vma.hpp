@@ -0,0 +1,72 @@
+/*
+    * Vma.hpp
+    * Per-process map of user heap regions and address-space holes
+    * Copyright (c) 2026 Daniel Hammer
+*/
+
+#pragma once
+#include <cstdint>
+#include <cstddef>
+
+namespace Memory {
+    class MemObject;
+
+    // The heap regions of one process and the holes freed between them.
+    // Both are AVL trees keyed by start address. Hole nodes also carry the
+    // largest hole in their subtree, so the lowest hole that fits is found
+    // in O(log n). Not thread-safe: the owner serializes access (vmLock).
+    class VmaTree {
+    public:
+        struct Node {
+            uint64_t start;       // First byte (page aligned)
+            uint64_t pages;
+            uint64_t maxPages;    // Largest `pages` in this subtree
+            Node* left;
+            Node* right;
+            int height;
+            MemObject* object;    // Backing object of a mapping, nullptr for anonymous memory
+            uint64_t objectPage;  // Object page mapped at `start`
+        };
+
+        // Record the allocated region [start, start + pages * 4K), backed
+        // by `object` from page `objectPage` on if given. The tree takes
+        // over the caller's reference to the object.
+        // Returns false if no node could be allocated.
+        bool Insert(uint64_t start, uint64_t pages, MemObject* object = nullptr, uint64_t objectPage = 0);
+
+        // Remove the region starting exactly at `start`. Returns its size
+        // in pages, or 0 if there is no such region. The reference to its
+        // backing object is handed to `object` if given, else dropped.
+        uint64_t Remove(uint64_t start, MemObject** object = nullptr);
+
+        // The region containing `va`, or nullptr
+        const Node* Find(uint64_t va) const;
+
+        // The region containing `va`, else the first one above it, or
+        // nullptr. For walking the regions in address order.
+        const Node* FindFrom(uint64_t va) const;
+
+        // Carve `pages` out of the lowest hole large enough. Returns the
+        // start address, or 0 if no hole fits.
+        uint64_t TakeHole(uint64_t pages);
+
+        // Return [start, start + pages * 4K) to the holes, merged with any
+        // adjacent hole. `start`/`pages` are updated to the merged hole.
+        // Returns false if no node could be allocated (the range is lost).
+        bool AddHole(uint64_t& start, uint64_t& pages);
+
+        // Drop the hole starting exactly at `start` (e.g. when it is given
+        // back to the bump frontier)
+        void RemoveHole(uint64_t start);
+
+        // Free every node and drop the object references (process teardown)
+        void Clear();
+
+        size_t RegionCount() const { return regionCount; }
+
+    private:
+        Node* regions = nullptr;
+        Node* holes = nullptr;
+        size_t regionCount = 0;
+    };
+};
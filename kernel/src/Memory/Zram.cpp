@@ -0,0 +1,241 @@
+/*
+    * Zram.cpp
+    * Compressed in-memory swap for idle user heap pages
+    * Copyright (c) 2026 Daniel Hammer
+*/
+
+#include "Zram.hpp"
+#include "Slab.hpp"
+#include "Paging.hpp"
+#include "Pressure.hpp"
+#include "Tlb.hpp"
+#include "HHDM.hpp"
+#include "Dma.hpp"
+#include "PageFrameAllocator.hpp"
+#include <Sched/Scheduler.hpp>
+#include <Libraries/Lz4.hpp>
+#include <Libraries/Memory.hpp>
+#include <CppLib/Spinlock.hpp>
+
+namespace Memory::Zram {
+
+    using VMM::Paging;
+
+    // A compressed page. Records come from their own size classes, each
+    // packing a slab page with little left over; a page needing more than
+    // the largest is not worth storing.
+    struct Record {
+        uint16_t length;        // Of the LZ4 block in data
+        uint8_t sizeClass;
+        uint8_t reserved;
+        uint8_t data[];
+    };
+
+    static SlabCache g_classes[] = {
+        { "zram-128", 128 },   { "zram-256", 256 },   { "zram-336", 336 },
+        { "zram-448", 448 },   { "zram-576", 576 },   { "zram-672", 672 },
+        { "zram-800", 800 },   { "zram-1008", 1008 }, { "zram-1344", 1344 },
+        { "zram-2016", 2016 },
+    };
+    static constexpr int ClassCount = sizeof(g_classes) / sizeof(g_classes[0]);
+    static constexpr uint64_t MaxRecord = 2016;
+
+    // Page table entries the clock looks at per shrinker call
+    static constexpr uint64_t ScanBudget = 4096;
+
+    // Store() is only called by the clock, under g_scanLock
+    static kcp::Mutex g_scanLock;
+    static uint8_t g_scratch[MaxRecord - sizeof(Record)];
+    static uint16_t g_hashTable[Lib::Lz4HashEntries];
+
+    // Where the clock hand stands: process slot and heap address
+    static int g_handSlot = 0;
+    static uint64_t g_handVa = 0;
+
+    static volatile uint64_t g_swappedPages = 0;
+    static volatile uint64_t g_compressedBytes = 0;
+
+    static bool IsZeroPage(const void* page) {
+        const uint64_t* words = (const uint64_t*)page;
+        for (int i = 0; i < 512; i++) {
+            if (words[i] != 0) return false;
+        }
+        return true;
+    }
+
+    uint64_t Store(const void* page) {
+        if (IsZeroPage(page)) {
+            __atomic_add_fetch(&g_swappedPages, 1, __ATOMIC_RELAXED);
+            return ZeroSlot;
+        }
+
+        int64_t length = Lib::Lz4CompressBlock((const uint8_t*)page, 0x1000, g_scratch, sizeof(g_scratch),
+                                               g_hashTable);
+        if (length < 0) return 0;
+
+        int sizeClass = 0;
+        while (g_classes[sizeClass].ObjectSize() < sizeof(Record) + (uint64_t)length) sizeClass++;
+
+        Record* record = (Record*)g_classes[sizeClass].Allocate();
+        if (record == nullptr) return 0;
+        record->length = (uint16_t)length;
+        record->sizeClass = (uint8_t)sizeClass;
+        record->reserved = 0;
+        memcpy(record->data, g_scratch, length);
+
+        __atomic_add_fetch(&g_swappedPages, 1, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&g_compressedBytes, g_classes[sizeClass].ObjectSize(), __ATOMIC_RELAXED);
+        return SubHHDM((uint64_t)record);
+    }
+
+    bool Load(uint64_t slot, void* page) {
+        if (slot == ZeroSlot) {
+            memset(page, 0, 0x1000);
+            return true;
+        }
+
+        const Record* record = (const Record*)HHDM(slot);
+        return Lib::Lz4DecompressBlock(record->data, record->length, (uint8_t*)page, 0x1000) == 0x1000;
+    }
+
+    void Release(uint64_t slot) {
+        if (slot == 0) return;
+        __atomic_sub_fetch(&g_swappedPages, 1, __ATOMIC_RELAXED);
+        if (slot == ZeroSlot) return;
+
+        Record* record = (Record*)HHDM(slot);
+        SlabCache& cache = g_classes[record->sizeClass];
+        __atomic_sub_fetch(&g_compressedBytes, cache.ObjectSize(), __ATOMIC_RELAXED);
+        cache.Free(record);
+    }
+
+    // Compress the pages taken into a batch whose invalidations have
+    // completed, freeing their frames; a page that cannot be stored is
+    // mapped back. Returns the frames freed.
+    static uint64_t StoreTaken(Sched::Process* proc, const uint64_t* vas, const uint64_t* frames,
+                               int count) {
+        uint64_t freed = 0;
+        for (int i = 0; i < count; i++) {
+            void* page = (void*)HHDM(frames[i]);
+            uint64_t swapSlot = Store(page);
+            if (swapSlot == 0) {
+                Paging::RestoreUserPage(proc->pml4Phys, vas[i]);
+                continue;
+            }
+            Paging::SetUserSwapSlot(proc->pml4Phys, vas[i], swapSlot);
+            g_pfa->Free(page);
+            proc->allocatedPages--;
+            freed++;
+        }
+        return freed;
+    }
+
+    // Advance the hand through one process's anonymous heap regions,
+    // taking up to `want` idle pages. Returns the frames freed; `done`
+    // says whether the hand reached the end of the heap.
+    static uint64_t ScanProcess(Sched::Process* proc, int slot, uint64_t want, uint64_t& budget, bool& done) {
+        done = true;
+        if (!proc->vmLock.TryAcquire()) return 0;
+
+        // A device may be using some of its pages (see Dma.hpp)
+        if (Dma::IsPinned(slot)) {
+            proc->vmLock.Release();
+            return 0;
+        }
+
+        uint64_t vas[VMM::Tlb::BatchSize];
+        uint64_t frames[VMM::Tlb::BatchSize];
+        int count = 0;
+        uint64_t freed = 0;
+        uint64_t va = g_handVa > Sched::UserHeapBase ? g_handVa : Sched::UserHeapBase;
+
+        VMM::Tlb::Batch batch(proc->pml4Phys);
+        const Memory::VmaTree::Node* region = proc->heapVmas.FindFrom(va);
+        while (region != nullptr && budget > 0 && freed + count < want) {
+            uint64_t end = region->start + region->pages * 0x1000;
+            if (va < region->start) va = region->start;
+
+            // Frames of mapped objects belong to the object
+            if (region->object != nullptr) {
+                va = end;
+            }
+
+            while (va < end && budget > 0 && count < VMM::Tlb::BatchSize && freed + count < want) {
+                if ((va & (Paging::HugePageSize - 1)) == 0 && Paging::IsUserHugePage(proc->pml4Phys, va)) {
+                    va += Paging::HugePageSize;
+                    budget--;
+                    continue;
+                }
+                uint64_t frame = Paging::TakeUserPageForSwap(proc->pml4Phys, va, batch);
+                if (frame != 0) {
+                    vas[count] = va;
+                    frames[count++] = frame;
+                }
+                va += 0x1000;
+                budget--;
+            }
+
+            // The frames may only be read once no CPU can write them
+            if (count == VMM::Tlb::BatchSize) {
+                batch.Flush();
+                freed += StoreTaken(proc, vas, frames, count);
+                count = 0;
+            }
+            if (va >= end) region = proc->heapVmas.FindFrom(va);
+        }
+
+        batch.Flush();
+        freed += StoreTaken(proc, vas, frames, count);
+
+        done = region == nullptr;
+        g_handVa = va;
+        proc->vmLock.Release();
+        return freed;
+    }
+
+    static uint64_t Shrink(uint64_t pages) {
+        if (!g_scanLock.TryAcquire()) return 0;
+
+        uint64_t freed = 0;
+        uint64_t budget = ScanBudget;
+        int slots = Sched::SlotCount();
+        for (int visited = 0; visited < slots && freed < pages && budget > 0; visited++) {
+            if (g_handSlot >= slots) g_handSlot = 0;
+            Sched::Process* proc = Sched::GetProcessSlot(g_handSlot);
+
+            // Spawn fills in the address space before it publishes the
+            // group reference; teardown waits for this pass to end
+            bool done = true;
+            if (proc->leaderSlot == g_handSlot && !proc->kernelMode && !proc->groupExiting
+                && __atomic_load_n(&proc->groupRefs, __ATOMIC_ACQUIRE) > 0) {
+                freed += ScanProcess(proc, g_handSlot, pages - freed, budget, done);
+            }
+
+            if (done) {
+                g_handSlot = (g_handSlot + 1) % slots;
+                g_handVa = 0;
+            }
+        }
+
+        g_scanLock.Release();
+        return freed;
+    }
+
+    void Initialize() {
+        Pressure::RegisterShrinker("zram", Shrink);
+    }
+
+    void WaitForScan() {
+        g_scanLock.Acquire();
+        g_scanLock.Release();
+    }
+
+    uint64_t SwappedBytes() {
+        return g_swappedPages * 0x1000;
+    }
+
+    uint64_t CompressedBytes() {
+        return g_compressedBytes;
+    }
+
+};
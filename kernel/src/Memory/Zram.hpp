@@ -0,0 +1,49 @@
+/*
+    * Zram.hpp
+    * Compressed in-memory swap for idle user heap pages
+    * Copyright (c) 2026 Daniel Hammer
+*/
+
+#pragma once
+#include <cstdint>
+
+namespace Memory::Zram {
+
+    // Under memory pressure, anonymous heap pages that have not been
+    // touched for a while are compressed into kernel memory and their
+    // frames freed. The page table entry is left not-present, tagged as a
+    // swap entry holding the slot (Paging::PteSwapped), and the next
+    // access faults the page back in through HandleHeapFault.
+    //
+    // Pages are picked by a clock over the processes' heap regions: a
+    // page whose accessed bit is set gets it cleared and is skipped, so
+    // only a page untouched for a whole turn of the clock is taken. The
+    // clock runs as a shrinker (see Pressure.hpp), a bounded number of
+    // pages per call. Pages that compress badly stay where they are;
+    // pages of zeros cost no memory at all.
+
+    // Slot of a page of zeros; any other slot is a compressed record
+    static constexpr uint64_t ZeroSlot = 1;
+
+    // Register the shrinker (once, after the allocators are up)
+    void Initialize();
+
+    // Compress the page at HHDM address `page`. Returns its slot, or 0 if
+    // it does not compress well enough or memory ran out.
+    uint64_t Store(const void* page);
+
+    // Decompress the page in `slot` into `page`; false if the record is
+    // damaged. The slot is still held.
+    bool Load(uint64_t slot, void* page);
+
+    void Release(uint64_t slot);
+
+    // Wait for a clock pass in progress to finish. Process teardown calls
+    // this before freeing the page tables the clock may be walking.
+    void WaitForScan();
+
+    // Bytes of heap pages swapped out, and the memory their records take
+    uint64_t SwappedBytes();
+    uint64_t CompressedBytes();
+
+};
@@ -14,6 +14,7 @@
 #include <Libraries/Memory.hpp>
 #include <Terminal/Terminal.hpp>
 #include <CppLib/Stream.hpp>
+#include <CppLib/Spinlock.hpp>
 #include <Timekeeping/ApicTimer.hpp>
 
 using namespace Kt;
@@ -26,64 +27,151 @@ namespace Net::Arp {
         return Drivers::Net::E1000E::GetMacAddress();
     }
 
-    // ARP cache entry
-    struct CacheEntry {
-        uint32_t Ip;
-        uint8_t  Mac[6];
-        uint64_t Timestamp;
-        bool     Valid;
+    // ---- Neighbor table ----
+
+    // Incomplete: a request is out and packets wait in the neighbor's queue.
+    // Reachable: the mapping was confirmed recently.
+    // Stale: past its reachable time, still used as is.
+    // Probe: a stale entry in use, being confirmed with unicast requests.
+    enum class State : uint8_t { Free, Incomplete, Reachable, Stale, Probe };
+
+    static constexpr int      NEIGH_COUNT     = 64;
+    static constexpr int      NEIGH_BUCKETS   = 32;      // power of two
+    static constexpr int      NEIGH_QUEUE_LEN = 8;       // packets held per unresolved neighbor
+    static constexpr uint64_t REACHABLE_MS    = 60000;
+    static constexpr uint64_t REFRESH_MS      = 45000;   // refresh an entry in use from here on
+    static constexpr uint64_t RETRY_MS        = 1000;
+    static constexpr int      MAX_PROBES      = 3;
+    static constexpr uint64_t GC_MS           = 600000;  // forget stale entries unused this long
+    static constexpr uint64_t SCAN_MS         = 100;
+
+    struct Neighbor {
+        uint32_t      Ip;
+        uint8_t       Mac[6];
+        State         St;
+        uint8_t       Probes;       // requests sent in this state
+        uint64_t      Confirmed;    // last reply from the neighbor (ms)
+        uint64_t      Used;         // last packet sent to it (ms)
+        uint64_t      NextProbe;
+        PacketBuffer* Queue[NEIGH_QUEUE_LEN];
+        int           QueueCount;
+        int           Next;         // hash chain: index + 1, 0 ends it
     };
 
-    static constexpr uint32_t ARP_CACHE_SIZE = 32;
-    static constexpr uint64_t ARP_CACHE_TIMEOUT_MS = 60000; // 60 seconds
+    static Neighbor g_neigh[NEIGH_COUNT] = {};
+    static int g_buckets[NEIGH_BUCKETS] = {};   // index + 1 of the first entry
+    static uint64_t g_nextScan = 0;
+    static kcp::Spinlock g_lock;
 
-    static CacheEntry g_cache[ARP_CACHE_SIZE] = {};
+    static_assert(NEIGH_BUCKETS == 32, "Bucket() takes the top 5 bits");
 
-    void Initialize() {
-        for (uint32_t i = 0; i < ARP_CACHE_SIZE; i++) {
-            g_cache[i].Valid = false;
+    static uint32_t Bucket(uint32_t ip) {
+        return (ip * 2654435761u) >> 27;
+    }
+
+    static Neighbor* Find(uint32_t ip) {
+        for (int i = g_buckets[Bucket(ip)]; i != 0; i = g_neigh[i - 1].Next) {
+            if (g_neigh[i - 1].Ip == ip) return &g_neigh[i - 1];
         }
-        KernelLogStream(OK, "Net") << "ARP initialized";
+        return nullptr;
     }
 
-    static void CacheInsert(uint32_t ip, const uint8_t* mac) {
-        // Look for existing entry or empty slot
-        uint32_t emptySlot = ARP_CACHE_SIZE;
-        for (uint32_t i = 0; i < ARP_CACHE_SIZE; i++) {
-            if (g_cache[i].Valid && g_cache[i].Ip == ip) {
-                // Update existing entry
-                memcpy(g_cache[i].Mac, mac, 6);
-                g_cache[i].Timestamp = Timekeeping::GetMilliseconds();
-                return;
-            }
-            if (!g_cache[i].Valid && emptySlot == ARP_CACHE_SIZE) {
-                emptySlot = i;
-            }
+    static void Unlink(Neighbor* n) {
+        int idx = (int)(n - g_neigh) + 1;
+        int* link = &g_buckets[Bucket(n->Ip)];
+        while (*link != 0 && *link != idx) link = &g_neigh[*link - 1].Next;
+        if (*link == idx) *link = n->Next;
+        n->St = State::Free;
+    }
+
+    // A free entry for `ip`, evicting the least recently used one that has
+    // nothing queued if the table is full. Lock held.
+    static Neighbor* Allocate(uint32_t ip, uint64_t now) {
+        Neighbor* victim = nullptr;
+        for (int i = 0; i < NEIGH_COUNT; i++) {
+            Neighbor* n = &g_neigh[i];
+            if (n->St == State::Free) { victim = n; break; }
+            if (n->QueueCount == 0 && (!victim || n->Used < victim->Used)) victim = n;
         }
+        if (!victim) return nullptr;
+        if (victim->St != State::Free) Unlink(victim);
 
-        if (emptySlot < ARP_CACHE_SIZE) {
-            g_cache[emptySlot].Ip = ip;
-            memcpy(g_cache[emptySlot].Mac, mac, 6);
-            g_cache[emptySlot].Timestamp = Timekeeping::GetMilliseconds();
-            g_cache[emptySlot].Valid = true;
+        victim->Ip = ip;
+        victim->St = State::Incomplete;
+        victim->Probes = 0;
+        victim->Confirmed = 0;
+        victim->Used = now;
+        victim->NextProbe = now;
+        victim->QueueCount = 0;
+        uint32_t b = Bucket(ip);
+        victim->Next = g_buckets[b];
+        g_buckets[b] = (int)(victim - g_neigh) + 1;
+        return victim;
+    }
+
+    static bool Usable(const Neighbor* n) {
+        return n->St == State::Reachable || n->St == State::Stale || n->St == State::Probe;
+    }
+
+    // Note a use of `n`: a stale entry starts being confirmed
+    static void Touch(Neighbor* n, uint64_t now) {
+        n->Used = now;
+        if (n->St == State::Stale) {
+            n->St = State::Probe;
+            n->Probes = 0;
+            n->NextProbe = now;
         }
     }
 
-    static bool CacheLookup(uint32_t ip, uint8_t* outMac) {
-        uint64_t now = Timekeeping::GetMilliseconds();
-        for (uint32_t i = 0; i < ARP_CACHE_SIZE; i++) {
-            if (g_cache[i].Valid && g_cache[i].Ip == ip) {
-                if ((now - g_cache[i].Timestamp) > ARP_CACHE_TIMEOUT_MS) {
-                    g_cache[i].Valid = false;
-                    return false;
-                }
-                memcpy(outMac, g_cache[i].Mac, 6);
-                return true;
-            }
+    // Requests due to be sent, gathered under the lock and sent after it
+    struct Request {
+        uint32_t Ip;
+        uint8_t  Mac[6];
+        bool     Unicast;
+    };
+
+    static void SendArp(uint16_t op, const uint8_t* destMac, const uint8_t* targetMac, uint32_t targetIp) {
+        Packet pkt;
+        pkt.HardwareType = Htons(HW_TYPE_ETHERNET);
+        pkt.ProtocolType = Htons(PROTO_TYPE_IPV4);
+        pkt.HardwareAddrLen = 6;
+        pkt.ProtocolAddrLen = 4;
+        pkt.Operation = Htons(op);
+
+        memcpy(pkt.SenderMac, GetActiveNicMac(), 6);
+        pkt.SenderIp = GetIpAddress();
+        memcpy(pkt.TargetMac, targetMac, 6);
+        pkt.TargetIp = targetIp;
+
+        Ethernet::Send(destMac, Ethernet::ETHERTYPE_ARP, (const uint8_t*)&pkt, sizeof(Packet));
+    }
+
+    static void SendRequests(const Request* reqs, int count) {
+        static const uint8_t zeroMac[6] = {};
+        for (int i = 0; i < count; i++) {
+            if (reqs[i].Unicast) SendArp(OP_REQUEST, reqs[i].Mac, zeroMac, reqs[i].Ip);
+            else SendRequest(reqs[i].Ip);
         }
-        return false;
     }
 
+    static void DropQueue(Neighbor* n) {
+        for (int i = 0; i < n->QueueCount; i++) PacketPool::Release(n->Queue[i]);
+        n->QueueCount = 0;
+    }
+
+    void Initialize() {
+        g_lock.Acquire();
+        for (int i = 0; i < NEIGH_COUNT; i++) {
+            g_neigh[i].St = State::Free;
+            g_neigh[i].QueueCount = 0;
+        }
+        for (int i = 0; i < NEIGH_BUCKETS; i++) g_buckets[i] = 0;
+        g_lock.Release();
+        KernelLogStream(OK, "Net") << "ARP initialized";
+    }
+
+    // ---- Receive ----
+
     void OnPacketReceived(const uint8_t* data, uint16_t length) {
         if (length < sizeof(Packet)) {
             return;
@@ -98,32 +186,44 @@ namespace Net::Arp {
 
         uint32_t senderIp = pkt->SenderIp; // Already in network byte order in struct
         uint32_t targetIp = pkt->TargetIp;
-
-        // Cache the sender's IP->MAC mapping, then flush any packets waiting on it
-        CacheInsert(senderIp, pkt->SenderMac);
-        Ipv4::FlushPending();
-
         uint16_t op = Ntohs(pkt->Operation);
+        bool forUs = targetIp == GetIpAddress();
+        uint64_t now = Timekeeping::GetMilliseconds();
 
-        if (op == OP_REQUEST && targetIp == GetIpAddress()) {
-            // Someone is asking for our MAC address -- send a reply
-            Packet reply;
-            reply.HardwareType = Htons(HW_TYPE_ETHERNET);
-            reply.ProtocolType = Htons(PROTO_TYPE_IPV4);
-            reply.HardwareAddrLen = 6;
-            reply.ProtocolAddrLen = 4;
-            reply.Operation = Htons(OP_REPLY);
+        // Learn the sender's mapping: always refresh a neighbor we know,
+        // and add one that is talking to us (RFC 826). Packets waiting on
+        // it go out once the lock is dropped.
+        PacketBuffer* ready[NEIGH_QUEUE_LEN];
+        int readyCount = 0;
+        uint8_t mac[6];
+        memcpy(mac, pkt->SenderMac, 6);
 
-            memcpy(reply.SenderMac, GetActiveNicMac(), 6);
-            reply.SenderIp = GetIpAddress();
-            memcpy(reply.TargetMac, pkt->SenderMac, 6);
-            reply.TargetIp = senderIp;
+        g_lock.Acquire();
+        Neighbor* n = senderIp != 0 ? Find(senderIp) : nullptr;
+        if (!n && forUs && senderIp != 0) n = Allocate(senderIp, now);
+        if (n) {
+            memcpy(n->Mac, mac, 6);
+            n->St = State::Reachable;
+            n->Probes = 0;
+            n->Confirmed = now;
+            for (int i = 0; i < n->QueueCount; i++) ready[readyCount++] = n->Queue[i];
+            n->QueueCount = 0;
+        }
+        g_lock.Release();
 
-            Ethernet::Send(pkt->SenderMac, Ethernet::ETHERTYPE_ARP,
-                          (const uint8_t*)&reply, sizeof(Packet));
+        for (int i = 0; i < readyCount; i++) {
+            Ethernet::SendPacket(mac, Ethernet::ETHERTYPE_IPV4, ready[i]);
+            PacketPool::Release(ready[i]);
+        }
+
+        if (op == OP_REQUEST && forUs) {
+            // Someone is asking for our MAC address -- send a reply
+            SendArp(OP_REPLY, mac, mac, senderIp);
         }
     }
 
+    // ---- Transmit ----
+
     bool Resolve(uint32_t ip, uint8_t* outMac) {
         // Broadcast address
         if (ip == 0xFFFFFFFF) {
@@ -131,30 +231,138 @@ namespace Net::Arp {
             return true;
         }
 
-        if (CacheLookup(ip, outMac)) {
-            return true;
+        uint64_t now = Timekeeping::GetMilliseconds();
+        bool found = false;
+        bool request = false;
+
+        g_lock.Acquire();
+        Neighbor* n = Find(ip);
+        if (n && Usable(n)) {
+            Touch(n, now);
+            memcpy(outMac, n->Mac, 6);
+            found = true;
+        } else if (!n) {
+            // Start resolving; Tick() retries from here on
+            n = Allocate(ip, now);
+            if (n) {
+                n->Probes = 1;
+                n->NextProbe = now + RETRY_MS;
+                request = true;
+            }
         }
+        g_lock.Release();
 
-        // Not in cache, send a request
-        SendRequest(ip);
-        return false;
+        if (request) SendRequest(ip);
+        return found;
+    }
+
+    bool Output(uint32_t nextHop, PacketBuffer* packet) {
+        if (nextHop == 0xFFFFFFFF) {
+            return Ethernet::SendPacket(Ethernet::BROADCAST_MAC, Ethernet::ETHERTYPE_IPV4, packet);
+        }
+
+        uint64_t now = Timekeeping::GetMilliseconds();
+        uint8_t mac[6];
+        bool send = false;
+        bool queued = false;
+        bool request = false;
+
+        g_lock.Acquire();
+        Neighbor* n = Find(nextHop);
+        if (!n) {
+            n = Allocate(nextHop, now);
+            if (n) {
+                n->Probes = 1;
+                n->NextProbe = now + RETRY_MS;
+                request = true;
+            }
+        }
+        if (n && Usable(n)) {
+            Touch(n, now);
+            memcpy(mac, n->Mac, 6);
+            send = true;
+        } else if (n && n->QueueCount < NEIGH_QUEUE_LEN) {
+            // Held until the reply comes in (or resolution fails)
+            PacketPool::Retain(packet);
+            n->Queue[n->QueueCount++] = packet;
+            n->Used = now;
+            queued = true;
+        }
+        g_lock.Release();
+
+        if (request) SendRequest(nextHop);
+        if (send) return Ethernet::SendPacket(mac, Ethernet::ETHERTYPE_IPV4, packet);
+        return queued;
     }
 
     void SendRequest(uint32_t targetIp) {
-        Packet req;
-        req.HardwareType = Htons(HW_TYPE_ETHERNET);
-        req.ProtocolType = Htons(PROTO_TYPE_IPV4);
-        req.HardwareAddrLen = 6;
-        req.ProtocolAddrLen = 4;
-        req.Operation = Htons(OP_REQUEST);
-
-        memcpy(req.SenderMac, GetActiveNicMac(), 6);
-        req.SenderIp = GetIpAddress();
-        memset(req.TargetMac, 0, 6);
-        req.TargetIp = targetIp;
-
-        Ethernet::Send(Ethernet::BROADCAST_MAC, Ethernet::ETHERTYPE_ARP,
-                      (const uint8_t*)&req, sizeof(Packet));
+        static const uint8_t zeroMac[6] = {};
+        SendArp(OP_REQUEST, Ethernet::BROADCAST_MAC, zeroMac, targetIp);
+    }
+
+    // ---- Timers ----
+
+    void Tick() {
+        uint64_t now = Timekeeping::GetMilliseconds();
+        if (now < g_nextScan) return;
+        g_nextScan = now + SCAN_MS;
+
+        Request reqs[NEIGH_COUNT];
+        int reqCount = 0;
+
+        g_lock.Acquire();
+        for (int i = 0; i < NEIGH_COUNT; i++) {
+            Neighbor* n = &g_neigh[i];
+            switch (n->St) {
+                case State::Free:
+                    break;
+
+                case State::Incomplete:
+                    if (now < n->NextProbe) break;
+                    if (n->Probes >= MAX_PROBES) {
+                        // Nobody answered: give up on what was queued
+                        DropQueue(n);
+                        Unlink(n);
+                        break;
+                    }
+                    n->Probes++;
+                    n->NextProbe = now + RETRY_MS;
+                    reqs[reqCount++] = { n->Ip, {}, false };
+                    break;
+
+                case State::Reachable:
+                    if (now - n->Confirmed >= REFRESH_MS && n->Used > n->Confirmed) {
+                        // In use: confirm it before it would go stale
+                        n->St = State::Probe;
+                        n->Probes = 0;
+                        n->NextProbe = now;
+                    } else if (now - n->Confirmed >= REACHABLE_MS) {
+                        n->St = State::Stale;
+                    }
+                    break;
+
+                case State::Stale:
+                    if (now - n->Used >= GC_MS) Unlink(n);
+                    break;
+
+                case State::Probe:
+                    if (now < n->NextProbe) break;
+                    if (n->Probes >= MAX_PROBES) {
+                        // The neighbor is gone; the next packet resolves afresh
+                        Unlink(n);
+                        break;
+                    }
+                    n->Probes++;
+                    n->NextProbe = now + RETRY_MS;
+                    reqs[reqCount] = { n->Ip, {}, true };
+                    memcpy(reqs[reqCount].Mac, n->Mac, 6);
+                    reqCount++;
+                    break;
+            }
+        }
+        g_lock.Release();
+
+        SendRequests(reqs, reqCount);
     }
 
 }
@@ -6,6 +6,7 @@
 
 #pragma once
 #include <cstdint>
+#include <Net/PacketBuffer.hpp>
 
 namespace Net::Arp {
 
@@ -33,10 +34,21 @@ namespace Net::Arp {
     // Handle an incoming ARP packet (called by Ethernet layer)
     void OnPacketReceived(const uint8_t* data, uint16_t length);
 
-    // Resolve an IP address to a MAC address. Returns true if found in cache.
-    // If not cached, sends an ARP request and returns false.
+    // Resolve an IP address to a MAC address. Returns true if the neighbor
+    // table has a usable entry. Otherwise starts resolving it (Tick()
+    // retries the request) and returns false without waiting.
     bool Resolve(uint32_t ip, uint8_t* outMac);
 
+    // Send the IPv4 packet in `packet` to next hop `nextHop`. If the
+    // neighbor is not resolved yet the packet joins its queue (taking a
+    // reference) and goes out when the reply arrives. Returns false if it
+    // was dropped.
+    bool Output(uint32_t nextHop, PacketBuffer* packet);
+
+    // Retry pending requests, confirm entries in use before they go
+    // stale and expire dead ones (called from the 1 ms housekeeping tick)
+    void Tick();
+
     // Send an ARP request for the given IP
     void SendRequest(uint32_t targetIp);
 
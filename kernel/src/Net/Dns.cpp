@@ -8,11 +8,13 @@
 #include <Net/Udp.hpp>
 #include <Net/ByteOrder.hpp>
 #include <Net/NetConfig.hpp>
+#include <Net/Loopback.hpp>
 #include <Libraries/Memory.hpp>
 #include <Libraries/String.hpp>
 #include <Timekeeping/ApicTimer.hpp>
 #include <Sched/Scheduler.hpp>
 #include <Terminal/Terminal.hpp>
+#include <CppLib/Spinlock.hpp>
 
 namespace Net::Dns {
 
@@ -21,21 +23,63 @@ namespace Net::Dns {
     static constexpr uint16_t DNS_PORT       = 53;
     static constexpr uint16_t DNS_FLAGS_RD   = 0x0100; // Recursion Desired
     static constexpr uint16_t DNS_QTYPE_A    = 1;
+    static constexpr uint16_t DNS_QTYPE_SOA  = 6;
     static constexpr uint16_t DNS_QCLASS_IN  = 1;
 
-    // ---- Simple cache ----
-
-    static constexpr int CACHE_SIZE = 8;
-
+    // ---- Tuning ----
+
+    static constexpr int      CACHE_SIZE       = 128;
+    static constexpr int      CACHE_BUCKETS    = 64;     // power of two
+    static constexpr int      MAX_PENDING      = 16;
+    static constexpr int      HOSTNAME_MAX     = 128;
+    static constexpr uint32_t MIN_TTL          = 60;     // seconds
+    static constexpr uint32_t MAX_TTL          = 86400;
+    static constexpr uint32_t NEG_TTL_DEFAULT  = 30;     // NXDOMAIN without an SOA
+    static constexpr uint32_t NEG_TTL_MAX      = 300;
+    static constexpr uint32_t FAIL_TTL         = 3;      // no server answered
+    static constexpr uint64_t RETRY_MS         = 1000;
+    static constexpr uint64_t QUERY_TIMEOUT_MS = 5000;
+
+    // An entry used this often is refreshed in the background once less
+    // than 1/PREFETCH_FRACTION of its TTL is left, so it never expires
+    // under its users
+    static constexpr uint32_t PREFETCH_HITS     = 2;
+    static constexpr uint32_t PREFETCH_FRACTION = 8;
+
+    // ---- Cache ----
+
+    // Hashed on the lowercased name, chained through `next`. Negative
+    // entries (NXDOMAIN, no A record, or no answer at all) have ip 0.
     struct CacheEntry {
-        char     hostname[128];
+        char     hostname[HOSTNAME_MAX];
         uint32_t ip;
-        uint32_t ttl;         // TTL in seconds
-        uint64_t timestamp;   // ms when cached
+        uint32_t ttl;         // seconds, as received
+        uint64_t expires;     // ms
+        uint64_t lastUsed;    // ms
+        uint32_t hits;        // lookups since stored
+        int16_t  next;        // next entry in the bucket, -1 = end
         bool     valid;
     };
 
+    // A query on the wire. It goes to every configured server with one
+    // transaction ID; the first usable answer lands in the cache.
+    struct Pending {
+        char     hostname[HOSTNAME_MAX];
+        uint16_t txId;
+        uint64_t started;     // ms
+        uint64_t sentAt;      // ms, last (re)transmission
+        bool     active;
+    };
+
     static CacheEntry g_cache[CACHE_SIZE] = {};
+    static int16_t    g_buckets[CACHE_BUCKETS];
+    static bool       g_bucketsReady = false;
+    static Pending    g_pending[MAX_PENDING] = {};
+    static uint16_t   g_port = 0;     // bound once, shared by all queries
+
+    // Guards the cache and the pending table; the UDP callback runs from
+    // the NIC interrupt
+    static kcp::Spinlock g_lock;
 
     static bool streq(const char* a, const char* b) {
         while (*a && *b) {
@@ -45,46 +89,81 @@ namespace Net::Dns {
         return *a == *b;
     }
 
-    static uint32_t CacheLookup(const char* hostname) {
-        uint64_t now = Timekeeping::GetMilliseconds();
-        for (int i = 0; i < CACHE_SIZE; i++) {
-            if (!g_cache[i].valid) continue;
-            if (!streq(g_cache[i].hostname, hostname)) continue;
-            // Check TTL
-            uint64_t elapsed = (now - g_cache[i].timestamp) / 1000;
-            if (elapsed < g_cache[i].ttl) {
-                return g_cache[i].ip;
+    static uint32_t HashName(const char* name) {
+        uint32_t h = 2166136261u;
+        for (; *name; name++) {
+            h ^= (uint8_t)*name;
+            h *= 16777619u;
+        }
+        return h & (CACHE_BUCKETS - 1);
+    }
+
+    // Lowercased copy of a name; false if it does not fit
+    static bool CopyName(char* dst, const char* src) {
+        int i = 0;
+        for (; src[i]; i++) {
+            if (i >= HOSTNAME_MAX - 1) return false;
+            char c = src[i];
+            dst[i] = (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+        }
+        dst[i] = '\0';
+        return true;
+    }
+
+    static void CacheUnlinkLocked(int idx) {
+        int16_t* link = &g_buckets[HashName(g_cache[idx].hostname)];
+        while (*link >= 0) {
+            if (*link == idx) { *link = g_cache[idx].next; break; }
+            link = &g_cache[*link].next;
+        }
+        g_cache[idx].valid = false;
+    }
+
+    static CacheEntry* CacheFindLocked(const char* name, uint64_t now) {
+        if (!g_bucketsReady) {
+            for (int i = 0; i < CACHE_BUCKETS; i++) g_buckets[i] = -1;
+            g_bucketsReady = true;
+        }
+        for (int16_t i = g_buckets[HashName(name)]; i >= 0; i = g_cache[i].next) {
+            if (!streq(g_cache[i].hostname, name)) continue;
+            if (now >= g_cache[i].expires) {
+                CacheUnlinkLocked(i);
+                return nullptr;
             }
-            // Expired
-            g_cache[i].valid = false;
-            return 0;
+            return &g_cache[i];
         }
-        return 0;
+        return nullptr;
     }
 
-    static void CacheStore(const char* hostname, uint32_t ip, uint32_t ttl) {
-        if (ttl == 0) ttl = 60; // Minimum 60s TTL
-
-        // Find free or oldest slot
-        int slot = 0;
-        uint64_t oldestTime = ~0ULL;
-        for (int i = 0; i < CACHE_SIZE; i++) {
-            if (!g_cache[i].valid) { slot = i; break; }
-            if (g_cache[i].timestamp < oldestTime) {
-                oldestTime = g_cache[i].timestamp;
-                slot = i;
+    static void CacheStoreLocked(const char* name, uint32_t ip, uint32_t ttl, uint64_t now) {
+        CacheEntry* e = CacheFindLocked(name, now);
+        if (!e) {
+            // A free slot, else the least recently used entry
+            int slot = 0;
+            for (int i = 0; i < CACHE_SIZE; i++) {
+                if (!g_cache[i].valid) { slot = i; break; }
+                if (g_cache[i].lastUsed < g_cache[slot].lastUsed) slot = i;
             }
+            if (g_cache[slot].valid) CacheUnlinkLocked(slot);
+
+            e = &g_cache[slot];
+            memcpy(e->hostname, name, HOSTNAME_MAX);
+            uint32_t bucket = HashName(name);
+            e->next = g_buckets[bucket];
+            g_buckets[bucket] = (int16_t)slot;
+            e->valid = true;
+            e->hits = 0;
+            e->lastUsed = now;
         }
+        e->ip = ip;
+        e->ttl = ttl;
+        e->expires = now + (uint64_t)ttl * 1000;
+    }
 
-        CacheEntry& e = g_cache[slot];
-        // Copy hostname
-        int len = 0;
-        while (hostname[len] && len < 126) { e.hostname[len] = hostname[len]; len++; }
-        e.hostname[len] = '\0';
-        e.ip = ip;
-        e.ttl = ttl;
-        e.timestamp = Timekeeping::GetMilliseconds();
-        e.valid = true;
+    static Pending* PendingFindLocked(const char* name) {
+        for (int i = 0; i < MAX_PENDING; i++)
+            if (g_pending[i].active && streq(g_pending[i].hostname, name)) return &g_pending[i];
+        return nullptr;
     }
 
     // ---- DNS query building ----
@@ -187,31 +266,35 @@ namespace Net::Dns {
         return -1;
     }
 
+    static uint32_t ReadU32(const uint8_t* p) {
+        return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+    }
+
     struct DnsAnswer {
-        uint32_t ip;
+        uint32_t ip;          // 0 for a negative answer
         uint32_t ttl;
-        bool     found;
+        bool     usable;      // an address, or a definite "no such name"
     };
 
-    // Parse a DNS response and extract the first A record.
-    static DnsAnswer ParseResponse(uint16_t expectedId, const uint8_t* packet, int packetLen) {
+    // Parse a DNS response: the first A record, or for NXDOMAIN and empty
+    // answers a negative result that lives as long as the SOA in the
+    // authority section allows (RFC 2308). Server failures are not usable;
+    // another server may still answer.
+    static DnsAnswer ParseResponse(const uint8_t* packet, int packetLen) {
         DnsAnswer result = {0, 0, false};
 
         if (packetLen < 12) return result;
 
-        // Check ID
-        uint16_t id = ((uint16_t)packet[0] << 8) | packet[1];
-        if (id != expectedId) return result;
-
         // Check QR bit (must be response)
         if (!(packet[2] & 0x80)) return result;
 
-        // Check RCODE (must be 0 = no error)
+        // RCODE: 0 = no error, 3 = no such name
         uint8_t rcode = packet[3] & 0x0F;
-        if (rcode != 0) return result;
+        if (rcode != 0 && rcode != 3) return result;
 
         uint16_t qdcount = ((uint16_t)packet[4] << 8) | packet[5];
         uint16_t ancount = ((uint16_t)packet[6] << 8) | packet[7];
+        uint16_t nscount = ((uint16_t)packet[8] << 8) | packet[9];
 
         // Skip question section
         int offset = 12;
@@ -222,68 +305,119 @@ namespace Net::Dns {
             if (offset > packetLen) return result;
         }
 
-        // Parse answers
-        for (uint16_t i = 0; i < ancount; i++) {
+        // Answers, then the authority section for a negative TTL
+        uint32_t negTtl = NEG_TTL_DEFAULT;
+        for (uint32_t i = 0; i < (uint32_t)ancount + nscount; i++) {
             offset = SkipName(packet, packetLen, offset);
             if (offset < 0 || offset + 10 > packetLen) return result;
 
             uint16_t atype  = ((uint16_t)packet[offset] << 8) | packet[offset + 1];
-            // uint16_t aclass = ((uint16_t)packet[offset + 2] << 8) | packet[offset + 3];
-            uint32_t attl   = ((uint32_t)packet[offset + 4] << 24) |
-                              ((uint32_t)packet[offset + 5] << 16) |
-                              ((uint32_t)packet[offset + 6] << 8)  |
-                              ((uint32_t)packet[offset + 7]);
+            uint32_t attl   = ReadU32(packet + offset + 4);
             uint16_t rdlen  = ((uint16_t)packet[offset + 8] << 8) | packet[offset + 9];
             offset += 10;
 
             if (offset + rdlen > packetLen) return result;
 
-            if (atype == DNS_QTYPE_A && rdlen == 4) {
+            if (i < ancount && rcode == 0 && atype == DNS_QTYPE_A && rdlen == 4) {
                 // A record: 4-byte IPv4 address (already in network byte order)
                 result.ip = ((uint32_t)packet[offset])
                           | ((uint32_t)packet[offset + 1] << 8)
                           | ((uint32_t)packet[offset + 2] << 16)
                           | ((uint32_t)packet[offset + 3] << 24);
                 result.ttl = attl;
-                result.found = true;
+                result.usable = true;
                 return result;
             }
 
+            if (i >= ancount && atype == DNS_QTYPE_SOA) {
+                // MNAME, RNAME, then serial/refresh/retry/expire/minimum
+                int p = SkipName(packet, packetLen, offset);
+                if (p >= 0) p = SkipName(packet, packetLen, p);
+                if (p >= 0 && p + 20 <= offset + rdlen) {
+                    uint32_t minimum = ReadU32(packet + p + 16);
+                    negTtl = attl < minimum ? attl : minimum;
+                }
+            }
+
             offset += rdlen;
         }
 
+        // No such name, or no A record for it
+        result.ttl = negTtl < NEG_TTL_MAX ? negTtl : NEG_TTL_MAX;
+        result.usable = true;
         return result;
     }
 
-    // ---- Resolve state (shared with UDP callback) ----
+    // The question's name, lowercased, to match a response to its query
+    static bool ReadQuestionName(const uint8_t* packet, int packetLen, char* out) {
+        int offset = 12, pos = 0;
+        while (offset < packetLen) {
+            uint8_t len = packet[offset++];
+            if (len == 0) {
+                if (pos == 0) return false;
+                out[pos - 1] = '\0';   // drop the trailing dot
+                return true;
+            }
+            if ((len & 0xC0) || offset + len > packetLen || pos + len + 1 >= HOSTNAME_MAX) return false;
+            for (int i = 0; i < len; i++) {
+                char c = (char)packet[offset + i];
+                out[pos++] = (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+            }
+            out[pos++] = '.';
+            offset += len;
+        }
+        return false;
+    }
+
+    // ---- Responses ----
 
-    static volatile bool g_gotResponse = false;
-    static volatile uint16_t g_currentId = 0;
-    static uint8_t g_responseBuffer[512];
-    static volatile int g_responseLen = 0;
+    static bool IsDnsServer(uint32_t ip) {
+        for (int i = 0; i < Net::MaxDnsServers; i++)
+            if (ip != 0 && Net::GetDnsServer(i) == ip) return true;
+        return false;
+    }
 
     static void DnsRecvCallback(uint32_t srcIp, uint16_t srcPort,
                                  uint16_t dstPort,
                                  const uint8_t* data, uint16_t length) {
-        (void)srcIp;
-        (void)srcPort;
         (void)dstPort;
+        if (srcPort != DNS_PORT || !IsDnsServer(srcIp) || length < 12) return;
+
+        char name[HOSTNAME_MAX];
+        if (!ReadQuestionName(data, length, name)) return;
+        DnsAnswer answer = ParseResponse(data, length);
+        if (!answer.usable) return;
+
+        uint16_t id = ((uint16_t)data[0] << 8) | data[1];
+        uint32_t ttl = answer.ttl;
+        if (answer.ip) {
+            if (ttl < MIN_TTL) ttl = MIN_TTL;
+            if (ttl > MAX_TTL) ttl = MAX_TTL;
+        }
 
-        if (g_gotResponse) return; // Already got a response
-        if (length > sizeof(g_responseBuffer)) length = sizeof(g_responseBuffer);
-
-        memcpy(g_responseBuffer, data, length);
-        g_responseLen = length;
-        g_gotResponse = true;
+        g_lock.Acquire();
+        // The first answer wins; the other servers' arrive to nothing
+        Pending* p = PendingFindLocked(name);
+        if (p && p->txId == id) {
+            CacheStoreLocked(p->hostname, answer.ip, ttl, Timekeeping::GetMilliseconds());
+            p->active = false;
+        }
+        g_lock.Release();
     }
 
-    // ---- Simple PRNG for transaction IDs ----
+    // ---- Transaction IDs ----
 
-    static uint16_t g_nextId = 0x4E53; // "NS"
+    // Unpredictable enough that an off-path host cannot guess them
+    static uint64_t g_idState = 0x4E53;
 
     static uint16_t NextId() {
-        g_nextId = g_nextId * 25173 + 13849;
-        return g_nextId;
+        uint64_t tsc;
+        asm volatile("rdtsc; shl $32, %%rdx; or %%rdx, %%rax" : "=a"(tsc) :: "rdx");
+        g_idState ^= tsc;
+        g_idState ^= g_idState >> 12;
+        g_idState ^= g_idState << 25;
+        g_idState ^= g_idState >> 27;
+        return (uint16_t)((g_idState * 0x2545F4914F6CDD1DULL) >> 48);
     }
 
     // ---- Check if string is already an IP address ----
@@ -305,73 +439,156 @@ namespace Net::Dns {
         return hasDigit && dotCount == 3;
     }
 
-    // ---- Public API ----
-
-    uint32_t Resolve(const char* hostname, uint32_t timeoutMs) {
-        if (hostname == nullptr || hostname[0] == '\0') return 0;
-
-        // Don't try to resolve IP addresses
-        if (IsIpAddress(hostname)) return 0;
+    // ---- Queries ----
 
-        // Check cache first
-        uint32_t cached = CacheLookup(hostname);
-        if (cached != 0) return cached;
+    // Send the query to every configured server
+    static bool SendQuery(const char* name, uint16_t txId) {
+        uint8_t queryPacket[512];
+        int queryLen = BuildQuery(txId, name, queryPacket, sizeof(queryPacket));
+        if (queryLen == 0) return false;
+
+        bool sent = false;
+        for (int i = 0; i < Net::MaxDnsServers; i++) {
+            uint32_t server = Net::GetDnsServer(i);
+            if (server == 0) continue;
+            bool dup = false;
+            for (int j = 0; j < i; j++) dup |= Net::GetDnsServer(j) == server;
+            if (dup) continue;
+            sent |= Net::Udp::Send(server, g_port, DNS_PORT, queryPacket, (uint16_t)queryLen);
+        }
+        return sent;
+    }
 
-        // Check DNS server is configured
-        uint32_t dnsServer = Net::GetDnsServer();
-        if (dnsServer == 0) return 0;
+    static bool EnsurePort() {
+        if (g_port != 0) return true;
+        for (int attempt = 0; attempt < 4; attempt++) {
+            uint16_t port = 10000 + (NextId() % 50000);
+            if (Net::Udp::Bind(port, DnsRecvCallback)) {
+                g_port = port;
+                return true;
+            }
+        }
+        return false;
+    }
 
-        // Pick a local port for receiving the response (ephemeral range)
-        uint16_t localPort = 10000 + (NextId() % 50000);
-        uint16_t txId = NextId();
+    enum class Status { Resolved, Failed, Pending };
 
-        // Build DNS query
-        uint8_t queryPacket[512];
-        int queryLen = BuildQuery(txId, hostname, queryPacket, sizeof(queryPacket));
-        if (queryLen == 0) return 0;
-
-        // Reset response state
-        g_gotResponse = false;
-        g_responseLen = 0;
-        g_currentId = txId;
-
-        // Bind our receive port
-        if (!Net::Udp::Bind(localPort, DnsRecvCallback)) {
-            // Port might be in use, try another
-            localPort = 10000 + (NextId() % 50000);
-            if (!Net::Udp::Bind(localPort, DnsRecvCallback)) {
-                return 0;
+    // One non-blocking step: answer from the cache, or start, retransmit
+    // or time out the query for `name` (lowercased)
+    static Status Step(const char* name, uint32_t* ip) {
+        uint64_t now = Timekeeping::GetMilliseconds();
+        Status status = Status::Pending;
+        bool send = false;
+        uint16_t txId = 0;
+
+        g_lock.Acquire();
+        CacheEntry* e = CacheFindLocked(name, now);
+        Pending* p = PendingFindLocked(name);
+        if (e) {
+            e->lastUsed = now;
+            e->hits++;
+            *ip = e->ip;
+            status = e->ip ? Status::Resolved : Status::Failed;
+
+            // Popular and about to expire: refresh it now, answer from
+            // the cache meanwhile
+            if (e->ip && !p && e->hits >= PREFETCH_HITS &&
+                (e->expires - now) * PREFETCH_FRACTION < (uint64_t)e->ttl * 1000) {
+                for (int i = 0; i < MAX_PENDING && !p; i++)
+                    if (!g_pending[i].active) p = &g_pending[i];
+                if (p) {
+                    memcpy(p->hostname, name, HOSTNAME_MAX);
+                    p->txId = NextId();
+                    p->started = p->sentAt = now;
+                    p->active = true;
+                    e->hits = 0;
+                    send = true;
+                    txId = p->txId;
+                }
+            }
+        } else if (p) {
+            if (now - p->started >= QUERY_TIMEOUT_MS) {
+                // Nobody answered: fail briefly rather than for every caller
+                p->active = false;
+                CacheStoreLocked(name, 0, FAIL_TTL, now);
+                status = Status::Failed;
+            } else if (now - p->sentAt >= RETRY_MS) {
+                p->sentAt = now;
+                send = true;
+                txId = p->txId;
+            }
+        } else {
+            for (int i = 0; i < MAX_PENDING && !p; i++)
+                if (!g_pending[i].active) p = &g_pending[i];
+            if (p) {
+                memcpy(p->hostname, name, HOSTNAME_MAX);
+                p->txId = NextId();
+                p->started = p->sentAt = now;
+                p->active = true;
+                send = true;
+                txId = p->txId;
             }
+            // With every slot busy, a later step tries again
         }
-
-        // Send the query to DNS server port 53
-        bool sent = Net::Udp::Send(dnsServer, localPort, DNS_PORT, queryPacket, (uint16_t)queryLen);
-        if (!sent) {
-            Net::Udp::Unbind(localPort);
-            return 0;
+        g_lock.Release();
+
+        if (send && !SendQuery(name, txId) && status == Status::Pending) {
+            // No server configured or reachable
+            g_lock.Acquire();
+            if (p && p->active && p->txId == txId) p->active = false;
+            g_lock.Release();
+            status = Status::Failed;
         }
+        return status;
+    }
+
+    // Common checks; false if the name cannot be looked up at all
+    static bool Prepare(const char* hostname, char* name, uint32_t* special) {
+        *special = 0;
+        if (hostname == nullptr || hostname[0] == '\0') return false;
+
+        // Don't try to resolve IP addresses
+        if (IsIpAddress(hostname)) return false;
+        if (!CopyName(name, hostname)) return false;
+
+        if (streq(name, "localhost")) { *special = Loopback::ADDRESS; return true; }
+        if (Net::GetDnsServer(0) == 0 && Net::GetDnsServer(1) == 0) return false;
+
+        g_lock.Acquire();
+        bool ok = EnsurePort();
+        g_lock.Release();
+        return ok;
+    }
+
+    // ---- Public API ----
+
+    uint32_t Resolve(const char* hostname, uint32_t timeoutMs) {
+        char name[HOSTNAME_MAX];
+        uint32_t special;
+        if (!Prepare(hostname, name, &special)) return 0;
+        if (special) return special;
 
-        // Wait for response with timeout
         uint64_t start = Timekeeping::GetMilliseconds();
-        while (!g_gotResponse) {
-            if (Timekeeping::GetMilliseconds() - start >= timeoutMs) {
-                Net::Udp::Unbind(localPort);
-                return 0;
-            }
+        for (;;) {
+            uint32_t ip = 0;
+            Status status = Step(name, &ip);
+            if (status == Status::Resolved) return ip;
+            if (status == Status::Failed) return 0;
+            if (Timekeeping::GetMilliseconds() - start >= timeoutMs) return 0;
             Sched::Schedule();
         }
+    }
 
-        // Unbind the port
-        Net::Udp::Unbind(localPort);
-
-        // Parse the response
-        DnsAnswer answer = ParseResponse(txId, g_responseBuffer, g_responseLen);
-        if (!answer.found) return 0;
-
-        // Cache the result
-        CacheStore(hostname, answer.ip, answer.ttl);
+    int64_t ResolveAsync(const char* hostname) {
+        char name[HOSTNAME_MAX];
+        uint32_t special;
+        if (!Prepare(hostname, name, &special)) return -1;
+        if (special) return special;
 
-        return answer.ip;
+        uint32_t ip = 0;
+        Status status = Step(name, &ip);
+        if (status == Status::Resolved) return ip;
+        return status == Status::Failed ? -1 : 0;
     }
 
 }
@@ -9,8 +9,13 @@
 
 namespace Net::Dns {
 
-    // Resolve a hostname to an IPv4 address.
+    // Resolve a hostname to an IPv4 address, waiting up to timeoutMs.
     // Returns the IP in network byte order, or 0 on failure.
     uint32_t Resolve(const char* hostname, uint32_t timeoutMs = 5000);
 
+    // Resolve without blocking: the IP if the name is cached, 0 while a
+    // query is in flight (starting one if needed), or -1 if the name does
+    // not resolve. Callers poll with the same name until it is not 0.
+    int64_t ResolveAsync(const char* hostname);
+
 }
@@ -13,6 +13,7 @@
 #include <Libraries/Memory.hpp>
 #include <Terminal/Terminal.hpp>
 #include <CppLib/Stream.hpp>
+#include <Common/Trace.hpp>
 
 using namespace Kt;
 
@@ -24,10 +25,17 @@ namespace Net::Ethernet {
         return Drivers::Net::E1000E::GetMacAddress();
     }
 
-    static bool ActiveNicSend(const uint8_t* data, uint16_t length) {
+    static bool ActiveNicSend(PacketBuffer* packet) {
         if (Drivers::Net::E1000::IsInitialized())
-            return Drivers::Net::E1000::SendPacket(data, length);
-        return Drivers::Net::E1000E::SendPacket(data, length);
+            return Drivers::Net::E1000::SendBuffer(packet);
+        return Drivers::Net::E1000E::SendBuffer(packet);
+    }
+
+    static bool ActiveNicSendOffload(const Drivers::Net::TxFragment* fragments, uint32_t count,
+                                     const Drivers::Net::TxOffload& off) {
+        if (Drivers::Net::E1000::IsInitialized())
+            return Drivers::Net::E1000::SendPacketOffload(fragments, count, off);
+        return Drivers::Net::E1000E::SendPacketOffload(fragments, count, off);
     }
 
     void Initialize() {
@@ -39,27 +47,78 @@ namespace Net::Ethernet {
             return false;
         }
 
-        uint8_t frame[MAX_FRAME_SIZE];
-        Header* hdr = (Header*)frame;
+        PacketBuffer* packet = PacketPool::AllocateCopy(payload, payloadLen);
+        if (packet == nullptr) {
+            return false;
+        }
+        bool sent = SendPacket(destMac, etherType, packet);
+        PacketPool::Release(packet);
+        return sent;
+    }
+
+    bool SendPacket(const uint8_t* destMac, uint16_t etherType, PacketBuffer* packet) {
+        if (packet->Length == 0 || packet->Length > MAX_PAYLOAD_SIZE || packet->Headroom() < HEADER_SIZE) {
+            return false;
+        }
 
+        Header* hdr = (Header*)packet->Push(HEADER_SIZE);
         memcpy(hdr->DestMac, destMac, 6);
         memcpy(hdr->SrcMac, GetActiveNicMac(), 6);
         hdr->EtherType = Htons(etherType);
 
-        memcpy(frame + HEADER_SIZE, payload, payloadLen);
+        Trace::Emit(Montauk::TRACE_NET, Montauk::TRACE_EV_NET_TX, etherType, packet->Length);
+        return ActiveNicSend(packet);
+    }
+
+    uint32_t Offloads() {
+        if (Drivers::Net::E1000::IsInitialized())
+            return Drivers::Net::E1000::GetOffloads();
+        if (Drivers::Net::E1000E::IsInitialized())
+            return Drivers::Net::E1000E::GetOffloads();
+        return 0;
+    }
+
+    bool SendOffload(const uint8_t* destMac, const Drivers::Net::TxFragment* fragments, uint32_t count,
+                     uint8_t ipHeaderLen, uint8_t headerLen, uint16_t mss) {
+        if (fragments == nullptr || count == 0 || count > MAX_OFFLOAD_FRAGMENTS) {
+            return false;
+        }
+
+        Header hdr;
+        memcpy(hdr.DestMac, destMac, 6);
+        memcpy(hdr.SrcMac, GetActiveNicMac(), 6);
+        hdr.EtherType = Htons(ETHERTYPE_IPV4);
 
-        uint16_t totalLen = HEADER_SIZE + payloadLen;
+        Drivers::Net::TxFragment frame[MAX_OFFLOAD_FRAGMENTS + 1];
+        frame[0] = {(const uint8_t*)&hdr, HEADER_SIZE};
+        for (uint32_t i = 0; i < count; i++) {
+            frame[i + 1] = fragments[i];
+        }
 
-        return ActiveNicSend(frame, totalLen);
+        Drivers::Net::TxOffload off;
+        off.IpOffset = HEADER_SIZE;
+        off.L4Offset = (uint8_t)(HEADER_SIZE + ipHeaderLen);
+        off.HeaderLen = (uint8_t)(HEADER_SIZE + headerLen);
+        off.Mss = mss;
+
+        if (Trace::On(Montauk::TRACE_NET)) {
+            uint64_t bytes = 0;
+            for (uint32_t i = 0; i < count + 1; i++) bytes += frame[i].Length;
+            Trace::Write(Montauk::TRACE_EV_NET_TX, ETHERTYPE_IPV4, bytes, 0);
+        }
+        return ActiveNicSendOffload(frame, count + 1, off);
     }
 
-    void OnFrameReceived(const uint8_t* data, uint16_t length) {
+    void OnFrameReceived(PacketBuffer* packet, uint8_t flags) {
+        const uint8_t* data = packet->Data;
+        uint16_t length = packet->Length;
         if (length < HEADER_SIZE) {
             return;
         }
 
         const Header* hdr = (const Header*)data;
         uint16_t etherType = Ntohs(hdr->EtherType);
+        Trace::Emit(Montauk::TRACE_NET, Montauk::TRACE_EV_NET_RX, etherType, length);
         const uint8_t* payload = data + HEADER_SIZE;
         uint16_t payloadLen = length - HEADER_SIZE;
 
@@ -68,7 +127,8 @@ namespace Net::Ethernet {
                 Arp::OnPacketReceived(payload, payloadLen);
                 break;
             case ETHERTYPE_IPV4:
-                Ipv4::OnPacketReceived(payload, payloadLen);
+                packet->Pull(HEADER_SIZE);
+                Ipv4::OnPacketReceived(packet, flags);
                 break;
             default:
                 break;
@@ -6,6 +6,8 @@
 
 #pragma once
 #include <cstdint>
+#include <Drivers/Net/Offload.hpp>
+#include <Net/PacketBuffer.hpp>
 
 namespace Net::Ethernet {
 
@@ -30,7 +32,28 @@ namespace Net::Ethernet {
     // Send an Ethernet frame with the given EtherType and payload
     bool Send(const uint8_t* destMac, uint16_t etherType, const uint8_t* payload, uint16_t payloadLen);
 
-    // Called by E1000 RX handler to dispatch received frames
-    void OnFrameReceived(const uint8_t* data, uint16_t length);
+    // Send the payload held in `packet` without copying it, pushing the
+    // Ethernet header into its headroom. The caller keeps its reference
+    // but must leave the packet alone from then on.
+    bool SendPacket(const uint8_t* destMac, uint16_t etherType, PacketBuffer* packet);
+
+    // Largest IPv4 packet SendOffload takes when segmenting
+    constexpr uint32_t MAX_OFFLOAD_SIZE = Drivers::Net::TSO_MAX_FRAME_SIZE - HEADER_SIZE;
+    constexpr uint32_t MAX_OFFLOAD_FRAGMENTS = 6;
+
+    // Drivers::Net::OFFLOAD_* bits of the active NIC
+    uint32_t Offloads();
+
+    // Send a TCP/IPv4 packet gathered from up to MAX_OFFLOAD_FRAGMENTS
+    // pieces, leaving checksums (and, with mss != 0, segmentation) to the
+    // NIC. `headerLen` covers the IPv4 and TCP headers.
+    bool SendOffload(const uint8_t* destMac, const Drivers::Net::TxFragment* fragments, uint32_t count,
+                     uint8_t ipHeaderLen, uint8_t headerLen, uint16_t mss);
+
+    // Called by the NIC RX handler to dispatch a received frame, with the
+    // Drivers::Net::RX_*_CSUM_OK flags for the checksums it verified. The
+    // driver releases its reference afterwards; layers that keep data
+    // take their own.
+    void OnFrameReceived(PacketBuffer* packet, uint8_t flags);
 
 }
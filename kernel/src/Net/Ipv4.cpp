@@ -11,6 +11,7 @@
 #include <Net/Icmp.hpp>
 #include <Net/Udp.hpp>
 #include <Net/Tcp.hpp>
+#include <Net/Loopback.hpp>
 #include <Net/NetConfig.hpp>
 #include <Libraries/Memory.hpp>
 #include <Terminal/Terminal.hpp>
@@ -22,18 +23,6 @@ namespace Net::Ipv4 {
 
     static uint16_t g_identification = 0;
 
-    // Deferred packet queue for packets awaiting ARP resolution
-    struct PendingPacket {
-        uint32_t DestIp;
-        uint8_t  Protocol;
-        uint8_t  Data[Ethernet::MAX_PAYLOAD_SIZE - HEADER_SIZE];
-        uint16_t Length;
-        bool     Active;
-    };
-
-    static constexpr uint32_t PENDING_QUEUE_SIZE = 8;
-    static PendingPacket g_pendingQueue[PENDING_QUEUE_SIZE] = {};
-
     void Initialize() {
         g_identification = 0;
         KernelLogStream(OK, "Net") << "IPv4 initialized, IP: "
@@ -66,6 +55,18 @@ namespace Net::Ipv4 {
         return (uint16_t)(~sum);
     }
 
+    uint16_t PseudoHeaderSum(uint32_t srcIp, uint32_t dstIp, uint8_t protocol, uint16_t length) {
+        uint32_t sum = (srcIp & 0xFFFF) + (srcIp >> 16)
+                     + (dstIp & 0xFFFF) + (dstIp >> 16)
+                     + Htons(protocol) + Htons(length);
+
+        while (sum >> 16) {
+            sum = (sum & 0xFFFF) + (sum >> 16);
+        }
+
+        return (uint16_t)sum;
+    }
+
     uint16_t PseudoHeaderChecksum(uint32_t srcIp, uint32_t dstIp, uint8_t protocol,
                                    uint16_t length, const void* data, uint16_t dataLen) {
         uint32_t sum = 0;
@@ -96,7 +97,9 @@ namespace Net::Ipv4 {
         return (uint16_t)(~sum);
     }
 
-    void OnPacketReceived(const uint8_t* data, uint16_t length) {
+    void OnPacketReceived(PacketBuffer* packet, uint8_t flags) {
+        const uint8_t* data = packet->Data;
+        uint16_t length = packet->Length;
         if (length < HEADER_SIZE) {
             return;
         }
@@ -115,8 +118,8 @@ namespace Net::Ipv4 {
             return;
         }
 
-        // Verify checksum
-        if (Checksum(data, ihl) != 0) {
+        // Verify checksum, unless the NIC already did
+        if (!(flags & Drivers::Net::RX_IP_CSUM_OK) && Checksum(data, ihl) != 0) {
             return;
         }
 
@@ -125,98 +128,148 @@ namespace Net::Ipv4 {
             return;
         }
 
-        // Check destination: accept packets addressed to us or broadcast
+        // Check destination: accept packets addressed to us or broadcast,
+        // and loopback addresses only from the loopback interface
         uint32_t ourIp = GetIpAddress();
-        if (hdr->DstIp != ourIp && hdr->DstIp != 0xFFFFFFFF) {
+        bool loopback = (flags & RX_LOOPBACK) && Loopback::IsLocal(hdr->DstIp);
+        if (hdr->DstIp != ourIp && hdr->DstIp != 0xFFFFFFFF && !loopback) {
             return;
         }
 
         const uint8_t* payload = data + ihl;
         uint16_t payloadLen = totalLen - ihl;
+        bool checksumOk = (flags & Drivers::Net::RX_L4_CSUM_OK) != 0;
 
         switch (hdr->Protocol) {
             case PROTO_ICMP:
                 Icmp::OnPacketReceived(hdr->SrcIp, payload, payloadLen);
                 break;
             case PROTO_UDP:
-                Udp::OnPacketReceived(hdr->SrcIp, hdr->DstIp, payload, payloadLen);
+                Udp::OnPacketReceived(hdr->SrcIp, hdr->DstIp, payload, payloadLen, checksumOk);
                 break;
             case PROTO_TCP:
-                Tcp::OnPacketReceived(hdr->SrcIp, hdr->DstIp, payload, payloadLen);
+                packet->Length = totalLen;
+                packet->Pull(ihl);
+                Tcp::OnPacketReceived(hdr->SrcIp, hdr->DstIp, packet, checksumOk);
                 break;
             default:
                 break;
         }
     }
 
-    // Build and send an IP packet over Ethernet (MAC already resolved)
-    static bool SendDirect(uint32_t destIp, uint8_t protocol, const uint8_t* destMac,
-                           const uint8_t* payload, uint16_t payloadLen) {
-        uint8_t packet[Ethernet::MAX_PAYLOAD_SIZE];
-        Header* hdr = (Header*)packet;
+    uint16_t MaxPayload(uint32_t destIp) {
+        uint32_t mtu = Loopback::IsLocal(destIp) ? Loopback::MTU : Ethernet::MAX_PAYLOAD_SIZE;
+        return (uint16_t)(mtu - HEADER_SIZE);
+    }
+
+    uint32_t SourceFor(uint32_t destIp) {
+        // Talking to 127.x.x.x, we are that address
+        if ((destIp & 0xFF) == 127) return destIp;
+        return GetIpAddress();
+    }
+
+    bool NeedsChecksum(uint32_t destIp) {
+        return !Loopback::IsLocal(destIp);
+    }
+
+    bool SendPacket(uint32_t destIp, uint8_t protocol, PacketBuffer* packet) {
+        bool local = Loopback::IsLocal(destIp);
+        if (packet->Length > MaxPayload(destIp) ||
+            packet->Headroom() < HEADER_SIZE + Ethernet::HEADER_SIZE) {
+            return false;
+        }
+
+        uint16_t payloadLen = packet->Length;
+        Header* hdr = (Header*)packet->Push(HEADER_SIZE);
 
         hdr->VersionIhl = (4 << 4) | 5; // IPv4, 5 dwords (20 bytes)
         hdr->Tos = 0;
         hdr->TotalLength = Htons(HEADER_SIZE + payloadLen);
-        hdr->Identification = Htons(g_identification++);
+        hdr->Identification = Htons(__atomic_fetch_add(&g_identification, 1, __ATOMIC_RELAXED));
         hdr->FlagsFragment = 0;
         hdr->Ttl = DEFAULT_TTL;
         hdr->Protocol = protocol;
         hdr->Checksum = 0;
-        hdr->SrcIp = GetIpAddress();
+        hdr->SrcIp = SourceFor(destIp);
         hdr->DstIp = destIp;
 
-        hdr->Checksum = Checksum(hdr, HEADER_SIZE);
+        if (local) {
+            return Loopback::Send(packet);
+        }
 
-        memcpy(packet + HEADER_SIZE, payload, payloadLen);
+        hdr->Checksum = Checksum(hdr, HEADER_SIZE);
 
-        return Ethernet::Send(destMac, Ethernet::ETHERTYPE_IPV4, packet, HEADER_SIZE + payloadLen);
+        // Sent now, or held by the next hop's neighbor entry until it resolves
+        return Arp::Output(GetNextHop(destIp), packet);
     }
 
     bool Send(uint32_t destIp, uint8_t protocol, const uint8_t* payload, uint16_t payloadLen) {
-        if (payloadLen > (Ethernet::MAX_PAYLOAD_SIZE - HEADER_SIZE)) {
+        if (payloadLen > MaxPayload(destIp)) {
             return false;
         }
 
-        // Determine next-hop IP and resolve MAC
-        uint32_t nextHop = GetNextHop(destIp);
-        uint8_t destMac[6];
-
-        if (Arp::Resolve(nextHop, destMac)) {
-            return SendDirect(destIp, protocol, destMac, payload, payloadLen);
+        PacketBuffer* packet = PacketPool::AllocateCopy(payload, payloadLen);
+        if (packet == nullptr) {
+            return false;
         }
+        bool sent = SendPacket(destIp, protocol, packet);
+        PacketPool::Release(packet);
+        return sent;
+    }
+
+    uint32_t Offloads(uint32_t destIp) {
+        if (Loopback::IsLocal(destIp)) return 0;
+        return Ethernet::Offloads();
+    }
 
-        // ARP request already sent by Resolve(), queue the packet for later
-        for (uint32_t i = 0; i < PENDING_QUEUE_SIZE; i++) {
-            if (!g_pendingQueue[i].Active) {
-                g_pendingQueue[i].DestIp = destIp;
-                g_pendingQueue[i].Protocol = protocol;
-                g_pendingQueue[i].Length = payloadLen;
-                memcpy(g_pendingQueue[i].Data, payload, payloadLen);
-                g_pendingQueue[i].Active = true;
-                return true;
-            }
+    bool SendTcpOffload(uint32_t destIp, const Drivers::Net::TxFragment* fragments, uint32_t count,
+                        uint16_t tcpHeaderLen, uint16_t mss) {
+        if (count == 0 || count >= Ethernet::MAX_OFFLOAD_FRAGMENTS) {
+            return false;
         }
 
-        // Queue full, drop the packet
-        return false;
-    }
+        uint32_t tcpLen = 0;
+        for (uint32_t i = 0; i < count; i++) {
+            tcpLen += fragments[i].Length;
+        }
+        uint32_t limit = mss != 0 ? Ethernet::MAX_OFFLOAD_SIZE : Ethernet::MAX_PAYLOAD_SIZE;
+        if (HEADER_SIZE + tcpLen > limit) {
+            return false;
+        }
 
-    void FlushPending() {
-        for (uint32_t i = 0; i < PENDING_QUEUE_SIZE; i++) {
-            if (!g_pendingQueue[i].Active) {
-                continue;
-            }
+        uint8_t destMac[6];
+        if (!Arp::Resolve(GetNextHop(destIp), destMac)) {
+            return false;
+        }
 
-            uint32_t nextHop = GetNextHop(g_pendingQueue[i].DestIp);
-            uint8_t destMac[6];
+        // The NIC fills in the header checksum and, when segmenting, the
+        // total length and an incrementing ID for each segment
+        Header hdr;
+        hdr.VersionIhl = (4 << 4) | 5;
+        hdr.Tos = 0;
+        hdr.TotalLength = Htons((uint16_t)(HEADER_SIZE + tcpLen));
+        hdr.FlagsFragment = 0;
+        hdr.Ttl = DEFAULT_TTL;
+        hdr.Protocol = PROTO_TCP;
+        hdr.Checksum = 0;
+        hdr.SrcIp = GetIpAddress();
+        hdr.DstIp = destIp;
+
+        uint32_t segments = 1;
+        if (mss != 0) {
+            segments = (tcpLen - tcpHeaderLen + mss - 1) / mss;
+        }
+        // Each segment takes an ID; the queues may send from several CPUs
+        hdr.Identification = Htons(__atomic_fetch_add(&g_identification, (uint16_t)segments, __ATOMIC_RELAXED));
 
-            if (Arp::Resolve(nextHop, destMac)) {
-                SendDirect(g_pendingQueue[i].DestIp, g_pendingQueue[i].Protocol,
-                           destMac, g_pendingQueue[i].Data, g_pendingQueue[i].Length);
-                g_pendingQueue[i].Active = false;
-            }
+        Drivers::Net::TxFragment packet[Ethernet::MAX_OFFLOAD_FRAGMENTS];
+        packet[0] = {(const uint8_t*)&hdr, HEADER_SIZE};
+        for (uint32_t i = 0; i < count; i++) {
+            packet[i + 1] = fragments[i];
         }
+
+        return Ethernet::SendOffload(destMac, packet, count + 1, HEADER_SIZE,
+                                     (uint8_t)(HEADER_SIZE + tcpHeaderLen), mss);
     }
 
 }
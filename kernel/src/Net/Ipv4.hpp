@@ -6,6 +6,8 @@
 
 #pragma once
 #include <cstdint>
+#include <Drivers/Net/Offload.hpp>
+#include <Net/PacketBuffer.hpp>
 
 namespace Net::Ipv4 {
 
@@ -17,6 +19,10 @@ namespace Net::Ipv4 {
 
     constexpr uint16_t HEADER_SIZE = 20; // Without options
 
+    // OnPacketReceived flag, next to the Drivers::Net RX_*_CSUM_OK ones:
+    // the packet came over the loopback interface
+    constexpr uint8_t RX_LOOPBACK = (1 << 7);
+
     struct Header {
         uint8_t  VersionIhl;     // Version (4 bits) + IHL (4 bits)
         uint8_t  Tos;            // Type of Service
@@ -33,20 +39,52 @@ namespace Net::Ipv4 {
     // Initialize the IPv4 subsystem
     void Initialize();
 
-    // Handle an incoming IP packet (called by Ethernet layer)
-    void OnPacketReceived(const uint8_t* data, uint16_t length);
+    // Handle an incoming IP packet, the contents of `packet` (called by
+    // Ethernet layer), with the RX_*_CSUM_OK flags for the checksums the
+    // NIC already verified
+    void OnPacketReceived(PacketBuffer* packet, uint8_t flags);
 
     // Send an IP packet with the given protocol and payload.
     // If ARP resolution is pending, the packet is queued and sent when the reply arrives.
     bool Send(uint32_t destIp, uint8_t protocol, const uint8_t* payload, uint16_t payloadLen);
 
-    // Flush any packets that were waiting for ARP resolution.
-    // Called by the ARP layer when a new cache entry is inserted.
-    void FlushPending();
+    // Send the payload held in `packet`, pushing the IP header into its
+    // headroom. The caller keeps its reference but must leave the packet
+    // alone from then on: the NIC, or the queue waiting for ARP, may
+    // still be reading it.
+    bool SendPacket(uint32_t destIp, uint8_t protocol, PacketBuffer* packet);
+
+    // Drivers::Net::OFFLOAD_* bits usable for packets to `destIp` (none
+    // over loopback, which needs neither)
+    uint32_t Offloads(uint32_t destIp);
+
+    // Largest payload of a packet to `destIp`: the interface MTU less the
+    // IP header
+    uint16_t MaxPayload(uint32_t destIp);
+
+    // The source address of packets to `destIp`
+    uint32_t SourceFor(uint32_t destIp);
+
+    // Whether packets to `destIp` need a transport checksum (loopback
+    // ones are never checked)
+    bool NeedsChecksum(uint32_t destIp);
+
+    // Send a TCP segment gathered from `count` fragments, the first of
+    // which holds its `tcpHeaderLen`-byte header, leaving the checksums to
+    // the NIC; the TCP checksum field must hold PseudoHeaderSum(). With
+    // mss != 0 the NIC also cuts the payload into mss-sized segments.
+    // Returns false, sending nothing, if the next hop is not resolved yet.
+    bool SendTcpOffload(uint32_t destIp, const Drivers::Net::TxFragment* fragments, uint32_t count,
+                        uint16_t tcpHeaderLen, uint16_t mss);
 
     // Compute the Internet checksum over a buffer
     uint16_t Checksum(const void* data, uint16_t length);
 
+    // Folded, uncomplemented sum of the TCP/UDP pseudo-header alone: what
+    // checksum offload expects in the checksum field (with length 0 when
+    // the NIC segments)
+    uint16_t PseudoHeaderSum(uint32_t srcIp, uint32_t dstIp, uint8_t protocol, uint16_t length);
+
     // Compute TCP/UDP pseudo-header checksum
     uint16_t PseudoHeaderChecksum(uint32_t srcIp, uint32_t dstIp, uint8_t protocol,
                                    uint16_t length, const void* data, uint16_t dataLen);
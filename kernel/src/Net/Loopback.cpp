@@ -0,0 +1,83 @@
+/*
+    * Loopback.cpp
+    * Loopback interface: IPv4 packets between local sockets
+    * Copyright (c) 2026 Daniel Hammer
+*/
+
+#include "Loopback.hpp"
+#include <Net/Ipv4.hpp>
+#include <Net/NetConfig.hpp>
+#include <CppLib/Spinlock.hpp>
+#include <Terminal/Terminal.hpp>
+#include <CppLib/Stream.hpp>
+
+using namespace Kt;
+
+namespace Net::Loopback {
+
+    // Packets delivered per pass, so the timer tick stays short
+    static constexpr uint32_t POLL_BUDGET = 64;
+
+    static PacketBuffer* g_queue[QUEUE_SIZE] = {};
+    static uint32_t g_head = 0;
+    static uint32_t g_count = 0;
+    static kcp::Spinlock g_queueLock;
+
+    // Held while delivering, so packets arrive in the order they were sent
+    static kcp::Spinlock g_deliverLock;
+
+    void Initialize() {
+        g_head = 0;
+        g_count = 0;
+        KernelLogStream(OK, "Net") << "Loopback initialized, MTU " << base::dec << (uint64_t)MTU;
+    }
+
+    bool IsLocal(uint32_t ip) {
+        if ((ip & 0xFF) == 127) return true;
+        return ip != 0 && ip == GetIpAddress();
+    }
+
+    bool Send(PacketBuffer* packet) {
+        g_queueLock.Acquire();
+        if (g_count == QUEUE_SIZE) {
+            g_queueLock.Release();
+            return false;
+        }
+        PacketPool::Retain(packet);
+        g_queue[(g_head + g_count) % QUEUE_SIZE] = packet;
+        g_count++;
+        g_queueLock.Release();
+        return true;
+    }
+
+    static PacketBuffer* Dequeue() {
+        g_queueLock.Acquire();
+        PacketBuffer* packet = nullptr;
+        if (g_count > 0) {
+            packet = g_queue[g_head];
+            g_head = (g_head + 1) % QUEUE_SIZE;
+            g_count--;
+        }
+        g_queueLock.Release();
+        return packet;
+    }
+
+    void Poll() {
+        // Whoever holds the lock delivers; packets queued just as it
+        // finishes wait for the next call
+        if (g_count == 0 || !g_deliverLock.TryAcquire()) {
+            return;
+        }
+
+        for (uint32_t i = 0; i < POLL_BUDGET; i++) {
+            PacketBuffer* packet = Dequeue();
+            if (packet == nullptr) break;
+            Ipv4::OnPacketReceived(packet, Drivers::Net::RX_IP_CSUM_OK | Drivers::Net::RX_L4_CSUM_OK |
+                                           Ipv4::RX_LOOPBACK);
+            PacketPool::Release(packet);
+        }
+
+        g_deliverLock.Release();
+    }
+
+}
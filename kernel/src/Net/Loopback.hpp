@@ -0,0 +1,38 @@
+/*
+    * Loopback.hpp
+    * Loopback interface: IPv4 packets between local sockets
+    * Copyright (c) 2026 Daniel Hammer
+*/
+
+#pragma once
+#include <cstdint>
+#include <Net/PacketBuffer.hpp>
+
+namespace Net::Loopback {
+
+    // Packets for 127.0.0.0/8 and for our own address never reach a NIC:
+    // IPv4 hands them here and they are received again from the queue,
+    // in the same buffer. Checksums are neither computed nor checked.
+    constexpr uint32_t MTU = PACKET_BUFFER_LARGE_SIZE - PACKET_HEADROOM;
+
+    constexpr uint32_t QUEUE_SIZE = 256;
+
+    // 127.0.0.1, in network byte order
+    constexpr uint32_t ADDRESS = 0x0100007F;
+
+    void Initialize();
+
+    // Whether packets for `ip` go over the loopback interface
+    bool IsLocal(uint32_t ip);
+
+    // Queue an IPv4 packet (header included) for delivery, taking a
+    // reference. Returns false if the queue is full.
+    bool Send(PacketBuffer* packet);
+
+    // Deliver queued packets. Never called with a connection lock held,
+    // since delivery may answer (ACKs) into the connection that sent:
+    // the socket layer calls it on the way out of each call, and the
+    // timer tick catches the rest.
+    void Poll();
+
+}
@@ -12,6 +12,7 @@
 #include <Net/Udp.hpp>
 #include <Net/Tcp.hpp>
 #include <Net/Socket.hpp>
+#include <Net/Loopback.hpp>
 #include <Net/NetConfig.hpp>
 #include <Drivers/Net/E1000.hpp>
 #include <Drivers/Net/E1000E.hpp>
@@ -23,12 +24,14 @@ using namespace Kt;
 namespace Net {
 
     void Initialize() {
-        if (!Drivers::Net::E1000::IsInitialized() && !Drivers::Net::E1000E::IsInitialized()) {
-            KernelLogStream(WARNING, "Net") << "No NIC initialized, skipping network stack";
-            return;
+        // Without a NIC the stack still runs, over loopback only
+        bool haveNic = Drivers::Net::E1000::IsInitialized() || Drivers::Net::E1000E::IsInitialized();
+        if (!haveNic) {
+            KernelLogStream(WARNING, "Net") << "No NIC initialized, loopback only";
         }
 
         // Initialize layers bottom-up
+        Loopback::Initialize();
         Ethernet::Initialize();
         Arp::Initialize();
         Ipv4::Initialize();
@@ -37,6 +40,11 @@ namespace Net {
         Tcp::Initialize();
         Socket::Initialize();
 
+        if (!haveNic) {
+            KernelLogStream(OK, "Net") << "Network stack initialized";
+            return;
+        }
+
         // Hook the active NIC's RX to our Ethernet dispatcher
         if (Drivers::Net::E1000::IsInitialized()) {
             Drivers::Net::E1000::SetRxCallback(Ethernet::OnFrameReceived);
@@ -12,7 +12,7 @@ namespace Net {
     static uint32_t g_ipAddress  = 0;
     static uint32_t g_subnetMask = 0;
     static uint32_t g_gateway    = 0;
-    static uint32_t g_dnsServer  = 0;
+    static uint32_t g_dnsServers[MaxDnsServers] = {};
 
     uint32_t GetIpAddress() { return g_ipAddress; }
     void SetIpAddress(uint32_t ip) { g_ipAddress = ip; }
@@ -23,8 +23,12 @@ namespace Net {
     uint32_t GetGateway() { return g_gateway; }
     void SetGateway(uint32_t gw) { g_gateway = gw; }
 
-    uint32_t GetDnsServer() { return g_dnsServer; }
-    void SetDnsServer(uint32_t dns) { g_dnsServer = dns; }
+    uint32_t GetDnsServer(int index) {
+        return (index >= 0 && index < MaxDnsServers) ? g_dnsServers[index] : 0;
+    }
+    void SetDnsServer(uint32_t dns, int index) {
+        if (index >= 0 && index < MaxDnsServers) g_dnsServers[index] = dns;
+    }
 
     bool IsLocalSubnet(uint32_t destIp) {
         return (destIp & g_subnetMask) == (g_ipAddress & g_subnetMask);
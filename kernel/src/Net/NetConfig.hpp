@@ -27,9 +27,11 @@ namespace Net {
     uint32_t GetGateway();
     void SetGateway(uint32_t gw);
 
-    // Get/set the DNS server (network byte order)
-    uint32_t GetDnsServer();
-    void SetDnsServer(uint32_t dns);
+    // Get/set the DNS servers (network byte order, 0 = none). Queries
+    // go to all of them at once.
+    constexpr int MaxDnsServers = 2;
+    uint32_t GetDnsServer(int index = 0);
+    void SetDnsServer(uint32_t dns, int index = 0);
 
     // Check if a destination IP is on the local subnet
     bool IsLocalSubnet(uint32_t destIp);
@@ -0,0 +1,108 @@
+/*
+    * PacketBuffer.cpp
+    * Reference-counted packet buffers shared by the NIC drivers and the stack
+    * Copyright (c) 2026 Daniel Hammer
+*/
+
+#include "PacketBuffer.hpp"
+#include <Memory/HHDM.hpp>
+#include <Memory/PageFrameAllocator.hpp>
+#include <Libraries/Memory.hpp>
+#include <CppLib/Spinlock.hpp>
+
+namespace Net::PacketPool {
+
+    static constexpr uint32_t BUFFERS_PER_PAGE = 0x1000 / PACKET_BUFFER_SIZE;
+    static constexpr uint32_t PAGES_PER_LARGE = PACKET_BUFFER_LARGE_SIZE / 0x1000;
+
+    // One free list per size
+    struct Class {
+        PacketBuffer* Buffers;
+        uint32_t      Max;
+        uint32_t      Count;      // Buffers with storage
+        PacketBuffer* Free;
+        uint32_t      FreeCount;
+    };
+
+    static PacketBuffer g_buffers[MAX_BUFFERS] = {};
+    static PacketBuffer g_largeBuffers[MAX_LARGE_BUFFERS] = {};
+    static Class g_normal = { g_buffers, MAX_BUFFERS, 0, nullptr, 0 };
+    static Class g_large = { g_largeBuffers, MAX_LARGE_BUFFERS, 0, nullptr, 0 };
+    static kcp::Spinlock g_lock;
+
+    static void PushFreeLocked(Class& c, PacketBuffer* b) {
+        b->Next = c.Free;
+        c.Free = b;
+        c.FreeCount++;
+    }
+
+    // Give storage to another page's worth of normal buffers, or to one
+    // large buffer. Lock held.
+    static bool GrowLocked(Class& c) {
+        bool large = &c == &g_large;
+        uint32_t count = large ? 1 : BUFFERS_PER_PAGE;
+        uint32_t size = large ? PACKET_BUFFER_LARGE_SIZE : PACKET_BUFFER_SIZE;
+        if (c.Count + count > c.Max) return false;
+
+        uint8_t* mem = large ? (uint8_t*)Memory::g_pfa->AllocateContiguous(PAGES_PER_LARGE)
+                             : (uint8_t*)Memory::g_pfa->Allocate();
+        if (mem == nullptr) return false;
+        uint64_t phys = Memory::SubHHDM(mem);
+
+        for (uint32_t i = 0; i < count; i++) {
+            PacketBuffer* b = &c.Buffers[c.Count++];
+            b->Head = mem + i * size;
+            b->Phys = phys + i * size;
+            b->Size = size;
+            PushFreeLocked(c, b);
+        }
+        return true;
+    }
+
+    PacketBuffer* Allocate(uint32_t length) {
+        Class& c = PACKET_HEADROOM + length > PACKET_BUFFER_SIZE ? g_large : g_normal;
+        if (PACKET_HEADROOM + length > PACKET_BUFFER_LARGE_SIZE) return nullptr;
+
+        g_lock.Acquire();
+        if (c.Free == nullptr && !GrowLocked(c)) {
+            g_lock.Release();
+            return nullptr;
+        }
+        PacketBuffer* b = c.Free;
+        c.Free = b->Next;
+        c.FreeCount--;
+        g_lock.Release();
+
+        b->Data = b->Head + PACKET_HEADROOM;
+        b->Length = 0;
+        b->Seq = 0;
+        b->Next = nullptr;
+        b->Refs.store(1, std::memory_order_relaxed);
+        return b;
+    }
+
+    PacketBuffer* AllocateCopy(const uint8_t* data, uint16_t length) {
+        PacketBuffer* b = Allocate(length);
+        if (b == nullptr) return nullptr;
+        memcpy(b->Data, data, length);
+        b->Length = length;
+        return b;
+    }
+
+    void Retain(PacketBuffer* buffer) {
+        buffer->Refs.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void Release(PacketBuffer* buffer) {
+        if (buffer->Refs.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+
+        g_lock.Acquire();
+        PushFreeLocked(buffer->Size == PACKET_BUFFER_SIZE ? g_normal : g_large, buffer);
+        g_lock.Release();
+    }
+
+    uint32_t Available() {
+        return g_normal.FreeCount + (MAX_BUFFERS - g_normal.Count);
+    }
+
+}
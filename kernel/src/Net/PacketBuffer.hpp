@@ -0,0 +1,83 @@
+/*
+    * PacketBuffer.hpp
+    * Reference-counted packet buffers shared by the NIC drivers and the stack
+    * Copyright (c) 2026 Daniel Hammer
+*/
+
+#pragma once
+#include <cstdint>
+#include <atomic>
+
+namespace Net {
+
+    // A packet buffer is a DMA-able BUFFER_SIZE block plus a header saying
+    // where in it the packet currently starts. Received frames are written
+    // by the NIC straight into one and handed up the stack; a layer that
+    // wants to keep the data (TCP) takes a reference instead of copying.
+    // Outgoing packets are built from the top: each layer pushes its header
+    // into the headroom in front of the data, and the driver sends the
+    // buffer without copying, dropping its reference once the NIC is done.
+    constexpr uint32_t PACKET_BUFFER_SIZE = 2048;
+    constexpr uint32_t PACKET_HEADROOM = 128;    // Ethernet + IPv4 + TCP with options
+
+    // Large buffers carry the packets of the loopback interface
+    constexpr uint32_t PACKET_BUFFER_LARGE_SIZE = 16384;
+
+    struct PacketBuffer {
+        uint8_t*      Head;     // Start of the storage
+        uint64_t      Phys;     // Physical address of Head
+        uint32_t      Size;     // Bytes of storage
+        uint8_t*      Data;     // Start of the packet
+        uint16_t      Length;   // Bytes from Data on
+        uint32_t      Seq;      // TCP: sequence number of Data
+        PacketBuffer* Next;     // Free list, or the queue of a sole owner
+        std::atomic<uint32_t> Refs;
+
+        // Room in front of Data, and behind Data + Length
+        uint32_t Headroom() const { return (uint32_t)(Data - Head); }
+        uint32_t Tailroom() const { return Size - Headroom() - Length; }
+
+        // Physical address of Data, for DMA
+        uint64_t DataPhys() const { return Phys + Headroom(); }
+
+        // Prepend `len` bytes (a header) to the packet, returning where they go
+        uint8_t* Push(uint16_t len) {
+            Data -= len;
+            Length += len;
+            return Data;
+        }
+
+        // Drop `len` bytes from the front
+        void Pull(uint16_t len) {
+            Data += len;
+            Length -= len;
+        }
+    };
+
+}
+
+namespace Net::PacketPool {
+
+    // The pool grows a page at a time, up to MAX_BUFFERS (and
+    // MAX_LARGE_BUFFERS large ones), and buffers never go back to the page
+    // allocator. All calls are safe from interrupt context.
+    constexpr uint32_t MAX_BUFFERS = 4096;
+    constexpr uint32_t MAX_LARGE_BUFFERS = 256;
+
+    // A buffer with one reference and PACKET_HEADROOM in front of an
+    // empty packet, with room for `length` bytes (a large buffer if they
+    // do not fit a normal one), or nullptr if the pool is exhausted
+    PacketBuffer* Allocate(uint32_t length = 0);
+
+    // A buffer holding a copy of `data`, after the headroom
+    PacketBuffer* AllocateCopy(const uint8_t* data, uint16_t length);
+
+    void Retain(PacketBuffer* buffer);
+
+    // Drop a reference; the last one returns the buffer to the pool
+    void Release(PacketBuffer* buffer);
+
+    // Normal buffers that can still be allocated without exhausting the pool
+    uint32_t Available();
+
+}
@@ -11,6 +11,10 @@
 #include <Terminal/Terminal.hpp>
 #include <CppLib/Stream.hpp>
 #include <Libraries/Memory.hpp>
+#include <Sched/Scheduler.hpp>
+#include <Memory/PageFrameAllocator.hpp>
+#include <CppLib/Spinlock.hpp>
+#include <atomic>
 
 using namespace Kt;
 
@@ -18,7 +22,16 @@ namespace Net::Socket {
 
     // ---- UDP socket state ----
 
-    static constexpr uint32_t UDP_RING_SIZE = 4096;
+    // Each UDP socket queues datagrams (a header, then the payload) in a
+    // ring of its own. The NIC interrupt is the only producer and readers
+    // are serialized among themselves, so both ends run without excluding
+    // each other; the spinlock only keeps the producer away while the
+    // ring is swapped for one of another size.
+    static constexpr uint32_t UDP_RING_DEFAULT = 4096;
+    static constexpr uint32_t UDP_RING_MIN     = 4096;
+    static constexpr uint32_t UDP_RING_MAX     = 1024 * 1024;
+    static constexpr uint32_t UDP_QLEN_DEFAULT = 256;
+    static constexpr uint32_t UDP_QLEN_MAX     = 4096;
     static constexpr int MAX_UDP_SOCKETS = 16;
 
     struct UdpDgramHeader {
@@ -28,10 +41,16 @@ namespace Net::Socket {
     };
 
     struct UdpSocketState {
-        uint8_t  Ring[UDP_RING_SIZE];
-        uint32_t Head;
-        uint32_t Tail;
-        uint32_t Count;
+        uint8_t* Ring;
+        uint32_t Size;                  // ring bytes, a power of two
+        uint32_t MaxQueued;             // queue depth in datagrams
+        std::atomic<uint32_t> Head;     // bytes ever dequeued (free-running)
+        std::atomic<uint32_t> Tail;     // bytes ever queued
+        std::atomic<uint32_t> Received; // Datagrams ever queued
+        std::atomic<uint32_t> Consumed; // Datagrams ever dequeued
+        uint64_t Dropped;               // Datagrams lost to a full queue
+        kcp::Spinlock Lock;
+        kcp::Mutex    ReadLock;
         uint16_t LocalPort;
         bool     Active;
     };
@@ -53,15 +72,33 @@ namespace Net::Socket {
         return true;
     }
 
+    static uint8_t* AllocRing(uint32_t size) {
+        return (uint8_t*)Memory::g_pfa->AllocateContiguous((int)(size / 0x1000));
+    }
+
+    static void FreeRing(uint8_t* ring, uint32_t size) {
+        if (ring) Memory::g_pfa->Free(ring, (int)(size / 0x1000));
+    }
+
     static UdpSocketState* AllocUdpState() {
         for (int i = 0; i < MAX_UDP_SOCKETS; i++) {
-            if (!g_udpSockets[i].Active) {
-                g_udpSockets[i].Active = true;
-                g_udpSockets[i].Head = 0;
-                g_udpSockets[i].Tail = 0;
-                g_udpSockets[i].Count = 0;
-                g_udpSockets[i].LocalPort = 0;
-                return &g_udpSockets[i];
+            UdpSocketState* st = &g_udpSockets[i];
+            if (!st->Active) {
+                uint8_t* ring = AllocRing(UDP_RING_DEFAULT);
+                if (!ring) return nullptr;
+                st->Lock.Acquire();
+                st->Ring = ring;
+                st->Size = UDP_RING_DEFAULT;
+                st->MaxQueued = UDP_QLEN_DEFAULT;
+                st->Head = 0;
+                st->Tail = 0;
+                st->Received = 0;
+                st->Consumed = 0;
+                st->Dropped = 0;
+                st->LocalPort = 0;
+                st->Active = true;
+                st->Lock.Release();
+                return st;
             }
         }
         return nullptr;
@@ -72,43 +109,123 @@ namespace Net::Socket {
             if (state->LocalPort != 0) {
                 Udp::Unbind(state->LocalPort);
             }
+            state->ReadLock.Acquire();
+            state->Lock.Acquire();
+            uint8_t* ring = state->Ring;
+            uint32_t size = state->Size;
+            state->Ring = nullptr;
             state->Active = false;
+            state->Lock.Release();
+            state->ReadLock.Release();
+            FreeRing(ring, size);
         }
     }
 
+    // Copy into/out of the ring at free-running position `pos`, wrapping
+    static void RingPut(UdpSocketState* st, uint32_t pos, const void* src, uint32_t len) {
+        uint32_t off = pos & (st->Size - 1);
+        uint32_t first = st->Size - off < len ? st->Size - off : len;
+        memcpy(st->Ring + off, src, first);
+        memcpy(st->Ring, (const uint8_t*)src + first, len - first);
+    }
+
+    static void RingGet(const UdpSocketState* st, uint32_t pos, void* dst, uint32_t len) {
+        uint32_t off = pos & (st->Size - 1);
+        uint32_t first = st->Size - off < len ? st->Size - off : len;
+        memcpy(dst, st->Ring + off, first);
+        memcpy((uint8_t*)dst + first, st->Ring, len - first);
+    }
+
     static void UdpSocketDispatcher(uint32_t srcIp, uint16_t srcPort,
                                      uint16_t dstPort,
                                      const uint8_t* data, uint16_t length) {
         for (int i = 0; i < MAX_UDP_SOCKETS; i++) {
             if (g_udpSockets[i].Active && g_udpSockets[i].LocalPort == dstPort) {
                 UdpSocketState* st = &g_udpSockets[i];
+                st->Lock.Acquire();
+                if (!st->Active || st->LocalPort != dstPort) {
+                    st->Lock.Release();
+                    return;
+                }
+
                 uint32_t needed = sizeof(UdpDgramHeader) + length;
-                if (st->Count + needed > UDP_RING_SIZE) {
-                    return; // drop if buffer full
+                uint32_t tail = st->Tail.load(std::memory_order_relaxed);
+                uint32_t used = tail - st->Head.load(std::memory_order_acquire);
+                uint32_t queued = st->Received.load(std::memory_order_relaxed) -
+                                  st->Consumed.load(std::memory_order_acquire);
+                if (used + needed > st->Size || queued >= st->MaxQueued) {
+                    st->Dropped++;
+                    st->Lock.Release();
+                    return;
                 }
 
-                // Enqueue header
                 UdpDgramHeader hdr;
                 hdr.SrcIp = srcIp;
                 hdr.SrcPort = srcPort;
                 hdr.DataLen = length;
+                RingPut(st, tail, &hdr, sizeof(hdr));
+                RingPut(st, tail + sizeof(hdr), data, length);
+
+                // Publish the datagram only once it is all in the ring
+                st->Tail.store(tail + needed, std::memory_order_release);
+                st->Received.fetch_add(1, std::memory_order_release);
+                st->Lock.Release();
+                Sched::NotifyReady(st);
+                return;
+            }
+        }
+    }
 
-                const uint8_t* hdrBytes = (const uint8_t*)&hdr;
-                for (uint32_t j = 0; j < sizeof(UdpDgramHeader); j++) {
-                    st->Ring[st->Tail] = hdrBytes[j];
-                    st->Tail = (st->Tail + 1) % UDP_RING_SIZE;
-                }
+    // Take the oldest queued datagram into `buf` (cut to `maxLen`).
+    // Returns its full length, or -1 if none is queued. ReadLock held.
+    static int DequeueDatagram(UdpSocketState* st, uint8_t* buf, uint32_t maxLen,
+                               uint32_t* srcIp, uint16_t* srcPort) {
+        if (st->Received.load(std::memory_order_acquire) ==
+            st->Consumed.load(std::memory_order_relaxed)) {
+            return -1;
+        }
 
-                // Enqueue payload
-                for (uint16_t j = 0; j < length; j++) {
-                    st->Ring[st->Tail] = data[j];
-                    st->Tail = (st->Tail + 1) % UDP_RING_SIZE;
-                }
+        uint32_t head = st->Head.load(std::memory_order_relaxed);
+        UdpDgramHeader hdr;
+        RingGet(st, head, &hdr, sizeof(hdr));
 
-                st->Count += needed;
-                return;
-            }
+        uint32_t copyLen = hdr.DataLen < maxLen ? hdr.DataLen : maxLen;
+        RingGet(st, head + sizeof(hdr), buf, copyLen);
+
+        st->Head.store(head + sizeof(hdr) + hdr.DataLen, std::memory_order_release);
+        st->Consumed.fetch_add(1, std::memory_order_release);
+
+        if (srcIp) *srcIp = hdr.SrcIp;
+        if (srcPort) *srcPort = hdr.SrcPort;
+        return hdr.DataLen;
+    }
+
+    // Move the queue into a ring of `size` bytes. Fails, keeping the old
+    // ring, if memory is short or the queued datagrams would not fit.
+    static bool ResizeRing(UdpSocketState* st, uint32_t size) {
+        uint8_t* ring = AllocRing(size);
+        if (!ring) return false;
+
+        st->ReadLock.Acquire();
+        st->Lock.Acquire();
+        uint32_t head = st->Head.load(std::memory_order_relaxed);
+        uint32_t used = st->Tail.load(std::memory_order_relaxed) - head;
+        uint8_t* old = st->Ring;
+        uint32_t oldSize = st->Size;
+        bool fits = used <= size;
+        if (fits) {
+            RingGet(st, head, ring, used);
+            st->Ring = ring;
+            st->Size = size;
+            st->Head.store(0, std::memory_order_relaxed);
+            st->Tail.store(used, std::memory_order_relaxed);
         }
+        st->Lock.Release();
+        st->ReadLock.Release();
+
+        if (fits) FreeRing(old, oldSize);
+        else FreeRing(ring, size);
+        return fits;
     }
 
     // ---- Public API ----
@@ -134,6 +251,7 @@ namespace Net::Socket {
                 g_sockets[i].TcpConn = nullptr;
                 g_sockets[i].UdpState = nullptr;
                 g_sockets[i].LocalPort = 0;
+                g_sockets[i].TcpOpts = Tcp::DefaultOptions();
 
                 if (type == SOCK_UDP) {
                     UdpSocketState* us = AllocUdpState();
@@ -158,7 +276,7 @@ namespace Net::Socket {
         uint16_t srcPort = AllocEphemeralPort();
         g_sockets[fd].LocalPort = srcPort;
 
-        Tcp::Connection* conn = Tcp::Connect(ip, port, srcPort);
+        Tcp::Connection* conn = Tcp::Connect(ip, port, srcPort, &g_sockets[fd].TcpOpts);
         if (conn == nullptr) return -1;
 
         g_sockets[fd].TcpConn = conn;
@@ -185,7 +303,7 @@ namespace Net::Socket {
         if (g_sockets[fd].LocalPort == 0) return -1;
         if (g_sockets[fd].TcpConn != nullptr) return -1;
 
-        Tcp::Connection* conn = Tcp::Listen(g_sockets[fd].LocalPort);
+        Tcp::Connection* conn = Tcp::Listen(g_sockets[fd].LocalPort, &g_sockets[fd].TcpOpts);
         if (conn == nullptr) return -1;
 
         g_sockets[fd].TcpConn = conn;
@@ -209,6 +327,7 @@ namespace Net::Socket {
                 g_sockets[i].TcpConn = clientConn;
                 g_sockets[i].UdpState = nullptr;
                 g_sockets[i].LocalPort = g_sockets[fd].LocalPort;
+                g_sockets[i].TcpOpts = Tcp::GetOptions(clientConn);
                 return i;
             }
         }
@@ -222,9 +341,17 @@ namespace Net::Socket {
         if (!ValidFd(fd, pid)) return -1;
         if (g_sockets[fd].Type != SOCK_TCP) return -1;
         if (g_sockets[fd].TcpConn == nullptr) return -1;
+        if (len > 0xFFFF) len = 0xFFFF;
         return Tcp::Send(g_sockets[fd].TcpConn, data, (uint16_t)len);
     }
 
+    int SendFrom(int fd, uint32_t len, Tcp::SendSource source, void* context, int pid) {
+        if (!ValidFd(fd, pid)) return -1;
+        if (g_sockets[fd].Type != SOCK_TCP) return -1;
+        if (g_sockets[fd].TcpConn == nullptr) return -1;
+        return Tcp::SendFrom(g_sockets[fd].TcpConn, len, source, context);
+    }
+
     int Recv(int fd, uint8_t* buf, uint32_t maxLen, int pid) {
         if (!ValidFd(fd, pid)) return -1;
         if (g_sockets[fd].Type != SOCK_TCP) return -1;
@@ -232,21 +359,106 @@ namespace Net::Socket {
         return Tcp::ReceiveNonBlocking(g_sockets[fd].TcpConn, buf, (uint16_t)maxLen);
     }
 
+    // Queue limits of a UDP socket
+    static int SetUdpOption(UdpSocketState* us, int option, uint64_t value) {
+        switch (option) {
+            case OPT_RCVBUF: {
+                if (value > UDP_RING_MAX) value = UDP_RING_MAX;
+                uint32_t size = UDP_RING_MIN;
+                while (size < value) size <<= 1;
+                if (size == us->Size) return 0;
+                return ResizeRing(us, size) ? 0 : -1;
+            }
+            case OPT_RCVQLEN:
+                if (value < 1) value = 1;
+                if (value > UDP_QLEN_MAX) value = UDP_QLEN_MAX;
+                us->MaxQueued = (uint32_t)value;
+                return 0;
+            default:
+                return -1;
+        }
+    }
+
+    int SetOption(int fd, int option, uint64_t value, int pid) {
+        if (!ValidFd(fd, pid)) return -1;
+        if (g_sockets[fd].Type == SOCK_UDP) {
+            if (!g_sockets[fd].UdpState) return -1;
+            return SetUdpOption(g_sockets[fd].UdpState, option, value);
+        }
+        if (g_sockets[fd].Type != SOCK_TCP) return -1;
+        Tcp::Options& opts = g_sockets[fd].TcpOpts;
+
+        switch (option) {
+            case OPT_RCVBUF:
+                if (value > Tcp::RECV_BUFFER_MAX) value = Tcp::RECV_BUFFER_MAX;
+                if (value < Tcp::RECV_BUFFER_MIN) value = Tcp::RECV_BUFFER_MIN;
+                opts.RecvBufferMax = (uint32_t)value;
+                if (g_sockets[fd].TcpConn) Tcp::SetRecvBufferLimit(g_sockets[fd].TcpConn, (uint32_t)value);
+                return 0;
+            case OPT_WSCALE:
+                opts.WindowScale = value != 0;
+                return 0;
+            case OPT_TIMESTAMPS:
+                opts.Timestamps = value != 0;
+                return 0;
+            case OPT_SACK:
+                opts.Sack = value != 0;
+                return 0;
+            case OPT_NODELAY:
+                opts.NoDelay = value != 0;
+                if (g_sockets[fd].TcpConn) Tcp::SetNoDelay(g_sockets[fd].TcpConn, opts.NoDelay);
+                return 0;
+            case OPT_QUICKACK:
+                opts.QuickAck = value != 0;
+                if (g_sockets[fd].TcpConn) Tcp::SetQuickAck(g_sockets[fd].TcpConn, opts.QuickAck);
+                return 0;
+            default:
+                return -1;
+        }
+    }
+
+    int GetOption(int fd, int option, uint64_t* value, int pid) {
+        if (!ValidFd(fd, pid)) return -1;
+        if (g_sockets[fd].Type == SOCK_UDP) {
+            UdpSocketState* us = g_sockets[fd].UdpState;
+            if (!us) return -1;
+            switch (option) {
+                case OPT_RCVBUF:  *value = us->Size; return 0;
+                case OPT_RCVQLEN: *value = us->MaxQueued; return 0;
+                case OPT_DROPS:   *value = us->Dropped; return 0;
+                default:          return -1;
+            }
+        }
+
+        const Tcp::Options& opts = g_sockets[fd].TcpOpts;
+        switch (option) {
+            case OPT_RCVBUF:     *value = opts.RecvBufferMax; return 0;
+            case OPT_WSCALE:     *value = opts.WindowScale; return 0;
+            case OPT_TIMESTAMPS: *value = opts.Timestamps; return 0;
+            case OPT_SACK:       *value = opts.Sack; return 0;
+            case OPT_NODELAY:    *value = opts.NoDelay; return 0;
+            case OPT_QUICKACK:   *value = opts.QuickAck; return 0;
+            default:             return -1;
+        }
+    }
+
+    // Auto-bind an ephemeral port if the UDP socket is not bound yet
+    static bool EnsureUdpBound(int fd) {
+        UdpSocketState* us = g_sockets[fd].UdpState;
+        if (us->LocalPort != 0) return true;
+        uint16_t ep = AllocEphemeralPort();
+        us->LocalPort = ep;
+        g_sockets[fd].LocalPort = ep;
+        return Udp::Bind(ep, UdpSocketDispatcher);
+    }
+
     int SendTo(int fd, const uint8_t* data, uint32_t len,
                uint32_t destIp, uint16_t destPort, int pid) {
         if (!ValidFd(fd, pid)) return -1;
         if (g_sockets[fd].Type != SOCK_UDP) return -1;
 
         UdpSocketState* us = g_sockets[fd].UdpState;
-        if (!us) return -1;
-
-        // Auto-bind ephemeral port if not already bound
-        if (us->LocalPort == 0) {
-            uint16_t ep = AllocEphemeralPort();
-            us->LocalPort = ep;
-            g_sockets[fd].LocalPort = ep;
-            if (!Udp::Bind(ep, UdpSocketDispatcher)) return -1;
-        }
+        if (!us || !EnsureUdpBound(fd)) return -1;
 
         if (!Udp::Send(destIp, us->LocalPort, destPort, data, (uint16_t)len)) {
             return -1;
@@ -254,6 +466,22 @@ namespace Net::Socket {
         return (int)len;
     }
 
+    int SendMany(int fd, Datagram* msgs, int count, int pid) {
+        if (!ValidFd(fd, pid)) return -1;
+        if (g_sockets[fd].Type != SOCK_UDP) return -1;
+
+        UdpSocketState* us = g_sockets[fd].UdpState;
+        if (!us || !EnsureUdpBound(fd)) return -1;
+
+        int sent = 0;
+        for (; sent < count; sent++) {
+            Datagram& m = msgs[sent];
+            if (m.Len > 0xFFFF) break;
+            if (!Udp::Send(m.Ip, us->LocalPort, m.Port, m.Data, (uint16_t)m.Len)) break;
+        }
+        return sent > 0 || count == 0 ? sent : -1;
+    }
+
     int RecvFrom(int fd, uint8_t* buf, uint32_t maxLen,
                  uint32_t* srcIp, uint16_t* srcPort, int pid) {
         if (!ValidFd(fd, pid)) return -1;
@@ -262,38 +490,55 @@ namespace Net::Socket {
         UdpSocketState* us = g_sockets[fd].UdpState;
         if (!us) return -1;
 
-        if (us->Count < sizeof(UdpDgramHeader)) {
-            return -1; // no data available
-        }
+        us->ReadLock.Acquire();
+        int len = DequeueDatagram(us, buf, maxLen, srcIp, srcPort);
+        us->ReadLock.Release();
+        if (len < 0) return -1; // no data available
+        return len < (int)maxLen ? len : (int)maxLen;
+    }
 
-        // Dequeue header
-        UdpDgramHeader hdr;
-        uint8_t* hdrBytes = (uint8_t*)&hdr;
-        for (uint32_t j = 0; j < sizeof(UdpDgramHeader); j++) {
-            hdrBytes[j] = us->Ring[us->Head];
-            us->Head = (us->Head + 1) % UDP_RING_SIZE;
-        }
-        us->Count -= sizeof(UdpDgramHeader);
+    int RecvMany(int fd, Datagram* msgs, int count, int pid) {
+        if (!ValidFd(fd, pid)) return -1;
+        if (g_sockets[fd].Type != SOCK_UDP) return -1;
 
-        // Dequeue payload
-        uint16_t copyLen = hdr.DataLen;
-        if (copyLen > maxLen) copyLen = (uint16_t)maxLen;
+        UdpSocketState* us = g_sockets[fd].UdpState;
+        if (!us) return -1;
 
-        for (uint16_t j = 0; j < copyLen; j++) {
-            buf[j] = us->Ring[us->Head];
-            us->Head = (us->Head + 1) % UDP_RING_SIZE;
+        int received = 0;
+        us->ReadLock.Acquire();
+        for (; received < count; received++) {
+            Datagram& m = msgs[received];
+            int len = DequeueDatagram(us, m.Data, m.Len, &m.Ip, &m.Port);
+            if (len < 0) break;
+            m.Flags = (uint32_t)len > m.Len ? DGRAM_TRUNC : 0;
+            if ((uint32_t)len < m.Len) m.Len = (uint32_t)len;
         }
+        us->ReadLock.Release();
+        return received;
+    }
 
-        // Skip remaining data if buffer was too small
-        for (uint16_t j = copyLen; j < hdr.DataLen; j++) {
-            us->Head = (us->Head + 1) % UDP_RING_SIZE;
-        }
-        us->Count -= hdr.DataLen;
+    uint32_t Poll(int fd, int pid, uint32_t& events, bool& timers, uint64_t& key) {
+        events = 0;
+        timers = false;
+        key = 0;
+        if (!ValidFd(fd, pid)) return POLL_ERR;
 
-        if (srcIp) *srcIp = hdr.SrcIp;
-        if (srcPort) *srcPort = hdr.SrcPort;
+        if (g_sockets[fd].Type == SOCK_UDP) {
+            UdpSocketState* us = g_sockets[fd].UdpState;
+            if (!us) return POLL_ERR;
+            key = (uint64_t)us;
+            events = us->Received.load(std::memory_order_acquire);
+            return POLL_OUT | (events != us->Consumed.load(std::memory_order_relaxed) ? POLL_IN : 0);
+        }
 
-        return (int)copyLen;
+        // A TCP socket is only ready once connected or listening
+        if (g_sockets[fd].TcpConn == nullptr) return 0;
+        key = (uint64_t)g_sockets[fd].TcpConn;
+        Tcp::PollInfo info = Tcp::Poll(g_sockets[fd].TcpConn);
+        events = info.Events;
+        timers = info.TimersPending;
+        return (info.Readable ? POLL_IN : 0) | (info.Writable ? POLL_OUT : 0) |
+               (info.HangUp ? POLL_HUP : 0);
     }
 
     void Close(int fd, int pid) {
@@ -309,6 +554,14 @@ namespace Net::Socket {
         g_sockets[fd].Active = false;
     }
 
+    int CountOwned(int pid) {
+        int count = 0;
+        for (int i = 0; i < MAX_SOCKETS; i++) {
+            if (g_sockets[i].Active && g_sockets[i].OwnerPid == pid) count++;
+        }
+        return count;
+    }
+
     void CleanupProcess(int pid) {
         for (int i = 0; i < MAX_SOCKETS; i++) {
             if (g_sockets[i].Active && g_sockets[i].OwnerPid == pid) {
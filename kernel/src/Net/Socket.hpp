@@ -12,10 +12,43 @@ namespace Net::Socket {
 
     static constexpr int SOCK_TCP = 1;
     static constexpr int SOCK_UDP = 2;
-    static constexpr int MAX_SOCKETS = 64;
+    static constexpr int MAX_SOCKETS = 512;
+
+    // SetOption options (same values as Montauk::SOCKOPT_*)
+    static constexpr int OPT_RCVBUF     = 1;   // Receive buffer limit in bytes
+    static constexpr int OPT_WSCALE     = 2;   // Window scaling on (1) or off (0)
+    static constexpr int OPT_TIMESTAMPS = 3;   // TCP timestamps on (1) or off (0)
+    static constexpr int OPT_SACK       = 4;   // Selective ACKs on (1) or off (0)
+    static constexpr int OPT_RCVQLEN    = 5;   // UDP: most datagrams queued for reading
+    static constexpr int OPT_DROPS      = 6;   // UDP: datagrams dropped on a full queue (read only)
+    static constexpr int OPT_NODELAY    = 7;   // TCP: no Nagle, small segments go out at once
+    static constexpr int OPT_QUICKACK   = 8;   // TCP: no delayed ACKs
+
+    // Poll readiness bits (same values as Montauk::POLL_*)
+    static constexpr uint32_t POLL_IN  = 0x01;
+    static constexpr uint32_t POLL_OUT = 0x04;
+    static constexpr uint32_t POLL_ERR = 0x08;
+    static constexpr uint32_t POLL_HUP = 0x10;
 
     struct UdpSocketState;
 
+    // Most datagrams moved by one SendMany or RecvMany call
+    static constexpr int MAX_BATCH = 64;
+
+    // One datagram of a batched send or receive (same layout as
+    // Montauk::UdpMsg). Len is the payload length to send, or the buffer
+    // size going in and the bytes received coming out.
+    struct Datagram {
+        uint8_t* Data;
+        uint32_t Len;
+        uint32_t Ip;
+        uint16_t Port;
+        uint16_t Flags;
+        uint32_t _pad;
+    };
+
+    static constexpr uint16_t DGRAM_TRUNC = 0x01;   // payload cut to fit Len
+
     struct SocketEntry {
         bool     Active;
         int      Type;
@@ -23,6 +56,7 @@ namespace Net::Socket {
         Tcp::Connection* TcpConn;
         UdpSocketState*  UdpState;
         uint16_t LocalPort;
+        Tcp::Options TcpOpts;    // Used by the next Connect or Listen
     };
 
     void Initialize();
@@ -45,6 +79,10 @@ namespace Net::Socket {
     // Send data on a connected socket. Returns bytes sent or -1.
     int Send(int fd, const uint8_t* data, uint32_t len, int pid);
 
+    // Send `len` bytes produced by `source` on a connected TCP socket
+    // (see Tcp::SendFrom). Returns bytes sent or -1.
+    int SendFrom(int fd, uint32_t len, Tcp::SendSource source, void* context, int pid);
+
     // Receive data from a connected socket. Returns bytes received, 0 on close, or -1.
     int Recv(int fd, uint8_t* buf, uint32_t maxLen, int pid);
 
@@ -56,10 +94,38 @@ namespace Net::Socket {
     int RecvFrom(int fd, uint8_t* buf, uint32_t maxLen,
                  uint32_t* srcIp, uint16_t* srcPort, int pid);
 
+    // Send `count` UDP datagrams, each to its own destination. Stops at
+    // the first that cannot be sent; returns the number sent or -1.
+    int SendMany(int fd, Datagram* msgs, int count, int pid);
+
+    // Receive up to `count` queued UDP datagrams without waiting. Returns
+    // the number received (0 if none was queued) or -1.
+    int RecvMany(int fd, Datagram* msgs, int count, int pid);
+
+    // Set a socket option. For TCP, window scaling and timestamps only
+    // affect connections set up afterwards; the receive buffer limit also
+    // applies to a connected socket. For UDP, OPT_RCVBUF sizes the receive
+    // ring (rounded up to a power of two) and OPT_RCVQLEN caps how many
+    // datagrams it holds. Returns 0 or -1.
+    int SetOption(int fd, int option, uint64_t value, int pid);
+
+    // Read a socket option into `value`. Returns 0 or -1.
+    int GetOption(int fd, int option, uint64_t* value, int pid);
+
+    // Readiness of socket fd as POLL_* bits (POLL_ERR if the caller has no
+    // such socket). `events` changes whenever new readiness may have
+    // arrived; `timers` is set if a TCP connection has data in flight and
+    // needs its timers serviced while the caller sleeps. `key` is what the
+    // socket passes to Sched::NotifyReady (0 if nothing will).
+    uint32_t Poll(int fd, int pid, uint32_t& events, bool& timers, uint64_t& key);
+
     // Close a socket.
     void Close(int fd, int pid);
 
     // Close all sockets owned by a process (called on process exit).
     void CleanupProcess(int pid);
 
+    // Number of open sockets owned by a process.
+    int CountOwned(int pid);
+
 }
@@ -6,6 +6,7 @@
 
 #include "Tcp.hpp"
 #include <Net/Ipv4.hpp>
+#include <Net/Ethernet.hpp>
 #include <Net/ByteOrder.hpp>
 #include <Net/NetConfig.hpp>
 #include <Libraries/Memory.hpp>
@@ -13,18 +14,121 @@
 #include <CppLib/Stream.hpp>
 #include <CppLib/Spinlock.hpp>
 #include <Timekeeping/ApicTimer.hpp>
+#include <Memory/PageFrameAllocator.hpp>
+#include <Sched/Scheduler.hpp>
 
 using namespace Kt;
 
 namespace Net::Tcp {
 
-    // Receive buffer size per connection
-    static constexpr uint16_t RECV_BUFFER_SIZE = 4096;
-    static constexpr uint16_t WINDOW_SIZE = 4096;
-    static constexpr uint32_t MAX_CONNECTIONS = 16;
-    static constexpr uint64_t RETRANSMIT_TIMEOUT_MS = 1000;
+    // Receive queue: received data stays in the packet buffers it arrived
+    // in, and reads copy it out from there. Small segments are copied onto
+    // the end of the last queued buffer when they fit, so a trickle of
+    // tiny segments does not pin a buffer each. The queue's limit starts
+    // small and doubles, up to the connection's limit, whenever a read
+    // finds it at least half used (the sender is being held back by our
+    // window). The advertised window is the room left under the limit,
+    // scaled down by the RFC 7323 shift agreed on in the handshake. Data
+    // is refused while the packet pool runs low, so the NICs can always
+    // refill their receive rings.
+    static constexpr uint32_t RECV_BUFFER_INITIAL = 64 * 1024;
+    static constexpr uint32_t MAX_WINDOW_SHIFT = 14;
+    static constexpr uint32_t POOL_RESERVE = 256;
+
+    // Connections are allocated on demand, up to MAX_CONNECTIONS, and found
+    // through a hash of (remote IP, remote port, local port); listeners are
+    // hashed with a zero remote end. Freed connections are kept for reuse
+    // and never go back to the page allocator,
+    // so a pointer picked up from the table always points at a connection.
+    // A connection that reaches TIME_WAIT is replaced on close by a small
+    // entry that only answers retransmitted FINs, for TIME_WAIT_MS.
+    static constexpr uint32_t MAX_CONNECTIONS = 1024;
+    static constexpr uint32_t CONNECTION_HASH_SIZE = 256;
+    static constexpr uint32_t MAX_TIME_WAIT = 512;
+    static constexpr uint32_t LISTEN_BACKLOG = 16;
+    // Retransmission timeout (RFC 6298), in ms: starts at 1 s, then follows
+    // the smoothed RTT, doubling on each expiry
+    static constexpr uint32_t RTO_INITIAL_MS = 1000;
+    static constexpr uint32_t RTO_MIN_MS = 200;
+    static constexpr uint32_t RTO_MAX_MS = 60000;
     static constexpr int      MAX_RETRANSMITS = 5;
     static constexpr uint64_t TIME_WAIT_MS = 2000;
+    static constexpr uint16_t MSS = 1460;
+    static constexpr uint16_t MAX_HEADER_SIZE = 60;   // With options
+
+    // Largest payload handed to the NIC in one segmentation (TSO) frame
+    static constexpr uint32_t TSO_MAX_PAYLOAD =
+        Ethernet::MAX_OFFLOAD_SIZE - Ipv4::HEADER_SIZE - MAX_HEADER_SIZE;
+
+    // TCP options
+    static constexpr uint8_t OPT_END       = 0;
+    static constexpr uint8_t OPT_NOP       = 1;
+    static constexpr uint8_t OPT_MSS       = 2;
+    static constexpr uint8_t OPT_WSCALE    = 3;
+    static constexpr uint8_t OPT_SACK_OK   = 4;
+    static constexpr uint8_t OPT_SACK      = 5;
+    static constexpr uint8_t OPT_TIMESTAMP = 8;
+    static constexpr uint16_t TIMESTAMP_OPTION_SIZE = 12; // NOP, NOP, kind, len, TSval, TSecr
+
+    // Send side: data stays in the send buffer until the peer ACKs it, and
+    // as much of it as the peer's window and the congestion window allow
+    // is in flight at once. Each transmitted segment gets an entry in the
+    // retransmission queue, which is in sequence order since segments are
+    // sent in order. Congestion control is NewReno (RFC 5681/6582); with
+    // SACK, recovery retransmits the holes the peer reports (RFC 6675),
+    // counting only segments still in the network against the window.
+    // Unless the connection has NoDelay, a segment shorter than SendMss
+    // waits while earlier data is unacknowledged (Nagle, RFC 896), so a
+    // stream of small writes goes out as full segments, one per ACK.
+    static constexpr uint32_t SEND_BUFFER_SIZE = 65536;
+    static constexpr uint32_t MAX_IN_FLIGHT = 64;
+    static constexpr int      DUP_ACK_THRESHOLD = 3;
+    static constexpr uint32_t INITIAL_WINDOW_SEGMENTS = 10;   // RFC 6928
+
+    // Delayed ACKs (RFC 1122, RFC 5681): in-order data is acknowledged on
+    // every second segment, or once the first has waited DELAYED_ACK_MS,
+    // unless the connection has QuickAck. Any segment we send carries the
+    // ACK along. Out-of-order data, data filling a hole and a FIN are
+    // acknowledged at once, so the sender's loss recovery is not slowed.
+    static constexpr uint32_t DELAYED_ACK_SEGMENTS = 2;
+    static constexpr uint64_t DELAYED_ACK_MS = 40;
+
+    struct SentSegment {
+        uint32_t Seq;
+        uint16_t Len;
+        bool     Sacked;         // The peer has it (SACK)
+        bool     Lost;           // Presumed lost, waiting to be retransmitted
+        bool     Retransmitted;  // No RTT sample from it (Karn)
+        uint64_t SentTime;
+    };
+
+    // Out-of-order data the receive buffer holds beyond RecvNext
+    static constexpr uint32_t MAX_OOO_RANGES = 4;
+
+    struct SeqRange {
+        uint32_t Start;
+        uint32_t End;
+    };
+
+    // Options found on an incoming segment
+    struct SegmentOptions {
+        uint16_t Mss;         // 0 if absent
+        bool     HasScale;
+        uint8_t  Scale;
+        bool     HasTimestamp;
+        uint32_t TsVal;
+        uint32_t TsEcr;
+        bool     SackOk;
+        uint32_t SackCount;
+        SeqRange Sack[4];
+    };
+
+    struct PendingSyn {
+        uint32_t RemoteIp;
+        uint16_t RemotePort;
+        uint32_t Seq;
+        SegmentOptions Opts;
+    };
 
     struct Connection {
         State    CurrentState;
@@ -38,106 +142,901 @@ namespace Net::Tcp {
         uint32_t SendUnack;   // Oldest unacknowledged sequence number
         uint32_t RecvNext;    // Next expected sequence number from remote
 
-        // Receive buffer (ring buffer)
-        uint8_t  RecvBuffer[RECV_BUFFER_SIZE];
-        uint16_t RecvHead;    // Read position
-        uint16_t RecvTail;    // Write position
-        uint16_t RecvCount;   // Bytes in buffer
-
-        // Retransmission tracking
-        uint8_t  RetransmitBuffer[1500];
-        uint16_t RetransmitLen;
-        uint64_t RetransmitTime;
-        int      RetransmitCount;
-
-        // For Listen/Accept
-        bool     PendingAccept;
-        uint32_t PendingRemoteIp;
-        uint16_t PendingRemotePort;
-        uint32_t PendingSeq;
-
-        bool     Active;
+        // Receive queue: packet buffers trimmed to the data not yet read,
+        // oldest first, and the out-of-order ones by sequence number
+        PacketBuffer* RecvQueue;
+        PacketBuffer* RecvQueueTail;
+        PacketBuffer* OooQueue;
+        uint32_t RecvCapacity; // Limit on queued and out-of-order data
+        uint32_t RecvCount;   // Bytes queued
+        uint32_t RecvAdvertised; // Window (in bytes) given in the last segment
+        uint32_t AckPending;  // Segments received since we last sent an ACK
+        uint64_t AckDeadline; // When the delayed ACK is due
+        SeqRange Ooo[MAX_OOO_RANGES]; // Ascending, disjoint, all above RecvNext
+        uint32_t OooCount;
+
+        // Negotiated in the handshake
+        Options  Opts;
+        bool     UseWindowScale;
+        uint8_t  RecvScale;   // Our window shift
+        uint8_t  SendScale;   // The peer's window shift
+        bool     UseTimestamps;
+        bool     UseSack;
+        uint32_t TsRecent;    // Peer's latest TSval, echoed back
+        uint16_t SendMss;     // Payload bytes per segment, after options
+
+        // Send buffer (ring buffer). Holds sequence numbers
+        // [SendUnack, SendUnack + SendCount); SendNext marks how far of
+        // that has been transmitted.
+        uint8_t  SendBuffer[SEND_BUFFER_SIZE];
+        uint32_t SendHead;    // Offset of SendUnack
+        uint32_t SendCount;   // Bytes in buffer
+        uint32_t SendFilling; // Bytes after them being filled by SendFrom, unlocked
+        uint32_t SendWindow;  // Peer's advertised window
+
+        // Retransmission queue (ring of in-flight segments, oldest first)
+        SentSegment InFlight[MAX_IN_FLIGHT];
+        uint32_t InFlightHead;
+        uint32_t InFlightCount;
+        int      RetransmitCount; // Timeouts since the last ACK progress
+        int      DupAcks;
+        uint64_t ProbeTime;       // Last zero-window probe or ACK progress
+
+        // RTT estimation and congestion control
+        uint32_t Srtt8;           // Smoothed RTT x8 (0: no sample yet)
+        uint32_t Rttvar4;         // RTT variation x4
+        uint32_t Rto;             // Retransmission timeout, ms
+        uint32_t Cwnd;            // Congestion window, bytes
+        uint32_t Ssthresh;        // Slow start threshold, bytes
+        bool     InRecovery;      // Fast recovery until Recover is ACKed
+        uint32_t Recover;
+
+        // For Listen/Accept: SYNs waiting for Accept, oldest first
+        PendingSyn Backlog[LISTEN_BACKLOG];
+        uint32_t BacklogHead;
+        uint32_t BacklogCount;
+
+        uint32_t    Events;       // Bumped when data, a SYN or a state change arrives, or send space frees up
+
+        bool        Active;       // Allocated to a user
+        bool        Hashed;
+        Connection* HashNext;     // Bucket chain, or free list
 
         kcp::Spinlock Lock;
     };
 
-    static Connection g_connections[MAX_CONNECTIONS] = {};
-    static kcp::Spinlock g_connectionsLock;
+    // What is left of a connection in TIME_WAIT
+    struct TimeWaitEntry {
+        bool     Used;
+        uint32_t RemoteIp;
+        uint16_t RemotePort;
+        uint16_t LocalPort;
+        uint32_t SendNext;
+        uint32_t RecvNext;
+        uint64_t Expires;
+        TimeWaitEntry* Next;
+    };
+
+    // The table lock covers the hash chains, the free list and the
+    // TIME_WAIT entries. It is taken in the receive path, so always with
+    // interrupts disabled, and before a connection's own lock.
+    static Connection* g_connectionHash[CONNECTION_HASH_SIZE] = {};
+    static Connection* g_freeConnections = nullptr;
+    static uint32_t g_connectionCount = 0;
+    static TimeWaitEntry g_timeWait[MAX_TIME_WAIT] = {};
+    static TimeWaitEntry* g_timeWaitHash[CONNECTION_HASH_SIZE] = {};
+    static kcp::LockStat g_connectionsLockStat{"tcp"};
+    static kcp::TicketLock g_connectionsLock{&g_connectionsLockStat};
 
     // Simple ISN generator using timer
     static uint32_t GenerateISN() {
         return (uint32_t)(Timekeeping::GetMilliseconds() * 2654435761u);
     }
 
-    static Connection* FindConnection(uint32_t remoteIp, uint16_t remotePort,
-                                       uint16_t localPort) {
-        for (uint32_t i = 0; i < MAX_CONNECTIONS; i++) {
-            Connection* c = &g_connections[i];
-            if (c->Active &&
-                c->LocalPort == localPort &&
-                c->RemoteIp == remoteIp &&
-                c->RemotePort == remotePort &&
-                c->CurrentState != State::Listen) {
+    static uint64_t LockTable() {
+        uint64_t flags;
+        asm volatile("pushfq; pop %0; cli" : "=r"(flags) :: "memory");
+        g_connectionsLock.Acquire();
+        return flags;
+    }
+
+    static void UnlockTable(uint64_t flags) {
+        g_connectionsLock.Release();
+        asm volatile("push %0; popfq" :: "r"(flags) : "memory");
+    }
+
+    static uint32_t HashTuple(uint32_t remoteIp, uint16_t remotePort, uint16_t localPort) {
+        uint32_t h = remoteIp * 2654435761u;
+        h ^= ((uint32_t)remotePort << 16 | localPort) * 2246822519u;
+        return (h ^ (h >> 15)) % CONNECTION_HASH_SIZE;
+    }
+
+    // Table lock held
+    static Connection* FindConnectionLocked(uint32_t remoteIp, uint16_t remotePort,
+                                            uint16_t localPort) {
+        Connection* c = g_connectionHash[HashTuple(remoteIp, remotePort, localPort)];
+        for (; c; c = c->HashNext) {
+            if (c->LocalPort == localPort && c->RemoteIp == remoteIp && c->RemotePort == remotePort) {
                 return c;
             }
         }
         return nullptr;
     }
 
-    static Connection* FindListener(uint16_t localPort) {
-        for (uint32_t i = 0; i < MAX_CONNECTIONS; i++) {
-            Connection* c = &g_connections[i];
-            if (c->Active && c->LocalPort == localPort && c->CurrentState == State::Listen) {
-                return c;
-            }
+    // Look up the connection for a segment (or the listener, with a zero
+    // remote end) and return it locked. Receive path only.
+    static Connection* LockConnection(uint32_t remoteIp, uint16_t remotePort, uint16_t localPort) {
+        uint64_t flags = LockTable();
+        Connection* conn = FindConnectionLocked(remoteIp, remotePort, localPort);
+        if (conn) conn->Lock.Acquire();
+        UnlockTable(flags);
+        return conn;
+    }
+
+    // Make the connection reachable by its 4-tuple. Fails if the tuple
+    // is taken.
+    static bool HashConnection(Connection* conn) {
+        uint64_t flags = LockTable();
+        if (FindConnectionLocked(conn->RemoteIp, conn->RemotePort, conn->LocalPort)) {
+            UnlockTable(flags);
+            return false;
         }
-        return nullptr;
+        Connection*& bucket = g_connectionHash[HashTuple(conn->RemoteIp, conn->RemotePort, conn->LocalPort)];
+        conn->HashNext = bucket;
+        bucket = conn;
+        conn->Hashed = true;
+        UnlockTable(flags);
+        return true;
     }
 
     static Connection* AllocateConnection() {
-        for (uint32_t i = 0; i < MAX_CONNECTIONS; i++) {
-            if (!g_connections[i].Active) {
-                Connection* c = &g_connections[i];
-                memset(c, 0, sizeof(Connection));
-                c->Active = true;
-                c->CurrentState = State::Closed;
-                return c;
+        uint64_t flags = LockTable();
+        if (g_connectionCount >= MAX_CONNECTIONS) {
+            UnlockTable(flags);
+            return nullptr;
+        }
+        g_connectionCount++;
+        Connection* c = g_freeConnections;
+        if (c) g_freeConnections = c->HashNext;
+        UnlockTable(flags);
+
+        if (c == nullptr) {
+            static constexpr int pages = (int)((sizeof(Connection) + 0xFFF) / 0x1000);
+            c = (Connection*)Memory::g_pfa->AllocateContiguous(pages);
+            if (c == nullptr) {
+                flags = LockTable();
+                g_connectionCount--;
+                UnlockTable(flags);
+                return nullptr;
             }
+            memset(c, 0, sizeof(Connection));
+        }
+
+        memset(c, 0, sizeof(Connection));
+        c->Active = true;
+        c->CurrentState = State::Closed;
+        c->Opts = DefaultOptions();
+        return c;
+    }
+
+    // Drop everything queued for reading or held out of order
+    static void FlushRecvQueue(Connection* conn) {
+        while (conn->RecvQueue != nullptr) {
+            PacketBuffer* b = conn->RecvQueue;
+            conn->RecvQueue = b->Next;
+            PacketPool::Release(b);
+        }
+        while (conn->OooQueue != nullptr) {
+            PacketBuffer* b = conn->OooQueue;
+            conn->OooQueue = b->Next;
+            PacketPool::Release(b);
+        }
+        conn->RecvQueueTail = nullptr;
+        conn->RecvCount = 0;
+        conn->OooCount = 0;
+    }
+
+    // Take the connection out of the table and put it on the free list.
+    // Called by its owner, without its lock.
+    static void ReleaseConnection(Connection* conn) {
+        uint64_t flags = LockTable();
+        if (conn->Hashed) {
+            Connection** link = &g_connectionHash[HashTuple(conn->RemoteIp, conn->RemotePort, conn->LocalPort)];
+            while (*link && *link != conn) link = &(*link)->HashNext;
+            if (*link) *link = conn->HashNext;
+            conn->Hashed = false;
+        }
+        UnlockTable(flags);
+
+        // The receive path may have found it just before: wait for it
+        asm volatile("pushfq; pop %0; cli" : "=r"(flags) :: "memory");
+        conn->Lock.Acquire();
+        conn->Active = false;
+        conn->CurrentState = State::Closed;
+        FlushRecvQueue(conn);
+        conn->Lock.Release();
+        asm volatile("push %0; popfq" :: "r"(flags) : "memory");
+
+        flags = LockTable();
+        conn->HashNext = g_freeConnections;
+        g_freeConnections = conn;
+        g_connectionCount--;
+        UnlockTable(flags);
+    }
+
+    // ====================================================================
+    // TIME_WAIT entries
+    // ====================================================================
+
+    // Table lock held
+    static void UnlinkTimeWaitLocked(TimeWaitEntry* tw) {
+        TimeWaitEntry** link = &g_timeWaitHash[HashTuple(tw->RemoteIp, tw->RemotePort, tw->LocalPort)];
+        while (*link && *link != tw) link = &(*link)->Next;
+        if (*link) *link = tw->Next;
+        tw->Used = false;
+    }
+
+    // Table lock held. Expired entries are dropped on the way.
+    static TimeWaitEntry* FindTimeWaitLocked(uint32_t remoteIp, uint16_t remotePort, uint16_t localPort) {
+        uint64_t now = Timekeeping::GetMilliseconds();
+        TimeWaitEntry* tw = g_timeWaitHash[HashTuple(remoteIp, remotePort, localPort)];
+        while (tw) {
+            TimeWaitEntry* next = tw->Next;
+            if (tw->Expires <= now) {
+                UnlinkTimeWaitLocked(tw);
+            } else if (tw->RemoteIp == remoteIp && tw->RemotePort == remotePort && tw->LocalPort == localPort) {
+                return tw;
+            }
+            tw = next;
         }
         return nullptr;
     }
 
-    static bool SendSegment(Connection* conn, uint8_t flags,
-                             const uint8_t* payload, uint16_t payloadLen) {
-        uint8_t packet[1500];
+    // Remember a connection in TIME_WAIT, reusing an expired entry or
+    // else the one closest to expiry
+    static void EnterTimeWait(Connection* conn) {
+        uint64_t now = Timekeeping::GetMilliseconds();
+        uint64_t flags = LockTable();
+        TimeWaitEntry* slot = nullptr;
+        for (uint32_t i = 0; i < MAX_TIME_WAIT; i++) {
+            TimeWaitEntry* tw = &g_timeWait[i];
+            if (!tw->Used || tw->Expires <= now) {
+                slot = tw;
+                break;
+            }
+            if (slot == nullptr || tw->Expires < slot->Expires) slot = tw;
+        }
+        if (slot->Used) UnlinkTimeWaitLocked(slot);
+
+        slot->Used = true;
+        slot->RemoteIp = conn->RemoteIp;
+        slot->RemotePort = conn->RemotePort;
+        slot->LocalPort = conn->LocalPort;
+        slot->SendNext = conn->SendNext;
+        slot->RecvNext = conn->RecvNext;
+        slot->Expires = now + TIME_WAIT_MS;
+        TimeWaitEntry*& bucket = g_timeWaitHash[HashTuple(slot->RemoteIp, slot->RemotePort, slot->LocalPort)];
+        slot->Next = bucket;
+        bucket = slot;
+        UnlockTable(flags);
+    }
+
+    static uint32_t ClampRecvLimit(uint32_t bytes) {
+        if (bytes < RECV_BUFFER_MIN) return RECV_BUFFER_MIN;
+        if (bytes > RECV_BUFFER_MAX) return RECV_BUFFER_MAX;
+        return bytes;
+    }
+
+    // Give a new connection an empty receive queue with the initial limit
+    // (or its own limit, if smaller)
+    static void PrepareRecvQueue(Connection* conn) {
+        FlushRecvQueue(conn);
+        conn->RecvCapacity = conn->Opts.RecvBufferMax < RECV_BUFFER_INITIAL
+            ? conn->Opts.RecvBufferMax : RECV_BUFFER_INITIAL;
+    }
+
+    // The window shift to offer: the smallest that can describe our limit
+    static uint8_t WindowShiftFor(uint32_t limit) {
+        uint8_t shift = 0;
+        while (shift < MAX_WINDOW_SHIFT && (limit >> shift) > 0xFFFF) shift++;
+        return shift;
+    }
+
+    // Largest window the negotiated shift can express
+    static uint32_t MaxWindow(const Connection* conn) {
+        return (uint32_t)0xFFFF << conn->RecvScale;
+    }
+
+    // Window to advertise, in bytes (before scaling)
+    static uint32_t FreeWindow(const Connection* conn) {
+        uint32_t free = conn->RecvCapacity - conn->RecvCount;
+        uint32_t max = MaxWindow(conn);
+        return free > max ? max : free;
+    }
+
+    static void ParseOptions(const uint8_t* opt, uint16_t len, SegmentOptions& out) {
+        memset(&out, 0, sizeof(out));
+        uint16_t i = 0;
+        while (i < len) {
+            uint8_t kind = opt[i];
+            if (kind == OPT_END) break;
+            if (kind == OPT_NOP) {
+                i++;
+                continue;
+            }
+            if (i + 1 >= len) break;
+            uint8_t optLen = opt[i + 1];
+            if (optLen < 2 || i + optLen > len) break;
+
+            if (kind == OPT_MSS && optLen == 4) {
+                out.Mss = (uint16_t)((opt[i + 2] << 8) | opt[i + 3]);
+            } else if (kind == OPT_WSCALE && optLen == 3) {
+                out.HasScale = true;
+                out.Scale = opt[i + 2] > MAX_WINDOW_SHIFT ? MAX_WINDOW_SHIFT : opt[i + 2];
+            } else if (kind == OPT_TIMESTAMP && optLen == 10) {
+                out.HasTimestamp = true;
+                uint32_t val, ecr;
+                memcpy(&val, opt + i + 2, 4);
+                memcpy(&ecr, opt + i + 6, 4);
+                out.TsVal = Ntohl(val);
+                out.TsEcr = Ntohl(ecr);
+            } else if (kind == OPT_SACK_OK && optLen == 2) {
+                out.SackOk = true;
+            } else if (kind == OPT_SACK && optLen >= 10 && (optLen - 2) % 8 == 0) {
+                for (uint16_t b = i + 2; b + 8 <= i + optLen && out.SackCount < 4; b += 8) {
+                    uint32_t start, end;
+                    memcpy(&start, opt + b, 4);
+                    memcpy(&end, opt + b + 4, 4);
+                    out.Sack[out.SackCount].Start = Ntohl(start);
+                    out.Sack[out.SackCount].End = Ntohl(end);
+                    out.SackCount++;
+                }
+            }
+            i += optLen;
+        }
+    }
+
+    // The MSS the route to the peer allows: MSS over Ethernet, more over
+    // loopback
+    static uint16_t RouteMss(const Connection* conn) {
+        return Ipv4::MaxPayload(conn->RemoteIp) - HEADER_SIZE;
+    }
+
+    // Settle the options of a connection from the peer's SYN (or SYN-ACK):
+    // each one is used only if we want it and the peer offered it too
+    static void NegotiateOptions(Connection* conn, const SegmentOptions& peer) {
+        conn->UseWindowScale = conn->Opts.WindowScale && peer.HasScale;
+        if (conn->UseWindowScale) {
+            conn->RecvScale = WindowShiftFor(conn->Opts.RecvBufferMax);
+            conn->SendScale = peer.Scale;
+        } else {
+            conn->RecvScale = 0;
+            conn->SendScale = 0;
+        }
+
+        conn->UseTimestamps = conn->Opts.Timestamps && peer.HasTimestamp;
+        conn->UseSack = conn->Opts.Sack && peer.SackOk;
+        conn->TsRecent = peer.TsVal;
+
+        uint16_t route = RouteMss(conn);
+        uint16_t mss = peer.Mss != 0 && peer.Mss < route ? peer.Mss : route;
+        conn->SendMss = conn->UseTimestamps ? mss - TIMESTAMP_OPTION_SIZE : mss;
+
+        conn->Rto = RTO_INITIAL_MS;
+        conn->Cwnd = INITIAL_WINDOW_SEGMENTS * conn->SendMss;
+        conn->Ssthresh = 0xFFFFFFFF;
+    }
+
+    static uint8_t* PutTimestamp(uint8_t* opt, const Connection* conn) {
+        *opt++ = OPT_NOP;
+        *opt++ = OPT_NOP;
+        *opt++ = OPT_TIMESTAMP;
+        *opt++ = 10;
+        uint32_t val = Htonl((uint32_t)Timekeeping::GetMilliseconds());
+        uint32_t ecr = Htonl(conn->TsRecent);
+        memcpy(opt, &val, 4);
+        memcpy(opt + 4, &ecr, 4);
+        return opt + 8;
+    }
+
+    // Fill in the header and options of a segment at `seq` carrying
+    // `payloadLen` bytes. Returns the header length; the checksum is left 0.
+    static uint16_t BuildHeader(Connection* conn, uint8_t* packet, uint32_t seq, uint8_t flags,
+                                uint32_t payloadLen) {
         Header* hdr = (Header*)packet;
 
+        // Options: everything we offer on a SYN, else the timestamp if in use
+        uint8_t* opt = packet + HEADER_SIZE;
+        bool syn = flags & FLAG_SYN;
+        if (syn) {
+            *opt++ = OPT_MSS;
+            *opt++ = 4;
+            uint16_t mss = RouteMss(conn);
+            *opt++ = (uint8_t)(mss >> 8);
+            *opt++ = (uint8_t)mss;
+            // A SYN-ACK only echoes what the peer's SYN offered
+            bool offerScale = conn->CurrentState == State::SynSent
+                ? conn->Opts.WindowScale : conn->UseWindowScale;
+            if (offerScale) {
+                *opt++ = OPT_NOP;
+                *opt++ = OPT_WSCALE;
+                *opt++ = 3;
+                *opt++ = WindowShiftFor(conn->Opts.RecvBufferMax);
+            }
+            bool offerTimestamps = conn->CurrentState == State::SynSent
+                ? conn->Opts.Timestamps : conn->UseTimestamps;
+            if (offerTimestamps) opt = PutTimestamp(opt, conn);
+            bool offerSack = conn->CurrentState == State::SynSent
+                ? conn->Opts.Sack : conn->UseSack;
+            if (offerSack) {
+                *opt++ = OPT_NOP;
+                *opt++ = OPT_NOP;
+                *opt++ = OPT_SACK_OK;
+                *opt++ = 2;
+            }
+        } else {
+            if (conn->UseTimestamps) opt = PutTimestamp(opt, conn);
+
+            // Pure ACKs report the out-of-order data we hold, as many
+            // ranges as fit
+            if (conn->UseSack && conn->OooCount > 0 && payloadLen == 0) {
+                uint32_t blocks = conn->OooCount;
+                uint32_t room = conn->UseTimestamps ? 3 : 4;
+                if (blocks > room) blocks = room;
+                *opt++ = OPT_NOP;
+                *opt++ = OPT_NOP;
+                *opt++ = OPT_SACK;
+                *opt++ = (uint8_t)(2 + 8 * blocks);
+                for (uint32_t b = 0; b < blocks; b++) {
+                    uint32_t start = Htonl(conn->Ooo[b].Start);
+                    uint32_t end = Htonl(conn->Ooo[b].End);
+                    memcpy(opt, &start, 4);
+                    memcpy(opt + 4, &end, 4);
+                    opt += 8;
+                }
+            }
+        }
+        uint16_t headerLen = (uint16_t)(opt - packet);
+
+        // The window in a SYN is never scaled
+        uint32_t window = FreeWindow(conn);
+        if (syn && window > 0xFFFF) window = 0xFFFF;
+        conn->RecvAdvertised = window;
+        conn->AckPending = 0;
+
         hdr->SrcPort = Htons(conn->LocalPort);
         hdr->DstPort = Htons(conn->RemotePort);
-        hdr->SeqNum = Htonl(conn->SendNext);
+        hdr->SeqNum = Htonl(seq);
         hdr->AckNum = Htonl(conn->RecvNext);
-        hdr->DataOffset = (HEADER_SIZE / 4) << 4;
+        hdr->DataOffset = (uint8_t)((headerLen / 4) << 4);
         hdr->Flags = flags;
-        hdr->Window = Htons(WINDOW_SIZE);
+        hdr->Window = Htons((uint16_t)(syn ? window : window >> conn->RecvScale));
         hdr->Checksum = 0;
         hdr->UrgentPtr = 0;
+        return headerLen;
+    }
 
-        uint16_t totalLen = HEADER_SIZE + payloadLen;
-        if (payload != nullptr && payloadLen > 0) {
-            memcpy(packet + HEADER_SIZE, payload, payloadLen);
-        }
+    // Build a segment in a packet buffer, its payload gathered from up to
+    // two pieces (the send buffer wraps), and hand it to IP
+    static bool SendSegmentFrom(Connection* conn, uint32_t seq, uint8_t flags,
+                                const uint8_t* first, uint16_t firstLen,
+                                const uint8_t* second, uint16_t secondLen) {
+        uint16_t payloadLen = firstLen + secondLen;
+        PacketBuffer* packet = PacketPool::Allocate(MAX_HEADER_SIZE + payloadLen);
+        if (packet == nullptr) return false;
+
+        uint16_t headerLen = BuildHeader(conn, packet->Data, seq, flags, payloadLen);
+        if (firstLen > 0) memcpy(packet->Data + headerLen, first, firstLen);
+        if (secondLen > 0) memcpy(packet->Data + headerLen + firstLen, second, secondLen);
+        packet->Length = headerLen + payloadLen;
 
         // Calculate checksum with pseudo-header
-        hdr->Checksum = Ipv4::PseudoHeaderChecksum(
-            conn->LocalIp, conn->RemoteIp, Ipv4::PROTO_TCP,
-            totalLen, packet, totalLen);
+        if (Ipv4::NeedsChecksum(conn->RemoteIp)) {
+            ((Header*)packet->Data)->Checksum = Ipv4::PseudoHeaderChecksum(
+                conn->LocalIp, conn->RemoteIp, Ipv4::PROTO_TCP,
+                packet->Length, packet->Data, packet->Length);
+        }
+
+        bool sent = Ipv4::SendPacket(conn->RemoteIp, Ipv4::PROTO_TCP, packet);
+        PacketPool::Release(packet);
+        return sent;
+    }
+
+    static bool SendSegmentAt(Connection* conn, uint32_t seq, uint8_t flags,
+                               const uint8_t* payload, uint16_t payloadLen) {
+        return SendSegmentFrom(conn, seq, flags, payload, payload ? payloadLen : 0, nullptr, 0);
+    }
+
+    static bool SendSegment(Connection* conn, uint8_t flags,
+                             const uint8_t* payload, uint16_t payloadLen) {
+        return SendSegmentAt(conn, conn->SendNext, flags, payload, payloadLen);
+    }
+
+    // Signed distance from sequence number b to a, for wrap-safe compares
+    static int32_t SeqDiff(uint32_t a, uint32_t b) {
+        return (int32_t)(a - b);
+    }
+
+    // (Re)transmit `len` bytes of the send buffer starting at `seq`. With
+    // checksum offload the NIC computes the checksum and takes the payload
+    // straight from the send buffer. If `segment`, `len` may span several
+    // segments and the NIC cuts it at SendMss (TSO); that is only tried
+    // with offload, and fails rather than falling back.
+    static bool TransmitData(Connection* conn, uint32_t seq, uint32_t len, bool segment = false) {
+        uint32_t start = (conn->SendHead + (seq - conn->SendUnack)) % SEND_BUFFER_SIZE;
+        uint32_t first = SEND_BUFFER_SIZE - start;
+        if (first > len) first = len;
+
+        if (Ipv4::Offloads(conn->RemoteIp) & Drivers::Net::OFFLOAD_TX_CSUM) {
+            uint8_t header[MAX_HEADER_SIZE];
+            uint16_t headerLen = BuildHeader(conn, header, seq, FLAG_ACK | FLAG_PSH, len);
+            ((Header*)header)->Checksum = Ipv4::PseudoHeaderSum(
+                conn->LocalIp, conn->RemoteIp, Ipv4::PROTO_TCP,
+                segment ? 0 : (uint16_t)(headerLen + len));
+
+            Drivers::Net::TxFragment fragments[3] = {
+                {header, headerLen},
+                {conn->SendBuffer + start, first},
+                {conn->SendBuffer, len - first},
+            };
+            if (Ipv4::SendTcpOffload(conn->RemoteIp, fragments, 3, headerLen,
+                                     segment ? conn->SendMss : 0)) {
+                return true;
+            }
+        }
+        if (segment) return false;
+
+        return SendSegmentFrom(conn, seq, FLAG_ACK | FLAG_PSH,
+                               conn->SendBuffer + start, (uint16_t)first,
+                               conn->SendBuffer, (uint16_t)(len - first));
+    }
+
+    static void QueueSent(Connection* conn, uint32_t seq, uint16_t len) {
+        SentSegment& seg = conn->InFlight[(conn->InFlightHead + conn->InFlightCount) % MAX_IN_FLIGHT];
+        seg.Seq = seq;
+        seg.Len = len;
+        seg.Sacked = false;
+        seg.Lost = false;
+        seg.Retransmitted = false;
+        seg.SentTime = Timekeeping::GetMilliseconds();
+        conn->InFlightCount++;
+    }
+
+    static SentSegment& InFlightAt(Connection* conn, uint32_t i) {
+        return conn->InFlight[(conn->InFlightHead + i) % MAX_IN_FLIGHT];
+    }
+
+    // Bytes still in the network: sent, not SACKed and not given up on
+    static uint32_t Pipe(Connection* conn) {
+        uint32_t pipe = 0;
+        for (uint32_t i = 0; i < conn->InFlightCount; i++) {
+            SentSegment& seg = InFlightAt(conn, i);
+            if (!seg.Sacked && !seg.Lost) pipe += seg.Len;
+        }
+        return pipe;
+    }
+
+    // Feed one RTT measurement into the RFC 6298 estimator
+    static void SampleRtt(Connection* conn, uint32_t rtt) {
+        if (conn->Srtt8 == 0) {
+            conn->Srtt8 = rtt * 8;
+            conn->Rttvar4 = rtt * 2;
+        } else {
+            int32_t delta = (int32_t)rtt - (int32_t)(conn->Srtt8 / 8);
+            if (delta < 0) delta = -delta;
+            conn->Rttvar4 = conn->Rttvar4 - conn->Rttvar4 / 4 + (uint32_t)delta;
+            conn->Srtt8 = conn->Srtt8 - conn->Srtt8 / 8 + rtt;
+        }
+
+        uint32_t rto = conn->Srtt8 / 8 + (conn->Rttvar4 > 1 ? conn->Rttvar4 : 1);
+        if (rto < RTO_MIN_MS) rto = RTO_MIN_MS;
+        if (rto > RTO_MAX_MS) rto = RTO_MAX_MS;
+        conn->Rto = rto;
+    }
+
+    // Multiplicative decrease on loss
+    static void ReduceWindow(Connection* conn) {
+        uint32_t half = Pipe(conn) / 2;
+        conn->Ssthresh = half > 2u * conn->SendMss ? half : 2u * conn->SendMss;
+    }
+
+    // With SACK, a hole is lost once DUP_ACK_THRESHOLD segments' worth of
+    // data above it has arrived (RFC 6675 IsLost). Returns true if any
+    // segment was newly marked.
+    static bool MarkSackLosses(Connection* conn) {
+        bool marked = false;
+        uint32_t sackedAbove = 0;
+        for (uint32_t i = conn->InFlightCount; i-- > 0;) {
+            SentSegment& seg = InFlightAt(conn, i);
+            if (seg.Sacked) {
+                sackedAbove += seg.Len;
+            } else if (!seg.Lost && !seg.Retransmitted &&
+                       sackedAbove >= DUP_ACK_THRESHOLD * (uint32_t)conn->SendMss) {
+                seg.Lost = true;
+                marked = true;
+            }
+        }
+        return marked;
+    }
+
+    // Fast retransmit: the oldest unacknowledged segment is lost
+    static void EnterRecovery(Connection* conn) {
+        ReduceWindow(conn);
+        conn->Cwnd = conn->Ssthresh;
+        conn->InRecovery = true;
+        conn->Recover = conn->SendNext;
+        if (conn->InFlightCount > 0) {
+            SentSegment& head = InFlightAt(conn, 0);
+            if (!head.Sacked) head.Lost = true;
+        }
+        if (conn->UseSack) MarkSackLosses(conn);
+        if (!conn->UseSack) conn->Cwnd += DUP_ACK_THRESHOLD * conn->SendMss;
+    }
+
+    // Transmit what the congestion and receive windows allow: segments
+    // presumed lost first, then new data. `push` sends a final runt
+    // without waiting for Nagle. Lock held.
+    static void TransmitPending(Connection* conn, bool push = false) {
+        uint64_t now = Timekeeping::GetMilliseconds();
+
+        for (;;) {
+            uint32_t pipe = Pipe(conn);
+            if (pipe >= conn->Cwnd) return;
+
+            // Retransmit the oldest lost segment
+            bool retransmitted = false;
+            for (uint32_t i = 0; i < conn->InFlightCount; i++) {
+                SentSegment& seg = InFlightAt(conn, i);
+                if (!seg.Lost || seg.Sacked) continue;
+                if (!TransmitData(conn, seg.Seq, seg.Len)) return;
+                seg.Lost = false;
+                seg.Retransmitted = true;
+                seg.SentTime = now;
+                retransmitted = true;
+                break;
+            }
+            if (retransmitted) continue;
+
+            if (conn->InFlightCount >= MAX_IN_FLIGHT) return;
+            uint32_t inFlight = conn->SendNext - conn->SendUnack;
+            if (inFlight >= conn->SendCount || inFlight >= conn->SendWindow) return;
+
+            uint32_t len = conn->SendCount - inFlight;
+            if (len > conn->SendMss) len = conn->SendMss;
+
+            // Nagle: hold a runt back until what is in flight is ACKed,
+            // in case more data arrives to fill it
+            if (len < conn->SendMss && inFlight > 0 && !conn->Opts.NoDelay && !push) return;
+
+            // Wait for the window to open up rather than send a runt,
+            // unless nothing would be in flight otherwise
+            uint32_t room = conn->SendWindow - inFlight;
+            uint32_t cwndRoom = conn->Cwnd - pipe;
+            if (cwndRoom < room) room = cwndRoom;
+            if (room < len) {
+                if (inFlight > 0) return;
+                len = room;
+            }
+
+            // With TSO, send every further full segment the windows and
+            // the retransmission queue allow in one frame. Each segment
+            // still gets its own queue entry, so loss recovery and SACK
+            // work per segment as before.
+            if (len == conn->SendMss && (Ipv4::Offloads(conn->RemoteIp) & Drivers::Net::OFFLOAD_TSO)) {
+                uint32_t burst = conn->SendCount - inFlight;
+                if (burst > room) burst = room;
+                if (burst > TSO_MAX_PAYLOAD) burst = TSO_MAX_PAYLOAD;
+                uint32_t segments = burst / conn->SendMss;
+                uint32_t slots = MAX_IN_FLIGHT - conn->InFlightCount;
+                if (segments > slots) segments = slots;
+
+                if (segments > 1 &&
+                    TransmitData(conn, conn->SendNext, segments * conn->SendMss, true)) {
+                    for (uint32_t s = 0; s < segments; s++) {
+                        QueueSent(conn, conn->SendNext, conn->SendMss);
+                        conn->SendNext += conn->SendMss;
+                    }
+                    continue;
+                }
+            }
+
+            if (!TransmitData(conn, conn->SendNext, len)) return;
+            QueueSent(conn, conn->SendNext, (uint16_t)len);
+            conn->SendNext += len;
+        }
+    }
+
+    // Take an ACK and window update from the peer: release what it
+    // acknowledges, learn from its SACK blocks and timestamps, grow or
+    // cut the congestion window, and send what the windows now allow.
+    // Lock held.
+    static void ProcessAck(Connection* conn, uint32_t ackNum, uint32_t window,
+                           uint16_t payloadLen, const SegmentOptions& opts) {
+        // Ignore ACKs for data that was never sent
+        if (SeqDiff(ackNum, conn->SendNext) > 0) return;
+
+        int32_t acked = SeqDiff(ackNum, conn->SendUnack);
+        bool windowChanged = window != conn->SendWindow;
+        conn->SendWindow = window;
+        uint64_t now = Timekeeping::GetMilliseconds();
+
+        // Mark what the peer holds beyond the cumulative ACK
+        bool newSack = false;
+        if (conn->UseSack) {
+            for (uint32_t b = 0; b < opts.SackCount; b++) {
+                const SeqRange& block = opts.Sack[b];
+                for (uint32_t i = 0; i < conn->InFlightCount; i++) {
+                    SentSegment& seg = InFlightAt(conn, i);
+                    if (!seg.Sacked && SeqDiff(seg.Seq, block.Start) >= 0 &&
+                        SeqDiff(seg.Seq + seg.Len, block.End) <= 0) {
+                        seg.Sacked = true;
+                        newSack = true;
+                    }
+                }
+            }
+        }
+
+        if (acked <= 0) {
+            // Duplicate ACK: the segment at SendUnack is probably lost
+            bool dup = acked == 0 && payloadLen == 0 && !windowChanged && conn->InFlightCount > 0;
+            if (dup) conn->DupAcks++;
+
+            if (!conn->InRecovery) {
+                bool sackLoss = conn->UseSack && newSack && MarkSackLosses(conn);
+                if (conn->DupAcks >= DUP_ACK_THRESHOLD || sackLoss) EnterRecovery(conn);
+            } else if (conn->UseSack) {
+                if (newSack) MarkSackLosses(conn);
+            } else if (dup) {
+                // NewReno: each duplicate means a segment left the network
+                conn->Cwnd += conn->SendMss;
+            }
+            TransmitPending(conn);
+            return;
+        }
+
+        // RTT sample: the echoed timestamp, else the segment just ACKed if
+        // it was sent only once
+        if (conn->UseTimestamps && opts.HasTimestamp && opts.TsEcr != 0) {
+            SampleRtt(conn, (uint32_t)now - opts.TsEcr);
+        } else if (conn->InFlightCount > 0) {
+            SentSegment& head = InFlightAt(conn, 0);
+            if (!head.Retransmitted && SeqDiff(head.Seq + head.Len, ackNum) <= 0) {
+                SampleRtt(conn, (uint32_t)(now - head.SentTime));
+            }
+        }
 
-        return Ipv4::Send(conn->RemoteIp, Ipv4::PROTO_TCP, packet, totalLen);
+        // The FIN takes a sequence number but no buffer space
+        uint32_t dataAcked = (uint32_t)acked < conn->SendCount ? (uint32_t)acked : conn->SendCount;
+        conn->SendHead = (conn->SendHead + dataAcked) % SEND_BUFFER_SIZE;
+        conn->SendCount -= dataAcked;
+        conn->SendUnack = ackNum;
+
+        while (conn->InFlightCount > 0) {
+            SentSegment& seg = conn->InFlight[conn->InFlightHead];
+            if (SeqDiff(seg.Seq + seg.Len, ackNum) <= 0) {
+                conn->InFlightHead = (conn->InFlightHead + 1) % MAX_IN_FLIGHT;
+                conn->InFlightCount--;
+                continue;
+            }
+            if (SeqDiff(ackNum, seg.Seq) > 0) {
+                seg.Len -= (uint16_t)(ackNum - seg.Seq);
+                seg.Seq = ackNum;
+            }
+            // Progress restarts the retransmission timer
+            seg.SentTime = now;
+            break;
+        }
+
+        if (conn->InRecovery) {
+            if (SeqDiff(ackNum, conn->Recover) >= 0) {
+                // Full ACK: recovery is over
+                conn->InRecovery = false;
+                conn->Cwnd = conn->Ssthresh;
+            } else {
+                // Partial ACK: the new oldest segment is lost too
+                if (conn->InFlightCount > 0) {
+                    SentSegment& head = InFlightAt(conn, 0);
+                    if (!head.Sacked) head.Lost = true;
+                }
+                if (!conn->UseSack) {
+                    // Deflate by what left, re-inflate by one segment
+                    conn->Cwnd = conn->Cwnd > dataAcked ? conn->Cwnd - dataAcked : 0;
+                    conn->Cwnd += conn->SendMss;
+                }
+            }
+        } else if (conn->Cwnd < conn->Ssthresh) {
+            // Slow start
+            conn->Cwnd += dataAcked < conn->SendMss ? dataAcked : conn->SendMss;
+        } else {
+            // Congestion avoidance: about one segment per RTT
+            uint32_t inc = (uint32_t)conn->SendMss * conn->SendMss / conn->Cwnd;
+            conn->Cwnd += inc > 0 ? inc : 1;
+        }
+        if (conn->Cwnd > 2 * SEND_BUFFER_SIZE) conn->Cwnd = 2 * SEND_BUFFER_SIZE;
+
+        conn->RetransmitCount = 0;
+        conn->DupAcks = 0;
+        conn->ProbeTime = now;
+        TransmitPending(conn);
     }
 
-    // Send a RST to an unexpected packet
-    static void SendReset(uint32_t destIp, uint16_t destPort, uint16_t srcPort,
-                           uint32_t seqNum, uint32_t ackNum) {
+    // On expiry of the retransmission timer, everything outstanding is
+    // presumed lost and sending restarts from one segment; also probe a
+    // zero window, and give up on the connection after MAX_RETRANSMITS.
+    // Send a delayed ACK that has waited long enough. Driven by whatever
+    // thread uses the connection. Lock held.
+    static void ServiceTimers(Connection* conn) {
+        if (conn->CurrentState == State::Closed || conn->CurrentState == State::Listen) return;
+        uint64_t now = Timekeeping::GetMilliseconds();
+
+        if (conn->AckPending > 0 && now >= conn->AckDeadline) {
+            SendSegment(conn, FLAG_ACK, nullptr, 0);
+        }
+
+        if (conn->InFlightCount > 0) {
+            SentSegment& head = InFlightAt(conn, 0);
+            if (now - head.SentTime <= conn->Rto) return;
+
+            if (++conn->RetransmitCount > MAX_RETRANSMITS) {
+                SendSegmentAt(conn, conn->SendNext, FLAG_RST | FLAG_ACK, nullptr, 0);
+                conn->CurrentState = State::Closed;
+                return;
+            }
+
+            // The timer ran out of patience: fall back to one segment
+            ReduceWindow(conn);
+            conn->Cwnd = conn->SendMss;
+            conn->InRecovery = false;
+            conn->DupAcks = 0;
+            for (uint32_t i = 0; i < conn->InFlightCount; i++) {
+                SentSegment& seg = InFlightAt(conn, i);
+                if (!seg.Sacked) seg.Lost = true;
+            }
+            conn->Rto = conn->Rto * 2 < RTO_MAX_MS ? conn->Rto * 2 : RTO_MAX_MS;
+
+            TransmitPending(conn);
+            head.SentTime = now;
+            return;
+        }
+
+        // Zero window with data waiting: push one byte past it so the
+        // peer's ACK tells us when it reopens
+        if (conn->SendWindow == 0 && conn->SendCount > conn->SendNext - conn->SendUnack &&
+            now - conn->ProbeTime > conn->Rto) {
+            if (TransmitData(conn, conn->SendNext, 1)) {
+                QueueSent(conn, conn->SendNext, 1);
+                conn->SendNext++;
+            }
+            conn->ProbeTime = now;
+        }
+    }
+
+    // Wait until everything buffered has been acknowledged, driving
+    // retransmissions meanwhile; nothing more is coming, so Nagle does not
+    // hold the tail back. Returns false if the connection failed.
+    static bool DrainSendBuffer(Connection* conn) {
+        for (;;) {
+            uint64_t flags;
+            asm volatile("pushfq; pop %0; cli" : "=r"(flags) :: "memory");
+            conn->Lock.Acquire();
+            bool failed = conn->CurrentState == State::Closed || !conn->Active;
+            if (!failed) TransmitPending(conn, true);
+            ServiceTimers(conn);
+            bool done = conn->SendCount == 0;
+            failed = conn->CurrentState == State::Closed || !conn->Active;
+            conn->Lock.Release();
+            asm volatile("push %0; popfq" :: "r"(flags) : "memory");
+
+            if (done) return true;
+            if (failed) return false;
+            Timekeeping::Sleep(10);
+        }
+    }
+
+    // Send a segment without options or data outside any connection: a RST
+    // to an unexpected packet, or an ACK from a TIME_WAIT entry
+    static void SendBare(uint32_t destIp, uint16_t destPort, uint16_t srcPort,
+                         uint32_t seqNum, uint32_t ackNum, uint8_t flags) {
         uint8_t packet[HEADER_SIZE];
         Header* hdr = (Header*)packet;
 
@@ -146,44 +1045,215 @@ namespace Net::Tcp {
         hdr->SeqNum = Htonl(seqNum);
         hdr->AckNum = Htonl(ackNum);
         hdr->DataOffset = (HEADER_SIZE / 4) << 4;
-        hdr->Flags = FLAG_RST | FLAG_ACK;
+        hdr->Flags = flags;
         hdr->Window = 0;
         hdr->Checksum = 0;
         hdr->UrgentPtr = 0;
 
-        uint32_t localIp = Net::GetIpAddress();
+        uint32_t localIp = Ipv4::SourceFor(destIp);
         hdr->Checksum = Ipv4::PseudoHeaderChecksum(
             localIp, destIp, Ipv4::PROTO_TCP, HEADER_SIZE, packet, HEADER_SIZE);
 
         Ipv4::Send(destIp, Ipv4::PROTO_TCP, packet, HEADER_SIZE);
     }
 
-    static void RecvBufferWrite(Connection* conn, const uint8_t* data, uint16_t len) {
-        for (uint16_t i = 0; i < len && conn->RecvCount < RECV_BUFFER_SIZE; i++) {
-            conn->RecvBuffer[conn->RecvTail] = data[i];
-            conn->RecvTail = (conn->RecvTail + 1) % RECV_BUFFER_SIZE;
-            conn->RecvCount++;
+    // Queue what fits of the in-order `data` from `packet`. Returns the
+    // bytes taken; only those may be acknowledged.
+    static uint16_t RecvQueueAppend(Connection* conn, PacketBuffer* packet,
+                                    const uint8_t* data, uint16_t len) {
+        uint32_t free = conn->RecvCapacity - conn->RecvCount;
+        if (len > free) len = (uint16_t)free;
+        if (len == 0) return 0;
+
+        PacketBuffer* tail = conn->RecvQueueTail;
+        if (tail != nullptr && len <= tail->Tailroom()) {
+            memcpy(tail->Data + tail->Length, data, len);
+            tail->Length += len;
+        } else {
+            if (PacketPool::Available() < POOL_RESERVE) return 0;
+            PacketPool::Retain(packet);
+            packet->Data = (uint8_t*)data;
+            packet->Length = len;
+            packet->Next = nullptr;
+            if (tail != nullptr) tail->Next = packet;
+            else conn->RecvQueue = packet;
+            conn->RecvQueueTail = packet;
         }
+        conn->RecvCount += len;
+        return len;
     }
 
-    void Initialize() {
-        for (uint32_t i = 0; i < MAX_CONNECTIONS; i++) {
-            g_connections[i].Active = false;
+    // Keep data that arrived ahead of RecvNext until the gap fills, and
+    // record its range for the SACK blocks. Dropped if it falls outside
+    // the window, repeats what we hold, or there is no range left.
+    static void RecvStoreOutOfOrder(Connection* conn, PacketBuffer* packet, uint32_t seq,
+                                    const uint8_t* data, uint16_t len) {
+        uint32_t offset = seq - conn->RecvNext;
+        uint32_t free = conn->RecvCapacity - conn->RecvCount;
+        if (offset >= free) return;
+        if (len > free - offset) len = (uint16_t)(free - offset);
+        uint32_t start = seq, end = seq + len;
+
+        // Find where the range goes, merging with what it touches
+        uint32_t first = 0;
+        while (first < conn->OooCount && SeqDiff(conn->Ooo[first].End, start) < 0) first++;
+        if (first < conn->OooCount && SeqDiff(conn->Ooo[first].Start, start) <= 0 &&
+            SeqDiff(conn->Ooo[first].End, end) >= 0) {
+            return;
+        }
+        uint32_t last = first;
+        while (last < conn->OooCount && SeqDiff(conn->Ooo[last].Start, end) <= 0) {
+            if (SeqDiff(conn->Ooo[last].Start, start) < 0) start = conn->Ooo[last].Start;
+            if (SeqDiff(conn->Ooo[last].End, end) > 0) end = conn->Ooo[last].End;
+            last++;
         }
+        uint32_t merged = last - first;
+        if (merged == 0 && conn->OooCount >= MAX_OOO_RANGES) return;
+        if (PacketPool::Available() < POOL_RESERVE) return;
+
+        PacketPool::Retain(packet);
+        packet->Data = (uint8_t*)data;
+        packet->Length = len;
+        packet->Seq = seq;
+        PacketBuffer** link = &conn->OooQueue;
+        while (*link && SeqDiff((*link)->Seq, seq) <= 0) link = &(*link)->Next;
+        packet->Next = *link;
+        *link = packet;
+
+        if (merged == 0) {
+            for (uint32_t i = conn->OooCount; i > first; i--) conn->Ooo[i] = conn->Ooo[i - 1];
+            conn->OooCount++;
+        } else {
+            for (uint32_t i = last; i < conn->OooCount; i++) conn->Ooo[i - merged + 1] = conn->Ooo[i];
+            conn->OooCount -= merged - 1;
+        }
+        conn->Ooo[first] = { start, end };
+    }
+
+    // After in-order data: move the out-of-order segments it reached onto
+    // the receive queue, less what overlaps data we already have
+    static void RecvAdvanceOutOfOrder(Connection* conn) {
+        while (conn->OooQueue != nullptr && SeqDiff(conn->OooQueue->Seq, conn->RecvNext) <= 0) {
+            PacketBuffer* b = conn->OooQueue;
+            conn->OooQueue = b->Next;
+            uint32_t overlap = conn->RecvNext - b->Seq;
+            if (overlap >= b->Length) {
+                PacketPool::Release(b);
+                continue;
+            }
+            b->Pull((uint16_t)overlap);
+            b->Next = nullptr;
+            if (conn->RecvQueueTail != nullptr) conn->RecvQueueTail->Next = b;
+            else conn->RecvQueue = b;
+            conn->RecvQueueTail = b;
+            conn->RecvNext += b->Length;
+            conn->RecvCount += b->Length;
+        }
+        while (conn->OooCount > 0 && SeqDiff(conn->Ooo[0].Start, conn->RecvNext) <= 0) {
+            for (uint32_t i = 1; i < conn->OooCount; i++) conn->Ooo[i - 1] = conn->Ooo[i];
+            conn->OooCount--;
+        }
+    }
+
+    // Copy queued data out, releasing the buffers it empties
+    static uint16_t RecvQueueRead(Connection* conn, uint8_t* buffer, uint16_t size) {
+        uint16_t n = 0;
+        while (n < size && conn->RecvQueue != nullptr) {
+            PacketBuffer* b = conn->RecvQueue;
+            uint16_t take = b->Length < size - n ? b->Length : (uint16_t)(size - n);
+            memcpy(buffer + n, b->Data, take);
+            b->Pull(take);
+            n += take;
+            if (b->Length == 0) {
+                conn->RecvQueue = b->Next;
+                if (conn->RecvQueue == nullptr) conn->RecvQueueTail = nullptr;
+                PacketPool::Release(b);
+            }
+        }
+        conn->RecvCount -= n;
+        return n;
+    }
+
+    // After a read: tell the peer when the window has opened by a good
+    // deal since it last heard, so it does not sit on a closed window
+    static void MaybeSendWindowUpdate(Connection* conn) {
+        uint32_t threshold = conn->RecvCapacity / 2 < 2u * MSS ? conn->RecvCapacity / 2 : 2u * MSS;
+        if (FreeWindow(conn) >= conn->RecvAdvertised + threshold) {
+            SendSegment(conn, FLAG_ACK, nullptr, 0);
+        }
+    }
+
+    // Double the receive limit after a read found it at least half used,
+    // up to the connection's limit. Lock held.
+    static void GrowRecvLimit(Connection* conn) {
+        uint32_t limit = conn->Opts.RecvBufferMax;
+        if (limit > MaxWindow(conn)) limit = MaxWindow(conn);
+        if (conn->RecvCapacity >= limit) return;
+        conn->RecvCapacity = conn->RecvCapacity * 2 < limit ? conn->RecvCapacity * 2 : limit;
+    }
+
+    // A segment for a connection in TIME_WAIT. Returns true if it was
+    // dealt with; false lets a new SYN through to the listener.
+    static bool HandleTimeWait(uint32_t srcIp, uint16_t srcPort, uint16_t dstPort,
+                               uint32_t seqNum, uint8_t flags) {
+        uint64_t lockFlags = LockTable();
+        TimeWaitEntry* tw = FindTimeWaitLocked(srcIp, srcPort, dstPort);
+        if (tw == nullptr) {
+            UnlockTable(lockFlags);
+            return false;
+        }
+
+        // A RST ends it early; a SYN beyond the old stream starts a new
+        // incarnation of the connection
+        if ((flags & FLAG_RST) || ((flags & FLAG_SYN) && SeqDiff(seqNum, tw->RecvNext) > 0)) {
+            UnlinkTimeWaitLocked(tw);
+            UnlockTable(lockFlags);
+            return !(flags & FLAG_SYN);
+        }
+
+        // Our final ACK was lost if the peer repeats its FIN
+        if (flags & FLAG_FIN) tw->Expires = Timekeeping::GetMilliseconds() + TIME_WAIT_MS;
+        uint32_t seq = tw->SendNext, ack = tw->RecvNext;
+        UnlockTable(lockFlags);
+        SendBare(srcIp, srcPort, dstPort, seq, ack, FLAG_ACK);
+        return true;
+    }
+
+    // Queue a SYN for the listener's Accept. A retransmitted SYN already
+    // waiting is not queued twice; with the queue full it is dropped and
+    // the peer will try again. Listener lock held.
+    static void QueueSyn(Connection* listener, uint32_t srcIp, uint16_t srcPort,
+                         uint32_t seqNum, const SegmentOptions& opts) {
+        for (uint32_t i = 0; i < listener->BacklogCount; i++) {
+            PendingSyn& p = listener->Backlog[(listener->BacklogHead + i) % LISTEN_BACKLOG];
+            if (p.RemoteIp == srcIp && p.RemotePort == srcPort) return;
+        }
+        if (listener->BacklogCount >= LISTEN_BACKLOG) return;
+
+        PendingSyn& p = listener->Backlog[(listener->BacklogHead + listener->BacklogCount) % LISTEN_BACKLOG];
+        p.RemoteIp = srcIp;
+        p.RemotePort = srcPort;
+        p.Seq = seqNum;
+        p.Opts = opts;
+        listener->BacklogCount++;
+    }
+
+    void Initialize() {
         KernelLogStream(OK, "Net") << "TCP initialized";
     }
 
-    void OnPacketReceived(uint32_t srcIp, uint32_t dstIp, const uint8_t* data, uint16_t length) {
+    void OnPacketReceived(uint32_t srcIp, uint32_t dstIp, PacketBuffer* packet, bool checksumOk) {
+        const uint8_t* data = packet->Data;
+        uint16_t length = packet->Length;
         if (length < HEADER_SIZE) {
             return;
         }
 
         const Header* hdr = (const Header*)data;
 
-        // Verify checksum
-        uint16_t check = Ipv4::PseudoHeaderChecksum(srcIp, dstIp, Ipv4::PROTO_TCP,
-                                                     length, data, length);
-        if (check != 0) {
+        // Verify checksum, unless the NIC already did
+        if (!checksumOk && Ipv4::PseudoHeaderChecksum(srcIp, dstIp, Ipv4::PROTO_TCP,
+                                                      length, data, length) != 0) {
             return;
         }
 
@@ -201,49 +1271,81 @@ namespace Net::Tcp {
         const uint8_t* payload = data + dataOff;
         uint16_t payloadLen = length - dataOff;
 
-        // Find existing connection
-        Connection* conn = FindConnection(srcIp, srcPort, dstPort);
+        SegmentOptions opts;
+        ParseOptions(data + HEADER_SIZE, dataOff - HEADER_SIZE, opts);
+
+        // Find the connection (returned locked); one that has closed is
+        // only waiting for its owner to release it
+        Connection* conn = LockConnection(srcIp, srcPort, dstPort);
+        if (conn && conn->CurrentState == State::Closed) {
+            conn->Lock.Release();
+            conn = nullptr;
+        }
 
         if (conn == nullptr) {
+            if (HandleTimeWait(srcIp, srcPort, dstPort, seqNum, flags)) return;
+
             // Check for a listening socket
-            if (flags & FLAG_SYN) {
-                Connection* listener = FindListener(dstPort);
+            if ((flags & (FLAG_SYN | FLAG_ACK | FLAG_RST)) == FLAG_SYN) {
+                Connection* listener = LockConnection(0, 0, dstPort);
                 if (listener != nullptr) {
-                    // Signal the listener about this incoming connection
-                    listener->Lock.Acquire();
-                    listener->PendingAccept = true;
-                    listener->PendingRemoteIp = srcIp;
-                    listener->PendingRemotePort = srcPort;
-                    listener->PendingSeq = seqNum;
+                    bool listening = listener->CurrentState == State::Listen;
+                    bool queued = false;
+                    if (listening) {
+                        uint32_t before = listener->BacklogCount;
+                        QueueSyn(listener, srcIp, srcPort, seqNum, opts);
+                        queued = listener->BacklogCount != before;
+                        if (queued) listener->Events++;
+                    }
                     listener->Lock.Release();
-                    return;
+                    if (queued) Sched::NotifyReady(listener);
+                    if (listening) return;
                 }
             }
 
             // No matching connection or listener -- send RST
             if (!(flags & FLAG_RST)) {
                 if (flags & FLAG_ACK) {
-                    SendReset(srcIp, srcPort, dstPort, ackNum, 0);
+                    SendBare(srcIp, srcPort, dstPort, ackNum, 0, FLAG_RST | FLAG_ACK);
                 } else {
                     uint32_t rstAck = seqNum + payloadLen;
                     if (flags & FLAG_SYN) rstAck++;
                     if (flags & FLAG_FIN) rstAck++;
-                    SendReset(srcIp, srcPort, dstPort, 0, rstAck);
+                    SendBare(srcIp, srcPort, dstPort, 0, rstAck, FLAG_RST | FLAG_ACK);
                 }
             }
             return;
         }
 
-        conn->Lock.Acquire();
-
         // RST handling
         if (flags & FLAG_RST) {
             conn->CurrentState = State::Closed;
-            conn->Active = false;
+            conn->Events++;
             conn->Lock.Release();
+            Sched::NotifyReady(conn);
             return;
         }
 
+        // What a poller could be waiting for, to tell whether this segment
+        // changed it
+        uint32_t prevRecvNext = conn->RecvNext;
+        uint32_t prevSendCount = conn->SendCount;
+        State prevState = conn->CurrentState;
+
+        // Timestamps: drop old duplicates (PAWS), remember the newest TSval
+        // of in-order data for echoing back
+        if (conn->UseTimestamps && opts.HasTimestamp && conn->CurrentState != State::SynSent) {
+            if (SeqDiff(opts.TsVal, conn->TsRecent) < 0) {
+                SendSegment(conn, FLAG_ACK, nullptr, 0);
+                conn->Lock.Release();
+                return;
+            }
+            if (SeqDiff(seqNum, conn->RecvNext) <= 0) conn->TsRecent = opts.TsVal;
+        }
+
+        // The peer's window, in bytes
+        uint32_t peerWindow = (uint32_t)Ntohs(hdr->Window) << conn->SendScale;
+
         switch (conn->CurrentState) {
             case State::SynSent: {
                 // Expecting SYN-ACK
@@ -251,6 +1353,8 @@ namespace Net::Tcp {
                     if (ackNum == conn->SendNext) {
                         conn->RecvNext = seqNum + 1;
                         conn->SendUnack = ackNum;
+                        NegotiateOptions(conn, opts);
+                        conn->SendWindow = Ntohs(hdr->Window);
                         conn->CurrentState = State::Established;
 
                         // Send ACK
@@ -265,6 +1369,7 @@ namespace Net::Tcp {
                 if (flags & FLAG_ACK) {
                     if (ackNum == conn->SendNext) {
                         conn->SendUnack = ackNum;
+                        conn->SendWindow = peerWindow;
                         conn->CurrentState = State::Established;
                     }
                 }
@@ -274,15 +1379,52 @@ namespace Net::Tcp {
             case State::Established: {
                 // Handle incoming data
                 if (flags & FLAG_ACK) {
-                    conn->SendUnack = ackNum;
+                    ProcessAck(conn, ackNum, peerWindow, payloadLen, opts);
                 }
 
-                if (payloadLen > 0 && seqNum == conn->RecvNext) {
-                    RecvBufferWrite(conn, payload, payloadLen);
-                    conn->RecvNext += payloadLen;
+                // Take the part of the segment that starts at RecvNext (a
+                // retransmission may overlap data we already have)
+                if (payloadLen > 0 && SeqDiff(seqNum, conn->RecvNext) < 0 &&
+                    SeqDiff(seqNum + payloadLen, conn->RecvNext) > 0) {
+                    uint32_t skip = conn->RecvNext - seqNum;
+                    payload += skip;
+                    payloadLen -= (uint16_t)skip;
+                    seqNum = conn->RecvNext;
+                }
 
-                    // Send ACK
-                    SendSegment(conn, FLAG_ACK, nullptr, 0);
+                if (payloadLen > 0) {
+                    // ACK at once unless this is in-order data we took whole
+                    // with no hole behind it: a duplicate ACK for a segment
+                    // out of order tells the sender what is missing
+                    bool ackNow = conn->Opts.QuickAck || conn->OooCount > 0;
+                    if (seqNum == conn->RecvNext) {
+                        uint16_t taken = RecvQueueAppend(conn, packet, payload, payloadLen);
+                        conn->RecvNext += taken;
+                        // A FIN after data we could not take is not ours yet
+                        if (taken < payloadLen) {
+                            flags &= ~FLAG_FIN;
+                            ackNow = true;
+                        }
+                        RecvAdvanceOutOfOrder(conn);
+                    } else {
+                        if (SeqDiff(seqNum, conn->RecvNext) > 0) {
+                            RecvStoreOutOfOrder(conn, packet, seqNum, payload, payloadLen);
+                        }
+                        flags &= ~FLAG_FIN;
+                        ackNow = true;
+                    }
+
+                    if (!ackNow && conn->AckPending++ == 0) {
+                        conn->AckDeadline = Timekeeping::GetMilliseconds() + DELAYED_ACK_MS;
+                    }
+                    if (ackNow || conn->AckPending >= DELAYED_ACK_SEGMENTS) {
+                        SendSegment(conn, FLAG_ACK, nullptr, 0);
+                    }
+                }
+
+                // Only a FIN at the end of everything we hold closes the stream
+                if ((flags & FLAG_FIN) && (conn->OooCount > 0 || seqNum + payloadLen != conn->RecvNext)) {
+                    flags &= ~FLAG_FIN;
                 }
 
                 if (flags & FLAG_FIN) {
@@ -297,7 +1439,9 @@ namespace Net::Tcp {
 
             case State::FinWait1: {
                 if (flags & FLAG_ACK) {
-                    conn->SendUnack = ackNum;
+                    ProcessAck(conn, ackNum, peerWindow, payloadLen, opts);
+                }
+                if ((flags & FLAG_ACK) && conn->SendUnack == conn->SendNext) {
                     if (flags & FLAG_FIN) {
                         conn->RecvNext = seqNum + 1;
                         conn->CurrentState = State::TimeWait;
@@ -322,10 +1466,17 @@ namespace Net::Tcp {
                 break;
             }
 
-            case State::LastAck: {
+            case State::CloseWait: {
+                // The peer is done sending, but may still be ACKing ours
                 if (flags & FLAG_ACK) {
+                    ProcessAck(conn, ackNum, peerWindow, payloadLen, opts);
+                }
+                break;
+            }
+
+            case State::LastAck: {
+                if ((flags & FLAG_ACK) && ackNum == conn->SendNext) {
                     conn->CurrentState = State::Closed;
-                    conn->Active = false;
                 }
                 break;
             }
@@ -339,27 +1490,81 @@ namespace Net::Tcp {
                 break;
         }
 
+        bool changed = conn->RecvNext != prevRecvNext || conn->SendCount != prevSendCount ||
+                       conn->CurrentState != prevState;
+        if (changed) conn->Events++;
         conn->Lock.Release();
+        if (changed) Sched::NotifyReady(conn);
     }
 
-    Connection* Listen(uint16_t port) {
-        g_connectionsLock.Acquire();
+    Connection* Listen(uint16_t port, const Options* opts) {
         Connection* conn = AllocateConnection();
-        g_connectionsLock.Release();
-
         if (conn == nullptr) {
             return nullptr;
         }
 
+        if (opts) conn->Opts = *opts;
+        conn->Opts.RecvBufferMax = ClampRecvLimit(conn->Opts.RecvBufferMax);
+
         conn->LocalIp = Net::GetIpAddress();
         conn->LocalPort = port;
         conn->CurrentState = State::Listen;
-        conn->PendingAccept = false;
+
+        // One listener per port
+        if (!HashConnection(conn)) {
+            ReleaseConnection(conn);
+            return nullptr;
+        }
 
         KernelLogStream(INFO, "Net") << "TCP listening on port " << base::dec << (uint64_t)port;
         return conn;
     }
 
+    // Complete the handshake for one queued SYN. Returns the established
+    // connection, or nullptr if it could not be set up or the peer never
+    // completed it.
+    static Connection* AcceptOne(Connection* listener, const PendingSyn& syn) {
+        Connection* conn = AllocateConnection();
+        if (conn == nullptr) {
+            return nullptr;
+        }
+
+        // Accepted connections take the listener's options
+        conn->Opts = listener->Opts;
+        PrepareRecvQueue(conn);
+
+        conn->LocalIp = Ipv4::SourceFor(syn.RemoteIp);
+        conn->LocalPort = listener->LocalPort;
+        conn->RemoteIp = syn.RemoteIp;
+        conn->RemotePort = syn.RemotePort;
+        NegotiateOptions(conn, syn.Opts);
+        conn->RecvNext = syn.Seq + 1;
+
+        uint32_t isn = GenerateISN();
+        conn->SendNext = isn + 1;
+        conn->SendUnack = isn;
+        conn->CurrentState = State::SynReceived;
+        if (!HashConnection(conn)) {
+            ReleaseConnection(conn);
+            return nullptr;
+        }
+
+        // Send SYN-ACK
+        SendSegmentAt(conn, isn, FLAG_SYN | FLAG_ACK, nullptr, 0);
+
+        // Wait for ACK to complete the handshake
+        for (int i = 0; i < 100; i++) {
+            if (conn->CurrentState == State::Established) {
+                return conn;
+            }
+            Timekeeping::Sleep(50);
+        }
+
+        // Timed out waiting for ACK
+        ReleaseConnection(conn);
+        return nullptr;
+    }
+
     Connection* Accept(Connection* listener) {
         if (listener == nullptr || listener->CurrentState != State::Listen) {
             return nullptr;
@@ -367,86 +1572,40 @@ namespace Net::Tcp {
 
         // Block until a SYN arrives
         while (true) {
+            uint64_t flags;
+            asm volatile("pushfq; pop %0; cli" : "=r"(flags) :: "memory");
             listener->Lock.Acquire();
-            if (listener->PendingAccept) {
-                listener->PendingAccept = false;
-
-                uint32_t remoteIp = listener->PendingRemoteIp;
-                uint16_t remotePort = listener->PendingRemotePort;
-                uint32_t remoteSeq = listener->PendingSeq;
+            if (listener->BacklogCount > 0) {
+                PendingSyn syn = listener->Backlog[listener->BacklogHead];
+                listener->BacklogHead = (listener->BacklogHead + 1) % LISTEN_BACKLOG;
+                listener->BacklogCount--;
                 listener->Lock.Release();
+                asm volatile("push %0; popfq" :: "r"(flags) : "memory");
 
-                // Allocate a new connection for this client
-                g_connectionsLock.Acquire();
-                Connection* conn = AllocateConnection();
-                g_connectionsLock.Release();
-
-                if (conn == nullptr) {
-                    return nullptr;
-                }
-
-                conn->LocalIp = Net::GetIpAddress();
-                conn->LocalPort = listener->LocalPort;
-                conn->RemoteIp = remoteIp;
-                conn->RemotePort = remotePort;
-                conn->RecvNext = remoteSeq + 1;
-
-                uint32_t isn = GenerateISN();
-                conn->SendNext = isn;
-                conn->SendUnack = isn;
-                conn->CurrentState = State::SynReceived;
-
-                // Send SYN-ACK
-                conn->SendNext = isn + 1;
-                {
-                    // Manually build the SYN-ACK with ISN as seqnum
-                    uint8_t packet[HEADER_SIZE];
-                    Header* hdr = (Header*)packet;
-
-                    hdr->SrcPort = Htons(conn->LocalPort);
-                    hdr->DstPort = Htons(conn->RemotePort);
-                    hdr->SeqNum = Htonl(isn);
-                    hdr->AckNum = Htonl(conn->RecvNext);
-                    hdr->DataOffset = (HEADER_SIZE / 4) << 4;
-                    hdr->Flags = FLAG_SYN | FLAG_ACK;
-                    hdr->Window = Htons(WINDOW_SIZE);
-                    hdr->Checksum = 0;
-                    hdr->UrgentPtr = 0;
-
-                    hdr->Checksum = Ipv4::PseudoHeaderChecksum(
-                        conn->LocalIp, conn->RemoteIp, Ipv4::PROTO_TCP,
-                        HEADER_SIZE, packet, HEADER_SIZE);
-
-                    Ipv4::Send(conn->RemoteIp, Ipv4::PROTO_TCP, packet, HEADER_SIZE);
-                }
-
-                // Wait for ACK to complete the handshake
-                for (int i = 0; i < 100; i++) {
-                    if (conn->CurrentState == State::Established) {
-                        return conn;
-                    }
-                    Timekeeping::Sleep(50);
-                }
-
-                // Timed out waiting for ACK
-                conn->Active = false;
-                return nullptr;
+                // A peer that gave up is skipped for the next one
+                Connection* conn = AcceptOne(listener, syn);
+                if (conn != nullptr) return conn;
+                continue;
             }
             listener->Lock.Release();
+            asm volatile("push %0; popfq" :: "r"(flags) : "memory");
+
+            if (listener->CurrentState != State::Listen) return nullptr;
             Timekeeping::Sleep(10);
         }
     }
 
-    Connection* Connect(uint32_t destIp, uint16_t destPort, uint16_t srcPort) {
-        g_connectionsLock.Acquire();
+    Connection* Connect(uint32_t destIp, uint16_t destPort, uint16_t srcPort, const Options* opts) {
         Connection* conn = AllocateConnection();
-        g_connectionsLock.Release();
-
         if (conn == nullptr) {
             return nullptr;
         }
 
-        conn->LocalIp = Net::GetIpAddress();
+        if (opts) conn->Opts = *opts;
+        conn->Opts.RecvBufferMax = ClampRecvLimit(conn->Opts.RecvBufferMax);
+        PrepareRecvQueue(conn);
+
+        conn->LocalIp = Ipv4::SourceFor(destIp);
         conn->LocalPort = srcPort;
         conn->RemoteIp = destIp;
         conn->RemotePort = destPort;
@@ -455,28 +1614,13 @@ namespace Net::Tcp {
         conn->SendNext = isn + 1;
         conn->SendUnack = isn;
         conn->CurrentState = State::SynSent;
+        if (!HashConnection(conn)) {
+            ReleaseConnection(conn);
+            return nullptr;
+        }
 
         // Send SYN
-        {
-            uint8_t packet[HEADER_SIZE];
-            Header* hdr = (Header*)packet;
-
-            hdr->SrcPort = Htons(conn->LocalPort);
-            hdr->DstPort = Htons(conn->RemotePort);
-            hdr->SeqNum = Htonl(isn);
-            hdr->AckNum = 0;
-            hdr->DataOffset = (HEADER_SIZE / 4) << 4;
-            hdr->Flags = FLAG_SYN;
-            hdr->Window = Htons(WINDOW_SIZE);
-            hdr->Checksum = 0;
-            hdr->UrgentPtr = 0;
-
-            hdr->Checksum = Ipv4::PseudoHeaderChecksum(
-                conn->LocalIp, conn->RemoteIp, Ipv4::PROTO_TCP,
-                HEADER_SIZE, packet, HEADER_SIZE);
-
-            Ipv4::Send(conn->RemoteIp, Ipv4::PROTO_TCP, packet, HEADER_SIZE);
-        }
+        SendSegmentAt(conn, isn, FLAG_SYN, nullptr, 0);
 
         // Wait for SYN-ACK
         for (int attempt = 0; attempt < MAX_RETRANSMITS; attempt++) {
@@ -489,29 +1633,12 @@ namespace Net::Tcp {
 
             if (conn->CurrentState == State::SynSent) {
                 // Retransmit SYN
-                uint8_t packet[HEADER_SIZE];
-                Header* hdr = (Header*)packet;
-
-                hdr->SrcPort = Htons(conn->LocalPort);
-                hdr->DstPort = Htons(conn->RemotePort);
-                hdr->SeqNum = Htonl(isn);
-                hdr->AckNum = 0;
-                hdr->DataOffset = (HEADER_SIZE / 4) << 4;
-                hdr->Flags = FLAG_SYN;
-                hdr->Window = Htons(WINDOW_SIZE);
-                hdr->Checksum = 0;
-                hdr->UrgentPtr = 0;
-
-                hdr->Checksum = Ipv4::PseudoHeaderChecksum(
-                    conn->LocalIp, conn->RemoteIp, Ipv4::PROTO_TCP,
-                    HEADER_SIZE, packet, HEADER_SIZE);
-
-                Ipv4::Send(conn->RemoteIp, Ipv4::PROTO_TCP, packet, HEADER_SIZE);
+                SendSegmentAt(conn, isn, FLAG_SYN, nullptr, 0);
             }
         }
 
         // Failed to connect
-        conn->Active = false;
+        ReleaseConnection(conn);
         return nullptr;
     }
 
@@ -520,71 +1647,109 @@ namespace Net::Tcp {
             return -1;
         }
 
-        // Phase 1: Send data segments with interrupts disabled (lock-safe)
-        uint64_t flags;
-        asm volatile("pushfq; pop %0; cli" : "=r"(flags) :: "memory");
-        conn->Lock.Acquire();
-
-        constexpr uint16_t MSS = 1460;
-        uint16_t sent = 0;
-
-        while (sent < length) {
-            uint16_t segLen = length - sent;
-            if (segLen > MSS) {
-                segLen = MSS;
-            }
+        uint16_t queued = 0;
+        while (true) {
+            // Copy what fits into the send buffer and put it on the wire,
+            // with interrupts disabled (lock-safe)
+            uint64_t flags;
+            asm volatile("pushfq; pop %0; cli" : "=r"(flags) :: "memory");
+            conn->Lock.Acquire();
 
-            bool ok = SendSegment(conn, FLAG_ACK | FLAG_PSH, data + sent, segLen);
-            if (!ok) {
+            if (conn->CurrentState != State::Established && conn->CurrentState != State::CloseWait) {
                 conn->Lock.Release();
                 asm volatile("push %0; popfq" :: "r"(flags) : "memory");
-                return sent > 0 ? sent : -1;
+                return queued > 0 ? queued : -1;
             }
 
-            conn->SendNext += segLen;
-
-            // Store for retransmission
-            if (segLen <= sizeof(conn->RetransmitBuffer)) {
-                memcpy(conn->RetransmitBuffer, data + sent, segLen);
-                conn->RetransmitLen = segLen;
-                conn->RetransmitTime = Timekeeping::GetMilliseconds();
-                conn->RetransmitCount = 0;
+            // Wait out a SendFrom filling the tail of the buffer
+            uint32_t space = conn->SendFilling ? 0 : SEND_BUFFER_SIZE - conn->SendCount;
+            uint32_t n = length - queued;
+            if (n > space) n = space;
+            if (n > 0) {
+                uint32_t tail = (conn->SendHead + conn->SendCount) % SEND_BUFFER_SIZE;
+                uint32_t first = SEND_BUFFER_SIZE - tail;
+                if (first > n) first = n;
+                memcpy(conn->SendBuffer + tail, data + queued, first);
+                memcpy(conn->SendBuffer, data + queued + first, n - first);
+                conn->SendCount += n;
+                queued += n;
+                TransmitPending(conn);
             }
+            ServiceTimers(conn);
 
-            sent += segLen;
+            conn->Lock.Release();
+            asm volatile("push %0; popfq" :: "r"(flags) : "memory");
+
+            // Return once everything is buffered; ACKs clock the rest out
+            if (queued == length) return queued;
+
+            // Buffer full: wait for ACKs (interrupts enabled)
+            Timekeeping::Sleep(1);
         }
+    }
 
-        conn->Lock.Release();
-        asm volatile("push %0; popfq" :: "r"(flags) : "memory");
+    int SendFrom(Connection* conn, uint32_t length, SendSource source, void* context) {
+        if (conn == nullptr || source == nullptr || conn->CurrentState != State::Established) {
+            return -1;
+        }
 
-        // Phase 2: Wait for ACK without holding the lock (interrupts enabled)
-        uint64_t startTime = Timekeeping::GetMilliseconds();
-        while (conn->SendUnack != conn->SendNext) {
-            uint64_t now = Timekeeping::GetMilliseconds();
-            if ((now - startTime) > (RETRANSMIT_TIMEOUT_MS * MAX_RETRANSMITS)) {
-                break;
-            }
-            if ((now - conn->RetransmitTime) > RETRANSMIT_TIMEOUT_MS && conn->RetransmitLen > 0) {
-                conn->RetransmitCount++;
-                if (conn->RetransmitCount > MAX_RETRANSMITS) {
-                    break;
-                }
-                // Retransmit with brief interrupt-disabled window
-                asm volatile("pushfq; pop %0; cli" : "=r"(flags) :: "memory");
-                conn->Lock.Acquire();
-                uint32_t savedNext = conn->SendNext;
-                conn->SendNext = conn->SendUnack;
-                SendSegment(conn, FLAG_ACK | FLAG_PSH,
-                           conn->RetransmitBuffer, conn->RetransmitLen);
-                conn->SendNext = savedNext;
-                conn->RetransmitTime = Timekeeping::GetMilliseconds();
+        uint32_t queued = 0;
+        while (queued < length) {
+            // Claim the free space at the tail of the send buffer. ACKs only
+            // move SendHead and SendCount together, so the tail stays put
+            // while the source fills it without the lock.
+            uint64_t flags;
+            asm volatile("pushfq; pop %0; cli" : "=r"(flags) :: "memory");
+            conn->Lock.Acquire();
+
+            if (conn->CurrentState != State::Established && conn->CurrentState != State::CloseWait) {
                 conn->Lock.Release();
                 asm volatile("push %0; popfq" :: "r"(flags) : "memory");
+                break;
             }
-            Timekeeping::Sleep(10);
+
+            uint32_t n = conn->SendFilling ? 0 : SEND_BUFFER_SIZE - conn->SendCount;
+            if (n > length - queued) n = length - queued;
+            uint32_t tail = (conn->SendHead + conn->SendCount) % SEND_BUFFER_SIZE;
+            conn->SendFilling = n;
+            if (n == 0) ServiceTimers(conn);
+
+            conn->Lock.Release();
+            asm volatile("push %0; popfq" :: "r"(flags) : "memory");
+
+            if (n == 0) {
+                // Buffer full (or another sender filling): wait for ACKs
+                Timekeeping::Sleep(1);
+                continue;
+            }
+
+            uint32_t first = SEND_BUFFER_SIZE - tail;
+            if (first > n) first = n;
+            int got = source(context, conn->SendBuffer + tail, queued, first);
+            if (got == (int)first && n > first) {
+                int more = source(context, conn->SendBuffer, queued + first, n - first);
+                got = more > 0 ? got + more : got;
+            }
+            uint32_t filled = got > 0 ? (uint32_t)got : 0;
+
+            asm volatile("pushfq; pop %0; cli" : "=r"(flags) :: "memory");
+            conn->Lock.Acquire();
+            conn->SendFilling = 0;
+            if (filled > 0 && (conn->CurrentState == State::Established ||
+                               conn->CurrentState == State::CloseWait)) {
+                conn->SendCount += filled;
+                queued += filled;
+                TransmitPending(conn);
+            }
+            ServiceTimers(conn);
+            conn->Lock.Release();
+            asm volatile("push %0; popfq" :: "r"(flags) : "memory");
+
+            // The source ran dry or failed
+            if (filled < n) break;
         }
 
-        return sent;
+        return queued > 0 ? (int)queued : -1;
     }
 
     int Receive(Connection* conn, uint8_t* buffer, uint16_t bufferSize) {
@@ -597,18 +1762,13 @@ namespace Net::Tcp {
             uint64_t flags;
             asm volatile("pushfq; pop %0; cli" : "=r"(flags) :: "memory");
             conn->Lock.Acquire();
+            ServiceTimers(conn);
 
             if (conn->RecvCount > 0) {
-                uint16_t toRead = conn->RecvCount;
-                if (toRead > bufferSize) {
-                    toRead = bufferSize;
-                }
-
-                for (uint16_t i = 0; i < toRead; i++) {
-                    buffer[i] = conn->RecvBuffer[conn->RecvHead];
-                    conn->RecvHead = (conn->RecvHead + 1) % RECV_BUFFER_SIZE;
-                }
-                conn->RecvCount -= toRead;
+                bool grow = conn->RecvCount >= conn->RecvCapacity / 2;
+                uint16_t toRead = RecvQueueRead(conn, buffer, bufferSize);
+                if (grow) GrowRecvLimit(conn);
+                MaybeSendWindowUpdate(conn);
 
                 conn->Lock.Release();
                 asm volatile("push %0; popfq" :: "r"(flags) : "memory");
@@ -640,20 +1800,14 @@ namespace Net::Tcp {
         asm volatile("pushfq; pop %0; cli" : "=r"(flags) :: "memory");
 
         conn->Lock.Acquire();
+        ServiceTimers(conn);
 
         int result;
         if (conn->RecvCount > 0) {
-            uint16_t toRead = conn->RecvCount;
-            if (toRead > bufferSize) {
-                toRead = bufferSize;
-            }
-
-            for (uint16_t i = 0; i < toRead; i++) {
-                buffer[i] = conn->RecvBuffer[conn->RecvHead];
-                conn->RecvHead = (conn->RecvHead + 1) % RECV_BUFFER_SIZE;
-            }
-            conn->RecvCount -= toRead;
-            result = toRead;
+            bool grow = conn->RecvCount >= conn->RecvCapacity / 2;
+            result = RecvQueueRead(conn, buffer, bufferSize);
+            if (grow) GrowRecvLimit(conn);
+            MaybeSendWindowUpdate(conn);
         } else if (conn->CurrentState == State::CloseWait ||
                    conn->CurrentState == State::Closed ||
                    conn->CurrentState == State::TimeWait) {
@@ -664,15 +1818,91 @@ namespace Net::Tcp {
 
         conn->Lock.Release();
         asm volatile("push %0; popfq" :: "r"(flags) : "memory");
-
         return result;
     }
 
+    PollInfo Poll(Connection* conn) {
+        PollInfo info = {};
+        if (conn == nullptr) {
+            info.HangUp = true;
+            return info;
+        }
+
+        uint64_t flags;
+        asm volatile("pushfq; pop %0; cli" : "=r"(flags) :: "memory");
+        conn->Lock.Acquire();
+        ServiceTimers(conn);
+
+        State state = conn->CurrentState;
+        if (state == State::Listen) {
+            info.Readable = conn->BacklogCount > 0;
+        } else {
+            bool peerClosed = state == State::CloseWait || state == State::Closed ||
+                              state == State::TimeWait;
+            info.Readable = conn->RecvCount > 0 || peerClosed;
+            info.HangUp = peerClosed;
+            info.Writable = (state == State::Established || state == State::CloseWait) &&
+                            conn->SendCount < SEND_BUFFER_SIZE;
+            info.TimersPending = conn->SendCount > 0 || conn->InFlightCount > 0 || conn->AckPending > 0;
+        }
+        info.Events = conn->Events;
+
+        conn->Lock.Release();
+        asm volatile("push %0; popfq" :: "r"(flags) : "memory");
+        return info;
+    }
+
+    Options DefaultOptions() {
+        return { RECV_BUFFER_DEFAULT_MAX, true, true, true, false, false };
+    }
+
+    Options GetOptions(Connection* conn) {
+        if (conn == nullptr) return DefaultOptions();
+        return conn->Opts;
+    }
+
+    void SetRecvBufferLimit(Connection* conn, uint32_t bytes) {
+        if (conn == nullptr) return;
+        // Only the growth limit changes; the buffer never shrinks under
+        // data the peer was allowed to send
+        conn->Opts.RecvBufferMax = ClampRecvLimit(bytes);
+    }
+
+    void SetNoDelay(Connection* conn, bool noDelay) {
+        if (conn == nullptr) return;
+        uint64_t flags;
+        asm volatile("pushfq; pop %0; cli" : "=r"(flags) :: "memory");
+        conn->Lock.Acquire();
+        conn->Opts.NoDelay = noDelay;
+        if (noDelay && (conn->CurrentState == State::Established ||
+                        conn->CurrentState == State::CloseWait)) {
+            TransmitPending(conn);
+        }
+        conn->Lock.Release();
+        asm volatile("push %0; popfq" :: "r"(flags) : "memory");
+    }
+
+    void SetQuickAck(Connection* conn, bool quickAck) {
+        if (conn == nullptr) return;
+        uint64_t flags;
+        asm volatile("pushfq; pop %0; cli" : "=r"(flags) :: "memory");
+        conn->Lock.Acquire();
+        conn->Opts.QuickAck = quickAck;
+        if (quickAck && conn->AckPending > 0) SendSegment(conn, FLAG_ACK, nullptr, 0);
+        conn->Lock.Release();
+        asm volatile("push %0; popfq" :: "r"(flags) : "memory");
+    }
+
     void Close(Connection* conn) {
         if (conn == nullptr) {
             return;
         }
 
+        // The FIN goes after everything already sent
+        if (conn->CurrentState == State::Established || conn->CurrentState == State::CloseWait) {
+            DrainSendBuffer(conn);
+        }
+
         uint64_t flags;
         asm volatile("pushfq; pop %0; cli" : "=r"(flags) :: "memory");
         conn->Lock.Acquire();
@@ -693,7 +1923,8 @@ namespace Net::Tcp {
                     }
                     Timekeeping::Sleep(50);
                 }
-                conn->Active = false;
+                if (conn->CurrentState == State::TimeWait) EnterTimeWait(conn);
+                ReleaseConnection(conn);
                 return;
             }
 
@@ -711,24 +1942,18 @@ namespace Net::Tcp {
                     }
                     Timekeeping::Sleep(50);
                 }
-                conn->Active = false;
+                ReleaseConnection(conn);
                 return;
             }
 
-            case State::Listen:
-            case State::SynSent: {
-                conn->CurrentState = State::Closed;
-                conn->Active = false;
+            default: {
+                bool timeWait = conn->CurrentState == State::TimeWait;
                 conn->Lock.Release();
                 asm volatile("push %0; popfq" :: "r"(flags) : "memory");
+                if (timeWait) EnterTimeWait(conn);
+                ReleaseConnection(conn);
                 return;
             }
-
-            default:
-                conn->Lock.Release();
-                asm volatile("push %0; popfq" :: "r"(flags) : "memory");
-                conn->Active = false;
-                return;
         }
     }
 
@@ -7,6 +7,7 @@
 #pragma once
 #include <cstdint>
 #include <CppLib/Spinlock.hpp>
+#include <Net/PacketBuffer.hpp>
 
 namespace Net::Tcp {
 
@@ -48,25 +49,60 @@ namespace Net::Tcp {
     // Opaque connection handle
     struct Connection;
 
+    // Receive buffer limits (bytes)
+    constexpr uint32_t RECV_BUFFER_MIN = 4096;
+    constexpr uint32_t RECV_BUFFER_MAX = 4 * 1024 * 1024;
+    constexpr uint32_t RECV_BUFFER_DEFAULT_MAX = 2 * 1024 * 1024;
+
+    // Per-connection tunables, fixed once the handshake has started (except
+    // RecvBufferMax, NoDelay and QuickAck, see the setters below)
+    struct Options {
+        uint32_t RecvBufferMax;   // How far the receive buffer may grow
+        bool     WindowScale;     // Offer the RFC 7323 window scale option
+        bool     Timestamps;      // Offer the RFC 7323 timestamp option
+        bool     Sack;            // Offer RFC 2018 selective acknowledgments
+        bool     NoDelay;         // Send small segments at once, not after the ACK (no Nagle)
+        bool     QuickAck;        // Acknowledge every segment at once (no delayed ACKs)
+    };
+
+    Options DefaultOptions();
+
     // Initialize the TCP subsystem
     void Initialize();
 
-    // Handle an incoming TCP segment (called by IPv4 layer)
-    void OnPacketReceived(uint32_t srcIp, uint32_t dstIp, const uint8_t* data, uint16_t length);
+    // Handle an incoming TCP segment, the contents of `packet` (called by
+    // IPv4 layer); `checksumOk` if the NIC already verified its checksum.
+    // Data is kept by taking a reference to the buffer.
+    void OnPacketReceived(uint32_t srcIp, uint32_t dstIp, PacketBuffer* packet, bool checksumOk);
 
     // Listen on a port. Returns a connection handle in Listen state.
-    Connection* Listen(uint16_t port);
+    // Accepted connections inherit `opts` (nullptr for the defaults).
+    Connection* Listen(uint16_t port, const Options* opts = nullptr);
 
     // Accept an incoming connection on a listening socket.
     // Blocks until a connection arrives. Returns a new connection in Established state.
     Connection* Accept(Connection* listener);
 
     // Actively connect to a remote host:port. Returns connection in Established state or nullptr.
-    Connection* Connect(uint32_t destIp, uint16_t destPort, uint16_t srcPort);
+    Connection* Connect(uint32_t destIp, uint16_t destPort, uint16_t srcPort,
+                        const Options* opts = nullptr);
 
-    // Send data on an established connection. Returns number of bytes sent.
+    // Send data on an established connection. Returns once the data is in the
+    // send buffer (waiting for ACKs only while it is full), with the number
+    // of bytes queued, or -1 if the connection is not open.
     int Send(Connection* conn, const uint8_t* data, uint16_t length);
 
+    // Produces bytes [offset, offset + length) of the stream being sent
+    // straight into `dest`. Returns how many it wrote; fewer than asked
+    // (or -1) ends the send.
+    using SendSource = int(*)(void* context, uint8_t* dest, uint32_t offset, uint32_t length);
+
+    // Send `length` bytes from `source`, which writes them directly into
+    // the send buffer, so the data is copied once on its way to the wire.
+    // The source runs without the connection lock and may block. Returns
+    // like Send once everything is queued or the source stops short.
+    int SendFrom(Connection* conn, uint32_t length, SendSource source, void* context);
+
     // Receive data from an established connection. Returns number of bytes received.
     // Blocks until data is available or connection is closed.
     int Receive(Connection* conn, uint8_t* buffer, uint16_t bufferSize);
@@ -74,9 +110,37 @@ namespace Net::Tcp {
     // Non-blocking receive. Returns bytes read, 0 if no data available, or -1 on closed/error.
     int ReceiveNonBlocking(Connection* conn, uint8_t* buffer, uint16_t bufferSize);
 
-    // Close a TCP connection gracefully
+    // Readiness of a connection, for SYS_EPOLL_WAIT. Services the
+    // connection's timers like a read does.
+    struct PollInfo {
+        bool     Readable;       // Data buffered, a SYN to accept, or the peer closed
+        bool     Writable;       // Room in the send buffer
+        bool     HangUp;         // The peer closed or reset the connection
+        bool     TimersPending;  // Unacknowledged data: someone must keep servicing timers
+        uint32_t Events;         // Changes whenever new readiness may have arrived
+    };
+
+    PollInfo Poll(Connection* conn);
+
+    // Close a TCP connection gracefully. The handle is invalid afterwards;
+    // if the connection ends up in TIME_WAIT, only a small entry is kept.
     void Close(Connection* conn);
 
+    // Options the connection was set up with
+    Options GetOptions(Connection* conn);
+
+    // Change how far the receive buffer may grow. Takes effect at the next
+    // read; the window can never exceed what the agreed scale can express.
+    void SetRecvBufferLimit(Connection* conn, uint32_t bytes);
+
+    // Turn Nagle's algorithm off (true) or back on; turning it off sends
+    // whatever small segment it was holding back
+    void SetNoDelay(Connection* conn, bool noDelay);
+
+    // Turn delayed ACKs off (true) or back on; turning them off sends the
+    // ACK being delayed
+    void SetQuickAck(Connection* conn, bool quickAck);
+
     // Get the state of a connection
     State GetState(Connection* conn);
 
@@ -32,7 +32,8 @@ namespace Net::Udp {
         KernelLogStream(OK, "Net") << "UDP initialized";
     }
 
-    void OnPacketReceived(uint32_t srcIp, uint32_t dstIp, const uint8_t* data, uint16_t length) {
+    void OnPacketReceived(uint32_t srcIp, uint32_t dstIp, const uint8_t* data, uint16_t length,
+                          bool checksumOk) {
         if (length < HEADER_SIZE) {
             return;
         }
@@ -46,8 +47,8 @@ namespace Net::Udp {
             return;
         }
 
-        // Verify checksum if present
-        if (hdr->Checksum != 0) {
+        // Verify checksum if present and not already checked by the NIC
+        if (hdr->Checksum != 0 && !checksumOk) {
             uint16_t check = Ipv4::PseudoHeaderChecksum(srcIp, dstIp, Ipv4::PROTO_UDP,
                                                          udpLen, data, udpLen);
             if (check != 0) {
@@ -86,7 +87,7 @@ namespace Net::Udp {
 
         // Calculate checksum with pseudo-header
         hdr->Checksum = Ipv4::PseudoHeaderChecksum(
-            Net::GetIpAddress(), destIp, Ipv4::PROTO_UDP,
+            Ipv4::SourceFor(destIp), destIp, Ipv4::PROTO_UDP,
             udpLen, packet, udpLen);
         if (hdr->Checksum == 0) {
             hdr->Checksum = 0xFFFF; // RFC 768: zero checksum transmitted as all ones
@@ -26,8 +26,10 @@ namespace Net::Udp {
     // Initialize the UDP subsystem
     void Initialize();
 
-    // Handle an incoming UDP packet (called by IPv4 layer)
-    void OnPacketReceived(uint32_t srcIp, uint32_t dstIp, const uint8_t* data, uint16_t length);
+    // Handle an incoming UDP packet (called by IPv4 layer); `checksumOk`
+    // if the NIC already verified its checksum
+    void OnPacketReceived(uint32_t srcIp, uint32_t dstIp, const uint8_t* data, uint16_t length,
+                          bool checksumOk);
 
     // Send a UDP datagram
     bool Send(uint32_t destIp, uint16_t srcPort, uint16_t destPort,
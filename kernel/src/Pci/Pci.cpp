@@ -10,6 +10,8 @@
 #include <Memory/HHDM.hpp>
 #include <Memory/Paging.hpp>
 #include <Io/IoPort.hpp>
+#include <CppLib/Spinlock.hpp>
+#include <Timekeeping/BootProfile.hpp>
 
 using namespace Kt;
 
@@ -155,6 +157,9 @@ namespace Pci {
     // Legacy PCI configuration space access (I/O ports 0xCF8/0xCFC)
     // -------------------------------------------------------------------------
 
+    // The address/data port pair is shared by every CPU
+    static kcp::Spinlock g_legacyLock;
+
     static uint32_t LegacyBuildAddress(uint8_t bus, uint8_t device, uint8_t function, uint8_t offset) {
         return (1u << 31)                       // Enable bit
              | ((uint32_t)bus << 16)
@@ -164,8 +169,11 @@ namespace Pci {
     }
 
     uint32_t LegacyRead32(uint8_t bus, uint8_t device, uint8_t function, uint8_t offset) {
+        g_legacyLock.Acquire();
         Io::Out32(LegacyBuildAddress(bus, device, function, offset), ConfigAddressPort);
-        return Io::In32(ConfigDataPort);
+        uint32_t value = Io::In32(ConfigDataPort);
+        g_legacyLock.Release();
+        return value;
     }
 
     uint16_t LegacyRead16(uint8_t bus, uint8_t device, uint8_t function, uint8_t offset) {
@@ -179,12 +187,15 @@ namespace Pci {
     }
 
     void LegacyWrite32(uint8_t bus, uint8_t device, uint8_t function, uint8_t offset, uint32_t value) {
+        g_legacyLock.Acquire();
         Io::Out32(LegacyBuildAddress(bus, device, function, offset), ConfigAddressPort);
         Io::Out32(value, ConfigDataPort);
+        g_legacyLock.Release();
     }
 
     void LegacyWrite16(uint8_t bus, uint8_t device, uint8_t function, uint8_t offset, uint16_t value) {
         uint32_t addr = LegacyBuildAddress(bus, device, function, offset & 0xFC);
+        g_legacyLock.Acquire();
         Io::Out32(addr, ConfigAddressPort);
         uint32_t tmp = Io::In32(ConfigDataPort);
         int shift = (offset & 2) * 8;
@@ -192,10 +203,12 @@ namespace Pci {
         tmp |= ((uint32_t)value << shift);
         Io::Out32(addr, ConfigAddressPort);
         Io::Out32(tmp, ConfigDataPort);
+        g_legacyLock.Release();
     }
 
     void LegacyWrite8(uint8_t bus, uint8_t device, uint8_t function, uint8_t offset, uint8_t value) {
         uint32_t addr = LegacyBuildAddress(bus, device, function, offset & 0xFC);
+        g_legacyLock.Acquire();
         Io::Out32(addr, ConfigAddressPort);
         uint32_t tmp = Io::In32(ConfigDataPort);
         int shift = (offset & 3) * 8;
@@ -203,6 +216,7 @@ namespace Pci {
         tmp |= ((uint32_t)value << shift);
         Io::Out32(addr, ConfigAddressPort);
         Io::Out32(tmp, ConfigDataPort);
+        g_legacyLock.Release();
     }
 
     // -------------------------------------------------------------------------
@@ -403,13 +417,19 @@ namespace Pci {
     // -------------------------------------------------------------------------
 
     uint64_t ReadBar0(uint8_t bus, uint8_t device, uint8_t function) {
-        uint32_t bar0Low = LegacyRead32(bus, device, function, (uint8_t)PCI_REG_BAR0);
-        uint64_t addr = bar0Low & 0xFFFFFFF0u;
+        return ReadBar(bus, device, function, 0);
+    }
+
+    uint64_t ReadBar(uint8_t bus, uint8_t device, uint8_t function, int index) {
+        if (index < 0 || index > 5) return 0;
+        uint8_t reg = (uint8_t)(PCI_REG_BAR0 + index * 4);
+        uint32_t barLow = LegacyRead32(bus, device, function, reg);
+        uint64_t addr = barLow & 0xFFFFFFF0u;
 
         // Check for 64-bit BAR (type field bits 2:1 == 0b10)
-        if ((bar0Low & 0x06) == 0x04) {
-            uint32_t bar0High = LegacyRead32(bus, device, function, (uint8_t)(PCI_REG_BAR0 + 4));
-            addr |= ((uint64_t)bar0High << 32);
+        if ((barLow & 0x06) == 0x04 && index < 5) {
+            uint32_t barHigh = LegacyRead32(bus, device, function, (uint8_t)(reg + 4));
+            addr |= ((uint64_t)barHigh << 32);
         }
 
         return addr;
@@ -464,7 +484,11 @@ namespace Pci {
                     << (uint64_t)dev.Bus << ":" << (uint64_t)dev.Device
                     << "." << (uint64_t)dev.Function;
 
-                if (table[i].Probe(dev)) {
+                int phase = Timekeeping::BootProfile::Begin(table[i].Name);
+                bool claimed = table[i].Probe(dev);
+                Timekeeping::BootProfile::End(phase);
+
+                if (claimed) {
                     KernelLogStream(OK, "PCI") << table[i].Name << " claimed device "
                         << base::hex << (uint64_t)dev.Bus << ":"
                         << (uint64_t)dev.Device << "." << (uint64_t)dev.Function;
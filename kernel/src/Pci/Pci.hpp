@@ -62,6 +62,7 @@ namespace Pci {
 
     // PCI capability IDs
     constexpr uint8_t PCI_CAP_MSI = 0x05;
+    constexpr uint8_t PCI_CAP_MSIX = 0x11;
 
     // Walk the PCI capability linked list for a given device.
     // Returns the config-space offset of the capability, or 0 if not found.
@@ -93,6 +94,10 @@ namespace Pci {
     // Read BAR0, handling 32/64-bit BARs. Returns physical base address.
     uint64_t ReadBar0(uint8_t bus, uint8_t device, uint8_t function);
 
+    // Read memory BAR `index` (0-5) the same way. A 64-bit BAR takes up
+    // two slots; pass the index of its low half.
+    uint64_t ReadBar(uint8_t bus, uint8_t device, uint8_t function, int index);
+
     // Enable memory space access and bus mastering in PCI command register.
     void EnableBusMaster(uint8_t bus, uint8_t device, uint8_t function);
 
@@ -1,30 +1,21 @@
 ;
 ;   Context.asm
-;   Context switch: save/restore callee-saved registers, stack pointer, CR3, and FPU state
+;   Context switch: save/restore callee-saved registers, stack pointer and CR3
 ;   Copyright (c) 2025 Daniel Hammer
 ;
 
 [bits 64]
 section .text
 
-; void SchedContextSwitch(uint64_t* oldRsp, uint64_t newRsp, uint64_t newCR3,
-;                         uint8_t* oldFpuArea, uint8_t* newFpuArea)
+; void SchedContextSwitch(uint64_t* oldRsp, uint64_t newRsp, uint64_t newCR3)
 ;   rdi = pointer to save old RSP
 ;   rsi = new RSP to restore
-;   rdx = new PML4 physical address (for CR3)
-;   rcx = old FPU state area (may be null)
-;   r8  = new FPU state area (may be null)
+;   rdx = new CR3 value: PML4 physical address | PCID, bit 63 = keep the
+;         PCID's TLB entries (see Memory/Pcid.hpp)
+;
+; FPU/SSE state is switched lazily by the scheduler (CR0.TS + #NM).
 global SchedContextSwitch
 SchedContextSwitch:
-    ; Save FPU state before pushing registers (rcx/r8 are caller-saved)
-    test rcx, rcx
-    jz .skip_fxsave
-    fxsave [rcx]
-.skip_fxsave:
-
-    ; Stash r8 in r9 (callee-saved registers will clobber r8 slot on stack)
-    mov r9, r8
-
     ; Save callee-saved registers on the current stack
     push rbp
     push rbx
@@ -39,9 +30,12 @@ SchedContextSwitch:
     ; Load new RSP
     mov rsp, rsi
 
-    ; Switch address space if CR3 differs (avoid unnecessary TLB flush)
+    ; Switch address space if CR3 differs (avoid unnecessary TLB flush).
+    ; Bit 63 is write-only and reads back as 0.
     mov rax, cr3
-    cmp rax, rdx
+    mov rcx, rdx
+    btr rcx, 63
+    cmp rax, rcx
     je .skip_cr3
     mov cr3, rdx
 .skip_cr3:
@@ -54,10 +48,4 @@ SchedContextSwitch:
     pop rbx
     pop rbp
 
-    ; Restore FPU state
-    test r9, r9
-    jz .skip_fxrstor
-    fxrstor [r9]
-.skip_fxrstor:
-
     ret
@@ -13,6 +13,7 @@
 #include <Libraries/Memory.hpp>
 #include <Terminal/Terminal.hpp>
 #include <CppLib/Stream.hpp>
+#include <CppLib/Spinlock.hpp>
 
 namespace Sched {
 
@@ -51,17 +52,69 @@ namespace Sched {
         return true;
     }
 
-    uint64_t ElfLoad(const char* vfsPath, uint64_t pml4Phys) {
+    static bool StrEqual(const char* a, const char* b) {
+        while (*a && *b) {
+            if (*a != *b) return false;
+            a++;
+            b++;
+        }
+        return *a == *b;
+    }
+
+    static constexpr int MaxSegments = 16;
+    static constexpr int MaxCachedImages = 32;
+
+    struct ImageSegment {
+        uint64_t base;            // VA of the first page
+        uint64_t pages;
+        uint64_t firstFrame;      // Index of its first page in ElfImage::frames
+        bool writable;
+    };
+
+    struct ElfImage {
+        char path[256];
+        uint64_t generation;      // Fs::Vfs::VfsPathGeneration() when read
+        uint64_t entry;
+        int refs;                 // Address spaces mapping the image
+        bool cached;              // Listed in g_images
+        uint64_t lastUse;
+        int segmentCount;
+        ImageSegment segments[MaxSegments];
+        uint64_t frameCount;
+        uint64_t* frames;         // Physical page per segment page, 0 = all zero
+    };
+
+    // Images of recently run binaries, in use or not. Unused ones are
+    // evicted oldest first when a new binary needs the slot; a binary
+    // that changed on disk is dropped from here at its next spawn.
+    static ElfImage* g_images[MaxCachedImages];
+    static uint64_t g_useClock = 0;
+    static uint64_t g_zeroPage = 0;     // Shared frame for pages with no file data
+    static kcp::Mutex g_imagesLock;
+
+    static void DestroyImage(ElfImage* image) {
+        if (image->frames) {
+            for (uint64_t i = 0; i < image->frameCount; i++) {
+                if (image->frames[i] != 0) Memory::g_pfa->Free((void*)Memory::HHDM(image->frames[i]));
+            }
+            Memory::g_heap->Free(image->frames);
+        }
+        Memory::g_heap->Free(image);
+    }
+
+    // Read and validate the binary and copy every PT_LOAD page into a
+    // frame of its own, laid out as the process will see it.
+    static ElfImage* BuildImage(const char* vfsPath, uint64_t generation) {
         int handle = Fs::Vfs::VfsOpen(vfsPath);
         if (handle < 0) {
-            return 0;
+            return nullptr;
         }
 
         uint64_t fileSize = Fs::Vfs::VfsGetSize(handle);
         if (fileSize < sizeof(Elf64Header)) {
             Kt::KernelLogStream(Kt::ERROR, "ELF") << "File too small (" << fileSize << " bytes)";
             Fs::Vfs::VfsClose(handle);
-            return 0;
+            return nullptr;
         }
 
         // Read entire file into a heap buffer
@@ -69,7 +122,7 @@ namespace Sched {
         if (fileData == nullptr) {
             Kt::KernelLogStream(Kt::ERROR, "ELF") << "Failed to allocate " << fileSize << " bytes for file";
             Fs::Vfs::VfsClose(handle);
-            return 0;
+            return nullptr;
         }
 
         Fs::Vfs::VfsRead(handle, fileData, 0, fileSize);
@@ -81,12 +134,25 @@ namespace Sched {
 
         // Validate ELF header
         Elf64Header* hdr = (Elf64Header*)fileData;
-        if (!ValidateElfHeader(hdr)) {
+        if (!ValidateElfHeader(hdr) || hdr->e_phoff + (uint64_t)hdr->e_phnum * hdr->e_phentsize > fileSize) {
             Memory::g_heap->Free(fileData);
-            return 0;
+            return nullptr;
+        }
+
+        ElfImage* image = (ElfImage*)Memory::g_heap->Request(sizeof(ElfImage));
+        if (image == nullptr) {
+            Memory::g_heap->Free(fileData);
+            return nullptr;
         }
+        memset(image, 0, sizeof(ElfImage));
+
+        int len = 0;
+        for (; len < (int)sizeof(image->path) - 1 && vfsPath[len]; len++) image->path[len] = vfsPath[len];
+        image->path[len] = '\0';
+        image->generation = generation;
+        image->entry = hdr->e_entry;
 
-        // Process program headers
+        // First pass: segment layout
         for (uint16_t i = 0; i < hdr->e_phnum; i++) {
             Elf64ProgramHeader* phdr = (Elf64ProgramHeader*)(fileData + hdr->e_phoff + i * hdr->e_phentsize);
 
@@ -98,32 +164,49 @@ namespace Sched {
                 continue;
             }
 
-            // Allocate pages and map them in the process PML4 with User bit
+            if (image->segmentCount == MaxSegments || phdr->p_offset + phdr->p_filesz > fileSize) {
+                Kt::KernelLogStream(Kt::ERROR, "ELF") << "Malformed program header " << (uint64_t)i;
+                Memory::g_heap->Free(fileData);
+                DestroyImage(image);
+                return nullptr;
+            }
+
             uint64_t segBase = phdr->p_vaddr & ~0xFFFULL;
             uint64_t segEnd = (phdr->p_vaddr + phdr->p_memsz + 0xFFF) & ~0xFFFULL;
-            uint64_t numPages = (segEnd - segBase) / 0x1000;
 
-            for (uint64_t p = 0; p < numPages; p++) {
-                void* page = Memory::g_pfa->AllocateZeroed();
-                if (page == nullptr) {
-                    Kt::KernelLogStream(Kt::ERROR, "ELF") << "Out of physical pages";
-                    Memory::g_heap->Free(fileData);
-                    return 0;
-                }
+            ImageSegment& seg = image->segments[image->segmentCount++];
+            seg.base = segBase;
+            seg.pages = (segEnd - segBase) / 0x1000;
+            seg.firstFrame = image->frameCount;
+            seg.writable = (phdr->p_flags & PF_W) != 0;
+            image->frameCount += seg.pages;
+        }
 
-                uint64_t physAddr = Memory::SubHHDM((uint64_t)page);
-                uint64_t virtAddr = segBase + p * 0x1000;
+        if (image->frameCount == 0) {
+            Kt::KernelLogStream(Kt::ERROR, "ELF") << "No loadable segments";
+            Memory::g_heap->Free(fileData);
+            DestroyImage(image);
+            return nullptr;
+        }
 
-                // Map into the process's PML4 with User bit set
-                if (!Memory::VMM::Paging::MapUserIn(pml4Phys, physAddr, virtAddr)) {
-                    Kt::KernelLogStream(Kt::ERROR, "ELF") << "Failed to map page";
-                    Memory::g_heap->Free(fileData);
-                    return 0;
-                }
+        image->frames = (uint64_t*)Memory::g_heap->Request(image->frameCount * sizeof(uint64_t));
+        if (image->frames == nullptr) {
+            Memory::g_heap->Free(fileData);
+            DestroyImage(image);
+            return nullptr;
+        }
+        memset(image->frames, 0, image->frameCount * sizeof(uint64_t));
 
-                // Copy file data that overlaps this page (via HHDM)
-                uint64_t pageStart = virtAddr;
-                uint64_t pageEnd = virtAddr + 0x1000;
+        // Second pass: copy the file data of each page
+        int segIndex = 0;
+        for (uint16_t i = 0; i < hdr->e_phnum; i++) {
+            Elf64ProgramHeader* phdr = (Elf64ProgramHeader*)(fileData + hdr->e_phoff + i * hdr->e_phentsize);
+            if (phdr->p_type != PT_LOAD || phdr->p_memsz == 0) continue;
+
+            ImageSegment& seg = image->segments[segIndex++];
+            for (uint64_t p = 0; p < seg.pages; p++) {
+                uint64_t pageStart = seg.base + p * 0x1000;
+                uint64_t pageEnd = pageStart + 0x1000;
 
                 uint64_t segFileStart = phdr->p_vaddr;
                 uint64_t segFileEnd = phdr->p_vaddr + phdr->p_filesz;
@@ -131,22 +214,147 @@ namespace Sched {
                 uint64_t copyStart = (pageStart > segFileStart) ? pageStart : segFileStart;
                 uint64_t copyEnd = (pageEnd < segFileEnd) ? pageEnd : segFileEnd;
 
-                if (copyStart < copyEnd) {
-                    uint64_t dstOffset = copyStart - pageStart;
-                    uint64_t srcOffset = copyStart - phdr->p_vaddr + phdr->p_offset;
-                    uint64_t copySize = copyEnd - copyStart;
+                // Pure .bss pages share the zero page
+                if (copyStart >= copyEnd) continue;
 
-                    uint8_t* dst = (uint8_t*)Memory::HHDM(physAddr) + dstOffset;
-                    uint8_t* src = fileData + srcOffset;
-                    memcpy(dst, src, copySize);
+                void* page = Memory::g_pfa->AllocateZeroed();
+                if (page == nullptr) {
+                    Kt::KernelLogStream(Kt::ERROR, "ELF") << "Out of physical pages";
+                    Memory::g_heap->Free(fileData);
+                    DestroyImage(image);
+                    return nullptr;
                 }
+
+                uint64_t dstOffset = copyStart - pageStart;
+                uint64_t srcOffset = copyStart - phdr->p_vaddr + phdr->p_offset;
+                memcpy((uint8_t*)page + dstOffset, fileData + srcOffset, copyEnd - copyStart);
+
+                image->frames[seg.firstFrame + p] = Memory::SubHHDM((uint64_t)page);
             }
         }
 
-        uint64_t entryPoint = hdr->e_entry;
         Memory::g_heap->Free(fileData);
+        return image;
+    }
+
+    // Find an up-to-date image of `path` and take a reference. Images of
+    // a file that changed since are unlisted. Lock must be held.
+    static ElfImage* LookupImageLocked(const char* path, uint64_t generation) {
+        for (int i = 0; i < MaxCachedImages; i++) {
+            ElfImage* image = g_images[i];
+            if (image == nullptr || !StrEqual(image->path, path)) continue;
+
+            if (image->generation != generation) {
+                g_images[i] = nullptr;
+                image->cached = false;
+                if (image->refs == 0) DestroyImage(image);
+                continue;
+            }
+
+            image->refs++;
+            image->lastUse = ++g_useClock;
+            return image;
+        }
+        return nullptr;
+    }
+
+    // List a new image, evicting the least recently used idle one if the
+    // cache is full. With every slot in use the image simply stays
+    // private to its processes. Lock must be held.
+    static void CacheImageLocked(ElfImage* image) {
+        int victim = -1;
+        for (int i = 0; i < MaxCachedImages; i++) {
+            if (g_images[i] == nullptr) {
+                victim = i;
+                break;
+            }
+            if (g_images[i]->refs == 0 && (victim < 0 || g_images[i]->lastUse < g_images[victim]->lastUse)) {
+                victim = i;
+            }
+        }
+        if (victim < 0) return;
+
+        if (g_images[victim]) DestroyImage(g_images[victim]);
+        g_images[victim] = image;
+        image->cached = true;
+    }
+
+    // Take a reference to the image of `vfsPath`, reading the file only
+    // if no current image of it is cached
+    static ElfImage* AcquireImage(const char* vfsPath) {
+        uint64_t generation = Fs::Vfs::VfsPathGeneration(vfsPath);
+
+        g_imagesLock.Acquire();
+        if (g_zeroPage == 0) {
+            void* zero = Memory::g_pfa->AllocateZeroed();
+            if (zero == nullptr) {
+                g_imagesLock.Release();
+                return nullptr;
+            }
+            g_zeroPage = Memory::SubHHDM((uint64_t)zero);
+        }
+        ElfImage* image = LookupImageLocked(vfsPath, generation);
+        g_imagesLock.Release();
+        if (image) return image;
+
+        // Build outside the lock; reading the file can take a while
+        ElfImage* built = BuildImage(vfsPath, generation);
+        if (built == nullptr) return nullptr;
+
+        g_imagesLock.Acquire();
+        image = LookupImageLocked(vfsPath, generation);  // Raced with another spawn?
+        if (image == nullptr) {
+            image = built;
+            image->refs = 1;
+            image->lastUse = ++g_useClock;
+            CacheImageLocked(image);
+            built = nullptr;
+        }
+        g_imagesLock.Release();
+
+        if (built) DestroyImage(built);
+        return image;
+    }
+
+    void ElfRelease(ElfImage* image) {
+        if (image == nullptr) return;
+
+        g_imagesLock.Acquire();
+        image->refs--;
+        bool destroy = image->refs == 0 && !image->cached;
+        g_imagesLock.Release();
+
+        if (destroy) DestroyImage(image);
+    }
+
+    uint64_t ElfLoad(const char* vfsPath, uint64_t pml4Phys, ElfImage** outImage) {
+        ElfImage* image = AcquireImage(vfsPath);
+        if (image == nullptr) {
+            return 0;
+        }
+
+        // Only page tables are built here; FreeUserHalf() leaves the
+        // frames to the image
+        for (int s = 0; s < image->segmentCount; s++) {
+            const ImageSegment& seg = image->segments[s];
+            for (uint64_t p = 0; p < seg.pages; p++) {
+                uint64_t physAddr = image->frames[seg.firstFrame + p];
+                if (physAddr == 0) physAddr = g_zeroPage;
+                uint64_t virtAddr = seg.base + p * 0x1000;
+
+                bool mapped = seg.writable
+                    ? Memory::VMM::Paging::MapUserInCopyOnWrite(pml4Phys, physAddr, virtAddr)
+                    : Memory::VMM::Paging::MapUserInShared(pml4Phys, physAddr, virtAddr, false);
+                if (!mapped) {
+                    Kt::KernelLogStream(Kt::ERROR, "ELF") << "Failed to map page";
+                    ElfRelease(image);
+                    return 0;
+                }
+            }
+        }
 
-        return entryPoint;
+        *outImage = image;
+        return image->entry;
     }
 
 }
@@ -38,12 +38,24 @@ namespace Sched {
     };
 
     static constexpr uint32_t PT_LOAD    = 1;
+    static constexpr uint32_t PF_W       = 2;
     static constexpr uint16_t ET_EXEC    = 2;
     static constexpr uint16_t EM_X86_64  = 62;
 
+    // The loaded PT_LOAD pages of one executable. Kept while any process
+    // runs it, and cached afterwards so the next spawn of the same binary
+    // only has to build page tables.
+    struct ElfImage;
+
     // Load an ELF64 binary into a per-process address space.
     // pml4Phys = physical address of the process's PML4.
+    // Read-only segments map the image's frames directly; writable ones
+    // map them copy-on-write. On success `*outImage` holds a reference
+    // to pass to ElfRelease() once the address space is torn down.
     // Returns the entry point address, or 0 on failure.
-    uint64_t ElfLoad(const char* vfsPath, uint64_t pml4Phys);
+    uint64_t ElfLoad(const char* vfsPath, uint64_t pml4Phys, ElfImage** outImage);
+
+    // Drop a reference taken by ElfLoad(). Safe with nullptr.
+    void ElfRelease(ElfImage* image);
 
 }
@@ -8,51 +8,1154 @@
 #include "ElfLoader.hpp"
 #include <Memory/PageFrameAllocator.hpp>
 #include <Memory/Paging.hpp>
+#include <Memory/Pcid.hpp>
+#include <Memory/Tlb.hpp>
 #include <Memory/HHDM.hpp>
+#include <Memory/Heap.hpp>
+#include <Memory/Zram.hpp>
 #include <Libraries/Memory.hpp>
 #include <Terminal/Terminal.hpp>
 #include <CppLib/Stream.hpp>
 #include <CppLib/Spinlock.hpp>
 #include <Hal/Apic/Apic.hpp>
+#include <Hal/Apic/Interrupts.hpp>
+#include <Hal/Cpu.hpp>
+#include <Hal/Fpu.hpp>
+#include <Hal/Pmu.hpp>
 #include <Hal/GDT.hpp>
 #include <Hal/SmpBoot.hpp>
 #include <Timekeeping/ApicTimer.hpp>
 #include <Api/WinServer.hpp>
+#include <Api/Pipe.hpp>
+#include <Api/Channel.hpp>
+#include <Common/Trace.hpp>
 
-// Assembly: context switch with CR3 and FPU state parameters
-extern "C" void SchedContextSwitch(uint64_t* oldRsp, uint64_t newRsp, uint64_t newCR3,
-                                   uint8_t* oldFpuArea, uint8_t* newFpuArea);
+// Assembly: context switch with CR3 parameter
+extern "C" void SchedContextSwitch(uint64_t* oldRsp, uint64_t newRsp, uint64_t newCR3);
 
 // Assembly: jump to user mode via IRETQ
-extern "C" void JumpToUserMode(uint64_t rip, uint64_t rsp);
+extern "C" void JumpToUserMode(uint64_t rip, uint64_t rsp, uint64_t arg);
 
 namespace Sched {
 
-    static Process processTable[MaxProcesses];
+    // Process table storage, SlotChunk slots at a time (see GrowSlots).
+    // Slots are still plain indices: a chunk directory maps each to its
+    // entry, and a chunk is never freed, so an index or pointer read
+    // without procLock always refers to some slot's storage.
+    template <typename T>
+    struct SlotTable {
+        T* chunks[MaxProcesses / SlotChunk];
+        T& operator[](int slot) const { return chunks[slot / SlotChunk][slot % SlotChunk]; }
+    };
+    static_assert(MaxProcesses % SlotChunk == 0, "the table is a whole number of chunks");
+    static SlotTable<Process> processTable;
+    static SlotTable<SchedEntity> schedTable;
+    static int slotCount = 0;      // Slots allocated, written under procLock
+    static kcp::Mutex slotGrowLock; // Serializes GrowSlots
+
+    // Slot lists and PID hash, see "Slot bookkeeping" below
+    static constexpr int PidHashSize = 4 * MaxProcesses;
+    static_assert((PidHashSize & (PidHashSize - 1)) == 0, "PID hash size must be a power of two");
+    static int pidHash[PidHashSize];
+    static int pidHashProbe = 1;
+    static int freeHead = -1;
+    static int usedHead = -1;
+    static int deadHead = -1;
     static int nextPid = 0;
 
-    // The scheduler lock MUST be a Spinlock (interrupt-disabling).
-    // It is held ACROSS context switches to prevent the race where
-    // another CPU picks up a process whose RSP hasn't been saved yet.
-    // The resumed process releases it.
-    static kcp::Spinlock schedLock;
+    // Guards process lifetime: slot allocation, exit/kill and the
+    // waitpid wakeup handshake. Lock order is procLock -> run queue
+    // lock; a run queue lock is never held while taking procLock.
+    static kcp::LockStat procLockStat{"proc"};
+    static kcp::TicketLock procLock{&procLockStat};
+
+    // Futex wait queues, hashed by address so a wake walks only the
+    // threads waiting on addresses in its own bucket. A waiting thread is
+    // on its bucket's FIFO list, linked through Process::futexNext, for
+    // exactly as long as its futexAddr is set. Lock order is bucket lock
+    // -> run queue lock. The bucket locks share one LockStat name, like
+    // the run queues, so lockstat shows them as a single "futex" lock.
+    struct FutexBucket {
+        kcp::LockStat lockStat{"futex"};
+        kcp::TicketLock lock{&lockStat};
+        int head = -1;
+        int tail = -1;
+    };
+    static constexpr int FutexBucketBits = 6;
+    static FutexBucket futexBuckets[1 << FutexBucketBits];
+
+    static FutexBucket& FutexBucketFor(uint64_t addr) {
+        // Fibonacci hash of the word index: neighbouring words and words at
+        // the same offset in different pages land in different buckets
+        return futexBuckets[((addr >> 2) * 0x9E3779B97F4A7C15ULL) >> (64 - FutexBucketBits)];
+    }
+
+    // Take a thread off its bucket's list. Caller holds the bucket lock.
+    static void FutexUnlink(FutexBucket& bucket, int slot) {
+        int prev = -1;
+        int* link = &bucket.head;
+        while (*link >= 0 && *link != slot) {
+            prev = *link;
+            link = &processTable[*link].futexNext;
+        }
+        if (*link < 0) return;
+        *link = processTable[slot].futexNext;
+        if (bucket.tail == slot) bucket.tail = prev;
+        processTable[slot].futexNext = -1;
+        processTable[slot].futexAddr = 0;
+    }
 
-    // Approximate count of Ready processes. Incremented/decremented
-    // under schedLock. Idle CPUs check this to avoid scanning all 256
-    // process slots on every timer tick.
-    static volatile int readyCount = 0;
+    static constexpr uint64_t NoDeadline = ~0ULL;
+
+    // Readiness channels for SYS_EPOLL_WAIT. A source key hashes to a
+    // channel, which holds a bit per listener subscribed to some key that
+    // hashes there. Each listener has its own generation, bumped by
+    // NotifyReady and slept on as a kernel futex word; readyWaiters lets
+    // NotifyReady skip the wake while the listener is not waiting.
+    static constexpr int ReadyChannelBits = 8;
+    static constexpr int ReadyChannels = 1 << ReadyChannelBits;
+    static_assert(MaxReadyListeners <= 64, "a channel's listeners are one 64-bit mask");
+    static volatile uint64_t readyChannels[ReadyChannels];
+    static uint64_t readySubscribed[MaxReadyListeners][ReadyChannels / 64];  // Channels each listener is on
+    static volatile uint32_t readyGenerations[MaxReadyListeners];
+    static volatile uint32_t readyWaiters[MaxReadyListeners];
+
+    // Per-CPU ready queue: one FIFO list per scheduling class, linked
+    // through Process::rqNext, so picking the next process is O(1).
+    //
+    // A queue's lock MUST be interrupt-disabling (TicketLock). It is
+    // held ACROSS context switches on its CPU to prevent the race where
+    // another CPU steals a process whose RSP hasn't been saved yet.
+    // The resumed context releases it (see FinishSwitch).
+    struct RunQueue {
+        kcp::LockStat lockStat{"runqueue"};
+        kcp::TicketLock lock{&lockStat};
+        int head[PriorityCount] = {-1, -1, -1, -1};
+        int tail[PriorityCount] = {-1, -1, -1, -1};
+        volatile int count = 0;   // Processes queued over all classes
+        int prevSlot = -1;   // Slot being switched away from (-1 = idle)
+        int migrateSlot = -1; // prevSlot must move to a CPU its affinity allows
+        uint64_t nextWakeUs = NoDeadline; // Earliest deadline of a sleeper blocked on this CPU
+
+        // Sleep deadlines of processes blocked on this CPU, a binary
+        // min-heap. A sleeper woken early leaves its entry behind; it is
+        // dropped when it reaches the top (see SleeperDue). It has room
+        // for one entry per process table slot (see ReserveTimers).
+        struct Timer {
+            uint64_t deadlineUs;
+            int slot;
+        };
+        Timer* timers = nullptr;
+        int timerCapacity = 0;
+        int timerCount = 0;
+    };
+
+    static RunQueue runQueues[Smp::MaxCPUs];
 
-    // The idle loop runs in the kernel PML4
     static uint64_t GetKernelCR3() {
         return (uint64_t)Memory::VMM::g_paging->PML4;
     }
 
+    // ====================================================================
+    // Run queue primitives -- caller holds runQueues[cpuIndex].lock
+    // ====================================================================
+
+    // With a one-shot timer an idle CPU sleeps until an interrupt, so it
+    // has to be told about new work with a reschedule IPI.
+    static bool KickIfIdle(int cpuIndex) {
+        auto* c = Smp::GetCpuData(cpuIndex);
+        if (c == nullptr || !c->started || c->currentSlot >= 0) return false;
+        if (c == Smp::GetCurrentCpuData()) return false;
+        Hal::LocalApic::SendIpi(c->lapicId, Hal::IRQ_VECTOR_BASE + Hal::IRQ_RESCHEDULE);
+        return true;
+    }
+
+    // Class a process is queued and compared at: its own, raised to
+    // interactive while an input boost lasts.
+    static int Level(const SchedEntity& se) {
+        int level = se.priority;
+        if (se.boost > 0 && level > Montauk::PRIO_INTERACTIVE) level = Montauk::PRIO_INTERACTIVE;
+        return level;
+    }
+
+    static uint64_t SliceUs(const SchedEntity& se) {
+        uint64_t ms = (Level(se) == Montauk::PRIO_BATCH) ? BatchSliceMs : TimeSliceMs;
+        return ms * 1000;
+    }
+
+    // End the slice of whatever `c` is running right away. A zeroed
+    // sliceEndUs tells Tick this is a preemption, not a used-up slice.
+    static void Preempt(Smp::CpuData* c, SchedEntity& cur) {
+        cur.sliceEndUs = 0;
+        if (c == Smp::GetCurrentCpuData()) {
+            Timekeeping::ArmTimer(0);
+        } else {
+            Hal::LocalApic::SendIpi(c->lapicId, Hal::IRQ_VECTOR_BASE + Hal::IRQ_RESCHEDULE);
+        }
+    }
+
+    // A process of class `level` became ready on `cpuIndex`: preempt it
+    // if it is running something of a lower class
+    static void PreemptIfLower(int cpuIndex, int level) {
+        auto* c = Smp::GetCpuData(cpuIndex);
+        if (c == nullptr || !c->started || c->currentSlot < 0) return;
+        SchedEntity& cur = schedTable[c->currentSlot];
+        if (Level(cur) > level) Preempt(c, cur);
+    }
+
+    static void Enqueue(int cpuIndex, int slot) {
+        RunQueue& rq = runQueues[cpuIndex];
+        SchedEntity& se = schedTable[slot];
+        int level = Level(se);
+        se.cpu = cpuIndex;
+        se.rqNext = -1;
+        se.rqLevel = (uint8_t)level;
+        se.queuedAtUs = Timekeeping::GetMicroseconds();
+        se.queued = true;
+        if (rq.tail[level] >= 0) schedTable[rq.tail[level]].rqNext = slot;
+        else rq.head[level] = slot;
+        rq.tail[level] = slot;
+        rq.count = rq.count + 1;
+
+        // Wake the owner if it is idle, or cut short a lower class running
+        // there. If it already has a backlog, wake one idle CPU so it can
+        // steal.
+        if (!KickIfIdle(cpuIndex)) PreemptIfLower(cpuIndex, level);
+        if (rq.count > 1) {
+            int cpuCount = Smp::GetCpuCount();
+            for (int i = 0; i < cpuCount; i++) {
+                if (i != cpuIndex && KickIfIdle(i)) break;
+            }
+        }
+    }
+
+    static void RemoveFromQueue(int cpuIndex, int slot) {
+        RunQueue& rq = runQueues[cpuIndex];
+        int level = schedTable[slot].rqLevel;
+        int prev = -1;
+        for (int i = rq.head[level]; i >= 0; prev = i, i = schedTable[i].rqNext) {
+            if (i != slot) continue;
+            int after = schedTable[i].rqNext;
+            if (prev >= 0) schedTable[prev].rqNext = after;
+            else rq.head[level] = after;
+            if (rq.tail[level] == slot) rq.tail[level] = prev;
+            schedTable[slot].rqNext = -1;
+            schedTable[slot].queued = false;
+            rq.count = rq.count - 1;
+            return;
+        }
+    }
+
+    static bool Allowed(const SchedEntity& se, int cpuIndex) {
+        return (se.affinity >> cpuIndex) & 1;
+    }
+
+    // Take the first process allowed on `forCpu` from the highest
+    // non-empty class of cpuIndex's queue. One that has been waiting for
+    // StarvationMs goes first regardless of class, so a busy higher class
+    // slows lower ones down but never stops them.
+    static int Dequeue(int cpuIndex, int forCpu) {
+        RunQueue& rq = runQueues[cpuIndex];
+        if (rq.count == 0) return -1;
+
+        int first[PriorityCount];
+        for (int l = 0; l < PriorityCount; l++) {
+            first[l] = -1;
+            for (int i = rq.head[l]; i >= 0; i = schedTable[i].rqNext) {
+                if (Allowed(schedTable[i], forCpu)) {
+                    first[l] = i;
+                    break;
+                }
+            }
+        }
+
+        int slot = -1;
+        uint64_t now = Timekeeping::GetMicroseconds();
+        uint64_t oldest = NoDeadline;
+        for (int l = 0; l < PriorityCount; l++) {
+            if (first[l] < 0) continue;
+            uint64_t since = schedTable[first[l]].queuedAtUs;
+            if (now - since >= StarvationMs * 1000 && since < oldest) {
+                oldest = since;
+                slot = first[l];
+            }
+        }
+        for (int l = 0; slot < 0 && l < PriorityCount; l++) {
+            slot = first[l];
+        }
+        if (slot < 0) return -1;
+
+        RemoveFromQueue(cpuIndex, slot);
+        return slot;
+    }
+
+    // Lock the run queue that owns a process. The owner can change under
+    // work stealing until its lock is held, so re-check after acquiring.
+    static int LockOwner(int slot) {
+        for (;;) {
+            int c = schedTable[slot].cpu;
+            runQueues[c].lock.Acquire();
+            if (schedTable[slot].cpu == c) return c;
+            runQueues[c].lock.Release();
+        }
+    }
+
+    // Lock the run queue of the CPU we are running on. Until the lock is
+    // held (interrupts off) we can be preempted and migrate, so re-check.
+    static Smp::CpuData* LockLocalQueue() {
+        for (;;) {
+            auto* cpu = Smp::GetCurrentCpuData();
+            runQueues[cpu->cpuIndex].lock.Acquire();
+            if (Smp::GetCurrentCpuData() == cpu) return cpu;
+            runQueues[cpu->cpuIndex].lock.Release();
+        }
+    }
+
+    // Take one Ready process that may run here from another CPU, trying
+    // the busiest first. Called with the local queue lock held, so victims
+    // are only try-locked: two CPUs stealing from each other must never
+    // deadlock.
+    static int TryStealFrom(int victim, int self) {
+        RunQueue& vq = runQueues[victim];
+        if (!vq.lock.TryAcquire()) return -1;
+        int slot = Dequeue(victim, self);
+        if (slot >= 0) schedTable[slot].cpu = self;
+        vq.lock.Release();
+        return slot;
+    }
+
+    static int Steal(int self) {
+        int victim = -1;
+        int best = 0;
+        int cpuCount = Smp::GetCpuCount();
+        for (int i = 0; i < cpuCount; i++) {
+            if (i == self) continue;
+            int c = runQueues[i].count;
+            if (c > best) {
+                best = c;
+                victim = i;
+            }
+        }
+        if (victim < 0) return -1;
+
+        int slot = TryStealFrom(victim, self);
+        if (slot >= 0) return slot;
+
+        // Everything there may be pinned elsewhere; try the rest
+        for (int i = 0; i < cpuCount; i++) {
+            if (i == self || i == victim || runQueues[i].count == 0) continue;
+            slot = TryStealFrom(i, self);
+            if (slot >= 0) return slot;
+        }
+        return -1;
+    }
+
+    static int PickNext(int self) {
+        int next = Dequeue(self, self);
+        if (next < 0) next = Steal(self);
+        return next;
+    }
+
+    // Cheap check used by idle CPUs: is anything runnable here or
+    // stealable from another CPU? Reads counts only, takes no locks.
+    static bool AnyReady(int self) {
+        if (runQueues[self].count > 0) return true;
+        int cpuCount = Smp::GetCpuCount();
+        for (int i = 0; i < cpuCount; i++) {
+            if (i != self && runQueues[i].count > 0) return true;
+        }
+        return false;
+    }
+
+    // Placement for new processes, and for processes moved off a CPU their
+    // affinity no longer allows: the CPU in `mask` with the shortest queue.
+    static int PickCpu(uint64_t mask) {
+        int self = Smp::GetCurrentCpuData()->cpuIndex;
+        int best = -1;
+        int bestCount = 0;
+        if ((mask >> self) & 1) {
+            best = self;
+            bestCount = runQueues[self].count;
+        }
+        int cpuCount = Smp::GetCpuCount();
+        for (int i = 0; i < cpuCount; i++) {
+            auto* c = Smp::GetCpuData(i);
+            if (c == nullptr || !c->started || !((mask >> i) & 1)) continue;
+            if (best < 0 || runQueues[i].count < bestCount) {
+                bestCount = runQueues[i].count;
+                best = i;
+            }
+        }
+        return (best >= 0) ? best : self;
+    }
+
+    // Charge the cycles since the last stamp to the thread's user or
+    // kernel time and restart the stamp. Interrupts are off.
+    static void ChargeCpuTime(Process& proc) {
+        uint64_t now = Hal::ReadTsc();
+        uint64_t delta = (now > proc.stampTsc) ? now - proc.stampTsc : 0; // TSC restarts across S3
+        if (proc.inSyscall) proc.kernelTsc += delta;
+        else proc.userTsc += delta;
+        proc.stampTsc = now;
+    }
+
+    // ====================================================================
+    // Lazy FPU switching
+    //
+    // A CPU's FPU registers belong to cpu->fpuOwner. A process switched in
+    // runs with CR0.TS set unless its state is still in this CPU's
+    // registers; its first FPU/SSE instruction traps (#NM) and loads the
+    // state then. Processes that never touch the FPU (most of the shell
+    // tools) never pay for a save or restore.
+    //
+    // A live owner is saved when it switches out, before its RSP is
+    // published, so another CPU can always restore it from memory.
+    // Process::fpuCpu tells whether the registers here are still current:
+    // it changes whenever the state is loaded on some other CPU.
+    // ====================================================================
+
+    static void SaveFpuIfLive(Smp::CpuData* cpu, int slot) {
+        if (cpu->fpuLive && cpu->fpuOwner == slot) {
+            Hal::Fpu::Save(processTable[slot].fpuState);
+        }
+    }
+
+    static void ArmFpu(Smp::CpuData* cpu, int slot) {
+        bool valid = cpu->fpuOwner == slot && processTable[slot].fpuCpu == cpu->cpuIndex;
+        if (valid) {
+            if (!cpu->fpuLive) Hal::Fpu::ClearTaskSwitched();
+            cpu->fpuLive = true;
+        } else if (cpu->fpuLive) {
+            Hal::Fpu::SetTaskSwitched();
+            cpu->fpuLive = false;
+        }
+    }
+
+    void HandleFpuTrap() {
+        auto* cpu = Smp::GetCurrentCpuData();
+        int slot = cpu->currentSlot;
+        Hal::Fpu::ClearTaskSwitched();
+        cpu->fpuLive = true;
+        if (slot < 0) return;
+
+        Process& proc = processTable[slot];
+        if (cpu->fpuOwner != slot || proc.fpuCpu != cpu->cpuIndex) {
+            Hal::Fpu::Restore(proc.fpuState);
+            cpu->fpuOwner = slot;
+            proc.fpuCpu = cpu->cpuIndex;
+        }
+    }
+
+    void SaveFpuState() {
+        uint64_t flags;
+        asm volatile("pushfq; pop %0; cli" : "=r"(flags) :: "memory");
+        auto* cpu = Smp::GetCurrentCpuData();
+        if (cpu->fpuOwner >= 0) SaveFpuIfLive(cpu, cpu->fpuOwner);
+        cpu->fpuOwner = -1;
+        if (cpu->fpuLive) Hal::Fpu::SetTaskSwitched();
+        cpu->fpuLive = false;
+        asm volatile("push %0; popfq" :: "r"(flags) : "memory");
+    }
+
+    // Hardware counters are per CPU, so a counting thread takes them with
+    // it: they are read into pmuCounts at switch-out and restarted from
+    // zero at switch-in. Threads that count nothing never touch an MSR.
+    static void SavePmu(Process& proc) {
+        Hal::Pmu::Read(proc.pmuEvents, proc.pmuCounts);
+        Hal::Pmu::Stop();
+    }
+
+    // Start a fresh time slice and make sure this CPU's timer ends it
+    static void StartSlice(SchedEntity& se) {
+        se.sliceEndUs = Timekeeping::GetMicroseconds() + SliceUs(se);
+        Timekeeping::ArmTimer(se.sliceEndUs);
+    }
+
+    // Whether a timer entry is still the live deadline of its process,
+    // rather than left behind by one woken early. Queue lock held.
+    static bool SleeperDue(int cpuIndex, const RunQueue::Timer& t) {
+        const SchedEntity& se = schedTable[t.slot];
+        return se.cpu == cpuIndex && se.state == ProcessState::Blocked &&
+               se.sleepUntilUs == t.deadlineUs;
+    }
+
+    static void TimerSiftDown(RunQueue& rq, int i) {
+        for (;;) {
+            int least = i;
+            int l = 2 * i + 1, r = 2 * i + 2;
+            if (l < rq.timerCount && rq.timers[l].deadlineUs < rq.timers[least].deadlineUs) least = l;
+            if (r < rq.timerCount && rq.timers[r].deadlineUs < rq.timers[least].deadlineUs) least = r;
+            if (least == i) return;
+            RunQueue::Timer t = rq.timers[i];
+            rq.timers[i] = rq.timers[least];
+            rq.timers[least] = t;
+            i = least;
+        }
+    }
+
+    static void TimerPop(RunQueue& rq) {
+        rq.timers[0] = rq.timers[--rq.timerCount];
+        TimerSiftDown(rq, 0);
+    }
+
+    // Drop entries left behind by sleepers woken early and rebuild the
+    // heap. At most one entry per slot is live, and the slot pushing has
+    // none, so this always makes room.
+    static void TimerCompact(int cpuIndex) {
+        RunQueue& rq = runQueues[cpuIndex];
+        int kept = 0;
+        for (int i = 0; i < rq.timerCount; i++) {
+            if (SleeperDue(cpuIndex, rq.timers[i])) rq.timers[kept++] = rq.timers[i];
+        }
+        rq.timerCount = kept;
+        for (int i = kept / 2 - 1; i >= 0; i--) TimerSiftDown(rq, i);
+    }
+
+    // Make room for `slots` entries in every CPU's timer heap, before the
+    // table grows to that many slots. Called from GrowSlots with no queue
+    // lock held. Returns false if out of memory.
+    static bool ReserveTimers(int slots) {
+        int cpus = Smp::GetCpuCount();
+        if (cpus < 1) cpus = 1;
+        for (int c = 0; c < cpus; c++) {
+            RunQueue& rq = runQueues[c];
+            if (rq.timerCapacity >= slots) continue;
+
+            auto* timers = (RunQueue::Timer*)Memory::g_heap->Request(slots * sizeof(RunQueue::Timer));
+            if (timers == nullptr) return false;
+
+            rq.lock.Acquire();
+            RunQueue::Timer* old = rq.timers;
+            for (int i = 0; i < rq.timerCount; i++) timers[i] = old[i];
+            rq.timers = timers;
+            rq.timerCapacity = slots;
+            rq.lock.Release();
+
+            if (old != nullptr) Memory::g_heap->Free(old);
+        }
+        return true;
+    }
+
+    // Record the sleep deadline of the process in `slot`, blocking on this
+    // CPU, and arm the timer for it. Caller holds runQueues[cpuIndex].lock.
+    static void NoteSleeper(int cpuIndex, int slot, uint64_t deadlineUs) {
+        RunQueue& rq = runQueues[cpuIndex];
+        if (rq.timerCount == rq.timerCapacity) TimerCompact(cpuIndex);
+
+        int i = rq.timerCount++;
+        while (i > 0 && rq.timers[(i - 1) / 2].deadlineUs > deadlineUs) {
+            rq.timers[i] = rq.timers[(i - 1) / 2];
+            i = (i - 1) / 2;
+        }
+        rq.timers[i] = {deadlineUs, slot};
+
+        if (deadlineUs < rq.nextWakeUs) rq.nextWakeUs = deadlineUs;
+        Timekeeping::ArmTimer(deadlineUs);
+    }
+
+    // Runs in the resumed context right after SchedContextSwitch returns
+    // (and at the top of ProcessStartup). Marks the context we switched
+    // away from as saved, then drops the queue lock held across the
+    // switch. Re-reads the CPU: the resumed process may have been
+    // switched out on a different CPU than the one it resumes on.
+    //
+    // A process that was switched out to leave a CPU its affinity no
+    // longer allows is re-queued on an allowed one from here, once its
+    // context is saved.
+    static void WakeBlocked(int slot);
+
+    static void FinishSwitch() {
+        RunQueue& rq = runQueues[Smp::GetCurrentCpuData()->cpuIndex];
+        int migrate = rq.migrateSlot;
+        rq.migrateSlot = -1;
+        if (rq.prevSlot >= 0) {
+            schedTable[rq.prevSlot].onCpu = false;
+            rq.prevSlot = -1;
+        }
+        rq.lock.Release();
+
+        if (migrate >= 0) WakeBlocked(migrate);
+    }
+
+    // Switch this CPU from its current context to `next`, or to the idle
+    // context if next < 0. Caller holds this CPU's queue lock and has
+    // already moved the current process out of Running (or queued it).
+    static void SwitchTo(Smp::CpuData* cpu, int next) {
+        RunQueue& rq = runQueues[cpu->cpuIndex];
+        int oldSlot = cpu->currentSlot;
+
+        if (next == oldSlot) {
+            // A waker re-queued the current process before it managed to
+            // switch away, and we popped it straight back off. Keep going.
+            if (next >= 0) {
+                schedTable[next].state = ProcessState::Running;
+                schedTable[next].runningOnCpu = cpu->cpuIndex;
+                ChargeCpuTime(processTable[next]);
+                StartSlice(schedTable[next]);
+            }
+            rq.lock.Release();
+            return;
+        }
+
+        uint64_t* oldRspPtr = &cpu->idleSavedRsp;
+        if (oldSlot >= 0) {
+            ChargeCpuTime(processTable[oldSlot]);
+            schedTable[oldSlot].runningOnCpu = -1;
+            oldRspPtr = &schedTable[oldSlot].savedRsp;
+            if (schedTable[oldSlot].state == ProcessState::Blocked) processTable[oldSlot].voluntarySwitches++;
+            else processTable[oldSlot].involuntarySwitches++;
+            SaveFpuIfLive(cpu, oldSlot);
+            if (processTable[oldSlot].pmuEvents) SavePmu(processTable[oldSlot]);
+        }
+        rq.prevSlot = oldSlot;
+
+        if (Trace::On(Montauk::TRACE_SCHED)) {
+            int prevPid = oldSlot >= 0 ? processTable[oldSlot].pid : -1;
+            int nextPid = next >= 0 ? processTable[next].pid : -1;
+            bool blocked = oldSlot >= 0 && schedTable[oldSlot].state == ProcessState::Blocked;
+            if (blocked) Trace::Write(Montauk::TRACE_EV_BLOCK, (uint32_t)prevPid, 0, 0);
+            Trace::Write(Montauk::TRACE_EV_SWITCH, (uint32_t)prevPid, (uint64_t)(int64_t)nextPid, blocked);
+        }
+
+        if (next < 0) {
+            cpu->currentSlot = -1;
+            Memory::VMM::Tlb::SetActive(cpu->cpuIndex, GetKernelCR3());
+            SchedContextSwitch(oldRspPtr, cpu->idleSavedRsp,
+                               Memory::VMM::Pcid::MakeCR3(cpu->cpuIndex, GetKernelCR3(), 0));
+        } else {
+            Process& proc = processTable[next];
+            SchedEntity& se = schedTable[next];
+
+            // A woken process may still be finishing its switch-out on
+            // the CPU it blocked on; wait until its RSP has been saved.
+            while (se.onCpu) {
+                asm volatile("pause");
+            }
+
+            se.onCpu = true;
+            se.state = ProcessState::Running;
+            se.runningOnCpu = cpu->cpuIndex;
+            se.cpu = cpu->cpuIndex;
+            proc.stampTsc = Hal::ReadTsc();
+            StartSlice(se);
+            cpu->currentSlot = next;
+            ArmFpu(cpu, next);
+            if (proc.pmuEvents) {
+                Hal::Pmu::Start(proc.pmuEvents, proc.pmuFlags & Montauk::PERF_USER_ONLY);
+            }
+
+            // Update per-CPU kernel RSP and TSS RSP0
+            cpu->kernelRsp = proc.kernelStackTop;
+            cpu->tss->rsp0 = proc.kernelStackTop;
+
+            Memory::VMM::Tlb::SetActive(cpu->cpuIndex, proc.pml4Phys);
+
+            // Threads share their leader's PML4, so they share its tag too
+            SchedContextSwitch(oldRspPtr, se.savedRsp,
+                               Memory::VMM::Pcid::MakeCR3(cpu->cpuIndex, proc.pml4Phys, proc.pcid));
+        }
+
+        // We reach here when the old context is resumed by some CPU's
+        // SwitchTo. That CPU held its queue lock across the switch.
+        FinishSwitch();
+    }
+
+    // Move a Blocked process back to Ready on the CPU it last ran on.
+    // The blocking CPU holds that queue lock until the process's context
+    // has been saved, so the state check here cannot race the switch-out.
+    //
+    // If its affinity no longer allows that CPU, hand it to one that is
+    // allowed first. The owner may change while Blocked as long as the
+    // owner's lock is held, so this is just another LockOwner round.
+    static void WakeBlocked(int slot) {
+        SchedEntity& se = schedTable[slot];
+        for (;;) {
+            int c = LockOwner(slot);
+            if (se.state != ProcessState::Blocked) {
+                runQueues[c].lock.Release();
+                return;
+            }
+            if (!Allowed(se, c)) {
+                int target = PickCpu(se.affinity);
+                if (target != c) {
+                    se.cpu = target;
+                    runQueues[c].lock.Release();
+                    continue;
+                }
+            }
+            se.sleepUntilUs = 0;
+            se.state = ProcessState::Ready;
+            Enqueue(c, slot);
+            runQueues[c].lock.Release();
+            Trace::Emit(Montauk::TRACE_SCHED, Montauk::TRACE_EV_WAKEUP, (uint32_t)processTable[slot].pid, (uint64_t)c);
+            return;
+        }
+    }
+
+    // Wake every process blocked in waitpid on `pid`. Caller holds procLock.
+    static void WakeWaiters(int pid) {
+        for (int i = usedHead; i >= 0; i = processTable[i].listNext) {
+            if (schedTable[i].state == ProcessState::Blocked &&
+                processTable[i].waitingForPid == pid) {
+                processTable[i].waitingForPid = -1;
+                WakeBlocked(i);
+            }
+        }
+    }
+
+    // ====================================================================
+    // Thread groups
+    //
+    // A process is a group of slots sharing the leader's PML4. The leader
+    // counts the threads still using the address space (groupRefs); the
+    // process is alive, and its memory, windows and I/O buffers are kept,
+    // until the count drops to zero -- even if the leader thread itself
+    // has already exited.
+    // ====================================================================
+
+    static bool IsLiveState(ProcessState s) {
+        return s == ProcessState::Ready || s == ProcessState::Running ||
+               s == ProcessState::Blocked;
+    }
+
+    static bool SlotAlive(int slot) {
+        const Process& proc = processTable[slot];
+        if (proc.leaderSlot == slot) return proc.groupRefs > 0;
+        return IsLiveState(proc.sched->state);
+    }
+
+    // ====================================================================
+    // Slot bookkeeping
+    //
+    // Every slot is on exactly one of two lists linked through listNext/
+    // listPrev: the free stack, or the list of slots in use (reserved,
+    // live or terminated). Terminated slots are also on a list of their
+    // own, through deadNext, so the BSP's per-tick reclaim walks only
+    // those. The lists and the PID hash are guarded by procLock.
+    //
+    // The PID hash maps an ID to its slot with linear probing. PIDs are
+    // never reused, so a bucket is simply cleared when its slot is freed,
+    // and readers without procLock (IsAlive, GetProcessByPid) confirm a hit
+    // against the slot's pid. It has four buckets per slot, so probes stay
+    // short; pidHashProbe is the longest any insert needed.
+    // ====================================================================
+
+    static void PidHashInsert(int slot) {
+        Process& proc = processTable[slot];
+        int home = proc.pid & (PidHashSize - 1);
+        for (int i = 0; i < PidHashSize; i++) {
+            int b = (home + i) & (PidHashSize - 1);
+            if (pidHash[b] >= 0) continue;
+            __atomic_store_n(&pidHash[b], slot, __ATOMIC_RELEASE);
+            proc.pidBucket = b;
+            if (i + 1 > pidHashProbe) __atomic_store_n(&pidHashProbe, i + 1, __ATOMIC_RELEASE);
+            return;
+        }
+    }
+
+    static void PidHashRemove(int slot) {
+        Process& proc = processTable[slot];
+        if (proc.pidBucket < 0) return;
+        __atomic_store_n(&pidHash[proc.pidBucket], -1, __ATOMIC_RELEASE);
+        proc.pidBucket = -1;
+    }
+
+    // Give a new thread its ID and make it findable. Caller holds procLock.
+    static void AssignPid(int slot) {
+        processTable[slot].pid = nextPid++;
+        PidHashInsert(slot);
+    }
+
+    // Take a slot off the free stack for a new process or thread, reserved
+    // as Running so the scheduler leaves it alone and with no IDs, so
+    // lookups can't find it. Caller holds procLock. Returns -1 if none is free.
+    static int TakeFreeSlot() {
+        int slot = freeHead;
+        if (slot < 0) return -1;
+        Process& proc = processTable[slot];
+        freeHead = proc.listNext;
+
+        proc.listPrev = -1;
+        proc.listNext = usedHead;
+        if (usedHead >= 0) processTable[usedHead].listPrev = slot;
+        usedHead = slot;
+
+        proc.sched->state = ProcessState::Running;
+        proc.sched->runningOnCpu = -1;
+        proc.pid = -1;
+        proc.tgid = -1;
+        proc.leaderSlot = -1;
+        return slot;
+    }
+
+    // A chunk holds the scheduling entries of its slots, then the slots
+    static constexpr uint64_t SlotChunkBytes = SlotChunk * (sizeof(SchedEntity) + sizeof(Process));
+    static constexpr int SlotChunkPages = (int)((SlotChunkBytes + 0xFFF) / 0x1000);
+    static_assert((SlotChunk * sizeof(SchedEntity)) % alignof(Process) == 0,
+                  "slots in a chunk must stay aligned");
+
+    // Set up a slot in zeroed chunk memory as free: everything whose free
+    // value is not zero
+    static void InitSlot(int slot) {
+        Process& proc = processTable[slot];
+        SchedEntity& se = schedTable[slot];
+        proc.pid = -1;
+        proc.sched = &se;
+        proc.waitingForPid = -1;
+        proc.futexNext = -1;
+        proc.pmuParent = -1;
+        proc.tgid = -1;
+        proc.leaderSlot = -1;
+        proc.pidBucket = -1;
+        proc.listNext = -1;
+        proc.listPrev = -1;
+        proc.deadNext = -1;
+        proc.stackWindow = -1;
+        proc.parentPid = -1;
+        proc.stdinPipe = -1;
+        proc.stdoutPipe = -1;
+        proc.fpuCpu = -1;
+        se.state = ProcessState::Free;
+        se.rqNext = -1;
+        se.runningOnCpu = -1;
+        se.priority = Montauk::PRIO_NORMAL;
+        se.affinity = ~0ULL;
+    }
+
+    // Add a chunk of free slots to the table, once every slot is taken.
+    // Returns false at MaxProcesses or when out of memory. Process
+    // context only; takes procLock briefly itself.
+    static bool GrowSlots() {
+        slotGrowLock.Acquire();
+
+        // Another thread may have grown the table while we waited
+        procLock.Acquire();
+        int base = slotCount;
+        bool haveFree = freeHead >= 0;
+        procLock.Release();
+        if (haveFree || base >= MaxProcesses) {
+            slotGrowLock.Release();
+            return haveFree;
+        }
+
+        void* mem = Memory::g_pfa->AllocateContiguous(SlotChunkPages);
+        if (mem == nullptr || !ReserveTimers(base + SlotChunk)) {
+            if (mem != nullptr) Memory::g_pfa->Free(mem, SlotChunkPages);
+            slotGrowLock.Release();
+            return false;
+        }
+        memset(mem, 0, (uint64_t)SlotChunkPages * 0x1000);
+        schedTable.chunks[base / SlotChunk] = (SchedEntity*)mem;
+        processTable.chunks[base / SlotChunk] =
+            (Process*)((uint8_t*)mem + SlotChunk * sizeof(SchedEntity));
+        for (int i = base; i < base + SlotChunk; i++) InitSlot(i);
+
+        // Pushed in reverse, so slots are handed out from the lowest up
+        procLock.Acquire();
+        for (int i = base + SlotChunk - 1; i >= base; i--) {
+            processTable[i].listNext = freeHead;
+            freeHead = i;
+        }
+        __atomic_store_n(&slotCount, base + SlotChunk, __ATOMIC_RELEASE);
+        procLock.Release();
+
+        slotGrowLock.Release();
+        return true;
+    }
+
+    // Take a free slot as TakeFreeSlot does, growing the table if there
+    // is none. Returns -1 when the table is full.
+    static int ReserveSlot() {
+        for (;;) {
+            procLock.Acquire();
+            int slot = TakeFreeSlot();
+            procLock.Release();
+            if (slot >= 0 || !GrowSlots()) return slot;
+        }
+    }
+
+    // Return a slot to the free stack. Caller holds procLock.
+    static void ReleaseSlot(int slot) {
+        Process& proc = processTable[slot];
+        PidHashRemove(slot);
+        proc.sched->state = ProcessState::Free;
+
+        if (proc.listPrev >= 0) processTable[proc.listPrev].listNext = proc.listNext;
+        else usedHead = proc.listNext;
+        if (proc.listNext >= 0) processTable[proc.listNext].listPrev = proc.listPrev;
+
+        proc.listPrev = -1;
+        proc.listNext = freeHead;
+        freeHead = slot;
+    }
+
+    // Slot of the live process or thread with this ID, or -1
+    static int FindSlot(int pid) {
+        if (pid < 0) return -1;
+        int home = pid & (PidHashSize - 1);
+        int probe = __atomic_load_n(&pidHashProbe, __ATOMIC_ACQUIRE);
+        for (int i = 0; i < probe; i++) {
+            int slot = __atomic_load_n(&pidHash[(home + i) & (PidHashSize - 1)], __ATOMIC_ACQUIRE);
+            if (slot >= 0 && processTable[slot].pid == pid) {
+                return SlotAlive(slot) ? slot : -1;
+            }
+        }
+        return -1;
+    }
+
+    // Mark a thread Terminated and queue its slot for ReclaimTerminated.
+    // Caller holds procLock (and, for a thread still queued, its queue lock).
+    static void MarkTerminated(int slot) {
+        Process& proc = processTable[slot];
+        proc.sched->state = ProcessState::Terminated;
+        proc.deadNext = deadHead;
+        __atomic_store_n(&deadHead, slot, __ATOMIC_RELEASE);
+    }
+
+    // Returns true if this dropped the last reference to the address space
+    static bool DropGroupRef(Process& leader) {
+        return __atomic_sub_fetch(&leader.groupRefs, 1, __ATOMIC_ACQ_REL) == 0;
+    }
+
+    // Terminate a thread that is not on any CPU, or flag it to exit on its
+    // next tick if it is. Caller holds procLock. Returns true if the thread
+    // was terminated here (its group reference must then be dropped).
+    static bool KillSlot(int slot) {
+        Process& proc = processTable[slot];
+        int c = LockOwner(slot);
+
+        if (proc.sched->onCpu) {
+            // Running (or still switching out) on some CPU. Its kernel
+            // stack is in use there, so let that CPU's Tick() finish it;
+            // the block paths refuse to block with a kill pending.
+            proc.sched->killPending = true;
+            runQueues[c].lock.Release();
+            return false;
+        }
+
+        // Ready or Blocked and not on any CPU. Take it off its queue and
+        // mark it Terminated so the scheduler won't pick it up.
+        if (proc.sched->queued) RemoveFromQueue(c, slot);
+        MarkTerminated(slot);
+        proc.sched->killPending = false;
+        runQueues[c].lock.Release();
+
+        // It never runs again to leave a futex queue itself. A waker that
+        // saw it Blocked may be unlinking it right now; FutexUnlink copes.
+        uint64_t futexAddr = proc.futexAddr;
+        if (futexAddr != 0) {
+            FutexBucket& bucket = FutexBucketFor(futexAddr);
+            bucket.lock.Acquire();
+            FutexUnlink(bucket, slot);
+            bucket.lock.Release();
+        }
+
+        // Wake joiners; waitpid waiters are woken when the process is gone
+        if (slot != proc.leaderSlot) WakeWaiters(proc.pid);
+        return true;
+    }
+
+    // Kill every thread of a process except `except`. Caller holds procLock.
+    // Returns true if the last reference to the address space was dropped.
+    static bool KillGroup(int leaderSlot, int except) {
+        Process& leader = processTable[leaderSlot];
+        int tgid = leader.pid;
+        bool last = false;
+
+        leader.groupExiting = true;
+        for (int i = usedHead; i >= 0; i = processTable[i].listNext) {
+            Process& proc = processTable[i];
+            if (i == except || proc.tgid != tgid || proc.exiting || !IsLiveState(proc.sched->state)) continue;
+            if (KillSlot(i) && DropGroupRef(leader)) last = true;
+        }
+        return last;
+    }
+
+    // Release everything a process owns once its last thread is gone.
+    // Nothing runs in the address space any more.
+    static void TeardownProcess(int leaderSlot) {
+        Process& proc = processTable[leaderSlot];
+
+        // Clean up any windows owned by this process
+        WinServer::CleanupProcess(proc.pid);
+
+        // Close its pipe ends: readers of its stdout see the end of stream
+        Pipe::CleanupProcess(proc.pid);
+        proc.stdinPipe = -1;
+        proc.stdoutPipe = -1;
+
+        // Close its channels and stop listening on its names
+        Channel::CleanupProcess(proc.pid);
+
+        // Free I/O redirect buffers
+        if (proc.outBuf) {
+            Memory::g_pfa->Free(proc.outBuf, (int)(proc.outBufSize / 0x1000));
+            proc.outBuf = nullptr;
+            proc.outBufSize = 0;
+        }
+        if (proc.inBuf) {
+            Memory::g_pfa->Free(proc.inBuf);
+            proc.inBuf = nullptr;
+        }
+
+        // Free all user-space physical pages and page table structures,
+        // once the Zram clock cannot be walking them. A thread killed in
+        // the middle of a transfer leaves its buffer pinned, and the
+        // device may still write there: leak the memory instead.
+        Memory::Zram::WaitForScan();
+        if (proc.dmaPins == 0) {
+            Memory::VMM::Paging::FreeUserHalf(proc.pml4Phys);
+        } else {
+            Kt::KernelLogStream(Kt::WARNING, "Sched") << "Process " << base::dec << (uint64_t)proc.pid
+                << " exited during DMA; its memory is leaked";
+        }
+        proc.heapVmas.Clear();
+        Memory::VMM::Pcid::Free(proc.pcid);
+        proc.pcid = 0;
+        ElfRelease(proc.elfImage);
+        proc.elfImage = nullptr;
+        if (proc.env) {
+            Memory::g_heap->Free(proc.env);
+            proc.env = nullptr;
+            proc.envSize = 0;
+        }
+
+        procLock.Acquire();
+        if (proc.pmuParent >= 0) {
+            // Every thread has stopped counting by now (FinishThread, or
+            // switched out for good by KillSlot)
+            int parentSlot = FindSlot(proc.pmuParent);
+            if (parentSlot >= 0) {
+                Process& parent = processTable[processTable[parentSlot].leaderSlot];
+                for (int i = usedHead; i >= 0; i = processTable[i].listNext) {
+                    const Process& t = processTable[i];
+                    if (t.tgid != proc.pid || t.sched->state == ProcessState::Free) continue;
+                    for (int e = 0; e < Montauk::PERF_MAX_EVENTS; e++) {
+                        parent.pmuChildren[e] += t.pmuCounts[e] + t.pmuChildren[e];
+                    }
+                }
+            }
+        }
+        WakeWaiters(proc.pid);
+        procLock.Release();
+
+        // A parent polling the child's output sees it hang up
+        NotifyReady(&proc.outHead);
+    }
+
+    static void FreeUserPages(uint64_t pml4Phys, uint64_t va, uint64_t pages) {
+        Memory::VMM::Tlb::Batch batch(pml4Phys);
+        for (uint64_t i = 0; i < pages; i++) {
+            uint64_t pageVa = va + i * 0x1000;
+            uint64_t physAddr = Memory::VMM::Paging::GetPhysAddr(pml4Phys, pageVa);
+            Memory::VMM::Paging::UnmapUserIn(pml4Phys, pageVa, batch);
+            if (physAddr != 0) {
+                batch.FreeAfter((void*)Memory::HHDM(physAddr));
+            }
+        }
+    }
+
+    // Claim a free thread stack window of the process. Window w is the
+    // w-th below ThreadStackAreaTop; montauk/heap.h tells threads apart
+    // by it, so two live threads never share one. vmLock held. Returns -1
+    // if the process has a thread in every window.
+    static int TakeStackWindow(Process& leader) {
+        for (int w = 0; w < ThreadStackWindows / 64; w++) {
+            uint64_t free = ~leader.stackWindows[w];
+            if (free == 0) continue;
+            int bit = __builtin_ctzll(free);
+            leader.stackWindows[w] |= 1ULL << bit;
+            return w * 64 + bit;
+        }
+        return -1;
+    }
+
+    // vmLock held
+    static void ReleaseStackWindow(Process& leader, int window) {
+        if (window < 0) return;
+        leader.stackWindows[window / 64] &= ~(1ULL << (window % 64));
+    }
+
+    // Unmap an exiting thread's user stack while the rest of the process
+    // keeps running. A thread killed mid-syscall may never release vmLock,
+    // so give up once the whole process is going away: FreeUserHalf then
+    // takes the stack with everything else.
+    static void FreeThreadStack(Process& thread, Process& leader) {
+        while (!leader.vmLock.TryAcquire()) {
+            if (leader.groupExiting) return;
+            asm volatile("pause");
+        }
+        FreeUserPages(leader.pml4Phys, thread.userStackBase, ThreadStackPages);
+        ReleaseStackWindow(leader, thread.stackWindow);
+        thread.stackWindow = -1;
+        leader.vmLock.Release();
+    }
+
+    // Common exit path for the calling thread
+    [[noreturn]] static void FinishThread(int slot, int exitCode) {
+        Process& proc = processTable[slot];
+        Process& leader = processTable[proc.leaderSlot];
+
+        // From here on KillGroup leaves this thread alone
+        procLock.Acquire();
+        proc.exiting = true;
+        proc.sched->killPending = false;
+        procLock.Release();
+
+        // Final counts must be in memory before the process is torn down
+        if (proc.pmuEvents) {
+            uint64_t flags;
+            asm volatile("pushfq; pop %0; cli" : "=r"(flags) :: "memory");
+            SavePmu(proc);
+            proc.pmuEvents = 0;
+            asm volatile("push %0; popfq" :: "r"(flags) : "memory");
+        }
+
+        if (DropGroupRef(leader)) {
+            TeardownProcess(proc.leaderSlot);
+        } else if (slot != proc.leaderSlot && proc.userStackBase != 0) {
+            FreeThreadStack(proc, leader);
+        }
+
+        // Terminated while still onCpu: nobody will dispatch it again, and
+        // ReclaimTerminated waits for the switch-out below to finish.
+        procLock.Acquire();
+        proc.exitCode = exitCode;
+        MarkTerminated(slot);
+        if (slot != proc.leaderSlot) WakeWaiters(proc.pid);
+        procLock.Release();
+
+        // We may have been preempted (and migrated) above
+        auto* cpu = LockLocalQueue();
+        SwitchTo(cpu, PickNext(cpu->cpuIndex));
+
+        for (;;) {
+            asm volatile("hlt");
+        }
+    }
+
+    // Allocate a physically contiguous kernel stack (nullptr on failure)
+    static void* AllocKernelStack() {
+        void* firstPage = Memory::g_pfa->AllocateZeroed();
+        if (firstPage == nullptr) {
+            Kt::KernelLogStream(Kt::ERROR, "Sched") << "Out of memory for kernel stack";
+            return nullptr;
+        }
+        void* stackMem = Memory::g_pfa->ReallocConsecutive(firstPage, StackPages);
+        if (stackMem == nullptr) {
+            Kt::KernelLogStream(Kt::ERROR, "Sched") << "Failed to allocate contiguous kernel stack";
+            Memory::g_pfa->Free(firstPage);
+            return nullptr;
+        }
+        return stackMem;
+    }
+
     // Startup function for newly spawned processes.
     // SchedContextSwitch "returns" here on first schedule.
-    // The schedLock is held (acquired by the switching-from CPU's Schedule).
+    // The switching CPU's queue lock is held (acquired by its SwitchTo).
     static void ProcessStartup() {
-        // Release the schedLock that the switching-from CPU held
-        schedLock.Release();
+        // Release the queue lock that the switching CPU held
+        FinishSwitch();
 
         auto* cpu = Smp::GetCurrentCpuData();
         int slot = cpu->currentSlot;
@@ -66,8 +1169,14 @@ namespace Sched {
             // Set up per-CPU TSS RSP0 for hardware interrupts from ring 3
             cpu->tss->rsp0 = proc.kernelStackTop;
 
+            if (proc.kernelMode) {
+                asm volatile("sti");
+                ((void (*)(uint64_t))proc.entryPoint)(proc.threadArg);
+                ExitThread(0);
+            }
+
             // Jump to user mode (never returns)
-            JumpToUserMode(proc.entryPoint, proc.userStackTop);
+            JumpToUserMode(proc.entryPoint, proc.userStackTop, proc.threadArg);
         }
 
         ExitProcess();
@@ -77,104 +1186,61 @@ namespace Sched {
     }
 
     void Initialize() {
-        for (int i = 0; i < MaxProcesses; i++) {
-            processTable[i].pid = i;
-            processTable[i].state = ProcessState::Free;
-            processTable[i].name[0] = '\0';
-            processTable[i].savedRsp = 0;
-            processTable[i].stackBase = 0;
-            processTable[i].entryPoint = 0;
-            processTable[i].sliceRemaining = 0;
-            processTable[i].pml4Phys = 0;
-            processTable[i].kernelStackTop = 0;
-            processTable[i].userStackTop = 0;
-            processTable[i].heapNext = 0;
-            processTable[i].readdirCursor = 0;
-            processTable[i].args[0] = '\0';
-            processTable[i].user[0] = '\0';
-            processTable[i].cwd[0] = '\0';
-            processTable[i].runningOnCpu = -1;
-            processTable[i].killPending = false;
-            processTable[i].waitingForPid = -1;
-            processTable[i].sleepUntilTick = 0;
-            processTable[i].redirected = false;
-            processTable[i].parentPid = -1;
-            processTable[i].outBuf = nullptr;
-            processTable[i].outHead = 0;
-            processTable[i].outTail = 0;
-            processTable[i].inBuf = nullptr;
-            processTable[i].inHead = 0;
-            processTable[i].inTail = 0;
-            processTable[i].keyHead = 0;
-            processTable[i].keyTail = 0;
-            processTable[i].termCols = 0;
-            processTable[i].termRows = 0;
-        }
-
+        for (int i = 0; i < PidHashSize; i++) pidHash[i] = -1;
+        freeHead = -1;
+        usedHead = -1;
         nextPid = 0;
 
-        Kt::KernelLogStream(Kt::OK, "Sched") << "Initialized (" << MaxProcesses
-            << " process slots, " << (uint64_t)TimeSliceMs << " ms time slice)";
+        Kt::KernelLogStream(Kt::OK, "Sched") << "Initialized (up to " << MaxProcesses
+            << " process slots, " << (uint64_t)TimeSliceMs << " ms time slice, "
+            << (uint64_t)PriorityCount << " priority classes, per-CPU run queues)";
     }
 
-    int Spawn(const char* vfsPath, const char* args) {
-        schedLock.Acquire();
+    int Spawn(const char* vfsPath, const char* args, int priority, int stdinPipe, int stdoutPipe) {
+        SpawnOptions options;
+        options.priority = priority;
+        options.stdinPipe = stdinPipe;
+        options.stdoutPipe = stdoutPipe;
+        return Spawn(vfsPath, args, options);
+    }
 
-        int slot = -1;
-        for (int i = 0; i < MaxProcesses; i++) {
-            if (processTable[i].state == ProcessState::Free) {
-                slot = i;
-                break;
-            }
-        }
+    int Spawn(const char* vfsPath, const char* args, const SpawnOptions& options) {
+        int priority = options.priority;
+        int stdinPipe = options.stdinPipe;
+        int stdoutPipe = options.stdoutPipe;
+
+        // Reserve the slot so another Spawn doesn't claim it
+        int slot = ReserveSlot();
 
         if (slot < 0) {
-            schedLock.Release();
             Kt::KernelLogStream(Kt::ERROR, "Sched") << "No free process slots";
             return -1;
         }
 
-        // Reserve the slot so another Spawn doesn't claim it.
-        // Use Running (not Ready!) so the scheduler doesn't try to
-        // dispatch this half-initialized process.
-        processTable[slot].state = ProcessState::Running;
-        processTable[slot].runningOnCpu = -1;
-        schedLock.Release();
-
         // Create per-process PML4 with kernel-half copied
         uint64_t pml4Phys = Memory::VMM::Paging::CreateUserPML4();
 
         // Load ELF into the process's address space
-        uint64_t entry = ElfLoad(vfsPath, pml4Phys);
+        ElfImage* image = nullptr;
+        uint64_t entry = ElfLoad(vfsPath, pml4Phys, &image);
         if (entry == 0) {
             Memory::VMM::Paging::FreeUserHalf(pml4Phys);
             Memory::g_pfa->Free((void*)Memory::HHDM(pml4Phys));
-            schedLock.Acquire();
-            processTable[slot].state = ProcessState::Free;
-            schedLock.Release();
+            procLock.Acquire();
+            ReleaseSlot(slot);
+            procLock.Release();
             return -1;
         }
 
         // Allocate kernel stack (used during syscalls and interrupts)
-        void* firstPage = Memory::g_pfa->AllocateZeroed();
-        if (firstPage == nullptr) {
-            Kt::KernelLogStream(Kt::ERROR, "Sched") << "Out of memory for kernel stack";
-            Memory::VMM::Paging::FreeUserHalf(pml4Phys);
-            Memory::g_pfa->Free((void*)Memory::HHDM(pml4Phys));
-            schedLock.Acquire();
-            processTable[slot].state = ProcessState::Free;
-            schedLock.Release();
-            return -1;
-        }
-        void* stackMem = Memory::g_pfa->ReallocConsecutive(firstPage, StackPages);
+        void* stackMem = AllocKernelStack();
         if (stackMem == nullptr) {
-            Kt::KernelLogStream(Kt::ERROR, "Sched") << "Failed to allocate contiguous kernel stack";
-            Memory::g_pfa->Free(firstPage);
             Memory::VMM::Paging::FreeUserHalf(pml4Phys);
             Memory::g_pfa->Free((void*)Memory::HHDM(pml4Phys));
-            schedLock.Acquire();
-            processTable[slot].state = ProcessState::Free;
-            schedLock.Release();
+            ElfRelease(image);
+            procLock.Acquire();
+            ReleaseSlot(slot);
+            procLock.Release();
             return -1;
         }
 
@@ -185,10 +1251,11 @@ namespace Sched {
         auto cleanupOnFail = [&]() {
             Memory::VMM::Paging::FreeUserHalf(pml4Phys);
             Memory::g_pfa->Free((void*)Memory::HHDM(pml4Phys));
+            ElfRelease(image);
             Memory::g_pfa->Free(stackMem, StackPages);
-            schedLock.Acquire();
-            processTable[slot].state = ProcessState::Free;
-            schedLock.Release();
+            procLock.Acquire();
+            ReleaseSlot(slot);
+            procLock.Release();
         };
 
         // Allocate user stack pages and map them in the process PML4
@@ -232,6 +1299,24 @@ namespace Sched {
             stub[0] = 0x31; stub[1] = 0xFF;  // xor edi, edi  (exit code 0)
             stub[2] = 0x31; stub[3] = 0xC0;  // xor eax, eax  (SYS_EXIT = 0)
             stub[4] = 0x0F; stub[5] = 0x05;  // syscall
+
+            // Threads return here instead: the thread function's return
+            // value becomes its exit code.
+            // Write: mov edi, eax; mov eax, SYS_THREAD_EXIT; syscall
+            uint8_t* tstub = stub + (ThreadExitStubAddr - ExitStubAddr);
+            tstub[0] = 0x89; tstub[1] = 0xC7;  // mov edi, eax
+            tstub[2] = 0xB8;                   // mov eax, imm32
+            *(uint32_t*)&tstub[3] = (uint32_t)Montauk::SYS_THREAD_EXIT;
+            tstub[7] = 0x0F; tstub[8] = 0x05;  // syscall
+        }
+
+        // Share the clock page, read-only (Montauk::TimePage)
+        if (uint64_t timePhys = Timekeeping::TimePagePhys()) {
+            if (!Memory::VMM::Paging::MapUserInShared(pml4Phys, timePhys, Montauk::USER_TIME_PAGE, false)) {
+                Kt::KernelLogStream(Kt::ERROR, "Sched") << "Failed to map clock page";
+                cleanupOnFail();
+                return -1;
+            }
         }
 
         // Push exit stub address as the return address on the user stack.
@@ -252,30 +1337,94 @@ namespace Sched {
         *(--sp) = 0;  // r14
         *(--sp) = 0;  // r15
 
-        schedLock.Acquire();
+        // The environment: the one given, or the spawner's as it was given
+        // to the spawner
+        const char* env = options.env;
+        uint32_t envSize = options.envSize;
+        if (env == nullptr) {
+            int spawner = Smp::GetCurrentCpuData()->currentSlot;
+            if (spawner >= 0) {
+                const Process& parent = processTable[processTable[spawner].leaderSlot];
+                env = parent.env;
+                envSize = parent.envSize;
+            }
+        }
+        char* envCopy = nullptr;
+        if (env != nullptr && envSize > 0) {
+            envCopy = (char*)Memory::g_heap->Request(envSize);
+            if (envCopy == nullptr) {
+                cleanupOnFail();
+                return -1;
+            }
+            memcpy(envCopy, env, envSize);
+        } else {
+            envSize = 0;
+        }
+
+        procLock.Acquire();
 
         Process& proc = processTable[slot];
-        proc.pid = nextPid++;
-        proc.state = ProcessState::Ready;
-        readyCount++;
+        AssignPid(slot);
+        proc.tgid = proc.pid;
+        proc.leaderSlot = slot;
+        proc.groupExiting = false;
+        proc.exitCode = 0;
+        proc.joined = false;
+        proc.exiting = false;
+        proc.threadArg = 0;
+        proc.userStackBase = 0;
+        proc.kernelMode = false;
         {
             int i = 0;
             for (; i < 63 && vfsPath[i]; i++) proc.name[i] = vfsPath[i];
             proc.name[i] = '\0';
         }
-        proc.savedRsp = (uint64_t)sp;
+        proc.sched->savedRsp = (uint64_t)sp;
         proc.stackBase = (uint64_t)kernelStackBase;
         proc.entryPoint = entry;
-        proc.sliceRemaining = TimeSliceMs;
+        proc.sched->sliceEndUs = 0;
         proc.pml4Phys = pml4Phys;
         proc.kernelStackTop = kernelStackTop;
         proc.userStackTop = UserStackTop - 8;
         proc.heapNext = UserHeapBase;
+        proc.heapVmas.Clear();
+        proc.dmaPins = 0;
+
+        // The Zram clock takes a group with references to be set up
+        __atomic_store_n(&proc.groupRefs, 1, __ATOMIC_RELEASE);
+        proc.elfImage = image;
+        proc.allocatedPages = 0;
+        proc.reservedPages = 0;
+        memset(proc.stackWindows, 0, sizeof(proc.stackWindows));
+        proc.pcid = Memory::VMM::Pcid::Allocate();
         proc.readdirCursor = 0;
-        proc.runningOnCpu = -1;
-        proc.killPending = false;
+        proc.sched->runningOnCpu = -1;
+        proc.sched->killPending = false;
+        proc.sched->rqNext = -1;
+        proc.sched->queued = false;
+        proc.sched->onCpu = false;
         proc.waitingForPid = -1;
-        proc.sleepUntilTick = 0;
+        proc.sched->sleepUntilUs = 0;
+        proc.futexAddr = 0;
+        proc.futexNext = -1;
+
+        // Affinity is not inherited, for the same reason as the elevated
+        // priority classes
+        proc.sched->affinity = options.affinity;
+        proc.userTsc = 0;
+        proc.kernelTsc = 0;
+        proc.inSyscall = false;
+        proc.reapedUserTsc = 0;
+        proc.reapedKernelTsc = 0;
+        proc.voluntarySwitches = 0;
+        proc.involuntarySwitches = 0;
+        proc.reapedVoluntary = 0;
+        proc.reapedInvoluntary = 0;
+        proc.pmuEvents = 0;
+        proc.pmuFlags = 0;
+        proc.pmuParent = -1;
+        memset(proc.pmuCounts, 0, sizeof(proc.pmuCounts));
+        memset(proc.pmuChildren, 0, sizeof(proc.pmuChildren));
 
         // Copy arguments string into process
         proc.args[0] = '\0';
@@ -291,6 +1440,21 @@ namespace Sched {
         {
             auto* cpu = Smp::GetCurrentCpuData();
             int parentSlot = cpu->currentSlot;
+            if (parentSlot >= 0) parentSlot = processTable[parentSlot].leaderSlot;
+
+            // Batch is inherited, so a batch shell's jobs stay batch. The
+            // elevated classes are not: whatever the desktop launches is
+            // an ordinary process unless asked for otherwise.
+            if (priority >= 0 && priority < PriorityCount) {
+                proc.sched->priority = (uint8_t)priority;
+            } else if (parentSlot >= 0 &&
+                       schedTable[parentSlot].priority > Montauk::PRIO_NORMAL) {
+                proc.sched->priority = schedTable[parentSlot].priority;
+            } else {
+                proc.sched->priority = Montauk::PRIO_NORMAL;
+            }
+            proc.sched->boost = 0;
+
             if (parentSlot >= 0) {
                 int i = 0;
                 for (; i < 31 && processTable[parentSlot].user[i]; i++)
@@ -304,9 +1468,17 @@ namespace Sched {
             }
         }
 
-        {
+        proc.env = envCopy;
+        proc.envSize = envSize;
+
+        if (options.cwd != nullptr) {
+            int i = 0;
+            for (; i < 255 && options.cwd[i]; i++) proc.cwd[i] = options.cwd[i];
+            proc.cwd[i] = '\0';
+        } else {
             auto* cpu = Smp::GetCurrentCpuData();
             int parentSlot = cpu->currentSlot;
+            if (parentSlot >= 0) parentSlot = processTable[parentSlot].leaderSlot;
             if (parentSlot >= 0 && processTable[parentSlot].cwd[0]) {
                 int i = 0;
                 for (; i < 255 && processTable[parentSlot].cwd[i]; i++) {
@@ -321,9 +1493,21 @@ namespace Sched {
             }
         }
 
+        // A counting thread with PERF_INHERIT passes its counters on; the
+        // child's totals land in the spawner's pmuChildren when it exits
+        {
+            int spawner = Smp::GetCurrentCpuData()->currentSlot;
+            if (spawner >= 0 && (processTable[spawner].pmuFlags & Montauk::PERF_INHERIT)) {
+                proc.pmuEvents = processTable[spawner].pmuEvents;
+                proc.pmuFlags = processTable[spawner].pmuFlags;
+                proc.pmuParent = processTable[spawner].tgid;
+            }
+        }
+
         proc.redirected = false;
         proc.parentPid = -1;
         proc.outBuf = nullptr;
+        proc.outBufSize = 0;
         proc.outHead = 0;
         proc.outTail = 0;
         proc.inBuf = nullptr;
@@ -334,13 +1518,34 @@ namespace Sched {
         proc.termCols = 0;
         proc.termRows = 0;
 
-        // Initialize FPU state: zero out, then set default FCW and MXCSR
-        memset(proc.fpuState, 0, 512);
-        *(uint16_t*)&proc.fpuState[0] = 0x037F;   // FCW: default x87 control word
-        *(uint32_t*)&proc.fpuState[24] = 0x1F80;   // MXCSR: default SSE control/status
+        // Standard input and output pipes, the child holding each end
+        // itself so that it stays open until the child exits
+        {
+            int spawner = Smp::GetCurrentCpuData()->currentSlot;
+            int holder = spawner >= 0 ? processTable[spawner].tgid : -1;
+            if (spawner >= 0) {
+                const Process& parent = processTable[processTable[spawner].leaderSlot];
+                if (stdinPipe == Montauk::PIPE_INHERIT) stdinPipe = parent.stdinPipe;
+                if (stdoutPipe == Montauk::PIPE_INHERIT) stdoutPipe = parent.stdoutPipe;
+            }
+            proc.stdinPipe = (stdinPipe > 0 && Pipe::Share(stdinPipe, holder, proc.pid) == 0) ? stdinPipe : -1;
+            proc.stdoutPipe = (stdoutPipe > 0 && Pipe::Share(stdoutPipe, holder, proc.pid) == 0) ? stdoutPipe : -1;
+        }
+
+        // Initial FPU state: default FCW and MXCSR, loaded on first use
+        Hal::Fpu::InitArea(proc.fpuState);
+        proc.fpuCpu = -1;
 
         int resultPid = proc.pid;
-        schedLock.Release();
+
+        // Publish: hand the process to the least loaded CPU's queue
+        int target = PickCpu(proc.sched->affinity);
+        runQueues[target].lock.Acquire();
+        proc.sched->state = ProcessState::Ready;
+        Enqueue(target, slot);
+        runQueues[target].lock.Release();
+
+        procLock.Release();
 
         return resultPid;
     }
@@ -348,162 +1553,193 @@ namespace Sched {
     // ====================================================================
     // Schedule -- core context switch logic
     //
-    // The schedLock is held ACROSS the context switch. This is critical:
-    // setting the old process to Ready and saving its RSP must be atomic
-    // with respect to other CPUs. If we released the lock before saving
-    // RSP, another CPU could pick up the process with a stale savedRsp.
+    // Each CPU only ever takes its own queue lock on the switch path, so
+    // CPUs no longer serialize on one lock just to context switch. The
+    // lock is held ACROSS the context switch: putting the old process on
+    // the queue and saving its RSP must be atomic with respect to other
+    // CPUs stealing from that queue.
     //
-    // The RESUMED process releases the lock (it was acquired by whatever
-    // CPU called Schedule() and switched away from that process).
-    // New processes release it in ProcessStartup().
+    // The RESUMED context releases the lock (FinishSwitch). New processes
+    // release it in ProcessStartup().
     // ====================================================================
 
     // Reclaim terminated process slots. Called from BSP's Tick only,
     // NOT from every Schedule() call on every CPU. This avoids holding
-    // schedLock (with interrupts disabled) during PFA::Free on the
-    // hot scheduling path.
+    // locks (with interrupts disabled) during PFA::Free on the hot
+    // scheduling path. A terminated process whose context is still live
+    // (onCpu) is still running on its own kernel stack; leave it for a
+    // later tick.
+    //
+    // A leader's slot holds the process-wide state until the last thread
+    // is gone; another thread's slot holds its exit code until it has been
+    // joined or the whole process has exited.
+    static bool Reclaimable(int slot) {
+        const Process& proc = processTable[slot];
+        if (proc.sched->state != ProcessState::Terminated || proc.sched->onCpu) return false;
+        if (proc.leaderSlot == slot) return proc.groupRefs == 0;
+        if (proc.leaderSlot < 0 || proc.joined) return true;
+        const Process& leader = processTable[proc.leaderSlot];
+        return leader.pid != proc.tgid || leader.groupRefs == 0;
+    }
+
+    // Walks only the slots MarkTerminated queued; those that can't be
+    // reclaimed yet go back on the list for a later tick.
     static void ReclaimTerminated() {
-        schedLock.Acquire();
-        for (int i = 0; i < MaxProcesses; i++) {
-            if (processTable[i].state == ProcessState::Terminated) {
-                // Grab the pointers, mark Free, then free memory after releasing lock
-                void* stackBase = (processTable[i].stackBase != 0)
-                    ? (void*)processTable[i].stackBase : nullptr;
-                void* pml4 = (processTable[i].pml4Phys != 0)
-                    ? (void*)Memory::HHDM(processTable[i].pml4Phys) : nullptr;
-                processTable[i].stackBase = 0;
-                processTable[i].pml4Phys = 0;
-                processTable[i].state = ProcessState::Free;
+        if (__atomic_load_n(&deadHead, __ATOMIC_ACQUIRE) < 0) return;
+
+        procLock.Acquire();
+        int next = deadHead;
+        deadHead = -1;
+        while (next >= 0) {
+            int i = next;
+            next = processTable[i].deadNext;
+            processTable[i].deadNext = -1;
+            if (!Reclaimable(i)) {
+                processTable[i].deadNext = deadHead;
+                deadHead = i;
+                continue;
+            }
 
-                // Release lock during PFA::Free to minimize hold time
-                schedLock.Release();
-                if (stackBase) Memory::g_pfa->Free(stackBase, StackPages);
-                if (pml4) Memory::g_pfa->Free(pml4);
-                schedLock.Acquire();
+            // Grab the pointers, mark Free, then free memory after releasing lock.
+            // Only the leader owns the PML4; threads borrow it.
+            void* stackBase = (processTable[i].stackBase != 0)
+                ? (void*)processTable[i].stackBase : nullptr;
+            void* pml4 = (processTable[i].pml4Phys != 0 && processTable[i].leaderSlot == i)
+                ? (void*)Memory::HHDM(processTable[i].pml4Phys) : nullptr;
+            processTable[i].stackBase = 0;
+            processTable[i].pml4Phys = 0;
+            ReleaseSlot(i);
+
+            // Keep an exited thread's CPU time with its process
+            int leaderSlot = processTable[i].leaderSlot;
+            if (leaderSlot >= 0 && leaderSlot != i &&
+                processTable[leaderSlot].pid == processTable[i].tgid &&
+                schedTable[leaderSlot].state != ProcessState::Free) {
+                processTable[leaderSlot].reapedUserTsc += processTable[i].userTsc;
+                processTable[leaderSlot].reapedKernelTsc += processTable[i].kernelTsc;
+                processTable[leaderSlot].reapedVoluntary += processTable[i].voluntarySwitches;
+                processTable[leaderSlot].reapedInvoluntary += processTable[i].involuntarySwitches;
+                for (int e = 0; e < Montauk::PERF_MAX_EVENTS; e++) {
+                    processTable[leaderSlot].pmuCounts[e] += processTable[i].pmuCounts[e];
+                }
             }
+
+            // Release lock during PFA::Free to minimize hold time. The
+            // detached list is ours alone meanwhile.
+            procLock.Release();
+            if (stackBase) Memory::g_pfa->Free(stackBase, StackPages);
+            if (pml4) Memory::g_pfa->Free(pml4);
+            procLock.Acquire();
         }
-        schedLock.Release();
+        procLock.Release();
     }
 
-    void Schedule() {
-        auto* cpu = Smp::GetCurrentCpuData();
-
-        schedLock.Acquire();
-
-        // Find the next Ready process (round-robin from after current slot)
-        int next = -1;
-        int start = (cpu->currentSlot >= 0) ? cpu->currentSlot + 1 : 0;
-
-        for (int i = 0; i < MaxProcesses; i++) {
-            int idx = (start + i) % MaxProcesses;
-            if (processTable[idx].state == ProcessState::Ready) {
-                next = idx;
-                break;
+    // Move this CPU's sleepers whose deadline has passed back to Ready and
+    // work out the next deadline. Each CPU wakes the sleepers that blocked
+    // on it, from its own timer interrupt, so a deadline is met to timer
+    // precision rather than at the next BSP tick.
+    static void WakeSleepers(int self, uint64_t now) {
+        RunQueue& rq = runQueues[self];
+        if (now < rq.nextWakeUs) return;
+
+        // Sleepers whose affinity changed while they slept go through
+        // WakeBlocked, which moves them, after the lock is dropped.
+        static constexpr int MaxMoved = 8;
+        int moved[MaxMoved];
+        int movedCount = 0;
+
+        rq.lock.Acquire();
+        uint64_t next = NoDeadline;
+        while (rq.timerCount > 0 && rq.timers[0].deadlineUs <= now) {
+            RunQueue::Timer t = rq.timers[0];
+            if (!SleeperDue(self, t)) {
+                TimerPop(rq);
+                continue;
             }
-        }
-
-        if (next < 0) {
-            // No ready processes. If we were running one, return to idle.
-            if (cpu->currentSlot >= 0) {
-                int oldSlot = cpu->currentSlot;
-                processTable[oldSlot].state = ProcessState::Ready;
-                readyCount++;
-                processTable[oldSlot].runningOnCpu = -1;
-                cpu->currentSlot = -1;
-
-                // Lock held across context switch -- the idle loop
-                // doesn't release it; the next Schedule() that resumes
-                // a process from idle will release it via the resumed
-                // process path.  But idle is special: we release here
-                // because idle doesn't go through ProcessStartup.
-                // The RSP save is safe because interrupts are disabled
-                // (Spinlock), so no timer can fire between Ready and save.
-                SchedContextSwitch(&processTable[oldSlot].savedRsp, cpu->idleSavedRsp,
-                                  GetKernelCR3(), processTable[oldSlot].fpuState, nullptr);
-                // Resumed from idle -- lock was held by whoever switched to us
-                schedLock.Release();
-            } else {
-                schedLock.Release();
+            SchedEntity& se = schedTable[t.slot];
+            if (!Allowed(se, self)) {
+                if (movedCount == MaxMoved) {
+                    next = now; // Pick up the rest on the next tick
+                    break;
+                }
+                moved[movedCount++] = t.slot;
+                TimerPop(rq);
+                continue;
             }
-            return;
+            TimerPop(rq);
+            se.sleepUntilUs = 0;
+            se.state = ProcessState::Ready;
+            Enqueue(self, t.slot);
         }
+        if (next == NoDeadline && rq.timerCount > 0) next = rq.timers[0].deadlineUs;
+        rq.nextWakeUs = next;
+        rq.lock.Release();
 
-        if (next == cpu->currentSlot) {
-            // Same process, just reset time slice
-            processTable[next].sliceRemaining = TimeSliceMs;
-            schedLock.Release();
-            return;
-        }
+        for (int i = 0; i < movedCount; i++) WakeBlocked(moved[i]);
+    }
+
+    void Schedule() {
+        auto* cpu = LockLocalQueue();
 
-        // Prepare the context switch
-        uint64_t* oldRspPtr;
         int oldSlot = cpu->currentSlot;
 
-        if (oldSlot >= 0) {
-            processTable[oldSlot].state = ProcessState::Ready;
-            readyCount++;
-            processTable[oldSlot].runningOnCpu = -1;
-            oldRspPtr = &processTable[oldSlot].savedRsp;
-        } else {
-            oldRspPtr = &cpu->idleSavedRsp;
+        // Preempted or yielding: the current process goes to the back of
+        // its class on the local queue before picking, so it keeps the CPU
+        // over anything of a lower class (SwitchTo handles picking it
+        // straight back). A process that is already Blocked (or was
+        // re-queued by a waker) is left alone.
+        //
+        // If its affinity no longer allows this CPU, it switches out as if
+        // blocking and FinishSwitch wakes it on an allowed CPU.
+        if (oldSlot >= 0 && schedTable[oldSlot].state == ProcessState::Running) {
+            if (Allowed(schedTable[oldSlot], cpu->cpuIndex)) {
+                schedTable[oldSlot].state = ProcessState::Ready;
+                Enqueue(cpu->cpuIndex, oldSlot);
+            } else {
+                schedTable[oldSlot].state = ProcessState::Blocked;
+                runQueues[cpu->cpuIndex].migrateSlot = oldSlot;
+            }
         }
 
-        cpu->currentSlot = next;
-        processTable[next].state = ProcessState::Running;
-        readyCount--;
-        processTable[next].runningOnCpu = cpu->cpuIndex;
-        processTable[next].sliceRemaining = TimeSliceMs;
-
-        uint64_t newCR3 = processTable[next].pml4Phys;
-
-        // Update per-CPU kernel RSP and TSS RSP0
-        cpu->kernelRsp = processTable[next].kernelStackTop;
-        cpu->tss->rsp0 = processTable[next].kernelStackTop;
+        int next = PickNext(cpu->cpuIndex);
 
-        uint8_t* oldFpu = (oldSlot >= 0) ? processTable[oldSlot].fpuState : nullptr;
-        uint8_t* newFpu = processTable[next].fpuState;
-
-        // DO NOT release schedLock here! It is held across the context
-        // switch so that setting Ready + saving RSP is atomic. The
-        // resumed process releases it.
-        SchedContextSwitch(oldRspPtr, processTable[next].savedRsp, newCR3, oldFpu, newFpu);
+        if (next < 0) {
+            // Nothing ready: return to idle; the next tick (or a
+            // reschedule IPI) picks up new work.
+            if (oldSlot < 0) {
+                runQueues[cpu->cpuIndex].lock.Release();
+                return;
+            }
+            SwitchTo(cpu, -1);
+            return;
+        }
 
-        // We reach here when this process is resumed by another CPU's
-        // Schedule(). That CPU held the lock across its context switch.
-        // Release it now.
-        schedLock.Release();
+        // DO NOT release the queue lock here! It is held across the
+        // context switch; the resumed context releases it.
+        SwitchTo(cpu, next);
     }
 
     void Tick() {
         auto* cpu = Smp::GetCurrentCpuData();
+        uint64_t now = Timekeeping::GetMicroseconds();
 
-        // BSP: wake sleeping processes and reclaim terminated slots
-        if (cpu->cpuIndex == 0) {
-            schedLock.Acquire();
-            uint64_t now = Timekeeping::GetTicks();
-            for (int i = 0; i < MaxProcesses; i++) {
-                if (processTable[i].state == ProcessState::Blocked &&
-                    processTable[i].sleepUntilTick != 0 &&
-                    now >= processTable[i].sleepUntilTick) {
-                    processTable[i].sleepUntilTick = 0;
-                    processTable[i].state = ProcessState::Ready;
-                    readyCount++;
-                }
-            }
-            schedLock.Release();
+        // Wake this CPU's sleepers and keep the timer armed for the rest
+        WakeSleepers(cpu->cpuIndex, now);
+        if (runQueues[cpu->cpuIndex].nextWakeUs != NoDeadline) {
+            Timekeeping::ArmTimer(runQueues[cpu->cpuIndex].nextWakeUs);
+        }
 
-            // Reclaim terminated process memory (BSP only, once per tick)
+        // BSP: reclaim terminated process memory (once per tick)
+        if (cpu->cpuIndex == 0) {
             ReclaimTerminated();
         }
 
         int slot = cpu->currentSlot;
 
         if (slot < 0) {
-            // Idle CPU. Check the approximate ready count to avoid
-            // scanning 256 process slots on every tick. On a 32-core
-            // system with 27 idle CPUs, this avoids ~7M cache-line
-            // reads/sec from the process table.
-            if (readyCount > 0) {
+            // Idle CPU. Only take the scheduling path when there is
+            // something runnable locally or stealable from a busier CPU.
+            if (AnyReady(cpu->cpuIndex)) {
                 Schedule();
             }
             return;
@@ -511,28 +1747,45 @@ namespace Sched {
 
         // Check if another CPU requested this process be killed.
         // We are on the CPU running it, so ExitProcess is safe here.
-        if (processTable[slot].killPending) {
-            processTable[slot].killPending = false;
+        if (schedTable[slot].killPending) {
+            schedTable[slot].killPending = false;
             ExitProcess();
             return;
         }
 
-        if (processTable[slot].sliceRemaining > 0) {
-            processTable[slot].sliceRemaining--;
-        }
-
-        if (processTable[slot].sliceRemaining == 0) {
+        if (now >= schedTable[slot].sliceEndUs) {
+            // A used-up slice spends an input boost; a preemption by a
+            // higher class (sliceEndUs == 0) does not.
+            SchedEntity& se = schedTable[slot];
+            if (se.sliceEndUs != 0 && se.boost > 0) se.boost--;
             Schedule();
+            return;
         }
+
+        // Woken early (BSP housekeeping tick, IPI): keep the slice timer
+        Timekeeping::ArmTimer(schedTable[slot].sliceEndUs);
     }
 
     int GetCurrentPid() {
+        auto* cpu = Smp::GetCurrentCpuData();
+        int slot = cpu->currentSlot;
+        return (slot >= 0) ? processTable[slot].tgid : -1;
+    }
+
+    int GetCurrentTid() {
         auto* cpu = Smp::GetCurrentCpuData();
         int slot = cpu->currentSlot;
         return (slot >= 0) ? processTable[slot].pid : -1;
     }
 
     Process* GetCurrentProcessPtr() {
+        auto* cpu = Smp::GetCurrentCpuData();
+        int slot = cpu->currentSlot;
+        if (slot < 0) return nullptr;
+        return &processTable[processTable[slot].leaderSlot];
+    }
+
+    Process* GetCurrentThreadPtr() {
         auto* cpu = Smp::GetCurrentCpuData();
         int slot = cpu->currentSlot;
         if (slot < 0) return nullptr;
@@ -547,151 +1800,489 @@ namespace Sched {
             return;
         }
 
-        Process& proc = processTable[slot];
-        proc.killPending = false;
-        int exitingPid = proc.pid;
+        // Take the other threads down first. We still hold our own group
+        // reference, so this never frees the address space under us.
+        procLock.Acquire();
+        KillGroup(processTable[slot].leaderSlot, slot);
+        procLock.Release();
 
-        // Clean up any windows owned by this process
-        WinServer::CleanupProcess(exitingPid);
+        FinishThread(slot, 0);
+    }
 
-        // Free I/O redirect buffers
-        if (proc.outBuf) {
-            Memory::g_pfa->Free(proc.outBuf);
-            proc.outBuf = nullptr;
+    void ExitThread(int exitCode) {
+        auto* cpu = Smp::GetCurrentCpuData();
+        int slot = cpu->currentSlot;
+
+        if (slot < 0) {
+            return;
         }
-        if (proc.inBuf) {
-            Memory::g_pfa->Free(proc.inBuf);
-            proc.inBuf = nullptr;
+
+        FinishThread(slot, exitCode);
+    }
+
+    int KillProcess(int pid) {
+        // Refuse to kill PID 0 (init)
+        if (pid == 0) return -1;
+
+        procLock.Acquire();
+
+        // Find the process (or any of its threads) by ID
+        int slot = FindSlot(pid);
+
+        // Refuse init and the caller's own process
+        if (slot < 0 || processTable[slot].tgid == 0 ||
+            processTable[slot].tgid == GetCurrentPid()) {
+            procLock.Release();
+            return -1;
         }
 
-        // Free all user-space physical pages and page table structures
-        Memory::VMM::Paging::FreeUserHalf(proc.pml4Phys);
+        int leaderSlot = processTable[slot].leaderSlot;
+        bool last = KillGroup(leaderSlot, -1);
 
-        schedLock.Acquire();
+        procLock.Release();
+
+        // Safe to clean up resources now -- no thread of the process is
+        // running anywhere. Otherwise the last thread to exit does it.
+        // Kernel stacks and the PML4 are freed by ReclaimTerminated on BSP tick.
+        if (last) TeardownProcess(leaderSlot);
+        return 0;
+    }
 
-        proc.state = ProcessState::Terminated;
-        proc.runningOnCpu = -1;
+    int SetPriority(int pid, int priority) {
+        if (priority < 0 || priority >= PriorityCount) return -1;
 
-        // Wake any processes blocked on this PID
-        for (int i = 0; i < MaxProcesses; i++) {
-            if (processTable[i].state == ProcessState::Blocked &&
-                processTable[i].waitingForPid == exitingPid) {
-                processTable[i].state = ProcessState::Ready;
-                readyCount++;
-                processTable[i].waitingForPid = -1;
+        procLock.Acquire();
+        int slot = FindSlot(pid);
+        if (slot < 0) {
+            procLock.Release();
+            return -1;
+        }
+
+        // Queued threads keep their place until they are next picked and
+        // re-queued; the running one switches class at its next slice.
+        int tgid = processTable[slot].tgid;
+        for (int i = usedHead; i >= 0; i = processTable[i].listNext) {
+            if (processTable[i].tgid == tgid && schedTable[i].state != ProcessState::Free) {
+                schedTable[i].priority = (uint8_t)priority;
             }
         }
+        procLock.Release();
+        return 0;
+    }
 
-        // Find next ready process
-        int next = -1;
-        for (int i = 0; i < MaxProcesses; i++) {
-            if (processTable[i].state == ProcessState::Ready) {
-                next = i;
-                break;
+    int GetPriority(int pid) {
+        procLock.Acquire();
+        int slot = FindSlot(pid);
+        int priority = (slot >= 0) ? schedTable[slot].priority : -1;
+        procLock.Release();
+        return priority;
+    }
+
+    uint64_t OnlineCpuMask() {
+        uint64_t online = 0;
+        int cpuCount = Smp::GetCpuCount();
+        for (int i = 0; i < cpuCount; i++) {
+            auto* c = Smp::GetCpuData(i);
+            if (c != nullptr && c->started) online |= 1ULL << i;
+        }
+        return online;
+    }
+
+    int SetAffinity(int pid, uint64_t mask) {
+        if ((mask & OnlineCpuMask()) == 0) return -1;
+
+        procLock.Acquire();
+        int slot = FindSlot(pid);
+        if (slot < 0) {
+            procLock.Release();
+            return -1;
+        }
+
+        int tgid = processTable[slot].tgid;
+        for (int i = usedHead; i >= 0; i = processTable[i].listNext) {
+            SchedEntity& se = schedTable[i];
+            if (processTable[i].tgid != tgid || !IsLiveState(se.state)) continue;
+            se.affinity = mask;
+
+            int c = LockOwner(i);
+            if (Allowed(se, c)) {
+                runQueues[c].lock.Release();
+            } else if (se.state == ProcessState::Running) {
+                // Schedule() on that CPU moves it
+                auto* cpu = Smp::GetCpuData(c);
+                if (cpu->currentSlot == i) Preempt(cpu, se);
+                runQueues[c].lock.Release();
+            } else if (se.queued) {
+                // Pull it off the queue and wake it where it may run
+                RemoveFromQueue(c, i);
+                se.state = ProcessState::Blocked;
+                runQueues[c].lock.Release();
+                WakeBlocked(i);
+            } else {
+                // Blocked: moved when it wakes up
+                runQueues[c].lock.Release();
             }
         }
+        procLock.Release();
+        return 0;
+    }
 
-        if (next >= 0) {
-            cpu->currentSlot = next;
-            processTable[next].state = ProcessState::Running;
-            readyCount--;
-            processTable[next].runningOnCpu = cpu->cpuIndex;
-            processTable[next].sliceRemaining = TimeSliceMs;
-
-            uint64_t newCR3 = processTable[next].pml4Phys;
-            cpu->kernelRsp = processTable[next].kernelStackTop;
-            cpu->tss->rsp0 = processTable[next].kernelStackTop;
-
-            // Lock held across context switch -- resumed process releases it
-            SchedContextSwitch(&processTable[slot].savedRsp, processTable[next].savedRsp, newCR3,
-                              processTable[slot].fpuState, processTable[next].fpuState);
-            schedLock.Release();
-        } else {
-            cpu->currentSlot = -1;
+    uint64_t GetAffinity(int pid) {
+        procLock.Acquire();
+        int slot = FindSlot(pid);
+        uint64_t mask = (slot >= 0) ? schedTable[slot].affinity : 0;
+        procLock.Release();
+        return mask;
+    }
+
+    bool GetCpuTime(int pid, uint64_t& userUs, uint64_t& kernelUs) {
+        GroupStats stats;
+        if (!GetGroupStats(pid, stats)) return false;
+        userUs = stats.userUs;
+        kernelUs = stats.kernelUs;
+        return true;
+    }
 
-            // Switch to idle -- release after resuming from idle
-            SchedContextSwitch(&processTable[slot].savedRsp, cpu->idleSavedRsp, GetKernelCR3(),
-                              processTable[slot].fpuState, nullptr);
-            schedLock.Release();
+    bool GetGroupStats(int pid, GroupStats& out) {
+        procLock.Acquire();
+        int slot = FindSlot(pid);
+        if (slot < 0) {
+            procLock.Release();
+            return false;
         }
 
-        for (;;) {
-            asm volatile("hlt");
+        const Process& leader = processTable[processTable[slot].leaderSlot];
+        uint64_t user = leader.reapedUserTsc;
+        uint64_t kernel = leader.reapedKernelTsc;
+        out.voluntarySwitches = leader.reapedVoluntary;
+        out.involuntarySwitches = leader.reapedInvoluntary;
+        out.threads = 0;
+        out.cpu = -1;
+        for (int i = usedHead; i >= 0; i = processTable[i].listNext) {
+            const Process& proc = processTable[i];
+            if (proc.tgid != leader.pid || proc.sched->state == ProcessState::Free) continue;
+            user += proc.userTsc;
+            kernel += proc.kernelTsc;
+            out.voluntarySwitches += proc.voluntarySwitches;
+            out.involuntarySwitches += proc.involuntarySwitches;
+            if (IsLiveState(proc.sched->state)) out.threads++;
+            if (out.cpu < 0 && proc.sched->runningOnCpu >= 0) out.cpu = proc.sched->runningOnCpu;
         }
+        procLock.Release();
+
+        out.userUs = Timekeeping::TscToMicroseconds(user);
+        out.kernelUs = Timekeeping::TscToMicroseconds(kernel);
+        return true;
     }
 
-    int KillProcess(int pid) {
-        // Refuse to kill PID 0 (init) or caller's own process
-        if (pid == 0) return -1;
-        if (pid == GetCurrentPid()) return -1;
+    void EnterSyscall() {
+        uint64_t flags;
+        asm volatile("pushfq; pop %0; cli" : "=r"(flags) :: "memory");
+        int slot = Smp::GetCurrentCpuData()->currentSlot;
+        if (slot >= 0) {
+            ChargeCpuTime(processTable[slot]);
+            processTable[slot].inSyscall = true;
+        }
+        asm volatile("push %0; popfq" :: "r"(flags) : "memory");
+    }
+
+    void LeaveSyscall() {
+        uint64_t flags;
+        asm volatile("pushfq; pop %0; cli" : "=r"(flags) :: "memory");
+        int slot = Smp::GetCurrentCpuData()->currentSlot;
+        if (slot >= 0) {
+            ChargeCpuTime(processTable[slot]);
+            processTable[slot].inSyscall = false;
+        }
+        asm volatile("push %0; popfq" :: "r"(flags) : "memory");
+    }
 
-        schedLock.Acquire();
+    int PerfStart(uint32_t events, uint32_t flags) {
+        uint32_t counted = Hal::Pmu::Supported(events);
+        if (events != 0 && counted == 0) return -1;
 
-        // Find the process by PID
-        int slot = -1;
-        for (int i = 0; i < MaxProcesses; i++) {
-            if (processTable[i].pid == pid) {
-                auto s = processTable[i].state;
-                if (s == ProcessState::Ready || s == ProcessState::Running ||
-                    s == ProcessState::Blocked) {
-                    slot = i;
-                }
-                break;
+        uint64_t rflags;
+        asm volatile("pushfq; pop %0; cli" : "=r"(rflags) :: "memory");
+        int slot = Smp::GetCurrentCpuData()->currentSlot;
+        if (slot < 0) {
+            asm volatile("push %0; popfq" :: "r"(rflags) : "memory");
+            return -1;
+        }
+
+        // Stopping keeps the final counts readable
+        Process& proc = processTable[slot];
+        if (proc.pmuEvents) SavePmu(proc);
+        proc.pmuEvents = counted;
+        proc.pmuFlags = flags;
+        if (counted != 0) {
+            memset(proc.pmuCounts, 0, sizeof(proc.pmuCounts));
+            memset(processTable[proc.leaderSlot].pmuChildren, 0, sizeof(proc.pmuChildren));
+            Hal::Pmu::Start(counted, flags & Montauk::PERF_USER_ONLY);
+        }
+        asm volatile("push %0; popfq" :: "r"(rflags) : "memory");
+        return (int)counted;
+    }
+
+    void PerfRead(Montauk::PerfCounts& out) {
+        memset(&out, 0, sizeof(out));
+
+        uint64_t flags;
+        asm volatile("pushfq; pop %0; cli" : "=r"(flags) :: "memory");
+        int slot = Smp::GetCurrentCpuData()->currentSlot;
+        if (slot >= 0) {
+            const Process& proc = processTable[slot];
+            out.events = proc.pmuEvents;
+            for (int e = 0; e < Montauk::PERF_MAX_EVENTS; e++) {
+                out.self[e] = proc.pmuCounts[e];
+                out.children[e] = processTable[proc.leaderSlot].pmuChildren[e];
+            }
+            if (proc.pmuEvents) Hal::Pmu::Read(proc.pmuEvents, out.self);
+        }
+        asm volatile("push %0; popfq" :: "r"(flags) : "memory");
+    }
+
+    // Called from input delivery paths that may hold other locks, so this
+    // takes none: a stray boost on a recycled slot is harmless.
+    void BoostInput(int pid) {
+        if (pid < 0) return;
+        int slots = __atomic_load_n(&slotCount, __ATOMIC_ACQUIRE);
+        for (int i = 0; i < slots; i++) {
+            Process& proc = processTable[i];
+            if (proc.tgid == pid && IsLiveState(proc.sched->state)) {
+                proc.sched->boost = BoostSlices;
             }
         }
+    }
+
+    // Start a thread in the process whose leader is in `leaderSlot`. The
+    // caller (`self`, -1 outside any process) is one of its threads, or
+    // the kernel starting a system thread.
+    static int CreateGroupThread(int leaderSlot, uint64_t entry, uint64_t arg, bool kernelMode) {
+        auto* cpu = Smp::GetCurrentCpuData();
+        int self = cpu->currentSlot;
+        Process& leader = processTable[leaderSlot];
+
+        // Reserve the slot, as in Spawn
+        int slot = ReserveSlot();
 
         if (slot < 0) {
-            schedLock.Release();
+            Kt::KernelLogStream(Kt::ERROR, "Sched") << "No free process slots";
             return -1;
         }
+        Process& thread = processTable[slot];
 
-        Process& proc = processTable[slot];
+        auto releaseSlot = [&]() {
+            procLock.Acquire();
+            ReleaseSlot(slot);
+            procLock.Release();
+        };
 
-        if (proc.runningOnCpu >= 0) {
-            // Process is currently running on another CPU. We cannot
-            // safely free its resources (kernel stack, PML4, user pages)
-            // because that CPU is actively using them. Set a kill-pending
-            // flag; the target CPU's Tick() will call ExitProcess().
-            proc.killPending = true;
-            schedLock.Release();
-            return 0;
+        void* stackMem = AllocKernelStack();
+        if (stackMem == nullptr) {
+            releaseSlot();
+            return -1;
         }
+        uint64_t kernelStackTop = (uint64_t)stackMem + StackSize;
+
+        // Each thread has its own window below the main stack, so thread
+        // stacks never overlap and are separated by unmapped guard space.
+        leader.vmLock.Acquire();
+        int window = kernelMode ? -1 : TakeStackWindow(leader);
+        if (!kernelMode && window < 0) {
+            leader.vmLock.Release();
+            Kt::KernelLogStream(Kt::ERROR, "Sched") << "No free thread stack windows";
+            Memory::g_pfa->Free(stackMem, StackPages);
+            releaseSlot();
+            return -1;
+        }
+        uint64_t stackTop = ThreadStackAreaTop - (uint64_t)window * ThreadStackStride;
+        uint64_t stackBase = stackTop - ThreadStackSize;
+        uint64_t topStackPagePhys = 0;
 
-        // Process is Ready or Blocked (not running on any CPU).
-        // Mark it Terminated so the scheduler won't pick it up.
-        int killedPid = proc.pid;
-        if (proc.state == ProcessState::Ready)
-            readyCount--;
-        proc.state = ProcessState::Terminated;
-        proc.killPending = false;
-
-        // Wake any processes blocked on this PID
-        for (int i = 0; i < MaxProcesses; i++) {
-            if (processTable[i].state == ProcessState::Blocked &&
-                processTable[i].waitingForPid == killedPid) {
-                processTable[i].state = ProcessState::Ready;
-                readyCount++;
-                processTable[i].waitingForPid = -1;
+        for (uint64_t i = 0; i < ThreadStackPages && !kernelMode; i++) {
+            void* page = Memory::g_pfa->AllocateZeroed();
+            uint64_t physAddr = page ? Memory::SubHHDM((uint64_t)page) : 0;
+            if (page == nullptr ||
+                !Memory::VMM::Paging::MapUserIn(leader.pml4Phys, physAddr, stackBase + i * 0x1000)) {
+                Kt::KernelLogStream(Kt::ERROR, "Sched") << "Failed to set up thread stack";
+                if (page) Memory::g_pfa->Free(page);
+                FreeUserPages(leader.pml4Phys, stackBase, i);
+                ReleaseStackWindow(leader, window);
+                leader.vmLock.Release();
+                Memory::g_pfa->Free(stackMem, StackPages);
+                releaseSlot();
+                return -1;
             }
+            if (i == ThreadStackPages - 1) topStackPagePhys = physAddr;
         }
+        leader.vmLock.Release();
 
-        schedLock.Release();
+        // Returning from the thread function lands in the thread exit stub
+        if (!kernelMode) {
+            uint8_t* topPage = (uint8_t*)Memory::HHDM(topStackPagePhys);
+            *(uint64_t*)(topPage + 0xFF8) = ThreadExitStubAddr;
+        }
 
-        // Safe to clean up resources now -- process is not running anywhere.
-        WinServer::CleanupProcess(killedPid);
+        // Same initial kernel frame as Spawn: first switch lands in ProcessStartup
+        uint64_t* sp = (uint64_t*)kernelStackTop;
 
-        if (proc.outBuf) {
-            Memory::g_pfa->Free(proc.outBuf);
-            proc.outBuf = nullptr;
+        *(--sp) = (uint64_t)ProcessStartup;  // return addr
+        *(--sp) = 0;  // rbp
+        *(--sp) = 0;  // rbx
+        *(--sp) = 0;  // r12
+        *(--sp) = 0;  // r13
+        *(--sp) = 0;  // r14
+        *(--sp) = 0;  // r15
+
+        procLock.Acquire();
+
+        // The process may have been killed meanwhile. Checked under
+        // procLock so KillGroup either sees the new thread or we see it.
+        if (leader.groupExiting || (self >= 0 && schedTable[self].killPending)) {
+            ReleaseSlot(slot);
+            procLock.Release();
+            Memory::g_pfa->Free(stackMem, StackPages);
+            return -1;
         }
-        if (proc.inBuf) {
-            Memory::g_pfa->Free(proc.inBuf);
-            proc.inBuf = nullptr;
+
+        AssignPid(slot);
+        thread.tgid = leader.pid;
+        thread.leaderSlot = leaderSlot;
+        thread.groupRefs = 0;
+        thread.groupExiting = false;
+        thread.exitCode = 0;
+        thread.joined = kernelMode;  // Nobody joins a kernel thread
+        thread.exiting = false;
+        thread.kernelMode = kernelMode;
+        for (int i = 0; i < 64; i++) thread.name[i] = leader.name[i];
+        thread.sched->savedRsp = (uint64_t)sp;
+        thread.stackBase = (uint64_t)stackMem;
+        thread.entryPoint = entry;
+        thread.threadArg = arg;
+        thread.sched->sliceEndUs = 0;
+        thread.pml4Phys = leader.pml4Phys;
+        thread.pcid = leader.pcid;
+        thread.kernelStackTop = kernelStackTop;
+        thread.userStackTop = kernelMode ? 0 : stackTop - 8;
+        thread.userStackBase = kernelMode ? 0 : stackBase;
+        thread.stackWindow = window;
+        thread.heapNext = 0;
+        thread.readdirCursor = 0;
+        thread.sched->runningOnCpu = -1;
+        thread.sched->killPending = false;
+        thread.sched->priority = leader.sched->priority;
+        thread.sched->boost = 0;
+        thread.sched->affinity = leader.sched->affinity;
+        thread.userTsc = 0;
+        thread.kernelTsc = 0;
+        thread.voluntarySwitches = 0;
+        thread.involuntarySwitches = 0;
+        thread.inSyscall = kernelMode;  // All of its time is kernel time
+        thread.sched->rqNext = -1;
+        thread.sched->queued = false;
+        thread.sched->onCpu = false;
+        thread.waitingForPid = -1;
+        thread.sched->sleepUntilUs = 0;
+        thread.futexAddr = 0;
+        thread.futexNext = -1;
+        thread.pmuEvents = 0;
+        thread.pmuFlags = 0;
+        thread.pmuParent = -1;
+        memset(thread.pmuCounts, 0, sizeof(thread.pmuCounts));
+        memset(thread.pmuChildren, 0, sizeof(thread.pmuChildren));
+        if (self >= 0 && (processTable[self].pmuFlags & Montauk::PERF_INHERIT)) {
+            thread.pmuEvents = processTable[self].pmuEvents;
+            thread.pmuFlags = processTable[self].pmuFlags;
+        }
+
+        // Per-process state is read from the leader's slot
+        thread.args[0] = '\0';
+        thread.user[0] = '\0';
+        thread.cwd[0] = '\0';
+        thread.env = nullptr;
+        thread.envSize = 0;
+        thread.redirected = false;
+        thread.parentPid = -1;
+        thread.outBuf = nullptr;
+        thread.outBufSize = 0;
+        thread.inBuf = nullptr;
+        thread.stdinPipe = -1;
+        thread.stdoutPipe = -1;
+
+        Hal::Fpu::InitArea(thread.fpuState);
+        thread.fpuCpu = -1;
+
+        __atomic_add_fetch(&leader.groupRefs, 1, __ATOMIC_ACQ_REL);
+
+        int tid = thread.pid;
+
+        int target = PickCpu(thread.sched->affinity);
+        runQueues[target].lock.Acquire();
+        thread.sched->state = ProcessState::Ready;
+        Enqueue(target, slot);
+        runQueues[target].lock.Release();
+
+        procLock.Release();
+
+        return tid;
+    }
+
+    int CreateThread(uint64_t entry, uint64_t arg) {
+        int self = Smp::GetCurrentCpuData()->currentSlot;
+        if (self < 0) return -1;
+        return CreateGroupThread(processTable[self].leaderSlot, entry, arg, false);
+    }
+
+    int CreateKernelThread(void (*fn)(uint64_t), uint64_t arg) {
+        int self = Smp::GetCurrentCpuData()->currentSlot;
+        if (self < 0) return -1;
+        return CreateGroupThread(processTable[self].leaderSlot, (uint64_t)fn, arg, true);
+    }
+
+    int CreateSystemThread(void (*fn)(uint64_t), uint64_t arg) {
+        procLock.Acquire();
+        int leaderSlot = FindSlot(0);
+        if (leaderSlot >= 0) leaderSlot = processTable[leaderSlot].leaderSlot;
+        procLock.Release();
+        if (leaderSlot < 0) return -1;
+        return CreateGroupThread(leaderSlot, (uint64_t)fn, arg, true);
+    }
+
+    int JoinThread(int tid, int* exitCode) {
+        auto* cpu = Smp::GetCurrentCpuData();
+        int self = cpu->currentSlot;
+        if (self < 0) return -1;
+        int tgid = processTable[self].tgid;
+
+        // Only another, not yet joined thread of our own process qualifies.
+        // The leader has no exit code of its own to collect.
+        procLock.Acquire();
+        int slot = -1;
+        for (int i = usedHead; i >= 0; i = processTable[i].listNext) {
+            const Process& proc = processTable[i];
+            if (proc.pid == tid && proc.tgid == tgid && proc.leaderSlot != i &&
+                proc.sched->state != ProcessState::Free && !proc.joined) {
+                slot = i;
+                break;
+            }
         }
+        procLock.Release();
+
+        if (slot < 0 || slot == self) return -1;
 
-        Memory::VMM::Paging::FreeUserHalf(proc.pml4Phys);
+        BlockOnPid(tid);
 
-        // Kernel stack and PML4 freed by ReclaimTerminated on BSP tick.
+        // Our process is alive, so the slot is only reclaimed once joined
+        procLock.Acquire();
+        Process& thread = processTable[slot];
+        if (thread.pid != tid || thread.sched->state != ProcessState::Terminated || thread.joined) {
+            // Woken by a kill instead, or someone else joined it first
+            procLock.Release();
+            return -1;
+        }
+        thread.joined = true;
+        *exitCode = thread.exitCode;
+        procLock.Release();
         return 0;
     }
 
@@ -703,63 +2294,39 @@ namespace Sched {
         int slot = cpu->currentSlot;
         if (slot < 0) return;
 
-        schedLock.Acquire();
+        procLock.Acquire();
 
         // Double-check under lock (target might have exited between
         // the lockless IsAlive check and acquiring the lock)
-        bool stillAlive = false;
-        for (int i = 0; i < MaxProcesses; i++) {
-            if (processTable[i].pid == pid) {
-                auto s = processTable[i].state;
-                stillAlive = (s == ProcessState::Ready ||
-                              s == ProcessState::Running ||
-                              s == ProcessState::Blocked);
-                break;
-            }
-        }
-
-        if (!stillAlive) {
-            schedLock.Release();
+        if (FindSlot(pid) < 0) {
+            procLock.Release();
             return;
         }
 
         // Mark current process as Blocked -- scheduler will skip it.
-        // ExitProcess will wake us when the target terminates.
-        processTable[slot].state = ProcessState::Blocked;
+        // ExitProcess/KillProcess wake us (under procLock) when the
+        // target terminates.
+        schedTable[slot].state = ProcessState::Blocked;
         processTable[slot].waitingForPid = pid;
-        processTable[slot].runningOnCpu = -1;
-
-        // Find next ready process to switch to
-        int next = -1;
-        for (int i = 0; i < MaxProcesses; i++) {
-            if (processTable[i].state == ProcessState::Ready) {
-                next = i;
-                break;
-            }
+        procLock.Release();
+
+        // The target may exit right here and wake us before we switch
+        // away; SwitchTo copes with finding us Ready (or even on our own
+        // queue) again.
+        cpu = LockLocalQueue();
+        if (schedTable[slot].state == ProcessState::Running) {
+            // Preempted after blocking, then already woken and resumed
+            runQueues[cpu->cpuIndex].lock.Release();
+            return;
         }
-
-        if (next >= 0) {
-            cpu->currentSlot = next;
-            processTable[next].state = ProcessState::Running;
-            readyCount--;
-            processTable[next].runningOnCpu = cpu->cpuIndex;
-            processTable[next].sliceRemaining = TimeSliceMs;
-
-            cpu->kernelRsp = processTable[next].kernelStackTop;
-            cpu->tss->rsp0 = processTable[next].kernelStackTop;
-
-            SchedContextSwitch(&processTable[slot].savedRsp, processTable[next].savedRsp,
-                              processTable[next].pml4Phys,
-                              processTable[slot].fpuState, processTable[next].fpuState);
-            schedLock.Release();
-        } else {
-            // No ready process -- go idle
-            cpu->currentSlot = -1;
-
-            SchedContextSwitch(&processTable[slot].savedRsp, cpu->idleSavedRsp,
-                              GetKernelCR3(), processTable[slot].fpuState, nullptr);
-            schedLock.Release();
+        if (schedTable[slot].killPending && schedTable[slot].state == ProcessState::Blocked) {
+            // Don't go to sleep with a kill pending; Tick() finishes us off
+            schedTable[slot].state = ProcessState::Running;
+            processTable[slot].waitingForPid = -1;
+            runQueues[cpu->cpuIndex].lock.Release();
+            return;
         }
+        SwitchTo(cpu, PickNext(cpu->cpuIndex));
     }
 
     void BlockForSleep(uint64_t ms) {
@@ -769,71 +2336,187 @@ namespace Sched {
         int slot = cpu->currentSlot;
         if (slot < 0) return;
 
-        schedLock.Acquire();
+        cpu = LockLocalQueue();
 
-        processTable[slot].state = ProcessState::Blocked;
-        processTable[slot].sleepUntilTick = Timekeeping::GetTicks() + ms;
-        processTable[slot].runningOnCpu = -1;
-
-        int next = -1;
-        for (int i = 0; i < MaxProcesses; i++) {
-            if (processTable[i].state == ProcessState::Ready) {
-                next = i;
-                break;
-            }
+        if (schedTable[slot].killPending) {
+            runQueues[cpu->cpuIndex].lock.Release();
+            return;
         }
 
-        if (next >= 0) {
-            cpu->currentSlot = next;
-            processTable[next].state = ProcessState::Running;
-            readyCount--;
-            processTable[next].runningOnCpu = cpu->cpuIndex;
-            processTable[next].sliceRemaining = TimeSliceMs;
-
-            cpu->kernelRsp = processTable[next].kernelStackTop;
-            cpu->tss->rsp0 = processTable[next].kernelStackTop;
-
-            SchedContextSwitch(&processTable[slot].savedRsp, processTable[next].savedRsp,
-                              processTable[next].pml4Phys,
-                              processTable[slot].fpuState, processTable[next].fpuState);
-            schedLock.Release();
+        schedTable[slot].state = ProcessState::Blocked;
+        schedTable[slot].sleepUntilUs = Timekeeping::GetMicroseconds() + ms * 1000;
+        NoteSleeper(cpu->cpuIndex, slot, schedTable[slot].sleepUntilUs);
+
+        SwitchTo(cpu, PickNext(cpu->cpuIndex));
+    }
+
+    int FutexWait(uint64_t addr, volatile uint32_t* word, uint32_t expected, uint64_t timeoutMs) {
+        auto* cpu = Smp::GetCurrentCpuData();
+        int slot = cpu->currentSlot;
+        if (slot < 0) return 0;
+        Process& proc = processTable[slot];
+        FutexBucket& bucket = FutexBucketFor(addr);
+
+        // The value check and joining the wait queue are atomic with
+        // respect to FutexWake: a waker that changes the word after this
+        // read takes the bucket lock to wake, and finds us queued.
+        bucket.lock.Acquire();
+        if (*word != expected) {
+            bucket.lock.Release();
+            return 0;
+        }
+        proc.futexAddr = addr;
+        proc.futexNext = -1;
+        if (bucket.tail >= 0) processTable[bucket.tail].futexNext = slot;
+        else bucket.head = slot;
+        bucket.tail = slot;
+        proc.sched->state = ProcessState::Blocked;
+        proc.sched->sleepUntilUs = 0;
+        if (timeoutMs) {
+            proc.sched->sleepUntilUs = Timekeeping::GetMicroseconds() + timeoutMs * 1000;
+            cpu = LockLocalQueue();
+            NoteSleeper(cpu->cpuIndex, slot, proc.sched->sleepUntilUs);
+            runQueues[cpu->cpuIndex].lock.Release();
+        }
+        bucket.lock.Release();
+
+        // Same hand-off as BlockOnPid: a wake may already have happened
+        cpu = LockLocalQueue();
+        if (proc.sched->state == ProcessState::Running) {
+            runQueues[cpu->cpuIndex].lock.Release();
+        } else if (proc.sched->killPending && proc.sched->state == ProcessState::Blocked) {
+            proc.sched->state = ProcessState::Running;
+            proc.sched->sleepUntilUs = 0;
+            runQueues[cpu->cpuIndex].lock.Release();
         } else {
-            cpu->currentSlot = -1;
+            SwitchTo(cpu, PickNext(cpu->cpuIndex));
+        }
+
+        // A wake unlinks us and clears futexAddr; still set means the
+        // timeout (or a pending kill) woke us.
+        bucket.lock.Acquire();
+        bool timedOut = proc.futexAddr != 0;
+        if (timedOut) FutexUnlink(bucket, slot);
+        bucket.lock.Release();
+        return timedOut ? 1 : 0;
+    }
 
-            SchedContextSwitch(&processTable[slot].savedRsp, cpu->idleSavedRsp,
-                              GetKernelCR3(), processTable[slot].fpuState, nullptr);
-            schedLock.Release();
+    // Wake up to `count` threads blocked on `addr`, of thread group `tgid`
+    // only if it is not -1
+    static int WakeFutex(uint64_t addr, int tgid, int count) {
+        FutexBucket& bucket = FutexBucketFor(addr);
+        int woken = 0;
+
+        bucket.lock.Acquire();
+        int prev = -1;
+        int* link = &bucket.head;
+        while (*link >= 0 && woken < count) {
+            int i = *link;
+            Process& proc = processTable[i];
+            if (proc.futexAddr != addr || (tgid >= 0 && proc.tgid != tgid) ||
+                proc.sched->state != ProcessState::Blocked) {
+                prev = i;
+                link = &proc.futexNext;
+                continue;
+            }
+            *link = proc.futexNext;
+            if (bucket.tail == i) bucket.tail = prev;
+            proc.futexNext = -1;
+            proc.futexAddr = 0;
+            WakeBlocked(i);
+            woken++;
         }
+        bucket.lock.Release();
+        return woken;
     }
 
-    bool IsAlive(int pid) {
-        for (int i = 0; i < MaxProcesses; i++) {
-            if (processTable[i].pid == pid) {
-                auto s = processTable[i].state;
-                return s == ProcessState::Ready
-                    || s == ProcessState::Running
-                    || s == ProcessState::Blocked;
+    int FutexWake(uint64_t addr, int count) {
+        int tgid = GetCurrentPid();
+        if (tgid < 0) return 0;
+        return WakeFutex(addr, tgid, count);
+    }
+
+    void WaitOnAddress(volatile uint32_t* word, uint32_t expected) {
+        FutexWait((uint64_t)word, word, expected, 0);
+    }
+
+    int WakeAddress(volatile uint32_t* word, int count) {
+        return WakeFutex((uint64_t)word, -1, count);
+    }
+
+    static int ReadyChannel(uint64_t key) {
+        return (int)((key * 0x9E3779B97F4A7C15ULL) >> (64 - ReadyChannelBits));
+    }
+
+    bool SubscribeReady(int listener, const uint64_t* keys, int count) {
+        uint64_t wanted[ReadyChannels / 64] = {};
+        for (int i = 0; i < count; i++) {
+            if (keys[i] == 0) continue;
+            int channel = ReadyChannel(keys[i]);
+            wanted[channel / 64] |= 1ULL << (channel % 64);
+        }
+
+        uint64_t bit = 1ULL << listener;
+        uint64_t* subscribed = readySubscribed[listener];
+        bool added = false;
+        for (int w = 0; w < ReadyChannels / 64; w++) {
+            uint64_t join = wanted[w] & ~subscribed[w];
+            uint64_t leave = subscribed[w] & ~wanted[w];
+            for (; join; join &= join - 1) {
+                __atomic_or_fetch(&readyChannels[w * 64 + __builtin_ctzll(join)], bit, __ATOMIC_SEQ_CST);
             }
+            for (; leave; leave &= leave - 1) {
+                __atomic_and_fetch(&readyChannels[w * 64 + __builtin_ctzll(leave)], ~bit, __ATOMIC_SEQ_CST);
+            }
+            added |= (wanted[w] & ~subscribed[w]) != 0;
+            subscribed[w] = wanted[w];
         }
-        return false;
+        return added;
     }
 
-    Process* GetProcessByPid(int pid) {
-        for (int i = 0; i < MaxProcesses; i++) {
-            if (processTable[i].pid == pid) {
-                auto s = processTable[i].state;
-                if (s == ProcessState::Ready || s == ProcessState::Running ||
-                    s == ProcessState::Blocked) {
-                    return &processTable[i];
-                }
+    uint32_t ReadyGeneration(int listener) {
+        return __atomic_load_n(&readyGenerations[listener], __ATOMIC_SEQ_CST);
+    }
+
+    void NotifyReady(uint64_t key) {
+        // Pairs with SubscribeReady and WaitReady: a listener that joined
+        // the channel before reading its generation either sees the new
+        // state, or sees its generation move, and a waiter either sees the
+        // new generation or is seen in readyWaiters
+        uint64_t listeners = __atomic_load_n(&readyChannels[ReadyChannel(key)], __ATOMIC_SEQ_CST);
+        for (; listeners; listeners &= listeners - 1) {
+            int listener = __builtin_ctzll(listeners);
+            __atomic_add_fetch(&readyGenerations[listener], 1, __ATOMIC_SEQ_CST);
+            if (__atomic_load_n(&readyWaiters[listener], __ATOMIC_SEQ_CST) != 0) {
+                WakeAddress(&readyGenerations[listener], MaxProcesses);
             }
         }
-        return nullptr;
+    }
+
+    int WaitReady(int listener, uint32_t generation, uint64_t timeoutMs) {
+        volatile uint32_t* word = &readyGenerations[listener];
+        __atomic_add_fetch(&readyWaiters[listener], 1, __ATOMIC_SEQ_CST);
+        int timedOut = FutexWait((uint64_t)word, word, generation, timeoutMs);
+        __atomic_sub_fetch(&readyWaiters[listener], 1, __ATOMIC_SEQ_CST);
+        return timedOut;
+    }
+
+    bool IsAlive(int pid) {
+        return FindSlot(pid) >= 0;
+    }
+
+    Process* GetProcessByPid(int pid) {
+        int slot = FindSlot(pid);
+        return (slot >= 0) ? &processTable[slot] : nullptr;
     }
 
     Process* GetProcessSlot(int slot) {
-        if (slot < 0 || slot >= MaxProcesses) return nullptr;
+        if (slot < 0 || slot >= __atomic_load_n(&slotCount, __ATOMIC_ACQUIRE)) return nullptr;
         return &processTable[slot];
     }
 
+    int SlotCount() {
+        return __atomic_load_n(&slotCount, __ATOMIC_ACQUIRE);
+    }
+
 }
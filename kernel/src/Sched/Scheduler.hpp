@@ -7,22 +7,43 @@
 #pragma once
 #include <cstdint>
 #include <Api/Syscall.hpp>
+#include <CppLib/Spinlock.hpp>
+#include <Hal/Fpu.hpp>
+#include <Memory/Vma.hpp>
 
 namespace Sched {
 
-    static constexpr int MaxProcesses = 256;
+    struct ElfImage;
+
+    // Process table slots are allocated SlotChunk at a time as they are
+    // first needed; MaxProcesses only bounds the table
+    static constexpr int MaxProcesses = 4096;
+    static constexpr int SlotChunk = 32;
     static constexpr uint64_t StackPages = 4;  // 16 KiB kernel stack per process
     static constexpr uint64_t StackSize = StackPages * 0x1000;
     static constexpr uint64_t UserStackPages = 8;  // 32 KiB user stack
     static constexpr uint64_t UserStackSize = UserStackPages * 0x1000;
-    static constexpr uint64_t UserStackTop = 0x7FFFFFF000ULL;  // User stack top VA
+    static constexpr uint64_t UserStackTop = Montauk::USER_STACK_TOP;  // User stack top VA
     static constexpr uint64_t UserHeapBase = 0x40000000ULL;    // User heap start VA
     static constexpr uint32_t UserReadDirSlots = 64;           // rotating scratch pages for SYS_READDIR
     static constexpr uint64_t UserReadDirBase =
         UserHeapBase - (uint64_t)UserReadDirSlots * 0x1000ULL;
     static constexpr uint64_t ExitStubAddr = 0x3FF000ULL;     // User-space exit stub page
+    static constexpr uint64_t ThreadExitStubAddr = ExitStubAddr + 0x10; // SYS_THREAD_EXIT stub (same page)
+    static constexpr uint64_t ThreadStackPages = 16;  // 64 KiB user stack per extra thread
+    static constexpr uint64_t ThreadStackSize = ThreadStackPages * 0x1000;
+    static constexpr uint64_t ThreadStackStride = Montauk::USER_THREAD_STACK_STRIDE;  // Per-thread VA window (stack + guard gap)
+    static constexpr uint64_t ThreadStackAreaTop = Montauk::USER_THREAD_STACK_TOP; // Below the main stack
+    static constexpr int ThreadStackWindows = Montauk::USER_THREAD_SLOTS;  // Threads per process with a user stack
     static constexpr uint64_t TimeSliceMs = 10; // 10 ms time slice
 
+    // Scheduling classes are the Montauk::PRIO_* values. Each CPU runs its
+    // highest non-empty class first; within a class it is round-robin.
+    static constexpr int PriorityCount = Montauk::PRIO_COUNT;
+    static constexpr uint64_t BatchSliceMs = 40;   // Batch runs less often, but for longer
+    static constexpr uint8_t BoostSlices = 3;      // Full slices an input boost lasts
+    static constexpr uint64_t StarvationMs = 200;  // Queue wait after which any class runs next
+
     enum class ProcessState {
         Free,
         Ready,
@@ -31,32 +52,114 @@ namespace Sched {
         Terminated
     };
 
+    // The part of a thread the scheduler reads on every tick, pick and
+    // wakeup, kept apart from the rest of its slot in a table of its own:
+    // one cache line per thread, so walking a run queue or the sleepers
+    // does not pull names, paths, I/O rings and FPU state into the cache.
+    // The run queue fields are guarded by the owning CPU's run queue lock.
+    struct alignas(64) SchedEntity {
+        ProcessState state = ProcessState::Free;
+        int cpu = 0;              // Owning CPU: queue it sits on, or CPU it runs / last ran on
+        int rqNext = -1;          // Next slot in the owning CPU's ready queue
+        int runningOnCpu = -1;    // CPU index running this thread (-1 if not running)
+
+        // Scheduling class (Montauk::PRIO_*); the same for every thread of a process
+        uint8_t priority = Montauk::PRIO_NORMAL;
+        uint8_t boost = 0;        // Slices left at interactive level after an input event
+        uint8_t rqLevel = 0;      // Class list it is linked into while queued
+        bool queued = false;      // Linked into the owning CPU's ready queue
+        volatile bool onCpu = false; // Register state is live on a CPU (RSP not yet saved)
+        bool killPending = false; // Set by Sys_Kill when target is running on another CPU
+
+        uint64_t affinity = ~0ULL; // Bit i set: may run on CPU index i
+        uint64_t queuedAtUs = 0;  // When it was queued (for starvation aging)
+        uint64_t sliceEndUs = 0;  // End of the current time slice (GetMicroseconds() time)
+        uint64_t sleepUntilUs = 0; // Wake deadline in GetMicroseconds() time (0 = not sleeping)
+        uint64_t savedRsp = 0;
+    };
+    static_assert(sizeof(SchedEntity) == 64, "SchedEntity must fill exactly one cache line");
+
+    // Every thread occupies its own process table slot. Per-process state
+    // (address space, heap, args, cwd, I/O redirection) lives in the slot
+    // of the thread group leader, which is the thread created by Spawn.
     struct Process {
-        int pid;
-        ProcessState state;
+        int pid;                  // Thread ID (== process ID for the leader)
+        SchedEntity* sched;       // This slot's entry in the scheduling table
         int waitingForPid;     // PID this process is blocked on (-1 if none)
-        uint64_t sleepUntilTick; // Tick deadline for SYS_SLEEP_MS (0 = not sleeping)
+        uint64_t futexAddr = 0;  // Address waited on in FutexWait (0 = none)
+        int futexNext = -1;      // Next slot in its futex bucket's wait queue
         char name[64];
-        uint64_t savedRsp;
         uint64_t stackBase;       // Bottom of allocated kernel stack (lowest address)
         uint64_t entryPoint;
-        uint64_t sliceRemaining;  // Ticks left in current time slice
         uint64_t pml4Phys;        // Physical address of per-process PML4
         uint64_t kernelStackTop;  // Top of kernel stack (for TSS RSP0 / SYSCALL)
         uint64_t userStackTop;    // User-space stack top
-        uint64_t heapNext;        // Simple bump allocator for user heap
+        uint64_t heapNext;        // Bump frontier of the user heap (above every heap region)
         uint32_t readdirCursor;   // Next SYS_READDIR scratch slot
         char args[256];           // Command-line arguments (set by parent via Spawn)
         char user[32];            // Owner user name (inherited from parent on spawn)
         char cwd[256];            // Absolute current working directory
+        char* env = nullptr;      // Environment block (SYS_GETENV), kernel heap; nullptr if empty
+        uint32_t envSize = 0;
 
-        int runningOnCpu;         // CPU index running this process (-1 if not running)
-        bool killPending = false; // Set by Sys_Kill when target is running on another CPU
+        // CPU time in TSC cycles, charged at context switches and syscall
+        // entry/exit. Interrupts are charged to whatever they interrupted.
+        uint64_t userTsc = 0;
+        uint64_t kernelTsc = 0;
+        uint64_t stampTsc = 0;    // Start of the interval not yet charged
+        bool inSyscall = false;
+        uint64_t reapedUserTsc = 0;   // Leader only: time of threads already reclaimed
+        uint64_t reapedKernelTsc = 0;
+
+        // Times switched out: blocked, or preempted/yielded while runnable
+        uint64_t voluntarySwitches = 0;
+        uint64_t involuntarySwitches = 0;
+        uint64_t reapedVoluntary = 0;     // Leader only: threads already reclaimed
+        uint64_t reapedInvoluntary = 0;
+
+        // Hardware counters (SYS_PERFCTL). They run only while this thread
+        // is on a CPU and are folded into pmuCounts when it switches out.
+        uint32_t pmuEvents = 0;       // Montauk::PERF_* being counted (0 = off)
+        uint32_t pmuFlags = 0;        // Montauk::PERF_INHERIT, PERF_USER_ONLY
+        uint64_t pmuCounts[Montauk::PERF_MAX_EVENTS] = {};
+        uint64_t pmuChildren[Montauk::PERF_MAX_EVENTS] = {}; // Leader only: exited inheriting processes
+        int pmuParent = -1;           // Leader only: process whose pmuChildren we add to at exit
+
+        // Thread group (guarded by the scheduler's process lock)
+        int tgid = -1;            // PID of the thread group leader
+        int leaderSlot = -1;      // Slot of the thread group leader (own slot for a leader)
+
+        // Slot bookkeeping (guarded by procLock)
+        int pidBucket = -1;       // PID hash bucket holding this slot (-1 = none)
+        int listNext = -1;        // Next slot on the free stack or the in-use list
+        int listPrev = -1;        // Previous slot on the in-use list
+        int deadNext = -1;        // Next slot on the list of Terminated slots to reclaim
+        volatile int groupRefs = 0; // Leader only: threads still using the address space
+        bool groupExiting = false; // Leader only: the whole process is being torn down
+        int exitCode = 0;         // Thread exit status, collected by SYS_THREAD_JOIN
+        bool joined = false;      // Exit status collected; slot may be reclaimed
+        bool exiting = false;     // Thread is tearing itself down; no longer a kill target
+        uint64_t threadArg = 0;   // Passed in RDI on first entry to user mode
+        uint64_t userStackBase = 0; // Non-leader threads: lowest VA of the user stack
+        int stackWindow = -1;     // Non-leader threads: window the user stack lies in
+        uint16_t pcid = 0;        // TLB tag of the address space (the leader's, for a thread)
+        bool kernelMode = false;  // Runs entryPoint in ring 0 (CreateKernelThread)
+        kcp::Mutex vmLock;        // Leader only: serializes user mappings between threads
+        Memory::VmaTree heapVmas; // Leader only: SYS_ALLOC regions and freed holes (under vmLock)
+        uint64_t stackWindows[ThreadStackWindows / 64] = {}; // Leader only: thread stack windows in use (under vmLock)
+
+        // Leader only: heap pages actually backed by memory, and pages
+        // reserved by SYS_ALLOC (faulted in on first touch)
+        uint64_t allocatedPages = 0;
+        uint64_t reservedPages = 0;
+        volatile int dmaPins = 0; // Leader only: user buffers a device is using (Memory::Dma)
+        ElfImage* elfImage = nullptr; // Leader only: executable the address space maps
 
         // I/O redirection for GUI terminal
         bool redirected = false;
         int parentPid = -1;
-        uint8_t* outBuf = nullptr;   // 4KB ring: child writes (print/putchar), parent reads
+        uint8_t* outBuf = nullptr;   // outBufSize ring: child writes (print/putchar), parent reads
+        uint32_t outBufSize = 0;
         volatile uint32_t outHead = 0;
         volatile uint32_t outTail = 0;
         uint8_t* inBuf = nullptr;    // 4KB ring: parent writes, child reads (getchar)
@@ -67,16 +170,48 @@ namespace Sched {
         volatile uint32_t keyTail = 0;
         static constexpr uint32_t IoBufSize = 4096;
 
+        // Output ring sizes SYS_SPAWN_REDIR accepts: a burst of output this
+        // large reaches the parent in one SYS_CHILDIO_READ
+        static constexpr uint32_t OutBufDefaultSize = 64 * 1024;
+        static constexpr uint32_t OutBufMaxSize = 1024 * 1024;
+
+        // Pipe ends used as stdin and stdout (Api/Pipe.hpp handles, -1 =
+        // none). Set by Spawn, which gives the process its own hold on each.
+        int stdinPipe = -1;
+        int stdoutPipe = -1;
+
         // GUI terminal dimensions (set by desktop, read by SYS_TERMSIZE)
         int termCols = 0;
         int termRows = 0;
 
-        // FPU/SSE state (FXSAVE format, must be 16-byte aligned)
-        uint8_t fpuState[512] __attribute__((aligned(16)));
+        // FPU/SSE/AVX state in Hal::Fpu's save format, loaded lazily on first use
+        int fpuCpu = -1;          // CPU whose registers last had this state loaded
+        uint8_t fpuState[Hal::Fpu::MaxAreaSize] __attribute__((aligned(64)));
     };
 
     void Initialize();
-    int Spawn(const char* vfsPath, const char* args = nullptr);
+
+    // How a new process is set up besides its path and arguments
+    struct SpawnOptions {
+        // A Montauk::PRIO_* class, or PRIO_INHERIT: batch if the caller is
+        // batch, otherwise normal
+        int priority = Montauk::PRIO_INHERIT;
+        // Pipe ends the caller holds, or Montauk::PIPE_INHERIT for the
+        // caller's own, or PIPE_NONE
+        int stdinPipe = Montauk::PIPE_INHERIT;
+        int stdoutPipe = Montauk::PIPE_INHERIT;
+        uint64_t affinity = ~0ULL;  // Must include a CPU that is up
+        const char* cwd = nullptr;  // Absolute; nullptr = the caller's
+        // Environment block, copied; nullptr = a copy of the caller's
+        const char* env = nullptr;
+        uint32_t envSize = 0;
+    };
+
+    // Start a new process. Returns its PID, or -1.
+    int Spawn(const char* vfsPath, const char* args, const SpawnOptions& options);
+    int Spawn(const char* vfsPath, const char* args = nullptr,
+              int priority = Montauk::PRIO_INHERIT,
+              int stdinPipe = Montauk::PIPE_INHERIT, int stdoutPipe = Montauk::PIPE_INHERIT);
     void Schedule();
 
     // Called from the APIC timer handler on every tick (per-CPU).
@@ -85,12 +220,54 @@ namespace Sched {
     // Get the PID of the currently running process (-1 if idle)
     int GetCurrentPid();
 
-    // Get a pointer to the currently running process (nullptr if idle)
+    // Get the thread ID of the currently running thread (-1 if idle)
+    int GetCurrentTid();
+
+    // Get a pointer to the currently running process, i.e. the thread
+    // group leader's slot (nullptr if idle)
     Process* GetCurrentProcessPtr();
 
-    // Called by terminated processes to mark themselves done
+    // Get a pointer to the currently running thread's own slot
+    Process* GetCurrentThreadPtr();
+
+    // Called by terminated processes to mark themselves done.
+    // Takes every thread of the process down with it.
     void ExitProcess();
 
+    // Count `events` (Montauk::PERF_*) for the calling thread from zero,
+    // or stop counting if events is 0. Returns the events counted, or -1
+    // if none of them can be.
+    int PerfStart(uint32_t events, uint32_t flags);
+
+    // Counts of the calling thread and of its process's exited children
+    void PerfRead(Montauk::PerfCounts& out);
+
+    // Start a new thread in the current process at `entry` with `arg` in
+    // RDI. It shares the address space and gets its own kernel stack,
+    // user stack and FPU state. Returns the new thread ID, or -1.
+    int CreateThread(uint64_t entry, uint64_t arg);
+
+    // Start a thread in the current process that runs `fn(arg)` in kernel
+    // mode, for kernel work done on a process's behalf. It shares the
+    // address space (so it can reach the process's buffers), has no user
+    // stack, cannot be joined, and is killed with the process. Returning
+    // from `fn` ends the thread. Returns the thread ID, or -1.
+    int CreateKernelThread(void (*fn)(uint64_t), uint64_t arg);
+
+    // Start a kernel-mode thread like CreateKernelThread, but in init's
+    // process (PID 0, which cannot be killed), for kernel daemons that
+    // must outlive any user process. Called once init is spawned.
+    int CreateSystemThread(void (*fn)(uint64_t), uint64_t arg);
+
+    // Terminate only the calling thread. The process goes away with its
+    // last thread.
+    void ExitThread(int exitCode);
+
+    // Wait for thread `tid` of the current process to exit and collect its
+    // exit code. A thread can be joined once; until then its slot stays
+    // allocated. Returns 0 on success, -1 if `tid` is not joinable.
+    int JoinThread(int tid, int* exitCode);
+
     // Check if a process is still alive (Ready, Running, or Blocked)
     bool IsAlive(int pid);
 
@@ -100,6 +277,99 @@ namespace Sched {
     // Block the current process for the given number of milliseconds.
     void BlockForSleep(uint64_t ms);
 
+    // Block the calling thread on user address `addr` if `*word` (a kernel
+    // alias of that address) still equals `expected`. Gives up after
+    // `timeoutMs` if non-zero. Returns 0 when woken or if the value had
+    // already changed, 1 on timeout.
+    int FutexWait(uint64_t addr, volatile uint32_t* word, uint32_t expected, uint64_t timeoutMs);
+
+    // Wake up to `count` threads of the current process waiting on `addr`.
+    // Returns the number of threads woken.
+    int FutexWake(uint64_t addr, int count);
+
+    // Kernel wait queues on the futex machinery, keyed by a kernel address
+    // (never equal to a user futex address). WaitOnAddress blocks the
+    // calling thread while `*word` equals `expected`; it may return early
+    // (pending kill, no current thread), so callers re-check in a loop.
+    // WakeAddress wakes up to `count` threads of any process and returns
+    // the number woken.
+    void WaitOnAddress(volatile uint32_t* word, uint32_t expected);
+    int WakeAddress(volatile uint32_t* word, int count);
+
+    // Readiness notifications for SYS_EPOLL_WAIT. An event source is named
+    // by a key: the address of the kernel object whose state changed (a
+    // pipe's sequence word, a connection, a window), or for a source there
+    // is only one of its Montauk::POLL_SRC_* number. A listener (a poll
+    // set, numbered below MaxReadyListeners) subscribes to the keys it
+    // watches; NotifyReady(key), safe from interrupt context, bumps the
+    // generation of the listeners subscribed to that key and wakes those
+    // that wait, and does nothing else. Keys hash into a fixed table, so
+    // a listener may now and then be woken for a key it does not watch.
+    //
+    // A waiter subscribes, then reads ReadyGeneration, checks its sources,
+    // and calls WaitReady with the generation it read: it returns at once
+    // if one of them was notified in between. SubscribeReady replaces the
+    // listener's keys (count 0 drops them all) and returns true if it
+    // added one, in which case the sources must be checked again before
+    // waiting. Calls for one listener must not overlap. WaitReady returns
+    // 1 after `timeoutMs` (0 = no timeout), else 0.
+    static constexpr int MaxReadyListeners = 64;
+    bool SubscribeReady(int listener, const uint64_t* keys, int count);
+    uint32_t ReadyGeneration(int listener);
+    void NotifyReady(uint64_t key);
+    inline void NotifyReady(const volatile void* key) { NotifyReady((uint64_t)key); }
+    int WaitReady(int listener, uint32_t generation, uint64_t timeoutMs);
+
+    // Set the scheduling class of every thread of process `pid`.
+    // Returns 0 on success, -1 if there is no such process or class.
+    int SetPriority(int pid, int priority);
+
+    // Get the scheduling class of process `pid` (-1 if not found).
+    int GetPriority(int pid);
+
+    // Restrict every thread of process `pid` to the CPUs in `mask` (bit i
+    // = CPU index i). Threads running elsewhere move at once. Returns 0
+    // on success, -1 if there is no such process or no CPU of `mask` is up.
+    int SetAffinity(int pid, uint64_t mask);
+
+    // The CPUs that are up, as an affinity mask
+    uint64_t OnlineCpuMask();
+
+    // Get the affinity mask of process `pid` (0 if not found).
+    uint64_t GetAffinity(int pid);
+
+    // Total user and kernel CPU time of process `pid` (all its threads,
+    // including exited ones) in microseconds. Returns false if not found.
+    bool GetCpuTime(int pid, uint64_t& userUs, uint64_t& kernelUs);
+
+    // Scheduling figures of a whole process, exited threads included
+    struct GroupStats {
+        uint64_t userUs, kernelUs;
+        uint64_t voluntarySwitches, involuntarySwitches;
+        int threads;              // Live threads
+        int cpu;                  // CPU running one of them, -1 if none
+    };
+
+    // Fill `out` for process `pid`. Returns false if not found.
+    bool GetGroupStats(int pid, GroupStats& out);
+
+    // Syscall entry/exit hooks for CPU time accounting
+    void EnterSyscall();
+    void LeaveSyscall();
+
+    // #NM handler: the current thread used the FPU with CR0.TS set. Loads
+    // its FPU state into this CPU's registers.
+    void HandleFpuTrap();
+
+    // Write the FPU registers of this CPU back to their owner and drop
+    // ownership (before S3, which loses the register contents).
+    void SaveFpuState();
+
+    // Process `pid` just received input (a key or a window event). Its
+    // threads run at interactive level for the next few slices, so the
+    // reaction to the event is not queued behind CPU-bound work.
+    void BoostInput(int pid);
+
     // Kill a process by PID. If the process is running on another CPU,
     // sets a kill-pending flag checked on the next timer tick.
     // Returns 0 on success, -1 on failure.
@@ -108,10 +378,12 @@ namespace Sched {
     // Find a process by PID (returns nullptr if not found or not alive)
     Process* GetProcessByPid(int pid);
 
-    // Get a pointer to slot i in the process table (for enumeration)
+    // Get a pointer to slot i in the process table (for enumeration), or
+    // nullptr past the slots allocated so far
     Process* GetProcessSlot(int slot);
 
-    // Per-process allocated page count (tracked by Heap syscalls, separate from Process struct)
-    inline uint64_t g_allocatedPages[MaxProcesses] = {};
+    // Slots allocated so far. It only grows: slot storage is never freed,
+    // so a Process pointer stays valid (if reused) without any lock.
+    int SlotCount();
 
 }
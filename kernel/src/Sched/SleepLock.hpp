@@ -0,0 +1,67 @@
+/*
+    * SleepLock.hpp
+    * Mutex that puts contending threads to sleep
+    * Copyright (c) 2026 Daniel Hammer
+*/
+
+#pragma once
+#include <cstdint>
+#include <CppLib/Spinlock.hpp>
+#include <Hal/Cpu.hpp>
+#include "Scheduler.hpp"
+
+namespace Sched {
+
+    // For locks held across disk I/O, where spinning would burn a CPU for
+    // milliseconds. A short spin covers brief critical sections; after that
+    // the thread blocks until Release() wakes it. Never use from interrupt
+    // context or with a kcp::Spinlock held.
+    class SleepLock {
+        static constexpr int SpinCount = 100;
+
+        // 0 free, 1 held, 2 held and a thread may be waiting
+        volatile uint32_t state = 0;
+        kcp::LockStat* stat = nullptr;
+
+        bool TryTake() {
+            uint32_t expected = 0;
+            return __atomic_compare_exchange_n(&state, &expected, 1, false,
+                                               __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+        }
+
+    public:
+        constexpr SleepLock() = default;
+        constexpr explicit SleepLock(kcp::LockStat* s) : stat(s) {}
+
+        void Acquire() {
+            if (TryTake()) {
+                if (stat != nullptr) stat->Acquired(0, false);
+                return;
+            }
+            uint64_t start = (stat != nullptr) ? Hal::ReadTsc() : 0;
+            for (int i = 0; i < SpinCount; i++) {
+                asm volatile("pause");
+                if (TryTake()) {
+                    if (stat != nullptr) stat->Acquired(start, true);
+                    return;
+                }
+            }
+            while (__atomic_exchange_n(&state, 2, __ATOMIC_ACQUIRE) != 0) {
+                WaitOnAddress(&state, 2);
+            }
+            if (stat != nullptr) stat->Acquired(start, true);
+        }
+
+        // Take the lock only if it is free, without spinning or sleeping
+        bool TryAcquire() {
+            if (!TryTake()) return false;
+            if (stat != nullptr) stat->Acquired(0, false);
+            return true;
+        }
+
+        void Release() {
+            if (stat != nullptr) stat->Released();
+            if (__atomic_exchange_n(&state, 0, __ATOMIC_RELEASE) == 2) WakeAddress(&state, 1);
+        }
+    };
+};
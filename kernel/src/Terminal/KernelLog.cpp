@@ -0,0 +1,326 @@
+/*
+    * KernelLog.cpp
+    * Per-CPU kernel log rings
+    * Copyright (c) 2026 Daniel Hammer
+*/
+
+#include "Terminal.hpp"
+#include <Hal/Cpu.hpp>
+#include <Hal/SmpBoot.hpp>
+#include <Memory/Heap.hpp>
+#include <Timekeeping/ApicTimer.hpp>
+#include <Libraries/Memory.hpp>
+
+namespace Kt {
+
+    static_assert(LogCpus == Smp::MaxCPUs, "log cursor must cover every CPU");
+
+    static constexpr int ComponentLen = 19;
+
+    // One message. `seq` is a per-slot seqlock: odd while the owning CPU
+    // rewrites the slot, 2 * (ordinal + 1) once record `ordinal` is in it.
+    struct LogRecord {
+        uint64_t seq;
+        uint64_t tsc;
+        uint8_t  level;
+        uint8_t  cpu;
+        uint16_t length;
+        char     component[ComponentLen + 1];
+        char     text[LogLine::Capacity];
+    };
+
+    // Written only by its own CPU with interrupts off; `head` counts every
+    // record ever stored, so record n sits in slot n % capacity.
+    struct LogRing {
+        uint64_t head;
+        uint64_t drawn;         // records already on the console
+        uint32_t capacity;      // power of two
+        LogRecord* records;
+    };
+
+    // CPU 0 logs all of early boot, so its ring is static and as large as
+    // the old shared buffer. APs get smaller ones from the heap.
+    static constexpr uint32_t BootRingRecords = 256;
+    static constexpr uint32_t ApRingRecords = 64;
+
+    static LogRecord g_bootRecords[BootRingRecords];
+    static LogRing g_bootRing = {0, 0, BootRingRecords, g_bootRecords};
+    static LogRing* g_rings[LogCpus] = {&g_bootRing};
+
+    void AttachLogRing(int cpu) {
+        if (cpu <= 0 || cpu >= LogCpus || g_rings[cpu]) return;
+
+        auto* ring = (LogRing*)Memory::g_heap->Request(sizeof(LogRing));
+        auto* records = (LogRecord*)Memory::g_heap->Request(ApRingRecords * sizeof(LogRecord));
+        if (ring == nullptr || records == nullptr) {
+            if (ring) Memory::g_heap->Free(ring);
+            if (records) Memory::g_heap->Free(records);
+            return;
+        }
+        memset(records, 0, ApRingRecords * sizeof(LogRecord));
+        ring->head = 0;
+        ring->drawn = 0;
+        ring->capacity = ApRingRecords;
+        ring->records = records;
+        __atomic_store_n(&g_rings[cpu], ring, __ATOMIC_RELEASE);
+    }
+
+    const char* LogLevelName(KernelLogLevel level) {
+        switch (level) {
+            case INFO:    return "INFO";
+            case WARNING: return "WARNING";
+            case ERROR:   return "ERROR";
+            case DEBUG:   return "DEBUG";
+            case OK:      return "OK";
+            default:      return "UNKNOWN";
+        }
+    }
+
+    // ================================================================
+    // Reading: merge the rings by timestamp
+    // ================================================================
+
+    static LogRing* Ring(int cpu) {
+        return __atomic_load_n(&g_rings[cpu], __ATOMIC_ACQUIRE);
+    }
+
+    // Copy record `ordinal` of a ring. False if the writer has reused
+    // the slot (or is reusing it) since.
+    static bool CopyRecord(LogRing* ring, uint64_t ordinal, LogRecord& out) {
+        const LogRecord& slot = ring->records[ordinal & (ring->capacity - 1)];
+        uint64_t want = 2 * (ordinal + 1);
+
+        if (__atomic_load_n(&slot.seq, __ATOMIC_ACQUIRE) != want) return false;
+        memcpy(&out, (const void*)&slot, sizeof(LogRecord));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&slot.seq, __ATOMIC_RELAXED) != want) return false;
+
+        if (out.length > LogLine::Capacity) out.length = LogLine::Capacity;
+        return true;
+    }
+
+    // The oldest record past `next` in any ring. Records a writer has
+    // already overwritten are skipped. Advances nothing; the caller
+    // moves next[*cpu] past the record when it consumes it.
+    static bool PeekOldest(uint64_t* next, LogRecord& out, int& outCpu) {
+        bool found = false;
+        LogRecord candidate;
+
+        for (int cpu = 0; cpu < LogCpus; cpu++) {
+            LogRing* ring = Ring(cpu);
+            if (ring == nullptr) continue;
+
+            uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+            if (head > ring->capacity && next[cpu] < head - ring->capacity) {
+                next[cpu] = head - ring->capacity;
+            }
+
+            while (next[cpu] < head && !CopyRecord(ring, next[cpu], candidate)) {
+                next[cpu]++;
+            }
+            if (next[cpu] >= head) continue;
+
+            if (!found || candidate.tsc < out.tsc) {
+                out = candidate;
+                outCpu = cpu;
+                found = true;
+            }
+        }
+        return found;
+    }
+
+    // ================================================================
+    // Console
+    // ================================================================
+
+    static bool Pending() {
+        for (int cpu = 0; cpu < LogCpus; cpu++) {
+            LogRing* ring = Ring(cpu);
+            if (ring && ring->drawn != __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE)) return true;
+        }
+        return false;
+    }
+
+    // Called with g_termLock held
+    static void DrawPending() {
+        uint64_t next[LogCpus];
+        for (int cpu = 0; cpu < LogCpus; cpu++) {
+            LogRing* ring = Ring(cpu);
+            next[cpu] = ring ? ring->drawn : 0;
+        }
+
+        LogRecord rec;
+        int cpu;
+        while (PeekOldest(next, rec, cpu)) {
+            next[cpu]++;
+
+            Write(rec.component, Lib::strlen(rec.component));
+            Write(": [", 3);
+            const char* level = KernelLogStream::LogLevelToStringWithColor((KernelLogLevel)rec.level);
+            Write(level, Lib::strlen(level));
+            Write("] ", 2);
+            Write(rec.text, rec.length);
+            Write(newline, 2);
+        }
+
+        for (int c = 0; c < LogCpus; c++) {
+            LogRing* ring = Ring(c);
+            if (ring) ring->drawn = next[c];
+        }
+    }
+
+    // Whoever gets the terminal draws every pending record; everyone else
+    // returns at once. The holder looks again after letting go so that a
+    // record committed while it was drawing is not left behind.
+    static void DrainConsole() {
+        while (g_termLock.TryAcquire()) {
+            DrawPending();
+            g_termLock.Release();
+            __atomic_thread_fence(__ATOMIC_SEQ_CST);
+            if (!Pending()) return;
+        }
+    }
+
+    // ================================================================
+    // Writing
+    // ================================================================
+
+    void CommitLog(KernelLogLevel level, const char* component, const char* text, uint16_t length) {
+        if (length > LogLine::Capacity) length = LogLine::Capacity;
+
+        // Interrupts off so a handler logging on this CPU cannot
+        // interleave with the slot being written
+        uint64_t flags;
+        asm volatile("pushfq; pop %0; cli" : "=r"(flags) :: "memory");
+
+        int cpu = Smp::CurrentCpuIndex();
+        LogRing* ring = (cpu >= 0 && cpu < LogCpus) ? g_rings[cpu] : nullptr;
+
+        if (ring) {
+            uint64_t ordinal = ring->head;
+            LogRecord& slot = ring->records[ordinal & (ring->capacity - 1)];
+
+            __atomic_store_n(&slot.seq, 2 * ordinal + 1, __ATOMIC_RELAXED);
+            __atomic_thread_fence(__ATOMIC_RELEASE);
+
+            slot.tsc = Hal::ReadTsc();
+            slot.level = (uint8_t)level;
+            slot.cpu = (uint8_t)cpu;
+            slot.length = length;
+            int i = 0;
+            for (; i < ComponentLen && component[i]; i++) slot.component[i] = component[i];
+            slot.component[i] = '\0';
+            memcpy(slot.text, text, length);
+
+            __atomic_store_n(&slot.seq, 2 * (ordinal + 1), __ATOMIC_RELEASE);
+            __atomic_store_n(&ring->head, ordinal + 1, __ATOMIC_RELEASE);
+        }
+
+        asm volatile("push %0; popfq" :: "r"(flags) : "memory");
+
+        if (ring) {
+            DrainConsole();
+        } else if (g_termLock.TryAcquire()) {
+            // No ring for this CPU (out of memory): draw it directly
+            Write(component, Lib::strlen(component));
+            Write(": [", 3);
+            const char* name = KernelLogStream::LogLevelToStringWithColor(level);
+            Write(name, Lib::strlen(name));
+            Write("] ", 2);
+            Write(text, length);
+            Write(newline, 2);
+            g_termLock.Release();
+        }
+    }
+
+    // ================================================================
+    // SYS_KLOG
+    // ================================================================
+
+    static char* AppendText(char* out, const char* text, uint64_t length) {
+        for (uint64_t i = 0; i < length; i++) *out++ = text[i];
+        return out;
+    }
+
+    // "[    12.345678] Component: [LEVEL] text\r\n" with ANSI escapes
+    // removed from the text. Returns the length; writes only if `out`.
+    static uint64_t FormatRecord(const LogRecord& rec, char* out) {
+        char line[32 + ComponentLen + 16 + LogLine::Capacity];
+        char* p = line;
+
+        uint64_t us = Timekeeping::TscToMicroseconds(rec.tsc);
+        char stamp[24];
+        uint64_t secs = us / 1000000;
+        uint64_t frac = us % 1000000;
+        int n = 0;
+        do { stamp[n++] = (char)('0' + secs % 10); secs /= 10; } while (secs && n < 12);
+        *p++ = '[';
+        for (int pad = n; pad < 5; pad++) *p++ = ' ';
+        while (n > 0) *p++ = stamp[--n];
+        *p++ = '.';
+        for (int d = 100000; d > 0; d /= 10) *p++ = (char)('0' + (frac / d) % 10);
+        *p++ = ']';
+        *p++ = ' ';
+
+        p = AppendText(p, rec.component, Lib::strlen(rec.component));
+        p = AppendText(p, ": [", 3);
+        const char* level = LogLevelName((KernelLogLevel)rec.level);
+        p = AppendText(p, level, Lib::strlen(level));
+        p = AppendText(p, "] ", 2);
+
+        bool escape = false;
+        for (uint16_t i = 0; i < rec.length; i++) {
+            char c = rec.text[i];
+            if (c == '\033') { escape = true; continue; }
+            if (escape) { if (c == 'm') escape = false; continue; }
+            *p++ = c;
+        }
+        p = AppendText(p, newline, 2);
+
+        uint64_t length = (uint64_t)(p - line);
+        if (out) memcpy(out, line, length);
+        return length;
+    }
+
+    int64_t ReadKernelLog(char* buf, uint64_t size, uint64_t* cursor) {
+        if (buf == nullptr || size == 0) return 0;
+
+        uint64_t next[LogCpus];
+        LogRecord rec;
+        int cpu;
+
+        if (cursor) {
+            for (int c = 0; c < LogCpus; c++) next[c] = cursor[c];
+        } else {
+            // Measure everything kept, then drop the oldest lines until
+            // the rest fits
+            for (int c = 0; c < LogCpus; c++) next[c] = 0;
+            uint64_t total = 0;
+            while (PeekOldest(next, rec, cpu)) {
+                next[cpu]++;
+                total += FormatRecord(rec, nullptr);
+            }
+
+            for (int c = 0; c < LogCpus; c++) next[c] = 0;
+            while (total > size && PeekOldest(next, rec, cpu)) {
+                next[cpu]++;
+                total -= FormatRecord(rec, nullptr);
+            }
+        }
+
+        uint64_t written = 0;
+        while (PeekOldest(next, rec, cpu)) {
+            uint64_t length = FormatRecord(rec, nullptr);
+            if (written + length > size) break;
+            FormatRecord(rec, buf + written);
+            written += length;
+            next[cpu]++;
+        }
+
+        if (cursor) {
+            for (int c = 0; c < LogCpus; c++) cursor[c] = next[c];
+        }
+        return (int64_t)written;
+    }
+
+};
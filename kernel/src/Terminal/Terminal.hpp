@@ -43,9 +43,12 @@ namespace Kt
     void Putchar(char c);
     void Print(const char *text);
 
-    // Terminal mutex - protects flanterm from concurrent CPU access.
-    // Uses Mutex (not Spinlock) to keep interrupts enabled while held,
-    // preventing dropped PS/2 mouse/keyboard bytes during log output.
+    // Write raw bytes to the console (dropped once the GUI owns the screen)
+    void Write(const char *text, std::size_t length);
+
+    // Terminal mutex - held while kernel log records are drawn. Only ever
+    // try-acquired: whoever holds it draws everything pending, so loggers
+    // never wait on the framebuffer.
     extern kcp::Mutex g_termLock;
 
     void UpdatePanelBar(const char* panelText);
@@ -59,42 +62,69 @@ namespace Kt
         return (base)custom;
     }
 
+    // Text of one log message while a KernelLogStream formats it.
+    // Anything past the capacity is cut off.
+    struct LogLine {
+        static constexpr std::uint16_t Capacity = 216;
+
+        char text[Capacity];
+        std::uint16_t length = 0;
+
+        void Append(char c) {
+            if (length < Capacity) text[length++] = c;
+        }
+
+        void Append(const char *string) {
+            while (*string && length < Capacity) text[length++] = *string++;
+        }
+    };
+
     class KernelOutStream
     {
     public:
         base streamBaseType = base::dec;
 
+        // When set, output goes into this line instead of the console
+        LogLine *line = nullptr;
+
+        void Emit(const char *string)
+        {
+            if (line) line->Append(string);
+            else Print(string);
+        }
+
         // C++ streaming operator like cout
         friend KernelOutStream &operator<<(KernelOutStream &t, const char *string)
         {
-            Print(string);
+            t.Emit(string);
             return t;
         }
 
         // C++ streaming operator like cout
         friend KernelOutStream &operator<<(KernelOutStream &t, const char chr)
         {
-            Putchar(chr);
+            if (t.line) t.line->Append(chr);
+            else Putchar(chr);
             return t;
         }
 
         friend KernelOutStream &operator<<(KernelOutStream &t, int number)
         {
-            Print(Lib::int2basestr(number, t.streamBaseType));
+            t.Emit(Lib::int2basestr(number, t.streamBaseType));
 
             return t;
         }
 
         friend KernelOutStream &operator<<(KernelOutStream &t, std::uint32_t number)
         {
-            Print(Lib::uint2basestr(number, t.streamBaseType));
+            t.Emit(Lib::uint2basestr(number, t.streamBaseType));
 
             return t;
         }
 
         friend KernelOutStream &operator<<(KernelOutStream &t, std::uint64_t number)
         {
-            Print(Lib::u64_2_basestr(number, t.streamBaseType));
+            t.Emit(Lib::u64_2_basestr(number, t.streamBaseType));
 
             return t;
         }
@@ -115,19 +145,39 @@ namespace Kt
         OK
     };
 
-    extern uint32_t g_kernelLogDepth;
     extern bool g_suppressKernelLog;
 
     void SuppressKernelLog();
-    int64_t ReadKernelLog(char* buf, uint64_t size);
+
+    // Kernel log records live in one ring per CPU that only that CPU
+    // writes, so logging never takes a shared lock. Readers merge the
+    // rings by timestamp. See KernelLog.cpp.
+    constexpr int LogCpus = 64;
+
+    // Store a finished message in this CPU's ring and draw it on the
+    // console, or leave it to the CPU that is drawing already.
+    void CommitLog(KernelLogLevel level, const char* component, const char* text, std::uint16_t length);
+
+    // Give an AP its own ring before it starts (CPU 0 has a static one)
+    void AttachLogRing(int cpu);
+
+    // Log records as text lines, oldest first. Without a cursor: as many
+    // of the newest lines as fit. With one (LogCpus entries, zero to start
+    // from the oldest record kept): only records after it, advancing it
+    // past those returned.
+    int64_t ReadKernelLog(char* buf, uint64_t size, uint64_t* cursor);
+
+    const char* LogLevelName(KernelLogLevel level);
 
     class KernelLogStream {
         KernelOutStream localStream{};
+        LogLine line;
+        KernelLogLevel logLevel;
 
         const char* componentName = "";
 
 public:
-        const char* LogLevelToStringWithColor(KernelLogLevel level) {
+        static const char* LogLevelToStringWithColor(KernelLogLevel level) {
             switch (level) {
                 case INFO:
                     return "\e[0;36mINFO\e[0m"; // Cyan
@@ -145,17 +195,13 @@ public:
         }
 
         KernelLogStream(KernelLogLevel level, const char* desiredComponentName) {
-            g_termLock.Acquire();
-            g_kernelLogDepth++;
+            logLevel = level;
             componentName = desiredComponentName;
-
-            localStream << componentName << ": " << "[" << LogLevelToStringWithColor(level) << "] ";
+            localStream.line = &line;
         }
 
         ~KernelLogStream() {
-            localStream << newline;
-            g_kernelLogDepth--;
-            g_termLock.Release();
+            CommitLog(logLevel, componentName, line.text, line.length);
         }
 
         template<typename T>
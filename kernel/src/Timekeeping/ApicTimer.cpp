@@ -1,6 +1,6 @@
 /*
     * ApicTimer.cpp
-    * Local APIC timer: PIT-calibrated periodic tick for timekeeping
+    * Local APIC timer: PIT-calibrated tick and TSC clock for timekeeping
     * Copyright (c) 2025 Daniel Hammer
 */
 
@@ -9,11 +9,17 @@
 #include <Hal/Apic/Apic.hpp>
 #include <Hal/Apic/Interrupts.hpp>
 #include <Hal/SmpBoot.hpp>
+#include <Hal/Cpu.hpp>
 #include <Io/IoPort.hpp>
 #include <Terminal/Terminal.hpp>
 #include <CppLib/Stream.hpp>
 #include <Sched/Scheduler.hpp>
+#include <Memory/PageFrameAllocator.hpp>
+#include <Memory/HHDM.hpp>
+#include <Api/Syscall.hpp>
 #include <Drivers/Net/E1000E.hpp>
+#include <Net/Loopback.hpp>
+#include <Net/Arp.hpp>
 #include <Drivers/USB/Xhci.hpp>
 #include <Drivers/USB/HidKeyboard.hpp>
 
@@ -40,17 +46,56 @@ namespace Timekeeping {
     static std::atomic<uint64_t> g_tickCount{0};
     static uint32_t g_ticksPerMs = 0;
 
+    // TSC clock (one-shot mode only). GetMicroseconds() =
+    // g_usOffset + (TSC - g_tscBase) / g_tscPerUs. The offset carries the
+    // clock across S3, where the TSC restarts from zero.
+    static bool g_oneShot = false;
+    static uint64_t g_tscPerUs = 0;
+    static uint64_t g_tscBase = 0;
+    static uint64_t g_usOffset = 0;
+    static volatile uint64_t g_lastUs = 0;
+
     static bool g_schedEnabled = false;
 
+    // Clock page shared read-only with every process (Montauk::TimePage)
+    static Montauk::TimePage* g_timePage = nullptr;
+
+    // Copy the TSC clock parameters to the clock page, under its seqlock
+    static void PublishTimePage() {
+        if (g_timePage == nullptr) return;
+        g_timePage->seq = g_timePage->seq + 1;
+        asm volatile("" ::: "memory");
+        g_timePage->flags = g_oneShot ? Montauk::TIME_PAGE_TSC : 0;
+        g_timePage->tscPerUs = g_tscPerUs;
+        g_timePage->tscBase = g_tscBase;
+        g_timePage->usOffset = g_usOffset;
+        asm volatile("" ::: "memory");
+        g_timePage->seq = g_timePage->seq + 1;
+    }
+
+    static uint32_t TimerLvt() {
+        uint32_t lvt = Hal::IRQ_VECTOR_BASE + Hal::IRQ_TIMER;
+        return g_oneShot ? lvt : (lvt | LVT_PERIODIC);
+    }
+
     // Timer IRQ handler: BSP handles timekeeping+polling, all CPUs run scheduler
     static void TimerHandler(uint8_t) {
         auto* cpu = Smp::GetCurrentCpuData();
 
         if (cpu->cpuIndex == 0) {
-            // BSP: increment global tick count and poll devices
-            g_tickCount.fetch_add(1, std::memory_order_relaxed);
+            // BSP: advance the clock and poll devices. In one-shot mode the
+            // BSP keeps a 1 ms housekeeping tick for the polled drivers.
+            if (g_oneShot) {
+                g_lastUs = GetMicroseconds();
+                ArmTimer(g_lastUs + 1000);
+            } else {
+                uint64_t ticks = g_tickCount.fetch_add(1, std::memory_order_relaxed) + 1;
+                if (g_timePage != nullptr) g_timePage->ms = ticks;
+            }
 
             Drivers::Net::E1000E::Poll();
+            ::Net::Loopback::Poll();
+            ::Net::Arp::Tick();
             Drivers::USB::Xhci::ProcessDeferredWork();
             Drivers::USB::HidKeyboard::Tick();
         }
@@ -60,6 +105,14 @@ namespace Timekeeping {
         }
     }
 
+    // Reschedule IPI: another CPU queued work for this (possibly tickless
+    // idle) CPU. Tick() picks it up.
+    static void RescheduleHandler(uint8_t) {
+        if (g_schedEnabled) {
+            Sched::Tick();
+        }
+    }
+
     // Use PIT channel 2 to create a precise delay for calibration.
     // Returns the number of APIC timer ticks that elapsed during ~10ms.
     static uint32_t CalibratePit() {
@@ -87,6 +140,7 @@ namespace Timekeeping {
         Hal::LocalApic::WriteRegister(Hal::LocalApic::REG_TIMER_DIVIDE, DIVIDE_BY_16);
         Hal::LocalApic::WriteRegister(Hal::LocalApic::REG_TIMER_LVT, LVT_MASKED);
         Hal::LocalApic::WriteRegister(Hal::LocalApic::REG_TIMER_INITIAL, 0xFFFFFFFF);
+        uint64_t tscStart = Hal::ReadTsc();
 
         // Enable PIT channel 2 gate to start counting
         gate = Io::In8(PIT_GATE_PORT);
@@ -98,9 +152,11 @@ namespace Timekeeping {
             asm volatile("pause");
         }
 
-        // Read how many APIC timer ticks elapsed
+        // Read how many APIC timer ticks elapsed, and calibrate the TSC
+        // over the same window
         uint32_t currentCount = Hal::LocalApic::ReadRegister(Hal::LocalApic::REG_TIMER_CURRENT);
         uint32_t elapsed = 0xFFFFFFFF - currentCount;
+        g_tscPerUs = (Hal::ReadTsc() - tscStart) / 10000;
 
         // Stop the APIC timer
         Hal::LocalApic::WriteRegister(Hal::LocalApic::REG_TIMER_INITIAL, 0);
@@ -111,6 +167,9 @@ namespace Timekeeping {
     void ApicTimerInitialize() {
         KernelLogStream(INFO, "Timer") << "Calibrating APIC timer using PIT channel 2";
 
+        void* page = Memory::g_pfa->AllocateZeroed();
+        if (page != nullptr) g_timePage = (Montauk::TimePage*)page;
+
         // Calibrate: measure APIC ticks over ~10ms
         uint32_t ticksIn10ms = CalibratePit();
         g_ticksPerMs = ticksIn10ms / 10;
@@ -125,20 +184,30 @@ namespace Timekeeping {
         KernelLogStream(OK, "Timer") << "APIC timer: " << base::dec << (uint64_t)g_ticksPerMs
             << " ticks/ms (" << timerFreqHz << " Hz, divide-by-16)";
 
+        // One-shot deadlines need a clock that keeps running between
+        // interrupts; only trust the TSC if it is invariant.
+        if (Hal::HasInvariantTsc() && g_tscPerUs != 0) {
+            g_oneShot = true;
+            g_tscBase = Hal::ReadTsc();
+            KernelLogStream(OK, "Timer") << "Invariant TSC: " << base::dec << g_tscPerUs
+                << " cycles/us, using one-shot timer";
+        }
+        PublishTimePage();
+
         // Register IRQ handler for timer (IRQ 0 = vector 32)
         Hal::RegisterIrqHandler(Hal::IRQ_TIMER, TimerHandler);
+        Hal::RegisterIrqHandler(Hal::IRQ_RESCHEDULE, RescheduleHandler);
 
-        // Configure APIC timer: periodic mode, vector 32
-        uint32_t lvt = (Hal::IRQ_VECTOR_BASE + Hal::IRQ_TIMER) | LVT_PERIODIC;
+        // Configure APIC timer: vector 32, periodic or one-shot
         Hal::LocalApic::WriteRegister(Hal::LocalApic::REG_TIMER_DIVIDE, DIVIDE_BY_16);
-        Hal::LocalApic::WriteRegister(Hal::LocalApic::REG_TIMER_LVT, lvt);
+        Hal::LocalApic::WriteRegister(Hal::LocalApic::REG_TIMER_LVT, TimerLvt());
 
-        // Set initial count for 1ms intervals (1000 Hz tick rate)
+        // First interrupt after 1ms (periodic: every 1ms, 1000 Hz tick rate)
         uint32_t initialCount = g_ticksPerMs;
         Hal::LocalApic::WriteRegister(Hal::LocalApic::REG_TIMER_INITIAL, initialCount);
 
         KernelLogStream(OK, "Timer") << "APIC timer started: " << base::dec << (uint64_t)TIMER_HZ
-            << " Hz periodic, initial count=" << (uint64_t)initialCount;
+            << (g_oneShot ? " Hz one-shot" : " Hz periodic") << ", initial count=" << (uint64_t)initialCount;
     }
 
     void ApicTimerReinitialize() {
@@ -150,22 +219,62 @@ namespace Timekeeping {
         // Reprogram the APIC timer registers (they were lost during S3).
         // The calibrated g_ticksPerMs value is still valid (it's in RAM).
         // The IRQ handler registration also survives (it's a function pointer array in RAM).
-        uint32_t lvt = (Hal::IRQ_VECTOR_BASE + Hal::IRQ_TIMER) | LVT_PERIODIC;
+        // The TSC restarted from zero: continue the clock from the last BSP tick.
+        if (g_oneShot) {
+            g_usOffset = g_lastUs + 1000;
+            g_tscBase = Hal::ReadTsc();
+            PublishTimePage();
+        }
         Hal::LocalApic::WriteRegister(Hal::LocalApic::REG_TIMER_DIVIDE, DIVIDE_BY_16);
-        Hal::LocalApic::WriteRegister(Hal::LocalApic::REG_TIMER_LVT, lvt);
+        Hal::LocalApic::WriteRegister(Hal::LocalApic::REG_TIMER_LVT, TimerLvt());
         Hal::LocalApic::WriteRegister(Hal::LocalApic::REG_TIMER_INITIAL, g_ticksPerMs);
 
         KernelLogStream(OK, "Timer") << "APIC timer restarted after S3 resume";
     }
 
     uint64_t GetTicks() {
+        if (g_oneShot) return GetMicroseconds() / 1000;  // Still 1 tick = 1 ms
         return g_tickCount.load(std::memory_order_relaxed);
     }
 
     uint64_t GetMilliseconds() {
+        if (g_oneShot) return GetMicroseconds() / 1000;
         return g_tickCount.load(std::memory_order_relaxed);  // 1 tick = 1 ms at 1000 Hz
     }
 
+    uint64_t GetMicroseconds() {
+        if (!g_oneShot) return g_tickCount.load(std::memory_order_relaxed) * 1000;
+        return g_usOffset + (Hal::ReadTsc() - g_tscBase) / g_tscPerUs;
+    }
+
+    uint64_t TscToMicroseconds(uint64_t cycles) {
+        return (g_tscPerUs != 0) ? cycles / g_tscPerUs : 0;
+    }
+
+    uint64_t TscPerMicrosecond() {
+        return g_tscPerUs;
+    }
+
+    uint64_t TimePagePhys() {
+        return (g_timePage != nullptr) ? Memory::SubHHDM((uint64_t)g_timePage) : 0;
+    }
+
+    void ArmTimer(uint64_t deadlineUs) {
+        if (!g_oneShot) return;
+
+        uint64_t now = GetMicroseconds();
+        uint64_t deltaUs = (deadlineUs > now) ? deadlineUs - now : 0;
+        uint64_t count = deltaUs * g_ticksPerMs / 1000;
+        if (count == 0) count = 1;
+        if (count > 0xFFFFFFFF) count = 0xFFFFFFFF;
+
+        // A running countdown that expires sooner already covers this deadline
+        uint32_t current = Hal::LocalApic::ReadRegister(Hal::LocalApic::REG_TIMER_CURRENT);
+        if (current != 0 && current <= count) return;
+
+        Hal::LocalApic::WriteRegister(Hal::LocalApic::REG_TIMER_INITIAL, (uint32_t)count);
+    }
+
     void EnableSchedulerTick() {
         g_schedEnabled = true;
     }
@@ -176,10 +285,10 @@ namespace Timekeeping {
         // identical. This avoids PIT contention during AP boot.
         if (g_ticksPerMs == 0) return;
 
-        // Configure periodic timer at 1000 Hz (same vector as BSP)
-        uint32_t lvt = (Hal::IRQ_VECTOR_BASE + Hal::IRQ_TIMER) | LVT_PERIODIC;
+        // Same mode and vector as the BSP. In one-shot mode this is the only
+        // tick an idle AP gets until the scheduler gives it a deadline.
         Hal::LocalApic::WriteRegister(Hal::LocalApic::REG_TIMER_DIVIDE, DIVIDE_BY_16);
-        Hal::LocalApic::WriteRegister(Hal::LocalApic::REG_TIMER_LVT, lvt);
+        Hal::LocalApic::WriteRegister(Hal::LocalApic::REG_TIMER_LVT, TimerLvt());
         Hal::LocalApic::WriteRegister(Hal::LocalApic::REG_TIMER_INITIAL, g_ticksPerMs);
     }
 
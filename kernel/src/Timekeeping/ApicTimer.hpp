@@ -1,6 +1,6 @@
 /*
     * ApicTimer.hpp
-    * Local APIC timer for periodic tick interrupts and timekeeping
+    * Local APIC timer for tick interrupts and timekeeping
     * Copyright (c) 2025 Daniel Hammer
 */
 
@@ -8,7 +8,10 @@
 #include <cstdint>
 
 namespace Timekeeping {
-    // Initialize the APIC timer: calibrate against PIT, start periodic interrupts
+    // Initialize the APIC timer: calibrate against PIT, start tick interrupts.
+    // With an invariant TSC the timer runs one-shot: the BSP re-arms it
+    // every millisecond for device polling, other CPUs only when they have
+    // a deadline (tickless idle). Without one it stays periodic at 1000 Hz.
     void ApicTimerInitialize();
 
     // Initialize the APIC timer on an AP (calibrate + start, no IRQ handler registration)
@@ -25,6 +28,26 @@ namespace Timekeeping {
     // Get elapsed milliseconds since timer initialization
     uint64_t GetMilliseconds();
 
+    // Get elapsed microseconds since timer initialization (TSC-based when
+    // available, otherwise tick resolution)
+    uint64_t GetMicroseconds();
+
+    // Convert a TSC cycle count to microseconds using the calibrated TSC
+    // rate (0 if the TSC could not be calibrated)
+    uint64_t TscToMicroseconds(uint64_t cycles);
+
+    // Calibrated TSC cycles per microsecond (0 if not calibrated)
+    uint64_t TscPerMicrosecond();
+
+    // Physical address of the clock page (Montauk::TimePage) that every
+    // process maps read-only, or 0 if there is none
+    uint64_t TimePagePhys();
+
+    // Make sure this CPU's timer fires no later than `deadlineUs`
+    // (GetMicroseconds() time base). Never pushes an earlier expiry back.
+    // No-op in periodic mode. Call with interrupts disabled.
+    void ArmTimer(uint64_t deadlineUs);
+
     // Enable scheduler tick (called after scheduler is initialized)
     void EnableSchedulerTick();
 
@@ -0,0 +1,66 @@
+/*
+    * BootProfile.cpp
+    * TSC-stamped boot phase markers
+    * Copyright (c) 2026 Daniel Hammer
+*/
+
+#include "BootProfile.hpp"
+#include <Hal/Cpu.hpp>
+#include <Hal/SmpBoot.hpp>
+#include <CppLib/Spinlock.hpp>
+
+namespace Timekeeping::BootProfile {
+
+    static Event g_events[MaxEvents];
+    static int g_eventCount = 0;
+    static kcp::Spinlock g_lock;
+
+    static int Record(const char* name, bool point) {
+        uint64_t tsc = Hal::ReadTsc();
+
+        g_lock.Acquire();
+        if (g_eventCount >= MaxEvents) {
+            g_lock.Release();
+            return -1;
+        }
+        int id = g_eventCount++;
+        Event& ev = g_events[id];
+
+        int i = 0;
+        for (; i < MaxNameLen && name[i]; i++) ev.Name[i] = name[i];
+        ev.Name[i] = '\0';
+        ev.StartTsc = tsc;
+        ev.EndTsc = point ? tsc : 0;
+        ev.Cpu = (uint32_t)Smp::CurrentCpuIndex();
+        g_lock.Release();
+        return id;
+    }
+
+    int Begin(const char* name) {
+        return Record(name, false);
+    }
+
+    void End(int id) {
+        if (id < 0 || id >= MaxEvents) return;
+        uint64_t tsc = Hal::ReadTsc();
+        g_lock.Acquire();
+        g_events[id].EndTsc = tsc;
+        g_lock.Release();
+    }
+
+    void Mark(const char* name) {
+        Record(name, true);
+    }
+
+    int Count() {
+        return __atomic_load_n(&g_eventCount, __ATOMIC_ACQUIRE);
+    }
+
+    bool Get(int index, Event& out) {
+        g_lock.Acquire();
+        bool valid = index >= 0 && index < g_eventCount;
+        if (valid) out = g_events[index];
+        g_lock.Release();
+        return valid;
+    }
+}
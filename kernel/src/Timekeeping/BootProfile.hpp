@@ -0,0 +1,33 @@
+/*
+    * BootProfile.hpp
+    * TSC-stamped boot phase markers
+    * Copyright (c) 2026 Daniel Hammer
+*/
+
+#pragma once
+#include <cstdint>
+
+namespace Timekeeping::BootProfile {
+
+    static constexpr int MaxEvents  = 96;
+    static constexpr int MaxNameLen = 31;
+
+    struct Event {
+        char     Name[MaxNameLen + 1];
+        uint64_t StartTsc;
+        uint64_t EndTsc;         // equal to StartTsc for a point marker, 0 while running
+        uint32_t Cpu;
+    };
+
+    // Open a phase on this CPU and return its id for End(), or -1 once the
+    // table is full. Safe from the first instruction of kmain on.
+    int Begin(const char* name);
+    void End(int id);
+
+    // Record a point in time rather than a phase
+    void Mark(const char* name);
+
+    // Events in recording order
+    int Count();
+    bool Get(int index, Event& out);
+}
@@ -117,6 +117,11 @@ void Timekeeping::Init(uint16_t Year, uint8_t Month, uint8_t Day, uint8_t Hour,
     UpdatePanelBar(dateString);
 }
 
+int64_t Timekeeping::DateToUnixTimestamp(uint16_t Year, uint8_t Month, uint8_t Day,
+                                         uint8_t Hour, uint8_t Minute, uint8_t Second) {
+    return DateToEpoch(Year, Month, Day, Hour, Minute, Second);
+}
+
 int64_t Timekeeping::GetUnixTimestamp() {
     return g_bootEpoch + (int64_t)(Timekeeping::GetMilliseconds() / 1000);
 }
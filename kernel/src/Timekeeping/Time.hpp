@@ -52,6 +52,9 @@ namespace Timekeeping {
 
     void Init(uint16_t Year, uint8_t Month, uint8_t Day, uint8_t Hour, uint8_t Minute, uint8_t Second);
     int64_t GetUnixTimestamp();
+    // Seconds since 1970 for a date and time taken as UTC
+    int64_t DateToUnixTimestamp(uint16_t Year, uint8_t Month, uint8_t Day,
+                                uint8_t Hour, uint8_t Minute, uint8_t Second);
     DateTime GetDateTime();
 
     void SetTZOffset(int totalMinutes);
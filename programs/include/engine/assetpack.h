@@ -0,0 +1,34 @@
+/*
+ * assetpack.h
+ * MontaukOS 2D Game Engine - Asset pack format shared by mkpack and the engine
+ * Copyright (c) 2026 Daniel Hammer
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+// mkpack decodes a game's PNG spritesheets at build time into one pack
+// file: each sheet already in the engine's ARGB pixel format, with its
+// frame size. AssetPack (engine/sprite.h) maps the pack read-only and
+// Spritesheets draw straight from the mapping, so a game starts without
+// decoding a single image. Offsets are from the start of the pack and
+// everything is little-endian.
+
+#define ASSET_PACK_MAGIC  "MTKPAK\x00\x01"
+#define ASSET_NAME_MAX    32
+#define ASSET_PIXEL_ALIGN 16
+
+typedef struct {
+    char     magic[8];        // ASSET_PACK_MAGIC
+    uint32_t count;           // AssetPackEntry records after the header
+    uint32_t size;            // whole pack, bytes
+} AssetPackHeader;
+
+typedef struct {
+    char     name[ASSET_NAME_MAX];  // NUL-terminated
+    uint32_t width, height;
+    uint32_t frameW, frameH;        // whole image if the sheet has one frame
+    uint32_t pixelsOff;             // width * height ARGB pixels, aligned
+    uint32_t reserved;
+} AssetPackEntry;
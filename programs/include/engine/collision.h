@@ -1,7 +1,7 @@
 /*
  * collision.h
  * MontaukOS 2D Game Engine - Collision Detection
- * AABB overlap testing and tile-based collision response
+ * AABB overlap testing, spatial hash broadphase and tile-based collision response
  * Copyright (c) 2026 Daniel Hammer
  */
 
@@ -24,6 +24,176 @@ struct AABB {
     }
 };
 
+// ============================================================================
+// Spatial hash broadphase
+// ============================================================================
+
+static constexpr int SPATIAL_MAX_ITEMS = 256;
+static constexpr int SPATIAL_MAX_LINKS = 1024;   // item-in-cell entries
+static constexpr int SPATIAL_BUCKETS   = 256;    // power of two
+
+// Boxes are filed under every grid cell they touch (cells hashed into a
+// fixed bucket table), so a query only looks at items near it. Pick the
+// cell size around the size of a typical entity. Handles returned by
+// insert() stay valid until remove().
+struct SpatialHash {
+    struct Item {
+        AABB box;
+        int user;              // caller's id for the item
+        int cx0, cy0, cx1, cy1;
+        uint32_t stamp;        // last query that reported it
+        bool used;
+    };
+
+    struct Link {
+        int item;
+        int cx, cy;
+        int next;
+    };
+
+    float cell_size = 32.0f;
+    Item items[SPATIAL_MAX_ITEMS];
+    Link links[SPATIAL_MAX_LINKS];
+    int buckets[SPATIAL_BUCKETS];
+    int free_link = -1;
+    uint32_t query_stamp = 0;
+
+    void init(float cell) {
+        cell_size = cell > 1.0f ? cell : 1.0f;
+        for (int i = 0; i < SPATIAL_MAX_ITEMS; i++)
+            items[i].used = false;
+        for (int i = 0; i < SPATIAL_BUCKETS; i++)
+            buckets[i] = -1;
+        for (int i = 0; i < SPATIAL_MAX_LINKS; i++)
+            links[i].next = i + 1 < SPATIAL_MAX_LINKS ? i + 1 : -1;
+        free_link = 0;
+        query_stamp = 0;
+    }
+
+    // Add a box; returns its handle, or -1 if the table is full
+    int insert(const AABB& box, int user) {
+        for (int h = 0; h < SPATIAL_MAX_ITEMS; h++) {
+            if (items[h].used) continue;
+            Item& it = items[h];
+            it.used = true;
+            it.user = user;
+            it.box = box;
+            it.stamp = query_stamp;
+            cell_range(box, it.cx0, it.cy0, it.cx1, it.cy1);
+            link_cells(h);
+            return h;
+        }
+        return -1;
+    }
+
+    // Move a box. Only refiled when it crosses into different cells.
+    void update(int h, const AABB& box) {
+        if (h < 0 || h >= SPATIAL_MAX_ITEMS || !items[h].used) return;
+        Item& it = items[h];
+        it.box = box;
+        int cx0, cy0, cx1, cy1;
+        cell_range(box, cx0, cy0, cx1, cy1);
+        if (cx0 == it.cx0 && cy0 == it.cy0 && cx1 == it.cx1 && cy1 == it.cy1) return;
+        unlink_cells(h);
+        it.cx0 = cx0; it.cy0 = cy0; it.cx1 = cx1; it.cy1 = cy1;
+        link_cells(h);
+    }
+
+    void remove(int h) {
+        if (h < 0 || h >= SPATIAL_MAX_ITEMS || !items[h].used) return;
+        unlink_cells(h);
+        items[h].used = false;
+    }
+
+    // Handles of the items overlapping `box`, each reported once.
+    // Returns how many were written to out (at most max_out).
+    int query(const AABB& box, int* out, int max_out) {
+        int n = 0;
+        uint32_t stamp = ++query_stamp;
+        int cx0, cy0, cx1, cy1;
+        cell_range(box, cx0, cy0, cx1, cy1);
+        for (int cy = cy0; cy <= cy1; cy++) {
+            for (int cx = cx0; cx <= cx1; cx++) {
+                for (int l = buckets[bucket(cx, cy)]; l >= 0; l = links[l].next) {
+                    if (links[l].cx != cx || links[l].cy != cy) continue;
+                    Item& it = items[links[l].item];
+                    if (it.stamp == stamp) continue;
+                    it.stamp = stamp;
+                    if (!it.box.overlaps(box)) continue;
+                    if (n < max_out) out[n] = links[l].item;
+                    n++;
+                }
+            }
+        }
+        return n < max_out ? n : max_out;
+    }
+
+    // True if anything overlaps `box`
+    bool any(const AABB& box) {
+        int h;
+        return query(box, &h, 1) > 0;
+    }
+
+    int user(int h) const { return items[h].user; }
+    const AABB& box(int h) const { return items[h].box; }
+
+    // ---- internals ----
+
+    int cell_of(float v) const {
+        float c = v / cell_size;
+        int i = (int)c;
+        return (c < 0 && (float)i != c) ? i - 1 : i;   // floor
+    }
+
+    void cell_range(const AABB& b, int& cx0, int& cy0, int& cx1, int& cy1) const {
+        cx0 = cell_of(b.x);
+        cy0 = cell_of(b.y);
+        cx1 = cell_of(b.x + b.w);
+        cy1 = cell_of(b.y + b.h);
+    }
+
+    static int bucket(int cx, int cy) {
+        uint32_t h = (uint32_t)cx * 73856093u ^ (uint32_t)cy * 19349663u;
+        return (int)(h & (SPATIAL_BUCKETS - 1));
+    }
+
+    void link_cells(int h) {
+        Item& it = items[h];
+        for (int cy = it.cy0; cy <= it.cy1; cy++) {
+            for (int cx = it.cx0; cx <= it.cx1; cx++) {
+                if (free_link < 0) return;   // out of links: the rest is not findable
+                int l = free_link;
+                free_link = links[l].next;
+                int b = bucket(cx, cy);
+                links[l].item = h;
+                links[l].cx = cx;
+                links[l].cy = cy;
+                links[l].next = buckets[b];
+                buckets[b] = l;
+            }
+        }
+    }
+
+    void unlink_cells(int h) {
+        Item& it = items[h];
+        for (int cy = it.cy0; cy <= it.cy1; cy++) {
+            for (int cx = it.cx0; cx <= it.cx1; cx++) {
+                int* prev = &buckets[bucket(cx, cy)];
+                while (*prev >= 0) {
+                    int l = *prev;
+                    if (links[l].item == h && links[l].cx == cx && links[l].cy == cy) {
+                        *prev = links[l].next;
+                        links[l].next = free_link;
+                        free_link = l;
+                        break;
+                    }
+                    prev = &links[l].next;
+                }
+            }
+        }
+    }
+};
+
 // Try to move an entity by (dx, dy) on the tilemap.
 // Uses separate X/Y axis resolution so the entity slides along walls.
 // box: the entity's collision box in world pixel coordinates.
@@ -11,6 +11,7 @@
 #include <montauk/heap.h>
 #include <montauk/string.h>
 #include <gui/gui.hpp>
+#include <gui/pixelops.hpp>
 #include <gui/truetype.hpp>
 
 extern "C" {
@@ -34,6 +35,15 @@ struct Engine {
     float dt = 0.016f;       // delta time in seconds
     uint64_t frame_count = 0;
 
+    // Fixed-step simulation: update_timing() banks each frame's time and
+    // fixed_step() pays it out in fixed_dt steps, so game logic runs at
+    // the same rate however fast frames are drawn. At most max_steps are
+    // banked; a frame slower than that slows the game down rather than
+    // piling up ever more steps.
+    float fixed_dt = 1.0f / 60.0f;
+    int max_steps = 5;
+    float accumulator = 0.0f;
+
     // Font
     gui::TrueTypeFont* font = nullptr;
 
@@ -74,6 +84,23 @@ struct Engine {
         dt = (float)elapsed / 1000.0f;
         last_time_ms = now;
         frame_count++;
+
+        accumulator += dt;
+        if (accumulator > fixed_dt * max_steps)
+            accumulator = fixed_dt * max_steps;
+    }
+
+    // Take one fixed step of banked time. Loop on it after update_timing():
+    //   while (eng.fixed_step()) simulate(eng.fixed_dt);
+    bool fixed_step() {
+        if (accumulator < fixed_dt) return false;
+        accumulator -= fixed_dt;
+        return true;
+    }
+
+    // How far into the next step the frame is (0..1), for interpolation
+    float step_alpha() const {
+        return accumulator / fixed_dt;
     }
 
     // Poll one window event. Returns true if an event was received.
@@ -103,9 +130,7 @@ struct Engine {
     // ---- Drawing helpers ----
 
     void clear(uint32_t color) {
-        int count = screen_w * screen_h;
-        for (int i = 0; i < count; i++)
-            pixels[i] = color;
+        gui::pixelops::fill(pixels, color, screen_w * screen_h);
     }
 
     void fill_rect(int x, int y, int w, int h, uint32_t color) {
@@ -114,34 +139,19 @@ struct Engine {
         int x1 = x + w > screen_w ? screen_w : x + w;
         int y1 = y + h > screen_h ? screen_h : y + h;
         for (int row = y0; row < y1; row++)
-            for (int col = x0; col < x1; col++)
-                pixels[row * screen_w + col] = color;
+            gui::pixelops::fill(pixels + row * screen_w + x0, color, x1 - x0);
     }
 
     void fill_rect_alpha(int x, int y, int w, int h, uint32_t color) {
-        uint8_t sa = (color >> 24) & 0xFF;
-        uint8_t sr = (color >> 16) & 0xFF;
-        uint8_t sg = (color >> 8) & 0xFF;
-        uint8_t sb = color & 0xFF;
-        if (sa == 0) return;
+        gui::Color c = gui::Color::from_rgba((color >> 16) & 0xFF, (color >> 8) & 0xFF, color & 0xFF,
+                                             (color >> 24) & 0xFF);
+        if (c.a == 0) return;
         int x0 = x < 0 ? 0 : x;
         int y0 = y < 0 ? 0 : y;
         int x1 = x + w > screen_w ? screen_w : x + w;
         int y1 = y + h > screen_h ? screen_h : y + h;
-        for (int row = y0; row < y1; row++) {
-            for (int col = x0; col < x1; col++) {
-                uint32_t dst = pixels[row * screen_w + col];
-                uint8_t dr = (dst >> 16) & 0xFF;
-                uint8_t dg = (dst >> 8) & 0xFF;
-                uint8_t db = dst & 0xFF;
-                uint32_t inv = 255 - sa;
-                uint32_t rr = (sa * sr + inv * dr + 128) / 255;
-                uint32_t gg = (sa * sg + inv * dg + 128) / 255;
-                uint32_t bb = (sa * sb + inv * db + 128) / 255;
-                pixels[row * screen_w + col] =
-                    0xFF000000 | (rr << 16) | (gg << 8) | bb;
-            }
-        }
+        for (int row = y0; row < y1; row++)
+            gui::pixelops::blend(pixels + row * screen_w + x0, x1 - x0, c);
     }
 
     void draw_rect_outline(int x, int y, int w, int h, uint32_t color) {
@@ -0,0 +1,130 @@
+/*
+ * render_queue.h
+ * MontaukOS 2D Game Engine - Render Queue
+ * Sprite draws collected per frame, sorted and blitted in one pass
+ * Copyright (c) 2026 Daniel Hammer
+ */
+
+#pragma once
+#include <cstdint>
+#include "engine/sprite.h"
+
+namespace engine {
+
+static constexpr int MAX_DRAW_CMDS = 512;
+
+struct DrawCmd {
+    const Spritesheet* sheet;
+    int src_x, src_y, src_w, src_h;
+    int dst_x, dst_y;
+    int scale;
+    bool flip_h;
+    uint32_t tint;       // ARGB blended over the drawn rectangle; 0 = none
+    int layer;
+    float sort_y;        // painter's order within a layer (e.g. feet y)
+    int seq;             // submission order, the last tie-break
+};
+
+// Draws are queued with a layer and a sort y, then flush() orders them by
+// layer, then y, then sheet (so runs of the same sheet stay together when
+// the order between them does not matter), culls what is off screen and
+// blits the rest.
+struct RenderQueue {
+    DrawCmd cmds[MAX_DRAW_CMDS];
+    int count = 0;
+
+    void begin() {
+        count = 0;
+    }
+
+    void submit_region(const Spritesheet* sheet,
+                       int src_x, int src_y, int src_w, int src_h,
+                       int dst_x, int dst_y, int scale,
+                       int layer, float sort_y, bool flip_h = false,
+                       uint32_t tint = 0) {
+        if (!sheet || !sheet->pixels || count >= MAX_DRAW_CMDS) return;
+        DrawCmd& c = cmds[count];
+        c.sheet = sheet;
+        c.src_x = src_x;
+        c.src_y = src_y;
+        c.src_w = src_w;
+        c.src_h = src_h;
+        c.dst_x = dst_x;
+        c.dst_y = dst_y;
+        c.scale = scale;
+        c.flip_h = flip_h;
+        c.tint = tint;
+        c.layer = layer;
+        c.sort_y = sort_y;
+        c.seq = count;
+        count++;
+    }
+
+    void submit_frame(const Spritesheet* sheet, int frame_col, int frame_row,
+                      int dst_x, int dst_y, int scale,
+                      int layer, float sort_y, bool flip_h = false,
+                      uint32_t tint = 0) {
+        if (!sheet) return;
+        if (frame_col < 0 || frame_col >= sheet->cols) return;
+        if (frame_row < 0 || frame_row >= sheet->rows) return;
+        submit_region(sheet, frame_col * sheet->frame_w, frame_row * sheet->frame_h,
+                      sheet->frame_w, sheet->frame_h, dst_x, dst_y, scale,
+                      layer, sort_y, flip_h, tint);
+    }
+
+    void submit(const AnimatedSprite& spr, int dst_x, int dst_y, int scale,
+                int layer, float sort_y) {
+        if (spr.current_anim < 0 || spr.current_anim >= spr.anim_count) return;
+        const Animation& a = spr.anims[spr.current_anim];
+        submit_frame(spr.sheet, a.frame_col(), a.frame_row(), dst_x, dst_y, scale,
+                     layer, sort_y, spr.flip_h);
+    }
+
+    static bool before(const DrawCmd& a, const DrawCmd& b) {
+        if (a.layer != b.layer) return a.layer < b.layer;
+        if (a.sort_y != b.sort_y) return a.sort_y < b.sort_y;
+        if (a.sheet != b.sheet) return (uintptr_t)a.sheet < (uintptr_t)b.sheet;
+        return a.seq < b.seq;
+    }
+
+    void flush(uint32_t* dst, int dst_w, int dst_h) {
+        // Insertion sort: the queue is short and mostly in order already
+        for (int i = 1; i < count; i++) {
+            DrawCmd tmp = cmds[i];
+            int j = i - 1;
+            while (j >= 0 && before(tmp, cmds[j])) {
+                cmds[j + 1] = cmds[j];
+                j--;
+            }
+            cmds[j + 1] = tmp;
+        }
+
+        for (int i = 0; i < count; i++) {
+            const DrawCmd& c = cmds[i];
+            int w = c.src_w * c.scale;
+            int h = c.src_h * c.scale;
+            if (c.dst_x >= dst_w || c.dst_y >= dst_h ||
+                c.dst_x + w <= 0 || c.dst_y + h <= 0)
+                continue;
+
+            c.sheet->blit(dst, dst_w, dst_h, c.src_x, c.src_y, c.src_w, c.src_h,
+                          c.dst_x, c.dst_y, c.scale, c.flip_h);
+            if (c.tint) tint_rect(dst, dst_w, dst_h, c.dst_x, c.dst_y, w, h, c.tint);
+        }
+        count = 0;
+    }
+
+    static void tint_rect(uint32_t* dst, int dst_w, int dst_h,
+                          int x, int y, int w, int h, uint32_t argb) {
+        gui::Color c = gui::Color::from_rgba((argb >> 16) & 0xFF, (argb >> 8) & 0xFF,
+                                             argb & 0xFF, (argb >> 24) & 0xFF);
+        int x0 = x < 0 ? 0 : x;
+        int y0 = y < 0 ? 0 : y;
+        int x1 = x + w > dst_w ? dst_w : x + w;
+        int y1 = y + h > dst_h ? dst_h : y + h;
+        for (int row = y0; row < y1; row++)
+            gui::pixelops::blend(dst + row * dst_w + x0, x1 - x0, c);
+    }
+};
+
+} // namespace engine
@@ -1,7 +1,7 @@
 /*
  * sprite.h
  * MontaukOS 2D Game Engine - Sprite and Animation System
- * PNG spritesheet loading, frame extraction, alpha-blended rendering
+ * PNG and asset pack spritesheet loading, frame extraction, alpha-blended rendering
  * Copyright (c) 2026 Daniel Hammer
  */
 
@@ -10,6 +10,7 @@
 #include <montauk/heap.h>
 #include <montauk/string.h>
 #include "engine/engine.h"
+#include "engine/assetpack.h"
 
 extern "C" {
 #include <gui/stb_image.h>
@@ -36,6 +37,50 @@ inline void rgba_to_argb(uint32_t* data, int count) {
     }
 }
 
+// ============================================================================
+// Asset pack - pre-converted spritesheets built by mkpack (see assetpack.h)
+// ============================================================================
+
+struct AssetPack {
+    const uint8_t* base = nullptr;
+    uint32_t size = 0;
+
+    // Map the pack read-only; it stays mapped for the life of the game
+    bool open(const char* vfs_path) {
+        int fh = montauk::open(vfs_path);
+        if (fh < 0) return false;
+        uint64_t fsize = montauk::getsize(fh);
+        montauk::close(fh);
+        if (fsize < sizeof(AssetPackHeader)) return false;
+
+        const uint8_t* blob = (const uint8_t*)montauk::mmap(vfs_path);
+        if (!blob) return false;
+        const AssetPackHeader* h = (const AssetPackHeader*)blob;
+        if (montauk::memcmp(h->magic, ASSET_PACK_MAGIC, sizeof(h->magic)) != 0 || h->size != fsize ||
+            h->count > (fsize - sizeof(AssetPackHeader)) / sizeof(AssetPackEntry)) {
+            montauk::munmap((void*)blob);
+            return false;
+        }
+        base = blob;
+        size = h->size;
+        return true;
+    }
+
+    const AssetPackEntry* find(const char* name) const {
+        if (!base) return nullptr;
+        const AssetPackHeader* h = (const AssetPackHeader*)base;
+        const AssetPackEntry* entries = (const AssetPackEntry*)(base + sizeof(AssetPackHeader));
+        for (uint32_t i = 0; i < h->count; i++) {
+            const AssetPackEntry& e = entries[i];
+            if (montauk::streq(e.name, name) &&
+                e.pixelsOff + (uint64_t)e.width * e.height * 4 <= size) {
+                return &e;
+            }
+        }
+        return nullptr;
+    }
+};
+
 // ============================================================================
 // Spritesheet
 // ============================================================================
@@ -48,6 +93,7 @@ struct Spritesheet {
     int frame_h = 0;
     int cols = 0;
     int rows = 0;
+    bool mapped = false;    // pixels point into an AssetPack
 
     // Load a PNG spritesheet from VFS and split into frames of given size.
     // If frame_w/frame_h are 0, treat the entire image as a single frame.
@@ -75,10 +121,28 @@ struct Spritesheet {
         return true;
     }
 
+    // Take sheet `name` from a pack: no decoding, the pixels are drawn
+    // from the mapping. Frame size as packed unless fw/fh are given.
+    bool load(const AssetPack& pack, const char* name, int fw = 0, int fh = 0) {
+        const AssetPackEntry* e = pack.find(name);
+        if (!e) return false;
+
+        pixels = (uint32_t*)(pack.base + e->pixelsOff);
+        mapped = true;
+        width = (int)e->width;
+        height = (int)e->height;
+        frame_w = fw > 0 ? fw : (int)e->frameW;
+        frame_h = fh > 0 ? fh : (int)e->frameH;
+        cols = width / frame_w;
+        rows = height / frame_h;
+        return true;
+    }
+
     void unload() {
         if (pixels) {
-            stbi_image_free(pixels);
+            if (!mapped) stbi_image_free(pixels);
             pixels = nullptr;
+            mapped = false;
         }
     }
 
@@ -90,96 +154,70 @@ struct Spritesheet {
                     int frame_col, int frame_row,
                     int dst_x, int dst_y, int scale = 1,
                     bool flip_h = false) const {
-        if (!pixels) return;
         if (frame_col < 0 || frame_col >= cols) return;
         if (frame_row < 0 || frame_row >= rows) return;
-
-        int src_ox = frame_col * frame_w;
-        int src_oy = frame_row * frame_h;
-        int out_w = frame_w * scale;
-        int out_h = frame_h * scale;
-
-        for (int py = 0; py < out_h; py++) {
-            int dy = dst_y + py;
-            if (dy < 0 || dy >= dst_h) continue;
-            int sy = src_oy + py / scale;
-
-            for (int px = 0; px < out_w; px++) {
-                int dx = dst_x + px;
-                if (dx < 0 || dx >= dst_w) continue;
-
-                int sx_local = px / scale;
-                if (flip_h) sx_local = frame_w - 1 - sx_local;
-                int sx = src_ox + sx_local;
-
-                uint32_t src_px = pixels[sy * width + sx];
-                uint8_t sa = (src_px >> 24) & 0xFF;
-                if (sa == 0) continue;
-
-                if (sa == 255) {
-                    dst[dy * dst_w + dx] = src_px;
-                } else {
-                    uint32_t d = dst[dy * dst_w + dx];
-                    uint8_t sr = (src_px >> 16) & 0xFF;
-                    uint8_t sg = (src_px >> 8) & 0xFF;
-                    uint8_t sb = src_px & 0xFF;
-                    uint8_t dr = (d >> 16) & 0xFF;
-                    uint8_t dg = (d >> 8) & 0xFF;
-                    uint8_t db = d & 0xFF;
-                    uint32_t inv = 255 - sa;
-                    uint32_t rr = (sa * sr + inv * dr + 128) / 255;
-                    uint32_t gg = (sa * sg + inv * dg + 128) / 255;
-                    uint32_t bb = (sa * sb + inv * db + 128) / 255;
-                    dst[dy * dst_w + dx] =
-                        0xFF000000 | (rr << 16) | (gg << 8) | bb;
-                }
-            }
-        }
+        blit(dst, dst_w, dst_h, frame_col * frame_w, frame_row * frame_h,
+             frame_w, frame_h, dst_x, dst_y, scale, flip_h);
     }
 
     // Draw an arbitrary sub-rectangle of the spritesheet (not frame-aligned)
     void draw_region(uint32_t* dst, int dst_w, int dst_h,
                      int src_x, int src_y, int src_w, int src_h,
                      int dst_x, int dst_y, int scale = 1) const {
-        if (!pixels) return;
-
-        int out_w = src_w * scale;
-        int out_h = src_h * scale;
-
-        for (int py = 0; py < out_h; py++) {
-            int dy = dst_y + py;
-            if (dy < 0 || dy >= dst_h) continue;
-            int sy = src_y + py / scale;
-            if (sy < 0 || sy >= height) continue;
-
-            for (int px = 0; px < out_w; px++) {
-                int dx = dst_x + px;
-                if (dx < 0 || dx >= dst_w) continue;
-                int sx = src_x + px / scale;
-                if (sx < 0 || sx >= width) continue;
-
-                uint32_t src_px = pixels[sy * width + sx];
-                uint8_t sa = (src_px >> 24) & 0xFF;
-                if (sa == 0) continue;
+        blit(dst, dst_w, dst_h, src_x, src_y, src_w, src_h, dst_x, dst_y, scale, false);
+    }
 
-                if (sa == 255) {
-                    dst[dy * dst_w + dx] = src_px;
+    // Widest run of scaled source pixels blended in one go
+    static constexpr int BLIT_SPAN = 256;
+
+    // Blend a source rectangle onto dst. Everything is clipped up front;
+    // then each source row is expanded (scaled, mirrored) into a span once
+    // and blended with pixelops::blend_argb onto the `scale` screen rows
+    // it covers.
+    void blit(uint32_t* dst, int dst_w, int dst_h,
+              int src_x, int src_y, int src_w, int src_h,
+              int dst_x, int dst_y, int scale, bool flip_h) const {
+        if (!pixels || scale < 1) return;
+
+        // Source rectangle to the sheet
+        if (src_x < 0) { dst_x -= src_x * scale; src_w += src_x; src_x = 0; }
+        if (src_y < 0) { dst_y -= src_y * scale; src_h += src_y; src_y = 0; }
+        if (src_x + src_w > width) src_w = width - src_x;
+        if (src_y + src_h > height) src_h = height - src_y;
+        if (src_w <= 0 || src_h <= 0) return;
+
+        // Scaled rectangle to the destination, in output pixels
+        int px0 = dst_x < 0 ? -dst_x : 0;
+        int py0 = dst_y < 0 ? -dst_y : 0;
+        int px1 = src_w * scale;
+        int py1 = src_h * scale;
+        if (dst_x + px1 > dst_w) px1 = dst_w - dst_x;
+        if (dst_y + py1 > dst_h) py1 = dst_h - dst_y;
+        if (px0 >= px1 || py0 >= py1) return;
+
+        uint32_t span[BLIT_SPAN];
+        for (int py = py0; py < py1; ) {
+            int sy = py / scale;
+            int rows_end = (sy + 1) * scale;
+            if (rows_end > py1) rows_end = py1;
+            const uint32_t* src_row = pixels + (src_y + sy) * width + src_x;
+
+            for (int x0 = px0; x0 < px1; x0 += BLIT_SPAN) {
+                int n = px1 - x0 < BLIT_SPAN ? px1 - x0 : BLIT_SPAN;
+                const uint32_t* line;
+                if (scale == 1 && !flip_h) {
+                    line = src_row + x0;
                 } else {
-                    uint32_t d = dst[dy * dst_w + dx];
-                    uint8_t sr = (src_px >> 16) & 0xFF;
-                    uint8_t sg = (src_px >> 8) & 0xFF;
-                    uint8_t sb = src_px & 0xFF;
-                    uint8_t dr = (d >> 16) & 0xFF;
-                    uint8_t dg = (d >> 8) & 0xFF;
-                    uint8_t db = d & 0xFF;
-                    uint32_t inv = 255 - sa;
-                    uint32_t rr = (sa * sr + inv * dr + 128) / 255;
-                    uint32_t gg = (sa * sg + inv * dg + 128) / 255;
-                    uint32_t bb = (sa * sb + inv * db + 128) / 255;
-                    dst[dy * dst_w + dx] =
-                        0xFF000000 | (rr << 16) | (gg << 8) | bb;
+                    for (int i = 0; i < n; i++) {
+                        int sx = (x0 + i) / scale;
+                        span[i] = src_row[flip_h ? src_w - 1 - sx : sx];
+                    }
+                    line = span;
                 }
+                for (int row = py; row < rows_end; row++)
+                    gui::pixelops::blend_argb(dst + (dst_y + row) * dst_w + dst_x + x0, line, n);
             }
+            py = rows_end;
         }
     }
 };
@@ -1,7 +1,7 @@
 /*
  * tilemap.h
  * MontaukOS 2D Game Engine - Tile Map
- * Grid-based terrain with per-tile rendering and collision
+ * Grid-based terrain with cached, pre-composited rendering and collision
  * Copyright (c) 2026 Daniel Hammer
  */
 
@@ -15,11 +15,17 @@ namespace engine {
 
 static constexpr int MAX_TILE_TYPES = 16;
 
+// The map is drawn from CHUNK_TILES x CHUNK_TILES blocks composited once
+// at the render scale; only animated tiles are drawn tile by tile
+static constexpr int CHUNK_TILES = 8;
+
 struct TileType {
     Spritesheet* sheet;   // tile image (may be a single-tile spritesheet)
     int src_x, src_y;     // source position within the sheet
     int src_w, src_h;     // source size (typically tile_size x tile_size)
     bool solid;           // blocks movement
+    int frames;           // animation frames, laid out left to right
+    float fps;
 };
 
 struct Tilemap {
@@ -31,6 +37,15 @@ struct Tilemap {
     TileType types[MAX_TILE_TYPES];
     int type_count = 0;
 
+    // Chunk cache, built for one scale; a null chunk is built when seen
+    uint32_t** chunks = nullptr;
+    int chunk_cols = 0;
+    int chunk_rows = 0;
+    int chunk_scale = 0;
+
+    bool animated = false;   // any animated type registered
+    float anim_time = 0.0f;
+
     bool alloc(int w, int h, int ts = 16) {
         map_w = w;
         map_h = h;
@@ -43,6 +58,16 @@ struct Tilemap {
 
     void free_map() {
         if (data) { montauk::mfree(data); data = nullptr; }
+        free_chunks();
+    }
+
+    void free_chunks() {
+        if (!chunks) return;
+        for (int i = 0; i < chunk_cols * chunk_rows; i++)
+            if (chunks[i]) montauk::mfree(chunks[i]);
+        montauk::mfree(chunks);
+        chunks = nullptr;
+        chunk_scale = 0;
     }
 
     // Register a tile type. Returns the tile ID.
@@ -55,12 +80,40 @@ struct Tilemap {
         types[id].src_w = sw;
         types[id].src_h = sh;
         types[id].solid = solid;
+        types[id].frames = 1;
+        types[id].fps = 0.0f;
         return id;
     }
 
+    // Register an animated tile type: `frames` tiles side by side from
+    // (sx, sy), cycled at `fps`. Returns the tile ID.
+    int add_anim_type(Spritesheet* sheet, int sx, int sy, int sw, int sh,
+                      bool solid, int frames, float fps) {
+        int id = add_type(sheet, sx, sy, sw, sh, solid);
+        if (id < 0 || frames < 2) return id;
+        types[id].frames = frames;
+        types[id].fps = fps;
+        animated = true;
+        return id;
+    }
+
+    void update(float dt) {
+        anim_time += dt;
+    }
+
     void set(int x, int y, int tile_id) {
-        if (x >= 0 && x < map_w && y >= 0 && y < map_h)
+        if (x >= 0 && x < map_w && y >= 0 && y < map_h) {
+            if (data[y * map_w + x] == tile_id) return;
             data[y * map_w + x] = tile_id;
+            invalidate(x, y);
+        }
+    }
+
+    // Drop the cached chunk holding a tile; it is rebuilt when next drawn
+    void invalidate(int x, int y) {
+        if (!chunks) return;
+        uint32_t*& c = chunks[(y / CHUNK_TILES) * chunk_cols + x / CHUNK_TILES];
+        if (c) { montauk::mfree(c); c = nullptr; }
     }
 
     int get(int x, int y) const {
@@ -91,11 +144,62 @@ struct Tilemap {
         return false;
     }
 
+    bool is_animated(int id) const {
+        return id >= 0 && id < type_count && types[id].frames > 1;
+    }
+
+    void draw_tile(uint32_t* dst, int dst_w, int dst_h, int id,
+                   int sx, int sy, int scale) const {
+        if (id < 0 || id >= type_count) return;
+        const TileType& tt = types[id];
+        if (!tt.sheet) return;
+        int frame = 0;
+        if (tt.frames > 1)
+            frame = (int)(anim_time * tt.fps) % tt.frames;
+        tt.sheet->draw_region(dst, dst_w, dst_h,
+                              tt.src_x + frame * tt.src_w, tt.src_y,
+                              tt.src_w, tt.src_h,
+                              sx, sy, scale);
+    }
+
+    // Composite the static tiles of one chunk over black
+    uint32_t* build_chunk(int cx, int cy, int scale) const {
+        int cs = CHUNK_TILES * tile_size * scale;
+        uint32_t* px = (uint32_t*)montauk::malloc((uint64_t)cs * cs * 4);
+        if (!px) return nullptr;
+        gui::pixelops::fill(px, 0xFF000000, cs * cs);
+
+        int ts = tile_size * scale;
+        for (int ty = 0; ty < CHUNK_TILES; ty++) {
+            for (int tx = 0; tx < CHUNK_TILES; tx++) {
+                int id = get(cx * CHUNK_TILES + tx, cy * CHUNK_TILES + ty);
+                if (is_animated(id)) continue;
+                draw_tile(px, cs, cs, id, tx * ts, ty * ts, scale);
+            }
+        }
+        return px;
+    }
+
+    bool ensure_chunks(int scale) {
+        if (chunks && chunk_scale == scale) return true;
+        free_chunks();
+        chunk_cols = (map_w + CHUNK_TILES - 1) / CHUNK_TILES;
+        chunk_rows = (map_h + CHUNK_TILES - 1) / CHUNK_TILES;
+        chunks = (uint32_t**)montauk::malloc(chunk_cols * chunk_rows * sizeof(uint32_t*));
+        if (!chunks) return false;
+        for (int i = 0; i < chunk_cols * chunk_rows; i++)
+            chunks[i] = nullptr;
+        chunk_scale = scale;
+        return true;
+    }
+
     // Draw visible tiles to the pixel buffer.
     // cam_x/cam_y: camera position in world pixels (native scale).
     // scale: rendering scale factor.
+    // Static tiles are copied out of the chunk cache; animated ones are
+    // drawn on top each frame.
     void draw(uint32_t* dst, int dst_w, int dst_h,
-              int cam_x, int cam_y, int scale) const {
+              int cam_x, int cam_y, int scale) {
         if (!data) return;
 
         int ts = tile_size * scale;
@@ -111,21 +215,50 @@ struct Tilemap {
         if (tx1 > map_w) tx1 = map_w;
         if (ty1 > map_h) ty1 = map_h;
 
-        for (int ty = ty0; ty < ty1; ty++) {
-            for (int tx = tx0; tx < tx1; tx++) {
-                int id = data[ty * map_w + tx];
-                if (id < 0 || id >= type_count) continue;
+        if (!ensure_chunks(scale)) {
+            // No memory for the cache: draw every tile
+            for (int ty = ty0; ty < ty1; ty++)
+                for (int tx = tx0; tx < tx1; tx++)
+                    draw_tile(dst, dst_w, dst_h, data[ty * map_w + tx],
+                              tx * ts - cam_x * scale, ty * ts - cam_y * scale, scale);
+            return;
+        }
 
-                const TileType& tt = types[id];
-                if (!tt.sheet) continue;
+        int cs = CHUNK_TILES * ts;
+        int map_px_w = map_w * ts;
+        int map_px_h = map_h * ts;
+        for (int cy = ty0 / CHUNK_TILES; cy * CHUNK_TILES < ty1; cy++) {
+            for (int cx = tx0 / CHUNK_TILES; cx * CHUNK_TILES < tx1; cx++) {
+                uint32_t*& chunk = chunks[cy * chunk_cols + cx];
+                if (!chunk) chunk = build_chunk(cx, cy, scale);
+                if (!chunk) continue;
 
-                int sx = tx * ts - cam_x * scale;
-                int sy = ty * ts - cam_y * scale;
+                // Chunk rectangle on screen, clipped to the screen and
+                // to the map's edge
+                int sx = cx * cs - cam_x * scale;
+                int sy = cy * cs - cam_y * scale;
+                int x0 = sx < 0 ? 0 : sx;
+                int y0 = sy < 0 ? 0 : sy;
+                int x1 = sx + cs;
+                int y1 = sy + cs;
+                if (x1 > dst_w) x1 = dst_w;
+                if (y1 > dst_h) y1 = dst_h;
+                if (x1 > map_px_w - cam_x * scale) x1 = map_px_w - cam_x * scale;
+                if (y1 > map_px_h - cam_y * scale) y1 = map_px_h - cam_y * scale;
 
-                tt.sheet->draw_region(dst, dst_w, dst_h,
-                                      tt.src_x, tt.src_y,
-                                      tt.src_w, tt.src_h,
-                                      sx, sy, scale);
+                for (int y = y0; y < y1; y++)
+                    gui::pixelops::copy(dst + y * dst_w + x0,
+                                        chunk + (y - sy) * cs + (x0 - sx), x1 - x0);
+            }
+        }
+
+        if (!animated) return;
+        for (int ty = ty0; ty < ty1; ty++) {
+            for (int tx = tx0; tx < tx1; tx++) {
+                int id = data[ty * map_w + tx];
+                if (is_animated(id))
+                    draw_tile(dst, dst_w, dst_h, id,
+                              tx * ts - cam_x * scale, ty * ts - cam_y * scale, scale);
             }
         }
     }
@@ -6,7 +6,9 @@
 */
 
 #pragma once
+#include <montauk/string.h>
 #include "gui/gui.hpp"
+#include "gui/pixelops.hpp"
 #include "gui/font.hpp"
 #include "gui/svg.hpp"
 #include "gui/window.hpp"
@@ -28,19 +30,36 @@ struct Canvas {
     // ---- Core drawing ----
 
     void fill(Color c) {
-        uint32_t px = c.to_pixel();
-        uint64_t px2 = ((uint64_t)px << 32) | px;
-        int total = w * h;
-        int i = 0;
-        // Align to 8-byte boundary if needed
-        if (total > 0 && ((uint64_t)pixels & 4)) {
-            pixels[0] = px;
-            i = 1;
-        }
-        uint64_t* dst64 = (uint64_t*)(pixels + i);
-        int pairs = (total - i) / 2;
-        for (int p = 0; p < pairs; p++) dst64[p] = px2;
-        if ((total - i) & 1) pixels[total - 1] = px;
+        if (w > 0 && h > 0) montauk::memset32(pixels, c.to_pixel(), (uint64_t)w * h);
+    }
+
+    void fill_rect_alpha(int x, int y, int rw, int rh, Color c) {
+        int x0 = gui_max(x, 0), y0 = gui_max(y, 0);
+        int x1 = gui_min(x + rw, w), y1 = gui_min(y + rh, h);
+        if (x0 >= x1) return;
+        for (int dy = y0; dy < y1; dy++)
+            pixelops::blend(pixels + dy * w + x0, x1 - x0, c);
+    }
+
+    // Left-to-right gradient from `from` to `to`
+    void fill_gradient_h(int x, int y, int rw, int rh, Color from, Color to) {
+        int x0 = gui_max(x, 0), y0 = gui_max(y, 0);
+        int x1 = gui_min(x + rw, w), y1 = gui_min(y + rh, h);
+        if (x0 >= x1 || y0 >= y1) return;
+        // Lay the full-width gradient down once, then copy its visible part
+        pixelops::gradient(pixels + y0 * w + x0, x1 - x0, pixelops::lerp(from, to, x0 - x, rw - 1),
+                           pixelops::lerp(from, to, x1 - 1 - x, rw - 1));
+        for (int dy = y0 + 1; dy < y1; dy++)
+            pixelops::copy(pixels + dy * w + x0, pixels + y0 * w + x0, x1 - x0);
+    }
+
+    // Top-to-bottom gradient from `from` to `to`
+    void fill_gradient_v(int x, int y, int rw, int rh, Color from, Color to) {
+        int x0 = gui_max(x, 0), y0 = gui_max(y, 0);
+        int x1 = gui_min(x + rw, w), y1 = gui_min(y + rh, h);
+        if (x0 >= x1) return;
+        for (int dy = y0; dy < y1; dy++)
+            pixelops::fill(pixels + dy * w + x0, pixelops::lerp(from, to, dy - y, rh - 1).to_pixel(), x1 - x0);
     }
 
     void put_pixel(int x, int y, Color c) {
@@ -50,69 +69,56 @@ struct Canvas {
 
     void fill_rect(int x, int y, int rw, int rh, Color c) {
         uint32_t px = c.to_pixel();
-        uint64_t px2 = ((uint64_t)px << 32) | px;
         int x0 = gui_max(x, 0), y0 = gui_max(y, 0);
         int x1 = gui_min(x + rw, w), y1 = gui_min(y + rh, h);
-        for (int dy = y0; dy < y1; dy++) {
-            uint32_t* row = pixels + dy * w;
-            int dx = x0;
-            // Align to 8-byte boundary
-            if (dx < x1 && ((uint64_t)(row + dx) & 4)) {
-                row[dx] = px;
-                dx++;
-            }
-            // Bulk 2-pixel writes
-            uint64_t* dst64 = (uint64_t*)(row + dx);
-            int pairs = (x1 - dx) / 2;
-            for (int p = 0; p < pairs; p++) dst64[p] = px2;
-            dx += pairs * 2;
-            // Remainder
-            if (dx < x1) row[dx] = px;
-        }
+        if (x0 >= x1) return;
+        for (int dy = y0; dy < y1; dy++)
+            pixelops::fill(pixels + dy * w + x0, px, x1 - x0);
     }
 
     void fill_rounded_rect(int x, int y, int rw, int rh, int radius, Color c) {
         if (radius <= 0) { fill_rect(x, y, rw, rh, c); return; }
+        radius = gui_min(radius, gui_min(rw / 2, rh / 2));
         uint32_t px = c.to_pixel();
         for (int row = 0; row < rh; row++) {
             int dy = y + row;
             if (dy < 0 || dy >= h) continue;
-            for (int col = 0; col < rw; col++) {
-                int dx = x + col;
-                if (dx < 0 || dx >= w) continue;
-                bool in_corner = false;
-                int cx_off = 0, cy_off = 0;
-                if (col < radius && row < radius) {
-                    cx_off = radius - col; cy_off = radius - row; in_corner = true;
-                } else if (col >= rw - radius && row < radius) {
-                    cx_off = col - (rw - radius - 1); cy_off = radius - row; in_corner = true;
-                } else if (col < radius && row >= rh - radius) {
-                    cx_off = radius - col; cy_off = row - (rh - radius - 1); in_corner = true;
-                } else if (col >= rw - radius && row >= rh - radius) {
-                    cx_off = col - (rw - radius - 1); cy_off = row - (rh - radius - 1); in_corner = true;
-                }
-                if (in_corner && cx_off * cx_off + cy_off * cy_off > radius * radius) continue;
-                pixels[dy * w + dx] = px;
+            // Rows inside a corner band are inset until the corner circle
+            int cy_off = row < radius ? radius - row
+                       : row >= rh - radius ? row - (rh - radius - 1) : 0;
+            int inset = 0;
+            if (cy_off > 0)
+                while (inset < radius && (radius - inset) * (radius - inset) + cy_off * cy_off > radius * radius)
+                    inset++;
+            int x0 = gui_max(x + inset, 0), x1 = gui_min(x + rw - inset, w);
+            if (x0 < x1) pixelops::fill(pixels + dy * w + x0, px, x1 - x0);
+        }
+    }
+
+    // Filled circle (midpoint algorithm, as gui::fill_circle)
+    void fill_circle(int cx, int cy, int r, Color c) {
+        if (r <= 0) return;
+        int x = 0, y = r, d = 1 - r;
+        hline(cx - r, cy, 2 * r + 1, c);
+        while (x < y) {
+            if (d < 0) {
+                d += 2 * x + 3;
+            } else {
+                d += 2 * (x - y) + 5;
+                y--;
+                hline(cx - x, cy + y + 1, 2 * x + 1, c);
+                hline(cx - x, cy - y - 1, 2 * x + 1, c);
             }
+            x++;
+            hline(cx - y, cy + x, 2 * y + 1, c);
+            hline(cx - y, cy - x, 2 * y + 1, c);
         }
     }
 
     void hline(int x, int y, int len, Color c) {
         if (y < 0 || y >= h) return;
-        uint32_t px = c.to_pixel();
         int x0 = gui_max(x, 0), x1 = gui_min(x + len, w);
-        uint32_t* row = pixels + y * w;
-        int dx = x0;
-        if (dx < x1 && ((uint64_t)(row + dx) & 4)) {
-            row[dx] = px;
-            dx++;
-        }
-        uint64_t px2 = ((uint64_t)px << 32) | px;
-        uint64_t* dst64 = (uint64_t*)(row + dx);
-        int pairs = (x1 - dx) / 2;
-        for (int p = 0; p < pairs; p++) dst64[p] = px2;
-        dx += pairs * 2;
-        if (dx < x1) row[dx] = px;
+        if (x0 < x1) pixelops::fill(pixels + y * w + x0, c.to_pixel(), x1 - x0);
     }
 
     void vline(int x, int y, int len, Color c) {
@@ -195,32 +201,12 @@ struct Canvas {
 
     void icon(int x, int y, const SvgIcon& ic) {
         if (!ic.pixels) return;
+        int x0 = gui_max(x, 0), x1 = gui_min(x + ic.width, w);
+        if (x0 >= x1) return;
         for (int row = 0; row < ic.height; row++) {
             int dy = y + row;
             if (dy < 0 || dy >= h) continue;
-            for (int col = 0; col < ic.width; col++) {
-                int dx = x + col;
-                if (dx < 0 || dx >= w) continue;
-                uint32_t src = ic.pixels[row * ic.width + col];
-                uint8_t sa = (src >> 24) & 0xFF;
-                if (sa == 0) continue;
-                if (sa == 255) {
-                    pixels[dy * w + dx] = src;
-                } else {
-                    uint32_t dst = pixels[dy * w + dx];
-                    uint8_t sr = (src >> 16) & 0xFF;
-                    uint8_t sg = (src >> 8) & 0xFF;
-                    uint8_t sb = src & 0xFF;
-                    uint8_t dr = (dst >> 16) & 0xFF;
-                    uint8_t dg = (dst >> 8) & 0xFF;
-                    uint8_t db = dst & 0xFF;
-                    uint32_t a = sa, inv_a = 255 - sa;
-                    uint32_t rr = (a * sr + inv_a * dr + 128) / 255;
-                    uint32_t gg = (a * sg + inv_a * dg + 128) / 255;
-                    uint32_t bb = (a * sb + inv_a * db + 128) / 255;
-                    pixels[dy * w + dx] = 0xFF000000 | (rr << 16) | (gg << 8) | bb;
-                }
-            }
+            pixelops::blend_argb(pixels + dy * w + x0, ic.pixels + row * ic.width + (x0 - x), x1 - x0);
         }
     }
 
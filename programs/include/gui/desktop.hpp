@@ -15,7 +15,7 @@
 
 namespace gui {
 
-static constexpr int MAX_WINDOWS = 8;
+static constexpr int MAX_WINDOWS = 64;
 static constexpr int PANEL_HEIGHT = 32;
 static constexpr int MAX_EXTERNAL_APPS = 32;
 
@@ -56,6 +56,41 @@ struct DesktopSettings {
     int tz_offset_minutes;  // timezone offset from UTC in minutes
 };
 
+// A window as the compositor last drew it
+struct ComposedWindow {
+    uint32_t* content;
+    int ext_win_id;
+    Rect frame;
+    WindowState state;
+    bool focused;
+    char title[MAX_TITLE_LEN];
+};
+
+// Compositor frame timing, shown by the Ctrl+Alt+P overlay and written
+// out by Ctrl+Alt+D. Times are in microseconds.
+struct FrameStats {
+    static constexpr int HIST_BUCKETS = 64;      // Frame times [0, 32 ms) in 500 us steps...
+    static constexpr int HIST_STEP_US = 500;     // ...and the last bucket holds the rest
+    static constexpr int STAGES = 3;             // Compose, flip, total
+
+    bool overlay;
+    uint64_t tsc_per_us;
+    uint64_t frames;
+    uint32_t hist[STAGES][HIST_BUCKETS];
+    uint64_t max_us[STAGES];
+
+    // The second being counted, and the last full one as shown
+    uint64_t second_start;       // ms
+    uint32_t second_frames;
+    uint64_t second_sum_us[STAGES];
+    uint64_t second_max_us[STAGES];
+    uint32_t fps;
+    uint32_t avg_us[STAGES];
+    uint32_t peak_us[STAGES];
+    int dirty_windows;           // Windows redrawn by the last frame
+    int damage_rects;            // Rectangles it repainted
+};
+
 struct DesktopState {
     Framebuffer fb;
     Window windows[MAX_WINDOWS];
@@ -148,12 +183,45 @@ struct DesktopState {
     // IDs of external windows we've sent a close event to but that haven't
     // been destroyed yet by their owning process.  Prevents the poll loop
     // from re-creating them at the default position (visible flicker).
-    static constexpr int MAX_CLOSING = 8;
+    static constexpr int MAX_CLOSING = 16;
     int closing_ext_ids[MAX_CLOSING];
     int closing_ext_count;
 
     DesktopSettings settings;
 
+    // The background pre-rendered at screen size: wallpaper, gradient or
+    // solid colour, under the panel colour where the panel goes. Damaged
+    // regions are restored from it row by row. It is the wallpaper itself
+    // when that already covers the screen. Rebuilt on first use after
+    // desktop_invalidate_background.
+    uint32_t* bg_surface;
+    uint32_t* bg_own;         // Surface rendered by the desktop, or nullptr
+    bool bg_own_gpu;          // bg_own came from gpu_alloc (and goes with free)
+    int bg_surface_w, bg_surface_h;
+    bool bg_valid;
+
+    // Compositor damage: the screen rectangles the next frame repaints
+    static constexpr int MAX_DAMAGE = 8;
+    Rect damage[MAX_DAMAGE];
+    int damage_count;
+
+    // Where a window that only moved was scrolled to in the back buffer
+    // this frame; shown along with the damage, but not repainted
+    Rect moved;
+
+    // Hardware cursor plane: the kernel moves the pointer with the mouse,
+    // and the compositor only loads a new image when the style changes.
+    // Cleared if the display has no cursor plane.
+    bool hw_cursor;
+    int hw_cursor_style;      // Style loaded, -1 before the first
+
+    // What the last frame showed, to find what changed since
+    ComposedWindow composed[MAX_WINDOWS];
+    int composed_count;
+    bool composed_overlay;    // A menu, popup or the lock screen was up
+
+    FrameStats frame_stats;
+
     // Lock screen state
     bool screen_locked;
     char lock_password[64];
@@ -168,11 +236,30 @@ struct DesktopState {
 void desktop_init(DesktopState* ds);
 void desktop_run(DesktopState* ds);
 void desktop_compose(DesktopState* ds);
+void desktop_add_damage(DesktopState* ds, Rect r);
+void desktop_damage_all(DesktopState* ds);
+// Background settings changed: re-render it, and repaint the screen
+void desktop_invalidate_background(DesktopState* ds);
+void desktop_damage_pointer(DesktopState* ds, int prev_x, int prev_y);
+void desktop_damage_scene(DesktopState* ds);
+void desktop_compose_damage(DesktopState* ds);
+// Frame statistics (stats.cpp)
+void desktop_stats_init(DesktopState* ds);
+void desktop_stats_frame(DesktopState* ds, uint64_t compose_tsc, uint64_t flip_tsc, uint64_t total_tsc,
+                         int damage_rects);
+bool desktop_stats_tick(DesktopState* ds, uint64_t now);
+int64_t desktop_stats_wait_ms(const DesktopState* ds, uint64_t now);
+Rect desktop_stats_rect(const DesktopState* ds);
+void desktop_draw_frame_stats(DesktopState* ds);
+void desktop_toggle_frame_stats(DesktopState* ds);
+void desktop_dump_frame_stats(DesktopState* ds);
 int  desktop_create_window(DesktopState* ds, const char* title, int x, int y, int w, int h);
 void desktop_close_window(DesktopState* ds, int idx);
 void desktop_raise_window(DesktopState* ds, int idx);
 void desktop_draw_panel(DesktopState* ds);
-void desktop_draw_window(DesktopState* ds, int idx);
+// Draws window `idx` within the `visible` rectangles, which must lie in
+// the framebuffer's clip
+void desktop_draw_window(DesktopState* ds, int idx, const Rect* visible, int visible_count);
 void desktop_handle_mouse(DesktopState* ds);
 void desktop_handle_keyboard(DesktopState* ds, const Montauk::KeyEvent& key);
 
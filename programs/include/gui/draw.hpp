@@ -12,12 +12,12 @@ namespace gui {
 
 // Fast horizontal line
 inline void draw_hline(Framebuffer& fb, int x, int y, int w, Color c) {
-    for (int i = 0; i < w; i++) fb.put_pixel(x + i, y, c);
+    fb.fill_rect(x, y, w, 1, c);
 }
 
 // Fast vertical line
 inline void draw_vline(Framebuffer& fb, int x, int y, int h, Color c) {
-    for (int i = 0; i < h; i++) fb.put_pixel(x, y + i, c);
+    fb.fill_rect(x, y, 1, h, c);
 }
 
 // Rectangle outline
@@ -343,11 +343,12 @@ enum CursorStyle {
     CURSOR_RESIZE_NESW, // diagonal NE-SW
 };
 
-// Draw the mouse cursor at (x, y)
-inline void draw_cursor(Framebuffer& fb, int x, int y, CursorStyle style = CURSOR_ARROW) {
-    const uint16_t* outline_data = cursor_outline;
-    const uint16_t* fill_data = cursor_fill;
-    int ox = 0, oy = 0; // hotspot offset for centered cursors
+// Bitmaps of a cursor style, and where its top-left sits relative to the hotspot
+inline void cursor_bitmaps(CursorStyle style, const uint16_t*& outline_data, const uint16_t*& fill_data,
+                           int& ox, int& oy) {
+    outline_data = cursor_outline;
+    fill_data = cursor_fill;
+    ox = 0; oy = 0; // hotspot offset for centered cursors
 
     switch (style) {
     case CURSOR_RESIZE_H:
@@ -373,6 +374,14 @@ inline void draw_cursor(Framebuffer& fb, int x, int y, CursorStyle style = CURSO
     default:
         break;
     }
+}
+
+// Draw the mouse cursor at (x, y)
+inline void draw_cursor(Framebuffer& fb, int x, int y, CursorStyle style = CURSOR_ARROW) {
+    const uint16_t* outline_data;
+    const uint16_t* fill_data;
+    int ox, oy;
+    cursor_bitmaps(style, outline_data, fill_data, ox, oy);
 
     Color black = colors::BLACK;
     Color white = colors::WHITE;
@@ -391,4 +400,26 @@ inline void draw_cursor(Framebuffer& fb, int x, int y, CursorStyle style = CURSO
     }
 }
 
+// Render a cursor style as an ARGB image for the hardware cursor plane
+inline void cursor_image(CursorStyle style, Montauk::CursorImage& img) {
+    const uint16_t* outline_data;
+    const uint16_t* fill_data;
+    int ox, oy;
+    cursor_bitmaps(style, outline_data, fill_data, ox, oy);
+
+    img.width = 16;
+    img.height = 16;
+    img.hotX = -ox;
+    img.hotY = -oy;
+    for (int row = 0; row < 16; row++) {
+        for (int col = 0; col < 16; col++) {
+            uint16_t mask = (uint16_t)(0x8000 >> col);
+            uint32_t px = 0;
+            if (outline_data[row] & mask) px = colors::BLACK.to_pixel();
+            else if (fill_data[row] & mask) px = colors::WHITE.to_pixel();
+            img.pixels[row * 16 + col] = px;
+        }
+    }
+}
+
 } // namespace gui
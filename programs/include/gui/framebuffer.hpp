@@ -7,7 +7,9 @@
 #pragma once
 #include <cstdint>
 #include <montauk/syscall.h>
+#include <montauk/string.h>
 #include "gui/gui.hpp"
+#include "gui/pixelops.hpp"
 
 namespace gui {
 
@@ -18,9 +20,37 @@ class Framebuffer {
     int fb_height;
     int fb_pitch; // in bytes
 
+    // Drawing is confined to [clip_x0, clip_x1) x [clip_y0, clip_y1)
+    int clip_x0, clip_y0, clip_x1, clip_y1;
+
+    // Page flipping, when the display has two scanout buffers. Frames are
+    // still drawn into back_buf: blending reads the destination, and
+    // scanout memory is write-combined, so reading it is uncached. What
+    // changed is copied into the buffer off screen, which is then flipped
+    // to at vertical blank. That buffer last received the frame before
+    // the previous one, so the previous frame's rectangles go along too.
+    static constexpr int MAX_PRESENT_RECTS = 16;
+    uint32_t* scanout[2];
+    int hidden;                 // Scanout buffer not on screen
+    bool flipping;
+    Rect prev_rects[MAX_PRESENT_RECTS];
+    int prev_count;             // -1 = the whole screen
+
+    // With an Intel blitter, back_buf is memory it reaches, and large
+    // opaque fills and copies run on it instead of the CPU: the copies to
+    // the screen most of all, since scanout memory is write-combined. It
+    // has no per-pixel alpha, so blending stays here. Each request waits
+    // for the blitter, which costs a system call, so small rectangles are
+    // not worth it.
+    static constexpr int64_t GPU_MIN_PIXELS = 64 * 1024;
+    bool gpu;
+
 public:
-    Framebuffer() : hw_fb(nullptr), back_buf(nullptr), fb_width(0), fb_height(0), fb_pitch(0) {
+    Framebuffer() : hw_fb(nullptr), back_buf(nullptr), fb_width(0), fb_height(0), fb_pitch(0),
+                    clip_x0(0), clip_y0(0), clip_x1(0), clip_y1(0),
+                    scanout{nullptr, nullptr}, hidden(0), flipping(false), prev_count(-1), gpu(false) {
         Montauk::FbInfo info;
+        info.buffers = 1;
         montauk::fb_info(&info);
 
         fb_width  = (int)info.width;
@@ -28,7 +58,20 @@ public:
         fb_pitch  = (int)info.pitch;
 
         hw_fb = (uint32_t*)montauk::fb_map();
-        back_buf = (uint32_t*)montauk::alloc((uint64_t)fb_height * fb_pitch);
+        back_buf = (uint32_t*)montauk::gpu_alloc((uint64_t)fb_height * fb_pitch);
+        gpu = back_buf != nullptr;
+        if (!gpu) back_buf = (uint32_t*)montauk::alloc((uint64_t)fb_height * fb_pitch);
+        reset_clip();
+
+        // Start from buffer 0 on screen, whatever the last owner left
+        if (info.buffers >= 2 && hw_fb) {
+            scanout[0] = hw_fb;
+            scanout[1] = (uint32_t*)montauk::fb_map_buffer(1);
+            if (scanout[1] && montauk::fb_flip(0) == 0) {
+                flipping = true;
+                hidden = 1;
+            }
+        }
     }
 
     int width() const { return fb_width; }
@@ -37,14 +80,34 @@ public:
 
     uint32_t* buffer() { return back_buf; }
 
+    // Confine drawing to a rectangle of the screen, so a compositor can
+    // repaint just part of it
+    inline void set_clip(Rect r) {
+        clip_x0 = r.x < 0 ? 0 : r.x;
+        clip_y0 = r.y < 0 ? 0 : r.y;
+        clip_x1 = (r.x + r.w) > fb_width ? fb_width : (r.x + r.w);
+        clip_y1 = (r.y + r.h) > fb_height ? fb_height : (r.y + r.h);
+        if (clip_x1 < clip_x0) clip_x1 = clip_x0;
+        if (clip_y1 < clip_y0) clip_y1 = clip_y0;
+    }
+
+    inline void reset_clip() {
+        clip_x0 = 0;
+        clip_y0 = 0;
+        clip_x1 = fb_width;
+        clip_y1 = fb_height;
+    }
+
+    Rect clip() const { return {clip_x0, clip_y0, clip_x1 - clip_x0, clip_y1 - clip_y0}; }
+
     inline void put_pixel(int x, int y, Color c) {
-        if (x < 0 || x >= fb_width || y < 0 || y >= fb_height) return;
+        if (x < clip_x0 || x >= clip_x1 || y < clip_y0 || y >= clip_y1) return;
         uint32_t* row = (uint32_t*)((uint8_t*)back_buf + y * fb_pitch);
         row[x] = c.to_pixel();
     }
 
     inline void put_pixel_alpha(int x, int y, Color c) {
-        if (x < 0 || x >= fb_width || y < 0 || y >= fb_height) return;
+        if (x < clip_x0 || x >= clip_x1 || y < clip_y0 || y >= clip_y1) return;
         if (c.a == 0) return;
         if (c.a == 255) {
             put_pixel(x, y, c);
@@ -75,22 +138,31 @@ public:
     }
 
     inline void fill_rect(int x, int y, int w, int h, Color c) {
-        // Clip to screen bounds
-        int x0 = x < 0 ? 0 : x;
-        int y0 = y < 0 ? 0 : y;
-        int x1 = (x + w) > fb_width ? fb_width : (x + w);
-        int y1 = (y + h) > fb_height ? fb_height : (y + h);
+        // Clip to the clip rectangle
+        int x0 = x < clip_x0 ? clip_x0 : x;
+        int y0 = y < clip_y0 ? clip_y0 : y;
+        int x1 = (x + w) > clip_x1 ? clip_x1 : (x + w);
+        int y1 = (y + h) > clip_y1 ? clip_y1 : (y + h);
 
         if (x0 >= x1 || y0 >= y1) return;
 
         uint32_t pixel = c.to_pixel();
         int clipped_w = x1 - x0;
 
+        if (gpu && (int64_t)clipped_w * (y1 - y0) >= GPU_MIN_PIXELS) {
+            Montauk::GpuBlit op = {};
+            op.dst = (uint64_t)((uint8_t*)back_buf + (uint64_t)y0 * fb_pitch + (uint64_t)x0 * 4);
+            op.dstPitch = (uint32_t)fb_pitch;
+            op.width = (uint32_t)clipped_w;
+            op.height = (uint32_t)(y1 - y0);
+            op.color = pixel;
+            op.fill = 1;
+            if (montauk::gpu_blit(&op, 1) == 0) return;
+        }
+
         for (int row = y0; row < y1; row++) {
             uint32_t* dst = (uint32_t*)((uint8_t*)back_buf + row * fb_pitch) + x0;
-            for (int col = 0; col < clipped_w; col++) {
-                dst[col] = pixel;
-            }
+            pixelops::fill(dst, pixel, clipped_w);
         }
     }
 
@@ -101,78 +173,111 @@ public:
             return;
         }
 
-        int x0 = x < 0 ? 0 : x;
-        int y0 = y < 0 ? 0 : y;
-        int x1 = (x + w) > fb_width ? fb_width : (x + w);
-        int y1 = (y + h) > fb_height ? fb_height : (y + h);
+        int x0 = x < clip_x0 ? clip_x0 : x;
+        int y0 = y < clip_y0 ? clip_y0 : y;
+        int x1 = (x + w) > clip_x1 ? clip_x1 : (x + w);
+        int y1 = (y + h) > clip_y1 ? clip_y1 : (y + h);
 
         if (x0 >= x1 || y0 >= y1) return;
 
-        uint32_t a = c.a;
-        uint32_t inv_a = 255 - a;
-        uint32_t src_r = a * c.r;
-        uint32_t src_g = a * c.g;
-        uint32_t src_b = a * c.b;
-
         for (int row = y0; row < y1; row++) {
             uint32_t* dst = (uint32_t*)((uint8_t*)back_buf + row * fb_pitch) + x0;
-            for (int col = 0; col < x1 - x0; col++) {
-                uint32_t d = dst[col];
-                uint32_t dr = (d >> 16) & 0xFF;
-                uint32_t dg = (d >> 8) & 0xFF;
-                uint32_t db = d & 0xFF;
+            pixelops::blend(dst, x1 - x0, c);
+        }
+    }
 
-                uint32_t rr = src_r + inv_a * dr;
-                uint32_t gg = src_g + inv_a * dg;
-                uint32_t bb = src_b + inv_a * db;
+    // `gpu_source`: the pixels may be in memory the blitter reaches (from
+    // gpu_alloc, or a window mapped with win_map); it is asked first
+    inline void blit(int x, int y, int w, int h, const uint32_t* pixels, bool gpu_source = false) {
+        int x0 = x < clip_x0 ? clip_x0 : x;
+        int y0 = y < clip_y0 ? clip_y0 : y;
+        int x1 = (x + w) > clip_x1 ? clip_x1 : (x + w);
+        int y1 = (y + h) > clip_y1 ? clip_y1 : (y + h);
 
-                rr = (rr + 1 + (rr >> 8)) >> 8;
-                gg = (gg + 1 + (gg >> 8)) >> 8;
-                bb = (bb + 1 + (bb >> 8)) >> 8;
+        if (x0 >= x1 || y0 >= y1) return;
 
-                dst[col] = (0xFF000000) | (rr << 16) | (gg << 8) | bb;
-            }
+        if (gpu && gpu_source && (int64_t)(x1 - x0) * (y1 - y0) >= GPU_MIN_PIXELS) {
+            Montauk::GpuBlit op = {};
+            op.dst = (uint64_t)((uint8_t*)back_buf + (uint64_t)y0 * fb_pitch + (uint64_t)x0 * 4);
+            op.src = (uint64_t)(pixels + (uint64_t)(y0 - y) * w + (x0 - x));
+            op.dstPitch = (uint32_t)fb_pitch;
+            op.srcPitch = (uint32_t)w * 4;
+            op.width = (uint32_t)(x1 - x0);
+            op.height = (uint32_t)(y1 - y0);
+            if (montauk::gpu_blit(&op, 1) == 0) return;
+        }
+
+        for (int dy = y0; dy < y1; dy++) {
+            uint32_t* dst = (uint32_t*)((uint8_t*)back_buf + dy * fb_pitch) + x0;
+            pixelops::copy(dst, pixels + (dy - y) * w + (x0 - x), x1 - x0);
         }
     }
 
-    inline void blit(int x, int y, int w, int h, const uint32_t* pixels) {
-        for (int row = 0; row < h; row++) {
-            int dy = y + row;
-            if (dy < 0 || dy >= fb_height) continue;
-            for (int col = 0; col < w; col++) {
-                int dx = x + col;
-                if (dx < 0 || dx >= fb_width) continue;
-                uint32_t* dst_row = (uint32_t*)((uint8_t*)back_buf + dy * fb_pitch);
-                dst_row[dx] = pixels[row * w + col];
+    // Blit an sw x sh image stretched to w x h: nearest-neighbour, or
+    // bilinear if `smooth`. Source positions step in 16.16 fixed point;
+    // whole-number factors replicate pixels, and a row that repeats the
+    // one above is copied from it.
+    inline void blit_scaled(int x, int y, int w, int h, const uint32_t* pixels, int sw, int sh,
+                            bool smooth = false) {
+        if (w == sw && h == sh) { blit(x, y, w, h, pixels); return; }
+
+        int x0 = x < clip_x0 ? clip_x0 : x;
+        int y0 = y < clip_y0 ? clip_y0 : y;
+        int x1 = (x + w) > clip_x1 ? clip_x1 : (x + w);
+        int y1 = (y + h) > clip_y1 ? clip_y1 : (y + h);
+
+        if (x0 >= x1 || y0 >= y1 || sw <= 0 || sh <= 0) return;
+
+        int n = x1 - x0;
+        int32_t stepx = (int32_t)(((int64_t)sw << 16) / w);
+        int32_t stepy = (int32_t)(((int64_t)sh << 16) / h);
+
+        if (smooth) {
+            // Pixel centres line up: source x = (dx + 0.5) * sw / w - 0.5
+            int32_t fx = (int32_t)((((int64_t)(2 * (x0 - x) + 1) * sw) << 16) / (2 * w)) - 0x8000;
+            int32_t fy = (int32_t)((((int64_t)(2 * (y0 - y) + 1) * sh) << 16) / (2 * h)) - 0x8000;
+            for (int dy = y0; dy < y1; dy++, fy += stepy) {
+                int sy = fy < 0 ? 0 : fy >> 16;
+                uint16_t wy = fy < 0 ? 0 : (fy >> 8) & 0xFF;
+                const uint32_t* r0 = pixels + sy * sw;
+                const uint32_t* r1 = sy + 1 < sh ? r0 + sw : r0;
+                uint32_t* dst = (uint32_t*)((uint8_t*)back_buf + dy * fb_pitch) + x0;
+                pixelops::scale_bilinear(dst, n, r0, r1, fx, stepx, sw - 1, wy);
             }
+            return;
+        }
+
+        int k = w % sw == 0 ? w / sw : 0;
+        int32_t fx = (int32_t)(x0 - x) * stepx;
+        int32_t fy = (int32_t)(y0 - y) * stepy;
+        int prev_sy = -1;
+        uint32_t* prev = nullptr;
+        for (int dy = y0; dy < y1; dy++, fy += stepy) {
+            int sy = fy >> 16;
+            uint32_t* dst = (uint32_t*)((uint8_t*)back_buf + dy * fb_pitch) + x0;
+            if (sy == prev_sy) {
+                pixelops::copy(dst, prev, n);
+                continue;
+            }
+            const uint32_t* src = pixels + sy * sw;
+            if (k) pixelops::scale_integer(dst, n, src + (x0 - x) / k, k, (x0 - x) % k);
+            else pixelops::scale_nearest(dst, n, src, fx, stepx);
+            prev_sy = sy;
+            prev = dst;
         }
     }
 
     inline void blit_alpha(int x, int y, int w, int h, const uint32_t* pixels) {
-        for (int row = 0; row < h; row++) {
-            int dy = y + row;
-            if (dy < 0 || dy >= fb_height) continue;
-            for (int col = 0; col < w; col++) {
-                int dx = x + col;
-                if (dx < 0 || dx >= fb_width) continue;
-
-                uint32_t src = pixels[row * w + col];
-                uint8_t sa = (src >> 24) & 0xFF;
-                if (sa == 0) continue;
-
-                uint8_t sr = (src >> 16) & 0xFF;
-                uint8_t sg = (src >> 8) & 0xFF;
-                uint8_t sb = src & 0xFF;
-
-                if (sa == 255) {
-                    uint32_t* dst_row = (uint32_t*)((uint8_t*)back_buf + dy * fb_pitch);
-                    dst_row[dx] = src;
-                    continue;
-                }
+        int x0 = x < clip_x0 ? clip_x0 : x;
+        int y0 = y < clip_y0 ? clip_y0 : y;
+        int x1 = (x + w) > clip_x1 ? clip_x1 : (x + w);
+        int y1 = (y + h) > clip_y1 ? clip_y1 : (y + h);
 
-                Color sc = {sr, sg, sb, sa};
-                put_pixel_alpha(dx, dy, sc);
-            }
+        if (x0 >= x1 || y0 >= y1) return;
+
+        for (int dy = y0; dy < y1; dy++) {
+            uint32_t* dst = (uint32_t*)((uint8_t*)back_buf + dy * fb_pitch) + x0;
+            pixelops::blend_argb(dst, pixels + (dy - y) * w + (x0 - x), x1 - x0);
         }
     }
 
@@ -180,16 +285,138 @@ public:
         fill_rect(0, 0, fb_width, fb_height, c);
     }
 
-    inline void flip() {
-        // Copy back buffer to hardware framebuffer, row by row (pitch may differ)
-        int row_pixels = fb_width;
-        for (int y = 0; y < fb_height; y++) {
-            uint32_t* src = (uint32_t*)((uint8_t*)back_buf + y * fb_pitch);
-            uint32_t* dst = (uint32_t*)((uint8_t*)hw_fb + y * fb_pitch);
-            for (int x = 0; x < row_pixels; x++) {
-                dst[x] = src[x];
+    // Move the pixels of a back buffer rectangle by (dx, dy), within
+    // `bounds`. Returns where they landed: the part of the moved rectangle
+    // whose source was inside `bounds` too (empty if none).
+    inline Rect move_rect(Rect r, int dx, int dy, Rect bounds) {
+        bounds = bounds.intersect({0, 0, fb_width, fb_height});
+        Rect dst = Rect{r.x + dx, r.y + dy, r.w, r.h}.intersect(bounds);
+        dst = dst.intersect(Rect{bounds.x + dx, bounds.y + dy, bounds.w, bounds.h});
+        if (dst.empty()) return {0, 0, 0, 0};
+
+        // Walk rows against the direction of motion so overlapping source
+        // rows are read before they are overwritten
+        uint64_t row_bytes = (uint64_t)dst.w * 4;
+        for (int i = 0; i < dst.h; i++) {
+            int row = dy > 0 ? dst.y + dst.h - 1 - i : dst.y + i;
+            uint8_t* d = (uint8_t*)back_buf + (uint64_t)row * fb_pitch + (uint64_t)dst.x * 4;
+            const uint8_t* s = (const uint8_t*)back_buf + (uint64_t)(row - dy) * fb_pitch +
+                               (uint64_t)(dst.x - dx) * 4;
+            montauk::memmove(d, s, row_bytes);
+        }
+        return dst;
+    }
+
+    // Whether frames reach the screen by page flipping (tear-free)
+    bool page_flipping() const { return flipping; }
+
+private:
+    // Copy a rectangle of the back buffer into `dst`, a screen-sized buffer
+    inline void copy_out(uint32_t* dst, int x, int y, int w, int h) {
+        int x0 = x < 0 ? 0 : x;
+        int y0 = y < 0 ? 0 : y;
+        int x1 = (x + w) > fb_width ? fb_width : (x + w);
+        int y1 = (y + h) > fb_height ? fb_height : (y + h);
+        if (x0 >= x1 || y0 >= y1) return;
+
+        uint64_t row_bytes = (uint64_t)(x1 - x0) * 4;
+        for (int row = y0; row < y1; row++) {
+            uint64_t offset = (uint64_t)row * fb_pitch + (uint64_t)x0 * 4;
+            montauk::memcpy((uint8_t*)dst + offset, (const uint8_t*)back_buf + offset, row_bytes);
+        }
+    }
+
+    // Copy rectangles of the back buffer into `dst`, on the blitter when
+    // they add up to enough pixels, else (or if it fails) on the CPU
+    inline void copy_out_rects(uint32_t* dst, const Rect* rects, int count) {
+        int64_t pixels = 0;
+        for (int i = 0; i < count; i++) pixels += (int64_t)rects[i].w * rects[i].h;
+
+        if (gpu && pixels >= GPU_MIN_PIXELS) {
+            Montauk::GpuBlit ops[Montauk::GPU_BLIT_MAX];
+            int n = 0;
+            bool ok = true;
+            for (int i = 0; i < count && ok; i++) {
+                Rect r = rects[i].intersect({0, 0, fb_width, fb_height});
+                if (r.empty()) continue;
+
+                uint64_t offset = (uint64_t)r.y * fb_pitch + (uint64_t)r.x * 4;
+                Montauk::GpuBlit& op = ops[n++];
+                op = {};
+                op.dst = (uint64_t)((uint8_t*)dst + offset);
+                op.src = (uint64_t)((const uint8_t*)back_buf + offset);
+                op.dstPitch = op.srcPitch = (uint32_t)fb_pitch;
+                op.width = (uint32_t)r.w;
+                op.height = (uint32_t)r.h;
+                if (n == Montauk::GPU_BLIT_MAX) {
+                    ok = montauk::gpu_blit(ops, n) == 0;
+                    n = 0;
+                }
             }
+            if (ok && n > 0) ok = montauk::gpu_blit(ops, n) == 0;
+            if (ok) return;
         }
+
+        for (int i = 0; i < count; i++) copy_out(dst, rects[i].x, rects[i].y, rects[i].w, rects[i].h);
+    }
+
+    inline void copy_out_all(uint32_t* dst) {
+        Rect all = {0, 0, fb_width, fb_height};
+        copy_out_rects(dst, &all, 1);
+    }
+
+    // Show the hidden buffer, once it holds the frame
+    inline void flip_hidden() {
+        if (montauk::fb_flip(hidden) != 0) {
+            // The display stopped flipping; fall back to copying into buffer 0
+            flipping = false;
+            hw_fb = scanout[0];
+            copy_out_all(hw_fb);
+            return;
+        }
+        hidden ^= 1;
+    }
+
+public:
+    inline void flip() {
+        if (flipping) {
+            copy_out_all(scanout[hidden]);
+            flip_hidden();
+            prev_count = -1;
+            return;
+        }
+        // Copy back buffer to hardware framebuffer (pitch may differ)
+        copy_out_all(hw_fb);
+    }
+
+    // Show a frame of which only `rects` changed since the last one
+    inline void present(const Rect* rects, int count) {
+        if (!flipping) {
+            copy_out_rects(hw_fb, rects, count);
+            return;
+        }
+
+        uint32_t* dst = scanout[hidden];
+        if (prev_count < 0) {
+            copy_out_all(dst);
+        } else {
+            copy_out_rects(dst, prev_rects, prev_count);
+            copy_out_rects(dst, rects, count);
+        }
+        flip_hidden();
+
+        if (count > MAX_PRESENT_RECTS) {
+            prev_count = -1;
+        } else {
+            for (int i = 0; i < count; i++) prev_rects[i] = rects[i];
+            prev_count = count;
+        }
+    }
+
+    // Show the frame, of which only a rectangle changed
+    inline void flip_rect(int x, int y, int w, int h) {
+        Rect r = {x, y, w, h};
+        present(&r, 1);
     }
 };
 
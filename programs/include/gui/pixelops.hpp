@@ -0,0 +1,395 @@
+/*
+    * pixelops.hpp
+    * MontaukOS pixel-span kernels: fill, copy, alpha blend, gradient and scaling
+    * Copyright (c) 2026 Daniel Hammer
+*/
+
+#pragma once
+#include <cstdint>
+#include <montauk/string.h>
+#include "gui/gui.hpp"
+
+// Every drawing target in the GUI is rows of 0xAARRGGBB pixels, and every
+// primitive ends up filling, copying or blending spans of one row. These
+// work on a single span of `n` pixels; callers clip and step through rows.
+// Like montauk/string.h, each kernel has an SSE2 body (always available on
+// x86-64) and an AVX2 body chosen at run time, with a scalar tail.
+//
+// Blends use out = (s * a + d * (255 - a)) / 255, rounded with the
+// (x + 1 + (x >> 8)) >> 8 trick, and always write an opaque pixel.
+//
+// Scaling steps through the source in 16.16 fixed point, so no pixel
+// costs a divide. Whole-number factors replicate pixels instead; those
+// kernels only shuffle and store, and have no AVX2 body.
+namespace gui::pixelops {
+
+    namespace simd {
+        typedef char v16 __attribute__((vector_size(16)));
+        typedef char v32 __attribute__((vector_size(32)));
+        typedef short v8s __attribute__((vector_size(16)));
+        typedef short v16s __attribute__((vector_size(32)));
+        typedef uint16_t v8u16 __attribute__((vector_size(16)));
+        typedef uint16_t v16u16 __attribute__((vector_size(32)));
+        typedef int32_t v4i32 __attribute__((vector_size(16)));
+        typedef int32_t v8i32 __attribute__((vector_size(32)));
+        typedef uint32_t v4u32 __attribute__((vector_size(16)));
+        typedef uint32_t v8u32 __attribute__((vector_size(32)));
+        typedef char v16u __attribute__((vector_size(16), may_alias, aligned(1)));
+        typedef char v32u __attribute__((vector_size(32), may_alias, aligned(1)));
+
+        // x / 255 for x <= 255 * 255, per 16-bit lane
+        __attribute__((target("sse2"))) inline v8u16 div255_sse2(v8u16 x) {
+            return (x + 1 + (x >> 8)) >> 8;
+        }
+
+        __attribute__((target("avx2"))) inline v16u16 div255_avx2(v16u16 x) {
+            return (x + 1 + (x >> 8)) >> 8;
+        }
+
+        // sr, sg and sb are the colour channels premultiplied by a; inv is 255 - a
+        __attribute__((target("sse2"))) inline int blend_sse2(uint32_t* d, int n, uint16_t sr, uint16_t sg, uint16_t sb, uint16_t inv16) {
+            v8u16 src = {sb, sg, sr, 0, sb, sg, sr, 0};
+            v8u16 inv = (v8u16){} + inv16;
+            v16 zero = {};
+            v16 opaque = (v16)((v4u32){} + 0xFF000000u);
+            int i = 0;
+            for (; i + 4 <= n; i += 4) {
+                v16 p = *(const v16u*)(d + i);
+                v8u16 lo = (v8u16)__builtin_ia32_punpcklbw128(p, zero);
+                v8u16 hi = (v8u16)__builtin_ia32_punpckhbw128(p, zero);
+                lo = div255_sse2(lo * inv + src);
+                hi = div255_sse2(hi * inv + src);
+                *(v16u*)(d + i) = __builtin_ia32_packuswb128((v8s)lo, (v8s)hi) | opaque;
+            }
+            return i;
+        }
+
+        __attribute__((target("avx2"))) inline int blend_avx2(uint32_t* d, int n, uint16_t sr, uint16_t sg, uint16_t sb, uint16_t inv16) {
+            v16u16 src = {sb, sg, sr, 0, sb, sg, sr, 0, sb, sg, sr, 0, sb, sg, sr, 0};
+            v16u16 inv = (v16u16){} + inv16;
+            v32 zero = {};
+            v32 opaque = (v32)((v8u32){} + 0xFF000000u);
+            int i = 0;
+            for (; i + 8 <= n; i += 8) {
+                v32 p = *(const v32u*)(d + i);
+                v16u16 lo = (v16u16)__builtin_ia32_punpcklbw256(p, zero);
+                v16u16 hi = (v16u16)__builtin_ia32_punpckhbw256(p, zero);
+                lo = div255_avx2(lo * inv + src);
+                hi = div255_avx2(hi * inv + src);
+                *(v32u*)(d + i) = __builtin_ia32_packuswb256((v16s)lo, (v16s)hi) | opaque;
+            }
+            return i;
+        }
+
+        // Groups of four that are fully transparent or fully opaque skip the math
+        __attribute__((target("sse2"))) inline int blend_argb_sse2(uint32_t* d, const uint32_t* s, int n) {
+            v16 zero = {};
+            v16 opaque = (v16)((v4u32){} + 0xFF000000u);
+            v8u16 full = (v8u16){} + (uint16_t)255;
+            int i = 0;
+            for (; i + 4 <= n; i += 4) {
+                v16 sp = *(const v16u*)(s + i);
+                v4u32 alpha = (v4u32)sp >> 24;
+                if (__builtin_ia32_pmovmskb128((v16)(alpha == 0)) == 0xFFFF) continue;
+                if (__builtin_ia32_pmovmskb128((v16)(alpha == 255)) == 0xFFFF) {
+                    *(v16u*)(d + i) = sp;
+                    continue;
+                }
+                v16 dp = *(const v16u*)(d + i);
+                v8u16 slo = (v8u16)__builtin_ia32_punpcklbw128(sp, zero);
+                v8u16 shi = (v8u16)__builtin_ia32_punpckhbw128(sp, zero);
+                v8u16 dlo = (v8u16)__builtin_ia32_punpcklbw128(dp, zero);
+                v8u16 dhi = (v8u16)__builtin_ia32_punpckhbw128(dp, zero);
+                v8u16 alo = (v8u16)__builtin_ia32_pshufhw(__builtin_ia32_pshuflw((v8s)slo, 0xFF), 0xFF);
+                v8u16 ahi = (v8u16)__builtin_ia32_pshufhw(__builtin_ia32_pshuflw((v8s)shi, 0xFF), 0xFF);
+                v8u16 lo = div255_sse2(slo * alo + dlo * (full - alo));
+                v8u16 hi = div255_sse2(shi * ahi + dhi * (full - ahi));
+                *(v16u*)(d + i) = __builtin_ia32_packuswb128((v8s)lo, (v8s)hi) | opaque;
+            }
+            return i;
+        }
+
+        __attribute__((target("avx2"))) inline int blend_argb_avx2(uint32_t* d, const uint32_t* s, int n) {
+            v32 zero = {};
+            v32 opaque = (v32)((v8u32){} + 0xFF000000u);
+            v16u16 full = (v16u16){} + (uint16_t)255;
+            int i = 0;
+            for (; i + 8 <= n; i += 8) {
+                v32 sp = *(const v32u*)(s + i);
+                v8u32 alpha = (v8u32)sp >> 24;
+                if (__builtin_ia32_pmovmskb256((v32)(alpha == 0)) == -1) continue;
+                if (__builtin_ia32_pmovmskb256((v32)(alpha == 255)) == -1) {
+                    *(v32u*)(d + i) = sp;
+                    continue;
+                }
+                v32 dp = *(const v32u*)(d + i);
+                v16u16 slo = (v16u16)__builtin_ia32_punpcklbw256(sp, zero);
+                v16u16 shi = (v16u16)__builtin_ia32_punpckhbw256(sp, zero);
+                v16u16 dlo = (v16u16)__builtin_ia32_punpcklbw256(dp, zero);
+                v16u16 dhi = (v16u16)__builtin_ia32_punpckhbw256(dp, zero);
+                v16u16 alo = (v16u16)__builtin_ia32_pshufhw256(__builtin_ia32_pshuflw256((v16s)slo, 0xFF), 0xFF);
+                v16u16 ahi = (v16u16)__builtin_ia32_pshufhw256(__builtin_ia32_pshuflw256((v16s)shi, 0xFF), 0xFF);
+                v16u16 lo = div255_avx2(slo * alo + dlo * (full - alo));
+                v16u16 hi = div255_avx2(shi * ahi + dhi * (full - ahi));
+                *(v32u*)(d + i) = __builtin_ia32_packuswb256((v16s)lo, (v16s)hi) | opaque;
+            }
+            return i;
+        }
+
+        // Channels are 16.16 fixed point, starting at pixel 0 of the span
+        __attribute__((target("sse2"))) inline int gradient_sse2(uint32_t* d, int n, const int32_t start[3], const int32_t step[3]) {
+            v4i32 lane = {0, 1, 2, 3};
+            v4i32 r = start[0] + lane * step[0], g = start[1] + lane * step[1], b = start[2] + lane * step[2];
+            v4i32 r4 = (v4i32){} + step[0] * 4, g4 = (v4i32){} + step[1] * 4, b4 = (v4i32){} + step[2] * 4;
+            int i = 0;
+            for (; i + 4 <= n; i += 4) {
+                v4i32 px = ((r >> 16) << 16) | ((g >> 16) << 8) | (b >> 16);
+                *(v16u*)(d + i) = (v16)(px | (int32_t)0xFF000000);
+                r += r4; g += g4; b += b4;
+            }
+            return i;
+        }
+
+        __attribute__((target("avx2"))) inline int gradient_avx2(uint32_t* d, int n, const int32_t start[3], const int32_t step[3]) {
+            v8i32 lane = {0, 1, 2, 3, 4, 5, 6, 7};
+            v8i32 r = start[0] + lane * step[0], g = start[1] + lane * step[1], b = start[2] + lane * step[2];
+            v8i32 r8 = (v8i32){} + step[0] * 8, g8 = (v8i32){} + step[1] * 8, b8 = (v8i32){} + step[2] * 8;
+            int i = 0;
+            for (; i + 8 <= n; i += 8) {
+                v8i32 px = ((r >> 16) << 16) | ((g >> 16) << 8) | (b >> 16);
+                *(v32u*)(d + i) = (v32)(px | (int32_t)0xFF000000);
+                r += r8; g += g8; b += b8;
+            }
+            return i;
+        }
+        // Pixel i is s[(x + i * step) >> 16]. SSE2 has no gather, so the
+        // four loads are scalar and only the store is wide.
+        __attribute__((target("sse2"))) inline int scale_nearest_sse2(uint32_t* d, int n, const uint32_t* s, int32_t x, int32_t step) {
+            int i = 0;
+            for (; i + 4 <= n; i += 4, x += step * 4) {
+                v4u32 px = {s[x >> 16], s[(x + step) >> 16], s[(x + step * 2) >> 16], s[(x + step * 3) >> 16]};
+                *(v16u*)(d + i) = (v16)px;
+            }
+            return i;
+        }
+
+        __attribute__((target("avx2"))) inline int scale_nearest_avx2(uint32_t* d, int n, const uint32_t* s, int32_t x, int32_t step) {
+            v8i32 lane = {0, 1, 2, 3, 4, 5, 6, 7};
+            v8i32 pos = x + lane * step;
+            v8i32 step8 = (v8i32){} + step * 8;
+            v8i32 all = (v8i32){} - 1;
+            int i = 0;
+            for (; i + 8 <= n; i += 8) {
+                v8i32 px = __builtin_ia32_gathersiv8si((v8i32){}, (const int*)s, pos >> 16, all, 4);
+                *(v32u*)(d + i) = (v32)px;
+                pos += step8;
+            }
+            return i;
+        }
+
+        // Each of `count` source pixels twice / three times
+        __attribute__((target("sse2"))) inline int replicate2_sse2(uint32_t* d, const uint32_t* s, int count) {
+            int i = 0;
+            for (; i + 4 <= count; i += 4) {
+                v4i32 p = (v4i32)*(const v16u*)(s + i);
+                *(v16u*)(d + i * 2) = (v16)__builtin_ia32_punpckldq128(p, p);
+                *(v16u*)(d + i * 2 + 4) = (v16)__builtin_ia32_punpckhdq128(p, p);
+            }
+            return i;
+        }
+
+        __attribute__((target("sse2"))) inline int replicate3_sse2(uint32_t* d, const uint32_t* s, int count) {
+            int i = 0;
+            for (; i + 4 <= count; i += 4) {
+                v4i32 p = (v4i32)*(const v16u*)(s + i);
+                *(v16u*)(d + i * 3) = (v16)__builtin_ia32_pshufd(p, 0x40);      // 0 0 0 1
+                *(v16u*)(d + i * 3 + 4) = (v16)__builtin_ia32_pshufd(p, 0xA5);  // 1 1 2 2
+                *(v16u*)(d + i * 3 + 8) = (v16)__builtin_ia32_pshufd(p, 0xFE);  // 2 3 3 3
+            }
+            return i;
+        }
+
+        // Bilinear: pixel i lies between columns (x >> 16) and the next
+        // (clamped to `last`) of rows r0 and r1, at weight wy / 256 toward
+        // r1. One pixel's four neighbours fill a register: the rows are
+        // blended first, then the two columns they leave.
+        __attribute__((target("sse2"))) inline int scale_bilinear_sse2(uint32_t* d, int n, const uint32_t* r0, const uint32_t* r1,
+                                                                       int32_t x, int32_t step, int last, uint16_t wy) {
+            v16 zero = {};
+            v8u16 wtop = (v8u16){} + (uint16_t)(256 - wy);
+            v8u16 wbot = (v8u16){} + wy;
+            for (int i = 0; i < n; i++, x += step) {
+                int sx = x >> 16;
+                uint16_t wx = (x >> 8) & 0xFF;
+                if (sx < 0) { sx = 0; wx = 0; }
+                int sx1 = sx < last ? sx + 1 : last;
+                v16 p = (v16)(v4u32){r0[sx], r0[sx1], r1[sx], r1[sx1]};
+                v8u16 top = (v8u16)__builtin_ia32_punpcklbw128(p, zero);
+                v8u16 bot = (v8u16)__builtin_ia32_punpckhbw128(p, zero);
+                v8u16 v = (top * wtop + bot * wbot) >> 8;
+                uint16_t wl = 256 - wx;
+                v8u16 h = v * (v8u16){wl, wl, wl, wl, wx, wx, wx, wx};
+                h = (h + (v8u16)__builtin_ia32_pshufd((v4i32)h, 0x4E)) >> 8;
+                d[i] = ((v4u32)__builtin_ia32_packuswb128((v8s)h, (v8s)h))[0];
+            }
+            return n;
+        }
+
+        // Two pixels at a time, one in each 128-bit lane
+        __attribute__((target("avx2"))) inline int scale_bilinear_avx2(uint32_t* d, int n, const uint32_t* r0, const uint32_t* r1,
+                                                                       int32_t x, int32_t step, int last, uint16_t wy) {
+            v32 zero = {};
+            v16u16 wtop = (v16u16){} + (uint16_t)(256 - wy);
+            v16u16 wbot = (v16u16){} + wy;
+            int i = 0;
+            for (; i + 2 <= n; i += 2, x += step * 2) {
+                int sa = x >> 16, sb = (x + step) >> 16;
+                uint16_t wa = (x >> 8) & 0xFF, wb = ((x + step) >> 8) & 0xFF;
+                if (sa < 0) { sa = 0; wa = 0; }
+                if (sb < 0) { sb = 0; wb = 0; }
+                int sa1 = sa < last ? sa + 1 : last;
+                int sb1 = sb < last ? sb + 1 : last;
+                v32 p = (v32)(v8u32){r0[sa], r0[sa1], r1[sa], r1[sa1], r0[sb], r0[sb1], r1[sb], r1[sb1]};
+                v16u16 top = (v16u16)__builtin_ia32_punpcklbw256(p, zero);
+                v16u16 bot = (v16u16)__builtin_ia32_punpckhbw256(p, zero);
+                v16u16 v = (top * wtop + bot * wbot) >> 8;
+                uint16_t la = 256 - wa, lb = 256 - wb;
+                v16u16 h = v * (v16u16){la, la, la, la, wa, wa, wa, wa, lb, lb, lb, lb, wb, wb, wb, wb};
+                h = (h + (v16u16)__builtin_ia32_pshufd256((v8i32)h, 0x4E)) >> 8;
+                v8u32 out = (v8u32)__builtin_ia32_packuswb256((v16s)h, (v16s)h);
+                d[i] = out[0];
+                d[i + 1] = out[4];
+            }
+            return i;
+        }
+    }
+
+    inline uint32_t div255(uint32_t x) {
+        return (x + 1 + (x >> 8)) >> 8;
+    }
+
+    // Solid fill
+    inline void fill(uint32_t* d, uint32_t px, int n) {
+        if (n > 0) montauk::memset32(d, px, (uint64_t)n);
+    }
+
+    // Copy-blit; the spans must not overlap
+    inline void copy(uint32_t* d, const uint32_t* s, int n) {
+        if (n > 0) montauk::memcpy(d, s, (uint64_t)n * 4);
+    }
+
+    // Blend one colour over the span at its constant alpha
+    inline void blend(uint32_t* d, int n, Color c) {
+        if (n <= 0 || c.a == 0) return;
+        if (c.a == 255) { fill(d, c.to_pixel(), n); return; }
+
+        uint16_t a = c.a;
+        uint16_t sr = a * c.r, sg = a * c.g, sb = a * c.b;
+        uint16_t inv = 255 - a;
+
+        int i = (n >= 8 && montauk::simd::avx2()) ? simd::blend_avx2(d, n, sr, sg, sb, inv)
+                                                  : simd::blend_sse2(d, n, sr, sg, sb, inv);
+
+        for (; i < n; i++) {
+            uint32_t p = d[i];
+            uint32_t rr = div255(sr + inv * ((p >> 16) & 0xFF));
+            uint32_t gg = div255(sg + inv * ((p >> 8) & 0xFF));
+            uint32_t bb = div255(sb + inv * (p & 0xFF));
+            d[i] = 0xFF000000 | (rr << 16) | (gg << 8) | bb;
+        }
+    }
+
+    // Blend a span of ARGB source pixels over the span, each at its own alpha
+    inline void blend_argb(uint32_t* d, const uint32_t* s, int n) {
+        if (n <= 0) return;
+        int i = (n >= 8 && montauk::simd::avx2()) ? simd::blend_argb_avx2(d, s, n)
+                                                  : simd::blend_argb_sse2(d, s, n);
+
+        for (; i < n; i++) {
+            uint32_t src = s[i];
+            uint32_t a = src >> 24;
+            if (a == 0) continue;
+            if (a == 255) { d[i] = src; continue; }
+            uint32_t p = d[i];
+            uint32_t inv = 255 - a;
+            uint32_t rr = div255(a * ((src >> 16) & 0xFF) + inv * ((p >> 16) & 0xFF));
+            uint32_t gg = div255(a * ((src >> 8) & 0xFF) + inv * ((p >> 8) & 0xFF));
+            uint32_t bb = div255(a * (src & 0xFF) + inv * (p & 0xFF));
+            d[i] = 0xFF000000 | (rr << 16) | (gg << 8) | bb;
+        }
+    }
+
+    // The opaque colour `t` steps of `range` along from `from` to `to`
+    inline Color lerp(Color from, Color to, int t, int range) {
+        if (range < 1) range = 1;
+        return Color::from_rgb((uint8_t)(from.r + ((int)to.r - from.r) * t / range),
+                               (uint8_t)(from.g + ((int)to.g - from.g) * t / range),
+                               (uint8_t)(from.b + ((int)to.b - from.b) * t / range));
+    }
+
+    // Horizontal gradient: pixel 0 is `from`, pixel n - 1 is `to`
+    inline void gradient(uint32_t* d, int n, Color from, Color to) {
+        if (n <= 0) return;
+        int span = n > 1 ? n - 1 : 1;
+        int32_t start[3] = { (int32_t)from.r << 16, (int32_t)from.g << 16, (int32_t)from.b << 16 };
+        int32_t step[3] = {
+            (((int32_t)to.r - from.r) << 16) / span,
+            (((int32_t)to.g - from.g) << 16) / span,
+            (((int32_t)to.b - from.b) << 16) / span,
+        };
+
+        int i = (n >= 8 && montauk::simd::avx2()) ? simd::gradient_avx2(d, n, start, step)
+                                                  : simd::gradient_sse2(d, n, start, step);
+
+        for (; i < n; i++) {
+            uint32_t r = (uint32_t)(start[0] + i * step[0]) >> 16;
+            uint32_t g = (uint32_t)(start[1] + i * step[1]) >> 16;
+            uint32_t b = (uint32_t)(start[2] + i * step[2]) >> 16;
+            d[i] = 0xFF000000 | (r << 16) | (g << 8) | b;
+        }
+    }
+
+    // Nearest-neighbour scale: pixel i of the span is s[(x + i * step) >> 16],
+    // with x and step in 16.16 fixed point
+    inline void scale_nearest(uint32_t* d, int n, const uint32_t* s, int32_t x, int32_t step) {
+        if (n <= 0) return;
+        int i = (n >= 8 && montauk::simd::avx2()) ? simd::scale_nearest_avx2(d, n, s, x, step)
+                                                  : simd::scale_nearest_sse2(d, n, s, x, step);
+
+        for (x += i * step; i < n; i++, x += step) d[i] = s[x >> 16];
+    }
+
+    // Scale by a whole number `k`: every source pixel repeated k times. The
+    // span starts `phase` (< k) copies into s[0].
+    inline void scale_integer(uint32_t* d, int n, const uint32_t* s, int k, int phase) {
+        if (n <= 0) return;
+        if (k == 1) { copy(d, s, n); return; }
+
+        int i = 0;
+        if (phase > 0) {
+            for (; phase < k && i < n; phase++) d[i++] = *s;
+            s++;
+        }
+        int whole = (n - i) / k;
+        int done = k == 2 ? simd::replicate2_sse2(d + i, s, whole)
+                 : k == 3 ? simd::replicate3_sse2(d + i, s, whole) : 0;
+        i += done * k;
+        s += done;
+
+        for (int r = 0; i < n; i++) {
+            d[i] = *s;
+            if (++r == k) { r = 0; s++; }
+        }
+    }
+
+    // Bilinear scale of the row pair r0/r1, wy / 256 of the way to r1.
+    // Column positions are as for scale_nearest; a negative x clamps to
+    // column 0 and no column past `last` is read.
+    inline void scale_bilinear(uint32_t* d, int n, const uint32_t* r0, const uint32_t* r1,
+                               int32_t x, int32_t step, int last, uint16_t wy) {
+        if (n <= 0) return;
+        int i = (n >= 8 && montauk::simd::avx2()) ? simd::scale_bilinear_avx2(d, n, r0, r1, x, step, last, wy) : 0;
+        simd::scale_bilinear_sse2(d + i, n - i, r0, r1, x + i * step, step, last, wy);
+    }
+
+} // namespace gui::pixelops
@@ -0,0 +1,241 @@
+/*
+    * raster.hpp
+    * MontaukOS anti-aliased polygon rasterizer (signed-area coverage)
+    * Copyright (c) 2026 Daniel Hammer
+*/
+
+#pragma once
+#include <cstdint>
+#include <montauk/heap.h>
+#include <montauk/string.h>
+
+// Polygons are filled the way font rasterizers do it: each edge adds, to
+// every cell it passes through, the signed area it covers to its right.
+// A running sum along a row then gives each pixel's exact coverage, so a
+// shape costs time proportional to its edges plus the rows it touches,
+// not edges times rows, and comes out anti-aliased without supersampling.
+// The sum and the compositing that follows run four pixels at a time.
+namespace gui {
+
+    namespace raster_simd {
+        typedef float v4f __attribute__((vector_size(16)));
+        typedef int32_t v4i32 __attribute__((vector_size(16)));
+        typedef uint32_t v4u32 __attribute__((vector_size(16)));
+        typedef float v4fu __attribute__((vector_size(16), may_alias, aligned(1)));
+
+        // Per-lane coverage from running winding sums: nonzero, or even-odd
+        __attribute__((target("sse2"))) inline v4f coverage(v4f sum, bool even_odd) {
+            v4f a = (v4f)((v4u32)sum & 0x7FFFFFFFu);
+            if (even_odd) {
+                v4f half = a * 0.5f;
+                a -= __builtin_ia32_cvtdq2ps(__builtin_ia32_cvttps2dq(half)) * 2.0f;
+                return __builtin_ia32_minps(a, (v4f){} + 2.0f - a);
+            }
+            return __builtin_ia32_minps(a, (v4f){} + 1.0f);
+        }
+
+        // Straight-alpha `src over dst` for four pixels; sa is the source alpha in 0..1
+        __attribute__((target("sse2"))) inline v4u32 over(v4u32 dst, v4f sa, const v4f src[3]) {
+            v4f da = __builtin_ia32_cvtdq2ps((v4i32)(dst >> 24)) * (1.0f / 255.0f);
+            v4f dr = __builtin_ia32_cvtdq2ps((v4i32)((dst >> 16) & 0xFF));
+            v4f dg = __builtin_ia32_cvtdq2ps((v4i32)((dst >> 8) & 0xFF));
+            v4f db = __builtin_ia32_cvtdq2ps((v4i32)(dst & 0xFF));
+            v4f k = da * (1.0f - sa);
+            v4f oa = sa + k;
+            v4f inv = 1.0f / __builtin_ia32_maxps(oa, (v4f){} + 1e-6f);
+            v4i32 r = __builtin_ia32_cvtps2dq((src[0] * sa + dr * k) * inv);
+            v4i32 g = __builtin_ia32_cvtps2dq((src[1] * sa + dg * k) * inv);
+            v4i32 b = __builtin_ia32_cvtps2dq((src[2] * sa + db * k) * inv);
+            v4i32 a = __builtin_ia32_cvtps2dq(oa * 255.0f);
+            return (v4u32)((a << 24) | (r << 16) | (g << 8) | b);
+        }
+    }
+
+    struct CoverageRaster {
+        float* acc;        // `stride` cells per row, `h` rows, zero between fills
+        int w, h;
+        int stride;        // w + 2 rounded up to a multiple of 4
+        int capacity;      // cells allocated
+        int y_min, y_max;  // rows touched since the last fill
+
+        // Size the raster for a w x h area, reusing the buffer if it is big enough
+        bool init(int width, int height) {
+            int s = (width + 2 + 3) & ~3;
+            if (!acc || s * height > capacity) {
+                if (acc) montauk::mfree(acc);
+                capacity = s * height;
+                acc = (float*)montauk::malloc(capacity * sizeof(float));
+                if (!acc) {
+                    capacity = 0;
+                    return false;
+                }
+                montauk::memset(acc, 0, capacity * sizeof(float));
+            }
+            w = width;
+            h = height;
+            stride = s;
+            y_min = h;
+            y_max = 0;
+            return true;
+        }
+
+        void release() {
+            if (acc) montauk::mfree(acc);
+            acc = nullptr;
+            capacity = 0;
+        }
+
+        // Add the edge (x0, y0) -> (x1, y1), in pixels. Edges may run
+        // outside the raster; only winding direction matters.
+        void line(float x0, float y0, float x1, float y1) {
+            if (y0 == y1) return;
+            float dir = 1.0f;
+            if (y0 > y1) {
+                float t = x0; x0 = x1; x1 = t;
+                t = y0; y0 = y1; y1 = t;
+                dir = -1.0f;
+            }
+            if (y1 <= 0 || y0 >= (float)h) return;
+
+            float dxdy = (x1 - x0) / (y1 - y0);
+            float x = x0;
+            if (y0 < 0) {
+                x -= y0 * dxdy;
+                y0 = 0;
+            }
+            if (y1 > (float)h) y1 = (float)h;
+
+            int ys = (int)y0;
+            int ye = (int)y1;
+            if ((float)ye < y1) ye++;
+            if (ys < y_min) y_min = ys;
+            if (ye > y_max) y_max = ye;
+
+            float fw = (float)w;
+            for (int y = ys; y < ye; y++) {
+                float* row = acc + y * stride;
+                float top = y0 > (float)y ? y0 : (float)y;
+                float bottom = y1 < (float)(y + 1) ? y1 : (float)(y + 1);
+                float dy = bottom - top;
+                float xnext = x + dxdy * dy;
+                float d = dy * dir;
+
+                // Left of the raster is the same as at its edge; right of it does not matter
+                float xa = x < xnext ? x : xnext;
+                float xb = x < xnext ? xnext : x;
+                if (xa < 0) xa = 0;
+                if (xb < 0) xb = 0;
+                if (xa > fw) xa = fw;
+                if (xb > fw) xb = fw;
+
+                int xai = (int)xa;
+                int xbi = (int)xb;
+                if ((float)xbi < xb) xbi++;
+
+                if (xbi <= xai + 1) {
+                    // Within one cell: split by the mean x
+                    float xm = 0.5f * (xa + xb) - (float)xai;
+                    row[xai] += d - d * xm;
+                    row[xai + 1] += d * xm;
+                } else {
+                    float s = 1.0f / (xb - xa);
+                    float xaf = xa - (float)xai;
+                    float a0 = 0.5f * s * (1.0f - xaf) * (1.0f - xaf);
+                    float xbf = xb - (float)xbi + 1.0f;
+                    float am = 0.5f * s * xbf * xbf;
+                    row[xai] += d * a0;
+                    if (xbi == xai + 2) {
+                        row[xai + 1] += d * (1.0f - a0 - am);
+                    } else {
+                        float a1 = s * (1.5f - xaf);
+                        row[xai + 1] += d * (a1 - a0);
+                        for (int xi = xai + 2; xi < xbi - 1; xi++) row[xi] += d * s;
+                        float a2 = a1 + (float)(xbi - xai - 3) * s;
+                        row[xbi - 1] += d * (1.0f - a2 - am);
+                    }
+                    row[xbi] += d * am;
+                }
+                x = xnext;
+            }
+        }
+
+        // Add a line of the given width from (x0, y0) to (x1, y1), with butt ends
+        void stroke(float x0, float y0, float x1, float y1, float width) {
+            float dx = x1 - x0, dy = y1 - y0;
+            float len2 = dx * dx + dy * dy;
+            if (len2 == 0) return;
+            float len = __builtin_ia32_sqrtss((raster_simd::v4f){len2, 0, 0, 0})[0];
+            float nx = -dy / len * width * 0.5f;
+            float ny = dx / len * width * 0.5f;
+            line(x0 + nx, y0 + ny, x1 + nx, y1 + ny);
+            line(x1 + nx, y1 + ny, x1 - nx, y1 - ny);
+            line(x1 - nx, y1 - ny, x0 - nx, y0 - ny);
+            line(x0 - nx, y0 - ny, x0 + nx, y0 + ny);
+        }
+
+        // Composite what the edges enclose in `color` (0xRRGGBB) at `opacity`
+        // (0..255) over the straight-alpha ARGB buffer `pixels` (buf_w x buf_h),
+        // with the raster's origin at (ox, oy), and clear the raster
+        __attribute__((target("sse2")))
+        void fill(uint32_t* pixels, int buf_w, int buf_h, int ox, int oy,
+                  uint32_t color, int opacity, bool even_odd = false) {
+            using namespace raster_simd;
+            v4f src[3] = {(v4f){} + (float)((color >> 16) & 0xFF),
+                          (v4f){} + (float)((color >> 8) & 0xFF),
+                          (v4f){} + (float)(color & 0xFF)};
+            float op = (float)opacity * (1.0f / 255.0f);
+            v4u32 solid = (v4u32){} + (0xFF000000u | (color & 0xFFFFFF));
+            v4f zero = {};
+
+            for (int y = y_min; y < y_max; y++) {
+                float* row = acc + y * stride;
+                int dy = oy + y;
+                bool visible = dy >= 0 && dy < buf_h;
+                uint32_t* dst = visible ? pixels + dy * buf_w + ox : nullptr;
+                v4f carry = zero;
+
+                for (int x = 0; x < stride; x += 4) {
+                    // Running sum within the group, plus everything to its left
+                    v4f v = *(const v4fu*)(row + x);
+                    v += __builtin_shuffle(v, zero, (v4i32){4, 0, 1, 2});
+                    v += __builtin_shuffle(v, zero, (v4i32){4, 4, 0, 1});
+                    v += carry;
+                    carry = __builtin_shuffle(v, (v4i32){3, 3, 3, 3});
+                    *(v4fu*)(row + x) = zero;
+
+                    if (!visible || x >= w) continue;
+                    v4f sa = coverage(v, even_odd) * op;
+                    int live = __builtin_ia32_movmskps((v4f)(sa > 1.0f / 512.0f));
+                    if (live == 0) continue;
+
+                    int dx = ox + x;
+                    if (x + 4 <= w && dx >= 0 && dx + 4 <= buf_w) {
+                        v4u32* p = (v4u32*)(dst + x);
+                        if (__builtin_ia32_movmskps((v4f)(sa >= 1.0f)) == 0xF) {
+                            __builtin_memcpy(p, &solid, 16);
+                        } else {
+                            v4u32 d;
+                            __builtin_memcpy(&d, p, 16);
+                            d = over(d, sa, src);
+                            __builtin_memcpy(p, &d, 16);
+                        }
+                        continue;
+                    }
+
+                    // Clipped group: composite the lanes that land in the buffer
+                    v4u32 d = {};
+                    for (int i = 0; i < 4; i++) {
+                        if (x + i < w && dx + i >= 0 && dx + i < buf_w) d[i] = dst[x + i];
+                    }
+                    d = over(d, sa, src);
+                    for (int i = 0; i < 4; i++) {
+                        if (x + i < w && dx + i >= 0 && dx + i < buf_w) dst[x + i] = d[i];
+                    }
+                }
+            }
+            y_min = h;
+            y_max = 0;
+        }
+    };
+
+}
@@ -19,9 +19,14 @@ struct WsWindow {
     int height;
     int scale_factor;
     bool closed;
+    // Cursor style last asked for; sent to the server with the next
+    // present, or once the event queue runs dry
+    int cursor;
+    bool cursor_pending;
 
     WsWindow()
-        : id(-1), pixels(nullptr), width(0), height(0), scale_factor(1), closed(false) {}
+        : id(-1), pixels(nullptr), width(0), height(0), scale_factor(1), closed(false),
+          cursor(0), cursor_pending(false) {}
 
     bool create(const char* title, int w, int h) {
         Montauk::WinCreateResult wres;
@@ -41,6 +46,7 @@ struct WsWindow {
         if (id < 0 || closed) return -1;
 
         int r = montauk::win_poll(id, ev);
+        if (r == 0) flush_cursor();
         if (r <= 0) return r;
 
         if (ev->type == 2) {
@@ -60,14 +66,45 @@ struct WsWindow {
         return Canvas(pixels, width, height);
     }
 
-    void present() const {
-        if (id >= 0)
-            montauk::win_present(id);
+    void present() {
+        if (id < 0) return;
+        Montauk::BatchCall call = {Montauk::SYS_WINPRESENT, {(uint64_t)id}, 0};
+        submit_with_cursor(call);
     }
 
-    void set_cursor(int cursor) const {
-        if (id >= 0)
-            montauk::win_setcursor(id, cursor);
+    // Present a frame of which only `rects` changed. Afterwards `pixels`
+    // holds the frame just presented, so the next one can be drawn over it.
+    void present(const Montauk::WinRect* rects, int count) {
+        if (id < 0) return;
+        Montauk::BatchCall call = {Montauk::SYS_WINPRESENTRECTS, {(uint64_t)id, (uint64_t)rects, (uint64_t)count}, 0};
+        submit_with_cursor(call);
+    }
+
+    // Apps set the cursor on every mouse event; only a change is sent
+    void set_cursor(int style) {
+        if (id < 0 || (style == cursor && !cursor_pending)) return;
+        cursor = style;
+        cursor_pending = true;
+    }
+
+    void flush_cursor() {
+        if (!cursor_pending || id < 0) return;
+        montauk::win_setcursor(id, cursor);
+        cursor_pending = false;
+    }
+
+    // Make `call`, along with a pending cursor change, in one kernel entry
+    void submit_with_cursor(Montauk::BatchCall& call) {
+        if (!cursor_pending) {
+            montauk::syscall3(call.nr, call.args[0], call.args[1], call.args[2]);
+            return;
+        }
+        Montauk::BatchCall calls[2] = {
+            {Montauk::SYS_WINSETCURSOR, {(uint64_t)id, (uint64_t)cursor}, 0},
+            call,
+        };
+        montauk::batch(calls, 2);
+        cursor_pending = false;
     }
 
     void destroy() {
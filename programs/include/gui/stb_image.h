@@ -421,6 +421,21 @@ typedef struct
 //
 
 STBIDEF stbi_uc *stbi_load_from_memory   (stbi_uc           const *buffer, int len   , int *x, int *y, int *channels_in_file, int desired_channels);
+
+// MontaukOS: decode a JPEG at 1/(1 << scale_shift) of its size (scale_shift
+// 0..3) with a reduced-size IDCT, keeping only the part that covers the
+// full-size pixel region (rx, ry, rw, rh); rw == 0 keeps everything. The
+// region is widened to whole MCUs, and where it starts in the scaled image
+// is returned in *out_x0, *out_y0; *x, *y get the size of what is returned.
+STBIDEF stbi_uc *stbi_load_jpeg_region_from_memory(stbi_uc const *buffer, int len, int scale_shift,
+                                                   int rx, int ry, int rw, int rh, int *out_x0, int *out_y0,
+                                                   int *x, int *y, int *channels_in_file, int desired_channels);
+// MontaukOS: as stbi_load_jpeg_region_from_memory, but the pixels come out
+// as 32-bit 0xAARRGGBB words (B, G, R, A bytes), ready to draw, without a
+// separate pass to swap red and blue. Free with stbi_image_free.
+STBIDEF unsigned int *stbi_load_jpeg_argb_from_memory(stbi_uc const *buffer, int len, int scale_shift,
+                                                     int rx, int ry, int rw, int rh, int *out_x0, int *out_y0,
+                                                     int *x, int *y);
 STBIDEF stbi_uc *stbi_load_from_callbacks(stbi_io_callbacks const *clbk  , void *user, int *x, int *y, int *channels_in_file, int desired_channels);
 
 #ifndef STBI_NO_STDIO
@@ -1994,9 +2009,16 @@ typedef struct
    int scan_n, order[4];
    int restart_interval, todo;
 
+// MontaukOS: reduced-size and cropped decoding
+   int scale_shift;                       // blocks are stored (8 >> scale_shift) pixels square
+   int region_x, region_y, region_w, region_h;   // requested, in pixels (region_w == 0: all)
+   int crop_x0, crop_y0, crop_x1, crop_y1;       // kept, in MCUs
+   int bgra;                              // 4 channels are stored B, G, R, A
+
 // kernels
    void (*idct_block_kernel)(stbi_uc *out, int out_stride, short data[64]);
-   void (*YCbCr_to_RGB_kernel)(stbi_uc *out, const stbi_uc *y, const stbi_uc *pcb, const stbi_uc *pcr, int count, int step);
+   void (*YCbCr_to_RGB_kernel)(stbi_uc *out, const stbi_uc *y, const stbi_uc *pcb, const stbi_uc *pcr, int count, int step, int bgr);
+   stbi_uc *(*resample_row_h_2_kernel)(stbi_uc *out, stbi_uc *in_near, stbi_uc *in_far, int w, int hs);
    stbi_uc *(*resample_row_hv_2_kernel)(stbi_uc *out, stbi_uc *in_near, stbi_uc *in_far, int w, int hs);
 } stbi__jpeg;
 
@@ -2523,6 +2545,59 @@ static void stbi__idct_block(stbi_uc *out, int out_stride, short data[64])
    }
 }
 
+// MontaukOS: reduced-size IDCTs. An n x n block (n = 4, 2, 1) is the
+// 8x8 block's low n x n frequencies put through an n-point IDCT, which
+// samples the full block's reconstruction at the centres of n x n cells.
+static const float stbi__idct4_table[16] = {
+   0.35355339f,  0.46193977f,  0.35355339f,  0.19134172f,
+   0.35355339f,  0.19134172f, -0.35355339f, -0.46193977f,
+   0.35355339f, -0.19134172f, -0.35355339f,  0.46193977f,
+   0.35355339f, -0.46193977f,  0.35355339f, -0.19134172f,
+};
+
+static const float stbi__idct2_table[4] = {
+   0.35355339f,  0.35355339f,
+   0.35355339f, -0.35355339f,
+};
+
+static void stbi__idct_reduced(stbi_uc *out, int out_stride, short data[64], const float *t, int n)
+{
+   float tmp[16];
+   int x, y, u, v;
+   // vertical pass: tmp[y][u] for each of the n lowest horizontal frequencies
+   for (u=0; u < n; ++u) {
+      for (y=0; y < n; ++y) {
+         float sum = 0;
+         for (v=0; v < n; ++v) sum += t[y*n + v] * data[v*8 + u];
+         tmp[y*n + u] = sum;
+      }
+   }
+   for (y=0; y < n; ++y, out += out_stride) {
+      for (x=0; x < n; ++x) {
+         float sum = 128.5f;
+         for (u=0; u < n; ++u) sum += t[x*n + u] * tmp[y*n + u];
+         out[x] = sum <= 0 ? 0 : stbi__clamp((int) sum);
+      }
+   }
+}
+
+static void stbi__idct_block_4x4(stbi_uc *out, int out_stride, short data[64])
+{
+   stbi__idct_reduced(out, out_stride, data, stbi__idct4_table, 4);
+}
+
+static void stbi__idct_block_2x2(stbi_uc *out, int out_stride, short data[64])
+{
+   stbi__idct_reduced(out, out_stride, data, stbi__idct2_table, 2);
+}
+
+static void stbi__idct_block_1x1(stbi_uc *out, int out_stride, short data[64])
+{
+   // just the DC term: the block's mean
+   STBI_NOTUSED(out_stride);
+   out[0] = stbi__clamp((data[0] + 4 + 1024) >> 3);
+}
+
 #ifdef STBI_SSE2
 // sse2 integer IDCT. not the fastest possible implementation but it
 // produces bit-identical results to the generic C version so it's
@@ -2946,6 +3021,18 @@ static void stbi__jpeg_reset(stbi__jpeg *j)
    // since we don't even allow 1<<30 pixels
 }
 
+// MontaukOS: where block (x2, y2) of component n, in full-size component
+// pixels, is stored, or NULL if it lies outside the kept region
+static stbi_uc *stbi__jpeg_block_out(stbi__jpeg *z, int n, int x2, int y2)
+{
+   int bw = z->img_comp[n].h * 8, bh = z->img_comp[n].v * 8;
+   int mx = x2 / bw, my = y2 / bh;
+   if (mx < z->crop_x0 || mx >= z->crop_x1 || my < z->crop_y0 || my >= z->crop_y1) return NULL;
+   x2 -= z->crop_x0 * bw;
+   y2 -= z->crop_y0 * bh;
+   return z->img_comp[n].data + z->img_comp[n].w2 * (y2 >> z->scale_shift) + (x2 >> z->scale_shift);
+}
+
 static int stbi__parse_entropy_coded_data(stbi__jpeg *z)
 {
    stbi__jpeg_reset(z);
@@ -2963,8 +3050,10 @@ static int stbi__parse_entropy_coded_data(stbi__jpeg *z)
          for (j=0; j < h; ++j) {
             for (i=0; i < w; ++i) {
                int ha = z->img_comp[n].ha;
+               stbi_uc *out;
                if (!stbi__jpeg_decode_block(z, data, z->huff_dc+z->img_comp[n].hd, z->huff_ac+ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq])) return 0;
-               z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*j*8+i*8, z->img_comp[n].w2, data);
+               out = stbi__jpeg_block_out(z, n, i*8, j*8);
+               if (out) z->idct_block_kernel(out, z->img_comp[n].w2, data);
                // every data block is an MCU, so countdown the restart interval
                if (--z->todo <= 0) {
                   if (z->code_bits < 24) stbi__grow_buffer_unsafe(z);
@@ -2991,8 +3080,10 @@ static int stbi__parse_entropy_coded_data(stbi__jpeg *z)
                         int x2 = (i*z->img_comp[n].h + x)*8;
                         int y2 = (j*z->img_comp[n].v + y)*8;
                         int ha = z->img_comp[n].ha;
+                        stbi_uc *out;
                         if (!stbi__jpeg_decode_block(z, data, z->huff_dc+z->img_comp[n].hd, z->huff_ac+ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq])) return 0;
-                        z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*y2+x2, z->img_comp[n].w2, data);
+                        out = stbi__jpeg_block_out(z, n, x2, y2);
+                        if (out) z->idct_block_kernel(out, z->img_comp[n].w2, data);
                      }
                   }
                }
@@ -3088,8 +3179,10 @@ static void stbi__jpeg_finish(stbi__jpeg *z)
          for (j=0; j < h; ++j) {
             for (i=0; i < w; ++i) {
                short *data = z->img_comp[n].coeff + 64 * (i + j * z->img_comp[n].coeff_w);
+               stbi_uc *out = stbi__jpeg_block_out(z, n, i*8, j*8);
+               if (!out) continue;
                stbi__jpeg_dequantize(data, z->dequant[z->img_comp[n].tq]);
-               z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*j*8+i*8, z->img_comp[n].w2, data);
+               z->idct_block_kernel(out, z->img_comp[n].w2, data);
             }
          }
       }
@@ -3261,6 +3354,11 @@ static int stbi__free_jpeg_components(stbi__jpeg *z, int ncomp, int why)
    return why;
 }
 
+static int stbi__jpeg_clampi(int v, int lo, int hi)
+{
+   return v < lo ? lo : (v > hi ? hi : v);
+}
+
 static int stbi__process_frame_header(stbi__jpeg *z, int scan)
 {
    stbi__context *s = z->s;
@@ -3318,6 +3416,18 @@ static int stbi__process_frame_header(stbi__jpeg *z, int scan)
    z->img_mcu_x = (s->img_x + z->img_mcu_w-1) / z->img_mcu_w;
    z->img_mcu_y = (s->img_y + z->img_mcu_h-1) / z->img_mcu_h;
 
+   // MontaukOS: the MCUs covering the requested region are kept
+   z->crop_x0 = 0;
+   z->crop_y0 = 0;
+   z->crop_x1 = z->img_mcu_x;
+   z->crop_y1 = z->img_mcu_y;
+   if (z->region_w > 0 && z->region_h > 0) {
+      z->crop_x0 = stbi__jpeg_clampi(z->region_x / z->img_mcu_w, 0, z->img_mcu_x - 1);
+      z->crop_y0 = stbi__jpeg_clampi(z->region_y / z->img_mcu_h, 0, z->img_mcu_y - 1);
+      z->crop_x1 = stbi__jpeg_clampi((z->region_x + z->region_w + z->img_mcu_w-1) / z->img_mcu_w, z->crop_x0 + 1, z->img_mcu_x);
+      z->crop_y1 = stbi__jpeg_clampi((z->region_y + z->region_h + z->img_mcu_h-1) / z->img_mcu_h, z->crop_y0 + 1, z->img_mcu_y);
+   }
+
    for (i=0; i < s->img_n; ++i) {
       // number of effective pixels (e.g. for non-interleaved MCU)
       z->img_comp[i].x = (s->img_x * z->img_comp[i].h + h_max-1) / h_max;
@@ -3329,8 +3439,8 @@ static int stbi__process_frame_header(stbi__jpeg *z, int scan)
       //
       // img_mcu_x, img_mcu_y: <=17 bits; comp[i].h and .v are <=4 (checked earlier)
       // so these muls can't overflow with 32-bit ints (which we require)
-      z->img_comp[i].w2 = z->img_mcu_x * z->img_comp[i].h * 8;
-      z->img_comp[i].h2 = z->img_mcu_y * z->img_comp[i].v * 8;
+      z->img_comp[i].w2 = ((z->crop_x1 - z->crop_x0) * z->img_comp[i].h * 8) >> z->scale_shift;
+      z->img_comp[i].h2 = ((z->crop_y1 - z->crop_y0) * z->img_comp[i].v * 8) >> z->scale_shift;
       z->img_comp[i].coeff = 0;
       z->img_comp[i].raw_coeff = 0;
       z->img_comp[i].linebuf = NULL;
@@ -3340,10 +3450,11 @@ static int stbi__process_frame_header(stbi__jpeg *z, int scan)
       // align blocks for idct using mmx/sse
       z->img_comp[i].data = (stbi_uc*) (((size_t) z->img_comp[i].raw_data + 15) & ~15);
       if (z->progressive) {
-         // w2, h2 are multiples of 8 (see above)
-         z->img_comp[i].coeff_w = z->img_comp[i].w2 / 8;
-         z->img_comp[i].coeff_h = z->img_comp[i].h2 / 8;
-         z->img_comp[i].raw_coeff = stbi__malloc_mad3(z->img_comp[i].w2, z->img_comp[i].h2, sizeof(short), 15);
+         // MontaukOS: coefficients cover the whole image, as refinement
+         // scans depend on every block's earlier ones
+         z->img_comp[i].coeff_w = z->img_mcu_x * z->img_comp[i].h;
+         z->img_comp[i].coeff_h = z->img_mcu_y * z->img_comp[i].v;
+         z->img_comp[i].raw_coeff = stbi__malloc_mad3(z->img_comp[i].coeff_w * 8, z->img_comp[i].coeff_h * 8, sizeof(short), 15);
          if (z->img_comp[i].raw_coeff == NULL)
             return stbi__free_jpeg_components(z, i+1, stbi__err("outofmem", "Out of memory"));
          z->img_comp[i].coeff = (short*) (((size_t) z->img_comp[i].raw_coeff + 15) & ~15);
@@ -3500,6 +3611,53 @@ static stbi_uc*  stbi__resample_row_h_2(stbi_uc *out, stbi_uc *in_near, stbi_uc
    return out;
 }
 
+#if defined(STBI_SSE2)
+// MontaukOS: 4:2:2 chroma upsampling, 8 input samples at a time; the
+// results match stbi__resample_row_h_2 exactly
+static stbi_uc*  stbi__resample_row_h_2_simd(stbi_uc *out, stbi_uc *in_near, stbi_uc *in_far, int w, int hs)
+{
+   int i;
+   stbi_uc *input = in_near;
+
+   if (w == 1) {
+      out[0] = out[1] = input[0];
+      return out;
+   }
+
+   out[0] = input[0];
+   out[1] = stbi__div4(input[0]*3 + input[1] + 2);
+
+   // each group reads input[i-1] .. input[i+8], so stop short of the end
+   for (i=1; i + 8 < w; i += 8) {
+      __m128i zero  = _mm_setzero_si128();
+      __m128i prev  = _mm_unpacklo_epi8(_mm_loadl_epi64((__m128i *) (input + i - 1)), zero);
+      __m128i curr  = _mm_unpacklo_epi8(_mm_loadl_epi64((__m128i *) (input + i)), zero);
+      __m128i next  = _mm_unpacklo_epi8(_mm_loadl_epi64((__m128i *) (input + i + 1)), zero);
+
+      // even = (3*cur + prev + 2) >> 2, odd = (3*cur + next + 2) >> 2
+      __m128i n     = _mm_add_epi16(_mm_add_epi16(curr, _mm_slli_epi16(curr, 1)), _mm_set1_epi16(2));
+      __m128i even  = _mm_srli_epi16(_mm_add_epi16(n, prev), 2);
+      __m128i odd   = _mm_srli_epi16(_mm_add_epi16(n, next), 2);
+
+      __m128i outv  = _mm_packus_epi16(_mm_unpacklo_epi16(even, odd), _mm_unpackhi_epi16(even, odd));
+      _mm_storeu_si128((__m128i *) (out + i*2), outv);
+   }
+
+   for (; i < w-1; ++i) {
+      int n = 3*input[i]+2;
+      out[i*2+0] = stbi__div4(n+input[i-1]);
+      out[i*2+1] = stbi__div4(n+input[i+1]);
+   }
+   out[i*2+0] = stbi__div4(input[w-2]*3 + input[w-1] + 2);
+   out[i*2+1] = input[w-1];
+
+   STBI_NOTUSED(in_far);
+   STBI_NOTUSED(hs);
+
+   return out;
+}
+#endif
+
 #define stbi__div16(x) ((stbi_uc) ((x) >> 4))
 
 static stbi_uc *stbi__resample_row_hv_2(stbi_uc *out, stbi_uc *in_near, stbi_uc *in_far, int w, int hs)
@@ -3657,9 +3815,10 @@ static stbi_uc *stbi__resample_row_generic(stbi_uc *out, stbi_uc *in_near, stbi_
 // this is a reduced-precision calculation of YCbCr-to-RGB introduced
 // to make sure the code produces the same results in both SIMD and scalar
 #define stbi__float2fixed(x)  (((int) ((x) * 4096.0f + 0.5f)) << 8)
-static void stbi__YCbCr_to_RGB_row(stbi_uc *out, const stbi_uc *y, const stbi_uc *pcb, const stbi_uc *pcr, int count, int step)
+// MontaukOS: `bgr` stores blue first, for 0xAARRGGBB pixels
+static void stbi__YCbCr_to_RGB_row(stbi_uc *out, const stbi_uc *y, const stbi_uc *pcb, const stbi_uc *pcr, int count, int step, int bgr)
 {
-   int i;
+   int i, ri = bgr ? 2 : 0, bi = bgr ? 0 : 2;
    for (i=0; i < count; ++i) {
       int y_fixed = (y[i] << 20) + (1<<19); // rounding
       int r,g,b;
@@ -3674,18 +3833,18 @@ static void stbi__YCbCr_to_RGB_row(stbi_uc *out, const stbi_uc *y, const stbi_uc
       if ((unsigned) r > 255) { if (r < 0) r = 0; else r = 255; }
       if ((unsigned) g > 255) { if (g < 0) g = 0; else g = 255; }
       if ((unsigned) b > 255) { if (b < 0) b = 0; else b = 255; }
-      out[0] = (stbi_uc)r;
+      out[ri] = (stbi_uc)r;
       out[1] = (stbi_uc)g;
-      out[2] = (stbi_uc)b;
+      out[bi] = (stbi_uc)b;
       out[3] = 255;
       out += step;
    }
 }
 
 #if defined(STBI_SSE2) || defined(STBI_NEON)
-static void stbi__YCbCr_to_RGB_simd(stbi_uc *out, stbi_uc const *y, stbi_uc const *pcb, stbi_uc const *pcr, int count, int step)
+static void stbi__YCbCr_to_RGB_simd(stbi_uc *out, stbi_uc const *y, stbi_uc const *pcb, stbi_uc const *pcr, int count, int step, int bgr)
 {
-   int i = 0;
+   int i = 0, ri = bgr ? 2 : 0, bi = bgr ? 0 : 2;
 
 #ifdef STBI_SSE2
    // step == 3 is pretty ugly on the final interleave, and i'm not convinced
@@ -3730,8 +3889,8 @@ static void stbi__YCbCr_to_RGB_simd(stbi_uc *out, stbi_uc const *y, stbi_uc cons
          __m128i bw = _mm_srai_epi16(bws, 4);
          __m128i gw = _mm_srai_epi16(gws, 4);
 
-         // back to byte, set up for transpose
-         __m128i brb = _mm_packus_epi16(rw, bw);
+         // back to byte, set up for transpose (blue first for BGRA)
+         __m128i brb = bgr ? _mm_packus_epi16(bw, rw) : _mm_packus_epi16(rw, bw);
          __m128i gxb = _mm_packus_epi16(gw, xw);
 
          // transpose to interleave channels
@@ -3782,9 +3941,9 @@ static void stbi__YCbCr_to_RGB_simd(stbi_uc *out, stbi_uc const *y, stbi_uc cons
 
          // undo scaling, round, convert to byte
          uint8x8x4_t o;
-         o.val[0] = vqrshrun_n_s16(rws, 4);
+         o.val[ri] = vqrshrun_n_s16(rws, 4);
          o.val[1] = vqrshrun_n_s16(gws, 4);
-         o.val[2] = vqrshrun_n_s16(bws, 4);
+         o.val[bi] = vqrshrun_n_s16(bws, 4);
          o.val[3] = vdup_n_u8(255);
 
          // store, interleaving r/g/b/a
@@ -3808,9 +3967,9 @@ static void stbi__YCbCr_to_RGB_simd(stbi_uc *out, stbi_uc const *y, stbi_uc cons
       if ((unsigned) r > 255) { if (r < 0) r = 0; else r = 255; }
       if ((unsigned) g > 255) { if (g < 0) g = 0; else g = 255; }
       if ((unsigned) b > 255) { if (b < 0) b = 0; else b = 255; }
-      out[0] = (stbi_uc)r;
+      out[ri] = (stbi_uc)r;
       out[1] = (stbi_uc)g;
-      out[2] = (stbi_uc)b;
+      out[bi] = (stbi_uc)b;
       out[3] = 255;
       out += step;
    }
@@ -3822,12 +3981,14 @@ static void stbi__setup_jpeg(stbi__jpeg *j)
 {
    j->idct_block_kernel = stbi__idct_block;
    j->YCbCr_to_RGB_kernel = stbi__YCbCr_to_RGB_row;
+   j->resample_row_h_2_kernel = stbi__resample_row_h_2;
    j->resample_row_hv_2_kernel = stbi__resample_row_hv_2;
 
 #ifdef STBI_SSE2
    if (stbi__sse2_available()) {
       j->idct_block_kernel = stbi__idct_simd;
       j->YCbCr_to_RGB_kernel = stbi__YCbCr_to_RGB_simd;
+      j->resample_row_h_2_kernel = stbi__resample_row_h_2_simd;
       j->resample_row_hv_2_kernel = stbi__resample_row_hv_2_simd;
    }
 #endif
@@ -3864,7 +4025,7 @@ static stbi_uc stbi__blinn_8x8(stbi_uc x, stbi_uc y)
 
 static stbi_uc *load_jpeg_image(stbi__jpeg *z, int *out_x, int *out_y, int *comp, int req_comp)
 {
-   int n, decode_n, is_rgb;
+   int n, decode_n, is_rgb, bgr;
    z->s->img_n = 0; // make stbi__cleanup_jpeg safe
 
    // validate req_comp
@@ -3873,6 +4034,20 @@ static stbi_uc *load_jpeg_image(stbi__jpeg *z, int *out_x, int *out_y, int *comp
    // load a jpeg image from whichever source, but leave in YCbCr format
    if (!stbi__decode_jpeg_image(z)) { stbi__cleanup_jpeg(z); return NULL; }
 
+   // MontaukOS: from here on the image is the kept region, at the decoded scale
+   if (z->scale_shift || z->region_w > 0) {
+      int s = z->scale_shift, round = (1 << s) - 1;
+      int x0 = z->crop_x0 * z->img_mcu_w, y0 = z->crop_y0 * z->img_mcu_h;
+      int x1 = stbi__jpeg_clampi(z->crop_x1 * z->img_mcu_w, x0, z->s->img_x);
+      int y1 = stbi__jpeg_clampi(z->crop_y1 * z->img_mcu_h, y0, z->s->img_y);
+      z->s->img_x = ((x1 + round) >> s) - (x0 >> s);
+      z->s->img_y = ((y1 + round) >> s) - (y0 >> s);
+      for (n=0; n < z->s->img_n; ++n) {
+         z->img_comp[n].x = (z->s->img_x * z->img_comp[n].h + z->img_h_max-1) / z->img_h_max;
+         z->img_comp[n].y = (z->s->img_y * z->img_comp[n].v + z->img_v_max-1) / z->img_v_max;
+      }
+   }
+
    // determine actual number of components to generate
    n = req_comp ? req_comp : z->s->img_n >= 3 ? 3 : 1;
 
@@ -3913,11 +4088,15 @@ static stbi_uc *load_jpeg_image(stbi__jpeg *z, int *out_x, int *out_y, int *comp
 
          if      (r->hs == 1 && r->vs == 1) r->resample = resample_row_1;
          else if (r->hs == 1 && r->vs == 2) r->resample = stbi__resample_row_v_2;
-         else if (r->hs == 2 && r->vs == 1) r->resample = stbi__resample_row_h_2;
+         else if (r->hs == 2 && r->vs == 1) r->resample = z->resample_row_h_2_kernel;
          else if (r->hs == 2 && r->vs == 2) r->resample = z->resample_row_hv_2_kernel;
          else                               r->resample = stbi__resample_row_generic;
       }
 
+      // MontaukOS: the colour kernels store BGRA themselves; rows made
+      // any other way (RGB, CMYK, YCCK, grey) get red and blue swapped
+      bgr = z->bgra && n == 4;
+
       // can't error after this so, this is safe
       output = (stbi_uc *) stbi__malloc_mad3(n, z->s->img_x, z->s->img_y, 1);
       if (!output) { stbi__cleanup_jpeg(z); return stbi__errpuc("outofmem", "Out of memory"); }
@@ -3951,7 +4130,7 @@ static stbi_uc *load_jpeg_image(stbi__jpeg *z, int *out_x, int *out_y, int *comp
                      out += n;
                   }
                } else {
-                  z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n);
+                  z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n, bgr);
                }
             } else if (z->s->img_n == 4) {
                if (z->app14_color_transform == 0) { // CMYK
@@ -3964,7 +4143,7 @@ static stbi_uc *load_jpeg_image(stbi__jpeg *z, int *out_x, int *out_y, int *comp
                      out += n;
                   }
                } else if (z->app14_color_transform == 2) { // YCCK
-                  z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n);
+                  z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n, bgr);
                   for (i=0; i < z->s->img_x; ++i) {
                      stbi_uc m = coutput[3][i];
                      out[0] = stbi__blinn_8x8(255 - out[0], m);
@@ -3973,7 +4152,7 @@ static stbi_uc *load_jpeg_image(stbi__jpeg *z, int *out_x, int *out_y, int *comp
                      out += n;
                   }
                } else { // YCbCr + alpha?  Ignore the fourth channel for now
-                  z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n);
+                  z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n, bgr);
                }
             } else
                for (i=0; i < z->s->img_x; ++i) {
@@ -3981,6 +4160,12 @@ static stbi_uc *load_jpeg_image(stbi__jpeg *z, int *out_x, int *out_y, int *comp
                   out[3] = 255; // not used if n==3
                   out += n;
                }
+            if (bgr && (is_rgb || (z->s->img_n == 4 && z->app14_color_transform == 0))) {
+               stbi_uc *row = output + n * z->s->img_x * j;
+               for (i=0; i < z->s->img_x; ++i, row += 4) {
+                  stbi_uc t = row[0]; row[0] = row[2]; row[2] = t;
+               }
+            }
          } else {
             if (is_rgb) {
                if (n == 1)
@@ -4039,6 +4224,56 @@ static void *stbi__jpeg_load(stbi__context *s, int *x, int *y, int *comp, int re
    return result;
 }
 
+static stbi_uc *stbi__load_jpeg_region(stbi_uc const *buffer, int len, int scale_shift,
+                                      int rx, int ry, int rw, int rh, int *out_x0, int *out_y0,
+                                      int *x, int *y, int *comp, int req_comp, int bgra)
+{
+   stbi__context s;
+   stbi_uc *result;
+   stbi__jpeg *j;
+   if (scale_shift < 0 || scale_shift > 3) return stbi__errpuc("bad scale", "Unsupported JPEG scale");
+   stbi__start_mem(&s, buffer, len);
+   j = (stbi__jpeg *) stbi__malloc(sizeof(stbi__jpeg));
+   if (!j) return stbi__errpuc("outofmem", "Out of memory");
+   memset(j, 0, sizeof(stbi__jpeg));
+   j->s = &s;
+   stbi__setup_jpeg(j);
+   j->scale_shift = scale_shift;
+   j->bgra = bgra;
+   if (scale_shift == 1) j->idct_block_kernel = stbi__idct_block_4x4;
+   if (scale_shift == 2) j->idct_block_kernel = stbi__idct_block_2x2;
+   if (scale_shift == 3) j->idct_block_kernel = stbi__idct_block_1x1;
+   if (rw > 0 && rh > 0) {
+      j->region_x = rx;
+      j->region_y = ry;
+      j->region_w = rw;
+      j->region_h = rh;
+   }
+   result = load_jpeg_image(j, x, y, comp, req_comp);
+   if (result) {
+      if (out_x0) *out_x0 = (j->crop_x0 * j->img_mcu_w) >> scale_shift;
+      if (out_y0) *out_y0 = (j->crop_y0 * j->img_mcu_h) >> scale_shift;
+   }
+   STBI_FREE(j);
+   return result;
+}
+
+STBIDEF stbi_uc *stbi_load_jpeg_region_from_memory(stbi_uc const *buffer, int len, int scale_shift,
+                                                   int rx, int ry, int rw, int rh, int *out_x0, int *out_y0,
+                                                   int *x, int *y, int *comp, int req_comp)
+{
+   return stbi__load_jpeg_region(buffer, len, scale_shift, rx, ry, rw, rh, out_x0, out_y0,
+                                 x, y, comp, req_comp, 0);
+}
+
+STBIDEF unsigned int *stbi_load_jpeg_argb_from_memory(stbi_uc const *buffer, int len, int scale_shift,
+                                                     int rx, int ry, int rw, int rh, int *out_x0, int *out_y0,
+                                                     int *x, int *y)
+{
+   return (unsigned int *) stbi__load_jpeg_region(buffer, len, scale_shift, rx, ry, rw, rh, out_x0, out_y0,
+                                                  x, y, NULL, 4, 1);
+}
+
 static int stbi__jpeg_test(stbi__context *s)
 {
    int r;
@@ -2,12 +2,13 @@
     * svg.hpp
     * MontaukOS SVG icon parser and scanline rasterizer
     * Handles the Flat-Remix symbolic icon subset (path, circle, rect)
-    * All math uses 16.16 fixed-point -- NO floating point.
+    * Geometry is 16.16 fixed-point; coverage comes from gui/raster.hpp
     * Copyright (c) 2025 Daniel Hammer
 */
 
 #pragma once
 #include "gui/gui.hpp"
+#include "gui/raster.hpp"
 #include <montauk/syscall.h>
 
 namespace gui {
@@ -811,71 +812,22 @@ inline void svg_path_to_edges(SvgEdgeList& el, const char* d, int dLen,
 }
 
 // ---------------------------------------------------------------------------
-// Scanline rasterizer (even-odd fill rule)
+// Coverage rasterizer (even-odd fill rule), see gui/raster.hpp
 // ---------------------------------------------------------------------------
-inline void svg_rasterize(const SvgEdgeList& el, uint32_t* pixels, int w, int h, uint32_t fill) {
-    // Temporary array for x-intersections on each scanline
-    // Allocate enough for all edges (each edge can intersect at most once per scanline)
-    int maxIsect = el.count + 16;
-    fixed_t* isect = (fixed_t*)montauk::malloc(maxIsect * sizeof(fixed_t));
-
-    for (int y = 0; y < h; ++y) {
-        // Scanline center in fixed-point
-        fixed_t scanY = int_to_fixed(y) + (1 << 15); // y + 0.5
-
-        int isectCount = 0;
-
-        // Find intersections with all edges
-        for (int i = 0; i < el.count; ++i) {
-            const SvgEdge& e = el.edges[i];
-            fixed_t ey0 = e.y0, ey1 = e.y1;
-
-            // Ensure ey0 <= ey1 for the range check
-            fixed_t emin = ey0 < ey1 ? ey0 : ey1;
-            fixed_t emax = ey0 > ey1 ? ey0 : ey1;
-
-            // Does this edge cross scanY?
-            if (scanY < emin || scanY >= emax) continue;
-
-            // Compute x at intersection: x = x0 + (scanY - y0) * (x1 - x0) / (y1 - y0)
-            fixed_t dy = ey1 - ey0;
-            if (dy == 0) continue; // horizontal, skip
-            fixed_t dx = e.x1 - e.x0;
-            fixed_t t_num = scanY - ey0;
-            // x_intersect = x0 + dx * t_num / dy
-            fixed_t x_int = e.x0 + (int32_t)(((int64_t)dx * t_num) / dy);
-
-            if (isectCount < maxIsect)
-                isect[isectCount++] = x_int;
-        }
-
-        // Sort intersections (simple insertion sort -- usually very few)
-        for (int i = 1; i < isectCount; ++i) {
-            fixed_t key = isect[i];
-            int j = i - 1;
-            while (j >= 0 && isect[j] > key) {
-                isect[j + 1] = isect[j];
-                --j;
-            }
-            isect[j + 1] = key;
-        }
-
-        // Fill between pairs (even-odd rule)
-        for (int i = 0; i + 1 < isectCount; i += 2) {
-            int x0 = fixed_to_int(isect[i]);
-            int x1 = fixed_to_int(isect[i + 1]);
-
-            // Clamp to pixel bounds
-            if (x0 < 0) x0 = 0;
-            if (x1 > w) x1 = w;
-
-            for (int x = x0; x < x1; ++x) {
-                pixels[y * w + x] = fill;
-            }
-        }
+inline void svg_add_edges(const SvgEdgeList& el, CoverageRaster& raster) {
+    static constexpr float TO_FLOAT = 1.0f / (1 << FIXED_SHIFT);
+    for (int i = 0; i < el.count; ++i) {
+        const SvgEdge& e = el.edges[i];
+        raster.line(e.x0 * TO_FLOAT, e.y0 * TO_FLOAT, e.x1 * TO_FLOAT, e.y1 * TO_FLOAT);
     }
+}
 
-    montauk::mfree(isect);
+inline void svg_rasterize(const SvgEdgeList& el, uint32_t* pixels, int w, int h, uint32_t fill) {
+    CoverageRaster raster = {};
+    if (!raster.init(w, h)) return;
+    svg_add_edges(el, raster);
+    raster.fill(pixels, w, h, 0, 0, fill, 255, true);
+    raster.release();
 }
 
 // ---------------------------------------------------------------------------
@@ -1064,77 +1016,13 @@ inline bool svg_get_element_scale(const char* elem, int elemLen,
 }
 
 // ---------------------------------------------------------------------------
-// Scanline rasterizer with alpha blending (for multi-color SVGs)
+// Composite one element in its colour and opacity (for multi-color SVGs)
 // ---------------------------------------------------------------------------
-inline void svg_rasterize_blend(const SvgEdgeList& el, uint32_t* pixels, int w, int h,
+inline void svg_rasterize_blend(const SvgEdgeList& el, CoverageRaster& raster, uint32_t* pixels,
                                 uint32_t fill, int alpha) {
     if (el.count == 0) return;
-
-    int maxIsect = el.count + 16;
-    fixed_t* isect = (fixed_t*)montauk::malloc(maxIsect * sizeof(fixed_t));
-
-    uint32_t fr = (fill >> 16) & 0xFF;
-    uint32_t fg = (fill >> 8) & 0xFF;
-    uint32_t fb = fill & 0xFF;
-
-    for (int y = 0; y < h; ++y) {
-        fixed_t scanY = int_to_fixed(y) + (1 << 15);
-        int isectCount = 0;
-
-        for (int i = 0; i < el.count; ++i) {
-            const SvgEdge& e = el.edges[i];
-            fixed_t ey0 = e.y0, ey1 = e.y1;
-            fixed_t emin = ey0 < ey1 ? ey0 : ey1;
-            fixed_t emax = ey0 > ey1 ? ey0 : ey1;
-            if (scanY < emin || scanY >= emax) continue;
-            fixed_t dy = ey1 - ey0;
-            if (dy == 0) continue;
-            fixed_t dx = e.x1 - e.x0;
-            fixed_t t_num = scanY - ey0;
-            fixed_t x_int = e.x0 + (int32_t)(((int64_t)dx * t_num) / dy);
-            if (isectCount < maxIsect)
-                isect[isectCount++] = x_int;
-        }
-
-        for (int i = 1; i < isectCount; ++i) {
-            fixed_t key = isect[i];
-            int j = i - 1;
-            while (j >= 0 && isect[j] > key) {
-                isect[j + 1] = isect[j];
-                --j;
-            }
-            isect[j + 1] = key;
-        }
-
-        for (int i = 0; i + 1 < isectCount; i += 2) {
-            int x0 = fixed_to_int(isect[i]);
-            int x1 = fixed_to_int(isect[i + 1]);
-            if (x0 < 0) x0 = 0;
-            if (x1 > w) x1 = w;
-
-            if (alpha >= 255) {
-                for (int x = x0; x < x1; ++x)
-                    pixels[y * w + x] = fill;
-            } else {
-                uint32_t sa = (uint32_t)alpha;
-                uint32_t inv_sa = 255 - sa;
-                for (int x = x0; x < x1; ++x) {
-                    uint32_t dst = pixels[y * w + x];
-                    uint32_t da = (dst >> 24) & 0xFF;
-                    uint32_t dr = (dst >> 16) & 0xFF;
-                    uint32_t dg = (dst >> 8) & 0xFF;
-                    uint32_t db = dst & 0xFF;
-                    uint32_t out_a = sa + (da * inv_sa + 127) / 255;
-                    uint32_t rr = (fr * sa + dr * inv_sa + 128) / 255;
-                    uint32_t gg = (fg * sa + dg * inv_sa + 128) / 255;
-                    uint32_t bb = (fb * sa + db * inv_sa + 128) / 255;
-                    pixels[y * w + x] = (out_a << 24) | (rr << 16) | (gg << 8) | bb;
-                }
-            }
-        }
-    }
-
-    montauk::mfree(isect);
+    svg_add_edges(el, raster);
+    raster.fill(pixels, raster.w, raster.h, 0, 0, fill, alpha, true);
 }
 
 // ---------------------------------------------------------------------------
@@ -1256,6 +1144,8 @@ inline SvgIcon svg_render(const char* svg_data, int svg_len, int target_w, int t
     // Shared edge list (cleared per element for multi-color support)
     SvgEdgeList el;
     el.init(SVG_MAX_EDGES);
+    CoverageRaster raster = {};
+    raster.init(target_w, target_h);
 
     // Heap-allocated path data buffer (avoids 8 KiB on the stack)
     char* d_buf = (char*)montauk::malloc(SVG_MAX_PATH_LEN);
@@ -1362,7 +1252,7 @@ inline SvgIcon svg_render(const char* svg_data, int svg_len, int target_w, int t
                 el.clear();
                 svg_path_to_edges(el, d_buf, d_len, eff_sx, eff_sy, vb_x, vb_y);
                 if (el.count > 0)
-                    svg_rasterize_blend(el, icon.pixels, target_w, target_h, elem_color.to_pixel(), alpha);
+                    svg_rasterize_blend(el, raster, icon.pixels, elem_color.to_pixel(), alpha);
             }
 
             p = elem_end;
@@ -1414,7 +1304,7 @@ inline SvgIcon svg_render(const char* svg_data, int svg_len, int target_w, int t
             el.clear();
             svg_circle_edges(el, scx, scy, sr);
             if (el.count > 0)
-                svg_rasterize_blend(el, icon.pixels, target_w, target_h, elem_color.to_pixel(), alpha);
+                svg_rasterize_blend(el, raster, icon.pixels, elem_color.to_pixel(), alpha);
 
             p = elem_end;
             continue;
@@ -1473,7 +1363,7 @@ inline SvgIcon svg_render(const char* svg_data, int svg_len, int target_w, int t
             el.clear();
             svg_rect_edges(el, sx, sy, sw, sh, srx, sry);
             if (el.count > 0)
-                svg_rasterize_blend(el, icon.pixels, target_w, target_h, elem_color.to_pixel(), alpha);
+                svg_rasterize_blend(el, raster, icon.pixels, elem_color.to_pixel(), alpha);
 
             p = elem_end;
             continue;
@@ -1484,13 +1374,114 @@ inline SvgIcon svg_render(const char* svg_data, int svg_len, int target_w, int t
 
     montauk::mfree(d_buf);
     montauk::mfree(el.edges);
+    raster.release();
     return icon;
 }
 
+// ---------------------------------------------------------------------------
+// Rasterized icon cache
+//
+// Icons rendered by svg_load are kept in a named shared memory object, so
+// the desktop, the file manager and every app reuse each other's work, and
+// an app launched later finds its toolbar icons already rasterized. The
+// object starts zeroed, which is the empty cache, and entries are only
+// ever appended: a writer claims a slot and pixel space with atomic adds,
+// fills them in, then publishes the slot. A writer that dies midway just
+// leaves an unpublished slot. Once full, icons are rendered uncached.
+// ---------------------------------------------------------------------------
+static constexpr const char* SVG_CACHE_NAME = "gui-icon-cache";
+static constexpr int SVG_CACHE_SIZE     = 4 * 1024 * 1024;
+static constexpr int SVG_CACHE_ENTRIES  = 1024;
+static constexpr int SVG_CACHE_PATH_LEN = 96;
+
+struct SvgCacheEntry {
+    uint32_t ready;     // set last, once the rest is filled in
+    uint32_t hash;      // of the path
+    int width, height;
+    uint32_t color;
+    uint32_t offset;    // of the pixels from the start of the cache
+    char path[SVG_CACHE_PATH_LEN];
+};
+
+struct SvgCacheHeader {
+    uint32_t entry_count;   // slots claimed
+    uint32_t data_used;     // pixel bytes claimed
+    SvgCacheEntry entries[SVG_CACHE_ENTRIES];
+};
+
+static constexpr uint32_t SVG_CACHE_DATA = (sizeof(SvgCacheHeader) + 15) & ~15u;
+
+inline SvgCacheHeader* svg_cache_map() {
+    static SvgCacheHeader* cache = nullptr;
+    static bool tried = false;
+    if (!tried) {
+        tried = true;
+        cache = (SvgCacheHeader*)montauk::shm_open(SVG_CACHE_NAME, SVG_CACHE_SIZE);
+    }
+    return cache;
+}
+
+inline uint32_t svg_cache_hash(const char* path) {
+    uint32_t h = 2166136261u;
+    for (int i = 0; path[i]; i++) h = (h ^ (uint8_t)path[i]) * 16777619u;
+    return h;
+}
+
+inline uint32_t svg_cache_color(Color c) {
+    return ((uint32_t)c.a << 24) | ((uint32_t)c.r << 16) | ((uint32_t)c.g << 8) | c.b;
+}
+
+// A heap copy of the cached icon, or {nullptr} if it is not cached
+inline SvgIcon svg_cache_find(const char* vfs_path, int w, int h, Color fill_color) {
+    SvgCacheHeader* cache = svg_cache_map();
+    if (!cache) return {nullptr, 0, 0};
+
+    uint32_t hash = svg_cache_hash(vfs_path);
+    int path_len = svg_strlen(vfs_path);
+    uint32_t color = svg_cache_color(fill_color);
+    uint32_t count = __atomic_load_n(&cache->entry_count, __ATOMIC_ACQUIRE);
+    if (count > SVG_CACHE_ENTRIES) count = SVG_CACHE_ENTRIES;
+
+    for (uint32_t i = 0; i < count; i++) {
+        SvgCacheEntry* e = &cache->entries[i];
+        if (!__atomic_load_n(&e->ready, __ATOMIC_ACQUIRE)) continue;
+        if (e->hash != hash || e->width != w || e->height != h || e->color != color) continue;
+        if (path_len >= SVG_CACHE_PATH_LEN || !svg_strncmp(e->path, vfs_path, path_len + 1)) continue;
+
+        uint32_t* out = (uint32_t*)montauk::malloc(w * h * 4);
+        if (!out) return {nullptr, 0, 0};
+        svg_memcpy(out, (uint8_t*)cache + e->offset, w * h * 4);
+        return {out, w, h};
+    }
+    return {nullptr, 0, 0};
+}
+
+inline void svg_cache_store(const char* vfs_path, const SvgIcon& icon, Color fill_color) {
+    SvgCacheHeader* cache = svg_cache_map();
+    int path_len = svg_strlen(vfs_path);
+    if (!cache || path_len >= SVG_CACHE_PATH_LEN) return;
+
+    uint32_t bytes = ((uint32_t)(icon.width * icon.height * 4) + 15) & ~15u;
+    uint32_t slot = __atomic_fetch_add(&cache->entry_count, 1, __ATOMIC_RELAXED);
+    if (slot >= SVG_CACHE_ENTRIES) return;
+    uint32_t offset = SVG_CACHE_DATA + __atomic_fetch_add(&cache->data_used, bytes, __ATOMIC_RELAXED);
+    if (offset + bytes > SVG_CACHE_SIZE) return;
+
+    SvgCacheEntry* e = &cache->entries[slot];
+    svg_memcpy((uint8_t*)cache + offset, icon.pixels, icon.width * icon.height * 4);
+    svg_memcpy(e->path, vfs_path, path_len + 1);
+    e->hash = svg_cache_hash(vfs_path);
+    e->width = icon.width;
+    e->height = icon.height;
+    e->color = svg_cache_color(fill_color);
+    e->offset = offset;
+    __atomic_store_n(&e->ready, 1, __ATOMIC_RELEASE);
+}
+
 // ---------------------------------------------------------------------------
 // Load SVG from VFS and render
 // ---------------------------------------------------------------------------
-inline SvgIcon svg_load(const char* vfs_path, int target_w, int target_h, Color fill_color) {
+inline SvgIcon svg_load_uncached(const char* vfs_path, int target_w, int target_h, Color fill_color) {
     int fd = montauk::open(vfs_path);
     if (fd < 0) {
         return {nullptr, 0, 0};
@@ -1507,57 +1498,20 @@ inline SvgIcon svg_load(const char* vfs_path, int target_w, int target_h, Color
     montauk::close(fd);
     buf[size] = '\0';
 
-    // 4x supersampling: render at 4x resolution, then downsample with box filter
-    static constexpr int SS = 4;
-    int hi_w = target_w * SS;
-    int hi_h = target_h * SS;
-
-    SvgIcon hi = svg_render(buf, (int)size, hi_w, hi_h, fill_color);
+    // Edges are anti-aliased by exact area coverage, so no supersampling
+    SvgIcon icon = svg_render(buf, (int)size, target_w, target_h, fill_color);
     montauk::mfree(buf);
+    return icon;
+}
 
-    if (!hi.pixels) return {nullptr, 0, 0};
-
-    // Allocate final icon at target resolution
-    uint32_t* out = (uint32_t*)montauk::malloc(target_w * target_h * 4);
-    for (int i = 0; i < target_w * target_h; i++) out[i] = 0;
-
-    // Downsample: average each SSxSS block using premultiplied alpha
-    for (int dy = 0; dy < target_h; dy++) {
-        for (int dx = 0; dx < target_w; dx++) {
-            uint32_t sum_a = 0, sum_pr = 0, sum_pg = 0, sum_pb = 0;
-            for (int sy = 0; sy < SS; sy++) {
-                for (int sx = 0; sx < SS; sx++) {
-                    uint32_t px = hi.pixels[(dy * SS + sy) * hi_w + (dx * SS + sx)];
-                    uint32_t a = (px >> 24) & 0xFF;
-                    uint32_t r = (px >> 16) & 0xFF;
-                    uint32_t g = (px >>  8) & 0xFF;
-                    uint32_t b =  px        & 0xFF;
-                    // Premultiply before averaging (rasterizer outputs straight alpha)
-                    sum_a  += a;
-                    sum_pr += r * a;
-                    sum_pg += g * a;
-                    sum_pb += b * a;
-                }
-            }
-            uint32_t avg_a = sum_a / (SS * SS);
-
-            // Un-premultiply for final straight-alpha output
-            uint32_t avg_r = 0, avg_g = 0, avg_b = 0;
-            if (sum_a > 0) {
-                avg_r = sum_pr / sum_a;
-                avg_g = sum_pg / sum_a;
-                avg_b = sum_pb / sum_a;
-                if (avg_r > 255) avg_r = 255;
-                if (avg_g > 255) avg_g = 255;
-                if (avg_b > 255) avg_b = 255;
-            }
-
-            out[dy * target_w + dx] = (avg_a << 24) | (avg_r << 16) | (avg_g << 8) | avg_b;
-        }
-    }
+// Render an icon, from the shared cache when another load already did
+inline SvgIcon svg_load(const char* vfs_path, int target_w, int target_h, Color fill_color) {
+    SvgIcon icon = svg_cache_find(vfs_path, target_w, target_h, fill_color);
+    if (icon.pixels) return icon;
 
-    montauk::mfree(hi.pixels);
-    return {out, target_w, target_h};
+    icon = svg_load_uncached(vfs_path, target_w, target_h, fill_color);
+    if (icon.pixels) svg_cache_store(vfs_path, icon, fill_color);
+    return icon;
 }
 
 // ---------------------------------------------------------------------------
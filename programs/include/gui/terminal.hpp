@@ -21,9 +21,22 @@ struct TermCell {
 
 static constexpr int TERM_MAX_SCROLLBACK = 500;
 
+// Output ring the shell writes into, and how much terminal_poll reads at once
+static constexpr uint32_t TERM_OUTPUT_BUFFER = 256 * 1024;
+static constexpr int TERM_READ_CHUNK = 64 * 1024;
+
+// Screen rows whose damage is tracked; taller terminals always repaint in full
+static constexpr int TERM_MAX_DAMAGE_ROWS = 256;
+
+// Columns [x0, x1) of a screen row changed since the last render (none if x0 >= x1)
+struct TermRowDamage {
+    int16_t x0, x1;
+};
+
 struct TerminalState {
-    TermCell* cells;
+    TermCell* cells;             // ring of rows + max_scrollback rows, oldest at cells_head
     TermCell* alt_cells;         // alternate screen buffer
+    int cells_head;              // ring row holding the oldest line
     int cols, rows;
     int cursor_x, cursor_y;
     int saved_cursor_x, saved_cursor_y;  // saved cursor for alternate screen
@@ -37,7 +50,11 @@ struct TerminalState {
     bool cursor_visible;
     bool alt_screen_active;
     bool reverse_video;
-    bool dirty;                  // true when content changed since last render
+    bool dirty;                  // true when the whole view must be repainted
+    bool damaged;                // cells changed since last render, see row_damage
+    int scrolled;                // rows the live view scrolled since last render
+    int drawn_cursor_x, drawn_cursor_y;  // cell the cursor was rendered on, -1 if none
+    TermRowDamage row_damage[TERM_MAX_DAMAGE_ROWS];
 
     enum { STATE_NORMAL, STATE_ESC, STATE_CSI } parse_state;
     bool csi_private;            // true if '?' was seen after CSI
@@ -69,23 +86,57 @@ static inline Color term_ansi_color(int idx) {
     }
 }
 
+// Helper: pointer to line `line` of the buffer, counting from the oldest
+// scrollback line. Rows are contiguous, but consecutive lines need not be.
+static inline TermCell* term_line(TerminalState* t, int line) {
+    int capacity = t->rows + t->max_scrollback;
+    return &t->cells[((t->cells_head + line) % capacity) * t->cols];
+}
+
 // Helper: pointer to start of screen-relative row r in the cells buffer
 static inline TermCell* term_screen_row(TerminalState* t, int r) {
-    return &t->cells[(t->scrollback_lines + r) * t->cols];
+    return term_line(t, t->scrollback_lines + r);
+}
+
+// Mark columns [x0, x1) of screen row r for the next render
+static inline void term_damage(TerminalState* t, int r, int x0, int x1) {
+    t->damaged = true;
+    if (r < 0 || r >= TERM_MAX_DAMAGE_ROWS) return;
+    TermRowDamage& d = t->row_damage[r];
+    if (d.x0 >= d.x1) {
+        d.x0 = (int16_t)x0;
+        d.x1 = (int16_t)x1;
+        return;
+    }
+    if (x0 < d.x0) d.x0 = (int16_t)x0;
+    if (x1 > d.x1) d.x1 = (int16_t)x1;
+}
+
+static inline void term_damage_rows(TerminalState* t, int r0, int r1) {
+    for (int r = r0; r < r1; r++) term_damage(t, r, 0, t->cols);
+}
+
+// Whether terminal_render has anything to draw
+static inline bool terminal_needs_render(const TerminalState* t) {
+    if (t->dirty || t->damaged) return true;
+    bool cursor_shown = t->cursor_visible && t->view_offset == 0 && t->cursor_x < t->cols;
+    if (!cursor_shown) return t->drawn_cursor_y >= 0;
+    return t->drawn_cursor_x != t->cursor_x || t->drawn_cursor_y != t->cursor_y;
 }
 
 static inline void terminal_scroll_up(TerminalState* t) {
     if (!t->alt_screen_active && t->scrollback_lines < t->max_scrollback) {
         // Room for scrollback: top visible row becomes scrollback, no data movement
         t->scrollback_lines++;
-    } else if (!t->alt_screen_active && t->max_scrollback > 0) {
-        // Scrollback full: discard oldest line, shift entire buffer up by one row
-        int total = (t->max_scrollback + t->rows - 1) * t->cols * sizeof(TermCell);
-        montauk::memmove(t->cells, t->cells + t->cols, total);
+    } else if (!t->alt_screen_active || t->max_scrollback == 0) {
+        // Scrollback full, or none (klog): the oldest line's row is reused
+        // as the new bottom row
+        t->cells_head = (t->cells_head + 1) % (t->rows + t->max_scrollback);
     } else {
-        // Alt screen or no scrollback (klog): shift visible area up
-        TermCell* screen = term_screen_row(t, 0);
-        montauk::memmove(screen, screen + t->cols, (t->rows - 1) * t->cols * sizeof(TermCell));
+        // Alt screen: its lines never become scrollback; shift visible rows up
+        for (int r = 0; r < t->rows - 1; r++) {
+            montauk::memcpy(term_screen_row(t, r), term_screen_row(t, r + 1), t->cols * sizeof(TermCell));
+        }
     }
 
     // Clear the new bottom visible row
@@ -99,6 +150,20 @@ static inline void terminal_scroll_up(TerminalState* t) {
         t->view_offset++;
         if (t->view_offset > t->scrollback_lines)
             t->view_offset = t->scrollback_lines;
+        t->dirty = true;
+        return;
+    }
+
+    // The rendered rows move up with the text: the renderer scrolls the
+    // pixels, and only the new bottom row (plus damage below) is drawn
+    if (t->rows <= TERM_MAX_DAMAGE_ROWS) {
+        montauk::memmove(&t->row_damage[0], &t->row_damage[1], (t->rows - 1) * sizeof(TermRowDamage));
+        t->row_damage[t->rows - 1] = {0, 0};
+        term_damage(t, t->rows - 1, 0, t->cols);
+        t->scrolled++;
+        if (t->drawn_cursor_y >= 0) t->drawn_cursor_y--;
+    } else {
+        t->dirty = true;
     }
 }
 
@@ -111,6 +176,7 @@ static inline void terminal_init_cells(TerminalState* t, int cols, int rows, int
     t->cursor_y = 0;
     t->saved_cursor_x = 0;
     t->saved_cursor_y = 0;
+    t->cells_head = 0;
     t->scrollback_lines = 0;
     t->max_scrollback = max_sb;
     t->view_offset = 0;
@@ -120,6 +186,11 @@ static inline void terminal_init_cells(TerminalState* t, int cols, int rows, int
     t->alt_screen_active = false;
     t->reverse_video = false;
     t->dirty = true;
+    t->damaged = false;
+    t->scrolled = 0;
+    t->drawn_cursor_x = -1;
+    t->drawn_cursor_y = -1;
+    montauk::memset(t->row_damage, 0, sizeof(t->row_damage));
     t->parse_state = TerminalState::STATE_NORMAL;
     t->csi_private = false;
     t->csi_param_count = 0;
@@ -149,7 +220,7 @@ static inline void terminal_init(TerminalState* t, int cols, int rows) {
     terminal_init_cells(t, cols, rows, TERM_MAX_SCROLLBACK);
     t->cursor_visible = true;
 
-    t->child_pid = montauk::spawn_redir("0:/os/shell.elf");
+    t->child_pid = montauk::spawn_redir("0:/os/shell.elf", nullptr, TERM_OUTPUT_BUFFER);
     if (t->child_pid > 0)
         montauk::childio_settermsz(t->child_pid, cols, rows);
 }
@@ -167,9 +238,35 @@ static inline void terminal_put_char(TerminalState* t, char ch) {
     row[t->cursor_x].ch = ch;
     row[t->cursor_x].fg = t->current_fg;
     row[t->cursor_x].bg = t->current_bg;
+    term_damage(t, t->cursor_y, t->cursor_x, t->cursor_x + 1);
     t->cursor_x++;
 }
 
+// Write a run of printable characters, a row segment at a time
+static inline void terminal_put_run(TerminalState* t, const char* s, int n) {
+    while (n > 0) {
+        if (t->cursor_x >= t->cols) {
+            t->cursor_x = 0;
+            t->cursor_y++;
+        }
+        if (t->cursor_y >= t->rows) {
+            terminal_scroll_up(t);
+            t->cursor_y = t->rows - 1;
+        }
+
+        int count = t->cols - t->cursor_x;
+        if (count > n) count = n;
+        TermCell* cell = term_screen_row(t, t->cursor_y) + t->cursor_x;
+        for (int i = 0; i < count; i++) {
+            cell[i] = {s[i], t->current_fg, t->current_bg};
+        }
+        term_damage(t, t->cursor_y, t->cursor_x, t->cursor_x + count);
+        t->cursor_x += count;
+        s += count;
+        n -= count;
+    }
+}
+
 static inline void terminal_enter_alt_screen(TerminalState* t) {
     if (t->alt_screen_active) return;
     t->alt_screen_active = true;
@@ -178,11 +275,13 @@ static inline void terminal_enter_alt_screen(TerminalState* t) {
     t->saved_cursor_x = t->cursor_x;
     t->saved_cursor_y = t->cursor_y;
     // Save visible screen to alt_cells, clear visible screen
-    int total = t->cols * t->rows;
-    TermCell* screen = term_screen_row(t, 0);
-    for (int i = 0; i < total; i++) {
-        t->alt_cells[i] = screen[i];
-        screen[i] = {' ', colors::TERM_FG, colors::TERM_BG};
+    for (int r = 0; r < t->rows; r++) {
+        TermCell* row = term_screen_row(t, r);
+        TermCell* saved = &t->alt_cells[r * t->cols];
+        for (int c = 0; c < t->cols; c++) {
+            saved[c] = row[c];
+            row[c] = {' ', colors::TERM_FG, colors::TERM_BG};
+        }
     }
     t->view_offset = 0;
     t->cursor_x = 0;
@@ -194,10 +293,8 @@ static inline void terminal_exit_alt_screen(TerminalState* t) {
     t->alt_screen_active = false;
     t->dirty = true;
     // Restore visible screen from alt_cells
-    int total = t->cols * t->rows;
-    TermCell* screen = term_screen_row(t, 0);
-    for (int i = 0; i < total; i++) {
-        screen[i] = t->alt_cells[i];
+    for (int r = 0; r < t->rows; r++) {
+        montauk::memcpy(term_screen_row(t, r), &t->alt_cells[r * t->cols], t->cols * sizeof(TermCell));
     }
     // Restore cursor
     t->cursor_x = t->saved_cursor_x;
@@ -293,6 +390,8 @@ static inline void terminal_process_csi(TerminalState* t, char cmd) {
                 for (int c = 0; c < t->cols; c++)
                     rp[c] = {' ', t->current_fg, colors::TERM_BG};
             }
+            term_damage(t, t->cursor_y, t->cursor_x, t->cols);
+            term_damage_rows(t, t->cursor_y + 1, t->rows);
         } else if (p0 == 1) {
             // Clear from start to cursor
             for (int r = 0; r < t->cursor_y; r++) {
@@ -301,8 +400,10 @@ static inline void terminal_process_csi(TerminalState* t, char cmd) {
                     rp[c] = {' ', t->current_fg, colors::TERM_BG};
             }
             TermCell* row = term_screen_row(t, t->cursor_y);
-            for (int x = 0; x <= t->cursor_x; x++)
+            for (int x = 0; x <= t->cursor_x && x < t->cols; x++)
                 row[x] = {' ', t->current_fg, colors::TERM_BG};
+            term_damage_rows(t, 0, t->cursor_y);
+            term_damage(t, t->cursor_y, 0, t->cursor_x + 1);
         } else if (p0 == 2) {
             // Clear entire screen
             for (int r = 0; r < t->rows; r++) {
@@ -310,6 +411,7 @@ static inline void terminal_process_csi(TerminalState* t, char cmd) {
                 for (int c = 0; c < t->cols; c++)
                     rp[c] = {' ', t->current_fg, colors::TERM_BG};
             }
+            term_damage_rows(t, 0, t->rows);
             t->cursor_x = 0;
             t->cursor_y = 0;
         }
@@ -321,9 +423,11 @@ static inline void terminal_process_csi(TerminalState* t, char cmd) {
         if (p0 == 0) { start = t->cursor_x; end = t->cols; }
         else if (p0 == 1) { start = 0; end = t->cursor_x + 1; }
         else if (p0 == 2) { start = 0; end = t->cols; }
+        if (end > t->cols) end = t->cols;
         TermCell* row = term_screen_row(t, t->cursor_y);
         for (int x = start; x < end; x++)
             row[x] = {' ', t->current_fg, colors::TERM_BG};
+        term_damage(t, t->cursor_y, start, end);
         break;
     }
     case 'm': {
@@ -399,10 +503,19 @@ static inline void terminal_process_csi(TerminalState* t, char cmd) {
 }
 
 static inline void terminal_feed(TerminalState* t, const char* data, int len) {
-    if (len > 0) t->dirty = true;
     for (int i = 0; i < len; i++) {
         char ch = data[i];
 
+        // Fast path: a run of printable characters goes into the cells in
+        // bulk; only control and escape bytes take the state machine
+        if (t->parse_state == TerminalState::STATE_NORMAL && (ch >= 32 || ch < 0)) {
+            int end = i + 1;
+            while (end < len && (data[end] >= 32 || data[end] < 0)) end++;
+            terminal_put_run(t, data + i, end - i);
+            i = end - 1;
+            continue;
+        }
+
         switch (t->parse_state) {
         case TerminalState::STATE_NORMAL:
             if (ch == '\033') {
@@ -474,122 +587,163 @@ static inline void terminal_feed(TerminalState* t, const char* data, int len) {
     }
 }
 
-static inline void terminal_render(TerminalState* t, uint32_t* pixels, int pw, int ph) {
-    if (!t->dirty || !t->cells) return;
-    t->dirty = false;
+// Draw one glyph with its top-left at (px, py)
+static inline void term_draw_glyph(uint32_t* pixels, int pw, int ph, int px, int py, char ch, Color fg,
+                                   GlyphCache* gc) {
+    if (!(ch > 32 || ch < 0)) return;
+    if (gc) {
+        int baseline = py + gc->ascent;
+        fonts::mono->draw_char_to_buffer(pixels, pw, ph, px, baseline, (unsigned char)ch, fg, gc);
+        return;
+    }
+    uint32_t fg_px = fg.to_pixel();
+    const uint8_t* glyph = &font_data[(unsigned char)ch * FONT_HEIGHT];
+    for (int fy = 0; fy < FONT_HEIGHT; fy++) {
+        int dy = py + fy;
+        if (dy >= ph) break;
+        uint8_t bits = glyph[fy];
+        for (int fx = 0; fx < FONT_WIDTH; fx++) {
+            if (bits & (0x80 >> fx)) {
+                int dx = px + fx;
+                if (dx >= pw) break;
+                pixels[dy * pw + dx] = fg_px;
+            }
+        }
+    }
+}
 
+// Fill a pixel rectangle, clipped to the buffer
+static inline void term_fill(uint32_t* pixels, int pw, int ph, int x, int y, int w, int h, uint32_t px) {
+    if (x + w > pw) w = pw - x;
+    if (y + h > ph) h = ph - y;
+    for (int r = 0; r < h; r++) {
+        uint32_t* row = &pixels[(y + r) * pw + x];
+        for (int c = 0; c < w; c++) row[c] = px;
+    }
+}
+
+// Draw cells [x0, x1) of a buffer line on view row r, over the terminal background
+static inline void term_render_span(uint32_t* pixels, int pw, int ph, int r, const TermCell* line,
+                                    int x0, int x1, GlyphCache* gc) {
     int cell_w = mono_cell_width();
     int cell_h = mono_cell_height();
-    bool use_ttf = fonts::mono && fonts::mono->valid;
-    GlyphCache* gc = use_ttf ? fonts::mono->get_cache(fonts::TERM_SIZE) : nullptr;
-
-    // Fill background using row-copy: fill first row, then memcpy to the rest
+    int py = r * cell_h;
     uint32_t bg_px = colors::TERM_BG.to_pixel();
-    int row_bytes = pw * sizeof(uint32_t);
-    for (int i = 0; i < pw; i++) pixels[i] = bg_px;
-    for (int r = 1; r < ph; r++) {
-        montauk::memcpy(&pixels[r * pw], pixels, row_bytes);
+
+    for (int c = x0; c < x1; c++) {
+        const TermCell& cell = line[c];
+        int px = c * cell_w;
+
+        // Only draw cell background if it differs from terminal bg
+        uint32_t cell_bg = cell.bg.to_pixel();
+        if (cell_bg != bg_px) term_fill(pixels, pw, ph, px, py, cell_w, cell_h, cell_bg);
+
+        term_draw_glyph(pixels, pw, ph, px, py, cell.ch, cell.fg, gc);
     }
+}
 
-    // Determine which rows of the buffer to display
-    int base_row = t->scrollback_lines - t->view_offset;
-    if (base_row < 0) base_row = 0;
+// Render the terminal into `pixels`, repainting only what changed since
+// the last call unless it is dirty. Returns the rectangle of `pixels`
+// that changed (empty if nothing did).
+static inline Rect terminal_render(TerminalState* t, uint32_t* pixels, int pw, int ph) {
+    if (!t->cells || !terminal_needs_render(t)) return {0, 0, 0, 0};
+
+    int cell_w = mono_cell_width();
+    int cell_h = mono_cell_height();
+    bool use_ttf = fonts::mono && fonts::mono->valid;
+    GlyphCache* gc = use_ttf ? fonts::mono->get_cache(fonts::TERM_SIZE) : nullptr;
 
-    // Render each visible cell
     int visible_rows = ph / cell_h;
     int visible_cols = pw / cell_w;
     if (visible_rows > t->rows) visible_rows = t->rows;
     if (visible_cols > t->cols) visible_cols = t->cols;
 
-    for (int r = 0; r < visible_rows; r++) {
-        int py = r * cell_h;
-        int src_row = base_row + r;
-        for (int c = 0; c < visible_cols; c++) {
-            int idx = src_row * t->cols + c;
-            TermCell& cell = t->cells[idx];
-
-            int px = c * cell_w;
-
-            // Only draw cell background if it differs from terminal bg
-            uint32_t cell_bg = cell.bg.to_pixel();
-            if (cell_bg != bg_px) {
-                for (int fy = 0; fy < cell_h && py + fy < ph; fy++) {
-                    uint32_t* row = &pixels[(py + fy) * pw + px];
-                    for (int fx = 0; fx < cell_w && px + fx < pw; fx++) {
-                        row[fx] = cell_bg;
-                    }
-                }
-            }
+    // Only the live view is tracked cell by cell, and only so many rows
+    bool full = t->dirty || t->view_offset > 0 || t->rows > TERM_MAX_DAMAGE_ROWS ||
+                t->scrolled >= visible_rows;
+    Rect damage = {0, 0, 0, 0};
+
+    if (full) {
+        // Fill background using row-copy: fill first row, then memcpy to the rest
+        uint32_t bg_px = colors::TERM_BG.to_pixel();
+        int row_bytes = pw * sizeof(uint32_t);
+        for (int i = 0; i < pw; i++) pixels[i] = bg_px;
+        for (int r = 1; r < ph; r++) {
+            montauk::memcpy(&pixels[r * pw], pixels, row_bytes);
+        }
 
-            // Draw character glyph
-            if (cell.ch > 32 || cell.ch < 0) {
-                if (use_ttf) {
-                    int baseline = py + gc->ascent;
-                    fonts::mono->draw_char_to_buffer(pixels, pw, ph,
-                        px, baseline, (unsigned char)cell.ch, cell.fg, gc);
-                } else {
-                    uint32_t cell_fg = cell.fg.to_pixel();
-                    const uint8_t* glyph = &font_data[(unsigned char)cell.ch * FONT_HEIGHT];
-                    for (int fy = 0; fy < FONT_HEIGHT; fy++) {
-                        int dy = py + fy;
-                        if (dy >= ph) break;
-                        uint8_t bits = glyph[fy];
-                        for (int fx = 0; fx < FONT_WIDTH; fx++) {
-                            if (bits & (0x80 >> fx)) {
-                                int dx = px + fx;
-                                if (dx >= pw) break;
-                                pixels[dy * pw + dx] = cell_fg;
-                            }
-                        }
-                    }
-                }
+        // Determine which rows of the buffer to display
+        int base_row = t->scrollback_lines - t->view_offset;
+        if (base_row < 0) base_row = 0;
+
+        for (int r = 0; r < visible_rows; r++) {
+            term_render_span(pixels, pw, ph, r, term_line(t, base_row + r), 0, visible_cols, gc);
+        }
+        damage = {0, 0, pw, ph};
+    } else {
+        // Scrolled rows: move their pixels up instead of redrawing them
+        if (t->scrolled > 0) {
+            int shift = t->scrolled * cell_h;
+            montauk::memmove(pixels, pixels + shift * pw,
+                             (uint64_t)(visible_rows * cell_h - shift) * pw * sizeof(uint32_t));
+            damage = {0, 0, pw, visible_rows * cell_h};
+        }
+
+        // The cell the cursor was drawn on, and the one it is on now
+        if (t->drawn_cursor_y >= 0) {
+            term_damage(t, t->drawn_cursor_y, t->drawn_cursor_x, t->drawn_cursor_x + 1);
+        }
+        if (t->cursor_visible && t->cursor_x < t->cols) {
+            term_damage(t, t->cursor_y, t->cursor_x, t->cursor_x + 1);
+        }
+
+        // Damaged spans: clear to the background (out to the buffer's
+        // right edge at the last column), then draw the cells again
+        uint32_t bg_px = colors::TERM_BG.to_pixel();
+        for (int r = 0; r < visible_rows; r++) {
+            int x0 = t->row_damage[r].x0;
+            int x1 = t->row_damage[r].x1 < visible_cols ? t->row_damage[r].x1 : visible_cols;
+            if (x0 >= x1) continue;
+
+            int px0 = x0 * cell_w;
+            int px1 = x1 == visible_cols ? pw : x1 * cell_w;
+            term_fill(pixels, pw, ph, px0, r * cell_h, px1 - px0, cell_h, bg_px);
+            term_render_span(pixels, pw, ph, r, term_screen_row(t, r), x0, x1, gc);
+
+            Rect span = {px0, r * cell_h, px1 - px0, cell_h};
+            if (damage.empty()) {
+                damage = span;
+            } else {
+                int x0 = damage.x < span.x ? damage.x : span.x;
+                int y0 = damage.y < span.y ? damage.y : span.y;
+                int x1 = damage.x + damage.w > span.x + span.w ? damage.x + damage.w : span.x + span.w;
+                int y1 = damage.y + damage.h > span.y + span.h ? damage.y + damage.h : span.y + span.h;
+                damage = {x0, y0, x1 - x0, y1 - y0};
             }
         }
     }
 
+    t->dirty = false;
+    t->damaged = false;
+    t->scrolled = 0;
+    montauk::memset(t->row_damage, 0, sizeof(t->row_damage));
+    t->drawn_cursor_x = -1;
+    t->drawn_cursor_y = -1;
+
     // Draw cursor (only when viewing live position)
     if (t->view_offset == 0 && t->cursor_visible &&
         t->cursor_x < visible_cols && t->cursor_y < visible_rows) {
         int cx = t->cursor_x * cell_w;
         int cy = t->cursor_y * cell_h;
-        uint32_t cursor_px = colors::WHITE.to_pixel();
-        for (int fy = 0; fy < cell_h; fy++) {
-            int dy = cy + fy;
-            if (dy >= ph) break;
-            for (int fx = 0; fx < cell_w; fx++) {
-                int dx = cx + fx;
-                if (dx >= pw) break;
-                pixels[dy * pw + dx] = cursor_px;
-            }
-        }
+        term_fill(pixels, pw, ph, cx, cy, cell_w, cell_h, colors::WHITE.to_pixel());
         // Draw character on top of cursor in black
-        if (t->cursor_y < t->rows && t->cursor_x < t->cols) {
-            TermCell* row = term_screen_row(t, t->cursor_y);
-            char ch = row[t->cursor_x].ch;
-            if (ch > 32 || ch < 0) {
-                if (use_ttf) {
-                    int baseline = cy + gc->ascent;
-                    fonts::mono->draw_char_to_buffer(pixels, pw, ph,
-                        cx, baseline, (unsigned char)ch, colors::BLACK, gc);
-                } else {
-                    const uint8_t* glyph = &font_data[(unsigned char)ch * FONT_HEIGHT];
-                    uint32_t black_px = colors::BLACK.to_pixel();
-                    for (int fy = 0; fy < FONT_HEIGHT; fy++) {
-                        int dy = cy + fy;
-                        if (dy >= ph) break;
-                        uint8_t bits = glyph[fy];
-                        for (int fx = 0; fx < FONT_WIDTH; fx++) {
-                            if (bits & (0x80 >> fx)) {
-                                int dx = cx + fx;
-                                if (dx >= pw) break;
-                                pixels[dy * pw + dx] = black_px;
-                            }
-                        }
-                    }
-                }
-            }
-        }
+        TermCell* row = term_screen_row(t, t->cursor_y);
+        term_draw_glyph(pixels, pw, ph, cx, cy, row[t->cursor_x].ch, colors::BLACK, gc);
+        t->drawn_cursor_x = t->cursor_x;
+        t->drawn_cursor_y = t->cursor_y;
     }
+
+    return damage.intersect({0, 0, pw, ph});
 }
 
 static inline void terminal_resize(TerminalState* t, int new_cols, int new_rows) {
@@ -620,8 +774,9 @@ static inline void terminal_resize(TerminalState* t, int new_cols, int new_rows)
     int copy_cols = t->cols < new_cols ? t->cols : new_cols;
 
     for (int r = 0; r < keep; r++) {
+        TermCell* src = term_line(t, discard + r);
         for (int c = 0; c < copy_cols; c++) {
-            new_cells[r * new_cols + c] = t->cells[(discard + r) * t->cols + c];
+            new_cells[r * new_cols + c] = src[c];
         }
     }
 
@@ -640,6 +795,7 @@ static inline void terminal_resize(TerminalState* t, int new_cols, int new_rows)
 
     t->cells = new_cells;
     t->alt_cells = new_alt;
+    t->cells_head = 0;
     t->cols = new_cols;
     t->rows = new_rows;
     t->scrollback_lines = new_scrollback;
@@ -670,7 +826,7 @@ static inline void terminal_handle_key(TerminalState* t, const Montauk::KeyEvent
 // Returns false if the child process has exited
 static inline bool terminal_poll(TerminalState* t) {
     if (t->child_pid <= 0) return false;
-    char buf[4096];
+    static char buf[TERM_READ_CHUNK];
     // Drain all available data so large output renders in one frame
     for (;;) {
         int n = montauk::childio_read(t->child_pid, buf, sizeof(buf));
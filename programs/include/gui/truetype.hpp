@@ -42,26 +42,440 @@
 namespace gui {
 
 struct CachedGlyph {
-    uint8_t* bitmap;
+    uint8_t* bitmap;  // alpha rows `stride` bytes apart, in the glyph atlas
     int width, height;
+    int stride;
     int xoff, yoff;
     int advance;
     bool loaded;
 };
 
+// Metrics of a font at one pixel size; its glyphs live in the glyph atlas
 struct GlyphCache {
-    CachedGlyph glyphs[256];  // Latin-1 Supplement (U+0080..U+00FF) included
     int pixel_size;
     float scale;
     int ascent, descent, line_gap;
     int line_height;
+    uint32_t last_used;
 };
 
+// ---- Shared glyph cache ----
+// Glyphs of the system fonts, once rasterized by any process, are kept in
+// a named shared memory object, so an app starting up copies the bitmaps
+// of its labels instead of rasterizing them again; the desktop fills it
+// with the ASCII glyphs of the UI sizes at boot (fonts::prewarm). As with
+// the icon cache (svg.hpp), the object starts zeroed, which is the empty
+// cache, and entries are only ever appended: a writer claims a slot and
+// bitmap space with atomic adds, fills them in, then pushes the slot onto
+// its hash chain. Once full, glyphs are rasterized unshared.
+
+static constexpr const char* GLYPH_SHARED_NAME = "gui-glyph-cache";
+static constexpr int GLYPH_SHARED_SIZE    = 2 * 1024 * 1024;
+static constexpr int GLYPH_SHARED_ENTRIES = 4096;
+static constexpr int GLYPH_SHARED_BUCKETS = 2048;  // power of two
+
+struct SharedGlyph {
+    uint32_t font_key;  // TrueTypeFont::shared_key
+    int pixel_size;
+    int codepoint;
+    int16_t width, height;
+    int16_t xoff, yoff;
+    int advance;
+    uint32_t offset;    // of the bitmap (rows `width` bytes) from the start of the cache
+    uint32_t next;      // hash chain, as slot + 1; 0 ends it
+};
+
+struct SharedGlyphHeader {
+    uint32_t entry_count;   // slots claimed
+    uint32_t data_used;     // bitmap bytes claimed
+    uint32_t buckets[GLYPH_SHARED_BUCKETS];  // slot + 1, 0 if empty
+    SharedGlyph entries[GLYPH_SHARED_ENTRIES];
+};
+
+static constexpr uint32_t GLYPH_SHARED_DATA = (sizeof(SharedGlyphHeader) + 15) & ~15u;
+
+inline SharedGlyphHeader* glyph_shared_map() {
+    static SharedGlyphHeader* cache = nullptr;
+    static bool tried = false;
+    if (!tried) {
+        tried = true;
+        cache = (SharedGlyphHeader*)montauk::shm_open(GLYPH_SHARED_NAME, GLYPH_SHARED_SIZE);
+    }
+    return cache;
+}
+
+inline uint32_t glyph_shared_bucket(uint32_t font_key, int pixel_size, int codepoint) {
+    uint32_t h = font_key ^ (uint32_t)pixel_size * 0x85EBCA77u ^ (uint32_t)codepoint * 0xC2B2AE3Du;
+    return (h ^ (h >> 15)) & (GLYPH_SHARED_BUCKETS - 1);
+}
+
+inline const SharedGlyph* glyph_shared_find(SharedGlyphHeader* cache, uint32_t font_key,
+                                            int pixel_size, int codepoint) {
+    uint32_t link = __atomic_load_n(&cache->buckets[glyph_shared_bucket(font_key, pixel_size, codepoint)],
+                                    __ATOMIC_ACQUIRE);
+    while (link != 0 && link <= GLYPH_SHARED_ENTRIES) {
+        const SharedGlyph* e = &cache->entries[link - 1];
+        if (e->codepoint == codepoint && e->pixel_size == pixel_size && e->font_key == font_key)
+            return e;
+        link = e->next;
+    }
+    return nullptr;
+}
+
+// Publish a w x h bitmap (rows `stride` bytes apart) and its metrics
+inline void glyph_shared_store(SharedGlyphHeader* cache, uint32_t font_key, int pixel_size,
+                               int codepoint, const CachedGlyph& g, const uint8_t* bitmap, int stride) {
+    uint32_t bytes = ((uint32_t)(g.width * g.height) + 15) & ~15u;
+    uint32_t slot = __atomic_fetch_add(&cache->entry_count, 1, __ATOMIC_RELAXED);
+    if (slot >= GLYPH_SHARED_ENTRIES) return;
+    uint32_t offset = GLYPH_SHARED_DATA + __atomic_fetch_add(&cache->data_used, bytes, __ATOMIC_RELAXED);
+    if (offset + bytes > GLYPH_SHARED_SIZE) return;
+
+    SharedGlyph* e = &cache->entries[slot];
+    for (int row = 0; row < g.height; row++)
+        montauk::memcpy((uint8_t*)cache + offset + row * g.width, bitmap + row * stride, g.width);
+    e->font_key = font_key;
+    e->pixel_size = pixel_size;
+    e->codepoint = codepoint;
+    e->width = (int16_t)g.width;
+    e->height = (int16_t)g.height;
+    e->xoff = (int16_t)g.xoff;
+    e->yoff = (int16_t)g.yoff;
+    e->advance = g.advance;
+    e->offset = offset;
+
+    uint32_t* bucket = &cache->buckets[glyph_shared_bucket(font_key, pixel_size, codepoint)];
+    uint32_t head = __atomic_load_n(bucket, __ATOMIC_RELAXED);
+    do {
+        e->next = head;
+    } while (!__atomic_compare_exchange_n(bucket, &head, slot + 1, true,
+                                          __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+// ---- Glyph atlas ----
+// Every font and size in the process keeps its rasterized glyphs in one
+// alpha atlas, found through a hash keyed by (font, size, codepoint), so
+// any codepoint can be cached and switching sizes never throws glyphs
+// away. The atlas is cut into shelves of glyphs of similar height; when
+// it fills up, the least recently used shelf is emptied and reused.
+
+static constexpr int GLYPH_ATLAS_W = 1024;
+static constexpr int GLYPH_ATLAS_H = 512;
+static constexpr int GLYPH_ATLAS_ENTRIES = 2048;
+static constexpr int GLYPH_ATLAS_BUCKETS = 4096;   // power of two
+static constexpr int GLYPH_ATLAS_SHELVES = 128;
+static constexpr int GLYPH_ATLAS_MAX_H = GLYPH_ATLAS_H / 4;  // taller glyphs are not cached
+
+struct GlyphAtlasEntry {
+    CachedGlyph glyph;
+    uint32_t font_id;
+    int pixel_size;
+    int codepoint;
+    int next;        // hash chain, or free list
+    int shelf;       // -1 if the glyph has no pixels
+    int shelf_next;  // other entries in the same shelf
+};
+
+struct GlyphShelf {
+    int y, height;
+    int used;        // columns filled from the left
+    int entries;     // first entry, linked through shelf_next
+    uint32_t last_used;
+};
+
+struct GlyphAtlas {
+    uint8_t* pixels;
+    GlyphAtlasEntry* entries;
+    int* buckets;
+    GlyphShelf shelves[GLYPH_ATLAS_SHELVES];
+    int shelf_count;
+    int free_entry;
+    uint32_t clock;
+    uint32_t generation;  // bumped whenever glyphs are evicted
+    uint32_t next_font_id;
+
+    // Glyphs too tall for a shelf are rasterized here on every use
+    CachedGlyph scratch;
+    int scratch_size;
+
+    bool ready() {
+        if (pixels) return true;
+        pixels = (uint8_t*)montauk::alloc(GLYPH_ATLAS_W * GLYPH_ATLAS_H);
+        entries = (GlyphAtlasEntry*)montauk::alloc(GLYPH_ATLAS_ENTRIES * sizeof(GlyphAtlasEntry));
+        buckets = (int*)montauk::alloc(GLYPH_ATLAS_BUCKETS * sizeof(int));
+        if (!pixels || !entries || !buckets) {
+            if (pixels) montauk::free(pixels);
+            if (entries) montauk::free(entries);
+            if (buckets) montauk::free(buckets);
+            pixels = nullptr;
+            return false;
+        }
+        reset();
+        return true;
+    }
+
+    // Drop every glyph
+    void reset() {
+        for (int i = 0; i < GLYPH_ATLAS_BUCKETS; i++) buckets[i] = -1;
+        for (int i = 0; i < GLYPH_ATLAS_ENTRIES; i++) entries[i].next = i + 1;
+        entries[GLYPH_ATLAS_ENTRIES - 1].next = -1;
+        free_entry = 0;
+        shelf_count = 0;
+        generation++;
+    }
+
+    static uint32_t hash(uint32_t font_id, int pixel_size, int codepoint) {
+        uint32_t h = font_id * 0x9E3779B1u ^ (uint32_t)pixel_size * 0x85EBCA77u ^
+                     (uint32_t)codepoint * 0xC2B2AE3Du;
+        return (h ^ (h >> 15)) & (GLYPH_ATLAS_BUCKETS - 1);
+    }
+
+    CachedGlyph* find(uint32_t font_id, int pixel_size, int codepoint) {
+        for (int i = buckets[hash(font_id, pixel_size, codepoint)]; i >= 0; i = entries[i].next) {
+            GlyphAtlasEntry* e = &entries[i];
+            if (e->codepoint == codepoint && e->pixel_size == pixel_size && e->font_id == font_id) {
+                if (e->shelf >= 0) shelves[e->shelf].last_used = ++clock;
+                return &e->glyph;
+            }
+        }
+        return nullptr;
+    }
+
+    // Empty shelf `s`, returning its entries to the free list
+    void evict_shelf(int s) {
+        GlyphShelf* sh = &shelves[s];
+        for (int i = sh->entries; i >= 0;) {
+            GlyphAtlasEntry* e = &entries[i];
+            int* link = &buckets[hash(e->font_id, e->pixel_size, e->codepoint)];
+            while (*link != i) link = &entries[*link].next;
+            *link = e->next;
+
+            int next = e->shelf_next;
+            e->next = free_entry;
+            free_entry = i;
+            i = next;
+        }
+        sh->used = 0;
+        sh->entries = -1;
+        generation++;
+    }
+
+    // Find room for a w x h bitmap, evicting if the atlas is full.
+    // Returns the shelf, with the bitmap going at column shelves[s].used.
+    int reserve(int w, int h) {
+        // The tightest shelf with room, so small glyphs do not fill tall shelves
+        int best = -1;
+        for (int s = 0; s < shelf_count; s++) {
+            GlyphShelf* sh = &shelves[s];
+            if (sh->height < h || sh->height > h + h / 2 + 4 || sh->used + w > GLYPH_ATLAS_W) continue;
+            if (best < 0 || sh->height < shelves[best].height) best = s;
+        }
+        if (best >= 0) return best;
+
+        // A new shelf below the others
+        int height = (h + 3) & ~3;
+        int bottom = shelf_count > 0 ? shelves[shelf_count - 1].y + shelves[shelf_count - 1].height : 0;
+        if (shelf_count == GLYPH_ATLAS_SHELVES || bottom + height > GLYPH_ATLAS_H) {
+            // Full: reuse the least recently used shelf tall enough
+            int lru = -1;
+            for (int s = 0; s < shelf_count; s++) {
+                if (shelves[s].height < h) continue;
+                if (lru < 0 || shelves[s].last_used < shelves[lru].last_used) lru = s;
+            }
+            if (lru >= 0) {
+                evict_shelf(lru);
+                return lru;
+            }
+            reset();
+            bottom = 0;
+        }
+
+        GlyphShelf* sh = &shelves[shelf_count];
+        sh->y = bottom;
+        sh->height = height;
+        sh->used = 0;
+        sh->entries = -1;
+        sh->last_used = clock;
+        return shelf_count++;
+    }
+
+    // Rasterize a glyph of `info` into the atlas and return it, or nullptr
+    // if the atlas could not be allocated. With a nonzero `shared_key` the
+    // glyph is copied from the shared glyph cache if it is there, and
+    // published to it otherwise.
+    CachedGlyph* load(const stbtt_fontinfo* info, uint32_t font_id, int pixel_size, float scale,
+                      int codepoint, uint32_t shared_key) {
+        if (!ready()) return nullptr;
+
+        SharedGlyphHeader* shared = shared_key ? glyph_shared_map() : nullptr;
+        if (shared) {
+            const SharedGlyph* sg = glyph_shared_find(shared, shared_key, pixel_size, codepoint);
+            if (sg) return insert(font_id, pixel_size, codepoint, sg);
+        }
+
+        int index = stbtt_FindGlyphIndex(info, codepoint);
+        int advance, lsb;
+        stbtt_GetGlyphHMetrics(info, index, &advance, &lsb);
+        int x0, y0, x1, y1;
+        stbtt_GetGlyphBitmapBox(info, index, scale, scale, &x0, &y0, &x1, &y1);
+        int w = x1 - x0, h = y1 - y0;
+        bool has_pixels = w > 0 && h > 0;
+
+        CachedGlyph g = {};
+        g.width = has_pixels ? w : 0;
+        g.height = has_pixels ? h : 0;
+        g.xoff = x0;
+        g.yoff = y0;
+        g.advance = (int)(advance * scale);
+        g.loaded = true;
+
+        if (has_pixels && (h > GLYPH_ATLAS_MAX_H || w > GLYPH_ATLAS_W)) {
+            if (w * h > scratch_size) {
+                if (scratch.bitmap) montauk::mfree(scratch.bitmap);
+                scratch.bitmap = (uint8_t*)montauk::malloc(w * h);
+                scratch_size = scratch.bitmap ? w * h : 0;
+            }
+            uint8_t* bitmap = scratch.bitmap;
+            scratch = g;
+            scratch.bitmap = bitmap;
+            scratch.stride = w;
+            if (!bitmap) {
+                scratch.width = scratch.height = 0;
+            } else {
+                stbtt_MakeGlyphBitmap(info, bitmap, w, h, w, scale, scale, index);
+            }
+            return &scratch;
+        }
+
+        CachedGlyph* e = add(font_id, pixel_size, codepoint, g);
+        if (e->bitmap)
+            stbtt_MakeGlyphBitmap(info, e->bitmap, w, h, GLYPH_ATLAS_W, scale, scale, index);
+        if (shared) glyph_shared_store(shared, shared_key, pixel_size, codepoint, *e, e->bitmap,
+                                       GLYPH_ATLAS_W);
+        return e;
+    }
+
+    // Copy a glyph found in the shared glyph cache into the atlas
+    CachedGlyph* insert(uint32_t font_id, int pixel_size, int codepoint, const SharedGlyph* sg) {
+        CachedGlyph g = {};
+        g.width = sg->width;
+        g.height = sg->height;
+        g.xoff = sg->xoff;
+        g.yoff = sg->yoff;
+        g.advance = sg->advance;
+        g.loaded = true;
+
+        CachedGlyph* e = add(font_id, pixel_size, codepoint, g);
+        if (e->bitmap) {
+            const uint8_t* src = (const uint8_t*)glyph_shared_map() + sg->offset;
+            for (int row = 0; row < g.height; row++)
+                montauk::memcpy(e->bitmap + row * GLYPH_ATLAS_W, src + row * g.width, g.width);
+        }
+        return e;
+    }
+
+    // Add an entry for `g`, with room in a shelf for its pixels if it has
+    // any; the caller fills in the bitmap
+    CachedGlyph* add(uint32_t font_id, int pixel_size, int codepoint, const CachedGlyph& g) {
+        if (free_entry < 0) reset();
+        int s = g.width > 0 && g.height > 0 ? reserve(g.width, g.height) : -1;
+
+        int i = free_entry;
+        GlyphAtlasEntry* e = &entries[i];
+        free_entry = e->next;
+
+        e->glyph = g;
+        e->glyph.bitmap = nullptr;
+        e->font_id = font_id;
+        e->pixel_size = pixel_size;
+        e->codepoint = codepoint;
+        e->shelf = s;
+        int* bucket = &buckets[hash(font_id, pixel_size, codepoint)];
+        e->next = *bucket;
+        *bucket = i;
+
+        if (s >= 0) {
+            GlyphShelf* sh = &shelves[s];
+            e->glyph.bitmap = pixels + sh->y * GLYPH_ATLAS_W + sh->used;
+            e->glyph.stride = GLYPH_ATLAS_W;
+            sh->used += g.width;
+            sh->last_used = ++clock;
+            e->shelf_next = sh->entries;
+            sh->entries = i;
+        }
+        return &e->glyph;
+    }
+};
+
+inline GlyphAtlas glyph_atlas = {};
+
+// ---- Text run cache ----
+// Widths and pen positions of recently measured or drawn strings, keyed by
+// (font, size, string), with the glyphs they use in the atlas. Layout code
+// that measures the same labels every frame gets the width without walking
+// the glyphs, and drawing a cached run is a series of atlas blits. Longer
+// strings bypass the cache.
+
+static constexpr int TEXT_RUN_MAX_LEN = 48;
+static constexpr int TEXT_RUN_SETS = 32;
+static constexpr int TEXT_RUN_WAYS = 4;
+
+struct TextRun {
+    uint32_t font_id;  // 0 if the slot is empty
+    int pixel_size;
+    uint32_t hash;
+    int len;
+    int width;
+    uint32_t last_used;
+    uint32_t generation;  // atlas generation `glyphs` were looked up in
+    bool bound;           // whether `glyphs` are all in the atlas
+    char text[TEXT_RUN_MAX_LEN];
+    int16_t x[TEXT_RUN_MAX_LEN];  // pen position of each character
+    CachedGlyph* glyphs[TEXT_RUN_MAX_LEN];
+};
+
+struct TextRunCache {
+    TextRun* runs;
+    uint32_t clock;
+
+    bool ready() {
+        if (runs) return true;
+        runs = (TextRun*)montauk::alloc(TEXT_RUN_SETS * TEXT_RUN_WAYS * sizeof(TextRun));
+        if (!runs) return false;
+        montauk::memset(runs, 0, TEXT_RUN_SETS * TEXT_RUN_WAYS * sizeof(TextRun));
+        return true;
+    }
+
+    // The run for `text` (`len` bytes hashing to `hash`), or else the least
+    // recently used slot of its set with font_id cleared
+    TextRun* lookup(uint32_t font_id, int pixel_size, const char* text, int len, uint32_t hash) {
+        TextRun* set = &runs[(hash % TEXT_RUN_SETS) * TEXT_RUN_WAYS];
+        TextRun* victim = &set[0];
+        for (int w = 0; w < TEXT_RUN_WAYS; w++) {
+            TextRun* run = &set[w];
+            if (run->font_id == font_id && run->hash == hash && run->pixel_size == pixel_size &&
+                run->len == len && montauk::memcmp(run->text, text, len) == 0) {
+                run->last_used = ++clock;
+                return run;
+            }
+            if (run->last_used < victim->last_used) victim = run;
+        }
+        victim->font_id = 0;
+        return victim;
+    }
+};
+
+inline TextRunCache text_runs = {};
+
+static constexpr int FONT_MAX_SIZES = 8;
+
 struct TrueTypeFont {
     stbtt_fontinfo info;
     uint8_t* data;
-    GlyphCache caches[4];
+    GlyphCache caches[FONT_MAX_SIZES];
     int cache_count;
+    uint32_t font_id;  // glyph atlas key, assigned on first use
+    uint32_t shared_key;  // shared glyph cache key, from the path; 0 to keep glyphs private
     bool valid;
     bool em_scaling;  // true for PDF embedded fonts: scale by em square, not ascent-descent
 
@@ -70,6 +484,8 @@ struct TrueTypeFont {
         em_scaling = false;
         data = nullptr;
         cache_count = 0;
+        font_id = 0;
+        shared_key = 0;
 
         int fd = montauk::open(vfs_path);
         if (fd < 0) return false;
@@ -80,13 +496,17 @@ struct TrueTypeFont {
             return false;
         }
 
-        data = (uint8_t*)montauk::alloc(size);
+        // Mapped, the font shares the page cache with every other process
+        // using it; read into memory of our own if the file cannot be mapped
+        data = (uint8_t*)montauk::mmap(vfs_path);
         if (!data) {
-            montauk::close(fd);
-            return false;
+            data = (uint8_t*)montauk::alloc(size);
+            if (!data) {
+                montauk::close(fd);
+                return false;
+            }
+            montauk::read(fd, data, 0, size);
         }
-
-        montauk::read(fd, data, 0, size);
         montauk::close(fd);
 
         if (!stbtt_InitFont(&info, data, stbtt_GetFontOffsetForIndex(data, 0))) {
@@ -95,20 +515,15 @@ struct TrueTypeFont {
             return false;
         }
 
+        uint32_t h = 2166136261u;
+        for (int i = 0; vfs_path[i]; i++) h = (h ^ (uint8_t)vfs_path[i]) * 16777619u;
+        shared_key = h ? h : 1;
+
         valid = true;
         return true;
     }
 
     void init_cache(GlyphCache* gc, int pixel_size) {
-        // Free any existing glyph bitmaps
-        for (int i = 0; i < 256; i++) {
-            if (gc->glyphs[i].bitmap) {
-                montauk::mfree(gc->glyphs[i].bitmap);
-            }
-            gc->glyphs[i].bitmap = nullptr;
-            gc->glyphs[i].loaded = false;
-        }
-
         gc->pixel_size = pixel_size;
         gc->scale = em_scaling
             ? stbtt_ScaleForMappingEmToPixels(&info, (float)pixel_size)
@@ -123,64 +538,148 @@ struct TrueTypeFont {
     }
 
     GlyphCache* get_cache(int pixel_size) {
+        if (font_id == 0) font_id = ++glyph_atlas.next_font_id;
+
         // Search existing caches
         for (int i = 0; i < cache_count; i++) {
-            if (caches[i].pixel_size == pixel_size)
+            if (caches[i].pixel_size == pixel_size) {
+                caches[i].last_used = glyph_atlas.clock;
                 return &caches[i];
+            }
         }
 
-        // Use a free slot if available
-        if (cache_count < 4) {
-            GlyphCache* gc = &caches[cache_count++];
-            init_cache(gc, pixel_size);
-            return gc;
+        // Use a free slot if available, else the least recently used one;
+        // only metrics are lost, the size's glyphs stay in the atlas
+        GlyphCache* gc = &caches[0];
+        if (cache_count < FONT_MAX_SIZES) {
+            gc = &caches[cache_count++];
+        } else {
+            for (int i = 1; i < FONT_MAX_SIZES; i++) {
+                if (caches[i].last_used < gc->last_used) gc = &caches[i];
+            }
         }
+        init_cache(gc, pixel_size);
+        gc->last_used = glyph_atlas.clock;
+        return gc;
+    }
 
-        // Evict oldest cache (slot 0) — free its glyph bitmaps
-        for (int g = 0; g < 256; g++) {
-            if (caches[0].glyphs[g].bitmap)
-                montauk::mfree(caches[0].glyphs[g].bitmap);
+    // The glyph for any Unicode codepoint. The pointer stays valid until
+    // the next get_glyph call, which may evict it from the atlas.
+    CachedGlyph* get_glyph(GlyphCache* gc, int codepoint) {
+        if (codepoint < 0 || codepoint > 0x10FFFF) return nullptr;
+        if (glyph_atlas.pixels) {
+            CachedGlyph* g = glyph_atlas.find(font_id, gc->pixel_size, codepoint);
+            if (g) return g;
         }
-        // Shift remaining caches down
-        for (int i = 0; i < 3; i++)
-            montauk::memcpy(&caches[i], &caches[i + 1], sizeof(GlyphCache));
-        montauk::memset(&caches[3], 0, sizeof(GlyphCache));
-        init_cache(&caches[3], pixel_size);
-        return &caches[3];
+        return glyph_atlas.load(&info, font_id, gc->pixel_size, gc->scale, codepoint,
+                                em_scaling ? 0 : shared_key);
     }
 
-    CachedGlyph* get_glyph(GlyphCache* gc, int codepoint) {
-        if (codepoint < 0 || codepoint >= 256) return nullptr;
-        CachedGlyph* g = &gc->glyphs[codepoint];
-        if (g->loaded) return g;
+    // The cached run for `text`, measuring it on a miss; nullptr if the
+    // text is too long to cache
+    TextRun* get_run(GlyphCache* gc, const char* text) {
+        uint32_t hash = 2166136261u;
+        int len = 0;
+        for (; len < TEXT_RUN_MAX_LEN && text[len]; len++)
+            hash = (hash ^ (uint8_t)text[len]) * 16777619u;
+        if (text[len] || !text_runs.ready()) return nullptr;
+
+        TextRun* run = text_runs.lookup(font_id, gc->pixel_size, text, len, hash);
+        if (run->font_id != 0) return run;
+
+        run->pixel_size = gc->pixel_size;
+        run->hash = hash;
+        run->len = len;
+        run->last_used = ++text_runs.clock;
+        montauk::memcpy(run->text, text, len);
+        run->generation = glyph_atlas.generation;
+        run->bound = true;
+        int pen = 0;
+        for (int i = 0; i < len; i++) {
+            CachedGlyph* g = get_glyph(gc, (unsigned char)text[i]);
+            run->x[i] = (int16_t)pen;
+            run->glyphs[i] = g;
+            if (!g || g == &glyph_atlas.scratch) run->bound = false;
+            if (g) pen += g->advance;
+        }
+        run->width = pen;
+        if (run->generation != glyph_atlas.generation) run->bound = false;
+        run->font_id = font_id;
+        return run;
+    }
 
-        g->loaded = true;
-        int advance, lsb;
-        stbtt_GetCodepointHMetrics(&info, codepoint, &advance, &lsb);
-        g->advance = (int)(advance * gc->scale);
+    // Make run->glyphs point into the atlas again after evictions; false
+    // if they cannot all be there at once
+    bool bind_run(GlyphCache* gc, TextRun* run) {
+        if (run->bound && run->generation == glyph_atlas.generation) return true;
+        uint32_t generation = glyph_atlas.generation;
+        run->bound = true;
+        for (int i = 0; i < run->len; i++) {
+            CachedGlyph* g = get_glyph(gc, (unsigned char)run->text[i]);
+            run->glyphs[i] = g;
+            if (!g || g == &glyph_atlas.scratch) run->bound = false;
+        }
+        run->generation = generation;
+        if (glyph_atlas.generation != generation) run->bound = false;
+        return run->bound;
+    }
 
-        int x0, y0, x1, y1;
-        stbtt_GetCodepointBitmapBox(&info, codepoint, gc->scale, gc->scale,
-                                     &x0, &y0, &x1, &y1);
-        g->width = x1 - x0;
-        g->height = y1 - y0;
-        g->xoff = x0;
-        g->yoff = y0;
-
-        if (g->width > 0 && g->height > 0) {
-            g->bitmap = (uint8_t*)montauk::malloc(g->width * g->height);
-            if (!g->bitmap)
-                return g;
-            stbtt_MakeCodepointBitmap(&info, g->bitmap, g->width, g->height,
-                                      g->width, gc->scale, gc->scale, codepoint);
+    // Call fn(glyph, pen_x) for each glyph of `text`, pen_x relative to the start
+    template <typename Fn>
+    void for_each_glyph(GlyphCache* gc, const char* text, Fn fn) {
+        TextRun* run = get_run(gc, text);
+        if (run && bind_run(gc, run)) {
+            for (int i = 0; i < run->len; i++) fn(run->glyphs[i], (int)run->x[i]);
+            return;
+        }
+        int pen = 0;
+        for (int i = 0; text[i]; i++) {
+            CachedGlyph* g = get_glyph(gc, (unsigned char)text[i]);
+            if (!g) continue;
+            fn(g, pen);
+            pen += g->advance;
         }
+    }
 
-        return g;
+    // Blend a glyph with its top-left at (gx, gy) into `pixels`, inside [x0, x1) x [y0, y1)
+    static void blit_glyph(uint32_t* pixels, int buf_w, int gx, int gy, const CachedGlyph* g,
+                           Color color, int x0, int y0, int x1, int y1) {
+        if (!g->bitmap) return;
+        int r0 = y0 - gy > 0 ? y0 - gy : 0;
+        int r1 = y1 - gy < g->height ? y1 - gy : g->height;
+        int c0 = x0 - gx > 0 ? x0 - gx : 0;
+        int c1 = x1 - gx < g->width ? x1 - gx : g->width;
+        uint32_t solid = 0xFF000000 | ((uint32_t)color.r << 16) | ((uint32_t)color.g << 8) | color.b;
+
+        for (int row = r0; row < r1; row++) {
+            const uint8_t* src = g->bitmap + row * g->stride;
+            uint32_t* dst_row = pixels + (gy + row) * buf_w + gx;
+            for (int col = c0; col < c1; col++) {
+                uint8_t alpha = src[col];
+                if (alpha == 0) continue;
+
+                if (alpha == 255) {
+                    dst_row[col] = solid;
+                } else {
+                    uint32_t dst = dst_row[col];
+                    uint8_t dr = (dst >> 16) & 0xFF;
+                    uint8_t dg = (dst >> 8) & 0xFF;
+                    uint8_t db = dst & 0xFF;
+                    uint32_t a = alpha, inv_a = 255 - alpha;
+                    uint32_t rr = (a * color.r + inv_a * dr + 128) / 255;
+                    uint32_t gg = (a * color.g + inv_a * dg + 128) / 255;
+                    uint32_t bb = (a * color.b + inv_a * db + 128) / 255;
+                    dst_row[col] = 0xFF000000 | (rr << 16) | (gg << 8) | bb;
+                }
+            }
+        }
     }
 
     int measure_text(const char* text, int pixel_size) {
         if (!valid) return 0;
         GlyphCache* gc = get_cache(pixel_size);
+        TextRun* run = get_run(gc, text);
+        if (run) return run->width;
         int w = 0;
         for (int i = 0; text[i]; i++) {
             CachedGlyph* g = get_glyph(gc, (unsigned char)text[i]);
@@ -199,28 +698,22 @@ struct TrueTypeFont {
               Color color, int pixel_size) {
         if (!valid) return;
         GlyphCache* gc = get_cache(pixel_size);
-        int cx = x;
         int baseline = y + gc->ascent;
 
-        for (int i = 0; text[i]; i++) {
-            CachedGlyph* g = get_glyph(gc, (unsigned char)text[i]);
-            if (!g) continue;
-
-            if (g->bitmap) {
-                int gx = cx + g->xoff;
-                int gy = baseline + g->yoff;
-                for (int row = 0; row < g->height; row++) {
-                    for (int col = 0; col < g->width; col++) {
-                        uint8_t alpha = g->bitmap[row * g->width + col];
-                        if (alpha > 0) {
-                            Color c = {color.r, color.g, color.b, alpha};
-                            fb.put_pixel_alpha(gx + col, gy + row, c);
-                        }
+        for_each_glyph(gc, text, [&](CachedGlyph* g, int pen) {
+            if (!g->bitmap) return;
+            int gx = x + pen + g->xoff;
+            int gy = baseline + g->yoff;
+            for (int row = 0; row < g->height; row++) {
+                for (int col = 0; col < g->width; col++) {
+                    uint8_t alpha = g->bitmap[row * g->stride + col];
+                    if (alpha > 0) {
+                        Color c = {color.r, color.g, color.b, alpha};
+                        fb.put_pixel_alpha(gx + col, gy + row, c);
                     }
                 }
             }
-            cx += g->advance;
-        }
+        });
     }
 
     void draw_bg(Framebuffer& fb, int x, int y, const char* text,
@@ -241,46 +734,12 @@ struct TrueTypeFont {
                         Color color, int pixel_size) {
         if (!valid) return;
         GlyphCache* gc = get_cache(pixel_size);
-        int cx = x;
         int baseline = y + gc->ascent;
 
-        for (int i = 0; text[i]; i++) {
-            CachedGlyph* g = get_glyph(gc, (unsigned char)text[i]);
-            if (!g) continue;
-
-            if (g->bitmap) {
-                int gx = cx + g->xoff;
-                int gy = baseline + g->yoff;
-                for (int row = 0; row < g->height; row++) {
-                    int dy = gy + row;
-                    if (dy < 0 || dy >= buf_h) continue;
-                    for (int col = 0; col < g->width; col++) {
-                        int dx = gx + col;
-                        if (dx < 0 || dx >= buf_w) continue;
-                        uint8_t alpha = g->bitmap[row * g->width + col];
-                        if (alpha == 0) continue;
-
-                        if (alpha == 255) {
-                            pixels[dy * buf_w + dx] =
-                                0xFF000000 | ((uint32_t)color.r << 16) |
-                                ((uint32_t)color.g << 8) | color.b;
-                        } else {
-                            uint32_t dst = pixels[dy * buf_w + dx];
-                            uint8_t dr = (dst >> 16) & 0xFF;
-                            uint8_t dg = (dst >> 8) & 0xFF;
-                            uint8_t db = dst & 0xFF;
-                            uint32_t a = alpha, inv_a = 255 - alpha;
-                            uint32_t rr = (a * color.r + inv_a * dr + 128) / 255;
-                            uint32_t gg = (a * color.g + inv_a * dg + 128) / 255;
-                            uint32_t bb = (a * color.b + inv_a * db + 128) / 255;
-                            pixels[dy * buf_w + dx] =
-                                0xFF000000 | (rr << 16) | (gg << 8) | bb;
-                        }
-                    }
-                }
-            }
-            cx += g->advance;
-        }
+        for_each_glyph(gc, text, [&](CachedGlyph* g, int pen) {
+            blit_glyph(pixels, buf_w, x + pen + g->xoff, baseline + g->yoff, g, color,
+                       0, 0, buf_w, buf_h);
+        });
     }
 
     // Draw text to buffer with clip rectangle (pixels outside clip_x..clip_x+clip_w are not drawn)
@@ -290,48 +749,16 @@ struct TrueTypeFont {
                         int clip_x, int clip_y, int clip_w, int clip_h) {
         if (!valid) return;
         GlyphCache* gc = get_cache(pixel_size);
-        int cx = x;
         int baseline = y + gc->ascent;
-        int clip_x2 = clip_x + clip_w;
-        int clip_y2 = clip_y + clip_h;
-
-        for (int i = 0; text[i]; i++) {
-            CachedGlyph* g = get_glyph(gc, (unsigned char)text[i]);
-            if (!g) continue;
-
-            if (g->bitmap) {
-                int gx = cx + g->xoff;
-                int gy = baseline + g->yoff;
-                for (int row = 0; row < g->height; row++) {
-                    int dy = gy + row;
-                    if (dy < clip_y || dy >= clip_y2 || dy < 0 || dy >= buf_h) continue;
-                    for (int col = 0; col < g->width; col++) {
-                        int dx = gx + col;
-                        if (dx < clip_x || dx >= clip_x2 || dx < 0 || dx >= buf_w) continue;
-                        uint8_t alpha = g->bitmap[row * g->width + col];
-                        if (alpha == 0) continue;
-
-                        if (alpha == 255) {
-                            pixels[dy * buf_w + dx] =
-                                0xFF000000 | ((uint32_t)color.r << 16) |
-                                ((uint32_t)color.g << 8) | color.b;
-                        } else {
-                            uint32_t dst = pixels[dy * buf_w + dx];
-                            uint8_t dr = (dst >> 16) & 0xFF;
-                            uint8_t dg = (dst >> 8) & 0xFF;
-                            uint8_t db = dst & 0xFF;
-                            uint32_t a = alpha, inv_a = 255 - alpha;
-                            uint32_t rr = (a * color.r + inv_a * dr + 128) / 255;
-                            uint32_t gg = (a * color.g + inv_a * dg + 128) / 255;
-                            uint32_t bb = (a * color.b + inv_a * db + 128) / 255;
-                            pixels[dy * buf_w + dx] =
-                                0xFF000000 | (rr << 16) | (gg << 8) | bb;
-                        }
-                    }
-                }
-            }
-            cx += g->advance;
-        }
+        int x0 = clip_x > 0 ? clip_x : 0;
+        int y0 = clip_y > 0 ? clip_y : 0;
+        int x1 = clip_x + clip_w < buf_w ? clip_x + clip_w : buf_w;
+        int y1 = clip_y + clip_h < buf_h ? clip_y + clip_h : buf_h;
+
+        for_each_glyph(gc, text, [&](CachedGlyph* g, int pen) {
+            blit_glyph(pixels, buf_w, x + pen + g->xoff, baseline + g->yoff, g, color,
+                       x0, y0, x1, y1);
+        });
     }
 
     // Draw single character to buffer, returning advance width
@@ -340,38 +767,7 @@ struct TrueTypeFont {
                             Color color, GlyphCache* gc) {
         CachedGlyph* g = get_glyph(gc, codepoint);
         if (!g) return 0;
-
-        if (g->bitmap) {
-            int gx = x + g->xoff;
-            int gy = baseline + g->yoff;
-            for (int row = 0; row < g->height; row++) {
-                int dy = gy + row;
-                if (dy < 0 || dy >= buf_h) continue;
-                for (int col = 0; col < g->width; col++) {
-                    int dx = gx + col;
-                    if (dx < 0 || dx >= buf_w) continue;
-                    uint8_t alpha = g->bitmap[row * g->width + col];
-                    if (alpha == 0) continue;
-
-                    if (alpha == 255) {
-                        pixels[dy * buf_w + dx] =
-                            0xFF000000 | ((uint32_t)color.r << 16) |
-                            ((uint32_t)color.g << 8) | color.b;
-                    } else {
-                        uint32_t dst = pixels[dy * buf_w + dx];
-                        uint8_t dr = (dst >> 16) & 0xFF;
-                        uint8_t dg = (dst >> 8) & 0xFF;
-                        uint8_t db = dst & 0xFF;
-                        uint32_t a = alpha, inv_a = 255 - alpha;
-                        uint32_t rr = (a * color.r + inv_a * dr + 128) / 255;
-                        uint32_t gg = (a * color.g + inv_a * dg + 128) / 255;
-                        uint32_t bb = (a * color.b + inv_a * db + 128) / 255;
-                        pixels[dy * buf_w + dx] =
-                            0xFF000000 | (rr << 16) | (gg << 8) | bb;
-                    }
-                }
-            }
-        }
+        blit_glyph(pixels, buf_w, x + g->xoff, baseline + g->yoff, g, color, 0, 0, buf_w, buf_h);
         return g->advance;
     }
 };
@@ -388,24 +784,68 @@ namespace fonts {
     inline int TERM_SIZE  = 18;
     inline int LARGE_SIZE = 28;
 
-    inline bool init() {
-        auto load = [](const char* path) -> TrueTypeFont* {
-            TrueTypeFont* f = (TrueTypeFont*)montauk::malloc(sizeof(TrueTypeFont));
-            montauk::memset(f, 0, sizeof(TrueTypeFont));
-            if (!f->init(path)) {
-                montauk::mfree(f);
-                return nullptr;
-            }
-            return f;
-        };
+    // Fonts this process has loaded, by path. A font is loaded once per
+    // process however many parts of it ask for it, so its glyphs are
+    // rasterized into the atlas once; across processes the file is a
+    // shared mapping (SYS_MMAP) and the glyphs go through the shared
+    // glyph cache. The desktop keeps the system fonts mapped all session,
+    // so an app opening them finds their pages already in memory.
+    static constexpr int MAX_OPEN_FONTS = 24;
+
+    struct OpenFont {
+        char path[64];
+        TrueTypeFont* font;
+    };
+
+    inline OpenFont open_fonts[MAX_OPEN_FONTS] = {};
+    inline int open_font_count = 0;
+
+    // The font at `path`, loaded on first use; nullptr if it cannot be.
+    // It stays loaded for the life of the process: do not free it.
+    inline TrueTypeFont* open(const char* path) {
+        for (int i = 0; i < open_font_count; i++) {
+            if (montauk::streq(open_fonts[i].path, path)) return open_fonts[i].font;
+        }
 
-        system_font = load("0:/fonts/Roboto-Medium.ttf");
-        system_bold = load("0:/fonts/Roboto-Bold.ttf");
-        mono        = load("0:/fonts/JetBrainsMono-Regular.ttf");
-        mono_bold   = load("0:/fonts/JetBrainsMono-Bold.ttf");
+        TrueTypeFont* f = (TrueTypeFont*)montauk::malloc(sizeof(TrueTypeFont));
+        if (!f) return nullptr;
+        montauk::memset(f, 0, sizeof(TrueTypeFont));
+        if (!f->init(path)) {
+            montauk::mfree(f);
+            return nullptr;
+        }
+
+        if (open_font_count < MAX_OPEN_FONTS && montauk::slen(path) < (int)sizeof(OpenFont::path)) {
+            OpenFont* of = &open_fonts[open_font_count++];
+            montauk::strcpy(of->path, path);
+            of->font = f;
+        }
+        return f;
+    }
+
+    inline bool init() {
+        system_font = open("0:/fonts/Roboto-Medium.ttf");
+        system_bold = open("0:/fonts/Roboto-Bold.ttf");
+        mono        = open("0:/fonts/JetBrainsMono-Regular.ttf");
+        mono_bold   = open("0:/fonts/JetBrainsMono-Bold.ttf");
 
         return system_font != nullptr;
     }
+
+    // Rasterize the printable ASCII glyphs of the system fonts at the UI
+    // sizes into the shared glyph cache, so apps find them there
+    inline void prewarm() {
+        TrueTypeFont* all[] = {system_font, system_bold, mono, mono_bold};
+        int sizes[] = {UI_SIZE, LARGE_SIZE, TERM_SIZE};
+        for (TrueTypeFont* f : all) {
+            if (!f) continue;
+            for (int i = 0; i < 3; i++) {
+                if (i == 2 && (TERM_SIZE == UI_SIZE || TERM_SIZE == LARGE_SIZE)) continue;
+                GlyphCache* gc = f->get_cache(sizes[i]);
+                for (int c = 32; c < 127; c++) f->get_glyph(gc, c);
+            }
+        }
+    }
 }
 
 } // namespace gui
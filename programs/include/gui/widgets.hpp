@@ -1,6 +1,6 @@
 /*
     * widgets.hpp
-    * MontaukOS GUI widget toolkit (Label, Button, TextBox, Scrollbar)
+    * MontaukOS GUI widget toolkit (Label, Button, TextBox, Scrollbar, VirtualList)
     * Copyright (c) 2025 Daniel Hammer
 */
 
@@ -356,4 +356,138 @@ struct Scrollbar {
     }
 };
 
+// ---- VirtualList ----
+
+// Draws item `index` with its top-left corner at (x, y) of a buf_w x buf_h
+// pixel buffer, typically through Canvas(pixels, buf_w, buf_h). The buffer
+// is a horizontal band of the list's viewport, so the item may be cut off
+// at the top or bottom; it must stay within its own columns.
+using ListItemCallback = void (*)(void* userdata, int index, uint32_t* pixels,
+                                  int buf_w, int buf_h, int x, int y);
+
+// A scrolling list of fixed-size items, or a grid when item_w is set, that
+// only ever lays out and draws the items in view, so its cost does not grow
+// with item_count. Scrolling moves the pixels already on screen and draws
+// just the rows that come into view. The viewport must lie within the
+// target buffer.
+struct VirtualList {
+    Rect bounds;               // viewport, in buffer pixels
+    int item_count;
+    int item_w;                // 0: one item per row, as wide as the viewport
+    int item_h;
+    int scroll_offset;         // pixels from the top of the content
+    Color bg;
+    ListItemCallback draw_item;
+    void* userdata;
+
+    void init(int height_per_item, ListItemCallback cb, void* ud) {
+        bounds = {0, 0, 0, 0};
+        item_count = 0;
+        item_w = 0;
+        item_h = height_per_item;
+        scroll_offset = 0;
+        bg = colors::WINDOW_BG;
+        draw_item = cb;
+        userdata = ud;
+    }
+
+    int columns() const {
+        if (item_w <= 0) return 1;
+        int cols = bounds.w / item_w;
+        return cols < 1 ? 1 : cols;
+    }
+
+    int content_height() const {
+        int cols = columns();
+        return (item_count + cols - 1) / cols * item_h;
+    }
+
+    int max_scroll() const {
+        int ms = content_height() - bounds.h;
+        return ms > 0 ? ms : 0;
+    }
+
+    void clamp_scroll() {
+        scroll_offset = gui_clamp(scroll_offset, 0, max_scroll());
+    }
+
+    // Index of the item under buffer point (px, py), or -1
+    int item_at(int px, int py) const {
+        if (!bounds.contains(px, py) || item_h <= 0) return -1;
+        int cols = columns();
+        int col = item_w > 0 ? (px - bounds.x) / item_w : 0;
+        if (col >= cols) return -1;
+        int index = (py - bounds.y + scroll_offset) / item_h * cols + col;
+        return index < item_count ? index : -1;
+    }
+
+    // Adjust scroll_offset just enough to bring item `index` fully into view
+    void scroll_to_item(int index) {
+        if (index < 0 || index >= item_count) return;
+        int top = index / columns() * item_h;
+        if (top < scroll_offset)
+            scroll_offset = top;
+        else if (top + item_h > scroll_offset + bounds.h)
+            scroll_offset = top + item_h - bounds.h;
+        clamp_scroll();
+    }
+
+    // Clear viewport rows [y0, y1) and draw the items that cross them
+    void draw_rows(uint32_t* pixels, int buf_w, int y0, int y1) const {
+        if (y0 >= y1 || bounds.w <= 0) return;
+        uint32_t* band = pixels + (bounds.y + y0) * buf_w;
+        int band_h = y1 - y0;
+        uint32_t px = bg.to_pixel();
+        for (int y = 0; y < band_h; y++)
+            pixelops::fill(band + y * buf_w + bounds.x, px, bounds.w);
+        if (item_h <= 0 || !draw_item) return;
+
+        int cols = columns();
+        int first = (scroll_offset + y0) / item_h;
+        int last = (scroll_offset + y1 - 1) / item_h;
+        for (int row = first; row <= last; row++) {
+            int iy = row * item_h - scroll_offset - y0;
+            for (int col = 0; col < cols; col++) {
+                int index = row * cols + col;
+                if (index >= item_count) return;
+                draw_item(userdata, index, band, buf_w, band_h, bounds.x + col * item_w, iy);
+            }
+        }
+    }
+
+    // Draw every item in view
+    void draw(uint32_t* pixels, int buf_w) {
+        clamp_scroll();
+        draw_rows(pixels, buf_w, 0, bounds.h);
+    }
+
+    // Scroll to `offset`, given that the buffer still holds the list as
+    // drawn at the current offset: what stays in view is moved, and only
+    // the rows scrolled in are drawn. Returns false if nothing moved.
+    bool scroll_to(uint32_t* pixels, int buf_w, int offset) {
+        offset = gui_clamp(offset, 0, max_scroll());
+        int delta = offset - scroll_offset;
+        if (delta == 0) return false;
+        scroll_offset = offset;
+
+        int h = bounds.h;
+        if (delta >= h || -delta >= h) {
+            draw_rows(pixels, buf_w, 0, h);
+            return true;
+        }
+
+        uint32_t* top = pixels + bounds.y * buf_w + bounds.x;
+        if (delta > 0) {
+            for (int y = 0; y < h - delta; y++)
+                pixelops::copy(top + y * buf_w, top + (y + delta) * buf_w, bounds.w);
+            draw_rows(pixels, buf_w, h - delta, h);
+        } else {
+            for (int y = h - 1; y >= -delta; y--)
+                pixelops::copy(top + y * buf_w, top + (y + delta) * buf_w, bounds.w);
+            draw_rows(pixels, buf_w, 0, -delta);
+        }
+        return true;
+    }
+};
+
 } // namespace gui
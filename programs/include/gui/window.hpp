@@ -67,6 +67,25 @@ struct Window {
     bool external;      // true = shared-memory window from external process
     int  ext_win_id;    // window server ID (valid when external == true)
     uint8_t ext_cursor; // cursor style requested by external app (0=arrow, 1=resize_h, 2=resize_v)
+    // Damage the external app presented since the last compose, in
+    // content coordinates; 0 rects with dirty set = the whole window
+    Rect ext_damage[Montauk::WinMaxDamage];
+    int  ext_damage_count;
+
+    // Frames presented (the window server's count for external windows,
+    // composes while dirty for the desktop's own) and the rate over the
+    // last second, for the frame statistics overlay
+    uint32_t presents;
+    uint32_t presents_mark;
+    uint32_t present_rate;
+
+    // Title bar and its borders, pre-rendered by the desktop and redrawn
+    // only when the width, focus, title or UI font size changes
+    uint32_t* chrome;
+    int  chrome_w;
+    int  chrome_font_size;
+    bool chrome_focused;
+    char chrome_title[MAX_TITLE_LEN];
 
     Rect titlebar_rect() const {
         return {frame.x, frame.y, frame.w, TITLEBAR_HEIGHT};
@@ -0,0 +1,386 @@
+/*
+ * cache.hpp
+ * Persistent HTTP response cache for MontaukOS
+ * Keeps responses on disk with their freshness and validators, and
+ * revalidates stale ones with conditional requests.
+ * Copyright (c) 2026 Daniel Hammer
+ */
+
+#pragma once
+
+#include <montauk/syscall.h>
+#include <montauk/string.h>
+#include <montauk/heap.h>
+#include <montauk/user.h>
+#include <http/http.hpp>
+#include <tls/tls.hpp>
+
+namespace http {
+
+// ----------------------------------------------------------------------------
+// On-disk entries
+// ----------------------------------------------------------------------------
+
+// One file per URL, named by the hash of host + path: this header, the
+// key itself (host then path), then the response as HttpsClient::fetch
+// returned it (status line, headers, de-chunked body).
+static constexpr uint32_t CACHE_MAGIC     = 0x43505448;  // "HTPC"
+static constexpr int      CACHE_MAX_FILES = 256;
+
+struct CacheFileHeader {
+    uint32_t magic;
+    uint32_t key_len;
+    uint64_t key_hash;
+    int64_t  stored_at;         // Unix seconds
+    int64_t  expires_at;        // served without asking until then
+    uint32_t resp_len;
+    uint32_t _pad;
+    char     etag[128];
+    char     last_modified[64];
+};
+
+// Seconds since 1970 from the RTC
+inline int64_t unix_now() {
+    Montauk::DateTime dt;
+    montauk::gettime(&dt);
+    int y = dt.Year - (dt.Month <= 2);
+    int m = dt.Month;
+    int era = y / 400;
+    int yoe = y - era * 400;
+    int doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + dt.Day - 1;
+    int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    int64_t days = (int64_t)era * 146097 + doe - 719468;
+    return days * 86400 + dt.Hour * 3600 + dt.Minute * 60 + dt.Second;
+}
+
+inline uint64_t cache_hash(const char* host, const char* path) {
+    uint64_t h = 0xCBF29CE484222325ull;
+    for (const char* s = host; *s; s++) { h ^= (uint8_t)*s; h *= 0x100000001B3ull; }
+    for (const char* s = path; *s; s++) { h ^= (uint8_t)*s; h *= 0x100000001B3ull; }
+    return h;
+}
+
+// How long a response may be served without revalidation, from its
+// Cache-Control and Age headers; default_ttl if it says nothing. Returns
+// -1 if it must not be stored at all.
+inline int cache_lifetime(char* resp, int len, int default_ttl) {
+    Response r;
+    parse_response(resp, len, &r);
+
+    char cc[128];
+    int ttl = default_ttl;
+    if (get_header(&r, "Cache-Control", cc, sizeof(cc))) {
+        for (char* c = cc; *c; c++)
+            if (*c >= 'A' && *c <= 'Z') *c += 32;
+        const char* ma = nullptr;
+        for (const char* c = cc; *c; c++) {
+            if (montauk::starts_with(c, "no-store")) return -1;
+            if (montauk::starts_with(c, "no-cache")) ttl = 0;
+            if (!ma && montauk::starts_with(c, "max-age=")) ma = c + 8;
+        }
+        if (ma && ttl != 0) {
+            ttl = 0;
+            while (*ma >= '0' && *ma <= '9' && ttl < 100000000)
+                ttl = ttl * 10 + (*ma++ - '0');
+        }
+    }
+
+    char age[16];
+    if (ttl > 0 && get_header(&r, "Age", age, sizeof(age))) {
+        int a = 0;
+        for (const char* c = age; *c >= '0' && *c <= '9' && a < 100000000; c++)
+            a = a * 10 + (*c - '0');
+        ttl = ttl > a ? ttl - a : 0;
+    }
+    return ttl;
+}
+
+// Told that the first `len` bytes of the response a fetch will return are
+// in `resp`, as they arrive. Return false to stop the transfer, which
+// then fails.
+using StreamFn = bool (*)(void* ctx, const char* resp, int len);
+
+// ----------------------------------------------------------------------------
+// Cache
+// ----------------------------------------------------------------------------
+
+// A per-application cache directory, <home>/.cache/<name>, bounded to
+// max_bytes; the least recently stored entries go first. Without a user
+// session the cache stays disabled and everything goes to the network.
+struct Cache {
+    char     dir[160];
+    uint64_t max_bytes;
+    bool     enabled;
+
+    bool init(const char* name, uint64_t maxBytes) {
+        enabled = false;
+        max_bytes = maxBytes;
+        char home[128];
+        if (!montauk::user::get_home_dir(home, sizeof(home))) return false;
+
+        int p = 0;
+        auto append = [&](const char* s) {
+            while (*s && p < (int)sizeof(dir) - 1) dir[p++] = *s++;
+            dir[p] = '\0';
+        };
+        append(home);
+        append("/.cache");
+        montauk::fmkdir(dir);
+        append("/");
+        append(name);
+        montauk::fmkdir(dir);
+
+        uint64_t cursor = 0;
+        Montauk::DirEntryInfo probe;
+        enabled = montauk::readdir_stat(dir, &cursor, &probe, 1) >= 0;
+        return enabled;
+    }
+
+    // The stored response for host + path in buf (NUL-terminated), if it
+    // is still fresh or any_age is set (history navigation, where a
+    // browser shows what it showed before). Returns its length or -1.
+    int lookup(const char* host, const char* path, char* buf, int max, bool any_age = false) {
+        CacheFileHeader hdr;
+        char file[192];
+        if (!open_entry(host, path, &hdr, file)) return -1;
+        if (!any_age && unix_now() >= hdr.expires_at) return -1;
+        return read_response(file, hdr, buf, max);
+    }
+
+    // GET host + path through client, revalidating a stored copy with
+    // If-None-Match / If-Modified-Since and storing what comes back.
+    // `headers` are extra request header lines, each ending in "\r\n".
+    // default_ttl applies to responses without Cache-Control freshness.
+    // If the server cannot be reached (or fails with a 5xx) the stored
+    // copy is returned instead. Returns the response length in buf or -1.
+    // `progress`, if given, sees buf fill up with the response returned:
+    // a fresh one as it streams in, a stored one once, whole. A transfer
+    // it stopped, or that broke off after it saw some of it, does not fall
+    // back on the stored copy.
+    int fetch(tls::HttpsClient& client, const char* host, uint32_t ip, uint16_t port,
+              const char* path, const char* headers, int default_ttl,
+              char* buf, int max, StreamFn progress = nullptr, void* ctx = nullptr) {
+        CacheFileHeader hdr;
+        char file[192];
+        bool have = open_entry(host, path, &hdr, file);
+
+        int reqMax = montauk::slen(path) + montauk::slen(host) + montauk::slen(headers) + 320;
+        char* req = (char*)montauk::malloc(reqMax);
+        if (!req) return -1;
+        int n = 0;
+        auto append = [&](const char* s) {
+            while (*s && n < reqMax - 1) req[n++] = *s++;
+        };
+        append("GET "); append(path); append(" HTTP/1.1\r\nHost: "); append(host);
+        append("\r\n"); append(headers);
+        if (have && hdr.etag[0]) {
+            append("If-None-Match: "); append(hdr.etag); append("\r\n");
+        }
+        if (have && hdr.last_modified[0]) {
+            append("If-Modified-Since: "); append(hdr.last_modified); append("\r\n");
+        }
+        append("\r\n");
+
+        int len = -1;
+        bool streamed = false;
+        if (max > 0) {
+            Stream st = { buf, 0, max, have, 0, false, progress, ctx };
+            int r = client.request(host, ip, port, req, n, stream_append, &st);
+            buf[st.len] = '\0';
+            len = r < 0 ? -1 : st.len;
+            if (st.stopped) {
+                montauk::mfree(req);
+                return -1;
+            }
+            streamed = st.state == 1 && progress;
+        }
+        montauk::mfree(req);
+
+        Response r;
+        int status = len > 0 ? parse_response(buf, len, &r) : -1;
+
+        if (status == 304 && have) {
+            // Still current: extend the stored copy's lifetime
+            int ttl = cache_lifetime(buf, len, default_ttl);
+            len = read_response(file, hdr, buf, max);
+            if (len > 0 && ttl >= 0) {
+                hdr.stored_at = unix_now();
+                hdr.expires_at = hdr.stored_at + ttl;
+                write_entry(file, hdr, host, path, buf);
+                evict();
+            }
+            if (len > 0 && progress) progress(ctx, buf, len);
+            return len;
+        }
+        if (status == 200) {
+            int ttl = cache_lifetime(buf, len, default_ttl);
+            if (enabled && ttl >= 0) {
+                montauk::memset(&hdr, 0, sizeof(hdr));
+                hdr.magic = CACHE_MAGIC;
+                hdr.key_len = montauk::slen(host) + montauk::slen(path);
+                hdr.key_hash = cache_hash(host, path);
+                hdr.stored_at = unix_now();
+                hdr.expires_at = hdr.stored_at + ttl;
+                hdr.resp_len = len;
+                get_header(&r, "ETag", hdr.etag, sizeof(hdr.etag));
+                get_header(&r, "Last-Modified", hdr.last_modified, sizeof(hdr.last_modified));
+                entry_path(host, path, file);
+                write_entry(file, hdr, host, path, buf);
+                evict();
+            }
+            return len;
+        }
+        if ((len <= 0 || status >= 500) && have && !streamed) {
+            int stale = read_response(file, hdr, buf, max);
+            if (stale > 0) {
+                if (progress) progress(ctx, buf, stale);
+                return stale;
+            }
+        }
+        return len;
+    }
+
+private:
+    // A response being collected by fetch. Once its headers are in, a
+    // response that will be returned as it is gets passed on to
+    // `progress` chunk by chunk; a 304, or a 5xx with a stored copy to
+    // fall back on, does not.
+    struct Stream {
+        char*      buf;
+        int        len;
+        int        max;
+        bool       have;       // a stored copy exists
+        int        state;      // 0 = headers incomplete, 1 = passing on, 2 = holding back
+        bool       stopped;    // progress asked to stop
+        StreamFn   progress;
+        void*      ctx;
+    };
+
+    // Like HttpsClient::fetch, reading on once buf is full so the
+    // connection stays in step
+    static bool stream_append(void* c, const char* data, int n) {
+        Stream* st = (Stream*)c;
+        int room = st->max - 1 - st->len;
+        if (n > room) n = room;
+        if (n <= 0) return true;
+        montauk::memcpy(st->buf + st->len, data, n);
+        st->len += n;
+
+        if (st->state == 0) {
+            Response r;
+            st->buf[st->len] = '\0';
+            int status = parse_response(st->buf, st->len, &r);
+            if (status <= 0 || r.body == nullptr) return true;
+            st->state = status == 304 || (status >= 500 && st->have) ? 2 : 1;
+        }
+        if (st->state == 1 && st->progress && !st->progress(st->ctx, st->buf, st->len)) {
+            st->stopped = true;
+            return false;
+        }
+        return true;
+    }
+
+    void entry_path(const char* host, const char* path, char* out) {
+        static const char hex[] = "0123456789abcdef";
+        uint64_t h = cache_hash(host, path);
+        int p = 0;
+        for (const char* s = dir; *s; s++) out[p++] = *s;
+        out[p++] = '/';
+        for (int i = 15; i >= 0; i--) out[p++] = hex[(h >> (i * 4)) & 0xF];
+        out[p] = '\0';
+    }
+
+    // Read and check the header of host + path's entry, if there is one
+    bool open_entry(const char* host, const char* path, CacheFileHeader* hdr, char* file) {
+        if (!enabled) return false;
+        entry_path(host, path, file);
+        int fd = montauk::open(file);
+        if (fd < 0) return false;
+
+        int hostLen = montauk::slen(host), pathLen = montauk::slen(path);
+        uint64_t size = montauk::getsize(fd);
+        bool ok = montauk::read(fd, (uint8_t*)hdr, 0, sizeof(*hdr)) == (int)sizeof(*hdr)
+            && hdr->magic == CACHE_MAGIC && hdr->key_hash == cache_hash(host, path)
+            && hdr->key_len == (uint32_t)(hostLen + pathLen)
+            && size == sizeof(*hdr) + hdr->key_len + hdr->resp_len;
+        if (ok) {
+            // Rule out a hash collision
+            char* key = (char*)montauk::malloc(hdr->key_len);
+            ok = key && montauk::read(fd, (uint8_t*)key, sizeof(*hdr), hdr->key_len) == (int)hdr->key_len
+                && montauk::memcmp(key, host, hostLen) == 0
+                && montauk::memcmp(key + hostLen, path, pathLen) == 0;
+            if (key) montauk::mfree(key);
+        }
+        montauk::close(fd);
+        hdr->etag[sizeof(hdr->etag) - 1] = '\0';
+        hdr->last_modified[sizeof(hdr->last_modified) - 1] = '\0';
+        return ok;
+    }
+
+    int read_response(const char* file, const CacheFileHeader& hdr, char* buf, int max) {
+        if ((int)hdr.resp_len >= max) return -1;
+        int fd = montauk::open(file);
+        if (fd < 0) return -1;
+        int n = montauk::read(fd, (uint8_t*)buf, sizeof(hdr) + hdr.key_len, hdr.resp_len);
+        montauk::close(fd);
+        if (n != (int)hdr.resp_len) return -1;
+        buf[n] = '\0';
+        return n;
+    }
+
+    void write_entry(const char* file, const CacheFileHeader& hdr,
+                     const char* host, const char* path, const char* resp) {
+        int hostLen = montauk::slen(host), pathLen = montauk::slen(path);
+        montauk::fdelete(file);
+        int fd = montauk::fcreate(file);
+        if (fd < 0) return;
+        uint64_t off = 0;
+        montauk::fwrite(fd, (const uint8_t*)&hdr, off, sizeof(hdr));   off += sizeof(hdr);
+        montauk::fwrite(fd, (const uint8_t*)host, off, hostLen);       off += hostLen;
+        montauk::fwrite(fd, (const uint8_t*)path, off, pathLen);       off += pathLen;
+        montauk::fwrite(fd, (const uint8_t*)resp, off, hdr.resp_len);
+        montauk::close(fd);
+    }
+
+    // Delete the oldest entries until the directory fits max_bytes and
+    // CACHE_MAX_FILES. Normally one pass over the directory finds it
+    // already does.
+    void evict() {
+        Montauk::DirEntryInfo* ents = (Montauk::DirEntryInfo*)montauk::malloc(
+            16 * sizeof(Montauk::DirEntryInfo));
+        if (!ents) return;
+
+        for (int round = 0; round < CACHE_MAX_FILES; round++) {
+            uint64_t total = 0, cursor = 0;
+            int files = 0;
+            int64_t oldestTime = 0;
+            char oldest[sizeof(ents[0].name)];
+            oldest[0] = '\0';
+
+            int n;
+            while ((n = montauk::readdir_stat(dir, &cursor, ents, 16)) > 0) {
+                for (int i = 0; i < n; i++) {
+                    if (ents[i].type == Montauk::DT_DIR) continue;
+                    total += ents[i].size;
+                    files++;
+                    if (!oldest[0] || ents[i].mtime < oldestTime) {
+                        oldestTime = ents[i].mtime;
+                        montauk::strncpy(oldest, ents[i].name, sizeof(oldest));
+                    }
+                }
+            }
+            if ((total <= max_bytes && files <= CACHE_MAX_FILES) || !oldest[0]) break;
+
+            char file[192];
+            int p = 0;
+            for (const char* s = dir; *s; s++) file[p++] = *s;
+            file[p++] = '/';
+            for (const char* s = oldest; *s && p < (int)sizeof(file) - 1; s++) file[p++] = *s;
+            file[p] = '\0';
+            if (montauk::fdelete(file) < 0) break;
+        }
+        montauk::mfree(ents);
+    }
+};
+
+} // namespace http
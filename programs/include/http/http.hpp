@@ -313,4 +313,273 @@ inline Response get_plain(const char* host, const char* path,
     return resp;
 }
 
+// ----------------------------------------------------------------------------
+// Streaming downloads
+// ----------------------------------------------------------------------------
+
+static constexpr int SINK_BUF_SIZE = 65536;
+
+// Writes a stream to a file through two buffers: one fills from the
+// network while the process's I/O ring writes the other, so receiving
+// and disk writes overlap. Without a ring it writes synchronously.
+struct FileSink {
+    int      fd;
+    uint64_t offset;            // file offset of the next buffer
+    char*    buf[2];
+    int      fill;              // bytes in buf[cur]
+    int      cur;
+    bool     busy[2];           // buf[i] is being written
+    bool     failed;
+
+    // Open path for writing at resume_at, or create it afresh if 0
+    bool open(const char* path, uint64_t resume_at) {
+        fd = -1;
+        offset = resume_at;
+        fill = 0;
+        cur = 0;
+        busy[0] = busy[1] = false;
+        failed = false;
+        buf[0] = (char*)montauk::malloc(SINK_BUF_SIZE);
+        buf[1] = (char*)montauk::malloc(SINK_BUF_SIZE);
+        if (!buf[0] || !buf[1]) { release(); return false; }
+
+        if (resume_at == 0) {
+            montauk::fdelete(path);
+            fd = montauk::fcreate(path);
+        } else {
+            fd = montauk::open(path);
+        }
+        if (fd < 0) { release(); return false; }
+        return true;
+    }
+
+    bool write(const char* data, int len) {
+        while (len > 0 && !failed) {
+            int n = SINK_BUF_SIZE - fill;
+            if (n > len) n = len;
+            montauk::memcpy(buf[cur] + fill, data, n);
+            fill += n;
+            data += n;
+            len -= n;
+            if (fill == SINK_BUF_SIZE) submit();
+        }
+        return !failed;
+    }
+
+    // Write out what is left and close. Returns false if any write failed.
+    bool close() {
+        if (fill > 0) submit();
+        wait(0);
+        wait(1);
+        if (fd >= 0) montauk::close(fd);
+        release();
+        return !failed;
+    }
+
+private:
+    static Montauk::IoRingHeader* ring() {
+        static Montauk::IoRingHeader* r = nullptr;
+        static bool tried = false;
+        if (!tried) { r = montauk::ioring_setup(4); tried = true; }
+        return r;
+    }
+
+    void release() {
+        if (buf[0]) montauk::mfree(buf[0]);
+        if (buf[1]) montauk::mfree(buf[1]);
+        buf[0] = buf[1] = nullptr;
+    }
+
+    // Hand buf[cur] to the ring and carry on in the other buffer once it
+    // is free again
+    void submit() {
+        Montauk::IoRingHeader* r = ring();
+        if (!r) {
+            if (montauk::fwrite(fd, (const uint8_t*)buf[cur], offset, fill) != fill) failed = true;
+        } else {
+            uint32_t tail = r->sqTail;
+            Montauk::IoSqe* sqe = montauk::ioring_sqe(r, tail);
+            montauk::memset(sqe, 0, sizeof(*sqe));
+            sqe->op = Montauk::IORING_OP_WRITE;
+            sqe->handle = fd;
+            sqe->offset = offset;
+            sqe->addr = (uint64_t)buf[cur];
+            sqe->len = fill;
+            sqe->userData = (uint64_t)cur | ((uint64_t)fill << 1);
+            __atomic_store_n(&r->sqTail, tail + 1, __ATOMIC_RELEASE);
+            montauk::ioring_enter(r, 0);
+            busy[cur] = true;
+        }
+        offset += fill;
+        fill = 0;
+        cur ^= 1;
+        wait(cur);
+    }
+
+    // Reap completions until buf[which] is free
+    void wait(int which) {
+        Montauk::IoRingHeader* r = ring();
+        while (busy[which]) {
+            if (r->cqHead == __atomic_load_n(&r->cqTail, __ATOMIC_ACQUIRE)) {
+                if (montauk::ioring_enter(r, 1) < 0) { failed = true; busy[0] = busy[1] = false; }
+                continue;
+            }
+            Montauk::IoCqe* cqe = montauk::ioring_cqe(r, r->cqHead);
+            int i = (int)(cqe->userData & 1);
+            if (cqe->result != (int64_t)(cqe->userData >> 1)) failed = true;
+            busy[i] = false;
+            __atomic_store_n(&r->cqHead, r->cqHead + 1, __ATOMIC_RELEASE);
+        }
+    }
+};
+
+// Progress of a download, passed to the progress callback as it goes
+struct Download {
+    int      status;            // HTTP status, -1 before (or without) one
+    uint64_t start;             // where this transfer began in the file
+    uint64_t received;          // body bytes written by this transfer
+    uint64_t total;             // full size of the file, 0 if unknown
+    bool     write_error;
+};
+
+using ProgressFn = void (*)(void* ctx, const Download* d);
+
+namespace detail {
+
+struct DownloadState {
+    Download*   d;
+    FileSink    sink;
+    bool        open;
+    const char* path;
+    uint64_t    resume_at;
+    ProgressFn  progress;
+    void*       progress_ctx;
+    uint64_t    last_report;
+};
+
+inline uint64_t parse_u64(const char* s) {
+    uint64_t n = 0;
+    while (*s >= '0' && *s <= '9') n = n * 10 + (*s++ - '0');
+    return n;
+}
+
+// The headers arrive first, then the de-chunked body in pieces
+inline bool download_data(void* ctx, const char* data, int len) {
+    DownloadState* st = (DownloadState*)ctx;
+    Download* d = st->d;
+
+    if (d->status < 0) {
+        Response r;
+        parse_response((char*)data, len, &r);
+        d->status = r.status;
+
+        char v[96];
+        if (r.status == 206 && st->resume_at > 0) {
+            // "bytes <first>-<last>/<total>": only a continuation of what
+            // is on disk will do
+            if (!get_header(&r, "Content-Range", v, sizeof(v)) ||
+                !montauk::starts_with(v, "bytes ") || parse_u64(v + 6) != st->resume_at)
+                return false;
+            const char* slash = v;
+            while (*slash && *slash != '/') slash++;
+            if (*slash == '/' && slash[1] != '*') d->total = parse_u64(slash + 1);
+            d->start = st->resume_at;
+        } else if (r.status == 200) {
+            // The whole file, whatever was asked for
+            if (get_header(&r, "Content-Length", v, sizeof(v))) d->total = parse_u64(v);
+            d->start = 0;
+        } else {
+            return false;
+        }
+        st->open = st->sink.open(st->path, d->start);
+        if (!st->open) { d->write_error = true; return false; }
+        if (st->progress) st->progress(st->progress_ctx, d);
+        return true;
+    }
+
+    if (!st->sink.write(data, len)) { d->write_error = true; return false; }
+    d->received += len;
+    if (st->progress && d->received - st->last_report >= SINK_BUF_SIZE) {
+        st->last_report = d->received;
+        st->progress(st->progress_ctx, d);
+    }
+    return true;
+}
+
+} // namespace detail
+
+// GET host + path straight into the file at out_path, a buffer at a time,
+// so the size is not limited by memory. With resume set and part of the
+// file already there, asks for the rest with a Range request and appends
+// it; a server that answers with the whole file overwrites it instead.
+// tas = nullptr for plain HTTP. Returns true if the body was written in
+// full (including a 416 for a file that is already complete).
+inline bool download(const char* host, uint32_t ip, uint16_t port,
+                     const char* path, const char* out_path, bool resume,
+                     const tls::TrustAnchors* tas, Download* d,
+                     ProgressFn progress = nullptr, void* progress_ctx = nullptr,
+                     tls::AbortCheckFn abort_check = nullptr) {
+    d->status = -1;
+    d->start = 0;
+    d->received = 0;
+    d->total = 0;
+    d->write_error = false;
+
+    static detail::DownloadState st;
+    st.d = d;
+    st.open = false;
+    st.path = out_path;
+    st.resume_at = 0;
+    st.progress = progress;
+    st.progress_ctx = progress_ctx;
+    st.last_report = 0;
+
+    if (resume) {
+        int fd = montauk::open(out_path);
+        if (fd >= 0) {
+            st.resume_at = montauk::getsize(fd);
+            montauk::close(fd);
+        }
+    }
+
+    char headers[96];
+    int p = 0;
+    for (const char* s = "User-Agent: MontaukOS/1.0\r\n"; *s; s++) headers[p++] = *s;
+    if (st.resume_at > 0) {
+        char digits[24];
+        int n = 0;
+        uint64_t v = st.resume_at;
+        while (v) { digits[n++] = '0' + v % 10; v /= 10; }
+        for (const char* s = "Range: bytes="; *s; s++) headers[p++] = *s;
+        while (n) headers[p++] = digits[--n];
+        headers[p++] = '-'; headers[p++] = '\r'; headers[p++] = '\n';
+    }
+    headers[p] = '\0';
+
+    char req[1024];
+    int reqLen = build_request(req, sizeof(req), "GET", host, path,
+                               nullptr, nullptr, 0, headers);
+
+    int r;
+    if (tas) {
+        static tls::HttpsClient client;
+        client.init(*tas);
+        r = client.request(host, ip, port, req, reqLen, detail::download_data, &st, abort_check);
+        client.close_all();
+    } else {
+        r = tls::http_request(ip, port, req, reqLen, detail::download_data, &st, abort_check);
+    }
+
+    if (st.open && !st.sink.close()) d->write_error = true;
+    if (progress && d->status >= 0) progress(progress_ctx, d);
+
+    if (d->status == 416 && st.resume_at > 0) {
+        d->start = st.resume_at;
+        d->total = st.resume_at;
+        return true;
+    }
+    if (r < 0 || d->write_error || (d->status != 200 && d->status != 206)) return false;
+    return d->total == 0 || d->start + d->received == d->total;
+}
+
 } // namespace http
@@ -99,10 +99,40 @@ extern "C" {
 #define MTK_SYS_GETTZ           91
 #define MTK_SYS_GETCWD          95
 #define MTK_SYS_CHDIR           96
+#define MTK_SYS_SHMOPEN         108
+#define MTK_SYS_WINEVENTRING    139
+#define MTK_SYS_WINCHANGES      140
+#define MTK_SYS_PIPE            141
+#define MTK_SYS_PIPE_READ       142
+#define MTK_SYS_PIPE_WRITE      143
+#define MTK_SYS_PIPE_CLOSE      144
+#define MTK_SYS_SPAWN_PIPED     145
+#define MTK_SYS_CHAN_LISTEN     146
+#define MTK_SYS_CHAN_CONNECT    147
+#define MTK_SYS_CHAN_ACCEPT     148
+#define MTK_SYS_CHAN_SEND       149
+#define MTK_SYS_CHAN_RECV       150
+#define MTK_SYS_CHAN_CLOSE      151
+#define MTK_SYS_BATCH           152
+#define MTK_SYS_SPAWN_EX        153
+#define MTK_SYS_GETENV          154
+#define MTK_SYS_FCOPY           155
+#define MTK_SYS_MOUSEEVENTS     156
+#define MTK_SYS_FSYNC           157
 
 #define MTK_SOCK_TCP 1
 #define MTK_SOCK_UDP 2
 
+/* Spawn setup (MTK_SYS_SPAWN_EX) */
+#define MTK_PRIO_INHERIT     (-1)
+#define MTK_SPAWN_ARGS_MAX   256
+#define MTK_SPAWN_ENV_MAX    4096
+#define MTK_SPAWN_STDIN      0
+#define MTK_SPAWN_STDOUT     1
+#define MTK_SPAWN_ACT_DUP    0
+#define MTK_SPAWN_ACT_CLOSE  1
+#define MTK_SPAWN_ACT_PIPE   2
+
 /* Window event types */
 #define MTK_EVENT_KEY    0
 #define MTK_EVENT_MOUSE  1
@@ -136,6 +166,18 @@ typedef struct {
     uint8_t  buttons;
 } mtk_mouse_state;
 
+/* One input event, see Montauk::MouseEvent */
+typedef struct {
+    int32_t  x;
+    int32_t  y;
+    int32_t  dx;
+    int32_t  dy;
+    int32_t  scroll;
+    uint8_t  buttons;
+    uint8_t  _pad[3];
+    uint64_t time_us;
+} mtk_mouse_event;
+
 typedef struct {
     uint8_t type;
     uint8_t _pad[3];
@@ -147,6 +189,26 @@ typedef struct {
     };
 } mtk_win_event;
 
+/* Event queue of a window, see Montauk::WinEventRing */
+#define MTK_WIN_EVENT_RING_SIZE 512u
+#define MTK_WIN_SLOT_READY      0u
+#define MTK_WIN_SLOT_WRITING    1u
+#define MTK_WIN_SLOT_TAKEN      2u
+
+typedef struct {
+    volatile uint32_t state;
+    mtk_win_event event;
+    uint32_t _pad[2];
+} mtk_win_event_slot;
+
+typedef struct {
+    volatile uint32_t head;
+    volatile uint32_t tail;
+    volatile uint32_t dropped;
+    uint32_t _pad[13];
+    mtk_win_event_slot slots[MTK_WIN_EVENT_RING_SIZE];
+} mtk_win_event_ring;
+
 typedef struct {
     int32_t  id;
     uint32_t _pad;
@@ -177,6 +239,8 @@ typedef struct {
     char     os_version[32];
     uint32_t api_version;
     uint32_t max_processes;
+    uint64_t tsc_per_us;
+    uint32_t cpu_count;     /* CPUs online */
 } mtk_sysinfo;
 
 typedef struct {
@@ -184,8 +248,19 @@ typedef struct {
     uint64_t free_bytes;
     uint64_t used_bytes;
     uint64_t page_size;
+    uint64_t heap_reserved_bytes;
+    uint64_t heap_resident_bytes;
+    uint32_t pressure;          /* MTK_MEM_PRESSURE_* */
+    uint32_t pressure_events;   /* changes with every change of pressure */
+    uint64_t swapped_bytes;     /* heap pages compressed out of memory (zram) */
+    uint64_t compressed_bytes;  /* memory holding them */
 } mtk_memstats;
 
+#define MTK_MEM_PRESSURE_NONE     0
+#define MTK_MEM_PRESSURE_LOW      1
+#define MTK_MEM_PRESSURE_MEDIUM   2
+#define MTK_MEM_PRESSURE_CRITICAL 3
+
 typedef struct {
     uint32_t ip_address;
     uint32_t subnet_mask;
@@ -199,11 +274,42 @@ typedef struct {
     int32_t  pid;
     int32_t  parent_pid;
     uint8_t  state;     /* 0=Free, 1=Ready, 2=Running, 3=Blocked, 4=Terminated */
-    uint8_t  _pad[3];
+    uint8_t  priority;  /* scheduling class, 0=Realtime .. 3=Batch */
+    uint8_t  _pad[2];
     char     name[64];
     uint64_t heap_used;
+    uint64_t user_time_us;
+    uint64_t kernel_time_us;
+    uint64_t resident_pages;
+    uint64_t reserved_pages;
+    uint32_t vma_count;
+    uint32_t window_pages;
+    uint32_t sockets;
+    uint32_t open_files;
+    uint64_t voluntary_switches;
+    uint64_t involuntary_switches;
+    int32_t  cpu;       /* CPU running one of its threads, -1 if none */
+    uint32_t threads;
 } mtk_procinfo;
 
+typedef struct {
+    uint32_t action;    /* MTK_SPAWN_ACT_* */
+    uint32_t stream;    /* MTK_SPAWN_STDIN or MTK_SPAWN_STDOUT */
+    int32_t  handle;    /* DUP: pipe end; PIPE: set to the caller's end */
+    uint32_t capacity;  /* PIPE: buffer size, 0 = default */
+} mtk_spawn_action;
+
+typedef struct {
+    const char *path;
+    const char *const *argv;    /* after the program name, NULL-terminated; NULL = none */
+    const char *const *envp;    /* "NAME=value", NULL-terminated; NULL = the caller's */
+    const char *cwd;            /* NULL = the caller's */
+    mtk_spawn_action *actions;
+    uint32_t action_count;
+    int32_t  priority;          /* MTK_PRIO_INHERIT or a class */
+    uint64_t affinity;          /* CPU mask, 0 = any */
+} mtk_spawn_attr;
+
 /* ====================================================================
    Raw syscall wrappers
    ==================================================================== */
@@ -316,10 +422,18 @@ static inline int mtk_proclist(mtk_procinfo *buf, int max) {
     return (int)_mtk_syscall2(MTK_SYS_PROCLIST, (long)buf, (long)max);
 }
 
+static inline int mtk_spawn_ex(mtk_spawn_attr *attr) {
+    return (int)_mtk_syscall1(MTK_SYS_SPAWN_EX, (long)attr);
+}
+
 static inline int mtk_getargs(char *buf, unsigned long max_len) {
     return (int)_mtk_syscall2(MTK_SYS_GETARGS, (long)buf, (long)max_len);
 }
 
+static inline int mtk_getenv_block(char *buf, unsigned long max_len) {
+    return (int)_mtk_syscall2(MTK_SYS_GETENV, (long)buf, (long)max_len);
+}
+
 static inline int mtk_chdir(const char *path) {
     return (int)_mtk_syscall1(MTK_SYS_CHDIR, (long)path);
 }
@@ -368,6 +482,19 @@ static inline int mtk_write(int handle, const uint8_t *buf, unsigned long offset
     return (int)_mtk_syscall4(MTK_SYS_FWRITE, (long)handle, (long)buf, (long)offset, (long)size);
 }
 
+/* Copy `size` bytes between two open files inside the kernel; returns the
+   bytes copied (fewer at the end of the source) or -1 */
+static inline long mtk_fcopy(int src, int dst, unsigned long src_offset,
+                             unsigned long dst_offset, unsigned long size) {
+    return _mtk_syscall5(MTK_SYS_FCOPY, (long)src, (long)dst, (long)src_offset,
+                         (long)dst_offset, (long)size);
+}
+
+/* Write back what was written to the file's drive; 0 or -1 */
+static inline int mtk_fsync(int handle) {
+    return (int)_mtk_syscall1(MTK_SYS_FSYNC, (long)handle);
+}
+
 static inline unsigned long mtk_getsize(int handle) {
     return (unsigned long)_mtk_syscall1(MTK_SYS_GETSIZE, (long)handle);
 }
@@ -412,16 +539,57 @@ static inline void mtk_get_memstats(mtk_memstats *out) {
     _mtk_syscall1(MTK_SYS_MEMSTATS, (long)out);
 }
 
+/* Map the shared memory object `name`, creating it zeroed with `size`
+   bytes if needed; NULL on failure */
+static inline void *mtk_shm_open(const char *name, unsigned long size) {
+    return (void *)_mtk_syscall2(MTK_SYS_SHMOPEN, (long)name, (long)size);
+}
+
 /* ====================================================================
    Timekeeping
    ==================================================================== */
 
+/* Clock page the kernel maps read-only in every process; see
+   Montauk::TimePage. The clock is read from it without a syscall. */
+#define MTK_TIME_PAGE     0x3FE000UL
+#define MTK_TIME_PAGE_TSC 1u
+
+typedef struct {
+    volatile uint32_t seq;        /* odd while the kernel rewrites the page */
+    volatile uint32_t flags;      /* MTK_TIME_PAGE_TSC */
+    volatile uint64_t tsc_per_us;
+    volatile uint64_t tsc_base;
+    volatile uint64_t us_offset;
+    volatile uint64_t ms;         /* tick count, without MTK_TIME_PAGE_TSC */
+} mtk_time_page;
+
+static inline unsigned long mtk_get_us(void) {
+    const mtk_time_page *tp = (const mtk_time_page *)MTK_TIME_PAGE;
+    for (;;) {
+        uint32_t seq = tp->seq;
+        uint64_t us;
+        if (seq & 1) {
+            __asm__ volatile("pause");
+            continue;
+        }
+        if (tp->flags & MTK_TIME_PAGE_TSC) {
+            uint32_t lo, hi;
+            __asm__ volatile("rdtsc" : "=a"(lo), "=d"(hi));
+            us = tp->us_offset + ((((uint64_t)hi << 32) | lo) - tp->tsc_base) / tp->tsc_per_us;
+        } else {
+            us = tp->ms * 1000;
+        }
+        __asm__ volatile("" ::: "memory");
+        if (tp->seq == seq) return (unsigned long)us;
+    }
+}
+
 static inline unsigned long mtk_get_ticks(void) {
-    return (unsigned long)_mtk_syscall0(MTK_SYS_GETTICKS);
+    return mtk_get_us() / 1000;
 }
 
 static inline unsigned long mtk_get_ms(void) {
-    return (unsigned long)_mtk_syscall0(MTK_SYS_GETMILLISECONDS);
+    return mtk_get_us() / 1000;
 }
 
 static inline void mtk_gettime(mtk_datetime *out) {
@@ -466,7 +634,18 @@ static inline int mtk_win_create(const char *title, int w, int h, mtk_win_result
     return (int)_mtk_syscall4(MTK_SYS_WINCREATE, (long)title, (long)w, (long)h, (long)result);
 }
 
+/* Event queues of this process's windows, mapped by the first
+   mtk_win_poll of each and kept by ID % MTK_WIN_RING_SLOTS. Every file
+   including this header has its own. */
+#define MTK_WIN_RING_SLOTS 64
+static struct { int id; mtk_win_event_ring *ring; } _mtk_win_rings[MTK_WIN_RING_SLOTS];
+
 static inline int mtk_win_destroy(int id) {
+    if (id >= 0 && _mtk_win_rings[id % MTK_WIN_RING_SLOTS].ring &&
+        _mtk_win_rings[id % MTK_WIN_RING_SLOTS].id == id) {
+        _mtk_syscall1(MTK_SYS_FREE, (long)_mtk_win_rings[id % MTK_WIN_RING_SLOTS].ring);
+        _mtk_win_rings[id % MTK_WIN_RING_SLOTS].ring = 0;
+    }
     return (int)_mtk_syscall1(MTK_SYS_WINDESTROY, (long)id);
 }
 
@@ -474,8 +653,34 @@ static inline unsigned long mtk_win_present(int id) {
     return (unsigned long)_mtk_syscall1(MTK_SYS_WINPRESENT, (long)id);
 }
 
+/* 1 with the next event, 0 if there is none, -1 if there is no such window */
 static inline int mtk_win_poll(int id, mtk_win_event *event) {
-    return (int)_mtk_syscall2(MTK_SYS_WINPOLL, (long)id, (long)event);
+    mtk_win_event_ring *ring;
+    int slot = id % MTK_WIN_RING_SLOTS;
+    if (id < 0) return -1;
+    ring = _mtk_win_rings[slot].id == id ? _mtk_win_rings[slot].ring : 0;
+    if (!ring) {
+        ring = (mtk_win_event_ring *)_mtk_syscall1(MTK_SYS_WINEVENTRING, (long)id);
+        if (!ring) return (int)_mtk_syscall2(MTK_SYS_WINPOLL, (long)id, (long)event);
+        if (_mtk_win_rings[slot].ring) _mtk_syscall1(MTK_SYS_FREE, (long)_mtk_win_rings[slot].ring);
+        _mtk_win_rings[slot].id = id;
+        _mtk_win_rings[slot].ring = ring;
+    }
+
+    for (;;) {
+        uint32_t tail = ring->tail;
+        uint32_t expected = MTK_WIN_SLOT_READY;
+        mtk_win_event_slot *slot;
+        if (tail == __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE)) return 0;
+        slot = &ring->slots[tail % MTK_WIN_EVENT_RING_SIZE];
+        if (__atomic_compare_exchange_n(&slot->state, &expected, MTK_WIN_SLOT_TAKEN,
+                                        0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            *event = slot->event;
+            __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+            return 1;
+        }
+        __asm__ volatile("pause");
+    }
 }
 
 static inline unsigned long mtk_win_resize(int id, int w, int h) {
@@ -506,6 +711,11 @@ static inline void mtk_get_mouse(mtk_mouse_state *out) {
     _mtk_syscall1(MTK_SYS_MOUSESTATE, (long)out);
 }
 
+/* Take up to `max` queued mouse events, oldest first; returns the count */
+static inline int mtk_mouse_events(mtk_mouse_event *out, int max) {
+    return (int)_mtk_syscall2(MTK_SYS_MOUSEEVENTS, (long)out, (long)max);
+}
+
 /* ====================================================================
    Networking
    ==================================================================== */
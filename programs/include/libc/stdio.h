@@ -30,6 +30,16 @@ typedef struct _FILE {
     int           error;
     int           is_std;
     int           ungetc_buf;
+    /* Stream buffer: bytes read ahead of `pos`, or written but not yet
+       flushed, covering the file from pos - buf_pos */
+    unsigned char *buf;
+    unsigned long buf_size;
+    unsigned long buf_pos;
+    unsigned long buf_len;
+    int           buf_mode;     /* _IOFBF, _IOLBF or _IONBF */
+    int           buf_state;    /* 0 empty, 1 reading, 2 writing */
+    int           buf_owned;
+    struct _FILE *next;         /* open streams, flushed at exit */
 } FILE;
 
 extern FILE *stdin;
@@ -17,6 +17,7 @@ extern "C" {
 int    read(int fd, void *buf, size_t count);
 int    write(int fd, const void *buf, size_t count);
 int    close(int fd);
+int    fsync(int fd);
 long   lseek(int fd, long offset, int whence);
 int    chdir(const char *path);
 char  *getcwd(char *buf, size_t size);
@@ -0,0 +1,29 @@
+/*
+    * args.h
+    * Command-line word splitting for MontaukOS programs
+    * Copyright (c) 2026 Daniel Hammer
+*/
+
+#pragma once
+#include <cstdint>
+#include <montauk/string.h>
+
+namespace montauk {
+
+    // The next space-separated word of `p` into `out`; returns what follows
+    inline const char* next_word(const char* p, char* out, int max) {
+        p = skip_spaces(p);
+        int n = 0;
+        while (*p && *p != ' ' && n < max - 1) out[n++] = *p++;
+        out[n] = '\0';
+        return p;
+    }
+
+    // Leading decimal digits of `s`; 0 if there are none
+    inline uint64_t parse_u64(const char* s) {
+        uint64_t n = 0;
+        while (*s >= '0' && *s <= '9') n = n * 10 + (*s++ - '0');
+        return n;
+    }
+
+}
@@ -0,0 +1,340 @@
+/*
+    * copy.h
+    * Pipelined file copy engine for MontaukOS programs
+    * Copyright (c) 2026 Daniel Hammer
+*/
+
+#pragma once
+#include <montauk/syscall.h>
+#include <montauk/heap.h>
+#include <montauk/string.h>
+
+namespace montauk {
+namespace copy {
+
+    // Files are copied in BLOCK-sized pieces through BUFFERS buffers. Reads
+    // go to one I/O ring and writes to another, each served by its own
+    // kernel thread, so the source is read ahead while the destination is
+    // being written. A block is what ext2 allocates as one contiguous run
+    // next to the file's previous block, so a file's blocks end up
+    // together on disk. Queued files stream through the same buffers back
+    // to back: one file's writes overlap the next one's reads and create,
+    // and its destination is closed from the write ring. A file copied
+    // within one drive skips the buffers and goes through fcopy(), which
+    // moves it in the kernel.
+    static constexpr uint64_t BLOCK = 1024 * 1024;
+    static constexpr int BUFFERS = 4;
+    static constexpr int MAX_QUEUED = 32;
+    static constexpr int PATH_LEN = 256;
+    static constexpr uint32_t RING_ENTRIES = 16;
+    static constexpr uint64_t PROGRESS_MS = 200;
+
+    struct Progress {
+        uint64_t bytesDone;
+        uint64_t bytesTotal;    // of the files opened so far
+        uint64_t bytesPerSec;
+        int filesDone;
+        const char* path;       // destination last written to
+    };
+
+    typedef void (*ProgressFn)(const Progress& progress, void* ctx);
+
+    // Read and write rings, set up on first use. The kernel keeps a ring
+    // until the process exits, so every engine shares these two; nullptr
+    // if they could not be had, and engines copy synchronously.
+    inline Montauk::IoRingHeader* g_rings[2] = {};
+    inline bool g_rings_tried = false;
+
+    inline bool rings_ready() {
+        if (!g_rings_tried) {
+            g_rings_tried = true;
+            g_rings[0] = montauk::ioring_setup(RING_ENTRIES);
+            g_rings[1] = g_rings[0] ? montauk::ioring_setup(RING_ENTRIES) : nullptr;
+        }
+        return g_rings[0] != nullptr && g_rings[1] != nullptr;
+    }
+
+    inline void ring_submit(Montauk::IoRingHeader* ring, uint8_t op, int handle,
+                            void* addr, uint64_t len, uint64_t offset, uint64_t userData) {
+        uint32_t tail = ring->sqTail;
+        Montauk::IoSqe* sqe = montauk::ioring_sqe(ring, tail);
+        montauk::memset(sqe, 0, sizeof(*sqe));
+        sqe->op = op;
+        sqe->handle = handle;
+        sqe->addr = (uint64_t)addr;
+        sqe->len = len;
+        sqe->offset = offset;
+        sqe->userData = userData;
+        __atomic_store_n(&ring->sqTail, tail + 1, __ATOMIC_RELEASE);
+        montauk::ioring_enter(ring, 0);
+    }
+
+    // Take the oldest completion, if there is one
+    inline bool ring_reap(Montauk::IoRingHeader* ring, Montauk::IoCqe& out) {
+        uint32_t head = ring->cqHead;
+        if (head == __atomic_load_n(&ring->cqTail, __ATOMIC_ACQUIRE)) return false;
+        out = *montauk::ioring_cqe(ring, head);
+        __atomic_store_n(&ring->cqHead, head + 1, __ATOMIC_RELEASE);
+        return true;
+    }
+
+    // Queue copies with add() and finish() them; add() runs the queue
+    // itself when it is full. An engine is large: keep it static or on
+    // the heap.
+    struct Engine {
+        struct Job {
+            char src[PATH_LEN];
+            char dst[PATH_LEN];
+            uint64_t size;
+            int in;             // -1 until opened, and again once closed
+            int out;
+        };
+
+        struct Slot {
+            int job;            // -1 when free
+            uint64_t offset;
+            uint64_t len;
+        };
+
+        // A write ring completion for the close of a job's destination
+        static constexpr uint64_t CLOSE_TAG = 1ULL << 32;
+
+        uint8_t* buffers[BUFFERS] = {};
+        Job jobs[MAX_QUEUED];
+        int count = 0;
+        Slot slots[BUFFERS];
+
+        ProgressFn progress = nullptr;
+        void* progressCtx = nullptr;
+        uint64_t bytesDone = 0;
+        uint64_t bytesTotal = 0;
+        int filesDone = 0;
+        uint64_t startMs = 0;
+        uint64_t lastReportMs = 0;
+        const char* lastPath = "";
+
+        bool failed = false;
+        char failedPath[PATH_LEN] = {};
+
+        bool init(ProgressFn fn = nullptr, void* ctx = nullptr) {
+            progress = fn;
+            progressCtx = ctx;
+            for (int i = 0; i < BUFFERS; i++) {
+                buffers[i] = (uint8_t*)montauk::malloc(BLOCK);
+                if (buffers[i] == nullptr) {
+                    destroy();
+                    return false;
+                }
+            }
+            count = 0;
+            bytesDone = bytesTotal = 0;
+            filesDone = 0;
+            failed = false;
+            failedPath[0] = '\0';
+            startMs = lastReportMs = montauk::get_milliseconds();
+            return true;
+        }
+
+        void destroy() {
+            for (int i = 0; i < BUFFERS; i++) {
+                if (buffers[i]) montauk::mfree(buffers[i]);
+                buffers[i] = nullptr;
+            }
+        }
+
+        // Queue a copy of `src` to `dst`; false once a copy has failed
+        bool add(const char* src, const char* dst) {
+            if (failed) return false;
+            if (count == MAX_QUEUED && !finish()) return false;
+            Job& j = jobs[count++];
+            montauk::strncpy(j.src, src, PATH_LEN);
+            montauk::strncpy(j.dst, dst, PATH_LEN);
+            j.size = 0;
+            j.in = j.out = -1;
+            return true;
+        }
+
+        // Copy everything queued. False if any copy failed; failedPath
+        // names its destination.
+        bool finish() {
+            if (count > 0 && !failed) {
+                if (rings_ready()) run_pipelined();
+                else run_sync();
+            }
+            for (int i = 0; i < count; i++) close_job(jobs[i]);
+            count = 0;
+            report(true);
+            return !failed;
+        }
+
+        // Copy one file now, with anything still queued
+        bool copy_file(const char* src, const char* dst) {
+            return add(src, dst) && finish();
+        }
+
+    private:
+        void fail(const Job& j) {
+            if (!failed) montauk::strncpy(failedPath, j.dst, PATH_LEN);
+            failed = true;
+        }
+
+        bool open_job(Job& j) {
+            j.in = montauk::open(j.src);
+            if (j.in < 0) return false;
+            j.size = montauk::getsize(j.in);
+            j.out = montauk::fcreate(j.dst);
+            if (j.out < 0) {
+                montauk::close(j.in);
+                j.in = -1;
+                return false;
+            }
+            bytesTotal += j.size;
+            lastPath = j.dst;
+            return true;
+        }
+
+        // Copy a whole opened file in the kernel; the data never comes up
+        bool kernel_copy(Job& j) {
+            if (j.size > 0 && montauk::fcopy(j.in, j.out, 0, 0, j.size) != (int64_t)j.size) return false;
+            bytesDone += j.size;
+            return true;
+        }
+
+        static bool same_drive(const Job& j) {
+            for (int i = 0; ; i++) {
+                if (j.src[i] != j.dst[i]) return false;
+                if (j.src[i] == ':') return true;
+                if (j.src[i] == '\0') return false;
+            }
+        }
+
+        void close_job(Job& j) {
+            if (j.in >= 0) montauk::close(j.in);
+            if (j.out >= 0) montauk::close(j.out);
+            j.in = j.out = -1;
+        }
+
+        void report(bool force) {
+            if (progress == nullptr) return;
+            uint64_t now = montauk::get_milliseconds();
+            if (!force && now - lastReportMs < PROGRESS_MS) return;
+            lastReportMs = now;
+
+            Progress p;
+            p.bytesDone = bytesDone;
+            p.bytesTotal = bytesTotal;
+            uint64_t elapsed = now - startMs;
+            p.bytesPerSec = elapsed > 0 ? bytesDone * 1000 / elapsed : 0;
+            p.filesDone = filesDone;
+            p.path = lastPath;
+            progress(p, progressCtx);
+        }
+
+        // Without rings: every file in the kernel, one after another
+        void run_sync() {
+            for (int i = 0; i < count && !failed; i++) {
+                Job& j = jobs[i];
+                if (!open_job(j) || !kernel_copy(j)) fail(j);
+                close_job(j);
+                if (!failed) filesDone++;
+                report(false);
+            }
+        }
+
+        void run_pipelined() {
+            Montauk::IoRingHeader* reads = g_rings[0];
+            Montauk::IoRingHeader* writes = g_rings[1];
+            for (int s = 0; s < BUFFERS; s++) slots[s].job = -1;
+
+            int next = 0;               // job to read from next
+            uint64_t readOff = 0;
+            int readsOut = 0, writesOut = 0;
+
+            for (;;) {
+                // Fill every free buffer with the next block
+                for (int s = 0; s < BUFFERS && !failed && next < count; s++) {
+                    if (slots[s].job >= 0) continue;
+                    Job& j = jobs[next];
+                    if (j.in < 0 && j.out < 0 && !open_job(j)) { fail(j); break; }
+                    if (j.size == 0 || same_drive(j)) {
+                        if (!kernel_copy(j)) fail(j);
+                        close_job(j);
+                        if (failed) break;
+                        filesDone++;
+                        next++;
+                        s--;
+                        continue;
+                    }
+
+                    uint64_t len = j.size - readOff < BLOCK ? j.size - readOff : BLOCK;
+                    slots[s] = { next, readOff, len };
+                    ring_submit(reads, Montauk::IORING_OP_READ, j.in, buffers[s], len, readOff, (uint64_t)s);
+                    readsOut++;
+                    readOff += len;
+                    if (readOff == j.size) {
+                        next++;
+                        readOff = 0;
+                    }
+                }
+
+                if (readsOut == 0 && writesOut == 0) break;
+
+                bool reaped = false;
+                Montauk::IoCqe cqe;
+
+                // A block read is written out at once; after a file's last
+                // block its source is closed and its destination queued for
+                // closing behind the write
+                while (ring_reap(reads, cqe)) {
+                    reaped = true;
+                    readsOut--;
+                    Slot& slot = slots[cqe.userData];
+                    Job& j = jobs[slot.job];
+                    bool last = slot.offset + slot.len == j.size;
+                    if (cqe.result != (int64_t)slot.len) fail(j);
+                    if (failed) {
+                        slot.job = -1;
+                        continue;
+                    }
+
+                    ring_submit(writes, Montauk::IORING_OP_WRITE, j.out, buffers[cqe.userData],
+                                slot.len, slot.offset, cqe.userData);
+                    writesOut++;
+                    if (last) {
+                        montauk::close(j.in);
+                        j.in = -1;
+                        ring_submit(writes, Montauk::IORING_OP_CLOSE, j.out, nullptr, 0, 0,
+                                    CLOSE_TAG | (uint64_t)slot.job);
+                        writesOut++;
+                    }
+                }
+
+                while (ring_reap(writes, cqe)) {
+                    reaped = true;
+                    writesOut--;
+                    if (cqe.userData & CLOSE_TAG) {
+                        Job& j = jobs[cqe.userData & ~CLOSE_TAG];
+                        j.out = -1;
+                        filesDone++;
+                        continue;
+                    }
+                    Slot& slot = slots[cqe.userData];
+                    if (cqe.result != (int64_t)slot.len) fail(jobs[slot.job]);
+                    bytesDone += slot.len;
+                    lastPath = jobs[slot.job].dst;
+                    slot.job = -1;
+                }
+                report(false);
+
+                // Reads are the quick side; once none is pending the
+                // destination is what is being waited for
+                if (!reaped) {
+                    if (readsOut > 0) montauk::ioring_enter(reads, 1);
+                    else montauk::ioring_enter(writes, 1);
+                }
+            }
+        }
+    };
+
+}
+}
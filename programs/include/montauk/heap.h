@@ -7,41 +7,104 @@
 #pragma once
 #include <montauk/syscall.h>
 #include <montauk/string.h>
+#include <montauk/sync.h>
 
 namespace montauk {
 namespace heap_detail {
 
-    static constexpr uint64_t HEADER_MAGIC = 0x5A484541;  // "ZHEA"
-    static constexpr uint64_t FREED_MAGIC  = 0xDEADFEEE;
+    static constexpr uint64_t HEADER_MAGIC  = 0x5A484541;  // "ZHEA"
+    static constexpr uint64_t TRACKED_MAGIC = 0x5A484554;  // "ZHET", call site slot in the upper half
+    static constexpr uint64_t FREED_MAGIC   = 0xDEADFEEE;
 
     struct Header {
         uint64_t magic;
         uint64_t size;     // user-requested size
     } __attribute__((packed));
 
+    // A free block. The magic stays FREED_MAGIC while it is on a list,
+    // so a second mfree of it is caught.
     struct FreeNode {
-        uint64_t  size;    // total size of this free block (including node)
+        uint64_t  magic;
         FreeNode* next;
     };
 
-    // Segregated free lists: power-of-2 size classes for blocks <= 4096 bytes.
-    // Blocks larger than 4096 go to the overflow list.
+    // Blocks allocated while heap statistics are recorded carry
+    // TRACKED_MAGIC, so that only they are counted when freed
+    static inline bool is_allocated(uint64_t magic) {
+        return magic == HEADER_MAGIC || (uint32_t)magic == TRACKED_MAGIC;
+    }
+
+    // Blocks (header included) come in three kinds:
+    //  - small, up to 4096 bytes: power-of-2 size classes, cut from 64 KiB
+    //    spans. Each thread has its own free list per class and its own
+    //    spans, so small malloc and mfree take no lock. A block freed by
+    //    a thread other than its span's owner is pushed onto the span's
+    //    lock-free remote list, which the owner takes back when it runs
+    //    out.
+    //  - mid-sized, up to 256 KiB: runs of whole pages, kept on free lists
+    //    by page count behind one lock.
+    //  - large: mapped with SYS_ALLOC on their own and handed back with
+    //    SYS_FREE.
     static constexpr int NUM_BUCKETS = 8;
     static constexpr uint64_t BUCKET_SIZES[NUM_BUCKETS] = {
         32, 64, 128, 256, 512, 1024, 2048, 4096
     };
 
+    static constexpr uint64_t PAGE_SIZE     = 0x1000;
+    static constexpr uint64_t SPAN_SIZE     = 0x10000;   // Aligned to its size
+    static constexpr uint64_t SPAN_HEADER   = 64;        // Span at the start, blocks after it
+    static constexpr uint64_t MID_MAX       = 0x40000;
+    static constexpr int      MAX_RUN_PAGES = (int)(MID_MAX / PAGE_SIZE);
+
+    // Spans and runs are cut from arenas. An arena stays under 2 MiB so
+    // that the kernel never backs it with a huge page.
+    static constexpr uint64_t ARENA_SIZE    = 0x100000;
+
+    struct Cache;
+
+    struct Span {
+        Cache*    owner;
+        Span*     next;               // Owner's spans of this class
+        uint32_t  cls;
+        uint32_t  bump;               // Offset of the first block never handed out
+        FreeNode* remote;             // Freed by other threads; pushed and taken atomically
+    };
+    static_assert(sizeof(Span) <= SPAN_HEADER);
+
+    // A thread's small-block state. Caches are picked by stack window
+    // (see current_cache), and a thread that takes over the window of one
+    // that exited takes over its cache too.
+    struct Cache {
+        FreeNode* local[NUM_BUCKETS];
+        Span*     current[NUM_BUCKETS];   // Span still being cut up
+        Span*     spans[NUM_BUCKETS];     // All spans of the class it owns
+        uint32_t  remotePending;          // Remote frees since the last drain
+        bool      shared;                 // Used from unknown stacks, behind `lock`
+        Mutex     lock;
+        uint64_t  freeBytes;              // On the local lists, for reports
+    };
+
+    // One cache per thread stack window, one for the main stack, and a
+    // shared one for code running on any other stack
+    static constexpr int MAIN_CACHE   = 0;
+    static constexpr int SHARED_CACHE = Montauk::USER_THREAD_SLOTS + 1;
+    static constexpr int NUM_CACHES   = Montauk::USER_THREAD_SLOTS + 2;
+
     // Per-process heap state — must be `inline` (not `static`) so that all
     // translation units in a multi-TU program share a single heap.
-    inline FreeNode* g_buckets[NUM_BUCKETS] = {};
-    inline FreeNode  g_overflow{0, nullptr};
-    inline bool      g_initialized = false;
+    inline Cache*    g_caches[NUM_CACHES] = {};
+    inline Mutex     g_lock;                     // Guards everything below
+    inline uint64_t  g_spanNext = 0, g_spanEnd = 0;
+    inline uint64_t  g_runNext = 0, g_runEnd = 0;
+    inline FreeNode* g_runs[MAX_RUN_PAGES + 1] = {};
+    inline uint64_t  g_runFreeBytes = 0;
+    inline uint64_t  g_mappedBytes = 0;          // Taken from SYS_ALLOC and not handed back
 
     static inline Header* get_header(void* block) {
         return (Header*)((uint8_t*)block - sizeof(Header));
     }
 
-    // Determine which bucket a block size belongs to, or -1 for overflow
+    // Determine which bucket a block size belongs to, or -1 for mid/large
     static inline int bucket_index(uint64_t blockSize) {
         if (blockSize <= 32)   return 0;
         if (blockSize <= 64)   return 1;
@@ -54,133 +117,466 @@ namespace heap_detail {
         return -1;
     }
 
-    // Insert into overflow list (sorted by address, with adjacent-block coalescing)
-    static inline void insert_overflow(void* ptr, uint64_t size) {
-        auto* node = (FreeNode*)ptr;
-        node->size = size;
+    static inline uint64_t block_size(uint64_t size) {
+        return (size + sizeof(Header) + 15) & ~15ULL;
+    }
+
+    // Bytes a block for `size` really has; two sizes with the same
+    // capacity share a block, so a realloc between them stays in place
+    static inline uint64_t capacity(uint64_t size) {
+        uint64_t block = block_size(size);
+        int idx = bucket_index(block);
+        if (idx >= 0) return BUCKET_SIZES[idx];
+        return (block + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+    }
+
+    static inline void* map(uint64_t bytes) {
+        void* mem = montauk::alloc(bytes);
+        if (mem != nullptr) __atomic_fetch_add(&g_mappedBytes, bytes, __ATOMIC_RELAXED);
+        return mem;
+    }
+
+    static inline void unmap(void* mem, uint64_t bytes) {
+        montauk::free(mem);
+        __atomic_fetch_sub(&g_mappedBytes, bytes, __ATOMIC_RELAXED);
+    }
+
+    // ---- Page runs (g_lock held) ----
+
+    static inline void push_run(uint64_t addr, int pages) {
+        auto* node = (FreeNode*)addr;
+        node->magic = FREED_MAGIC;
+        node->next = g_runs[pages];
+        g_runs[pages] = node;
+        g_runFreeBytes += pages * PAGE_SIZE;
+    }
 
-        FreeNode* prev = &g_overflow;
-        FreeNode* cur  = g_overflow.next;
-        while (cur != nullptr && cur < node) {
-            prev = cur;
-            cur  = cur->next;
+    // What is left of an arena goes to the run lists
+    static inline void retire_run_arena() {
+        while (g_runNext < g_runEnd) {
+            uint64_t pages = (g_runEnd - g_runNext) / PAGE_SIZE;
+            if (pages > (uint64_t)MAX_RUN_PAGES) pages = MAX_RUN_PAGES;
+            push_run(g_runNext, (int)pages);
+            g_runNext += pages * PAGE_SIZE;
         }
+    }
 
-        bool merged_prev = false;
-        if (prev != &g_overflow &&
-            (uint8_t*)prev + prev->size == (uint8_t*)node) {
-            prev->size += size;
-            node = prev;
-            merged_prev = true;
+    // The smallest free run that fits, split if larger, or fresh pages
+    static inline void* take_run(int pages) {
+        for (int p = pages; p <= MAX_RUN_PAGES; p++) {
+            FreeNode* node = g_runs[p];
+            if (node == nullptr) continue;
+            g_runs[p] = node->next;
+            g_runFreeBytes -= p * PAGE_SIZE;
+            if (p > pages) push_run((uint64_t)node + pages * PAGE_SIZE, p - pages);
+            return node;
         }
 
-        if (cur != nullptr &&
-            (uint8_t*)node + node->size == (uint8_t*)cur) {
-            node->size += cur->size;
-            node->next  = cur->next;
-            if (!merged_prev) prev->next = node;
-        } else if (!merged_prev) {
-            node->next = cur;
-            prev->next = node;
+        if (g_runEnd - g_runNext < pages * PAGE_SIZE) {
+            void* arena = map(ARENA_SIZE);
+            if (arena == nullptr) return nullptr;
+            retire_run_arena();
+            g_runNext = (uint64_t)arena;
+            g_runEnd = g_runNext + ARENA_SIZE;
         }
+        void* run = (void*)g_runNext;
+        g_runNext += pages * PAGE_SIZE;
+        return run;
     }
 
-    // Take a block of at least `needed` bytes from the overflow list.
-    // Splits remainder back into overflow if worthwhile.
-    static inline void* take_from_overflow(uint64_t needed) {
-        FreeNode* prev = &g_overflow;
-        FreeNode* cur  = g_overflow.next;
+    // ---- Spans ----
 
-        while (cur != nullptr) {
-            if (cur->size >= needed) {
-                uint64_t blockSize = cur->size;
-                prev->next = cur->next;
+    // A fresh span for `cache`, cut from the span arena
+    static inline Span* new_span(Cache* cache, int cls) {
+        g_lock.lock();
+        if (g_spanNext == g_spanEnd) {
+            // One span's worth of slack leaves room to align
+            void* arena = map(ARENA_SIZE + SPAN_SIZE);
+            if (arena == nullptr) {
+                g_lock.unlock();
+                return nullptr;
+            }
+            g_spanNext = ((uint64_t)arena + SPAN_SIZE - 1) & ~(SPAN_SIZE - 1);
+            g_spanEnd = g_spanNext + ARENA_SIZE;
+        }
+        auto* span = (Span*)g_spanNext;
+        g_spanNext += SPAN_SIZE;
+        g_lock.unlock();
+
+        span->owner = cache;
+        span->cls = cls;
+        span->bump = SPAN_HEADER;
+        span->remote = nullptr;
+        span->next = cache->spans[cls];
+        cache->spans[cls] = span;
+        return span;
+    }
+
+    static inline Span* span_of(void* block) {
+        return (Span*)((uint64_t)block & ~(SPAN_SIZE - 1));
+    }
 
-                if (blockSize > needed + sizeof(FreeNode) + 16) {
-                    insert_overflow((uint8_t*)cur + needed, blockSize - needed);
+    // Take back every block other threads freed into the cache's spans
+    static inline void drain_remote(Cache* cache) {
+        if (__atomic_exchange_n(&cache->remotePending, 0, __ATOMIC_ACQUIRE) == 0) return;
+        for (int cls = 0; cls < NUM_BUCKETS; cls++) {
+            for (Span* span = cache->spans[cls]; span != nullptr; span = span->next) {
+                FreeNode* list = __atomic_exchange_n(&span->remote, nullptr, __ATOMIC_ACQUIRE);
+                while (list != nullptr) {
+                    FreeNode* next = list->next;
+                    list->next = cache->local[cls];
+                    cache->local[cls] = list;
+                    cache->freeBytes += BUCKET_SIZES[cls];
+                    list = next;
                 }
-                return (void*)cur;
             }
-            prev = cur;
-            cur  = cur->next;
         }
-        return nullptr;
     }
 
-    static inline bool grow(uint64_t bytes) {
-        uint64_t pages = (bytes + 0xFFF) / 0x1000;
-        if (pages < 4) pages = 4;
+    // A block of class `cls` when the local list is empty
+    static inline void* refill(Cache* cache, int cls) {
+        drain_remote(cache);
+        FreeNode* node = cache->local[cls];
+        if (node != nullptr) {
+            cache->local[cls] = node->next;
+            cache->freeBytes -= BUCKET_SIZES[cls];
+            return node;
+        }
+
+        Span* span = cache->current[cls];
+        if (span == nullptr || span->bump + BUCKET_SIZES[cls] > SPAN_SIZE) {
+            span = new_span(cache, cls);
+            if (span == nullptr) return nullptr;
+            cache->current[cls] = span;
+        }
+        void* block = (uint8_t*)span + span->bump;
+        span->bump += BUCKET_SIZES[cls];
+        return block;
+    }
 
-        void* mem = montauk::alloc(pages * 0x1000);
-        if (mem == nullptr) return false;
-        insert_overflow(mem, pages * 0x1000);
-        return true;
+    static Cache* create_cache(int idx) {
+        if (idx == SHARED_CACHE) g_lock.lock();
+        Cache* cache = g_caches[idx];
+        if (cache == nullptr) {
+            // Pages from SYS_ALLOC come zeroed
+            cache = (Cache*)map((sizeof(Cache) + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1));
+            if (cache != nullptr) {
+                cache->shared = idx == SHARED_CACHE;
+                __atomic_store_n(&g_caches[idx], cache, __ATOMIC_RELEASE);
+            }
+        }
+        if (idx == SHARED_CACHE) g_lock.unlock();
+        return cache;
     }
 
-    // Refill a small-block bucket by carving a page-sized chunk from overflow
-    static inline bool refill_bucket(int idx) {
-        uint64_t bsize = BUCKET_SIZES[idx];
-        uint64_t chunk = (bsize < 4096) ? 4096 : bsize;
+    // The calling thread's cache, told by which stack window it runs on.
+    // Two running threads never share a window.
+    static inline Cache* current_cache() {
+        uint64_t sp;
+        asm volatile("mov %%rsp, %0" : "=r"(sp));
+
+        int idx = SHARED_CACHE;
+        if (sp >= Montauk::USER_THREAD_STACK_TOP && sp < Montauk::USER_STACK_TOP) {
+            idx = MAIN_CACHE;
+        } else if (sp < Montauk::USER_THREAD_STACK_TOP) {
+            uint64_t window = (Montauk::USER_THREAD_STACK_TOP - 1 - sp) / Montauk::USER_THREAD_STACK_STRIDE;
+            if (window < (uint64_t)Montauk::USER_THREAD_SLOTS) idx = 1 + (int)window;
+        }
+
+        Cache* cache = __atomic_load_n(&g_caches[idx], __ATOMIC_ACQUIRE);
+        return cache != nullptr ? cache : create_cache(idx);
+    }
 
-        void* block = take_from_overflow(chunk);
-        if (block == nullptr) {
-            if (!grow(chunk)) return false;
-            block = take_from_overflow(chunk);
-            if (block == nullptr) return false;
+    static inline void* alloc_small(int cls) {
+        Cache* cache = current_cache();
+        if (cache == nullptr) return nullptr;
+        if (cache->shared) cache->lock.lock();
+
+        void* block;
+        FreeNode* node = cache->local[cls];
+        if (node != nullptr) {
+            cache->local[cls] = node->next;
+            cache->freeBytes -= BUCKET_SIZES[cls];
+            block = node;
+        } else {
+            block = refill(cache, cls);
         }
 
-        uint64_t count = chunk / bsize;
-        for (uint64_t i = 0; i < count; i++) {
-            auto* node = (FreeNode*)((uint8_t*)block + i * bsize);
-            node->size = bsize;
-            node->next = g_buckets[idx];
-            g_buckets[idx] = node;
+        if (cache->shared) cache->lock.unlock();
+        return block;
+    }
+
+    static inline void free_small(void* block, int cls) {
+        auto* node = (FreeNode*)block;
+        Span* span = span_of(block);
+        Cache* cache = current_cache();
+
+        if (span->owner == cache) {
+            if (cache->shared) cache->lock.lock();
+            node->next = cache->local[cls];
+            cache->local[cls] = node;
+            cache->freeBytes += BUCKET_SIZES[cls];
+            if (cache->shared) cache->lock.unlock();
+            return;
         }
-        return true;
+
+        // Another thread's block: push it, then tell the owner
+        FreeNode* head = __atomic_load_n(&span->remote, __ATOMIC_RELAXED);
+        do {
+            node->next = head;
+        } while (!__atomic_compare_exchange_n(&span->remote, &head, node, true,
+                                              __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+        __atomic_fetch_add(&span->owner->remotePending, 1, __ATOMIC_RELEASE);
     }
 
-} // namespace heap_detail
+    // ---- Heap statistics ----
 
-    // ---- Public API ----
+    // Counts are kept per size class (the buckets, then mid-sized and
+    // large blocks) and per call site. Sizes are the ones requested.
+    static constexpr int CLASS_MID   = NUM_BUCKETS;
+    static constexpr int CLASS_LARGE = NUM_BUCKETS + 1;
+    static constexpr int NUM_CLASSES = NUM_BUCKETS + 2;
+    static constexpr int MAX_SITES = 1024;    // Power of two; slot 0 gathers sites that found no slot
+    static constexpr int REPORT_SITES = 16;
+    static constexpr uint64_t REPORT_SIZE = 0x10000;
 
-    inline void* malloc(uint64_t size) {
-        using namespace heap_detail;
+    struct ClassStats {
+        uint64_t allocs, frees;
+        uint64_t liveBlocks, peakBlocks;
+    };
+
+    struct SiteStats {
+        uint64_t pc;
+        uint64_t allocs;
+        uint64_t liveBlocks, liveBytes;
+    };
 
-        if (!g_initialized) {
-            grow(16 * 0x1000);             // seed with 64 KiB
-            g_initialized = true;
+    struct Stats {
+        ClassStats classes[NUM_CLASSES];
+        SiteStats  sites[MAX_SITES];
+        uint64_t   allocs, frees;
+        uint64_t   liveBytes, peakBytes;
+        char       exitPath[128];     // Report written by exit(); empty = the terminal
+    };
+
+    // Allocated with SYS_ALLOC by heap_stats_enable(), never freed.
+    // Updated under g_lock.
+    inline Stats* g_stats = nullptr;
+
+    // Address of the code this is inlined into, to tell call sites apart
+    [[gnu::always_inline]] static inline uint64_t here() {
+        uint64_t pc;
+        asm volatile("lea 0(%%rip), %0" : "=r"(pc));
+        return pc;
+    }
+
+    static inline int class_index(uint64_t size) {
+        uint64_t block = block_size(size);
+        int idx = bucket_index(block);
+        if (idx >= 0) return idx;
+        return block <= MID_MAX ? CLASS_MID : CLASS_LARGE;
+    }
+
+    static inline uint64_t site_slot(uint64_t pc) {
+        uint64_t h = (pc * 0x9E3779B97F4A7C15ULL) >> 54;
+        for (int probe = 0; probe < 16; probe++) {
+            uint64_t slot = (h + probe) & (MAX_SITES - 1);
+            if (slot == 0) continue;
+            SiteStats& site = g_stats->sites[slot];
+            if (site.pc == pc) return slot;
+            if (site.pc == 0) {
+                site.pc = pc;
+                return slot;
+            }
         }
+        return 0;
+    }
 
-        // Guard against overflow: size + Header must not wrap
-        if (size > UINT64_MAX - sizeof(Header) - 15)
-            return nullptr;
+    static inline void add_live_bytes(uint64_t slot, int64_t delta) {
+        g_stats->sites[slot].liveBytes += delta;
+        g_stats->liveBytes += delta;
+        if (g_stats->liveBytes > g_stats->peakBytes) g_stats->peakBytes = g_stats->liveBytes;
+    }
 
-        uint64_t needed = size + sizeof(Header);
-        needed = (needed + 15) & ~15ULL;
+    [[gnu::noinline]] static void note_alloc(void* ptr, uint64_t pc) {
+        Header* header = get_header(ptr);
+        g_lock.lock();
+        uint64_t slot = site_slot(pc);
+        header->magic = TRACKED_MAGIC | (slot << 32);
+
+        ClassStats& c = g_stats->classes[class_index(header->size)];
+        c.allocs++;
+        c.liveBlocks++;
+        if (c.liveBlocks > c.peakBlocks) c.peakBlocks = c.liveBlocks;
+        g_stats->sites[slot].allocs++;
+        g_stats->sites[slot].liveBlocks++;
+        g_stats->allocs++;
+        add_live_bytes(slot, (int64_t)header->size);
+        g_lock.unlock();
+    }
 
-        int idx = bucket_index(needed);
+    [[gnu::noinline]] static void note_free(Header* header) {
+        if ((uint32_t)header->magic != TRACKED_MAGIC) return;
+        uint64_t slot = header->magic >> 32;
+
+        g_lock.lock();
+        ClassStats& c = g_stats->classes[class_index(header->size)];
+        c.frees++;
+        c.liveBlocks--;
+        g_stats->sites[slot].liveBlocks--;
+        g_stats->frees++;
+        add_live_bytes(slot, -(int64_t)header->size);
+        g_lock.unlock();
+    }
 
-        if (idx >= 0) {
-            // Small allocation — use segregated bucket (O(1))
-            if (g_buckets[idx] == nullptr && !refill_bucket(idx))
-                return nullptr;
+    // Resized in place, so the block keeps its class
+    [[gnu::noinline]] static void note_resize(Header* header, uint64_t size) {
+        if ((uint32_t)header->magic != TRACKED_MAGIC) return;
+        g_lock.lock();
+        add_live_bytes(header->magic >> 32, (int64_t)size - (int64_t)header->size);
+        g_lock.unlock();
+    }
+
+    // Text report builder: appends up to the buffer's end
+    struct Report {
+        char*    buf;
+        uint64_t len, cap;
+
+        void str(const char* s) {
+            while (*s && len + 1 < cap) buf[len++] = *s++;
+            buf[len] = '\0';
+        }
+
+        // Right-aligned in `width` columns
+        void num(uint64_t v, int width) {
+            char digits[20];
+            int n = 0;
+            do {
+                digits[n++] = '0' + v % 10;
+                v /= 10;
+            } while (v > 0);
+            for (int i = n; i < width; i++) str(" ");
+            char out[21];
+            for (int i = 0; i < n; i++) out[i] = digits[n - 1 - i];
+            out[n] = '\0';
+            str(out);
+        }
+
+        void hex(uint64_t v) {
+            static const char HEX[] = "0123456789abcdef";
+            char out[19] = "0x";
+            for (int i = 0; i < 16; i++) out[2 + i] = HEX[(v >> (60 - 4 * i)) & 0xF];
+            out[18] = '\0';
+            str(out);
+        }
+    };
+
+    // Other threads may be allocating while this runs, so the free
+    // figure is approximate then
+    static inline void write_report(Report& r) {
+        uint64_t cachedBytes = 0;
+        for (int i = 0; i < NUM_CACHES; i++) {
+            Cache* cache = __atomic_load_n(&g_caches[i], __ATOMIC_ACQUIRE);
+            if (cache != nullptr) cachedBytes += cache->freeBytes;
+        }
+        g_lock.lock();
+        uint64_t freeBytes = cachedBytes + g_runFreeBytes + (g_runEnd - g_runNext) + (g_spanEnd - g_spanNext);
+        uint64_t mapped = __atomic_load_n(&g_mappedBytes, __ATOMIC_RELAXED);
+        g_lock.unlock();
+
+        r.str("heap statistics\n");
+        r.str("  mapped     "); r.num(mapped, 12); r.str(" bytes from SYS_ALLOC\n");
+        r.str("  free       "); r.num(freeBytes, 12); r.str(" bytes on free lists and unused arena\n");
+        r.str("  in use     "); r.num(mapped - freeBytes, 12); r.str(" bytes in blocks and heap metadata\n");
+        if (g_stats == nullptr) {
+            r.str("  (recording is off; call heap_stats_enable() for the rest)\n");
+            return;
+        }
 
-            FreeNode* node = g_buckets[idx];
-            g_buckets[idx] = node->next;
+        g_lock.lock();
+        r.str("  requested  "); r.num(g_stats->liveBytes, 12); r.str(" bytes live, ");
+        r.num(g_stats->peakBytes, 0); r.str(" at peak\n");
+        r.str("  allocs     "); r.num(g_stats->allocs, 12);
+        r.str("\n  frees      "); r.num(g_stats->frees, 12); r.str("\n\n");
+
+        r.str("   class      allocs       frees        live        peak\n");
+        for (int i = 0; i < NUM_CLASSES; i++) {
+            const ClassStats& c = g_stats->classes[i];
+            if (i < NUM_BUCKETS) r.num(BUCKET_SIZES[i], 8);
+            else r.str(i == CLASS_MID ? "     mid" : "   large");
+            r.num(c.allocs, 12);
+            r.num(c.frees, 12);
+            r.num(c.liveBlocks, 12);
+            r.num(c.peakBlocks, 12);
+            r.str("\n");
+        }
+
+        r.str("\n  call site                allocs  live blocks   live bytes\n");
+        bool taken[MAX_SITES] = {};
+        for (int k = 0; k < REPORT_SITES; k++) {
+            int best = -1;
+            for (int i = 0; i < MAX_SITES; i++) {
+                const SiteStats& s = g_stats->sites[i];
+                if (taken[i] || s.allocs == 0) continue;
+                if (best < 0 || s.liveBytes > g_stats->sites[best].liveBytes) best = i;
+            }
+            if (best < 0) break;
+            taken[best] = true;
+            const SiteStats& s = g_stats->sites[best];
+            r.str("  ");
+            if (best == 0) r.str("(other sites)     ");
+            else r.hex(s.pc);
+            r.num(s.allocs, 13);
+            r.num(s.liveBlocks, 13);
+            r.num(s.liveBytes, 13);
+            r.str("\n");
+        }
+        g_lock.unlock();
+    }
+
+    static inline void dump(const char* path) {
+        Report r{(char*)montauk::alloc(REPORT_SIZE), 0, REPORT_SIZE};
+        if (r.buf == nullptr) return;
+        write_report(r);
 
-            Header* header = (Header*)node;
-            header->magic  = HEADER_MAGIC;
-            header->size   = size;
-            return (void*)((uint8_t*)header + sizeof(Header));
+        if (path == nullptr || path[0] == '\0') {
+            montauk::print(r.buf);
+        } else {
+            montauk::fdelete(path);
+            int h = montauk::fcreate(path);
+            if (h >= 0) {
+                montauk::fwrite(h, (const uint8_t*)r.buf, 0, r.len);
+                montauk::close(h);
+            }
         }
+        montauk::free(r.buf);
+    }
+
+    static void dump_at_exit() {
+        dump(g_stats->exitPath);
+    }
+
+    // ---- Allocation ----
+
+    static inline void* allocate(uint64_t size) {
+        // Guard against overflow: size + Header must not wrap
+        if (size > UINT64_MAX - sizeof(Header) - PAGE_SIZE)
+            return nullptr;
 
-        // Large allocation — search overflow list
-        void* block = take_from_overflow(needed);
-        if (block == nullptr) {
-            if (!grow(needed)) return nullptr;
-            block = take_from_overflow(needed);
-            if (block == nullptr) return nullptr;
+        uint64_t needed = block_size(size);
+        int idx = bucket_index(needed);
+
+        void* block;
+        if (idx >= 0) {
+            block = alloc_small(idx);
+        } else if (needed <= MID_MAX) {
+            g_lock.lock();
+            block = take_run((int)(capacity(size) / PAGE_SIZE));
+            g_lock.unlock();
+        } else {
+            block = map(capacity(size));
         }
+        if (block == nullptr) return nullptr;
 
         Header* header = (Header*)block;
         header->magic  = HEADER_MAGIC;
@@ -188,59 +584,103 @@ namespace heap_detail {
         return (void*)((uint8_t*)header + sizeof(Header));
     }
 
-    inline void mfree(void* ptr) {
-        using namespace heap_detail;
-
+    static inline void release(void* ptr) {
         if (ptr == nullptr) return;
 
         Header* header = get_header(ptr);
 
         if (header->magic == FREED_MAGIC) return;    // double-free
-        if (header->magic != HEADER_MAGIC) return;   // corrupt
+        if (!is_allocated(header->magic)) return;    // corrupt
+        if (g_stats != nullptr) note_free(header);
         header->magic = FREED_MAGIC;
 
-        uint64_t blockSize = header->size + sizeof(Header);
-        blockSize = (blockSize + 15) & ~15ULL;
-
-        int idx = bucket_index(blockSize);
+        uint64_t needed = block_size(header->size);
+        int idx = bucket_index(needed);
 
         if (idx >= 0) {
-            // Small block — push onto bucket (O(1))
-            auto* node  = (FreeNode*)header;
-            node->size  = BUCKET_SIZES[idx];
-            node->next  = g_buckets[idx];
-            g_buckets[idx] = node;
+            free_small((void*)header, idx);
+        } else if (needed <= MID_MAX) {
+            g_lock.lock();
+            push_run((uint64_t)header, (int)(capacity(header->size) / PAGE_SIZE));
+            g_lock.unlock();
         } else {
-            // Large block — sorted insert with coalescing
-            insert_overflow((void*)header, blockSize);
+            unmap(header, capacity(header->size));
         }
     }
 
-    inline void* realloc(void* ptr, uint64_t size) {
-        if (ptr == nullptr) return malloc(size);
+    // `pc` is the caller's call site, used only while recording
+    static inline void* reallocate(void* ptr, uint64_t size, uint64_t pc) {
+        if (ptr == nullptr) {
+            void* block = allocate(size);
+            if (g_stats != nullptr && block != nullptr) note_alloc(block, pc);
+            return block;
+        }
 
-        auto* header = heap_detail::get_header(ptr);
+        auto* header = get_header(ptr);
         uint64_t old = header->size;
 
-        // Compute actual block size (accounting for bucket rounding)
-        uint64_t oldBlock = (old + sizeof(heap_detail::Header) + 15) & ~15ULL;
-        int idx = heap_detail::bucket_index(oldBlock);
-        if (idx >= 0) oldBlock = heap_detail::BUCKET_SIZES[idx];
-
-        uint64_t newNeed = (size + sizeof(heap_detail::Header) + 15) & ~15ULL;
-        if (newNeed <= oldBlock) {
+        // The block is found again on free from its size, so it can only
+        // stay in place if the new size needs the same block
+        if (capacity(size) == capacity(old)) {
+            if (g_stats != nullptr) note_resize(header, size);
             header->size = size;
             return ptr;
         }
 
-        void* newBlock = malloc(size);
+        void* newBlock = allocate(size);
         if (newBlock == nullptr) return nullptr;
+        if (g_stats != nullptr) note_alloc(newBlock, pc);
 
         uint64_t copySize = (old < size) ? old : size;
         memcpy(newBlock, ptr, copySize);
 
-        mfree(ptr);
+        release(ptr);
         return newBlock;
     }
 
+} // namespace heap_detail
+
+    // ---- Public API ----
+
+    // malloc and realloc are always inlined so that, while heap statistics
+    // are recorded, each call site is told apart by its own address.
+    // Any thread may free a block any other thread allocated.
+
+    [[gnu::always_inline]] inline void* malloc(uint64_t size) {
+        void* ptr = heap_detail::allocate(size);
+        if (heap_detail::g_stats != nullptr && ptr != nullptr) {
+            heap_detail::note_alloc(ptr, heap_detail::here());
+        }
+        return ptr;
+    }
+
+    inline void mfree(void* ptr) {
+        heap_detail::release(ptr);
+    }
+
+    [[gnu::always_inline]] inline void* realloc(void* ptr, uint64_t size) {
+        return heap_detail::reallocate(ptr, size, heap_detail::g_stats != nullptr ? heap_detail::here() : 0);
+    }
+
+    // Start recording allocations and frees by size class and call site.
+    // Blocks allocated before this are left out of the counts. When the
+    // program calls exit(), a report is written to `path`, or printed if
+    // it is nullptr.
+    inline void heap_stats_enable(const char* path = nullptr) {
+        using namespace heap_detail;
+        if (g_stats != nullptr) return;
+
+        auto* stats = (Stats*)montauk::alloc(sizeof(Stats));
+        if (stats == nullptr) return;
+        if (path != nullptr) montauk::strncpy(stats->exitPath, path, sizeof(stats->exitPath) - 1);
+        g_exitHook = dump_at_exit;
+        __atomic_store_n(&g_stats, stats, __ATOMIC_RELEASE);
+    }
+
+    // Write a report now, to `path` or the terminal. Without recording
+    // it only covers what the heap has mapped and what is free.
+    inline void heap_stats_dump(const char* path = nullptr) {
+        heap_detail::dump(path);
+    }
+
 } // namespace montauk
@@ -0,0 +1,28 @@
+/*
+    * service.h
+    * Readiness notification for services started by init
+    * Copyright (c) 2026 Daniel Hammer
+*/
+
+#pragma once
+#include <montauk/syscall.h>
+
+namespace montauk {
+
+    // init takes notes from the services it started on this channel
+    static constexpr const char* INIT_CHANNEL = "init";
+    static constexpr uint32_t INIT_MSG_READY = 1;
+
+    // Tell init the caller is up, for a service whose manifest entry says
+    // ready = "notify". The services that wait on it start then. Harmless
+    // when the caller was not started by init.
+    inline void notify_ready() {
+        int ch = chan_connect(INIT_CHANNEL);
+        if (ch < 0) return;
+        Montauk::ChanMsg msg = {};
+        msg.type = INIT_MSG_READY;
+        chan_send(ch, &msg, Montauk::CHAN_NOWAIT);
+        chan_close(ch);
+    }
+
+}
@@ -9,12 +9,6 @@
 
 namespace montauk {
 
-    inline int slen(const char* s) {
-        int n = 0;
-        while (s[n]) n++;
-        return n;
-    }
-
     inline bool streq(const char* a, const char* b) {
         while (*a && *b) {
             if (*a != *b) return false;
@@ -36,30 +30,238 @@ namespace montauk {
         return s;
     }
 
+    // SIMD kernels for the routines below. Programs are built without SSE,
+    // so each one enables its instruction set locally; SSE2 is baseline on
+    // x86-64 and AVX2 is picked at run time when the CPU and kernel (XCR0)
+    // support it. Vector loads may read past the end of a string, but never
+    // across an aligned 16/32-byte block, so never into an unmapped page.
+    namespace simd {
+        typedef char v16 __attribute__((vector_size(16), may_alias));
+        typedef char v32 __attribute__((vector_size(32), may_alias));
+        typedef char v16u __attribute__((vector_size(16), may_alias, aligned(1)));
+        typedef char v32u __attribute__((vector_size(32), may_alias, aligned(1)));
+        typedef uint32_t v4u32u __attribute__((vector_size(16), may_alias, aligned(1)));
+        typedef uint32_t v8u32u __attribute__((vector_size(32), may_alias, aligned(1)));
+
+        inline int level = 0;  // 0 = not probed yet, 1 = SSE2, 2 = AVX2
+
+        inline int probe() {
+            uint32_t a, b, c, d;
+            asm volatile("cpuid" : "=a"(a), "=b"(b), "=c"(c), "=d"(d) : "a"(0), "c"(0));
+            if (a < 7) return 1;
+
+            // AVX needs OSXSAVE and the YMM state enabled in XCR0
+            asm volatile("cpuid" : "=a"(a), "=b"(b), "=c"(c), "=d"(d) : "a"(1), "c"(0));
+            if (!(c & (1u << 27)) || !(c & (1u << 28))) return 1;
+            uint32_t xlo, xhi;
+            asm volatile("xgetbv" : "=a"(xlo), "=d"(xhi) : "c"(0));
+            if ((xlo & 6) != 6) return 1;
+
+            asm volatile("cpuid" : "=a"(a), "=b"(b), "=c"(c), "=d"(d) : "a"(7), "c"(0));
+            return (b & (1u << 5)) ? 2 : 1;
+        }
+
+        inline bool avx2() {
+            if (level == 0) level = probe();
+            return level == 2;
+        }
+
+        // The copy and fill kernels only run for n at or above their vector
+        // width, which GCC cannot always prove once they are inlined into a
+        // caller with a small buffer and a run-time length. Passing the
+        // destination through an empty asm drops what GCC knows about the
+        // object behind it, so it does not warn about stores that the
+        // caller's length check already rules out. It costs no instructions.
+        template <typename T>
+        inline T* unbounded(T* p) {
+            asm("" : "+r"(p));
+            return p;
+        }
+
+        // n >= 16
+        __attribute__((target("sse2"))) inline void copy_sse2(uint8_t* d, const uint8_t* s, uint64_t n) {
+            d = unbounded(d);
+            uint64_t i = 0;
+            for (; i + 64 <= n; i += 64) {
+                v16u a = *(const v16u*)(s + i), b = *(const v16u*)(s + i + 16);
+                v16u c = *(const v16u*)(s + i + 32), e = *(const v16u*)(s + i + 48);
+                *(v16u*)(d + i) = a; *(v16u*)(d + i + 16) = b;
+                *(v16u*)(d + i + 32) = c; *(v16u*)(d + i + 48) = e;
+            }
+            for (; i + 16 <= n; i += 16) *(v16u*)(d + i) = *(const v16u*)(s + i);
+            if (i < n) *(v16u*)(d + n - 16) = *(const v16u*)(s + n - 16);
+        }
+
+        // n >= 32
+        __attribute__((target("avx2"))) inline void copy_avx2(uint8_t* d, const uint8_t* s, uint64_t n) {
+            d = unbounded(d);
+            uint64_t i = 0;
+            for (; i + 128 <= n; i += 128) {
+                v32u a = *(const v32u*)(s + i), b = *(const v32u*)(s + i + 32);
+                v32u c = *(const v32u*)(s + i + 64), e = *(const v32u*)(s + i + 96);
+                *(v32u*)(d + i) = a; *(v32u*)(d + i + 32) = b;
+                *(v32u*)(d + i + 64) = c; *(v32u*)(d + i + 96) = e;
+            }
+            for (; i + 32 <= n; i += 32) *(v32u*)(d + i) = *(const v32u*)(s + i);
+            if (i < n) *(v32u*)(d + n - 32) = *(const v32u*)(s + n - 32);
+        }
+
+        // n >= 16
+        __attribute__((target("sse2"))) inline void fill_sse2(uint8_t* d, uint8_t v, uint64_t n) {
+            d = unbounded(d);
+            v16u pattern = (v16u){} + (char)v;
+            uint64_t i = 0;
+            for (; i + 16 <= n; i += 16) *(v16u*)(d + i) = pattern;
+            if (i < n) *(v16u*)(d + n - 16) = pattern;
+        }
+
+        // n >= 32
+        __attribute__((target("avx2"))) inline void fill_avx2(uint8_t* d, uint8_t v, uint64_t n) {
+            d = unbounded(d);
+            v32u pattern = (v32u){} + (char)v;
+            uint64_t i = 0;
+            for (; i + 32 <= n; i += 32) *(v32u*)(d + i) = pattern;
+            if (i < n) *(v32u*)(d + n - 32) = pattern;
+        }
+
+        // count >= 4
+        __attribute__((target("sse2"))) inline void fill32_sse2(uint32_t* d, uint32_t v, uint64_t count) {
+            d = unbounded(d);
+            v4u32u pattern = (v4u32u){} + v;
+            uint64_t i = 0;
+            for (; i + 4 <= count; i += 4) *(v4u32u*)(d + i) = pattern;
+            if (i < count) *(v4u32u*)(d + count - 4) = pattern;
+        }
+
+        // count >= 8
+        __attribute__((target("avx2"))) inline void fill32_avx2(uint32_t* d, uint32_t v, uint64_t count) {
+            d = unbounded(d);
+            v8u32u pattern = (v8u32u){} + v;
+            uint64_t i = 0;
+            for (; i + 8 <= count; i += 8) *(v8u32u*)(d + i) = pattern;
+            if (i < count) *(v8u32u*)(d + count - 8) = pattern;
+        }
+
+        __attribute__((target("sse2"))) inline uint64_t strlen_sse2(const char* s) {
+            uint64_t misalign = (uint64_t)s & 15;
+            const char* p = s - misalign;
+            uint32_t mask = (uint32_t)__builtin_ia32_pmovmskb128((v16)(*(const v16*)p == (v16){})) >> misalign;
+            if (mask) return __builtin_ctz(mask);
+            for (p += 16;; p += 16) {
+                mask = __builtin_ia32_pmovmskb128((v16)(*(const v16*)p == (v16){}));
+                if (mask) return (uint64_t)(p - s) + __builtin_ctz(mask);
+            }
+        }
+
+        __attribute__((target("avx2"))) inline uint64_t strlen_avx2(const char* s) {
+            uint64_t misalign = (uint64_t)s & 31;
+            const char* p = s - misalign;
+            uint32_t mask = (uint32_t)__builtin_ia32_pmovmskb256((v32)(*(const v32*)p == (v32){})) >> misalign;
+            if (mask) return __builtin_ctz(mask);
+            for (p += 32;; p += 32) {
+                mask = __builtin_ia32_pmovmskb256((v32)(*(const v32*)p == (v32){}));
+                if (mask) return (uint64_t)(p - s) + __builtin_ctz(mask);
+            }
+        }
+
+        // First index < n where the blocks differ, or n
+        __attribute__((target("sse2"))) inline uint64_t mismatch_sse2(const uint8_t* a, const uint8_t* b, uint64_t n) {
+            uint64_t i = 0;
+            for (; i + 16 <= n; i += 16) {
+                uint32_t eq = __builtin_ia32_pmovmskb128((v16)(*(const v16u*)(a + i) == *(const v16u*)(b + i)));
+                if (eq != 0xFFFF) return i + __builtin_ctz(~eq);
+            }
+            for (; i < n; i++) if (a[i] != b[i]) return i;
+            return n;
+        }
+
+        __attribute__((target("avx2"))) inline uint64_t mismatch_avx2(const uint8_t* a, const uint8_t* b, uint64_t n) {
+            uint64_t i = 0;
+            for (; i + 32 <= n; i += 32) {
+                uint32_t eq = __builtin_ia32_pmovmskb256((v32)(*(const v32u*)(a + i) == *(const v32u*)(b + i)));
+                if (eq != 0xFFFFFFFFu) return i + __builtin_ctz(~eq);
+            }
+            return i + mismatch_sse2(a + i, b + i, n - i);
+        }
+
+        // First index < n holding `v`, or n
+        __attribute__((target("sse2"))) inline uint64_t find_sse2(const uint8_t* p, uint8_t v, uint64_t n) {
+            v16u needle = (v16u){} + (char)v;
+            uint64_t i = 0;
+            for (; i + 16 <= n; i += 16) {
+                uint32_t m = __builtin_ia32_pmovmskb128((v16)(*(const v16u*)(p + i) == needle));
+                if (m) return i + __builtin_ctz(m);
+            }
+            for (; i < n; i++) if (p[i] == v) return i;
+            return n;
+        }
+
+        __attribute__((target("avx2"))) inline uint64_t find_avx2(const uint8_t* p, uint8_t v, uint64_t n) {
+            v32u needle = (v32u){} + (char)v;
+            uint64_t i = 0;
+            for (; i + 32 <= n; i += 32) {
+                uint32_t m = __builtin_ia32_pmovmskb256((v32)(*(const v32u*)(p + i) == needle));
+                if (m) return i + __builtin_ctz(m);
+            }
+            return i + find_sse2(p + i, v, n - i);
+        }
+
+        // First i in [from, last] with p[i] == f and p[i + gap] == l, each
+        // byte OR'd with `fold` before comparing, or last + 1. With fold
+        // 0x20 (f and l folded the same way) a letter matches in either
+        // case, along with a few non-letters the caller's compare rejects.
+        __attribute__((target("sse2"))) inline uint64_t pair_sse2(const uint8_t* p, uint64_t from, uint64_t last,
+                                                                  uint64_t gap, uint8_t f, uint8_t l, uint8_t fold) {
+            v16u vf = (v16u){} + (char)f, vl = (v16u){} + (char)l, vfold = (v16u){} + (char)fold;
+            uint64_t i = from;
+            for (; i + 15 <= last; i += 16) {
+                v16u a = *(const v16u*)(p + i) | vfold;
+                v16u b = *(const v16u*)(p + i + gap) | vfold;
+                uint32_t m = __builtin_ia32_pmovmskb128((v16)((a == vf) & (b == vl)));
+                if (m) return i + __builtin_ctz(m);
+            }
+            for (; i <= last; i++)
+                if ((uint8_t)(p[i] | fold) == f && (uint8_t)(p[i + gap] | fold) == l) return i;
+            return last + 1;
+        }
+
+        __attribute__((target("avx2"))) inline uint64_t pair_avx2(const uint8_t* p, uint64_t from, uint64_t last,
+                                                                  uint64_t gap, uint8_t f, uint8_t l, uint8_t fold) {
+            v32u vf = (v32u){} + (char)f, vl = (v32u){} + (char)l, vfold = (v32u){} + (char)fold;
+            uint64_t i = from;
+            for (; i + 31 <= last; i += 32) {
+                v32u a = *(const v32u*)(p + i) | vfold;
+                v32u b = *(const v32u*)(p + i + gap) | vfold;
+                uint32_t m = __builtin_ia32_pmovmskb256((v32)((a == vf) & (b == vl)));
+                if (m) return i + __builtin_ctz(m);
+            }
+            return pair_sse2(p, i, last, gap, f, l, fold);
+        }
+    }
+
+    inline int slen(const char* s) {
+        return (int)(simd::avx2() ? simd::strlen_avx2(s) : simd::strlen_sse2(s));
+    }
+
     inline void memcpy(void* dst, const void* src, uint64_t n) {
         auto* d = (uint8_t*)dst;
         auto* s = (const uint8_t*)src;
 
-        // Byte copy until 8-byte aligned
-        while (n && ((uint64_t)d & 7)) { *d++ = *s++; n--; }
-
-        // Bulk 8-byte copy
-        auto* d8 = (uint64_t*)d;
-        auto* s8 = (const uint64_t*)s;
-        uint64_t words = n / 8;
-        for (uint64_t i = 0; i < words; i++) d8[i] = s8[i];
-
-        // Remainder
-        d = (uint8_t*)(d8 + words);
-        s = (const uint8_t*)(s8 + words);
-        for (uint64_t i = 0; i < (n & 7); i++) d[i] = s[i];
+        if (n >= 64 && simd::avx2()) { simd::copy_avx2(d, s, n); return; }
+        if (n >= 16) { simd::copy_sse2(d, s, n); return; }
+        for (uint64_t i = 0; i < n; i++) d[i] = s[i];
     }
 
     inline void memmove(void* dst, const void* src, uint64_t n) {
         auto* d = (uint8_t*)dst;
         auto* s = (const uint8_t*)src;
-        if (d < s || d >= s + n) {
+        if (d + n <= s || d >= s + n) {
             memcpy(dst, src, n);
+        } else if (d < s) {
+            // Overlapping forward copy: each word is read before it is overwritten
+            uint64_t words = n / 8;
+            for (uint64_t i = 0; i < words; i++) ((uint64_t*)d)[i] = ((const uint64_t*)s)[i];
+            for (uint64_t i = words * 8; i < n; i++) d[i] = s[i];
         } else {
             // Backward copy — bulk 8 bytes at a time from end
             d += n; s += n;
@@ -78,21 +280,185 @@ namespace montauk {
         auto* d = (uint8_t*)dst;
         uint8_t v = (uint8_t)val;
 
-        // Byte fill until 8-byte aligned
-        while (n && ((uint64_t)d & 7)) { *d++ = v; n--; }
+        if (n >= 64 && simd::avx2()) { simd::fill_avx2(d, v, n); return; }
+        if (n >= 16) { simd::fill_sse2(d, v, n); return; }
+        for (uint64_t i = 0; i < n; i++) d[i] = v;
+    }
+
+    // Fill `count` 32-bit words (pixels) with `val`
+    inline void memset32(uint32_t* dst, uint32_t val, uint64_t count) {
+        if (count >= 16 && simd::avx2()) { simd::fill32_avx2(dst, val, count); return; }
+        if (count >= 4) { simd::fill32_sse2(dst, val, count); return; }
+        for (uint64_t i = 0; i < count; i++) dst[i] = val;
+    }
+
+    inline int memcmp(const void* a, const void* b, uint64_t n) {
+        auto* pa = (const uint8_t*)a;
+        auto* pb = (const uint8_t*)b;
+        uint64_t i = (n >= 64 && simd::avx2()) ? simd::mismatch_avx2(pa, pb, n) : simd::mismatch_sse2(pa, pb, n);
+        if (i == n) return 0;
+        return pa[i] < pb[i] ? -1 : 1;
+    }
+
+    inline const void* memchr(const void* p, int c, uint64_t n) {
+        auto* bytes = (const uint8_t*)p;
+        uint8_t v = (uint8_t)c;
+        uint64_t i = (n >= 64 && simd::avx2()) ? simd::find_avx2(bytes, v, n) : simd::find_sse2(bytes, v, n);
+        return i == n ? nullptr : bytes + i;
+    }
+
+    inline uint8_t fold_case(uint8_t c) {
+        return (c >= 'A' && c <= 'Z') ? (uint8_t)(c + 32) : c;
+    }
+
+    namespace search {
+        // Needles this long are searched with Boyer-Moore-Horspool
+        static constexpr uint64_t HORSPOOL_MIN = 32;
+
+        inline bool equal(const uint8_t* a, const uint8_t* b, uint64_t n, bool nocase) {
+            if (!nocase) return memcmp(a, b, n) == 0;
+            for (uint64_t i = 0; i < n; i++)
+                if (fold_case(a[i]) != fold_case(b[i])) return false;
+            return true;
+        }
+
+        // Each step compares the byte under the needle's end and moves on
+        // by how far that byte is from the needle's end (its whole length
+        // if it is not in it)
+        inline int64_t horspool(const uint8_t* h, uint64_t n, const uint8_t* nd, uint64_t m, bool nocase) {
+            uint32_t skip[256];
+            for (int i = 0; i < 256; i++) skip[i] = (uint32_t)m;
+            for (uint64_t i = 0; i + 1 < m; i++)
+                skip[nocase ? fold_case(nd[i]) : nd[i]] = (uint32_t)(m - 1 - i);
+
+            uint8_t end = nocase ? fold_case(nd[m - 1]) : nd[m - 1];
+            for (uint64_t i = 0; i + m <= n; ) {
+                uint8_t c = nocase ? fold_case(h[i + m - 1]) : h[i + m - 1];
+                if (c == end && equal(h + i, nd, m - 1, nocase)) return (int64_t)i;
+                i += skip[c];
+            }
+            return -1;
+        }
+
+        // Shorter needles: candidates 16 or 32 positions at a time by their
+        // first and last bytes, each then compared in full
+        inline int64_t find(const uint8_t* h, uint64_t n, const uint8_t* nd, uint64_t m, bool nocase) {
+            if (m == 0) return 0;
+            if (m > n) return -1;
+            if (m >= HORSPOOL_MIN) return horspool(h, n, nd, m, nocase);
+
+            uint8_t fold = nocase ? 0x20 : 0;
+            uint8_t f = nd[0] | fold, l = nd[m - 1] | fold;
+            uint64_t last = n - m;
+            bool wide = last >= 64 && simd::avx2();
+            for (uint64_t i = 0; i <= last; i++) {
+                i = wide ? simd::pair_avx2(h, i, last, m - 1, f, l, fold)
+                         : simd::pair_sse2(h, i, last, m - 1, f, l, fold);
+                if (i > last) break;
+                if (equal(h + i, nd, m, nocase)) return (int64_t)i;
+            }
+            return -1;
+        }
+    }
 
-        // Bulk 8-byte fill
-        uint64_t v8 = v;
-        v8 |= v8 << 8;  v8 |= v8 << 16;  v8 |= v8 << 32;
-        auto* d8 = (uint64_t*)d;
-        uint64_t words = n / 8;
-        for (uint64_t i = 0; i < words; i++) d8[i] = v8;
+    // Where `needle` (m bytes) first occurs in `hay` (n bytes), or nullptr
+    inline const void* memmem(const void* hay, uint64_t n, const void* needle, uint64_t m) {
+        int64_t i = search::find((const uint8_t*)hay, n, (const uint8_t*)needle, m, false);
+        return i < 0 ? nullptr : (const uint8_t*)hay + i;
+    }
 
-        // Remainder
-        d = (uint8_t*)(d8 + words);
-        for (uint64_t i = 0; i < (n & 7); i++) d[i] = v;
+    // memmem() ignoring the case of ASCII letters
+    inline const void* memmem_nocase(const void* hay, uint64_t n, const void* needle, uint64_t m) {
+        int64_t i = search::find((const uint8_t*)hay, n, (const uint8_t*)needle, m, true);
+        return i < 0 ? nullptr : (const uint8_t*)hay + i;
     }
 
+    // Search-as-you-type over a text, from a starting point round to it
+    // again. A query that only grew at the end cannot match before the
+    // shorter one did, so typing resumes from the last match instead of
+    // rescanning, and once the query has no match nothing typed after it
+    // is searched for at all. The text must not change between calls.
+    struct IncrementalSearch {
+        static constexpr int QUERY_MAX = 128;
+
+        const char* text = nullptr;
+        uint64_t size = 0;
+        bool nocase = true;
+        char query[QUERY_MAX] = {};
+        int len = 0;
+        int64_t match = -1;     // of the query, or -1
+        uint64_t origin = 0;    // where the search started
+
+        // A new, empty query over `t` (n bytes), starting at `from`
+        void begin(const char* t, uint64_t n, uint64_t from, bool ignoreCase) {
+            text = t;
+            size = n;
+            nocase = ignoreCase;
+            origin = from < n ? from : 0;
+            len = 0;
+            query[0] = '\0';
+            match = -1;
+        }
+
+        // Keep the query but search `t` (n bytes) from `from`, after the
+        // text changed
+        void rebase(const char* t, uint64_t n, uint64_t from) {
+            text = t;
+            size = n;
+            origin = from < n ? from : 0;
+            match = -1;
+        }
+
+        // First match with its start in [from, until)
+        int64_t scan(uint64_t from, uint64_t until) const {
+            if (until > size) until = size;
+            if (from >= until) return -1;
+            uint64_t end = until + (uint64_t)len - 1;
+            if (end > size) end = size;
+            int64_t i = search::find((const uint8_t*)text + from, end - from,
+                                     (const uint8_t*)query, (uint64_t)len, nocase);
+            return i < 0 ? -1 : (int64_t)from + i;
+        }
+
+        // From `from` on, then from the start up to the origin
+        int64_t scan_from(uint64_t from) const {
+            if (from < origin) return scan(from, origin);
+            int64_t i = scan(from, size);
+            return i >= 0 ? i : scan(0, origin);
+        }
+
+        // The query gained `c`; returns its match
+        int64_t type(char c) {
+            if (len + 1 >= QUERY_MAX) return match;
+            bool grew = len > 0;
+            query[len++] = c;
+            query[len] = '\0';
+            if (grew && match < 0) return -1;
+            match = scan_from(grew ? (uint64_t)match : origin);
+            return match;
+        }
+
+        // The query lost its last character: searched again from the origin
+        int64_t erase() {
+            if (len == 0) return match;
+            query[--len] = '\0';
+            match = len > 0 ? scan_from(origin) : -1;
+            return match;
+        }
+
+        // The match after the current one, round to it again; what is
+        // typed next carries on from there
+        int64_t next() {
+            if (len == 0 || size == 0) return -1;
+            uint64_t from = match >= 0 ? (uint64_t)match + 1 : origin;
+            if (from >= size) from = 0;
+            origin = from;
+            match = scan_from(from);
+            if (match >= 0) origin = (uint64_t)match;
+            return match;
+        }
+    };
+
     inline void strcpy(char* dst, const char* src) {
         while (*src) *dst++ = *src++;
         *dst = '\0';
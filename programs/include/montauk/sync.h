@@ -0,0 +1,88 @@
+/*
+    * sync.h
+    * Futex-based mutex and condition variable for MontaukOS threads
+    * Copyright (c) 2026 Daniel Hammer
+*/
+
+#pragma once
+#include <montauk/syscall.h>
+
+namespace montauk {
+
+    // Sleeping mutex. Uncontended lock/unlock never enter the kernel.
+    // state: 0 = unlocked, 1 = locked, 2 = locked and someone may be waiting
+    struct Mutex {
+        volatile uint32_t state = 0;
+
+        bool try_lock() {
+            uint32_t expected = 0;
+            return __atomic_compare_exchange_n(&state, &expected, 1, false,
+                                               __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+        }
+
+        void lock() {
+            uint32_t c = 0;
+            if (__atomic_compare_exchange_n(&state, &c, 1, false,
+                                            __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+                return;
+
+            // Contended: mark it so the holder's unlock wakes us
+            if (c != 2) c = __atomic_exchange_n(&state, 2, __ATOMIC_ACQUIRE);
+            while (c != 0) {
+                futex_wait(&state, 2);
+                c = __atomic_exchange_n(&state, 2, __ATOMIC_ACQUIRE);
+            }
+        }
+
+        void unlock() {
+            if (__atomic_fetch_sub(&state, 1, __ATOMIC_RELEASE) != 1) {
+                __atomic_store_n(&state, 0, __ATOMIC_RELEASE);
+                futex_wake(&state, 1);
+            }
+        }
+    };
+
+    // Scoped lock for Mutex
+    struct LockGuard {
+        Mutex& m;
+        explicit LockGuard(Mutex& mutex) : m(mutex) { m.lock(); }
+        ~LockGuard() { m.unlock(); }
+        LockGuard(const LockGuard&) = delete;
+        LockGuard& operator=(const LockGuard&) = delete;
+    };
+
+    // Condition variable. Waiters sleep on a sequence number that every
+    // signal bumps, so a signal sent between unlocking the mutex and
+    // going to sleep is never lost. Wakeups can be spurious: always wait
+    // in a loop that re-checks the condition.
+    struct CondVar {
+        volatile uint32_t seq = 0;
+
+        void wait(Mutex& m) {
+            uint32_t s = __atomic_load_n(&seq, __ATOMIC_RELAXED);
+            m.unlock();
+            futex_wait(&seq, s);
+            m.lock();
+        }
+
+        // Returns false if timeoutMs elapsed without a signal
+        bool wait_for(Mutex& m, uint64_t timeoutMs) {
+            uint32_t s = __atomic_load_n(&seq, __ATOMIC_RELAXED);
+            m.unlock();
+            int r = futex_wait(&seq, s, timeoutMs);
+            m.lock();
+            return r != 1;
+        }
+
+        void signal() {
+            __atomic_fetch_add(&seq, 1, __ATOMIC_RELEASE);
+            futex_wake(&seq, 1);
+        }
+
+        void broadcast() {
+            __atomic_fetch_add(&seq, 1, __ATOMIC_RELEASE);
+            futex_wake(&seq, 0x7FFFFFFF);
+        }
+    };
+
+}
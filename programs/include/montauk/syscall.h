@@ -109,7 +109,17 @@ namespace montauk {
     // ---- Typed wrappers ----
 
     // Process
+
+    // Called once by exit() before the process ends (heap_stats_enable()
+    // uses it to write its report)
+    inline void (*g_exitHook)() = nullptr;
+
     [[noreturn]] inline void exit(int code = 0) {
+        if (g_exitHook != nullptr) {
+            void (*hook)() = g_exitHook;
+            g_exitHook = nullptr;
+            hook();
+        }
         syscall1(Montauk::SYS_EXIT, (uint64_t)code);
         __builtin_unreachable();
     }
@@ -117,8 +127,29 @@ namespace montauk {
     inline void yield() { syscall0(Montauk::SYS_YIELD); }
     inline void sleep_ms(uint64_t ms) { syscall1(Montauk::SYS_SLEEP_MS, ms); }
     inline int getpid() { return (int)syscall0(Montauk::SYS_GETPID); }
-    inline int spawn(const char* path, const char* args = nullptr) {
-        return (int)syscall2(Montauk::SYS_SPAWN, (uint64_t)path, (uint64_t)args);
+    inline int spawn(const char* path, const char* args = nullptr,
+                     int priority = Montauk::PRIO_INHERIT) {
+        return (int)syscall3(Montauk::SYS_SPAWN, (uint64_t)path, (uint64_t)args, (uint64_t)priority);
+    }
+    // Spawn with the child's arguments, environment, cwd, streams,
+    // priority and affinity set up in the same call (Montauk::SpawnAttr).
+    // SPAWN_ACT_PIPE actions get the caller's end of their pipe back.
+    inline int spawn_ex(Montauk::SpawnAttr* attr) {
+        return (int)syscall1(Montauk::SYS_SPAWN_EX, (uint64_t)attr);
+    }
+    // Scheduling class (Montauk::PRIO_*) of a process; pid -1 is the caller
+    inline int set_priority(int pid, int priority) {
+        return (int)syscall2(Montauk::SYS_SETPRIORITY, (uint64_t)pid, (uint64_t)priority);
+    }
+    inline int get_priority(int pid = -1) {
+        return (int)syscall1(Montauk::SYS_GETPRIORITY, (uint64_t)pid);
+    }
+    // CPU affinity mask (bit i = CPU index i) of a process; pid -1 is the caller
+    inline int set_affinity(int pid, uint64_t mask) {
+        return (int)syscall2(Montauk::SYS_SETAFFINITY, (uint64_t)pid, mask);
+    }
+    inline uint64_t get_affinity(int pid = -1) {
+        return (uint64_t)syscall1(Montauk::SYS_GETAFFINITY, (uint64_t)pid);
     }
     inline int chdir(const char* path) {
         return (int)syscall1(Montauk::SYS_CHDIR, (uint64_t)path);
@@ -127,6 +158,36 @@ namespace montauk {
         return (int)syscall2(Montauk::SYS_GETCWD, (uint64_t)buf, maxLen);
     }
 
+    // Threads
+    // A thread shares the process's memory, heap and sockets. Returning
+    // from `fn` is the same as calling thread_exit() with its result.
+    // Every thread should be joined, or its slot stays taken until the
+    // process exits.
+    using thread_fn = int (*)(void* arg);
+
+    inline int thread_create(thread_fn fn, void* arg = nullptr) {
+        return (int)syscall2(Montauk::SYS_THREAD_CREATE, (uint64_t)fn, (uint64_t)arg);
+    }
+    inline int thread_join(int tid, int* exitCode = nullptr) {
+        return (int)syscall2(Montauk::SYS_THREAD_JOIN, (uint64_t)tid, (uint64_t)exitCode);
+    }
+    [[noreturn]] inline void thread_exit(int code = 0) {
+        syscall1(Montauk::SYS_THREAD_EXIT, (uint64_t)code);
+        __builtin_unreachable();
+    }
+    inline int gettid() { return (int)syscall0(Montauk::SYS_GETTID); }
+
+    // Futex: sleep while *addr == expected, until futex_wake() on the same
+    // address or timeoutMs (0 = no timeout). Returns 0 when woken or if
+    // the value had already changed, 1 on timeout, -1 on a bad address.
+    // Keyed on the address within this process. See montauk/sync.h.
+    inline int futex_wait(volatile uint32_t* addr, uint32_t expected, uint64_t timeoutMs = 0) {
+        return (int)syscall3(Montauk::SYS_FUTEX_WAIT, (uint64_t)addr, (uint64_t)expected, timeoutMs);
+    }
+    inline int futex_wake(volatile uint32_t* addr, int count = 1) {
+        return (int)syscall2(Montauk::SYS_FUTEX_WAKE, (uint64_t)addr, (uint64_t)count);
+    }
+
     // Console
     inline void print(const char* text) { syscall1(Montauk::SYS_PRINT, (uint64_t)text); }
     inline void putchar(char c) { syscall1(Montauk::SYS_PUTCHAR, (uint64_t)c); }
@@ -141,11 +202,47 @@ namespace montauk {
     inline int readdir(const char* path, const char** names, int max) {
         return (int)syscall3(Montauk::SYS_READDIR, (uint64_t)path, (uint64_t)names, (uint64_t)max);
     }
+    // Up to `max` entries of `path` with type, size and mtime, starting at
+    // `*cursor` (set it to 0 first). Returns the count, 0 once the
+    // directory is exhausted, or -1 if it is not a directory.
+    inline int readdir_stat(const char* path, uint64_t* cursor, Montauk::DirEntryInfo* out, int max) {
+        return (int)syscall4(Montauk::SYS_READDIRSTAT, (uint64_t)path, (uint64_t)cursor, (uint64_t)out, (uint64_t)max);
+    }
+
+    // Asynchronous file I/O. ioring_setup() maps a ring with `entries`
+    // (rounded up to a power of two) slots and returns it, or nullptr.
+    // Fill IoSqe slots at sqTail, publish them by advancing sqTail, then
+    // ioring_enter() to start them; completions appear at cqHead in
+    // submission order. ioring_enter() returns once `minComplete` are
+    // ready (or after timeoutMs, 0 = none) with the number ready.
+    inline Montauk::IoRingHeader* ioring_setup(uint32_t entries) {
+        return (Montauk::IoRingHeader*)syscall1(Montauk::SYS_IORING_SETUP, (uint64_t)entries);
+    }
+    inline int ioring_enter(Montauk::IoRingHeader* ring, uint32_t minComplete, uint64_t timeoutMs = 0) {
+        return (int)syscall3(Montauk::SYS_IORING_ENTER, (uint64_t)ring, (uint64_t)minComplete, timeoutMs);
+    }
+    inline Montauk::IoSqe* ioring_sqe(Montauk::IoRingHeader* ring, uint32_t index) {
+        return (Montauk::IoSqe*)((uint8_t*)ring + ring->sqOffset) + (index & (ring->entries - 1));
+    }
+    inline Montauk::IoCqe* ioring_cqe(Montauk::IoRingHeader* ring, uint32_t index) {
+        return (Montauk::IoCqe*)((uint8_t*)ring + ring->cqOffset) + (index & (ring->entries - 1));
+    }
 
     // File write/create
     inline int fwrite(int handle, const uint8_t* buf, uint64_t off, uint64_t size) {
         return (int)syscall4(Montauk::SYS_FWRITE, (uint64_t)handle, (uint64_t)buf, off, size);
     }
+    // Copy `size` bytes at `srcOff` of one open file to `dstOff` of
+    // another inside the kernel; returns the bytes copied, fewer if the
+    // source ends first, or -1
+    inline int64_t fcopy(int src, int dst, uint64_t srcOff, uint64_t dstOff, uint64_t size) {
+        return syscall5(Montauk::SYS_FCOPY, (uint64_t)src, (uint64_t)dst, srcOff, dstOff, size);
+    }
+    // Write back what was written to the file's drive; 0, or -1 on a
+    // device error. Writes otherwise reach the disk within seconds.
+    inline int fsync(int handle) {
+        return (int)syscall1(Montauk::SYS_FSYNC, (uint64_t)handle);
+    }
     inline int fcreate(const char* path) {
         return (int)syscall1(Montauk::SYS_FCREATE, (uint64_t)path);
     }
@@ -163,13 +260,56 @@ namespace montauk {
     inline void* alloc(uint64_t size) { return (void*)syscall1(Montauk::SYS_ALLOC, size); }
     inline void free(void* ptr) { syscall1(Montauk::SYS_FREE, (uint64_t)ptr); }
 
-    // Timekeeping
-    inline uint64_t get_ticks() { return (uint64_t)syscall0(Montauk::SYS_GETTICKS); }
-    inline uint64_t get_milliseconds() { return (uint64_t)syscall0(Montauk::SYS_GETMILLISECONDS); }
+    // Map a file read-only (length 0 = to the end); nullptr on failure
+    inline void* mmap(const char* path, uint64_t offset = 0, uint64_t length = 0) {
+        return (void*)syscall3(Montauk::SYS_MMAP, (uint64_t)path, offset, length);
+    }
+    // Map the named shared memory object, creating it with `size` bytes.
+    // A null name makes an unnamed one, to hand over with chan_send().
+    inline void* shm_open(const char* name, uint64_t size) {
+        return (void*)syscall2(Montauk::SYS_SHMOPEN, (uint64_t)name, size);
+    }
+    inline int shm_unlink(const char* name) {
+        return (int)syscall1(Montauk::SYS_SHMUNLINK, (uint64_t)name);
+    }
+    // Unmap a mapping returned by mmap() or shm_open()
+    inline void munmap(void* addr) { syscall1(Montauk::SYS_FREE, (uint64_t)addr); }
+
+    // Timekeeping. The clock is read from the kernel's clock page
+    // (Montauk::TimePage) without entering the kernel.
+    inline uint64_t get_microseconds() {
+        auto* tp = (const Montauk::TimePage*)Montauk::USER_TIME_PAGE;
+        for (;;) {
+            uint32_t seq = tp->seq;
+            if (seq & 1) {
+                asm volatile("pause");
+                continue;
+            }
+            uint64_t us;
+            if (tp->flags & Montauk::TIME_PAGE_TSC) {
+                uint32_t lo, hi;
+                asm volatile("rdtsc" : "=a"(lo), "=d"(hi));
+                uint64_t tsc = ((uint64_t)hi << 32) | lo;
+                us = tp->usOffset + (tsc - tp->tscBase) / tp->tscPerUs;
+            } else {
+                us = tp->ms * 1000;
+            }
+            asm volatile("" ::: "memory");
+            if (tp->seq == seq) return us;
+        }
+    }
+    inline uint64_t get_ticks() { return get_microseconds() / 1000; }
+    inline uint64_t get_milliseconds() { return get_microseconds() / 1000; }
 
     // System
     inline void get_info(Montauk::SysInfo* info) { syscall1(Montauk::SYS_GETINFO, (uint64_t)info); }
 
+    // Make up to Montauk::BATCH_MAX syscalls in one kernel entry; each
+    // call's result is stored in it. Returns the number of calls made.
+    inline int batch(Montauk::BatchCall* calls, int count, uint32_t flags = 0) {
+        return (int)syscall3(Montauk::SYS_BATCH, (uint64_t)calls, (uint64_t)count, (uint64_t)flags);
+    }
+
     // Keyboard
     inline bool is_key_available() { return (bool)syscall0(Montauk::SYS_ISKEYAVAILABLE); }
     inline void getkey(Montauk::KeyEvent* out) { syscall1(Montauk::SYS_GETKEY, (uint64_t)out); }
@@ -184,6 +324,11 @@ namespace montauk {
     inline uint32_t resolve(const char* hostname) {
         return (uint32_t)syscall1(Montauk::SYS_RESOLVE, (uint64_t)hostname);
     }
+    // Non-blocking resolve, polled with the same name: the IP once it is
+    // known, 0 while the query is in flight, -1 if the name does not resolve
+    inline int64_t resolve_async(const char* hostname) {
+        return (int64_t)syscall1(Montauk::SYS_RESOLVE_ASYNC, (uint64_t)hostname);
+    }
 
     // Network configuration
     inline void get_netcfg(Montauk::NetCfg* out) { syscall1(Montauk::SYS_GETNETCFG, (uint64_t)out); }
@@ -208,12 +353,50 @@ namespace montauk {
     inline int send(int fd, const void* data, uint32_t len) {
         return (int)syscall3(Montauk::SYS_SEND, (uint64_t)fd, (uint64_t)data, (uint64_t)len);
     }
+    // Send `len` bytes of open file `handle` from `offset` on TCP socket
+    // `fd`, without copying them through user memory. Returns bytes sent
+    // (short at end of file) or -1.
+    inline int sendfile(int handle, int fd, uint64_t offset, uint32_t len) {
+        return (int)syscall4(Montauk::SYS_SENDFILE, (uint64_t)handle, (uint64_t)fd, offset, (uint64_t)len);
+    }
     inline int recv(int fd, void* buf, uint32_t maxLen) {
         return (int)syscall3(Montauk::SYS_RECV, (uint64_t)fd, (uint64_t)buf, (uint64_t)maxLen);
     }
+    // option is a Montauk::SOCKOPT_*; returns 0 or -1
+    inline int setsockopt(int fd, int option, uint64_t value) {
+        return (int)syscall3(Montauk::SYS_SETSOCKOPT, (uint64_t)fd, (uint64_t)option, value);
+    }
     inline int closesocket(int fd) {
         return (int)syscall1(Montauk::SYS_CLOSESOCK, (uint64_t)fd);
     }
+
+    // Readiness multiplexing. A poll set watches sockets, the keyboard,
+    // the mouse, windows, child output and (for the compositor) window
+    // changes; epoll_wait sleeps until one is ready.
+    inline int epoll_create() {
+        return (int)syscall0(Montauk::SYS_EPOLL_CREATE);
+    }
+    // op is a Montauk::EPOLL_CTL_*; a watch is keyed by (source, id)
+    inline int epoll_ctl(int epfd, int op, const Montauk::PollEvent* ev) {
+        return (int)syscall3(Montauk::SYS_EPOLL_CTL, (uint64_t)epfd, (uint64_t)op, (uint64_t)ev);
+    }
+    inline int epoll_ctl(int epfd, int op, uint8_t source, int32_t id, uint32_t events, uint64_t userData = 0) {
+        Montauk::PollEvent ev = {};
+        ev.source = source;
+        ev.id = id;
+        ev.events = events;
+        ev.userData = userData;
+        return epoll_ctl(epfd, op, &ev);
+    }
+    // timeoutMs: 0 = just check, negative = wait forever.
+    // Returns the number of ready events, 0 on timeout, or -1.
+    inline int epoll_wait(int epfd, Montauk::PollEvent* events, int maxEvents, int64_t timeoutMs) {
+        return (int)syscall4(Montauk::SYS_EPOLL_WAIT, (uint64_t)epfd, (uint64_t)events,
+                             (uint64_t)maxEvents, (uint64_t)timeoutMs);
+    }
+    inline int epoll_close(int epfd) {
+        return (int)syscall1(Montauk::SYS_EPOLL_CLOSE, (uint64_t)epfd);
+    }
     inline int sendto(int fd, const void* data, uint32_t len, uint32_t destIp, uint16_t destPort) {
         return (int)syscall5(Montauk::SYS_SENDTO, (uint64_t)fd, (uint64_t)data,
                              (uint64_t)len, (uint64_t)destIp, (uint64_t)destPort);
@@ -222,6 +405,20 @@ namespace montauk {
         return (int)syscall5(Montauk::SYS_RECVFROM, (uint64_t)fd, (uint64_t)buf,
                              (uint64_t)maxLen, (uint64_t)srcIp, (uint64_t)srcPort);
     }
+    // Send up to UDP_MAX_BATCH datagrams in one call, stopping at the
+    // first that fails. Returns the number sent or -1.
+    inline int sendmmsg(int fd, const Montauk::UdpMsg* msgs, int count) {
+        return (int)syscall3(Montauk::SYS_SENDMMSG, (uint64_t)fd, (uint64_t)msgs, (uint64_t)count);
+    }
+    // Take up to UDP_MAX_BATCH queued datagrams without waiting. Returns
+    // the number received (0 if none is queued) or -1.
+    inline int recvmmsg(int fd, Montauk::UdpMsg* msgs, int count) {
+        return (int)syscall3(Montauk::SYS_RECVMMSG, (uint64_t)fd, (uint64_t)msgs, (uint64_t)count);
+    }
+    // option is a Montauk::SOCKOPT_*; returns 0 or -1
+    inline int getsockopt(int fd, int option, uint64_t* value) {
+        return (int)syscall3(Montauk::SYS_GETSOCKOPT, (uint64_t)fd, (uint64_t)option, (uint64_t)value);
+    }
 
     // Process management
     inline void waitpid(int pid) { syscall1(Montauk::SYS_WAITPID, (uint64_t)pid); }
@@ -229,11 +426,39 @@ namespace montauk {
     // Framebuffer
     inline void fb_info(Montauk::FbInfo* info) { syscall1(Montauk::SYS_FBINFO, (uint64_t)info); }
     inline void* fb_map() { return (void*)syscall0(Montauk::SYS_FBMAP); }
+    // Map scanout buffer `index` (0 = fb_map's), or nullptr
+    inline void* fb_map_buffer(int index) { return (void*)syscall1(Montauk::SYS_FBMAPBUFFER, (uint64_t)index); }
+    // Show scanout buffer `index` from the next vertical blank; returns
+    // once it is on screen, or -1 if the display cannot flip
+    inline int fb_flip(int index) { return (int)syscall1(Montauk::SYS_FBFLIP, (uint64_t)index); }
+
+    // Zeroed memory the GPU blitter can fill and copy, freed with free();
+    // nullptr if there is no blitter
+    inline void* gpu_alloc(uint64_t size) { return (void*)syscall1(Montauk::SYS_GPUALLOC, size); }
+    // Run up to GPU_BLIT_MAX fills and copies on the blitter, in order,
+    // returning once they are done; -1 (nothing ran) if one touches memory
+    // the blitter cannot reach, so the caller draws on the CPU instead
+    inline int gpu_blit(const Montauk::GpuBlit* blits, int count) {
+        return (int)syscall2(Montauk::SYS_GPUBLIT, (uint64_t)blits, (uint64_t)count);
+    }
+
+    // Load the pointer image into the hardware cursor plane, which the
+    // kernel then moves with the mouse; nullptr hides it. Returns -1 if
+    // there is no cursor plane and the pointer must be drawn in software.
+    inline int cursor_set(const Montauk::CursorImage* image) {
+        return (int)syscall1(Montauk::SYS_CURSORSET, (uint64_t)image);
+    }
 
     // Arguments
     inline int getargs(char* buf, uint64_t maxLen) {
         return (int)syscall2(Montauk::SYS_GETARGS, (uint64_t)buf, maxLen);
     }
+    // The environment block the process was spawned with ("NAME=value"
+    // strings, each terminated). Returns its size, more than maxLen if
+    // it was cut short.
+    inline int getenv_block(char* buf, uint64_t maxLen) {
+        return (int)syscall2(Montauk::SYS_GETENV, (uint64_t)buf, maxLen);
+    }
 
     // Terminal
     inline void termsize(int* cols, int* rows) {
@@ -259,6 +484,52 @@ namespace montauk {
     inline void settz(int offset_minutes) { syscall1(Montauk::SYS_SETTZ, (uint64_t)(int64_t)offset_minutes); }
     inline int gettz() { return (int)syscall0(Montauk::SYS_GETTZ); }
 
+    // Boot timeline: copy up to `max` events, returns how many
+    inline int boot_profile(Montauk::BootEvent* out, int max) {
+        return (int)syscall2(Montauk::SYS_BOOTPROFILE, (uint64_t)out, (uint64_t)max);
+    }
+    inline void boot_mark(const char* name) { syscall1(Montauk::SYS_BOOTMARK, (uint64_t)name); }
+
+    // Kernel tracing: record the Montauk::TRACE_* categories in `mask`
+    // (0 stops), and map the per-CPU trace rings (free() unmaps them)
+    inline int trace_ctl(uint32_t mask) { return (int)syscall1(Montauk::SYS_TRACECTL, mask); }
+    inline Montauk::TraceHeader* trace_map() {
+        return (Montauk::TraceHeader*)syscall0(Montauk::SYS_TRACEMAP);
+    }
+
+    // Lock contention counters of up to `max` named kernel locks, zeroed
+    // afterwards if `reset`; returns how many were copied
+    inline int lockstat(Montauk::LockStatInfo* out, int max, bool reset = false) {
+        return (int)syscall3(Montauk::SYS_LOCKSTAT, (uint64_t)out, (uint64_t)max, reset ? 1 : 0);
+    }
+
+    // Syscall statistics: apply Montauk::SYSSTAT_* flags (0 stops), and
+    // copy the counters, system wide for pid -1 or for one process
+    inline int syscallstat_ctl(uint32_t flags) {
+        return (int)syscall1(Montauk::SYS_SYSCALLSTATCTL, flags);
+    }
+    inline int syscallstat(int pid, Montauk::SyscallStatInfo* out, int max) {
+        return (int)syscall3(Montauk::SYS_SYSCALLSTAT, (uint64_t)pid, (uint64_t)out, (uint64_t)max);
+    }
+
+    // Sampling profiler: start on process `pid` (-1: all), or stop, which
+    // returns the number of samples dropped; prof_read drains samples
+    inline int64_t prof_ctl(bool enable, int pid = -1) {
+        return syscall2(Montauk::SYS_PROFCTL, enable ? 1 : 0, (uint64_t)pid);
+    }
+    inline int prof_read(Montauk::ProfSample* out, int max) {
+        return (int)syscall2(Montauk::SYS_PROFREAD, (uint64_t)out, (uint64_t)max);
+    }
+
+    // Hardware counters: count PERF_* events for this thread from zero (0
+    // stops); returns the events counted, or -1 without a usable PMU
+    inline int perf_ctl(uint32_t events, uint32_t flags = 0) {
+        return (int)syscall2(Montauk::SYS_PERFCTL, events, flags);
+    }
+    inline int perf_read(Montauk::PerfCounts* out) {
+        return (int)syscall1(Montauk::SYS_PERFREAD, (uint64_t)out);
+    }
+
     // Random number generation
     inline int64_t getrandom(void* buf, uint32_t len) {
         return syscall2(Montauk::SYS_GETRANDOM, (uint64_t)buf, (uint64_t)len);
@@ -281,6 +552,10 @@ namespace montauk {
 
     // Mouse
     inline void mouse_state(Montauk::MouseState* out) { syscall1(Montauk::SYS_MOUSESTATE, (uint64_t)out); }
+    // Take up to `max` queued input events, oldest first; returns the count
+    inline int mouse_events(Montauk::MouseEvent* out, int max) {
+        return (int)syscall2(Montauk::SYS_MOUSEEVENTS, (uint64_t)out, (uint64_t)max);
+    }
     inline void set_mouse_bounds(int32_t maxX, int32_t maxY) {
         syscall2(Montauk::SYS_SETMOUSEBOUNDS, (uint64_t)maxX, (uint64_t)maxY);
     }
@@ -290,9 +565,16 @@ namespace montauk {
         return syscall2(Montauk::SYS_KLOG, (uint64_t)buf, size);
     }
 
-    // I/O redirection
-    inline int spawn_redir(const char* path, const char* args = nullptr) {
-        return (int)syscall2(Montauk::SYS_SPAWN_REDIR, (uint64_t)path, (uint64_t)args);
+    // Only the records after `cursor` (zero it to start), as many whole
+    // lines as fit; the cursor moves past those returned.
+    inline int64_t read_klog(char* buf, uint64_t size, Montauk::KlogCursor* cursor) {
+        return syscall3(Montauk::SYS_KLOG, (uint64_t)buf, size, (uint64_t)cursor);
+    }
+
+    // I/O redirection. `outBufSize` sizes the child's output ring
+    // (rounded up to pages, at most 1 MiB); 0 means the 64 KiB default.
+    inline int spawn_redir(const char* path, const char* args = nullptr, uint32_t outBufSize = 0) {
+        return (int)syscall3(Montauk::SYS_SPAWN_REDIR, (uint64_t)path, (uint64_t)args, (uint64_t)outBufSize);
     }
     inline int childio_read(int childPid, char* buf, int maxLen) {
         return (int)syscall3(Montauk::SYS_CHILDIO_READ, (uint64_t)childPid, (uint64_t)buf, (uint64_t)maxLen);
@@ -307,6 +589,53 @@ namespace montauk {
         return (int)syscall3(Montauk::SYS_CHILDIO_SETTERMSZ, (uint64_t)childPid, (uint64_t)cols, (uint64_t)rows);
     }
 
+    // Anonymous pipes. `capacity` is rounded up to a power of two (at most
+    // 1 MiB); 0 means the 64 KiB default. Reads block until data arrives
+    // and return 0 once every write end is closed. Montauk::PIPE_STDIN and
+    // PIPE_STDOUT name the pipes the caller was spawned with.
+    inline int pipe(int32_t handles[2], uint32_t capacity = 0) {
+        return (int)syscall2(Montauk::SYS_PIPE, (uint64_t)handles, (uint64_t)capacity);
+    }
+    inline int pipe_read(int handle, void* buf, int len) {
+        return (int)syscall3(Montauk::SYS_PIPE_READ, (uint64_t)handle, (uint64_t)buf, (uint64_t)len);
+    }
+    inline int pipe_write(int handle, const void* buf, int len) {
+        return (int)syscall3(Montauk::SYS_PIPE_WRITE, (uint64_t)handle, (uint64_t)buf, (uint64_t)len);
+    }
+    inline int pipe_close(int handle) {
+        return (int)syscall1(Montauk::SYS_PIPE_CLOSE, (uint64_t)handle);
+    }
+    // Spawn with stdin and stdout attached to pipe ends the caller holds;
+    // Montauk::PIPE_INHERIT passes on the caller's own, PIPE_NONE none
+    inline int spawn_piped(const char* path, const char* args, int stdinPipe, int stdoutPipe) {
+        return (int)syscall4(Montauk::SYS_SPAWN_PIPED, (uint64_t)path, (uint64_t)args,
+                             (uint64_t)stdinPipe, (uint64_t)stdoutPipe);
+    }
+
+    // Message channels (see Montauk::ChanMsg). A message whose shmAddr is
+    // the start of a shm_open() or mmap() mapping hands the memory over;
+    // the receiver finds it mapped at shmAddr and munmap()s it when done.
+    // Send, receive and accept return 0 instead of blocking with
+    // Montauk::CHAN_NOWAIT; receive returns -1 once the peer is gone.
+    inline int chan_listen(const char* name) {
+        return (int)syscall1(Montauk::SYS_CHAN_LISTEN, (uint64_t)name);
+    }
+    inline int chan_connect(const char* name) {
+        return (int)syscall1(Montauk::SYS_CHAN_CONNECT, (uint64_t)name);
+    }
+    inline int chan_accept(int listener, uint32_t flags = 0) {
+        return (int)syscall2(Montauk::SYS_CHAN_ACCEPT, (uint64_t)listener, (uint64_t)flags);
+    }
+    inline int chan_send(int handle, const Montauk::ChanMsg* msg, uint32_t flags = 0) {
+        return (int)syscall3(Montauk::SYS_CHAN_SEND, (uint64_t)handle, (uint64_t)msg, (uint64_t)flags);
+    }
+    inline int chan_recv(int handle, Montauk::ChanMsg* msg, uint32_t flags = 0) {
+        return (int)syscall3(Montauk::SYS_CHAN_RECV, (uint64_t)handle, (uint64_t)msg, (uint64_t)flags);
+    }
+    inline int chan_close(int handle) {
+        return (int)syscall1(Montauk::SYS_CHAN_CLOSE, (uint64_t)handle);
+    }
+
     // Process listing / kill
     inline int proclist(Montauk::ProcInfo* buf, int max) {
         return (int)syscall2(Montauk::SYS_PROCLIST, (uint64_t)buf, (uint64_t)max);
@@ -336,6 +665,12 @@ namespace montauk {
                         (uint64_t)sectorCount, (uint64_t)buf);
     }
 
+    // Benchmark a block device below the buffer cache (writes only outside
+    // every partition of a GPT disk). Returns 0 with `result` filled in.
+    inline int disk_bench(const Montauk::DiskBenchParams* params, Montauk::DiskBenchResult* result) {
+        return (int)syscall2(Montauk::SYS_DISKBENCH, (uint64_t)params, (uint64_t)result);
+    }
+
     // GPT management
     inline int gpt_init(int blockDev) {
         return (int)syscall1(Montauk::SYS_GPTINIT, (uint64_t)blockDev);
@@ -387,6 +722,22 @@ namespace montauk {
     inline int audio_bt_status(int handle) {
         return audio_ctl(handle, Montauk::AUDIO_CTL_BT_STATUS, 0);
     }
+    inline int audio_set_periods(int handle, uint32_t periodBytes, uint32_t periodCount) {
+        // Through the smallest ring, so neither step exceeds AUDIO_RING_MAX_BYTES
+        if (audio_ctl(handle, Montauk::AUDIO_CTL_SET_PERIODS, (int)Montauk::AUDIO_PERIODS_MIN) < 0) return -1;
+        if (audio_ctl(handle, Montauk::AUDIO_CTL_SET_PERIOD_BYTES, (int)periodBytes) < 0) return -1;
+        return audio_ctl(handle, Montauk::AUDIO_CTL_SET_PERIODS, (int)periodCount);
+    }
+    inline Montauk::AudioRingHeader* audio_map_ring(int handle) {
+        return (Montauk::AudioRingHeader*)syscall3(Montauk::SYS_AUDIOCTL, (uint64_t)handle,
+                                                   (uint64_t)Montauk::AUDIO_CTL_MAP_RING, 0);
+    }
+    inline uint8_t* audio_ring_data(Montauk::AudioRingHeader* ring) {
+        return (uint8_t*)ring + ring->ringOffset;
+    }
+    inline int audio_wait_period(int handle, uint32_t lastSeen) {
+        return audio_ctl(handle, Montauk::AUDIO_CTL_WAIT_PERIOD, (int)lastSeen);
+    }
 
     // Bluetooth
     inline int bt_scan(Montauk::BtScanResult* buf, int maxCount, uint32_t timeoutMs) {
@@ -417,21 +768,74 @@ namespace montauk {
     }
 
     // Window server
+
+    // Event queues of this process's windows, mapped by the first
+    // win_poll of each and kept by window slot
+    static constexpr int WIN_RING_SLOTS = Montauk::WinMaxWindows;
+    struct WinRingCache {
+        int id;
+        Montauk::WinEventRing* ring;
+    };
+    inline WinRingCache g_win_rings[WIN_RING_SLOTS] = {};
+
     inline int win_create(const char* title, int w, int h, Montauk::WinCreateResult* result) {
         return (int)syscall4(Montauk::SYS_WINCREATE, (uint64_t)title, (uint64_t)w, (uint64_t)h, (uint64_t)result);
     }
     inline int win_destroy(int id) {
+        WinRingCache& cached = g_win_rings[(id < 0 ? 0 : id) % WIN_RING_SLOTS];
+        if (cached.ring != nullptr && cached.id == id) {
+            munmap(cached.ring);
+            cached.ring = nullptr;
+        }
         return (int)syscall1(Montauk::SYS_WINDESTROY, (uint64_t)id);
     }
     inline uint64_t win_present(int id) {
         return (uint64_t)syscall1(Montauk::SYS_WINPRESENT, (uint64_t)id);
     }
+    inline Montauk::WinEventRing* win_event_ring(int id) {
+        return (Montauk::WinEventRing*)syscall1(Montauk::SYS_WINEVENTRING, (uint64_t)id);
+    }
+    // Take the next event of a window: 1, 0 if there is none, or -1 if
+    // the caller has no such window. Only the first call per window
+    // enters the kernel.
     inline int win_poll(int id, Montauk::WinEvent* event) {
-        return (int)syscall2(Montauk::SYS_WINPOLL, (uint64_t)id, (uint64_t)event);
+        if (id < 0) return -1;
+        WinRingCache& cached = g_win_rings[id % WIN_RING_SLOTS];
+        Montauk::WinEventRing* ring = cached.id == id ? cached.ring : nullptr;
+        if (ring == nullptr) {
+            ring = win_event_ring(id);
+            if (ring == nullptr) return (int)syscall2(Montauk::SYS_WINPOLL, (uint64_t)id, (uint64_t)event);
+            if (cached.ring != nullptr) munmap(cached.ring);
+            cached = {id, ring};
+        }
+
+        for (;;) {
+            uint32_t tail = ring->tail;
+            if (tail == __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE)) return 0;
+            Montauk::WinEventSlot& slot = ring->slots[tail % Montauk::WIN_EVENT_RING_SIZE];
+            uint32_t expected = Montauk::WIN_SLOT_READY;
+            if (__atomic_compare_exchange_n(&slot.state, &expected, Montauk::WIN_SLOT_TAKEN,
+                                            false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+                *event = slot.event;
+                __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+                return 1;
+            }
+            // The kernel is merging a move into it, or another thread took it
+            asm volatile("pause");
+        }
+    }
+    // Present a frame of which only `rects` (at most 16) changed
+    inline uint64_t win_present_rects(int id, const Montauk::WinRect* rects, int count) {
+        return (uint64_t)syscall3(Montauk::SYS_WINPRESENTRECTS, (uint64_t)id, (uint64_t)rects, (uint64_t)count);
     }
     inline int win_enumerate(Montauk::WinInfo* info, int max) {
         return (int)syscall2(Montauk::SYS_WINENUM, (uint64_t)info, (uint64_t)max);
     }
+    // Compositor: the windows that changed since the last call (closed
+    // set for those that are gone), and their pending frames
+    inline int win_changes(Montauk::WinInfo* info, int max) {
+        return (int)syscall2(Montauk::SYS_WINCHANGES, (uint64_t)info, (uint64_t)max);
+    }
     inline uint64_t win_map(int id) {
         return (uint64_t)syscall1(Montauk::SYS_WINMAP, (uint64_t)id);
     }
@@ -0,0 +1,33 @@
+/*
+ * anchors.h
+ * Pre-parsed trust anchor blob shared by mkanchors and libtls
+ * Copyright (c) 2026 Daniel Hammer
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+// mkanchors decodes the CA bundle at build time into this blob, which is
+// installed next to it. load_trust_anchors() maps it read-only and points
+// the BearSSL anchors straight into the mapping, so a TLS client starts
+// without decoding a single certificate. Offsets are from the start of
+// the blob and everything is little-endian.
+
+#define TA_BLOB_PATH   "0:/etc/ca-anchors.bin"
+#define TA_BLOB_MAGIC  "MTKTA\x00\x00\x01"
+
+typedef struct {
+    char     magic[8];        // TA_BLOB_MAGIC
+    uint32_t count;           // TaBlobEntry records after the header
+    uint32_t size;            // whole blob, bytes
+} TaBlobHeader;
+
+typedef struct {
+    uint32_t dnOff, dnLen;    // subject DN, DER
+    uint32_t flags;           // BR_X509_TA_*
+    uint32_t keyType;         // BR_KEYTYPE_RSA or BR_KEYTYPE_EC
+    uint32_t curve;           // BR_EC_* for EC keys, else 0
+    uint32_t aOff, aLen;      // RSA modulus or EC point
+    uint32_t bOff, bLen;      // RSA exponent; 0 for EC keys
+} TaBlobEntry;
@@ -42,4 +42,63 @@ int https_fetch(const char* host, uint32_t ip, uint16_t port,
                 char* respBuf, int respMax,
                 AbortCheckFn abort_check = nullptr);
 
+// ---- Persistent HTTPS client ----
+
+// Receives a response as it arrives: the status line and headers first,
+// then the body with any chunked framing removed. Return false to stop
+// reading; the connection is then dropped.
+using ResponseFn = bool (*)(void* ctx, const char* data, int len);
+
+static constexpr int HTTPS_MAX_HOSTS = 4;
+
+// One host's connection. The BearSSL contexts live as long as the slot,
+// so a reconnect resumes the last session with an abbreviated handshake.
+struct HttpsConn {
+    char     host[128];                // "" = free slot
+    uint32_t ip;
+    uint16_t port;
+    int      fd;                       // -1 = not connected
+    uint64_t lastUsed;                 // ms
+    br_ssl_client_context*   cc;
+    br_x509_minimal_context* xc;
+    void*    iobuf;
+    bool     haveSession;
+    br_ssl_session_parameters session;
+};
+
+// Keeps a connection per host open between requests (HTTP/1.1
+// keep-alive) and caches TLS session parameters for resumption. Requests
+// should be HTTP/1.1 without "Connection: close" for the connection to
+// be reused; anything else still works, one connection per request.
+struct HttpsClient {
+    const TrustAnchors* tas;
+    HttpsConn conns[HTTPS_MAX_HOSTS];
+
+    void init(const TrustAnchors& anchors);
+
+    // Send a request and stream the response to on_data. Returns the
+    // bytes delivered, or -1 if the response did not arrive in full.
+    int request(const char* host, uint32_t ip, uint16_t port,
+                const char* req, int reqLen,
+                ResponseFn on_data, void* ctx,
+                AbortCheckFn abort_check = nullptr);
+
+    // Like https_fetch: the response (headers, then the de-chunked body)
+    // in respBuf, NUL-terminated. Returns its length or -1.
+    int fetch(const char* host, uint32_t ip, uint16_t port,
+              const char* req, int reqLen,
+              char* respBuf, int respMax,
+              AbortCheckFn abort_check = nullptr);
+
+    // Close every connection (and free the contexts)
+    void close_all();
+};
+
+// Plain HTTP on a fresh connection, streamed to on_data with the same
+// framing as HttpsClient::request. Returns the bytes delivered, or -1.
+int http_request(uint32_t ip, uint16_t port,
+                 const char* req, int reqLen,
+                 ResponseFn on_data, void* ctx,
+                 AbortCheckFn abort_check = nullptr);
+
 } // namespace tls
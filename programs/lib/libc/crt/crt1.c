@@ -5,7 +5,8 @@
     *
     * This startup shim is intentionally small: it fetches the raw
     * command-line buffer from the kernel, tokenizes it into argc/argv,
-    * calls main(), then exits with main()'s return code.
+    * calls main(), then exits with main()'s return code through exit(),
+    * so atexit handlers run and buffered stdio is flushed.
 */
 
 static inline long _sys1(long nr, long a1) {
@@ -35,6 +36,7 @@ static inline long _sys2(long nr, long a1, long a2) {
 #define SYS_GETARGS 25
 
 extern int main(int argc, char** argv);
+extern void exit(int status) __attribute__((noreturn));
 
 void _start(void) {
     char argbuf[256];
@@ -76,6 +78,5 @@ void _start(void) {
 
     argv[argc] = 0;
 
-    _sys1(SYS_EXIT, (long)main(argc, argv));
-    __builtin_unreachable();
+    exit(main(argc, argv));
 }
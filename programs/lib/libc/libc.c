@@ -22,6 +22,7 @@
 #include <sys/stat.h>
 #include <sys/time.h>
 #include <unistd.h>
+#include <montauk.h>
 
 /* ========================================================================
    Raw syscall wrappers (C versions matching kernel ABI)
@@ -98,7 +99,6 @@ static inline long _zos_syscall4(long nr, long a1, long a2, long a3, long a4) {
 #define SYS_FREE    12
 #define SYS_GETMILLISECONDS 14
 #define SYS_GETCHAR 18
-#define SYS_SPAWN   20
 #define SYS_WAITPID 23
 #define SYS_GETARGS 25
 #define SYS_GETTIME 28
@@ -110,6 +110,13 @@ static inline long _zos_syscall4(long nr, long a1, long a2, long a3, long a4) {
 #define SYS_FRENAME 94
 #define SYS_GETCWD  95
 #define SYS_CHDIR   96
+#define SYS_PIPE_READ 142
+#define SYS_PIPE_WRITE 143
+#define SYS_FSYNC   157
+
+/* Montauk::PIPE_STDIN / PIPE_STDOUT: the pipes the process was spawned with */
+#define PIPE_STDIN  (-2)
+#define PIPE_STDOUT (-3)
 
 /* ========================================================================
    errno
@@ -143,6 +150,7 @@ struct _env_entry {
 };
 
 static struct _env_entry _env_entries[64];
+static int _env_loaded;
 static sighandler_t _signal_handlers[32];
 
 static const char *_weekday_short[] = {
@@ -304,7 +312,61 @@ static int _path_prefix_skip(const char *path) {
     return prefix_len;
 }
 
+/* The environment starts as the block the process was spawned with */
+static void _env_load(void) {
+    if (_env_loaded) return;
+    _env_loaded = 1;
+
+    char *block = (char *)malloc(MTK_SPAWN_ENV_MAX);
+    if (block == NULL) return;
+    int size = mtk_getenv_block(block, MTK_SPAWN_ENV_MAX);
+    if (size > MTK_SPAWN_ENV_MAX) size = MTK_SPAWN_ENV_MAX;
+
+    int slot = 0;
+    for (int pos = 0; pos < size && slot < (int)(sizeof(_env_entries) / sizeof(_env_entries[0]));) {
+        const char *entry = block + pos;
+        int len = 0;
+        while (pos + len < size && entry[len] != '\0') len++;
+        pos += len + 1;
+        int name_len = 0;
+        while (name_len < len && entry[name_len] != '=') name_len++;
+        if (name_len == 0 || name_len == len) continue;
+
+        char *name = (char *)malloc((size_t)name_len + 1);
+        char *value = (char *)malloc((size_t)(len - name_len));
+        if (name == NULL || value == NULL) {
+            free(name);
+            free(value);
+            break;
+        }
+        memcpy(name, entry, (size_t)name_len);
+        name[name_len] = '\0';
+        memcpy(value, entry + name_len + 1, (size_t)(len - name_len - 1));
+        value[len - name_len - 1] = '\0';
+        _env_entries[slot].name = name;
+        _env_entries[slot].value = value;
+        slot++;
+    }
+    free(block);
+}
+
+/* Put the environment in `block` (MTK_SPAWN_ENV_MAX bytes) as the
+   NULL-terminated `envp` (65 entries) MTK_SYS_SPAWN_EX takes */
+static void _env_build(char *block, const char **envp) {
+    int count = 0;
+    size_t used = 0;
+    for (int i = 0; i < (int)(sizeof(_env_entries) / sizeof(_env_entries[0])); i++) {
+        if (_env_entries[i].name == NULL) continue;
+        size_t need = strlen(_env_entries[i].name) + strlen(_env_entries[i].value) + 2;
+        if (used + need > MTK_SPAWN_ENV_MAX) break;
+        envp[count++] = block + used;
+        used += (size_t)sprintf(block + used, "%s=%s", _env_entries[i].name, _env_entries[i].value) + 1;
+    }
+    envp[count] = NULL;
+}
+
 static int _find_env_slot(const char *name) {
+    _env_load();
     for (int i = 0; i < (int)(sizeof(_env_entries) / sizeof(_env_entries[0])); i++) {
         if (_env_entries[i].name != NULL && strcmp(_env_entries[i].name, name) == 0)
             return i;
@@ -313,6 +375,7 @@ static int _find_env_slot(const char *name) {
 }
 
 static int _alloc_env_slot(void) {
+    _env_load();
     for (int i = 0; i < (int)(sizeof(_env_entries) / sizeof(_env_entries[0])); i++) {
         if (_env_entries[i].name == NULL)
             return i;
@@ -324,44 +387,100 @@ static int _alloc_env_slot(void) {
    string.h functions
    ======================================================================== */
 
+/* SIMD paths: SSE2 is baseline on x86-64, AVX2 is used when both the CPU
+   and the kernel (XCR0) support it. String scans only load aligned blocks,
+   which never cross into an unmapped page. */
+
+typedef char simd_v16 __attribute__((vector_size(16), may_alias));
+typedef char simd_v32 __attribute__((vector_size(32), may_alias));
+typedef char simd_v16u __attribute__((vector_size(16), may_alias, aligned(1)));
+typedef char simd_v32u __attribute__((vector_size(32), may_alias, aligned(1)));
+
+static int simd_level; /* 0 = not probed yet, 1 = SSE2, 2 = AVX2 */
+
+static int simd_probe(void) {
+    uint32_t a, b, c, d;
+    __asm__ volatile("cpuid" : "=a"(a), "=b"(b), "=c"(c), "=d"(d) : "a"(0), "c"(0));
+    if (a < 7) return 1;
+
+    /* AVX needs OSXSAVE and the YMM state enabled in XCR0 */
+    __asm__ volatile("cpuid" : "=a"(a), "=b"(b), "=c"(c), "=d"(d) : "a"(1), "c"(0));
+    if (!(c & (1u << 27)) || !(c & (1u << 28))) return 1;
+    uint32_t xlo, xhi;
+    __asm__ volatile("xgetbv" : "=a"(xlo), "=d"(xhi) : "c"(0));
+    if ((xlo & 6) != 6) return 1;
+
+    __asm__ volatile("cpuid" : "=a"(a), "=b"(b), "=c"(c), "=d"(d) : "a"(7), "c"(0));
+    return (b & (1u << 5)) ? 2 : 1;
+}
+
+static inline int simd_avx2(void) {
+    if (simd_level == 0) simd_level = simd_probe();
+    return simd_level == 2;
+}
+
+/* n >= 32 */
+__attribute__((target("avx2")))
+static void copy_avx2(unsigned char *d, const unsigned char *s, size_t n) {
+    size_t i = 0;
+    for (; i + 128 <= n; i += 128) {
+        simd_v32u a = *(const simd_v32u *)(s + i), b = *(const simd_v32u *)(s + i + 32);
+        simd_v32u c = *(const simd_v32u *)(s + i + 64), e = *(const simd_v32u *)(s + i + 96);
+        *(simd_v32u *)(d + i) = a; *(simd_v32u *)(d + i + 32) = b;
+        *(simd_v32u *)(d + i + 64) = c; *(simd_v32u *)(d + i + 96) = e;
+    }
+    for (; i + 32 <= n; i += 32) *(simd_v32u *)(d + i) = *(const simd_v32u *)(s + i);
+    if (i < n) *(simd_v32u *)(d + n - 32) = *(const simd_v32u *)(s + n - 32);
+}
+
+/* n >= 16 */
+static void copy_sse2(unsigned char *d, const unsigned char *s, size_t n) {
+    size_t i = 0;
+    for (; i + 64 <= n; i += 64) {
+        simd_v16u a = *(const simd_v16u *)(s + i), b = *(const simd_v16u *)(s + i + 16);
+        simd_v16u c = *(const simd_v16u *)(s + i + 32), e = *(const simd_v16u *)(s + i + 48);
+        *(simd_v16u *)(d + i) = a; *(simd_v16u *)(d + i + 16) = b;
+        *(simd_v16u *)(d + i + 32) = c; *(simd_v16u *)(d + i + 48) = e;
+    }
+    for (; i + 16 <= n; i += 16) *(simd_v16u *)(d + i) = *(const simd_v16u *)(s + i);
+    if (i < n) *(simd_v16u *)(d + n - 16) = *(const simd_v16u *)(s + n - 16);
+}
+
 void *memcpy(void *dest, const void *src, size_t n) {
     unsigned char *d = (unsigned char *)dest;
     const unsigned char *s = (const unsigned char *)src;
 
-    /* Byte copy until 8-byte aligned */
-    while (n && ((uint64_t)d & 7)) { *d++ = *s++; n--; }
+    if (n >= 64 && simd_avx2()) copy_avx2(d, s, n);
+    else if (n >= 16) copy_sse2(d, s, n);
+    else for (size_t i = 0; i < n; i++) d[i] = s[i];
 
-    /* Bulk 8-byte copy */
-    uint64_t *d8 = (uint64_t *)d;
-    const uint64_t *s8 = (const uint64_t *)s;
-    size_t words = n / 8;
-    for (size_t i = 0; i < words; i++) d8[i] = s8[i];
+    return dest;
+}
 
-    /* Remainder */
-    d = (unsigned char *)(d8 + words);
-    s = (const unsigned char *)(s8 + words);
-    for (size_t i = 0; i < (n & 7); i++) d[i] = s[i];
+/* n >= 32 */
+__attribute__((target("avx2")))
+static void fill_avx2(unsigned char *d, unsigned char v, size_t n) {
+    simd_v32u pattern = (simd_v32u){} + (char)v;
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) *(simd_v32u *)(d + i) = pattern;
+    if (i < n) *(simd_v32u *)(d + n - 32) = pattern;
+}
 
-    return dest;
+/* n >= 16 */
+static void fill_sse2(unsigned char *d, unsigned char v, size_t n) {
+    simd_v16u pattern = (simd_v16u){} + (char)v;
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) *(simd_v16u *)(d + i) = pattern;
+    if (i < n) *(simd_v16u *)(d + n - 16) = pattern;
 }
 
 void *memset(void *s, int c, size_t n) {
     unsigned char *p = (unsigned char *)s;
     unsigned char v = (unsigned char)c;
 
-    /* Byte fill until 8-byte aligned */
-    while (n && ((uint64_t)p & 7)) { *p++ = v; n--; }
-
-    /* Bulk 8-byte fill */
-    uint64_t v8 = v;
-    v8 |= v8 << 8;  v8 |= v8 << 16;  v8 |= v8 << 32;
-    uint64_t *p8 = (uint64_t *)p;
-    size_t words = n / 8;
-    for (size_t i = 0; i < words; i++) p8[i] = v8;
-
-    /* Remainder */
-    p = (unsigned char *)(p8 + words);
-    for (size_t i = 0; i < (n & 7); i++) p[i] = v;
+    if (n >= 64 && simd_avx2()) fill_avx2(p, v, n);
+    else if (n >= 16) fill_sse2(p, v, n);
+    else for (size_t i = 0; i < n; i++) p[i] = v;
 
     return s;
 }
@@ -369,8 +488,13 @@ void *memset(void *s, int c, size_t n) {
 void *memmove(void *dest, const void *src, size_t n) {
     unsigned char *d = (unsigned char *)dest;
     const unsigned char *s = (const unsigned char *)src;
-    if (d < s || d >= s + n) {
+    if (d + n <= s || d >= s + n) {
         memcpy(dest, src, n);
+    } else if (d < s) {
+        /* Overlapping forward copy: each word is read before it is overwritten */
+        size_t words = n / 8;
+        for (size_t i = 0; i < words; i++) ((uint64_t *)d)[i] = ((const uint64_t *)s)[i];
+        for (size_t i = words * 8; i < n; i++) d[i] = s[i];
     } else {
         /* Backward copy — bulk 8 bytes at a time from end */
         d += n; s += n;
@@ -386,30 +510,90 @@ void *memmove(void *dest, const void *src, size_t n) {
     return dest;
 }
 
+/* First index < n where the blocks differ, or n */
+static size_t mismatch_sse2(const unsigned char *a, const unsigned char *b, size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        unsigned eq = __builtin_ia32_pmovmskb128((simd_v16)(*(const simd_v16u *)(a + i) == *(const simd_v16u *)(b + i)));
+        if (eq != 0xFFFF) return i + __builtin_ctz(~eq);
+    }
+    for (; i < n; i++) if (a[i] != b[i]) return i;
+    return n;
+}
+
+__attribute__((target("avx2")))
+static size_t mismatch_avx2(const unsigned char *a, const unsigned char *b, size_t n) {
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        unsigned eq = __builtin_ia32_pmovmskb256((simd_v32)(*(const simd_v32u *)(a + i) == *(const simd_v32u *)(b + i)));
+        if (eq != 0xFFFFFFFFu) return i + __builtin_ctz(~eq);
+    }
+    return i + mismatch_sse2(a + i, b + i, n - i);
+}
+
 int memcmp(const void *s1, const void *s2, size_t n) {
     const unsigned char *a = (const unsigned char *)s1;
     const unsigned char *b = (const unsigned char *)s2;
-    for (size_t i = 0; i < n; i++) {
-        if (a[i] != b[i])
-            return a[i] < b[i] ? -1 : 1;
+    size_t i = (n >= 64 && simd_avx2()) ? mismatch_avx2(a, b, n) : mismatch_sse2(a, b, n);
+    if (i == n) return 0;
+    return a[i] < b[i] ? -1 : 1;
+}
+
+/* First index < n holding `v`, or n */
+static size_t find_sse2(const unsigned char *p, unsigned char v, size_t n) {
+    simd_v16u needle = (simd_v16u){} + (char)v;
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        unsigned m = __builtin_ia32_pmovmskb128((simd_v16)(*(const simd_v16u *)(p + i) == needle));
+        if (m) return i + __builtin_ctz(m);
     }
-    return 0;
+    for (; i < n; i++) if (p[i] == v) return i;
+    return n;
+}
+
+__attribute__((target("avx2")))
+static size_t find_avx2(const unsigned char *p, unsigned char v, size_t n) {
+    simd_v32u needle = (simd_v32u){} + (char)v;
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        unsigned m = __builtin_ia32_pmovmskb256((simd_v32)(*(const simd_v32u *)(p + i) == needle));
+        if (m) return i + __builtin_ctz(m);
+    }
+    return i + find_sse2(p + i, v, n - i);
 }
 
 void *memchr(const void *s, int c, size_t n) {
     const unsigned char *p = (const unsigned char *)s;
     unsigned char uc = (unsigned char)c;
-    for (size_t i = 0; i < n; i++) {
-        if (p[i] == uc)
-            return (void *)(p + i);
+    size_t i = (n >= 64 && simd_avx2()) ? find_avx2(p, uc, n) : find_sse2(p, uc, n);
+    return i == n ? (void *)0 : (void *)(p + i);
+}
+
+static size_t strlen_sse2(const char *s) {
+    size_t misalign = (uint64_t)s & 15;
+    const char *p = s - misalign;
+    unsigned mask = (unsigned)__builtin_ia32_pmovmskb128((simd_v16)(*(const simd_v16 *)p == (simd_v16){})) >> misalign;
+    if (mask) return __builtin_ctz(mask);
+    for (p += 16;; p += 16) {
+        mask = __builtin_ia32_pmovmskb128((simd_v16)(*(const simd_v16 *)p == (simd_v16){}));
+        if (mask) return (size_t)(p - s) + __builtin_ctz(mask);
+    }
+}
+
+__attribute__((target("avx2")))
+static size_t strlen_avx2(const char *s) {
+    size_t misalign = (uint64_t)s & 31;
+    const char *p = s - misalign;
+    unsigned mask = (unsigned)__builtin_ia32_pmovmskb256((simd_v32)(*(const simd_v32 *)p == (simd_v32){})) >> misalign;
+    if (mask) return __builtin_ctz(mask);
+    for (p += 32;; p += 32) {
+        mask = __builtin_ia32_pmovmskb256((simd_v32)(*(const simd_v32 *)p == (simd_v32){}));
+        if (mask) return (size_t)(p - s) + __builtin_ctz(mask);
     }
-    return (void *)0;
 }
 
 size_t strlen(const char *s) {
-    size_t len = 0;
-    while (s[len]) len++;
-    return len;
+    return simd_avx2() ? strlen_avx2(s) : strlen_sse2(s);
 }
 
 size_t strspn(const char *s, const char *accept) {
@@ -991,6 +1175,7 @@ int atexit(void (*func)(void)) {
 void exit(int status) {
     for (int i = _atexit_count - 1; i >= 0; i--)
         _atexit_funcs[i]();
+    fflush(NULL);
     _zos_syscall1(SYS_EXIT, (long)status);
     __builtin_unreachable();
 }
@@ -1017,7 +1202,21 @@ static void _system_build_drive_path(int drive, const char *leaf, char *out, siz
 }
 
 static int _system_try_spawn(const char *path, const char *args) {
-    int pid = (int)_zos_syscall2(SYS_SPAWN, (long)path, (long)args);
+    /* The environment as setenv() left it, if it was touched */
+    char *block = NULL;
+    const char *envp[65];
+    const char *argv[2] = { args, NULL };
+    if (_env_loaded) block = (char *)malloc(MTK_SPAWN_ENV_MAX);
+    if (block != NULL) _env_build(block, envp);
+
+    mtk_spawn_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.path = path;
+    attr.argv = (args != NULL && args[0] != '\0') ? argv : NULL;
+    attr.envp = (block != NULL) ? envp : NULL;
+    attr.priority = MTK_PRIO_INHERIT;
+    int pid = mtk_spawn_ex(&attr);
+    free(block);
     if (pid < 0) return -1;
     _zos_syscall1(SYS_WAITPID, (long)pid);
     return 0;
@@ -1034,6 +1233,9 @@ int system(const char *command) {
 
     if (command == NULL) return -1;
 
+    /* What is buffered goes out before the command's own output */
+    fflush(NULL);
+
     while (*command == ' ' || *command == '\t' || *command == '\n') command++;
     if (*command == '\0') return 0;
 
@@ -1325,26 +1527,21 @@ int sprintf(char *buf, const char *fmt, ...) {
     return ret;
 }
 
-static char _printbuf[4096];
-
 int printf(const char *fmt, ...) {
     va_list ap;
     va_start(ap, fmt);
-    int ret = vsnprintf(_printbuf, sizeof(_printbuf), fmt, ap);
+    int ret = vfprintf(stdout, fmt, ap);
     va_end(ap);
-    _zos_syscall1(SYS_PRINT, (long)_printbuf);
     return ret;
 }
 
 int puts(const char *s) {
-    _zos_syscall1(SYS_PRINT, (long)s);
-    _zos_syscall1(SYS_PUTCHAR, (long)'\n');
-    return 0;
+    if (fputs(s, stdout) == EOF) return EOF;
+    return (fputc('\n', stdout) == EOF) ? EOF : 0;
 }
 
 int putchar(int c) {
-    _zos_syscall1(SYS_PUTCHAR, (long)c);
-    return c;
+    return fputc(c, stdout);
 }
 
 /* ========================================================================
@@ -1352,11 +1549,7 @@ int putchar(int c) {
    ======================================================================== */
 
 void __assert_fail(const char *expr, const char *file, int line, const char *func) {
-    _zos_syscall1(SYS_PRINT, (long)"Assertion failed: ");
-    _zos_syscall1(SYS_PRINT, (long)expr);
-    _zos_syscall1(SYS_PRINT, (long)" at ");
-    _zos_syscall1(SYS_PRINT, (long)file);
-    _zos_syscall1(SYS_PRINT, (long)"\n");
+    fprintf(stderr, "Assertion failed: %s at %s\n", expr, file);
     (void)line; (void)func;
     abort();
 }
@@ -1365,18 +1558,140 @@ void __assert_fail(const char *expr, const char *file, int line, const char *fun
    stdio.h FILE-based I/O
    ======================================================================== */
 
-/* Static FILE objects for standard streams */
+/* Buffer a file stream allocates on first use */
+#define _STDIO_BUFSIZE 16384
+/* stdout and stderr; one byte more is kept for the NUL SYS_PRINT wants */
+#define _STDOUT_BUFSIZE 4096
+
+static unsigned char _stdout_buf[_STDOUT_BUFSIZE + 1];
+static unsigned char _stderr_buf[_STDOUT_BUFSIZE + 1];
+
+/* Static FILE objects for standard streams. stdout is line buffered until
+   its first flush finds it writing to a pipe; stderr goes out with every
+   call, stdout first. */
 static FILE _stdin_file  = { .handle = -1, .pos = 0, .size = 0, .eof = 0,
                              .error = 0, .is_std = 1, .ungetc_buf = -1 };
 static FILE _stdout_file = { .handle = -1, .pos = 0, .size = 0, .eof = 0,
-                             .error = 0, .is_std = 2, .ungetc_buf = -1 };
+                             .error = 0, .is_std = 2, .ungetc_buf = -1,
+                             .buf = _stdout_buf, .buf_size = _STDOUT_BUFSIZE,
+                             .buf_mode = _IOLBF };
 static FILE _stderr_file = { .handle = -1, .pos = 0, .size = 0, .eof = 0,
-                             .error = 0, .is_std = 3, .ungetc_buf = -1 };
+                             .error = 0, .is_std = 3, .ungetc_buf = -1,
+                             .buf = _stderr_buf, .buf_size = _STDOUT_BUFSIZE,
+                             .buf_mode = _IONBF };
 
 FILE *stdin  = &_stdin_file;
 FILE *stdout = &_stdout_file;
 FILE *stderr = &_stderr_file;
 
+/* Streams fopen() made, for fflush(NULL) and exit() */
+static FILE *_stdio_open = NULL;
+
+/* -1 until the first flush of stdout learns whether it is a pipe */
+static int _stdout_piped = -1;
+/* setvbuf() chose stdout's buffering, which a pipe then leaves alone */
+static int _stdout_mode_set = 0;
+
+static void _stdio_link(FILE *f) {
+    f->next = _stdio_open;
+    _stdio_open = f;
+}
+
+static void _stdio_unlink(FILE *f) {
+    for (FILE **p = &_stdio_open; *p != NULL; p = &(*p)->next) {
+        if (*p == f) {
+            *p = f->next;
+            return;
+        }
+    }
+}
+
+/* Hand `len` bytes of a standard stream's buffer to the kernel in one
+   call: SYS_PIPE_WRITE if the process was spawned with a stdout pipe,
+   SYS_PRINT otherwise. data[len] must be writable. */
+static void _stdio_emit(unsigned char *data, unsigned long len) {
+    if (_stdout_piped != 0) {
+        long n = _zos_syscall3(SYS_PIPE_WRITE, PIPE_STDOUT, (long)data, (long)len);
+        if (n >= 0) {
+            if (_stdout_piped < 0 && !_stdout_mode_set) stdout->buf_mode = _IOFBF;
+            _stdout_piped = 1;
+            return;
+        }
+        _stdout_piped = 0;
+    }
+
+    /* SYS_PRINT stops at a NUL, so any in the data go out one by one */
+    data[len] = '\0';
+    unsigned long i = 0;
+    while (i < len) {
+        if (data[i] == '\0') {
+            _zos_syscall1(SYS_PUTCHAR, 0L);
+            i++;
+            continue;
+        }
+        _zos_syscall1(SYS_PRINT, (long)(data + i));
+        i += strlen((const char *)data + i);
+    }
+}
+
+/* Write out what is buffered for writing, or drop what was read ahead;
+   either way the buffer is empty afterwards */
+static int _stdio_flush(FILE *f) {
+    int rc = 0;
+    if (f->buf_state == 2 && f->buf_pos > 0) {
+        if (f->is_std) {
+            _stdio_emit(f->buf, f->buf_pos);
+        } else {
+            int ret = (int)_zos_syscall4(SYS_FWRITE, (long)f->handle, (long)f->buf,
+                                          (long)(f->pos - f->buf_pos), (long)f->buf_pos);
+            if (ret < 0) {
+                f->error = 1;
+                rc = EOF;
+            }
+        }
+    }
+    f->buf_pos = 0;
+    f->buf_len = 0;
+    f->buf_state = 0;
+    return rc;
+}
+
+/* Give a file stream its buffer if it has none yet; 0 if it is to go
+   unbuffered */
+static int _stdio_alloc(FILE *f) {
+    if (f->buf_mode == _IONBF) return 0;
+    if (f->buf != NULL) return 1;
+    if (f->buf_size == 0) f->buf_size = _STDIO_BUFSIZE;
+    f->buf = (unsigned char *)malloc(f->buf_size);
+    if (f->buf == NULL) {
+        f->buf_size = 0;
+        f->buf_mode = _IONBF;
+        return 0;
+    }
+    f->buf_owned = 1;
+    return 1;
+}
+
+/* Read ahead from `pos`; returns the bytes buffered, 0 at end of file */
+static int _stdio_fill(FILE *f) {
+    f->buf_pos = 0;
+    f->buf_len = 0;
+    f->buf_state = 0;
+    if (f->pos >= f->size) return 0;
+
+    unsigned long want = f->size - f->pos;
+    if (want > f->buf_size) want = f->buf_size;
+    int ret = (int)_zos_syscall4(SYS_READ, (long)f->handle, (long)f->buf,
+                                  (long)f->pos, (long)want);
+    if (ret < 0) {
+        f->error = 1;
+        return -1;
+    }
+    f->buf_len = (unsigned long)ret;
+    f->buf_state = ret > 0 ? 1 : 0;
+    return ret;
+}
+
 static char _stdin_linebuf[512];
 static size_t _stdin_line_len = 0;
 static size_t _stdin_line_pos = 0;
@@ -1395,9 +1710,20 @@ static int _stdin_fill_line(void) {
     _stdin_line_len = 0;
     _stdin_line_pos = 0;
 
+    /* A prompt waiting in stdout's buffer shows before the input does */
+    _stdio_flush(stdout);
+
+    /* Piped stdin is taken as it comes, unechoed; -1 means there is no pipe */
+    long n = _zos_syscall3(SYS_PIPE_READ, PIPE_STDIN, (long)_stdin_linebuf, (long)sizeof(_stdin_linebuf));
+    if (n >= 0) {
+        _stdin_line_len = (size_t)n;
+        return n > 0;
+    }
+
     while (_stdin_line_len + 1 < sizeof(_stdin_linebuf)) {
         int c = (int)_zos_syscall0(SYS_GETCHAR);
-        if (c <= 0) continue;
+        if (c < 0) break;
+        if (c == 0) continue;
 
         if (c == '\r') c = '\n';
 
@@ -1476,13 +1802,13 @@ FILE *fopen(const char *path, const char *mode) {
         return NULL;
     }
 
+    memset(f, 0, sizeof(FILE));
     f->handle = handle;
     f->size = fileSize;
     f->pos = want_append ? fileSize : 0;
-    f->eof = 0;
-    f->error = 0;
-    f->is_std = 0;
     f->ungetc_buf = -1;
+    f->buf_mode = _IOFBF;
+    _stdio_link(f);
 
     (void)want_read;
     (void)want_write;
@@ -1492,11 +1818,14 @@ FILE *fopen(const char *path, const char *mode) {
 
 int fclose(FILE *stream) {
     if (stream == NULL) return EOF;
-    if (stream->is_std) return 0;
+    if (stream->is_std) return fflush(stream);
 
+    int rc = _stdio_flush(stream);
     _zos_syscall1(SYS_CLOSE, (long)stream->handle);
+    _stdio_unlink(stream);
+    if (stream->buf_owned) free(stream->buf);
     free(stream);
-    return 0;
+    return rc;
 }
 
 size_t fread(void *ptr, size_t size, size_t nmemb, FILE *stream) {
@@ -1516,6 +1845,9 @@ size_t fread(void *ptr, size_t size, size_t nmemb, FILE *stream) {
         }
         return i / size;
     }
+    if (stream->is_std) return 0;
+
+    if (stream->buf_state == 2 && _stdio_flush(stream) == EOF) return 0;
 
     size_t total = size * nmemb;
     size_t remaining = (stream->pos < stream->size) ? stream->size - stream->pos : 0;
@@ -1523,44 +1855,102 @@ size_t fread(void *ptr, size_t size, size_t nmemb, FILE *stream) {
         total = remaining;
         stream->eof = 1;
     }
-    if (total == 0) return 0;
 
-    int ret = (int)_zos_syscall4(SYS_READ, (long)stream->handle,
-                                  (long)ptr, (long)stream->pos, (long)total);
-    if (ret < 0) {
-        stream->error = 1;
-        return 0;
+    /* What was read ahead first; then reads of a buffer or more go
+       straight to the caller, and smaller ones through the buffer */
+    unsigned char *dst = (unsigned char *)ptr;
+    size_t done = 0;
+    while (done < total) {
+        if (stream->buf_state == 1 && stream->buf_pos < stream->buf_len) {
+            size_t n = stream->buf_len - stream->buf_pos;
+            if (n > total - done) n = total - done;
+            memcpy(dst + done, stream->buf + stream->buf_pos, n);
+            stream->buf_pos += n;
+            stream->pos += n;
+            done += n;
+            continue;
+        }
+
+        size_t want = total - done;
+        if (!_stdio_alloc(stream) || want >= stream->buf_size) {
+            _stdio_flush(stream);
+            int ret = (int)_zos_syscall4(SYS_READ, (long)stream->handle,
+                                          (long)(dst + done), (long)stream->pos, (long)want);
+            if (ret < 0) {
+                stream->error = 1;
+                break;
+            }
+            if (ret == 0) {
+                stream->eof = 1;
+                break;
+            }
+            stream->pos += (unsigned long)ret;
+            done += (size_t)ret;
+            continue;
+        }
+
+        if (_stdio_fill(stream) <= 0) {
+            if (!stream->error) stream->eof = 1;
+            break;
+        }
     }
 
-    stream->pos += (unsigned long)ret;
-    return (size_t)ret / size;
+    return done / size;
 }
 
 size_t fwrite(const void *ptr, size_t size, size_t nmemb, FILE *stream) {
     if (stream == NULL || ptr == NULL || size == 0 || nmemb == 0) return 0;
 
-    if (stream->is_std) {
-        /* stdout/stderr: print via SYS_PRINT/SYS_PUTCHAR */
-        size_t total = size * nmemb;
-        const char *src = (const char *)ptr;
-        for (size_t i = 0; i < total; i++)
-            _zos_syscall1(SYS_PUTCHAR, (long)(unsigned char)src[i]);
-        return nmemb;
-    }
+    /* Writes to stdin have always gone to the console */
+    if (stream->is_std == 1) stream = stdout;
+    if (stream == stderr) _stdio_flush(stdout);
+    if (stream->buf_state == 1) _stdio_flush(stream);
 
     size_t total = size * nmemb;
-    int ret = (int)_zos_syscall4(SYS_FWRITE, (long)stream->handle,
-                                  (long)ptr, (long)stream->pos, (long)total);
-    if (ret < 0) {
-        stream->error = 1;
-        return 0;
+    const unsigned char *src = (const unsigned char *)ptr;
+
+    /* A file stream writes a buffer or more at once, and everything when
+       unbuffered, straight through after what is pending */
+    if (!stream->is_std && (!_stdio_alloc(stream) || total >= stream->buf_size)) {
+        if (_stdio_flush(stream) == EOF) return 0;
+        int ret = (int)_zos_syscall4(SYS_FWRITE, (long)stream->handle,
+                                      (long)src, (long)stream->pos, (long)total);
+        if (ret < 0) {
+            stream->error = 1;
+            return 0;
+        }
+
+        stream->pos += (unsigned long)ret;
+        /* Update size if we wrote past the old end */
+        if (stream->pos > stream->size)
+            stream->size = stream->pos;
+        return (size_t)ret / size;
+    }
+
+    size_t done = 0;
+    while (done < total) {
+        size_t room = stream->buf_size - stream->buf_pos;
+        if (room == 0) {
+            if (_stdio_flush(stream) == EOF) break;
+            continue;
+        }
+        size_t n = total - done;
+        if (n > room) n = room;
+        memcpy(stream->buf + stream->buf_pos, src + done, n);
+        stream->buf_pos += n;
+        stream->buf_state = 2;
+        done += n;
+        if (!stream->is_std) {
+            stream->pos += n;
+            if (stream->pos > stream->size)
+                stream->size = stream->pos;
+        }
     }
 
-    stream->pos += (unsigned long)ret;
-    /* Update size if we wrote past the old end */
-    if (stream->pos > stream->size)
-        stream->size = stream->pos;
-    return (size_t)ret / size;
+    if (stream->buf_mode == _IONBF ||
+        (stream->buf_mode == _IOLBF && memchr(src, '\n', done) != NULL))
+        _stdio_flush(stream);
+    return done / size;
 }
 
 int fseek(FILE *stream, long offset, int whence) {
@@ -1574,8 +1964,21 @@ int fseek(FILE *stream, long offset, int whence) {
     default: return -1;
     }
 
-    stream->pos = newpos;
+    stream->ungetc_buf = -1;
     stream->eof = 0;
+
+    /* A seek within what was read ahead keeps it */
+    if (stream->buf_state == 1) {
+        unsigned long start = stream->pos - stream->buf_pos;
+        if (newpos >= start && newpos <= start + stream->buf_len) {
+            stream->buf_pos = newpos - start;
+            stream->pos = newpos;
+            return 0;
+        }
+    }
+    if (_stdio_flush(stream) == EOF) return -1;
+
+    stream->pos = newpos;
     return 0;
 }
 
@@ -1585,9 +1988,17 @@ long ftell(FILE *stream) {
 }
 
 int fflush(FILE *stream) {
-    /* No buffering in this implementation */
-    (void)stream;
-    return 0;
+    if (stream != NULL) {
+        if (stream->buf_state != 2) return 0;
+        return _stdio_flush(stream);
+    }
+
+    int rc = 0;
+    for (FILE *f = _stdio_open; f != NULL; f = f->next)
+        if (f->buf_state == 2 && _stdio_flush(f) == EOF) rc = EOF;
+    if (_stdio_flush(stdout) == EOF) rc = EOF;
+    if (_stdio_flush(stderr) == EOF) rc = EOF;
+    return rc;
 }
 
 FILE *freopen(const char *path, const char *mode, FILE *stream) {
@@ -1597,20 +2008,44 @@ FILE *freopen(const char *path, const char *mode, FILE *stream) {
     FILE *fresh = fopen(path, mode);
     if (fresh == NULL) return NULL;
 
+    _stdio_flush(stream);
     if (!stream->is_std) {
         _zos_syscall1(SYS_CLOSE, (long)stream->handle);
+        _stdio_unlink(stream);
+        if (stream->buf_owned) free(stream->buf);
     }
 
+    _stdio_unlink(fresh);
     *stream = *fresh;
     free(fresh);
+    _stdio_link(stream);
     return stream;
 }
 
 int setvbuf(FILE *stream, char *buf, int mode, size_t size) {
-    (void)stream;
-    (void)buf;
-    (void)mode;
-    (void)size;
+    if (stream == NULL) return -1;
+    if (mode != _IOFBF && mode != _IOLBF && mode != _IONBF) return -1;
+    /* stdin keeps its own line buffer */
+    if (stream->is_std == 1) return 0;
+    if (_stdio_flush(stream) == EOF) return -1;
+
+    stream->buf_mode = mode;
+    if (stream == stdout) _stdout_mode_set = 1;
+
+    /* stdout and stderr always keep a buffer, with the byte for the NUL */
+    if (stream->is_std) {
+        if (buf != NULL && size > 1) {
+            stream->buf = (unsigned char *)buf;
+            stream->buf_size = size - 1;
+        }
+        return 0;
+    }
+
+    if (buf == NULL && (mode == _IONBF || size == 0)) return 0;
+    if (stream->buf_owned) free(stream->buf);
+    stream->buf = (unsigned char *)buf;
+    stream->buf_size = size;
+    stream->buf_owned = 0;
     return 0;
 }
 
@@ -1650,10 +2085,25 @@ int fgetc(FILE *stream) {
         return (unsigned char)_stdin_linebuf[_stdin_line_pos++];
     }
 
-    if (stream->pos >= stream->size) {
+    if (stream->buf_state == 1 && stream->buf_pos < stream->buf_len) {
+        stream->pos++;
+        return stream->buf[stream->buf_pos++];
+    }
+
+    if (stream->is_std || stream->pos >= stream->size) {
         stream->eof = 1;
         return EOF;
     }
+    if (stream->buf_state == 2 && _stdio_flush(stream) == EOF) return EOF;
+
+    if (_stdio_alloc(stream)) {
+        if (_stdio_fill(stream) <= 0) {
+            if (!stream->error) stream->eof = 1;
+            return EOF;
+        }
+        stream->pos++;
+        return stream->buf[stream->buf_pos++];
+    }
 
     unsigned char c;
     int ret = (int)_zos_syscall4(SYS_READ, (long)stream->handle,
@@ -1674,7 +2124,7 @@ int getc(FILE *stream) {
 int fputc(int c, FILE *stream) {
     unsigned char ch = (unsigned char)c;
     size_t n = fwrite(&ch, 1, 1, stream);
-    return (n == 1) ? c : EOF;
+    return (n == 1) ? (int)ch : EOF;
 }
 
 int ungetc(int c, FILE *stream) {
@@ -1710,29 +2160,36 @@ int fputs(const char *s, FILE *stream) {
 }
 
 int fprintf(FILE *stream, const char *fmt, ...) {
-    char buf[4096];
     va_list ap;
     va_start(ap, fmt);
-    int n = vsnprintf(buf, sizeof(buf), fmt, ap);
+    int n = vfprintf(stream, fmt, ap);
     va_end(ap);
-
-    if (stream == NULL || stream->is_std) {
-        _zos_syscall1(SYS_PRINT, (long)buf);
-    } else {
-        fwrite(buf, 1, (size_t)(n > 0 ? n : 0), stream);
-    }
     return n;
 }
 
+/* Output that does not fit the stack buffer is formatted again into one
+   big enough, so it reaches the stream in a single write */
 int vfprintf(FILE *stream, const char *fmt, va_list ap) {
     char buf[4096];
+    va_list again;
+    va_copy(again, ap);
     int n = vsnprintf(buf, sizeof(buf), fmt, ap);
-
-    if (stream == NULL || stream->is_std) {
-        _zos_syscall1(SYS_PRINT, (long)buf);
-    } else {
-        fwrite(buf, 1, (size_t)(n > 0 ? n : 0), stream);
+    if (stream == NULL) stream = stdout;
+
+    if (n >= (int)sizeof(buf)) {
+        char *big = (char *)malloc((size_t)n + 1);
+        if (big != NULL) {
+            vsnprintf(big, (size_t)n + 1, fmt, again);
+            fwrite(big, 1, (size_t)n, stream);
+            free(big);
+            va_end(again);
+            return n;
+        }
+        fwrite(buf, 1, sizeof(buf) - 1, stream);
+    } else if (n > 0) {
+        fwrite(buf, 1, (size_t)n, stream);
     }
+    va_end(again);
     return n;
 }
 
@@ -1755,11 +2212,9 @@ int rename(const char *oldpath, const char *newpath) {
 }
 
 void perror(const char *s) {
-    if (s != NULL && s[0] != '\0') {
-        _zos_syscall1(SYS_PRINT, (long)s);
-        _zos_syscall1(SYS_PRINT, (long)": ");
-    }
-    _zos_syscall1(SYS_PRINT, (long)"error\n");
+    if (s != NULL && s[0] != '\0')
+        fprintf(stderr, "%s: ", s);
+    fputs("error\n", stderr);
 }
 
 FILE *tmpfile(void) {
@@ -1775,7 +2230,7 @@ char *tmpnam(char *s) {
 
     _zos_syscall1(SYS_FMKDIR, (long)"0:/tmp");
     snprintf(out, L_tmpnam, "0:/tmp/tmp%lu.tmp",
-             (unsigned long)_zos_syscall0(SYS_GETMILLISECONDS) + counter++);
+             mtk_get_ms() + counter++);
     return out;
 }
 
@@ -1952,6 +2407,14 @@ int close(int fd) {
     return 0;
 }
 
+int fsync(int fd) {
+    if ((int)_zos_syscall1(SYS_FSYNC, (long)fd) < 0) {
+        errno = EIO;
+        return -1;
+    }
+    return 0;
+}
+
 long lseek(int fd, long offset, int whence) {
     unsigned long pos = (fd >= 0 && fd < _FD_POS_MAX) ? _fd_pos[fd] : 0;
     unsigned long newpos;
@@ -2637,7 +3100,7 @@ int raise(int sig) {
    ======================================================================== */
 
 clock_t clock(void) {
-    return (clock_t)_zos_syscall0(SYS_GETMILLISECONDS);
+    return (clock_t)mtk_get_ms();
 }
 
 time_t time(time_t *tloc) {
@@ -2844,7 +3307,7 @@ size_t strftime(char *s, size_t max, const char *format, const struct tm *tm) {
 }
 
 int gettimeofday(struct timeval *tv, struct timezone *tz) {
-    long ms = (long)_zos_syscall0(SYS_GETMILLISECONDS);
+    long ms = (long)mtk_get_ms();
 
     if (tv != NULL) {
         tv->tv_sec = (long)time(NULL);
@@ -0,0 +1,142 @@
+/*
+ * mkanchors.c
+ * Build-time tool: pre-parse a PEM CA bundle into a trust anchor blob
+ * Usage: mkanchors <ca-certificates.crt> <ca-anchors.bin>
+ * Copyright (c) 2026 Daniel Hammer
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bearssl.h"
+#include "tls/anchors.h"
+
+typedef struct {
+    unsigned char* data;
+    size_t len, cap;
+} Buf;
+
+static void buf_append(void* ctx, const void* src, size_t len) {
+    Buf* b = (Buf*)ctx;
+    if (b->len + len > b->cap) {
+        size_t nc = b->cap ? b->cap * 2 : 4096;
+        while (nc < b->len + len) nc *= 2;
+        b->data = (unsigned char*)realloc(b->data, nc);
+        if (!b->data) { fprintf(stderr, "mkanchors: out of memory\n"); exit(1); }
+        b->cap = nc;
+    }
+    memcpy(b->data + b->len, src, len);
+    b->len += len;
+}
+
+static Buf g_entries;    // TaBlobEntry records
+static Buf g_data;       // DNs and keys they point at
+static uint32_t g_count;
+
+// Offset the data will have once the header and entries are in front
+static uint32_t data_put(const void* src, size_t len) {
+    uint32_t off = (uint32_t)g_data.len;
+    buf_append(&g_data, src, len);
+    return off;
+}
+
+// Decode one certificate the way libtls used to at runtime
+static void add_cert(const unsigned char* der, size_t len) {
+    static br_x509_decoder_context dc;
+    Buf dn = { NULL, 0, 0 };
+    br_x509_decoder_init(&dc, buf_append, &dn);
+    br_x509_decoder_push(&dc, der, len);
+    br_x509_pkey* pk = br_x509_decoder_get_pkey(&dc);
+    if (!pk) { free(dn.data); return; }
+
+    TaBlobEntry e;
+    memset(&e, 0, sizeof(e));
+    e.dnOff = data_put(dn.data, dn.len);
+    e.dnLen = (uint32_t)dn.len;
+    e.flags = br_x509_decoder_isCA(&dc) ? BR_X509_TA_CA : 0;
+
+    switch (pk->key_type) {
+    case BR_KEYTYPE_RSA:
+        e.keyType = BR_KEYTYPE_RSA;
+        e.aOff = data_put(pk->key.rsa.n, pk->key.rsa.nlen);
+        e.aLen = (uint32_t)pk->key.rsa.nlen;
+        e.bOff = data_put(pk->key.rsa.e, pk->key.rsa.elen);
+        e.bLen = (uint32_t)pk->key.rsa.elen;
+        break;
+    case BR_KEYTYPE_EC:
+        e.keyType = BR_KEYTYPE_EC;
+        e.curve = (uint32_t)pk->key.ec.curve;
+        e.aOff = data_put(pk->key.ec.q, pk->key.ec.qlen);
+        e.aLen = (uint32_t)pk->key.ec.qlen;
+        break;
+    default:
+        g_data.len = e.dnOff;
+        free(dn.data);
+        return;
+    }
+    free(dn.data);
+
+    buf_append(&g_entries, &e, sizeof(e));
+    g_count++;
+}
+
+int main(int argc, char** argv) {
+    if (argc != 3) {
+        fprintf(stderr, "usage: mkanchors <ca-certificates.crt> <ca-anchors.bin>\n");
+        return 1;
+    }
+
+    FILE* in = fopen(argv[1], "rb");
+    if (!in) { perror(argv[1]); return 1; }
+    Buf pem = { NULL, 0, 0 };
+    unsigned char chunk[8192];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), in)) > 0) buf_append(&pem, chunk, n);
+    fclose(in);
+
+    static br_pem_decoder_context pc;
+    br_pem_decoder_init(&pc);
+    Buf der = { NULL, 0, 0 };
+    int inCert = 0;
+    size_t offset = 0;
+    while (offset < pem.len) {
+        offset += br_pem_decoder_push(&pc, pem.data + offset, pem.len - offset);
+        int ev = br_pem_decoder_event(&pc);
+        if (ev == BR_PEM_BEGIN_OBJ) {
+            inCert = strcmp(br_pem_decoder_name(&pc), "CERTIFICATE") == 0;
+            br_pem_decoder_setdest(&pc, inCert ? buf_append : NULL, inCert ? &der : NULL);
+            der.len = 0;
+        } else if (ev == BR_PEM_END_OBJ) {
+            if (inCert && der.len > 0) add_cert(der.data, der.len);
+            inCert = 0;
+        } else if (ev == BR_PEM_ERROR) {
+            fprintf(stderr, "mkanchors: PEM error in %s\n", argv[1]);
+            return 1;
+        }
+    }
+
+    // Rebase the data offsets past the header and entry table
+    uint32_t base = (uint32_t)(sizeof(TaBlobHeader) + g_entries.len);
+    TaBlobEntry* entries = (TaBlobEntry*)g_entries.data;
+    for (uint32_t i = 0; i < g_count; i++) {
+        entries[i].dnOff += base;
+        entries[i].aOff += base;
+        if (entries[i].bLen) entries[i].bOff += base;
+    }
+
+    TaBlobHeader h;
+    memcpy(h.magic, TA_BLOB_MAGIC, sizeof(h.magic));
+    h.count = g_count;
+    h.size = base + (uint32_t)g_data.len;
+
+    FILE* out = fopen(argv[2], "wb");
+    if (!out) { perror(argv[2]); return 1; }
+    fwrite(&h, sizeof(h), 1, out);
+    if (g_entries.len) fwrite(g_entries.data, g_entries.len, 1, out);
+    if (g_data.len) fwrite(g_data.data, g_data.len, 1, out);
+    if (fclose(out) != 0) { perror(argv[2]); return 1; }
+
+    printf("mkanchors: %u trust anchors, %u bytes\n", g_count, h.size);
+    return 0;
+}
@@ -2,10 +2,12 @@
  * tls.cpp
  * Shared TLS helper library for MontaukOS
  * Extracted from fetch, wiki, wikipedia, and weather apps
+ * Persistent HTTPS client with keep-alive and session resumption
  * Copyright (c) 2025-2026 Daniel Hammer
  */
 
 #include <tls/tls.hpp>
+#include <tls/anchors.h>
 #include <montauk/syscall.h>
 
 extern "C" {
@@ -99,6 +101,66 @@ bool process_cert_der(tls::TrustAnchors* tas, const unsigned char* der, size_t d
     return true;
 }
 
+// Trust anchors from the blob mkanchors built out of the CA bundle. The
+// anchors point into the read-only mapping, so nothing is decoded or
+// copied; returns an empty set if the blob is missing or malformed.
+tls::TrustAnchors load_anchor_blob() {
+    tls::TrustAnchors tas = {nullptr, 0, 0};
+    int fh = montauk::open(TA_BLOB_PATH);
+    if (fh < 0) return tas;
+    uint64_t fsize = montauk::getsize(fh);
+    montauk::close(fh);
+    if (fsize < sizeof(TaBlobHeader)) return tas;
+
+    const unsigned char* blob = (const unsigned char*)montauk::mmap(TA_BLOB_PATH);
+    if (!blob) return tas;
+    const TaBlobHeader* h = (const TaBlobHeader*)blob;
+    const TaBlobEntry* entries = (const TaBlobEntry*)(blob + sizeof(TaBlobHeader));
+    if (memcmp(h->magic, TA_BLOB_MAGIC, sizeof(h->magic)) != 0 || h->size != fsize ||
+        h->count == 0 || h->count > (fsize - sizeof(TaBlobHeader)) / sizeof(TaBlobEntry)) {
+        montauk::munmap((void*)blob);
+        return tas;
+    }
+
+    tas.anchors = (br_x509_trust_anchor*)malloc(h->count * sizeof(br_x509_trust_anchor));
+    if (!tas.anchors) { montauk::munmap((void*)blob); return tas; }
+    tas.capacity = h->count;
+
+    auto field = [&](uint32_t off, uint32_t len) -> unsigned char* {
+        if (off > fsize || len > fsize - off) return nullptr;
+        return (unsigned char*)blob + off;
+    };
+
+    for (uint32_t i = 0; i < h->count; i++) {
+        const TaBlobEntry& e = entries[i];
+        br_x509_trust_anchor ta;
+        memset(&ta, 0, sizeof(ta));
+        ta.dn.data = field(e.dnOff, e.dnLen);
+        ta.dn.len = e.dnLen;
+        ta.flags = e.flags;
+        ta.pkey.key_type = (unsigned char)e.keyType;
+        unsigned char* a = field(e.aOff, e.aLen);
+        if (!ta.dn.data || !a) continue;
+
+        if (e.keyType == BR_KEYTYPE_RSA) {
+            unsigned char* b = field(e.bOff, e.bLen);
+            if (!b) continue;
+            ta.pkey.key.rsa.n = a;
+            ta.pkey.key.rsa.nlen = e.aLen;
+            ta.pkey.key.rsa.e = b;
+            ta.pkey.key.rsa.elen = e.bLen;
+        } else if (e.keyType == BR_KEYTYPE_EC) {
+            ta.pkey.key.ec.curve = (int)e.curve;
+            ta.pkey.key.ec.q = a;
+            ta.pkey.key.ec.qlen = e.aLen;
+        } else {
+            continue;
+        }
+        tas.anchors[tas.count++] = ta;
+    }
+    return tas;
+}
+
 } // anonymous namespace
 
 // ============================================================================
@@ -108,7 +170,10 @@ bool process_cert_der(tls::TrustAnchors* tas, const unsigned char* der, size_t d
 namespace tls {
 
 TrustAnchors load_trust_anchors() {
-    TrustAnchors tas = {nullptr, 0, 0};
+    // Pre-parsed at build time where available; the PEM bundle otherwise
+    TrustAnchors tas = load_anchor_blob();
+    if (tas.count > 0) return tas;
+
     int fh = montauk::open("0:/etc/ca-certificates.crt");
     if (fh < 0) return tas;
     uint64_t fsize = montauk::getsize(fh);
@@ -277,3 +342,472 @@ int https_fetch(const char* host, uint32_t ip, uint16_t port,
 }
 
 } // namespace tls
+
+// ============================================================================
+// Persistent HTTPS client
+// ============================================================================
+
+namespace {
+
+// Reconnect (resuming the session) rather than reuse a connection that
+// has been idle this long; servers drop idle keep-alive connections
+constexpr uint64_t HTTPS_IDLE_MS = 30000;
+constexpr int      HEAD_MAX      = 8192;
+
+// HTTP/1.1 response framing, parsed as the decrypted bytes arrive
+enum class Stage { Head, Length, UntilClose, ChunkSize, ChunkData, ChunkEnd, Trailer, Done };
+
+struct ResponseParser {
+    tls::ResponseFn on_data;
+    void*    ctx;
+    bool     noBody;          // response to a HEAD request
+    Stage    stage;
+    char     head[HEAD_MAX];
+    int      headLen;
+    uint64_t left;            // body or chunk bytes still to come
+    int      lineLen;         // chunk size and trailer lines
+    char     line[32];
+    int      delivered;
+    bool     keepAlive;       // the connection can take another request
+    bool     stopped;         // on_data asked to stop
+    bool     failed;          // malformed response or I/O error
+    bool     aborted;
+};
+
+void parser_init(ResponseParser* p, tls::ResponseFn on_data, void* ctx, bool noBody) {
+    p->on_data = on_data;
+    p->ctx = ctx;
+    p->noBody = noBody;
+    p->stage = Stage::Head;
+    p->headLen = 0;
+    p->left = 0;
+    p->lineLen = 0;
+    p->delivered = 0;
+    p->keepAlive = false;
+    p->stopped = false;
+    p->failed = false;
+    p->aborted = false;
+}
+
+void deliver(ResponseParser* p, const char* data, size_t len) {
+    if (len == 0 || p->stopped) return;
+    if (!p->on_data(p->ctx, data, (int)len)) p->stopped = true;
+    // Saturates: a streamed download can run past what an int holds
+    p->delivered = len < (size_t)(0x7FFFFFFF - p->delivered) ? p->delivered + (int)len : 0x7FFFFFFF;
+}
+
+char lower(char c) {
+    return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+}
+
+// Copy the value of header `name` (lowercase) into out, lowercased
+bool header_value(const char* head, int len, const char* name, char* out, int outMax) {
+    int nameLen = (int)strlen(name);
+    int i = 0;
+    while (i < len && head[i] != '\n') i++;
+    while (++i < len) {
+        int n = 0;
+        while (n < nameLen && i + n < len && lower(head[i + n]) == name[n]) n++;
+        if (n == nameLen && i + n < len && head[i + n] == ':') {
+            i += n + 1;
+            while (i < len && (head[i] == ' ' || head[i] == '\t')) i++;
+            int j = 0;
+            while (i < len && head[i] != '\r' && head[i] != '\n') {
+                if (j < outMax - 1) out[j++] = lower(head[i]);
+                i++;
+            }
+            out[j] = '\0';
+            return true;
+        }
+        while (i < len && head[i] != '\n') i++;
+    }
+    return false;
+}
+
+// The headers are complete: hand them over and work out how the body is
+// framed and whether the connection stays open
+void parse_head(ResponseParser* p) {
+    const char* h = p->head;
+    int len = p->headLen;
+
+    int status = 0;
+    if (len > 12 && memcmp(h, "HTTP/", 5) == 0) {
+        for (int i = 9; i < 12 && h[i] >= '0' && h[i] <= '9'; i++)
+            status = status * 10 + (h[i] - '0');
+    }
+    if (status == 0) { p->failed = true; return; }
+
+    // Interim responses (100 Continue) are followed by the real one
+    if (status >= 100 && status < 200) {
+        p->headLen = 0;
+        return;
+    }
+
+    char value[64];
+    bool http11 = memcmp(h, "HTTP/1.1", 8) == 0;
+    p->keepAlive = http11;
+    if (header_value(h, len, "connection", value, sizeof(value))) {
+        if (strstr(value, "close")) p->keepAlive = false;
+        else if (strstr(value, "keep-alive")) p->keepAlive = true;
+    }
+
+    if (p->noBody || status == 204 || status == 304) {
+        p->stage = Stage::Done;
+    } else if (header_value(h, len, "transfer-encoding", value, sizeof(value)) &&
+               strstr(value, "chunked")) {
+        p->stage = Stage::ChunkSize;
+        p->lineLen = 0;
+    } else if (header_value(h, len, "content-length", value, sizeof(value))) {
+        uint64_t n = 0;
+        for (int i = 0; value[i] >= '0' && value[i] <= '9'; i++) n = n * 10 + (value[i] - '0');
+        p->left = n;
+        p->stage = n ? Stage::Length : Stage::Done;
+    } else {
+        // Delimited by the server closing the connection
+        p->stage = Stage::UntilClose;
+        p->keepAlive = false;
+    }
+
+    deliver(p, h, len);
+}
+
+void parser_feed(ResponseParser* p, const unsigned char* buf, size_t len) {
+    const char* data = (const char*)buf;
+    size_t i = 0;
+    while (i < len && !p->stopped && !p->failed) {
+        switch (p->stage) {
+        case Stage::Head:
+            if (p->headLen >= HEAD_MAX) { p->failed = true; break; }
+            p->head[p->headLen++] = data[i++];
+            if (p->headLen >= 4 && memcmp(p->head + p->headLen - 4, "\r\n\r\n", 4) == 0)
+                parse_head(p);
+            break;
+
+        case Stage::Length:
+        case Stage::ChunkData: {
+            size_t n = len - i;
+            if (n > p->left) n = (size_t)p->left;
+            deliver(p, data + i, n);
+            i += n;
+            p->left -= n;
+            if (p->left == 0)
+                p->stage = p->stage == Stage::Length ? Stage::Done : Stage::ChunkEnd;
+            break;
+        }
+
+        case Stage::UntilClose:
+            deliver(p, data + i, len - i);
+            i = len;
+            break;
+
+        case Stage::ChunkSize: {
+            // "1a2b[;extension]\r\n"
+            char c = data[i++];
+            if (c != '\n') {
+                if (p->lineLen < (int)sizeof(p->line)) p->line[p->lineLen++] = c;
+                break;
+            }
+            uint64_t n = 0;
+            int k = 0;
+            for (; k < p->lineLen; k++) {
+                char d = lower(p->line[k]);
+                if (d >= '0' && d <= '9') n = n * 16 + (d - '0');
+                else if (d >= 'a' && d <= 'f') n = n * 16 + (d - 'a' + 10);
+                else break;
+            }
+            if (k == 0) { p->failed = true; break; }
+            p->lineLen = 0;
+            p->left = n;
+            p->stage = n ? Stage::ChunkData : Stage::Trailer;
+            break;
+        }
+
+        case Stage::ChunkEnd:
+            // The CRLF after a chunk's data
+            if (data[i++] == '\n') p->stage = Stage::ChunkSize;
+            break;
+
+        case Stage::Trailer: {
+            // Trailer lines, up to an empty one
+            char c = data[i++];
+            if (c == '\n') {
+                if (p->lineLen == 0) p->stage = Stage::Done;
+                p->lineLen = 0;
+            } else if (c != '\r') {
+                p->lineLen = 1;
+            }
+            break;
+        }
+
+        case Stage::Done:
+            // More than the response: the stream is out of step
+            p->keepAlive = false;
+            i = len;
+            break;
+        }
+    }
+}
+
+void conn_drop(tls::HttpsConn* c) {
+    if (c->fd >= 0) montauk::closesocket(c->fd);
+    c->fd = -1;
+}
+
+// Connect and start the handshake, resuming the last session if there is one
+bool conn_open(tls::HttpsConn* c, const tls::TrustAnchors* tas) {
+    if (!c->cc) {
+        c->cc = (br_ssl_client_context*)malloc(sizeof(*c->cc));
+        c->xc = (br_x509_minimal_context*)malloc(sizeof(*c->xc));
+        c->iobuf = malloc(BR_SSL_BUFSIZE_BIDI);
+        if (!c->cc || !c->xc || !c->iobuf) {
+            free(c->cc); free(c->xc); free(c->iobuf);
+            c->cc = nullptr; c->xc = nullptr; c->iobuf = nullptr;
+            return false;
+        }
+    }
+
+    int fd = montauk::socket(Montauk::SOCK_TCP);
+    if (fd < 0) return false;
+    if (montauk::connect(fd, c->ip, c->port) < 0) { montauk::closesocket(fd); return false; }
+
+    br_ssl_client_init_full(c->cc, c->xc, tas->anchors, tas->count);
+    uint32_t days, secs;
+    tls::get_bearssl_time(&days, &secs);
+    br_x509_minimal_set_time(c->xc, days, secs);
+
+    unsigned char seed[32];
+    montauk::getrandom(seed, sizeof(seed));
+    br_ssl_engine_set_buffer(&c->cc->eng, c->iobuf, BR_SSL_BUFSIZE_BIDI, 1);
+    br_ssl_engine_inject_entropy(&c->cc->eng, seed, sizeof(seed));
+
+    if (c->haveSession) br_ssl_engine_set_session_parameters(&c->cc->eng, &c->session);
+    if (!br_ssl_client_reset(c->cc, c->host, c->haveSession ? 1 : 0)) {
+        montauk::closesocket(fd);
+        return false;
+    }
+    c->fd = fd;
+    return true;
+}
+
+// Send one request and read its response through the parser. Returns
+// true once the whole response is in.
+bool conn_exchange(tls::HttpsConn* c, const char* req, int reqLen,
+                   ResponseParser* p, tls::AbortCheckFn abort_check) {
+    br_ssl_engine_context* eng = &c->cc->eng;
+    int reqSent = 0;
+    uint64_t deadline = montauk::get_milliseconds() + 30000;
+
+    while (p->stage != Stage::Done) {
+        if (p->stopped || p->failed) return false;
+
+        unsigned state = br_ssl_engine_current_state(eng);
+        if (state & BR_SSL_CLOSED) {
+            // A close ends a body that runs until close, and nothing else
+            if (p->stage == Stage::UntilClose && br_ssl_engine_last_error(eng) == BR_ERR_OK) break;
+            p->failed = true;
+            return false;
+        }
+        if (abort_check && abort_check()) {
+            p->aborted = true;
+            return false;
+        }
+        if (state & BR_SSL_SENDREC) {
+            size_t len; unsigned char* buf = br_ssl_engine_sendrec_buf(eng, &len);
+            if (tls::tls_send_all(c->fd, buf, len) < 0) { p->failed = true; return false; }
+            br_ssl_engine_sendrec_ack(eng, len);
+            deadline = montauk::get_milliseconds() + 30000; continue;
+        }
+        if (state & BR_SSL_RECVAPP) {
+            size_t len; unsigned char* buf = br_ssl_engine_recvapp_buf(eng, &len);
+            parser_feed(p, buf, len);
+            br_ssl_engine_recvapp_ack(eng, len);
+            deadline = montauk::get_milliseconds() + 30000; continue;
+        }
+        if ((state & BR_SSL_SENDAPP) && reqSent < reqLen) {
+            // The handshake is done: keep its session for next time
+            if (reqSent == 0) {
+                br_ssl_engine_get_session_parameters(eng, &c->session);
+                c->haveSession = true;
+            }
+            size_t len; unsigned char* buf = br_ssl_engine_sendapp_buf(eng, &len);
+            size_t toWrite = (size_t)(reqLen - reqSent);
+            if (toWrite > len) toWrite = len;
+            memcpy(buf, req + reqSent, toWrite);
+            br_ssl_engine_sendapp_ack(eng, toWrite);
+            reqSent += (int)toWrite;
+            if (reqSent == reqLen) br_ssl_engine_flush(eng, 0);
+            deadline = montauk::get_milliseconds() + 30000; continue;
+        }
+        if (state & BR_SSL_RECVREC) {
+            size_t len; unsigned char* buf = br_ssl_engine_recvrec_buf(eng, &len);
+            int got = tls::tls_recv_some(c->fd, buf, len);
+            if (got < 0) {
+                // The peer closed the socket without close_notify
+                if (p->stage == Stage::UntilClose) break;
+                p->failed = true;
+                return false;
+            }
+            br_ssl_engine_recvrec_ack(eng, got);
+            deadline = montauk::get_milliseconds() + 30000; continue;
+        }
+        if (montauk::get_milliseconds() >= deadline) { p->failed = true; return false; }
+        montauk::sleep_ms(1);
+    }
+    p->stage = Stage::Done;
+    return true;
+}
+
+struct FetchBuf {
+    char* buf;
+    int   len;
+    int   max;
+};
+
+// Collect into a fixed buffer. Reading goes on once it is full so the
+// connection stays in step for the next request.
+bool fetch_append(void* ctx, const char* data, int len) {
+    FetchBuf* f = (FetchBuf*)ctx;
+    int room = f->max - 1 - f->len;
+    if (len > room) len = room;
+    if (len > 0) {
+        memcpy(f->buf + f->len, data, len);
+        f->len += len;
+    }
+    return true;
+}
+
+} // anonymous namespace
+
+namespace tls {
+
+void HttpsClient::init(const TrustAnchors& anchors) {
+    tas = &anchors;
+    for (int i = 0; i < HTTPS_MAX_HOSTS; i++) {
+        HttpsConn* c = &conns[i];
+        c->host[0] = '\0';
+        c->port = 0;
+        c->fd = -1;
+        c->lastUsed = 0;
+        c->cc = nullptr;
+        c->xc = nullptr;
+        c->iobuf = nullptr;
+        c->haveSession = false;
+    }
+}
+
+int HttpsClient::request(const char* host, uint32_t ip, uint16_t port,
+                         const char* req, int reqLen,
+                         ResponseFn on_data, void* ctx,
+                         AbortCheckFn abort_check) {
+    if (strlen(host) >= sizeof(conns[0].host)) return -1;
+
+    // This host's slot, else a free one, else the least recently used
+    HttpsConn* c = nullptr;
+    for (int i = 0; i < HTTPS_MAX_HOSTS && !c; i++) {
+        if (conns[i].port == port && strcmp(conns[i].host, host) == 0) c = &conns[i];
+    }
+    if (!c) {
+        for (int i = 0; i < HTTPS_MAX_HOSTS; i++) {
+            HttpsConn* s = &conns[i];
+            if (!s->host[0]) { c = s; break; }
+            if (!c || s->lastUsed < c->lastUsed) c = s;
+        }
+        conn_drop(c);
+        strcpy(c->host, host);
+        c->port = port;
+        c->ip = ip;
+        c->haveSession = false;
+    }
+    if (c->ip != ip) {
+        // The name moved: neither the connection nor the session apply
+        conn_drop(c);
+        c->ip = ip;
+        c->haveSession = false;
+    }
+    if (c->fd >= 0 && montauk::get_milliseconds() - c->lastUsed >= HTTPS_IDLE_MS)
+        conn_drop(c);
+
+    static ResponseParser parser;  // keep off stack
+    bool noBody = reqLen >= 5 && memcmp(req, "HEAD ", 5) == 0;
+
+    for (int attempt = 0; attempt < 2; attempt++) {
+        bool reused = c->fd >= 0;
+        if (!reused && !conn_open(c, tas)) return -1;
+
+        parser_init(&parser, on_data, ctx, noBody);
+        bool ok = conn_exchange(c, req, reqLen, &parser, abort_check);
+        c->lastUsed = montauk::get_milliseconds();
+
+        if (!ok || !parser.keepAlive ||
+            (br_ssl_engine_current_state(&c->cc->eng) & BR_SSL_CLOSED))
+            conn_drop(c);
+        if (ok) return parser.delivered;
+
+        // A kept-alive connection the server had closed in the meantime:
+        // try once more on a fresh one
+        if (reused && parser.failed && parser.stage == Stage::Head && parser.headLen == 0)
+            continue;
+        return -1;
+    }
+    return -1;
+}
+
+int HttpsClient::fetch(const char* host, uint32_t ip, uint16_t port,
+                       const char* req, int reqLen,
+                       char* respBuf, int respMax,
+                       AbortCheckFn abort_check) {
+    if (respMax <= 0) return -1;
+    FetchBuf f = { respBuf, 0, respMax };
+    int r = request(host, ip, port, req, reqLen, fetch_append, &f, abort_check);
+    respBuf[f.len] = '\0';
+    return r < 0 ? -1 : f.len;
+}
+
+void HttpsClient::close_all() {
+    for (int i = 0; i < HTTPS_MAX_HOSTS; i++) {
+        HttpsConn* c = &conns[i];
+        conn_drop(c);
+        free(c->cc); free(c->xc); free(c->iobuf);
+        c->cc = nullptr; c->xc = nullptr; c->iobuf = nullptr;
+        c->host[0] = '\0';
+        c->haveSession = false;
+    }
+}
+
+int http_request(uint32_t ip, uint16_t port,
+                 const char* req, int reqLen,
+                 ResponseFn on_data, void* ctx,
+                 AbortCheckFn abort_check) {
+    int fd = montauk::socket(Montauk::SOCK_TCP);
+    if (fd < 0) return -1;
+    if (montauk::connect(fd, ip, port) < 0 ||
+        tls_send_all(fd, (const unsigned char*)req, reqLen) < 0) {
+        montauk::closesocket(fd);
+        return -1;
+    }
+
+    static ResponseParser parser;
+    static unsigned char buf[16384];
+    parser_init(&parser, on_data, ctx, reqLen >= 5 && memcmp(req, "HEAD ", 5) == 0);
+
+    uint64_t deadline = montauk::get_milliseconds() + 30000;
+    while (parser.stage != Stage::Done && !parser.stopped && !parser.failed) {
+        if (abort_check && abort_check()) break;
+        int r = montauk::recv(fd, buf, sizeof(buf));
+        if (r > 0) {
+            parser_feed(&parser, buf, r);
+            deadline = montauk::get_milliseconds() + 30000;
+        } else if (r < 0) {
+            // Closed: the end of a body that runs until close, else cut short
+            if (parser.stage == Stage::UntilClose) parser.stage = Stage::Done;
+            break;
+        } else {
+            if (montauk::get_milliseconds() >= deadline) break;
+            montauk::sleep_ms(1);
+        }
+    }
+    montauk::closesocket(fd);
+    return parser.stage == Stage::Done ? parser.delivered : -1;
+}
+
+} // namespace tls
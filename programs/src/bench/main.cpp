@@ -0,0 +1,509 @@
+/*
+    * main.cpp
+    * bench - Kernel and libc microbenchmarks
+    * Copyright (c) 2026 Daniel Hammer
+*/
+
+#include <montauk/syscall.h>
+#include <montauk/string.h>
+#include <montauk/args.h>
+#include <montauk/heap.h>
+#include <stdio.h>
+
+// Each test runs several passes and reports its fastest, so that runs
+// of the same build compare closely and runs of different builds can
+// be diffed line by line.
+static constexpr int Passes = 5;
+
+static const char* SelfPath = "0:/os/bench.elf";
+static const char* PingPongShm = "bench.pingpong";
+
+static uint64_t g_tscPerUs;
+static const char* g_filters[16];
+static int g_filterCount;
+
+static inline uint64_t rdtsc() {
+    uint32_t lo, hi;
+    asm volatile("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+static void print_int(uint64_t n) {
+    if (n == 0) {
+        montauk::putchar('0');
+        return;
+    }
+    char buf[20];
+    int i = 0;
+    while (n > 0) {
+        buf[i++] = '0' + (n % 10);
+        n /= 10;
+    }
+    for (int j = i - 1; j >= 0; j--) {
+        montauk::putchar(buf[j]);
+    }
+}
+
+static int digits(uint64_t n) {
+    int d = 1;
+    while (n >= 10) {
+        n /= 10;
+        d++;
+    }
+    return d;
+}
+
+static void pad(int n) {
+    for (int i = 0; i < n; i++) montauk::putchar(' ');
+}
+
+static bool wanted(const char* name) {
+    if (g_filterCount == 0) return true;
+    for (int i = 0; i < g_filterCount; i++) {
+        if (montauk::starts_with(name, g_filters[i])) return true;
+    }
+    return false;
+}
+
+// One result line: name, value with one decimal, unit
+static void report(const char* name, uint64_t tenths, const char* unit) {
+    montauk::print(name);
+    pad(28 - montauk::slen(name));
+    pad(10 - digits(tenths / 10));
+    print_int(tenths / 10);
+    montauk::putchar('.');
+    montauk::putchar('0' + tenths % 10);
+    montauk::putchar(' ');
+    montauk::print(unit);
+    montauk::putchar('\n');
+}
+
+static void report_skipped(const char* name, const char* why) {
+    montauk::print("# ");
+    montauk::print(name);
+    montauk::print(" skipped: ");
+    montauk::print(why);
+    montauk::putchar('\n');
+}
+
+// Tenths of a nanosecond per op
+static uint64_t ns_per_op(uint64_t ticks, uint64_t ops) {
+    return ticks * 10000 / (g_tscPerUs * ops);
+}
+
+// Tenths of a MB/s (bytes per microsecond)
+static uint64_t mb_per_s(uint64_t bytes, uint64_t ticks) {
+    if (ticks == 0) ticks = 1;
+    return bytes * 10 * g_tscPerUs / ticks;
+}
+
+// Fastest of `passes` timed runs of `body`, in TSC ticks
+template <typename F>
+static uint64_t best_of(int passes, F body) {
+    uint64_t best = ~0ULL;
+    for (int i = 0; i < passes; i++) {
+        uint64_t start = rdtsc();
+        body();
+        uint64_t ticks = rdtsc() - start;
+        if (ticks < best) best = ticks;
+    }
+    return best;
+}
+
+// ============================================================================
+// Child modes
+// ============================================================================
+
+struct PingPong {
+    volatile uint32_t ready;
+    volatile uint32_t turn;     // 1: the child's turn, 0: the parent's
+    volatile uint32_t stop;
+};
+
+// Hand the turn straight back each time it arrives
+static void child_pingpong() {
+    auto* pp = (PingPong*)montauk::shm_open(PingPongShm, 0x1000);
+    if (pp == nullptr) montauk::exit(1);
+    pp->ready = 1;
+    while (!pp->stop) {
+        if (pp->turn == 1) pp->turn = 0;
+        else montauk::yield();
+    }
+    montauk::exit(0);
+}
+
+// ============================================================================
+// Tests
+// ============================================================================
+
+static void bench_syscall() {
+    if (!wanted("syscall.getpid")) return;
+    constexpr int N = 20000;
+    uint64_t ticks = best_of(Passes, [] {
+        for (int i = 0; i < N; i++) montauk::getpid();
+    });
+    report("syscall.getpid", ns_per_op(ticks, N), "ns");
+}
+
+// Two processes pinned to one CPU pass a turn through shared memory,
+// yielding while they wait, so each handoff is one context switch
+static void bench_pingpong() {
+    if (!wanted("sched.pingpong")) return;
+    constexpr int N = 2000;
+
+    montauk::shm_unlink(PingPongShm);
+    auto* pp = (PingPong*)montauk::shm_open(PingPongShm, 0x1000);
+    if (pp == nullptr) {
+        report_skipped("sched.pingpong", "no shared memory");
+        return;
+    }
+    pp->ready = 0;
+    pp->turn = 0;
+    pp->stop = 0;
+
+    // The child starts out on CPU 0, where its partner runs
+    const char* argv[] = {"-child", "pingpong", nullptr};
+    Montauk::SpawnAttr attr = {};
+    attr.path = SelfPath;
+    attr.argv = argv;
+    attr.priority = Montauk::PRIO_INHERIT;
+    attr.affinity = 1;
+    int child = montauk::spawn_ex(&attr);
+    if (child < 0) {
+        report_skipped("sched.pingpong", "cannot spawn");
+        montauk::munmap(pp);
+        montauk::shm_unlink(PingPongShm);
+        return;
+    }
+
+    uint64_t affinity = montauk::get_affinity();
+    montauk::set_affinity(-1, 1);
+    uint64_t deadline = montauk::get_milliseconds() + 2000;
+    while (!pp->ready && montauk::get_milliseconds() < deadline) montauk::yield();
+    if (!pp->ready) {
+        report_skipped("sched.pingpong", "child did not start");
+        montauk::kill(child);
+        montauk::set_affinity(-1, affinity);
+        montauk::munmap(pp);
+        montauk::shm_unlink(PingPongShm);
+        return;
+    }
+
+    uint64_t ticks = best_of(Passes, [pp] {
+        for (int i = 0; i < N; i++) {
+            pp->turn = 1;
+            while (pp->turn != 0) montauk::yield();
+        }
+    });
+
+    pp->stop = 1;
+    montauk::waitpid(child);
+    montauk::set_affinity(-1, affinity);
+    montauk::munmap(pp);
+    montauk::shm_unlink(PingPongShm);
+
+    report("sched.pingpong", ns_per_op(ticks, 2 * N), "ns");
+}
+
+static void bench_spawn() {
+    if (!wanted("proc.spawn_wait")) return;
+    constexpr int N = 20;
+    bool failed = false;
+    uint64_t ticks = best_of(3, [&failed] {
+        for (int i = 0; i < N; i++) {
+            int pid = montauk::spawn(SelfPath, "-child exit");
+            if (pid < 0) {
+                failed = true;
+                return;
+            }
+            montauk::waitpid(pid);
+        }
+    });
+    if (failed) {
+        report_skipped("proc.spawn_wait", "cannot spawn");
+        return;
+    }
+    report("proc.spawn_wait", ns_per_op(ticks, N) / 1000, "us");
+}
+
+static void bench_alloc() {
+    static const struct { const char* name; uint64_t size; } sizes[] = {
+        {"mem.alloc_free_4k", 0x1000},
+        {"mem.alloc_free_64k", 0x10000},
+        {"mem.alloc_free_1m", 0x100000},
+    };
+    constexpr int N = 2000;
+    for (auto& s : sizes) {
+        if (!wanted(s.name)) continue;
+        uint64_t size = s.size;
+        uint64_t ticks = best_of(Passes, [size] {
+            for (int i = 0; i < N; i++) montauk::free(montauk::alloc(size));
+        });
+        report(s.name, ns_per_op(ticks, N), "ns");
+    }
+}
+
+// Heap pages are mapped on first touch, so the cost of a fault is the
+// time to touch fresh memory. Windows of 2 MiB that a region covers
+// whole are backed by one huge page instead.
+static void bench_faults() {
+    if (wanted("mem.fault_4k")) {
+        constexpr uint64_t Size = 0x100000;
+        constexpr uint64_t Pages = Size / 0x1000;
+        uint64_t best = ~0ULL;
+        for (int pass = 0; pass < Passes; pass++) {
+            auto* p = (volatile uint8_t*)montauk::alloc(Size);
+            if (p == nullptr) break;
+            uint64_t start = rdtsc();
+            for (uint64_t i = 0; i < Pages; i++) p[i * 0x1000] = 1;
+            uint64_t ticks = rdtsc() - start;
+            montauk::free((void*)p);
+            if (ticks < best) best = ticks;
+        }
+        if (best != ~0ULL) report("mem.fault_4k", ns_per_op(best, Pages), "ns");
+    }
+
+    if (wanted("mem.fault_2m")) {
+        constexpr uint64_t Huge = 0x200000;
+        constexpr uint64_t Size = 4 * Huge;
+        uint64_t best = ~0ULL;
+        for (int pass = 0; pass < Passes; pass++) {
+            auto* p = (uint8_t*)montauk::alloc(Size);
+            if (p == nullptr) break;
+            uint64_t first = ((uint64_t)p + Huge - 1) & ~(Huge - 1);
+            uint64_t windows = ((uint64_t)p + Size - first) / Huge;
+            uint64_t start = rdtsc();
+            for (uint64_t i = 0; i < windows; i++) *(volatile uint8_t*)(first + i * Huge) = 1;
+            uint64_t ticks = (rdtsc() - start) / windows;
+            montauk::free(p);
+            if (ticks < best) best = ticks;
+        }
+        if (best != ~0ULL) report("mem.fault_2m", ns_per_op(best, 1) / 1000, "us");
+    }
+}
+
+static void bench_bandwidth() {
+    static const struct { const char* copy; const char* fill; uint64_t size; } sizes[] = {
+        {"libc.memcpy_64",  "libc.memset_64",  64},
+        {"libc.memcpy_4k",  "libc.memset_4k",  0x1000},
+        {"libc.memcpy_64k", "libc.memset_64k", 0x10000},
+        {"libc.memcpy_1m",  "libc.memset_1m",  0x100000},
+        {"libc.memcpy_16m", "libc.memset_16m", 0x1000000},
+    };
+    constexpr uint64_t MaxSize = 0x1000000;
+    constexpr uint64_t Volume = 0x4000000;  // Bytes moved per pass
+
+    bool any = false;
+    for (auto& s : sizes) any = any || wanted(s.copy) || wanted(s.fill);
+    if (!any) return;
+
+    auto* src = (uint8_t*)montauk::alloc(MaxSize);
+    auto* dst = (uint8_t*)montauk::alloc(MaxSize);
+    if (src == nullptr || dst == nullptr) {
+        report_skipped("libc", "out of memory");
+        if (src) montauk::free(src);
+        if (dst) montauk::free(dst);
+        return;
+    }
+    // Fault everything in before timing
+    montauk::memset(src, 0x5A, MaxSize);
+    montauk::memset(dst, 0, MaxSize);
+
+    for (auto& s : sizes) {
+        uint64_t size = s.size;
+        uint64_t reps = Volume / size;
+        if (wanted(s.copy)) {
+            uint64_t ticks = best_of(Passes, [=] {
+                for (uint64_t i = 0; i < reps; i++) montauk::memcpy(dst, src, size);
+            });
+            report(s.copy, mb_per_s(size * reps, ticks), "MB/s");
+        }
+        if (wanted(s.fill)) {
+            uint64_t ticks = best_of(Passes, [=] {
+                for (uint64_t i = 0; i < reps; i++) montauk::memset(dst, (int)i, size);
+            });
+            report(s.fill, mb_per_s(size * reps, ticks), "MB/s");
+        }
+    }
+
+    montauk::free(src);
+    montauk::free(dst);
+}
+
+static void file_test_names(const char* prefix, char* openName, char* readName) {
+    snprintf(openName, 48, "%s.open_close", prefix);
+    snprintf(readName, 48, "%s.read_4k", prefix);
+}
+
+// Open/close and 4 KiB reads of one file. Reads cycle through the
+// first 64 KiB, so after the first pass they come from the cache.
+static void bench_file(const char* prefix, const char* path) {
+    char openName[48], readName[48];
+    file_test_names(prefix, openName, readName);
+
+    int h = montauk::open(path);
+    if (h < 0) {
+        report_skipped(prefix, "cannot open file");
+        return;
+    }
+    uint64_t size = montauk::getsize(h);
+    uint64_t span = size < 0x10000 ? size & ~0xFFFULL : 0x10000;
+
+    if (wanted(readName) && span > 0) {
+        auto* buf = (uint8_t*)montauk::malloc(0x1000);
+        constexpr int N = 2000;
+        uint64_t ticks = best_of(Passes, [=] {
+            for (int i = 0; i < N; i++) montauk::read(h, buf, (i * 0x1000) % span, 0x1000);
+        });
+        montauk::mfree(buf);
+        report(readName, ns_per_op(ticks, N), "ns");
+    }
+    montauk::close(h);
+
+    if (wanted(openName)) {
+        constexpr int N = 1000;
+        uint64_t ticks = best_of(Passes, [path] {
+            for (int i = 0; i < N; i++) montauk::close(montauk::open(path));
+        });
+        report(openName, ns_per_op(ticks, N), "ns");
+    }
+}
+
+static void bench_vfs() {
+    char openName[48], readName[48];
+    file_test_names("vfs.ramdisk", openName, readName);
+    if (wanted(openName) || wanted(readName)) bench_file("vfs.ramdisk", SelfPath);
+
+    // The first mounted disk drive gets a 64 KiB scratch file
+    int drives[16];
+    int count = montauk::drivelist(drives, 16);
+    int drive = -1;
+    for (int i = 0; i < count; i++) {
+        if (drives[i] != 0) {
+            drive = drives[i];
+            break;
+        }
+    }
+    char prefix[24];
+    snprintf(prefix, sizeof(prefix), "vfs.drive%d", drive);
+    if (drive < 0) {
+        if (wanted("vfs.drive")) report_skipped("vfs.drive", "no disk drive mounted");
+        return;
+    }
+    file_test_names(prefix, openName, readName);
+    if (!wanted(openName) && !wanted(readName)) return;
+
+    char path[32];
+    snprintf(path, sizeof(path), "%d:/bench.tmp", drive);
+    int h = montauk::fcreate(path);
+    if (h < 0) {
+        report_skipped(prefix, "cannot create scratch file");
+        return;
+    }
+    auto* block = (uint8_t*)montauk::malloc(0x1000);
+    montauk::memset(block, 0xA5, 0x1000);
+    bool ok = true;
+    for (uint64_t off = 0; off < 0x10000 && ok; off += 0x1000) {
+        ok = montauk::fwrite(h, block, off, 0x1000) >= 0;
+    }
+    montauk::mfree(block);
+    montauk::close(h);
+
+    if (ok) bench_file(prefix, path);
+    else report_skipped(prefix, "cannot write scratch file");
+    montauk::fdelete(path);
+}
+
+static void bench_present() {
+    bool full = wanted("win.present");
+    bool rects = wanted("win.present_rect");
+    if (!full && !rects) return;
+
+    Montauk::WinCreateResult win;
+    if (montauk::win_create("bench", 320, 240, &win) < 0 || win.id < 0) {
+        report_skipped("win", "no window server");
+        return;
+    }
+    montauk::memset32((uint32_t*)win.pixelVa, 0xFF336699, 320 * 240);
+
+    constexpr int N = 200;
+    if (full) {
+        uint64_t ticks = best_of(Passes, [&win] {
+            for (int i = 0; i < N; i++) montauk::win_present(win.id);
+        });
+        report("win.present", ns_per_op(ticks, N), "ns");
+    }
+    if (rects) {
+        Montauk::WinRect r = {16, 16, 32, 32};
+        uint64_t ticks = best_of(Passes, [&win, &r] {
+            for (int i = 0; i < N; i++) montauk::win_present_rects(win.id, &r, 1);
+        });
+        report("win.present_rect", ns_per_op(ticks, N), "ns");
+    }
+    montauk::win_destroy(win.id);
+}
+
+// Fallback for a kernel that has not calibrated the TSC
+static uint64_t calibrate_tsc() {
+    uint64_t t0 = montauk::get_milliseconds();
+    while (montauk::get_milliseconds() == t0) {}
+    uint64_t start = rdtsc();
+    uint64_t t1 = montauk::get_milliseconds();
+    while (montauk::get_milliseconds() < t1 + 100) {}
+    return (rdtsc() - start) / 100000;
+}
+
+static void usage() {
+    montauk::print("usage: bench [prefix ...]\n");
+    montauk::exit(1);
+}
+
+extern "C" void _start() {
+    static char args[512];
+    montauk::getargs(args, sizeof(args));
+
+    static char words[16][64];
+    const char* p = args;
+    while (g_filterCount < 16) {
+        p = montauk::next_word(p, words[g_filterCount], sizeof(words[0]));
+        if (words[g_filterCount][0] == '\0') break;
+        if (words[g_filterCount][0] == '-') {
+            if (montauk::streq(words[g_filterCount], "-child")) {
+                char mode[16];
+                montauk::next_word(p, mode, sizeof(mode));
+                if (montauk::streq(mode, "pingpong")) child_pingpong();
+                montauk::exit(0);
+            }
+            usage();
+        }
+        g_filters[g_filterCount] = words[g_filterCount];
+        g_filterCount++;
+    }
+
+    Montauk::SysInfo info;
+    montauk::get_info(&info);
+    g_tscPerUs = info.tscPerUs;
+    if (g_tscPerUs == 0) g_tscPerUs = calibrate_tsc();
+    if (g_tscPerUs == 0) g_tscPerUs = 1;
+
+    montauk::print("# bench ");
+    montauk::print(info.osName);
+    montauk::putchar(' ');
+    montauk::print(info.osVersion);
+    montauk::print(" api ");
+    print_int(info.apiVersion);
+    montauk::print(" tsc_mhz ");
+    print_int(g_tscPerUs);
+    montauk::putchar('\n');
+
+    bench_syscall();
+    bench_pingpong();
+    bench_spawn();
+    bench_alloc();
+    bench_faults();
+    bench_bandwidth();
+    bench_vfs();
+    bench_present();
+
+    montauk::exit(0);
+}
@@ -472,14 +472,7 @@ static int get_hover_row(int mx, int my) {
 
 extern "C" void _start() {
     // Load font
-    {
-        TrueTypeFont* f = (TrueTypeFont*)montauk::malloc(sizeof(TrueTypeFont));
-        if (f) {
-            montauk::memset(f, 0, sizeof(TrueTypeFont));
-            if (!f->init("0:/fonts/Roboto-Medium.ttf")) { montauk::mfree(f); f = nullptr; }
-        }
-        g_font = f;
-    }
+    g_font = fonts::open("0:/fonts/Roboto-Medium.ttf");
 
     // Query adapter
     refresh_adapter();
@@ -0,0 +1,128 @@
+/*
+    * main.cpp
+    * bootchart - Show where boot time went
+    * Copyright (c) 2026 Daniel Hammer
+*/
+
+#include <montauk/syscall.h>
+#include <montauk/string.h>
+
+static constexpr int BAR_WIDTH  = 40;
+static constexpr int NAME_WIDTH = 22;
+
+static Montauk::BootEvent g_events[Montauk::BOOT_MAX_EVENTS];
+
+static void print_int(uint64_t n) {
+    if (n == 0) {
+        montauk::putchar('0');
+        return;
+    }
+    char buf[20];
+    int i = 0;
+    while (n > 0) {
+        buf[i++] = '0' + (n % 10);
+        n /= 10;
+    }
+    for (int j = i - 1; j >= 0; j--) {
+        montauk::putchar(buf[j]);
+    }
+}
+
+static int digits(uint64_t n) {
+    int d = 1;
+    while (n >= 10) {
+        n /= 10;
+        d++;
+    }
+    return d;
+}
+
+static void pad(int n) {
+    for (int i = 0; i < n; i++) montauk::putchar(' ');
+}
+
+// Microseconds as right-aligned milliseconds with one decimal
+static void print_ms(uint64_t us, int width) {
+    uint64_t ms = us / 1000;
+    pad(width - digits(ms) - 2);
+    print_int(ms);
+    montauk::putchar('.');
+    print_int((us / 100) % 10);
+}
+
+// Start order; a point marker goes ahead of a phase starting with it
+static bool before(const Montauk::BootEvent& a, const Montauk::BootEvent& b) {
+    if (a.startUs != b.startUs) return a.startUs < b.startUs;
+    return a.endUs == a.startUs && b.endUs != b.startUs;
+}
+
+extern "C" void _start() {
+    int count = montauk::boot_profile(g_events, Montauk::BOOT_MAX_EVENTS);
+    if (count <= 0) {
+        montauk::print("bootchart: no boot profile recorded\n");
+        montauk::exit(1);
+    }
+
+    // Insertion sort, stable so equal starts keep recording order
+    for (int i = 1; i < count; i++) {
+        Montauk::BootEvent tmp = g_events[i];
+        int j = i - 1;
+        while (j >= 0 && before(tmp, g_events[j])) {
+            g_events[j + 1] = g_events[j];
+            j--;
+        }
+        g_events[j + 1] = tmp;
+    }
+
+    uint64_t first = g_events[0].startUs;
+    uint64_t last = first;
+    for (int i = 0; i < count; i++) {
+        if (g_events[i].startUs > last) last = g_events[i].startUs;
+        if (g_events[i].endUs > last) last = g_events[i].endUs;
+    }
+    uint64_t span = (last > first) ? last - first : 1;
+
+    montauk::print("Boot timeline (ms since power on)\n\n");
+    montauk::print("     start  duration  cpu  phase\n");
+
+    for (int i = 0; i < count; i++) {
+        const Montauk::BootEvent& ev = g_events[i];
+        bool point = ev.endUs == ev.startUs;
+        bool running = ev.endUs == 0;
+
+        print_ms(ev.startUs, 10);
+        if (point) {
+            montauk::print("         -");
+        } else if (running) {
+            montauk::print("   running");
+        } else {
+            print_ms(ev.endUs - ev.startUs, 10);
+        }
+        pad(5 - digits(ev.cpu));
+        print_int(ev.cpu);
+        montauk::print("  ");
+
+        int len = montauk::slen(ev.name);
+        montauk::print(ev.name);
+        pad(NAME_WIDTH - len);
+
+        // Where the phase sits between the first and last event
+        uint64_t end = running ? last : ev.endUs;
+        int from = (int)((ev.startUs - first) * BAR_WIDTH / span);
+        int to = (int)((end - first) * BAR_WIDTH / span);
+        if (to >= BAR_WIDTH) to = BAR_WIDTH - 1;
+        if (from > to) from = to;
+
+        montauk::print(" |");
+        for (int c = 0; c < BAR_WIDTH; c++) {
+            if (c < from || c > to) montauk::putchar(' ');
+            else montauk::putchar(point ? '|' : '#');
+        }
+        montauk::print("|\n");
+    }
+
+    montauk::print("\nKernel to last event: ");
+    print_ms(last - first, 0);
+    montauk::print(" ms\n");
+    montauk::exit(0);
+}
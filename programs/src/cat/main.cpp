@@ -12,9 +12,20 @@ extern "C" void _start() {
     int len = montauk::getargs(args, sizeof(args));
     const char* path = montauk::skip_spaces(args);
 
+    // With no file, copy stdin through when it is a pipe
     if (len <= 0 || *path == '\0') {
-        montauk::print("Usage: cat <filename>\n");
-        montauk::exit(1);
+        char buf[512];
+        int n = montauk::pipe_read(Montauk::PIPE_STDIN, buf, sizeof(buf) - 1);
+        if (n < 0) {
+            montauk::print("Usage: cat <filename>\n");
+            montauk::exit(1);
+        }
+        while (n > 0) {
+            buf[n] = '\0';
+            montauk::print(buf);
+            n = montauk::pipe_read(Montauk::PIPE_STDIN, buf, sizeof(buf) - 1);
+        }
+        montauk::exit(0);
     }
 
     int handle = montauk::open(path);
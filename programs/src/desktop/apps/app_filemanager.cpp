@@ -5,7 +5,9 @@
 */
 
 #include "apps_common.hpp"
+#include "../wallpaper.hpp"
 #include <montauk/toml.h>
+#include <montauk/copy.h>
 
 // ============================================================================
 // File Manager state
@@ -13,25 +15,38 @@
 
 static constexpr int FM_MAX_DRIVES = 16;
 
+// One entry of the current view. Its name lives in the state's name pool,
+// which like the entry array grows with the directory being read.
+struct FmEntry {
+    uint32_t name;         // offset into FileManagerState::names
+    int type;              // 0=file, 1=dir, 2=exec, 3=drive, 4=home, 5=apps, 6=app, 7=special_dir
+    bool is_dir;
+    int drive;             // Computer view: drive number, or special folder index
+    uint64_t size;
+    int64_t mtime;
+    SvgIcon thumb;         // grid view thumbnail of an image file
+    uint8_t thumb_state;   // THUMB_*
+};
+
 struct FileManagerState {
     char current_path[256];
     char history[16][256];
     int history_pos;
     int history_count;
-    char entry_names[64][64];
-    int entry_types[64];   // 0=file, 1=dir, 2=exec, 3=drive, 4=home, 5=apps, 6=app, 7=special_dir
-    int entry_sizes[64];
+    FmEntry* entries;
     int entry_count;
+    int entry_cap;
+    char* names;
+    uint32_t names_used;
+    uint32_t names_cap;
     int selected;
-    int scroll_offset;
-    bool is_dir[64];
     int last_click_item;
     uint64_t last_click_time;
     Scrollbar scrollbar;
+    VirtualList list;          // the entries, as rows or as a grid
     DesktopState* desktop;
     bool grid_view;
     bool at_drives_root;
-    int drive_indices[FM_MAX_DRIVES]; // which drive number each entry maps to
 
     // Clipboard
     char clipboard_path[256];
@@ -49,7 +64,7 @@ struct FileManagerState {
     // Rename
     bool rename_active;
     int rename_idx;
-    char rename_buf[64];
+    char rename_buf[256];
     int rename_cursor;
     int rename_len;
 
@@ -65,6 +80,10 @@ struct FileManagerState {
     SvgIcon app_icons_lg[16];  // 48x48 icons for grid view
     SvgIcon app_icons_sm[16];  // 16x16 icons for list view
     int app_icon_count;
+
+    // Thumbnails for image files in the grid view (FmEntry::thumb)
+    int thumbs_pending;        // queued with the worker, not yet collected
+    bool thumbs_deferred;      // a request found the queue full
 };
 
 static constexpr int FM_TOOLBAR_H = 32;
@@ -77,6 +96,42 @@ static constexpr int FM_GRID_CELL_H = 80;
 static constexpr int FM_GRID_ICON   = 48;
 static constexpr int FM_GRID_PAD    = 4;
 
+static const char* fm_name(const FileManagerState* fm, int i) {
+    return fm->names + fm->entries[i].name;
+}
+
+// Append an entry called `name`, zeroed otherwise; nullptr if out of memory
+static FmEntry* fm_add_entry(FileManagerState* fm, const char* name) {
+    if (fm->entry_count == fm->entry_cap) {
+        int cap = fm->entry_cap ? fm->entry_cap * 2 : 64;
+        FmEntry* grown = (FmEntry*)montauk::realloc(fm->entries, sizeof(FmEntry) * cap);
+        if (!grown) return nullptr;
+        fm->entries = grown;
+        fm->entry_cap = cap;
+    }
+    uint32_t len = (uint32_t)montauk::slen(name) + 1;
+    if (fm->names_used + len > fm->names_cap) {
+        uint32_t cap = fm->names_cap ? fm->names_cap : 4096;
+        while (cap < fm->names_used + len) cap *= 2;
+        char* grown = (char*)montauk::realloc(fm->names, cap);
+        if (!grown) return nullptr;
+        fm->names = grown;
+        fm->names_cap = cap;
+    }
+
+    FmEntry* e = &fm->entries[fm->entry_count++];
+    montauk::memset(e, 0, sizeof(*e));
+    e->name = fm->names_used;
+    montauk::memcpy(fm->names + fm->names_used, name, len);
+    fm->names_used += len;
+    return e;
+}
+
+static void fm_clear_entries(FileManagerState* fm) {
+    fm->entry_count = 0;
+    fm->names_used = 0;
+}
+
 // Special user folders: name, icon filename, index into DesktopState arrays
 static constexpr int SF_COUNT = 6;
 static const char* sf_names[SF_COUNT] = {
@@ -193,41 +248,371 @@ static const char* path_basename(const char* path) {
     return last;
 }
 
+// ============================================================================
+// Thumbnails
+// ============================================================================
+
+// Image files in the grid view show a thumbnail instead of the generic file
+// icon. Decoding a photo takes far longer than a frame, so it happens on a
+// worker thread: drawing the grid queues the images it shows, the worker
+// reads, decodes and shrinks them one at a time, and the window collects
+// finished thumbnails from its poll callback. Each one is also saved under
+// <home>/.thumbnails, keyed by the file's path, size and mtime, so a folder
+// seen before costs one small read per image.
+//
+// The worker touches nothing but its job and the libc heap stb_image uses
+// (behind stbi_lock); it never calls montauk::malloc, which is not
+// thread-safe.
+static constexpr int FM_THUMB_SLOTS = 64;
+static constexpr uint64_t FM_THUMB_MAX_FILE = 16 * 1024 * 1024;
+static constexpr uint32_t FM_THUMB_MAGIC = 0x4D4E4854; // "THNM"
+
+static constexpr uint8_t THUMB_NONE    = 0;
+static constexpr uint8_t THUMB_PENDING = 1;
+static constexpr uint8_t THUMB_READY   = 2;
+static constexpr uint8_t THUMB_FAILED  = 3;
+
+static constexpr int JOB_FREE   = 0;
+static constexpr int JOB_QUEUED = 1;
+static constexpr int JOB_BUSY   = 2;   // the worker owns the job's fields
+static constexpr int JOB_DONE   = 3;
+
+struct ThumbJob {
+    int state;                  // JOB_*
+    uint64_t seq;               // queue order
+    FileManagerState* owner;    // nullptr once nobody wants the result
+    int index;                  // entry index in the owner
+    char path[256];
+    uint64_t size;
+    int64_t mtime;
+    bool ok;
+    int w, h;
+    uint32_t pixels[FM_GRID_ICON * FM_GRID_ICON];
+};
+
+struct ThumbCacheHeader {
+    uint32_t magic;
+    uint16_t w, h;
+    uint64_t size;
+    int64_t mtime;
+    uint64_t path_hash;
+};
+
+// Shared by every file manager window. `lock` protects the job states
+// and everything in a job that is not JOB_BUSY.
+struct ThumbService {
+    montauk::Mutex lock;
+    montauk::CondVar work;
+    ThumbJob* jobs;             // FM_THUMB_SLOTS, allocated on first use
+    uint64_t next_seq;
+    bool running;
+    bool failed;                // no worker: stop asking
+    char cache_dir[160];
+};
+
+static ThumbService thumb_service;
+
+static uint64_t thumb_hash(const char* s) {
+    uint64_t h = 0xCBF29CE484222325ull;
+    for (; *s; s++) {
+        h ^= (uint8_t)*s;
+        h *= 0x100000001B3ull;
+    }
+    return h;
+}
+
+static bool thumb_cache_read(ThumbJob* job, const char* cache_path, uint64_t hash) {
+    int fd = montauk::open(cache_path);
+    if (fd < 0) return false;
+
+    ThumbCacheHeader hdr;
+    bool ok = montauk::read(fd, (uint8_t*)&hdr, 0, sizeof(hdr)) == (int)sizeof(hdr)
+        && hdr.magic == FM_THUMB_MAGIC && hdr.path_hash == hash
+        && hdr.size == job->size && hdr.mtime == job->mtime
+        && hdr.w >= 1 && hdr.w <= FM_GRID_ICON && hdr.h >= 1 && hdr.h <= FM_GRID_ICON;
+    if (ok) {
+        int bytes = hdr.w * hdr.h * 4;
+        ok = montauk::read(fd, (uint8_t*)job->pixels, sizeof(hdr), bytes) == bytes;
+        job->w = hdr.w;
+        job->h = hdr.h;
+    }
+    montauk::close(fd);
+    return ok;
+}
+
+static void thumb_cache_write(const ThumbJob* job, const char* cache_path, uint64_t hash) {
+    ThumbCacheHeader hdr;
+    hdr.magic = FM_THUMB_MAGIC;
+    hdr.w = (uint16_t)job->w;
+    hdr.h = (uint16_t)job->h;
+    hdr.size = job->size;
+    hdr.mtime = job->mtime;
+    hdr.path_hash = hash;
+
+    montauk::fdelete(cache_path);
+    int fd = montauk::fcreate(cache_path);
+    if (fd < 0) return;
+    montauk::fwrite(fd, (const uint8_t*)&hdr, 0, sizeof(hdr));
+    montauk::fwrite(fd, (const uint8_t*)job->pixels, sizeof(hdr), job->w * job->h * 4);
+    montauk::close(fd);
+}
+
+// Shrink a decoded ARGB image to fit the icon box, keeping its aspect
+// ratio, by averaging every source pixel that lands in each thumbnail
+// pixel. Decoding at a reduced scale has usually left less than twice
+// the box to shrink.
+static void thumb_downscale(const uint32_t* argb, int sw, int sh, ThumbJob* job) {
+    int dw = FM_GRID_ICON, dh = FM_GRID_ICON;
+    if (sw >= sh) dh = gui_max(1, (int)((int64_t)sh * FM_GRID_ICON / sw));
+    else dw = gui_max(1, (int)((int64_t)sw * FM_GRID_ICON / sh));
+    if (dw > sw) dw = sw;
+    if (dh > sh) dh = sh;
+
+    for (int y = 0; y < dh; y++) {
+        int y0 = (int)((int64_t)y * sh / dh);
+        int y1 = (int)((int64_t)(y + 1) * sh / dh);
+        for (int x = 0; x < dw; x++) {
+            int x0 = (int)((int64_t)x * sw / dw);
+            int x1 = (int)((int64_t)(x + 1) * sw / dw);
+            uint32_t r = 0, g = 0, b = 0;
+            for (int sy = y0; sy < y1; sy++) {
+                const uint32_t* p = argb + (int64_t)sy * sw + x0;
+                for (int sx = x0; sx < x1; sx++, p++) {
+                    r += (*p >> 16) & 0xFF;
+                    g += (*p >> 8) & 0xFF;
+                    b += *p & 0xFF;
+                }
+            }
+            uint32_t n = (uint32_t)((y1 - y0) * (x1 - x0));
+            job->pixels[y * dw + x] = 0xFF000000u | ((r / n) << 16) | ((g / n) << 8) | (b / n);
+        }
+    }
+    job->w = dw;
+    job->h = dh;
+}
+
+// Fill in a busy job's thumbnail, from the cache or the image itself
+static bool thumb_generate(ThumbJob* job) {
+    uint64_t hash = thumb_hash(job->path);
+    char cache_path[256];
+    snprintf(cache_path, sizeof(cache_path), "%s/%08x%08x-%d", thumb_service.cache_dir,
+             (unsigned)(hash >> 32), (unsigned)hash, FM_GRID_ICON);
+    if (thumb_cache_read(job, cache_path, hash)) return true;
+
+    if (job->size == 0 || job->size > FM_THUMB_MAX_FILE) return false;
+    int fd = montauk::open(job->path);
+    if (fd < 0) return false;
+    uint8_t* data = (uint8_t*)montauk::alloc(job->size);
+    int bytes_read = data ? montauk::read(fd, data, 0, job->size) : -1;
+    montauk::close(fd);
+    if (bytes_read <= 0) {
+        if (data) montauk::free(data);
+        return false;
+    }
+
+    // Decode at the smallest of 1/1 .. 1/8 scale that keeps the long side
+    // at least as big as the box; the reduced IDCT does most of the shrinking
+    int img_w, img_h, channels;
+    uint32_t* argb = nullptr;
+    stbi_lock.lock();
+    if (stbi_info_from_memory(data, bytes_read, &img_w, &img_h, &channels)) {
+        int longest = img_w > img_h ? img_w : img_h;
+        int shift = 0;
+        while (shift < 3 && (longest >> (shift + 1)) >= FM_GRID_ICON) shift++;
+        argb = (uint32_t*)stbi_load_jpeg_argb_from_memory(data, bytes_read, shift, 0, 0, 0, 0,
+                                                          nullptr, nullptr, &img_w, &img_h);
+    }
+    stbi_lock.unlock();
+    montauk::free(data);
+    if (!argb) return false;
+
+    thumb_downscale(argb, img_w, img_h, job);
+    stbi_lock.lock();
+    stbi_image_free(argb);
+    stbi_lock.unlock();
+
+    thumb_cache_write(job, cache_path, hash);
+    return true;
+}
+
+// Worker thread: runs the oldest queued job, forever
+static int thumb_worker(void*) {
+    ThumbService& ts = thumb_service;
+    ts.lock.lock();
+    for (;;) {
+        ThumbJob* job = nullptr;
+        for (int i = 0; i < FM_THUMB_SLOTS; i++) {
+            ThumbJob* j = &ts.jobs[i];
+            if (j->state == JOB_QUEUED && (!job || j->seq < job->seq)) job = j;
+        }
+        if (!job) {
+            ts.work.wait(ts.lock);
+            continue;
+        }
+
+        job->state = JOB_BUSY;
+        ts.lock.unlock();
+        bool ok = thumb_generate(job);
+        ts.lock.lock();
+        job->ok = ok;
+        job->state = job->owner ? JOB_DONE : JOB_FREE;
+    }
+    return 0;
+}
+
+static bool thumb_service_start(DesktopState* ds) {
+    ThumbService& ts = thumb_service;
+    if (ts.running) return true;
+    if (ts.failed) return false;
+    if (!ds || ds->home_dir[0] == '\0') {
+        ts.failed = true;
+        return false;
+    }
+
+    ts.jobs = (ThumbJob*)montauk::alloc(sizeof(ThumbJob) * FM_THUMB_SLOTS);
+    if (!ts.jobs) {
+        ts.failed = true;
+        return false;
+    }
+    montauk::memset(ts.jobs, 0, sizeof(ThumbJob) * FM_THUMB_SLOTS);
+    snprintf(ts.cache_dir, sizeof(ts.cache_dir), "%s/.thumbnails", ds->home_dir);
+    montauk::fmkdir(ts.cache_dir);
+
+    if (montauk::thread_create(thumb_worker) < 0) {
+        montauk::free(ts.jobs);
+        ts.jobs = nullptr;
+        ts.failed = true;
+        return false;
+    }
+    ts.running = true;
+    return true;
+}
+
+// Queue entry `i` of the current directory for a thumbnail
+static void thumb_request(FileManagerState* fm, int i) {
+    if (!thumb_service_start(fm->desktop)) {
+        fm->entries[i].thumb_state = THUMB_FAILED;
+        return;
+    }
+
+    ThumbService& ts = thumb_service;
+    montauk::LockGuard guard(ts.lock);
+    for (int s = 0; s < FM_THUMB_SLOTS; s++) {
+        ThumbJob* job = &ts.jobs[s];
+        if (job->state != JOB_FREE) continue;
+        job->owner = fm;
+        job->index = i;
+        filemanager_build_fullpath(job->path, sizeof(job->path), fm->current_path, fm_name(fm, i));
+        job->size = (uint64_t)fm->entries[i].size;
+        job->mtime = fm->entries[i].mtime;
+        job->seq = ts.next_seq++;
+        job->state = JOB_QUEUED;
+        fm->entries[i].thumb_state = THUMB_PENDING;
+        fm->thumbs_pending++;
+        ts.work.signal();
+        return;
+    }
+    fm->thumbs_deferred = true;
+}
+
+// Take the finished thumbnails of `fm`; returns whether there were any
+static bool thumb_collect(FileManagerState* fm) {
+    ThumbService& ts = thumb_service;
+    if (!ts.jobs || fm->thumbs_pending == 0) return false;
+
+    bool any = false;
+    montauk::LockGuard guard(ts.lock);
+    for (int s = 0; s < FM_THUMB_SLOTS; s++) {
+        ThumbJob* job = &ts.jobs[s];
+        if (job->owner != fm || job->state != JOB_DONE) continue;
+
+        int i = job->index;
+        fm->entries[i].thumb_state = THUMB_FAILED;
+        if (job->ok) {
+            uint32_t* px = (uint32_t*)montauk::malloc(job->w * job->h * 4);
+            if (px) {
+                montauk::memcpy(px, job->pixels, job->w * job->h * 4);
+                fm->entries[i].thumb.pixels = px;
+                fm->entries[i].thumb.width = job->w;
+                fm->entries[i].thumb.height = job->h;
+                fm->entries[i].thumb_state = THUMB_READY;
+            }
+        }
+        job->owner = nullptr;
+        job->state = JOB_FREE;
+        fm->thumbs_pending--;
+        any = true;
+    }
+    return any;
+}
+
+// Drop every thumbnail of `fm` and its outstanding requests; called
+// whenever its entries change
+static void thumb_cancel(FileManagerState* fm) {
+    ThumbService& ts = thumb_service;
+    if (ts.jobs && fm->thumbs_pending > 0) {
+        montauk::LockGuard guard(ts.lock);
+        for (int s = 0; s < FM_THUMB_SLOTS; s++) {
+            ThumbJob* job = &ts.jobs[s];
+            if (job->owner != fm) continue;
+            job->owner = nullptr;
+            if (job->state != JOB_BUSY) job->state = JOB_FREE;
+        }
+    }
+    for (int i = 0; i < fm->entry_count; i++) {
+        if (fm->entries[i].thumb.pixels) montauk::mfree(fm->entries[i].thumb.pixels);
+        fm->entries[i].thumb.pixels = nullptr;
+        fm->entries[i].thumb_state = THUMB_NONE;
+    }
+    fm->thumbs_pending = 0;
+    fm->thumbs_deferred = false;
+}
+
+// Poll callback while thumbnails are outstanding
+static void filemanager_on_poll(Window* win) {
+    FileManagerState* fm = (FileManagerState*)win->app_data;
+    if (!fm) {
+        win->on_poll = nullptr;
+        return;
+    }
+    bool retry = fm->thumbs_deferred && fm->thumbs_pending == 0;
+    if (thumb_collect(fm) || retry) {
+        fm->thumbs_deferred = false;
+        win->dirty = true;
+    }
+    if (fm->thumbs_pending == 0 && !fm->thumbs_deferred) win->on_poll = nullptr;
+}
+
 // ============================================================================
 // Directory reading with sorting and file sizes
 // ============================================================================
 
 static void filemanager_read_drives(FileManagerState* fm) {
-    fm->entry_count = 0;
+    thumb_cancel(fm);
+    fm_clear_entries(fm);
     fm->at_drives_root = true;
     fm->current_path[0] = '\0';
 
     // Home folder entry (if we have a valid home directory)
     DesktopState* ds = fm->desktop;
     if (ds && ds->home_dir[0] != '\0') {
-        int i = fm->entry_count;
-        montauk::strncpy(fm->entry_names[i], "Home", 63);
-        fm->entry_types[i] = 4; // home
-        fm->entry_sizes[i] = 0;
-        fm->is_dir[i] = true;
-        fm->drive_indices[i] = -1;
-        fm->entry_count++;
+        if (FmEntry* e = fm_add_entry(fm, "Home")) {
+            e->type = 4; // home
+            e->is_dir = true;
+            e->drive = -1;
+        }
     }
 
     // Apps entry
-    {
-        int i = fm->entry_count;
-        montauk::strncpy(fm->entry_names[i], "Apps", 63);
-        fm->entry_types[i] = 5; // apps
-        fm->entry_sizes[i] = 0;
-        fm->is_dir[i] = true;
-        fm->drive_indices[i] = -1;
-        fm->entry_count++;
+    if (FmEntry* e = fm_add_entry(fm, "Apps")) {
+        e->type = 5; // apps
+        e->is_dir = true;
+        e->drive = -1;
     }
 
     // Special user folders (Documents, Desktop, Music, etc.) - only if they exist
     if (ds && ds->home_dir[0] != '\0') {
-        for (int sf = 0; sf < SF_COUNT && fm->entry_count < 64; sf++) {
+        for (int sf = 0; sf < SF_COUNT; sf++) {
             char probe_path[256];
             montauk::strcpy(probe_path, ds->home_dir);
             int plen = montauk::slen(probe_path);
@@ -239,13 +624,11 @@ static void filemanager_read_drives(FileManagerState* fm) {
             int probe_fd = montauk::open(probe_path);
             if (probe_fd >= 0) {
                 montauk::close(probe_fd);
-                int i = fm->entry_count;
-                montauk::strncpy(fm->entry_names[i], sf_names[sf], 63);
-                fm->entry_types[i] = 7; // special_dir
-                fm->entry_sizes[i] = 0;
-                fm->is_dir[i] = true;
-                fm->drive_indices[i] = sf; // special folder index
-                fm->entry_count++;
+                if (FmEntry* e = fm_add_entry(fm, sf_names[sf])) {
+                    e->type = 7; // special_dir
+                    e->is_dir = true;
+                    e->drive = sf; // special folder index
+                }
             }
         }
     }
@@ -256,7 +639,6 @@ static void filemanager_read_drives(FileManagerState* fm) {
 
     for (int di = 0; di < driveCount; di++) {
         int d = drives[di];
-        int i = fm->entry_count;
         char probe[8];
         if (d < 10) {
             probe[0] = '0' + d;
@@ -273,127 +655,81 @@ static void filemanager_read_drives(FileManagerState* fm) {
         char label[64];
         montauk::strcpy(label, "Drive ");
         str_append(label, probe, 64);
-        montauk::strncpy(fm->entry_names[i], label, 63);
-        fm->entry_types[i] = 3; // drive
-        fm->entry_sizes[i] = 0;
-        fm->is_dir[i] = true;
-        fm->drive_indices[i] = d;
-        fm->entry_count++;
-        if (fm->entry_count >= 64) break;
+        if (FmEntry* e = fm_add_entry(fm, label)) {
+            e->type = 3; // drive
+            e->is_dir = true;
+            e->drive = d;
+        }
     }
 
     fm->selected = -1;
-    fm->scroll_offset = 0;
     fm->scrollbar.scroll_offset = 0;
     fm->last_click_item = -1;
     fm->last_click_time = 0;
 }
 
+// Directories first, then alphabetical (case-insensitive)
+static bool fm_entry_before(const FileManagerState* fm, const FmEntry& a, const FmEntry& b) {
+    if (a.is_dir != b.is_dir) return a.is_dir;
+    return str_compare_ci(fm->names + a.name, fm->names + b.name) < 0;
+}
+
+// Stable bottom-up merge sort of the entries; falls back to leaving them
+// in directory order if there is no memory for the scratch array
+static void fm_sort_entries(FileManagerState* fm) {
+    int n = fm->entry_count;
+    if (n < 2) return;
+    FmEntry* tmp = (FmEntry*)montauk::malloc(sizeof(FmEntry) * n);
+    if (!tmp) return;
+
+    FmEntry* src = fm->entries;
+    FmEntry* dst = tmp;
+    for (int width = 1; width < n; width *= 2) {
+        for (int lo = 0; lo < n; lo += 2 * width) {
+            int mid = gui_min(lo + width, n);
+            int hi = gui_min(lo + 2 * width, n);
+            int i = lo, j = mid, k = lo;
+            while (i < mid && j < hi)
+                dst[k++] = fm_entry_before(fm, src[j], src[i]) ? src[j++] : src[i++];
+            while (i < mid) dst[k++] = src[i++];
+            while (j < hi) dst[k++] = src[j++];
+        }
+        FmEntry* t = src;
+        src = dst;
+        dst = t;
+    }
+    if (src != fm->entries) montauk::memcpy(fm->entries, src, sizeof(FmEntry) * n);
+    montauk::mfree(tmp);
+}
+
 static void filemanager_read_dir(FileManagerState* fm) {
+    thumb_cancel(fm);
     fm->at_drives_root = false;
     if (fm->at_apps_view) {
         fm->at_apps_view = false;
         filemanager_free_app_icons(fm);
     }
-    const char* names[64];
-    fm->entry_count = montauk::readdir(fm->current_path, names, 64);
-    if (fm->entry_count < 0) fm->entry_count = 0;
-
-    // readdir returns full paths from the VFS (e.g. "man/fetch.1" instead
-    // of just "fetch.1").  Compute the prefix to strip so we get basenames.
-    const char* after_drive = fm->current_path;
-    for (int k = 0; after_drive[k]; k++) {
-        if (after_drive[k] == ':' && after_drive[k + 1] == '/') {
-            after_drive += k + 2;
-            break;
-        }
-    }
-    char prefix[256] = {0};
-    int prefix_len = 0;
-    if (after_drive[0] != '\0') {
-        montauk::strcpy(prefix, after_drive);
-        prefix_len = montauk::slen(prefix);
-        if (prefix_len > 0 && prefix[prefix_len - 1] != '/') {
-            prefix[prefix_len++] = '/';
-            prefix[prefix_len] = '\0';
-        }
-    }
-
-    for (int i = 0; i < fm->entry_count; i++) {
-        const char* raw = names[i];
-        // Strip directory prefix if it matches
-        if (prefix_len > 0) {
-            bool match = true;
-            for (int k = 0; k < prefix_len; k++) {
-                if (raw[k] != prefix[k]) { match = false; break; }
-            }
-            if (match) raw += prefix_len;
-        }
-        montauk::strncpy(fm->entry_names[i], raw, 63);
-        int len = montauk::slen(fm->entry_names[i]);
-
-        // Detect directory
-        if (len > 0 && fm->entry_names[i][len - 1] == '/') {
-            fm->is_dir[i] = true;
-            fm->entry_names[i][len - 1] = '\0';
-        } else {
-            fm->is_dir[i] = false;
-        }
-
-        fm->entry_types[i] = detect_file_type(fm->entry_names[i], fm->is_dir[i]);
-
-        // Get file size
-        fm->entry_sizes[i] = 0;
-        if (!fm->is_dir[i]) {
-            char fullpath[512];
-            montauk::strcpy(fullpath, fm->current_path);
-            int plen = montauk::slen(fullpath);
-            if (plen > 0 && fullpath[plen - 1] != '/') {
-                str_append(fullpath, "/", 512);
-            }
-            str_append(fullpath, fm->entry_names[i], 512);
-            int fd = montauk::open(fullpath);
-            if (fd >= 0) {
-                fm->entry_sizes[i] = (int)montauk::getsize(fd);
-                montauk::close(fd);
-            }
-        }
-    }
-
-    // Sort: directories first, then alphabetical (case-insensitive)
-    for (int i = 1; i < fm->entry_count; i++) {
-        char tmp_name[64];
-        int tmp_type = fm->entry_types[i];
-        int tmp_size = fm->entry_sizes[i];
-        bool tmp_isdir = fm->is_dir[i];
-        montauk::strcpy(tmp_name, fm->entry_names[i]);
-
-        int j = i - 1;
-        while (j >= 0) {
-            bool swap = false;
-            if (tmp_isdir && !fm->is_dir[j]) {
-                swap = true;
-            } else if (tmp_isdir == fm->is_dir[j]) {
-                if (str_compare_ci(tmp_name, fm->entry_names[j]) < 0) {
-                    swap = true;
-                }
-            }
-            if (!swap) break;
-
-            montauk::strcpy(fm->entry_names[j + 1], fm->entry_names[j]);
-            fm->entry_types[j + 1] = fm->entry_types[j];
-            fm->entry_sizes[j + 1] = fm->entry_sizes[j];
-            fm->is_dir[j + 1] = fm->is_dir[j];
-            j--;
+    // One batched call per 16 entries returns the names, types and sizes;
+    // the cursor walks the whole directory, however large
+    Montauk::DirEntryInfo batch[16];
+    uint64_t cursor = 0;
+    fm_clear_entries(fm);
+    for (;;) {
+        int n = montauk::readdir_stat(fm->current_path, &cursor, batch, 16);
+        if (n <= 0) break;
+
+        for (int k = 0; k < n; k++) {
+            FmEntry* e = fm_add_entry(fm, batch[k].name);
+            if (!e) break;
+            e->is_dir = batch[k].type == Montauk::DT_DIR;
+            e->type = detect_file_type(batch[k].name, e->is_dir);
+            e->size = e->is_dir ? 0 : batch[k].size;
+            e->mtime = batch[k].mtime;
         }
-        montauk::strcpy(fm->entry_names[j + 1], tmp_name);
-        fm->entry_types[j + 1] = tmp_type;
-        fm->entry_sizes[j + 1] = tmp_size;
-        fm->is_dir[j + 1] = tmp_isdir;
     }
+    fm_sort_entries(fm);
 
     fm->selected = -1;
-    fm->scroll_offset = 0;
     fm->scrollbar.scroll_offset = 0;
     fm->last_click_item = -1;
     fm->last_click_time = 0;
@@ -419,10 +755,11 @@ static void filemanager_free_app_icons(FileManagerState* fm) {
 
 static void filemanager_read_apps(FileManagerState* fm) {
     filemanager_free_app_icons(fm);
+    thumb_cancel(fm);
 
     fm->at_drives_root = false;
     fm->at_apps_view = true;
-    fm->entry_count = 0;
+    fm_clear_entries(fm);
 
     DesktopState* ds = fm->desktop;
     if (!ds) return;
@@ -466,12 +803,14 @@ static void filemanager_read_apps(FileManagerState* fm) {
         const char* icon_file = doc.get_string("app.icon", "");
 
         int idx = fm->entry_count;
-        montauk::strncpy(fm->entry_names[idx], name, 63);
-        fm->entry_types[idx] = 6; // app entry
-        fm->entry_sizes[idx] = 0;
-        fm->is_dir[idx] = false;
+        FmEntry* e = fm_add_entry(fm, name);
+        if (!e) {
+            doc.destroy();
+            break;
+        }
+        e->type = 6; // app entry
 
-        // Store binary path in drive_indices as an app_map index
+        // Map the entry to its external_app, if any
         fm->app_map[idx] = -1;
         // Find matching external_app by binary path
         char bin_path[128];
@@ -495,12 +834,10 @@ static void filemanager_read_apps(FileManagerState* fm) {
         }
 
         doc.destroy();
-        fm->entry_count++;
         fm->app_icon_count = fm->entry_count;
     }
 
     fm->selected = -1;
-    fm->scroll_offset = 0;
     fm->scrollbar.scroll_offset = 0;
     fm->last_click_item = -1;
     fm->last_click_time = 0;
@@ -514,52 +851,23 @@ static bool filemanager_delete_recursive(const char* path) {
     // Try deleting as a file (or empty directory) first
     if (montauk::fdelete(path) == 0) return true;
 
-    // If that failed, it may be a non-empty directory -- enumerate and delete children
-    const char* names[64];
-    int count = montauk::readdir(path, names, 64);
-    if (count < 0) return false;
-
-    // Compute the prefix to strip (readdir returns paths relative to drive root)
-    const char* after_drive = path;
-    for (int k = 0; after_drive[k]; k++) {
-        if (after_drive[k] == ':' && after_drive[k + 1] == '/') {
-            after_drive += k + 2;
-            break;
-        }
-    }
-    char prefix[256] = {0};
-    int prefix_len = 0;
-    if (after_drive[0] != '\0') {
-        montauk::strcpy(prefix, after_drive);
-        prefix_len = montauk::slen(prefix);
-        if (prefix_len > 0 && prefix[prefix_len - 1] != '/') {
-            prefix[prefix_len++] = '/';
-            prefix[prefix_len] = '\0';
-        }
-    }
-
-    for (int i = 0; i < count; i++) {
-        const char* raw = names[i];
-        if (prefix_len > 0) {
-            bool match = true;
-            for (int k = 0; k < prefix_len; k++) {
-                if (raw[k] != prefix[k]) { match = false; break; }
+    // If that failed, it may be a non-empty directory -- enumerate and
+    // delete children. Deleting moves later entries under the cursor, so
+    // walk again from the start until a pass finds nothing it can delete.
+    Montauk::DirEntryInfo batch[16];
+    for (;;) {
+        uint64_t cursor = 0;
+        int deleted = 0;
+        int n;
+        while ((n = montauk::readdir_stat(path, &cursor, batch, 16)) > 0) {
+            for (int i = 0; i < n; i++) {
+                char child[512];
+                filemanager_build_fullpath(child, 512, path, batch[i].name);
+                if (filemanager_delete_recursive(child)) deleted++;
             }
-            if (match) raw += prefix_len;
         }
-
-        char child[512];
-        montauk::strcpy(child, path);
-        int plen = montauk::slen(child);
-        if (plen > 0 && child[plen - 1] != '/')
-            str_append(child, "/", 512);
-        str_append(child, raw, 512);
-
-        // Strip trailing slash if present (directory marker)
-        int clen = montauk::slen(child);
-        if (clen > 0 && child[clen - 1] == '/') child[clen - 1] = '\0';
-
-        filemanager_delete_recursive(child);
+        if (n < 0) return false;
+        if (deleted == 0) break;
     }
 
     // Now the directory should be empty -- delete it
@@ -570,100 +878,47 @@ static bool filemanager_delete_recursive(const char* path) {
 // File copy helper (single file)
 // ============================================================================
 
-static bool filemanager_copy_file(const char* src, const char* dst) {
-    int sfd = montauk::open(src);
-    if (sfd < 0) return false;
-    int size = (int)montauk::getsize(sfd);
-
-    // Create destination
-    int dfd = montauk::fcreate(dst);
-    if (dfd < 0) {
-        montauk::close(sfd);
-        return false;
-    }
-
-    if (size > 0) {
-        // Cap at 4 MB to avoid exhausting memory
-        if (size > 4 * 1024 * 1024) {
-            montauk::close(sfd);
-            montauk::close(dfd);
-            montauk::fdelete(dst);
-            return false;
-        }
-        uint8_t* buf = (uint8_t*)montauk::malloc(size);
-        if (!buf) {
-            montauk::close(sfd);
-            montauk::close(dfd);
-            montauk::fdelete(dst);
-            return false;
-        }
-        montauk::read(sfd, buf, 0, size);
-        montauk::fwrite(dfd, buf, 0, size);
-        montauk::mfree(buf);
-    }
+// Copies go through the pipelined engine in large blocks, so there is no
+// longer a cap on file size; its buffers are held only while copying
+static montauk::copy::Engine g_fm_copier;
 
-    montauk::close(sfd);
-    montauk::close(dfd);
-    return true;
+static bool filemanager_copy_file(const char* src, const char* dst) {
+    if (!g_fm_copier.init()) return false;
+    bool ok = g_fm_copier.copy_file(src, dst);
+    g_fm_copier.destroy();
+    if (!ok) montauk::fdelete(dst);
+    return ok;
 }
 
-// Recursive directory copy
-static bool filemanager_copy_dir_recursive(const char* src, const char* dst) {
+// Recursive directory copy: directories are made as the walk reaches them
+// and their files queued on the engine
+static bool filemanager_queue_dir_recursive(const char* src, const char* dst) {
     montauk::fmkdir(dst);
 
-    const char* names[64];
-    int count = montauk::readdir(src, names, 64);
-    if (count < 0) return false;
-
-    // Compute prefix to strip
-    const char* after_drive = src;
-    for (int k = 0; after_drive[k]; k++) {
-        if (after_drive[k] == ':' && after_drive[k + 1] == '/') {
-            after_drive += k + 2;
-            break;
+    Montauk::DirEntryInfo batch[16];
+    uint64_t cursor = 0;
+    int n;
+    while ((n = montauk::readdir_stat(src, &cursor, batch, 16)) > 0) {
+        for (int i = 0; i < n; i++) {
+            char src_child[512], dst_child[512];
+            filemanager_build_fullpath(src_child, 512, src, batch[i].name);
+            filemanager_build_fullpath(dst_child, 512, dst, batch[i].name);
+
+            if (batch[i].type == Montauk::DT_DIR)
+                filemanager_queue_dir_recursive(src_child, dst_child);
+            else if (!g_fm_copier.add(src_child, dst_child))
+                return false;
         }
     }
-    char prefix[256] = {0};
-    int prefix_len = 0;
-    if (after_drive[0] != '\0') {
-        montauk::strcpy(prefix, after_drive);
-        prefix_len = montauk::slen(prefix);
-        if (prefix_len > 0 && prefix[prefix_len - 1] != '/') {
-            prefix[prefix_len++] = '/';
-            prefix[prefix_len] = '\0';
-        }
-    }
-
-    for (int i = 0; i < count; i++) {
-        const char* raw = names[i];
-        if (prefix_len > 0) {
-            bool match = true;
-            for (int k = 0; k < prefix_len; k++) {
-                if (raw[k] != prefix[k]) { match = false; break; }
-            }
-            if (match) raw += prefix_len;
-        }
-
-        bool child_is_dir = false;
-        char basename[64];
-        montauk::strncpy(basename, raw, 63);
-        int blen = montauk::slen(basename);
-        if (blen > 0 && basename[blen - 1] == '/') {
-            child_is_dir = true;
-            basename[blen - 1] = '\0';
-        }
-
-        char src_child[512], dst_child[512];
-        filemanager_build_fullpath(src_child, 512, src, basename);
-        filemanager_build_fullpath(dst_child, 512, dst, basename);
-
-        if (child_is_dir)
-            filemanager_copy_dir_recursive(src_child, dst_child);
-        else
-            filemanager_copy_file(src_child, dst_child);
-    }
+    return n == 0;
+}
 
-    return true;
+static bool filemanager_copy_dir_recursive(const char* src, const char* dst) {
+    if (!g_fm_copier.init()) return false;
+    bool queued = filemanager_queue_dir_recursive(src, dst);
+    bool ok = g_fm_copier.finish() && queued;
+    g_fm_copier.destroy();
+    return ok;
 }
 
 // ============================================================================
@@ -672,20 +927,20 @@ static bool filemanager_copy_dir_recursive(const char* src, const char* dst) {
 
 static void filemanager_do_copy(FileManagerState* fm) {
     if (fm->selected < 0 || fm->selected >= fm->entry_count) return;
-    if (fm->at_drives_root || fm->entry_types[fm->selected] == 3) return;
+    if (fm->at_drives_root || fm->entries[fm->selected].type == 3) return;
 
     filemanager_build_fullpath(fm->clipboard_path, 256,
-                               fm->current_path, fm->entry_names[fm->selected]);
+                               fm->current_path, fm_name(fm, fm->selected));
     fm->clipboard_has_data = true;
     fm->clipboard_is_cut = false;
 }
 
 static void filemanager_do_cut(FileManagerState* fm) {
     if (fm->selected < 0 || fm->selected >= fm->entry_count) return;
-    if (fm->at_drives_root || fm->entry_types[fm->selected] == 3) return;
+    if (fm->at_drives_root || fm->entries[fm->selected].type == 3) return;
 
     filemanager_build_fullpath(fm->clipboard_path, 256,
-                               fm->current_path, fm->entry_names[fm->selected]);
+                               fm->current_path, fm_name(fm, fm->selected));
     fm->clipboard_has_data = true;
     fm->clipboard_is_cut = true;
 }
@@ -725,11 +980,11 @@ static void filemanager_do_paste(FileManagerState* fm) {
 
 static void filemanager_start_rename(FileManagerState* fm) {
     if (fm->selected < 0 || fm->selected >= fm->entry_count) return;
-    if (fm->at_drives_root || fm->entry_types[fm->selected] == 3) return;
+    if (fm->at_drives_root || fm->entries[fm->selected].type == 3) return;
 
     fm->rename_active = true;
     fm->rename_idx = fm->selected;
-    montauk::strcpy(fm->rename_buf, fm->entry_names[fm->selected]);
+    montauk::strncpy(fm->rename_buf, fm_name(fm, fm->selected), sizeof(fm->rename_buf));
     fm->rename_len = montauk::slen(fm->rename_buf);
     fm->rename_cursor = fm->rename_len;
 }
@@ -739,16 +994,16 @@ static void filemanager_finish_rename(FileManagerState* fm) {
     fm->rename_active = false;
 
     // If name unchanged, skip
-    if (montauk::streq(fm->rename_buf, fm->entry_names[fm->rename_idx])) return;
+    if (montauk::streq(fm->rename_buf, fm_name(fm, fm->rename_idx))) return;
     if (fm->rename_len == 0) return;
 
     char old_path[512], new_path[512];
     filemanager_build_fullpath(old_path, 512,
-                               fm->current_path, fm->entry_names[fm->rename_idx]);
+                               fm->current_path, fm_name(fm, fm->rename_idx));
     filemanager_build_fullpath(new_path, 512,
                                fm->current_path, fm->rename_buf);
 
-    if (fm->is_dir[fm->rename_idx]) {
+    if (fm->entries[fm->rename_idx].is_dir) {
         // Directory rename: copy recursively then delete old
         if (filemanager_copy_dir_recursive(old_path, new_path))
             filemanager_delete_recursive(old_path);
@@ -790,7 +1045,7 @@ static void filemanager_new_folder(FileManagerState* fm) {
 
     // Select the new folder and start rename
     for (int i = 0; i < fm->entry_count; i++) {
-        if (montauk::streq(fm->entry_names[i], name)) {
+        if (montauk::streq(fm_name(fm, i), name)) {
             fm->selected = i;
             filemanager_start_rename(fm);
             break;
@@ -804,12 +1059,12 @@ static void filemanager_new_folder(FileManagerState* fm) {
 
 static void filemanager_delete_selected(FileManagerState* fm) {
     if (fm->selected < 0 || fm->selected >= fm->entry_count) return;
-    if (fm->at_drives_root || fm->entry_types[fm->selected] == 3) return;
+    if (fm->at_drives_root || fm->entries[fm->selected].type == 3) return;
 
     char fullpath[512];
     filemanager_build_fullpath(fullpath, 512,
-                               fm->current_path, fm->entry_names[fm->selected]);
-    if (fm->is_dir[fm->selected])
+                               fm->current_path, fm_name(fm, fm->selected));
+    if (fm->entries[fm->selected].is_dir)
         filemanager_delete_recursive(fullpath);
     else
         montauk::fdelete(fullpath);
@@ -830,7 +1085,7 @@ static void filemanager_open_ctx_menu(FileManagerState* fm, int local_x, int loc
     fm->ctx_item_count = 0;
 
     if (target_idx >= 0 && target_idx < fm->entry_count) {
-        int tt = fm->entry_types[target_idx];
+        int tt = fm->entries[target_idx].type;
         if ((fm->at_drives_root && (tt == 3 || tt == 4 || tt == 5 || tt == 7)) ||
             (fm->at_apps_view && tt == 6)) {
             // Drive, Home, Apps shortcut, or app entry: only Open
@@ -1000,14 +1255,14 @@ static void filemanager_open_entry(FileManagerState* fm, int idx) {
     if (idx < 0 || idx >= fm->entry_count) return;
 
     // Special user folder in Computer view
-    if (fm->at_drives_root && fm->entry_types[idx] == 7) {
+    if (fm->at_drives_root && fm->entries[idx].type == 7) {
         DesktopState* ds = fm->desktop;
         if (ds && ds->home_dir[0] != '\0') {
             montauk::strcpy(fm->current_path, ds->home_dir);
             int plen = montauk::slen(fm->current_path);
             if (plen > 0 && fm->current_path[plen - 1] != '/')
                 str_append(fm->current_path, "/", 256);
-            str_append(fm->current_path, fm->entry_names[idx], 256);
+            str_append(fm->current_path, fm_name(fm, idx), 256);
             filemanager_push_history(fm);
             filemanager_read_dir(fm);
         }
@@ -1015,13 +1270,13 @@ static void filemanager_open_entry(FileManagerState* fm, int idx) {
     }
 
     // Apps shortcut in Computer view
-    if (fm->at_drives_root && fm->entry_types[idx] == 5) {
+    if (fm->at_drives_root && fm->entries[idx].type == 5) {
         filemanager_read_apps(fm);
         return;
     }
 
     // App entry in apps view - launch it
-    if (fm->at_apps_view && fm->entry_types[idx] == 6) {
+    if (fm->at_apps_view && fm->entries[idx].type == 6) {
         DesktopState* ds = fm->desktop;
         if (ds && fm->app_map[idx] >= 0 && fm->app_map[idx] < ds->external_app_count) {
             const ExternalApp& app = ds->external_apps[fm->app_map[idx]];
@@ -1034,7 +1289,7 @@ static void filemanager_open_entry(FileManagerState* fm, int idx) {
         return;
     }
 
-    if (fm->at_drives_root && fm->entry_types[idx] == 4) {
+    if (fm->at_drives_root && fm->entries[idx].type == 4) {
         // Home folder
         DesktopState* ds = fm->desktop;
         if (ds && ds->home_dir[0] != '\0') {
@@ -1045,8 +1300,8 @@ static void filemanager_open_entry(FileManagerState* fm, int idx) {
         return;
     }
 
-    if (fm->at_drives_root && fm->entry_types[idx] == 3) {
-        int d = fm->drive_indices[idx];
+    if (fm->at_drives_root && fm->entries[idx].type == 3) {
+        int d = fm->entries[idx].drive;
         char dpath[8];
         if (d < 10) {
             dpath[0] = '0' + d; dpath[1] = ':'; dpath[2] = '/'; dpath[3] = '\0';
@@ -1059,27 +1314,27 @@ static void filemanager_open_entry(FileManagerState* fm, int idx) {
         return;
     }
 
-    if (fm->is_dir[idx]) {
-        filemanager_navigate(fm, fm->entry_names[idx]);
+    if (fm->entries[idx].is_dir) {
+        filemanager_navigate(fm, fm_name(fm, idx));
         return;
     }
 
     // Open file with appropriate app
     char fullpath[512];
-    filemanager_build_fullpath(fullpath, 512, fm->current_path, fm->entry_names[idx]);
-    if (is_image_file(fm->entry_names[idx])) {
+    filemanager_build_fullpath(fullpath, 512, fm->current_path, fm_name(fm, idx));
+    if (is_image_file(fm_name(fm, idx))) {
         montauk::spawn("0:/apps/imageviewer/imageviewer.elf", fullpath);
-    } else if (is_font_file(fm->entry_names[idx])) {
+    } else if (is_font_file(fm_name(fm, idx))) {
         montauk::spawn("0:/apps/fontpreview/fontpreview.elf", fullpath);
-    } else if (is_pdf_file(fm->entry_names[idx])) {
+    } else if (is_pdf_file(fm_name(fm, idx))) {
         montauk::spawn("0:/apps/pdfviewer/pdfviewer.elf", fullpath);
-    } else if (is_spreadsheet_file(fm->entry_names[idx])) {
+    } else if (is_spreadsheet_file(fm_name(fm, idx))) {
         montauk::spawn("0:/apps/spreadsheet/spreadsheet.elf", fullpath);
-    } else if (is_wordprocessor_file(fm->entry_names[idx])) {
+    } else if (is_wordprocessor_file(fm_name(fm, idx))) {
         montauk::spawn("0:/apps/wordprocessor/wordprocessor.elf", fullpath);
-    } else if (is_audio_file(fm->entry_names[idx])) {
+    } else if (is_audio_file(fm_name(fm, idx))) {
         montauk::spawn("0:/apps/music/music.elf", fullpath);
-    } else if (str_ends_with(fm->entry_names[idx], ".elf")) {
+    } else if (str_ends_with(fm_name(fm, idx), ".elf")) {
         montauk::spawn(fullpath);
     } else {
         montauk::spawn("0:/apps/texteditor/texteditor.elf", fullpath);
@@ -1137,7 +1392,7 @@ static void filemanager_draw_header(Canvas& c, FileManagerState* fm,
     // Action buttons: Copy, Cut, Paste, Rename, New Folder, Delete
     bool has_sel = fm->selected >= 0 && fm->selected < fm->entry_count
                    && !fm->at_drives_root && !fm->at_apps_view
-                   && fm->entry_types[fm->selected] != 3;
+                   && fm->entries[fm->selected].type != 3;
     bool has_clip = fm->clipboard_has_data && !fm->at_drives_root && !fm->at_apps_view;
     Color dim_bg = Color::from_rgb(0xF0, 0xF0, 0xF0);
 
@@ -1195,6 +1450,193 @@ static void filemanager_draw_header(Canvas& c, FileManagerState* fm,
     c.hline(0, pathbar_y + FM_PATHBAR_H - 1, c.w, colors::BORDER);
 }
 
+// VirtualList item callbacks: draw entry `i` with its cell's top-left
+// corner at (x, y) of a band of the window's content buffer
+static void filemanager_draw_grid_item(void* userdata, int i, uint32_t* pixels,
+                                       int buf_w, int buf_h, int cell_x, int cell_y) {
+    FileManagerState* fm = (FileManagerState*)userdata;
+    DesktopState* ds = fm->desktop;
+    Canvas c(pixels, buf_w, buf_h);
+    FmEntry& e = fm->entries[i];
+    const char* name = fm_name(fm, i);
+
+    // Selection highlight
+    if (i == fm->selected)
+        c.fill_rect(cell_x, cell_y, FM_GRID_CELL_W, FM_GRID_CELL_H, colors::MENU_HOVER);
+
+    // Large icon centered horizontally
+    int icon_x = cell_x + (FM_GRID_CELL_W - FM_GRID_ICON) / 2;
+    int icon_y = cell_y + FM_GRID_PAD;
+    // Check for special folder icon (type 7 in Computer, or type 1 dir with matching name)
+    int sfi = -1;
+    if (e.type == 7) sfi = e.drive;
+    else if (ds && e.type == 1) sfi = special_folder_index(name);
+
+    if (e.type == 0 && e.thumb_state == THUMB_NONE && is_image_file(name)) {
+        thumb_request(fm, i);
+    }
+
+    if (sfi >= 0 && ds && ds->icon_special_folder_lg[sfi].pixels) {
+        c.icon(icon_x, icon_y, ds->icon_special_folder_lg[sfi]);
+    } else if (e.type == 6 && i < fm->app_icon_count && fm->app_icons_lg[i].pixels) {
+        c.icon(icon_x, icon_y, fm->app_icons_lg[i]);
+    } else if (ds && e.type == 5 && ds->icon_apps_lg.pixels) {
+        c.icon(icon_x, icon_y, ds->icon_apps_lg);
+    } else if (ds && e.type == 4 && ds->icon_home_folder_lg.pixels) {
+        c.icon(icon_x, icon_y, ds->icon_home_folder_lg);
+    } else if (ds && e.type == 3 && ds->icon_drive_lg.pixels) {
+        c.icon(icon_x, icon_y, ds->icon_drive_lg);
+    } else if (ds && e.type == 1 && ds->icon_folder_lg.pixels) {
+        c.icon(icon_x, icon_y, ds->icon_folder_lg);
+    } else if (ds && e.type == 2 && ds->icon_exec_lg.pixels) {
+        c.icon(icon_x, icon_y, ds->icon_exec_lg);
+    } else if (e.thumb_state == THUMB_READY) {
+        c.icon(icon_x + (FM_GRID_ICON - e.thumb.width) / 2,
+               icon_y + (FM_GRID_ICON - e.thumb.height) / 2, e.thumb);
+    } else if (ds && ds->icon_file_lg.pixels) {
+        c.icon(icon_x, icon_y, ds->icon_file_lg);
+    } else {
+        Color icon_c = e.is_dir
+            ? Color::from_rgb(0xFF, 0xBD, 0x2E)
+            : Color::from_rgb(0x90, 0x90, 0x90);
+        c.fill_rect(icon_x, icon_y, FM_GRID_ICON, FM_GRID_ICON, icon_c);
+    }
+
+    // Filename centered below icon, truncated if needed; only drawn when
+    // it fits the band. If renaming this entry, draw the rename textbox instead
+    int fh = system_font_height();
+    int ty = icon_y + FM_GRID_ICON + 2;
+    if (fm->rename_active && fm->rename_idx == i) {
+        int tw = FM_GRID_CELL_W - 4;
+        if (ty - 1 >= 0 && ty + fh + 4 <= buf_h) {
+            c.fill_rect(cell_x + 2, ty - 1, tw, fh + 2, colors::WHITE);
+            c.rect(cell_x + 2, ty - 1, tw, fh + 2, colors::ACCENT);
+            // Draw rename text (truncated to cell width)
+            char display[16];
+            int rlen = fm->rename_len;
+            if (rlen > 10) rlen = 10;
+            for (int k = 0; k < rlen; k++) display[k] = fm->rename_buf[k];
+            display[rlen] = '\0';
+            c.text(cell_x + 4, ty, display, colors::TEXT_COLOR);
+            // Cursor
+            char prefix[16];
+            int cpos = fm->rename_cursor < rlen ? fm->rename_cursor : rlen;
+            for (int k = 0; k < cpos; k++) prefix[k] = fm->rename_buf[k];
+            prefix[cpos] = '\0';
+            int cx = cell_x + 4 + text_width(prefix);
+            c.vline(cx, ty, fh, colors::ACCENT);
+        }
+    } else {
+        char label[16];
+        int nlen = montauk::slen(name);
+        if (nlen > 9) {
+            for (int k = 0; k < 9; k++) label[k] = name[k];
+            label[9] = '.';
+            label[10] = '.';
+            label[11] = '\0';
+        } else {
+            montauk::strncpy(label, name, 15);
+        }
+        int tw = text_width(label);
+        int tx = cell_x + (FM_GRID_CELL_W - tw) / 2;
+        if (tx < cell_x) tx = cell_x;
+        if (ty >= 0 && ty + fh <= buf_h)
+            c.text(tx, ty, label, colors::TEXT_COLOR);
+    }
+}
+
+static void filemanager_draw_list_item(void* userdata, int i, uint32_t* pixels,
+                                       int buf_w, int buf_h, int x, int iy) {
+    FileManagerState* fm = (FileManagerState*)userdata;
+    DesktopState* ds = fm->desktop;
+    Canvas c(pixels, buf_w, buf_h);
+    const FmEntry& e = fm->entries[i];
+    const char* name = fm_name(fm, i);
+    Color dim = Color::from_rgb(0x88, 0x88, 0x88);
+    int row_w = fm->list.bounds.w;
+    int size_col_x = x + row_w - 120;
+    int type_col_x = x + row_w - 60;
+
+    // Highlight selected
+    if (i == fm->selected)
+        c.fill_rect(x, iy, row_w, FM_ITEM_H, colors::MENU_HOVER);
+
+    // Icon
+    int ico_x = x + 8;
+    int ico_y = iy + (FM_ITEM_H - 16) / 2;
+    // Check for special folder icon
+    int sfi_sm = -1;
+    if (e.type == 7) sfi_sm = e.drive;
+    else if (ds && e.type == 1) sfi_sm = special_folder_index(name);
+
+    if (sfi_sm >= 0 && ds && ds->icon_special_folder[sfi_sm].pixels) {
+        c.icon(ico_x, ico_y, ds->icon_special_folder[sfi_sm]);
+    } else if (e.type == 6 && i < fm->app_icon_count && fm->app_icons_sm[i].pixels) {
+        c.icon(ico_x, ico_y, fm->app_icons_sm[i]);
+    } else if (ds && e.type == 5 && ds->icon_apps.pixels) {
+        c.icon(ico_x, ico_y, ds->icon_apps);
+    } else if (ds && e.type == 4 && ds->icon_home_folder.pixels) {
+        c.icon(ico_x, ico_y, ds->icon_home_folder);
+    } else if (ds && e.type == 3 && ds->icon_drive.pixels) {
+        c.icon(ico_x, ico_y, ds->icon_drive);
+    } else if (ds && e.type == 1 && ds->icon_folder.pixels) {
+        c.icon(ico_x, ico_y, ds->icon_folder);
+    } else if (ds && e.type == 2 && ds->icon_exec.pixels) {
+        c.icon(ico_x, ico_y, ds->icon_exec);
+    } else if (ds && ds->icon_file.pixels) {
+        c.icon(ico_x, ico_y, ds->icon_file);
+    } else {
+        Color icon_c = e.is_dir
+            ? Color::from_rgb(0xFF, 0xBD, 0x2E)
+            : Color::from_rgb(0x90, 0x90, 0x90);
+        c.fill_rect(ico_x, ico_y, 16, 16, icon_c);
+    }
+
+    // Text is only drawn when its line fits the band
+    int tx = x + 30;
+    int fm_sfh = system_font_height();
+    int ty = iy + (FM_ITEM_H - fm_sfh) / 2;
+    if (ty < 0 || ty + fm_sfh > buf_h) return;
+
+    // Name (or rename textbox)
+    if (fm->rename_active && fm->rename_idx == i) {
+        // Rename textbox inline
+        int rw = (size_col_x > 100 ? size_col_x - 8 : x + row_w - 8) - tx;
+        c.fill_rect(tx - 2, ty - 1, rw, fm_sfh + 2, colors::WHITE);
+        c.rect(tx - 2, ty - 1, rw, fm_sfh + 2, colors::ACCENT);
+        c.text(tx, ty, fm->rename_buf, colors::TEXT_COLOR);
+        // Cursor
+        char prefix[256];
+        int cpos = fm->rename_cursor;
+        if (cpos > 255) cpos = 255;
+        for (int k = 0; k < cpos; k++) prefix[k] = fm->rename_buf[k];
+        prefix[cpos] = '\0';
+        int cx = tx + text_width(prefix);
+        c.vline(cx, ty, fm_sfh, colors::ACCENT);
+    } else {
+        c.text(tx, ty, name, colors::TEXT_COLOR);
+    }
+
+    // Size
+    if (size_col_x > 100 && !e.is_dir) {
+        char size_str[16];
+        format_size(size_str, (int)e.size);
+        c.text(size_col_x, ty, size_str, dim);
+    }
+
+    // Type
+    if (type_col_x > 160) {
+        const char* type_str = "File";
+        if (e.type == 6) type_str = "App";
+        else if (e.type == 5) type_str = "Apps";
+        else if (e.type == 4) type_str = "Home";
+        else if (e.type == 3) type_str = "Drive";
+        else if (e.type == 1) type_str = "Dir";
+        else if (e.type == 2) type_str = "Exec";
+        c.text(type_col_x, ty, type_str, dim);
+    }
+}
+
 static void filemanager_on_draw(Window* win, Framebuffer& fb) {
     FileManagerState* fm = (FileManagerState*)win->app_data;
     if (!fm) return;
@@ -1205,128 +1647,24 @@ static void filemanager_on_draw(Window* win, Framebuffer& fb) {
     Color toolbar_color = Color::from_rgb(0xF5, 0xF5, 0xF5);
     Color btn_bg = Color::from_rgb(0xE8, 0xE8, 0xE8);
     Color dim = Color::from_rgb(0x88, 0x88, 0x88);
-    DesktopState* ds = fm->desktop;
 
     // Draw header (toolbar + path bar)
     filemanager_draw_header(c, fm, toolbar_color, btn_bg);
 
+    // The entries go through the VirtualList, which draws only those in
+    // view, clipped to the list area
+    int list_y = FM_TOOLBAR_H + FM_PATHBAR_H;
+    int size_col_x = c.w - FM_SCROLLBAR_W - 120;
     if (fm->grid_view) {
-        // ---- Grid View ----
-        int list_y = FM_TOOLBAR_H + FM_PATHBAR_H;
-        int list_h = c.h - list_y;
-        int cols = (c.w - FM_SCROLLBAR_W) / FM_GRID_CELL_W;
-        if (cols < 1) cols = 1;
-        int rows = (fm->entry_count + cols - 1) / cols;
-        int content_h = rows * FM_GRID_CELL_H;
-
-        // Update scrollbar
-        fm->scrollbar.bounds = {c.w - FM_SCROLLBAR_W, list_y, FM_SCROLLBAR_W, list_h};
-        fm->scrollbar.content_height = content_h;
-        fm->scrollbar.view_height = list_h;
-
-        for (int i = 0; i < fm->entry_count; i++) {
-            int col = i % cols;
-            int row = i / cols;
-            int cell_x = col * FM_GRID_CELL_W;
-            int cell_y = list_y + row * FM_GRID_CELL_H - fm->scrollbar.scroll_offset;
-
-            // Skip if entirely off-screen
-            if (cell_y + FM_GRID_CELL_H <= list_y || cell_y >= c.h) continue;
-
-            // Selection highlight
-            if (i == fm->selected) {
-                int sy = gui_max(cell_y, list_y);
-                int sh = gui_min(cell_y + FM_GRID_CELL_H, c.h) - sy;
-                int sw = gui_min(FM_GRID_CELL_W, c.w - FM_SCROLLBAR_W - cell_x);
-                if (sh > 0 && sw > 0)
-                    c.fill_rect(cell_x, sy, sw, sh, colors::MENU_HOVER);
-            }
-
-            // Large icon centered horizontally
-            int icon_x = cell_x + (FM_GRID_CELL_W - FM_GRID_ICON) / 2;
-            int icon_y = cell_y + FM_GRID_PAD;
-            // Check for special folder icon (type 7 in Computer, or type 1 dir with matching name)
-            int sfi = -1;
-            if (fm->entry_types[i] == 7) sfi = fm->drive_indices[i];
-            else if (ds && fm->entry_types[i] == 1) sfi = special_folder_index(fm->entry_names[i]);
-
-            if (sfi >= 0 && ds && ds->icon_special_folder_lg[sfi].pixels) {
-                c.icon(icon_x, icon_y, ds->icon_special_folder_lg[sfi]);
-            } else if (fm->entry_types[i] == 6 && i < fm->app_icon_count && fm->app_icons_lg[i].pixels) {
-                c.icon(icon_x, icon_y, fm->app_icons_lg[i]);
-            } else if (ds && fm->entry_types[i] == 5 && ds->icon_apps_lg.pixels) {
-                c.icon(icon_x, icon_y, ds->icon_apps_lg);
-            } else if (ds && fm->entry_types[i] == 4 && ds->icon_home_folder_lg.pixels) {
-                c.icon(icon_x, icon_y, ds->icon_home_folder_lg);
-            } else if (ds && fm->entry_types[i] == 3 && ds->icon_drive_lg.pixels) {
-                c.icon(icon_x, icon_y, ds->icon_drive_lg);
-            } else if (ds && fm->entry_types[i] == 1 && ds->icon_folder_lg.pixels) {
-                c.icon(icon_x, icon_y, ds->icon_folder_lg);
-            } else if (ds && fm->entry_types[i] == 2 && ds->icon_exec_lg.pixels) {
-                c.icon(icon_x, icon_y, ds->icon_exec_lg);
-            } else if (ds && ds->icon_file_lg.pixels) {
-                c.icon(icon_x, icon_y, ds->icon_file_lg);
-            } else {
-                Color icon_c = fm->is_dir[i]
-                    ? Color::from_rgb(0xFF, 0xBD, 0x2E)
-                    : Color::from_rgb(0x90, 0x90, 0x90);
-                int iy_clip = gui_max(icon_y, list_y);
-                int ih_clip = FM_GRID_ICON - (iy_clip - icon_y);
-                if (ih_clip > 0)
-                    c.fill_rect(icon_x, iy_clip, FM_GRID_ICON, ih_clip, icon_c);
-            }
-
-            // Filename centered below icon, truncated if needed
-            // If renaming this entry, draw the rename textbox instead
-            if (fm->rename_active && fm->rename_idx == i) {
-                int ty = icon_y + FM_GRID_ICON + 2;
-                int tw = FM_GRID_CELL_W - 4;
-                if (ty >= list_y && ty + system_font_height() + 4 <= c.h) {
-                    c.fill_rect(cell_x + 2, ty - 1, tw, system_font_height() + 2, colors::WHITE);
-                    c.rect(cell_x + 2, ty - 1, tw, system_font_height() + 2, colors::ACCENT);
-                    // Draw rename text (truncated to cell width)
-                    char display[16];
-                    int rlen = fm->rename_len;
-                    if (rlen > 10) rlen = 10;
-                    for (int k = 0; k < rlen; k++) display[k] = fm->rename_buf[k];
-                    display[rlen] = '\0';
-                    c.text(cell_x + 4, ty, display, colors::TEXT_COLOR);
-                    // Cursor
-                    char prefix[64];
-                    int cpos = fm->rename_cursor < rlen ? fm->rename_cursor : rlen;
-                    for (int k = 0; k < cpos; k++) prefix[k] = fm->rename_buf[k];
-                    prefix[cpos] = '\0';
-                    int cx = cell_x + 4 + text_width(prefix);
-                    c.vline(cx, ty, system_font_height(), colors::ACCENT);
-                }
-            } else {
-                char label[16];
-                int nlen = montauk::slen(fm->entry_names[i]);
-                if (nlen > 9) {
-                    for (int k = 0; k < 9; k++) label[k] = fm->entry_names[i][k];
-                    label[9] = '.';
-                    label[10] = '.';
-                    label[11] = '\0';
-                } else {
-                    montauk::strncpy(label, fm->entry_names[i], 15);
-                }
-                int tw = text_width(label);
-                int tx = cell_x + (FM_GRID_CELL_W - tw) / 2;
-                if (tx < cell_x) tx = cell_x;
-                int ty = icon_y + FM_GRID_ICON + 2;
-                if (ty >= list_y && ty + system_font_height() <= c.h)
-                    c.text(tx, ty, label, colors::TEXT_COLOR);
-            }
-        }
+        fm->list.item_w = FM_GRID_CELL_W;
+        fm->list.item_h = FM_GRID_CELL_H;
+        fm->list.draw_item = filemanager_draw_grid_item;
     } else {
-        // ---- List View ----
-
         // ---- Column headers ----
-        int header_y = FM_TOOLBAR_H + FM_PATHBAR_H;
+        int header_y = list_y;
         c.fill_rect(0, header_y, c.w, FM_HEADER_H, Color::from_rgb(0xF8, 0xF8, 0xF8));
 
         int name_col_x = 8;
-        int size_col_x = c.w - FM_SCROLLBAR_W - 120;
         int type_col_x = c.w - FM_SCROLLBAR_W - 60;
 
         c.text(name_col_x, header_y + 2, "Name", dim);
@@ -1338,115 +1676,31 @@ static void filemanager_on_draw(Window* win, Framebuffer& fb) {
         // Header separator
         c.hline(0, header_y + FM_HEADER_H - 1, c.w, colors::BORDER);
 
-        // Column separator lines
-        if (size_col_x > 100) {
-            c.vline(size_col_x - 4, header_y, c.h - header_y, colors::BORDER);
-        }
+        list_y = header_y + FM_HEADER_H;
+        fm->list.item_w = 0;
+        fm->list.item_h = FM_ITEM_H;
+        fm->list.draw_item = filemanager_draw_list_item;
+    }
 
-        // ---- File entries ----
-        int list_y = header_y + FM_HEADER_H;
-        int list_h = c.h - list_y;
-        int visible_items = list_h / FM_ITEM_H;
-        int content_h = fm->entry_count * FM_ITEM_H;
-
-        // Update scrollbar
-        fm->scrollbar.bounds = {c.w - FM_SCROLLBAR_W, list_y, FM_SCROLLBAR_W, list_h};
-        fm->scrollbar.content_height = content_h;
-        fm->scrollbar.view_height = list_h;
-
-        int scroll_items = fm->scrollbar.scroll_offset / FM_ITEM_H;
-
-        for (int i = scroll_items; i < fm->entry_count && (i - scroll_items) < visible_items + 1; i++) {
-            int iy = list_y + (i - scroll_items) * FM_ITEM_H - (fm->scrollbar.scroll_offset % FM_ITEM_H);
-            if (iy + FM_ITEM_H <= list_y || iy >= c.h) continue;
-
-            // Highlight selected
-            if (i == fm->selected) {
-                int sy = gui_max(iy, list_y);
-                int sh = gui_min(iy + FM_ITEM_H, c.h) - sy;
-                if (sh > 0)
-                    c.fill_rect(0, sy, c.w - FM_SCROLLBAR_W, sh, colors::MENU_HOVER);
-            }
+    int list_h = gui_max(0, c.h - list_y);
+    fm->list.bounds = {0, list_y, gui_max(0, c.w - FM_SCROLLBAR_W), list_h};
+    fm->list.item_count = fm->entry_count;
+    fm->list.scroll_offset = fm->scrollbar.scroll_offset;
+    fm->list.draw(c.pixels, c.w);
 
-            // Icon (skip if it would bleed above the list area)
-            int ico_x = 8;
-            int ico_y = iy + (FM_ITEM_H - 16) / 2;
-            // Check for special folder icon
-            int sfi_sm = -1;
-            if (fm->entry_types[i] == 7) sfi_sm = fm->drive_indices[i];
-            else if (ds && fm->entry_types[i] == 1) sfi_sm = special_folder_index(fm->entry_names[i]);
-
-            if (ico_y < list_y) { /* clipped by header repaint */ }
-            else if (sfi_sm >= 0 && ds && ds->icon_special_folder[sfi_sm].pixels) {
-                c.icon(ico_x, ico_y, ds->icon_special_folder[sfi_sm]);
-            } else if (fm->entry_types[i] == 6 && i < fm->app_icon_count && fm->app_icons_sm[i].pixels) {
-                c.icon(ico_x, ico_y, fm->app_icons_sm[i]);
-            } else if (ds && fm->entry_types[i] == 5 && ds->icon_apps.pixels) {
-                c.icon(ico_x, ico_y, ds->icon_apps);
-            } else if (ds && fm->entry_types[i] == 4 && ds->icon_home_folder.pixels) {
-                c.icon(ico_x, ico_y, ds->icon_home_folder);
-            } else if (ds && fm->entry_types[i] == 3 && ds->icon_drive.pixels) {
-                c.icon(ico_x, ico_y, ds->icon_drive);
-            } else if (ds && fm->entry_types[i] == 1 && ds->icon_folder.pixels) {
-                c.icon(ico_x, ico_y, ds->icon_folder);
-            } else if (ds && fm->entry_types[i] == 2 && ds->icon_exec.pixels) {
-                c.icon(ico_x, ico_y, ds->icon_exec);
-            } else if (ds && ds->icon_file.pixels) {
-                c.icon(ico_x, ico_y, ds->icon_file);
-            } else {
-                Color icon_c = fm->is_dir[i]
-                    ? Color::from_rgb(0xFF, 0xBD, 0x2E)
-                    : Color::from_rgb(0x90, 0x90, 0x90);
-                int iy_clip = gui_max(ico_y, list_y);
-                int ih_clip = 16 - (iy_clip - ico_y);
-                if (ih_clip > 0)
-                    c.fill_rect(ico_x, iy_clip, 16, ih_clip, icon_c);
-            }
-
-            // Name (or rename textbox)
-            int tx = 30;
-            int fm_sfh = system_font_height();
-            int ty = iy + (FM_ITEM_H - fm_sfh) / 2;
-
-            if (fm->rename_active && fm->rename_idx == i && ty >= list_y && ty + fm_sfh <= c.h) {
-                // Rename textbox inline
-                int rw = (size_col_x > 100 ? size_col_x - 8 : c.w - FM_SCROLLBAR_W - 8) - tx;
-                c.fill_rect(tx - 2, ty - 1, rw, fm_sfh + 2, colors::WHITE);
-                c.rect(tx - 2, ty - 1, rw, fm_sfh + 2, colors::ACCENT);
-                c.text(tx, ty, fm->rename_buf, colors::TEXT_COLOR);
-                // Cursor
-                char prefix[64];
-                int cpos = fm->rename_cursor;
-                if (cpos > 63) cpos = 63;
-                for (int k = 0; k < cpos; k++) prefix[k] = fm->rename_buf[k];
-                prefix[cpos] = '\0';
-                int cx = tx + text_width(prefix);
-                c.vline(cx, ty, fm_sfh, colors::ACCENT);
-            } else {
-                if (ty >= list_y && ty + fm_sfh <= c.h)
-                    c.text(tx, ty, fm->entry_names[i], colors::TEXT_COLOR);
-            }
+    // Update scrollbar
+    fm->scrollbar.bounds = {c.w - FM_SCROLLBAR_W, list_y, FM_SCROLLBAR_W, list_h};
+    fm->scrollbar.content_height = fm->list.content_height();
+    fm->scrollbar.view_height = list_h;
+    fm->scrollbar.scroll_offset = fm->list.scroll_offset;
 
-            // Size
-            if (size_col_x > 100 && !fm->is_dir[i] && ty >= list_y && ty + fm_sfh <= c.h) {
-                char size_str[16];
-                format_size(size_str, fm->entry_sizes[i]);
-                c.text(size_col_x, ty, size_str, dim);
-            }
+    // Column separator line
+    if (!fm->grid_view && size_col_x > 100)
+        c.vline(size_col_x - 4, list_y - FM_HEADER_H, c.h - list_y + FM_HEADER_H, colors::BORDER);
 
-            // Type
-            if (type_col_x > 160 && ty >= list_y && ty + fm_sfh <= c.h) {
-                const char* type_str = "File";
-                if (fm->entry_types[i] == 6) type_str = "App";
-                else if (fm->entry_types[i] == 5) type_str = "Apps";
-                else if (fm->entry_types[i] == 4) type_str = "Home";
-                else if (fm->entry_types[i] == 3) type_str = "Drive";
-                else if (fm->entry_types[i] == 1) type_str = "Dir";
-                else if (fm->entry_types[i] == 2) type_str = "Exec";
-                c.text(type_col_x, ty, type_str, dim);
-            }
-        }
-    }
+    // Collect thumbnails as the worker finishes them
+    if (fm->thumbs_pending > 0 || fm->thumbs_deferred)
+        win->on_poll = filemanager_on_poll;
 
     // ---- Scrollbar ----
     if (fm->scrollbar.content_height > fm->scrollbar.view_height) {
@@ -1465,10 +1719,6 @@ static void filemanager_on_draw(Window* win, Framebuffer& fb) {
         c.fill_rect(sbx + 1, tty, sbw - 2, th, sb_fg_color);
     }
 
-    // Repaint header on top of content to clip scrolled icon overflow
-    if (fm->scrollbar.scroll_offset > 0)
-        filemanager_draw_header(c, fm, toolbar_color, btn_bg);
-
     // ---- Context menu overlay ----
     if (fm->ctx_open && fm->ctx_item_count > 0) {
         int cmx = fm->ctx_x;
@@ -1608,57 +1858,27 @@ static void filemanager_on_mouse(Window* win, MouseEvent& ev) {
             return;
         }
 
-        // File clicks (grid vs list)
-        if (fm->grid_view) {
-            int list_y = FM_TOOLBAR_H + FM_PATHBAR_H;
-            if (local_y >= list_y && local_x < cw - FM_SCROLLBAR_W) {
-                int cols = (cw - FM_SCROLLBAR_W) / FM_GRID_CELL_W;
-                if (cols < 1) cols = 1;
-                int col = local_x / FM_GRID_CELL_W;
-                int row = (local_y - list_y + fm->scrollbar.scroll_offset) / FM_GRID_CELL_H;
-                int clicked_idx = row * cols + col;
-
-                if (clicked_idx >= 0 && clicked_idx < fm->entry_count && col < cols) {
-                    uint64_t now = montauk::get_milliseconds();
-
-                    if (fm->last_click_item == clicked_idx &&
-                        (now - fm->last_click_time) < 400) {
-                        filemanager_open_entry(fm, clicked_idx);
-                        fm->last_click_item = -1;
-                        fm->last_click_time = 0;
-                    } else {
-                        fm->selected = clicked_idx;
-                        fm->last_click_item = clicked_idx;
-                        fm->last_click_time = now;
-                    }
-                } else {
-                    fm->selected = -1;
-                }
-            }
-        } else {
-            // List view clicks
-            int list_y = FM_TOOLBAR_H + FM_PATHBAR_H + FM_HEADER_H;
-            if (local_y >= list_y && local_x < cw - FM_SCROLLBAR_W) {
-                int rel_y = local_y - list_y + fm->scrollbar.scroll_offset;
-                int clicked_idx = rel_y / FM_ITEM_H;
-
-                if (clicked_idx >= 0 && clicked_idx < fm->entry_count) {
-                    uint64_t now = montauk::get_milliseconds();
-
-                    // Double-click detection
-                    if (fm->last_click_item == clicked_idx &&
-                        (now - fm->last_click_time) < 400) {
-                        filemanager_open_entry(fm, clicked_idx);
-                        fm->last_click_item = -1;
-                        fm->last_click_time = 0;
-                    } else {
-                        fm->selected = clicked_idx;
-                        fm->last_click_item = clicked_idx;
-                        fm->last_click_time = now;
-                    }
+        // File clicks, hit-tested against the list as last drawn
+        fm->list.scroll_offset = fm->scrollbar.scroll_offset;
+        if (fm->list.bounds.contains(local_x, local_y)) {
+            int clicked_idx = fm->list.item_at(local_x, local_y);
+
+            if (clicked_idx >= 0) {
+                uint64_t now = montauk::get_milliseconds();
+
+                // Double-click detection
+                if (fm->last_click_item == clicked_idx &&
+                    (now - fm->last_click_time) < 400) {
+                    filemanager_open_entry(fm, clicked_idx);
+                    fm->last_click_item = -1;
+                    fm->last_click_time = 0;
                 } else {
-                    fm->selected = -1;
+                    fm->selected = clicked_idx;
+                    fm->last_click_item = clicked_idx;
+                    fm->last_click_time = now;
                 }
+            } else {
+                fm->selected = -1;
             }
         }
     }
@@ -1670,31 +1890,11 @@ static void filemanager_on_mouse(Window* win, MouseEvent& ev) {
         // Determine what was right-clicked
         int target_idx = -1;
 
-        if (local_y >= FM_TOOLBAR_H + FM_PATHBAR_H) {
-            if (fm->grid_view) {
-                int list_y = FM_TOOLBAR_H + FM_PATHBAR_H;
-                if (local_x < cw - FM_SCROLLBAR_W) {
-                    int cols = (cw - FM_SCROLLBAR_W) / FM_GRID_CELL_W;
-                    if (cols < 1) cols = 1;
-                    int col = local_x / FM_GRID_CELL_W;
-                    int row = (local_y - list_y + fm->scrollbar.scroll_offset) / FM_GRID_CELL_H;
-                    int idx = row * cols + col;
-                    if (idx >= 0 && idx < fm->entry_count && col < cols) {
-                        target_idx = idx;
-                        fm->selected = idx;
-                    }
-                }
-            } else {
-                int list_y = FM_TOOLBAR_H + FM_PATHBAR_H + FM_HEADER_H;
-                if (local_y >= list_y && local_x < cw - FM_SCROLLBAR_W) {
-                    int rel_y = local_y - list_y + fm->scrollbar.scroll_offset;
-                    int idx = rel_y / FM_ITEM_H;
-                    if (idx >= 0 && idx < fm->entry_count) {
-                        target_idx = idx;
-                        fm->selected = idx;
-                    }
-                }
-            }
+        fm->list.scroll_offset = fm->scrollbar.scroll_offset;
+        int idx = fm->list.item_at(local_x, local_y);
+        if (idx >= 0) {
+            target_idx = idx;
+            fm->selected = idx;
         }
 
         filemanager_open_ctx_menu(fm, local_x, local_y, target_idx);
@@ -1801,7 +2001,7 @@ static void filemanager_on_key(Window* win, const Montauk::KeyEvent& key) {
             fm->rename_cursor = fm->rename_len;
         } else if (key.ascii >= 32 && key.ascii < 127) {
             // Printable character (reject / and other FS-unsafe chars)
-            if (key.ascii != '/' && key.ascii != '\\' && fm->rename_len < 62) {
+            if (key.ascii != '/' && key.ascii != '\\' && fm->rename_len < (int)sizeof(fm->rename_buf) - 2) {
                 for (int i = fm->rename_len; i > fm->rename_cursor; i--)
                     fm->rename_buf[i] = fm->rename_buf[i - 1];
                 fm->rename_buf[fm->rename_cursor] = key.ascii;
@@ -1841,14 +2041,13 @@ static void filemanager_on_key(Window* win, const Montauk::KeyEvent& key) {
         return;
     }
 
+    int prev_selected = fm->selected;
     if (key.ascii == '\b' || key.scancode == 0x0E) {
         filemanager_go_up(fm);
     } else if (key.scancode == 0x48) {
         // Up arrow
         if (fm->grid_view) {
-            Rect cr_r = win->content_rect();
-            int cols = (cr_r.w - FM_SCROLLBAR_W) / FM_GRID_CELL_W;
-            if (cols < 1) cols = 1;
+            int cols = fm->list.columns();
             if (fm->selected >= cols) fm->selected -= cols;
         } else {
             if (fm->selected > 0) fm->selected--;
@@ -1856,9 +2055,7 @@ static void filemanager_on_key(Window* win, const Montauk::KeyEvent& key) {
     } else if (key.scancode == 0x50) {
         // Down arrow
         if (fm->grid_view) {
-            Rect cr_r = win->content_rect();
-            int cols = (cr_r.w - FM_SCROLLBAR_W) / FM_GRID_CELL_W;
-            if (cols < 1) cols = 1;
+            int cols = fm->list.columns();
             if (fm->selected + cols < fm->entry_count) fm->selected += cols;
         } else {
             if (fm->selected < fm->entry_count - 1) fm->selected++;
@@ -1882,12 +2079,22 @@ static void filemanager_on_key(Window* win, const Montauk::KeyEvent& key) {
         // Alt+Right: go forward
         filemanager_go_forward(fm);
     }
+
+    // Keep the selection in view
+    if (fm->selected != prev_selected) {
+        fm->list.scroll_offset = fm->scrollbar.scroll_offset;
+        fm->list.scroll_to_item(fm->selected);
+        fm->scrollbar.scroll_offset = fm->list.scroll_offset;
+    }
 }
 
 static void filemanager_on_close(Window* win) {
     if (win->app_data) {
         FileManagerState* fm = (FileManagerState*)win->app_data;
         filemanager_free_app_icons(fm);
+        thumb_cancel(fm);
+        montauk::mfree(fm->entries);
+        montauk::mfree(fm->names);
         montauk::mfree(win->app_data);
         win->app_data = nullptr;
     }
@@ -1910,6 +2117,7 @@ void open_filemanager(DesktopState* ds) {
     fm->history_count = 0;
     fm->desktop = ds;
     fm->grid_view = true;
+    fm->list.init(FM_GRID_CELL_H, filemanager_draw_grid_item, fm);
 
     fm->scrollbar.init(0, 0, FM_SCROLLBAR_W, 100);
 
@@ -391,6 +391,7 @@ static Color int_to_color(int64_t v) {
 static void settings_persist(SettingsState* st) {
     DesktopSettings& s = st->desktop->settings;
     const char* user = st->desktop->current_user;
+    desktop_invalidate_background(st->desktop);
 
     montauk::toml::Doc doc;
     doc.init();
@@ -149,61 +149,233 @@ void desktop_draw_lock_screen(DesktopState* ds) {
 // Desktop Composition
 // ============================================================================
 
-void gui::desktop_compose(DesktopState* ds) {
-    Framebuffer& fb = ds->fb;
+// The screen area a window covers, shadow included
+static Rect window_extent(const Window& win) {
+    return {win.frame.x, win.frame.y, win.frame.w + SHADOW_SIZE, win.frame.h + SHADOW_SIZE};
+}
+
+static bool window_visible(const Window& win) {
+    return win.state != WIN_MINIMIZED && win.state != WIN_CLOSED;
+}
+
+// A set of disjoint screen rectangles
+struct Region {
+    static constexpr int MAX_RECTS = 32;
+    Rect rects[MAX_RECTS];
+    int count;
+};
+
+// Remove `cut` from a region. A rect that would split past MAX_RECTS is
+// kept whole, which only means painting some pixels that end up covered.
+static void region_subtract(Region& rg, const Rect& cut) {
+    Rect out[Region::MAX_RECTS];
+    int n = 0;
+    for (int i = 0; i < rg.count; i++) {
+        const Rect& r = rg.rects[i];
+        Rect ix = r.intersect(cut);
+        if (ix.empty() || n + 4 > Region::MAX_RECTS) {
+            if (!ix.empty() && ix.x == r.x && ix.y == r.y && ix.w == r.w && ix.h == r.h) continue;
+            out[n++] = r;
+            continue;
+        }
 
-    // Desktop background gradient
+        Rect pieces[4] = {
+            {r.x, r.y, r.w, ix.y - r.y},                                  // above
+            {r.x, ix.y + ix.h, r.w, r.y + r.h - (ix.y + ix.h)},           // below
+            {r.x, ix.y, ix.x - r.x, ix.h},                                // left
+            {ix.x + ix.w, ix.y, r.x + r.w - (ix.x + ix.w), ix.h},         // right
+        };
+        for (int p = 0; p < 4; p++) {
+            if (!pieces[p].empty()) out[n++] = pieces[p];
+        }
+    }
+    for (int i = 0; i < n; i++) rg.rects[i] = out[i];
+    rg.count = n;
+}
+
+// Window bodies are opaque: whatever lies under one does not show
+static void region_subtract_windows(Region& rg, const DesktopState* ds, int from) {
+    for (int j = from; j < ds->window_count && rg.count > 0; j++) {
+        if (window_visible(ds->windows[j])) region_subtract(rg, ds->windows[j].frame);
+    }
+}
+
+void gui::desktop_invalidate_background(DesktopState* ds) {
+    ds->bg_valid = false;
+    desktop_damage_all(ds);
+}
+
+// Render the background for the current settings and screen size
+static void build_background(DesktopState* ds) {
     int sw = ds->screen_w;
     int sh = ds->screen_h;
+    const DesktopSettings& s = ds->settings;
+    ds->bg_valid = true;
+    ds->bg_surface_w = sw;
+    ds->bg_surface_h = sh;
+
+    // Wallpaper covers the entire screen; panel draws on top
+    if (s.bg_image && s.bg_wallpaper && s.bg_wallpaper_w == sw && s.bg_wallpaper_h == sh) {
+        if (ds->bg_own) {
+            if (ds->bg_own_gpu) montauk::free(ds->bg_own);
+            else montauk::mfree(ds->bg_own);
+            ds->bg_own = nullptr;
+        }
+        ds->bg_surface = s.bg_wallpaper;
+        return;
+    }
+
+    // Restoring damage from it is then a blitter copy
+    if (!ds->bg_own) {
+        ds->bg_own = (uint32_t*)montauk::gpu_alloc((uint64_t)sw * sh * 4);
+        ds->bg_own_gpu = ds->bg_own != nullptr;
+        if (!ds->bg_own) ds->bg_own = (uint32_t*)montauk::malloc((uint64_t)sw * sh * 4);
+    }
+    ds->bg_surface = ds->bg_own;
+    if (!ds->bg_own) return;
+
     int grad_start = PANEL_HEIGHT;
     int grad_range = sh - grad_start;
     if (grad_range < 1) grad_range = 1;
 
-    uint32_t* buf = fb.buffer();
-    int pitch = fb.pitch();
-
     for (int y = 0; y < sh; y++) {
-        uint32_t* row = (uint32_t*)((uint8_t*)buf + y * pitch);
-        if (ds->settings.bg_image && ds->settings.bg_wallpaper) {
-            // Wallpaper covers the entire screen; panel draws on top
-            uint32_t* wp = ds->settings.bg_wallpaper + y * ds->settings.bg_wallpaper_w;
-            int cw = sw < ds->settings.bg_wallpaper_w ? sw : ds->settings.bg_wallpaper_w;
-            for (int x = 0; x < cw; x++) row[x] = wp[x];
+        uint32_t* row = ds->bg_own + (uint64_t)y * sw;
+        if (s.bg_image && s.bg_wallpaper) {
+            // A wallpaper loaded for another resolution: what overlaps
+            int cw = sw < s.bg_wallpaper_w ? sw : s.bg_wallpaper_w;
+            if (y < s.bg_wallpaper_h) pixelops::copy(row, s.bg_wallpaper + (uint64_t)y * s.bg_wallpaper_w, cw);
+            else cw = 0;
+            pixelops::fill(row + cw, s.bg_solid.to_pixel(), sw - cw);
         } else if (y < grad_start) {
             // Panel area - will be overwritten by panel drawing
-            uint32_t px = ds->settings.panel_color.to_pixel();
-            for (int x = 0; x < sw; x++) row[x] = px;
-        } else if (ds->settings.bg_gradient) {
-            int t = y - grad_start;
-            Color top = ds->settings.bg_grad_top;
-            Color bot = ds->settings.bg_grad_bottom;
-            uint8_t r = top.r - (top.r - bot.r) * t / grad_range;
-            uint8_t g = top.g - (top.g - bot.g) * t / grad_range;
-            uint8_t b = top.b - (top.b - bot.b) * t / grad_range;
-            uint32_t px = 0xFF000000 | ((uint32_t)r << 16) | ((uint32_t)g << 8) | b;
-            for (int x = 0; x < sw; x++) row[x] = px;
+            pixelops::fill(row, s.panel_color.to_pixel(), sw);
+        } else if (s.bg_gradient) {
+            Color px = pixelops::lerp(s.bg_grad_top, s.bg_grad_bottom, y - grad_start, grad_range);
+            pixelops::fill(row, px.to_pixel(), sw);
         } else {
-            uint32_t px = ds->settings.bg_solid.to_pixel();
-            for (int x = 0; x < sw; x++) row[x] = px;
+            pixelops::fill(row, s.bg_solid.to_pixel(), sw);
         }
     }
+}
+
+static void draw_background(DesktopState* ds, const Rect& r) {
+    if (!ds->bg_valid || ds->bg_surface_w != ds->screen_w || ds->bg_surface_h != ds->screen_h) {
+        build_background(ds);
+    }
+
+    Framebuffer& fb = ds->fb;
+    Rect area = r.intersect({0, 0, ds->bg_surface_w, ds->bg_surface_h});
+    if (area.w <= 0 || area.h <= 0) return;
+    if (!ds->bg_surface) {
+        fb.fill_rect(area.x, area.y, area.w, area.h, ds->settings.bg_solid);
+        return;
+    }
+
+    if (ds->bg_surface == ds->bg_own && ds->bg_own_gpu) {
+        Rect saved = fb.clip();
+        fb.set_clip(area);
+        fb.blit(0, 0, ds->bg_surface_w, ds->bg_surface_h, ds->bg_surface, true);
+        fb.set_clip(saved);
+        return;
+    }
+
+    uint32_t* buf = fb.buffer();
+    int pitch = fb.pitch();
+    for (int y = area.y; y < area.y + area.h; y++) {
+        uint32_t* row = (uint32_t*)((uint8_t*)buf + y * pitch);
+        pixelops::copy(row + area.x, ds->bg_surface + (uint64_t)y * ds->bg_surface_w + area.x, area.w);
+    }
+}
+
+// Cursor style for the pointer position: resize arrows on a window edge
+// or while resizing, or what the focused external window asks for
+static CursorStyle desktop_cursor_style(const DesktopState* ds) {
+    CursorStyle cur_style = CURSOR_ARROW;
+    for (int i = ds->window_count - 1; i >= 0; i--) {
+        const Window* win = &ds->windows[i];
+        if (win->resizing) {
+            cur_style = cursor_for_edge(win->resize_edge);
+            break;
+        }
+        if (win->state == WIN_MINIMIZED || win->state == WIN_CLOSED || win->state == WIN_MAXIMIZED)
+            continue;
+        if (win->frame.contains(ds->mouse.x, ds->mouse.y)) {
+            ResizeEdge edge = hit_test_resize_edge(win->frame, ds->mouse.x, ds->mouse.y);
+            if (edge != RESIZE_NONE) {
+                cur_style = cursor_for_edge(edge);
+            }
+            break;
+        }
+    }
+
+    // Check if focused external window requests a cursor style
+    if (cur_style == CURSOR_ARROW && ds->focused_window >= 0) {
+        const Window* fwin = &ds->windows[ds->focused_window];
+        if (fwin->external && fwin->ext_cursor > 0) {
+            Rect cr = fwin->content_rect();
+            if (cr.contains(ds->mouse.x, ds->mouse.y)) {
+                if (fwin->ext_cursor == 1) cur_style = CURSOR_RESIZE_H;
+                else if (fwin->ext_cursor == 2) cur_style = CURSOR_RESIZE_V;
+            }
+        }
+    }
+
+    return cur_style;
+}
+
+// Shows the pointer through the cursor plane, loading the style's image
+// if another one is there, or else draws it into the frame
+static void desktop_show_cursor(DesktopState* ds, CursorStyle style) {
+    if (ds->hw_cursor) {
+        if (ds->hw_cursor_style == style) return;
+        static Montauk::CursorImage image;
+        cursor_image(style, image);
+        if (montauk::cursor_set(&image) == 0) {
+            ds->hw_cursor_style = style;
+            return;
+        }
+        ds->hw_cursor = false;
+    }
+    draw_cursor(ds->fb, ds->mouse.x, ds->mouse.y, style);
+}
+
+// Draws the whole scene, but only inside the framebuffer's clip rectangle
+void gui::desktop_compose(DesktopState* ds) {
+    Framebuffer& fb = ds->fb;
+    Rect clip = fb.clip();
+    int sw = ds->screen_w;
+    int sh = ds->screen_h;
+
+    // Desktop background, except under windows
+    Region rg;
+    rg.rects[0] = clip;
+    rg.count = 1;
+    if (!ds->screen_locked) region_subtract_windows(rg, ds, 0);
+    for (int i = 0; i < rg.count; i++) {
+        draw_background(ds, rg.rects[i]);
+    }
 
     // Lock screen: draw overlay and card, then cursor, and return early
     if (ds->screen_locked) {
         desktop_draw_lock_screen(ds);
-        draw_cursor(fb, ds->mouse.x, ds->mouse.y);
+        desktop_show_cursor(ds, CURSOR_ARROW);
         return;
     }
 
-    // Draw windows from bottom to top
+    // Draw windows from bottom to top, each only where no window above
+    // covers it; hidden ones are skipped
     for (int i = 0; i < ds->window_count; i++) {
-        if (ds->windows[i].state != WIN_MINIMIZED && ds->windows[i].state != WIN_CLOSED) {
-            desktop_draw_window(ds, i);
-        }
+        if (!window_visible(ds->windows[i])) continue;
+        rg.rects[0] = window_extent(ds->windows[i]).intersect(clip);
+        rg.count = rg.rects[0].empty() ? 0 : 1;
+        region_subtract_windows(rg, ds, i + 1);
+        if (rg.count > 0) desktop_draw_window(ds, i, rg.rects, rg.count);
     }
 
     // Draw panel on top
-    desktop_draw_panel(ds);
+    if (clip.y < PANEL_HEIGHT) {
+        desktop_draw_panel(ds);
+    }
 
     // Draw app menu if open
     if (ds->app_menu_open) {
@@ -286,37 +458,252 @@ void gui::desktop_compose(DesktopState* ds) {
         }
     }
 
-    // Determine cursor style based on resize hover or active resize
-    CursorStyle cur_style = CURSOR_ARROW;
-    for (int i = ds->window_count - 1; i >= 0; i--) {
-        Window* win = &ds->windows[i];
-        if (win->resizing) {
-            cur_style = cursor_for_edge(win->resize_edge);
-            break;
+    desktop_draw_frame_stats(ds);
+
+    // Draw cursor last
+    desktop_show_cursor(ds, desktop_cursor_style(ds));
+}
+
+// ============================================================================
+// Damage
+// ============================================================================
+
+static bool desktop_overlay_open(const DesktopState* ds) {
+    return ds->screen_locked || ds->app_menu_open || ds->ctx_menu_open ||
+           ds->net_popup_open || ds->vol_popup_open;
+}
+
+static Rect rect_union(const Rect& a, const Rect& b) {
+    int x0 = a.x < b.x ? a.x : b.x;
+    int y0 = a.y < b.y ? a.y : b.y;
+    int x1 = (a.x + a.w) > (b.x + b.w) ? (a.x + a.w) : (b.x + b.w);
+    int y1 = (a.y + a.h) > (b.y + b.h) ? (a.y + a.h) : (b.y + b.h);
+    return {x0, y0, x1 - x0, y1 - y0};
+}
+
+// Adds a screen rectangle to the next frame's damage. A rect overlapping
+// one already there is merged into it; past MAX_DAMAGE rects, everything
+// collapses into one bounding box.
+void gui::desktop_add_damage(DesktopState* ds, Rect r) {
+    r = r.intersect({0, 0, ds->screen_w, ds->screen_h});
+    if (r.empty()) return;
+
+    for (int i = 0; i < ds->damage_count; i++) {
+        if (!ds->damage[i].intersect(r).empty()) {
+            ds->damage[i] = rect_union(ds->damage[i], r);
+            return;
         }
-        if (win->state == WIN_MINIMIZED || win->state == WIN_CLOSED || win->state == WIN_MAXIMIZED)
-            continue;
-        if (win->frame.contains(ds->mouse.x, ds->mouse.y)) {
-            ResizeEdge edge = hit_test_resize_edge(win->frame, ds->mouse.x, ds->mouse.y);
-            if (edge != RESIZE_NONE) {
-                cur_style = cursor_for_edge(edge);
-            }
-            break;
+    }
+
+    if (ds->damage_count == DesktopState::MAX_DAMAGE) {
+        for (int i = 1; i < ds->damage_count; i++) r = rect_union(r, ds->damage[i]);
+        ds->damage[0] = rect_union(ds->damage[0], r);
+        ds->damage_count = 1;
+        return;
+    }
+    ds->damage[ds->damage_count++] = r;
+}
+
+void gui::desktop_damage_all(DesktopState* ds) {
+    ds->damage[0] = {0, 0, ds->screen_w, ds->screen_h};
+    ds->damage_count = 1;
+}
+
+static Rect cursor_extent(int x, int y) {
+    // 16x16 bitmaps, the resize cursors centered on the hotspot
+    return {x - 8, y - 8, 24, 24};
+}
+
+// The mouse moved from (prev_x, prev_y): the cursor, and whatever shows
+// hover feedback under it, needs repainting. The cursor plane has already
+// moved with the mouse; it only needs the image for the new style.
+void gui::desktop_damage_pointer(DesktopState* ds, int prev_x, int prev_y) {
+    int x = ds->mouse.x;
+    int y = ds->mouse.y;
+    if (ds->hw_cursor) {
+        desktop_show_cursor(ds, ds->screen_locked ? CURSOR_ARROW : desktop_cursor_style(ds));
+    }
+    if (!ds->hw_cursor) {
+        desktop_add_damage(ds, cursor_extent(prev_x, prev_y));
+        desktop_add_damage(ds, cursor_extent(x, y));
+    }
+
+    if (y < PANEL_HEIGHT || prev_y < PANEL_HEIGHT) {
+        desktop_add_damage(ds, {0, 0, ds->screen_w, PANEL_HEIGHT});
+    }
+
+    // Desktop-drawn windows redraw their hover state on every compose,
+    // except one being dragged, which just moves along with the pointer
+    for (int i = 0; i < ds->window_count; i++) {
+        const Window& win = ds->windows[i];
+        if (win.external || win.dragging || !window_visible(win)) continue;
+        if (win.frame.contains(x, y) || win.frame.contains(prev_x, prev_y)) {
+            desktop_add_damage(ds, window_extent(win));
         }
     }
 
-    // Check if focused external window requests a cursor style
-    if (cur_style == CURSOR_ARROW && ds->focused_window >= 0) {
-        Window* fwin = &ds->windows[ds->focused_window];
-        if (fwin->external && fwin->ext_cursor > 0) {
-            Rect cr = fwin->content_rect();
-            if (cr.contains(ds->mouse.x, ds->mouse.y)) {
-                if (fwin->ext_cursor == 1) cur_style = CURSOR_RESIZE_H;
-                else if (fwin->ext_cursor == 2) cur_style = CURSOR_RESIZE_V;
-            }
+    // Snap preview while dragging to a screen edge
+    for (int i = 0; i < ds->window_count; i++) {
+        if (!ds->windows[i].dragging) continue;
+        int sw = ds->screen_w;
+        if (x <= 0 || x >= sw - 1 || prev_x <= 0 || prev_x >= sw - 1) {
+            desktop_damage_all(ds);
         }
+        break;
     }
+}
 
-    // Draw cursor last
-    draw_cursor(fb, ds->mouse.x, ds->mouse.y, cur_style);
+// Damage a dirty window: the rects an external app presented, or all of it
+static void desktop_damage_window_content(DesktopState* ds, const Window& win) {
+    Rect cr = win.content_rect();
+    bool scaled = cr.w != win.content_w || cr.h != win.content_h;
+    if (!win.external || win.ext_damage_count == 0 || scaled) {
+        desktop_add_damage(ds, window_extent(win));
+        return;
+    }
+    for (int d = 0; d < win.ext_damage_count; d++) {
+        const Rect& local = win.ext_damage[d];
+        desktop_add_damage(ds, Rect{cr.x + local.x, cr.y + local.y, local.w, local.h}.intersect(cr));
+    }
+}
+
+static void desktop_add_damage_region(DesktopState* ds, const Region& rg) {
+    for (int i = 0; i < rg.count; i++) desktop_add_damage(ds, rg.rects[i]);
+}
+
+// The top window only moved: scroll its pixels from the last frame to the
+// new position in the back buffer, and damage only what that leaves
+// wrong -- the uncovered area, the shadow, and any part of the window
+// that was off screen or under the panel. Returns false if the window
+// has to be repainted instead.
+static bool desktop_move_window(DesktopState* ds, const Rect& old_frame, const Window& win) {
+    if (!ds->moved.empty()) return false;
+    if (ds->damage_count == 1 && ds->damage[0].w == ds->screen_w && ds->damage[0].h == ds->screen_h) {
+        return false;
+    }
+
+    int dx = win.frame.x - old_frame.x;
+    int dy = win.frame.y - old_frame.y;
+    Rect below_panel = {0, PANEL_HEIGHT, ds->screen_w, ds->screen_h - PANEL_HEIGHT};
+    ds->moved = ds->fb.move_rect(old_frame, dx, dy, below_panel);
+
+    Region rg;
+    rg.rects[0] = {old_frame.x, old_frame.y, old_frame.w + SHADOW_SIZE, old_frame.h + SHADOW_SIZE};
+    rg.count = 1;
+    region_subtract(rg, ds->moved);
+    desktop_add_damage_region(ds, rg);
+
+    rg.rects[0] = window_extent(win);
+    rg.count = 1;
+    region_subtract(rg, ds->moved);
+    region_subtract(rg, {old_frame.x, old_frame.y, old_frame.w + SHADOW_SIZE, old_frame.h + SHADOW_SIZE});
+    desktop_add_damage_region(ds, rg);
+
+    // A software cursor drawn over the window moved with it
+    if (!ds->hw_cursor) {
+        Rect cur = cursor_extent(ds->mouse.x, ds->mouse.y);
+        desktop_add_damage(ds, {cur.x + dx, cur.y + dy, cur.w, cur.h});
+    }
+
+    // So did the frame statistics overlay, which also has to be put back
+    // over the window
+    if (ds->frame_stats.overlay) {
+        Rect st = desktop_stats_rect(ds);
+        desktop_add_damage(ds, st);
+        desktop_add_damage(ds, {st.x + dx, st.y + dy, st.w, st.h});
+    }
+
+    if (win.dirty) desktop_damage_window_content(ds, win);
+    return true;
+}
+
+// Compare the windows with the last frame: a window that moved, resized,
+// changed state or order damages where it was and where it is now, and
+// the panel's window list too unless it only moved
+void gui::desktop_damage_scene(DesktopState* ds) {
+    bool overlay = desktop_overlay_open(ds);
+    if (overlay != ds->composed_overlay) {
+        desktop_damage_all(ds);
+        return;
+    }
+
+    int count = ds->window_count > ds->composed_count ? ds->window_count : ds->composed_count;
+    for (int i = 0; i < count; i++) {
+        const ComposedWindow* old = i < ds->composed_count ? &ds->composed[i] : nullptr;
+        const Window* win = i < ds->window_count ? &ds->windows[i] : nullptr;
+
+        bool same = old && win && old->content == win->content && old->ext_win_id == win->ext_win_id &&
+                    old->state == win->state && old->focused == win->focused &&
+                    montauk::memcmp(old->title, win->title, MAX_TITLE_LEN) == 0;
+        if (same && old->frame.x == win->frame.x && old->frame.y == win->frame.y &&
+            old->frame.w == win->frame.w && old->frame.h == win->frame.h) {
+            if (win->dirty && window_visible(*win)) desktop_damage_window_content(ds, *win);
+            continue;
+        }
+
+        // Only moved, with nothing above it: no repaint, and the owning
+        // app never hears of it
+        if (same && !overlay && i == ds->window_count - 1 && window_visible(*win) &&
+            old->frame.w == win->frame.w && old->frame.h == win->frame.h &&
+            desktop_move_window(ds, old->frame, *win)) {
+            continue;
+        }
+
+        if (old && old->state != WIN_MINIMIZED && old->state != WIN_CLOSED) {
+            desktop_add_damage(ds, {old->frame.x, old->frame.y,
+                                    old->frame.w + SHADOW_SIZE, old->frame.h + SHADOW_SIZE});
+        }
+        if (win && window_visible(*win)) desktop_add_damage(ds, window_extent(*win));
+        if (!same) desktop_add_damage(ds, {0, 0, ds->screen_w, PANEL_HEIGHT});
+    }
+}
+
+static inline uint64_t rdtsc() {
+    uint32_t lo, hi;
+    asm volatile("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+// Repaint and flip the damage, then remember what the frame showed
+void gui::desktop_compose_damage(DesktopState* ds) {
+    Framebuffer& fb = ds->fb;
+    uint64_t start = rdtsc();
+
+    // Menus and popups are drawn over everything and track the mouse
+    if (desktop_overlay_open(ds) && ds->damage_count > 0) desktop_damage_all(ds);
+
+    for (int i = 0; i < ds->damage_count; i++) {
+        fb.set_clip(ds->damage[i]);
+        desktop_compose(ds);
+    }
+    fb.reset_clip();
+    uint64_t composed = rdtsc();
+    int rects = ds->damage_count;
+
+    if (ds->moved.empty()) {
+        fb.present(ds->damage, ds->damage_count);
+    } else {
+        Rect shown[DesktopState::MAX_DAMAGE + 1];
+        for (int i = 0; i < ds->damage_count; i++) shown[i] = ds->damage[i];
+        shown[ds->damage_count] = ds->moved;
+        fb.present(shown, ds->damage_count + 1);
+    }
+    uint64_t flipped = rdtsc();
+    ds->damage_count = 0;
+    ds->moved = {0, 0, 0, 0};
+
+    for (int i = 0; i < ds->window_count; i++) {
+        const Window& win = ds->windows[i];
+        ComposedWindow& c = ds->composed[i];
+        c.content = win.content;
+        c.ext_win_id = win.ext_win_id;
+        c.frame = win.frame;
+        c.state = win.state;
+        c.focused = win.focused;
+        montauk::memcpy(c.title, win.title, MAX_TITLE_LEN);
+    }
+    ds->composed_count = ds->window_count;
+    ds->composed_overlay = desktop_overlay_open(ds);
+
+    desktop_stats_frame(ds, composed - start, flipped - composed, rdtsc() - start, rects);
 }
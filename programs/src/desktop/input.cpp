@@ -769,6 +769,14 @@ void gui::desktop_handle_keyboard(DesktopState* ds, const Montauk::KeyEvent& key
             open_klog(ds);
             return;
         }
+        if (key.ascii == 'p' || key.ascii == 'P') {
+            desktop_toggle_frame_stats(ds);
+            return;
+        }
+        if (key.ascii == 'd' || key.ascii == 'D') {
+            desktop_dump_frame_stats(ds);
+            return;
+        }
     }
 
     // Dispatch to focused window
@@ -182,6 +182,8 @@ void gui::desktop_init(DesktopState* ds) {
 
     // Load TrueType fonts
     fonts::init();
+    fonts::prewarm();
+    desktop_stats_init(ds);
 
     ds->window_count = 0;
     ds->focused_window = -1;
@@ -190,6 +192,8 @@ void gui::desktop_init(DesktopState* ds) {
 
     montauk::memset(&ds->mouse, 0, sizeof(Montauk::MouseState));
     montauk::set_mouse_bounds(ds->screen_w - 1, ds->screen_h - 1);
+    ds->hw_cursor = true;
+    ds->hw_cursor_style = -1;
 
     // Load SVG icons — scalable (colorful) for app menu, symbolic for toolbar/panel
     Color defColor = colors::ICON_COLOR;
@@ -225,6 +229,13 @@ void gui::desktop_init(DesktopState* ds) {
     desktop_scan_apps(ds);
     desktop_build_menu(ds);
 
+    ds->bg_surface = nullptr;
+    ds->bg_own = nullptr;
+    ds->bg_own_gpu = false;
+    ds->bg_surface_w = 0;
+    ds->bg_surface_h = 0;
+    ds->bg_valid = false;
+
     // Settings defaults
     ds->settings.bg_gradient = true;
     ds->settings.bg_image = false;
@@ -348,15 +359,6 @@ static uint64_t desktop_clock_token() {
          | (uint64_t)dt.Minute;
 }
 
-static bool desktop_has_visible_dirty_window(const DesktopState* ds) {
-    for (int i = 0; i < ds->window_count; i++) {
-        const Window& win = ds->windows[i];
-        if (win.state == WIN_CLOSED || win.state == WIN_MINIMIZED) continue;
-        if (win.dirty) return true;
-    }
-    return false;
-}
-
 static bool desktop_has_active_interaction(const DesktopState* ds) {
     if (ds->vol_dragging) return true;
 
@@ -372,163 +374,229 @@ static bool desktop_has_active_interaction(const DesktopState* ds) {
 static void desktop_clear_window_dirty(DesktopState* ds) {
     for (int i = 0; i < ds->window_count; i++) {
         ds->windows[i].dirty = false;
+        ds->windows[i].ext_damage_count = 0;
     }
 }
 
+// Add what an external window presented to its damage. Rects only add up
+// while the window has no whole-window damage pending.
+static void desktop_add_ext_damage(Window* win, const Montauk::WinInfo& info) {
+    bool whole = info.damageCount == 0 || (win->dirty && win->ext_damage_count == 0) ||
+                 win->ext_damage_count + info.damageCount > Montauk::WinMaxDamage;
+    if (whole) {
+        win->ext_damage_count = 0;
+    } else {
+        for (int d = 0; d < info.damageCount; d++) {
+            const Montauk::WinRect& r = info.damage[d];
+            win->ext_damage[win->ext_damage_count++] = {r.x, r.y, r.w, r.h};
+        }
+    }
+    win->dirty = true;
+}
+
 static bool desktop_panel_refresh_due(const DesktopState* ds, uint64_t now) {
     if (ds->screen_locked) return false;
     return (now - ds->net_cfg_last_poll > 5000) || (now - ds->vol_last_poll > 5000);
 }
 
-bool desktop_poll_external_windows(DesktopState* ds) {
-    bool changed = false;
-    Montauk::WinInfo extWins[8];
-    int extCount = montauk::win_enumerate(extWins, 8);
+// The boot framebuffer has no vblank interrupt, so frames are paced to a
+// 60 Hz clock instead: a burst of input is coalesced into one frame
+static constexpr uint64_t DESKTOP_FRAME_MS = 16;
+
+// Windows with a poll callback are polled at least this often
+static constexpr int64_t DESKTOP_POLL_MS = 16;
+
+// Input, window changes and the wait's timeout wake the run loop
+static int desktop_create_wait_set() {
+    int epfd = montauk::epoll_create();
+    if (epfd < 0) return -1;
+    if (montauk::epoll_ctl(epfd, Montauk::EPOLL_CTL_ADD, Montauk::POLL_SRC_KEYBOARD, 0, Montauk::POLL_IN) < 0 ||
+        montauk::epoll_ctl(epfd, Montauk::EPOLL_CTL_ADD, Montauk::POLL_SRC_MOUSE, 0, Montauk::POLL_IN) < 0 ||
+        montauk::epoll_ctl(epfd, Montauk::EPOLL_CTL_ADD, Montauk::POLL_SRC_WINSERVER, 0, Montauk::POLL_IN) < 0) {
+        montauk::epoll_close(epfd);
+        return -1;
+    }
+    return epfd;
+}
 
-    // Check for new external windows and map them
-    for (int e = 0; e < extCount; e++) {
-        int extId = extWins[e].id;
+// How long the run loop may sleep before a timed update is due: the clock
+// turning to the next minute, the panel refresh, a poll callback, or the
+// frame statistics overlay
+static int64_t desktop_wait_ms(const DesktopState* ds, uint64_t now) {
+    Montauk::DateTime dt;
+    montauk::gettime(&dt);
+    int64_t wait = (int64_t)(60 - dt.Second) * 1000;
 
-        // Check if we already have this window
-        bool found = false;
-        for (int i = 0; i < ds->window_count; i++) {
-            if (ds->windows[i].external && ds->windows[i].ext_win_id == extId) {
-                found = true;
-                if (ds->windows[i].content_w != extWins[e].width ||
-                    ds->windows[i].content_h != extWins[e].height) {
-                    ds->windows[i].content_w = extWins[e].width;
-                    ds->windows[i].content_h = extWins[e].height;
-                    ds->windows[i].dirty = true;
-                    if (ds->windows[i].state != WIN_MINIMIZED && ds->windows[i].state != WIN_CLOSED) {
-                        changed = true;
-                    }
-                }
-                montauk::strncpy(ds->windows[i].title, extWins[e].title, MAX_TITLE_LEN);
-                // Update dirty flag and cursor
-                if (extWins[e].dirty) {
-                    ds->windows[i].dirty = true;
-                    if (ds->windows[i].state != WIN_MINIMIZED && ds->windows[i].state != WIN_CLOSED) {
-                        changed = true;
-                    }
-                }
-                if (ds->windows[i].ext_cursor != extWins[e].cursor) {
-                    changed = true;
-                }
-                ds->windows[i].ext_cursor = extWins[e].cursor;
-                // Always verify mapping is current. If a window slot was
-                // recycled (app exited, new app got same slot), desktopVa
-                // was zeroed and Map() returns a new VA. Detect this and
-                // update the content pointer to avoid using a stale VA.
-                uint64_t va = montauk::win_map(extId);
-                if (va != 0 && va != (uint64_t)(uintptr_t)ds->windows[i].content) {
-                    ds->windows[i].content = (uint32_t*)va;
-                    ds->windows[i].content_w = extWins[e].width;
-                    ds->windows[i].content_h = extWins[e].height;
-                    ds->windows[i].dirty = true;
-                    montauk::strncpy(ds->windows[i].title, extWins[e].title, MAX_TITLE_LEN);
-                    changed = true;
-                    // Clear from closing list if the slot was reused
-                    for (int c = 0; c < ds->closing_ext_count; c++) {
-                        if (ds->closing_ext_ids[c] == extId) {
-                            ds->closing_ext_ids[c] = ds->closing_ext_ids[--ds->closing_ext_count];
-                            break;
-                        }
-                    }
-                }
-                break;
-            }
-        }
+    if (!ds->screen_locked) {
+        uint64_t oldest = ds->net_cfg_last_poll < ds->vol_last_poll ? ds->net_cfg_last_poll : ds->vol_last_poll;
+        int64_t panel = (int64_t)(oldest + 5001) - (int64_t)now;
+        if (panel < wait) wait = panel;
 
-        if (!found && ds->window_count < MAX_WINDOWS) {
-            // Skip windows we've already sent a close event to — the owning
-            // process hasn't destroyed them yet, so they still appear in
-            // win_enumerate.  Re-creating them would place them at the
-            // default position instead of where the user dragged them.
-            bool closing = false;
-            for (int c = 0; c < ds->closing_ext_count; c++) {
-                if (ds->closing_ext_ids[c] == extId) { closing = true; break; }
-            }
-            if (closing) continue;
-
-            // Map the pixel buffer into our address space
-            uint64_t va = montauk::win_map(extId);
-            if (va == 0) continue;
-
-            int idx = ds->window_count;
-            Window* win = &ds->windows[idx];
-            montauk::memset(win, 0, sizeof(Window));
-
-            montauk::strncpy(win->title, extWins[e].title, MAX_TITLE_LEN);
-            int w = extWins[e].width;
-            int h = extWins[e].height;
-            // Position the window centered-ish
-            int wx = (ds->screen_w - w - 2 * BORDER_WIDTH) / 2 + idx * 30;
-            int wy = PANEL_HEIGHT + 20 + idx * 30;
-            win->frame = {wx, wy, w + 2 * BORDER_WIDTH, h + TITLEBAR_HEIGHT + BORDER_WIDTH};
-            win->state = WIN_NORMAL;
-            win->z_order = idx;
-            win->focused = true;
-            win->dirty = true;
-            win->dragging = false;
-            win->resizing = false;
-            win->saved_frame = win->frame;
-
-            // Point content to the shared pixel buffer
-            win->content = (uint32_t*)va;
-            win->content_w = w;
-            win->content_h = h;
-
-            win->on_draw = nullptr;
-            win->on_mouse = nullptr;
-            win->on_key = nullptr;
-            win->on_close = nullptr;
-            win->on_poll = nullptr;
-            win->app_data = nullptr;
-            win->external = true;
-            win->ext_win_id = extId;
-
-            // Unfocus previous window
-            if (ds->focused_window >= 0 && ds->focused_window < ds->window_count) {
-                ds->windows[ds->focused_window].focused = false;
+        for (int i = 0; i < ds->window_count; i++) {
+            if (ds->windows[i].on_poll && ds->windows[i].state != WIN_CLOSED && DESKTOP_POLL_MS < wait) {
+                wait = DESKTOP_POLL_MS;
             }
-            ds->focused_window = idx;
-            ds->window_count++;
-            changed = true;
         }
     }
+    int64_t stats = desktop_stats_wait_ms(ds, now);
+    if (stats < wait) wait = stats;
+    return wait > 0 ? wait : 1;
+}
 
-    // Check for removed external windows (process exited)
+// Remove the external windows a change to slot `info` retires: the
+// window that is gone, or the one whose slot a new window took over
+static bool desktop_retire_ext_windows(DesktopState* ds, const Montauk::WinInfo& info) {
+    bool changed = false;
+    int slot = info.id % Montauk::WinMaxWindows;
     for (int i = ds->window_count - 1; i >= 0; i--) {
-        if (!ds->windows[i].external) continue;
+        Window& win = ds->windows[i];
+        if (!win.external || win.ext_win_id % Montauk::WinMaxWindows != slot) continue;
+        if (win.ext_win_id == info.id && !info.closed) continue;
+        // Window gone — remove without freeing content (shared memory)
+        win.content = nullptr; // prevent free
+        gui::desktop_close_window(ds, i);
+        changed = true;
+    }
 
-        int extId = ds->windows[i].ext_win_id;
-        bool stillExists = false;
-        for (int e = 0; e < extCount; e++) {
-            if (extWins[e].id == extId) {
-                stillExists = true;
-                break;
-            }
+    // Forget closing IDs of windows the kernel has fully destroyed
+    for (int c = ds->closing_ext_count - 1; c >= 0; c--) {
+        int id = ds->closing_ext_ids[c];
+        if (id % Montauk::WinMaxWindows == slot && (id != info.id || info.closed)) {
+            ds->closing_ext_ids[c] = ds->closing_ext_ids[--ds->closing_ext_count];
         }
+    }
+    return changed;
+}
 
-        if (!stillExists) {
-            // Window gone — remove without freeing content (shared memory)
-            ds->windows[i].content = nullptr; // prevent free
-            gui::desktop_close_window(ds, i);
+static bool desktop_update_ext_window(DesktopState* ds, Window* win, const Montauk::WinInfo& info) {
+    bool changed = false;
+    if (win->content_w != info.width || win->content_h != info.height) {
+        win->content_w = info.width;
+        win->content_h = info.height;
+        win->dirty = true;
+        win->ext_damage_count = 0;
+        if (win->state != WIN_MINIMIZED && win->state != WIN_CLOSED) {
             changed = true;
         }
     }
+    montauk::strncpy(win->title, info.title, MAX_TITLE_LEN);
+    win->presents = info.presents;
+    // Update dirty flag and cursor. New content alone is not a
+    // scene change: the compositor repaints what was presented.
+    if (info.dirty) {
+        desktop_add_ext_damage(win, info);
+    }
+    if (win->ext_cursor != info.cursor) {
+        changed = true;
+    }
+    win->ext_cursor = info.cursor;
+    // A resize unmaps the old buffers from the desktop, and Map() then
+    // returns a new VA. Update the content pointer to avoid using a
+    // stale one.
+    uint64_t va = montauk::win_map(info.id);
+    if (va != 0 && va != (uint64_t)(uintptr_t)win->content) {
+        win->content = (uint32_t*)va;
+        win->dirty = true;
+        win->ext_damage_count = 0;
+        changed = true;
+    }
+    return changed;
+}
 
-    // Purge closing IDs that the kernel no longer reports (fully destroyed)
-    for (int c = ds->closing_ext_count - 1; c >= 0; c--) {
-        bool alive = false;
-        for (int e = 0; e < extCount; e++) {
-            if (extWins[e].id == ds->closing_ext_ids[c]) { alive = true; break; }
-        }
-        if (!alive) {
-            ds->closing_ext_ids[c] = ds->closing_ext_ids[--ds->closing_ext_count];
+static bool desktop_add_ext_window(DesktopState* ds, const Montauk::WinInfo& info) {
+    if (ds->window_count >= MAX_WINDOWS) return false;
+
+    // Skip windows we've already sent a close event to — the owning
+    // process hasn't destroyed them yet, so they can still change.
+    // Re-creating them would place them at the default position instead
+    // of where the user dragged them.
+    for (int c = 0; c < ds->closing_ext_count; c++) {
+        if (ds->closing_ext_ids[c] == info.id) return false;
+    }
+
+    // Map the pixel buffer into our address space
+    uint64_t va = montauk::win_map(info.id);
+    if (va == 0) return false;
+
+    int idx = ds->window_count;
+    Window* win = &ds->windows[idx];
+    montauk::memset(win, 0, sizeof(Window));
+
+    montauk::strncpy(win->title, info.title, MAX_TITLE_LEN);
+    int w = info.width;
+    int h = info.height;
+    // Position the window centered-ish, cascading
+    int wx = (ds->screen_w - w - 2 * BORDER_WIDTH) / 2 + (idx % 8) * 30;
+    int wy = PANEL_HEIGHT + 20 + (idx % 8) * 30;
+    win->frame = {wx, wy, w + 2 * BORDER_WIDTH, h + TITLEBAR_HEIGHT + BORDER_WIDTH};
+    win->state = WIN_NORMAL;
+    win->z_order = idx;
+    win->focused = true;
+    win->dirty = true;
+    win->dragging = false;
+    win->resizing = false;
+    win->saved_frame = win->frame;
+
+    // Point content to the shared pixel buffer
+    win->content = (uint32_t*)va;
+    win->content_w = w;
+    win->content_h = h;
+
+    win->on_draw = nullptr;
+    win->on_mouse = nullptr;
+    win->on_key = nullptr;
+    win->on_close = nullptr;
+    win->on_poll = nullptr;
+    win->app_data = nullptr;
+    win->external = true;
+    win->ext_win_id = info.id;
+    win->ext_cursor = info.cursor;
+    win->presents = info.presents;
+    win->presents_mark = info.presents;
+
+    // Unfocus previous window
+    if (ds->focused_window >= 0 && ds->focused_window < ds->window_count) {
+        ds->windows[ds->focused_window].focused = false;
+    }
+    ds->focused_window = idx;
+    ds->window_count++;
+    return true;
+}
+
+static constexpr int EXT_CHANGES_BATCH = 16;
+static constexpr int MOUSE_EVENTS_BATCH = 16;
+
+// Apply one batch of changes from win_changes(): new windows are mapped,
+// gone ones removed, the others take their new size, title, cursor and
+// damage
+static bool desktop_apply_ext_changes(DesktopState* ds, const Montauk::WinInfo* extWins, int extCount) {
+    bool changed = false;
+    for (int e = 0; e < extCount; e++) {
+        const Montauk::WinInfo& info = extWins[e];
+        changed |= desktop_retire_ext_windows(ds, info);
+        if (info.closed) continue;
+
+        Window* win = nullptr;
+        for (int i = 0; i < ds->window_count && win == nullptr; i++) {
+            if (ds->windows[i].external && ds->windows[i].ext_win_id == info.id) win = &ds->windows[i];
         }
+        if (win != nullptr) changed |= desktop_update_ext_window(ds, win, info);
+        else changed |= desktop_add_ext_window(ds, info);
     }
+    return changed;
+}
 
+// Apply what changed about external windows since the last call. The
+// kernel reports only the windows that changed, so idle windows cost
+// nothing per frame.
+bool desktop_poll_external_windows(DesktopState* ds) {
+    bool changed = false;
+    Montauk::WinInfo extWins[EXT_CHANGES_BATCH];
+    for (;;) {
+        int extCount = montauk::win_changes(extWins, EXT_CHANGES_BATCH);
+        changed |= desktop_apply_ext_changes(ds, extWins, extCount);
+        if (extCount < EXT_CHANGES_BATCH) break;
+    }
     return changed;
 }
 
@@ -539,26 +607,35 @@ bool desktop_poll_external_windows(DesktopState* ds) {
 void gui::desktop_run(DesktopState* ds) {
     uint64_t lastClockToken = 0;
     bool firstFrame = true;
+    bool bootMarked = false;
+    int epfd = desktop_create_wait_set();
 
     for (;;) {
         bool mouseChanged = false;
         bool keyboardChanged = false;
         bool sceneChanged = false;
 
-        // Poll mouse state
+        // Take the queued mouse events, whether keys are waiting and the
+        // window changes in one kernel entry. The kernel folds motion
+        // between two reads into one event but keeps every button change
+        // as its own, so a click shorter than a frame still arrives.
         int prevMouseX = ds->mouse.x;
         int prevMouseY = ds->mouse.y;
         uint8_t prevMouseButtons = ds->mouse.buttons;
-        ds->prev_buttons = ds->mouse.buttons;
-        montauk::mouse_state(&ds->mouse);
-        mouseChanged = ds->mouse.x != prevMouseX
-                    || ds->mouse.y != prevMouseY
-                    || ds->mouse.buttons != prevMouseButtons
-                    || ds->mouse.scrollDelta != 0;
+        Montauk::MouseEvent mouseEvents[MOUSE_EVENTS_BATCH];
+        Montauk::WinInfo extWins[EXT_CHANGES_BATCH];
+        Montauk::BatchCall calls[3] = {
+            {Montauk::SYS_MOUSEEVENTS, {(uint64_t)mouseEvents, MOUSE_EVENTS_BATCH}, 0},
+            {Montauk::SYS_ISKEYAVAILABLE, {}, 0},
+            {Montauk::SYS_WINCHANGES, {(uint64_t)extWins, EXT_CHANGES_BATCH}, 0},
+        };
+        montauk::batch(calls, 3);
+        int mouseCount = calls[0].result > 0 ? (int)calls[0].result : 0;
+        mouseChanged = mouseCount > 0;
         sceneChanged |= mouseChanged;
 
         // Poll keyboard events
-        while (montauk::is_key_available()) {
+        for (bool keyAvailable = calls[1].result > 0; keyAvailable; keyAvailable = montauk::is_key_available()) {
             Montauk::KeyEvent key;
             montauk::getkey(&key);
             desktop_handle_keyboard(ds, key);
@@ -566,8 +643,11 @@ void gui::desktop_run(DesktopState* ds) {
         }
         sceneChanged |= keyboardChanged;
 
-        // Poll external windows (discover new, remove dead, update dirty)
-        sceneChanged |= desktop_poll_external_windows(ds);
+        // Apply external window changes (discover new, remove dead, update
+        // dirty), fetching the rest if the batch did not hold them all
+        int extCount = (int)calls[2].result;
+        sceneChanged |= desktop_apply_ext_changes(ds, extWins, extCount);
+        if (extCount == EXT_CHANGES_BATCH) sceneChanged |= desktop_poll_external_windows(ds);
 
         if (!ds->screen_locked) {
             // Poll windows that have a poll callback
@@ -580,10 +660,26 @@ void gui::desktop_run(DesktopState* ds) {
             }
         }
 
-        // Handle mouse events
-        if (mouseChanged) {
+        // Handle mouse events in order, each against the state before it
+        bool clicked = false;
+        for (int m = 0; m < mouseCount; m++) {
+            const Montauk::MouseEvent& me = mouseEvents[m];
+            ds->prev_buttons = ds->mouse.buttons;
+            ds->mouse.x = me.x;
+            ds->mouse.y = me.y;
+            ds->mouse.scrollDelta = me.scroll;
+            ds->mouse.buttons = me.buttons;
+            clicked |= me.buttons != ds->prev_buttons || me.scroll != 0;
             desktop_handle_mouse(ds);
+
+            // A full batch: more may be queued behind it
+            if (m == mouseCount - 1 && mouseCount == MOUSE_EVENTS_BATCH) {
+                mouseCount = montauk::mouse_events(mouseEvents, MOUSE_EVENTS_BATCH);
+                m = -1;
+            }
         }
+        ds->prev_buttons = ds->mouse.buttons;
+        ds->mouse.scrollDelta = 0;
 
         if (!ds->screen_locked && (mouseChanged || keyboardChanged)) {
             // Re-poll external windows so that any killed during mouse/key
@@ -592,28 +688,63 @@ void gui::desktop_run(DesktopState* ds) {
         }
 
         uint64_t now = montauk::get_milliseconds();
-        sceneChanged |= desktop_panel_refresh_due(ds, now);
+        bool panelChanged = desktop_panel_refresh_due(ds, now);
+        if (desktop_stats_tick(ds, now)) {
+            desktop_add_damage(ds, desktop_stats_rect(ds));
+        }
 
         uint64_t clockToken = desktop_clock_token();
         if (clockToken != lastClockToken) {
             lastClockToken = clockToken;
-            sceneChanged = true;
+            panelChanged = true;
         }
 
-        sceneChanged |= desktop_has_visible_dirty_window(ds);
+        // Work out what to repaint. Keys and clicks can change anything
+        // the desktop draws, so they repaint the whole screen; plain
+        // pointer motion and window updates repaint just what they touch.
+        clicked |= ds->mouse.buttons != prevMouseButtons;
+        if (firstFrame || keyboardChanged || clicked) {
+            desktop_damage_all(ds);
+            firstFrame = false;
+        }
+        if (ds->mouse.x != prevMouseX || ds->mouse.y != prevMouseY || sceneChanged) {
+            desktop_damage_pointer(ds, prevMouseX, prevMouseY);
+        }
+        if (panelChanged) {
+            desktop_add_damage(ds, {0, 0, ds->screen_w, PANEL_HEIGHT});
+        }
+        desktop_damage_scene(ds);
 
-        if (firstFrame || sceneChanged) {
-            desktop_compose(ds);
-            ds->fb.flip();
+        bool composed = ds->damage_count > 0 || !ds->moved.empty();
+        if (composed) {
+            desktop_compose_damage(ds);
             desktop_clear_window_dirty(ds);
-            firstFrame = false;
+            sceneChanged = true;
+
+            if (!bootMarked) {
+                montauk::boot_mark("Desktop first frame");
+                bootMarked = true;
+            }
         }
 
-        if (desktop_has_active_interaction(ds)) {
-            montauk::sleep_ms(1);
-        } else {
-            montauk::sleep_ms(sceneChanged ? 4 : 16);
+        if (epfd < 0) {
+            // No poll set: fall back to polling
+            if (desktop_has_active_interaction(ds)) {
+                montauk::sleep_ms(1);
+            } else {
+                montauk::sleep_ms(sceneChanged ? 4 : 16);
+            }
+            continue;
+        }
+
+        // Hold off the next frame until this one's slot is over, then
+        // sleep until there is something to do
+        if (composed) {
+            uint64_t spent = montauk::get_milliseconds() - now;
+            if (spent < DESKTOP_FRAME_MS) montauk::sleep_ms(DESKTOP_FRAME_MS - spent);
         }
+        Montauk::PollEvent ready[3];
+        montauk::epoll_wait(epfd, ready, 3, desktop_wait_ms(ds, montauk::get_milliseconds()));
     }
 }
 
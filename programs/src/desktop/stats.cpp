@@ -0,0 +1,175 @@
+/*
+    * stats.cpp
+    * Compositor frame statistics: timing histogram and overlay
+    * Copyright (c) 2026 Daniel Hammer
+*/
+
+#include "desktop_internal.hpp"
+
+static constexpr int STATS_W      = 300;
+static constexpr int STATS_MARGIN = 8;
+static constexpr int STATS_PAD    = 8;
+static constexpr int STATS_WINDOWS = 16;   // Windows listed, the first ones open
+static constexpr int STATS_LINES  = 1 + FrameStats::STAGES + STATS_WINDOWS;
+
+static const char* const STAGE_NAMES[FrameStats::STAGES] = { "compose", "flip", "total" };
+
+static int stats_line_height() {
+    return system_font_height() + 2;
+}
+
+void gui::desktop_stats_init(DesktopState* ds) {
+    FrameStats& st = ds->frame_stats;
+    Montauk::SysInfo info;
+    montauk::get_info(&info);
+    st.tsc_per_us = info.tscPerUs ? info.tscPerUs : 1;
+    st.second_start = montauk::get_milliseconds();
+}
+
+void gui::desktop_stats_frame(DesktopState* ds, uint64_t compose_tsc, uint64_t flip_tsc, uint64_t total_tsc,
+                              int damage_rects) {
+    FrameStats& st = ds->frame_stats;
+    uint64_t us[FrameStats::STAGES] = {
+        compose_tsc / st.tsc_per_us, flip_tsc / st.tsc_per_us, total_tsc / st.tsc_per_us
+    };
+
+    for (int s = 0; s < FrameStats::STAGES; s++) {
+        uint64_t bucket = us[s] / FrameStats::HIST_STEP_US;
+        if (bucket >= FrameStats::HIST_BUCKETS) bucket = FrameStats::HIST_BUCKETS - 1;
+        st.hist[s][bucket]++;
+        if (us[s] > st.max_us[s]) st.max_us[s] = us[s];
+        st.second_sum_us[s] += us[s];
+        if (us[s] > st.second_max_us[s]) st.second_max_us[s] = us[s];
+    }
+    st.frames++;
+    st.second_frames++;
+
+    // The desktop's own windows present by being composed while dirty
+    int dirty = 0;
+    for (int i = 0; i < ds->window_count; i++) {
+        Window& win = ds->windows[i];
+        if (!win.dirty) continue;
+        dirty++;
+        if (!win.external) win.presents++;
+    }
+    st.dirty_windows = dirty;
+    st.damage_rects = damage_rects;
+}
+
+// Once a second, turns the counts of the second just ended into the
+// figures the overlay shows. Returns true if the overlay needs redrawing.
+bool gui::desktop_stats_tick(DesktopState* ds, uint64_t now) {
+    FrameStats& st = ds->frame_stats;
+    uint64_t elapsed = now - st.second_start;
+    if (elapsed < 1000) return false;
+
+    st.fps = (uint32_t)(st.second_frames * 1000 / elapsed);
+    for (int s = 0; s < FrameStats::STAGES; s++) {
+        st.avg_us[s] = st.second_frames ? (uint32_t)(st.second_sum_us[s] / st.second_frames) : 0;
+        st.peak_us[s] = (uint32_t)st.second_max_us[s];
+        st.second_sum_us[s] = 0;
+        st.second_max_us[s] = 0;
+    }
+    st.second_frames = 0;
+    st.second_start = now;
+
+    for (int i = 0; i < ds->window_count; i++) {
+        Window& win = ds->windows[i];
+        win.present_rate = win.presents - win.presents_mark;
+        win.presents_mark = win.presents;
+    }
+    return st.overlay;
+}
+
+int64_t gui::desktop_stats_wait_ms(const DesktopState* ds, uint64_t now) {
+    const FrameStats& st = ds->frame_stats;
+    if (!st.overlay) return INT64_MAX;
+    int64_t wait = (int64_t)(st.second_start + 1000) - (int64_t)now;
+    return wait > 0 ? wait : 1;
+}
+
+Rect gui::desktop_stats_rect(const DesktopState* ds) {
+    return {ds->screen_w - STATS_W - STATS_MARGIN, PANEL_HEIGHT + STATS_MARGIN,
+            STATS_W, STATS_LINES * stats_line_height() + 2 * STATS_PAD};
+}
+
+// Milliseconds with two decimals
+static void format_ms(char* buf, int size, uint32_t us) {
+    snprintf(buf, size, "%d.%02d", (int)(us / 1000), (int)(us % 1000 / 10));
+}
+
+void gui::desktop_draw_frame_stats(DesktopState* ds) {
+    const FrameStats& st = ds->frame_stats;
+    if (!st.overlay) return;
+
+    Framebuffer& fb = ds->fb;
+    Rect r = desktop_stats_rect(ds);
+    int lh = stats_line_height();
+    int lines = 1 + FrameStats::STAGES;
+    for (int i = 0; i < ds->window_count && lines < STATS_LINES; i++) {
+        if (ds->windows[i].state != WIN_CLOSED) lines++;
+    }
+    fb.fill_rect_alpha(r.x, r.y, r.w, lines * lh + 2 * STATS_PAD, Color::from_rgba(0, 0, 0, 0xC0));
+
+    Color fg = Color::from_rgb(0xFF, 0xFF, 0xFF);
+    Color dim = Color::from_rgb(0xB0, 0xB0, 0xB0);
+    int x = r.x + STATS_PAD;
+    int y = r.y + STATS_PAD;
+    char line[96];
+
+    snprintf(line, sizeof(line), "%d fps   %d dirty   %d rects",
+             (int)st.fps, st.dirty_windows, st.damage_rects);
+    draw_text(fb, x, y, line, fg);
+    y += lh;
+
+    for (int s = 0; s < FrameStats::STAGES; s++) {
+        char avg[16], peak[16];
+        format_ms(avg, sizeof(avg), st.avg_us[s]);
+        format_ms(peak, sizeof(peak), st.peak_us[s]);
+        snprintf(line, sizeof(line), "%s  %s ms avg  %s max", STAGE_NAMES[s], avg, peak);
+        draw_text(fb, x, y, line, fg);
+        y += lh;
+    }
+
+    for (int i = 0, shown = 0; i < ds->window_count && shown < STATS_WINDOWS; i++) {
+        const Window& win = ds->windows[i];
+        if (win.state == WIN_CLOSED) continue;
+        shown++;
+        char title[24];
+        montauk::strncpy(title, win.title, sizeof(title) - 1);
+        title[sizeof(title) - 1] = '\0';
+        snprintf(line, sizeof(line), "%s  %d/s", title, (int)win.present_rate);
+        draw_text(fb, x, y, line, dim);
+        y += lh;
+    }
+}
+
+void gui::desktop_toggle_frame_stats(DesktopState* ds) {
+    ds->frame_stats.overlay = !ds->frame_stats.overlay;
+    desktop_add_damage(ds, desktop_stats_rect(ds));
+}
+
+// Writes the histogram to the user's home directory as text: one row per
+// non-empty 500 us bucket, with the frame count of each stage
+void gui::desktop_dump_frame_stats(DesktopState* ds) {
+    const FrameStats& st = ds->frame_stats;
+    static char out[4096];
+    int len = snprintf(out, sizeof(out),
+                       "# frames %d\n# max_us compose %d flip %d total %d\n# bucket_us compose flip total\n",
+                       (int)st.frames, (int)st.max_us[0], (int)st.max_us[1], (int)st.max_us[2]);
+
+    for (int b = 0; b < FrameStats::HIST_BUCKETS && len < (int)sizeof(out) - 64; b++) {
+        if (st.hist[0][b] == 0 && st.hist[1][b] == 0 && st.hist[2][b] == 0) continue;
+        len += snprintf(out + len, sizeof(out) - len, "%d%s %d %d %d\n",
+                        b * FrameStats::HIST_STEP_US, b == FrameStats::HIST_BUCKETS - 1 ? "+" : "",
+                        (int)st.hist[0][b], (int)st.hist[1][b], (int)st.hist[2][b]);
+    }
+
+    char path[160];
+    snprintf(path, sizeof(path), "%s/frame_stats.txt", ds->home_dir);
+    montauk::fdelete(path);
+    int h = montauk::fcreate(path);
+    if (h < 0) return;
+    montauk::fwrite(h, (const uint8_t*)out, 0, len);
+    montauk::close(h);
+}
@@ -9,6 +9,7 @@
 #include <montauk/syscall.h>
 #include <montauk/string.h>
 #include <montauk/heap.h>
+#include <montauk/sync.h>
 #include <gui/gui.hpp>
 #include <gui/desktop.hpp>
 
@@ -16,19 +17,70 @@
 // We avoid including stb_image.h directly because its declaration section
 // pulls in <stdlib.h> which is unavailable in the desktop's freestanding build.
 extern "C" {
-    unsigned char* stbi_load_from_memory(const unsigned char* buffer, int len,
-                                         int* x, int* y, int* channels_in_file,
-                                         int desired_channels);
+    unsigned int* stbi_load_jpeg_argb_from_memory(const unsigned char* buffer, int len, int scale_shift,
+                                                  int rx, int ry, int rw, int rh, int* out_x0, int* out_y0,
+                                                  int* x, int* y);
+    int stbi_info_from_memory(const unsigned char* buffer, int len, int* x, int* y, int* comp);
     void stbi_image_free(void* retval_from_stbi_load);
     const char* stbi_failure_reason(void);
 }
 
 namespace gui {
 
+// stb_image allocates from the libc heap, which is not thread-safe. The
+// file manager decodes thumbnails on a worker thread, so every call into
+// stb_image (loads and frees alike) holds this lock.
+inline montauk::Mutex stbi_lock;
+
 // ============================================================================
 // Wallpaper loading
 // ============================================================================
 
+// The JPEG decode scale (1 / (1 << shift)) for an img_w x img_h image
+// whose cover crop must still fill dst_w x dst_h pixels
+inline int wallpaper_scale_shift(int img_w, int img_h, int dst_w, int dst_h) {
+    int crop_w = img_w, crop_h = img_h;
+    if ((int64_t)img_w * dst_h > (int64_t)img_h * dst_w) crop_w = (int)((int64_t)img_h * dst_w / dst_h);
+    else crop_h = (int)((int64_t)img_w * dst_h / dst_w);
+
+    int shift = 0;
+    while (shift < 3 && (crop_w >> (shift + 1)) >= dst_w && (crop_h >> (shift + 1)) >= dst_h) shift++;
+    return shift;
+}
+
+// Nearest-neighbour scale of ARGB pixels to cover dst_w x dst_h, cropping
+// the middle of whichever dimension is too long
+inline void wallpaper_scale_cover(const uint32_t* src, int img_w, int img_h,
+                                  uint32_t* dst, int dst_w, int dst_h) {
+    int src_crop_w, src_crop_h, src_x0, src_y0;
+    if ((int64_t)img_w * dst_h > (int64_t)img_h * dst_w) {
+        // Image is wider — crop sides
+        src_crop_h = img_h;
+        src_crop_w = (int)((int64_t)img_h * dst_w / dst_h);
+        src_x0 = (img_w - src_crop_w) / 2;
+        src_y0 = 0;
+    } else {
+        // Image is taller — crop top/bottom
+        src_crop_w = img_w;
+        src_crop_h = (int)((int64_t)img_w * dst_h / dst_w);
+        src_x0 = 0;
+        src_y0 = (img_h - src_crop_h) / 2;
+    }
+
+    for (int y = 0; y < dst_h; y++) {
+        int sy = src_y0 + (int)((int64_t)y * src_crop_h / dst_h);
+        if (sy < 0) sy = 0;
+        if (sy >= img_h) sy = img_h - 1;
+        const uint32_t* row = src + (int64_t)sy * img_w;
+        for (int x = 0; x < dst_w; x++) {
+            int sx = src_x0 + (int)((int64_t)x * src_crop_w / dst_w);
+            if (sx < 0) sx = 0;
+            if (sx >= img_w) sx = img_w - 1;
+            dst[(int64_t)y * dst_w + x] = row[sx] | 0xFF000000u;
+        }
+    }
+}
+
 // Load a JPEG file and scale it to cover the given screen dimensions.
 // Stores the scaled ARGB pixel buffer in settings.  Returns true on success.
 inline bool wallpaper_load(DesktopSettings* s, const char* path,
@@ -58,54 +110,35 @@ inline bool wallpaper_load(DesktopSettings* s, const char* path,
     montauk::close(fd);
     if (bytes_read <= 0) { montauk::mfree(filedata); return false; }
 
-    // Decode JPEG
+    // Decode JPEG, at the smallest of 1/1 .. 1/8 scale that still covers
+    // the screen: the reduced IDCT skips most of the work for large photos
+    int dst_w = screen_w;
+    int dst_h = screen_h;
     int img_w, img_h, channels;
-    unsigned char* rgb = stbi_load_from_memory(filedata, bytes_read,
-                                               &img_w, &img_h, &channels, 3);
+    uint32_t* argb = nullptr;
+    stbi_lock.lock();
+    if (stbi_info_from_memory(filedata, bytes_read, &img_w, &img_h, &channels)) {
+        int shift = wallpaper_scale_shift(img_w, img_h, dst_w, dst_h);
+        argb = (uint32_t*)stbi_load_jpeg_argb_from_memory(filedata, bytes_read, shift, 0, 0, 0, 0,
+                                                          nullptr, nullptr, &img_w, &img_h);
+    }
+    stbi_lock.unlock();
     montauk::mfree(filedata);
-    if (!rgb) return false;
+    if (!argb) return false;
 
     // Scale to cover screen (crop to fill, maintain aspect ratio)
-    int dst_w = screen_w;
-    int dst_h = screen_h;
-
     uint32_t* scaled = (uint32_t*)montauk::malloc((uint64_t)dst_w * dst_h * 4);
-    if (!scaled) { stbi_image_free(rgb); return false; }
-
-    // Compute source crop region for "cover" scaling
-    int src_crop_w, src_crop_h, src_x0, src_y0;
-    if ((int64_t)img_w * dst_h > (int64_t)img_h * dst_w) {
-        // Image is wider — crop sides
-        src_crop_h = img_h;
-        src_crop_w = (int)((int64_t)img_h * dst_w / dst_h);
-        src_x0 = (img_w - src_crop_w) / 2;
-        src_y0 = 0;
-    } else {
-        // Image is taller — crop top/bottom
-        src_crop_w = img_w;
-        src_crop_h = (int)((int64_t)img_w * dst_h / dst_w);
-        src_x0 = 0;
-        src_y0 = (img_h - src_crop_h) / 2;
-    }
-
-    // Nearest-neighbor scale from cropped region to destination
-    for (int y = 0; y < dst_h; y++) {
-        int sy = src_y0 + (int)((int64_t)y * src_crop_h / dst_h);
-        if (sy < 0) sy = 0;
-        if (sy >= img_h) sy = img_h - 1;
-        for (int x = 0; x < dst_w; x++) {
-            int sx = src_x0 + (int)((int64_t)x * src_crop_w / dst_w);
-            if (sx < 0) sx = 0;
-            if (sx >= img_w) sx = img_w - 1;
-            int si = (sy * img_w + sx) * 3;
-            scaled[y * dst_w + x] = 0xFF000000u
-                | ((uint32_t)rgb[si] << 16)
-                | ((uint32_t)rgb[si + 1] << 8)
-                | (uint32_t)rgb[si + 2];
-        }
+    if (!scaled) {
+        stbi_lock.lock();
+        stbi_image_free(argb);
+        stbi_lock.unlock();
+        return false;
     }
+    wallpaper_scale_cover(argb, img_w, img_h, scaled, dst_w, dst_h);
 
-    stbi_image_free(rgb);
+    stbi_lock.lock();
+    stbi_image_free(argb);
+    stbi_lock.unlock();
 
     s->bg_wallpaper   = scaled;
     s->bg_wallpaper_w = dst_w;
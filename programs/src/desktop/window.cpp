@@ -75,6 +75,10 @@ void gui::desktop_close_window(DesktopState* ds, int idx) {
         montauk::free(win->content);
         win->content = nullptr;
     }
+    if (win->chrome) {
+        montauk::free(win->chrome);
+        win->chrome = nullptr;
+    }
 
     // Shift remaining windows down
     for (int i = idx; i < ds->window_count - 1; i++) {
@@ -121,11 +125,53 @@ void gui::desktop_raise_window(DesktopState* ds, int idx) {
     ds->windows[ds->focused_window].focused = true;
 }
 
-void gui::desktop_draw_window(DesktopState* ds, int idx) {
-    if (idx < 0 || idx >= ds->window_count) return;
-    Window* win = &ds->windows[idx];
-    if (win->state == WIN_MINIMIZED || win->state == WIN_CLOSED) return;
+// Render the title bar, with its part of the border, into win->chrome
+// unless the cached one still matches the window
+static void desktop_update_chrome(Window* win) {
+    int w = win->frame.w;
+    if (win->chrome && win->chrome_w == w && win->chrome_focused == win->focused &&
+        win->chrome_font_size == fonts::UI_SIZE && montauk::streq(win->chrome_title, win->title))
+        return;
 
+    if (!win->chrome || win->chrome_w != w) {
+        if (win->chrome) montauk::free(win->chrome);
+        win->chrome = (uint32_t*)montauk::alloc((uint64_t)w * TITLEBAR_HEIGHT * 4);
+        if (!win->chrome) return;
+    }
+    win->chrome_w = w;
+    win->chrome_focused = win->focused;
+    win->chrome_font_size = fonts::UI_SIZE;
+    montauk::strncpy(win->chrome_title, win->title, MAX_TITLE_LEN);
+
+    Canvas c(win->chrome, w, TITLEBAR_HEIGHT);
+    Color tb_bg = win->focused ? colors::TITLEBAR_BG : Color::from_rgb(0xE8, 0xE8, 0xE8);
+    c.fill(tb_bg);
+
+    // Border, and the titlebar bottom separator
+    c.hline(0, 0, w, colors::BORDER);
+    c.vline(0, 0, TITLEBAR_HEIGHT, colors::BORDER);
+    c.vline(w - 1, 0, TITLEBAR_HEIGHT, colors::BORDER);
+    c.hline(0, TITLEBAR_HEIGHT - 1, w, colors::BORDER);
+
+    // Window buttons (macOS style: close, minimize, maximize)
+    int by = (TITLEBAR_HEIGHT - BTN_RADIUS * 2) / 2 + BTN_RADIUS;
+    c.fill_circle(12 + BTN_RADIUS, by, BTN_RADIUS, colors::CLOSE_BTN);
+    c.fill_circle(12 + 22 + BTN_RADIUS, by, BTN_RADIUS, colors::MIN_BTN);
+    c.fill_circle(12 + 44 + BTN_RADIUS, by, BTN_RADIUS, colors::MAX_BTN);
+
+    // Title text centered in the space after the buttons
+    int title_x = 12 + 44 + BTN_RADIUS * 2 + 12;
+    int title_y = (TITLEBAR_HEIGHT - system_font_height()) / 2;
+    int title_w = text_width(win->title);
+    int remaining_w = w - title_x - 12;
+    if (remaining_w > title_w) {
+        title_x += (remaining_w - title_w) / 2;
+    }
+    c.text(title_x, title_y, win->title, colors::TEXT_COLOR);
+}
+
+// Paint a window within the framebuffer's clip rectangle
+static void desktop_draw_window_part(DesktopState* ds, Window* win) {
     Framebuffer& fb = ds->fb;
     int x = win->frame.x;
     int y = win->frame.y;
@@ -136,74 +182,56 @@ void gui::desktop_draw_window(DesktopState* ds, int idx) {
     if (ds->settings.show_shadows)
         draw_shadow(fb, x, y, w, h, SHADOW_SIZE, colors::SHADOW);
 
-    // Draw window body
-    fb.fill_rect(x, y, w, h, colors::WINDOW_BG);
-
-    // Draw titlebar
-    Color tb_bg = win->focused ? colors::TITLEBAR_BG : Color::from_rgb(0xE8, 0xE8, 0xE8);
-    fb.fill_rect(x, y, w, TITLEBAR_HEIGHT, tb_bg);
-
-    // Draw border
-    draw_rect(fb, x, y, w, h, colors::BORDER);
-    // Titlebar bottom separator
-    draw_hline(fb, x, y + TITLEBAR_HEIGHT - 1, w, colors::BORDER);
-
-    // Draw window buttons (macOS style: close, minimize, maximize)
-    Rect close_r = win->close_btn_rect();
-    Rect min_r = win->min_btn_rect();
-    Rect max_r = win->max_btn_rect();
+    // Title bar from the cache
+    if (win->chrome) fb.blit(x, y, w, TITLEBAR_HEIGHT, win->chrome);
+    else fb.fill_rect(x, y, w, TITLEBAR_HEIGHT, colors::TITLEBAR_BG);
 
-    fill_circle(fb, close_r.x + BTN_RADIUS, close_r.y + BTN_RADIUS, BTN_RADIUS, colors::CLOSE_BTN);
-    fill_circle(fb, min_r.x + BTN_RADIUS, min_r.y + BTN_RADIUS, BTN_RADIUS, colors::MIN_BTN);
-    fill_circle(fb, max_r.x + BTN_RADIUS, max_r.y + BTN_RADIUS, BTN_RADIUS, colors::MAX_BTN);
+    // Body border
+    draw_vline(fb, x, y + TITLEBAR_HEIGHT, h - TITLEBAR_HEIGHT, colors::BORDER);
+    draw_vline(fb, x + w - 1, y + TITLEBAR_HEIGHT, h - TITLEBAR_HEIGHT, colors::BORDER);
+    draw_hline(fb, x, y + h - 1, w, colors::BORDER);
 
-    // Draw title text centered in titlebar (after buttons)
-    int title_x = x + 12 + 44 + BTN_RADIUS * 2 + 12; // after buttons
-    int title_y = y + (TITLEBAR_HEIGHT - system_font_height()) / 2;
-    int title_w = text_width(win->title);
-    // Center in remaining space
-    int remaining_w = w - (title_x - x) - 12;
-    if (remaining_w > title_w) {
-        title_x += (remaining_w - title_w) / 2;
-    }
-    draw_text(fb, title_x, title_y, win->title, colors::TEXT_COLOR);
-
-    // Call app draw callback to render content (skip during resize — buffer is old size)
-    if (win->on_draw && !win->resizing) {
-        win->on_draw(win, fb);
-    }
-
-    // Blit content buffer to framebuffer (clip to actual buffer size during resize)
+    // Blit content buffer to framebuffer (clip to actual buffer size during resize),
+    // filling whatever part of the content area it leaves uncovered
     Rect cr = win->content_rect();
-    if (win->content) {
+    if (!win->content) {
+        fb.fill_rect(cr.x, cr.y, cr.w, cr.h, colors::WINDOW_BG);
+    } else {
         if (win->external && (cr.w != win->content_w || cr.h != win->content_h)) {
             // Nearest-neighbor scale for external windows (fixed-size shared buffer)
-            int src_w = win->content_w;
-            int src_h = win->content_h;
-            int dst_w = cr.w;
-            int dst_h = cr.h;
-            uint32_t* buf = fb.buffer();
-            int pitch = fb.pitch();
-            for (int y = 0; y < dst_h; y++) {
-                int dy = cr.y + y;
-                if (dy < 0 || dy >= fb.height()) continue;
-                int sy = y * src_h / dst_h;
-                uint32_t* dst_row = (uint32_t*)((uint8_t*)buf + dy * pitch);
-                uint32_t* src_row = win->content + sy * src_w;
-                for (int x = 0; x < dst_w; x++) {
-                    int dx = cr.x + x;
-                    if (dx < 0 || dx >= fb.width()) continue;
-                    dst_row[dx] = src_row[x * src_w / dst_w];
-                }
-            }
+            fb.blit_scaled(cr.x, cr.y, cr.w, cr.h, win->content, win->content_w, win->content_h);
         } else {
             int blit_w = cr.w < win->content_w ? cr.w : win->content_w;
             int blit_h = cr.h < win->content_h ? cr.h : win->content_h;
-            fb.blit(cr.x, cr.y, blit_w, blit_h, win->content);
+            fb.blit(cr.x, cr.y, blit_w, blit_h, win->content, win->external);
+            fb.fill_rect(cr.x + blit_w, cr.y, cr.w - blit_w, blit_h, colors::WINDOW_BG);
+            fb.fill_rect(cr.x, cr.y + blit_h, cr.w, cr.h - blit_h, colors::WINDOW_BG);
         }
     }
 }
 
+void gui::desktop_draw_window(DesktopState* ds, int idx, const Rect* visible, int visible_count) {
+    if (idx < 0 || idx >= ds->window_count) return;
+    Window* win = &ds->windows[idx];
+    if (win->state == WIN_MINIMIZED || win->state == WIN_CLOSED) return;
+
+    // Call app draw callback to render content (skip during resize — buffer is old size)
+    if (win->on_draw && !win->resizing) {
+        win->on_draw(win, ds->fb);
+    }
+
+    if (visible_count > 0) desktop_update_chrome(win);
+
+    // Paint only the parts no window above covers
+    Framebuffer& fb = ds->fb;
+    Rect clip = fb.clip();
+    for (int i = 0; i < visible_count; i++) {
+        fb.set_clip(visible[i]);
+        desktop_draw_window_part(ds, win);
+    }
+    fb.set_clip(clip);
+}
+
 gui::ResizeEdge hit_test_resize_edge(const gui::Rect& f, int mx, int my) {
     using namespace gui;
     int G = RESIZE_GRAB;
@@ -191,14 +191,7 @@ extern "C" void _start() {
         g_state.collapsed[i] = false;
 
     // Load font
-    {
-        TrueTypeFont* f = (TrueTypeFont*)montauk::malloc(sizeof(TrueTypeFont));
-        if (f) {
-            montauk::memset(f, 0, sizeof(TrueTypeFont));
-            if (!f->init("0:/fonts/Roboto-Medium.ttf")) { montauk::mfree(f); f = nullptr; }
-        }
-        g_font = f;
-    }
+    g_font = fonts::open("0:/fonts/Roboto-Medium.ttf");
 
     // Initial device poll
     g_state.dev_count = montauk::devlist(g_state.devs, MAX_DEVS);
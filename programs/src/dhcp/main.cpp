@@ -261,6 +261,7 @@ struct DhcpOffer {
     uint32_t subnetMask;
     uint32_t router;
     uint32_t dns;
+    uint32_t dns2;
     uint32_t leaseTime;
     uint8_t  msgType;
     bool     valid;
@@ -272,6 +273,7 @@ static void parse_options(const DhcpPacket* pkt, DhcpOffer* offer) {
     offer->subnetMask = 0;
     offer->router     = 0;
     offer->dns        = 0;
+    offer->dns2       = 0;
     offer->leaseTime  = 0;
     offer->msgType    = 0;
     offer->valid      = false;
@@ -304,6 +306,7 @@ static void parse_options(const DhcpPacket* pkt, DhcpOffer* offer) {
             break;
         case OPT_DNS:
             if (len >= 4) memcpy(&offer->dns, &pkt->options[off], 4);
+            if (len >= 8) memcpy(&offer->dns2, &pkt->options[off + 4], 4);
             break;
         case OPT_SERVER_ID:
             if (len >= 4) memcpy(&offer->serverId, &pkt->options[off], 4);
@@ -464,6 +467,7 @@ extern "C" void _start() {
     newCfg.subnetMask = offer.subnetMask;
     newCfg.gateway    = offer.router;
     newCfg.dnsServer  = offer.dns;
+    newCfg.dnsServer2 = offer.dns2;
     montauk::set_netcfg(&newCfg);
 
     // 9. Print results
@@ -487,6 +491,12 @@ extern "C" void _start() {
         montauk::print(msg);
     }
 
+    if (offer.dns2 != 0) {
+        format_ip(ipStr, sizeof(ipStr), offer.dns2);
+        snprintf(msg, sizeof(msg), "  DNS Server:  %s\n", ipStr);
+        montauk::print(msg);
+    }
+
     if (offer.leaseTime != 0) {
         snprintf(msg, sizeof(msg), "  Lease Time:  %u seconds\n", offer.leaseTime);
         montauk::print(msg);
@@ -0,0 +1,387 @@
+/*
+ * bench.cpp
+ * MontaukOS Disk Tool — storage benchmark
+ * Copyright (c) 2026 Daniel Hammer
+ */
+
+#include "disks.h"
+
+// ============================================================================
+// Test table
+// ============================================================================
+
+struct RawTest {
+    const char* name;
+    uint32_t flags;         // Montauk::DISKBENCH_*
+    uint32_t block_bytes;
+    uint32_t depth;
+};
+
+static const RawTest g_rawTests[BENCH_RAW_TESTS] = {
+    { "Seq read 128K Q8",  0,                                                   128 * 1024, 8 },
+    { "Seq write 128K Q8", Montauk::DISKBENCH_WRITE,                            128 * 1024, 8 },
+    { "4K read Q1",        Montauk::DISKBENCH_RANDOM,                           4096, 1 },
+    { "4K read Q4",        Montauk::DISKBENCH_RANDOM,                           4096, 4 },
+    { "4K read Q16",       Montauk::DISKBENCH_RANDOM,                           4096, 16 },
+    { "4K read Q32",       Montauk::DISKBENCH_RANDOM,                           4096, 32 },
+    { "4K write Q1",       Montauk::DISKBENCH_RANDOM | Montauk::DISKBENCH_WRITE, 4096, 1 },
+    { "4K write Q4",       Montauk::DISKBENCH_RANDOM | Montauk::DISKBENCH_WRITE, 4096, 4 },
+    { "4K write Q16",      Montauk::DISKBENCH_RANDOM | Montauk::DISKBENCH_WRITE, 4096, 16 },
+    { "4K write Q32",      Montauk::DISKBENCH_RANDOM | Montauk::DISKBENCH_WRITE, 4096, 32 },
+};
+
+enum { FS_SEQ_WRITE = 0, FS_SEQ_READ, FS_RAND_READ, FS_RAND_WRITE };
+
+static const char* const g_fsTests[BENCH_FS_TESTS] = {
+    "FS seq write 1M", "FS seq read 1M", "FS 4K read Q1", "FS 4K write Q1"
+};
+
+static constexpr uint64_t FS_FILE_BYTES  = 32ULL * 1024 * 1024;
+static constexpr uint32_t FS_CHUNK_BYTES = 1024 * 1024;
+static constexpr uint32_t FS_RAND_BYTES  = 4096;
+
+// Smallest unpartitioned region worth writing to
+static constexpr uint64_t MIN_FREE_BYTES = 1024 * 1024;
+
+// Both copies of the GPT
+static constexpr uint64_t GPT_SECTORS = 34;
+
+const char* bench_test_name(int test) {
+    if (test < BENCH_RAW_TESTS) return g_rawTests[test].name;
+    return g_fsTests[test - BENCH_RAW_TESTS];
+}
+
+// ============================================================================
+// Helpers
+// ============================================================================
+
+static inline uint64_t rdtsc() {
+    uint32_t lo, hi;
+    asm volatile("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+static uint64_t g_rng = 0x9E3779B97F4A7C15ULL;
+
+static uint64_t next_random() {
+    g_rng ^= g_rng >> 12;
+    g_rng ^= g_rng << 25;
+    g_rng ^= g_rng >> 27;
+    return g_rng * 0x2545F4914F6CDD1DULL;
+}
+
+// Largest unpartitioned region of the disk, clear of the GPT. Returns
+// false if there is none worth benchmarking.
+static bool largest_free_region(const Montauk::DiskInfo& disk, uint64_t& start, uint64_t& count) {
+    if (disk.sectorCount <= GPT_SECTORS * 2) return false;
+    uint64_t first = GPT_SECTORS;
+    uint64_t end = disk.sectorCount - (GPT_SECTORS - 1);
+    count = 0;
+
+    // Walk the partitions in LBA order, looking at the gap before each
+    uint64_t cursor = first;
+    while (cursor < end) {
+        uint64_t next_start = end, next_end = end;
+        for (int i = 0; i < g_state.part_count; i++) {
+            const Montauk::PartInfo& p = g_state.parts[i];
+            if (p.blockDev != disk.port || p.endLba < cursor) continue;
+            if (p.startLba < next_start) {
+                next_start = p.startLba < cursor ? cursor : p.startLba;
+                next_end = p.endLba + 1;
+            }
+        }
+        if (next_start - cursor > count) {
+            start = cursor;
+            count = next_start - cursor;
+        }
+        cursor = next_end;
+    }
+
+    return count * disk.sectorSizeLog >= MIN_FREE_BYTES;
+}
+
+static bool has_gpt(const Montauk::DiskInfo& disk) {
+    if (disk.sectorSizeLog < 512 || disk.sectorSizeLog > 4096) return false;
+    uint8_t* sector = (uint8_t*)montauk::malloc(disk.sectorSizeLog);
+    if (!sector) return false;
+    bool found = montauk::disk_read(disk.port, 1, 1, sector) > 0 &&
+                 montauk::memcmp(sector, "EFI PART", 8) == 0;
+    montauk::mfree(sector);
+    return found;
+}
+
+// Latencies in log-linear buckets, eight per power of two, as the kernel
+// keeps them for SYS_DISKBENCH
+struct LatencyHistogram {
+    static constexpr int SUB = 8;
+    static constexpr int BUCKETS = 64 * SUB;
+    uint32_t counts[BUCKETS];
+    uint64_t total, min, max, ops;
+
+    void reset() {
+        montauk::memset(this, 0, sizeof(*this));
+        min = ~0ULL;
+    }
+
+    void add(uint64_t ns) {
+        int b;
+        if (ns < SUB) {
+            b = (int)ns;
+        } else {
+            int octave = 63 - __builtin_clzll(ns);
+            b = (octave - 2) * SUB + ((int)(ns >> (octave - 3)) & (SUB - 1));
+        }
+        counts[b]++;
+        total += ns;
+        ops++;
+        if (ns < min) min = ns;
+        if (ns > max) max = ns;
+    }
+
+    uint64_t percentile(uint64_t per_mille) const {
+        uint64_t rank = (ops * per_mille + 999) / 1000;
+        if (rank == 0) rank = 1;
+        uint64_t seen = 0;
+        for (int b = 0; b < BUCKETS; b++) {
+            seen += counts[b];
+            if (seen < rank) continue;
+            if (b < SUB) return (uint64_t)b;
+            int octave = b / SUB + 2;
+            uint64_t top = (((uint64_t)SUB + b % SUB + 1) << (octave - 3)) - 1;
+            return top < max ? top : max;
+        }
+        return max;
+    }
+
+    void fill(Montauk::DiskBenchResult& r) const {
+        if (ops == 0) return;
+        r.avgNs = total / ops;
+        r.minNs = min;
+        r.p50Ns = percentile(500);
+        r.p90Ns = percentile(900);
+        r.p99Ns = percentile(990);
+        r.p999Ns = percentile(999);
+        r.maxNs = max;
+    }
+};
+
+static LatencyHistogram g_hist;
+
+// ============================================================================
+// Filesystem tests
+// ============================================================================
+
+static void fs_path(char* buf, int size) {
+    snprintf(buf, size, "%d:/diskbench.tmp", g_state.bench.fs_drive);
+}
+
+static void fs_run(int test, BenchRow& row) {
+    char path[32];
+    fs_path(path, sizeof(path));
+
+    uint8_t* buf = (uint8_t*)montauk::malloc(FS_CHUNK_BYTES);
+    if (!buf) {
+        row.outcome = BENCH_FAILED;
+        row.note = "Out of memory";
+        return;
+    }
+    montauk::memset(buf, 0xA5, FS_CHUNK_BYTES);
+
+    int h = test == FS_SEQ_WRITE ? montauk::fcreate(path) : montauk::open(path);
+    if (h < 0) {
+        montauk::mfree(buf);
+        row.outcome = BENCH_FAILED;
+        row.note = test == FS_SEQ_WRITE ? "Cannot create file" : "Scratch file missing";
+        return;
+    }
+
+    g_hist.reset();
+    Montauk::DiskBenchResult& r = row.result;
+    montauk::memset(&r, 0, sizeof(r));
+    r.depth = 1;
+    r.blockBytes = test <= FS_SEQ_READ ? FS_CHUNK_BYTES : FS_RAND_BYTES;
+
+    uint64_t file_blocks = FS_FILE_BYTES / FS_RAND_BYTES;
+    uint64_t start_ms = montauk::get_milliseconds();
+    uint64_t start_tsc = rdtsc();
+    uint64_t deadline = start_ms + BENCH_MS;
+    uint64_t offset = 0;
+    bool ok = true;
+
+    while (ok) {
+        if (test <= FS_SEQ_READ) {
+            if (offset >= FS_FILE_BYTES) break;
+        } else if (montauk::get_milliseconds() >= deadline) {
+            break;
+        }
+
+        uint64_t off = test <= FS_SEQ_READ ? offset : (next_random() % file_blocks) * FS_RAND_BYTES;
+        uint64_t t0 = rdtsc();
+        int n;
+        if (test == FS_SEQ_WRITE || test == FS_RAND_WRITE) {
+            n = montauk::fwrite(h, buf, off, r.blockBytes);
+        } else {
+            n = montauk::read(h, buf, off, r.blockBytes);
+        }
+        if (n != (int)r.blockBytes) {
+            ok = false;
+            break;
+        }
+        g_hist.add(rdtsc() - t0);   // TSC ticks for now, scaled below
+        offset += r.blockBytes;
+    }
+
+    uint64_t elapsed_ms = montauk::get_milliseconds() - start_ms;
+    uint64_t elapsed_tsc = rdtsc() - start_tsc;
+    montauk::close(h);
+    montauk::mfree(buf);
+
+    if (!ok) {
+        row.outcome = BENCH_FAILED;
+        row.note = "I/O error";
+        return;
+    }
+
+    // Calibrate the TSC against the millisecond clock over the whole run
+    Montauk::DiskBenchResult ticks = {};
+    g_hist.fill(ticks);
+    uint64_t tsc_per_us = elapsed_ms ? elapsed_tsc / (elapsed_ms * 1000) : 0;
+    if (tsc_per_us == 0) tsc_per_us = 1;
+    auto to_ns = [&](uint64_t t) { return t * 1000 / tsc_per_us; };
+
+    r.ops = g_hist.ops;
+    r.bytes = g_hist.ops * r.blockBytes;
+    r.elapsedUs = elapsed_ms * 1000;
+    r.avgNs = to_ns(ticks.avgNs);
+    r.minNs = to_ns(ticks.minNs);
+    r.p50Ns = to_ns(ticks.p50Ns);
+    r.p90Ns = to_ns(ticks.p90Ns);
+    r.p99Ns = to_ns(ticks.p99Ns);
+    r.p999Ns = to_ns(ticks.p999Ns);
+    r.maxNs = to_ns(ticks.maxNs);
+    row.outcome = BENCH_DONE;
+}
+
+// ============================================================================
+// Raw tests
+// ============================================================================
+
+static void raw_run(int test, BenchRow& row) {
+    const Montauk::DiskInfo& disk = g_state.disks[g_state.bench.disk];
+    const RawTest& t = g_rawTests[test];
+
+    Montauk::DiskBenchParams params;
+    montauk::memset(&params, 0, sizeof(params));
+    params.blockDev = disk.port;
+    params.flags = t.flags;
+    params.blockBytes = t.block_bytes;
+    params.depth = t.depth;
+    params.durationMs = BENCH_MS;
+    params.startLba = 0;
+    params.sectorCount = disk.sectorCount;
+
+    if (t.flags & Montauk::DISKBENCH_WRITE) {
+        if (!has_gpt(disk)) {
+            row.outcome = BENCH_SKIPPED;
+            row.note = "Writes need a GPT disk";
+            return;
+        }
+        if (!largest_free_region(disk, params.startLba, params.sectorCount)) {
+            row.outcome = BENCH_SKIPPED;
+            row.note = "No unpartitioned space";
+            return;
+        }
+    }
+
+    if (montauk::disk_bench(&params, &row.result) < 0) {
+        row.outcome = BENCH_FAILED;
+        row.note = "Benchmark refused";
+        return;
+    }
+    if (row.result.errors > 0) {
+        row.outcome = BENCH_FAILED;
+        row.note = "I/O error";
+        return;
+    }
+    row.outcome = BENCH_DONE;
+}
+
+// ============================================================================
+// Driver
+// ============================================================================
+
+void bench_start() {
+    auto& dt = g_state;
+    auto& b = dt.bench;
+    if (dt.selected_disk < 0 || dt.selected_disk >= dt.disk_count) return;
+
+    montauk::memset(&b, 0, sizeof(b));
+    b.running = true;
+    b.disk = dt.selected_disk;
+    b.next = 0;
+    g_rng ^= rdtsc();
+
+    // FS tests use the selected partition, or the first mounted one
+    int part_indices[MAX_PARTS];
+    int nparts = get_disk_parts(part_indices, MAX_PARTS);
+    b.fs_drive = -1;
+    if (dt.selected_part >= 0 && dt.selected_part < nparts) {
+        b.fs_drive = dt.parts[part_indices[dt.selected_part]].drive;
+    }
+    for (int i = 0; i < nparts && b.fs_drive < 0; i++) {
+        b.fs_drive = dt.parts[part_indices[i]].drive;
+    }
+
+    char msg[80];
+    snprintf(msg, sizeof(msg), "Running %s...", bench_test_name(0));
+    set_status(msg);
+}
+
+void bench_stop() {
+    auto& b = g_state.bench;
+    if (!b.running) return;
+    b.running = false;
+    if (b.fs_drive >= 0) {
+        char path[32];
+        fs_path(path, sizeof(path));
+        montauk::fdelete(path);
+    }
+    set_status("Benchmark stopped");
+}
+
+void bench_step() {
+    auto& b = g_state.bench;
+    if (!b.running) return;
+
+    int test = b.next;
+    BenchRow& row = b.rows[test];
+
+    if (test < BENCH_RAW_TESTS) {
+        raw_run(test, row);
+    } else if (b.fs_drive < 0) {
+        row.outcome = BENCH_SKIPPED;
+        row.note = "No mounted partition";
+    } else if (test > BENCH_RAW_TESTS && b.rows[BENCH_RAW_TESTS].outcome != BENCH_DONE) {
+        // Every other FS test reads or rewrites the file the first one wrote
+        row.outcome = BENCH_SKIPPED;
+        row.note = "Scratch file missing";
+    } else {
+        fs_run(test - BENCH_RAW_TESTS, row);
+    }
+
+    b.next++;
+    if (b.next < BENCH_TESTS) {
+        char msg[80];
+        snprintf(msg, sizeof(msg), "Running %s...", bench_test_name(b.next));
+        set_status(msg);
+        return;
+    }
+
+    b.running = false;
+    if (b.fs_drive >= 0) {
+        char path[32];
+        fs_path(path, sizeof(path));
+        montauk::fdelete(path);
+    }
+    set_status("Benchmark complete");
+}
@@ -34,6 +34,8 @@ static constexpr int MAX_PARTS    = 32;
 static constexpr int MAX_DISKS    = 8;
 static constexpr int STATUS_H     = 26;
 static constexpr int FONT_SIZE    = 16;
+static constexpr int BENCH_ROW_H  = 24;
+static constexpr int BENCH_NAME_W = 160;
 
 static constexpr int TB_BTN_Y     = 7;
 static constexpr int TB_BTN_H     = 26;
@@ -98,6 +100,35 @@ struct NewPartDialog {
     uint32_t* pixels;
 };
 
+// ============================================================================
+// Benchmark
+// ============================================================================
+
+enum { VIEW_PARTITIONS = 0, VIEW_BENCH = 1 };
+
+// Raw tests go through SYS_DISKBENCH below the buffer cache; FS tests use
+// a scratch file on the mounted partition, through the VFS and the cache
+static constexpr int BENCH_RAW_TESTS = 10;
+static constexpr int BENCH_FS_TESTS  = 4;
+static constexpr int BENCH_TESTS     = BENCH_RAW_TESTS + BENCH_FS_TESTS;
+static constexpr int BENCH_MS        = 1000;
+
+enum BenchOutcome { BENCH_PENDING = 0, BENCH_DONE, BENCH_SKIPPED, BENCH_FAILED };
+
+struct BenchRow {
+    int outcome;                    // BenchOutcome
+    const char* note;               // Why it was skipped or failed
+    Montauk::DiskBenchResult result;
+};
+
+struct BenchState {
+    bool running;
+    int  disk;                      // Index into DiskToolState::disks
+    int  next;                      // Test to run next
+    int  fs_drive;                  // Drive the FS tests use, -1 if none
+    BenchRow rows[BENCH_TESTS];
+};
+
 struct DiskToolState {
     Montauk::DiskInfo disks[MAX_DISKS];
     int disk_count;
@@ -110,6 +141,8 @@ struct DiskToolState {
     uint64_t status_time;
     FormatDialog fmt_dlg;
     NewPartDialog np_dlg;
+    int view;                       // VIEW_*
+    BenchState bench;
 };
 
 // ============================================================================
@@ -155,3 +188,12 @@ void format_dialog_do_format();
 void open_newpart_dialog();
 void close_newpart_dialog();
 void newpart_dialog_confirm();
+
+// ============================================================================
+// Function declarations — bench.cpp
+// ============================================================================
+
+const char* bench_test_name(int test);
+void bench_start();
+void bench_stop();
+void bench_step();
@@ -86,6 +86,7 @@ static bool handle_toolbar_click(int mx, int my) {
     for (int i = 0; i < dt.disk_count; i++) {
         int lw = disk_btn_width(i);
         if (mx >= bx && mx < bx + lw && my >= TB_BTN_Y && my < TB_BTN_Y + TB_BTN_H) {
+            if (dt.bench.running) return false;
             dt.selected_disk = i;
             dt.selected_part = -1;
             dt.scroll_y = 0;
@@ -97,6 +98,25 @@ static bool handle_toolbar_click(int mx, int my) {
     // Right-side buttons (must match render layout)
     int rx = g_win_w - 8;
 
+    if (dt.view == VIEW_BENCH) {
+        int run_w = 60; rx -= run_w;
+        if (mx >= rx && mx < rx + run_w && my >= TB_BTN_Y && my < TB_BTN_Y + TB_BTN_H) {
+            if (dt.bench.running) bench_stop();
+            else bench_start();
+            return true;
+        }
+        rx -= 6;
+
+        int part_w = 84; rx -= part_w;
+        if (mx >= rx && mx < rx + part_w && my >= TB_BTN_Y && my < TB_BTN_Y + TB_BTN_H) {
+            bench_stop();
+            dt.view = VIEW_PARTITIONS;
+            dt.scroll_y = 0;
+            return true;
+        }
+        return false;
+    }
+
     int ref_w = 64; rx -= ref_w;
     if (mx >= rx && mx < rx + ref_w && my >= TB_BTN_Y && my < TB_BTN_Y + TB_BTN_H) {
         disktool_refresh();
@@ -124,6 +144,14 @@ static bool handle_toolbar_click(int mx, int my) {
         do_create_partition();
         return true;
     }
+    rx -= 6;
+
+    int bench_w = 84; rx -= bench_w;
+    if (mx >= rx && mx < rx + bench_w && my >= TB_BTN_Y && my < TB_BTN_Y + TB_BTN_H) {
+        dt.view = VIEW_BENCH;
+        dt.scroll_y = 0;
+        return true;
+    }
 
     return false;
 }
@@ -135,6 +163,7 @@ static bool handle_toolbar_click(int mx, int my) {
 static bool handle_content_click(int mx, int my) {
     auto& dt = g_state;
     if (dt.disk_count == 0 || dt.selected_disk < 0) return false;
+    if (dt.view == VIEW_BENCH) return false;
 
     int fh = g_font ? g_font->get_cache(FONT_SIZE)->ascent - g_font->get_cache(FONT_SIZE)->descent : 16;
     int y = TOOLBAR_H + 8 + fh + 8;
@@ -295,6 +324,23 @@ static bool handle_key(const Montauk::KeyEvent& key) {
         return true;
     }
 
+    // Benchmark view: switch disks between runs, R runs
+    if (dt.view == VIEW_BENCH) {
+        if (key.scancode == 0x01) { // Escape
+            bench_stop();
+            return false;
+        } else if (dt.bench.running) {
+            return true;
+        } else if (key.scancode == 0x4B) { // Left
+            if (dt.selected_disk > 0) { dt.selected_disk--; dt.scroll_y = 0; }
+        } else if (key.scancode == 0x4D) { // Right
+            if (dt.selected_disk < dt.disk_count - 1) { dt.selected_disk++; dt.scroll_y = 0; }
+        } else if (key.ascii == 'r' || key.ascii == 'R') {
+            bench_start();
+        }
+        return true;
+    }
+
     int part_indices[MAX_PARTS];
     int nparts = get_disk_parts(part_indices, MAX_PARTS);
 
@@ -331,14 +377,7 @@ extern "C" void _start() {
     g_state.selected_part = -1;
 
     // Load font
-    {
-        TrueTypeFont* f = (TrueTypeFont*)montauk::malloc(sizeof(TrueTypeFont));
-        if (f) {
-            montauk::memset(f, 0, sizeof(TrueTypeFont));
-            if (!f->init("0:/fonts/Roboto-Medium.ttf")) { montauk::mfree(f); f = nullptr; }
-        }
-        g_font = f;
-    }
+    g_font = fonts::open("0:/fonts/Roboto-Medium.ttf");
 
     disktool_refresh();
 
@@ -402,6 +441,16 @@ extern "C" void _start() {
         int r = win.poll(&ev);
 
         if (r < 0) break;
+
+        // One benchmark test per pass, so Stop and redraws get through
+        // between tests
+        if (r == 0 && g_state.bench.running) {
+            bench_step();
+            render(pixels);
+            win.present();
+            continue;
+        }
+
         if (r == 0) {
             // Even with no main event, dialog may have triggered redraws
             if (redraw_main) { render(pixels); win.present(); }
@@ -452,6 +501,7 @@ extern "C" void _start() {
         if (redraw_np) { render_newpart_window(); montauk::win_present(g_state.np_dlg.win_id); }
     }
 
+    bench_stop();
     close_newpart_dialog();
     close_format_dialog();
     win.destroy();
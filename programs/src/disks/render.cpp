@@ -121,9 +121,24 @@ static void render_toolbar(uint32_t* px) {
     }
 
     // Right-side action buttons
-    bool has_sel = dt.selected_part >= 0;
     int rx = g_win_w - 8;
 
+    if (dt.view == VIEW_BENCH) {
+        int run_w = 60; rx -= run_w;
+        px_button(px, g_win_w, g_win_h, rx, TB_BTN_Y, run_w, TB_BTN_H,
+                  dt.bench.running ? "Stop" : "Run",
+                  dt.bench.running ? Color::from_rgb(0xCC, 0x33, 0x33) : Color::from_rgb(0x42, 0x7A, 0xB5),
+                  WHITE, TB_BTN_RAD);
+        rx -= 6;
+
+        int part_w = 84; rx -= part_w;
+        px_button(px, g_win_w, g_win_h, rx, TB_BTN_Y, part_w, TB_BTN_H,
+                  "Partitions", Color::from_rgb(0xE0, 0xE0, 0xE0), TEXT_COLOR, TB_BTN_RAD);
+        return;
+    }
+
+    bool has_sel = dt.selected_part >= 0;
+
     int ref_w = 64; rx -= ref_w;
     px_button(px, g_win_w, g_win_h, rx, TB_BTN_Y, ref_w, TB_BTN_H,
               "Refresh", Color::from_rgb(0xE0, 0xE0, 0xE0), TEXT_COLOR, TB_BTN_RAD);
@@ -146,6 +161,11 @@ static void render_toolbar(uint32_t* px) {
     int np_w = 74; rx -= np_w;
     px_button(px, g_win_w, g_win_h, rx, TB_BTN_Y, np_w, TB_BTN_H,
               "New Part", Color::from_rgb(0x42, 0x7A, 0xB5), WHITE, TB_BTN_RAD);
+    rx -= 6;
+
+    int bench_w = 84; rx -= bench_w;
+    px_button(px, g_win_w, g_win_h, rx, TB_BTN_Y, bench_w, TB_BTN_H,
+              "Benchmark", Color::from_rgb(0xE0, 0xE0, 0xE0), TEXT_COLOR, TB_BTN_RAD);
 }
 
 static void render_content(uint32_t* px) {
@@ -256,6 +276,136 @@ static void render_content(uint32_t* px) {
         px_text(px, g_win_w, g_win_h, col_name, list_y + 8, "No partitions found", FAINT_TEXT);
 }
 
+// ============================================================================
+// Render: benchmark view
+// ============================================================================
+
+// Right edge of numeric column `col` (0 = MB/s ... 6 = max)
+static int bench_col_right(int col) {
+    int avail = g_win_w - BENCH_NAME_W - 12;
+    return BENCH_NAME_W + (col + 1) * avail / 7;
+}
+
+static void text_right(uint32_t* px, int right, int y, const char* text, Color c) {
+    px_text(px, g_win_w, g_win_h, right - text_w(text), y, text, c);
+}
+
+static void format_latency(char* buf, int size, uint64_t ns) {
+    uint64_t us = ns / 1000;
+    if (us < 1000) {
+        snprintf(buf, size, "%luus", (unsigned long)us);
+    } else if (us < 10000) {
+        snprintf(buf, size, "%lu.%02lums", (unsigned long)(us / 1000), (unsigned long)(us % 1000 / 10));
+    } else {
+        snprintf(buf, size, "%lums", (unsigned long)(us / 1000));
+    }
+}
+
+static void render_bench_row(uint32_t* px, int y, int test) {
+    auto& b = g_state.bench;
+    const BenchRow& row = b.rows[test];
+    int fh = font_h();
+    int ty = y + (BENCH_ROW_H - fh) / 2;
+
+    px_text(px, g_win_w, g_win_h, 12, ty, bench_test_name(test), TEXT_COLOR);
+
+    if (row.outcome == BENCH_PENDING) {
+        if (b.running && b.next == test)
+            px_text(px, g_win_w, g_win_h, BENCH_NAME_W + 12, ty, "running...", FAINT_TEXT);
+        return;
+    }
+    if (row.outcome != BENCH_DONE) {
+        Color c = row.outcome == BENCH_FAILED ? Color::from_rgb(0xCC, 0x22, 0x22) : FAINT_TEXT;
+        px_text(px, g_win_w, g_win_h, BENCH_NAME_W + 12, ty, row.note ? row.note : "", c);
+        return;
+    }
+
+    const Montauk::DiskBenchResult& r = row.result;
+    uint64_t us = r.elapsedUs ? r.elapsedUs : 1;
+    char buf[24];
+
+    // Bytes per microsecond is MB/s; one decimal
+    uint64_t tenths = r.bytes * 10 / us;
+    snprintf(buf, sizeof(buf), "%lu.%lu", (unsigned long)(tenths / 10), (unsigned long)(tenths % 10));
+    text_right(px, bench_col_right(0), ty, buf, TEXT_COLOR);
+
+    snprintf(buf, sizeof(buf), "%lu", (unsigned long)(r.ops * 1000000 / us));
+    text_right(px, bench_col_right(1), ty, buf, TEXT_COLOR);
+
+    const uint64_t lat[5] = { r.avgNs, r.p50Ns, r.p99Ns, r.p999Ns, r.maxNs };
+    for (int i = 0; i < 5; i++) {
+        format_latency(buf, sizeof(buf), lat[i]);
+        text_right(px, bench_col_right(2 + i), ty, buf, i == 4 ? DIM_TEXT : TEXT_COLOR);
+    }
+}
+
+static void render_bench(uint32_t* px) {
+    auto& dt = g_state;
+    auto& b = dt.bench;
+    int fh = font_h();
+
+    if (dt.disk_count == 0 || dt.selected_disk < 0 || dt.selected_disk >= dt.disk_count)
+        return;
+
+    // Results belong to the disk they were measured on
+    bool have = b.disk == dt.selected_disk && (b.running || b.rows[0].outcome != BENCH_PENDING);
+
+    Montauk::DiskInfo& disk = dt.disks[dt.selected_disk];
+    int y = TOOLBAR_H + 8;
+    px_text(px, g_win_w, g_win_h, MAP_PAD, y, disk.model, TEXT_COLOR);
+    char info_str[64];
+    if (disk.supportsNcq)
+        snprintf(info_str, sizeof(info_str), "NCQ depth %u", (unsigned)disk.ncqDepth);
+    else
+        snprintf(info_str, sizeof(info_str), "%s", disk.type == 3 ? "NVMe" : "No NCQ");
+    px_text(px, g_win_w, g_win_h, g_win_w - text_w(info_str) - MAP_PAD, y, info_str, DIM_TEXT);
+    y += fh + 8;
+
+    // Column header
+    px_fill(px, g_win_w, g_win_h, 0, y, g_win_w, HEADER_H, HEADER_BG);
+    int ty = y + (HEADER_H - fh) / 2;
+    static const char* const cols[7] = { "MB/s", "IOPS", "avg", "p50", "p99", "p99.9", "max" };
+    px_text(px, g_win_w, g_win_h, 12, ty, "Test", DIM_TEXT);
+    for (int i = 0; i < 7; i++) text_right(px, bench_col_right(i), ty, cols[i], DIM_TEXT);
+    px_hline(px, g_win_w, g_win_h, 0, y + HEADER_H - 1, g_win_w, BORDER_COLOR);
+    y += HEADER_H;
+
+    int list_y = y;
+    int list_bottom = g_win_h - STATUS_H;
+    if (!have) {
+        px_text(px, g_win_w, g_win_h, 12, list_y + 8,
+                "Run measures this disk below the cache and through its filesystem.", FAINT_TEXT);
+        px_text(px, g_win_w, g_win_h, 12, list_y + 8 + fh + 6,
+                "Writes only touch unpartitioned space and a scratch file.", FAINT_TEXT);
+        return;
+    }
+
+    // Two sections, each a caption row followed by its tests
+    int row = 0;
+    for (int test = 0; test < BENCH_TESTS; test++) {
+        if (test == 0 || test == BENCH_RAW_TESTS) {
+            int cy = list_y + row * BENCH_ROW_H - dt.scroll_y;
+            if (cy + BENCH_ROW_H > list_y && cy < list_bottom) {
+                char caption[64];
+                if (test == 0)
+                    snprintf(caption, sizeof(caption), "Block device (no cache)");
+                else if (b.fs_drive >= 0)
+                    snprintf(caption, sizeof(caption), "Filesystem on %d:/ (write-back cache)", b.fs_drive);
+                else
+                    snprintf(caption, sizeof(caption), "Filesystem");
+                px_text(px, g_win_w, g_win_h, 8, cy + (BENCH_ROW_H - fh) / 2, caption, DIM_TEXT);
+            }
+            row++;
+        }
+
+        int ry = list_y + row * BENCH_ROW_H - dt.scroll_y;
+        row++;
+        if (ry + BENCH_ROW_H <= list_y || ry >= list_bottom) continue;
+        if (ry + BENCH_ROW_H > list_bottom) break;
+        render_bench_row(px, ry, test);
+    }
+}
+
 static void render_status(uint32_t* px) {
     auto& dt = g_state;
     int fh = font_h();
@@ -407,6 +557,9 @@ void render_newpart_window() {
 void render(uint32_t* pixels) {
     px_fill(pixels, g_win_w, g_win_h, 0, 0, g_win_w, g_win_h, BG_COLOR);
     render_toolbar(pixels);
-    render_content(pixels);
+    if (g_state.view == VIEW_BENCH)
+        render_bench(pixels);
+    else
+        render_content(pixels);
     render_status(pixels);
 }
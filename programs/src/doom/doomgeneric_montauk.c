@@ -9,6 +9,9 @@
 
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <emmintrin.h>
+#include <montauk.h>
 
 /* ---- Raw syscall interface (C versions) ---- */
 
@@ -60,40 +63,125 @@ static inline long _zos_syscall4(long nr, long a1, long a2, long a3, long a4) {
 #define SYS_EXIT            0
 #define SYS_SLEEP_MS        2
 #define SYS_PRINT           4
-#define SYS_GETMILLISECONDS 14
 #define SYS_WINCREATE       54
 #define SYS_WINDESTROY      55
 #define SYS_WINPRESENT      56
-#define SYS_WINPOLL         57
 
-/* Window server structs (must match Montauk::WinCreateResult and Montauk::WinEvent) */
+/* Window server structs (must match Montauk::WinCreateResult) */
 struct WinCreateResult {
     int      id;        /* -1 on failure */
     unsigned _pad;
     unsigned long pixelVa;  /* VA of pixel buffer in caller's address space */
 };
 
-struct WinEvent {
-    unsigned char type;     /* 0=key, 1=mouse, 2=resize, 3=close */
-    unsigned char _pad[3];
-    union {
-        struct {
-            unsigned char scancode;
-            char          ascii;
-            unsigned char pressed;
-            unsigned char shift;
-            unsigned char ctrl;
-            unsigned char alt;
-        } key;
-        struct { int x, y, scroll; unsigned char buttons, prev_buttons; } mouse;
-        struct { int w, h; } resize;
-    };
-};
-
 /* ---- Window state ---- */
 
 static int       g_winId   = -1;
 static uint32_t* g_pixBuf  = 0;
+static int       g_winW    = DOOMGENERIC_RESX;
+static int       g_winH    = DOOMGENERIC_RESY;
+
+/* While the window is exactly DOOMGENERIC_RESX x DOOMGENERIC_RESY, DOOM
+   renders straight into its back buffer: DG_ScreenBuffer points at the
+   mapping, which keeps its address across presents (the kernel swaps the
+   pages under it), and I_FinishUpdate writes every pixel of each frame.
+   In a larger window the frame is shown centered at the largest integer
+   scale that fits. DOOM then renders into g_ownBuf, and scaling it into
+   the window is the only copy. */
+static uint32_t* g_ownBuf  = 0;
+static int       g_scale   = 1;
+static uint32_t* g_origin  = 0;  /* Top-left pixel of the picture in the window */
+static int       g_showW   = DOOMGENERIC_RESX;  /* Source pixels shown per row */
+static int       g_showH   = DOOMGENERIC_RESY;  /* Source rows shown */
+
+_Static_assert(DOOMGENERIC_RESX % 4 == 0, "the scalers take 4 pixels at a time");
+
+/* Lay the frame out in a w x h window whose pixels are at `pixels` */
+static void set_window(uint32_t* pixels, int w, int h) {
+    int sx = w / DOOMGENERIC_RESX;
+    int sy = h / DOOMGENERIC_RESY;
+    int pw, ph;
+
+    g_pixBuf = pixels;
+    g_winW = w;
+    g_winH = h;
+    g_scale = sx < sy ? sx : sy;
+    if (g_scale < 1) g_scale = 1;
+
+    /* A window smaller than the frame shows its top-left part */
+    g_showW = w / g_scale < DOOMGENERIC_RESX ? w / g_scale : DOOMGENERIC_RESX;
+    g_showH = h / g_scale < DOOMGENERIC_RESY ? h / g_scale : DOOMGENERIC_RESY;
+    pw = g_showW * g_scale;
+    ph = g_showH * g_scale;
+    g_origin = pixels + (long)((h - ph) / 2) * w + (w - pw) / 2;
+
+    DG_ScreenBuffer = (w == DOOMGENERIC_RESX && h == DOOMGENERIC_RESY) ? pixels : g_ownBuf;
+}
+
+/* Copy rows of the frame into the window as they are */
+static void blit_1x(const uint32_t* src) {
+    for (int y = 0; y < g_showH; y++) {
+        memcpy(g_origin + (long)y * g_winW, src + y * DOOMGENERIC_RESX, g_showW * sizeof(uint32_t));
+    }
+}
+
+/* Each pixel becomes a 2x2 block: every source vector of four pixels
+   is widened into two and stored to both rows */
+static void blit_2x(const uint32_t* src) {
+    for (int y = 0; y < g_showH; y++) {
+        const uint32_t* in = src + y * DOOMGENERIC_RESX;
+        uint32_t* out0 = g_origin + (long)(2 * y) * g_winW;
+        uint32_t* out1 = out0 + g_winW;
+        for (int x = 0; x + 4 <= g_showW; x += 4) {
+            __m128i p  = _mm_loadu_si128((const __m128i*)(in + x));
+            __m128i lo = _mm_unpacklo_epi32(p, p);
+            __m128i hi = _mm_unpackhi_epi32(p, p);
+            _mm_storeu_si128((__m128i*)(out0 + 2 * x), lo);
+            _mm_storeu_si128((__m128i*)(out0 + 2 * x + 4), hi);
+            _mm_storeu_si128((__m128i*)(out1 + 2 * x), lo);
+            _mm_storeu_si128((__m128i*)(out1 + 2 * x + 4), hi);
+        }
+    }
+}
+
+/* Each pixel becomes a 3x3 block: four pixels abcd are shuffled into
+   aaab bbcc cddd and stored to three rows */
+static void blit_3x(const uint32_t* src) {
+    for (int y = 0; y < g_showH; y++) {
+        const uint32_t* in = src + y * DOOMGENERIC_RESX;
+        uint32_t* out = g_origin + (long)(3 * y) * g_winW;
+        for (int x = 0; x + 4 <= g_showW; x += 4) {
+            __m128i p  = _mm_loadu_si128((const __m128i*)(in + x));
+            __m128i v0 = _mm_shuffle_epi32(p, _MM_SHUFFLE(1, 0, 0, 0));
+            __m128i v1 = _mm_shuffle_epi32(p, _MM_SHUFFLE(2, 2, 1, 1));
+            __m128i v2 = _mm_shuffle_epi32(p, _MM_SHUFFLE(3, 3, 3, 2));
+            for (int r = 0; r < 3; r++) {
+                uint32_t* o = out + (long)r * g_winW + 3 * x;
+                _mm_storeu_si128((__m128i*)o, v0);
+                _mm_storeu_si128((__m128i*)(o + 4), v1);
+                _mm_storeu_si128((__m128i*)(o + 8), v2);
+            }
+        }
+    }
+}
+
+/* Any larger scale: widen each row once, then repeat it */
+static void blit_nx(const uint32_t* src) {
+    int k = g_scale;
+    int rowBytes = g_showW * k * (int)sizeof(uint32_t);
+    for (int y = 0; y < g_showH; y++) {
+        const uint32_t* in = src + y * DOOMGENERIC_RESX;
+        uint32_t* out = g_origin + (long)(k * y) * g_winW;
+        for (int x = 0; x < g_showW; x++) {
+            __m128i v = _mm_set1_epi32((int)in[x]);
+            uint32_t* o = out + x * k;
+            int i = 0;
+            for (; i + 4 <= k; i += 4) _mm_storeu_si128((__m128i*)(o + i), v);
+            for (; i < k; i++) o[i] = in[x];
+        }
+        for (int r = 1; r < k; r++) memcpy(out + (long)r * g_winW, out, rowBytes);
+    }
+}
 
 /* ---- Circular key queue ---- */
 
@@ -178,8 +266,8 @@ static unsigned char scancode_to_doomkey(unsigned char scancode, char ascii) {
 /* ---- Poll window events and enqueue key events ---- */
 
 static void poll_keyboard(void) {
-    struct WinEvent evt;
-    while (_zos_syscall2(SYS_WINPOLL, (long)g_winId, (long)&evt) > 0) {
+    mtk_win_event evt;
+    while (mtk_win_poll(g_winId, &evt) > 0) {
         if (evt.type == 0) {
             /* Key event */
             unsigned char baseSc = evt.key.scancode & 0x7F;
@@ -192,6 +280,11 @@ static void poll_keyboard(void) {
             if (dk != 0) {
                 key_queue_push(evt.key.pressed ? 1 : 0, dk);
             }
+        } else if (evt.type == MTK_EVENT_RESIZE) {
+            uint32_t* pixels = (uint32_t*)mtk_win_resize(g_winId, evt.resize.w, evt.resize.h);
+            /* The old buffers are gone either way */
+            if (pixels == 0) _zos_syscall1(SYS_EXIT, 1);
+            set_window(pixels, evt.resize.w, evt.resize.h);
         } else if (evt.type == 3) {
             /* Close event — exit the process */
             _zos_syscall1(SYS_EXIT, 0);
@@ -211,21 +304,32 @@ void DG_Init(void) {
     }
 
     g_winId  = result.id;
-    g_pixBuf = (uint32_t*)result.pixelVa;
+
+    /* doomgeneric_Create allocated DG_ScreenBuffer just before calling
+       us; it is kept for when the window is scaled */
+    g_ownBuf = DG_ScreenBuffer;
+    set_window((uint32_t*)result.pixelVa, DOOMGENERIC_RESX, DOOMGENERIC_RESY);
 }
 
 void DG_DrawFrame(void) {
-    /* Poll keyboard first */
-    poll_keyboard();
-
-    /* Copy DG_ScreenBuffer into the shared pixel buffer */
     if (g_pixBuf == 0 || DG_ScreenBuffer == 0) return;
 
-    memcpy(g_pixBuf, DG_ScreenBuffer,
-           DOOMGENERIC_RESX * DOOMGENERIC_RESY * sizeof(uint32_t));
+    /* Scale the frame into the window unless it was drawn there */
+    if (DG_ScreenBuffer != g_pixBuf) {
+        switch (g_scale) {
+        case 1:  blit_1x(DG_ScreenBuffer); break;
+        case 2:  blit_2x(DG_ScreenBuffer); break;
+        case 3:  blit_3x(DG_ScreenBuffer); break;
+        default: blit_nx(DG_ScreenBuffer); break;
+        }
+    }
 
-    /* Mark window as dirty so the compositor picks it up */
+    /* Hand the frame to the compositor */
     _zos_syscall1(SYS_WINPRESENT, (long)g_winId);
+
+    /* Poll events after presenting: a resize unmaps the buffer the
+       frame was just drawn into */
+    poll_keyboard();
 }
 
 void DG_SleepMs(uint32_t ms) {
@@ -233,7 +337,7 @@ void DG_SleepMs(uint32_t ms) {
 }
 
 uint32_t DG_GetTicksMs(void) {
-    return (uint32_t)_zos_syscall0(SYS_GETMILLISECONDS);
+    return (uint32_t)mtk_get_ms();
 }
 
 int DG_GetKey(int* pressed, unsigned char* doomKey) {
@@ -52,6 +52,10 @@ static inline long _snd_syscall3(long nr, long a1, long a2, long a3) {
 #define SYS_AUDIOOPEN   80
 #define SYS_AUDIOCLOSE  81
 #define SYS_AUDIOWRITE  82
+#define SYS_AUDIOCTL    83
+
+#define AUDIO_CTL_SET_PERIOD_BYTES  7
+#define AUDIO_CTL_SET_PERIODS       8
 
 /* ========================================================================
    Audio mixing engine
@@ -70,6 +74,11 @@ float libsamplerate_scale = 0.65f;
 #define MIX_SAMPLES     1260
 #define MIX_BUF_BYTES   (MIX_SAMPLES * MIX_CHANNELS * (MIX_BITS / 8))
 
+/* Stream ring: 6 x 2 KiB periods (~70 ms), a little over two mix frames.
+   A deeper queue would only delay sound effects behind the picture. */
+#define RING_PERIOD_BYTES   2048
+#define RING_PERIODS        6
+
 /* Channel state */
 struct snd_channel {
     const uint8_t  *data;       /* 8-bit unsigned PCM samples */
@@ -198,6 +207,13 @@ static boolean I_Montauk_InitSound(boolean _use_sfx_prefix) {
         return false;
     }
 
+    /* Keep the default ring if the stream cannot take short periods */
+    if (_snd_syscall3(SYS_AUDIOCTL, (long)audio_handle,
+            AUDIO_CTL_SET_PERIOD_BYTES, RING_PERIOD_BYTES) == 0) {
+        _snd_syscall3(SYS_AUDIOCTL, (long)audio_handle,
+            AUDIO_CTL_SET_PERIODS, RING_PERIODS);
+    }
+
     sound_initialized = true;
     return true;
 }
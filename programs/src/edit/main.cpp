@@ -587,21 +587,15 @@ static void find_next(bool fromPrompt) {
         int colStart = (i == 0) ? startCol : 0;
 
         Line* ln = &lines[row];
-        for (int c = colStart; c <= ln->len - searchLen; c++) {
-            bool match = true;
-            for (int k = 0; k < searchLen; k++) {
-                if (ln->data[c + k] != searchQuery[k]) {
-                    match = false;
-                    break;
-                }
-            }
-            if (match) {
-                cursorRow = row;
-                cursorCol = c;
-                fullRedraw = true;
-                set_status("Found");
-                return;
-            }
+        if (colStart > ln->len - searchLen) continue;
+        const char* hit = (const char*)montauk::memmem(ln->data + colStart, ln->len - colStart,
+                                                       searchQuery, searchLen);
+        if (hit) {
+            cursorRow = row;
+            cursorCol = (int)(hit - ln->data);
+            fullRedraw = true;
+            set_status("Found");
+            return;
         }
     }
 
@@ -1,7 +1,7 @@
 /*
     * main.cpp
     * HTTP/HTTPS client for MontaukOS (TLS 1.2 via BearSSL)
-    * Usage: fetch [-v] <url>
+    * Usage: fetch [-v] [-c] [-o file] <url>
     *        fetch [-v] <host> <port> [path]    (legacy mode, plain HTTP)
     * Copyright (c) 2025-2026 Daniel Hammer
 */
@@ -9,6 +9,7 @@
 #include <montauk/syscall.h>
 #include <montauk/string.h>
 #include <tls/tls.hpp>
+#include <http/http.hpp>
 
 extern "C" {
 #include <string.h>
@@ -258,6 +259,62 @@ static void print_response(const char* respBuf, int respLen, bool verbose) {
     }
 }
 
+// ---- Download to a file ----
+
+static void print_progress(void* ctx, const http::Download* d) {
+    uint64_t have = d->start + d->received;
+    char msg[96];
+    if (d->total)
+        snprintf(msg, sizeof(msg), "\r%lu / %lu KiB (%lu%%)   ",
+            (unsigned long)(have / 1024), (unsigned long)(d->total / 1024),
+            (unsigned long)(have * 100 / d->total));
+    else
+        snprintf(msg, sizeof(msg), "\r%lu KiB   ", (unsigned long)(have / 1024));
+    montauk::print(msg);
+}
+
+// Stream the body to outPath; with resume, continue a partial file
+static int download_to_file(const char* host, uint32_t ip, uint16_t port, bool https,
+                            const char* path, const char* outPath, bool resume, bool verbose) {
+    tls::TrustAnchors tas = {nullptr, 0, 0};
+    if (https) {
+        tas = tls::load_trust_anchors();
+        if (tas.count == 0) {
+            montauk::print("Error: no trust anchors loaded\n");
+            return 1;
+        }
+    }
+
+    http::Download d;
+    bool ok = http::download(host, ip, port, path, outPath, resume,
+                             https ? &tas : nullptr, &d,
+                             print_progress, nullptr, check_keyboard_abort);
+    montauk::putchar('\n');
+
+    char msg[320];
+    if (d.status == 416 && ok) {
+        snprintf(msg, sizeof(msg), "%s is already complete\n", outPath);
+    } else if (ok) {
+        if (verbose && d.start > 0)
+            snprintf(msg, sizeof(msg), "Resumed at byte %lu, wrote %lu bytes to %s\n",
+                (unsigned long)d.start, (unsigned long)d.received, outPath);
+        else
+            snprintf(msg, sizeof(msg), "Wrote %lu bytes to %s\n",
+                (unsigned long)(d.start + d.received), outPath);
+    } else if (d.write_error) {
+        snprintf(msg, sizeof(msg), "Error: could not write %s\n", outPath);
+    } else if (d.status >= 0 && d.status != 200 && d.status != 206) {
+        snprintf(msg, sizeof(msg), "Error: HTTP %d\n", d.status);
+    } else if (d.status >= 0) {
+        snprintf(msg, sizeof(msg), "Incomplete: %lu bytes in %s (fetch -c to resume)\n",
+            (unsigned long)(d.start + d.received), outPath);
+    } else {
+        snprintf(msg, sizeof(msg), "Error: no response received\n");
+    }
+    montauk::print(msg);
+    return ok ? 0 : 1;
+}
+
 // ---- Main ----
 
 extern "C" void _start() {
@@ -266,24 +323,46 @@ extern "C" void _start() {
     const char* arg = skip_spaces(argbuf);
 
     if (*arg == '\0') {
-        montauk::print("Usage: fetch [-v] <url>\n");
+        montauk::print("Usage: fetch [-v] [-c] [-o file] <url>\n");
         montauk::print("       fetch [-v] <host> <port> [path]\n");
         montauk::print("\n");
-        montauk::print("  -v  Verbose output (show connection info and headers)\n");
+        montauk::print("  -v       Verbose output (show connection info and headers)\n");
+        montauk::print("  -o file  Save the body to file as it arrives\n");
+        montauk::print("  -c       Continue a partial download of the -o file\n");
         montauk::print("\n");
         montauk::print("Examples:\n");
         montauk::print("  fetch https://icanhazip.com\n");
         montauk::print("  fetch http://example.com/index.html\n");
         montauk::print("  fetch -v https://example.com\n");
+        montauk::print("  fetch -c -o big.iso https://example.com/big.iso\n");
         montauk::print("  fetch 10.0.68.1 80 /\n");
         montauk::exit(0);
     }
 
-    // Check for -v flag
+    // Flags
     bool verbose = false;
-    if (arg[0] == '-' && arg[1] == 'v' && (arg[2] == ' ' || arg[2] == '\0')) {
-        verbose = true;
+    bool resume = false;
+    char outPath[256] = {};
+    while (arg[0] == '-' && arg[1] && (arg[2] == ' ' || arg[2] == '\0')) {
+        char flag = arg[1];
         arg = skip_spaces(arg + 2);
+        if (flag == 'v') {
+            verbose = true;
+        } else if (flag == 'c') {
+            resume = true;
+        } else if (flag == 'o') {
+            int i = 0;
+            while (arg[i] && arg[i] != ' ' && i < 255) { outPath[i] = arg[i]; i++; }
+            outPath[i] = '\0';
+            arg = skip_spaces(arg + i);
+        } else {
+            montauk::print("Unknown option\n");
+            montauk::exit(1);
+        }
+    }
+    if (resume && !outPath[0]) {
+        montauk::print("Error: -c needs -o <file>\n");
+        montauk::exit(1);
     }
 
     // Determine mode: URL mode (starts with http:// or https://) vs legacy mode
@@ -355,6 +434,16 @@ extern "C" void _start() {
         montauk::print(msg);
     }
 
+    if (outPath[0]) {
+        if (verbose) {
+            char msg[128];
+            snprintf(msg, sizeof(msg), "GET %s\n", path);
+            montauk::print(msg);
+        }
+        montauk::exit(download_to_file(hostStr, serverIp, port, useHttps,
+                                       path, outPath, resume, verbose));
+    }
+
     // Build HTTP request
     char request[1024];
     int reqLen = snprintf(request, sizeof(request),
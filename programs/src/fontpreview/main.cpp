@@ -320,14 +320,7 @@ extern "C" void _start() {
     if (arglen <= 0) montauk::strcpy(filepath, "");
 
     // Load UI font for labels
-    auto load_font = [](const char* path) -> TrueTypeFont* {
-        TrueTypeFont* f = (TrueTypeFont*)montauk::malloc(sizeof(TrueTypeFont));
-        if (!f) return nullptr;
-        montauk::memset(f, 0, sizeof(TrueTypeFont));
-        if (!f->init(path)) { montauk::mfree(f); return nullptr; }
-        return f;
-    };
-    g_ui_font = load_font("0:/fonts/Roboto-Medium.ttf");
+    g_ui_font = fonts::open("0:/fonts/Roboto-Medium.ttf");
 
     // Window title from filename
     char title[64] = "Font Preview";
@@ -0,0 +1,769 @@
+/*
+    * main.cpp
+    * httpbench - HTTP load generator for MontaukOS
+    * Usage: httpbench [-c conns] [-d secs] [-n requests] [-r rate] [-C] <url>
+    * Reports latency percentiles, requests/s and bytes/s for httpd and the TCP stack
+    * Copyright (c) 2026 Daniel Hammer
+*/
+
+#include <montauk/syscall.h>
+#include <montauk/string.h>
+
+using montauk::slen;
+using montauk::streq;
+using montauk::starts_with;
+using montauk::skip_spaces;
+
+// ---- Minimal snprintf (no libc available) ----
+
+using va_list = __builtin_va_list;
+#define va_start __builtin_va_start
+#define va_end   __builtin_va_end
+#define va_arg   __builtin_va_arg
+
+struct PfState {
+    char*  buf;
+    int    pos;
+    int    max;
+};
+
+static void pf_putc(PfState* st, char c) {
+    if (st->pos < st->max) st->buf[st->pos] = c;
+    st->pos++;
+}
+
+static void pf_putnum(PfState* st, unsigned long val, int base, int width, char pad, int neg) {
+    char tmp[24];
+    int i = 0;
+    const char* digits = "0123456789abcdef";
+    if (val == 0) { tmp[i++] = '0'; }
+    else { while (val > 0) { tmp[i++] = digits[val % base]; val /= base; } }
+    int total = (neg ? 1 : 0) + i;
+    if (neg && pad == '0') pf_putc(st, '-');
+    for (int w = total; w < width; w++) pf_putc(st, pad);
+    if (neg && pad != '0') pf_putc(st, '-');
+    while (i > 0) pf_putc(st, tmp[--i]);
+}
+
+static int vsnprintf(char* buf, int size, const char* fmt, va_list ap) {
+    PfState st;
+    st.buf = buf;
+    st.pos = 0;
+    st.max = size > 0 ? size - 1 : 0;
+    while (*fmt) {
+        if (*fmt != '%') { pf_putc(&st, *fmt++); continue; }
+        fmt++;
+        char pad = ' ';
+        if (*fmt == '0') { pad = '0'; fmt++; }
+        int width = 0;
+        while (*fmt >= '0' && *fmt <= '9') { width = width * 10 + (*fmt - '0'); fmt++; }
+        bool lng = false;
+        while (*fmt == 'l') { lng = true; fmt++; }
+        switch (*fmt) {
+        case 'd': case 'i': {
+            long val = lng ? va_arg(ap, long) : va_arg(ap, int);
+            int neg = 0; unsigned long uval;
+            if (val < 0) { neg = 1; uval = (unsigned long)(-val); }
+            else uval = (unsigned long)val;
+            pf_putnum(&st, uval, 10, width, pad, neg);
+            break;
+        }
+        case 'u': {
+            unsigned long val = lng ? va_arg(ap, unsigned long) : va_arg(ap, unsigned);
+            pf_putnum(&st, val, 10, width, pad, 0);
+            break;
+        }
+        case 'x': {
+            unsigned long val = lng ? va_arg(ap, unsigned long) : va_arg(ap, unsigned);
+            pf_putnum(&st, val, 16, width, pad, 0);
+            break;
+        }
+        case 's': {
+            const char* s = va_arg(ap, const char*);
+            if (!s) s = "(null)";
+            int slen = 0; while (s[slen]) slen++;
+            for (int w = slen; w < width; w++) pf_putc(&st, ' ');
+            for (int j = 0; j < slen; j++) pf_putc(&st, s[j]);
+            break;
+        }
+        case 'c': { char c = (char)va_arg(ap, int); pf_putc(&st, c); break; }
+        case '%': pf_putc(&st, '%'); break;
+        default: pf_putc(&st, '%'); pf_putc(&st, *fmt); break;
+        }
+        if (*fmt) fmt++;
+    }
+    if (size > 0) {
+        if (st.pos < size) st.buf[st.pos] = '\0';
+        else st.buf[size - 1] = '\0';
+    }
+    return st.pos;
+}
+
+static int snprintf(char* buf, int size, const char* fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    int ret = vsnprintf(buf, size, fmt, ap);
+    va_end(ap);
+    return ret;
+}
+
+static void printf_out(const char* fmt, ...) {
+    char buf[256];
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(buf, sizeof(buf), fmt, ap);
+    va_end(ap);
+    montauk::print(buf);
+}
+
+// ---- Argument parsing ----
+
+static bool parse_uint(const char* s, uint64_t* out) {
+    uint64_t val = 0;
+    if (*s == '\0') return false;
+    while (*s) {
+        if (*s < '0' || *s > '9') return false;
+        val = val * 10 + (*s - '0');
+        s++;
+    }
+    *out = val;
+    return true;
+}
+
+static bool parse_ip(const char* s, uint32_t* out) {
+    uint32_t octets[4];
+    int idx = 0;
+    uint32_t val = 0;
+    bool hasDigit = false;
+
+    for (int i = 0; ; i++) {
+        char c = s[i];
+        if (c >= '0' && c <= '9') {
+            val = val * 10 + (c - '0');
+            if (val > 255) return false;
+            hasDigit = true;
+        } else if (c == '.' || c == '\0') {
+            if (!hasDigit || idx >= 4) return false;
+            octets[idx++] = val;
+            val = 0;
+            hasDigit = false;
+            if (c == '\0') break;
+        } else {
+            return false;
+        }
+    }
+
+    if (idx != 4) return false;
+    *out = octets[0] | (octets[1] << 8) | (octets[2] << 16) | (octets[3] << 24);
+    return true;
+}
+
+// Copy the next space-separated word of *p into out and advance past it
+static bool next_word(const char** p, char* out, int outMax) {
+    const char* s = skip_spaces(*p);
+    if (*s == '\0') return false;
+    int n = 0;
+    while (*s && *s != ' ') {
+        if (n < outMax - 1) out[n++] = *s;
+        s++;
+    }
+    out[n] = '\0';
+    *p = s;
+    return true;
+}
+
+// Split "[http://]host[:port][/path]"
+static bool parse_url(const char* url, char* host, int hostMax, uint16_t* port,
+                      char* path, int pathMax) {
+    if (starts_with(url, "http://")) url += 7;
+
+    int n = 0;
+    while (*url && *url != ':' && *url != '/') {
+        if (n < hostMax - 1) host[n++] = *url;
+        url++;
+    }
+    host[n] = '\0';
+    if (n == 0) return false;
+
+    *port = 80;
+    if (*url == ':') {
+        url++;
+        uint32_t val = 0;
+        if (*url < '0' || *url > '9') return false;
+        while (*url >= '0' && *url <= '9') {
+            val = val * 10 + (*url - '0');
+            if (val > 65535) return false;
+            url++;
+        }
+        *port = (uint16_t)val;
+    }
+
+    if (*url == '\0') url = "/";
+    if (*url != '/') return false;
+    n = 0;
+    while (*url && n < pathMax - 1) path[n++] = *url++;
+    path[n] = '\0';
+    return true;
+}
+
+// ---- Timing ----
+
+// Loopback round trips are well under a millisecond, so latencies are
+// taken from the TSC, calibrated against the millisecond clock
+static uint64_t g_tscPerUs = 1;
+
+static inline uint64_t rdtsc() {
+    uint32_t lo, hi;
+    asm volatile("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+static void calibrate_tsc() {
+    // Start on a millisecond edge
+    uint64_t ms0 = montauk::get_milliseconds();
+    while (montauk::get_milliseconds() == ms0) {}
+    ms0 = montauk::get_milliseconds();
+    uint64_t t0 = rdtsc();
+
+    montauk::sleep_ms(200);
+
+    uint64_t ms1 = montauk::get_milliseconds();
+    uint64_t t1 = rdtsc();
+    if (ms1 > ms0) g_tscPerUs = (t1 - t0) / ((ms1 - ms0) * 1000);
+    if (g_tscPerUs == 0) g_tscPerUs = 1;
+}
+
+static uint64_t now_us() {
+    return rdtsc() / g_tscPerUs;
+}
+
+// ---- Latency histogram ----
+
+// Log-linear buckets: exact below 64 us, then 32 per power of two (about
+// 3% resolution) up to 2^32 us
+static constexpr int HIST_LINEAR  = 64;
+static constexpr int HIST_SUB     = 32;
+static constexpr int HIST_BUCKETS = HIST_LINEAR + (32 - 6) * HIST_SUB;
+
+static uint64_t g_hist[HIST_BUCKETS];
+static uint64_t g_histCount = 0;
+static uint64_t g_histMax = 0;
+
+static int hist_index(uint64_t us) {
+    if (us < HIST_LINEAR) return (int)us;
+    int p = 63 - __builtin_clzll(us);
+    if (p >= 32) return HIST_BUCKETS - 1;
+    return HIST_LINEAR + (p - 6) * HIST_SUB + (int)((us >> (p - 5)) & (HIST_SUB - 1));
+}
+
+// Smallest latency that falls in bucket idx
+static uint64_t hist_lower(int idx) {
+    if (idx < HIST_LINEAR) return idx;
+    int p = (idx - HIST_LINEAR) / HIST_SUB + 6;
+    int sub = (idx - HIST_LINEAR) % HIST_SUB;
+    return (uint64_t)(HIST_SUB + sub) << (p - 5);
+}
+
+static void hist_add(uint64_t us) {
+    g_hist[hist_index(us)]++;
+    g_histCount++;
+    if (us > g_histMax) g_histMax = us;
+}
+
+// Latency at or below which per100k / 100000 of the requests completed
+// (reported as the top of its bucket)
+static uint64_t hist_percentile(uint64_t per100k) {
+    if (g_histCount == 0) return 0;
+    uint64_t target = (g_histCount * per100k + 99999) / 100000;
+    if (target == 0) target = 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        seen += g_hist[i];
+        if (seen >= target) {
+            uint64_t top = i + 1 < HIST_BUCKETS ? hist_lower(i + 1) - 1 : g_histMax;
+            return top < g_histMax ? top : g_histMax;
+        }
+    }
+    return g_histMax;
+}
+
+// "0.213 ms"-style text for a latency in microseconds
+static void format_latency(uint64_t us, char* out, int outMax) {
+    if (us < 1000000)
+        snprintf(out, outMax, "%lu.%03lu ms", us / 1000, us % 1000);
+    else
+        snprintf(out, outMax, "%lu.%03lu s", us / 1000000, (us / 1000) % 1000);
+}
+
+// "12.34 MiB"-style text for a byte count
+static void format_bytes(uint64_t bytes, char* out, int outMax) {
+    if (bytes >= 1024 * 1024)
+        snprintf(out, outMax, "%lu.%02lu MiB", bytes >> 20, ((bytes & 0xFFFFF) * 100) >> 20);
+    else if (bytes >= 1024)
+        snprintf(out, outMax, "%lu.%02lu KiB", bytes >> 10, ((bytes & 0x3FF) * 100) >> 10);
+    else
+        snprintf(out, outMax, "%lu B", bytes);
+}
+
+// ---- Connections ----
+
+// Each connection has at most one request outstanding. With a target
+// rate, requests are due on a fixed schedule and latency is measured from
+// when a request was due rather than when it went out, so a stalled
+// server is not hidden by the generator waiting on it.
+static constexpr int      MAX_CONNS          = 60;     // leaves poll set room for the keyboard
+static constexpr uint64_t RESPONSE_TIMEOUT_US = 10000000;
+static constexpr uint64_t RETRY_US           = 100000; // after a failed connect
+
+struct BenchConn {
+    int      fd;             // -1 = not connected
+    bool     busy;           // request sent, response pending
+    uint64_t due;            // when the next request should go
+    uint64_t start;          // latency is measured from here
+
+    // Response being parsed
+    char     head[1024];
+    int      headLen;
+    bool     inBody;
+    bool     untilClose;     // no Content-Length: the body ends at close
+    uint64_t bodyLeft;
+    int      status;
+    bool     serverClose;    // the server will close after this response
+};
+
+static BenchConn g_conns[MAX_CONNS];
+static int       g_connCount = 8;
+static int       g_epfd = -1;
+
+static uint32_t  g_ip;
+static uint16_t  g_port;
+static char      g_request[512];
+static int       g_requestLen;
+static bool      g_keepAlive = true;
+static uint64_t  g_interval = 0;      // us between requests on a connection, 0 = back to back
+
+// Totals
+static uint64_t  g_sent = 0;
+static uint64_t  g_done = 0;
+static uint64_t  g_bytes = 0;
+static uint64_t  g_connects = 0;
+static uint64_t  g_errConnect = 0;
+static uint64_t  g_errRead = 0;
+static uint64_t  g_errTimeout = 0;
+static uint64_t  g_non2xx = 0;
+
+static char to_lower(char c) {
+    return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+}
+
+// Case-insensitive search for `word` (lowercase) in head[0 .. len)
+static int find_nocase(const char* head, int len, const char* word) {
+    int wlen = slen(word);
+    for (int i = 0; i + wlen <= len; i++) {
+        int j = 0;
+        while (j < wlen && to_lower(head[i + j]) == word[j]) j++;
+        if (j == wlen) return i;
+    }
+    return -1;
+}
+
+static void conn_disconnect(BenchConn* b) {
+    if (b->fd < 0) return;
+    montauk::epoll_ctl(g_epfd, Montauk::EPOLL_CTL_DEL, Montauk::POLL_SRC_SOCKET, b->fd, 0);
+    montauk::closesocket(b->fd);
+    b->fd = -1;
+}
+
+static bool conn_connect(BenchConn* b) {
+    int fd = montauk::socket(Montauk::SOCK_TCP);
+    if (fd < 0) return false;
+    if (montauk::connect(fd, g_ip, g_port) < 0 ||
+        montauk::epoll_ctl(g_epfd, Montauk::EPOLL_CTL_ADD, Montauk::POLL_SRC_SOCKET,
+                           fd, Montauk::POLL_IN, (uint64_t)(b - g_conns)) < 0) {
+        montauk::closesocket(fd);
+        return false;
+    }
+    b->fd = fd;
+    g_connects++;
+    return true;
+}
+
+static void conn_schedule_next(BenchConn* b, uint64_t now) {
+    if (g_interval) {
+        b->due += g_interval;
+    } else {
+        b->due = now;
+    }
+}
+
+static void conn_send(BenchConn* b, uint64_t now) {
+    // Without a rate the clock starts now; with one, when the request was due
+    b->start = g_interval ? b->due : now;
+
+    if (b->fd < 0 && !conn_connect(b)) {
+        g_errConnect++;
+        b->due = now + RETRY_US;
+        return;
+    }
+
+    if (montauk::send(b->fd, g_request, g_requestLen) != g_requestLen) {
+        g_errRead++;
+        conn_disconnect(b);
+        conn_schedule_next(b, now);
+        return;
+    }
+
+    b->busy = true;
+    b->headLen = 0;
+    b->inBody = false;
+    b->untilClose = false;
+    b->bodyLeft = 0;
+    b->status = 0;
+    b->serverClose = false;
+    g_sent++;
+}
+
+static void conn_complete(BenchConn* b) {
+    uint64_t now = now_us();
+    hist_add(now - b->start);
+    g_done++;
+    if (b->status < 200 || b->status >= 400) g_non2xx++;
+
+    b->busy = false;
+    if (!g_keepAlive || b->serverClose) conn_disconnect(b);
+    conn_schedule_next(b, now);
+}
+
+static void conn_fail(BenchConn* b, uint64_t* counter) {
+    (*counter)++;
+    b->busy = false;
+    conn_disconnect(b);
+    conn_schedule_next(b, now_us());
+}
+
+// Headers are in: pick out the status, the body length and whether the
+// server keeps the connection
+static void parse_head(BenchConn* b) {
+    const char* h = b->head;
+    int len = b->headLen;
+
+    b->status = 0;
+    if (len > 12 && starts_with(h, "HTTP/")) {
+        for (int i = 9; i < 12; i++) b->status = b->status * 10 + (h[i] - '0');
+    }
+
+    int cl = find_nocase(h, len, "\ncontent-length:");
+    if (cl >= 0) {
+        int i = cl + 16;
+        while (i < len && h[i] == ' ') i++;
+        uint64_t n = 0;
+        while (i < len && h[i] >= '0' && h[i] <= '9') n = n * 10 + (h[i++] - '0');
+        b->bodyLeft = n;
+    } else {
+        b->untilClose = true;
+    }
+
+    int conn = find_nocase(h, len, "\nconnection:");
+    bool http10 = starts_with(h, "HTTP/1.0");
+    if (conn >= 0) {
+        int end = conn + 12;
+        while (end < len && h[end] != '\r') end++;
+        bool close = find_nocase(h + conn, end - conn, "close") >= 0;
+        bool keep = find_nocase(h + conn, end - conn, "keep-alive") >= 0;
+        b->serverClose = close || (http10 && !keep);
+    } else {
+        b->serverClose = http10;
+    }
+    if (b->untilClose) b->serverClose = true;
+    b->inBody = true;
+}
+
+// Feed received bytes to the response parser
+static void conn_feed(BenchConn* b, const uint8_t* data, int len) {
+    int i = 0;
+    while (i < len && b->busy) {
+        if (!b->inBody) {
+            if (b->headLen >= (int)sizeof(b->head)) {
+                conn_fail(b, &g_errRead);
+                return;
+            }
+            b->head[b->headLen++] = (char)data[i++];
+            int n = b->headLen;
+            if (n >= 4 && b->head[n - 4] == '\r' && b->head[n - 3] == '\n' &&
+                b->head[n - 2] == '\r' && b->head[n - 1] == '\n') {
+                parse_head(b);
+                if (!b->untilClose && b->bodyLeft == 0) conn_complete(b);
+            }
+            continue;
+        }
+
+        uint64_t n = (uint64_t)(len - i);
+        if (b->untilClose) {
+            i = len;
+            continue;
+        }
+        if (n > b->bodyLeft) n = b->bodyLeft;
+        b->bodyLeft -= n;
+        i += (int)n;
+        if (b->bodyLeft == 0) conn_complete(b);
+    }
+}
+
+static void conn_readable(BenchConn* b) {
+    static uint8_t buf[16384];
+    while (b->fd >= 0) {
+        int r = montauk::recv(b->fd, buf, sizeof(buf));
+        if (r > 0) {
+            g_bytes += r;
+            conn_feed(b, buf, r);
+        } else if (r == 0) {
+            break;
+        } else {
+            // Closed by the server
+            if (b->busy && b->inBody && b->untilClose) {
+                conn_complete(b);
+            } else if (b->busy) {
+                conn_fail(b, &g_errRead);
+            }
+            conn_disconnect(b);
+            break;
+        }
+    }
+}
+
+// ---- Report ----
+
+static void print_report(const char* url, uint64_t elapsedUs) {
+    char a[32], b[32], c[32];
+    if (elapsedUs == 0) elapsedUs = 1;
+
+    montauk::print("\n");
+    printf_out("%lu requests in %lu.%02lu s, %lu connections (%lu opened), %s\n",
+        g_done, elapsedUs / 1000000, (elapsedUs / 10000) % 100,
+        (unsigned long)g_connCount, g_connects, g_keepAlive ? "keep-alive" : "close");
+    printf_out("  Target:      %s\n", url);
+
+    format_bytes(g_bytes, a, sizeof(a));
+    format_bytes(g_bytes * 1000000 / elapsedUs, b, sizeof(b));
+    printf_out("  Requests/s:  %lu\n", g_done * 1000000 / elapsedUs);
+    printf_out("  Transfer:    %s (%s/s)\n", a, b);
+
+    if (g_histCount > 0) {
+        montauk::print("\n  Latency distribution\n");
+        static const struct { const char* name; uint64_t per100k; } points[] = {
+            { "50%",    50000 }, { "75%",    75000 }, { "90%",    90000 },
+            { "99%",    99000 }, { "99.9%",  99900 }, { "99.99%", 99990 },
+        };
+        for (auto& pt : points) {
+            format_latency(hist_percentile(pt.per100k), a, sizeof(a));
+            printf_out("    %6s  %s\n", pt.name, a);
+        }
+        format_latency(g_histMax, a, sizeof(a));
+        printf_out("    %6s  %s\n", "max", a);
+
+        // Counts per power of two, with a bar scaled to the largest
+        montauk::print("\n  Histogram\n");
+        uint64_t rows[33] = {};
+        int last = 0;
+        for (int i = 0; i < HIST_BUCKETS; i++) {
+            if (!g_hist[i]) continue;
+            uint64_t lo = hist_lower(i);
+            int p = lo ? 64 - __builtin_clzll(lo) : 0;
+            if (p > 32) p = 32;
+            rows[p] += g_hist[i];
+            if (p > last) last = p;
+        }
+        uint64_t peak = 0;
+        for (int p = 0; p <= last; p++) if (rows[p] > peak) peak = rows[p];
+        int first = 0;
+        while (first < last && rows[first] == 0) first++;
+        for (int p = first; p <= last; p++) {
+            // Row p holds latencies in [2^(p-1), 2^p) us
+            format_latency(p ? (1ull << (p - 1)) : 0, a, sizeof(a));
+            format_latency(1ull << p, b, sizeof(b));
+            char bar[41];
+            int w = (int)(rows[p] * 40 / peak);
+            for (int k = 0; k < w; k++) bar[k] = '#';
+            bar[w] = '\0';
+            printf_out("    %12s - %12s %8lu %s\n", a, b, rows[p], bar);
+        }
+    }
+
+    snprintf(c, sizeof(c), "%lu", g_errConnect + g_errRead + g_errTimeout);
+    printf_out("\n  Errors:      %s (connect %lu, read %lu, timeout %lu)\n",
+        c, g_errConnect, g_errRead, g_errTimeout);
+    if (g_non2xx)
+        printf_out("  Non-2xx/3xx: %lu\n", g_non2xx);
+}
+
+// ---- Entry point ----
+
+static void usage() {
+    montauk::print("Usage: httpbench [-c conns] [-d secs] [-n requests] [-r rate] [-C] <url>\n");
+    montauk::print("  -c N   concurrent connections (default 8, max 60)\n");
+    montauk::print("  -d S   run for S seconds (default 10)\n");
+    montauk::print("  -n N   stop after N responses\n");
+    montauk::print("  -r R   target R requests/s in total (default: as fast as possible)\n");
+    montauk::print("  -C     close the connection after every request (no keep-alive)\n");
+    montauk::print("  url    [http://]host[:port][/path], e.g. 127.0.0.1:8080/files/\n");
+    montauk::exit(1);
+}
+
+extern "C" void _start() {
+    char args[512];
+    montauk::getargs(args, sizeof(args));
+
+    uint64_t durationSecs = 10;
+    bool durationSet = false;
+    uint64_t maxRequests = 0;
+    uint64_t rate = 0;
+    char url[256] = "";
+
+    const char* p = args;
+    char word[256];
+    while (next_word(&p, word, sizeof(word))) {
+        uint64_t val = 0;
+        if (streq(word, "-C")) {
+            g_keepAlive = false;
+        } else if (streq(word, "-c") || streq(word, "-d") || streq(word, "-n") || streq(word, "-r")) {
+            char opt = word[1];
+            if (!next_word(&p, word, sizeof(word)) || !parse_uint(word, &val) || val == 0) usage();
+            if (opt == 'c') {
+                if (val > MAX_CONNS) val = MAX_CONNS;
+                g_connCount = (int)val;
+            } else if (opt == 'd') {
+                durationSecs = val;
+                durationSet = true;
+            } else if (opt == 'n') {
+                maxRequests = val;
+            } else {
+                rate = val;
+            }
+        } else if (word[0] == '-' || url[0]) {
+            usage();
+        } else {
+            montauk::strcpy(url, word);
+        }
+    }
+    if (!url[0]) usage();
+
+    char host[128];
+    char path[256];
+    if (!parse_url(url, host, sizeof(host), &g_port, path, sizeof(path))) {
+        montauk::print("Invalid URL: ");
+        montauk::print(url);
+        montauk::putchar('\n');
+        montauk::exit(1);
+    }
+    if (!parse_ip(host, &g_ip)) {
+        g_ip = montauk::resolve(host);
+        if (g_ip == 0) {
+            montauk::print("Could not resolve: ");
+            montauk::print(host);
+            montauk::putchar('\n');
+            montauk::exit(1);
+        }
+    }
+
+    char hostHeader[160];
+    if (g_port == 80) snprintf(hostHeader, sizeof(hostHeader), "%s", host);
+    else snprintf(hostHeader, sizeof(hostHeader), "%s:%d", host, (int)g_port);
+    g_requestLen = snprintf(g_request, sizeof(g_request),
+        "GET %s HTTP/1.1\r\n"
+        "Host: %s\r\n"
+        "User-Agent: httpbench\r\n"
+        "Connection: %s\r\n"
+        "\r\n",
+        path, hostHeader, g_keepAlive ? "keep-alive" : "close");
+
+    // With -n alone, run until that many responses are in
+    uint64_t durationUs = (maxRequests && !durationSet) ? 0 : durationSecs * 1000000;
+    if (rate) {
+        g_interval = (uint64_t)g_connCount * 1000000 / rate;
+        if (g_interval == 0) g_interval = 1;
+    }
+
+    g_epfd = montauk::epoll_create();
+    if (g_epfd < 0 ||
+        montauk::epoll_ctl(g_epfd, Montauk::EPOLL_CTL_ADD, Montauk::POLL_SRC_KEYBOARD, 0, Montauk::POLL_IN) < 0) {
+        montauk::print("Error: failed to set up polling\n");
+        montauk::exit(1);
+    }
+
+    montauk::print("Calibrating timer...\n");
+    calibrate_tsc();
+
+    // Open the connections up front so the handshakes are not timed
+    for (int i = 0; i < g_connCount; i++) {
+        g_conns[i].fd = -1;
+        g_conns[i].busy = false;
+        if (g_keepAlive && !conn_connect(&g_conns[i])) {
+            montauk::print("Error: could not connect to ");
+            montauk::print(url);
+            montauk::putchar('\n');
+            montauk::exit(1);
+        }
+    }
+
+    printf_out("Running against %s with %d connections", url, g_connCount);
+    if (rate) printf_out(" at %lu req/s", rate);
+    if (durationUs) printf_out(" for %lu s", durationSecs);
+    if (maxRequests) printf_out(", up to %lu requests", maxRequests);
+    montauk::print(". Ctrl+Q stops early.\n");
+
+    // Stagger the schedules so paced connections do not fire together
+    uint64_t begin = now_us();
+    for (int i = 0; i < g_connCount; i++)
+        g_conns[i].due = begin + (g_interval * i) / g_connCount;
+
+    bool running = true;
+    while (running) {
+        uint64_t now = now_us();
+        if (durationUs && now - begin >= durationUs) break;
+        if (maxRequests && g_done + g_errConnect + g_errRead + g_errTimeout >= maxRequests) break;
+
+        // Send whatever is due, and give up on responses that never came
+        uint64_t nextDue = ~0ull;
+        for (int i = 0; i < g_connCount; i++) {
+            BenchConn* b = &g_conns[i];
+            if (b->busy) {
+                if (now - b->start >= RESPONSE_TIMEOUT_US) conn_fail(b, &g_errTimeout);
+                continue;
+            }
+            if (maxRequests && g_sent >= maxRequests) continue;
+            if (b->due <= now) conn_send(b, now);
+            if (!b->busy && b->due < nextDue) nextDue = b->due;
+        }
+
+        // Sleep until a response arrives or the next request is due
+        now = now_us();
+        int64_t timeoutMs = 100;
+        if (nextDue != ~0ull)
+            timeoutMs = nextDue <= now ? 0 : (int64_t)((nextDue - now) / 1000);
+        if (timeoutMs > 100) timeoutMs = 100;
+
+        Montauk::PollEvent ready[MAX_CONNS + 1];
+        int n = montauk::epoll_wait(g_epfd, ready, MAX_CONNS + 1, timeoutMs);
+        if (n < 0) break;
+
+        for (int i = 0; i < n; i++) {
+            if (ready[i].source == Montauk::POLL_SRC_KEYBOARD) {
+                while (montauk::is_key_available()) {
+                    Montauk::KeyEvent ev;
+                    montauk::getkey(&ev);
+                    if (ev.pressed && ev.ctrl && ev.ascii == 'q') running = false;
+                }
+                continue;
+            }
+            BenchConn* b = &g_conns[ready[i].userData];
+            if (b->fd >= 0 && b->fd == ready[i].id) conn_readable(b);
+        }
+    }
+    uint64_t elapsed = now_us() - begin;
+
+    for (int i = 0; i < g_connCount; i++) conn_disconnect(&g_conns[i]);
+    montauk::epoll_close(g_epfd);
+
+    print_report(url, elapsed);
+    montauk::exit(0);
+}
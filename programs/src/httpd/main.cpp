@@ -1,6 +1,6 @@
 /*
     * main.cpp
-    * HTTP/1.0 server for MontaukOS
+    * HTTP/1.1 server for MontaukOS
     * Usage: httpd [port]  (default: 80)
     * Serves a built-in index page and files from the VFS
     * Copyright (c) 2025-2026 Daniel Hammer
@@ -8,6 +8,8 @@
 
 #include <montauk/syscall.h>
 #include <montauk/string.h>
+#include <montauk/heap.h>
+#include <montauk/service.h>
 
 using montauk::slen;
 using montauk::streq;
@@ -142,29 +144,306 @@ static const char* content_type_for(const char* path) {
     return "application/octet-stream";
 }
 
+// ---- Response cache ----
+
+// Small files stay in memory next to their serialized response headers,
+// keyed by VFS path, so a hot page is answered without touching the VFS
+// or the formatter. An entry is checked against the file's size and
+// mtime at most every CACHE_REVALIDATE_MS, and the least recently used
+// ones are evicted to keep the total under CACHE_BUDGET.
+static constexpr int      CACHE_MAX_ENTRIES   = 64;
+static constexpr uint64_t CACHE_BUDGET        = 8 * 1024 * 1024;
+static constexpr uint64_t CACHE_MAX_FILE      = 1024 * 1024;
+static constexpr uint64_t CACHE_REVALIDATE_MS = 2000;
+
+static const char CONN_KEEP_ALIVE[] = "Connection: keep-alive\r\n\r\n";
+static const char CONN_CLOSE[]      = "Connection: close\r\n\r\n";
+
+struct CacheEntry {
+    char     path[256];        // VFS path, "" once dropped
+    uint64_t size;
+    int64_t  mtime;
+    uint64_t checked;          // when size and mtime were last compared
+    uint64_t lastUsed;         // LRU clock
+    int      refs;             // connections still sending the body
+
+    // One allocation: the 200 header (ending in CONN_KEEP_ALIVE), the
+    // body, then the 304 header up to its Connection line
+    char*    block;            // nullptr = free slot
+    uint64_t blockSize;
+    int      headerLen;
+    int      prefixLen;        // headerLen without the Connection line
+    const uint8_t* body;
+    const char* notModified;
+    int      notModifiedLen;
+
+    char     etag[24];         // "" when the mtime is unknown
+    char     lastModified[32];
+};
+
+static CacheEntry g_cache[CACHE_MAX_ENTRIES];
+static uint64_t   g_cacheBytes = 0;
+static uint64_t   g_cacheClock = 0;
+
+// "Sun, 06 Nov 1994 08:49:37 GMT" for Unix time t
+static void format_http_date(int64_t t, char* out, int outMax) {
+    static const char* days[] = { "Thu", "Fri", "Sat", "Sun", "Mon", "Tue", "Wed" };
+    static const char* months[] = { "Jan", "Feb", "Mar", "Apr", "May", "Jun",
+                                    "Jul", "Aug", "Sep", "Oct", "Nov", "Dec" };
+    int64_t day = t / 86400;
+    int secs = (int)(t % 86400);
+
+    // Civil date from days since 1970-01-01
+    int64_t z = day + 719468;
+    int64_t era = z / 146097;
+    int doe = (int)(z - era * 146097);
+    int yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    int doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    int mp = (5 * doy + 2) / 153;
+    int mday = doy - (153 * mp + 2) / 5 + 1;
+    int month = mp < 10 ? mp + 3 : mp - 9;
+    int year = (int)(yoe + era * 400) + (month <= 2 ? 1 : 0);
+
+    snprintf(out, outMax, "%s, %02d %s %d %02d:%02d:%02d GMT",
+        days[day % 7], mday, months[month - 1], year,
+        secs / 3600, (secs / 60) % 60, secs % 60);
+}
+
+// The file's mtime from its directory entry, or 0 if unknown
+static int64_t file_mtime(const char* vfsPath) {
+    int slash = -1;
+    for (int i = 0; vfsPath[i]; i++) {
+        if (vfsPath[i] == '/') slash = i;
+    }
+    if (slash < 0) return 0;
+
+    // "0:/name" lives in "0:/", "0:/dir/name" in "0:/dir"
+    char dir[256];
+    int dirLen = slash == 2 ? 3 : slash;
+    if (dirLen >= (int)sizeof(dir)) return 0;
+    montauk::memcpy(dir, vfsPath, dirLen);
+    dir[dirLen] = '\0';
+    const char* name = vfsPath + slash + 1;
+
+    Montauk::DirEntryInfo batch[8];
+    uint64_t cursor = 0;
+    int n;
+    while ((n = montauk::readdir_stat(dir, &cursor, batch, 8)) > 0) {
+        for (int i = 0; i < n; i++) {
+            if (streq(batch[i].name, name)) return batch[i].mtime;
+        }
+    }
+    return 0;
+}
+
+static void cache_free(CacheEntry* e) {
+    montauk::mfree(e->block);
+    g_cacheBytes -= e->blockSize;
+    e->block = nullptr;
+}
+
+// Take an entry out of lookups; it is freed once no connection is
+// sending its body
+static void cache_drop(CacheEntry* e) {
+    e->path[0] = '\0';
+    if (e->refs == 0) cache_free(e);
+}
+
+static void cache_release(CacheEntry* e) {
+    if (--e->refs == 0 && e->path[0] == '\0') cache_free(e);
+}
+
+static CacheEntry* cache_find(const char* vfsPath) {
+    for (int i = 0; i < CACHE_MAX_ENTRIES; i++) {
+        CacheEntry* e = &g_cache[i];
+        if (e->block && e->path[0] && streq(e->path, vfsPath)) return e;
+    }
+    return nullptr;
+}
+
+// Evict least recently used entries until `bytes` more fit. Returns a
+// free slot, or nullptr if the space cannot be found.
+static CacheEntry* cache_make_room(uint64_t bytes) {
+    while (true) {
+        CacheEntry* freeSlot = nullptr;
+        CacheEntry* lru = nullptr;
+        for (int i = 0; i < CACHE_MAX_ENTRIES; i++) {
+            CacheEntry* e = &g_cache[i];
+            if (!e->block) {
+                if (!freeSlot) freeSlot = e;
+            } else if (e->path[0] && e->refs == 0 &&
+                       (!lru || e->lastUsed < lru->lastUsed)) {
+                lru = e;
+            }
+        }
+        if (freeSlot && g_cacheBytes + bytes <= CACHE_BUDGET) return freeSlot;
+        if (!lru) return nullptr;
+        cache_drop(lru);
+    }
+}
+
+// Read an open file into a new entry. Returns nullptr if it is too big
+// to cache or does not fit.
+static CacheEntry* cache_load(const char* vfsPath, const char* urlPath, int handle,
+                              uint64_t size, int64_t mtime) {
+    if (size > CACHE_MAX_FILE || slen(vfsPath) >= (int)sizeof(CacheEntry::path))
+        return nullptr;
+
+    char etag[24] = "";
+    char lastModified[32] = "";
+    char validators[128] = "";
+    if (mtime > 0) {
+        snprintf(etag, sizeof(etag), "\"%x-%x\"", (unsigned)mtime, (unsigned)size);
+        format_http_date(mtime, lastModified, sizeof(lastModified));
+        snprintf(validators, sizeof(validators), "ETag: %s\r\nLast-Modified: %s\r\n",
+            etag, lastModified);
+    }
+
+    char header[512];
+    int prefixLen = snprintf(header, sizeof(header),
+        "HTTP/1.1 200 OK\r\n"
+        "Content-Type: %s\r\n"
+        "Content-Length: %u\r\n"
+        "%s"
+        "Server: MontaukOS/1.0\r\n",
+        content_type_for(urlPath), (unsigned)size, validators);
+    char notModified[256];
+    int notModifiedLen = snprintf(notModified, sizeof(notModified),
+        "HTTP/1.1 304 Not Modified\r\n"
+        "%s"
+        "Server: MontaukOS/1.0\r\n",
+        validators);
+    int headerLen = prefixLen + (int)sizeof(CONN_KEEP_ALIVE) - 1;
+
+    uint64_t blockSize = headerLen + size + notModifiedLen;
+    CacheEntry* e = cache_make_room(blockSize);
+    if (!e) return nullptr;
+    char* block = (char*)montauk::malloc(blockSize);
+    if (!block) return nullptr;
+
+    uint8_t* body = (uint8_t*)block + headerLen;
+    uint64_t got = 0;
+    while (got < size) {
+        int r = montauk::read(handle, body + got, got, size - got);
+        if (r <= 0) {
+            montauk::mfree(block);
+            return nullptr;
+        }
+        got += r;
+    }
+
+    montauk::memcpy(block, header, prefixLen);
+    montauk::memcpy(block + prefixLen, CONN_KEEP_ALIVE, sizeof(CONN_KEEP_ALIVE) - 1);
+    montauk::memcpy(block + headerLen + size, notModified, notModifiedLen);
+
+    montauk::strcpy(e->path, vfsPath);
+    e->size = size;
+    e->mtime = mtime;
+    e->checked = montauk::get_milliseconds();
+    e->refs = 0;
+    e->block = block;
+    e->blockSize = blockSize;
+    e->headerLen = headerLen;
+    e->prefixLen = prefixLen;
+    e->body = body;
+    e->notModified = block + headerLen + size;
+    e->notModifiedLen = notModifiedLen;
+    montauk::strcpy(e->etag, etag);
+    montauk::strcpy(e->lastModified, lastModified);
+    g_cacheBytes += blockSize;
+    return e;
+}
+
+// ---- Connections ----
+
+// Every connection sits on one poll set. Data is read into the
+// connection's own buffer as it arrives, each complete request in it is
+// answered in turn (so pipelined requests work), and file bodies go out a
+// chunk at a time as the socket has room, so one slow client does not
+// hold up the others.
+static constexpr int      MAX_CONNS            = 32;
+static constexpr int      REQ_BUF_SIZE         = 4096;    // HTTP requests are small
+static constexpr uint64_t REQUEST_TIMEOUT_MS   = 10000;   // to finish a request, or take a body chunk
+static constexpr uint64_t KEEPALIVE_TIMEOUT_MS = 5000;    // idle between requests
+static constexpr int      KEEPALIVE_MAX        = 100;     // requests per connection
+static constexpr uint32_t BODY_CHUNK           = 0x8000;  // body bytes sent per POLL_OUT
+
+// userData of the listening socket's watch; connections use their slot
+static constexpr uint64_t LISTEN_DATA = MAX_CONNS;
+
+struct Conn {
+    int      fd;            // -1 = free slot
+    char     req[REQ_BUF_SIZE];
+    int      reqLen;
+    uint64_t lastActive;
+    int      served;        // requests answered so far
+    bool     keepAlive;     // the response being sent leaves the connection open
+    bool     closing;       // close once the response in progress is out
+    bool     peerClosed;
+
+    // Body still being sent, from an open file (fileHandle, else -1) or
+    // a cache entry (cached, else nullptr)
+    int         fileHandle;
+    CacheEntry* cached;
+    uint64_t    bodyOffset;
+    uint64_t    bodySize;
+};
+
+static Conn g_conns[MAX_CONNS];
+static int  g_epfd = -1;
+
+static void conn_watch(Conn* c, uint32_t events) {
+    montauk::epoll_ctl(g_epfd, Montauk::EPOLL_CTL_MOD, Montauk::POLL_SRC_SOCKET,
+                       c->fd, events, (uint64_t)(c - g_conns));
+}
+
+static bool conn_sending(const Conn* c) {
+    return c->fileHandle >= 0 || c->cached;
+}
+
+static void conn_body_done(Conn* c) {
+    if (c->fileHandle >= 0) {
+        montauk::close(c->fileHandle);
+        c->fileHandle = -1;
+    }
+    if (c->cached) {
+        cache_release(c->cached);
+        c->cached = nullptr;
+    }
+}
+
+static void conn_close(Conn* c) {
+    conn_body_done(c);
+    montauk::epoll_ctl(g_epfd, Montauk::EPOLL_CTL_DEL, Montauk::POLL_SRC_SOCKET, c->fd, 0);
+    montauk::closesocket(c->fd);
+    c->fd = -1;
+}
+
 // ---- HTTP response helpers ----
 
 // Send a complete HTTP response with headers and body
-static void send_response(int clientFd, int statusCode, const char* statusText,
+static void send_response(Conn* c, int statusCode, const char* statusText,
                           const char* contentType, const char* body, int bodyLen) {
     char header[512];
     int hlen = snprintf(header, sizeof(header),
-        "HTTP/1.0 %d %s\r\n"
+        "HTTP/1.1 %d %s\r\n"
         "Content-Type: %s\r\n"
         "Content-Length: %d\r\n"
-        "Connection: close\r\n"
+        "Connection: %s\r\n"
         "Server: MontaukOS/1.0\r\n"
         "\r\n",
-        statusCode, statusText, contentType, bodyLen);
+        statusCode, statusText, contentType, bodyLen,
+        c->keepAlive ? "keep-alive" : "close");
 
-    montauk::send(clientFd, header, hlen);
+    montauk::send(c->fd, header, hlen);
     if (bodyLen > 0) {
-        montauk::send(clientFd, body, bodyLen);
+        montauk::send(c->fd, body, bodyLen);
     }
 }
 
-// Send a file from the VFS
-static int send_file_response(int clientFd, const char* vfsPath, const char* urlPath) {
+// Send the header for a file from the VFS and leave the body to
+// conn_send_body as the socket drains. Returns the body size or -1.
+static int send_file_response(Conn* c, const char* vfsPath, const char* urlPath) {
     int handle = montauk::open(vfsPath);
     if (handle < 0) return -1;
 
@@ -174,31 +453,55 @@ static int send_file_response(int clientFd, const char* vfsPath, const char* url
     // Send header
     char header[512];
     int hlen = snprintf(header, sizeof(header),
-        "HTTP/1.0 200 OK\r\n"
+        "HTTP/1.1 200 OK\r\n"
         "Content-Type: %s\r\n"
         "Content-Length: %u\r\n"
-        "Connection: close\r\n"
+        "Connection: %s\r\n"
         "Server: MontaukOS/1.0\r\n"
         "\r\n",
-        ctype, (unsigned)size);
-    montauk::send(clientFd, header, hlen);
-
-    // Send file body in chunks
-    uint8_t buf[512];
-    uint64_t offset = 0;
-    while (offset < size) {
-        uint64_t chunk = size - offset;
-        if (chunk > sizeof(buf)) chunk = sizeof(buf);
-        int bytesRead = montauk::read(handle, buf, offset, chunk);
-        if (bytesRead <= 0) break;
-        montauk::send(clientFd, buf, bytesRead);
-        offset += bytesRead;
-    }
-
-    montauk::close(handle);
+        ctype, (unsigned)size, c->keepAlive ? "keep-alive" : "close");
+    montauk::send(c->fd, header, hlen);
+
+    if (size == 0) {
+        montauk::close(handle);
+        return 0;
+    }
+
+    // Wait for room to send rather than for the next request
+    c->fileHandle = handle;
+    c->bodyOffset = 0;
+    c->bodySize = size;
+    conn_watch(c, Montauk::POLL_OUT);
     return (int)size;
 }
 
+// Send a cached file. A small one goes out with its header in one send;
+// a larger one is streamed from the entry like a file body.
+static void send_cached_response(Conn* c, CacheEntry* e) {
+    const uint8_t* start = (const uint8_t*)e->block;
+    uint64_t skip;
+    if (c->keepAlive) {
+        skip = e->headerLen;
+    } else {
+        montauk::send(c->fd, e->block, e->prefixLen);
+        montauk::send(c->fd, CONN_CLOSE, sizeof(CONN_CLOSE) - 1);
+        start = e->body;
+        skip = 0;
+    }
+
+    if (skip + e->size <= BODY_CHUNK) {
+        montauk::send(c->fd, start, (uint32_t)(skip + e->size));
+        return;
+    }
+    if (skip) montauk::send(c->fd, start, (uint32_t)skip);
+
+    e->refs++;
+    c->cached = e;
+    c->bodyOffset = 0;
+    c->bodySize = e->size;
+    conn_watch(c, Montauk::POLL_OUT);
+}
+
 // ---- Request parsing ----
 
 // Extract the request path from "GET /path HTTP/1.x\r\n..."
@@ -219,6 +522,76 @@ static int parse_request_path(const char* req, int reqLen, char* pathOut, int pa
     return j;
 }
 
+// Length of the request at the start of buf up to and including the
+// blank line ending its headers, or -1 if it has not all arrived
+static int find_header_end(const char* buf, int len) {
+    for (int i = 0; i + 3 < len; i++) {
+        if (buf[i] == '\r' && buf[i+1] == '\n' &&
+            buf[i+2] == '\r' && buf[i+3] == '\n')
+            return i + 4;
+    }
+    return -1;
+}
+
+static char to_lower(char c) {
+    return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+}
+
+// Copy the value of header `name` (lowercase) into out, lowercased.
+// Returns false if the request does not have it.
+static bool find_header(const char* req, int reqLen, const char* name, char* out, int outMax) {
+    int nameLen = slen(name);
+    int i = 0;
+
+    // Skip the request line
+    while (i < reqLen && req[i] != '\n') i++;
+
+    while (++i < reqLen) {
+        int n = 0;
+        while (n < nameLen && i + n < reqLen && to_lower(req[i + n]) == name[n]) n++;
+        if (n == nameLen && i + n < reqLen && req[i + n] == ':') {
+            i += n + 1;
+            while (i < reqLen && (req[i] == ' ' || req[i] == '\t')) i++;
+            int j = 0;
+            while (i < reqLen && req[i] != '\r' && req[i] != '\n') {
+                if (j < outMax - 1) out[j++] = to_lower(req[i]);
+                i++;
+            }
+            out[j] = '\0';
+            return true;
+        }
+        while (i < reqLen && req[i] != '\n') i++;
+    }
+    return false;
+}
+
+static bool contains(const char* str, const char* word) {
+    for (; *str; str++) {
+        if (starts_with(str, word)) return true;
+    }
+    return false;
+}
+
+// HTTP/1.1 keeps the connection open unless the client says
+// "Connection: close"; HTTP/1.0 closes it unless asked to keep it.
+// Requests carrying a body always close, since bodies are not read.
+static bool wants_keep_alive(const char* req, int reqLen) {
+    int lineEnd = 0;
+    while (lineEnd < reqLen && req[lineEnd] != '\r' && req[lineEnd] != '\n') lineEnd++;
+    bool http11 = lineEnd >= 8 && montauk::memcmp(req + lineEnd - 8, "HTTP/1.1", 8) == 0;
+
+    char value[64];
+    if (find_header(req, reqLen, "content-length", value, sizeof(value)) && !streq(value, "0"))
+        return false;
+    if (find_header(req, reqLen, "transfer-encoding", value, sizeof(value)))
+        return false;
+    if (find_header(req, reqLen, "connection", value, sizeof(value))) {
+        if (contains(value, "close")) return false;
+        if (contains(value, "keep-alive")) return true;
+    }
+    return http11;
+}
+
 // ---- Logging ----
 
 static void log_request(const char* method, const char* path, int status, int bodyLen) {
@@ -361,51 +734,90 @@ static int generate_dir_listing(char* buf, int bufSize, const char* urlPath, con
 
 // ---- Request handler ----
 
-static void handle_client(int clientFd) {
-    // Read request (HTTP requests are small, 4 KB is plenty)
-    char reqBuf[4096];
-    int reqLen = 0;
-    int idleCount = 0;
+// True if the request's If-None-Match or If-Modified-Since says the
+// client already has this version
+static bool not_modified(const CacheEntry* e, const char* req, int reqLen) {
+    if (!e->etag[0]) return false;
+
+    // If-None-Match wins over If-Modified-Since (values come lowercased)
+    char value[128];
+    if (find_header(req, reqLen, "if-none-match", value, sizeof(value)))
+        return streq(value, "*") || contains(value, e->etag);
+    if (find_header(req, reqLen, "if-modified-since", value, sizeof(value))) {
+        char lm[32];
+        int i = 0;
+        for (; e->lastModified[i]; i++) lm[i] = to_lower(e->lastModified[i]);
+        lm[i] = '\0';
+        return streq(value, lm);
+    }
+    return false;
+}
 
-    // Read until we get the full header (ends with \r\n\r\n)
-    while (reqLen < (int)sizeof(reqBuf) - 1) {
-        int r = montauk::recv(clientFd, reqBuf + reqLen, sizeof(reqBuf) - 1 - reqLen);
-        if (r > 0) {
-            reqLen += r;
-            idleCount = 0;
-            // Check if we have the full header
-            bool done = false;
-            for (int i = 0; i + 3 < reqLen; i++) {
-                if (reqBuf[i] == '\r' && reqBuf[i+1] == '\n' &&
-                    reqBuf[i+2] == '\r' && reqBuf[i+3] == '\n') {
-                    done = true;
-                    break;
-                }
-            }
-            if (done) break;
-        } else if (r == 0) {
-            break; // Connection closed
+// Serve a VFS file, from the cache when possible. Returns the status
+// sent (200 or 304) with the body length in *bodyLen, or -1 if the file
+// cannot be opened.
+static int serve_file(Conn* c, const char* vfsPath, const char* urlPath,
+                      const char* req, int reqLen, int* bodyLen) {
+    CacheEntry* e = cache_find(vfsPath);
+
+    // Check a cached copy against the file now and then
+    uint64_t now = montauk::get_milliseconds();
+    if (e && now - e->checked >= CACHE_REVALIDATE_MS) {
+        int handle = montauk::open(vfsPath);
+        bool same = false;
+        if (handle >= 0) {
+            same = montauk::getsize(handle) == e->size && file_mtime(vfsPath) == e->mtime;
+            montauk::close(handle);
+        }
+        if (same) {
+            e->checked = now;
         } else {
-            idleCount++;
-            if (idleCount > 500) break; // Timeout
-            montauk::yield();
+            cache_drop(e);
+            e = nullptr;
         }
     }
-    reqBuf[reqLen] = '\0';
 
-    if (reqLen == 0) {
-        montauk::closesocket(clientFd);
-        return;
+    if (!e) {
+        int handle = montauk::open(vfsPath);
+        if (handle < 0) return -1;
+        uint64_t size = montauk::getsize(handle);
+        if (size <= CACHE_MAX_FILE)
+            e = cache_load(vfsPath, urlPath, handle, size, file_mtime(vfsPath));
+        montauk::close(handle);
+        if (!e) {
+            *bodyLen = send_file_response(c, vfsPath, urlPath);
+            return *bodyLen >= 0 ? 200 : -1;
+        }
+    }
+    e->lastUsed = ++g_cacheClock;
+
+    if (not_modified(e, req, reqLen)) {
+        montauk::send(c->fd, e->notModified, e->notModifiedLen);
+        if (c->keepAlive) montauk::send(c->fd, CONN_KEEP_ALIVE, sizeof(CONN_KEEP_ALIVE) - 1);
+        else montauk::send(c->fd, CONN_CLOSE, sizeof(CONN_CLOSE) - 1);
+        *bodyLen = 0;
+        return 304;
     }
 
+    send_cached_response(c, e);
+    *bodyLen = (int)e->size;
+    return 200;
+}
+
+
+// Answer the request in c->req[0 .. reqLen)
+static void handle_request(Conn* c, int reqLen) {
+    const char* reqBuf = c->req;
+    c->keepAlive = c->served + 1 < KEEPALIVE_MAX && wants_keep_alive(reqBuf, reqLen);
+
     // Parse request path
     char path[256];
     if (parse_request_path(reqBuf, reqLen, path, sizeof(path)) < 0) {
         // Bad request
         static char body[] = "<!DOCTYPE html><html><body><h1>400 Bad Request</h1></body></html>";
-        send_response(clientFd, 400, "Bad Request", "text/html", body, slen(body));
+        c->keepAlive = false;
+        send_response(c, 400, "Bad Request", "text/html", body, slen(body));
         log_request("???", "???", 400, slen(body));
-        montauk::closesocket(clientFd);
         return;
     }
 
@@ -414,22 +826,21 @@ static void handle_client(int clientFd) {
 
     if (streq(path, "/")) {
         // Try to serve 0:/www/index.html from disk first
-        int handle = montauk::open("0:/www/index.html");
-        if (handle >= 0) {
-            montauk::close(handle);
-            int bodyLen = send_file_response(clientFd, "0:/www/index.html", "/index.html");
-            log_request("GET", path, 200, bodyLen);
+        int bodyLen;
+        int status = serve_file(c, "0:/www/index.html", "/index.html", reqBuf, reqLen, &bodyLen);
+        if (status > 0) {
+            log_request("GET", path, status, bodyLen);
         } else {
             // Fall back to built-in index page
-            int bodyLen = generate_index_page(pageBuf, sizeof(pageBuf));
-            send_response(clientFd, 200, "OK", "text/html", pageBuf, bodyLen);
+            bodyLen = generate_index_page(pageBuf, sizeof(pageBuf));
+            send_response(c, 200, "OK", "text/html", pageBuf, bodyLen);
             log_request("GET", path, 200, bodyLen);
         }
 
     } else if (streq(path, "/files") || streq(path, "/files/")) {
         // Root directory listing
         int bodyLen = generate_dir_listing(pageBuf, sizeof(pageBuf), "/files/", "0:/");
-        send_response(clientFd, 200, "OK", "text/html", pageBuf, bodyLen);
+        send_response(c, 200, "OK", "text/html", pageBuf, bodyLen);
         log_request("GET", path, 200, bodyLen);
 
     } else if (starts_with(path, "/files/")) {
@@ -439,9 +850,8 @@ static void handle_client(int clientFd) {
         // Reject path traversal attempts
         if (starts_with(relPath, "..") || starts_with(relPath, "/")) {
             static char body[] = "<!DOCTYPE html><html><body><h1>403 Forbidden</h1></body></html>";
-            send_response(clientFd, 403, "Forbidden", "text/html", body, slen(body));
+            send_response(c, 403, "Forbidden", "text/html", body, slen(body));
             log_request("GET", path, 403, slen(body));
-            montauk::closesocket(clientFd);
             return;
         }
         // Check for /../ or trailing /.. anywhere in the path
@@ -450,9 +860,8 @@ static void handle_client(int clientFd) {
                 if (ci == 0 || relPath[ci-1] == '/') {
                     if (relPath[ci+2] == '\0' || relPath[ci+2] == '/') {
                         static char body[] = "<!DOCTYPE html><html><body><h1>403 Forbidden</h1></body></html>";
-                        send_response(clientFd, 403, "Forbidden", "text/html", body, slen(body));
+                        send_response(c, 403, "Forbidden", "text/html", body, slen(body));
                         log_request("GET", path, 403, slen(body));
-                        montauk::closesocket(clientFd);
                         return;
                     }
                 }
@@ -471,19 +880,11 @@ static void handle_client(int clientFd) {
         if (pi > 3 && vfsPath[pi-1] == '/') pi--;
         vfsPath[pi] = '\0';
 
-        // Try to open as file first
-        int handle = montauk::open(vfsPath);
-        if (handle >= 0) {
-            // It's a file — serve it
-            montauk::close(handle);
-            int bodyLen = send_file_response(clientFd, vfsPath, path);
-            if (bodyLen >= 0) {
-                log_request("GET", path, 200, bodyLen);
-            } else {
-                static char body[] = "<!DOCTYPE html><html><body><h1>500 Internal Server Error</h1></body></html>";
-                send_response(clientFd, 500, "Internal Server Error", "text/html", body, slen(body));
-                log_request("GET", path, 500, slen(body));
-            }
+        // Try to serve it as a file first
+        int bodyLen;
+        int status = serve_file(c, vfsPath, path, reqBuf, reqLen, &bodyLen);
+        if (status > 0) {
+            log_request("GET", path, status, bodyLen);
         } else {
             // Try as directory
             const char* entries[64];
@@ -498,12 +899,12 @@ static void handle_client(int clientFd) {
                 urlPath[up] = '\0';
 
                 int bodyLen = generate_dir_listing(pageBuf, sizeof(pageBuf), urlPath, vfsPath);
-                send_response(clientFd, 200, "OK", "text/html", pageBuf, bodyLen);
+                send_response(c, 200, "OK", "text/html", pageBuf, bodyLen);
                 log_request("GET", path, 200, bodyLen);
             } else {
                 // Not found
                 int bodyLen = generate_404_page(pageBuf, sizeof(pageBuf), path);
-                send_response(clientFd, 404, "Not Found", "text/html", pageBuf, bodyLen);
+                send_response(c, 404, "Not Found", "text/html", pageBuf, bodyLen);
                 log_request("GET", path, 404, bodyLen);
             }
         }
@@ -511,11 +912,128 @@ static void handle_client(int clientFd) {
     } else {
         // 404 for anything else
         int bodyLen = generate_404_page(pageBuf, sizeof(pageBuf), path);
-        send_response(clientFd, 404, "Not Found", "text/html", pageBuf, bodyLen);
+        send_response(c, 404, "Not Found", "text/html", pageBuf, bodyLen);
         log_request("GET", path, 404, bodyLen);
     }
+}
+
+// ---- Connection handling ----
+
+// Answer each complete request in the buffer in order, stopping while a
+// file body is still going out
+static void conn_process(Conn* c) {
+    while (!conn_sending(c) && !c->closing) {
+        int end = find_header_end(c->req, c->reqLen);
+        if (end < 0) {
+            if (c->reqLen >= REQ_BUF_SIZE) {
+                // The headers do not fit in the buffer
+                static char body[] = "<!DOCTYPE html><html><body><h1>431 Request Header Fields Too Large</h1></body></html>";
+                c->keepAlive = false;
+                send_response(c, 431, "Request Header Fields Too Large", "text/html", body, slen(body));
+                log_request("???", "???", 431, slen(body));
+                c->closing = true;
+            }
+            break;
+        }
+
+        handle_request(c, end);
+        c->served++;
+        if (!c->keepAlive) c->closing = true;
+
+        // Drop the request, keeping whatever was pipelined after it
+        c->reqLen -= end;
+        montauk::memmove(c->req, c->req + end, c->reqLen);
+    }
+
+    if (conn_sending(c)) return;
+    if (c->closing || c->peerClosed) conn_close(c);
+}
+
+static void conn_readable(Conn* c) {
+    while (c->reqLen < REQ_BUF_SIZE) {
+        int r = montauk::recv(c->fd, c->req + c->reqLen, REQ_BUF_SIZE - c->reqLen);
+        if (r > 0) {
+            c->reqLen += r;
+            c->lastActive = montauk::get_milliseconds();
+        } else {
+            // 0: nothing more for now, -1: the peer has closed
+            if (r < 0) c->peerClosed = true;
+            break;
+        }
+    }
+    conn_process(c);
+}
+
+// Send the next chunk of the body in progress
+static void conn_send_body(Conn* c) {
+    uint64_t chunk = c->bodySize - c->bodyOffset;
+    if (chunk > BODY_CHUNK) chunk = BODY_CHUNK;
+    int sent = c->cached
+        ? montauk::send(c->fd, c->cached->body + c->bodyOffset, (uint32_t)chunk)
+        : montauk::sendfile(c->fileHandle, c->fd, c->bodyOffset, (uint32_t)chunk);
+    if (sent <= 0) {
+        // The peer is gone or the file came up short of its length
+        conn_close(c);
+        return;
+    }
+    c->bodyOffset += sent;
+    c->lastActive = montauk::get_milliseconds();
+    if (c->bodyOffset < c->bodySize) return;
+
+    conn_body_done(c);
+    conn_watch(c, Montauk::POLL_IN);
+    conn_process(c);
+}
+
+static void accept_client(int listenFd) {
+    // A connection is waiting; accept only completes its handshake
+    int clientFd = montauk::accept(listenFd);
+    if (clientFd < 0) {
+        montauk::print("Warning: accept failed\n");
+        return;
+    }
+
+    Conn* c = nullptr;
+    for (int i = 0; i < MAX_CONNS; i++) {
+        if (g_conns[i].fd < 0) { c = &g_conns[i]; break; }
+    }
+    if (!c || montauk::epoll_ctl(g_epfd, Montauk::EPOLL_CTL_ADD, Montauk::POLL_SRC_SOCKET,
+                                 clientFd, Montauk::POLL_IN, (uint64_t)(c - g_conns)) < 0) {
+        // Every slot is taken: turn the client away rather than queue it
+        static const char busy[] =
+            "HTTP/1.1 503 Service Unavailable\r\n"
+            "Content-Length: 0\r\n"
+            "Connection: close\r\n"
+            "Server: MontaukOS/1.0\r\n"
+            "\r\n";
+        montauk::send(clientFd, busy, sizeof(busy) - 1);
+        montauk::closesocket(clientFd);
+        return;
+    }
 
-    montauk::closesocket(clientFd);
+    c->fd = clientFd;
+    c->reqLen = 0;
+    c->lastActive = montauk::get_milliseconds();
+    c->served = 0;
+    c->keepAlive = false;
+    c->closing = false;
+    c->peerClosed = false;
+    c->fileHandle = -1;
+    c->cached = nullptr;
+}
+
+// Close connections that have gone quiet: idle keep-alive ones after
+// KEEPALIVE_TIMEOUT_MS, ones partway through a request or a file body
+// after REQUEST_TIMEOUT_MS
+static void reap_idle() {
+    uint64_t now = montauk::get_milliseconds();
+    for (int i = 0; i < MAX_CONNS; i++) {
+        Conn* c = &g_conns[i];
+        if (c->fd < 0) continue;
+        bool busy = c->reqLen > 0 || conn_sending(c);
+        uint64_t limit = busy ? REQUEST_TIMEOUT_MS : KEEPALIVE_TIMEOUT_MS;
+        if (now - c->lastActive >= limit) conn_close(c);
+    }
 }
 
 // ---- Entry point ----
@@ -564,42 +1082,73 @@ extern "C" void _start() {
     char msg[128];
     snprintf(msg, sizeof(msg), "MontaukOS httpd listening on port %d\n", (int)port);
     montauk::print(msg);
-    montauk::print("Press Ctrl+Q between requests to stop.\n\n");
+    montauk::print("Press Ctrl+Q to stop.\n\n");
+
+    for (int i = 0; i < MAX_CONNS; i++) {
+        g_conns[i].fd = -1;
+        g_conns[i].fileHandle = -1;
+        g_conns[i].cached = nullptr;
+    }
+
+    // Sleep until a connection, a client socket or a key is ready
+    g_epfd = montauk::epoll_create();
+    if (g_epfd < 0 ||
+        montauk::epoll_ctl(g_epfd, Montauk::EPOLL_CTL_ADD, Montauk::POLL_SRC_SOCKET, listenFd, Montauk::POLL_IN, LISTEN_DATA) < 0 ||
+        montauk::epoll_ctl(g_epfd, Montauk::EPOLL_CTL_ADD, Montauk::POLL_SRC_KEYBOARD, 0, Montauk::POLL_IN) < 0) {
+        montauk::print("Error: failed to set up polling\n");
+        montauk::closesocket(listenFd);
+        montauk::exit(1);
+    }
+
+    // Serving from here on, for init's ready = "notify"
+    montauk::notify_ready();
 
     bool running = true;
     while (running) {
-        // Check for Ctrl+Q before blocking on accept
-        while (montauk::is_key_available()) {
-            Montauk::KeyEvent ev;
-            montauk::getkey(&ev);
-            if (ev.pressed && ev.ctrl && ev.ascii == 'q') {
-                running = false;
-                break;
+        // Wake at least once a second to time out idle connections
+        Montauk::PollEvent ready[MAX_CONNS + 2];
+        int n = montauk::epoll_wait(g_epfd, ready, MAX_CONNS + 2, 1000);
+        if (n < 0) break;
+
+        for (int i = 0; i < n && running; i++) {
+            if (ready[i].source == Montauk::POLL_SRC_KEYBOARD) {
+                // Ctrl+Q stops the server
+                while (montauk::is_key_available()) {
+                    Montauk::KeyEvent ev;
+                    montauk::getkey(&ev);
+                    if (ev.pressed && ev.ctrl && ev.ascii == 'q') {
+                        running = false;
+                        break;
+                    }
+                }
+                continue;
             }
-        }
-        if (!running) break;
-
-        // Accept next client (blocks until a connection arrives)
-        int clientFd = montauk::accept(listenFd);
-        if (clientFd < 0) {
-            montauk::print("Warning: accept failed\n");
-            montauk::yield();
-            continue;
-        }
 
-        handle_client(clientFd);
+            if (ready[i].userData == LISTEN_DATA) {
+                accept_client(listenFd);
+                continue;
+            }
 
-        // After serving, check for Ctrl+Q
-        while (montauk::is_key_available()) {
-            Montauk::KeyEvent ev;
-            montauk::getkey(&ev);
-            if (ev.pressed && ev.ctrl && ev.ascii == 'q') {
-                running = false;
-                break;
+            // Skip events for a connection closed earlier in this batch
+            Conn* c = &g_conns[ready[i].userData];
+            if (c->fd < 0 || c->fd != ready[i].id) continue;
+
+            if (ready[i].events & Montauk::POLL_ERR) {
+                conn_close(c);
+            } else if (conn_sending(c)) {
+                conn_send_body(c);
+            } else {
+                conn_readable(c);
             }
         }
+
+        reap_idle();
     }
 
+    for (int i = 0; i < MAX_CONNS; i++) {
+        if (g_conns[i].fd >= 0) conn_close(&g_conns[i]);
+    }
+    montauk::epoll_close(g_epfd);
     montauk::print("\nShutting down httpd...\n");
     montauk::closesocket(listenFd);
     montauk::exit(0);
@@ -84,6 +84,11 @@ extern "C" void _start() {
         montauk::print("  DNS Server:   ");
         print_ip(cfg.dnsServer);
         montauk::putchar('\n');
+        if (cfg.dnsServer2 != 0) {
+            montauk::print("  DNS Server:   ");
+            print_ip(cfg.dnsServer2);
+            montauk::putchar('\n');
+        }
         montauk::exit(0);
     }
 
@@ -135,7 +140,9 @@ extern "C" void _start() {
         montauk::exit(1);
     }
 
+    // Keep the DNS servers as they are
     Montauk::NetCfg cfg;
+    montauk::get_netcfg(&cfg);
     cfg.ipAddress  = ip;
     cfg.subnetMask = mask;
     cfg.gateway    = gw;
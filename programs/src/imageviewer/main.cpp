@@ -51,6 +51,10 @@ static constexpr Color CHECK_DARK    = Color::from_rgb(0x99, 0x99, 0x99);
 static constexpr float ZOOM_MIN = 0.05f;
 static constexpr float ZOOM_MAX = 16.0f;
 
+// Mip levels go down to 1/16, the reduction ZOOM_MIN calls for
+static constexpr int MIP_MAX_SHIFT = 4;
+static constexpr int MAX_LEVELS    = MIP_MAX_SHIFT + 1;
+
 // ============================================================================
 // App state
 // ============================================================================
@@ -58,11 +62,32 @@ static constexpr float ZOOM_MAX = 16.0f;
 static int       g_win_w   = INIT_W;
 static int       g_win_h   = INIT_H;
 
-// Image data (original, unscaled)
-static uint32_t* g_image   = nullptr;
-static int       g_img_w   = 0;
-static int       g_img_h   = 0;
-static bool      g_has_alpha = false;
+// A decoded copy of all or part of the image at 1/(1 << shift) of its
+// size, whose top-left pixel sits at (x0, y0) in that reduced image
+struct ImageLevel {
+    uint32_t* pixels;
+    int       w, h;
+    int       x0, y0;
+    int       shift;
+};
+
+// The file stays in memory so detail tiles can be decoded from it. The
+// image is decoded once, as small as the window allows (the overview),
+// and halved from there into a mip pyramid; zooming in past the overview
+// decodes just the part of the image in view, at the size it is shown.
+static uint8_t*   g_file    = nullptr;
+static int        g_file_len = 0;
+static int        g_img_w   = 0;   // full size
+static int        g_img_h   = 0;
+static bool       g_has_alpha = false;
+
+static ImageLevel g_levels[MAX_LEVELS] = {};   // overview, then halvings of it
+static int        g_level_count = 0;
+
+// Detail tile, and the full-size region it was decoded to cover
+static ImageLevel g_tile = {};
+static int        g_tile_rx0, g_tile_ry0, g_tile_rx1, g_tile_ry1;
+static bool       g_tile_failed = false;
 
 // Zoom and pan
 static float     g_zoom    = 1.0f;
@@ -103,8 +128,92 @@ static const char* basename(const char* path) {
 // Image loading
 // ============================================================================
 
+static void free_level(ImageLevel& lv) {
+    if (lv.pixels) free(lv.pixels);
+    lv = {};
+}
+
+static void free_image() {
+    for (int i = 0; i < g_level_count; i++) free_level(g_levels[i]);
+    g_level_count = 0;
+    free_level(g_tile);
+    if (g_file) { montauk::mfree(g_file); g_file = nullptr; }
+}
+
+// Decode the part of the image covering the full-size rectangle (rx, ry,
+// rw, rh) at 1/(1 << shift) of its size; rw = 0 decodes all of it
+static bool decode_level(ImageLevel& lv, int shift, int rx, int ry, int rw, int rh) {
+    int x0, y0, w, h;
+    unsigned int* argb = stbi_load_jpeg_argb_from_memory(g_file, g_file_len, shift, rx, ry, rw, rh,
+                                                         &x0, &y0, &w, &h);
+    if (!argb) return false;
+    lv.pixels = (uint32_t*)argb;
+    lv.w = w;
+    lv.h = h;
+    lv.x0 = x0;
+    lv.y0 = y0;
+    lv.shift = shift;
+    return true;
+}
+
+// Halve `src` into `dst` with a 2x2 box filter
+static bool halve_level(const ImageLevel& src, ImageLevel& dst) {
+    int w = (src.w + 1) / 2;
+    int h = (src.h + 1) / 2;
+    uint32_t* px = (uint32_t*)malloc((uint64_t)w * h * 4);
+    if (!px) return false;
+
+    for (int y = 0; y < h; y++) {
+        const uint32_t* r0 = &src.pixels[(y * 2) * src.w];
+        const uint32_t* r1 = y * 2 + 1 < src.h ? r0 + src.w : r0;
+        for (int x = 0; x < w; x++) {
+            int xa = x * 2;
+            int xb = xa + 1 < src.w ? xa + 1 : xa;
+            uint32_t p[4] = {r0[xa], r0[xb], r1[xa], r1[xb]};
+            uint32_t out = 0;
+            for (int sh = 0; sh < 32; sh += 8) {
+                uint32_t sum = ((p[0] >> sh) & 0xFF) + ((p[1] >> sh) & 0xFF) +
+                               ((p[2] >> sh) & 0xFF) + ((p[3] >> sh) & 0xFF);
+                out |= ((sum + 2) >> 2) << sh;
+            }
+            px[y * w + x] = out;
+        }
+    }
+
+    dst.pixels = px;
+    dst.w = w;
+    dst.h = h;
+    dst.x0 = 0;
+    dst.y0 = 0;
+    dst.shift = src.shift + 1;
+    return true;
+}
+
+static int viewport_h() { return g_win_h - TOOLBAR_H - STATUS_BAR_H; }
+
+// The largest DCT reduction (up to 1/8) whose image still covers the
+// window at the zoom that fits the whole image in it
+static int overview_shift(int w, int h) {
+    float zx = (float)g_win_w / w;
+    float zy = (float)viewport_h() / h;
+    float fit = zx < zy ? zx : zy;
+    if (fit > 1.0f) fit = 1.0f;
+    int shown_w = (int)(w * fit);
+    int shown_h = (int)(h * fit);
+
+    int shift = 0;
+    while (shift < 3) {
+        int next = shift + 1;
+        int rw = (w + (1 << next) - 1) >> next;
+        int rh = (h + (1 << next) - 1) >> next;
+        if (rw < shown_w || rh < shown_h) break;
+        shift = next;
+    }
+    return shift;
+}
+
 static bool load_image(const char* path) {
-    if (g_image) { montauk::mfree(g_image); g_image = nullptr; }
+    free_image();
 
     int fd = montauk::open(path);
     if (fd < 0) {
@@ -119,63 +228,145 @@ static bool load_image(const char* path) {
         return false;
     }
 
-    uint8_t* filedata = (uint8_t*)montauk::malloc(size);
-    if (!filedata) {
+    g_file = (uint8_t*)montauk::malloc(size);
+    if (!g_file) {
         montauk::close(fd);
         montauk::strcpy(g_status, "Error: out of memory");
         return false;
     }
 
-    int bytes_read = montauk::read(fd, filedata, 0, size);
+    int bytes_read = montauk::read(fd, g_file, 0, size);
     montauk::close(fd);
 
     if (bytes_read <= 0) {
-        montauk::mfree(filedata);
+        free_image();
         montauk::strcpy(g_status, "Error: could not read file");
         return false;
     }
+    g_file_len = bytes_read;
 
     int w, h, channels;
-    unsigned char* rgba = stbi_load_from_memory(filedata, bytes_read, &w, &h, &channels, 4);
-    montauk::mfree(filedata);
-
-    if (!rgba) {
+    if (!stbi_info_from_memory(g_file, g_file_len, &w, &h, &channels) ||
+        !decode_level(g_levels[0], overview_shift(w, h), 0, 0, 0, 0)) {
         snprintf(g_status, 256, "Error: %s", stbi_failure_reason() ? stbi_failure_reason() : "decode failed");
+        free_image();
         return false;
     }
+    g_level_count = 1;
 
-    g_has_alpha = (channels == 4 || channels == 2);
-
-    // Convert RGBA to ARGB pixel format
-    g_image = (uint32_t*)montauk::malloc((uint64_t)w * h * 4);
-    if (!g_image) {
-        stbi_image_free(rgba);
-        montauk::strcpy(g_status, "Error: out of memory for image");
-        return false;
+    while (g_level_count < MAX_LEVELS) {
+        const ImageLevel& prev = g_levels[g_level_count - 1];
+        if (prev.shift >= MIP_MAX_SHIFT || (prev.w == 1 && prev.h == 1)) break;
+        if (!halve_level(prev, g_levels[g_level_count])) break;
+        g_level_count++;
     }
 
-    for (int i = 0; i < w * h; i++) {
-        uint8_t r = rgba[i * 4 + 0];
-        uint8_t g = rgba[i * 4 + 1];
-        uint8_t b = rgba[i * 4 + 2];
-        uint8_t a = rgba[i * 4 + 3];
-        g_image[i] = ((uint32_t)a << 24) | ((uint32_t)r << 16) | ((uint32_t)g << 8) | b;
-    }
-
-    stbi_image_free(rgba);
-
+    g_has_alpha = (channels == 4 || channels == 2);
     g_img_w = w;
     g_img_h = h;
+    g_tile_failed = false;
 
     snprintf(g_status, 256, "%s  %dx%d  %dch", basename(path), w, h, channels);
     return true;
 }
 
 // ============================================================================
-// Zoom and pan
+// Level selection
 // ============================================================================
 
-static int viewport_h() { return g_win_h - TOOLBAR_H - STATUS_BAR_H; }
+// The reduction the current zoom shows best: the smallest image that still
+// has at least one pixel per screen pixel
+static int zoom_shift() {
+    int shift = 0;
+    while (shift < MIP_MAX_SHIFT && (float)(2 << shift) * g_zoom <= 1.0f) shift++;
+    return shift;
+}
+
+// The part of the full-size image in the viewport
+static void visible_region(int& x0, int& y0, int& x1, int& y1) {
+    float inv_zoom = 1.0f / g_zoom;
+    x0 = (int)(-g_pan_x * inv_zoom);
+    y0 = (int)((TOOLBAR_H - g_pan_y) * inv_zoom);
+    x1 = (int)((g_win_w - g_pan_x) * inv_zoom) + 1;
+    y1 = (int)((g_win_h - STATUS_BAR_H - g_pan_y) * inv_zoom) + 1;
+    if (x0 < 0) x0 = 0;
+    if (y0 < 0) y0 = 0;
+    if (x1 > g_img_w) x1 = g_img_w;
+    if (y1 > g_img_h) y1 = g_img_h;
+}
+
+static bool tile_covers_view(int shift) {
+    if (!g_tile.pixels || g_tile.shift != shift) return false;
+    int x0, y0, x1, y1;
+    visible_region(x0, y0, x1, y1);
+    return x0 >= g_tile_rx0 && y0 >= g_tile_ry0 && x1 <= g_tile_rx1 && y1 <= g_tile_ry1;
+}
+
+// The image to draw from: a mip level, or the detail tile when zoomed in
+// past the overview and the tile covers the view (else the overview,
+// enlarged, until update_tile has decoded one)
+static const ImageLevel* current_level() {
+    int shift = zoom_shift();
+    int base = g_levels[0].shift;
+    if (shift >= base) {
+        int i = shift - base;
+        return &g_levels[i < g_level_count ? i : g_level_count - 1];
+    }
+    return tile_covers_view(shift) ? &g_tile : &g_levels[0];
+}
+
+// Decode a detail tile for the view if it needs one it does not have.
+// The tile reaches a quarter of the view past each side, so small pans
+// and the edges of the decoded area (where chroma is not interpolated
+// from outside it) stay clear of the screen. Returns true if it decoded one.
+static bool update_tile() {
+    if (!g_load_ok || g_tile_failed) return false;
+    int shift = zoom_shift();
+    if (shift >= g_levels[0].shift || tile_covers_view(shift)) return false;
+
+    int x0, y0, x1, y1;
+    visible_region(x0, y0, x1, y1);
+    if (x1 <= x0 || y1 <= y0) return false;
+    int mx = (x1 - x0) / 4 + 8;
+    int my = (y1 - y0) / 4 + 8;
+    x0 = x0 - mx < 0 ? 0 : x0 - mx;
+    y0 = y0 - my < 0 ? 0 : y0 - my;
+    x1 = x1 + mx > g_img_w ? g_img_w : x1 + mx;
+    y1 = y1 + my > g_img_h ? g_img_h : y1 + my;
+
+    free_level(g_tile);
+    if (!decode_level(g_tile, shift, x0, y0, x1 - x0, y1 - y0)) {
+        g_tile_failed = true;
+        return false;
+    }
+    g_tile_rx0 = x0;
+    g_tile_ry0 = y0;
+    g_tile_rx1 = x1;
+    g_tile_ry1 = y1;
+    return true;
+}
+
+// The system's memory pressure changed. From MEDIUM on the detail tile
+// goes unless it is on screen; at CRITICAL it goes regardless and no new
+// one is decoded (the overview is shown enlarged) until pressure eases.
+// Returns true if the view needs drawing again.
+static bool memory_pressure(uint32_t level) {
+    if (level < Montauk::MEM_PRESSURE_CRITICAL && g_tile_failed && g_load_ok) {
+        g_tile_failed = false;
+        return update_tile();
+    }
+    if (level < Montauk::MEM_PRESSURE_MEDIUM || !g_tile.pixels) return false;
+
+    bool shown = current_level() == &g_tile;
+    if (shown && level < Montauk::MEM_PRESSURE_CRITICAL) return false;
+    free_level(g_tile);
+    if (level >= Montauk::MEM_PRESSURE_CRITICAL) g_tile_failed = true;
+    return shown;
+}
+
+// ============================================================================
+// Zoom and pan
+// ============================================================================
 
 static void clamp_pan() {
     int scaled_w = (int)(g_img_w * g_zoom);
@@ -268,7 +459,8 @@ static void render(Canvas& canvas) {
     canvas.fill_rect(0, vp_y0, g_win_w, vp_y1 - vp_y0, BG_COLOR);
 
     // Draw scaled image
-    if (g_image && g_load_ok) {
+    if (g_level_count > 0 && g_load_ok) {
+        const ImageLevel* lv = current_level();
         int scaled_w = (int)(g_img_w * g_zoom);
         int scaled_h = (int)(g_img_h * g_zoom);
 
@@ -278,20 +470,21 @@ static void render(Canvas& canvas) {
         int draw_x1 = g_pan_x + scaled_w > g_win_w ? g_win_w : g_pan_x + scaled_w;
         int draw_y1 = g_pan_y + scaled_h > vp_y1 ? vp_y1 : g_pan_y + scaled_h;
 
-        float inv_zoom = 1.0f / g_zoom;
+        // Screen pixels to pixels of the level
+        float step = 1.0f / (g_zoom * (float)(1 << lv->shift));
 
         for (int dy = draw_y0; dy < draw_y1; dy++) {
-            int src_y = (int)((dy - g_pan_y) * inv_zoom);
+            int src_y = (int)((dy - g_pan_y) * step) - lv->y0;
             if (src_y < 0) src_y = 0;
-            if (src_y >= g_img_h) src_y = g_img_h - 1;
+            if (src_y >= lv->h) src_y = lv->h - 1;
 
-            const uint32_t* src_row = &g_image[src_y * g_img_w];
+            const uint32_t* src_row = &lv->pixels[src_y * lv->w];
             uint32_t* dst_row = &canvas.pixels[dy * g_win_w];
 
             for (int dx = draw_x0; dx < draw_x1; dx++) {
-                int src_x = (int)((dx - g_pan_x) * inv_zoom);
+                int src_x = (int)((dx - g_pan_x) * step) - lv->x0;
                 if (src_x < 0) src_x = 0;
-                if (src_x >= g_img_w) src_x = g_img_w - 1;
+                if (src_x >= lv->w) src_x = lv->w - 1;
 
                 uint32_t spx = src_row[src_x];
                 uint8_t a = (spx >> 24) & 0xFF;
@@ -444,14 +637,7 @@ extern "C" void _start() {
     if (arglen <= 0) g_filepath[0] = '\0';
 
     // Load font
-    {
-        TrueTypeFont* f = (TrueTypeFont*)montauk::malloc(sizeof(TrueTypeFont));
-        if (f) {
-            montauk::memset(f, 0, sizeof(TrueTypeFont));
-            if (!f->init("0:/fonts/Roboto-Medium.ttf")) { montauk::mfree(f); f = nullptr; }
-        }
-        g_font = f;
-    }
+    g_font = fonts::open("0:/fonts/Roboto-Medium.ttf");
 
     // Load image
     if (g_filepath[0]) {
@@ -487,14 +673,31 @@ extern "C" void _start() {
 
     render(canvas);
     win.present();
+    if (update_tile()) {
+        render(canvas);
+        win.present();
+    }
 
     // Event loop
+    uint32_t pressure_events = 0;
     while (true) {
         Montauk::WinEvent ev;
         int r = win.poll(&ev);
 
         if (r < 0) break;
-        if (r == 0) { montauk::sleep_ms(16); continue; }
+        if (r == 0) {
+            Montauk::MemStats mem;
+            montauk::memstats(&mem);
+            if (mem.pressureEvents != pressure_events) {
+                pressure_events = mem.pressureEvents;
+                if (memory_pressure(mem.pressure)) {
+                    render(canvas);
+                    win.present();
+                }
+            }
+            montauk::sleep_ms(16);
+            continue;
+        }
 
         if (ev.type == 3) break; // close
 
@@ -506,6 +709,10 @@ extern "C" void _start() {
             canvas = win.canvas();
             render(canvas);
             win.present();
+            if (update_tile()) {
+                render(canvas);
+                win.present();
+            }
             continue;
         }
 
@@ -589,10 +796,16 @@ extern "C" void _start() {
             canvas = win.canvas();
             render(canvas);
             win.present();
+
+            // Show the enlarged overview at once, then the detail
+            if (update_tile()) {
+                render(canvas);
+                win.present();
+            }
         }
     }
 
-    if (g_image) montauk::mfree(g_image);
+    free_image();
     win.destroy();
     montauk::exit(0);
 }
@@ -1,11 +1,15 @@
 /*
     * main.cpp
     * Init system for MontaukOS (PID 0)
-    * Chains system services then launches the shell.
+    * Starts the system services in dependency order, in parallel where it can.
     * Copyright (c) 2026 Daniel Hammer
 */
 
 #include <montauk/syscall.h>
+#include <montauk/heap.h>
+#include <montauk/string.h>
+#include <montauk/toml.h>
+#include <montauk/service.h>
 
 // ---- Minimal snprintf ----
 
@@ -122,30 +126,268 @@ static void log_info(const char* msg) { log(LOG_INFO, msg); }
 static void log_warn(const char* msg) { log(LOG_WARN, msg); }
 static void log_err(const char* msg)  { log(LOG_ERR, msg); }
 
+// ---- Service manifest ----
+
+// Services are listed in MANIFEST_PATH, one [service.<name>] table each
+// (see data/services.toml). Every service with nothing left to wait on is
+// started at once; the rest follow as the services they come after get
+// ready, so boot takes as long as the longest chain, not the sum.
+
+static constexpr const char* MANIFEST_PATH = "0:/etc/services.toml";
+static constexpr int MAX_SERVICES = 32;
+static constexpr int MAX_DEPS     = 8;
+
+// The login -> desktop -> shell chain, should the manifest be missing
+static const char DEFAULT_MANIFEST[] =
+    "[service.dhcp]\n"
+    "path = \"0:/os/dhcp.elf\"\n"
+    "ready = \"exit\"\n"
+    "[service.login]\n"
+    "path = \"0:/os/login.elf\"\n"
+    "fallback = \"desktop\"\n"
+    "[service.desktop]\n"
+    "path = \"0:/os/desktop.elf\"\n"
+    "fallback = \"shell\"\n"
+    "boot = false\n"
+    "[service.shell]\n"
+    "path = \"0:/os/shell.elf\"\n"
+    "boot = false\n";
+
+enum class ReadyWhen { Start, Exit, Notify };
+
+enum class State {
+    Idle,       // only started as a fallback
+    Waiting,    // for the services it comes after
+    Running,    // started, not ready yet
+    Ready,
+    Done,       // exited after it was ready, or a one-shot job finished
+    Failed,
+};
+
+struct Service {
+    char      name[32];
+    char      path[128];
+    char      args[128];
+    int       deps[MAX_DEPS];
+    int       dep_count;
+    int       fallback;     // index, or -1
+    ReadyWhen ready;
+    State     state;
+    int       pid;
+    int       watcher;      // thread waiting for it to exit, -1 once it has
+    uint64_t  started_ms;
+};
+
+static Service g_services[MAX_SERVICES];
+static int     g_service_count = 0;
+
+static int find_service(const char* name) {
+    for (int i = 0; i < g_service_count; i++)
+        if (montauk::streq(g_services[i].name, name)) return i;
+    return -1;
+}
+
+static char* read_file(const char* path) {
+    int fh = montauk::open(path);
+    if (fh < 0) return nullptr;
+    uint64_t sz = montauk::getsize(fh);
+    if (sz == 0 || sz > 16384) { montauk::close(fh); return nullptr; }
+    char* text = (char*)montauk::malloc(sz + 1);
+    montauk::read(fh, (uint8_t*)text, 0, sz);
+    montauk::close(fh);
+    text[sz] = '\0';
+    return text;
+}
+
+static void load_manifest(const char* text) {
+    char msg[160];
+    auto doc = montauk::toml::parse(text);
+
+    // A service is a table with a path
+    for (int i = 0; i < doc.entries.count && g_service_count < MAX_SERVICES; i++) {
+        auto* v = doc.entries.items[i];
+        if (!v->key || v->type != montauk::toml::Type::String) continue;
+        if (!montauk::starts_with(v->key, "service.")) continue;
+        int klen = montauk::slen(v->key);
+        if (klen <= 13 || !montauk::streq(v->key + klen - 5, ".path")) continue;
+
+        Service* s = &g_services[g_service_count++];
+        int nlen = klen - 13;
+        if (nlen > (int)sizeof(s->name) - 1) nlen = sizeof(s->name) - 1;
+        montauk::memcpy(s->name, v->key + 8, nlen);
+        s->name[nlen] = '\0';
+        montauk::strncpy(s->path, v->str, sizeof(s->path));
+    }
+
+    for (int i = 0; i < g_service_count; i++) {
+        Service* s = &g_services[i];
+        char key[96];
+
+        snprintf(key, sizeof(key), "service.%s.args", s->name);
+        montauk::strncpy(s->args, doc.get_string(key), sizeof(s->args));
+
+        snprintf(key, sizeof(key), "service.%s.ready", s->name);
+        const char* ready = doc.get_string(key, "start");
+        s->ready = montauk::streq(ready, "exit")   ? ReadyWhen::Exit
+                 : montauk::streq(ready, "notify") ? ReadyWhen::Notify
+                 : ReadyWhen::Start;
+
+        snprintf(key, sizeof(key), "service.%s.boot", s->name);
+        s->state = doc.get_bool(key, true) ? State::Waiting : State::Idle;
+
+        snprintf(key, sizeof(key), "service.%s.fallback", s->name);
+        const char* fallback = doc.get_string(key);
+        s->fallback = fallback[0] ? find_service(fallback) : -1;
+        if (fallback[0] && s->fallback < 0) {
+            snprintf(msg, sizeof(msg), "%s: no service %s to fall back on", s->name, fallback);
+            log_warn(msg);
+        }
+
+        snprintf(key, sizeof(key), "service.%s.after", s->name);
+        s->dep_count = 0;
+        if (auto* after = doc.get_array(key)) {
+            for (int j = 0; j < after->array.count; j++) {
+                auto* dep = after->array.items[j];
+                if (dep->type != montauk::toml::Type::String) continue;
+                int idx = find_service(dep->str);
+                if (idx < 0 || idx == i) {
+                    snprintf(msg, sizeof(msg), "%s: ignoring unknown dependency %s", s->name, dep->str);
+                    log_warn(msg);
+                } else if (s->dep_count < MAX_DEPS) {
+                    s->deps[s->dep_count++] = idx;
+                }
+            }
+        }
+
+        s->pid = -1;
+        s->watcher = -1;
+    }
+
+    doc.destroy();
+}
+
 // ---- Service runner ----
 
-static bool run_service(const char* path, const char* name, bool wait = true) {
+// Watcher threads write the pid of a service that exited here, for the
+// main loop to pick up along with readiness notes
+static int32_t g_exit_pipe[2];
+
+static int watch_service(void* arg) {
+    int pid = (int)(intptr_t)arg;
+    montauk::waitpid(pid);
+    montauk::pipe_write(g_exit_pipe[1], &pid, sizeof(pid));
+    return 0;
+}
+
+static void fail_service(Service* s) {
+    s->state = State::Failed;
+    if (s->fallback < 0) return;
+
+    Service* f = &g_services[s->fallback];
+    if (f->state != State::Idle) return;
+    char msg[128];
+    snprintf(msg, sizeof(msg), "%s failed, falling back to %s", s->name, f->name);
+    log_warn(msg);
+    f->state = State::Waiting;
+}
+
+static void start_service(Service* s) {
     char msg[128];
 
-    snprintf(msg, sizeof(msg), "Starting %s", name);
+    snprintf(msg, sizeof(msg), "Starting %s", s->name);
     log_info(msg);
 
-    int pid = montauk::spawn(path);
+    int pid = montauk::spawn(s->path, s->args[0] ? s->args : nullptr);
     if (pid < 0) {
-        snprintf(msg, sizeof(msg), "Failed to start %s", name);
+        snprintf(msg, sizeof(msg), "Failed to start %s", s->name);
         log_err(msg);
-        return false;
+        fail_service(s);
+        return;
     }
 
-    if (wait) {
-        montauk::waitpid(pid);
-        snprintf(msg, sizeof(msg), "%s finished (pid %d)", name, pid);
-        log_ok(msg);
-    } else {
-        snprintf(msg, sizeof(msg), "%s spawned in background (pid %d)", name, pid);
-        log_ok(msg);
+    s->pid = pid;
+    s->started_ms = montauk::get_milliseconds();
+    s->watcher = montauk::thread_create(watch_service, (void*)(intptr_t)pid);
+    s->state = s->ready == ReadyWhen::Start ? State::Ready : State::Running;
+
+    // Without a watcher its exit goes unseen, so nothing waits on that
+    if (s->watcher < 0 && s->ready == ReadyWhen::Exit) s->state = State::Ready;
+
+    snprintf(msg, sizeof(msg), "%s started (pid %d)", s->name, pid);
+    log_ok(msg);
+}
+
+static Service* service_by_pid(int pid) {
+    for (int i = 0; i < g_service_count; i++)
+        if (g_services[i].pid == pid && g_services[i].watcher >= 0) return &g_services[i];
+    return nullptr;
+}
+
+static void service_exited(int pid) {
+    Service* s = service_by_pid(pid);
+    if (!s) return;
+    montauk::thread_join(s->watcher);
+    s->watcher = -1;
+
+    char msg[128];
+    unsigned ms = (unsigned)(montauk::get_milliseconds() - s->started_ms);
+    if (s->state == State::Running && s->ready == ReadyWhen::Notify) {
+        snprintf(msg, sizeof(msg), "%s exited before it was ready", s->name);
+        log_err(msg);
+        fail_service(s);
+        return;
     }
-    return true;
+    s->state = State::Done;
+    snprintf(msg, sizeof(msg), "%s finished after %u ms (pid %d)", s->name, ms, pid);
+    log_ok(msg);
+}
+
+static void service_notified(int pid) {
+    Service* s = service_by_pid(pid);
+    if (!s || s->state != State::Running || s->ready != ReadyWhen::Notify) return;
+    s->state = State::Ready;
+
+    char msg[128];
+    unsigned ms = (unsigned)(montauk::get_milliseconds() - s->started_ms);
+    snprintf(msg, sizeof(msg), "%s ready after %u ms", s->name, ms);
+    log_ok(msg);
+}
+
+// Start every waiting service whose dependencies are all ready, and give
+// up on those with one that failed. False if nothing changed.
+static bool start_ready_services() {
+    bool changed = false;
+    for (int i = 0; i < g_service_count; i++) {
+        Service* s = &g_services[i];
+        if (s->state != State::Waiting) continue;
+
+        const Service* failed = nullptr;
+        bool ready = true;
+        for (int j = 0; j < s->dep_count; j++) {
+            const Service* dep = &g_services[s->deps[j]];
+            if (dep->state == State::Failed) failed = dep;
+            else if (dep->state != State::Ready && dep->state != State::Done) ready = false;
+        }
+
+        if (failed) {
+            char msg[128];
+            snprintf(msg, sizeof(msg), "Not starting %s: %s failed", s->name, failed->name);
+            log_warn(msg);
+            fail_service(s);
+        } else if (ready) {
+            start_service(s);
+        } else {
+            continue;
+        }
+        changed = true;
+    }
+    return changed;
+}
+
+static bool services_alive() {
+    for (int i = 0; i < g_service_count; i++)
+        if (g_services[i].watcher >= 0) return true;
+    return false;
 }
 
 // ---- Main ----
@@ -154,16 +396,61 @@ extern "C" void _start() {
 
     log_info("The Montauk Operating System");
 
-    // ---- Stage 1: Network configuration (non-blocking) ----
-    run_service("0:/os/dhcp.elf", "dhcp", false);
+    char* text = read_file(MANIFEST_PATH);
+    if (text) {
+        load_manifest(text);
+        montauk::mfree(text);
+    }
+    if (g_service_count == 0) {
+        log_warn("No service manifest, using the built-in one");
+        load_manifest(DEFAULT_MANIFEST);
+    }
+
+    int epfd = montauk::epoll_create();
+    montauk::pipe(g_exit_pipe);
+    montauk::epoll_ctl(epfd, Montauk::EPOLL_CTL_ADD, Montauk::POLL_SRC_PIPE, g_exit_pipe[0], Montauk::POLL_IN);
+    int listener = montauk::chan_listen(montauk::INIT_CHANNEL);
+    if (listener > 0)
+        montauk::epoll_ctl(epfd, Montauk::EPOLL_CTL_ADD, Montauk::POLL_SRC_CHANNEL, listener, Montauk::POLL_IN);
+
+    while (start_ready_services()) {}
+
+    while (services_alive()) {
+        Montauk::PollEvent events[8];
+        int n = montauk::epoll_wait(epfd, events, 8, -1);
 
-    // ---- Stage 2: Login screen -> desktop (falls back to desktop, then shell) ----
-    if (!run_service("0:/os/login.elf", "login")) {
-        log_warn("Login failed, falling back to desktop");
-        if (!run_service("0:/os/desktop.elf", "desktop")) {
-            log_warn("Desktop failed, falling back to shell");
-            run_service("0:/os/shell.elf", "shell");
+        for (int i = 0; i < n; i++) {
+            const Montauk::PollEvent& ev = events[i];
+            if (ev.source == Montauk::POLL_SRC_PIPE) {
+                int pids[8];
+                int got = montauk::pipe_read(g_exit_pipe[0], pids, sizeof(pids));
+                for (int j = 0; j < got / (int)sizeof(int); j++)
+                    service_exited(pids[j]);
+            } else if (ev.id == listener) {
+                int ch = montauk::chan_accept(listener, Montauk::CHAN_NOWAIT);
+                if (ch > 0)
+                    montauk::epoll_ctl(epfd, Montauk::EPOLL_CTL_ADD, Montauk::POLL_SRC_CHANNEL, ch, Montauk::POLL_IN);
+            } else {
+                Montauk::ChanMsg msg;
+                int r;
+                while ((r = montauk::chan_recv(ev.id, &msg, Montauk::CHAN_NOWAIT)) > 0)
+                    if (msg.type == montauk::INIT_MSG_READY) service_notified(msg.senderPid);
+                if (r < 0) {
+                    montauk::epoll_ctl(epfd, Montauk::EPOLL_CTL_DEL, Montauk::POLL_SRC_CHANNEL, ev.id, 0);
+                    montauk::chan_close(ev.id);
+                }
+            }
         }
+
+        while (start_ready_services()) {}
+    }
+
+    // Nothing left running can get the rest going
+    for (int i = 0; i < g_service_count; i++) {
+        if (g_services[i].state != State::Waiting) continue;
+        char msg[128];
+        snprintf(msg, sizeof(msg), "%s never got to start", g_services[i].name);
+        log_err(msg);
     }
 
     log_warn("All services exited");
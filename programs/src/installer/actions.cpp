@@ -82,76 +82,50 @@ static void path_join(char* out, int outsize, const char* dir, const char* name)
 }
 
 // ============================================================================
-// Copy a single file from src_path to dst_path
+// Copy engine
 // ============================================================================
 
-static bool copy_file(const char* src_path, const char* dst_path) {
-    int src = montauk::open(src_path);
-    if (src < 0) return false;
-
-    uint64_t size = montauk::getsize(src);
-
-    // Create destination (returns handle)
-    int dst = montauk::fcreate(dst_path);
-    if (dst < 0) {
-        montauk::close(src);
-        return false;
-    }
-
-    if (size == 0) {
-        // Empty file — just create it
-        montauk::close(dst);
-        montauk::close(src);
-        return true;
-    }
-
-    // Use large buffer for faster copies (256 KB)
-    static constexpr uint64_t CHUNK = 256 * 1024;
-    uint8_t* buf = (uint8_t*)montauk::malloc(CHUNK);
-    if (!buf) {
-        montauk::close(dst);
-        montauk::close(src);
-        return false;
-    }
-
-    // Show progress for large files (> 1 MB)
-    bool show_progress = (size > 1024 * 1024);
-    uint64_t last_progress_mb = 0;
-
-    uint64_t offset = 0;
-    bool ok = true;
-    while (offset < size) {
-        uint64_t to_read = size - offset;
-        if (to_read > CHUNK) to_read = CHUNK;
-
-        int rd = montauk::read(src, buf, offset, to_read);
-        if (rd <= 0) { ok = false; break; }
-
-        int wr = montauk::fwrite(dst, buf, offset, rd);
-        if (wr < rd) { ok = false; break; }
-
-        offset += rd;
-
-        if (show_progress) {
-            uint64_t cur_mb = offset / (1024 * 1024);
-            if (cur_mb > last_progress_mb) {
-                last_progress_mb = cur_mb;
-                uint64_t total_mb = size / (1024 * 1024);
-                char prog[64];
-                snprintf(prog, sizeof(prog), "    %lu / %lu MB",
-                         (unsigned long)cur_mb, (unsigned long)total_mb);
-                set_status(prog);
-                flush_ui();
-            }
-        }
-    }
+// Files are queued on one engine as the walk finds them and stream
+// through its ring pipeline back to back; progress for the whole copy
+// replaces the per-file UI flush.
+static montauk::copy::Engine g_copier;
 
-    montauk::mfree(buf);
-    montauk::close(dst);
-    montauk::close(src);
+static void copy_progress(const montauk::copy::Progress& p, void*) {
+    static constexpr uint64_t MB = 1024 * 1024;
+    char prog[64];
+    snprintf(prog, sizeof(prog), "    %lu / %lu MB at %lu MB/s",
+             (unsigned long)(p.bytesDone / MB), (unsigned long)(p.bytesTotal / MB),
+             (unsigned long)(p.bytesPerSec / MB));
+    set_status(prog);
+    flush_ui();
+}
+
+static bool copy_begin() {
+    return g_copier.init(copy_progress);
+}
+
+// Wait for everything queued since copy_begin() and release the buffers
+static bool copy_end() {
+    bool ok = g_copier.finish();
+    if (!ok) {
+        char log_msg[64];
+        snprintf(log_msg, sizeof(log_msg), "  failed: %s", g_copier.failedPath);
+        add_log(log_msg);
+    }
+    g_copier.destroy();
     return ok;
 }
 
+// ============================================================================
+// Copy a single file from src_path to dst_path
+// ============================================================================
+
+static bool copy_file(const char* src_path, const char* dst_path) {
+    if (!copy_begin()) return false;
+    g_copier.add(src_path, dst_path);
+    return copy_end();
+}
+
 // ============================================================================
 // Recursively copy directory contents from ramdisk to target drive
 // ============================================================================
@@ -159,9 +133,10 @@ static bool copy_file(const char* src_path, const char* dst_path) {
 static int g_files_copied;
 static int g_dirs_created;
 
-// Copy all entries from src_dir (on ramdisk) to dst_dir (on target drive).
-// If skip_toplevel is non-null, skip that directory name at the top level.
-static bool copy_recursive(const char* src_dir, const char* dst_dir,
+// Queue all entries from src_dir (on ramdisk) for copying to dst_dir (on
+// target drive), creating its directories as it goes. If skip_toplevel is
+// non-null, skip that directory name at the top level.
+static bool queue_recursive(const char* src_dir, const char* dst_dir,
                             const char* skip_toplevel = nullptr) {
     const char* names[256];
     int count = montauk::readdir(src_dir, names, 256);
@@ -233,7 +208,7 @@ static bool copy_recursive(const char* src_dir, const char* dst_dir,
             char src_subdir[256];
             path_join(src_subdir, sizeof(src_subdir), src_dir, dir_name);
 
-            if (!copy_recursive(src_subdir, target_path))
+            if (!queue_recursive(src_subdir, target_path))
                 return false;
         } else {
             // Skip ramdisk and limine.conf — installed system boots from
@@ -256,9 +231,8 @@ static bool copy_recursive(const char* src_dir, const char* dst_dir,
             char log_msg[64];
             snprintf(log_msg, sizeof(log_msg), "  copy %s", basename);
             add_log(log_msg);
-            flush_ui();
 
-            if (!copy_file(src_path, dst_path))
+            if (!g_copier.add(src_path, dst_path))
                 return false;
 
             g_files_copied++;
@@ -268,6 +242,13 @@ static bool copy_recursive(const char* src_dir, const char* dst_dir,
     return true;
 }
 
+static bool copy_recursive(const char* src_dir, const char* dst_dir,
+                           const char* skip_toplevel = nullptr) {
+    if (!copy_begin()) return false;
+    bool queued = queue_recursive(src_dir, dst_dir, skip_toplevel);
+    return copy_end() && queued;
+}
+
 // ============================================================================
 // GPT + partition helper
 // ============================================================================
@@ -9,6 +9,7 @@
 #include <montauk/syscall.h>
 #include <montauk/string.h>
 #include <montauk/heap.h>
+#include <montauk/copy.h>
 #include <gui/gui.hpp>
 #include <gui/truetype.hpp>
 
@@ -262,14 +262,7 @@ extern "C" void _start() {
     g_state.step = STEP_MODE_SELECT;
 
     // Load font
-    {
-        TrueTypeFont* f = (TrueTypeFont*)montauk::malloc(sizeof(TrueTypeFont));
-        if (f) {
-            montauk::memset(f, 0, sizeof(TrueTypeFont));
-            if (!f->init("0:/fonts/Roboto-Medium.ttf")) { montauk::mfree(f); f = nullptr; }
-        }
-        g_font = f;
-    }
+    g_font = fonts::open("0:/fonts/Roboto-Medium.ttf");
 
     apply_scale(montauk::win_getscale());
 
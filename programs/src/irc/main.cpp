@@ -944,6 +944,14 @@ extern "C" void _start() {
 
     ui_render();
 
+    // Sleep between server lines and keystrokes instead of spinning
+    int epfd;
+    epfd = montauk::epoll_create();
+    if (epfd >= 0) {
+        montauk::epoll_ctl(epfd, Montauk::EPOLL_CTL_ADD, Montauk::POLL_SRC_SOCKET, irc.fd, Montauk::POLL_IN);
+        montauk::epoll_ctl(epfd, Montauk::EPOLL_CTL_ADD, Montauk::POLL_SRC_KEYBOARD, 0, Montauk::POLL_IN);
+    }
+
     // ---- Main loop ----
     while (running && irc.connected) {
         dirty = false;
@@ -1028,7 +1036,12 @@ extern "C" void _start() {
             }
         } else {
             if (!dirty) {
-                montauk::yield();
+                if (epfd >= 0) {
+                    Montauk::PollEvent ready[2];
+                    montauk::epoll_wait(epfd, ready, 2, -1);
+                } else {
+                    montauk::yield();
+                }
                 continue;
             }
         }
@@ -1036,6 +1049,7 @@ extern "C" void _start() {
         if (dirty) ui_render();
     }
 
+    if (epfd >= 0) montauk::epoll_close(epfd);
     if (irc.fd >= 0) {
         montauk::closesocket(irc.fd);
     }
@@ -19,16 +19,19 @@ using namespace gui;
 static constexpr int INIT_W = 718;
 static constexpr int INIT_H = 449;
 
-static constexpr int KLOG_READ_SIZE = 65536;
+static constexpr int KLOG_READ_SIZE = 65536;   // Text kept for refeeds
+static constexpr int KLOG_CHUNK     = 8192;    // Largest single read
 static constexpr int KLOG_POLL_MS   = 250;
 
 struct KlogState {
     TerminalState term;
     char* klog_buf;
     int last_len;
-    char last_tail_byte;
+    Montauk::KlogCursor cursor;     // Records already in klog_buf
     uint64_t last_poll_ms;
     uint32_t* last_pixels;
+    Montauk::WinRect present[2];    // What the last render changed
+    int present_count;              // -1: everything
 };
 
 static WsWindow g_win;
@@ -50,42 +53,56 @@ static void klog_refeed(int n) {
 
     g_klog.term.scrollback_lines = 0;
     g_klog.term.view_offset = 0;
+    g_klog.term.dirty = true;
     g_klog.term.cursor_x = 0;
     g_klog.term.cursor_y = 0;
     g_klog.term.current_fg = colors::TERM_FG;
     g_klog.term.current_bg = colors::TERM_BG;
 
-    TermCell* screen = term_screen_row(&g_klog.term, 0);
-    int total = g_klog.term.cols * g_klog.term.rows;
-    for (int i = 0; i < total; i++)
-        screen[i] = {' ', colors::TERM_FG, colors::TERM_BG};
+    for (int r = 0; r < g_klog.term.rows; r++) {
+        TermCell* row = term_screen_row(&g_klog.term, r);
+        for (int c = 0; c < g_klog.term.cols; c++)
+            row[c] = {' ', colors::TERM_FG, colors::TERM_BG};
+    }
 
     terminal_feed(&g_klog.term, g_klog.klog_buf + start, n - start);
 }
 
+// Drop the oldest whole lines until a full chunk fits behind the text
+static void klog_make_room() {
+    int keep = KLOG_READ_SIZE - KLOG_CHUNK;
+    if (g_klog.last_len <= keep) return;
+
+    int drop = g_klog.last_len - keep;
+    while (drop < g_klog.last_len && g_klog.klog_buf[drop - 1] != '\n')
+        drop++;
+    montauk::memmove(g_klog.klog_buf, g_klog.klog_buf + drop, g_klog.last_len - drop);
+    g_klog.last_len -= drop;
+}
+
+// Append the records logged since the last fetch, feeding them to the
+// terminal as well when `feed` is set. Returns whether any arrived.
+static bool klog_fetch(bool feed) {
+    bool any = false;
+    while (true) {
+        klog_make_room();
+        char* dst = g_klog.klog_buf + g_klog.last_len;
+        int n = (int)montauk::read_klog(dst, KLOG_CHUNK, &g_klog.cursor);
+        if (n <= 0) break;
+
+        if (feed) terminal_feed(&g_klog.term, dst, n);
+        g_klog.last_len += n;
+        any = true;
+    }
+    return any;
+}
+
 static bool klog_poll() {
     uint64_t now = montauk::get_milliseconds();
     if (now - g_klog.last_poll_ms < KLOG_POLL_MS) return false;
     g_klog.last_poll_ms = now;
 
-    int n = (int)montauk::read_klog(g_klog.klog_buf, KLOG_READ_SIZE);
-    if (n <= 0 && g_klog.last_len <= 0) return false;
-
-    if (n > g_klog.last_len) {
-        terminal_feed(&g_klog.term, g_klog.klog_buf + g_klog.last_len, n - g_klog.last_len);
-    } else if (n == g_klog.last_len && n > 0) {
-        if (g_klog.klog_buf[n - 1] != g_klog.last_tail_byte) {
-            klog_refeed(n);
-        } else {
-            return false;
-        }
-    } else if (n < g_klog.last_len) {
-        klog_refeed(n);
-    }
-
-    g_klog.last_len = n;
-    if (n > 0) g_klog.last_tail_byte = g_klog.klog_buf[n - 1];
-    return true;
+    return klog_fetch(true);
 }
 
 static bool klog_render() {
@@ -107,12 +124,16 @@ static bool klog_render() {
         g_klog.term.dirty = true;
     }
 
-    if (!g_klog.term.dirty) return false;
+    if (!terminal_needs_render(&g_klog.term)) return false;
 
-    bool was_dirty = g_klog.term.dirty;
-    terminal_render(&g_klog.term, g_win.pixels, g_win.width, g_win.height);
+    bool full = g_klog.term.dirty;
+    Rect damage = terminal_render(&g_klog.term, g_win.pixels, g_win.width, g_win.height);
+    g_klog.present_count = full ? -1 : 0;
+    if (!full && !damage.empty()) {
+        g_klog.present[g_klog.present_count++] = {damage.x, damage.y, damage.w, damage.h};
+    }
 
-    if (was_dirty && g_klog.term.scrollback_lines > 0) {
+    if (g_klog.term.scrollback_lines > 0) {
         int cell_h = mono_cell_height();
         int total_rows = g_klog.term.scrollback_lines + g_klog.term.rows;
         int total_h = total_rows * cell_h;
@@ -129,10 +150,20 @@ static bool klog_render() {
                 ? (scroll_from_top * (view_h - thumb_h)) / max_scroll : 0;
             c.fill_rect(sb_x, 0, sb_w, view_h, Color::from_rgb(0x33, 0x33, 0x33));
             c.fill_rect(sb_x, thumb_y, sb_w, thumb_h, Color::from_rgb(0x88, 0x88, 0x88));
+            if (!full) g_klog.present[g_klog.present_count++] = {sb_x, 0, sb_w, view_h};
         }
     }
 
-    return true;
+    return g_klog.present_count != 0;
+}
+
+// Present what the last klog_render changed
+static void klog_present() {
+    if (g_klog.present_count < 0) {
+        g_win.present();
+    } else {
+        g_win.present(g_klog.present, g_klog.present_count);
+    }
 }
 
 static void klog_handle_mouse(const Montauk::WinEvent& ev) {
@@ -179,15 +210,11 @@ extern "C" void _start() {
 
     g_klog.last_pixels = g_win.pixels;
 
-    int n = (int)montauk::read_klog(g_klog.klog_buf, KLOG_READ_SIZE);
-    if (n > 0) {
-        klog_refeed(n);
-        g_klog.last_len = n;
-        g_klog.last_tail_byte = g_klog.klog_buf[n - 1];
-    }
+    if (klog_fetch(false))
+        klog_refeed(g_klog.last_len);
 
     if (klog_render())
-        g_win.present();
+        klog_present();
 
     while (true) {
         bool redraw = klog_poll();
@@ -214,7 +241,7 @@ extern "C" void _start() {
         if (r < 0 || quit) break;
 
         if (redraw && klog_render())
-            g_win.present();
+            klog_present();
 
         if (r == 0)
             montauk::sleep_ms(16);
@@ -0,0 +1,137 @@
+/*
+    * main.cpp
+    * lockstat - Show contention on the kernel's named locks
+    * Copyright (c) 2026 Daniel Hammer
+*/
+
+#include <montauk/syscall.h>
+#include <montauk/string.h>
+
+using Montauk::LockStatInfo;
+
+static constexpr int MAX_LOCKS  = 256;
+static constexpr int NAME_WIDTH = 12;
+
+static LockStatInfo g_locks[MAX_LOCKS];
+
+static void print_int(uint64_t n) {
+    if (n == 0) {
+        montauk::putchar('0');
+        return;
+    }
+    char buf[20];
+    int i = 0;
+    while (n > 0) {
+        buf[i++] = '0' + (n % 10);
+        n /= 10;
+    }
+    for (int j = i - 1; j >= 0; j--) {
+        montauk::putchar(buf[j]);
+    }
+}
+
+static int digits(uint64_t n) {
+    int d = 1;
+    while (n >= 10) {
+        n /= 10;
+        d++;
+    }
+    return d;
+}
+
+static void pad(int n) {
+    for (int i = 0; i < n; i++) montauk::putchar(' ');
+}
+
+static void print_col(uint64_t n, int width) {
+    pad(width - digits(n));
+    print_int(n);
+}
+
+// Nanoseconds as right-aligned microseconds with one decimal
+static void print_us(uint64_t ns, int width) {
+    uint64_t us = ns / 1000;
+    pad(width - digits(us) - 2);
+    print_int(us);
+    montauk::putchar('.');
+    print_int((ns / 100) % 10);
+}
+
+// Most contended first, then the busiest
+static bool before(const LockStatInfo& a, const LockStatInfo& b) {
+    if (a.contended != b.contended) return a.contended > b.contended;
+    return a.acquisitions > b.acquisitions;
+}
+
+extern "C" void _start() {
+    char args[64];
+    montauk::getargs(args, sizeof(args));
+    const char* p = montauk::skip_spaces(args);
+
+    int reset = 0;
+    if (p[0] == '-' && p[1] == 'r' && (p[2] == '\0' || p[2] == ' ')) {
+        reset = 1;
+    } else if (*p) {
+        montauk::print("usage: lockstat [-r]\n");
+        montauk::exit(1);
+    }
+
+    int count = montauk::lockstat(g_locks, MAX_LOCKS, reset);
+    if (count < 0) {
+        montauk::print("lockstat: cannot read lock statistics\n");
+        montauk::exit(1);
+    }
+
+    // Locks sharing a name (one per CPU, say) are shown as one
+    int merged = 0;
+    for (int i = 0; i < count; i++) {
+        LockStatInfo& lock = g_locks[i];
+        int j = 0;
+        while (j < merged && !montauk::streq(g_locks[j].name, lock.name)) j++;
+        if (j == merged) {
+            g_locks[merged++] = lock;
+            continue;
+        }
+        LockStatInfo& into = g_locks[j];
+        into.acquisitions += lock.acquisitions;
+        into.contended += lock.contended;
+        into.spinNs += lock.spinNs;
+        if (lock.maxSpinNs > into.maxSpinNs) into.maxSpinNs = lock.maxSpinNs;
+        if (lock.maxHoldNs > into.maxHoldNs) into.maxHoldNs = lock.maxHoldNs;
+    }
+
+    for (int i = 1; i < merged; i++) {
+        LockStatInfo tmp = g_locks[i];
+        int j = i - 1;
+        while (j >= 0 && before(tmp, g_locks[j])) {
+            g_locks[j + 1] = g_locks[j];
+            j--;
+        }
+        g_locks[j + 1] = tmp;
+    }
+
+    montauk::print("lock            acquired  contended  cont%   spin(us)  maxspin(us)  maxhold(us)\n");
+    for (int i = 0; i < merged; i++) {
+        const LockStatInfo& lock = g_locks[i];
+        montauk::print(lock.name);
+        pad(NAME_WIDTH - montauk::slen(lock.name));
+
+        print_col(lock.acquisitions, 12);
+        print_col(lock.contended, 11);
+
+        // Percentage with one decimal
+        uint64_t permille = lock.acquisitions ? lock.contended * 1000 / lock.acquisitions : 0;
+        pad(7 - digits(permille / 10) - 2);
+        print_int(permille / 10);
+        montauk::putchar('.');
+        print_int(permille % 10);
+
+        print_us(lock.spinNs, 11);
+        print_us(lock.maxSpinNs, 13);
+        print_us(lock.maxHoldNs, 13);
+        montauk::putchar('\n');
+    }
+
+    if (reset) montauk::print("\nCounters reset.\n");
+    montauk::exit(0);
+}
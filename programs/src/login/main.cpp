@@ -18,9 +18,10 @@
 
 // Forward-declare stb_image functions (implementation in libjpeg.a).
 extern "C" {
-    unsigned char* stbi_load_from_memory(const unsigned char* buffer, int len,
-                                         int* x, int* y, int* channels_in_file,
-                                         int desired_channels);
+    unsigned int* stbi_load_jpeg_argb_from_memory(const unsigned char* buffer, int len, int scale_shift,
+                                                  int rx, int ry, int rw, int rh, int* out_x0, int* out_y0,
+                                                  int* x, int* y);
+    int stbi_info_from_memory(const unsigned char* buffer, int len, int* x, int* y, int* comp);
     void stbi_image_free(void* retval_from_stbi_load);
 }
 
@@ -157,22 +158,32 @@ static bool load_login_wallpaper(LoginState* ls) {
     montauk::close(fd);
     if (bytes_read <= 0) { montauk::mfree(filedata); return false; }
 
-    // Decode JPEG
-    int img_w, img_h, channels;
-    unsigned char* rgb = stbi_load_from_memory(filedata, bytes_read,
-                                               &img_w, &img_h, &channels, 3);
-    montauk::mfree(filedata);
-    if (!rgb) return false;
-
-    // Scale to cover screen (same algorithm as desktop wallpaper.hpp)
+    // Decode JPEG at the smallest scale (1/1 .. 1/8) whose cover crop
+    // still fills the screen (same algorithm as desktop wallpaper.hpp)
     int dst_w = ls->screen_w;
     int dst_h = ls->screen_h;
+    int img_w, img_h, channels;
+    if (!stbi_info_from_memory(filedata, bytes_read, &img_w, &img_h, &channels)) {
+        montauk::mfree(filedata);
+        return false;
+    }
+
+    int src_crop_w, src_crop_h, src_x0, src_y0;
+    bool wider = (int64_t)img_w * dst_h > (int64_t)img_h * dst_w;
+    src_crop_w = wider ? (int)((int64_t)img_h * dst_w / dst_h) : img_w;
+    src_crop_h = wider ? img_h : (int)((int64_t)img_w * dst_h / dst_w);
+    int shift = 0;
+    while (shift < 3 && (src_crop_w >> (shift + 1)) >= dst_w && (src_crop_h >> (shift + 1)) >= dst_h) shift++;
+
+    uint32_t* argb = (uint32_t*)stbi_load_jpeg_argb_from_memory(filedata, bytes_read, shift, 0, 0, 0, 0,
+                                                                nullptr, nullptr, &img_w, &img_h);
+    montauk::mfree(filedata);
+    if (!argb) return false;
 
     uint32_t* scaled = (uint32_t*)montauk::malloc((uint64_t)dst_w * dst_h * 4);
-    if (!scaled) { stbi_image_free(rgb); return false; }
+    if (!scaled) { stbi_image_free(argb); return false; }
 
-    int src_crop_w, src_crop_h, src_x0, src_y0;
-    if ((int64_t)img_w * dst_h > (int64_t)img_h * dst_w) {
+    if (wider) {
         src_crop_h = img_h;
         src_crop_w = (int)((int64_t)img_h * dst_w / dst_h);
         src_x0 = (img_w - src_crop_w) / 2;
@@ -188,19 +199,16 @@ static bool load_login_wallpaper(LoginState* ls) {
         int sy = src_y0 + (int)((int64_t)y * src_crop_h / dst_h);
         if (sy < 0) sy = 0;
         if (sy >= img_h) sy = img_h - 1;
+        const uint32_t* row = argb + (int64_t)sy * img_w;
         for (int x = 0; x < dst_w; x++) {
             int sx = src_x0 + (int)((int64_t)x * src_crop_w / dst_w);
             if (sx < 0) sx = 0;
             if (sx >= img_w) sx = img_w - 1;
-            int si = (sy * img_w + sx) * 3;
-            scaled[y * dst_w + x] = 0xFF000000u
-                | ((uint32_t)rgb[si] << 16)
-                | ((uint32_t)rgb[si + 1] << 8)
-                | (uint32_t)rgb[si + 2];
+            scaled[(int64_t)y * dst_w + x] = row[sx] | 0xFF000000u;
         }
     }
 
-    stbi_image_free(rgb);
+    stbi_image_free(argb);
 
     ls->bg_wallpaper = scaled;
     ls->bg_wallpaper_w = dst_w;
@@ -544,7 +552,7 @@ static void handle_key(LoginState* ls, const Montauk::KeyEvent& key) {
         } else {
             if (try_login(ls)) {
                 // Spawn desktop with username
-                int pid = montauk::spawn("0:/os/desktop.elf", ls->username);
+                int pid = montauk::spawn("0:/os/desktop.elf", ls->username, Montauk::PRIO_INTERACTIVE);
                 if (pid >= 0) {
                     montauk::setuser(pid, ls->username);
                     montauk::waitpid(pid);
@@ -687,7 +695,7 @@ static void handle_mouse(LoginState* ls) {
         // Login button
         if (mx >= x && mx < x + content_w && my >= y && my < y + BTN_H) {
             if (try_login(ls)) {
-                int pid = montauk::spawn("0:/os/desktop.elf", ls->username);
+                int pid = montauk::spawn("0:/os/desktop.elf", ls->username, Montauk::PRIO_INTERACTIVE);
                 if (pid >= 0) {
                     montauk::setuser(pid, ls->username);
                     montauk::waitpid(pid);
@@ -772,7 +780,7 @@ extern "C" void _start() {
             doc.destroy();
 
             // Launch desktop directly -- no login required
-            int pid = montauk::spawn("0:/os/desktop.elf", user);
+            int pid = montauk::spawn("0:/os/desktop.elf", user, Montauk::PRIO_INTERACTIVE);
             if (pid >= 0) {
                 montauk::setuser(pid, user);
                 montauk::waitpid(pid);
@@ -781,12 +781,166 @@ static int skipcomment (FILE *f, int *cp) {
 }
 
 
+#if defined(LUA_CHUNKCACHE)
+
+/*
+** Compiled chunk cache. A script loaded by file name is compiled once,
+** and its chunk (as 'lua_dump' writes it, with debug information) is
+** kept next to it in '<script>' LUA_CHUNKCACHE, behind a header with a
+** hash of the source. Later loads of the same source skip the parser.
+** A cache file that cannot be read or written is simply not used.
+*/
+
+#define CACHE_MAGIC	"LUACACH1"
+
+typedef struct CacheHeader {
+  char magic[8];
+  unsigned long long hash;  /* FNV-1a hash of the source */
+  unsigned long long size;  /* size of the source */
+} CacheHeader;
+
+
+typedef struct DumpB {
+  char *b;
+  size_t n;
+  size_t size;
+} DumpB;
+
+
+static int dumpwriter (lua_State *L, const void *p, size_t sz, void *ud) {
+  DumpB *d = (DumpB *)ud;
+  (void)L;  /* not used */
+  if (d->n + sz > d->size) {
+    size_t newsize = (d->size > 0) ? d->size * 2 : 4096;
+    char *newb;
+    while (newsize < d->n + sz) newsize *= 2;
+    newb = (char *)realloc(d->b, newsize);
+    if (newb == NULL) return 1;
+    d->b = newb;
+    d->size = newsize;
+  }
+  memcpy(d->b + d->n, p, sz);
+  d->n += sz;
+  return 0;
+}
+
+
+/*
+** Read file 'name' whole into a buffer from 'malloc'; NULL if it
+** cannot be read.
+*/
+static char *readwhole (const char *name, size_t *size) {
+  char *b = NULL;
+  long n;
+  FILE *f = fopen(name, "rb");
+  if (f == NULL) return NULL;
+  if (fseek(f, 0, SEEK_END) == 0 && (n = ftell(f)) >= 0 &&
+      fseek(f, 0, SEEK_SET) == 0) {
+    b = (char *)malloc((size_t)n + 1);
+    if (b != NULL && fread(b, 1, (size_t)n, f) != (size_t)n) {
+      free(b);
+      b = NULL;
+    }
+    *size = (size_t)n;
+  }
+  fclose(f);
+  return b;
+}
+
+
+/*
+** Load script 'filename' through its cache. Returns -1, leaving the
+** stack as it was, when it cannot: the file is unreadable, is already
+** a binary chunk, or 'mode' rules out text or binary chunks; the
+** caller then loads the file as usual.
+*/
+static int loadcached (lua_State *L, const char *filename,
+                       const char *mode) {
+  size_t size, csize, skip = 0, i;
+  unsigned long long h = 14695981039346656037ULL;
+  char *src, *cache, *cname;
+  int status;
+  if (mode != NULL && (strchr(mode, 't') == NULL || strchr(mode, 'b') == NULL))
+    return -1;
+  src = readwhole(filename, &size);
+  if (src == NULL) return -1;
+  if (size > 0 && src[0] == LUA_SIGNATURE[0]) {  /* binary file? */
+    free(src);
+    return -1;
+  }
+  cname = (char *)malloc(strlen(filename) + sizeof(LUA_CHUNKCACHE));
+  if (cname == NULL) {
+    free(src);
+    return -1;
+  }
+  strcpy(cname, filename);
+  strcat(cname, LUA_CHUNKCACHE);
+  for (i = 0; i < size; i++)
+    h = (h ^ (unsigned char)src[i]) * 1099511628211ULL;
+  lua_pushfstring(L, "@%s", filename);
+  cache = readwhole(cname, &csize);
+  if (cache != NULL && csize > sizeof(CacheHeader)) {
+    CacheHeader hd;
+    memcpy(&hd, cache, sizeof(hd));
+    if (memcmp(hd.magic, CACHE_MAGIC, sizeof(hd.magic)) == 0 &&
+        hd.hash == h && hd.size == size) {
+      status = luaL_loadbufferx(L, cache + sizeof(hd), csize - sizeof(hd),
+                                lua_tostring(L, -1), "b");
+      if (status == LUA_OK) {
+        free(cache);
+        free(cname);
+        free(src);
+        lua_remove(L, -2);  /* remove chunk name */
+        return LUA_OK;
+      }
+      lua_pop(L, 1);  /* stale or damaged cache: compile the source */
+    }
+  }
+  free(cache);
+  /* skip an optional BOM and a first-line comment, as 'skipcomment' */
+  if (size >= 3 && memcmp(src, "\xEF\xBB\xBF", 3) == 0) skip = 3;
+  if (skip < size && src[skip] == '#') {
+    while (skip < size && src[skip] != '\n') skip++;  /* keep the '\n' */
+  }
+  status = luaL_loadbufferx(L, src + skip, size - skip, lua_tostring(L, -1),
+                            mode);
+  if (status == LUA_OK) {
+    DumpB d = {NULL, 0, 0};
+    if (lua_dump(L, dumpwriter, &d, 0) == 0) {
+      FILE *f = fopen(cname, "wb");
+      if (f != NULL) {
+        CacheHeader hd;
+        memcpy(hd.magic, CACHE_MAGIC, sizeof(hd.magic));
+        hd.hash = h;
+        hd.size = size;
+        fwrite(&hd, sizeof(hd), 1, f);
+        fwrite(d.b, 1, d.n, f);
+        fclose(f);
+      }
+    }
+    free(d.b);
+  }
+  free(cname);
+  free(src);
+  lua_remove(L, -2);  /* remove chunk name */
+  return status;
+}
+
+#endif
+
+
 LUALIB_API int luaL_loadfilex (lua_State *L, const char *filename,
                                              const char *mode) {
   LoadF lf;
   int status, readstatus;
   int c;
   int fnameindex = lua_gettop(L) + 1;  /* index of filename on the stack */
+#if defined(LUA_CHUNKCACHE)
+  if (filename != NULL) {
+    status = loadcached(L, filename, mode);
+    if (status >= 0) return status;
+  }
+#endif
   if (filename == NULL) {
     lua_pushliteral(L, "=stdin");
     lf.f = stdin;
@@ -1023,6 +1177,93 @@ LUALIB_API const char *luaL_gsub (lua_State *L, const char *s,
 }
 
 
+#if defined(LUAI_POOLALLOC)
+
+/*
+** Pooled allocator. Lua passes the size of every block it frees or
+** resizes, so blocks up to POOL_MAX bytes need no header: they are cut
+** from shared arenas in POOL_GRAIN steps and, once freed, kept on a
+** free list per size for reuse. Strings, tables, closures and upvalues
+** are mostly this small and come and go with every collection; the C
+** library would add a header to each and round it up to a power of two.
+** Larger blocks go to 'realloc'.
+*/
+
+#define POOL_GRAIN	16
+#define POOL_MAX	256
+#define POOL_ARENA	(64 * 1024)
+
+typedef struct PoolFree {
+  struct PoolFree *next;
+} PoolFree;
+
+static PoolFree *pool_free[POOL_MAX / POOL_GRAIN];
+static char *pool_next;  /* unused part of the current arena */
+static char *pool_end;
+
+
+static int poolclass (size_t size) {
+  return (int)((size + POOL_GRAIN - 1) / POOL_GRAIN) - 1;
+}
+
+
+static void poolrelease (void *p, int c) {
+  PoolFree *b = (PoolFree *)p;
+  b->next = pool_free[c];
+  pool_free[c] = b;
+}
+
+
+static void *poolget (int c) {
+  size_t size = (size_t)(c + 1) * POOL_GRAIN;
+  char *b;
+  if (pool_free[c] != NULL) {
+    PoolFree *f = pool_free[c];
+    pool_free[c] = f->next;
+    return f;
+  }
+  if ((size_t)(pool_end - pool_next) < size) {  /* arena used up? */
+    char *arena = (char *)malloc(POOL_ARENA);
+    if (arena == NULL) return NULL;
+    if (pool_end - pool_next >= POOL_GRAIN)  /* keep the rest of the old one */
+      poolrelease(pool_next, (int)((pool_end - pool_next) / POOL_GRAIN) - 1);
+    pool_next = arena;
+    pool_end = arena + POOL_ARENA;
+  }
+  b = pool_next;
+  pool_next += size;
+  return b;
+}
+
+
+static void *l_alloc (void *ud, void *ptr, size_t osize, size_t nsize) {
+  int oc = (ptr != NULL && osize <= POOL_MAX) ? poolclass(osize) : -1;
+  void *newptr;
+  (void)ud;  /* not used */
+  if (nsize == 0) {
+    if (oc >= 0) poolrelease(ptr, oc);
+    else free(ptr);
+    return NULL;
+  }
+  if (nsize <= POOL_MAX) {
+    int nc = poolclass(nsize);
+    if (oc == nc) return ptr;  /* same class: nothing to do */
+    newptr = poolget(nc);
+  }
+  else if (oc < 0)  /* large (or new) to large */
+    return realloc(ptr, nsize);
+  else
+    newptr = malloc(nsize);
+  if (newptr != NULL && ptr != NULL) {
+    memcpy(newptr, ptr, (osize < nsize) ? osize : nsize);
+    if (oc >= 0) poolrelease(ptr, oc);
+    else free(ptr);
+  }
+  return newptr;
+}
+
+#else
+
 static void *l_alloc (void *ud, void *ptr, size_t osize, size_t nsize) {
   (void)ud; (void)osize;  /* not used */
   if (nsize == 0) {
@@ -1033,6 +1274,8 @@ static void *l_alloc (void *ud, void *ptr, size_t osize, size_t nsize) {
     return realloc(ptr, nsize);
 }
 
+#endif
+
 
 /*
 ** Standard panic funcion just prints an error message. The test
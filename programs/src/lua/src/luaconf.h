@@ -809,6 +809,22 @@
 ** without modifying the main part of the file.
 */
 
+#if defined(__MONTAUKOS__)
+
+/*
+@@ LUA_CHUNKCACHE is the suffix of the file next to a script in which
+** 'luaL_loadfilex' keeps the script's compiled chunk, so that an
+** unchanged script is not parsed again. Undefine it to always parse.
+*/
+#define LUA_CHUNKCACHE		".cache"
+
+/*
+@@ LUAI_POOLALLOC makes 'luaL_newstate' allocate small blocks from
+** size-class pools instead of the C library's heap.
+*/
+#define LUAI_POOLALLOC
+
+#endif
 
 
 
@@ -62,8 +62,18 @@ struct ManLine {
     bool        isTH;
 };
 
+// The pager's search: '/' starts it and each key typed searches again,
+// 'n' finds the next match. The current match is shown in reverse video.
+struct ManSearch {
+    montauk::IncrementalSearch find;
+    bool prompting = false;
+    int savedScroll = 0;
+};
+
 static void man_render(ManLine* lines, int totalLines, int scroll, int rows, int cols,
-                       const char* name, int section) {
+                       const char* name, int section, const ManSearch& search) {
+    const char* hit = search.find.match >= 0 ? search.find.text + search.find.match : nullptr;
+
     int contentRows = rows - 1;
 
     for (int r = 0; r < contentRows; r++) {
@@ -88,17 +98,29 @@ static void man_render(ManLine* lines, int totalLines, int scroll, int rows, int
         if (ln.isSS) maxW -= 3;
         int printLen = ln.len;
         if (printLen > maxW) printLen = maxW;
+        bool inHit = false;
         for (int c = 0; c < printLen; c++) {
-            montauk::putchar(ln.text[c]);
+            const char* ch = ln.text + c;
+            bool h = hit && ch >= hit && ch < hit + search.find.len;
+            if (h != inHit) montauk::print(h ? "\033[7m" : "\033[27m");
+            inHit = h;
+            montauk::putchar(*ch);
         }
+        if (inHit) montauk::print("\033[27m");
 
         if (ln.isSH || ln.isSS || ln.isBold) {
             montauk::print("\033[0m");
         }
     }
 
-    // Status bar
+    // Status bar, or the search prompt
     cursor_to(rows, 1);
+    if (search.prompting) {
+        montauk::print("\033[2K/");
+        montauk::print(search.find.query);
+        if (search.find.len > 0 && search.find.match < 0) montauk::print("  (not found)");
+        return;
+    }
     montauk::print("\033[7m");
     montauk::print(" Manual page ");
     montauk::print(name);
@@ -116,6 +138,16 @@ static void man_render(ManLine* lines, int totalLines, int scroll, int rows, int
     montauk::print("\033[0m");
 }
 
+// Scroll so the line holding the match is at the top
+static int man_scroll_to(ManLine* lines, int totalLines, int64_t match, const char* text,
+                         int scroll, int maxScroll) {
+    if (match < 0) return scroll;
+    const char* hit = text + match;
+    int line = 0;
+    for (int i = 0; i < totalLines && lines[i].text <= hit; i++) line = i;
+    return line < maxScroll ? line : maxScroll;
+}
+
 // ---- Main ----
 
 extern "C" void _start() {
@@ -278,7 +310,10 @@ extern "C" void _start() {
     int maxScroll = totalLines - (rows - 1);
     if (maxScroll < 0) maxScroll = 0;
 
-    man_render(lines, totalLines, scroll, rows, cols, topic, foundSection);
+    ManSearch search;
+    search.find.begin(fileData, offset, 0, true);
+
+    man_render(lines, totalLines, scroll, rows, cols, topic, foundSection, search);
 
     // Event loop — yield while waiting for key input
     bool running = true;
@@ -293,7 +328,36 @@ extern "C" void _start() {
 
         int contentRows = rows - 1;
 
+        if (search.prompting) {
+            int64_t match = search.find.match;
+            if (ev.ascii == '\n' || ev.ascii == '\r') {
+                search.prompting = false;
+            } else if (ev.scancode == 0x01) { // Escape
+                search.prompting = false;
+                search.find.match = -1;
+                scroll = search.savedScroll;
+            } else if (ev.ascii == '\b' || ev.scancode == 0x0E) {
+                match = search.find.erase();
+            } else if (ev.ascii >= 32 && ev.ascii < 127) {
+                match = search.find.type(ev.ascii);
+            }
+            if (search.prompting)
+                scroll = man_scroll_to(lines, totalLines, match, fileData,
+                                       match >= 0 ? scroll : search.savedScroll, maxScroll);
+            man_render(lines, totalLines, scroll, rows, cols, topic, foundSection, search);
+            continue;
+        }
+
         switch (ev.ascii) {
+            case '/':
+                // A new search starts from the top of the page shown
+                search.find.begin(fileData, offset, lines[scroll].text - fileData, true);
+                search.prompting = true;
+                search.savedScroll = scroll;
+                break;
+            case 'n':
+                scroll = man_scroll_to(lines, totalLines, search.find.next(), fileData, scroll, maxScroll);
+                break;
             case 'q':
                 running = false;
                 break;
@@ -345,7 +409,7 @@ extern "C" void _start() {
         }
 
         if (running) {
-            man_render(lines, totalLines, scroll, rows, cols, topic, foundSection);
+            man_render(lines, totalLines, scroll, rows, cols, topic, foundSection, search);
         }
     }
 
@@ -1,13 +1,14 @@
 /*
  * main.cpp
  * MontaukOS Mandelbrot - standalone Window Server app
- * Preserves the desktop app's fixed-point renderer and interaction model
+ * Tiled, progressive renderer spread across one worker thread per CPU
  * Copyright (c) 2026 Daniel Hammer
  */
 
 #include <montauk/syscall.h>
 #include <montauk/string.h>
 #include <montauk/heap.h>
+#include <montauk/sync.h>
 #include <gui/gui.hpp>
 #include <gui/standalone.hpp>
 #include <gui/truetype.hpp>
@@ -28,36 +29,69 @@ static constexpr int MB_MAX_ITER = 256;
 static constexpr int MB_TOOLBAR_H = 32;
 static constexpr int UI_FONT_SIZE = 18;
 
-using fp_t = int64_t;
-static constexpr int FP_SHIFT = 36;
+// The frame is cut into MB_TILE-square tiles that workers take in turn.
+// Pass 0 computes one pixel per MB_COARSE block and fills the block with
+// it, so a usable picture appears quickly; pass 1 computes every pixel.
+static constexpr int MB_TILE = 64;
+static constexpr int MB_COARSE = 8;
+static constexpr int MB_PASSES = 2;
+static constexpr int MB_MAX_WORKERS = 16;
 
 static TrueTypeFont* g_font = nullptr;
 
-static inline fp_t fp_from_int(int v) { return (fp_t)v << FP_SHIFT; }
-
-static inline fp_t fp_mul(fp_t a, fp_t b) {
-    __int128 r = (__int128)a * b;
-    return (fp_t)(r >> FP_SHIFT);
-}
-
-static inline fp_t fp_div_small(int a, int b) {
-    return ((fp_t)a << FP_SHIFT) / (fp_t)b;
-}
-
 struct MandelbrotState {
-    fp_t center_x;
-    fp_t center_y;
-    fp_t scale;
+    double center_x;
+    double center_y;
+    double scale;
     int max_iter;
     bool needs_render;
 
     bool dragging;
     int drag_start_x;
     int drag_start_y;
-    fp_t drag_start_cx;
-    fp_t drag_start_cy;
+    double drag_start_cx;
+    double drag_start_cy;
+};
+
+// View and target of the frame being rendered. Only changed by the UI
+// thread while no tile is in flight.
+struct FrameParams {
+    double x_min;
+    double y_min;
+    double scale;
+    int max_iter;
+    uint32_t* pixels;   // render area only, below the toolbar
+    int w, h;
+    int tiles_x;
+    int tile_count;
 };
 
+struct RenderJob {
+    montauk::Mutex lock;
+    montauk::CondVar work;      // tiles to take, or stop
+    montauk::CondVar idle;      // busy dropped to zero
+
+    FrameParams frame;
+    uint32_t gen;               // bumped to abandon the frame in flight
+    int pass;                   // MB_PASSES once the frame is finished
+    int next_tile;
+    int tiles_done;             // of the current pass
+    int busy;                   // workers inside render_tile
+    bool stop;
+
+    volatile uint32_t progress; // bumped per finished tile; UI presents on change
+    uint64_t start_ms;
+    uint64_t elapsed_ms;
+};
+
+static RenderJob g_job;
+static int g_workers[MB_MAX_WORKERS];
+static int g_worker_count = 0;
+static bool g_avx2 = false;
+static uint32_t* g_frame = nullptr;
+static int g_frame_w = 0;
+static int g_frame_h = 0;
+
 static int ui_text_h() {
     return text_height(g_font, UI_FONT_SIZE);
 }
@@ -72,9 +106,9 @@ static void ui_draw_text(Canvas& c, int x, int y, const char* text, Color color)
 }
 
 static void reset_view(MandelbrotState* mb, int width_hint) {
-    mb->center_x = -fp_from_int(1) / 2;
-    mb->center_y = 0;
-    mb->scale = fp_div_small(3, width_hint > 0 ? width_hint : 400);
+    mb->center_x = -0.5;
+    mb->center_y = 0.0;
+    mb->scale = 3.0 / (width_hint > 0 ? width_hint : 400);
     mb->max_iter = MB_MAX_ITER;
     mb->needs_render = true;
     mb->dragging = false;
@@ -99,42 +133,267 @@ static uint32_t mandelbrot_color(int iter, int max_iter) {
     return 0xFF000000 | ((uint32_t)r << 16) | ((uint32_t)g << 8) | b;
 }
 
-static void mandelbrot_render(MandelbrotState* mb, uint32_t* pixels, int w, int h) {
-    int render_h = h - MB_TOOLBAR_H;
-    if (render_h <= 0) return;
-
-    fp_t half_w = fp_mul(fp_from_int(w / 2), mb->scale);
-    fp_t half_h = fp_mul(fp_from_int(render_h / 2), mb->scale);
-    fp_t x_min = mb->center_x - half_w;
-    fp_t y_min = mb->center_y - half_h;
-    fp_t bailout = fp_from_int(4);
-
-    for (int py = 0; py < render_h; py++) {
-        fp_t ci = y_min + fp_mul(fp_from_int(py), mb->scale);
-        uint32_t* row = pixels + (py + MB_TOOLBAR_H) * w;
-
-        for (int px = 0; px < w; px++) {
-            fp_t cr = x_min + fp_mul(fp_from_int(px), mb->scale);
-
-            fp_t zr = 0;
-            fp_t zi = 0;
-            int iter = 0;
-
-            while (iter < mb->max_iter) {
-                fp_t zr2 = fp_mul(zr, zr);
-                fp_t zi2 = fp_mul(zi, zi);
-                if (zr2 + zi2 > bailout) break;
-                fp_t new_zr = zr2 - zi2 + cr;
-                zi = fp_mul(fp_from_int(2), fp_mul(zr, zi)) + ci;
-                zr = new_zr;
-                iter++;
+// ---- Iteration ----
+
+typedef double v2df __attribute__((vector_size(16)));
+typedef int64_t v2di __attribute__((vector_size(16)));
+typedef double v4df __attribute__((vector_size(32)));
+typedef int64_t v4di __attribute__((vector_size(32)));
+
+// Points in the main cardioid or the period-2 bulb never escape, and they
+// are most of the black area, so they are answered without iterating.
+static inline bool in_main_bulbs(double x, double y) {
+    double y2 = y * y;
+    double xq = x - 0.25;
+    double q = xq * xq + y2;
+    if (q * (q + xq) <= 0.25 * y2) return true;
+    double xb = x + 1.0;
+    return xb * xb + y2 <= 0.0625;
+}
+
+// Each lane iterates one pixel of a row. A lane drops out when it escapes,
+// or when z comes back exactly to a value saved at the last power-of-two
+// step (Brent's cycle check): that orbit is periodic and never escapes.
+// Lanes start out inactive if in_main_bulbs already settled them.
+static void iterate2(const double* cr, double ci, int max_iter, int* out) {
+    v2df vcr = {cr[0], cr[1]};
+    v2df vci = (v2df){} + ci;
+    v2df four = (v2df){} + 4.0;
+    v2df zr = {}, zi = {}, sr = {}, si = {};
+    v2di interior = {in_main_bulbs(cr[0], ci) ? -1 : 0, in_main_bulbs(cr[1], ci) ? -1 : 0};
+    v2di active = ~interior;
+    v2di count = {};
+    int save_at = 8;
+
+    for (int it = 0; it < max_iter; it++) {
+        v2df zr2 = zr * zr, zi2 = zi * zi;
+        active &= (zr2 + zi2 <= four);
+        if (!__builtin_ia32_movmskpd((v2df)active)) break;
+        count -= active;
+        v2df t = zr * zi;
+        zi = t + t + vci;
+        zr = zr2 - zi2 + vcr;
+        if (it == save_at) {
+            sr = zr; si = zi;
+            save_at <<= 1;
+        } else {
+            v2di cycle = (zr == sr) & (zi == si) & active;
+            interior |= cycle;
+            active &= ~cycle;
+        }
+    }
+
+    for (int i = 0; i < 2; i++) out[i] = interior[i] ? max_iter : (int)count[i];
+}
+
+__attribute__((target("avx2")))
+static void iterate4(const double* cr, double ci, int max_iter, int* out) {
+    v4df vcr = {cr[0], cr[1], cr[2], cr[3]};
+    v4df vci = (v4df){} + ci;
+    v4df four = (v4df){} + 4.0;
+    v4df zr = {}, zi = {}, sr = {}, si = {};
+    v4di interior;
+    for (int i = 0; i < 4; i++) interior[i] = in_main_bulbs(cr[i], ci) ? -1 : 0;
+    v4di active = ~interior;
+    v4di count = {};
+    int save_at = 8;
+
+    for (int it = 0; it < max_iter; it++) {
+        v4df zr2 = zr * zr, zi2 = zi * zi;
+        active &= (zr2 + zi2 <= four);
+        if (!__builtin_ia32_movmskpd256((v4df)active)) break;
+        count -= active;
+        v4df t = zr * zi;
+        zi = t + t + vci;
+        zr = zr2 - zi2 + vcr;
+        if (it == save_at) {
+            sr = zr; si = zi;
+            save_at <<= 1;
+        } else {
+            v4di cycle = (zr == sr) & (zi == si) & active;
+            interior |= cycle;
+            active &= ~cycle;
+        }
+    }
+
+    for (int i = 0; i < 4; i++) out[i] = interior[i] ? max_iter : (int)count[i];
+}
+
+// Iteration counts for n points on one row. cr must have room for n
+// rounded up to a multiple of 4; the tail is padded with the last point.
+static void iterate_row(double* cr, int n, double ci, int max_iter, int* out) {
+    int lanes = g_avx2 ? 4 : 2;
+    int padded = (n + lanes - 1) / lanes * lanes;
+    for (int i = n; i < padded; i++) cr[i] = cr[n - 1];
+
+    int tail[4];
+    for (int i = 0; i < n; i += lanes) {
+        int* dst = i + lanes <= n ? out + i : tail;
+        if (g_avx2) iterate4(cr + i, ci, max_iter, dst);
+        else iterate2(cr + i, ci, max_iter, dst);
+        if (dst == tail)
+            for (int k = 0; i + k < n; k++) out[i + k] = tail[k];
+    }
+}
+
+// ---- Tiles and workers ----
+
+// Renders one tile of `pass`. Gives up between rows once the frame it
+// belongs to has been abandoned. Touches no heap, so it is safe to run on
+// any thread.
+static void render_tile(const FrameParams& f, int tile, int pass, uint32_t gen) {
+    int tx = (tile % f.tiles_x) * MB_TILE;
+    int ty = (tile / f.tiles_x) * MB_TILE;
+    int tw = f.w - tx < MB_TILE ? f.w - tx : MB_TILE;
+    int th = f.h - ty < MB_TILE ? f.h - ty : MB_TILE;
+    int step = pass == 0 ? MB_COARSE : 1;
+
+    double cr[MB_TILE + 4];
+    int iters[MB_TILE];
+
+    for (int y = 0; y < th; y += step) {
+        if (__atomic_load_n(&g_job.gen, __ATOMIC_RELAXED) != gen) return;
+
+        int n = 0;
+        for (int x = 0; x < tw; x += step)
+            cr[n++] = f.x_min + (tx + x) * f.scale;
+        iterate_row(cr, n, f.y_min + (ty + y) * f.scale, f.max_iter, iters);
+
+        int y1 = y + step < th ? y + step : th;
+        for (int i = 0; i < n; i++) {
+            uint32_t color = mandelbrot_color(iters[i], f.max_iter);
+            int x0 = i * step;
+            int x1 = x0 + step < tw ? x0 + step : tw;
+            for (int yy = y; yy < y1; yy++) {
+                uint32_t* row = f.pixels + (ty + yy) * f.w + tx;
+                for (int x = x0; x < x1; x++) row[x] = color;
             }
+        }
+    }
+}
 
-            row[px] = mandelbrot_color(iter, mb->max_iter);
+// Called with g_job.lock held after a tile of the current frame finished
+static void tile_finished() {
+    __atomic_fetch_add(&g_job.progress, 1, __ATOMIC_RELEASE);
+    if (++g_job.tiles_done < g_job.frame.tile_count) return;
+
+    g_job.tiles_done = 0;
+    g_job.next_tile = 0;
+    if (++g_job.pass == MB_PASSES)
+        g_job.elapsed_ms = montauk::get_milliseconds() - g_job.start_ms;
+    else
+        g_job.work.broadcast();
+}
+
+static int render_worker(void*) {
+    g_job.lock.lock();
+    for (;;) {
+        if (g_job.stop) break;
+        if (g_job.pass >= MB_PASSES || g_job.next_tile >= g_job.frame.tile_count) {
+            g_job.work.wait(g_job.lock);
+            continue;
         }
+
+        FrameParams f = g_job.frame;
+        int tile = g_job.next_tile++;
+        int pass = g_job.pass;
+        uint32_t gen = g_job.gen;
+        g_job.busy++;
+        g_job.lock.unlock();
+
+        render_tile(f, tile, pass, gen);
+
+        g_job.lock.lock();
+        g_job.busy--;
+        if (gen == g_job.gen) tile_finished();
+        if (g_job.busy == 0) g_job.idle.broadcast();
     }
+    g_job.lock.unlock();
+    return 0;
+}
+
+static void start_workers() {
+    g_avx2 = montauk::simd::avx2();
+
+    int cpus = __builtin_popcountll(montauk::get_affinity(-1));
+    if (cpus > MB_MAX_WORKERS) cpus = MB_MAX_WORKERS;
+    g_job.pass = MB_PASSES;
+    for (int i = 0; i < cpus; i++) {
+        int tid = montauk::thread_create(render_worker);
+        if (tid < 0) break;
+        g_workers[g_worker_count++] = tid;
+    }
+}
+
+static void stop_workers() {
+    g_job.lock.lock();
+    g_job.stop = true;
+    __atomic_fetch_add(&g_job.gen, 1, __ATOMIC_RELAXED);
+    g_job.work.broadcast();
+    g_job.lock.unlock();
+    for (int i = 0; i < g_worker_count; i++)
+        montauk::thread_join(g_workers[i]);
+    g_worker_count = 0;
+}
+
+// Abandons the frame in flight and waits for the workers to let go of it,
+// which takes at most one row of a tile each.
+static void cancel_frame() {
+    g_job.lock.lock();
+    __atomic_fetch_add(&g_job.gen, 1, __ATOMIC_RELAXED);
+    g_job.pass = MB_PASSES;
+    while (g_job.busy > 0) g_job.idle.wait(g_job.lock);
+    g_job.lock.unlock();
+}
 
+static void start_frame(MandelbrotState* mb, int w, int h) {
+    cancel_frame();
     mb->needs_render = false;
+
+    int render_h = h - MB_TOOLBAR_H;
+    if (w <= 0 || render_h <= 0) return;
+
+    if (w != g_frame_w || render_h != g_frame_h) {
+        if (g_frame) montauk::mfree(g_frame);
+        g_frame = (uint32_t*)montauk::malloc((uint64_t)w * render_h * 4);
+        g_frame_w = g_frame ? w : 0;
+        g_frame_h = g_frame ? render_h : 0;
+        if (!g_frame) return;
+        montauk::memset(g_frame, 0, (uint64_t)w * render_h * 4);
+    }
+
+    FrameParams& f = g_job.frame;
+    f.x_min = mb->center_x - (w / 2) * mb->scale;
+    f.y_min = mb->center_y - (render_h / 2) * mb->scale;
+    f.scale = mb->scale;
+    f.max_iter = mb->max_iter;
+    f.pixels = g_frame;
+    f.w = w;
+    f.h = render_h;
+    f.tiles_x = (w + MB_TILE - 1) / MB_TILE;
+    f.tile_count = f.tiles_x * ((render_h + MB_TILE - 1) / MB_TILE);
+
+    g_job.lock.lock();
+    g_job.start_ms = montauk::get_milliseconds();
+    g_job.next_tile = 0;
+    g_job.tiles_done = 0;
+    g_job.pass = 0;
+    uint32_t gen = g_job.gen;
+    g_job.work.broadcast();
+    g_job.lock.unlock();
+
+    // No threads to hand it to: render the whole frame here
+    if (g_worker_count == 0) {
+        for (int pass = 0; pass < MB_PASSES; pass++)
+            for (int t = 0; t < f.tile_count; t++)
+                render_tile(f, t, pass, gen);
+        g_job.pass = MB_PASSES;
+        g_job.elapsed_ms = montauk::get_milliseconds() - g_job.start_ms;
+    }
+}
+
+static bool frame_in_progress() {
+    return __atomic_load_n(&g_job.pass, __ATOMIC_RELAXED) < MB_PASSES;
 }
 
 static void draw_toolbar(MandelbrotState* mb, Canvas& c) {
@@ -158,16 +417,35 @@ static void draw_toolbar(MandelbrotState* mb, Canvas& c) {
     draw_button(c, g_font, btn_x + 28, 4, 24, 24, "+",
                 step_bg, colors::WHITE, 4, UI_FONT_SIZE);
 
+    char stat_str[48];
+    int threads = g_worker_count > 0 ? g_worker_count : 1;
+    if (frame_in_progress())
+        snprintf(stat_str, sizeof(stat_str), "%d threads  ...", threads);
+    else
+        snprintf(stat_str, sizeof(stat_str), "%d threads  %d ms", threads, (int)g_job.elapsed_ms);
+    int stat_x = btn_x + 60;
+    ui_draw_text(c, stat_x, text_y, stat_str, colors::TEXT_COLOR);
+
     const char* hint = "Scroll=zoom  Drag=pan";
     int hint_w = ui_text_w(hint);
-    ui_draw_text(c, c.w - hint_w - 8, text_y, hint, Color::from_rgb(0x99, 0x99, 0x99));
+    if (c.w - hint_w - 8 > stat_x + ui_text_w(stat_str) + 8)
+        ui_draw_text(c, c.w - hint_w - 8, text_y, hint, Color::from_rgb(0x99, 0x99, 0x99));
 }
 
+// Copies whatever the workers have finished so far into the window. Tiles
+// still being written show up half done; the next present catches up.
 static void render(MandelbrotState* mb, WsWindow& win) {
     Canvas c = win.canvas();
 
     if (mb->needs_render)
-        mandelbrot_render(mb, c.pixels, c.w, c.h);
+        start_frame(mb, c.w, c.h);
+
+    if (g_frame) {
+        int w = g_frame_w < c.w ? g_frame_w : c.w;
+        int h = g_frame_h < c.h - MB_TOOLBAR_H ? g_frame_h : c.h - MB_TOOLBAR_H;
+        for (int y = 0; y < h; y++)
+            montauk::memcpy(c.pixels + (y + MB_TOOLBAR_H) * c.w, g_frame + y * g_frame_w, (uint64_t)w * 4);
+    }
 
     draw_toolbar(mb, c);
 }
@@ -223,8 +501,8 @@ static bool handle_mouse(MandelbrotState* mb, const MouseEvent& ev, int win_w, i
     if (mb->dragging && ev.left_held()) {
         int dx = lx - mb->drag_start_x;
         int dy = ly - mb->drag_start_y;
-        mb->center_x = mb->drag_start_cx - fp_mul(fp_from_int(dx), mb->scale);
-        mb->center_y = mb->drag_start_cy - fp_mul(fp_from_int(dy), mb->scale);
+        mb->center_x = mb->drag_start_cx - dx * mb->scale;
+        mb->center_y = mb->drag_start_cy - dy * mb->scale;
         mb->needs_render = true;
         return true;
     }
@@ -234,16 +512,16 @@ static bool handle_mouse(MandelbrotState* mb, const MouseEvent& ev, int win_w, i
 
     if (ev.scroll != 0 && ly >= MB_TOOLBAR_H) {
         int render_h = win_h - MB_TOOLBAR_H;
-        fp_t mx_frac = mb->center_x + fp_mul(fp_from_int(lx - win_w / 2), mb->scale);
-        fp_t my_frac = mb->center_y + fp_mul(fp_from_int((ly - MB_TOOLBAR_H) - render_h / 2), mb->scale);
+        double mx_frac = mb->center_x + (lx - win_w / 2) * mb->scale;
+        double my_frac = mb->center_y + ((ly - MB_TOOLBAR_H) - render_h / 2) * mb->scale;
 
         if (ev.scroll < 0)
-            mb->scale = fp_mul(mb->scale, fp_from_int(3) / 4);
+            mb->scale *= 0.75;
         else
-            mb->scale = fp_mul(mb->scale, fp_from_int(4) / 3);
+            mb->scale *= 4.0 / 3.0;
 
-        fp_t new_mx = mb->center_x + fp_mul(fp_from_int(lx - win_w / 2), mb->scale);
-        fp_t new_my = mb->center_y + fp_mul(fp_from_int((ly - MB_TOOLBAR_H) - render_h / 2), mb->scale);
+        double new_mx = mb->center_x + (lx - win_w / 2) * mb->scale;
+        double new_my = mb->center_y + ((ly - MB_TOOLBAR_H) - render_h / 2) * mb->scale;
         mb->center_x += mx_frac - new_mx;
         mb->center_y += my_frac - new_my;
         mb->needs_render = true;
@@ -283,14 +561,7 @@ static bool handle_key(MandelbrotState* mb, const Montauk::KeyEvent& key, int wi
 }
 
 extern "C" void _start() {
-    g_font = (TrueTypeFont*)montauk::malloc(sizeof(TrueTypeFont));
-    if (g_font) {
-        montauk::memset(g_font, 0, sizeof(TrueTypeFont));
-        if (!g_font->init("0:/fonts/Roboto-Medium.ttf")) {
-            montauk::mfree(g_font);
-            g_font = nullptr;
-        }
-    }
+    g_font = fonts::open("0:/fonts/Roboto-Medium.ttf");
 
     MandelbrotState mb = {};
     reset_view(&mb, INIT_W);
@@ -299,9 +570,13 @@ extern "C" void _start() {
     if (!win.create("Mandelbrot", INIT_W, INIT_H))
         montauk::exit(1);
 
+    start_workers();
     render(&mb, win);
     win.present();
 
+    uint32_t shown_progress = 0;
+    bool shown_done = false;
+
     while (true) {
         Montauk::WinEvent ev;
         int r = win.poll(&ev);
@@ -309,6 +584,15 @@ extern "C" void _start() {
         if (r < 0) break;
 
         if (r == 0) {
+            // Show new tiles as they land, and the final timing once
+            uint32_t progress = __atomic_load_n(&g_job.progress, __ATOMIC_ACQUIRE);
+            bool done = !frame_in_progress();
+            if (progress != shown_progress || done != shown_done) {
+                shown_progress = progress;
+                shown_done = done;
+                render(&mb, win);
+                win.present();
+            }
             montauk::sleep_ms(16);
             continue;
         }
@@ -341,6 +625,7 @@ extern "C" void _start() {
         }
     }
 
+    stop_workers();
     win.destroy();
     montauk::exit(0);
 }
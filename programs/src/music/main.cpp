@@ -49,8 +49,20 @@ static constexpr int MAX_FILTER     = 64;
 
 // Decode buffer: one MP3 frame = up to 1152 samples * 2 channels
 static constexpr int PCM_BUF_SAMPLES = 1152 * 2;
+// Decoded audio waiting for the device: 32 frames, ~0.8 s of 44.1 kHz
+// stereo. Divisible by 1-4, 6 and 8 channels, so a wrap never splits a
+// sample frame.
+static constexpr int PCM_RING_SAMPLES = PCM_BUF_SAMPLES * 32;
 // Audio write chunk size (bytes) — feed in small chunks for responsiveness
 static constexpr int AUDIO_CHUNK     = 4096;
+// Frames decoded per main loop pass at most, so the UI stays responsive
+static constexpr int DECODE_AHEAD_FRAMES = 8;
+
+// Input window: the part of the file around the decode position. It is
+// refilled once fewer than STREAM_LOOKAHEAD bytes are left in it, which
+// is enough for minimp3 to find sync across several frames.
+static constexpr int STREAM_BUF_SIZE  = 64 * 1024;
+static constexpr int STREAM_LOOKAHEAD = 16 * 1024;
 
 static constexpr Color BG_COLOR       = Color::from_rgb(0xFF, 0xFF, 0xFF);
 static constexpr Color TOOLBAR_BG     = Color::from_rgb(0xF5, 0xF5, 0xF5);
@@ -119,16 +131,24 @@ struct PlayerState {
     // Audio handle
     int audio_handle;
 
-    // File data (entire file loaded into memory)
-    uint8_t* file_data;
+    // Open track. Only a window of it is resident at a time.
+    int file_handle;
     uint64_t file_size;
+    uint8_t* stream_buf;
+    uint64_t stream_base;    // file offset of stream_buf[0]
+    int stream_len;
 
     // MP3 decoder
     mp3dec_t mp3dec;
-    uint64_t mp3_offset;     // current read position in file_data
+    uint64_t mp3_audio_start; // file offset past any ID3v2 tag
+    uint64_t mp3_offset;      // file offset of the next frame to decode
+    uint64_t mp3_samples;     // samples before the frame at mp3_offset
+    // Frames seen so far, in file order. Grows as playback decodes and
+    // when a seek goes past its end.
     Mp3Frame* mp3_frames;
     int mp3_frame_count;
     int mp3_frame_cap;
+    uint64_t mp3_index_next;  // file offset just past the last indexed frame
     uint64_t mp3_seek_discard_samples;
     int sample_rate;
     int channels;
@@ -139,13 +159,18 @@ struct PlayerState {
     uint64_t wav_pos;         // current position in PCM data
 
     // Timing
-    uint64_t total_samples;   // total decoded samples (per channel)
+    uint64_t total_samples;   // per channel; an estimate until the end is reached
     uint64_t played_samples;  // samples fed to audio device
 
-    // PCM buffer for decoded audio
+    // One decoded MP3 frame
     int16_t pcm_buf[PCM_BUF_SAMPLES];
-    int pcm_buf_len;     // samples remaining in pcm_buf
-    int pcm_buf_pos;     // current read position in pcm_buf
+
+    // Decode-ahead ring of interleaved samples feeding the audio device
+    int16_t pcm_ring[PCM_RING_SAMPLES];
+    uint64_t ring_read;       // samples taken out since ring_anchor
+    uint64_t ring_write;      // samples put in since ring_anchor
+    uint64_t ring_anchor;     // played_samples when the ring was last emptied
+    bool source_done;         // input exhausted; play out the ring, then advance
 
     // Progress dragging
     bool dragging_progress;
@@ -596,10 +621,12 @@ static bool parse_wav(const uint8_t* data, uint64_t size) {
             g.channels = fmt->channels;
             g.wav_data_offset = chunk_data;
             g.wav_data_size = chunk->size;
+            if (g.wav_data_offset + g.wav_data_size > g.file_size)
+                g.wav_data_size = g.file_size - g.wav_data_offset;
             g.wav_pos = 0;
             int bytes_per_sample = (fmt->bits_per_sample / 8) * fmt->channels;
             if (bytes_per_sample > 0)
-                g.total_samples = chunk->size / bytes_per_sample;
+                g.total_samples = g.wav_data_size / bytes_per_sample;
             return true;
         }
 
@@ -609,6 +636,49 @@ static bool parse_wav(const uint8_t* data, uint64_t size) {
     return false;
 }
 
+// ============================================================================
+// Streaming input
+// ============================================================================
+
+// Makes the file from `pos` resident, at least STREAM_LOOKAHEAD bytes of
+// it unless the file ends sooner, and returns how many bytes are
+// available at stream_at(pos).
+static int stream_ensure(uint64_t pos) {
+    if (pos >= g.file_size) return 0;
+
+    uint64_t end = g.stream_base + (uint64_t)g.stream_len;
+    if (pos < g.stream_base || pos > end) {
+        g.stream_base = pos;
+        g.stream_len = 0;
+        end = pos;
+    }
+
+    if (end - pos < STREAM_LOOKAHEAD && end < g.file_size) {
+        int keep = (int)(end - pos);
+        montauk::memmove(g.stream_buf, g.stream_buf + (pos - g.stream_base), keep);
+        g.stream_base = pos;
+        g.stream_len = keep;
+
+        // Read in chunks (syscall may have size limits)
+        while (g.stream_len < STREAM_BUF_SIZE) {
+            uint64_t off = g.stream_base + (uint64_t)g.stream_len;
+            if (off >= g.file_size) break;
+            uint64_t chunk = (uint64_t)(STREAM_BUF_SIZE - g.stream_len);
+            if (chunk > g.file_size - off) chunk = g.file_size - off;
+            if (chunk > 32768) chunk = 32768;
+            int rd = montauk::read(g.file_handle, g.stream_buf + g.stream_len, off, chunk);
+            if (rd <= 0) break;
+            g.stream_len += rd;
+        }
+    }
+
+    return (int)(g.stream_base + (uint64_t)g.stream_len - pos);
+}
+
+static const uint8_t* stream_at(uint64_t pos) {
+    return g.stream_buf + (pos - g.stream_base);
+}
+
 // ============================================================================
 // MP3 helpers
 // ============================================================================
@@ -641,47 +711,78 @@ static bool push_mp3_frame(uint32_t offset, uint64_t samples_before, uint16_t sa
     return true;
 }
 
-static bool build_mp3_index(uint64_t start_offset) {
-    free_mp3_index();
-    g.total_samples = 0;
-    g.sample_rate = 0;
-    g.channels = 0;
+static uint64_t mp3_index_end_samples() {
+    if (g.mp3_frame_count <= 0) return 0;
+    const Mp3Frame& last = g.mp3_frames[g.mp3_frame_count - 1];
+    return last.samples_before + last.sample_count;
+}
+
+// Samples per channel in a frame, from its header alone
+static int mp3_frame_samples(const mp3dec_frame_info_t& info) {
+    if (info.layer == 1) return 384;
+    if (info.layer == 3 && info.hz < 32000) return 576;
+    return 1152;
+}
+
+// Records a frame found at `pos` (before any junk minimp3 skipped) unless
+// the index already covers it.
+static void note_mp3_frame(uint64_t pos, const mp3dec_frame_info_t& info,
+                           uint64_t samples_before, int samples) {
+    uint64_t start = pos + (uint64_t)info.frame_offset;
+    if (start < g.mp3_index_next) return;
+    push_mp3_frame((uint32_t)start, samples_before, (uint16_t)samples);
+    g.mp3_index_next = pos + (uint64_t)info.frame_bytes;
+}
+
+static uint32_t read_be32(const uint8_t* p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+// Frame count from a Xing/Info or VBRI header in the first frame, 0 if
+// there is none
+static uint32_t mp3_vbr_frames(const uint8_t* frame, int avail, const mp3dec_frame_info_t& info) {
+    if (info.layer != 3) return 0;
+
+    // Xing/Info sits right after the side information
+    bool mpeg1 = info.hz >= 32000;
+    int xing = 4 + (mpeg1 ? (info.channels == 1 ? 17 : 32)
+                          : (info.channels == 1 ? 9 : 17));
+    if (xing + 12 <= avail &&
+        (montauk::memcmp(frame + xing, "Xing", 4) == 0 ||
+         montauk::memcmp(frame + xing, "Info", 4) == 0)) {
+        uint32_t flags = read_be32(frame + xing + 4);
+        return (flags & 1) ? read_be32(frame + xing + 8) : 0;
+    }
+
+    // VBRI is always 32 bytes past the header
+    if (36 + 18 <= avail && montauk::memcmp(frame + 36, "VBRI", 4) == 0)
+        return read_be32(frame + 36 + 14);
+    return 0;
+}
 
+// Walks frame headers (minimp3 without an output buffer does not decode)
+// from the end of the index until it covers `target` or the file ends.
+// Reaching the end pins down the exact length.
+static void extend_mp3_index(uint64_t target) {
     mp3dec_t scan_dec;
     mp3dec_init(&scan_dec);
 
-    uint64_t offset = start_offset;
-    while (offset < g.file_size) {
+    uint64_t pos = g.mp3_frame_count > 0 ? g.mp3_index_next : g.mp3_audio_start;
+    uint64_t samples = mp3_index_end_samples();
+    while (samples <= target) {
+        int avail = stream_ensure(pos);
         mp3dec_frame_info_t info = {};
-        int samples = mp3dec_decode_frame(&scan_dec,
-                                          g.file_data + offset,
-                                          (int)(g.file_size - offset),
-                                          nullptr, &info);
-        if (info.frame_bytes <= 0) break;
-
-        if (samples > 0 && info.hz > 0 && info.channels > 0) {
-            uint32_t frame_offset = (uint32_t)(offset + (uint64_t)info.frame_offset);
-            if (!push_mp3_frame(frame_offset, g.total_samples, (uint16_t)samples)) {
-                free_mp3_index();
-                return false;
-            }
-            if (g.sample_rate == 0) {
-                g.sample_rate = info.hz;
-                g.channels = info.channels;
-            }
-            g.total_samples += (uint64_t)samples;
+        int n = avail > 0 ? mp3dec_decode_frame(&scan_dec, stream_at(pos), avail, nullptr, &info) : 0;
+        if (info.frame_bytes <= 0) {
+            g.total_samples = samples;
+            break;
         }
-
-        offset += (uint64_t)info.frame_bytes;
-    }
-
-    if (g.mp3_frame_count <= 0 || g.sample_rate <= 0 || g.channels <= 0) {
-        free_mp3_index();
-        return false;
+        if (n > 0) {
+            note_mp3_frame(pos, info, samples, n);
+            samples += (uint64_t)n;
+        }
+        pos += (uint64_t)info.frame_bytes;
     }
-
-    g.mp3_offset = g.mp3_frames[0].offset;
-    return true;
 }
 
 static int pick_shuffled_track(int current) {
@@ -697,10 +798,13 @@ static void seek_to_samples(uint64_t target_samples) {
     if (g.play_state == PlayState::Stopped || g.total_samples == 0) return;
     if (target_samples > g.total_samples) target_samples = g.total_samples;
 
-    g.pcm_buf_len = 0;
-    g.pcm_buf_pos = 0;
+    g.ring_read = 0;
+    g.ring_write = 0;
+    g.ring_anchor = target_samples;
+    g.source_done = false;
 
     if (g.current_track >= 0 && g.files[g.current_track].is_mp3) {
+        if (target_samples >= mp3_index_end_samples()) extend_mp3_index(target_samples);
         if (g.mp3_frame_count <= 0) return;
         int lo = 0;
         int hi = g.mp3_frame_count - 1;
@@ -717,8 +821,9 @@ static void seek_to_samples(uint64_t target_samples) {
 
         const Mp3Frame& frame = g.mp3_frames[best];
         g.mp3_offset = frame.offset;
-        g.played_samples = frame.samples_before;
+        g.mp3_samples = frame.samples_before;
         g.mp3_seek_discard_samples = target_samples - frame.samples_before;
+        g.played_samples = target_samples;
         mp3dec_init(&g.mp3dec);
     } else {
         int bytes_per_frame = 2 * g.channels;
@@ -737,17 +842,27 @@ static void stop_playback() {
         montauk::audio_close(g.audio_handle);
         g.audio_handle = -1;
     }
-    if (g.file_data) {
-        montauk::mfree(g.file_data);
-        g.file_data = nullptr;
+    if (g.file_handle >= 0) {
+        montauk::close(g.file_handle);
+        g.file_handle = -1;
+    }
+    if (g.stream_buf) {
+        montauk::mfree(g.stream_buf);
+        g.stream_buf = nullptr;
     }
+    g.stream_base = 0;
+    g.stream_len = 0;
     free_mp3_index();
     music_visualizer::reset(g.visualizer);
     g.play_state = PlayState::Stopped;
     g.played_samples = 0;
-    g.pcm_buf_len = 0;
-    g.pcm_buf_pos = 0;
+    g.ring_read = 0;
+    g.ring_write = 0;
+    g.ring_anchor = 0;
+    g.source_done = false;
     g.mp3_offset = 0;
+    g.mp3_samples = 0;
+    g.mp3_index_next = 0;
     g.wav_pos = 0;
 }
 
@@ -760,61 +875,64 @@ static bool start_track(int index) {
     char path[MAX_PATH * 2];
     snprintf(path, sizeof(path), "%s/%s", g.dir_path, g.files[index].name);
 
-    // Open and read entire file
-    int fh = montauk::open(path);
-    if (fh < 0) return false;
+    // Open the file; it is read a window at a time as playback goes
+    g.file_handle = montauk::open(path);
+    if (g.file_handle < 0) return false;
 
-    g.file_size = montauk::getsize(fh);
-    if (g.file_size == 0 || g.file_size > 64 * 1024 * 1024) { // 64 MiB limit
-        montauk::close(fh);
-        return false;
-    }
-
-    g.file_data = (uint8_t*)montauk::malloc(g.file_size);
-    if (!g.file_data) {
-        montauk::close(fh);
-        return false;
-    }
-
-    // Read in chunks (syscall may have size limits)
-    uint64_t off = 0;
-    while (off < g.file_size) {
-        uint64_t chunk = g.file_size - off;
-        if (chunk > 32768) chunk = 32768;
-        int rd = montauk::read(fh, g.file_data + off, off, chunk);
-        if (rd <= 0) break;
-        off += rd;
-    }
-    montauk::close(fh);
-
-    if (off < g.file_size) {
-        montauk::mfree(g.file_data);
-        g.file_data = nullptr;
+    g.file_size = montauk::getsize(g.file_handle);
+    g.stream_buf = (uint8_t*)montauk::malloc(STREAM_BUF_SIZE);
+    if (g.file_size == 0 || !g.stream_buf) {
+        stop_playback();
         return false;
     }
 
     // Parse format
     if (g.files[index].is_mp3) {
         mp3dec_init(&g.mp3dec);
-        g.mp3_offset = 0;
+        g.mp3_audio_start = 0;
 
         // Skip ID3v2
-        if (g.file_size >= 10 && g.file_data[0] == 'I' && g.file_data[1] == 'D' && g.file_data[2] == '3') {
-            g.mp3_offset = 10 + (((uint64_t)(g.file_data[6] & 0x7F) << 21) |
-                                  ((uint64_t)(g.file_data[7] & 0x7F) << 14) |
-                                  ((uint64_t)(g.file_data[8] & 0x7F) << 7)  |
-                                  ((uint64_t)(g.file_data[9] & 0x7F)));
+        int avail = stream_ensure(0);
+        const uint8_t* head = stream_at(0);
+        if (avail >= 10 && head[0] == 'I' && head[1] == 'D' && head[2] == '3') {
+            g.mp3_audio_start = 10 + (((uint64_t)(head[6] & 0x7F) << 21) |
+                                      ((uint64_t)(head[7] & 0x7F) << 14) |
+                                      ((uint64_t)(head[8] & 0x7F) << 7)  |
+                                      ((uint64_t)(head[9] & 0x7F)));
         }
 
-        if (!build_mp3_index(g.mp3_offset)) {
-            montauk::mfree(g.file_data);
-            g.file_data = nullptr;
+        // The first frame gives the format, and the length if it carries
+        // a VBR header; otherwise estimate it from the bitrate
+        mp3dec_t probe_dec;
+        mp3dec_init(&probe_dec);
+        mp3dec_frame_info_t info = {};
+        avail = stream_ensure(g.mp3_audio_start);
+        if (avail > 0)
+            mp3dec_decode_frame(&probe_dec, stream_at(g.mp3_audio_start), avail, nullptr, &info);
+        if (info.frame_bytes <= 0 || info.hz <= 0 || info.channels <= 0) {
+            stop_playback();
             return false;
         }
+        g.sample_rate = info.hz;
+        g.channels = info.channels;
+
+        uint32_t vbr_frames = mp3_vbr_frames(stream_at(g.mp3_audio_start) + info.frame_offset,
+                                             avail - info.frame_offset, info);
+        uint64_t audio_bytes = g.file_size - g.mp3_audio_start;
+        if (vbr_frames > 0)
+            g.total_samples = (uint64_t)vbr_frames * mp3_frame_samples(info);
+        else if (info.bitrate_kbps > 0)
+            g.total_samples = audio_bytes * 8 * (uint64_t)info.hz / ((uint64_t)info.bitrate_kbps * 1000);
+        else
+            g.total_samples = 0;
+
+        g.mp3_offset = g.mp3_audio_start;
+        g.mp3_samples = 0;
+        g.mp3_index_next = 0;
     } else {
-        if (!parse_wav(g.file_data, g.file_size)) {
-            montauk::mfree(g.file_data);
-            g.file_data = nullptr;
+        int avail = stream_ensure(0);
+        if (!parse_wav(stream_at(0), (uint64_t)avail)) {
+            stop_playback();
             return false;
         }
     }
@@ -822,17 +940,17 @@ static bool start_track(int index) {
     // Open audio device
     g.audio_handle = montauk::audio_open(g.sample_rate, g.channels, 16);
     if (g.audio_handle < 0) {
-        free_mp3_index();
-        montauk::mfree(g.file_data);
-        g.file_data = nullptr;
+        stop_playback();
         return false;
     }
 
     g.current_track = index;
     g.play_state = PlayState::Playing;
     g.played_samples = 0;
-    g.pcm_buf_len = 0;
-    g.pcm_buf_pos = 0;
+    g.ring_read = 0;
+    g.ring_write = 0;
+    g.ring_anchor = 0;
+    g.source_done = false;
     g.mp3_seek_discard_samples = 0;
     music_visualizer::reset(g.visualizer);
 
@@ -904,94 +1022,121 @@ static void prev_track() {
 // Audio feeding — call from the main loop
 // ============================================================================
 
+// Room left in the ring, and where the next contiguous run of it starts
+static int ring_space(int* contiguous) {
+    int free = PCM_RING_SAMPLES - (int)(g.ring_write - g.ring_read);
+    int idx = (int)(g.ring_write % PCM_RING_SAMPLES);
+    *contiguous = free < PCM_RING_SAMPLES - idx ? free : PCM_RING_SAMPLES - idx;
+    return free;
+}
+
+static void ring_push(const int16_t* pcm, int count) {
+    while (count > 0) {
+        int run;
+        ring_space(&run);
+        if (run > count) run = count;
+        montauk::memcpy(g.pcm_ring + g.ring_write % PCM_RING_SAMPLES, pcm, (uint64_t)run * 2);
+        g.ring_write += run;
+        pcm += run;
+        count -= run;
+    }
+}
+
+// Decodes one MP3 frame into the ring. The caller makes sure a whole
+// frame fits.
+static void decode_mp3_frame() {
+    int avail = stream_ensure(g.mp3_offset);
+    mp3dec_frame_info_t info = {};
+    int samples = avail > 0 ? mp3dec_decode_frame(&g.mp3dec, stream_at(g.mp3_offset), avail,
+                                                  g.pcm_buf, &info) : 0;
+    if (info.frame_bytes <= 0) {
+        // Can't decode — end. The length is known exactly now.
+        g.source_done = true;
+        g.total_samples = g.mp3_samples;
+        return;
+    }
+
+    // A frame that could not be decoded (missing bit reservoir right
+    // after a seek) still takes up its time in the stream
+    int frame_samples = samples > 0 ? samples : (info.hz > 0 ? mp3_frame_samples(info) : 0);
+    if (frame_samples > 0) note_mp3_frame(g.mp3_offset, info, g.mp3_samples, frame_samples);
+    g.mp3_offset += (uint64_t)info.frame_bytes;
+    g.mp3_samples += (uint64_t)frame_samples;
+    if (g.mp3_samples > g.total_samples) g.total_samples = g.mp3_samples;
+
+    if (samples <= 0) return;
+    int skip = 0;
+    if (g.mp3_seek_discard_samples > 0) {
+        uint64_t discard = g.mp3_seek_discard_samples;
+        if (discard > (uint64_t)samples) discard = (uint64_t)samples;
+        g.mp3_seek_discard_samples -= discard;
+        skip = (int)discard;
+    }
+    ring_push(g.pcm_buf + skip * info.channels, (samples - skip) * info.channels);
+}
+
+// Copies the next stretch of WAV data into the ring
+static void decode_wav_chunk() {
+    uint64_t remaining = g.wav_data_size - g.wav_pos;
+    int avail = remaining > 0 ? stream_ensure(g.wav_data_offset + g.wav_pos) : 0;
+    int block = 2 * g.channels;
+
+    int run;
+    ring_space(&run);
+    uint64_t bytes = (uint64_t)run * 2;
+    if (bytes > (uint64_t)avail) bytes = (uint64_t)avail;
+    if (bytes > remaining) bytes = remaining;
+    bytes -= bytes % (uint64_t)block;
+    if (bytes == 0) {
+        g.source_done = true;
+        return;
+    }
+
+    montauk::memcpy(g.pcm_ring + g.ring_write % PCM_RING_SAMPLES,
+                    stream_at(g.wav_data_offset + g.wav_pos), bytes);
+    g.ring_write += bytes / 2;
+    g.wav_pos += bytes;
+}
+
+// Keeps the ring topped up, a bounded amount of work per call
+static void decode_ahead() {
+    bool mp3 = g.current_track >= 0 && g.files[g.current_track].is_mp3;
+    for (int i = 0; i < DECODE_AHEAD_FRAMES && !g.source_done; i++) {
+        int run;
+        int free = ring_space(&run);
+        if (free < PCM_BUF_SAMPLES) break;
+        if (mp3) decode_mp3_frame();
+        else decode_wav_chunk();
+    }
+}
+
 static void feed_audio() {
     if (g.play_state != PlayState::Playing) return;
     if (g.audio_handle < 0) return;
 
+    decode_ahead();
+
     // Try to feed a chunk of audio data
     for (int iter = 0; iter < 4; iter++) {
-        // If we have leftover PCM in the buffer, write it
-        if (g.pcm_buf_len > 0) {
-            int bytes_avail = g.pcm_buf_len * 2; // 16-bit samples
-            int to_write = bytes_avail > AUDIO_CHUNK ? AUDIO_CHUNK : bytes_avail;
-            int written = montauk::audio_write(g.audio_handle,
-                                                (const uint8_t*)(g.pcm_buf + g.pcm_buf_pos),
-                                                to_write);
-            if (written <= 0) return; // device buffer full, try later
-            int samples_written = written / 2;
-            g.pcm_buf_pos += samples_written;
-            g.pcm_buf_len -= samples_written;
-            g.played_samples += samples_written / g.channels;
-            continue;
+        int avail = (int)(g.ring_write - g.ring_read);
+        if (avail <= 0) {
+            // Ring drained and nothing left to decode — advance to next track
+            if (g.source_done) next_track(true);
+            return;
         }
 
-        // Decode more audio
-        g.pcm_buf_pos = 0;
-        g.pcm_buf_len = 0;
+        int idx = (int)(g.ring_read % PCM_RING_SAMPLES);
+        if (avail > PCM_RING_SAMPLES - idx) avail = PCM_RING_SAMPLES - idx;
+        int to_write = avail * 2 > AUDIO_CHUNK ? AUDIO_CHUNK : avail * 2; // 16-bit samples
+        const int16_t* pcm = g.pcm_ring + idx;
+        int written = montauk::audio_write(g.audio_handle, (const uint8_t*)pcm, to_write);
+        if (written <= 0) return; // device buffer full, try later
 
-        if (g.current_track >= 0 && g.files[g.current_track].is_mp3) {
-            // MP3 decode
-            if (g.mp3_offset >= g.file_size) {
-                // End of file — advance to next track
-                next_track(true);
-                return;
-            }
-
-            mp3dec_frame_info_t info = {};
-            int samples = mp3dec_decode_frame(&g.mp3dec,
-                                               g.file_data + g.mp3_offset,
-                                               (int)(g.file_size - g.mp3_offset),
-                                               g.pcm_buf, &info);
-            if (info.frame_bytes > 0) {
-                g.mp3_offset += info.frame_bytes;
-            } else {
-                // Can't decode — end
-                next_track(true);
-                return;
-            }
-
-            if (samples > 0) {
-                if (g.mp3_seek_discard_samples > 0) {
-                    uint64_t discard = g.mp3_seek_discard_samples;
-                    if (discard > (uint64_t)samples) discard = (uint64_t)samples;
-                    g.pcm_buf_pos = (int)(discard * (uint64_t)info.channels);
-                    g.played_samples += discard;
-                    g.mp3_seek_discard_samples -= discard;
-                    samples -= (int)discard;
-                }
-                g.pcm_buf_len = samples * info.channels;
-                if (g.pcm_buf_len > 0) {
-                    music_visualizer::feed_pcm(g.visualizer,
-                                               g.pcm_buf + g.pcm_buf_pos,
-                                               g.pcm_buf_len / info.channels,
-                                               info.channels,
-                                               info.hz);
-                } else {
-                    g.pcm_buf_pos = 0;
-                }
-            }
-        } else {
-            // WAV decode — just copy PCM data
-            if (g.wav_pos >= g.wav_data_size) {
-                next_track(true);
-                return;
-            }
-
-            uint64_t remaining = g.wav_data_size - g.wav_pos;
-            uint64_t to_copy = remaining;
-            if (to_copy > sizeof(g.pcm_buf)) to_copy = sizeof(g.pcm_buf);
-
-            memcpy(g.pcm_buf, g.file_data + g.wav_data_offset + g.wav_pos, to_copy);
-            g.wav_pos += to_copy;
-            g.pcm_buf_len = (int)(to_copy / 2); // 16-bit samples
-            if (g.channels > 0 && g.pcm_buf_len > 0) {
-                music_visualizer::feed_pcm(g.visualizer,
-                                           g.pcm_buf,
-                                           g.pcm_buf_len / g.channels,
-                                           g.channels,
-                                           g.sample_rate);
-            }
-        }
+        int samples_written = written / 2;
+        g.ring_read += samples_written;
+        g.played_samples = g.ring_anchor + g.ring_read / g.channels;
+        music_visualizer::feed_pcm(g.visualizer, pcm, samples_written / g.channels,
+                                   g.channels, g.sample_rate);
     }
 }
 
@@ -1432,11 +1577,15 @@ static bool handle_key(const Montauk::KeyEvent& key, bool& quit) {
 // ============================================================================
 
 extern "C" void _start() {
+    // Audio is fed from this loop; don't let CPU-bound jobs delay it
+    montauk::set_priority(-1, Montauk::PRIO_INTERACTIVE);
+
     // Init state
     memset(&g, 0, sizeof(g));
     g.win_w = INIT_W;
     g.win_h = INIT_H;
     g.audio_handle = -1;
+    g.file_handle = -1;
     g.current_track = -1;
     g.play_state = PlayState::Stopped;
     g.hovered_item = -1;
@@ -1498,14 +1647,7 @@ extern "C" void _start() {
     }
 
     // Load font
-    {
-        TrueTypeFont* f = (TrueTypeFont*)montauk::malloc(sizeof(TrueTypeFont));
-        if (f) {
-            montauk::memset(f, 0, sizeof(TrueTypeFont));
-            if (!f->init("0:/fonts/Roboto-Medium.ttf")) { montauk::mfree(f); f = nullptr; }
-        }
-        g.font = f;
-    }
+    g.font = fonts::open("0:/fonts/Roboto-Medium.ttf");
 
     // Load transport icons (dark + white variants for colored backgrounds)
     {
@@ -14,8 +14,13 @@ static constexpr double PROBE_FREQS[BAND_COUNT] = {
     418.76, 533.88, 680.64, 867.76, 1106.3, 1410.43, 1798.16, 2292.48,
     2922.68, 3726.13, 4750.46, 6056.37, 7721.28, 9843.88, 12549.98, 16000.0
 };
-static constexpr double PROBE_SPREADS[PROBE_COUNT] = {0.82, 1.0, 1.22};
-static constexpr double PROBE_WEIGHTS[PROBE_COUNT] = {0.65, 1.0, 0.65};
+// Each band covers 0.82x..1.22x its frequency, bins at the edges
+// weighted EDGE_WEIGHT and the center 1
+static constexpr double BAND_LOW = 0.82;
+static constexpr double BAND_HIGH = 1.22;
+static constexpr float EDGE_WEIGHT = 0.65f;
+
+typedef float v4f __attribute__((vector_size(16)));
 
 static void px_fill(uint32_t* px, int bw, int bh,
                     int x, int y, int w, int h, Color c) {
@@ -85,55 +90,162 @@ static double fast_sin(double x) {
     return stb_cos((PI * 0.5) - x);
 }
 
+static void build_tables(State& state) {
+    if (state.tables_ready) return;
+
+    for (int i = 0; i < ANALYSIS_SIZE; i++)
+        state.window[i] = (float)(0.5 - 0.5 * stb_cos((2.0 * PI * (double)i) / (double)(ANALYSIS_SIZE - 1)));
+
+    for (int k = 0; k < FFT_SIZE; k++) {
+        double angle = (2.0 * PI * (double)k) / (double)ANALYSIS_SIZE;
+        state.twiddle_re[k] = (float)stb_cos(angle);
+        state.twiddle_im[k] = (float)-fast_sin(angle);
+    }
+
+    int bits = 0;
+    while ((1 << bits) < FFT_SIZE) bits++;
+    for (int i = 0; i < FFT_SIZE; i++) {
+        int r = 0;
+        for (int b = 0; b < bits; b++)
+            if (i & (1 << b)) r |= 1 << (bits - 1 - b);
+        state.bitrev[i] = (uint16_t)r;
+    }
+
+    state.tables_ready = true;
+}
+
 static void prepare_analysis(State& state, int sample_rate) {
     if (sample_rate <= 0 || state.sample_rate == sample_rate) return;
 
+    build_tables(state);
     state.sample_rate = sample_rate;
     state.ring_pos = 0;
     state.ring_fill = 0;
     state.samples_since_analyze = 0;
 
-    for (int i = 0; i < ANALYSIS_SIZE; i++) {
+    for (int i = 0; i < ANALYSIS_SIZE; i++)
         state.ring[i] = 0;
-        state.window[i] = 0.5 - 0.5 * stb_cos((2.0 * PI * (double)i) / (double)(ANALYSIS_SIZE - 1));
-    }
 
     double max_freq = (double)sample_rate * 0.45;
     if (max_freq < 90.0) max_freq = 90.0;
+    double bin_hz = (double)sample_rate / (double)ANALYSIS_SIZE;
 
     for (int band = 0; band < BAND_COUNT; band++) {
-        for (int probe = 0; probe < PROBE_COUNT; probe++) {
-            double freq = PROBE_FREQS[band] * PROBE_SPREADS[probe];
-            if (freq > max_freq) freq = max_freq;
-            if (freq < 40.0) freq = 40.0;
-
-            double omega = (2.0 * PI * freq) / (double)sample_rate;
-            double cosine = stb_cos(omega);
-            state.probes[band][probe].cosine = cosine;
-            state.probes[band][probe].sine = fast_sin(omega);
-            state.probes[band][probe].coeff = 2.0 * cosine;
+        double lo = PROBE_FREQS[band] * BAND_LOW;
+        double hi = PROBE_FREQS[band] * BAND_HIGH;
+        double center = PROBE_FREQS[band];
+        if (hi > max_freq) hi = max_freq;
+        if (center > max_freq) center = max_freq;
+        if (lo > max_freq) lo = max_freq;
+        if (lo < 40.0) lo = 40.0;
+
+        BandBins& bins = state.bands[band];
+        bins.center = (float)(center / bin_hz);
+        bins.first = (int)(lo / bin_hz + 0.999);
+        bins.last = (int)(hi / bin_hz);
+        if (bins.last > FFT_SIZE) bins.last = FFT_SIZE;
+    }
+}
+
+// In-place iterative radix-2 FFT of FFT_SIZE complex points. Twiddles
+// for a butterfly span of `len` are every (ANALYSIS_SIZE / len)-th entry
+// of the table.
+static void fft(State& state) {
+    float* re = state.fft_re;
+    float* im = state.fft_im;
+
+    for (int i = 0; i < FFT_SIZE; i++) {
+        int j = state.bitrev[i];
+        if (j > i) {
+            float t = re[i]; re[i] = re[j]; re[j] = t;
+            t = im[i]; im[i] = im[j]; im[j] = t;
+        }
+    }
+
+    for (int len = 2; len <= FFT_SIZE; len <<= 1) {
+        int half = len >> 1;
+        int step = ANALYSIS_SIZE / len;
+        for (int base = 0; base < FFT_SIZE; base += len) {
+            for (int j = 0; j < half; j++) {
+                float wr = state.twiddle_re[j * step];
+                float wi = state.twiddle_im[j * step];
+                int a = base + j;
+                int b = a + half;
+                float tr = re[b] * wr - im[b] * wi;
+                float ti = re[b] * wi + im[b] * wr;
+                re[b] = re[a] - tr;
+                im[b] = im[a] - ti;
+                re[a] += tr;
+                im[a] += ti;
+            }
         }
     }
 }
 
-static double run_goertzel(const State& state, const Probe& probe) {
-    double q1 = 0.0;
-    double q2 = 0.0;
+// Magnitudes of bins 0..FFT_SIZE of the windowed ring. The ANALYSIS_SIZE
+// real samples go in as FFT_SIZE complex points (even samples real, odd
+// imaginary) and the two interleaved spectra are separated afterwards.
+static void compute_spectrum(State& state) {
     int pos = state.ring_pos;
+    for (int i = 0; i < FFT_SIZE; i++) {
+        state.fft_re[i] = (float)state.ring[pos] * state.window[2 * i];
+        if (++pos >= ANALYSIS_SIZE) pos = 0;
+        state.fft_im[i] = (float)state.ring[pos] * state.window[2 * i + 1];
+        if (++pos >= ANALYSIS_SIZE) pos = 0;
+    }
+
+    fft(state);
+
+    // Power first, then square roots four bins at a time
+    float dc = state.fft_re[0] + state.fft_im[0];
+    float nyquist = state.fft_re[0] - state.fft_im[0];
+    state.magnitude[0] = dc * dc;
+    state.magnitude[FFT_SIZE] = nyquist * nyquist;
+    for (int k = 1; k < FFT_SIZE; k++) {
+        float zr = state.fft_re[k], zi = state.fft_im[k];
+        float cr = state.fft_re[FFT_SIZE - k], ci = -state.fft_im[FFT_SIZE - k];
+        // Even part (Z[k] + conj Z[N-k]) / 2, odd part (Z[k] - conj Z[N-k]) / 2i
+        float er = 0.5f * (zr + cr), ei = 0.5f * (zi + ci);
+        float orr = 0.5f * (zi - ci), oi = -0.5f * (zr - cr);
+        float wr = state.twiddle_re[k], wi = state.twiddle_im[k];
+        float xr = er + orr * wr - oi * wi;
+        float xi = ei + orr * wi + oi * wr;
+        state.magnitude[k] = xr * xr + xi * xi;
+    }
 
-    for (int i = 0; i < ANALYSIS_SIZE; i++) {
-        double sample = (double)state.ring[pos] * state.window[i];
-        double q0 = probe.coeff * q1 - q2 + sample;
-        q2 = q1;
-        q1 = q0;
+    int k = 0;
+    for (; k + 4 <= FFT_SIZE + 1; k += 4) {
+        v4f p;
+        __builtin_memcpy(&p, state.magnitude + k, sizeof(p));
+        p = __builtin_ia32_sqrtps(p);
+        __builtin_memcpy(state.magnitude + k, &p, sizeof(p));
+    }
+    for (; k <= FFT_SIZE; k++)
+        state.magnitude[k] = __builtin_ia32_sqrtss((v4f){state.magnitude[k], 0, 0, 0})[0];
+}
 
-        pos++;
-        if (pos >= ANALYSIS_SIZE) pos = 0;
+// Weighted mean of the band's bins. A band narrower than a bin (the low
+// ones) reads the spectrum between the two bins around its center.
+static double band_magnitude(const State& state, const BandBins& bins) {
+    if (bins.last < bins.first) {
+        int k = (int)bins.center;
+        if (k >= FFT_SIZE) return state.magnitude[FFT_SIZE];
+        float frac = bins.center - (float)k;
+        return state.magnitude[k] * (1.0f - frac) + state.magnitude[k + 1] * frac;
     }
 
-    double real = q1 - q2 * probe.cosine;
-    double imag = q2 * probe.sine;
-    return stb_sqrt(real * real + imag * imag);
+    float sum = 0.0f;
+    float weight_sum = 0.0f;
+    float span_lo = bins.center - (float)bins.first + 1.0f;
+    float span_hi = (float)bins.last - bins.center + 1.0f;
+    for (int k = bins.first; k <= bins.last; k++) {
+        float d = (float)k - bins.center;
+        float t = d < 0.0f ? -d / span_lo : d / span_hi;
+        float weight = 1.0f - (1.0f - EDGE_WEIGHT) * (t > 1.0f ? 1.0f : t);
+        sum += state.magnitude[k] * weight;
+        weight_sum += weight;
+    }
+    return weight_sum > 0.0f ? sum / weight_sum : 0.0;
 }
 
 static void analyze_window(State& state) {
@@ -141,19 +253,10 @@ static void analyze_window(State& state) {
 
     double raw[BAND_COUNT] = {};
 
-    for (int band = 0; band < BAND_COUNT; band++) {
-        double weighted = 0.0;
-        double weight_sum = 0.0;
-
-        for (int probe = 0; probe < PROBE_COUNT; probe++) {
-            double magnitude = run_goertzel(state, state.probes[band][probe]);
-            weighted += magnitude * PROBE_WEIGHTS[probe];
-            weight_sum += PROBE_WEIGHTS[probe];
-        }
-
-        if (weight_sum > 0.0) weighted /= weight_sum;
+    compute_spectrum(state);
 
-        double normalized = weighted / REFERENCE_MAGNITUDE;
+    for (int band = 0; band < BAND_COUNT; band++) {
+        double normalized = band_magnitude(state, state.bands[band]) / REFERENCE_MAGNITUDE;
         if (normalized < 0.0) normalized = 0.0;
 
         double display = 100.0 * stb_sqrt(normalized);
@@ -199,18 +302,8 @@ void reset(State& state) {
     state.ring_fill = 0;
     state.samples_since_analyze = 0;
 
-    for (int i = 0; i < ANALYSIS_SIZE; i++) {
+    for (int i = 0; i < ANALYSIS_SIZE; i++)
         state.ring[i] = 0;
-        state.window[i] = 0.0;
-    }
-
-    for (int band = 0; band < BAND_COUNT; band++) {
-        for (int probe = 0; probe < PROBE_COUNT; probe++) {
-            state.probes[band][probe].coeff = 0.0;
-            state.probes[band][probe].cosine = 0.0;
-            state.probes[band][probe].sine = 0.0;
-        }
-    }
 }
 
 void tick(State& state) {
@@ -6,13 +6,14 @@
 namespace music_visualizer {
 
 static constexpr int BAND_COUNT = 24;
-static constexpr int PROBE_COUNT = 3;
-static constexpr int ANALYSIS_SIZE = 512;
-
-struct Probe {
-    double coeff;
-    double cosine;
-    double sine;
+static constexpr int ANALYSIS_SIZE = 1024;
+static constexpr int FFT_SIZE = ANALYSIS_SIZE / 2;   // complex points of the real FFT
+
+// Spectrum bins a band averages over, with the band's center bin
+struct BandBins {
+    int first;
+    int last;
+    float center;
 };
 
 struct State {
@@ -26,8 +27,19 @@ struct State {
     int samples_since_analyze;
 
     int16_t ring[ANALYSIS_SIZE];
-    double window[ANALYSIS_SIZE];
-    Probe probes[BAND_COUNT][PROBE_COUNT];
+    float window[ANALYSIS_SIZE];
+    BandBins bands[BAND_COUNT];
+
+    // FFT tables, built once: e^(-2*pi*i*k/ANALYSIS_SIZE) and the
+    // bit-reversed order of FFT_SIZE points
+    bool tables_ready;
+    float twiddle_re[FFT_SIZE];
+    float twiddle_im[FFT_SIZE];
+    uint16_t bitrev[FFT_SIZE];
+
+    float fft_re[FFT_SIZE];
+    float fft_im[FFT_SIZE];
+    float magnitude[FFT_SIZE + 1];
 };
 
 void reset(State& state);
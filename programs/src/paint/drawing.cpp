@@ -13,6 +13,20 @@
 void canvas_put_pixel(int x, int y, Color c) {
     if (x < 0 || x >= g_canvas_w || y < 0 || y >= g_canvas_h) return;
     g_canvas[y * g_canvas_w + x] = c.to_pixel();
+    canvas_mark_dirty(x, y, x, y);
+}
+
+// Everything larger than a pixel is drawn as horizontal spans: one clip,
+// one dirty mark and a straight run of stores per row
+static void canvas_fill_span(int x0, int x1, int y, uint32_t v) {
+    if (y < 0 || y >= g_canvas_h) return;
+    if (x0 < 0) x0 = 0;
+    if (x1 >= g_canvas_w) x1 = g_canvas_w - 1;
+    if (x0 > x1) return;
+    uint32_t* row = g_canvas + y * g_canvas_w;
+    for (int x = x0; x <= x1; x++)
+        row[x] = v;
+    canvas_mark_dirty(x0, y, x1, y);
 }
 
 void canvas_clear(Color c) {
@@ -20,30 +34,81 @@ void canvas_clear(Color c) {
     int total = g_canvas_w * g_canvas_h;
     for (int i = 0; i < total; i++)
         g_canvas[i] = v;
+    canvas_mark_dirty(0, 0, g_canvas_w - 1, g_canvas_h - 1);
+}
+
+// Flag the tiles under a canvas rectangle (inclusive, already clipped)
+// and add it to the area the next render_damage() puts on screen
+void canvas_mark_dirty(int x0, int y0, int x1, int y1) {
+    for (int ty = y0 / UNDO_TILE; ty <= y1 / UNDO_TILE; ty++)
+        for (int tx = x0 / UNDO_TILE; tx <= x1 / UNDO_TILE; tx++)
+            g_tile_dirty[ty * g_tiles_x + tx] = 1;
+
+    if (x0 < g_damage_x0) g_damage_x0 = x0;
+    if (y0 < g_damage_y0) g_damage_y0 = y0;
+    if (x1 > g_damage_x1) g_damage_x1 = x1;
+    if (y1 > g_damage_y1) g_damage_y1 = y1;
 }
 
 // ============================================================================
 // Brush (filled circle stamp)
 // ============================================================================
 
+static constexpr int BRUSH_MAX_R = 32;
+
+// Half-width of the stamp on each row out from its centre, for the
+// brush size last asked for
+static int g_mask_size = -1;
+static int g_mask_r = 0;
+static int g_mask_w[BRUSH_MAX_R + 1];
+
+static void brush_mask(int size) {
+    if (size == g_mask_size) return;
+    g_mask_size = size;
+    int r = size <= 1 ? 0 : size / 2;
+    if (r > BRUSH_MAX_R) r = BRUSH_MAX_R;
+    g_mask_r = r;
+    for (int dy = 0; dy <= r; dy++) {
+        int w = r;
+        while (w * w + dy * dy > r * r) w--;
+        g_mask_w[dy] = w;
+    }
+}
+
 void canvas_draw_brush(int cx, int cy, Color c, int size) {
-    if (size <= 1) {
-        canvas_put_pixel(cx, cy, c);
-        return;
+    brush_mask(size);
+    uint32_t v = c.to_pixel();
+    for (int dy = -g_mask_r; dy <= g_mask_r; dy++) {
+        int w = g_mask_w[dy < 0 ? -dy : dy];
+        canvas_fill_span(cx - w, cx + w, cy + dy, v);
     }
-    int r = size / 2;
-    int r2 = r * r;
-    for (int dy = -r; dy <= r; dy++)
-        for (int dx = -r; dx <= r; dx++)
-            if (dx * dx + dy * dy <= r2)
-                canvas_put_pixel(cx + dx, cy + dy, c);
 }
 
 // ============================================================================
 // Bresenham line
 // ============================================================================
 
+// Extent of a stroke on each canvas row
+static int g_row_lo[MAX_CANVAS_H];
+static int g_row_hi[MAX_CANVAS_H];
+
+// The brush is stamped at every point of the line, but the stamps are
+// only merged into one span per row and the spans filled at the end, so
+// each pixel is written once however much the stamps overlap
 void canvas_draw_line(int x0, int y0, int x1, int y1, Color c, int thickness) {
+    brush_mask(thickness);
+    int r = g_mask_r;
+
+    int row0 = (y0 < y1 ? y0 : y1) - r;
+    int row1 = (y0 > y1 ? y0 : y1) + r;
+    if (row0 < 0) row0 = 0;
+    if (row1 >= g_canvas_h) row1 = g_canvas_h - 1;
+    if (row0 > row1) return;
+    for (int y = row0; y <= row1; y++) {
+        g_row_lo[y] = g_canvas_w;
+        g_row_hi[y] = -1;
+    }
+
     int dx = x1 - x0;
     int dy = y1 - y0;
     if (dx < 0) dx = -dx;
@@ -54,12 +119,23 @@ void canvas_draw_line(int x0, int y0, int x1, int y1, Color c, int thickness) {
     int err = dx - dy;
 
     while (true) {
-        canvas_draw_brush(x0, y0, c, thickness);
+        for (int my = -r; my <= r; my++) {
+            int y = y0 + my;
+            if (y < row0 || y > row1) continue;
+            int w = g_mask_w[my < 0 ? -my : my];
+            if (x0 - w < g_row_lo[y]) g_row_lo[y] = x0 - w;
+            if (x0 + w > g_row_hi[y]) g_row_hi[y] = x0 + w;
+        }
         if (x0 == x1 && y0 == y1) break;
         int e2 = 2 * err;
         if (e2 > -dy) { err -= dy; x0 += sx; }
         if (e2 < dx)  { err += dx; y0 += sy; }
     }
+
+    uint32_t v = c.to_pixel();
+    for (int y = row0; y <= row1; y++)
+        if (g_row_lo[y] <= g_row_hi[y])
+            canvas_fill_span(g_row_lo[y], g_row_hi[y], y, v);
 }
 
 // ============================================================================
@@ -70,14 +146,15 @@ void canvas_draw_rect(int x0, int y0, int x1, int y1, Color c, int thickness) {
     if (x0 > x1) { int t = x0; x0 = x1; x1 = t; }
     if (y0 > y1) { int t = y0; y0 = y1; y1 = t; }
 
-    for (int t = 0; t < thickness; t++) {
-        for (int x = x0 + t; x <= x1 - t; x++) {
-            canvas_put_pixel(x, y0 + t, c);
-            canvas_put_pixel(x, y1 - t, c);
-        }
-        for (int y = y0 + t; y <= y1 - t; y++) {
-            canvas_put_pixel(x0 + t, y, c);
-            canvas_put_pixel(x1 - t, y, c);
+    // A pixel is on the outline when it is within `thickness` of an edge
+    uint32_t v = c.to_pixel();
+    for (int y = y0; y <= y1; y++) {
+        int d = y - y0 < y1 - y ? y - y0 : y1 - y;
+        if (d < thickness || x1 - x0 < 2 * thickness) {
+            canvas_fill_span(x0, x1, y, v);
+        } else {
+            canvas_fill_span(x0, x0 + thickness - 1, y, v);
+            canvas_fill_span(x1 - thickness + 1, x1, y, v);
         }
     }
 }
@@ -86,9 +163,9 @@ void canvas_fill_rect(int x0, int y0, int x1, int y1, Color c) {
     if (x0 > x1) { int t = x0; x0 = x1; x1 = t; }
     if (y0 > y1) { int t = y0; y0 = y1; y1 = t; }
 
+    uint32_t v = c.to_pixel();
     for (int y = y0; y <= y1; y++)
-        for (int x = x0; x <= x1; x++)
-            canvas_put_pixel(x, y, c);
+        canvas_fill_span(x0, x1, y, v);
 }
 
 // ============================================================================
@@ -163,23 +240,30 @@ void canvas_fill_ellipse(int x0, int y0, int x1, int y1, Color c) {
     int b = (y1 - y0) / 2;
     if (a == 0 || b == 0) return;
 
-    for (int dy = -b; dy <= b; dy++) {
-        // x^2/a^2 + y^2/b^2 <= 1  =>  x <= a * sqrt(1 - y^2/b^2)
-        long long x_extent = (long long)a * a * ((long long)b * b - (long long)dy * dy);
-        if (x_extent < 0) continue;
-        // Integer sqrt approximation
-        long long denom = (long long)b * b;
-        int w = 0;
+    // x^2/a^2 + y^2/b^2 <= 1  =>  x <= a * sqrt(1 - y^2/b^2). Working in
+    // from the top and bottom rows the half-width only grows, so it is
+    // carried from row to row instead of found from zero each time.
+    uint32_t v = c.to_pixel();
+    long long denom = (long long)b * b;
+    int w = 0;
+    for (int dy = b; dy >= 0; dy--) {
+        long long x_extent = (long long)a * a * (denom - (long long)dy * dy);
         while ((long long)(w + 1) * (w + 1) * denom <= x_extent) w++;
-        for (int dx = -w; dx <= w; dx++)
-            canvas_put_pixel(cx + dx, cy + dy, c);
+        canvas_fill_span(cx - w, cx + w, cy + dy, v);
+        if (dy > 0) canvas_fill_span(cx - w, cx + w, cy - dy, v);
     }
 }
 
 // ============================================================================
-// Flood fill (iterative scanline)
+// Flood fill (scanline spans)
 // ============================================================================
 
+// A run already filled on row y - dy whose neighbours on row y are still
+// to be scanned
+struct FillSeg {
+    int y, x0, x1, dy;
+};
+
 void canvas_flood_fill(int sx, int sy, Color fill_color) {
     if (sx < 0 || sx >= g_canvas_w || sy < 0 || sy >= g_canvas_h) return;
 
@@ -187,50 +271,57 @@ void canvas_flood_fill(int sx, int sy, Color fill_color) {
     uint32_t fill_px = fill_color.to_pixel();
     if (target == fill_px) return;
 
-    // Simple stack-based flood fill with a bounded stack
-    static constexpr int STACK_MAX = 65536;
-    struct Pt { int16_t x, y; };
-    Pt* stack = (Pt*)montauk::malloc(STACK_MAX * sizeof(Pt));
-    if (!stack) return;
-
+    // The stack grows as needed, so a fill is never cut short
+    int cap = 1024;
     int sp = 0;
-    stack[sp++] = {(int16_t)sx, (int16_t)sy};
-    g_canvas[sy * g_canvas_w + sx] = fill_px;
+    FillSeg* stack = (FillSeg*)montauk::malloc(cap * sizeof(FillSeg));
+    if (!stack) return;
 
-    while (sp > 0) {
-        Pt p = stack[--sp];
-        int x = p.x, y = p.y;
-
-        // Scan left
-        int left = x;
-        while (left > 0 && g_canvas[y * g_canvas_w + left - 1] == target) {
-            left--;
-            g_canvas[y * g_canvas_w + left] = fill_px;
+    auto push = [&](int y, int x0, int x1, int dy) {
+        if (y + dy < 0 || y + dy >= g_canvas_h) return;
+        if (sp == cap) {
+            FillSeg* grown = (FillSeg*)montauk::realloc(stack, cap * 2 * sizeof(FillSeg));
+            if (!grown) return;
+            stack = grown;
+            cap *= 2;
         }
+        stack[sp++] = {y, x0, x1, dy};
+    };
+
+    push(sy, sx, sx, 1);
+    push(sy + 1, sx, sx, -1);
 
-        // Scan right
-        int right = x;
-        while (right < g_canvas_w - 1 && g_canvas[y * g_canvas_w + right + 1] == target) {
-            right++;
-            g_canvas[y * g_canvas_w + right] = fill_px;
+    while (sp > 0) {
+        FillSeg seg = stack[--sp];
+        int y = seg.y + seg.dy;
+        uint32_t* row = g_canvas + y * g_canvas_w;
+
+        // Runs on this row that touch the parent run. The first may reach
+        // left of it, any may reach right of it; those overhangs can leak
+        // back round, so they are also scanned on the parent's row.
+        int x = seg.x0;
+        while (x >= 0 && row[x] == target) x--;
+        bool in_run = x < seg.x0;
+        int left = x + 1;
+        if (in_run) {
+            if (left < seg.x0) push(y, left, seg.x0 - 1, -seg.dy);
+            x = seg.x0 + 1;
+        } else {
+            x = seg.x0;
         }
 
-        // Check above and below
-        for (int dir = -1; dir <= 1; dir += 2) {
-            int ny = y + dir;
-            if (ny < 0 || ny >= g_canvas_h) continue;
-            bool in_span = false;
-            for (int px = left; px <= right; px++) {
-                if (g_canvas[ny * g_canvas_w + px] == target) {
-                    if (!in_span && sp < STACK_MAX) {
-                        g_canvas[ny * g_canvas_w + px] = fill_px;
-                        stack[sp++] = {(int16_t)px, (int16_t)ny};
-                        in_span = true;
-                    }
-                } else {
-                    in_span = false;
-                }
+        for (;;) {
+            if (in_run) {
+                while (x < g_canvas_w && row[x] == target) x++;
+                canvas_fill_span(left, x - 1, y, fill_px);
+                push(y, left, x - 1, seg.dy);
+                if (x > seg.x1 + 1) push(y, seg.x1 + 1, x - 1, -seg.dy);
             }
+            x++;
+            while (x <= seg.x1 && row[x] != target) x++;
+            if (x > seg.x1) break;
+            left = x;
+            in_run = true;
         }
     }
 
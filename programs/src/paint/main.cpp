@@ -18,9 +18,8 @@ uint32_t* g_canvas = nullptr;
 int g_canvas_w = 640;
 int g_canvas_h = 480;
 
-uint32_t* g_undo_buf[UNDO_MAX];
-int g_undo_count = 0;
-int g_undo_pos = 0;
+int g_damage_x0 = MAX_CANVAS_W, g_damage_y0 = MAX_CANVAS_H;
+int g_damage_x1 = -1, g_damage_y1 = -1;
 
 int g_scroll_x = 0;
 int g_scroll_y = 0;
@@ -68,64 +67,6 @@ bool screen_to_canvas(int sx, int sy, int* cx, int* cy) {
     return *cx >= 0 && *cx < g_canvas_w && *cy >= 0 && *cy < g_canvas_h;
 }
 
-// ============================================================================
-// Undo/Redo
-// ============================================================================
-
-void undo_push() {
-    // Discard any redo states after current position
-    for (int i = g_undo_pos; i < g_undo_count; i++) {
-        if (g_undo_buf[i]) {
-            montauk::mfree(g_undo_buf[i]);
-            g_undo_buf[i] = nullptr;
-        }
-    }
-    g_undo_count = g_undo_pos;
-
-    // If at capacity, shift everything down
-    if (g_undo_count >= UNDO_MAX) {
-        if (g_undo_buf[0]) montauk::mfree(g_undo_buf[0]);
-        for (int i = 1; i < UNDO_MAX; i++)
-            g_undo_buf[i - 1] = g_undo_buf[i];
-        g_undo_buf[UNDO_MAX - 1] = nullptr;
-        g_undo_count = UNDO_MAX - 1;
-        g_undo_pos = g_undo_count;
-    }
-
-    int sz = g_canvas_w * g_canvas_h * 4;
-    uint32_t* buf = (uint32_t*)montauk::malloc(sz);
-    if (buf) {
-        montauk::memcpy(buf, g_canvas, sz);
-        g_undo_buf[g_undo_count] = buf;
-        g_undo_count++;
-        g_undo_pos = g_undo_count;
-    }
-}
-
-void undo_do() {
-    if (g_undo_pos <= 0) return;
-    // Save current state as redo if we're at the top
-    if (g_undo_pos == g_undo_count && g_undo_count < UNDO_MAX) {
-        int sz = g_canvas_w * g_canvas_h * 4;
-        uint32_t* buf = (uint32_t*)montauk::malloc(sz);
-        if (buf) {
-            montauk::memcpy(buf, g_canvas, sz);
-            g_undo_buf[g_undo_count] = buf;
-            g_undo_count++;
-        }
-    }
-    g_undo_pos--;
-    int sz = g_canvas_w * g_canvas_h * 4;
-    montauk::memcpy(g_canvas, g_undo_buf[g_undo_pos], sz);
-}
-
-void redo_do() {
-    if (g_undo_pos >= g_undo_count - 1) return;
-    g_undo_pos++;
-    int sz = g_canvas_w * g_canvas_h * 4;
-    montauk::memcpy(g_canvas, g_undo_buf[g_undo_pos], sz);
-}
-
 // ============================================================================
 // Toolbar hit testing
 // ============================================================================
@@ -240,24 +181,15 @@ static void apply_shape() {
 // ============================================================================
 
 extern "C" void _start() {
-    // Initialize undo pointers
-    for (int i = 0; i < UNDO_MAX; i++) g_undo_buf[i] = nullptr;
-
     // Allocate canvas
     int canvas_bytes = g_canvas_w * g_canvas_h * 4;
     g_canvas = (uint32_t*)montauk::malloc(canvas_bytes);
     if (!g_canvas) montauk::exit(1);
+    if (!undo_init()) montauk::exit(1);
     canvas_clear(g_bg_color);
 
     // Load font
-    g_font = (TrueTypeFont*)montauk::malloc(sizeof(TrueTypeFont));
-    if (g_font) {
-        montauk::memset(g_font, 0, sizeof(TrueTypeFont));
-        if (!g_font->init("0:/fonts/Roboto-Medium.ttf")) {
-            montauk::mfree(g_font);
-            g_font = nullptr;
-        }
-    }
+    g_font = fonts::open("0:/fonts/Roboto-Medium.ttf");
 
     // Push initial undo state
     undo_push();
@@ -297,6 +229,7 @@ extern "C" void _start() {
         }
 
         bool redraw = false;
+        bool redraw_canvas = false;  // only the canvas damage needs showing
 
         // ============================================================
         // Keyboard
@@ -428,7 +361,7 @@ extern "C" void _start() {
                             canvas_draw_line(g_prev_x, g_prev_y, cx_pos, cy_pos, draw_c, bs);
                             g_prev_x = cx_pos;
                             g_prev_y = cy_pos;
-                            redraw = true;
+                            redraw_canvas = true;
                         }
                     }
                     if (left_released && g_drawing) {
@@ -477,6 +410,10 @@ extern "C" void _start() {
         if (redraw) {
             render(pixels);
             win.present();
+        } else if (redraw_canvas) {
+            Montauk::WinRect rect;
+            if (render_damage(pixels, &rect))
+                win.present(&rect, 1);
         }
     }
 
@@ -127,11 +127,19 @@ extern int g_win_w, g_win_h;
 extern uint32_t* g_canvas;
 extern int g_canvas_w, g_canvas_h;
 
-// Undo
-static constexpr int UNDO_MAX = 16;
-extern uint32_t* g_undo_buf[UNDO_MAX];
-extern int g_undo_count;
-extern int g_undo_pos;
+// Canvas area drawn on since it was last put on screen (empty: x1 < x0)
+extern int g_damage_x0, g_damage_y0, g_damage_x1, g_damage_y1;
+
+// Undo: history is kept in UNDO_TILE x UNDO_TILE canvas tiles shared
+// between states, and a new state copies only the tiles drawn on since the
+// last one. The oldest states go once the tiles outgrow UNDO_BUDGET.
+static constexpr int UNDO_TILE = 64;
+static constexpr int UNDO_MAX = 128;
+static constexpr uint64_t UNDO_BUDGET = 64 * 1024 * 1024;
+
+// One flag per tile, set by the canvas_* drawing functions
+extern uint8_t* g_tile_dirty;
+extern int g_tiles_x, g_tiles_y;
 
 // View
 extern int g_scroll_x, g_scroll_y;
@@ -178,20 +186,28 @@ void canvas_fill_ellipse(int x0, int y0, int x1, int y1, Color c);
 void canvas_flood_fill(int x, int y, Color fill_color);
 void canvas_draw_brush(int x, int y, Color c, int size);
 void canvas_clear(Color c);
+void canvas_mark_dirty(int x0, int y0, int x1, int y1);
 
 // ============================================================================
 // Function declarations -- render.cpp
 // ============================================================================
 
 void render(uint32_t* pixels);
+bool render_damage(uint32_t* pixels, Montauk::WinRect* out);
 
 // ============================================================================
-// Function declarations -- main.cpp
+// Function declarations -- undo.cpp
 // ============================================================================
 
+bool undo_init();
 void undo_push();
 void undo_do();
 void redo_do();
+
+// ============================================================================
+// Function declarations -- main.cpp
+// ============================================================================
+
 int canvas_x();
 int canvas_y();
 bool screen_to_canvas(int sx, int sy, int* cx, int* cy);
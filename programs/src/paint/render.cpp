@@ -12,7 +12,15 @@ static const char* tool_names[TOOL_COUNT] = {
     "Fill", "Pick"
 };
 
+static void damage_reset() {
+    g_damage_x0 = MAX_CANVAS_W;
+    g_damage_y0 = MAX_CANVAS_H;
+    g_damage_x1 = -1;
+    g_damage_y1 = -1;
+}
+
 void render(uint32_t* pixels) {
+    damage_reset();
     px_fill(pixels, g_win_w, g_win_h, 0, 0, g_win_w, g_win_h, BG_COLOR);
 
     // ================================================================
@@ -202,3 +210,32 @@ void render(uint32_t* pixels) {
         g_font->draw_to_buffer(pixels, g_win_w, g_win_h, g_win_w - rw - 6, sty, right, STATUS_TEXT, FONT_SIZE);
     }
 }
+
+// Copy just the part of the canvas drawn on since the last render onto
+// the previous frame. Returns false if nothing visible changed; otherwise
+// `out` is the window rectangle to present.
+bool render_damage(uint32_t* pixels, Montauk::WinRect* out) {
+    int x0 = g_damage_x0, y0 = g_damage_y0;
+    int x1 = g_damage_x1, y1 = g_damage_y1;
+    damage_reset();
+    if (x1 < x0 || y1 < y0) return false;
+
+    // Canvas to window, clipped to the canvas area
+    int cx = canvas_x();
+    int cy = canvas_y();
+    int sx0 = cx + x0, sy0 = cy + y0;
+    int sx1 = cx + x1 + 1, sy1 = cy + y1 + 1;
+    if (sx0 < 0) sx0 = 0;
+    if (sy0 < TOOLBAR_H + COLOR_BAR_H) sy0 = TOOLBAR_H + COLOR_BAR_H;
+    if (sx1 > g_win_w) sx1 = g_win_w;
+    if (sy1 > g_win_h - STATUS_BAR_H) sy1 = g_win_h - STATUS_BAR_H;
+    if (sx0 >= sx1 || sy0 >= sy1) return false;
+
+    for (int sy = sy0; sy < sy1; sy++) {
+        const uint32_t* src = g_canvas + (sy - cy) * g_canvas_w + (sx0 - cx);
+        montauk::memcpy(&pixels[sy * g_win_w + sx0], src, (sx1 - sx0) * 4);
+    }
+
+    *out = {sx0, sy0, sx1 - sx0, sy1 - sy0};
+    return true;
+}
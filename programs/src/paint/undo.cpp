@@ -0,0 +1,185 @@
+/*
+ * undo.cpp
+ * Tiled copy-on-write undo history for Paint app
+ * Copyright (c) 2026 Daniel Hammer
+ */
+
+#include "paint.h"
+
+// A saved tile. States are tables of tile pointers, and a tile is shared
+// by every state (and the base) it has not changed between.
+struct UndoTile {
+    int refs;
+    uint32_t px[UNDO_TILE * UNDO_TILE];
+};
+
+uint8_t* g_tile_dirty = nullptr;
+int g_tiles_x = 0, g_tiles_y = 0;
+
+static UndoTile** g_states[UNDO_MAX];
+static int g_undo_count = 0;
+static int g_undo_pos = 0;
+
+// What the canvas holds, except for the tiles flagged dirty since
+static UndoTile** g_base = nullptr;
+
+static uint64_t g_tile_bytes = 0;
+
+static int tile_count() {
+    return g_tiles_x * g_tiles_y;
+}
+
+// ============================================================================
+// Tiles
+// ============================================================================
+
+static void tile_span(int idx, int* x, int* y, int* w, int* h) {
+    *x = (idx % g_tiles_x) * UNDO_TILE;
+    *y = (idx / g_tiles_x) * UNDO_TILE;
+    *w = g_canvas_w - *x < UNDO_TILE ? g_canvas_w - *x : UNDO_TILE;
+    *h = g_canvas_h - *y < UNDO_TILE ? g_canvas_h - *y : UNDO_TILE;
+}
+
+static UndoTile* tile_capture(int idx) {
+    UndoTile* t = (UndoTile*)montauk::malloc(sizeof(UndoTile));
+    if (!t) return nullptr;
+    t->refs = 1;
+    g_tile_bytes += sizeof(UndoTile);
+
+    int x, y, w, h;
+    tile_span(idx, &x, &y, &w, &h);
+    for (int row = 0; row < h; row++)
+        montauk::memcpy(&t->px[row * UNDO_TILE], &g_canvas[(y + row) * g_canvas_w + x], w * 4);
+    return t;
+}
+
+static void tile_restore(int idx, const UndoTile* t) {
+    int x, y, w, h;
+    tile_span(idx, &x, &y, &w, &h);
+    for (int row = 0; row < h; row++)
+        montauk::memcpy(&g_canvas[(y + row) * g_canvas_w + x], &t->px[row * UNDO_TILE], w * 4);
+}
+
+static void tile_release(UndoTile* t) {
+    if (t && --t->refs == 0) {
+        montauk::mfree(t);
+        g_tile_bytes -= sizeof(UndoTile);
+    }
+}
+
+// ============================================================================
+// States
+// ============================================================================
+
+static void state_free(UndoTile** s) {
+    if (!s) return;
+    for (int i = 0; i < tile_count(); i++)
+        tile_release(s[i]);
+    montauk::mfree(s);
+}
+
+// Recapture the tiles drawn on since the base was last brought up to date.
+// On allocation failure the rest stay dirty and the base is still valid.
+static bool base_sync() {
+    for (int i = 0; i < tile_count(); i++) {
+        if (!g_tile_dirty[i]) continue;
+        UndoTile* t = tile_capture(i);
+        if (!t) return false;
+        tile_release(g_base[i]);
+        g_base[i] = t;
+        g_tile_dirty[i] = 0;
+    }
+    return true;
+}
+
+// Save the canvas as a new state after the current ones
+static bool state_append() {
+    if (!base_sync()) return false;
+    UndoTile** s = (UndoTile**)montauk::malloc(tile_count() * sizeof(UndoTile*));
+    if (!s) return false;
+    for (int i = 0; i < tile_count(); i++) {
+        s[i] = g_base[i];
+        s[i]->refs++;
+    }
+    g_states[g_undo_count++] = s;
+    return true;
+}
+
+static void drop_oldest() {
+    state_free(g_states[0]);
+    for (int i = 1; i < g_undo_count; i++)
+        g_states[i - 1] = g_states[i];
+    g_states[--g_undo_count] = nullptr;
+    if (g_undo_pos > 0) g_undo_pos--;
+}
+
+// Put state idx on the canvas, copying only the tiles that differ from it
+static void state_restore(int idx) {
+    UndoTile** s = g_states[idx];
+    for (int i = 0; i < tile_count(); i++) {
+        if (g_tile_dirty[i] || g_base[i] != s[i])
+            tile_restore(i, s[i]);
+        if (g_base[i] != s[i]) {
+            s[i]->refs++;
+            tile_release(g_base[i]);
+            g_base[i] = s[i];
+        }
+        g_tile_dirty[i] = 0;
+    }
+}
+
+// ============================================================================
+// Undo/Redo
+// ============================================================================
+
+bool undo_init() {
+    g_tiles_x = (g_canvas_w + UNDO_TILE - 1) / UNDO_TILE;
+    g_tiles_y = (g_canvas_h + UNDO_TILE - 1) / UNDO_TILE;
+    g_tile_dirty = (uint8_t*)montauk::malloc(tile_count());
+    g_base = (UndoTile**)montauk::malloc(tile_count() * sizeof(UndoTile*));
+    if (!g_tile_dirty || !g_base) return false;
+
+    // Nothing saved yet: every tile is dirty
+    for (int i = 0; i < tile_count(); i++) {
+        g_tile_dirty[i] = 1;
+        g_base[i] = nullptr;
+    }
+    for (int i = 0; i < UNDO_MAX; i++) g_states[i] = nullptr;
+    return true;
+}
+
+void undo_push() {
+    // Discard any redo states after current position
+    for (int i = g_undo_pos; i < g_undo_count; i++) {
+        state_free(g_states[i]);
+        g_states[i] = nullptr;
+    }
+    g_undo_count = g_undo_pos;
+
+    if (g_undo_count >= UNDO_MAX) drop_oldest();
+    if (!state_append()) return;
+    g_undo_pos = g_undo_count;
+
+    while (g_tile_bytes > UNDO_BUDGET && g_undo_count > 1)
+        drop_oldest();
+}
+
+void undo_do() {
+    if (g_undo_pos <= 0) return;
+    // Save current state as redo if we're at the top
+    if (g_undo_pos == g_undo_count) {
+        if (g_undo_count >= UNDO_MAX) {
+            drop_oldest();
+            if (g_undo_pos <= 0) return;
+        }
+        state_append();
+    }
+    g_undo_pos--;
+    state_restore(g_undo_pos);
+}
+
+void redo_do() {
+    if (g_undo_pos >= g_undo_count - 1) return;
+    g_undo_pos++;
+    state_restore(g_undo_pos);
+}
@@ -84,8 +84,10 @@ void px_fill_rounded(uint32_t* px, int bw, int bh,
     }
 }
 
+// `raster` is scratch space, one per thread drawing lines
 void px_line(uint32_t* px, int bw, int bh,
-             int x0, int y0, int x1, int y1, int thick, Color c) {
+             int x0, int y0, int x1, int y1, int thick, Color c,
+             CoverageRaster& raster) {
     if (thick < 1) thick = 1;
     int half = thick / 2;
 
@@ -103,25 +105,18 @@ void px_line(uint32_t* px, int bw, int bh,
         px_fill(px, bw, bh, x0 - half, ty, thick, by - ty + 1, c);
         return;
     }
-    // General case: Bresenham with thickness
-    uint32_t v = c.to_pixel();
-    int dx = x1 - x0; int sx = dx > 0 ? 1 : -1; if (dx < 0) dx = -dx;
-    int dy = y1 - y0; int sy = dy > 0 ? 1 : -1; if (dy < 0) dy = -dy;
-    int err = dx - dy;
-    int cx = x0, cy = y0;
-    while (true) {
-        for (int oy = -half; oy <= half; oy++) {
-            for (int ox = -half; ox <= half; ox++) {
-                int px_x = cx + ox, py_y = cy + oy;
-                if (px_x >= 0 && px_x < bw && py_y >= 0 && py_y < bh)
-                    px[py_y * bw + px_x] = v;
-            }
-        }
-        if (cx == x1 && cy == y1) break;
-        int e2 = 2 * err;
-        if (e2 > -dy) { err -= dy; cx += sx; }
-        if (e2 < dx) { err += dx; cy += sy; }
-    }
+    // General case: an anti-aliased quad, rasterized over its bounding box
+    int bx0 = (x0 < x1 ? x0 : x1) - thick, by0 = (y0 < y1 ? y0 : y1) - thick;
+    int bx1 = (x0 > x1 ? x0 : x1) + thick + 1, by1 = (y0 > y1 ? y0 : y1) + thick + 1;
+    if (bx0 < 0) bx0 = 0;
+    if (by0 < 0) by0 = 0;
+    if (bx1 > bw) bx1 = bw;
+    if (by1 > bh) by1 = bh;
+    if (bx1 <= bx0 || by1 <= by0 || !raster.init(bx1 - bx0, by1 - by0)) return;
+
+    // Pixel centres, so the line matches the axis-aligned cases above
+    raster.stroke(x0 - bx0 + 0.5f, y0 - by0 + 0.5f, x1 - bx0 + 0.5f, y1 - by0 + 0.5f, (float)thick);
+    raster.fill(px, bw, bh, bx0, by0, c.to_pixel() & 0xFFFFFF, 255);
 }
 
 int str_len(const char* s) {
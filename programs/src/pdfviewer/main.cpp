@@ -105,16 +105,9 @@ static void open_file(const char* path) {
 
 extern "C" void _start() {
     // Load fonts
-    auto load_font = [](const char* path) -> TrueTypeFont* {
-        TrueTypeFont* f = (TrueTypeFont*)montauk::malloc(sizeof(TrueTypeFont));
-        if (!f) return nullptr;
-        montauk::memset(f, 0, sizeof(TrueTypeFont));
-        if (!f->init(path)) { montauk::mfree(f); return nullptr; }
-        return f;
-    };
-    g_font = load_font("0:/fonts/Roboto-Medium.ttf");
-    g_font_bold = load_font("0:/fonts/Roboto-Bold.ttf");
-    g_font_mono = load_font("0:/fonts/JetBrainsMono-Regular.ttf");
+    g_font = fonts::open("0:/fonts/Roboto-Medium.ttf");
+    g_font_bold = fonts::open("0:/fonts/Roboto-Bold.ttf");
+    g_font_mono = fonts::open("0:/fonts/JetBrainsMono-Regular.ttf");
 
     // Check for file argument
     char args[512] = {};
@@ -141,6 +134,7 @@ extern "C" void _start() {
     render(pixels);
     win.present();
 
+    uint32_t pressure_events = 0;
     while (true) {
         Montauk::WinEvent ev;
         int r = win.poll(&ev);
@@ -148,7 +142,16 @@ extern "C" void _start() {
         if (r < 0) break;
 
         if (r == 0) {
-            montauk::sleep_ms(16);
+            // Let go of cached pages if memory is running short
+            Montauk::MemStats mem;
+            montauk::memstats(&mem);
+            if (mem.pressureEvents != pressure_events) {
+                pressure_events = mem.pressureEvents;
+                page_cache_pressure(mem.pressure);
+            }
+
+            if (!page_prefetch())
+                montauk::sleep_ms(16);
             continue;
         }
 
@@ -322,6 +325,7 @@ extern "C" void _start() {
         }
     }
 
+    tiles_shutdown();
     free_pdf();
     win.destroy();
     montauk::exit(0);
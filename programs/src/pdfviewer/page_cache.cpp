@@ -0,0 +1,95 @@
+/*
+ * page_cache.cpp
+ * Parsed-page cache and idle-time prefetch
+ * Copyright (c) 2026 Daniel Hammer
+ */
+
+#include "pdfviewer.h"
+
+// Pages are parsed the first time they are shown. At most PAGE_CACHE_MAX
+// keep their display lists; past that the least recently used one is
+// dropped and parsed again if it comes back.
+static constexpr int PAGE_CACHE_MAX = 16;
+
+static uint32_t g_use_clock = 0;
+
+// Memory pressure (Montauk::MEM_PRESSURE_*). From LOW on nothing is
+// prefetched; from MEDIUM on only the current page is kept.
+static uint32_t g_pressure = Montauk::MEM_PRESSURE_NONE;
+
+static void page_release(PdfPage* page) {
+    if (page->items) montauk::mfree(page->items);
+    if (page->gfx_items) montauk::mfree(page->gfx_items);
+    page->items = nullptr;
+    page->item_count = 0;
+    page->item_cap = 0;
+    page->gfx_items = nullptr;
+    page->gfx_count = 0;
+    page->gfx_cap = 0;
+    page->parsed = false;
+    page_layout_free(page);
+}
+
+PdfPage* page_get(int idx) {
+    PdfPage* page = &g_doc.pages[idx];
+    page->last_used = ++g_use_clock;
+    if (page->parsed) return page;
+
+    int parsed = 0;
+    int oldest = -1;
+    for (int i = 0; i < g_doc.page_count; i++) {
+        if (!g_doc.pages[i].parsed) continue;
+        parsed++;
+        if (oldest < 0 || g_doc.pages[i].last_used < g_doc.pages[oldest].last_used)
+            oldest = i;
+    }
+    if (parsed >= PAGE_CACHE_MAX && oldest >= 0)
+        page_release(&g_doc.pages[oldest]);
+
+    parse_page(idx, g_doc.page_objs[idx]);
+    page->parsed = true;
+    return page;
+}
+
+void page_cache_clear() {
+    tiles_clear(-1);
+    if (g_doc.pages) {
+        for (int i = 0; i < g_doc.page_count; i++)
+            page_release(&g_doc.pages[i]);
+    }
+}
+
+// The system's memory pressure changed: give back everything but the
+// current page if it is MEDIUM or worse. The rest is parsed and rendered
+// again when it is shown.
+void page_cache_pressure(uint32_t level) {
+    g_pressure = level;
+    if (level < Montauk::MEM_PRESSURE_MEDIUM) return;
+
+    tiles_clear(g_current_page);
+    if (g_doc.pages) {
+        for (int i = 0; i < g_doc.page_count; i++)
+            if (i != g_current_page && g_doc.pages[i].parsed) page_release(&g_doc.pages[i]);
+    }
+}
+
+// Called when the event loop is idle: get the first screen of the next
+// page parsed and rendered before it is asked for. Returns true if it did
+// any work.
+bool page_prefetch() {
+    if (!g_doc.valid || g_pressure >= Montauk::MEM_PRESSURE_LOW) return false;
+    int next = g_current_page + 1;
+    if (next >= g_doc.page_count) return false;
+
+    const PdfPage* page = &g_doc.pages[next];
+    int w = (int)(page->width * g_zoom);
+    int h = g_win_h;
+    if (tiles_ready(next, 0, 0, w, h)) return false;
+    if (tiles_render(next, 0, 0, w, h)) return true;
+
+    // More than the tile cache holds: having the display list is the most
+    // that can be done ahead of time
+    if (page->parsed) return false;
+    page_get(next);
+    return true;
+}
@@ -22,6 +22,11 @@ struct Token {
     int str_len;
 };
 
+// How far ahead of the tokenizer a content stream is kept decoded. A
+// token that runs past this (only inline image data, in practice) is cut
+// short at the window edge.
+static constexpr int CONTENT_LOOKAHEAD = 32768;
+
 static int next_token(const uint8_t* d, int len, int p, Token* tok) {
     // Skip whitespace
     while (p < len && (d[p] == ' ' || d[p] == '\t' || d[p] == '\n' || d[p] == '\r'))
@@ -387,9 +392,7 @@ void parse_page(int page_idx, int page_obj_num) {
     // Get content stream(s)
     int start, end;
     if (find_obj_content(page_obj_num, &start, &end) < 0) {
-        for (int fi = 0; fi < fonts->count; fi++)
-        if (fonts->fonts[fi].tounicode) montauk::mfree(fonts->fonts[fi].tounicode);
-    montauk::mfree(fonts);
+        montauk::mfree(fonts);
         return;
     }
 
@@ -398,9 +401,7 @@ void parse_page(int page_idx, int page_obj_num) {
 
     int contents_pos = dict_lookup(d, len, start, "Contents");
     if (contents_pos < 0) {
-        for (int fi = 0; fi < fonts->count; fi++)
-        if (fonts->fonts[fi].tounicode) montauk::mfree(fonts->fonts[fi].tounicode);
-    montauk::mfree(fonts);
+        montauk::mfree(fonts);
         return;
     }
 
@@ -434,13 +435,13 @@ void parse_page(int page_idx, int page_obj_num) {
 
     // Concatenate and parse all content streams
     for (int ci = 0; ci < content_count; ci++) {
-        int stream_len;
-        uint8_t* stream_data = get_stream_data(content_objs[ci], &stream_len);
-        if (!stream_data) continue;
+        // Decoded and parsed a window at a time
+        PdfStream stm;
+        if (!stream_open(content_objs[ci], &stm)) continue;
 
         // Parse the content stream
         Operand* ops = (Operand*)montauk::malloc(MAX_OPERANDS * sizeof(Operand));
-        if (!ops) { montauk::mfree(stream_data); continue; }
+        if (!ops) { stream_close(&stm); continue; }
         int op_count = 0;
 
         TextState ts;
@@ -475,8 +476,10 @@ void parse_page(int page_idx, int page_obj_num) {
         Token tok;
         int pos = 0;
 
-        while (pos < stream_len) {
-            pos = next_token(stream_data, stream_len, pos, &tok);
+        for (;;) {
+            stream_fill(&stm, &pos, CONTENT_LOOKAHEAD);
+            if (pos >= stm.len) break;
+            pos = next_token(stm.data, stm.len, pos, &tok);
             if (tok.type == TOK_EOF) break;
 
             // Accumulate operands
@@ -519,9 +522,11 @@ void parse_page(int page_idx, int page_obj_num) {
                 char tj_buf[MAX_TEXT_LEN];
                 int tj_len = 0;
 
-                while (pos < stream_len) {
+                for (;;) {
+                    stream_fill(&stm, &pos, CONTENT_LOOKAHEAD);
+                    if (pos >= stm.len) break;
                     Token atk;
-                    int next_pos = next_token(stream_data, stream_len, pos, &atk);
+                    int next_pos = next_token(stm.data, stm.len, pos, &atk);
                     if (atk.type == TOK_EOF) break;
                     if (atk.type == TOK_ARRAY_END) { pos = next_pos; break; }
 
@@ -964,10 +969,8 @@ void parse_page(int page_idx, int page_obj_num) {
         montauk::mfree(ops);
         if (path_segs) montauk::mfree(path_segs);
         if (path_rects) montauk::mfree(path_rects);
-        montauk::mfree(stream_data);
+        stream_close(&stm);
     }
 
-    for (int fi = 0; fi < fonts->count; fi++)
-        if (fonts->fonts[fi].tounicode) montauk::mfree(fonts->fonts[fi].tounicode);
     montauk::mfree(fonts);
 }
@@ -10,285 +10,433 @@
 // DEFLATE Decompression (RFC 1951)
 // ============================================================================
 
+// Bits are consumed LSB-first from a 64-bit buffer that is topped up eight
+// bytes at a time, so one refill covers a whole length/distance pair.
+// Past the end of the input the buffer is padded with zeros; pad_bits
+// counts them so that reading into the padding can be caught.
 struct BitStream {
     const uint8_t* data;
     int len;
-    int byte_pos;
-    uint32_t buf;
-    int buf_bits;
+    int pos;
+    uint64_t buf;
+    int bits;
+    int pad_bits;
 };
 
 static void bs_init(BitStream* bs, const uint8_t* data, int len) {
     bs->data = data;
     bs->len = len;
-    bs->byte_pos = 0;
+    bs->pos = 0;
     bs->buf = 0;
-    bs->buf_bits = 0;
+    bs->bits = 0;
+    bs->pad_bits = 0;
 }
 
-static void bs_ensure(BitStream* bs, int n) {
-    while (bs->buf_bits < n && bs->byte_pos < bs->len) {
-        bs->buf |= (uint32_t)bs->data[bs->byte_pos++] << bs->buf_bits;
-        bs->buf_bits += 8;
+// Leave at least 56 bits in the buffer
+static inline void bs_refill(BitStream* bs) {
+    if (bs->bits >= 56) return;
+    if (bs->pos + 8 <= bs->len) {
+        uint64_t w;
+        __builtin_memcpy(&w, bs->data + bs->pos, 8);
+        bs->buf |= w << bs->bits;
+        bs->pos += (63 - bs->bits) >> 3;
+        bs->bits |= 56;
+        return;
+    }
+    while (bs->bits <= 56) {
+        if (bs->pos < bs->len)
+            bs->buf |= (uint64_t)bs->data[bs->pos++] << bs->bits;
+        else
+            bs->pad_bits += 8;
+        bs->bits += 8;
     }
 }
 
-static uint32_t bs_read(BitStream* bs, int n) {
-    if (n == 0) return 0;
-    bs_ensure(bs, n);
-    uint32_t val = bs->buf & ((1u << n) - 1);
+static inline bool bs_overrun(const BitStream* bs) {
+    return bs->bits < bs->pad_bits;
+}
+
+// Take n bits that are already buffered
+static inline uint32_t bs_take(BitStream* bs, int n) {
+    uint32_t val = (uint32_t)(bs->buf & ((1ull << n) - 1));
     bs->buf >>= n;
-    bs->buf_bits -= n;
+    bs->bits -= n;
     return val;
 }
 
-// Huffman tree: children[node][bit]
-// Leaf: -(symbol + 1), Internal: child node index (>= 0)
-#define HUFF_UNSET ((int16_t)0x7FFF)
-#define HUFF_MAX_NODES 620
-
-struct HuffTree {
-    int16_t ch[HUFF_MAX_NODES][2];
-    int cnt;
-};
-
-static void huff_init(HuffTree* t) {
-    t->cnt = 1;
-    t->ch[0][0] = t->ch[0][1] = HUFF_UNSET;
+static uint32_t bs_read(BitStream* bs, int n) {
+    bs_refill(bs);
+    return bs_take(bs, n);
 }
 
-static void huff_build(HuffTree* t, const int* lens, int n) {
-    huff_init(t);
-
+// Huffman decoding table. The low `primary` bits of the input index the
+// first level directly. An entry holds the symbol in its top 16 bits and
+// the code length in its low 4; zero means no code. Codes longer than
+// `primary` bits go through a link entry (HUFF_LINK) to a second-level
+// table indexed by the following bits.
+static constexpr uint32_t HUFF_LINK = 0x100;
+static constexpr int LIT_PRIMARY  = 10;
+static constexpr int DIST_PRIMARY = 8;
+static constexpr int CL_PRIMARY   = 7;
+static constexpr int LIT_TABLE_SIZE  = (1 << LIT_PRIMARY) + 288 * (1 << (15 - LIT_PRIMARY));
+static constexpr int DIST_TABLE_SIZE = (1 << DIST_PRIMARY) + 32 * (1 << (15 - DIST_PRIMARY));
+static constexpr int CL_TABLE_SIZE   = 1 << CL_PRIMARY;
+
+static bool huff_build(uint32_t* table, int primary, const uint8_t* lens, int n) {
+    int bl_count[16] = {};
     int max_len = 0;
-    for (int i = 0; i < n; i++)
+    for (int i = 0; i < n; i++) {
+        bl_count[lens[i]]++;
         if (lens[i] > max_len) max_len = lens[i];
-    if (max_len == 0) return;
+    }
+    bl_count[0] = 0;
 
-    int bl_count[16] = {};
-    for (int i = 0; i < n; i++)
-        if (lens[i]) bl_count[lens[i]]++;
+    // Over-subscribed codes are invalid; incomplete ones just leave holes
+    int left = 1;
+    for (int b = 1; b <= 15; b++) {
+        left = (left << 1) - bl_count[b];
+        if (left < 0) return false;
+    }
 
     int next_code[16] = {};
     int code = 0;
-    for (int b = 1; b <= max_len; b++) {
+    for (int b = 1; b <= 15; b++) {
         code = (code + bl_count[b - 1]) << 1;
         next_code[b] = code;
     }
 
+    montauk::memset(table, 0, (uint64_t)(1 << primary) * sizeof(uint32_t));
+    int sub_bits = max_len > primary ? max_len - primary : 0;
+    int next_sub = 1 << primary;
+
     for (int sym = 0; sym < n; sym++) {
         int len = lens[sym];
         if (!len) continue;
         int c = next_code[len]++;
-        int node = 0;
-        for (int bit = len - 1; bit >= 0; bit--) {
-            int b = (c >> bit) & 1;
-            if (bit == 0) {
-                t->ch[node][b] = (int16_t)(-(sym + 1));
-            } else {
-                if (t->ch[node][b] == HUFF_UNSET || t->ch[node][b] < 0) {
-                    int nn = t->cnt++;
-                    if (nn >= HUFF_MAX_NODES) return;
-                    t->ch[nn][0] = t->ch[nn][1] = HUFF_UNSET;
-                    t->ch[node][b] = (int16_t)nn;
-                    node = nn;
-                } else {
-                    node = t->ch[node][b];
-                }
-            }
+        int rev = 0;
+        for (int i = 0; i < len; i++) rev |= ((c >> i) & 1) << (len - 1 - i);
+
+        if (len <= primary) {
+            for (int i = rev; i < (1 << primary); i += 1 << len)
+                table[i] = ((uint32_t)sym << 16) | (uint32_t)len;
+            continue;
         }
+
+        uint32_t& link = table[rev & ((1 << primary) - 1)];
+        if (!(link & HUFF_LINK)) {
+            link = ((uint32_t)next_sub << 16) | HUFF_LINK | ((uint32_t)sub_bits << 4);
+            montauk::memset(table + next_sub, 0, (uint64_t)(1 << sub_bits) * sizeof(uint32_t));
+            next_sub += 1 << sub_bits;
+        }
+        uint32_t* sub = table + (link >> 16);
+        int sub_len = len - primary;
+        for (int i = rev >> primary; i < (1 << sub_bits); i += 1 << sub_len)
+            sub[i] = ((uint32_t)sym << 16) | (uint32_t)sub_len;
     }
+    return true;
 }
 
-static int huff_decode(HuffTree* t, BitStream* bs) {
-    int node = 0;
-    for (;;) {
-        bs_ensure(bs, 1);
-        if (bs->buf_bits == 0) return -1;
-        int bit = bs->buf & 1;
-        bs->buf >>= 1;
-        bs->buf_bits--;
-        int16_t val = t->ch[node][bit];
-        if (val == HUFF_UNSET) return -1;
-        if (val < 0) return -(val) - 1;
-        node = val;
-    }
+// Needs 15 buffered bits. Returns the symbol, or -1 for an unused code.
+static inline int huff_decode(const uint32_t* table, int primary, BitStream* bs) {
+    uint32_t e = table[bs->buf & ((1u << primary) - 1)];
+    if (e & HUFF_LINK) {
+        bs_take(bs, primary);
+        e = table[(e >> 16) + (bs->buf & ((1u << ((e >> 4) & 15)) - 1))];
+    }
+    int len = e & 15;
+    if (!len) return -1;
+    bs_take(bs, len);
+    return (int)(e >> 16);
 }
 
-static const int LEN_BASE[29] = {
+static const uint16_t LEN_BASE[29] = {
     3,4,5,6,7,8,9,10,11,13,15,17,19,23,27,31,
     35,43,51,59,67,83,99,115,131,163,195,227,258
 };
-static const int LEN_EXTRA[29] = {
+static const uint8_t LEN_EXTRA[29] = {
     0,0,0,0,0,0,0,0,1,1,1,1,2,2,2,2,
     3,3,3,3,4,4,4,4,5,5,5,5,0
 };
-static const int DIST_BASE[30] = {
+static const uint16_t DIST_BASE[30] = {
     1,2,3,4,5,7,9,13,17,25,33,49,65,97,129,193,
     257,385,513,769,1025,1537,2049,3073,4097,6145,8193,12289,16385,24577
 };
-static const int DIST_EXTRA[30] = {
+static const uint8_t DIST_EXTRA[30] = {
     0,0,0,0,1,1,2,2,3,3,4,4,5,5,6,6,
     7,7,8,8,9,9,10,10,11,11,12,12,13,13
 };
-static const int CL_ORDER[19] = {
+static const uint8_t CL_ORDER[19] = {
     16,17,18,0,8,7,9,6,10,5,11,4,12,3,13,2,14,1,15
 };
 
-// Inflate raw DEFLATE data (no zlib header). Returns bytes written or -1.
-static int inflate_raw(BitStream* bs, uint8_t* out, int out_cap) {
-    HuffTree* lit = (HuffTree*)montauk::malloc(sizeof(HuffTree));
-    HuffTree* dist = (HuffTree*)montauk::malloc(sizeof(HuffTree));
-    HuffTree* cl = (HuffTree*)montauk::malloc(sizeof(HuffTree));
-    if (!lit || !dist || !cl) goto fail;
+static constexpr int INFLATE_WINDOW = 32768;
+static constexpr int INFLATE_SLACK  = 258 + 8;  // longest match plus wide-copy overrun
 
-    {
-        int out_pos = 0;
-        int bfinal = 0;
-
-        while (!bfinal) {
-            bfinal = (int)bs_read(bs, 1);
-            int btype = (int)bs_read(bs, 2);
-
-            if (btype == 0) {
-                // Stored block: align to byte boundary
-                bs->buf = 0;
-                bs->buf_bits = 0;
-                if (bs->byte_pos + 4 > bs->len) goto fail;
-                int len = bs->data[bs->byte_pos] | (bs->data[bs->byte_pos + 1] << 8);
-                bs->byte_pos += 4; // skip len and nlen
-                for (int i = 0; i < len && out_pos < out_cap; i++) {
-                    if (bs->byte_pos >= bs->len) goto fail;
-                    out[out_pos++] = bs->data[bs->byte_pos++];
-                }
-            } else if (btype == 1 || btype == 2) {
-                if (btype == 1) {
-                    // Fixed Huffman codes
-                    int ll[288];
-                    for (int i = 0; i <= 143; i++) ll[i] = 8;
-                    for (int i = 144; i <= 255; i++) ll[i] = 9;
-                    for (int i = 256; i <= 279; i++) ll[i] = 7;
-                    for (int i = 280; i <= 287; i++) ll[i] = 8;
-                    huff_build(lit, ll, 288);
-                    int dd[32];
-                    for (int i = 0; i < 32; i++) dd[i] = 5;
-                    huff_build(dist, dd, 32);
-                } else {
-                    // Dynamic Huffman codes
-                    int hlit = (int)bs_read(bs, 5) + 257;
-                    int hdist = (int)bs_read(bs, 5) + 1;
-                    int hclen = (int)bs_read(bs, 4) + 4;
-
-                    int cl_lens[19] = {};
-                    for (int i = 0; i < hclen; i++)
-                        cl_lens[CL_ORDER[i]] = (int)bs_read(bs, 3);
-                    huff_build(cl, cl_lens, 19);
-
-                    int all_lens[320] = {};
-                    int total = hlit + hdist;
-                    int idx = 0;
-                    while (idx < total) {
-                        int sym = huff_decode(cl, bs);
-                        if (sym < 0) goto fail;
-                        if (sym < 16) {
-                            all_lens[idx++] = sym;
-                        } else if (sym == 16) {
-                            int rep = (int)bs_read(bs, 2) + 3;
-                            int val = idx > 0 ? all_lens[idx - 1] : 0;
-                            for (int j = 0; j < rep && idx < total; j++)
-                                all_lens[idx++] = val;
-                        } else if (sym == 17) {
-                            int rep = (int)bs_read(bs, 3) + 3;
-                            for (int j = 0; j < rep && idx < total; j++)
-                                all_lens[idx++] = 0;
-                        } else {
-                            int rep = (int)bs_read(bs, 7) + 11;
-                            for (int j = 0; j < rep && idx < total; j++)
-                                all_lens[idx++] = 0;
-                        }
-                    }
+enum InflateState { INF_HEADER, INF_STORED, INF_HUFF, INF_DONE, INF_ERROR };
 
-                    huff_build(lit, all_lens, hlit);
-                    huff_build(dist, all_lens + hlit, hdist);
-                }
+// A decoder that can stop between symbols and pick up again later, so
+// output can be produced a piece at a time. out[0, out_len) is what has
+// been decoded and not yet discarded; it always ends with the last
+// INFLATE_WINDOW bytes of output, which matches may refer back into.
+struct Inflater {
+    BitStream bs;
+    uint8_t* out;
+    int out_len;
+    int out_cap;
+    InflateState state;
+    bool final_block;
+    int stored_left;
+    uint32_t lit[LIT_TABLE_SIZE];
+    uint32_t dist[DIST_TABLE_SIZE];
+    uint32_t cl[CL_TABLE_SIZE];
+};
 
-                // Decode symbols
-                for (;;) {
-                    int sym = huff_decode(lit, bs);
-                    if (sym < 0) goto fail;
-                    if (sym < 256) {
-                        if (out_pos >= out_cap) goto fail;
-                        out[out_pos++] = (uint8_t)sym;
-                    } else if (sym == 256) {
-                        break;
-                    } else {
-                        int li = sym - 257;
-                        if (li >= 29) goto fail;
-                        int length = LEN_BASE[li];
-                        if (LEN_EXTRA[li])
-                            length += (int)bs_read(bs, LEN_EXTRA[li]);
-
-                        int di = huff_decode(dist, bs);
-                        if (di < 0 || di >= 30) goto fail;
-                        int distance = DIST_BASE[di];
-                        if (DIST_EXTRA[di])
-                            distance += (int)bs_read(bs, DIST_EXTRA[di]);
-
-                        if (distance > out_pos) goto fail;
-                        for (int j = 0; j < length; j++) {
-                            if (out_pos >= out_cap) goto fail;
-                            out[out_pos] = out[out_pos - distance];
-                            out_pos++;
-                        }
-                    }
-                }
-            } else {
-                goto fail;
+// Start decoding zlib-wrapped data (2-byte header + deflate + 4-byte checksum)
+static Inflater* inflate_open(const uint8_t* src, int src_len, int out_cap) {
+    if (src_len < 6) return nullptr;
+
+    // Skip 2-byte zlib header
+    int deflate_start = 2;
+    // Check for FDICT flag
+    if (src[1] & 0x20) deflate_start += 4;
+
+    Inflater* inf = (Inflater*)montauk::malloc(sizeof(Inflater));
+    if (!inf) return nullptr;
+    inf->out = (uint8_t*)montauk::malloc(out_cap);
+    if (!inf->out) {
+        montauk::mfree(inf);
+        return nullptr;
+    }
+    bs_init(&inf->bs, src + deflate_start, src_len - deflate_start - 4);
+    inf->out_len = 0;
+    inf->out_cap = out_cap;
+    inf->state = INF_HEADER;
+    inf->final_block = false;
+    inf->stored_left = 0;
+    return inf;
+}
+
+static void inflate_close(Inflater* inf) {
+    if (!inf) return;
+    montauk::mfree(inf->out);
+    montauk::mfree(inf);
+}
+
+static bool inflate_reserve(Inflater* inf, int n) {
+    if (inf->out_cap - inf->out_len >= n) return true;
+    int new_cap = inf->out_cap * 2;
+    if (new_cap < inf->out_len + n) new_cap = inf->out_len + n;
+    uint8_t* grown = (uint8_t*)montauk::realloc(inf->out, new_cap);
+    if (!grown) return false;
+    inf->out = grown;
+    inf->out_cap = new_cap;
+    return true;
+}
+
+// Drop output before `keep` that is no longer needed, retaining the match
+// window. Returns how far the remaining bytes moved down.
+static int inflate_discard(Inflater* inf, int keep) {
+    int drop = inf->out_len - INFLATE_WINDOW;
+    if (drop > keep) drop = keep;
+    if (drop <= 0) return 0;
+    montauk::memmove(inf->out, inf->out + drop, inf->out_len - drop);
+    inf->out_len -= drop;
+    return drop;
+}
+
+static bool inflate_block_header(Inflater* inf) {
+    BitStream* bs = &inf->bs;
+    inf->final_block = bs_read(bs, 1) != 0;
+    int btype = (int)bs_read(bs, 2);
+
+    if (btype == 0) {
+        // Stored block: realign to the byte boundary and rewind the input
+        // past whatever whole bytes are still buffered
+        bs_take(bs, bs->bits & 7);
+        bs->pos -= (bs->bits - bs->pad_bits) >> 3;
+        bs->buf = 0;
+        bs->bits = 0;
+        bs->pad_bits = 0;
+        if (bs->pos + 4 > bs->len) return false;
+        inf->stored_left = bs->data[bs->pos] | (bs->data[bs->pos + 1] << 8);
+        bs->pos += 4; // skip len and nlen
+        inf->state = INF_STORED;
+        return true;
+    }
+
+    if (btype == 1) {
+        // Fixed Huffman codes
+        uint8_t ll[288];
+        for (int i = 0; i <= 143; i++) ll[i] = 8;
+        for (int i = 144; i <= 255; i++) ll[i] = 9;
+        for (int i = 256; i <= 279; i++) ll[i] = 7;
+        for (int i = 280; i <= 287; i++) ll[i] = 8;
+        uint8_t dd[30];
+        for (int i = 0; i < 30; i++) dd[i] = 5;
+        huff_build(inf->lit, LIT_PRIMARY, ll, 288);
+        huff_build(inf->dist, DIST_PRIMARY, dd, 30);
+        inf->state = INF_HUFF;
+        return true;
+    }
+
+    if (btype != 2) return false;
+
+    // Dynamic Huffman codes
+    int hlit = (int)bs_read(bs, 5) + 257;
+    int hdist = (int)bs_read(bs, 5) + 1;
+    int hclen = (int)bs_read(bs, 4) + 4;
+
+    uint8_t cl_lens[19] = {};
+    for (int i = 0; i < hclen; i++)
+        cl_lens[CL_ORDER[i]] = (uint8_t)bs_read(bs, 3);
+    if (!huff_build(inf->cl, CL_PRIMARY, cl_lens, 19)) return false;
+
+    uint8_t all_lens[320] = {};
+    int total = hlit + hdist;
+    int idx = 0;
+    while (idx < total) {
+        bs_refill(bs);
+        int sym = huff_decode(inf->cl, CL_PRIMARY, bs);
+        if (sym < 0 || bs_overrun(bs)) return false;
+        if (sym < 16) {
+            all_lens[idx++] = (uint8_t)sym;
+            continue;
+        }
+        int rep;
+        uint8_t val = 0;
+        if (sym == 16) {
+            if (idx == 0) return false;
+            val = all_lens[idx - 1];
+            rep = (int)bs_take(bs, 2) + 3;
+        } else if (sym == 17) {
+            rep = (int)bs_take(bs, 3) + 3;
+        } else {
+            rep = (int)bs_take(bs, 7) + 11;
+        }
+        if (idx + rep > total) return false;
+        while (rep--) all_lens[idx++] = val;
+    }
+
+    if (!huff_build(inf->lit, LIT_PRIMARY, all_lens, hlit)) return false;
+    if (!huff_build(inf->dist, DIST_PRIMARY, all_lens + hlit, hdist)) return false;
+    inf->state = INF_HUFF;
+    return true;
+}
+
+// Decode until at least `target` bytes are held in out, or the stream
+// ends. Returns false on corrupt or truncated data.
+static bool inflate_run(Inflater* inf, int target) {
+    BitStream* bs = &inf->bs;
+
+    while (inf->out_len < target) {
+        if (inf->state == INF_DONE) return true;
+        if (inf->state == INF_ERROR) return false;
+
+        if (inf->state == INF_HEADER) {
+            if (!inflate_block_header(inf) || bs_overrun(bs)) {
+                inf->state = INF_ERROR;
+                return false;
             }
+            continue;
         }
 
-        montauk::mfree(lit);
-        montauk::mfree(dist);
-        montauk::mfree(cl);
-        return out_pos;
-    }
+        if (inf->state == INF_STORED) {
+            int n = inf->stored_left;
+            if (n > target - inf->out_len) n = target - inf->out_len;
+            if (n > bs->len - bs->pos || !inflate_reserve(inf, n)) {
+                inf->state = INF_ERROR;
+                return false;
+            }
+            montauk::memcpy(inf->out + inf->out_len, bs->data + bs->pos, n);
+            inf->out_len += n;
+            bs->pos += n;
+            inf->stored_left -= n;
+            if (inf->stored_left == 0)
+                inf->state = inf->final_block ? INF_DONE : INF_HEADER;
+            continue;
+        }
 
-fail:
-    if (lit) montauk::mfree(lit);
-    if (dist) montauk::mfree(dist);
-    if (cl) montauk::mfree(cl);
-    return -1;
+        // Huffman-coded block. One refill covers the longest symbol pair:
+        // 15 + 5 bits of length and 15 + 13 bits of distance.
+        uint8_t* out = inf->out;
+        int out_len = inf->out_len;
+        bool ok = true;
+        while (out_len < target) {
+            if (inf->out_cap - out_len < INFLATE_SLACK) {
+                inf->out_len = out_len;
+                if (!inflate_reserve(inf, INFLATE_SLACK)) { ok = false; break; }
+                out = inf->out;
+            }
+
+            bs_refill(bs);
+            if (bs_overrun(bs)) { ok = false; break; }
+
+            int sym = huff_decode(inf->lit, LIT_PRIMARY, bs);
+            if (sym < 256) {
+                if (sym < 0) { ok = false; break; }
+                out[out_len++] = (uint8_t)sym;
+                continue;
+            }
+            if (sym == 256) {
+                inf->state = inf->final_block ? INF_DONE : INF_HEADER;
+                break;
+            }
+
+            int li = sym - 257;
+            if (li >= 29) { ok = false; break; }
+            int length = LEN_BASE[li] + (int)bs_take(bs, LEN_EXTRA[li]);
+
+            int di = huff_decode(inf->dist, DIST_PRIMARY, bs);
+            if (di < 0 || di >= 30) { ok = false; break; }
+            int distance = DIST_BASE[di] + (int)bs_take(bs, DIST_EXTRA[di]);
+            if (distance > out_len) { ok = false; break; }
+
+            uint8_t* dst = out + out_len;
+            const uint8_t* src = dst - distance;
+            if (distance >= 8) {
+                // Eight bytes at a time; may write up to 7 bytes past the
+                // match, which INFLATE_SLACK leaves room for
+                uint8_t* end = dst + length;
+                do {
+                    uint64_t w;
+                    __builtin_memcpy(&w, src, 8);
+                    __builtin_memcpy(dst, &w, 8);
+                    dst += 8;
+                    src += 8;
+                } while (dst < end);
+            } else if (distance == 1) {
+                montauk::memset(dst, *src, length);
+            } else {
+                for (int j = 0; j < length; j++) dst[j] = src[j];
+            }
+            out_len += length;
+        }
+        inf->out_len = out_len;
+        if (!ok || bs_overrun(bs)) {
+            inf->state = INF_ERROR;
+            return false;
+        }
+    }
+    return true;
 }
 
-// Inflate zlib-wrapped data (2-byte header + deflate + 4-byte checksum).
+// Inflate zlib-wrapped data in one go.
 // Returns heap-allocated buffer and length, or nullptr on failure.
 static uint8_t* inflate_zlib(const uint8_t* src, int src_len, int* out_len) {
-    if (src_len < 6) return nullptr;
+    int cap = src_len * 4;
+    if (cap < 65536) cap = 65536;
+    Inflater* inf = inflate_open(src, src_len, cap);
+    if (!inf) return nullptr;
 
-    // Skip 2-byte zlib header
-    int deflate_start = 2;
-    // Check for FDICT flag
-    if (src[1] & 0x20) deflate_start += 4;
-
-    BitStream bs;
-    bs_init(&bs, src + deflate_start, src_len - deflate_start - 4);
-
-    // Try progressively larger buffers
-    for (int mult = 8; mult <= 64; mult *= 2) {
-        int cap = src_len * mult;
-        if (cap < 65536) cap = 65536;
-        uint8_t* dst = (uint8_t*)montauk::malloc(cap);
-        if (!dst) return nullptr;
-
-        bs_init(&bs, src + deflate_start, src_len - deflate_start - 4);
-        int result = inflate_raw(&bs, dst, cap);
-        if (result >= 0) {
-            *out_len = result;
-            return dst;
-        }
-        montauk::mfree(dst);
+    if (!inflate_run(inf, 0x7FFFFFFF)) {
+        inflate_close(inf);
+        return nullptr;
     }
-    return nullptr;
+
+    uint8_t* dst = inf->out;
+    *out_len = inf->out_len;
+    montauk::mfree(inf);
+    return dst;
 }
 
 // ============================================================================
@@ -565,12 +713,11 @@ int find_obj_content(int obj_num, int* start, int* end) {
 // Stream Data Extraction
 // ============================================================================
 
-// Get decompressed stream data for a stream object.
-// Returns heap-allocated buffer (caller must free) and sets out_len.
-uint8_t* get_stream_data(int obj_num, int* out_len) {
+// Locate a stream object's raw bytes and whether they are Flate-encoded
+static bool find_stream_extent(int obj_num, int* data_start, int* data_len, bool* flate) {
     int obj_start, obj_end;
     if (find_obj_content(obj_num, &obj_start, &obj_end) < 0)
-        return nullptr;
+        return false;
 
     const uint8_t* d = g_doc.data;
     int len = g_doc.data_len;
@@ -624,12 +771,27 @@ uint8_t* get_stream_data(int obj_num, int* out_len) {
         sp++;
     }
 
-    if (sp >= len || stream_len <= 0) return nullptr;
+    if (sp >= len || stream_len <= 0) return false;
 
     // Clamp stream_len to available file data
     // (Don't clamp to obj_end — binary streams may contain false "endobj" matches)
     if (sp + stream_len > len) stream_len = len - sp;
 
+    *data_start = sp;
+    *data_len = stream_len;
+    *flate = is_flate;
+    return true;
+}
+
+// Get decompressed stream data for a stream object.
+// Returns heap-allocated buffer (caller must free) and sets out_len.
+uint8_t* get_stream_data(int obj_num, int* out_len) {
+    int sp, stream_len;
+    bool is_flate;
+    if (!find_stream_extent(obj_num, &sp, &stream_len, &is_flate))
+        return nullptr;
+
+    const uint8_t* d = g_doc.data;
     if (is_flate) {
         return inflate_zlib(d + sp, stream_len, out_len);
     } else {
@@ -642,6 +804,50 @@ uint8_t* get_stream_data(int obj_num, int* out_len) {
     }
 }
 
+// Open a stream for reading front to back. Compressed streams are
+// decoded only as far as stream_fill asks.
+bool stream_open(int obj_num, PdfStream* s) {
+    int sp, stream_len;
+    bool is_flate;
+    if (!find_stream_extent(obj_num, &sp, &stream_len, &is_flate))
+        return false;
+
+    const uint8_t* d = g_doc.data;
+    if (!is_flate) {
+        s->inf = nullptr;
+        s->data = d + sp;
+        s->len = stream_len;
+        s->complete = true;
+        return true;
+    }
+
+    s->inf = inflate_open(d + sp, stream_len, 2 * INFLATE_WINDOW);
+    if (!s->inf) return false;
+    s->data = s->inf->out;
+    s->len = 0;
+    s->complete = false;
+    return true;
+}
+
+// Make at least `want` bytes from *pos on available, unless the stream
+// ends first. Bytes before *pos may be dropped, moving the rest down;
+// *pos is adjusted to match.
+void stream_fill(PdfStream* s, int* pos, int want) {
+    if (s->complete || s->len - *pos >= want) return;
+
+    Inflater* inf = s->inf;
+    *pos -= inflate_discard(inf, *pos);
+    if (!inflate_run(inf, *pos + want) || inf->state == INF_DONE)
+        s->complete = true;
+    s->data = inf->out;
+    s->len = inf->out_len;
+}
+
+void stream_close(PdfStream* s) {
+    inflate_close(s->inf);
+    s->inf = nullptr;
+}
+
 // ============================================================================
 // Xref Parsing
 // ============================================================================
@@ -1048,6 +1254,7 @@ static void add_page(int obj_num) {
     g_doc.pages[g_doc.page_count].gfx_cap = 0;
     g_doc.pages[g_doc.page_count].width = 612;
     g_doc.pages[g_doc.page_count].height = 792;
+    g_doc.pages[g_doc.page_count].parsed = false;
     g_doc.page_count++;
 }
 
@@ -1295,6 +1502,98 @@ static TrueTypeFont* load_embedded_font(int stream_obj_num) {
     return f;
 }
 
+// Resolve a font resource by object number. Each font's flags, ToUnicode
+// table and embedded font are worked out once per document and shared by
+// every page that uses it.
+static const PdfFont* font_get(int font_obj) {
+    for (int i = 0; i < g_doc.font_count; i++)
+        if (g_doc.fonts[i].obj_num == font_obj) return &g_doc.fonts[i];
+
+    if (g_doc.font_count >= g_doc.font_cap) {
+        int new_cap = g_doc.font_cap ? g_doc.font_cap * 2 : 16;
+        PdfFont* nf = (PdfFont*)montauk::malloc(new_cap * sizeof(PdfFont));
+        if (!nf) return nullptr;
+        if (g_doc.fonts) {
+            montauk::memcpy(nf, g_doc.fonts, g_doc.font_count * sizeof(PdfFont));
+            montauk::mfree(g_doc.fonts);
+        }
+        g_doc.fonts = nf;
+        g_doc.font_cap = new_cap;
+    }
+
+    // Fonts that fail to resolve are cached too, with no flags or tables
+    PdfFont* font = &g_doc.fonts[g_doc.font_count++];
+    font->obj_num = font_obj;
+    font->flags = 0;
+    font->tounicode = nullptr;
+    font->embedded_font = nullptr;
+
+    const uint8_t* d = g_doc.data;
+    int len = g_doc.data_len;
+
+    // Look up /BaseFont in the font object
+    int fs2, fe2;
+    if (find_obj_content(font_obj, &fs2, &fe2) == 0) {
+        int bf_pos = dict_lookup(d, len, fs2, "BaseFont");
+        if (bf_pos >= 0 && bf_pos < len && d[bf_pos] == '/') {
+            bf_pos++;
+            char base_font[64] = {};
+            int bi = 0;
+            while (bf_pos < len && bi < 63 && d[bf_pos] != ' ' &&
+                   d[bf_pos] != '\t' && d[bf_pos] != '\n' &&
+                   d[bf_pos] != '\r' && d[bf_pos] != '/' &&
+                   d[bf_pos] != '<' && d[bf_pos] != '>') {
+                base_font[bi++] = (char)d[bf_pos++];
+            }
+            base_font[bi] = '\0';
+
+            if (str_contains(base_font, "Bold"))
+                font->flags |= 1;
+            if (str_contains(base_font, "Italic") || str_contains(base_font, "Oblique"))
+                font->flags |= 2;
+            if (str_contains(base_font, "Courier") || str_contains(base_font, "Mono"))
+                font->flags |= 4;
+        }
+
+        // Parse /ToUnicode CMap if present
+        int tu_pos = dict_lookup(d, len, fs2, "ToUnicode");
+        if (tu_pos >= 0) {
+            int tu_ref;
+            if (parse_ref_at(d, len, tu_pos, &tu_ref) > 0) {
+                font->tounicode = parse_tounicode(tu_ref);
+            }
+        }
+
+        // Try to load embedded font from FontDescriptor
+        int fdesc_pos = dict_lookup(d, len, fs2, "FontDescriptor");
+        if (fdesc_pos >= 0) {
+            int fdesc_num;
+            if (parse_ref_at(d, len, fdesc_pos, &fdesc_num) > 0) {
+                int fds, fde;
+                if (find_obj_content(fdesc_num, &fds, &fde) == 0) {
+                    // Try /FontFile2 (TrueType)
+                    int ff_pos = dict_lookup(d, len, fds, "FontFile2");
+                    if (ff_pos >= 0) {
+                        int ff_num;
+                        if (parse_ref_at(d, len, ff_pos, &ff_num) > 0)
+                            font->embedded_font = load_embedded_font(ff_num);
+                    }
+                    // Try /FontFile3 (CFF/OpenType)
+                    if (!font->embedded_font) {
+                        ff_pos = dict_lookup(d, len, fds, "FontFile3");
+                        if (ff_pos >= 0) {
+                            int ff_num;
+                            if (parse_ref_at(d, len, ff_pos, &ff_num) > 0)
+                                font->embedded_font = load_embedded_font(ff_num);
+                        }
+                    }
+                }
+            }
+        }
+    }
+    return font;
+}
+
 void build_font_map(int page_obj_num, FontMap* out) {
     out->count = 0;
 
@@ -1375,6 +1674,7 @@ void build_font_map(int page_obj_num, FontMap* out) {
         fi->name[ni] = '\0';
         fi->flags = 0;
         fi->tounicode = nullptr;
+        fi->embedded_font = nullptr;
 
         // Read font reference
         fdp = skip_ws(d, len, fdp);
@@ -1383,67 +1683,11 @@ void build_font_map(int page_obj_num, FontMap* out) {
         if (ref_end > 0) {
             fdp = ref_end;
 
-            // Look up /BaseFont in the font object
-            int fs2, fe2;
-            if (find_obj_content(font_obj, &fs2, &fe2) == 0) {
-                int bf_pos = dict_lookup(d, len, fs2, "BaseFont");
-                if (bf_pos >= 0 && bf_pos < len && d[bf_pos] == '/') {
-                    bf_pos++;
-                    char base_font[64] = {};
-                    int bi = 0;
-                    while (bf_pos < len && bi < 63 && d[bf_pos] != ' ' &&
-                           d[bf_pos] != '\t' && d[bf_pos] != '\n' &&
-                           d[bf_pos] != '\r' && d[bf_pos] != '/' &&
-                           d[bf_pos] != '<' && d[bf_pos] != '>') {
-                        base_font[bi++] = (char)d[bf_pos++];
-                    }
-                    base_font[bi] = '\0';
-
-                    if (str_contains(base_font, "Bold"))
-                        fi->flags |= 1;
-                    if (str_contains(base_font, "Italic") || str_contains(base_font, "Oblique"))
-                        fi->flags |= 2;
-                    if (str_contains(base_font, "Courier") || str_contains(base_font, "Mono"))
-                        fi->flags |= 4;
-                }
-
-                // Parse /ToUnicode CMap if present
-                fi->tounicode = nullptr;
-                int tu_pos = dict_lookup(d, len, fs2, "ToUnicode");
-                if (tu_pos >= 0) {
-                    int tu_ref;
-                    if (parse_ref_at(d, len, tu_pos, &tu_ref) > 0) {
-                        fi->tounicode = parse_tounicode(tu_ref);
-                    }
-                }
-
-                // Try to load embedded font from FontDescriptor
-                fi->embedded_font = nullptr;
-                int fdesc_pos = dict_lookup(d, len, fs2, "FontDescriptor");
-                if (fdesc_pos >= 0) {
-                    int fdesc_num;
-                    if (parse_ref_at(d, len, fdesc_pos, &fdesc_num) > 0) {
-                        int fds, fde;
-                        if (find_obj_content(fdesc_num, &fds, &fde) == 0) {
-                            // Try /FontFile2 (TrueType)
-                            int ff_pos = dict_lookup(d, len, fds, "FontFile2");
-                            if (ff_pos >= 0) {
-                                int ff_num;
-                                if (parse_ref_at(d, len, ff_pos, &ff_num) > 0)
-                                    fi->embedded_font = load_embedded_font(ff_num);
-                            }
-                            // Try /FontFile3 (CFF/OpenType)
-                            if (!fi->embedded_font) {
-                                ff_pos = dict_lookup(d, len, fds, "FontFile3");
-                                if (ff_pos >= 0) {
-                                    int ff_num;
-                                    if (parse_ref_at(d, len, ff_pos, &ff_num) > 0)
-                                        fi->embedded_font = load_embedded_font(ff_num);
-                                }
-                            }
-                        }
-                    }
-                }
+            const PdfFont* font = font_get(font_obj);
+            if (font) {
+                fi->flags = font->flags;
+                fi->tounicode = font->tounicode;
+                fi->embedded_font = font->embedded_font;
             }
         } else {
             // Inline font dict or unknown - skip value
@@ -1602,11 +1846,7 @@ bool load_pdf(const char* path) {
         return false;
     }
 
-    // Parse content for each page
-    for (int i = 0; i < g_doc.page_count; i++) {
-        parse_page(i, g_doc.page_objs[i]);
-    }
-
+    // Page content is parsed when the page is first shown (page_get)
     g_doc.valid = true;
     snprintf(g_status_msg, 128, "%d page%s loaded", g_doc.page_count,
                  g_doc.page_count == 1 ? "" : "s");
@@ -1618,15 +1858,20 @@ void free_pdf() {
     if (g_doc.xref) { montauk::mfree(g_doc.xref); g_doc.xref = nullptr; }
     if (g_doc.xref_stm) { montauk::mfree(g_doc.xref_stm); g_doc.xref_stm = nullptr; }
     if (g_doc.xref_idx) { montauk::mfree(g_doc.xref_idx); g_doc.xref_idx = nullptr; }
+    page_cache_clear();
     if (g_doc.pages) {
-        for (int i = 0; i < g_doc.page_count; i++) {
-            if (g_doc.pages[i].items) montauk::mfree(g_doc.pages[i].items);
-            if (g_doc.pages[i].gfx_items) montauk::mfree(g_doc.pages[i].gfx_items);
-        }
         montauk::mfree(g_doc.pages);
         g_doc.pages = nullptr;
     }
     if (g_doc.page_objs) { montauk::mfree(g_doc.page_objs); g_doc.page_objs = nullptr; }
+    if (g_doc.fonts) {
+        for (int i = 0; i < g_doc.font_count; i++)
+            if (g_doc.fonts[i].tounicode) montauk::mfree(g_doc.fonts[i].tounicode);
+        montauk::mfree(g_doc.fonts);
+        g_doc.fonts = nullptr;
+    }
+    g_doc.font_count = 0;
+    g_doc.font_cap = 0;
     if (g_doc.emb_fonts) {
         for (int i = 0; i < g_doc.emb_font_count; i++) {
             if (g_doc.emb_fonts[i].font_data) montauk::mfree(g_doc.emb_fonts[i].font_data);
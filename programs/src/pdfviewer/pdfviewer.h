@@ -11,6 +11,7 @@
 #include <montauk/heap.h>
 #include <gui/gui.hpp>
 #include <gui/truetype.hpp>
+#include <gui/raster.hpp>
 
 extern "C" {
 #include <string.h>
@@ -75,6 +76,24 @@ struct GraphicsItem {
     uint8_t r, g, b;
 };
 
+// A glyph of a page's text, top-left corner in page pixels
+struct PlacedGlyph {
+    int x, y;
+    const CachedGlyph* glyph;
+};
+
+// A page's text laid out at one zoom level (see page_layout). The
+// distinct glyphs are copies, so drawing from it never touches the font
+// caches, which only the UI thread may use.
+struct PageText {
+    float zoom;
+    CachedGlyph* glyphs;    // bitmaps point into `bitmaps`
+    int glyph_count;
+    uint8_t* bitmaps;
+    PlacedGlyph* placed;
+    int placed_count;
+};
+
 struct PdfPage {
     TextItem* items;
     int item_count;
@@ -83,6 +102,21 @@ struct PdfPage {
     int gfx_count;
     int gfx_cap;
     float width, height; // page dimensions in points (from MediaBox)
+    bool parsed;         // items/gfx_items are filled in (see page_cache.cpp)
+    PageText* text;      // laid out for the zoom last drawn at, or nullptr
+    uint32_t last_used;
+};
+
+// TILE_SIZE x TILE_SIZE pixels of a page at one zoom level. Tiles over
+// the right or bottom edge of the page leave the rest undefined.
+static constexpr int TILE_SIZE = 256;
+
+struct PageTile {
+    uint32_t* px;       // nullptr until the slot is first used
+    int page;           // -1 if the slot is free
+    float zoom;
+    int tx, ty;         // column and row of the tile in the page
+    uint32_t last_used;
 };
 
 struct EmbeddedFontEntry {
@@ -91,6 +125,14 @@ struct EmbeddedFontEntry {
     uint8_t* font_data;    // heap-allocated font data (must persist for stb_truetype)
 };
 
+// A font resource, resolved once per document (see font_get)
+struct PdfFont {
+    int obj_num;            // font dictionary object number
+    uint8_t flags;          // bit 0: bold, bit 1: italic, bit 2: mono
+    uint16_t* tounicode;    // glyph ID -> Unicode codepoint (256 entries), or nullptr
+    TrueTypeFont* embedded_font; // owned by emb_fonts, or nullptr
+};
+
 struct PdfDoc {
     uint8_t* data;
     int data_len;
@@ -108,13 +150,26 @@ struct PdfDoc {
     EmbeddedFontEntry* emb_fonts; // cached embedded fonts
     int emb_font_count;
 
+    PdfFont* fonts;     // cached font resources, by object number
+    int font_count;
+    int font_cap;
+
     bool valid;
 };
 
+// A stream read front to back, decoding as it goes (see stream_open)
+struct Inflater;
+struct PdfStream {
+    const uint8_t* data;   // decoded bytes available so far, data[0, len)
+    int len;
+    bool complete;         // len reaches the end of the stream
+    Inflater* inf;         // nullptr if the stream is not compressed
+};
+
 struct FontInfo {
     char name[32];      // PDF font name (e.g., "F1")
     uint8_t flags;      // bit 0: bold, bit 1: italic, bit 2: mono
-    uint16_t* tounicode; // glyph ID -> Unicode codepoint (256 entries), heap-allocated
+    uint16_t* tounicode; // glyph ID -> Unicode codepoint, shared with g_doc.fonts
     TrueTypeFont* embedded_font; // loaded from PDF font stream, or nullptr
 };
 
@@ -155,7 +210,8 @@ void px_hline(uint32_t* px, int bw, int bh, int x, int y, int w, Color c);
 void px_vline(uint32_t* px, int bw, int bh, int x, int y, int h, Color c);
 void px_rect(uint32_t* px, int bw, int bh, int x, int y, int w, int h, Color c);
 void px_fill_rounded(uint32_t* px, int bw, int bh, int x, int y, int w, int h, int r, Color c);
-void px_line(uint32_t* px, int bw, int bh, int x0, int y0, int x1, int y1, int thick, Color c);
+void px_line(uint32_t* px, int bw, int bh, int x0, int y0, int x1, int y1, int thick, Color c,
+             CoverageRaster& raster);
 int  str_len(const char* s);
 void str_cpy(char* dst, const char* src, int max);
 
@@ -175,6 +231,9 @@ int  dict_lookup(const uint8_t* d, int len, int pos, const char* key);
 int  parse_ref_at(const uint8_t* d, int len, int p, int* obj_num);
 int  find_obj_content(int obj_num, int* start, int* end);
 uint8_t* get_stream_data(int obj_num, int* out_len);
+bool stream_open(int obj_num, PdfStream* s);
+void stream_fill(PdfStream* s, int* pos, int want);
+void stream_close(PdfStream* s);
 void build_font_map(int page_obj_num, FontMap* out);
 
 // ============================================================================
@@ -188,3 +247,26 @@ void parse_page(int page_idx, int page_obj_num);
 // ============================================================================
 
 void render(uint32_t* pixels);
+bool page_layout(PdfPage* page, float zoom);
+void page_layout_free(PdfPage* page);
+void draw_page(uint32_t* px, int bw, int bh, const PdfPage* page,
+               int page_x, int page_y, int clip_y0, int clip_y1, CoverageRaster& raster);
+
+// ============================================================================
+// page_cache.cpp
+// ============================================================================
+
+PdfPage* page_get(int idx);
+bool page_prefetch();
+void page_cache_clear();
+void page_cache_pressure(uint32_t level);
+
+// ============================================================================
+// tiles.cpp
+// ============================================================================
+
+bool tiles_render(int idx, int x0, int y0, int x1, int y1);
+bool tiles_ready(int idx, int x0, int y0, int x1, int y1);
+const PageTile* tile_find(int idx, int tx, int ty);
+void tiles_clear(int keep_page);
+void tiles_shutdown();
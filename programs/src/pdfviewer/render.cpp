@@ -6,6 +6,234 @@
 
 #include "pdfviewer.h"
 
+// The font a text item is drawn in: its embedded one, else a system font
+static TrueTypeFont* item_font(const TextItem* item) {
+    if (item->font) return item->font;
+    TrueTypeFont* font = g_font;
+    if ((item->flags & 1) && g_font_bold) font = g_font_bold;
+    if ((item->flags & 4) && g_font_mono) font = g_font_mono;
+    return font;
+}
+
+void page_layout_free(PdfPage* page) {
+    PageText* t = page->text;
+    if (!t) return;
+    if (t->glyphs) montauk::mfree(t->glyphs);
+    if (t->bitmaps) montauk::mfree(t->bitmaps);
+    if (t->placed) montauk::mfree(t->placed);
+    montauk::mfree(t);
+    page->text = nullptr;
+}
+
+// Lay out the page's text at `zoom` for draw_page: every glyph placed in
+// page pixels, each distinct one rasterized once and copied out of the
+// glyph atlas. Runs on the UI thread, the only one that uses the font
+// caches. False if out of memory.
+bool page_layout(PdfPage* page, float zoom) {
+    if (page->text && page->text->zoom == zoom) return true;
+    page_layout_free(page);
+
+    int chars = 0;
+    for (int i = 0; i < page->item_count; i++)
+        chars += str_len(page->items[i].text);
+
+    // Glyphs are told apart by font, size and character, through an open
+    // addressing table at most half full
+    struct GlyphKey {
+        TrueTypeFont* font;
+        int size;
+        int ch;
+        int glyph;      // index in t->glyphs, or -1 if the font has none
+    };
+    int slots = 16;
+    while (slots < chars * 2) slots <<= 1;
+
+    PageText* t = (PageText*)montauk::malloc(sizeof(PageText));
+    GlyphKey* keys = (GlyphKey*)montauk::malloc(chars * sizeof(GlyphKey) + 1);
+    int* table = (int*)montauk::malloc(slots * sizeof(int));
+    if (t) montauk::memset(t, 0, sizeof(PageText));
+    if (t && chars > 0) {
+        t->glyphs = (CachedGlyph*)montauk::malloc(chars * sizeof(CachedGlyph));
+        t->placed = (PlacedGlyph*)montauk::malloc(chars * sizeof(PlacedGlyph));
+    }
+    page->text = t;
+    if (!t || !keys || !table || (chars > 0 && (!t->glyphs || !t->placed))) {
+        if (keys) montauk::mfree(keys);
+        if (table) montauk::mfree(table);
+        page_layout_free(page);
+        return false;
+    }
+    t->zoom = zoom;
+    for (int i = 0; i < slots; i++) table[i] = -1;
+
+    int key_count = 0;
+    uint64_t bitmap_used = 0, bitmap_cap = 0;
+    bool ok = true;
+    for (int i = 0; i < page->item_count && ok; i++) {
+        const TextItem* item = &page->items[i];
+        TrueTypeFont* font = item_font(item);
+        if (!font || !font->valid) continue;
+
+        int px_size = (int)(item->font_size * zoom + 0.5f);
+        if (px_size < 4) px_size = 4;
+        if (px_size > 120) px_size = 120;
+        GlyphCache* gc = font->get_cache(px_size);
+
+        // PDF: origin bottom-left, y up, and positions are baselines
+        int pen = (int)(item->x * zoom);
+        int baseline = (int)((page->height - item->y) * zoom);
+
+        for (int j = 0; item->text[j] && ok; j++) {
+            // Embedded fonts take the raw character codes (subset fonts
+            // use codes 0-N that map through the font's cmap); system
+            // fonts only printable ASCII
+            int ch = (unsigned char)item->text[j];
+            if (!item->font) {
+                if (ch == '\t') ch = ' ';
+                else if (ch < 32 || ch >= 127) continue;
+            }
+
+            uint32_t h = ((uint32_t)(uintptr_t)font * 0x9E3779B1u) ^ ((uint32_t)px_size * 0x85EBCA77u)
+                       ^ ((uint32_t)ch * 0xC2B2AE3Du);
+            int slot = (int)((h ^ (h >> 15)) & (uint32_t)(slots - 1));
+            while (table[slot] >= 0) {
+                const GlyphKey* k = &keys[table[slot]];
+                if (k->font == font && k->size == px_size && k->ch == ch) break;
+                slot = (slot + 1) & (slots - 1);
+            }
+
+            if (table[slot] < 0) {
+                GlyphKey* k = &keys[key_count];
+                k->font = font;
+                k->size = px_size;
+                k->ch = ch;
+                k->glyph = -1;
+
+                // The atlas may drop this glyph on the next lookup: copy now
+                CachedGlyph* g = font->get_glyph(gc, ch);
+                if (g) {
+                    uint64_t bytes = (uint64_t)g->width * g->height;
+                    if (g->bitmap && bitmap_used + bytes > bitmap_cap) {
+                        uint64_t cap = bitmap_cap ? bitmap_cap * 2 : 64 * 1024;
+                        while (cap < bitmap_used + bytes) cap *= 2;
+                        uint8_t* grown = (uint8_t*)montauk::realloc(t->bitmaps, cap);
+                        if (!grown) {
+                            ok = false;
+                            break;
+                        }
+                        t->bitmaps = grown;
+                        bitmap_cap = cap;
+                    }
+
+                    // Bitmaps hold offsets until the buffer stops moving
+                    CachedGlyph* copy = &t->glyphs[t->glyph_count];
+                    *copy = *g;
+                    copy->stride = g->width;
+                    copy->bitmap = g->bitmap ? (uint8_t*)(uintptr_t)(bitmap_used + 1) : nullptr;
+                    if (g->bitmap) {
+                        for (int row = 0; row < g->height; row++)
+                            montauk::memcpy(t->bitmaps + bitmap_used + (uint64_t)row * g->width,
+                                            g->bitmap + row * g->stride, g->width);
+                        bitmap_used += bytes;
+                    }
+                    k->glyph = t->glyph_count++;
+                }
+                table[slot] = key_count++;
+            }
+
+            int gi = keys[table[slot]].glyph;
+            if (gi < 0) continue;
+            const CachedGlyph* g = &t->glyphs[gi];
+            if (g->bitmap) {
+                PlacedGlyph* p = &t->placed[t->placed_count++];
+                p->x = pen + g->xoff;
+                p->y = baseline + g->yoff;
+                p->glyph = g;
+            }
+            pen += g->advance;
+        }
+    }
+
+    montauk::mfree(keys);
+    montauk::mfree(table);
+    if (!ok) {
+        page_layout_free(page);
+        return false;
+    }
+    for (int i = 0; i < t->glyph_count; i++) {
+        CachedGlyph* g = &t->glyphs[i];
+        if (g->bitmap) g->bitmap = t->bitmaps + ((uintptr_t)g->bitmap - 1);
+    }
+    return true;
+}
+
+// Draw a page's contents at the current zoom with its top-left corner at
+// (page_x, page_y), touching only rows clip_y0 to clip_y1. The text is
+// what page_layout left, so this reads nothing any other thread writes
+// and tile workers can run it side by side, each with its own `raster`.
+void draw_page(uint32_t* px, int bw, int bh, const PdfPage* page,
+               int page_x, int page_y, int clip_y0, int clip_y1, CoverageRaster& raster) {
+    int page_w = (int)(page->width * g_zoom);
+    int page_h = (int)(page->height * g_zoom);
+
+    // Draw white page
+    for (int row = page_y; row < page_y + page_h; row++) {
+        if (row < clip_y0 || row >= clip_y1) continue;
+        int x0 = page_x < 0 ? 0 : page_x;
+        int x1 = page_x + page_w;
+        if (x1 > bw) x1 = bw;
+        uint32_t white = PAGE_COLOR.to_pixel();
+        for (int col = x0; col < x1; col++)
+            px[row * bw + col] = white;
+    }
+
+    // Draw graphics items (lines, filled rectangles)
+    for (int i = 0; i < page->gfx_count; i++) {
+        GraphicsItem* gi = &page->gfx_items[i];
+        Color gfx_color = Color::from_rgb(gi->r, gi->g, gi->b);
+
+        if (gi->type == GFX_RECT_FILL) {
+            // gi->x1,y1 = rect origin (PDF coords), gi->x2,y2 = width,height
+            int rx = page_x + (int)(gi->x1 * g_zoom);
+            int ry = page_y + (int)((page->height - gi->y1 - gi->y2) * g_zoom);
+            int rw = (int)(gi->x2 * g_zoom);
+            int rh = (int)(gi->y2 * g_zoom);
+            if (rw < 0) { rx += rw; rw = -rw; }
+            if (rh < 0) { ry += rh; rh = -rh; }
+            // Clip to content area
+            if (ry + rh > clip_y0 && ry < clip_y1)
+                px_fill(px, bw, bh, rx, ry, rw, rh, gfx_color);
+        } else {
+            // GFX_LINE or GFX_RECT_STROKE
+            int lx0 = page_x + (int)(gi->x1 * g_zoom);
+            int ly0 = page_y + (int)((page->height - gi->y1) * g_zoom);
+            int lx1 = page_x + (int)(gi->x2 * g_zoom);
+            int ly1 = page_y + (int)((page->height - gi->y2) * g_zoom);
+            int lw = (int)(gi->line_width * g_zoom + 0.5f);
+            if (lw < 1) lw = 1;
+            // Basic clip check
+            int min_y = ly0 < ly1 ? ly0 : ly1;
+            int max_y = ly0 > ly1 ? ly0 : ly1;
+            if (max_y + lw >= clip_y0 && min_y - lw < clip_y1)
+                px_line(px, bw, bh, lx0, ly0, lx1, ly1, lw, gfx_color, raster);
+        }
+    }
+
+    // Draw text, glyph by glyph
+    const PageText* text = page->text;
+    if (!text) return;
+    int y0 = clip_y0 > 0 ? clip_y0 : 0;
+    int y1 = clip_y1 < bh ? clip_y1 : bh;
+    for (int i = 0; i < text->placed_count; i++) {
+        const PlacedGlyph* p = &text->placed[i];
+        int gx = page_x + p->x;
+        int gy = page_y + p->y;
+        if (gy >= y1 || gy + p->glyph->height <= y0 || gx >= bw || gx + p->glyph->width <= 0)
+            continue;
+        TrueTypeFont::blit_glyph(px, bw, gx, gy, p->glyph, TEXT_COLOR, 0, y0, bw, y1);
+    }
+}
+
 void render(uint32_t* pixels) {
     // ---- Background ----
     px_fill(pixels, g_win_w, g_win_h, 0, 0, g_win_w, g_win_h, BG_COLOR);
@@ -18,7 +246,7 @@ void render(uint32_t* pixels) {
     int content_h = g_win_h - content_y - STATUS_BAR_H;
 
     if (g_doc.valid && g_current_page >= 0 && g_current_page < g_doc.page_count) {
-        PdfPage* page = &g_doc.pages[g_current_page];
+        PdfPage* page = page_get(g_current_page);
 
         int page_w = (int)(page->width * g_zoom);
         int page_h = (int)(page->height * g_zoom);
@@ -37,107 +265,34 @@ void render(uint32_t* pixels) {
         int clip_y0 = content_y;
         int clip_y1 = content_y + content_h;
 
-        // Draw white page
-        for (int row = page_y; row < page_y + page_h; row++) {
-            if (row < clip_y0 || row >= clip_y1) continue;
-            int x0 = page_x < 0 ? 0 : page_x;
-            int x1 = page_x + page_w;
-            if (x1 > g_win_w) x1 = g_win_w;
-            uint32_t white = PAGE_COLOR.to_pixel();
-            for (int col = x0; col < x1; col++)
-                pixels[row * g_win_w + col] = white;
-        }
-
-        // Draw graphics items (lines, filled rectangles)
-        for (int i = 0; i < page->gfx_count; i++) {
-            GraphicsItem* gi = &page->gfx_items[i];
-            Color gfx_color = Color::from_rgb(gi->r, gi->g, gi->b);
-
-            if (gi->type == GFX_RECT_FILL) {
-                // gi->x1,y1 = rect origin (PDF coords), gi->x2,y2 = width,height
-                int rx = page_x + (int)(gi->x1 * g_zoom);
-                int ry = page_y + (int)((page->height - gi->y1 - gi->y2) * g_zoom);
-                int rw = (int)(gi->x2 * g_zoom);
-                int rh = (int)(gi->y2 * g_zoom);
-                if (rw < 0) { rx += rw; rw = -rw; }
-                if (rh < 0) { ry += rh; rh = -rh; }
-                // Clip to content area
-                if (ry + rh > clip_y0 && ry < clip_y1)
-                    px_fill(pixels, g_win_w, g_win_h, rx, ry, rw, rh, gfx_color);
-            } else {
-                // GFX_LINE or GFX_RECT_STROKE
-                int lx0 = page_x + (int)(gi->x1 * g_zoom);
-                int ly0 = page_y + (int)((page->height - gi->y1) * g_zoom);
-                int lx1 = page_x + (int)(gi->x2 * g_zoom);
-                int ly1 = page_y + (int)((page->height - gi->y2) * g_zoom);
-                int lw = (int)(gi->line_width * g_zoom + 0.5f);
-                if (lw < 1) lw = 1;
-                // Basic clip check
-                int min_y = ly0 < ly1 ? ly0 : ly1;
-                int max_y = ly0 > ly1 ? ly0 : ly1;
-                if (max_y + lw >= clip_y0 && min_y - lw < clip_y1)
-                    px_line(pixels, g_win_w, g_win_h, lx0, ly0, lx1, ly1, lw, gfx_color);
-            }
-        }
-
-        // Draw text items
-        for (int i = 0; i < page->item_count; i++) {
-            TextItem* item = &page->items[i];
-
-            // Convert PDF coords to screen coords
-            // PDF: origin bottom-left, y up
-            // Screen: origin top-left, y down
-            int sx = page_x + (int)(item->x * g_zoom);
-            int sy = page_y + (int)((page->height - item->y) * g_zoom);
-
-            // Skip if outside visible area
-            if (sy < clip_y0 - 30 || sy > clip_y1) continue;
-
-            // Choose font: prefer embedded, fall back to system fonts
-            TrueTypeFont* font = item->font;
-            if (!font) {
-                font = g_font;
-                if ((item->flags & 1) && g_font_bold) font = g_font_bold;
-                if ((item->flags & 4) && g_font_mono) font = g_font_mono;
-            }
-            if (!font) continue;
-
-            // Scale font size
-            int px_size = (int)(item->font_size * g_zoom + 0.5f);
-            if (px_size < 4) px_size = 4;
-            if (px_size > 120) px_size = 120;
-
-            // draw_to_buffer treats y as top of text box, but PDF
-            // specifies the baseline.  Subtract ascent so the rendered
-            // baseline lands at the correct position.
-            GlyphCache* gc = font->get_cache(px_size);
-            int baseline_adj = gc ? gc->ascent : (int)(px_size * 0.8f);
-            int ty = sy - baseline_adj;
-
-            if (item->font) {
-                // Embedded font: pass raw character codes directly
-                // (subset fonts use codes 0-N that map through the font's cmap)
-                font->draw_to_buffer(pixels, g_win_w, g_win_h,
-                    sx, ty, item->text, TEXT_COLOR, px_size);
-            } else {
-                // System font: filter out non-printable characters
-                char render_text[MAX_TEXT_LEN];
-                int ri = 0;
-                for (int j = 0; item->text[j] && ri < MAX_TEXT_LEN - 1; j++) {
-                    char c = item->text[j];
-                    if (c >= 32 && c < 127) {
-                        render_text[ri++] = c;
-                    } else if (c == '\t') {
-                        render_text[ri++] = ' ';
-                    }
-                }
-                render_text[ri] = '\0';
-
-                if (ri > 0) {
-                    font->draw_to_buffer(pixels, g_win_w, g_win_h,
-                        sx, ty, render_text, TEXT_COLOR, px_size);
+        // Page contents, from tiles when the cache has room for the
+        // visible ones, else drawn straight to the window
+        int x0 = page_x > 0 ? page_x : 0;
+        int x1 = page_x + page_w < g_win_w ? page_x + page_w : g_win_w;
+        int y0 = page_y > clip_y0 ? page_y : clip_y0;
+        int y1 = page_y + page_h < clip_y1 ? page_y + page_h : clip_y1;
+        if (x1 <= x0 || y1 <= y0) {
+            // Scrolled out of view
+        } else if (tiles_render(g_current_page, x0 - page_x, y0 - page_y, x1 - page_x, y1 - page_y)) {
+            for (int ty = (y0 - page_y) / TILE_SIZE; ty <= (y1 - 1 - page_y) / TILE_SIZE; ty++) {
+                for (int tx = (x0 - page_x) / TILE_SIZE; tx <= (x1 - 1 - page_x) / TILE_SIZE; tx++) {
+                    const PageTile* tile = tile_find(g_current_page, tx, ty);
+                    if (!tile) continue;
+                    int left = page_x + tx * TILE_SIZE, top = page_y + ty * TILE_SIZE;
+                    int cx0 = left > x0 ? left : x0;
+                    int cx1 = left + TILE_SIZE < x1 ? left + TILE_SIZE : x1;
+                    int cy0 = top > y0 ? top : y0;
+                    int cy1 = top + TILE_SIZE < y1 ? top + TILE_SIZE : y1;
+                    for (int row = cy0; row < cy1; row++)
+                        montauk::memcpy(pixels + row * g_win_w + cx0,
+                                        tile->px + (row - top) * TILE_SIZE + (cx0 - left),
+                                        (uint64_t)(cx1 - cx0) * 4);
                 }
             }
+        } else {
+            static CoverageRaster raster = {};
+            page_layout(page, g_zoom);
+            draw_page(pixels, g_win_w, g_win_h, page, page_x, page_y, clip_y0, clip_y1, raster);
         }
 
         // Page border
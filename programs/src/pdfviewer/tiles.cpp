@@ -0,0 +1,233 @@
+/*
+ * tiles.cpp
+ * Rendered-tile cache, and drawing tiles across worker threads
+ * Copyright (c) 2026 Daniel Hammer
+ */
+
+#include "pdfviewer.h"
+#include <montauk/sync.h>
+
+// Pages are rendered as TILE_SIZE squares, kept per zoom level, least
+// recently used evicted first. Scrolling only draws the rows of tiles it
+// uncovers, and zooming back finds the old level's tiles still there.
+// TILE_CACHE_MAX tiles of 256 KiB make a 32 MiB budget.
+static constexpr int TILE_CACHE_MAX = 128;
+static constexpr int TILE_MAX_WORKERS = 7;
+
+static PageTile g_tiles[TILE_CACHE_MAX];
+static uint32_t g_tile_clock = 0;
+
+// The missing tiles of one tiles_render call are handed out one at a
+// time to the workers and the UI thread, which waits for the last of
+// them. They all draw from the page's display list and text layout,
+// which nobody changes until the batch is done.
+struct TileJob {
+    montauk::Mutex lock;
+    montauk::CondVar work;      // tiles to take, or stop
+    montauk::CondVar done;      // the last tile of the batch was drawn
+
+    const PdfPage* page;
+    PageTile** tiles;
+    int count;
+    int next;
+    int finished;
+    bool stop;
+};
+
+static TileJob g_job;
+static int g_workers[TILE_MAX_WORKERS];
+static int g_worker_count = 0;
+static bool g_workers_started = false;
+static CoverageRaster g_ui_raster = {};
+
+// Mark every slot free the first time the cache is used
+static void tiles_init() {
+    static bool ready = false;
+    if (ready) return;
+    for (int i = 0; i < TILE_CACHE_MAX; i++) {
+        g_tiles[i].px = nullptr;
+        g_tiles[i].page = -1;
+    }
+    ready = true;
+}
+
+static PageTile* find(int idx, int tx, int ty) {
+    for (int i = 0; i < TILE_CACHE_MAX; i++) {
+        PageTile* t = &g_tiles[i];
+        if (t->page == idx && t->zoom == g_zoom && t->tx == tx && t->ty == ty && t->px)
+            return t;
+    }
+    return nullptr;
+}
+
+// Take tiles of the batch until none are left. Called with g_job.lock held.
+static void run_tiles(CoverageRaster& raster) {
+    while (g_job.next < g_job.count) {
+        PageTile* t = g_job.tiles[g_job.next++];
+        const PdfPage* page = g_job.page;
+        g_job.lock.unlock();
+
+        draw_page(t->px, TILE_SIZE, TILE_SIZE, page, -t->tx * TILE_SIZE, -t->ty * TILE_SIZE,
+                  0, TILE_SIZE, raster);
+
+        g_job.lock.lock();
+        if (++g_job.finished == g_job.count) g_job.done.broadcast();
+    }
+}
+
+static int tile_worker(void*) {
+    CoverageRaster raster = {};
+    g_job.lock.lock();
+    while (!g_job.stop) {
+        if (g_job.next >= g_job.count) {
+            g_job.work.wait(g_job.lock);
+            continue;
+        }
+        run_tiles(raster);
+    }
+    g_job.lock.unlock();
+    raster.release();
+    return 0;
+}
+
+// One worker per CPU besides the UI thread's; with a single CPU the UI
+// thread draws every tile itself
+static void start_workers() {
+    if (g_workers_started) return;
+    g_workers_started = true;
+
+    int cpus = __builtin_popcountll(montauk::get_affinity(-1));
+    int workers = cpus - 1;
+    if (workers > TILE_MAX_WORKERS) workers = TILE_MAX_WORKERS;
+    for (int i = 0; i < workers; i++) {
+        int tid = montauk::thread_create(tile_worker);
+        if (tid < 0) break;
+        g_workers[g_worker_count++] = tid;
+    }
+}
+
+void tiles_shutdown() {
+    if (!g_workers_started) return;
+    g_job.lock.lock();
+    g_job.stop = true;
+    g_job.work.broadcast();
+    g_job.lock.unlock();
+    for (int i = 0; i < g_worker_count; i++)
+        montauk::thread_join(g_workers[i]);
+    g_worker_count = 0;
+    g_workers_started = false;
+    g_ui_raster.release();
+}
+
+// Clamp [x0, x1) x [y0, y1), in page pixels at the current zoom, to the
+// page and turn it into a range of tiles. False if nothing is left.
+static bool tile_range(int idx, int x0, int y0, int x1, int y1,
+                       int* tx0, int* ty0, int* tx1, int* ty1) {
+    const PdfPage* page = &g_doc.pages[idx];
+    int page_w = (int)(page->width * g_zoom);
+    int page_h = (int)(page->height * g_zoom);
+    if (x0 < 0) x0 = 0;
+    if (y0 < 0) y0 = 0;
+    if (x1 > page_w) x1 = page_w;
+    if (y1 > page_h) y1 = page_h;
+    if (x1 <= x0 || y1 <= y0) return false;
+    *tx0 = x0 / TILE_SIZE;
+    *ty0 = y0 / TILE_SIZE;
+    *tx1 = (x1 - 1) / TILE_SIZE;
+    *ty1 = (y1 - 1) / TILE_SIZE;
+    return true;
+}
+
+bool tiles_ready(int idx, int x0, int y0, int x1, int y1) {
+    tiles_init();
+    int tx0, ty0, tx1, ty1;
+    if (!tile_range(idx, x0, y0, x1, y1, &tx0, &ty0, &tx1, &ty1)) return true;
+    for (int ty = ty0; ty <= ty1; ty++)
+        for (int tx = tx0; tx <= tx1; tx++)
+            if (!find(idx, tx, ty)) return false;
+    return true;
+}
+
+const PageTile* tile_find(int idx, int tx, int ty) {
+    tiles_init();
+    return find(idx, tx, ty);
+}
+
+// Make sure the tiles covering [x0, x1) x [y0, y1) of page `idx`, in page
+// pixels at the current zoom, are in the cache, drawing the missing ones
+// in parallel. False if they do not all fit in it at once.
+bool tiles_render(int idx, int x0, int y0, int x1, int y1) {
+    tiles_init();
+    int tx0, ty0, tx1, ty1;
+    if (!tile_range(idx, x0, y0, x1, y1, &tx0, &ty0, &tx1, &ty1)) return true;
+    if ((tx1 - tx0 + 1) * (ty1 - ty0 + 1) > TILE_CACHE_MAX) return false;
+
+    // Tiles stamped with this call's clock are needed and not evicted
+    uint32_t stamp = ++g_tile_clock;
+    PageTile* missing[TILE_CACHE_MAX];
+    int count = 0;
+    for (int ty = ty0; ty <= ty1; ty++) {
+        for (int tx = tx0; tx <= tx1; tx++) {
+            PageTile* t = find(idx, tx, ty);
+            if (t) {
+                t->last_used = stamp;
+                continue;
+            }
+
+            PageTile* slot = nullptr;
+            for (int i = 0; i < TILE_CACHE_MAX; i++) {
+                PageTile* c = &g_tiles[i];
+                if (c->last_used == stamp) continue;
+                if (!slot || c->page < 0 || (slot->page >= 0 && c->last_used < slot->last_used))
+                    slot = c;
+                if (slot->page < 0) break;
+            }
+            if (!slot->px) slot->px = (uint32_t*)montauk::malloc((uint64_t)TILE_SIZE * TILE_SIZE * 4);
+            if (!slot->px) {
+                for (int i = 0; i < count; i++) missing[i]->page = -1;
+                return false;
+            }
+            slot->page = idx;
+            slot->zoom = g_zoom;
+            slot->tx = tx;
+            slot->ty = ty;
+            slot->last_used = stamp;
+            missing[count++] = slot;
+        }
+    }
+    if (count == 0) return true;
+
+    PdfPage* page = page_get(idx);
+    if (!page_layout(page, g_zoom)) {
+        for (int i = 0; i < count; i++) missing[i]->page = -1;
+        return false;
+    }
+
+    start_workers();
+    g_job.lock.lock();
+    g_job.page = page;
+    g_job.tiles = missing;
+    g_job.count = count;
+    g_job.next = 0;
+    g_job.finished = 0;
+    if (g_worker_count > 0 && count > 1) g_job.work.broadcast();
+    run_tiles(g_ui_raster);
+    while (g_job.finished < g_job.count) g_job.done.wait(g_job.lock);
+    g_job.count = 0;
+    g_job.next = 0;
+    g_job.lock.unlock();
+    return true;
+}
+
+// Drop the tiles of every page but `keep_page` (-1 for all), giving their
+// memory back
+void tiles_clear(int keep_page) {
+    tiles_init();
+    for (int i = 0; i < TILE_CACHE_MAX; i++) {
+        PageTile* t = &g_tiles[i];
+        if (t->page == keep_page && keep_page >= 0) continue;
+        if (t->px) montauk::mfree(t->px);
+        t->px = nullptr;
+        t->page = -1;
+    }
+}
@@ -0,0 +1,171 @@
+/*
+    * main.cpp
+    * perfstat - Count hardware events while a command runs
+    * Copyright (c) 2026 Daniel Hammer
+*/
+
+#include <montauk/syscall.h>
+#include <montauk/string.h>
+#include <montauk/args.h>
+
+using Montauk::PerfCounts;
+
+static const char* const g_events[Montauk::PERF_MAX_EVENTS] = {
+    "cycles", "instructions", "LLC misses", "branch misses", "dTLB misses"
+};
+
+static void print_int(uint64_t n) {
+    if (n == 0) {
+        montauk::putchar('0');
+        return;
+    }
+    char buf[20];
+    int i = 0;
+    while (n > 0) {
+        buf[i++] = '0' + (n % 10);
+        n /= 10;
+    }
+    for (int j = i - 1; j >= 0; j--) {
+        montauk::putchar(buf[j]);
+    }
+}
+
+static int digits(uint64_t n) {
+    int d = 1;
+    while (n >= 10) {
+        n /= 10;
+        d++;
+    }
+    return d;
+}
+
+static void pad(int n) {
+    for (int i = 0; i < n; i++) montauk::putchar(' ');
+}
+
+// num / den with two decimals
+static void print_ratio(uint64_t num, uint64_t den) {
+    uint64_t hundredths = num * 100 / den;
+    print_int(hundredths / 100);
+    montauk::putchar('.');
+    montauk::putchar('0' + (hundredths / 10) % 10);
+    montauk::putchar('0' + hundredths % 10);
+}
+
+static void usage() {
+    montauk::print("usage: perfstat [-u] command [args]\n");
+    montauk::exit(1);
+}
+
+extern "C" void _start() {
+    char args[512];
+    montauk::getargs(args, sizeof(args));
+
+    uint32_t flags = Montauk::PERF_INHERIT;
+    char command[256] = "";
+    const char* commandArgs = nullptr;
+
+    const char* p = args;
+    char w[256];
+    while (true) {
+        const char* rest = montauk::next_word(p, w, sizeof(w));
+        if (w[0] == '\0') break;
+        if (montauk::streq(w, "-u")) {
+            flags |= Montauk::PERF_USER_ONLY;
+            p = rest;
+        } else if (w[0] == '-') {
+            usage();
+        } else {
+            montauk::strcpy(command, w);
+            commandArgs = montauk::skip_spaces(rest);
+            if (*commandArgs == '\0') commandArgs = nullptr;
+            break;
+        }
+    }
+    if (command[0] == '\0') usage();
+
+    char path[300];
+    bool direct = false;
+    for (int i = 0; command[i]; i++) {
+        if (command[i] == '/' || command[i] == ':') direct = true;
+    }
+    if (direct) {
+        montauk::strcpy(path, command);
+    } else {
+        montauk::strcpy(path, "0:/os/");
+        montauk::strcpy(path + 6, command);
+        montauk::strcpy(path + 6 + montauk::slen(command), ".elf");
+    }
+
+    // Only the child is of interest: our own counts are left out, and
+    // the child inherits the counters at spawn
+    int counted = montauk::perf_ctl(Montauk::PERF_ALL, flags);
+    if (counted < 0) {
+        montauk::print("perfstat: no performance counters on this CPU\n");
+        montauk::exit(1);
+    }
+
+    uint64_t start = montauk::get_milliseconds();
+    int pid = montauk::spawn(path, commandArgs);
+    if (pid < 0) {
+        montauk::perf_ctl(0);
+        montauk::print("perfstat: cannot run ");
+        montauk::print(path);
+        montauk::print("\n");
+        montauk::exit(1);
+    }
+    montauk::waitpid(pid);
+    uint64_t elapsed = montauk::get_milliseconds() - start;
+
+    PerfCounts counts;
+    montauk::perf_read(&counts);
+    montauk::perf_ctl(0);
+    const uint64_t* c = counts.children;
+
+    montauk::print("\nPerformance counters for '");
+    montauk::print(command);
+    if (commandArgs) {
+        montauk::putchar(' ');
+        montauk::print(commandArgs);
+    }
+    montauk::print(flags & Montauk::PERF_USER_ONLY ? "' (user):\n\n" : "':\n\n");
+
+    for (int e = 0; e < Montauk::PERF_MAX_EVENTS; e++) {
+        if (!(counted & (1u << e))) {
+            pad(16 - 11);
+            montauk::print("not counted  ");
+            montauk::print(g_events[e]);
+            montauk::putchar('\n');
+            continue;
+        }
+
+        pad(16 - digits(c[e]));
+        print_int(c[e]);
+        montauk::print("  ");
+        montauk::print(g_events[e]);
+        pad(16 - montauk::slen(g_events[e]));
+
+        uint64_t cycles = c[0], instructions = c[1];
+        bool haveCycles = (counted & Montauk::PERF_CYCLES) && cycles > 0;
+        bool haveInstructions = (counted & Montauk::PERF_INSTRUCTIONS) && instructions > 0;
+        if (e == 1 && haveCycles) {
+            print_ratio(instructions, cycles);
+            montauk::print(" per cycle");
+        } else if (e >= 2 && haveInstructions) {
+            print_ratio(c[e] * 1000, instructions);
+            montauk::print(" per 1000 instructions");
+        }
+        montauk::putchar('\n');
+    }
+
+    montauk::putchar('\n');
+    pad(16 - digits(elapsed / 1000) - 4);
+    print_int(elapsed / 1000);
+    montauk::putchar('.');
+    montauk::putchar('0' + (elapsed / 100) % 10);
+    montauk::putchar('0' + (elapsed / 10) % 10);
+    montauk::putchar('0' + elapsed % 10);
+    montauk::print("  seconds elapsed\n");
+
+    montauk::exit(0);
+}
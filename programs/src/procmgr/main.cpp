@@ -11,6 +11,7 @@
 #include <gui/canvas.hpp>
 #include <gui/standalone.hpp>
 #include <gui/truetype.hpp>
+#include <gui/widgets.hpp>
 
 extern "C" {
 #include <stdio.h>
@@ -18,14 +19,17 @@ extern "C" {
 
 using namespace gui;
 
-static constexpr int INIT_W          = 620;
-static constexpr int INIT_H          = 420;
+static constexpr int INIT_W          = 720;
+static constexpr int INIT_H          = 480;
 static constexpr int PM_TOOLBAR_H    = 36;
 static constexpr int PM_TAB_H        = 32;
 static constexpr int PM_HEADER_H     = 24;
 static constexpr int PM_ITEM_H       = 28;
+static constexpr int PM_DETAIL_H     = 84;
+static constexpr int PM_HIST         = 28;    // Samples per sparkline, one per poll
+static constexpr int PM_SPARK_W      = PM_HIST * 2;
 static constexpr int PM_POLL_MS      = 1000;
-static constexpr int PM_MAX_PROCS    = 256;
+static constexpr int PM_MAX_PROCS    = 1024;
 static constexpr int PM_MAX_WINDOWS  = 64;
 static constexpr int FONT_SIZE       = 18;
 
@@ -38,6 +42,9 @@ static constexpr Color PM_WARNING    = Color::from_rgb(0xCC, 0x88, 0x00);
 static constexpr Color PM_DANGER     = Color::from_rgb(0xCC, 0x33, 0x33);
 static constexpr Color PM_INFO       = Color::from_rgb(0x33, 0x66, 0xCC);
 
+static constexpr Color PM_SPARK_CPU  = Color::from_rgb(0x33, 0x66, 0xCC);
+static constexpr Color PM_SPARK_MEM  = Color::from_rgb(0x88, 0x44, 0xAA);
+
 enum ProcMgrTab {
     PM_TAB_PROCESSES = 0,
     PM_TAB_WINDOWS   = 1,
@@ -49,16 +56,37 @@ static const char* g_tab_labels[PM_TAB_COUNT] = {
     "Windows",
 };
 
+enum ProcSortColumn {
+    PM_SORT_PID,
+    PM_SORT_NAME,
+    PM_SORT_CPU,
+    PM_SORT_MEM,
+    PM_SORT_THREADS,
+    PM_SORT_SWITCHES,
+    PM_SORT_STATE,
+};
+
+// A process and what was seen of it over the last polls
+struct ProcRow {
+    Montauk::ProcInfo info;
+    uint32_t cpu_tenths;                 // CPU% x10 over the last poll, 1000 = one core
+    uint32_t switch_rate;                // Context switches per second over the last poll
+    uint16_t cpu_hist[PM_HIST];          // cpu_tenths, oldest first
+    uint32_t mem_hist[PM_HIST];          // mem_pages(), oldest first
+};
+
 struct ProcMgrState {
-    Montauk::ProcInfo procs[PM_MAX_PROCS];
+    ProcRow procs[PM_MAX_PROCS];
     Montauk::WinInfo windows[PM_MAX_WINDOWS];
     int proc_count;
     int win_count;
     int selected;
     int selected_window;
-    int proc_scroll;
-    int win_scroll;
+    VirtualList proc_list;
+    VirtualList win_list;
     int active_tab;
+    int sort_column;
+    bool sort_desc;
     uint64_t last_poll_ms;
 };
 
@@ -116,6 +144,11 @@ static const char* proc_state_label(uint8_t state, Color* out_color) {
     return label;
 }
 
+// Memory a process holds: its resident heap and its window buffers
+static uint64_t mem_pages(const Montauk::ProcInfo& info) {
+    return info.residentPages + info.windowPages;
+}
+
 static int content_top() {
     return PM_TOOLBAR_H + PM_TAB_H;
 }
@@ -128,22 +161,10 @@ static int window_list_y() {
     return content_top() + PM_HEADER_H;
 }
 
-static int process_visible_rows() {
-    int avail = g_win.height - process_list_y();
-    if (avail <= 0) return 0;
-    return avail / PM_ITEM_H;
-}
-
-static int window_visible_rows() {
-    int avail = g_win.height - window_list_y();
-    if (avail <= 0) return 0;
-    return avail / PM_ITEM_H;
-}
-
 static int live_process_count() {
     int count = 0;
     for (int i = 0; i < g_pm.proc_count; i++) {
-        uint8_t state = g_pm.procs[i].state;
+        uint8_t state = g_pm.procs[i].info.state;
         if (state == 1 || state == 2 || state == 3)
             count++;
     }
@@ -152,7 +173,7 @@ static int live_process_count() {
 
 static int find_process_index_by_pid(int pid) {
     for (int i = 0; i < g_pm.proc_count; i++) {
-        if (g_pm.procs[i].pid == pid)
+        if (g_pm.procs[i].info.pid == pid)
             return i;
     }
     return -1;
@@ -166,40 +187,118 @@ static int find_window_index_by_id(int id) {
     return -1;
 }
 
+// Fit both lists to the window and their contents
 static void clamp_scrolls() {
-    int proc_vis = process_visible_rows();
-    int max_proc_scroll = 0;
-    if (g_pm.proc_count > proc_vis && proc_vis > 0)
-        max_proc_scroll = g_pm.proc_count - proc_vis;
-    g_pm.proc_scroll = gui_clamp(g_pm.proc_scroll, 0, max_proc_scroll);
-
-    int win_vis = window_visible_rows();
-    int max_win_scroll = 0;
-    if (g_pm.win_count > win_vis && win_vis > 0)
-        max_win_scroll = g_pm.win_count - win_vis;
-    g_pm.win_scroll = gui_clamp(g_pm.win_scroll, 0, max_win_scroll);
+    int proc_y = process_list_y();
+    g_pm.proc_list.bounds = {0, proc_y, g_win.width, gui_max(0, g_win.height - PM_DETAIL_H - proc_y)};
+    g_pm.proc_list.item_count = g_pm.proc_count;
+    g_pm.proc_list.clamp_scroll();
+
+    int win_y = window_list_y();
+    g_pm.win_list.bounds = {0, win_y, g_win.width, gui_max(0, g_win.height - win_y)};
+    g_pm.win_list.item_count = g_pm.win_count;
+    g_pm.win_list.clamp_scroll();
 }
 
 static void ensure_process_selection_visible() {
-    if (g_pm.selected < 0) return;
-    int visible = process_visible_rows();
-    if (visible <= 0) return;
-    if (g_pm.selected < g_pm.proc_scroll)
-        g_pm.proc_scroll = g_pm.selected;
-    else if (g_pm.selected >= g_pm.proc_scroll + visible)
-        g_pm.proc_scroll = g_pm.selected - visible + 1;
     clamp_scrolls();
+    g_pm.proc_list.scroll_to_item(g_pm.selected);
 }
 
 static void ensure_window_selection_visible() {
-    if (g_pm.selected_window < 0) return;
-    int visible = window_visible_rows();
-    if (visible <= 0) return;
-    if (g_pm.selected_window < g_pm.win_scroll)
-        g_pm.win_scroll = g_pm.selected_window;
-    else if (g_pm.selected_window >= g_pm.win_scroll + visible)
-        g_pm.win_scroll = g_pm.selected_window - visible + 1;
     clamp_scrolls();
+    g_pm.win_list.scroll_to_item(g_pm.selected_window);
+}
+
+static VirtualList* active_list() {
+    if (g_pm.active_tab == PM_TAB_PROCESSES) return &g_pm.proc_list;
+    if (g_pm.active_tab == PM_TAB_WINDOWS) return &g_pm.win_list;
+    return nullptr;
+}
+
+// Present the whole window. Presenting by rectangle keeps the frame in
+// the buffer, so scrolling a list can move its pixels instead of redrawing.
+static void present_all() {
+    Montauk::WinRect all = {0, 0, g_win.width, g_win.height};
+    g_win.present(&all, 1);
+}
+
+// Whether row a goes before row b in the current order
+static bool process_before(const ProcRow& a, const ProcRow& b) {
+    int64_t ka = 0, kb = 0;
+    switch (g_pm.sort_column) {
+    case PM_SORT_NAME: {
+        int i = 0;
+        while (a.info.name[i] && a.info.name[i] == b.info.name[i]) i++;
+        ka = (uint8_t)a.info.name[i];
+        kb = (uint8_t)b.info.name[i];
+        break;
+    }
+    case PM_SORT_CPU:
+        ka = a.cpu_tenths;
+        kb = b.cpu_tenths;
+        break;
+    case PM_SORT_MEM:
+        ka = (int64_t)mem_pages(a.info);
+        kb = (int64_t)mem_pages(b.info);
+        break;
+    case PM_SORT_THREADS:
+        ka = a.info.threads;
+        kb = b.info.threads;
+        break;
+    case PM_SORT_SWITCHES:
+        ka = a.switch_rate;
+        kb = b.switch_rate;
+        break;
+    case PM_SORT_STATE:
+        ka = a.info.state;
+        kb = b.info.state;
+        break;
+    default:
+        break;
+    }
+    // Ties, and the PID column itself, go by PID
+    if (ka == kb) {
+        ka = a.info.pid;
+        kb = b.info.pid;
+        if (g_pm.sort_column != PM_SORT_PID) return ka < kb;
+    }
+    return g_pm.sort_desc ? ka > kb : ka < kb;
+}
+
+// Sort the rows in place, keeping the selection on the same process
+static void sort_processes() {
+    static ProcRow sorted[PM_MAX_PROCS];
+    static int order[PM_MAX_PROCS];
+    int n = g_pm.proc_count;
+    int selected_pid = (g_pm.selected >= 0 && g_pm.selected < n) ? g_pm.procs[g_pm.selected].info.pid : -1;
+
+    for (int i = 0; i < n; i++) {
+        int idx = i;
+        int j = i;
+        while (j > 0 && process_before(g_pm.procs[idx], g_pm.procs[order[j - 1]])) {
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = idx;
+    }
+    for (int i = 0; i < n; i++) sorted[i] = g_pm.procs[order[i]];
+    montauk::memcpy(g_pm.procs, sorted, sizeof(ProcRow) * n);
+
+    if (selected_pid >= 0) g_pm.selected = find_process_index_by_pid(selected_pid);
+}
+
+// Click on a column header: sort by it, or flip the order if it already is
+static void set_sort(int column) {
+    if (g_pm.sort_column == column) {
+        g_pm.sort_desc = !g_pm.sort_desc;
+    } else {
+        g_pm.sort_column = column;
+        // Numbers read best largest first, names and PIDs in order
+        g_pm.sort_desc = column != PM_SORT_PID && column != PM_SORT_NAME;
+    }
+    sort_processes();
+    ensure_process_selection_visible();
 }
 
 static bool refresh_state(bool force) {
@@ -207,19 +306,53 @@ static bool refresh_state(bool force) {
     if (!force && now - g_pm.last_poll_ms < PM_POLL_MS)
         return false;
 
+    uint64_t prev_poll_ms = g_pm.last_poll_ms;
     g_pm.last_poll_ms = now;
 
     int prev_pid = -1;
     if (g_pm.selected >= 0 && g_pm.selected < g_pm.proc_count)
-        prev_pid = g_pm.procs[g_pm.selected].pid;
+        prev_pid = g_pm.procs[g_pm.selected].info.pid;
 
     int prev_win_id = -1;
     if (g_pm.selected_window >= 0 && g_pm.selected_window < g_pm.win_count)
         prev_win_id = g_pm.windows[g_pm.selected_window].id;
 
-    g_pm.proc_count = montauk::proclist(g_pm.procs, PM_MAX_PROCS);
+    // The previous poll's rows turn counters into rates and carry the history
+    static ProcRow prev[PM_MAX_PROCS];
+    static Montauk::ProcInfo infos[PM_MAX_PROCS];
+    int prev_count = g_pm.proc_count;
+    montauk::memcpy(prev, g_pm.procs, sizeof(ProcRow) * prev_count);
+    uint64_t elapsed_ms = now - prev_poll_ms;
+
+    g_pm.proc_count = montauk::proclist(infos, PM_MAX_PROCS);
     if (g_pm.proc_count < 0) g_pm.proc_count = 0;
 
+    for (int i = 0; i < g_pm.proc_count; i++) {
+        ProcRow& row = g_pm.procs[i];
+        montauk::memset(&row, 0, sizeof(row));
+        row.info = infos[i];
+        uint64_t total = row.info.userTimeUs + row.info.kernelTimeUs;
+        uint64_t switches = row.info.voluntarySwitches + row.info.involuntarySwitches;
+
+        for (int j = 0; j < prev_count; j++) {
+            const ProcRow& old = prev[j];
+            if (old.info.pid != row.info.pid) continue;
+            uint64_t old_total = old.info.userTimeUs + old.info.kernelTimeUs;
+            uint64_t old_switches = old.info.voluntarySwitches + old.info.involuntarySwitches;
+            if (elapsed_ms > 0 && total >= old_total)
+                row.cpu_tenths = (uint32_t)((total - old_total) / elapsed_ms);
+            if (elapsed_ms > 0 && switches >= old_switches)
+                row.switch_rate = (uint32_t)((switches - old_switches) * 1000ULL / elapsed_ms);
+            montauk::memcpy(row.cpu_hist, old.cpu_hist + 1, sizeof(row.cpu_hist) - sizeof(row.cpu_hist[0]));
+            montauk::memcpy(row.mem_hist, old.mem_hist + 1, sizeof(row.mem_hist) - sizeof(row.mem_hist[0]));
+            break;
+        }
+        row.cpu_hist[PM_HIST - 1] = (uint16_t)gui_min((int)row.cpu_tenths, 0xFFFF);
+        row.mem_hist[PM_HIST - 1] = (uint32_t)mem_pages(row.info);
+    }
+    g_pm.selected = -1;
+    sort_processes();
+
     g_pm.selected = find_process_index_by_pid(prev_pid);
 
     g_pm.win_count = montauk::win_enumerate(g_pm.windows, PM_MAX_WINDOWS);
@@ -236,15 +369,15 @@ static bool can_kill_selected() {
     return g_pm.active_tab == PM_TAB_PROCESSES
         && g_pm.selected >= 0
         && g_pm.selected < g_pm.proc_count
-        && g_pm.procs[g_pm.selected].pid != 0
-        && g_pm.procs[g_pm.selected].state != 4;
+        && g_pm.procs[g_pm.selected].info.pid != 0
+        && g_pm.procs[g_pm.selected].info.state != 4;
 }
 
 static void kill_selected() {
     if (!can_kill_selected())
         return;
 
-    montauk::kill(g_pm.procs[g_pm.selected].pid);
+    montauk::kill(g_pm.procs[g_pm.selected].info.pid);
     refresh_state(true);
 }
 
@@ -331,101 +464,189 @@ static void render_tabs(Canvas& c, TrueTypeFont* font, int fh) {
     }
 }
 
-static void render_processes(Canvas& c, TrueTypeFont* font, int fh) {
-    int header_y = content_top();
-    c.fill_rect(0, header_y, g_win.width, PM_HEADER_H, PM_HEADER_BG);
-    c.hline(0, header_y + PM_HEADER_H - 1, g_win.width, PM_BORDER);
+struct ProcColumns {
+    int pid, name, cpu, mem, threads, switches, state;
+};
 
-    int col_pid = 12;
-    int col_ppid = 64;
-    int col_name = 124;
-    int col_heap = g_win.width - 150;
-    int col_state = g_win.width - 70;
-    int header_text_y = header_y + (PM_HEADER_H - fh) / 2;
+struct WinColumns {
+    int id, pid, title, size, dirty;
+};
+
+static ProcColumns process_columns() {
+    int w = g_win.width;
+    return {12, 64, w - 456, w - 316, w - 176, w - 134, w - 64};
+}
+
+static WinColumns window_columns() {
+    return {12, 60, 118, g_win.width - 130, g_win.width - 52};
+}
+
+// Bars of `values`, scaled so that `scale` fills the height
+static void draw_sparkline(Canvas& c, int x, int y, int h, const uint32_t* values, uint32_t scale, Color color) {
+    if (scale == 0) return;
+    for (int i = 0; i < PM_HIST; i++) {
+        uint32_t v = values[i] < scale ? values[i] : scale;
+        int bar = (int)((uint64_t)v * h / scale);
+        if (v > 0 && bar == 0) bar = 1;
+        if (bar > 0) c.fill_rect(x + i * 2, y + h - bar, 2, bar, color);
+    }
+}
+
+static void draw_process_row(void*, int index, uint32_t* pixels, int buf_w, int buf_h, int x, int y) {
+    Canvas c(pixels, buf_w, buf_h);
+    TrueTypeFont* font = fonts::system_font;
+    int fh = text_height(font, FONT_SIZE);
+    ProcColumns col = process_columns();
+    const ProcRow& row = g_pm.procs[index];
 
-    draw_text(c, font, col_pid, header_text_y, "PID", PM_DIM_TEXT, FONT_SIZE);
-    draw_text(c, font, col_ppid, header_text_y, "PPID", PM_DIM_TEXT, FONT_SIZE);
-    draw_text(c, font, col_name, header_text_y, "Name", PM_DIM_TEXT, FONT_SIZE);
-    draw_text(c, font, col_heap, header_text_y, "Heap", PM_DIM_TEXT, FONT_SIZE);
-    draw_text(c, font, col_state, header_text_y, "State", PM_DIM_TEXT, FONT_SIZE);
+    if (index == g_pm.selected)
+        c.fill_rect(x, y, g_pm.proc_list.bounds.w, PM_ITEM_H, colors::MENU_HOVER);
 
-    int list_y = process_list_y();
-    int visible = process_visible_rows();
-    for (int row = 0; row < visible; row++) {
-        int index = g_pm.proc_scroll + row;
-        if (index >= g_pm.proc_count) break;
+    int text_y = y + (PM_ITEM_H - fh) / 2;
+    int spark_y = y + 5;
+    int spark_h = PM_ITEM_H - 10;
+    char buf[32];
 
-        int row_y = list_y + row * PM_ITEM_H;
-        if (index == g_pm.selected)
-            c.fill_rect(0, row_y, g_win.width, PM_ITEM_H, colors::MENU_HOVER);
+    snprintf(buf, sizeof(buf), "%d", (int)row.info.pid);
+    draw_text(c, font, x + col.pid, text_y, buf, colors::TEXT_COLOR, FONT_SIZE);
 
-        int text_y = row_y + (PM_ITEM_H - fh) / 2;
-        char buf[32];
+    draw_text_fit(c, font, x + col.name, text_y, row.info.name,
+                  col.cpu - col.name - 10, colors::TEXT_COLOR, FONT_SIZE);
 
-        snprintf(buf, sizeof(buf), "%d", (int)g_pm.procs[index].pid);
-        draw_text(c, font, col_pid, text_y, buf, colors::TEXT_COLOR, FONT_SIZE);
+    uint32_t tenths = row.cpu_tenths;
+    snprintf(buf, sizeof(buf), "%u.%u%%", tenths / 10, tenths % 10);
+    draw_text(c, font, x + col.cpu, text_y, buf, colors::TEXT_COLOR, FONT_SIZE);
+    uint32_t cpu_hist[PM_HIST];
+    for (int i = 0; i < PM_HIST; i++) cpu_hist[i] = row.cpu_hist[i];
+    draw_sparkline(c, x + col.cpu + 64, spark_y, spark_h, cpu_hist, 1000, PM_SPARK_CPU);
 
-        snprintf(buf, sizeof(buf), "%d", (int)g_pm.procs[index].parentPid);
-        draw_text(c, font, col_ppid, text_y, buf, colors::TEXT_COLOR, FONT_SIZE);
+    format_size(buf, mem_pages(row.info) * 4096ULL);
+    draw_text(c, font, x + col.mem, text_y, buf, colors::TEXT_COLOR, FONT_SIZE);
+    uint32_t mem_peak = 0;
+    for (int i = 0; i < PM_HIST; i++) mem_peak = gui_max(mem_peak, row.mem_hist[i]);
+    draw_sparkline(c, x + col.mem + 76, spark_y, spark_h, row.mem_hist, mem_peak, PM_SPARK_MEM);
 
-        draw_text_fit(c, font, col_name, text_y, g_pm.procs[index].name,
-                      col_heap - col_name - 10, colors::TEXT_COLOR, FONT_SIZE);
+    snprintf(buf, sizeof(buf), "%u", row.info.threads);
+    draw_text(c, font, x + col.threads, text_y, buf, colors::TEXT_COLOR, FONT_SIZE);
 
-        format_size(buf, g_pm.procs[index].heapUsed);
-        draw_text(c, font, col_heap, text_y, buf, colors::TEXT_COLOR, FONT_SIZE);
+    snprintf(buf, sizeof(buf), "%u", row.switch_rate);
+    draw_text(c, font, x + col.switches, text_y, buf, colors::TEXT_COLOR, FONT_SIZE);
+
+    Color state_color;
+    const char* state = proc_state_label(row.info.state, &state_color);
+    draw_text(c, font, x + col.state, text_y, state, state_color, FONT_SIZE);
+}
+
+static void draw_window_row(void*, int index, uint32_t* pixels, int buf_w, int buf_h, int x, int y) {
+    Canvas c(pixels, buf_w, buf_h);
+    TrueTypeFont* font = fonts::system_font;
+    int fh = text_height(font, FONT_SIZE);
+    WinColumns col = window_columns();
 
-        Color state_color;
-        const char* state = proc_state_label(g_pm.procs[index].state, &state_color);
-        draw_text(c, font, col_state, text_y, state, state_color, FONT_SIZE);
+    if (index == g_pm.selected_window)
+        c.fill_rect(x, y, g_pm.win_list.bounds.w, PM_ITEM_H, colors::MENU_HOVER);
+
+    int text_y = y + (PM_ITEM_H - fh) / 2;
+    char buf[64];
+
+    snprintf(buf, sizeof(buf), "%d", (int)g_pm.windows[index].id);
+    draw_text(c, font, x + col.id, text_y, buf, colors::TEXT_COLOR, FONT_SIZE);
+
+    snprintf(buf, sizeof(buf), "%d", (int)g_pm.windows[index].ownerPid);
+    draw_text(c, font, x + col.pid, text_y, buf, colors::TEXT_COLOR, FONT_SIZE);
+
+    draw_text_fit(c, font, x + col.title, text_y, g_pm.windows[index].title,
+                  col.size - col.title - 10, colors::TEXT_COLOR, FONT_SIZE);
+
+    snprintf(buf, sizeof(buf), "%dx%d", (int)g_pm.windows[index].width, (int)g_pm.windows[index].height);
+    draw_text(c, font, x + col.size, text_y, buf, colors::TEXT_COLOR, FONT_SIZE);
+
+    draw_text(c, font, x + col.dirty, text_y, g_pm.windows[index].dirty ? "Y" : "N",
+              g_pm.windows[index].dirty ? PM_WARNING : PM_DIM_TEXT, FONT_SIZE);
+}
+
+// Everything SYS_PROCLIST knows about the selected process
+static void render_process_detail(Canvas& c, TrueTypeFont* font, int fh) {
+    int y = g_win.height - PM_DETAIL_H;
+    c.fill_rect(0, y, g_win.width, PM_DETAIL_H, PM_HEADER_BG);
+    c.hline(0, y, g_win.width, PM_BORDER);
+
+    int line_h = fh + 6;
+    int x = 12;
+    y += 8;
+    if (g_pm.selected < 0 || g_pm.selected >= g_pm.proc_count) {
+        draw_text(c, font, x, y, "Select a process to see its details.", PM_DIM_TEXT, FONT_SIZE);
+        return;
     }
+
+    const Montauk::ProcInfo& info = g_pm.procs[g_pm.selected].info;
+    char line[160], a[24], b[24], w[24];
+
+    format_size(a, info.residentPages * 4096ULL);
+    format_size(b, info.reservedPages * 4096ULL);
+    format_size(w, (uint64_t)info.windowPages * 4096ULL);
+    snprintf(line, sizeof(line), "Heap %s resident of %s reserved in %u regions, windows %s",
+             a, b, info.vmaCount, w);
+    draw_text_fit(c, font, x, y, line, g_win.width - 24, colors::TEXT_COLOR, FONT_SIZE);
+    y += line_h;
+
+    char where[24];
+    if (info.cpu >= 0) snprintf(where, sizeof(where), "on CPU %d", (int)info.cpu);
+    else snprintf(where, sizeof(where), "not running");
+    snprintf(line, sizeof(line), "CPU user %llu.%02llu s, kernel %llu.%02llu s, %s, parent %d",
+             (unsigned long long)(info.userTimeUs / 1000000), (unsigned long long)(info.userTimeUs / 10000 % 100),
+             (unsigned long long)(info.kernelTimeUs / 1000000), (unsigned long long)(info.kernelTimeUs / 10000 % 100),
+             where, (int)info.parentPid);
+    draw_text_fit(c, font, x, y, line, g_win.width - 24, colors::TEXT_COLOR, FONT_SIZE);
+    y += line_h;
+
+    snprintf(line, sizeof(line), "Switches %llu blocking, %llu preempted; %u sockets, %u files open",
+             (unsigned long long)info.voluntarySwitches, (unsigned long long)info.involuntarySwitches,
+             info.sockets, info.openFiles);
+    draw_text_fit(c, font, x, y, line, g_win.width - 24, colors::TEXT_COLOR, FONT_SIZE);
 }
 
-static void render_windows(Canvas& c, TrueTypeFont* font, int fh) {
+static void render_processes(Canvas& c, TrueTypeFont* font, int fh) {
     int header_y = content_top();
     c.fill_rect(0, header_y, g_win.width, PM_HEADER_H, PM_HEADER_BG);
     c.hline(0, header_y + PM_HEADER_H - 1, g_win.width, PM_BORDER);
 
-    int col_id = 12;
-    int col_pid = 60;
-    int col_title = 118;
-    int col_size = g_win.width - 130;
-    int col_dirty = g_win.width - 52;
+    ProcColumns col = process_columns();
     int header_text_y = header_y + (PM_HEADER_H - fh) / 2;
 
-    draw_text(c, font, col_id, header_text_y, "ID", PM_DIM_TEXT, FONT_SIZE);
-    draw_text(c, font, col_pid, header_text_y, "PID", PM_DIM_TEXT, FONT_SIZE);
-    draw_text(c, font, col_title, header_text_y, "Title", PM_DIM_TEXT, FONT_SIZE);
-    draw_text(c, font, col_size, header_text_y, "Size", PM_DIM_TEXT, FONT_SIZE);
-    draw_text(c, font, col_dirty, header_text_y, "D", PM_DIM_TEXT, FONT_SIZE);
-
-    int list_y = window_list_y();
-    int visible = window_visible_rows();
-    for (int row = 0; row < visible; row++) {
-        int index = g_pm.win_scroll + row;
-        if (index >= g_pm.win_count) break;
-
-        int row_y = list_y + row * PM_ITEM_H;
-        if (index == g_pm.selected_window)
-            c.fill_rect(0, row_y, g_win.width, PM_ITEM_H, colors::MENU_HOVER);
-
-        int text_y = row_y + (PM_ITEM_H - fh) / 2;
-        char buf[64];
+    static const char* labels[] = { "PID", "Name", "CPU", "Memory", "Thr", "Sw/s", "State" };
+    int xs[] = { col.pid, col.name, col.cpu, col.mem, col.threads, col.switches, col.state };
+    for (int i = 0; i < 7; i++) {
+        char label[16];
+        if (i == g_pm.sort_column)
+            snprintf(label, sizeof(label), "%s %s", labels[i], g_pm.sort_desc ? "v" : "^");
+        else
+            snprintf(label, sizeof(label), "%s", labels[i]);
+        draw_text(c, font, xs[i], header_text_y, label,
+                  i == g_pm.sort_column ? colors::TEXT_COLOR : PM_DIM_TEXT, FONT_SIZE);
+    }
 
-        snprintf(buf, sizeof(buf), "%d", (int)g_pm.windows[index].id);
-        draw_text(c, font, col_id, text_y, buf, colors::TEXT_COLOR, FONT_SIZE);
+    clamp_scrolls();
+    g_pm.proc_list.draw(c.pixels, c.w);
+    render_process_detail(c, font, fh);
+}
 
-        snprintf(buf, sizeof(buf), "%d", (int)g_pm.windows[index].ownerPid);
-        draw_text(c, font, col_pid, text_y, buf, colors::TEXT_COLOR, FONT_SIZE);
+static void render_windows(Canvas& c, TrueTypeFont* font, int fh) {
+    int header_y = content_top();
+    c.fill_rect(0, header_y, g_win.width, PM_HEADER_H, PM_HEADER_BG);
+    c.hline(0, header_y + PM_HEADER_H - 1, g_win.width, PM_BORDER);
 
-        draw_text_fit(c, font, col_title, text_y, g_pm.windows[index].title,
-                      col_size - col_title - 10, colors::TEXT_COLOR, FONT_SIZE);
+    WinColumns col = window_columns();
+    int header_text_y = header_y + (PM_HEADER_H - fh) / 2;
 
-        snprintf(buf, sizeof(buf), "%dx%d", (int)g_pm.windows[index].width, (int)g_pm.windows[index].height);
-        draw_text(c, font, col_size, text_y, buf, colors::TEXT_COLOR, FONT_SIZE);
+    draw_text(c, font, col.id, header_text_y, "ID", PM_DIM_TEXT, FONT_SIZE);
+    draw_text(c, font, col.pid, header_text_y, "PID", PM_DIM_TEXT, FONT_SIZE);
+    draw_text(c, font, col.title, header_text_y, "Title", PM_DIM_TEXT, FONT_SIZE);
+    draw_text(c, font, col.size, header_text_y, "Size", PM_DIM_TEXT, FONT_SIZE);
+    draw_text(c, font, col.dirty, header_text_y, "D", PM_DIM_TEXT, FONT_SIZE);
 
-        draw_text(c, font, col_dirty, text_y, g_pm.windows[index].dirty ? "Y" : "N",
-                  g_pm.windows[index].dirty ? PM_WARNING : PM_DIM_TEXT, FONT_SIZE);
-    }
+    clamp_scrolls();
+    g_pm.win_list.draw(c.pixels, c.w);
 }
 
 static void render() {
@@ -479,44 +700,49 @@ static bool handle_tab_click(int mx, int my) {
     return false;
 }
 
-static bool handle_process_click(int my) {
-    if (my < process_list_y())
+static bool handle_process_click(int mx, int my) {
+    if (my < content_top())
         return false;
 
-    int row = (my - process_list_y()) / PM_ITEM_H;
-    int index = g_pm.proc_scroll + row;
-    if (index >= 0 && index < g_pm.proc_count)
-        g_pm.selected = index;
-    else
-        g_pm.selected = -1;
+    if (my < process_list_y()) {
+        ProcColumns col = process_columns();
+        int xs[] = { col.pid, col.name, col.cpu, col.mem, col.threads, col.switches, col.state };
+        int column = 0;
+        for (int i = 0; i < 7; i++) {
+            if (mx >= xs[i] - 6) column = i;
+        }
+        set_sort(column);
+        return true;
+    }
+    if (my >= g_win.height - PM_DETAIL_H)
+        return false;
+
+    g_pm.selected = g_pm.proc_list.item_at(mx, my);
     return true;
 }
 
-static bool handle_window_click(int my) {
+static bool handle_window_click(int mx, int my) {
     if (my < window_list_y())
         return false;
 
-    int row = (my - window_list_y()) / PM_ITEM_H;
-    int index = g_pm.win_scroll + row;
-    if (index >= 0 && index < g_pm.win_count)
-        g_pm.selected_window = index;
-    else
-        g_pm.selected_window = -1;
+    g_pm.selected_window = g_pm.win_list.item_at(mx, my);
     return true;
 }
 
+// Scroll the active list in place and present just the list
+static void scroll_active_list(int32_t scroll) {
+    VirtualList* list = active_list();
+    if (!list || !g_win.pixels) return;
+    if (list->scroll_to(g_win.pixels, g_win.width, list->scroll_offset - scroll * 3 * PM_ITEM_H)) {
+        Montauk::WinRect r = {list->bounds.x, list->bounds.y, list->bounds.w, list->bounds.h};
+        g_win.present(&r, 1);
+    }
+}
+
 static bool handle_mouse(const Montauk::WinEvent& ev) {
     if (ev.mouse.scroll != 0) {
-        if (g_pm.active_tab == PM_TAB_PROCESSES) {
-            g_pm.proc_scroll -= ev.mouse.scroll * 3;
-            clamp_scrolls();
-            return true;
-        }
-        if (g_pm.active_tab == PM_TAB_WINDOWS) {
-            g_pm.win_scroll -= ev.mouse.scroll * 3;
-            clamp_scrolls();
-            return true;
-        }
+        scroll_active_list(ev.mouse.scroll);
+        return false;
     }
 
     bool left_pressed = (ev.mouse.buttons & 1) && !(ev.mouse.prev_buttons & 1);
@@ -532,9 +758,9 @@ static bool handle_mouse(const Montauk::WinEvent& ev) {
         return handle_tab_click(mx, my);
 
     if (g_pm.active_tab == PM_TAB_PROCESSES)
-        return handle_process_click(my);
+        return handle_process_click(mx, my);
     if (g_pm.active_tab == PM_TAB_WINDOWS)
-        return handle_window_click(my);
+        return handle_window_click(mx, my);
     return false;
 }
 
@@ -608,9 +834,13 @@ extern "C" void _start() {
     g_pm.selected = -1;
     g_pm.selected_window = -1;
     g_pm.active_tab = PM_TAB_PROCESSES;
+    g_pm.sort_column = PM_SORT_CPU;
+    g_pm.sort_desc = true;
+    g_pm.proc_list.init(PM_ITEM_H, draw_process_row, nullptr);
+    g_pm.win_list.init(PM_ITEM_H, draw_window_row, nullptr);
     refresh_state(true);
     render();
-    g_win.present();
+    present_all();
 
     while (!g_win.closed) {
         bool redraw = refresh_state(false);
@@ -622,7 +852,7 @@ extern "C" void _start() {
         if (r == 0) {
             if (redraw) {
                 render();
-                g_win.present();
+                present_all();
             }
             montauk::sleep_ms(16);
             continue;
@@ -637,7 +867,7 @@ extern "C" void _start() {
 
         if (redraw) {
             render();
-            g_win.present();
+            present_all();
         }
     }
 
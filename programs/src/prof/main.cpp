@@ -0,0 +1,738 @@
+/*
+    * main.cpp
+    * prof - Sampling profiler: flat profiles and folded stacks
+    * Copyright (c) 2026 Daniel Hammer
+*/
+
+#include <montauk/syscall.h>
+#include <montauk/string.h>
+#include <montauk/args.h>
+#include <montauk/heap.h>
+
+using Montauk::ProfSample;
+
+static constexpr uint64_t DEFAULT_MS = 5000;
+static constexpr uint64_t DRAIN_MS   = 50;
+static constexpr int BATCH       = 256;
+static constexpr int MAX_PROCS   = 1024;
+static constexpr int MAX_PATHS   = 1024;
+static constexpr int MAX_IMAGES  = 32;
+static constexpr int TOP_FUNCS   = 40;
+static constexpr int NAME_MAX    = 128;
+
+static const char* const KERNEL_IMAGE = "0:/boot/kernel";
+
+// ---- Output buffer, printed or written to a file at the end ----
+
+struct Out {
+    char* data = nullptr;
+    uint64_t len = 0;
+    uint64_t cap = 0;
+};
+
+static void put(Out& out, const char* s, uint64_t n) {
+    if (out.len + n + 1 > out.cap) {
+        uint64_t cap = out.cap ? out.cap * 2 : 65536;
+        while (cap < out.len + n + 1) cap *= 2;
+        char* grown = (char*)montauk::realloc(out.data, cap);
+        if (!grown) return;
+        out.data = grown;
+        out.cap = cap;
+    }
+    montauk::memcpy(out.data + out.len, s, n);
+    out.len += n;
+    out.data[out.len] = '\0';
+}
+
+static void put(Out& out, const char* s) { put(out, s, montauk::slen(s)); }
+
+static int digits(uint64_t n) {
+    int d = 1;
+    while (n >= 10) {
+        n /= 10;
+        d++;
+    }
+    return d;
+}
+
+static void put_u64(Out& out, uint64_t n, int width = 0) {
+    char buf[20];
+    int i = 0;
+    do {
+        buf[i++] = '0' + (n % 10);
+        n /= 10;
+    } while (n > 0);
+    for (int pad = i; pad < width; pad++) put(out, " ", 1);
+    char rev[20];
+    for (int j = 0; j < i; j++) rev[j] = buf[i - 1 - j];
+    put(out, rev, i);
+}
+
+static void put_hex(Out& out, uint64_t n) {
+    char buf[18];
+    int i = 0;
+    do {
+        buf[i++] = "0123456789abcdef"[n & 0xF];
+        n >>= 4;
+    } while (n > 0);
+    put(out, "0x", 2);
+    for (int j = i - 1; j >= 0; j--) put(out, &buf[j], 1);
+}
+
+// `part` of `whole` as a right-aligned percentage with one decimal
+static void put_percent(Out& out, uint64_t part, uint64_t whole, int width) {
+    uint64_t permille = whole ? part * 1000 / whole : 0;
+    for (int pad = digits(permille / 10) + 3; pad < width; pad++) put(out, " ", 1);
+    put_u64(out, permille / 10);
+    put(out, ".", 1);
+    put_u64(out, permille % 10);
+    put(out, "%", 1);
+}
+
+// ---- ELF symbol tables ----
+
+struct Elf64Header {
+    uint8_t  e_ident[16];
+    uint16_t e_type;
+    uint16_t e_machine;
+    uint32_t e_version;
+    uint64_t e_entry;
+    uint64_t e_phoff;
+    uint64_t e_shoff;
+    uint32_t e_flags;
+    uint16_t e_ehsize;
+    uint16_t e_phentsize;
+    uint16_t e_phnum;
+    uint16_t e_shentsize;
+    uint16_t e_shnum;
+    uint16_t e_shstrndx;
+};
+
+struct Elf64SectionHeader {
+    uint32_t sh_name;
+    uint32_t sh_type;
+    uint64_t sh_flags;
+    uint64_t sh_addr;
+    uint64_t sh_offset;
+    uint64_t sh_size;
+    uint32_t sh_link;
+    uint32_t sh_info;
+    uint64_t sh_addralign;
+    uint64_t sh_entsize;
+};
+
+struct Elf64Symbol {
+    uint32_t st_name;
+    uint8_t  st_info;
+    uint8_t  st_other;
+    uint16_t st_shndx;
+    uint64_t st_value;
+    uint64_t st_size;
+};
+
+static constexpr uint32_t SHT_SYMTAB = 2;
+static constexpr uint8_t  STT_FUNC   = 2;
+
+struct Symbol {
+    uint64_t addr;
+    uint64_t size;
+    uint32_t name;       // Offset into the image's string table
+};
+
+struct Image {
+    char path[64];
+    const char* shortName;   // Last path component
+    char* strtab;
+    Symbol* syms;
+    int count;
+    bool loaded;
+};
+
+static Image g_images[MAX_IMAGES];
+static int g_imageCount = 0;
+static Image* g_kernel = nullptr;
+
+static bool read_at(int fd, void* buf, uint64_t off, uint64_t size) {
+    return montauk::read(fd, (uint8_t*)buf, off, size) == (int)size;
+}
+
+static void sift_down(Symbol* syms, int start, int end) {
+    int root = start;
+    while (root * 2 + 1 <= end) {
+        int child = root * 2 + 1;
+        if (child + 1 <= end && syms[child].addr < syms[child + 1].addr) child++;
+        if (syms[root].addr >= syms[child].addr) return;
+        Symbol tmp = syms[root];
+        syms[root] = syms[child];
+        syms[child] = tmp;
+        root = child;
+    }
+}
+
+// Heapsort by address; a kernel symbol table has tens of thousands
+static void sort_symbols(Symbol* syms, int count) {
+    for (int start = count / 2 - 1; start >= 0; start--) sift_down(syms, start, count - 1);
+    for (int end = count - 1; end > 0; end--) {
+        Symbol tmp = syms[0];
+        syms[0] = syms[end];
+        syms[end] = tmp;
+        sift_down(syms, 0, end - 1);
+    }
+}
+
+// Read the function symbols of an ELF file. An image without a symbol
+// table (stripped) leaves every address unresolved.
+static void load_symbols(Image& image) {
+    image.loaded = true;
+    int fd = montauk::open(image.path);
+    if (fd < 0) return;
+
+    Elf64Header eh;
+    if (!read_at(fd, &eh, 0, sizeof(eh)) || eh.e_ident[0] != 0x7F || eh.e_ident[1] != 'E' ||
+        eh.e_ident[2] != 'L' || eh.e_ident[3] != 'F' || eh.e_shentsize != sizeof(Elf64SectionHeader)) {
+        montauk::close(fd);
+        return;
+    }
+
+    uint64_t shdrSize = (uint64_t)eh.e_shnum * sizeof(Elf64SectionHeader);
+    auto* shdrs = (Elf64SectionHeader*)montauk::malloc(shdrSize);
+    if (!shdrs || !read_at(fd, shdrs, eh.e_shoff, shdrSize)) {
+        montauk::mfree(shdrs);
+        montauk::close(fd);
+        return;
+    }
+
+    for (int i = 0; i < eh.e_shnum; i++) {
+        const Elf64SectionHeader& symtab = shdrs[i];
+        if (symtab.sh_type != SHT_SYMTAB || symtab.sh_link >= eh.e_shnum) continue;
+        const Elf64SectionHeader& strtab = shdrs[symtab.sh_link];
+
+        int total = (int)(symtab.sh_size / sizeof(Elf64Symbol));
+        auto* raw = (Elf64Symbol*)montauk::malloc(symtab.sh_size);
+        image.strtab = (char*)montauk::malloc(strtab.sh_size + 1);
+        image.syms = (Symbol*)montauk::malloc((uint64_t)total * sizeof(Symbol));
+        if (!raw || !image.strtab || !image.syms ||
+            !read_at(fd, raw, symtab.sh_offset, symtab.sh_size) ||
+            !read_at(fd, image.strtab, strtab.sh_offset, strtab.sh_size)) {
+            montauk::mfree(raw);
+            montauk::mfree(image.strtab);
+            montauk::mfree(image.syms);
+            image.strtab = nullptr;
+            image.syms = nullptr;
+            break;
+        }
+        image.strtab[strtab.sh_size] = '\0';
+
+        for (int s = 0; s < total; s++) {
+            if ((raw[s].st_info & 0xF) != STT_FUNC || raw[s].st_value == 0) continue;
+            if (raw[s].st_name >= strtab.sh_size) continue;
+            image.syms[image.count++] = {raw[s].st_value, raw[s].st_size, raw[s].st_name};
+        }
+        montauk::mfree(raw);
+        sort_symbols(image.syms, image.count);
+        break;
+    }
+
+    montauk::mfree(shdrs);
+    montauk::close(fd);
+}
+
+static Image* find_image(const char* path) {
+    for (int i = 0; i < g_imageCount; i++) {
+        if (montauk::streq(g_images[i].path, path)) return &g_images[i];
+    }
+    if (g_imageCount == MAX_IMAGES) return nullptr;
+
+    Image& image = g_images[g_imageCount++];
+    montauk::strncpy(image.path, path, sizeof(image.path));
+    image.shortName = image.path;
+    for (const char* p = image.path; *p; p++) {
+        if (*p == '/' || *p == ':') image.shortName = p + 1;
+    }
+    return &image;
+}
+
+static const Symbol* lookup(Image* image, uint64_t addr) {
+    if (image == nullptr) return nullptr;
+    if (!image->loaded) load_symbols(*image);
+
+    int lo = 0, hi = image->count - 1, found = -1;
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        if (image->syms[mid].addr <= addr) {
+            found = mid;
+            lo = mid + 1;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    if (found < 0) return nullptr;
+
+    // Sizeless symbols (assembly) reach up to the next one
+    const Symbol& sym = image->syms[found];
+    if (sym.size != 0 && addr >= sym.addr + sym.size) return nullptr;
+    return &sym;
+}
+
+// ---- Demangling, just enough for readable frames ----
+
+// <length><identifier> at `p` into `out`; returns what follows, or nullptr
+static const char* demangle_source_name(const char* p, char* out, int& len, int max) {
+    if (*p < '0' || *p > '9') return nullptr;
+    int n = 0;
+    while (*p >= '0' && *p <= '9') n = n * 10 + (*p++ - '0');
+    for (int i = 0; i < n; i++) {
+        if (!p[i]) return nullptr;
+        if (len < max - 1) out[len++] = p[i];
+    }
+    return p + n;
+}
+
+// Skip a template argument list (I ... E), nested ones included
+static const char* skip_template_args(const char* p) {
+    int nesting = 0;
+    do {
+        if (*p == 'I') nesting++;
+        else if (*p == 'E') nesting--;
+        else if (!*p) return p;
+        p++;
+    } while (nesting > 0);
+    return p;
+}
+
+// _ZN3gui6Window4drawEv -> gui::Window::draw. Parameters and template
+// arguments are dropped; anything not understood is shown as is.
+static void demangle(const char* name, char* out, int max) {
+    int len = 0;
+    const char* p = name;
+    bool ok = p[0] == '_' && p[1] == 'Z';
+    if (ok) {
+        p += 2;
+        if (*p == 'L') p++;
+        if (*p == 'N') {
+            p++;
+            while (*p == 'r' || *p == 'V' || *p == 'K') p++;
+            const char* last = nullptr;
+            int lastLen = 0;
+            while (ok && *p && *p != 'E') {
+                if (*p == 'I') {
+                    p = skip_template_args(p);
+                    continue;
+                }
+                if (len > 0 && len < max - 2) {
+                    out[len++] = ':';
+                    out[len++] = ':';
+                }
+                if ((*p == 'C' || *p == 'D') && p[1] >= '0' && p[1] <= '9') {
+                    // Constructor or destructor: the class name again
+                    if (*p == 'D' && len < max - 1) out[len++] = '~';
+                    for (int i = 0; i < lastLen && len < max - 1; i++) out[len++] = last[i];
+                    p += 2;
+                    continue;
+                }
+                int start = len;
+                p = demangle_source_name(p, out, len, max);
+                if (!p) ok = false;
+                last = out + start;
+                lastLen = len - start;
+            }
+        } else {
+            ok = demangle_source_name(p, out, len, max) != nullptr;
+        }
+    }
+
+    if (!ok || len == 0) {
+        montauk::strncpy(out, name, max);
+        return;
+    }
+    out[len] = '\0';
+}
+
+// ---- Processes ----
+
+struct PidPath {
+    int pid;
+    char path[64];
+};
+
+static PidPath g_paths[MAX_PATHS];
+static int g_pathCount = 0;
+static Montauk::ProcInfo g_procs[MAX_PROCS];
+static int g_procCount = 0;
+
+// Remember the executable of every process seen, including ones that
+// have exited by the time the report is written
+static void refresh_procs() {
+    g_procCount = montauk::proclist(g_procs, MAX_PROCS);
+    if (g_procCount < 0) g_procCount = 0;
+    for (int i = 0; i < g_procCount; i++) {
+        bool known = false;
+        for (int j = 0; j < g_pathCount && !known; j++) known = g_paths[j].pid == g_procs[i].pid;
+        if (known || g_pathCount == MAX_PATHS) continue;
+        g_paths[g_pathCount].pid = g_procs[i].pid;
+        montauk::strncpy(g_paths[g_pathCount].path, g_procs[i].name, sizeof(g_paths[0].path));
+        g_pathCount++;
+    }
+}
+
+static bool alive(int pid) {
+    for (int i = 0; i < g_procCount; i++) {
+        // 4 = Terminated: a child waiting to be reaped
+        if (g_procs[i].pid == pid) return g_procs[i].state != 0 && g_procs[i].state != 4;
+    }
+    return false;
+}
+
+static Image* image_of(int pid) {
+    for (int i = 0; i < g_pathCount; i++) {
+        if (g_paths[i].pid == pid) return find_image(g_paths[i].path);
+    }
+    return nullptr;
+}
+
+// ---- Stacks, counted as they are drained ----
+
+struct Stack {
+    int32_t pid;
+    uint16_t depth;          // 0 = empty slot
+    uint16_t flags;
+    uint64_t count;
+    uint64_t ip[Montauk::PROF_MAX_DEPTH];
+};
+
+static Stack* g_stacks = nullptr;
+static uint32_t g_stackCap = 0;
+static uint32_t g_stackCount = 0;
+static uint64_t g_samples = 0;
+
+static uint32_t hash_stack(int32_t pid, uint16_t flags, uint16_t depth, const uint64_t* ip) {
+    uint64_t h = 14695981039346656037ull;
+    auto mix = [&](uint64_t v) { h = (h ^ v) * 1099511628211ull; };
+    mix((uint64_t)(uint32_t)pid);
+    mix(flags);
+    for (int i = 0; i < depth; i++) mix(ip[i]);
+    return (uint32_t)(h ^ (h >> 32));
+}
+
+static Stack* stack_slot(Stack* table, uint32_t cap, int32_t pid, uint16_t flags, uint16_t depth, const uint64_t* ip) {
+    uint32_t i = hash_stack(pid, flags, depth, ip) & (cap - 1);
+    while (table[i].depth != 0) {
+        Stack& s = table[i];
+        if (s.pid == pid && s.flags == flags && s.depth == depth &&
+            montauk::memcmp(s.ip, ip, depth * sizeof(uint64_t)) == 0)
+            return &s;
+        i = (i + 1) & (cap - 1);
+    }
+    return &table[i];
+}
+
+static bool grow_stacks() {
+    uint32_t cap = g_stackCap ? g_stackCap * 2 : 1024;
+    auto* table = (Stack*)montauk::malloc((uint64_t)cap * sizeof(Stack));
+    if (!table) return false;
+    montauk::memset(table, 0, (uint64_t)cap * sizeof(Stack));
+    for (uint32_t i = 0; i < g_stackCap; i++) {
+        Stack& s = g_stacks[i];
+        if (s.depth == 0) continue;
+        *stack_slot(table, cap, s.pid, s.flags, s.depth, s.ip) = s;
+    }
+    montauk::mfree(g_stacks);
+    g_stacks = table;
+    g_stackCap = cap;
+    return true;
+}
+
+static void add_sample(const ProfSample& sample) {
+    if (sample.depth == 0 || sample.depth > Montauk::PROF_MAX_DEPTH) return;
+    if ((g_stackCount + 1) * 4 > g_stackCap * 3 && !grow_stacks()) return;
+
+    Stack* s = stack_slot(g_stacks, g_stackCap, sample.pid, sample.flags, sample.depth, sample.ip);
+    if (s->depth == 0) {
+        s->pid = sample.pid;
+        s->flags = sample.flags;
+        s->depth = sample.depth;
+        montauk::memcpy(s->ip, sample.ip, sample.depth * sizeof(uint64_t));
+        g_stackCount++;
+    }
+    s->count++;
+    g_samples++;
+}
+
+static ProfSample g_batch[BATCH];
+
+static void drain() {
+    while (true) {
+        int n = montauk::prof_read(g_batch, BATCH);
+        if (n <= 0) return;
+        for (int i = 0; i < n; i++) add_sample(g_batch[i]);
+    }
+}
+
+// ---- Report ----
+
+struct Frame {
+    Image* image;
+    const Symbol* sym;
+    uint64_t addr;           // Used when sym is nullptr
+};
+
+// Frame `i` of a stack. Return addresses point after the call, so the
+// caller is looked up one byte back.
+static Frame resolve(const Stack& s, int i) {
+    bool kernel = i == 0 && (s.flags & Montauk::PROF_KERNEL);
+    Image* image = kernel ? g_kernel : image_of(s.pid);
+    uint64_t addr = i == 0 ? s.ip[0] : s.ip[i] - 1;
+    Frame f{image, lookup(image, addr), s.ip[i]};
+    return f;
+}
+
+static void put_frame(Out& out, const Frame& f) {
+    if (f.sym == nullptr) {
+        put_hex(out, f.addr);
+        return;
+    }
+    char name[NAME_MAX];
+    demangle(f.image->strtab + f.sym->name, name, sizeof(name));
+    // ';' separates frames in folded output
+    for (int i = 0; name[i]; i++) {
+        if (name[i] == ';' || name[i] == ' ') name[i] = '_';
+    }
+    put(out, name);
+}
+
+static bool same_function(const Frame& a, const Frame& b) {
+    if (a.sym || b.sym) return a.sym == b.sym;
+    return a.addr == b.addr;
+}
+
+struct Func {
+    Frame frame;
+    uint64_t self;
+    uint64_t total;
+};
+
+static void write_flat(Out& out, uint64_t dropped) {
+    Func* funcs = nullptr;
+    int count = 0, cap = 0;
+
+    for (uint32_t i = 0; i < g_stackCap; i++) {
+        const Stack& s = g_stacks[i];
+        if (s.depth == 0) continue;
+
+        Frame frames[Montauk::PROF_MAX_DEPTH];
+        for (int d = 0; d < s.depth; d++) {
+            frames[d] = resolve(s, d);
+
+            // Recursion counts once towards a function's total
+            bool seen = false;
+            for (int e = 0; e < d && !seen; e++) seen = same_function(frames[e], frames[d]);
+            if (seen) continue;
+
+            int f = 0;
+            while (f < count && !same_function(funcs[f].frame, frames[d])) f++;
+            if (f == count) {
+                if (count == cap) {
+                    cap = cap ? cap * 2 : 256;
+                    auto* grown = (Func*)montauk::realloc(funcs, (uint64_t)cap * sizeof(Func));
+                    if (!grown) break;
+                    funcs = grown;
+                }
+                funcs[count++] = {frames[d], 0, 0};
+            }
+            funcs[f].total += s.count;
+            if (d == 0) funcs[f].self += s.count;
+        }
+    }
+
+    // Most self time first
+    for (int i = 1; i < count; i++) {
+        Func tmp = funcs[i];
+        int j = i - 1;
+        while (j >= 0 && funcs[j].self < tmp.self) {
+            funcs[j + 1] = funcs[j];
+            j--;
+        }
+        funcs[j + 1] = tmp;
+    }
+
+    put(out, "Samples: ");
+    put_u64(out, g_samples);
+    if (dropped) {
+        put(out, " (");
+        put_u64(out, dropped);
+        put(out, " dropped)");
+    }
+    put(out, ", one per CPU every ");
+    put_u64(out, 1000 / Montauk::PROF_HZ);
+    put(out, " ms\n\n");
+    put(out, "    self   self%   total  total%  function\n");
+
+    for (int i = 0; i < count && i < TOP_FUNCS; i++) {
+        const Func& f = funcs[i];
+        put_u64(out, f.self, 8);
+        put_percent(out, f.self, g_samples, 8);
+        put_u64(out, f.total, 8);
+        put_percent(out, f.total, g_samples, 8);
+        put(out, "  ");
+        put_frame(out, f.frame);
+        if (f.frame.image) {
+            put(out, "  [");
+            put(out, f.frame.image == g_kernel ? "kernel" : f.frame.image->shortName);
+            put(out, "]");
+        }
+        put(out, "\n");
+    }
+    montauk::mfree(funcs);
+}
+
+// One line per distinct stack, root first: "shell.elf;main;run;parse 12"
+static void write_folded(Out& out) {
+    for (uint32_t i = 0; i < g_stackCap; i++) {
+        const Stack& s = g_stacks[i];
+        if (s.depth == 0) continue;
+
+        Image* image = image_of(s.pid);
+        if (image) {
+            put(out, image->shortName);
+        } else {
+            put(out, "pid");
+            put_u64(out, (uint64_t)s.pid);
+        }
+        if (s.flags & Montauk::PROF_KERNEL) put(out, ";[kernel]");
+
+        for (int d = s.depth - 1; d >= 0; d--) {
+            put(out, ";");
+            put_frame(out, resolve(s, d));
+        }
+        put(out, " ");
+        put_u64(out, s.count);
+        put(out, "\n");
+    }
+}
+
+// ---- Arguments ----
+
+static void usage() {
+    montauk::print("usage: prof [-p pid] [-t ms] [-f] [-o file.folded] [command [args]]\n");
+    montauk::exit(1);
+}
+
+extern "C" void _start() {
+    char args[512];
+    montauk::getargs(args, sizeof(args));
+
+    int pid = -1;
+    uint64_t ms = 0;
+    bool folded = false;
+    char outPath[256] = "";
+    char command[256] = "";
+    const char* commandArgs = nullptr;
+
+    const char* p = args;
+    char w[256];
+    while (true) {
+        const char* rest = montauk::next_word(p, w, sizeof(w));
+        if (w[0] == '\0') break;
+        if (montauk::streq(w, "-p")) {
+            p = montauk::next_word(rest, w, sizeof(w));
+            if (w[0] < '0' || w[0] > '9') usage();
+            pid = (int)montauk::parse_u64(w);
+        } else if (montauk::streq(w, "-t")) {
+            p = montauk::next_word(rest, w, sizeof(w));
+            ms = montauk::parse_u64(w);
+        } else if (montauk::streq(w, "-f")) {
+            folded = true;
+            p = rest;
+        } else if (montauk::streq(w, "-o")) {
+            p = montauk::next_word(rest, outPath, sizeof(outPath));
+            if (outPath[0] == '\0') usage();
+        } else if (w[0] == '-') {
+            usage();
+        } else {
+            montauk::strcpy(command, w);
+            commandArgs = montauk::skip_spaces(rest);
+            if (*commandArgs == '\0') commandArgs = nullptr;
+            break;
+        }
+    }
+    if (command[0] && pid >= 0) usage();
+
+    g_kernel = find_image(KERNEL_IMAGE);
+    bool child = false;
+
+    if (command[0]) {
+        char path[300];
+        bool direct = false;
+        for (int i = 0; command[i]; i++) {
+            if (command[i] == '/' || command[i] == ':') direct = true;
+        }
+        if (direct) {
+            montauk::strcpy(path, command);
+        } else {
+            montauk::strcpy(path, "0:/os/");
+            montauk::strcpy(path + 6, command);
+            montauk::strcpy(path + 6 + montauk::slen(command), ".elf");
+        }
+
+        pid = montauk::spawn(path, commandArgs);
+        if (pid < 0) {
+            montauk::print("prof: cannot run ");
+            montauk::print(path);
+            montauk::print("\n");
+            montauk::exit(1);
+        }
+        child = true;
+    } else if (ms == 0) {
+        ms = DEFAULT_MS;
+    }
+
+    refresh_procs();
+    if (pid >= 0 && !alive(pid)) {
+        montauk::print("prof: no such process\n");
+        montauk::exit(1);
+    }
+
+    if (montauk::prof_ctl(true, pid) < 0) {
+        montauk::print("prof: cannot start the profiler\n");
+        montauk::exit(1);
+    }
+
+    // Drain while sampling: the kernel keeps only about two seconds
+    uint64_t until = ms ? montauk::get_milliseconds() + ms : 0;
+    while (true) {
+        montauk::sleep_ms(DRAIN_MS);
+        drain();
+        refresh_procs();
+        if (pid >= 0 && !alive(pid)) break;
+        if (until && montauk::get_milliseconds() >= until) break;
+    }
+
+    uint64_t dropped = (uint64_t)montauk::prof_ctl(false);
+    drain();
+    if (child) montauk::waitpid(pid);
+
+    if (g_samples == 0) {
+        montauk::print("prof: no samples recorded\n");
+        montauk::exit(0);
+    }
+
+    if (outPath[0]) {
+        Out file;
+        write_folded(file);
+        int fd = montauk::fcreate(outPath);
+        if (fd < 0) {
+            montauk::print("prof: cannot create ");
+            montauk::print(outPath);
+            montauk::print("\n");
+            montauk::exit(1);
+        }
+        montauk::fwrite(fd, (const uint8_t*)file.data, 0, file.len);
+        montauk::close(fd);
+    }
+
+    Out out;
+    if (folded) write_folded(out);
+    else write_flat(out, dropped);
+    if (out.data) montauk::print(out.data);
+    montauk::exit(0);
+}
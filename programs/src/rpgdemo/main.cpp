@@ -14,6 +14,7 @@
 #include <engine/engine.h>
 #include <engine/sprite.h>
 #include <engine/tilemap.h>
+#include <engine/render_queue.h>
 #include <engine/input.h>
 #include <engine/audio.h>
 #include <engine/ui.h>
@@ -124,6 +125,9 @@ static Enemy g_enemies[MAX_ENEMIES];
 static int g_enemy_count = 0;
 static Decoration g_decor[MAX_DECORATIONS];
 static int g_decor_count = 0;
+
+// Solid decorations' collision boxes, for nearby-only lookups
+static SpatialHash g_solids;
 static Chest g_chests[MAX_CHESTS];
 static int g_chest_count = 0;
 
@@ -140,51 +144,40 @@ static float g_dialog_timer = 0;
 // Asset loading
 // ============================================================================
 
-static bool load_assets() {
-    const char* base = "0:/apps/rpgdemo/";
+static AssetPack g_pack;
+
+// Sheets come from the pack mkpack builds (frame sizes are recorded in
+// it); a sheet missing from it falls back to decoding `name`.png
+static bool load_sheet(Spritesheet& sheet, const char* name, int fw = 0, int fh = 0) {
+    if (sheet.load(g_pack, name, fw, fh)) return true;
     char path[128];
+    snprintf(path, sizeof(path), "0:/apps/rpgdemo/%s.png", name);
+    return sheet.load(path, fw, fh);
+}
 
-    auto make_path = [&](const char* file) {
-        snprintf(path, sizeof(path), "%s%s", base, file);
-    };
+static bool load_assets() {
+    g_pack.open("0:/apps/rpgdemo/assets.pak");
 
     // Player (32x32 frames, 6 columns x 10 rows)
-    make_path("Player.png");
-    if (!g_spr_player.load(path, SPR_W, SPR_H)) return false;
+    if (!load_sheet(g_spr_player, "Player", SPR_W, SPR_H)) return false;
 
     // Skeleton (same layout as player)
-    make_path("Skeleton.png");
-    if (!g_spr_skeleton.load(path, SPR_W, SPR_H)) return false;
+    if (!load_sheet(g_spr_skeleton, "Skeleton", SPR_W, SPR_H)) return false;
 
     // Slime (64x64 frames)
-    make_path("Slime_Green.png");
-    g_spr_slime.load(path, 64, 64); // not fatal if missing
+    load_sheet(g_spr_slime, "Slime_Green", 64, 64); // not fatal if missing
 
     // Tiles (single 16x16 images)
-    make_path("Grass_Middle.png");
-    if (!g_spr_grass.load(path, TILE_SIZE, TILE_SIZE)) return false;
-
-    make_path("Path_Middle.png");
-    if (!g_spr_path.load(path, TILE_SIZE, TILE_SIZE)) return false;
-
-    make_path("Water_Middle.png");
-    if (!g_spr_water.load(path, TILE_SIZE, TILE_SIZE)) return false;
+    if (!load_sheet(g_spr_grass, "Grass_Middle", TILE_SIZE, TILE_SIZE)) return false;
+    if (!load_sheet(g_spr_path, "Path_Middle", TILE_SIZE, TILE_SIZE)) return false;
+    if (!load_sheet(g_spr_water, "Water_Middle", TILE_SIZE, TILE_SIZE)) return false;
 
     // Decorations
-    make_path("Oak_Tree.png");
-    g_spr_tree.load(path);
-
-    make_path("Oak_Tree_Small.png");
-    g_spr_tree_small.load(path, 32, 48);
-
-    make_path("House.png");
-    g_spr_house.load(path);
-
-    make_path("Chest.png");
-    g_spr_chest.load(path, TILE_SIZE, TILE_SIZE);
-
-    make_path("Fences.png");
-    g_spr_fences.load(path, TILE_SIZE, TILE_SIZE);
+    load_sheet(g_spr_tree, "Oak_Tree");
+    load_sheet(g_spr_tree_small, "Oak_Tree_Small", 32, 48);
+    load_sheet(g_spr_house, "House");
+    load_sheet(g_spr_chest, "Chest", TILE_SIZE, TILE_SIZE);
+    load_sheet(g_spr_fences, "Fences", TILE_SIZE, TILE_SIZE);
 
     // Procedural gravestone sprite (16x16)
     {
@@ -298,6 +291,8 @@ static void add_decoration(float x, float y, Spritesheet* sheet,
     d.col_h = ch;
     d.frame_col = fcol;
     d.frame_row = frow;
+    if (solid)
+        g_solids.insert({ x + cx, y + cy, cw, ch }, g_decor_count - 1);
 }
 
 static void add_chest(float x, float y) {
@@ -463,6 +458,7 @@ static void generate_world() {
     // Clear occupancy grid
     for (int i = 0; i < MAP_W * MAP_H; i++)
         g_occ[i] = 0;
+    g_solids.init(2 * TILE_SIZE);
 
     // Initialize tilemap
     g_map.alloc(MAP_W, MAP_H, TILE_SIZE);
@@ -600,14 +596,7 @@ static void update_camera() {
 }
 
 static bool check_decoration_collision(float x, float y, float w, float h) {
-    for (int i = 0; i < g_decor_count; i++) {
-        Decoration& d = g_decor[i];
-        if (!d.solid) continue;
-        AABB a = { x, y, w, h };
-        AABB b = { d.x + d.col_x, d.y + d.col_y, d.col_w, d.col_h };
-        if (a.overlaps(b)) return true;
-    }
-    return false;
+    return g_solids.any({ x, y, w, h });
 }
 
 static void update_player(float dt) {
@@ -803,7 +792,7 @@ static void update_interactions() {
     }
 }
 
-static void update(float dt) {
+static void update() {
     if (g_player.health <= 0) {
         // Game over - respawn after pressing space
         if (g_input.key_just_pressed(key::SPACE)) {
@@ -811,11 +800,16 @@ static void update(float dt) {
             g_player.x = 24 * TILE_SIZE;
             g_player.y = 22 * TILE_SIZE;
         }
+        while (g_engine.fixed_step()) {}
         return;
     }
 
-    update_player(dt);
-    update_enemies(dt);
+    // Movement and combat in fixed steps; key presses and the camera
+    // once per frame, so a press is never missed or seen twice
+    while (g_engine.fixed_step()) {
+        update_player(g_engine.fixed_dt);
+        update_enemies(g_engine.fixed_dt);
+    }
     update_interactions();
     update_camera();
 }
@@ -824,28 +818,9 @@ static void update(float dt) {
 // Rendering
 // ============================================================================
 
-// Y-sort helper for draw ordering
-struct DrawEntry {
-    float y;
-    int type;   // 0=decoration, 1=player, 2=enemy, 3=chest
-    int index;
-};
-
-static DrawEntry g_draw_list[MAX_DECORATIONS + MAX_ENEMIES + MAX_CHESTS + 1];
-static int g_draw_count = 0;
-
-static void sort_draw_list() {
-    // Simple insertion sort (small N)
-    for (int i = 1; i < g_draw_count; i++) {
-        DrawEntry tmp = g_draw_list[i];
-        int j = i - 1;
-        while (j >= 0 && g_draw_list[j].y > tmp.y) {
-            g_draw_list[j + 1] = g_draw_list[j];
-            j--;
-        }
-        g_draw_list[j + 1] = tmp;
-    }
-}
+// World sprites go through one queue, y-sorted by their feet
+static RenderQueue g_queue;
+static constexpr int LAYER_WORLD = 0;
 
 static void render() {
     int cam_x = (int)g_cam_x;
@@ -855,101 +830,64 @@ static void render() {
     g_map.draw(g_engine.pixels, g_engine.screen_w, g_engine.screen_h,
                cam_x, cam_y, SCALE);
 
-    // Build Y-sorted draw list for entities and decorations
-    g_draw_count = 0;
+    g_queue.begin();
 
     for (int i = 0; i < g_decor_count; i++) {
-        Decoration& dc = g_decor[i];
-        float h = 0;
-        if (dc.sheet) {
-            h = (dc.frame_col >= 0) ? (float)dc.sheet->frame_h
-                                    : (float)dc.sheet->height;
+        Decoration& d = g_decor[i];
+        if (!d.sheet || !d.sheet->pixels) continue;
+        int sx = (int)(d.x * SCALE) - cam_x * SCALE;
+        int sy = (int)(d.y * SCALE) - cam_y * SCALE;
+        if (d.frame_col >= 0 && d.frame_row >= 0) {
+            g_queue.submit_frame(d.sheet, d.frame_col, d.frame_row, sx, sy, SCALE,
+                                 LAYER_WORLD, d.y + (float)d.sheet->frame_h);
+        } else {
+            g_queue.submit_region(d.sheet, 0, 0, d.sheet->width, d.sheet->height,
+                                  sx, sy, SCALE, LAYER_WORLD, d.y + (float)d.sheet->height);
         }
-        g_draw_list[g_draw_count++] = { dc.y + h, 0, i };
     }
 
     for (int i = 0; i < g_chest_count; i++) {
-        g_draw_list[g_draw_count++] = { g_chests[i].y + TILE_SIZE, 3, i };
+        Chest& c = g_chests[i];
+        if (c.collected) continue;
+        int cx = (int)(c.x * SCALE) - cam_x * SCALE;
+        int cy = (int)(c.y * SCALE) - cam_y * SCALE;
+        // Frame 0 = closed; opened chests are darkened slightly
+        g_queue.submit_frame(&g_spr_chest, 0, 0, cx, cy, SCALE,
+                             LAYER_WORLD, c.y + TILE_SIZE, false,
+                             c.opened ? 0x40000000 : 0);
     }
 
-    g_draw_list[g_draw_count++] = { g_player.y + SPR_H, 1, 0 };
+    // Player, flashing when invincible
+    bool visible = true;
+    if (g_player.hit_timer > 0) {
+        visible = ((int)(g_player.hit_timer * 10) % 2 == 0);
+    }
+    if (visible) {
+        int px = (int)(g_player.x * SCALE) - cam_x * SCALE;
+        int py = (int)(g_player.y * SCALE) - cam_y * SCALE;
+        g_queue.submit(g_player.sprite, px, py, SCALE, LAYER_WORLD, g_player.y + SPR_H);
+    }
 
     for (int i = 0; i < g_enemy_count; i++) {
-        if (!g_enemies[i].active) continue;
-        float bottom = g_enemies[i].y + (g_enemies[i].type == 1 ? 64 : SPR_H);
-        g_draw_list[g_draw_count++] = { bottom, 2, i };
+        Enemy& e = g_enemies[i];
+        if (!e.active) continue;
+        int ex = (int)(e.x * SCALE) - cam_x * SCALE;
+        int ey = (int)(e.y * SCALE) - cam_y * SCALE;
+        float bottom = e.y + (e.type == 1 ? 64 : SPR_H);
+        g_queue.submit(e.sprite, ex, ey, SCALE, LAYER_WORLD, bottom);
     }
 
-    sort_draw_list();
-
-    // Render sorted entities
-    for (int i = 0; i < g_draw_count; i++) {
-        DrawEntry& de = g_draw_list[i];
-
-        if (de.type == 0) {
-            // Decoration
-            Decoration& d = g_decor[de.index];
-            if (d.sheet && d.sheet->pixels) {
-                int sx = (int)(d.x * SCALE) - cam_x * SCALE;
-                int sy = (int)(d.y * SCALE) - cam_y * SCALE;
-                if (d.frame_col >= 0 && d.frame_row >= 0) {
-                    d.sheet->draw_frame(g_engine.pixels, g_engine.screen_w,
-                                        g_engine.screen_h, d.frame_col,
-                                        d.frame_row, sx, sy, SCALE);
-                } else {
-                    d.sheet->draw_region(g_engine.pixels, g_engine.screen_w,
-                                         g_engine.screen_h, 0, 0,
-                                         d.sheet->width, d.sheet->height,
-                                         sx, sy, SCALE);
-                }
-            }
-        } else if (de.type == 1) {
-            // Player
-            int px = (int)(g_player.x * SCALE) - cam_x * SCALE;
-            int py = (int)(g_player.y * SCALE) - cam_y * SCALE;
-
-            // Flash when invincible
-            bool visible = true;
-            if (g_player.hit_timer > 0) {
-                visible = ((int)(g_player.hit_timer * 10) % 2 == 0);
-            }
+    g_queue.flush(g_engine.pixels, g_engine.screen_w, g_engine.screen_h);
 
-            if (visible) {
-                g_player.sprite.draw(g_engine.pixels, g_engine.screen_w,
-                                     g_engine.screen_h, px, py, SCALE);
-            }
-        } else if (de.type == 2) {
-            // Enemy
-            Enemy& e = g_enemies[de.index];
-            int ex = (int)(e.x * SCALE) - cam_x * SCALE;
-            int ey = (int)(e.y * SCALE) - cam_y * SCALE;
-            e.sprite.draw(g_engine.pixels, g_engine.screen_w,
-                          g_engine.screen_h, ex, ey, SCALE);
-
-            // Health bar above enemy
-            if (e.health < e.max_health) {
-                draw_bar(g_engine, ex + 4, ey - 8, 56, 6,
-                         e.health, e.max_health,
-                         0xFFCC3333, 0xFF333333, 0xFF000000);
-            }
-        } else if (de.type == 3) {
-            // Chest
-            Chest& c = g_chests[de.index];
-            int cx = (int)(c.x * SCALE) - cam_x * SCALE;
-            int cy = (int)(c.y * SCALE) - cam_y * SCALE;
-
-            if (!c.collected && g_spr_chest.pixels) {
-                // Draw chest (frame 0 = closed, use tinting for opened)
-                g_spr_chest.draw_frame(g_engine.pixels, g_engine.screen_w,
-                                       g_engine.screen_h, 0, 0,
-                                       cx, cy, SCALE);
-                if (c.opened) {
-                    // Darken opened chests slightly
-                    g_engine.fill_rect_alpha(cx, cy, TILE_SIZE * SCALE,
-                                             TILE_SIZE * SCALE, 0x40000000);
-                }
-            }
-        }
+    // Health bars above enemies, over the world
+    for (int i = 0; i < g_enemy_count; i++) {
+        Enemy& e = g_enemies[i];
+        if (!e.active || e.health >= e.max_health) continue;
+        int ex = (int)(e.x * SCALE) - cam_x * SCALE;
+        int ey = (int)(e.y * SCALE) - cam_y * SCALE;
+        draw_bar(g_engine, ex + 4, ey - 8, 56, 6,
+                 e.health, e.max_health,
+                 0xFFCC3333, 0xFF333333, 0xFF000000);
     }
 
     // ---- HUD ----
@@ -1063,7 +1001,7 @@ extern "C" void _start() {
         }
 
         // Update
-        update(g_engine.dt);
+        update();
 
         // Render
         render();
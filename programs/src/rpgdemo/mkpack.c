@@ -0,0 +1,128 @@
+/*
+ * mkpack.c
+ * Build-time tool: decode PNG spritesheets into an engine asset pack
+ * Usage: mkpack <out.pak> <name>[:<W>x<H>]=<sheet.png> ...
+ * Copyright (c) 2026 Daniel Hammer
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define STBI_ONLY_PNG
+#define STB_IMAGE_IMPLEMENTATION
+#include "gui/stb_image.h"
+
+#include "engine/assetpack.h"
+
+typedef struct {
+    unsigned char* data;
+    size_t len, cap;
+} Buf;
+
+static void buf_append(Buf* b, const void* src, size_t len) {
+    if (b->len + len > b->cap) {
+        size_t nc = b->cap ? b->cap * 2 : 65536;
+        while (nc < b->len + len) nc *= 2;
+        b->data = (unsigned char*)realloc(b->data, nc);
+        if (!b->data) { fprintf(stderr, "mkpack: out of memory\n"); exit(1); }
+        b->cap = nc;
+    }
+    memcpy(b->data + b->len, src, len);
+    b->len += len;
+}
+
+static Buf g_entries;    // AssetPackEntry records
+static Buf g_pixels;     // the sheets they point at
+
+// Decode one sheet and convert it the way Spritesheet::load does at
+// runtime: stb's R,G,B,A bytes become 0xAARRGGBB
+static int add_sheet(const char* spec) {
+    const char* eq = strchr(spec, '=');
+    if (!eq) return 0;
+
+    AssetPackEntry e;
+    memset(&e, 0, sizeof(e));
+    size_t nameLen = (size_t)(eq - spec);
+    const char* colon = memchr(spec, ':', nameLen);
+    if (colon) {
+        if (sscanf(colon + 1, "%ux%u", &e.frameW, &e.frameH) != 2) return 0;
+        nameLen = (size_t)(colon - spec);
+    }
+    if (nameLen == 0 || nameLen >= ASSET_NAME_MAX) return 0;
+    memcpy(e.name, spec, nameLen);
+
+    const char* path = eq + 1;
+    int w, h, channels;
+    unsigned char* img = stbi_load(path, &w, &h, &channels, 4);
+    if (!img) {
+        fprintf(stderr, "mkpack: %s: %s\n", path, stbi_failure_reason());
+        exit(1);
+    }
+
+    e.width = (uint32_t)w;
+    e.height = (uint32_t)h;
+    if (e.frameW == 0 || e.frameH == 0) {
+        e.frameW = e.width;
+        e.frameH = e.height;
+    }
+
+    static const unsigned char zero[ASSET_PIXEL_ALIGN];
+    buf_append(&g_pixels, zero, (ASSET_PIXEL_ALIGN - g_pixels.len % ASSET_PIXEL_ALIGN) % ASSET_PIXEL_ALIGN);
+    e.pixelsOff = (uint32_t)g_pixels.len;
+
+    for (size_t i = 0; i < (size_t)w * h; i++) {
+        const unsigned char* p = img + i * 4;
+        uint32_t argb = ((uint32_t)p[3] << 24) | ((uint32_t)p[0] << 16) |
+                        ((uint32_t)p[1] << 8) | p[2];
+        unsigned char le[4] = {
+            (unsigned char)argb, (unsigned char)(argb >> 8),
+            (unsigned char)(argb >> 16), (unsigned char)(argb >> 24),
+        };
+        buf_append(&g_pixels, le, 4);
+    }
+    stbi_image_free(img);
+
+    buf_append(&g_entries, &e, sizeof(e));
+    return 1;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        fprintf(stderr, "usage: mkpack <out.pak> <name>[:<W>x<H>]=<sheet.png> ...\n");
+        return 1;
+    }
+
+    for (int i = 2; i < argc; i++) {
+        if (!add_sheet(argv[i])) {
+            fprintf(stderr, "mkpack: bad sheet spec '%s'\n", argv[i]);
+            return 1;
+        }
+    }
+    uint32_t count = (uint32_t)(g_entries.len / sizeof(AssetPackEntry));
+
+    // Rebase the pixel offsets past the header and entry table, keeping
+    // them aligned
+    size_t base = sizeof(AssetPackHeader) + g_entries.len;
+    size_t pad = (ASSET_PIXEL_ALIGN - base % ASSET_PIXEL_ALIGN) % ASSET_PIXEL_ALIGN;
+    base += pad;
+    AssetPackEntry* entries = (AssetPackEntry*)g_entries.data;
+    for (uint32_t i = 0; i < count; i++) entries[i].pixelsOff += (uint32_t)base;
+
+    AssetPackHeader h;
+    memcpy(h.magic, ASSET_PACK_MAGIC, sizeof(h.magic));
+    h.count = count;
+    h.size = (uint32_t)(base + g_pixels.len);
+
+    static const unsigned char zero[ASSET_PIXEL_ALIGN];
+    FILE* out = fopen(argv[1], "wb");
+    if (!out) { perror(argv[1]); return 1; }
+    fwrite(&h, sizeof(h), 1, out);
+    fwrite(g_entries.data, g_entries.len, 1, out);
+    if (pad) fwrite(zero, pad, 1, out);
+    if (g_pixels.len) fwrite(g_pixels.data, g_pixels.len, 1, out);
+    if (fclose(out) != 0) { perror(argv[1]); return 1; }
+
+    printf("mkpack: %u sheets, %u bytes\n", count, h.size);
+    return 0;
+}
@@ -0,0 +1,476 @@
+/*
+ * jpegenc.cpp
+ * Baseline JPEG encoder for 0xAARRGGBB screen captures
+ * Copyright (c) 2026 Daniel Hammer
+ */
+
+#include "jpegenc.hpp"
+#include <montauk/heap.h>
+#include <montauk/string.h>
+
+// Colour conversion and the forward DCT work on eight 16-bit lanes at a
+// time: one row of a block per vector, so the column pass of the AAN DCT
+// is plain vector arithmetic across the eight rows, and the row pass the
+// same after a transpose. The AAN scale factors it leaves on each
+// coefficient are folded into the quantiser reciprocals, so the only
+// per-coefficient work after the DCT is one multiply and the entropy
+// coder.
+
+namespace jpegenc {
+
+    namespace {
+
+        typedef short v8s __attribute__((vector_size(16)));
+        typedef uint16_t v8u16 __attribute__((vector_size(16)));
+        typedef int32_t v4i32 __attribute__((vector_size(16)));
+        typedef int32_t v4i32u __attribute__((vector_size(16), may_alias, aligned(1)));
+        typedef long long v2i64 __attribute__((vector_size(16)));
+        typedef float v4f __attribute__((vector_size(16)));
+
+        // ---- Tables (ITU T.81 Annex K) ----
+
+        const uint8_t zigzag[64] = {
+             0,  1,  8, 16,  9,  2,  3, 10, 17, 24, 32, 25, 18, 11,  4,  5,
+            12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13,  6,  7, 14, 21, 28,
+            35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+            58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63,
+        };
+
+        const uint8_t lumaQuant[64] = {
+            16, 11, 10, 16,  24,  40,  51,  61,  12, 12, 14, 19,  26,  58,  60,  55,
+            14, 13, 16, 24,  40,  57,  69,  56,  14, 17, 22, 29,  51,  87,  80,  62,
+            18, 22, 37, 56,  68, 109, 103,  77,  24, 35, 55, 64,  81, 104, 113,  92,
+            49, 64, 78, 87, 103, 121, 120, 101,  72, 92, 95, 98, 112, 100, 103,  99,
+        };
+
+        const uint8_t chromaQuant[64] = {
+            17, 18, 24, 47, 99, 99, 99, 99,  18, 21, 26, 66, 99, 99, 99, 99,
+            24, 26, 56, 99, 99, 99, 99, 99,  47, 66, 99, 99, 99, 99, 99, 99,
+            99, 99, 99, 99, 99, 99, 99, 99,  99, 99, 99, 99, 99, 99, 99, 99,
+            99, 99, 99, 99, 99, 99, 99, 99,  99, 99, 99, 99, 99, 99, 99, 99,
+        };
+
+        // Code counts per length 1..16, then the symbols in code order
+        const uint8_t dcLumaBits[16] = { 0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0 };
+        const uint8_t dcChromaBits[16] = { 0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0 };
+        const uint8_t dcValues[12] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11 };
+
+        const uint8_t acLumaBits[16] = { 0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7d };
+        const uint8_t acLumaValues[162] = {
+            0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07,
+            0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xa1, 0x08, 0x23, 0x42, 0xb1, 0xc1, 0x15, 0x52, 0xd1, 0xf0,
+            0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0a, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x25, 0x26, 0x27, 0x28,
+            0x29, 0x2a, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
+            0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+            0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+            0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7,
+            0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5,
+            0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe1, 0xe2,
+            0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+            0xf9, 0xfa,
+        };
+
+        const uint8_t acChromaBits[16] = { 0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77 };
+        const uint8_t acChromaValues[162] = {
+            0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71,
+            0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91, 0xa1, 0xb1, 0xc1, 0x09, 0x23, 0x33, 0x52, 0xf0,
+            0x15, 0x62, 0x72, 0xd1, 0x0a, 0x16, 0x24, 0x34, 0xe1, 0x25, 0xf1, 0x17, 0x18, 0x19, 0x1a, 0x26,
+            0x27, 0x28, 0x29, 0x2a, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48,
+            0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68,
+            0x69, 0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+            0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5,
+            0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3,
+            0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda,
+            0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+            0xf9, 0xfa,
+        };
+
+        // cos(k * pi / 16) * sqrt(2), the scale the AAN DCT leaves on
+        // frequency k (1 for k = 0)
+        const float aanScale[8] = {
+            1.0f, 1.387039845f, 1.306562965f, 1.175875602f,
+            1.0f, 0.785694958f, 0.541196100f, 0.275899379f,
+        };
+
+        // Worst case one MCU can take: three blocks of 63 longest AC codes
+        // plus a DC code, every byte of it stuffed
+        constexpr uint64_t MaxMcuBytes = 2048;
+
+        struct Huffman {
+            uint16_t code[256];
+            uint8_t size[256];
+        };
+
+        struct Component {
+            alignas(16) float recip[64];    // zigzag order, AAN scale folded in
+            uint8_t table[64];              // zigzag order, as written to DQT
+            const Huffman* dc;
+            const Huffman* ac;
+            int lastDc;
+        };
+
+        struct Writer {
+            uint8_t* data;
+            uint8_t* p;
+            uint64_t capacity;
+            uint64_t acc;
+            int bits;
+            bool failed;
+        };
+
+        Huffman g_dcLuma, g_dcChroma, g_acLuma, g_acChroma;
+        bool g_tablesBuilt = false;
+
+        // Transposed position of each zigzag index: the DCT leaves
+        // horizontal frequency in the vector and vertical in the lane
+        uint8_t g_dctIndex[64];
+
+        void build_huffman(const uint8_t* bits, const uint8_t* values, Huffman* h) {
+            uint16_t code = 0;
+            int k = 0;
+            for (int len = 1; len <= 16; len++) {
+                for (int i = 0; i < bits[len - 1]; i++, k++) {
+                    h->code[values[k]] = code++;
+                    h->size[values[k]] = (uint8_t)len;
+                }
+                code <<= 1;
+            }
+        }
+
+        void build_tables() {
+            if (g_tablesBuilt) return;
+            build_huffman(dcLumaBits, dcValues, &g_dcLuma);
+            build_huffman(dcChromaBits, dcValues, &g_dcChroma);
+            build_huffman(acLumaBits, acLumaValues, &g_acLuma);
+            build_huffman(acChromaBits, acChromaValues, &g_acChroma);
+            for (int k = 0; k < 64; k++)
+                g_dctIndex[k] = (uint8_t)((zigzag[k] & 7) * 8 + (zigzag[k] >> 3));
+            g_tablesBuilt = true;
+        }
+
+        void init_component(Component* c, const uint8_t* base, int quality,
+                            const Huffman* dc, const Huffman* ac) {
+            int scale = quality < 50 ? 5000 / quality : 200 - quality * 2;
+            for (int k = 0; k < 64; k++) {
+                int n = zigzag[k];
+                int q = (base[n] * scale + 50) / 100;
+                if (q < 1) q = 1;
+                if (q > 255) q = 255;
+                c->table[k] = (uint8_t)q;
+                // 8 from the DCT and 2 from the doubled samples
+                c->recip[k] = 1.0f / ((float)q * aanScale[n >> 3] * aanScale[n & 7] * 16.0f);
+            }
+            c->dc = dc;
+            c->ac = ac;
+            c->lastDc = 0;
+        }
+
+        // ---- Output ----
+
+        bool reserve(Writer& w, uint64_t bytes) {
+            uint64_t used = (uint64_t)(w.p - w.data);
+            if (w.capacity - used >= bytes) return true;
+            uint64_t capacity = w.capacity * 2;
+            if (capacity < used + bytes) capacity = used + bytes;
+            auto* data = (uint8_t*)montauk::realloc(w.data, capacity);
+            if (data == nullptr) {
+                w.failed = true;
+                return false;
+            }
+            w.data = data;
+            w.p = data + used;
+            w.capacity = capacity;
+            return true;
+        }
+
+        void put_byte(Writer& w, uint8_t b) { *w.p++ = b; }
+
+        void put_word(Writer& w, uint16_t v) {
+            w.p[0] = (uint8_t)(v >> 8);
+            w.p[1] = (uint8_t)v;
+            w.p += 2;
+        }
+
+        void put_bytes(Writer& w, const uint8_t* src, int n) {
+            montauk::memcpy(w.p, src, n);
+            w.p += n;
+        }
+
+        // Appends the low `size` bits of `code` to the entropy-coded data,
+        // with a zero after every 0xFF byte. At most 27 bits at a time.
+        inline void put_bits(Writer& w, uint32_t code, int size) {
+            w.acc = (w.acc << size) | code;
+            w.bits += size;
+            while (w.bits >= 8) {
+                w.bits -= 8;
+                uint8_t b = (uint8_t)(w.acc >> w.bits);
+                *w.p++ = b;
+                if (b == 0xFF) *w.p++ = 0;
+            }
+        }
+
+        inline void put_symbol(Writer& w, const Huffman* h, int symbol, int value, int bits) {
+            // Negative values are sent as value - 1 in `bits` bits
+            uint32_t extra = (uint32_t)(value < 0 ? value - 1 : value) & ((1u << bits) - 1);
+            put_bits(w, ((uint32_t)h->code[symbol] << bits) | extra, h->size[symbol] + bits);
+        }
+
+        inline int magnitude_bits(int v) {
+            if (v == 0) return 0;
+            return 32 - __builtin_clz((unsigned)(v < 0 ? -v : v));
+        }
+
+        void write_headers(Writer& w, int width, int height, const Component& luma, const Component& chroma) {
+            static const uint8_t app0[] = {
+                0xFF, 0xE0, 0x00, 0x10, 'J', 'F', 'I', 'F', 0x00, 0x01, 0x01, 0x00,
+                0x00, 0x01, 0x00, 0x01, 0x00, 0x00,
+            };
+            put_word(w, 0xFFD8);
+            put_bytes(w, app0, sizeof(app0));
+
+            put_word(w, 0xFFDB);
+            put_word(w, 2 + 2 * 65);
+            put_byte(w, 0x00);
+            put_bytes(w, luma.table, 64);
+            put_byte(w, 0x01);
+            put_bytes(w, chroma.table, 64);
+
+            // Three components, all sampled 1x1
+            put_word(w, 0xFFC0);
+            put_word(w, 17);
+            put_byte(w, 8);
+            put_word(w, (uint16_t)height);
+            put_word(w, (uint16_t)width);
+            put_byte(w, 3);
+            for (int i = 0; i < 3; i++) {
+                put_byte(w, (uint8_t)(i + 1));
+                put_byte(w, 0x11);
+                put_byte(w, i == 0 ? 0 : 1);
+            }
+
+            put_word(w, 0xFFC4);
+            put_word(w, 2 + 4 * 17 + 2 * sizeof(dcValues) + 2 * sizeof(acLumaValues));
+            put_byte(w, 0x00);
+            put_bytes(w, dcLumaBits, 16);
+            put_bytes(w, dcValues, sizeof(dcValues));
+            put_byte(w, 0x10);
+            put_bytes(w, acLumaBits, 16);
+            put_bytes(w, acLumaValues, sizeof(acLumaValues));
+            put_byte(w, 0x01);
+            put_bytes(w, dcChromaBits, 16);
+            put_bytes(w, dcValues, sizeof(dcValues));
+            put_byte(w, 0x11);
+            put_bytes(w, acChromaBits, 16);
+            put_bytes(w, acChromaValues, sizeof(acChromaValues));
+
+            static const uint8_t sos[] = {
+                0xFF, 0xDA, 0x00, 0x0C, 0x03, 0x01, 0x00, 0x02, 0x11, 0x03, 0x11,
+                0x00, 0x3F, 0x00,
+            };
+            put_bytes(w, sos, sizeof(sos));
+        }
+
+        // ---- Transform ----
+
+        inline v8s splat(short k) { return (v8s){ k, k, k, k, k, k, k, k }; }
+
+        // x * k / 65536, truncated; k < 32768, so every constant below
+        // under 0.5 is applied as is and the rest as x -/+ x * fraction
+        __attribute__((target("sse2")))
+        inline v8s mulhi(v8s x, short k) { return __builtin_ia32_pmulhw128(x, splat(k)); }
+
+        // One 8-point AAN pass down the eight vectors (IJG jfdctfst)
+        __attribute__((target("sse2")))
+        inline void fdct_pass(v8s d[8]) {
+            v8s tmp0 = d[0] + d[7], tmp7 = d[0] - d[7];
+            v8s tmp1 = d[1] + d[6], tmp6 = d[1] - d[6];
+            v8s tmp2 = d[2] + d[5], tmp5 = d[2] - d[5];
+            v8s tmp3 = d[3] + d[4], tmp4 = d[3] - d[4];
+
+            v8s tmp10 = tmp0 + tmp3, tmp13 = tmp0 - tmp3;
+            v8s tmp11 = tmp1 + tmp2, tmp12 = tmp1 - tmp2;
+            d[0] = tmp10 + tmp11;
+            d[4] = tmp10 - tmp11;
+            v8s t = tmp12 + tmp13;
+            v8s z1 = t - mulhi(t, 19195);                  // * 0.707106781
+            d[2] = tmp13 + z1;
+            d[6] = tmp13 - z1;
+
+            tmp10 = tmp4 + tmp5;
+            tmp11 = tmp5 + tmp6;
+            tmp12 = tmp6 + tmp7;
+            v8s z5 = mulhi(tmp10 - tmp12, 25080);          // * 0.382683433
+            v8s z2 = tmp10 - mulhi(tmp10, 30068) + z5;     // * 0.541196100
+            v8s z4 = tmp12 + mulhi(tmp12, 20091) + z5;     // * 1.306562965
+            v8s z3 = tmp11 - mulhi(tmp11, 19195);          // * 0.707106781
+            v8s z11 = tmp7 + z3, z13 = tmp7 - z3;
+            d[5] = z13 + z2;
+            d[3] = z13 - z2;
+            d[1] = z11 + z4;
+            d[7] = z11 - z4;
+        }
+
+        __attribute__((target("sse2")))
+        inline void transpose(v8s d[8]) {
+            v4i32 a0 = (v4i32)__builtin_ia32_punpcklwd128(d[0], d[1]);
+            v4i32 a1 = (v4i32)__builtin_ia32_punpckhwd128(d[0], d[1]);
+            v4i32 a2 = (v4i32)__builtin_ia32_punpcklwd128(d[2], d[3]);
+            v4i32 a3 = (v4i32)__builtin_ia32_punpckhwd128(d[2], d[3]);
+            v4i32 a4 = (v4i32)__builtin_ia32_punpcklwd128(d[4], d[5]);
+            v4i32 a5 = (v4i32)__builtin_ia32_punpckhwd128(d[4], d[5]);
+            v4i32 a6 = (v4i32)__builtin_ia32_punpcklwd128(d[6], d[7]);
+            v4i32 a7 = (v4i32)__builtin_ia32_punpckhwd128(d[6], d[7]);
+
+            v2i64 b0 = (v2i64)__builtin_ia32_punpckldq128(a0, a2);
+            v2i64 b1 = (v2i64)__builtin_ia32_punpckhdq128(a0, a2);
+            v2i64 b2 = (v2i64)__builtin_ia32_punpckldq128(a1, a3);
+            v2i64 b3 = (v2i64)__builtin_ia32_punpckhdq128(a1, a3);
+            v2i64 b4 = (v2i64)__builtin_ia32_punpckldq128(a4, a6);
+            v2i64 b5 = (v2i64)__builtin_ia32_punpckhdq128(a4, a6);
+            v2i64 b6 = (v2i64)__builtin_ia32_punpckldq128(a5, a7);
+            v2i64 b7 = (v2i64)__builtin_ia32_punpckhdq128(a5, a7);
+
+            d[0] = (v8s)__builtin_ia32_punpcklqdq128(b0, b4);
+            d[1] = (v8s)__builtin_ia32_punpckhqdq128(b0, b4);
+            d[2] = (v8s)__builtin_ia32_punpcklqdq128(b1, b5);
+            d[3] = (v8s)__builtin_ia32_punpckhqdq128(b1, b5);
+            d[4] = (v8s)__builtin_ia32_punpcklqdq128(b2, b6);
+            d[5] = (v8s)__builtin_ia32_punpckhqdq128(b2, b6);
+            d[6] = (v8s)__builtin_ia32_punpcklqdq128(b3, b7);
+            d[7] = (v8s)__builtin_ia32_punpckhqdq128(b3, b7);
+        }
+
+        // Level-shifted Y, Cb and Cr of eight 0xAARRGGBB pixels, with
+        // 8-bit fixed-point BT.601 weights. Every sum stays inside 16 bits:
+        // the Y weights add up to 256 and are summed unsigned, the chroma
+        // ones to 0 with a rounding bias of 127 rather than 128. Samples
+        // come out doubled, which buys the truncating multiplies in the
+        // DCT a bit of precision and still cannot overflow its outputs.
+        __attribute__((target("sse2")))
+        inline void convert_row(const uint32_t* px, v8s& y, v8s& cb, v8s& cr) {
+            v4i32 p0 = *(const v4i32u*)px;
+            v4i32 p1 = *(const v4i32u*)(px + 4);
+            v4i32 mask = { 0xFF, 0xFF, 0xFF, 0xFF };
+            v8s r = __builtin_ia32_packssdw128((p0 >> 16) & mask, (p1 >> 16) & mask);
+            v8s g = __builtin_ia32_packssdw128((p0 >> 8) & mask, (p1 >> 8) & mask);
+            v8s b = __builtin_ia32_packssdw128(p0 & mask, p1 & mask);
+
+            v8u16 luma = ((v8u16)r * 77 + (v8u16)g * 150 + (v8u16)b * 29 + 128) >> 8;
+            y = ((v8s)luma - 128) << 1;
+            cb = ((b * 128 - r * 43 - g * 85 + 127) >> 8) << 1;
+            cr = ((r * 128 - g * 107 - b * 21 + 127) >> 8) << 1;
+        }
+
+        __attribute__((target("sse2")))
+        void encode_block(Writer& w, Component& c, v8s d[8]) {
+            fdct_pass(d);
+            transpose(d);
+            fdct_pass(d);
+
+            int16_t coef[64] __attribute__((aligned(16)));
+            for (int i = 0; i < 8; i++) *(v8s*)(coef + i * 8) = d[i];
+
+            // cvtps2dq rounds to nearest
+            int32_t q[64] __attribute__((aligned(16)));
+            for (int k = 0; k < 64; k += 4) {
+                v4f x = { (float)coef[g_dctIndex[k]], (float)coef[g_dctIndex[k + 1]],
+                          (float)coef[g_dctIndex[k + 2]], (float)coef[g_dctIndex[k + 3]] };
+                *(v4i32*)(q + k) = __builtin_ia32_cvtps2dq(x * *(const v4f*)(c.recip + k));
+            }
+
+            int diff = q[0] - c.lastDc;
+            c.lastDc = q[0];
+            if (diff > 2047) diff = 2047;
+            if (diff < -2047) diff = -2047;
+            int bits = magnitude_bits(diff);
+            put_symbol(w, c.dc, bits, diff, bits);
+
+            int run = 0;
+            for (int k = 1; k < 64; k++) {
+                int v = q[k];
+                if (v == 0) {
+                    run++;
+                    continue;
+                }
+                if (v > 1023) v = 1023;
+                if (v < -1023) v = -1023;
+                for (; run >= 16; run -= 16)
+                    put_bits(w, c.ac->code[0xF0], c.ac->size[0xF0]);
+                bits = magnitude_bits(v);
+                put_symbol(w, c.ac, (run << 4) | bits, v, bits);
+                run = 0;
+            }
+            if (run > 0) put_bits(w, c.ac->code[0x00], c.ac->size[0x00]);
+        }
+
+    }
+
+    __attribute__((target("sse2")))
+    bool encode_argb(const uint32_t* pixels, int width, int height, int stride,
+                     int quality, Output* out) {
+        out->data = nullptr;
+        out->size = 0;
+        if (width <= 0 || height <= 0 || width > 0xFFFF || height > 0xFFFF) return false;
+        if (quality < 1) quality = 1;
+        if (quality > 100) quality = 100;
+
+        build_tables();
+        Component components[3];
+        init_component(&components[0], lumaQuant, quality, &g_dcLuma, &g_acLuma);
+        init_component(&components[1], chromaQuant, quality, &g_dcChroma, &g_acChroma);
+        init_component(&components[2], chromaQuant, quality, &g_dcChroma, &g_acChroma);
+
+        // A screen at 4:4:4 rarely needs more than four bits a pixel, so
+        // one buffer of that size almost always holds the whole file
+        Writer w = {};
+        w.capacity = (uint64_t)width * height / 2 + 4096;
+        w.data = (uint8_t*)montauk::malloc(w.capacity);
+        if (w.data == nullptr) return false;
+        w.p = w.data;
+        write_headers(w, width, height, components[0], components[1]);
+
+        uint32_t edge[64] __attribute__((aligned(16)));
+        for (int by = 0; by < height && !w.failed; by += 8) {
+            for (int bx = 0; bx < width; bx += 8) {
+                if (!reserve(w, MaxMcuBytes)) break;
+
+                // Blocks over the right or bottom edge repeat the last
+                // column and row
+                const uint32_t* src = pixels + (uint64_t)by * stride + bx;
+                int srcStride = stride;
+                if (bx + 8 > width || by + 8 > height) {
+                    for (int y = 0; y < 8; y++) {
+                        int sy = by + y < height ? by + y : height - 1;
+                        for (int x = 0; x < 8; x++) {
+                            int sx = bx + x < width ? bx + x : width - 1;
+                            edge[y * 8 + x] = pixels[(uint64_t)sy * stride + sx];
+                        }
+                    }
+                    src = edge;
+                    srcStride = 8;
+                }
+
+                v8s y[8], cb[8], cr[8];
+                for (int row = 0; row < 8; row++)
+                    convert_row(src + row * srcStride, y[row], cb[row], cr[row]);
+                encode_block(w, components[0], y);
+                encode_block(w, components[1], cb);
+                encode_block(w, components[2], cr);
+            }
+        }
+
+        if (w.failed || !reserve(w, 4)) {
+            montauk::mfree(w.data);
+            return false;
+        }
+
+        // Pad the last byte with ones
+        if (w.bits > 0) put_bits(w, (1u << (8 - w.bits)) - 1, 8 - w.bits);
+        put_word(w, 0xFFD9);
+
+        out->data = w.data;
+        out->size = (uint64_t)(w.p - w.data);
+        return true;
+    }
+
+}
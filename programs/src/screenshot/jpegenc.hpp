@@ -0,0 +1,24 @@
+/*
+ * jpegenc.hpp
+ * Baseline JPEG encoder for 0xAARRGGBB screen captures
+ * Copyright (c) 2026 Daniel Hammer
+ */
+
+#pragma once
+#include <cstdint>
+
+namespace jpegenc {
+
+    struct Output {
+        uint8_t* data;      // montauk::malloc'd, the caller frees it
+        uint64_t size;
+    };
+
+    // Encodes `width` x `height` pixels, `stride` pixels apart row to row,
+    // as a baseline JFIF with 4:4:4 sampling, so coloured text keeps its
+    // edges. `quality` is the usual 1..100 IJG scale. False when out of
+    // memory or the size does not fit a JPEG.
+    bool encode_argb(const uint32_t* pixels, int width, int height, int stride,
+                     int quality, Output* out);
+
+}
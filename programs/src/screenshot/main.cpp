@@ -11,40 +11,13 @@
 #include <montauk/config.h>
 
 extern "C" {
-#include <string.h>
-#include <stdlib.h>
 #include <stdio.h>
-
-#define STBI_WRITE_NO_STDIO
-#include <gui/stb_image_write.h>
 }
 
-// ============================================================================
-// JPEG write callback - accumulates encoded bytes into a resizable buffer
-// ============================================================================
+#include "jpegenc.hpp"
 
-struct JpegBuffer {
-    uint8_t* data;
-    uint64_t size;
-    uint64_t capacity;
-};
-
-static void jpeg_write_callback(void* context, void* data, int size) {
-    JpegBuffer* buf = (JpegBuffer*)context;
-    if (size <= 0) return;
-
-    uint64_t needed = buf->size + (uint64_t)size;
-    if (needed > buf->capacity) {
-        uint64_t new_cap = buf->capacity * 2;
-        if (new_cap < needed) new_cap = needed;
-        uint8_t* new_data = (uint8_t*)montauk::realloc(buf->data, new_cap);
-        if (!new_data) return;
-        buf->data = new_data;
-        buf->capacity = new_cap;
-    }
-    montauk::memcpy(buf->data + buf->size, data, size);
-    buf->size += (uint64_t)size;
-}
+// 4:4:4 at this quality keeps UI text crisp at a fraction of quality 100's size
+static constexpr int JPEG_QUALITY = 92;
 
 // ============================================================================
 // Entry point
@@ -71,43 +44,27 @@ extern "C" void _start() {
         montauk::exit(1);
     }
 
-    // Copy framebuffer and convert from BGRA (0xAARRGGBB) to packed RGB
-    uint64_t rgb_size = (uint64_t)width * height * 3;
-    uint8_t* rgb = (uint8_t*)montauk::malloc(rgb_size);
-    if (!rgb) {
+    // Take the frame with a plain row copy, so the picture is the screen
+    // at the moment of the request rather than partway through an encode
+    uint32_t* pixels = (uint32_t*)montauk::malloc((uint64_t)width * height * 4);
+    if (!pixels) {
         montauk::print("screenshot: out of memory\n");
         montauk::exit(1);
     }
 
-    for (int y = 0; y < height; y++) {
-        uint32_t* src_row = (uint32_t*)((uint8_t*)hw_fb + y * pitch);
-        uint8_t* dst_row = rgb + y * width * 3;
-        for (int x = 0; x < width; x++) {
-            uint32_t px = src_row[x];
-            dst_row[x * 3 + 0] = (px >> 16) & 0xFF; // R
-            dst_row[x * 3 + 1] = (px >> 8)  & 0xFF; // G
-            dst_row[x * 3 + 2] = px & 0xFF;          // B
-        }
-    }
+    for (int y = 0; y < height; y++)
+        montauk::memcpy(pixels + (uint64_t)y * width, (uint8_t*)hw_fb + (uint64_t)y * pitch,
+                        (uint64_t)width * 4);
 
-    // Encode as JPEG (quality 100 - maximum quality)
-    JpegBuffer jpeg;
-    jpeg.data = (uint8_t*)montauk::malloc(256 * 1024);
-    jpeg.size = 0;
-    jpeg.capacity = 256 * 1024;
+    // Encoding and saving can wait for idle time; the compositor and the
+    // app in front should not lose a frame to them
+    montauk::set_priority(-1, Montauk::PRIO_BATCH);
 
-    if (!jpeg.data) {
-        montauk::mfree(rgb);
-        montauk::print("screenshot: out of memory for JPEG buffer\n");
-        montauk::exit(1);
-    }
+    jpegenc::Output jpeg;
+    bool ok = jpegenc::encode_argb(pixels, width, height, width, JPEG_QUALITY, &jpeg);
+    montauk::mfree(pixels);
 
-    int ok = stbi_write_jpg_to_func(jpeg_write_callback, &jpeg,
-                                     width, height, 3, rgb, 100);
-    montauk::mfree(rgb);
-
-    if (!ok || jpeg.size == 0) {
-        montauk::mfree(jpeg.data);
+    if (!ok) {
         montauk::print("screenshot: JPEG encoding failed\n");
         montauk::exit(1);
     }
@@ -15,13 +15,11 @@ static bool file_exists(const char* path) {
     return true;
 }
 
-// ---- Try to spawn an ELF at the given path ----
+// ---- Copy a candidate path out if a file is there ----
 
-static bool try_exec(const char* path, const char* args) {
+static bool try_path(const char* path, char* out, int outMax) {
     if (!file_exists(path)) return false;
-    int pid = montauk::spawn(path, args);
-    if (pid < 0) return false;
-    montauk::waitpid(pid);
+    scopy(out, path, outMax);
     return true;
 }
 
@@ -36,71 +34,180 @@ static void build_cwd_path(const char* name, char* out, int outMax) {
     scat(out, name, outMax);
 }
 
-// ---- Search and execute an external command ----
+// ---- Search for an external command ----
 
-int exec_external(const char* cmd, const char* args) {
+static bool is_direct_path(const char* cmd) {
+    if (has_drive_prefix(cmd) || cmd[0] == '/' || cmd[0] == '.') return true;
+    for (int i = 0; cmd[i]; i++) {
+        if (cmd[i] == '/') return true;
+    }
+    return false;
+}
+
+bool find_external(const char* cmd, char* out, int outMax) {
     char path[256];
-    const char* finalArgs = (args && args[0]) ? args : nullptr;
 
     // Strip leading "./" from command name
     const char* name = cmd;
     if (name[0] == '.' && name[1] == '/') name += 2;
 
     // 0. Direct paths are resolved by the kernel against the process CWD.
-    bool hasSlash = false;
-    for (int i = 0; cmd[i]; i++) {
-        if (cmd[i] == '/') {
-            hasSlash = true;
-            break;
-        }
-    }
-    if (has_drive_prefix(cmd) || cmd[0] == '/' || cmd[0] == '.' || hasSlash) {
-        if (try_exec(cmd, finalArgs)) return 0;
+    if (is_direct_path(cmd)) {
+        if (try_path(cmd, out, outMax)) return true;
         scopy(path, cmd, sizeof(path));
         scat(path, ".elf", sizeof(path));
-        if (try_exec(path, finalArgs)) return 0;
-        montauk::print(cmd);
-        montauk::print(": not found\n");
-        return 127;
+        return try_path(path, out, outMax);
     }
 
     // 1. Try as-is in CWD (exact name, e.g., "a.out" or "hello.elf")
     build_cwd_path(name, path, sizeof(path));
-    if (try_exec(path, finalArgs)) return 0;
+    if (try_path(path, out, outMax)) return true;
 
     // 2. Try with .elf extension in CWD
     build_cwd_path(name, path, sizeof(path));
     scat(path, ".elf", sizeof(path));
-    if (try_exec(path, finalArgs)) return 0;
+    if (try_path(path, out, outMax)) return true;
 
     // 3. Try 0:/os/<cmd>.elf
     scopy(path, "0:/os/", sizeof(path));
     scat(path, name, sizeof(path));
     scat(path, ".elf", sizeof(path));
-    if (try_exec(path, finalArgs)) return 0;
+    if (try_path(path, out, outMax)) return true;
 
     // 4. Try 0:/os/<cmd> (no extension)
     scopy(path, "0:/os/", sizeof(path));
     scat(path, name, sizeof(path));
-    if (try_exec(path, finalArgs)) return 0;
+    if (try_path(path, out, outMax)) return true;
 
     // 5. Try 0:/games/<cmd>.elf
     scopy(path, "0:/games/", sizeof(path));
     scat(path, name, sizeof(path));
     scat(path, ".elf", sizeof(path));
-    if (try_exec(path, finalArgs)) return 0;
+    if (try_path(path, out, outMax)) return true;
 
     // 6. If on a non-zero drive, also try drive root
     if (current_drive != 0) {
         build_drive_path(current_drive, name, path, sizeof(path));
-        if (try_exec(path, finalArgs)) return 0;
+        if (try_path(path, out, outMax)) return true;
 
         build_drive_path(current_drive, name, path, sizeof(path));
         scat(path, ".elf", sizeof(path));
-        if (try_exec(path, finalArgs)) return 0;
+        if (try_path(path, out, outMax)) return true;
     }
 
+    return false;
+}
+
+static void print_not_found(const char* cmd) {
     montauk::print(cmd);
-    montauk::print(": command not found\n");
-    return 127;
+    montauk::print(is_direct_path(cmd) ? ": not found\n" : ": command not found\n");
+}
+
+// ---- Search and execute an external command ----
+
+int exec_external(const char* cmd, const char* args) {
+    char path[256];
+    if (!find_external(cmd, path, sizeof(path))) {
+        print_not_found(cmd);
+        return 127;
+    }
+
+    int pid = montauk::spawn(path, (args && args[0]) ? args : nullptr);
+    if (pid < 0) {
+        montauk::print(cmd);
+        montauk::print(": cannot execute\n");
+        return 126;
+    }
+    montauk::waitpid(pid);
+    return 0;
+}
+
+// ---- Run a pipeline: a | b | c ----
+
+static constexpr int MAX_STAGES = 8;
+
+int run_pipeline(const char* line) {
+    // Split on unquoted '|' into stage command names and arguments
+    char stages[MAX_STAGES][256];
+    int count = 0;
+    int si = 0;
+    bool in_sq = false, in_dq = false;
+    for (const char* p = line; ; p++) {
+        if (*p == '\'' && !in_dq) in_sq = !in_sq;
+        else if (*p == '"' && !in_sq) in_dq = !in_dq;
+        if (*p == '\0' || (*p == '|' && !in_sq && !in_dq)) {
+            stages[count][si] = '\0';
+            while (si > 0 && stages[count][si - 1] == ' ') stages[count][--si] = '\0';
+            if (*skip_spaces(stages[count]) == '\0') {
+                montauk::print("pipeline: empty command\n");
+                return 1;
+            }
+            count++;
+            si = 0;
+            if (*p == '\0') break;
+            if (count == MAX_STAGES) {
+                montauk::print("pipeline: too many stages\n");
+                return 1;
+            }
+            continue;
+        }
+        if (si < 255) stages[count][si++] = *p;
+    }
+
+    // Resolve every stage before starting any; builtins print straight to
+    // the terminal, so only external commands can take part
+    char paths[MAX_STAGES][256];
+    const char* args[MAX_STAGES];
+    for (int i = 0; i < count; i++) {
+        char* stage = (char*)skip_spaces(stages[i]);
+        char* space = stage;
+        while (*space && *space != ' ') space++;
+        args[i] = nullptr;
+        if (*space) {
+            *space = '\0';
+            args[i] = skip_spaces(space + 1);
+            if (*args[i] == '\0') args[i] = nullptr;
+        }
+        if (!find_external(stage, paths[i], sizeof(paths[i]))) {
+            print_not_found(stage);
+            return 127;
+        }
+    }
+
+    // Each stage but the last is spawned with a new pipe as its stdout,
+    // whose read end becomes the next stage's stdin. The shell lets go of
+    // that end once the next stage holds it: its copy would keep readers
+    // from ever seeing the end of the stream.
+    int pids[MAX_STAGES];
+    int started = 0;
+    int prev = -1;  // read end of the pipe into stage `started`
+    for (; started < count; started++) {
+        Montauk::SpawnAction actions[2];
+        uint32_t n = 0;
+        if (prev > 0) actions[n++] = {Montauk::SPAWN_ACT_DUP, Montauk::SPAWN_STDIN, prev, 0};
+        if (started < count - 1) actions[n++] = {Montauk::SPAWN_ACT_PIPE, Montauk::SPAWN_STDOUT, 0, 0};
+        const char* argv[2] = {args[started], nullptr};
+
+        Montauk::SpawnAttr attr = {};
+        attr.path = paths[started];
+        attr.argv = args[started] ? argv : nullptr;
+        attr.actions = actions;
+        attr.actionCount = n;
+        attr.priority = Montauk::PRIO_INHERIT;
+        pids[started] = montauk::spawn_ex(&attr);
+
+        if (prev > 0) montauk::pipe_close(prev);
+        prev = -1;
+        if (pids[started] < 0) break;
+        if (started < count - 1) prev = actions[n - 1].handle;
+    }
+
+    for (int i = 0; i < started; i++) montauk::waitpid(pids[i]);
+
+    if (started < count) {
+        montauk::print(stages[started]);
+        montauk::print(": cannot execute\n");
+        return 126;
+    }
+    return 0;
 }
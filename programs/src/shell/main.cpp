@@ -299,7 +299,8 @@ static void execute_line(const char* raw) {
     // Step 3: strip comments
     strip_comment(expanded);
 
-    // Step 4: split on ;, &&, || and execute with chaining logic
+    // Step 4: split on ;, &&, || and execute with chaining logic; a segment
+    // with a single | in it is a pipeline
     const char* p = expanded;
     int prev = 0;
     enum { OP_NONE, OP_SEMI, OP_AND, OP_OR } pending = OP_NONE;
@@ -313,6 +314,7 @@ static void execute_line(const char* raw) {
         int si = 0;
         int op = OP_NONE;
         bool in_sq = false, in_dq = false;
+        bool has_pipe = false;
 
         while (*p && si < 255) {
             if (*p == '\'' && !in_dq) { in_sq = !in_sq; seg[si++] = *p++; continue; }
@@ -321,6 +323,7 @@ static void execute_line(const char* raw) {
                 if (*p == ';') { op = OP_SEMI; p++; break; }
                 if (*p == '&' && p[1] == '&') { op = OP_AND; p += 2; break; }
                 if (*p == '|' && p[1] == '|') { op = OP_OR; p += 2; break; }
+                if (*p == '|') has_pipe = true;
             }
             seg[si++] = *p++;
         }
@@ -335,7 +338,7 @@ static void execute_line(const char* raw) {
         if (pending == OP_OR && prev == 0) run = false;
 
         if (run && seg[0]) {
-            prev = process_command(seg);
+            prev = has_pipe ? run_pipeline(seg) : process_command(seg);
         }
 
         pending = (decltype(pending))op;
@@ -125,4 +125,8 @@ bool switch_drive(int drive);
 
 // ---- External execution (exec.cpp) ----
 
+// Resolve a command name to the path of its ELF; false if none is found
+bool find_external(const char* cmd, char* out, int outMax);
 int exec_external(const char* cmd, const char* args);
+// Run "a | b | c" with each stage's output piped to the next's input
+int run_pipeline(const char* line);
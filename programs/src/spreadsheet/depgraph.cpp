@@ -0,0 +1,255 @@
+/*
+ * depgraph.cpp
+ * Cell dependency graph and incremental recalculation
+ * Copyright (c) 2026 Daniel Hammer
+ */
+
+#include "spreadsheet.h"
+
+// Each reference in a formula, a single cell or a range, is one DepRef,
+// listed on the formula's cell so it can be dropped when the formula
+// changes. To find who reads a cell, references are also filed under
+// every column chunk (CHUNK_ROWS cells of one column) they overlap, so
+// a range over a whole column costs one entry per chunk rather than one
+// per cell, and blank cells it covers need no storage. Changed cells are
+// queued; recalc() evaluates them and everything downstream of them once
+// each, in dependency order.
+//
+// Cells are named by id, row * MAX_COLS + col.
+
+struct DepRef {
+    CellRange range;
+    int32_t   owner;        // formula cell
+    int32_t   link;         // next reference of the owner, or next free
+    int32_t   first_node;   // its chunk entries
+};
+
+struct DepNode {
+    int32_t ref;
+    int32_t prev, next;     // neighbours in the chunk's list
+    int32_t link;           // next entry of the same reference, or next free
+    int32_t col, index;     // the chunk
+};
+
+// Items are numbered from 1 so that 0 ends a list and zeroed memory is empty
+template <typename T>
+struct DepPool {
+    T*      items;
+    int32_t cap;
+    int32_t top;
+    int32_t free_list;
+
+    int32_t alloc() {
+        if (free_list) {
+            int32_t i = free_list;
+            free_list = items[i].link;
+            return i;
+        }
+        if (top < 1) top = 1;
+        if (top >= cap) {
+            int32_t n = cap ? cap * 2 : 1024;
+            T* grown = (T*)montauk::malloc((uint64_t)n * sizeof(T));
+            if (!grown) return 0;
+            if (items) {
+                montauk::memcpy(grown, items, (uint64_t)top * sizeof(T));
+                montauk::mfree(items);
+            }
+            items = grown;
+            cap = n;
+        }
+        return top++;
+    }
+
+    void release(int32_t i) {
+        items[i].link = free_list;
+        free_list = i;
+    }
+
+    void reset() {
+        top = 1;
+        free_list = 0;
+    }
+};
+
+static DepPool<DepRef>  g_refs;
+static DepPool<DepNode> g_nodes;
+static int32_t*         g_buckets[MAX_COLS];   // per column, CHUNK_COUNT list heads
+
+// Cells waiting for recalc() and, during it, everything found downstream
+static int32_t* g_queue = nullptr;
+static int32_t* g_order = nullptr;
+static int      g_queue_count = 0;
+static int      g_queue_cap = 0;
+
+static Cell* cell_by_id(int32_t id) {
+    return cell_at(id % MAX_COLS, id / MAX_COLS);
+}
+
+static void unlink_refs(Cell* c) {
+    for (int32_t r = c->ref_head; r; ) {
+        for (int32_t n = g_refs.items[r].first_node; n; ) {
+            DepNode* d = &g_nodes.items[n];
+            if (d->prev) g_nodes.items[d->prev].next = d->next;
+            else g_buckets[d->col][d->index] = d->next;
+            if (d->next) g_nodes.items[d->next].prev = d->prev;
+            int32_t next = d->link;
+            g_nodes.release(n);
+            n = next;
+        }
+        int32_t next = g_refs.items[r].link;
+        g_refs.release(r);
+        r = next;
+    }
+    c->ref_head = 0;
+}
+
+static void link_refs(int32_t id, Cell* c) {
+    if (!c->code) return;
+
+    CellRange refs[FORMULA_MAX_REFS];
+    int n = formula_refs(c->code, refs, FORMULA_MAX_REFS);
+    for (int i = 0; i < n; i++) {
+        int32_t r = g_refs.alloc();
+        if (!r) return;
+        DepRef* ref = &g_refs.items[r];
+        ref->range = refs[i];
+        ref->owner = id;
+        ref->first_node = 0;
+        ref->link = c->ref_head;
+        c->ref_head = r;
+
+        for (int col = refs[i].c0; col <= refs[i].c1; col++) {
+            if (!g_buckets[col]) {
+                g_buckets[col] = (int32_t*)montauk::malloc(CHUNK_COUNT * sizeof(int32_t));
+                if (!g_buckets[col]) return;
+                montauk::memset(g_buckets[col], 0, CHUNK_COUNT * sizeof(int32_t));
+            }
+            for (int k = refs[i].r0 / CHUNK_ROWS; k <= refs[i].r1 / CHUNK_ROWS; k++) {
+                int32_t e = g_nodes.alloc();
+                if (!e) return;
+                DepNode* d = &g_nodes.items[e];
+                d->ref = r;
+                d->col = col;
+                d->index = k;
+                d->prev = 0;
+                d->next = g_buckets[col][k];
+                if (d->next) g_nodes.items[d->next].prev = e;
+                g_buckets[col][k] = e;
+                d->link = g_refs.items[r].first_node;
+                g_refs.items[r].first_node = e;
+            }
+        }
+    }
+}
+
+// Call fn(owner id) for every reference that reads cell `id`
+template <typename F>
+static void for_each_dependent(int32_t id, F fn) {
+    int col = id % MAX_COLS, row = id / MAX_COLS;
+    if (!g_buckets[col]) return;
+    for (int32_t n = g_buckets[col][row / CHUNK_ROWS]; n; n = g_nodes.items[n].next) {
+        const DepRef* ref = &g_refs.items[g_nodes.items[n].ref];
+        if (row >= ref->range.r0 && row <= ref->range.r1 &&
+            col >= ref->range.c0 && col <= ref->range.c1)
+            fn(ref->owner);
+    }
+}
+
+static void queue_cell(int32_t id, Cell* c) {
+    if (c->queued) return;
+    if (g_queue_count == g_queue_cap) {
+        int cap = g_queue_cap ? g_queue_cap * 2 : 1024;
+        int32_t* q = (int32_t*)montauk::malloc((uint64_t)cap * sizeof(int32_t));
+        if (!q) return;
+        if (g_queue) {
+            montauk::memcpy(q, g_queue, (uint64_t)g_queue_count * sizeof(int32_t));
+            montauk::mfree(g_queue);
+        }
+        g_queue = q;
+        g_queue_cap = cap;
+    }
+    c->queued = true;
+    g_queue[g_queue_count++] = id;
+}
+
+// The cell's input, format or value changed: recompile it (unless the
+// caller already set its code), pick up its new references and queue it
+// for the next recalc()
+void cell_changed(int col, int row, bool compile) {
+    Cell* c = cell_touch(col, row);
+    if (!c) return;
+    if (compile) compile_cell(col, row);
+    unlink_refs(c);
+    link_refs(row * MAX_COLS + col, c);
+    queue_cell(row * MAX_COLS + col, c);
+}
+
+// Evaluate the queued cells and their transitive dependents. Each is
+// evaluated once, after everything it reads (Kahn's algorithm over the
+// affected cells); those left over are on a reference cycle, or read
+// from one, and show #CYCLE.
+void recalc() {
+    // Everything downstream of the changed cells
+    for (int i = 0; i < g_queue_count; i++) {
+        for_each_dependent(g_queue[i], [](int32_t owner) { queue_cell(owner, cell_by_id(owner)); });
+    }
+
+    // Count, for each affected cell, the affected cells it reads
+    for (int i = 0; i < g_queue_count; i++) cell_by_id(g_queue[i])->indegree = 0;
+    for (int i = 0; i < g_queue_count; i++) {
+        for_each_dependent(g_queue[i], [](int32_t owner) { cell_by_id(owner)->indegree++; });
+    }
+
+    if (g_order) montauk::mfree(g_order);
+    g_order = (int32_t*)montauk::malloc((uint64_t)(g_queue_count + 1) * sizeof(int32_t));
+    int head = 0, tail = 0;
+    if (g_order) {
+        for (int i = 0; i < g_queue_count; i++) {
+            if (cell_by_id(g_queue[i])->indegree == 0) g_order[tail++] = g_queue[i];
+        }
+        while (head < tail) {
+            int32_t id = g_order[head++];
+            eval_cell(id % MAX_COLS, id / MAX_COLS);
+            for_each_dependent(id, [&tail](int32_t owner) {
+                if (--cell_by_id(owner)->indegree == 0) g_order[tail++] = owner;
+            });
+        }
+    }
+
+    for (int i = 0; i < g_queue_count; i++) {
+        int32_t id = g_queue[i];
+        Cell* c = cell_by_id(id);
+        c->queued = false;
+        if (c->indegree == 0) continue;
+        CellChunk* chunk = sheet_chunk(id % MAX_COLS, (id / MAX_COLS) / CHUNK_ROWS, false);
+        chunk->values[(id / MAX_COLS) % CHUNK_ROWS] = 0;
+        c->type = CT_ERROR;
+        str_cpy(c->display, "#CYCLE", CELL_TEXT_MAX);
+    }
+    g_queue_count = 0;
+}
+
+// Rebuild the graph and evaluate every stored cell, after the sheet was replaced
+void eval_all_cells() {
+    g_refs.reset();
+    g_nodes.reset();
+    for (int col = 0; col < MAX_COLS; col++) {
+        if (g_buckets[col]) montauk::memset(g_buckets[col], 0, CHUNK_COUNT * sizeof(int32_t));
+    }
+
+    for (int col = 0; col < MAX_COLS; col++) {
+        for (int k = 0; k < CHUNK_COUNT; k++) {
+            CellChunk* chunk = sheet_chunk(col, k, false);
+            if (!chunk) continue;
+            for (int i = 0; i < CHUNK_ROWS; i++) {
+                int row = k * CHUNK_ROWS + i;
+                Cell* c = &chunk->cells[i];
+                c->ref_head = 0;
+                compile_cell(col, row);
+                link_refs(row * MAX_COLS + col, c);
+                queue_cell(row * MAX_COLS + col, c);
+            }
+        }
+    }
+    recalc();
+}
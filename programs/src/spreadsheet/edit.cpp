@@ -10,69 +10,136 @@
 // Undo/redo
 // ============================================================================
 
+// undo_push() opens an entry, and every cell the edit then changes goes
+// through cell_for_edit(), which saves the cell's state first. Undo puts
+// those states back, last change first, keeping the ones it replaces so
+// redo can swap them in again; an edit costs memory for the cells it
+// touched, not for the whole sheet.
+
+static UndoEntry* g_undo_open = nullptr;   // the entry edits are recorded into
+
+static void undo_free(UndoEntry* e) {
+    if (!e) return;
+    if (e->cells) montauk::mfree(e->cells);
+    montauk::mfree(e);
+}
+
 void undo_push() {
     for (int i = g_undo_pos; i < g_undo_count; i++) {
-        if (g_undo[i]) { montauk::mfree(g_undo[i]); g_undo[i] = nullptr; }
+        undo_free(g_undo[i]);
+        g_undo[i] = nullptr;
     }
-    if (g_undo[UNDO_MAX]) { montauk::mfree(g_undo[UNDO_MAX]); g_undo[UNDO_MAX] = nullptr; }
     g_undo_count = g_undo_pos;
 
     if (g_undo_count >= UNDO_MAX) {
-        if (g_undo[0]) montauk::mfree(g_undo[0]);
+        undo_free(g_undo[0]);
         for (int i = 0; i < UNDO_MAX - 1; i++) g_undo[i] = g_undo[i + 1];
         g_undo[UNDO_MAX - 1] = nullptr;
         g_undo_count = UNDO_MAX - 1;
     }
 
+    g_undo_open = nullptr;
     UndoEntry* e = (UndoEntry*)montauk::malloc(sizeof(UndoEntry));
     if (!e) return;
-    for (int r = 0; r < MAX_ROWS; r++)
-        for (int c = 0; c < MAX_COLS; c++) {
-            str_cpy(e->cells[r][c].input, g_cells[r][c].input, CELL_TEXT_MAX);
-            e->cells[r][c].align = g_cells[r][c].align;
-            e->cells[r][c].fmt = g_cells[r][c].fmt;
-            e->cells[r][c].bold = g_cells[r][c].bold;
-        }
+    e->count = 0;
+    e->capacity = 0;
+    e->cells = nullptr;
     g_undo[g_undo_count] = e;
     g_undo_count++;
     g_undo_pos = g_undo_count;
+    g_undo_open = e;
+}
+
+// Drop all history, when the sheet is replaced
+void undo_clear() {
+    for (int i = 0; i < g_undo_count; i++) {
+        undo_free(g_undo[i]);
+        g_undo[i] = nullptr;
+    }
+    g_undo_count = 0;
+    g_undo_pos = 0;
+    g_undo_open = nullptr;
+}
+
+static void undo_save(UndoCellData* d, const Cell* c) {
+    str_cpy(d->input, c->input, CELL_TEXT_MAX);
+    d->align = c->align;
+    d->fmt = c->fmt;
+    d->bold = c->bold;
 }
 
-static void undo_restore(UndoEntry* e) {
-    for (int r = 0; r < MAX_ROWS; r++)
-        for (int c = 0; c < MAX_COLS; c++) {
-            str_cpy(g_cells[r][c].input, e->cells[r][c].input, CELL_TEXT_MAX);
-            g_cells[r][c].align = e->cells[r][c].align;
-            g_cells[r][c].fmt = e->cells[r][c].fmt;
-            g_cells[r][c].bold = e->cells[r][c].bold;
+static void undo_record(UndoEntry* e, int col, int row) {
+    if (e->count == e->capacity) {
+        int cap = e->capacity ? e->capacity * 2 : 16;
+        UndoCellData* cells = (UndoCellData*)montauk::malloc((uint64_t)cap * sizeof(UndoCellData));
+        if (!cells) return;
+        if (e->cells) {
+            montauk::memcpy(cells, e->cells, (uint64_t)e->count * sizeof(UndoCellData));
+            montauk::mfree(e->cells);
         }
-    eval_all_cells();
+        e->cells = cells;
+        e->capacity = cap;
+    }
+    UndoCellData* d = &e->cells[e->count++];
+    undo_save(d, cell_peek(col, row));
+    d->col = (uint16_t)col;
+    d->row = (uint32_t)row;
+}
+
+// The cell at (col, row), created if need be, after saving its state
+// into the open undo entry
+Cell* cell_for_edit(int col, int row) {
+    if (g_undo_open) undo_record(g_undo_open, col, row);
+    return cell_touch(col, row);
+}
+
+// Exchange each saved state with the cell's; only cells whose input or
+// format differ are recalculated
+static void undo_swap(UndoEntry* e, bool reverse) {
+    for (int k = 0; k < e->count; k++) {
+        UndoCellData* d = &e->cells[reverse ? e->count - 1 - k : k];
+        Cell* cell = cell_touch(d->col, d->row);
+        if (!cell) continue;
+        UndoCellData saved = *d;
+        undo_save(d, cell);
+        bool changed = strcmp(cell->input, saved.input) != 0 || cell->fmt != saved.fmt;
+        str_cpy(cell->input, saved.input, CELL_TEXT_MAX);
+        cell->align = saved.align;
+        cell->fmt = saved.fmt;
+        cell->bold = saved.bold;
+        if (changed) cell_changed(d->col, d->row);
+    }
+    recalc();
 }
 
 void undo_do() {
+    g_undo_open = nullptr;
     if (g_undo_pos <= 0) return;
-    if (g_undo_pos == g_undo_count && !g_undo[g_undo_count]) {
-        UndoEntry* e = (UndoEntry*)montauk::malloc(sizeof(UndoEntry));
-        if (e) {
-            for (int r = 0; r < MAX_ROWS; r++)
-                for (int c = 0; c < MAX_COLS; c++) {
-                    str_cpy(e->cells[r][c].input, g_cells[r][c].input, CELL_TEXT_MAX);
-                    e->cells[r][c].align = g_cells[r][c].align;
-                    e->cells[r][c].fmt = g_cells[r][c].fmt;
-                    e->cells[r][c].bold = g_cells[r][c].bold;
-                }
-            g_undo[g_undo_count] = e;
-        }
-    }
     g_undo_pos--;
-    if (g_undo[g_undo_pos]) undo_restore(g_undo[g_undo_pos]);
+    if (g_undo[g_undo_pos]) undo_swap(g_undo[g_undo_pos], true);
 }
 
 void redo_do() {
+    g_undo_open = nullptr;
     if (g_undo_pos >= g_undo_count) return;
+    if (g_undo[g_undo_pos]) undo_swap(g_undo[g_undo_pos], false);
     g_undo_pos++;
-    UndoEntry* e = g_undo[g_undo_pos];
-    if (e) undo_restore(e);
+}
+
+// Empty every stored cell in the range; blank chunks are skipped
+void clear_range(int c0, int r0, int c1, int r1) {
+    for (int c = c0; c <= c1; c++) {
+        for (int k = r0 / CHUNK_ROWS; k <= r1 / CHUNK_ROWS; k++) {
+            CellChunk* chunk = sheet_chunk(c, k, false);
+            if (!chunk) continue;
+            for (int i = 0; i < CHUNK_ROWS; i++) {
+                int r = k * CHUNK_ROWS + i;
+                if (r < r0 || r > r1 || !chunk->cells[i].input[0]) continue;
+                cell_for_edit(c, r)->input[0] = '\0';
+                cell_changed(c, r);
+            }
+        }
+    }
 }
 
 // ============================================================================
@@ -82,7 +149,7 @@ void redo_do() {
 void start_editing() {
     if (g_editing) return;
     g_editing = true;
-    Cell* c = &g_cells[g_sel_row][g_sel_col];
+    const Cell* c = cell_peek(g_sel_col, g_sel_row);
     str_cpy(g_edit_buf, c->input, CELL_TEXT_MAX);
     g_edit_len = str_len(g_edit_buf);
     g_edit_cursor = g_edit_len;
@@ -92,10 +159,12 @@ void commit_edit() {
     if (!g_editing) return;
     g_editing = false;
     undo_push();
-    Cell* c = &g_cells[g_sel_row][g_sel_col];
+    Cell* c = cell_for_edit(g_sel_col, g_sel_row);
+    if (!c) return;
     str_cpy(c->input, g_edit_buf, CELL_TEXT_MAX);
     g_modified = true;
-    eval_all_cells();
+    cell_changed(g_sel_col, g_sel_row);
+    recalc();
 }
 
 void cancel_edit() {
@@ -133,12 +202,13 @@ void copy_selection() {
     for (int r = r0; r <= r1 && g_clip_count < CLIP_MAX_CELLS; r++) {
         for (int c = c0; c <= c1 && g_clip_count < CLIP_MAX_CELLS; c++) {
             ClipCell* cc = &g_clipboard[g_clip_count];
-            str_cpy(cc->text, g_cells[r][c].input, CELL_TEXT_MAX);
+            const Cell* cell = cell_peek(c, r);
+            str_cpy(cc->text, cell->input, CELL_TEXT_MAX);
             cc->rel_col = c - c0;
             cc->rel_row = r - r0;
-            cc->align = g_cells[r][c].align;
-            cc->fmt = g_cells[r][c].fmt;
-            cc->bold = g_cells[r][c].bold;
+            cc->align = cell->align;
+            cc->fmt = cell->fmt;
+            cc->bold = cell->bold;
             g_clip_count++;
         }
     }
@@ -149,10 +219,8 @@ void cut_selection() {
     undo_push();
     int c0, r0, c1, r1;
     sel_range(&c0, &r0, &c1, &r1);
-    for (int r = r0; r <= r1; r++)
-        for (int c = c0; c <= c1; c++)
-            g_cells[r][c].input[0] = '\0';
-    eval_all_cells();
+    clear_range(c0, r0, c1, r1);
+    recalc();
     g_modified = true;
 }
 
@@ -163,13 +231,16 @@ void paste_at_cursor() {
         int tc = g_sel_col + g_clipboard[i].rel_col;
         int tr = g_sel_row + g_clipboard[i].rel_row;
         if (tc >= 0 && tc < MAX_COLS && tr >= 0 && tr < MAX_ROWS) {
-            str_cpy(g_cells[tr][tc].input, g_clipboard[i].text, CELL_TEXT_MAX);
-            g_cells[tr][tc].align = g_clipboard[i].align;
-            g_cells[tr][tc].fmt = g_clipboard[i].fmt;
-            g_cells[tr][tc].bold = g_clipboard[i].bold;
+            Cell* cell = cell_for_edit(tc, tr);
+            if (!cell) continue;
+            str_cpy(cell->input, g_clipboard[i].text, CELL_TEXT_MAX);
+            cell->align = g_clipboard[i].align;
+            cell->fmt = g_clipboard[i].fmt;
+            cell->bold = g_clipboard[i].bold;
+            cell_changed(tc, tr);
         }
     }
-    eval_all_cells();
+    recalc();
     g_modified = true;
 }
 
@@ -181,10 +252,12 @@ void apply_bold_toggle() {
     undo_push();
     int c0, r0, c1, r1;
     sel_range(&c0, &r0, &c1, &r1);
-    bool new_bold = !g_cells[r0][c0].bold;
+    bool new_bold = !cell_peek(c0, r0)->bold;
     for (int r = r0; r <= r1; r++)
-        for (int c = c0; c <= c1; c++)
-            g_cells[r][c].bold = new_bold;
+        for (int c = c0; c <= c1; c++) {
+            Cell* cell = cell_for_edit(c, r);
+            if (cell) cell->bold = new_bold;
+        }
     g_modified = true;
 }
 
@@ -193,8 +266,10 @@ void apply_align(CellAlign a) {
     int c0, r0, c1, r1;
     sel_range(&c0, &r0, &c1, &r1);
     for (int r = r0; r <= r1; r++)
-        for (int c = c0; c <= c1; c++)
-            g_cells[r][c].align = a;
+        for (int c = c0; c <= c1; c++) {
+            Cell* cell = cell_for_edit(c, r);
+            if (cell) cell->align = a;
+        }
     g_modified = true;
 }
 
@@ -203,9 +278,13 @@ void apply_format(NumFormat f) {
     int c0, r0, c1, r1;
     sel_range(&c0, &r0, &c1, &r1);
     for (int r = r0; r <= r1; r++)
-        for (int c = c0; c <= c1; c++)
-            g_cells[r][c].fmt = f;
-    eval_all_cells();
+        for (int c = c0; c <= c1; c++) {
+            Cell* cell = cell_for_edit(c, r);
+            if (!cell) continue;
+            cell->fmt = f;
+            cell_changed(c, r);
+        }
+    recalc();
     g_modified = true;
 }
 
@@ -229,22 +308,25 @@ void fill_down(int src_r0, int src_c0, int src_r1, int src_c1, int dst_r1) {
         int src_r = src_r0 + ((r - src_r0) % src_rows);
         int drow = r - src_r;
         for (int c = src_c0; c <= src_c1; c++) {
-            Cell* src = &g_cells[src_r][c];
-            Cell* dst = &g_cells[r][c];
+            const Cell* src = cell_peek(c, src_r);
+            Cell* dst = cell_for_edit(c, r);
+            if (!dst) continue;
             dst->align = src->align;
             dst->fmt = src->fmt;
             dst->bold = src->bold;
 
             if (src->input[0] == '=') {
-                // Formula: adjust cell references
-                adjust_formula_refs(src->input, dst->input, CELL_TEXT_MAX, 0, drow);
+                // Formula: adjust cell references, which compiles it too
+                adjust_formula_refs(src, dst, 0, drow);
+                cell_changed(c, r, false);
             } else {
                 str_cpy(dst->input, src->input, CELL_TEXT_MAX);
+                cell_changed(c, r);
             }
         }
     }
 
-    eval_all_cells();
+    recalc();
     g_modified = true;
 }
 
@@ -255,10 +337,14 @@ void fill_down(int src_r0, int src_c0, int src_r1, int src_c1, int dst_r1) {
 void auto_fit_column(int col) {
     if (!g_font) return;
     int max_w = MIN_COL_W;
-    for (int r = 0; r < MAX_ROWS; r++) {
-        if (g_cells[r][col].display[0]) {
-            TrueTypeFont* f = (g_cells[r][col].bold && g_font_bold) ? g_font_bold : g_font;
-            int tw = f->measure_text(g_cells[r][col].display, FONT_SIZE) + 12;
+    for (int k = 0; k < CHUNK_COUNT; k++) {
+        const CellChunk* chunk = sheet_chunk(col, k, false);
+        if (!chunk) continue;
+        for (int i = 0; i < CHUNK_ROWS; i++) {
+            const Cell* c = &chunk->cells[i];
+            if (!c->display[0]) continue;
+            TrueTypeFont* f = (c->bold && g_font_bold) ? g_font_bold : g_font;
+            int tw = f->measure_text(c->display, FONT_SIZE) + 12;
             if (tw > max_w) max_w = tw;
         }
     }
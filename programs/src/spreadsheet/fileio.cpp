@@ -6,53 +6,120 @@
 
 #include "spreadsheet.h"
 
+// MSS4: "MSS4", cell count (u32), cols (u16), rows (u32), then per cell
+// col (u16), row (u32), length (u16), flags (u8) and the input text.
+// MSS3 had a u16 row and row count; MSS1/MSS2 used one byte for col and
+// row and a u16 count; MSS1 had no flags.
+//
+// Files are written and read through one IO_BLOCK buffer, so neither the
+// sheet's size nor the file's decides how much memory a save or load takes.
+
+static constexpr int IO_BLOCK = 64 * 1024;
+
+static void put16(uint8_t* buf, int& off, int v) {
+    buf[off++] = (uint8_t)(v & 0xFF);
+    buf[off++] = (uint8_t)((v >> 8) & 0xFF);
+}
+
+static void put32(uint8_t* buf, int& off, uint32_t v) {
+    put16(buf, off, (int)(v & 0xFFFF));
+    put16(buf, off, (int)(v >> 16));
+}
+
+static int get16(const uint8_t* p) { return p[0] | (p[1] << 8); }
+static uint32_t get32(const uint8_t* p) { return (uint32_t)get16(p) | ((uint32_t)get16(p + 2) << 16); }
+
+struct FileWriter {
+    int      fd;
+    uint64_t pos;
+    uint8_t* buf;
+    int      len;
+    bool     ok;
+
+    void flush() {
+        if (len > 0 && montauk::fwrite(fd, buf, pos, len) < 0) ok = false;
+        pos += len;
+        len = 0;
+    }
+
+    // Room for n more bytes at buf + len
+    void reserve(int n) {
+        if (len + n > IO_BLOCK) flush();
+    }
+};
+
+struct FileReader {
+    int      fd;
+    uint64_t size;
+    uint64_t pos;      // file offset of buf[0]
+    uint8_t* buf;
+    int      len, at;
+
+    // Make n bytes available at buf + at; false at the end of the file
+    bool need(int n) {
+        if (at + n <= len) return true;
+        pos += at;
+        len -= at;
+        montauk::memmove(buf, buf + at, len);
+        at = 0;
+        uint64_t left = size - pos - len;
+        int want = IO_BLOCK - len;
+        if ((uint64_t)want > left) want = (int)left;
+        if (want > 0 && montauk::read(fd, buf + len, pos + len, want) >= 0) len += want;
+        return n <= len;
+    }
+};
+
 void save_file() {
     if (g_filepath[0] == '\0') return;
 
-    int count = 0;
-    for (int r = 0; r < MAX_ROWS; r++)
-        for (int c = 0; c < MAX_COLS; c++)
-            if (g_cells[r][c].input[0]) count++;
-
-    int size = 4 + 2 + 2;
-    for (int r = 0; r < MAX_ROWS; r++)
-        for (int c = 0; c < MAX_COLS; c++)
-            if (g_cells[r][c].input[0])
-                size += 1 + 1 + 2 + 1 + str_len(g_cells[r][c].input);
-
-    uint8_t* buf = (uint8_t*)montauk::malloc(size);
-    int off = 0;
-
-    buf[off++] = 'M'; buf[off++] = 'S'; buf[off++] = 'S'; buf[off++] = '2';
-    buf[off++] = (uint8_t)(count & 0xFF);
-    buf[off++] = (uint8_t)((count >> 8) & 0xFF);
-    buf[off++] = MAX_COLS;
-    buf[off++] = MAX_ROWS;
-
-    for (int r = 0; r < MAX_ROWS; r++) {
-        for (int c = 0; c < MAX_COLS; c++) {
-            if (!g_cells[r][c].input[0]) continue;
-            buf[off++] = (uint8_t)c;
-            buf[off++] = (uint8_t)r;
-            int len = str_len(g_cells[r][c].input);
-            buf[off++] = (uint8_t)(len & 0xFF);
-            buf[off++] = (uint8_t)((len >> 8) & 0xFF);
-            uint8_t flags = ((uint8_t)g_cells[r][c].align & 3)
-                          | (((uint8_t)g_cells[r][c].fmt & 3) << 2)
-                          | (g_cells[r][c].bold ? 0x10 : 0);
-            buf[off++] = flags;
-            montauk::memcpy(buf + off, g_cells[r][c].input, len);
-            off += len;
+    uint32_t count = 0;
+    for (int c = 0; c < MAX_COLS; c++)
+        for (int k = 0; k < CHUNK_COUNT; k++) {
+            const CellChunk* chunk = sheet_chunk(c, k, false);
+            if (!chunk) continue;
+            for (int i = 0; i < CHUNK_ROWS; i++)
+                if (chunk->cells[i].input[0]) count++;
         }
-    }
 
+    uint8_t* buf = (uint8_t*)montauk::malloc(IO_BLOCK);
+    if (!buf) return;
     int fd = montauk::fcreate(g_filepath);
-    if (fd >= 0) {
-        montauk::fwrite(fd, buf, 0, off);
-        montauk::close(fd);
-        g_modified = false;
+    if (fd < 0) {
+        montauk::mfree(buf);
+        return;
     }
 
+    FileWriter w = {fd, 0, buf, 0, true};
+    buf[w.len++] = 'M'; buf[w.len++] = 'S'; buf[w.len++] = 'S'; buf[w.len++] = '4';
+    put32(buf, w.len, count);
+    put16(buf, w.len, MAX_COLS);
+    put32(buf, w.len, MAX_ROWS);
+
+    for (int c = 0; c < MAX_COLS; c++) {
+        for (int k = 0; k < CHUNK_COUNT; k++) {
+            const CellChunk* chunk = sheet_chunk(c, k, false);
+            if (!chunk) continue;
+            for (int i = 0; i < CHUNK_ROWS; i++) {
+                const Cell* cell = &chunk->cells[i];
+                if (!cell->input[0]) continue;
+                int len = str_len(cell->input);
+                w.reserve(2 + 4 + 2 + 1 + len);
+                put16(buf, w.len, c);
+                put32(buf, w.len, (uint32_t)(k * CHUNK_ROWS + i));
+                put16(buf, w.len, len);
+                buf[w.len++] = ((uint8_t)cell->align & 3)
+                             | (((uint8_t)cell->fmt & 3) << 2)
+                             | (cell->bold ? 0x10 : 0);
+                montauk::memcpy(buf + w.len, cell->input, len);
+                w.len += len;
+            }
+        }
+    }
+    w.flush();
+    montauk::close(fd);
+    if (w.ok) g_modified = false;
+
     montauk::mfree(buf);
 }
 
@@ -60,66 +127,66 @@ void load_file(const char* path) {
     int fd = montauk::open(path);
     if (fd < 0) return;
 
-    uint64_t fsize = montauk::getsize(fd);
-    if (fsize < 8 || fsize > 1024 * 1024) {
+    uint8_t* buf = (uint8_t*)montauk::malloc(IO_BLOCK);
+    if (!buf) {
         montauk::close(fd);
         return;
     }
+    FileReader rd = {fd, montauk::getsize(fd), 0, buf, 0, 0};
 
-    uint8_t* buf = (uint8_t*)montauk::malloc((int)fsize);
-    montauk::read(fd, buf, 0, fsize);
-    montauk::close(fd);
-
-    if (buf[0] != 'M' || buf[1] != 'S' || buf[2] != 'S' || (buf[3] != '1' && buf[3] != '2')) {
+    int ver = rd.need(8) ? buf[3] - '0' : 0;
+    int header = ver >= 4 ? 14 : ver == 3 ? 12 : 8;
+    if (buf[0] != 'M' || buf[1] != 'S' || buf[2] != 'S' || ver < 1 || ver > 4 || !rd.need(header)) {
         montauk::mfree(buf);
+        montauk::close(fd);
         return;
     }
-    bool v2 = (buf[3] == '2');
-
-    for (int r = 0; r < MAX_ROWS; r++)
-        for (int c = 0; c < MAX_COLS; c++) {
-            g_cells[r][c].input[0] = '\0';
-            g_cells[r][c].display[0] = '\0';
-            g_cells[r][c].value = 0;
-            g_cells[r][c].type = CT_EMPTY;
-            g_cells[r][c].align = ALIGN_AUTO;
-            g_cells[r][c].fmt = FMT_AUTO;
-            g_cells[r][c].bold = false;
-        }
 
-    int off = 4;
-    int count = buf[off] | (buf[off + 1] << 8);
-    off += 2;
-    off += 2; // skip cols/rows
-
-    for (int i = 0; i < count && off < (int)fsize; i++) {
-        if (off + 4 > (int)fsize) break;
-        int c = buf[off++];
-        int r = buf[off++];
-        int len = buf[off] | (buf[off + 1] << 8);
-        off += 2;
-
-        uint8_t flags = 0;
-        if (v2) {
-            if (off >= (int)fsize) break;
-            flags = buf[off++];
+    sheet_clear();
+    undo_clear();
+
+    // Cols and rows in the header are not needed
+    uint32_t count = ver >= 3 ? get32(buf + 4) : (uint32_t)get16(buf + 4);
+    rd.at = header;
+
+    bool v2 = ver >= 2;
+    int pos_bytes = ver >= 4 ? 6 : ver == 3 ? 4 : 2;
+    int fixed = pos_bytes + 2 + (v2 ? 1 : 0);
+    for (uint32_t i = 0; i < count && rd.need(fixed); i++) {
+        const uint8_t* p = buf + rd.at;
+        int c, r;
+        if (ver >= 4) {
+            c = get16(p);
+            r = (int)get32(p + 2);
+        } else if (ver == 3) {
+            c = get16(p);
+            r = get16(p + 2);
+        } else {
+            c = p[0];
+            r = p[1];
         }
-
-        if (off + len > (int)fsize) break;
-        if (c < MAX_COLS && r < MAX_ROWS && len < CELL_TEXT_MAX) {
-            montauk::memcpy(g_cells[r][c].input, buf + off, len);
-            g_cells[r][c].input[len] = '\0';
+        int len = get16(p + pos_bytes);
+        uint8_t flags = v2 ? p[pos_bytes + 2] : 0;
+        rd.at += fixed;
+
+        if (len >= IO_BLOCK || !rd.need(len)) break;
+        Cell* cell = (c < MAX_COLS && r >= 0 && r < MAX_ROWS && len < CELL_TEXT_MAX)
+                   ? cell_touch(c, r) : nullptr;
+        if (cell) {
+            montauk::memcpy(cell->input, buf + rd.at, len);
+            cell->input[len] = '\0';
             if (v2) {
-                g_cells[r][c].align = (CellAlign)(flags & 3);
-                g_cells[r][c].fmt = (NumFormat)((flags >> 2) & 3);
-                g_cells[r][c].bold = (flags & 0x10) != 0;
+                cell->align = (CellAlign)(flags & 3);
+                cell->fmt = (NumFormat)((flags >> 2) & 3);
+                cell->bold = (flags & 0x10) != 0;
             }
         }
-        off += len;
+        rd.at += len;
     }
+    montauk::close(fd);
+    montauk::mfree(buf);
 
     str_cpy(g_filepath, path, 256);
     g_modified = false;
     eval_all_cells();
-    montauk::mfree(buf);
 }
@@ -38,260 +38,461 @@ static constexpr int FORMULA_COUNT = sizeof(g_formula_list) / sizeof(g_formula_l
 // Cell reference parsing
 // ============================================================================
 
+// A column is one or two letters: A-Z, then AA, AB, ...
 static bool parse_cell_ref(const char* s, int* col, int* row, int* consumed) {
     int i = 0;
-    char c = to_upper(s[i]);
-    if (c < 'A' || c > 'Z') return false;
-    *col = c - 'A';
+    if (!is_alpha(s[i])) return false;
+    int c = to_upper(s[i]) - 'A';
     i++;
+    if (is_alpha(s[i])) {
+        c = (c + 1) * 26 + (to_upper(s[i]) - 'A');
+        i++;
+    }
+    if (c >= MAX_COLS) return false;
+    *col = c;
 
     if (!is_digit(s[i])) return false;
     int r = 0;
     while (is_digit(s[i])) {
         r = r * 10 + (s[i] - '0');
+        if (r > MAX_ROWS) return false;
         i++;
     }
-    if (r < 1 || r > MAX_ROWS) return false;
+    if (r < 1) return false;
     *row = r - 1;
     *consumed = i;
     return true;
 }
 
 // ============================================================================
-// Formula evaluation (simple recursive-descent)
+// Formula compilation
 // ============================================================================
 
-static double eval_expr(const char* s, int* pos, bool* ok);
+// A formula is parsed once, when its cell is edited, into stack bytecode
+// (FormulaCode, kept on the cell); evaluating it just runs the code.
+// References keep where their text sits in the input so fill-down can
+// move them without parsing the formula again.
+//
+//   OP_NUM   f64                          push a constant
+//   OP_REF   col u8, row u32, pos u8, len u8
+//   OP_RANGE func u8, then two references as for OP_REF
+//   others                                operate on the top of the stack
+
+enum FormulaOp : uint8_t {
+    OP_NUM, OP_REF, OP_RANGE,
+    OP_NEG, OP_ADD, OP_SUB, OP_MUL, OP_DIV,
+    OP_ABS, OP_SQRT, OP_INT, OP_FLOOR, OP_CEIL,
+    OP_ROUND, OP_POW, OP_MOD, OP_IF,
+};
 
-static double cell_value(int col, int row) {
-    if (col < 0 || col >= MAX_COLS || row < 0 || row >= MAX_ROWS) return 0;
-    return g_cells[row][col].value;
+enum RangeFunc : uint8_t { RF_SUM, RF_AVG, RF_MIN, RF_MAX, RF_COUNT };
+
+static constexpr int REF_BYTES      = 7;
+static constexpr int REF_POS        = 5;   // offsets of pos and len in a reference
+static constexpr int REF_LEN        = 6;
+static constexpr int FORMULA_CODE_MAX = 1024;
+static constexpr int FORMULA_STACK  = 64;
+
+static int ref_col(const uint8_t* r) { return r[0]; }
+static int ref_row(const uint8_t* r) { return r[1] | (r[2] << 8) | (r[3] << 16) | (r[4] << 24); }
+
+static void set_ref(uint8_t* r, int col, int row, int at, int n) {
+    r[0] = (uint8_t)col;
+    r[1] = (uint8_t)row;
+    r[2] = (uint8_t)(row >> 8);
+    r[3] = (uint8_t)(row >> 16);
+    r[4] = (uint8_t)(row >> 24);
+    r[REF_POS] = (uint8_t)at;
+    r[REF_LEN] = (uint8_t)n;
 }
 
-static double eval_range_func(const char* func, const char* s, int* pos, bool* ok) {
-    if (s[*pos] != '(') { *ok = false; return 0; }
-    (*pos)++;
+static int op_size(uint8_t op) {
+    switch (op) {
+    case OP_NUM:   return 1 + 8;
+    case OP_REF:   return 1 + REF_BYTES;
+    case OP_RANGE: return 2 + 2 * REF_BYTES;
+    default:       return 1;
+    }
+}
 
-    int c1, r1, c2, r2, consumed;
-    if (!parse_cell_ref(s + *pos, &c1, &r1, &consumed)) { *ok = false; return 0; }
-    *pos += consumed;
+struct FormulaCompiler {
+    const char* s;
+    int pos;
+    bool ok;
+    uint8_t code[FORMULA_CODE_MAX];
+    int len;
+    int depth, max_depth;
+
+    // Emit an op that changes the stack depth by `delta`
+    void op(uint8_t o, int delta) {
+        if (len >= FORMULA_CODE_MAX) { ok = false; return; }
+        code[len++] = o;
+        depth += delta;
+        if (depth > max_depth) max_depth = depth;
+    }
+
+    void bytes(const void* p, int n) {
+        if (len + n > FORMULA_CODE_MAX) { ok = false; return; }
+        montauk::memcpy(code + len, p, n);
+        len += n;
+    }
+
+    void ref(int col, int row, int at, int n) {
+        uint8_t b[REF_BYTES];
+        set_ref(b, col, row, at, n);
+        bytes(b, REF_BYTES);
+    }
 
-    if (s[*pos] != ':') { *ok = false; return 0; }
-    (*pos)++;
+    void skip_spaces() {
+        while (s[pos] == ' ') pos++;
+    }
 
-    if (!parse_cell_ref(s + *pos, &c2, &r2, &consumed)) { *ok = false; return 0; }
-    *pos += consumed;
+    void expr();
+    void term();
+    void primary();
+    void range_func(RangeFunc f);
+};
 
-    if (s[*pos] != ')') { *ok = false; return 0; }
-    (*pos)++;
+void FormulaCompiler::range_func(RangeFunc f) {
+    if (s[pos] != '(') { ok = false; return; }
+    pos++;
 
-    if (c1 > c2) { int t = c1; c1 = c2; c2 = t; }
-    if (r1 > r2) { int t = r1; r1 = r2; r2 = t; }
+    int c1, r1, c2, r2, n1, n2;
+    if (!parse_cell_ref(s + pos, &c1, &r1, &n1)) { ok = false; return; }
+    int at1 = pos;
+    pos += n1;
 
-    double sum = 0;
-    int count = 0;
-    for (int r = r1; r <= r2; r++) {
-        for (int c = c1; c <= c2; c++) {
-            sum += cell_value(c, r);
-            count++;
-        }
-    }
+    if (s[pos] != ':') { ok = false; return; }
+    pos++;
 
-    bool is_sum = (func[0] == 'S' || func[0] == 's');
-    bool is_avg = (func[0] == 'A' || func[0] == 'a');
-    bool is_min = (func[0] == 'M' || func[0] == 'm') && (func[1] == 'I' || func[1] == 'i');
-    bool is_max = (func[0] == 'M' || func[0] == 'm') && (func[1] == 'A' || func[1] == 'a');
-    bool is_cnt = (func[0] == 'C' || func[0] == 'c');
-
-    if (is_sum) return sum;
-    if (is_avg) return count > 0 ? sum / count : 0;
-    if (is_cnt) return (double)count;
-    if (is_min || is_max) {
-        double result = cell_value(c1, r1);
-        for (int r = r1; r <= r2; r++) {
-            for (int c = c1; c <= c2; c++) {
-                double v = cell_value(c, r);
-                if (is_min && v < result) result = v;
-                if (is_max && v > result) result = v;
-            }
-        }
-        return result;
-    }
+    if (!parse_cell_ref(s + pos, &c2, &r2, &n2)) { ok = false; return; }
+    int at2 = pos;
+    pos += n2;
 
-    *ok = false;
-    return 0;
-}
+    if (s[pos] != ')') { ok = false; return; }
+    pos++;
 
-static void skip_spaces(const char* s, int* pos) {
-    while (s[*pos] == ' ') (*pos)++;
+    op(OP_RANGE, 1);
+    uint8_t fb = f;
+    bytes(&fb, 1);
+    ref(c1, r1, at1, n1);
+    ref(c2, r2, at2, n2);
 }
 
-static double eval_primary(const char* s, int* pos, bool* ok) {
-    skip_spaces(s, pos);
+void FormulaCompiler::primary() {
+    skip_spaces();
 
-    if (s[*pos] == '-') {
-        (*pos)++;
-        return -eval_primary(s, pos, ok);
+    if (s[pos] == '-') {
+        pos++;
+        primary();
+        op(OP_NEG, 0);
+        return;
     }
 
-    if (s[*pos] == '(') {
-        (*pos)++;
-        double v = eval_expr(s, pos, ok);
-        skip_spaces(s, pos);
-        if (s[*pos] == ')') (*pos)++;
-        return v;
+    if (s[pos] == '(') {
+        pos++;
+        expr();
+        skip_spaces();
+        if (s[pos] == ')') pos++;
+        return;
     }
 
-    if (is_alpha(s[*pos])) {
+    if (is_alpha(s[pos])) {
         char fname[8] = {};
         int fi = 0;
-        int save_pos = *pos;
-        while (is_alpha(s[*pos]) && fi < 7) {
-            fname[fi++] = to_upper(s[*pos]);
-            (*pos)++;
+        int save_pos = pos;
+        while (is_alpha(s[pos]) && fi < 7) {
+            fname[fi++] = to_upper(s[pos]);
+            pos++;
         }
         fname[fi] = '\0';
 
-        // Range functions: SUM, AVG, MIN, MAX, COUNT
-        if (s[*pos] == '(' && (strcmp(fname, "SUM") == 0 ||
-                                strcmp(fname, "AVG") == 0 ||
-                                strcmp(fname, "MIN") == 0 ||
-                                strcmp(fname, "MAX") == 0 ||
-                                strcmp(fname, "COUNT") == 0)) {
-            return eval_range_func(fname, s, pos, ok);
-        }
-
-        // No-arg: PI()
-        if (s[*pos] == '(' && strcmp(fname, "PI") == 0) {
-            (*pos)++;
-            skip_spaces(s, pos);
-            if (s[*pos] == ')') (*pos)++;
-            return 3.14159265358979;
-        }
-
-        // Single-arg functions
-        if (s[*pos] == '(' && (strcmp(fname, "ABS") == 0 ||
-                                strcmp(fname, "SQRT") == 0 ||
-                                strcmp(fname, "INT") == 0 ||
-                                strcmp(fname, "FLOOR") == 0 ||
-                                strcmp(fname, "CEIL") == 0)) {
-            (*pos)++;
-            double arg = eval_expr(s, pos, ok);
-            skip_spaces(s, pos);
-            if (s[*pos] == ')') (*pos)++;
-            if (!*ok) return 0;
-            if (strcmp(fname, "ABS") == 0)   return stb_fabs(arg);
-            if (strcmp(fname, "SQRT") == 0)  return stb_sqrt(arg);
-            if (strcmp(fname, "INT") == 0)   return (double)(long long)arg;
-            if (strcmp(fname, "FLOOR") == 0) return stb_floor(arg);
-            if (strcmp(fname, "CEIL") == 0)  return stb_ceil(arg);
-            return 0;
-        }
+        if (s[pos] == '(') {
+            // Range functions: SUM, AVG, MIN, MAX, COUNT
+            if (strcmp(fname, "SUM") == 0)   { range_func(RF_SUM); return; }
+            if (strcmp(fname, "AVG") == 0)   { range_func(RF_AVG); return; }
+            if (strcmp(fname, "MIN") == 0)   { range_func(RF_MIN); return; }
+            if (strcmp(fname, "MAX") == 0)   { range_func(RF_MAX); return; }
+            if (strcmp(fname, "COUNT") == 0) { range_func(RF_COUNT); return; }
+
+            // No-arg: PI()
+            if (strcmp(fname, "PI") == 0) {
+                pos++;
+                skip_spaces();
+                if (s[pos] == ')') pos++;
+                double pi = 3.14159265358979;
+                op(OP_NUM, 1);
+                bytes(&pi, 8);
+                return;
+            }
 
-        // Two-arg functions: ROUND, POW, MOD
-        if (s[*pos] == '(' && (strcmp(fname, "ROUND") == 0 ||
-                                strcmp(fname, "POW") == 0 ||
-                                strcmp(fname, "MOD") == 0)) {
-            (*pos)++;
-            double a = eval_expr(s, pos, ok);
-            skip_spaces(s, pos);
-            if (s[*pos] != ',') { *ok = false; return 0; }
-            (*pos)++;
-            double b = eval_expr(s, pos, ok);
-            skip_spaces(s, pos);
-            if (s[*pos] == ')') (*pos)++;
-            if (!*ok) return 0;
-            if (strcmp(fname, "POW") == 0) return stb_pow(a, b);
-            if (strcmp(fname, "MOD") == 0) {
-                if (b == 0) { *ok = false; return 0; }
-                return stb_fmod(a, b);
+            // Single-arg functions
+            uint8_t unary = strcmp(fname, "ABS") == 0   ? OP_ABS
+                          : strcmp(fname, "SQRT") == 0  ? OP_SQRT
+                          : strcmp(fname, "INT") == 0   ? OP_INT
+                          : strcmp(fname, "FLOOR") == 0 ? OP_FLOOR
+                          : strcmp(fname, "CEIL") == 0  ? OP_CEIL : 0;
+            if (unary) {
+                pos++;
+                expr();
+                skip_spaces();
+                if (s[pos] == ')') pos++;
+                op(unary, 0);
+                return;
             }
-            if (strcmp(fname, "ROUND") == 0) {
-                double factor = stb_pow(10.0, b);
-                return stb_floor(a * factor + 0.5) / factor;
+
+            // Two-arg functions: ROUND, POW, MOD
+            uint8_t binary = strcmp(fname, "ROUND") == 0 ? OP_ROUND
+                           : strcmp(fname, "POW") == 0   ? OP_POW
+                           : strcmp(fname, "MOD") == 0   ? OP_MOD : 0;
+            if (binary) {
+                pos++;
+                expr();
+                skip_spaces();
+                if (s[pos] != ',') { ok = false; return; }
+                pos++;
+                expr();
+                skip_spaces();
+                if (s[pos] == ')') pos++;
+                op(binary, -1);
+                return;
             }
-            return 0;
-        }
 
-        // IF(condition, true_value, false_value)
-        if (s[*pos] == '(' && strcmp(fname, "IF") == 0) {
-            (*pos)++;
-            double cond = eval_expr(s, pos, ok);
-            skip_spaces(s, pos);
-            if (s[*pos] != ',') { *ok = false; return 0; }
-            (*pos)++;
-            double tv = eval_expr(s, pos, ok);
-            skip_spaces(s, pos);
-            if (s[*pos] != ',') { *ok = false; return 0; }
-            (*pos)++;
-            double fv = eval_expr(s, pos, ok);
-            skip_spaces(s, pos);
-            if (s[*pos] == ')') (*pos)++;
-            if (!*ok) return 0;
-            return (cond != 0.0) ? tv : fv;
+            // IF(condition, true_value, false_value); all three are evaluated
+            if (strcmp(fname, "IF") == 0) {
+                pos++;
+                expr();
+                skip_spaces();
+                if (s[pos] != ',') { ok = false; return; }
+                pos++;
+                expr();
+                skip_spaces();
+                if (s[pos] != ',') { ok = false; return; }
+                pos++;
+                expr();
+                skip_spaces();
+                if (s[pos] == ')') pos++;
+                op(OP_IF, -2);
+                return;
+            }
         }
 
         // Fall back to cell reference
-        *pos = save_pos;
+        pos = save_pos;
         int col, row, consumed;
-        if (parse_cell_ref(s + *pos, &col, &row, &consumed)) {
-            *pos += consumed;
-            return cell_value(col, row);
+        if (parse_cell_ref(s + pos, &col, &row, &consumed)) {
+            op(OP_REF, 1);
+            ref(col, row, pos, consumed);
+            pos += consumed;
+            return;
         }
 
-        *ok = false;
-        return 0;
+        ok = false;
+        return;
     }
 
-    if (is_digit(s[*pos]) || s[*pos] == '.') {
+    if (is_digit(s[pos]) || s[pos] == '.') {
         double result = 0;
-        while (is_digit(s[*pos])) {
-            result = result * 10 + (s[*pos] - '0');
-            (*pos)++;
+        while (is_digit(s[pos])) {
+            result = result * 10 + (s[pos] - '0');
+            pos++;
         }
-        if (s[*pos] == '.') {
-            (*pos)++;
+        if (s[pos] == '.') {
+            pos++;
             double frac = 0.1;
-            while (is_digit(s[*pos])) {
-                result += (s[*pos] - '0') * frac;
+            while (is_digit(s[pos])) {
+                result += (s[pos] - '0') * frac;
                 frac *= 0.1;
-                (*pos)++;
+                pos++;
             }
         }
-        return result;
+        op(OP_NUM, 1);
+        bytes(&result, 8);
+        return;
     }
 
-    *ok = false;
-    return 0;
+    ok = false;
 }
 
-static double eval_term(const char* s, int* pos, bool* ok) {
-    double left = eval_primary(s, pos, ok);
-    while (*ok) {
-        skip_spaces(s, pos);
-        char op = s[*pos];
-        if (op != '*' && op != '/') break;
-        (*pos)++;
-        double right = eval_primary(s, pos, ok);
-        if (op == '*') left *= right;
-        else if (right != 0) left /= right;
-        else { *ok = false; return 0; }
-    }
-    return left;
+void FormulaCompiler::term() {
+    primary();
+    while (ok) {
+        skip_spaces();
+        char c = s[pos];
+        if (c != '*' && c != '/') break;
+        pos++;
+        primary();
+        op(c == '*' ? OP_MUL : OP_DIV, -1);
+    }
+}
+
+void FormulaCompiler::expr() {
+    term();
+    while (ok) {
+        skip_spaces();
+        char c = s[pos];
+        if (c != '+' && c != '-') break;
+        pos++;
+        term();
+        op(c == '+' ? OP_ADD : OP_SUB, -1);
+    }
 }
 
-static double eval_expr(const char* s, int* pos, bool* ok) {
-    double left = eval_term(s, pos, ok);
-    while (*ok) {
-        skip_spaces(s, pos);
-        char op = s[*pos];
-        if (op != '+' && op != '-') break;
-        (*pos)++;
-        double right = eval_term(s, pos, ok);
-        if (op == '+') left += right;
-        else left -= right;
-    }
-    return left;
+// Compile a formula (the input after '='), or nullptr if it does not parse
+static FormulaCode* compile_formula(const char* s) {
+    FormulaCompiler* fc = (FormulaCompiler*)montauk::malloc(sizeof(FormulaCompiler));
+    if (!fc) return nullptr;
+    fc->s = s;
+    fc->pos = 0;
+    fc->ok = true;
+    fc->len = 0;
+    fc->depth = 0;
+    fc->max_depth = 0;
+    fc->expr();
+
+    FormulaCode* f = nullptr;
+    if (fc->ok && fc->max_depth <= FORMULA_STACK) {
+        f = (FormulaCode*)montauk::malloc(sizeof(FormulaCode) + fc->len);
+        if (f) {
+            f->len = (uint16_t)fc->len;
+            montauk::memcpy(f->code, fc->code, fc->len);
+        }
+    }
+    montauk::mfree(fc);
+    return f;
+}
+
+// Recompile the cell's formula after its input changed
+void compile_cell(int col, int row) {
+    Cell* c = cell_at(col, row);
+    if (!c) return;
+    if (c->code) montauk::mfree(c->code);
+    c->code = c->input[0] == '=' ? compile_formula(c->input + 1) : nullptr;
+}
+
+// The cells and ranges a compiled formula reads; returns how many were
+// stored in `out`
+int formula_refs(const FormulaCode* f, CellRange* out, int max) {
+    int n = 0;
+    for (int i = 0; i < f->len && n < max; i += op_size(f->code[i])) {
+        const uint8_t* p = f->code + i + 1;
+        if (f->code[i] == OP_REF) {
+            int col = ref_col(p), row = ref_row(p);
+            out[n++] = {col, row, col, row};
+        } else if (f->code[i] == OP_RANGE) {
+            const uint8_t* a = p + 1;
+            const uint8_t* b = a + REF_BYTES;
+            int c1 = ref_col(a), r1 = ref_row(a);
+            int c2 = ref_col(b), r2 = ref_row(b);
+            out[n++] = {c1 < c2 ? c1 : c2, r1 < r2 ? r1 : r2, c1 < c2 ? c2 : c1, r1 < r2 ? r2 : r1};
+        }
+    }
+    return n;
+}
+
+// ============================================================================
+// Formula execution
+// ============================================================================
+
+// Ranges are swept a column chunk at a time over the chunk's values
+// array; chunks never written hold only zeros and are skipped
+static double range_value(uint8_t func, const uint8_t* a, const uint8_t* b) {
+    int c0 = ref_col(a), r0 = ref_row(a);
+    int c1 = ref_col(b), r1 = ref_row(b);
+    if (c0 > c1) { int t = c0; c0 = c1; c1 = t; }
+    if (r0 > r1) { int t = r0; r0 = r1; r1 = t; }
+
+    double count = (double)(c1 - c0 + 1) * (double)(r1 - r0 + 1);
+    if (func == RF_COUNT) return count;
+
+    double sum = 0;
+    double lo = cell_value(c0, r0), hi = lo;
+    bool blank = false;
+    for (int c = c0; c <= c1; c++) {
+        for (int k = r0 / CHUNK_ROWS; k <= r1 / CHUNK_ROWS; k++) {
+            const CellChunk* chunk = sheet_chunk(c, k, false);
+            if (!chunk) {
+                blank = true;
+                continue;
+            }
+            int i0 = k == r0 / CHUNK_ROWS ? r0 % CHUNK_ROWS : 0;
+            int i1 = k == r1 / CHUNK_ROWS ? r1 % CHUNK_ROWS : CHUNK_ROWS - 1;
+            const double* v = chunk->values;
+            for (int i = i0; i <= i1; i++) {
+                sum += v[i];
+                if (v[i] < lo) lo = v[i];
+                if (v[i] > hi) hi = v[i];
+            }
+        }
+    }
+    if (blank) {
+        if (lo > 0) lo = 0;
+        if (hi < 0) hi = 0;
+    }
+
+    switch (func) {
+    case RF_SUM: return sum;
+    case RF_AVG: return sum / count;
+    case RF_MIN: return lo;
+    default:     return hi;
+    }
+}
+
+// Run a compiled formula; false on a math error (division or MOD by zero)
+static bool run_formula(const FormulaCode* f, double* out) {
+    double st[FORMULA_STACK];
+    int sp = 0;
+    const uint8_t* ip = f->code;
+    const uint8_t* end = f->code + f->len;
+
+    while (ip < end) {
+        uint8_t o = *ip;
+        switch (o) {
+        case OP_NUM:
+            montauk::memcpy(&st[sp++], ip + 1, 8);
+            break;
+        case OP_REF:
+            st[sp++] = cell_value(ref_col(ip + 1), ref_row(ip + 1));
+            break;
+        case OP_RANGE:
+            st[sp++] = range_value(ip[1], ip + 2, ip + 2 + REF_BYTES);
+            break;
+        case OP_NEG:   st[sp - 1] = -st[sp - 1]; break;
+        case OP_ADD:   sp--; st[sp - 1] += st[sp]; break;
+        case OP_SUB:   sp--; st[sp - 1] -= st[sp]; break;
+        case OP_MUL:   sp--; st[sp - 1] *= st[sp]; break;
+        case OP_DIV:
+            sp--;
+            if (st[sp] == 0) return false;
+            st[sp - 1] /= st[sp];
+            break;
+        case OP_ABS:   st[sp - 1] = stb_fabs(st[sp - 1]); break;
+        case OP_SQRT:  st[sp - 1] = stb_sqrt(st[sp - 1]); break;
+        case OP_INT:   st[sp - 1] = (double)(long long)st[sp - 1]; break;
+        case OP_FLOOR: st[sp - 1] = stb_floor(st[sp - 1]); break;
+        case OP_CEIL:  st[sp - 1] = stb_ceil(st[sp - 1]); break;
+        case OP_ROUND: {
+            sp--;
+            double factor = stb_pow(10.0, st[sp]);
+            st[sp - 1] = stb_floor(st[sp - 1] * factor + 0.5) / factor;
+            break;
+        }
+        case OP_POW:   sp--; st[sp - 1] = stb_pow(st[sp - 1], st[sp]); break;
+        case OP_MOD:
+            sp--;
+            if (st[sp] == 0) return false;
+            st[sp - 1] = stb_fmod(st[sp - 1], st[sp]);
+            break;
+        case OP_IF:
+            sp -= 2;
+            st[sp - 1] = st[sp - 1] != 0.0 ? st[sp] : st[sp + 1];
+            break;
+        }
+        ip += op_size(o);
+    }
+
+    *out = st[0];
+    return true;
 }
 
 // ============================================================================
@@ -336,25 +537,26 @@ void format_value(char* buf, int max, double val, NumFormat fmt) {
 }
 
 void eval_cell(int col, int row) {
-    Cell* c = &g_cells[row][col];
+    CellChunk* chunk = sheet_chunk(col, row / CHUNK_ROWS, false);
+    if (!chunk) return;
+    Cell* c = &chunk->cells[row % CHUNK_ROWS];
+    double* value = &chunk->values[row % CHUNK_ROWS];
     if (c->input[0] == '\0') {
         c->type = CT_EMPTY;
         c->display[0] = '\0';
-        c->value = 0;
+        *value = 0;
         return;
     }
 
     if (c->input[0] == '=') {
-        int pos = 1;
-        bool ok = true;
-        double val = eval_expr(c->input, &pos, &ok);
-        if (ok) {
+        double val;
+        if (c->code && run_formula(c->code, &val)) {
             c->type = CT_FORMULA;
-            c->value = val;
+            *value = val;
             format_value(c->display, CELL_TEXT_MAX, val, c->fmt);
         } else {
             c->type = CT_ERROR;
-            c->value = 0;
+            *value = 0;
             str_cpy(c->display, "#ERR", CELL_TEXT_MAX);
         }
         return;
@@ -364,21 +566,15 @@ void eval_cell(int col, int row) {
     double val = str_to_double(c->input, &ok);
     if (ok) {
         c->type = CT_NUMBER;
-        c->value = val;
+        *value = val;
         format_value(c->display, CELL_TEXT_MAX, val, c->fmt);
     } else {
         c->type = CT_TEXT;
-        c->value = 0;
+        *value = 0;
         str_cpy(c->display, c->input, CELL_TEXT_MAX);
     }
 }
 
-void eval_all_cells() {
-    for (int r = 0; r < MAX_ROWS; r++)
-        for (int c = 0; c < MAX_COLS; c++)
-            eval_cell(c, r);
-}
-
 // ============================================================================
 // Column/row geometry helpers
 // ============================================================================
@@ -399,12 +595,19 @@ int content_height() {
     return COL_HEADER_H + MAX_ROWS * ROW_H;
 }
 
+// Column letters into buf (at least 3 bytes); returns their length
+int col_name(char* buf, int col) {
+    int n = 0;
+    if (col >= 26) buf[n++] = 'A' + col / 26 - 1;
+    buf[n++] = 'A' + col % 26;
+    buf[n] = '\0';
+    return n;
+}
+
+// Two letters and the row number, so buf needs CELL_NAME_MAX bytes
 void cell_name(char* buf, int col, int row) {
-    buf[0] = 'A' + col;
-    int r = row + 1;
-    if (r >= 100) { buf[1] = '0' + r / 100; buf[2] = '0' + (r / 10) % 10; buf[3] = '0' + r % 10; buf[4] = '\0'; }
-    else if (r >= 10) { buf[1] = '0' + r / 10; buf[2] = '0' + r % 10; buf[3] = '\0'; }
-    else { buf[1] = '0' + r; buf[2] = '\0'; }
+    int n = col_name(buf, col);
+    snprintf(buf + n, CELL_NAME_MAX - n, "%d", row + 1);
 }
 
 // ============================================================================
@@ -502,7 +705,19 @@ void accept_autocomplete() {
 // Formula reference adjustment (for fill handle)
 // ============================================================================
 
-void adjust_formula_refs(const char* src, char* dst, int max, int dcol, int drow) {
+static void shift_ref(int* col, int* row, int dcol, int drow) {
+    int nc = *col + dcol;
+    int nr = *row + drow;
+    if (nc < 0) nc = 0;
+    if (nc >= MAX_COLS) nc = MAX_COLS - 1;
+    if (nr < 0) nr = 0;
+    if (nr >= MAX_ROWS) nr = MAX_ROWS - 1;
+    *col = nc;
+    *row = nr;
+}
+
+// Text-only version, for formulas that do not compile
+static void adjust_formula_text(const char* src, char* dst, int max, int dcol, int drow) {
     int si = 0, di = 0;
     while (src[si] && di < max - 1) {
         if (is_alpha(src[si])) {
@@ -517,24 +732,11 @@ void adjust_formula_refs(const char* src, char* dst, int max, int dcol, int drow
                     dst[di++] = src[si++];
                     continue;
                 }
-                int nc = col + dcol;
-                int nr = row + drow;
-                if (nc < 0) nc = 0;
-                if (nc >= MAX_COLS) nc = MAX_COLS - 1;
-                if (nr < 0) nr = 0;
-                if (nr >= MAX_ROWS) nr = MAX_ROWS - 1;
-                dst[di++] = 'A' + nc;
-                int rv = nr + 1;
-                if (rv >= 100 && di < max - 3) {
-                    dst[di++] = '0' + rv / 100;
-                    dst[di++] = '0' + (rv / 10) % 10;
-                    dst[di++] = '0' + rv % 10;
-                } else if (rv >= 10 && di < max - 2) {
-                    dst[di++] = '0' + rv / 10;
-                    dst[di++] = '0' + rv % 10;
-                } else {
-                    dst[di++] = '0' + rv;
-                }
+                shift_ref(&col, &row, dcol, drow);
+                char ref[CELL_NAME_MAX];
+                cell_name(ref, col, row);
+                for (int k = 0; ref[k] && di < max - 1; k++)
+                    dst[di++] = ref[k];
                 si += consumed;
             } else {
                 dst[di++] = src[si++];
@@ -545,3 +747,74 @@ void adjust_formula_refs(const char* src, char* dst, int max, int dcol, int drow
     }
     dst[di] = '\0';
 }
+
+// Make dst a copy of the formula in src with every reference moved by
+// (dcol, drow). The compiled code is copied and patched, and the text is
+// rebuilt around the references it records, so nothing is parsed again.
+void adjust_formula_refs(const Cell* src, Cell* dst, int dcol, int drow) {
+    if (dst->code) montauk::mfree(dst->code);
+    dst->code = nullptr;
+
+    const FormulaCode* sf = src->code;
+    FormulaCode* f = sf ? (FormulaCode*)montauk::malloc(sizeof(FormulaCode) + sf->len) : nullptr;
+    if (!f) {
+        adjust_formula_text(src->input, dst->input, CELL_TEXT_MAX, dcol, drow);
+        if (dst->input[0] == '=') dst->code = compile_formula(dst->input + 1);
+        return;
+    }
+    f->len = sf->len;
+    montauk::memcpy(f->code, sf->code, sf->len);
+
+    // The references, in the order they appear in the text
+    uint8_t* refs[FORMULA_MAX_REFS * 2];
+    int n = 0;
+    for (int i = 0; i < f->len; i += op_size(f->code[i])) {
+        if (f->code[i] == OP_REF && n < FORMULA_MAX_REFS * 2) {
+            refs[n++] = f->code + i + 1;
+        } else if (f->code[i] == OP_RANGE && n + 1 < FORMULA_MAX_REFS * 2) {
+            refs[n++] = f->code + i + 2;
+            refs[n++] = f->code + i + 2 + REF_BYTES;
+        }
+    }
+    for (int i = 1; i < n; i++) {
+        uint8_t* r = refs[i];
+        int j = i;
+        for (; j > 0 && refs[j - 1][REF_POS] > r[REF_POS]; j--) refs[j] = refs[j - 1];
+        refs[j] = r;
+    }
+
+    // Text positions in the code are relative to the character after '='
+    const char* s = src->input + 1;
+    char* out = dst->input + 1;
+    int max = CELL_TEXT_MAX - 2;
+    int si = 0, di = 0;
+    bool fits = true;
+    for (int i = 0; i < n && fits; i++) {
+        uint8_t* r = refs[i];
+        int at = r[REF_POS], len = r[REF_LEN];
+        while (si < at && di < max) out[di++] = s[si++];
+
+        int col = ref_col(r), row = ref_row(r);
+        shift_ref(&col, &row, dcol, drow);
+        char name[CELL_NAME_MAX];
+        cell_name(name, col, row);
+        int nlen = str_len(name);
+        if (di + nlen > max) { fits = false; break; }
+        set_ref(r, col, row, di, nlen);
+        montauk::memcpy(out + di, name, nlen);
+        di += nlen;
+        si = at + len;
+    }
+    while (fits && s[si] && di < max) out[di++] = s[si++];
+    dst->input[0] = '=';
+    out[di] = '\0';
+
+    if (fits && !s[si]) {
+        dst->code = f;
+    } else {
+        // Truncated: keep what fits, as the text version would
+        montauk::mfree(f);
+        adjust_formula_text(src->input, dst->input, CELL_TEXT_MAX, dcol, drow);
+        dst->code = compile_formula(dst->input + 1);
+    }
+}
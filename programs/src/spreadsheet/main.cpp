@@ -14,8 +14,6 @@
 int g_win_w = INIT_W;
 int g_win_h = INIT_H;
 
-Cell g_cells[MAX_ROWS][MAX_COLS];
-
 int g_sel_col = 0;
 int g_sel_row = 0;
 
@@ -57,7 +55,7 @@ int  g_col_resize_idx = -1;
 int  g_col_resize_start_x = 0;
 int  g_col_resize_start_w = 0;
 
-UndoEntry* g_undo[UNDO_MAX + 1];
+UndoEntry* g_undo[UNDO_MAX];
 int g_undo_count = 0;
 int g_undo_pos = 0;
 
@@ -212,33 +210,14 @@ extern "C" void _start() {
     for (int i = 0; i < MAX_COLS; i++)
         g_col_widths[i] = DEF_COL_W;
 
-    // Initialize cells
-    for (int r = 0; r < MAX_ROWS; r++)
-        for (int c = 0; c < MAX_COLS; c++) {
-            g_cells[r][c].input[0] = '\0';
-            g_cells[r][c].display[0] = '\0';
-            g_cells[r][c].value = 0;
-            g_cells[r][c].type = CT_EMPTY;
-            g_cells[r][c].align = ALIGN_AUTO;
-            g_cells[r][c].fmt = FMT_AUTO;
-            g_cells[r][c].bold = false;
-        }
-
     // Initialize undo pointers
-    for (int i = 0; i <= UNDO_MAX; i++) g_undo[i] = nullptr;
+    for (int i = 0; i < UNDO_MAX; i++) g_undo[i] = nullptr;
     g_undo_count = 0;
     g_undo_pos = 0;
 
     // Load font
-    auto load_font = [](const char* path) -> TrueTypeFont* {
-        TrueTypeFont* f = (TrueTypeFont*)montauk::malloc(sizeof(TrueTypeFont));
-        if (!f) return nullptr;
-        montauk::memset(f, 0, sizeof(TrueTypeFont));
-        if (!f->init(path)) { montauk::mfree(f); return nullptr; }
-        return f;
-    };
-    g_font = load_font("0:/fonts/Roboto-Medium.ttf");
-    g_font_bold = load_font("0:/fonts/Roboto-Bold.ttf");
+    g_font = fonts::open("0:/fonts/Roboto-Medium.ttf");
+    g_font_bold = fonts::open("0:/fonts/Roboto-Bold.ttf");
 
     // Check for file argument
     char args[512] = {};
@@ -453,10 +432,8 @@ extern "C" void _start() {
                     undo_push();
                     int c0, r0, c1, r1;
                     sel_range(&c0, &r0, &c1, &r1);
-                    for (int r = r0; r <= r1; r++)
-                        for (int c = c0; c <= c1; c++)
-                            g_cells[r][c].input[0] = '\0';
-                    eval_all_cells();
+                    clear_range(c0, r0, c1, r1);
+                    recalc();
                     g_modified = true;
                     redraw = true;
                 }
@@ -476,10 +453,8 @@ extern "C" void _start() {
                     undo_push();
                     int c0, r0, c1, r1;
                     sel_range(&c0, &r0, &c1, &r1);
-                    for (int r = r0; r <= r1; r++)
-                        for (int c = c0; c <= c1; c++)
-                            g_cells[r][c].input[0] = '\0';
-                    eval_all_cells();
+                    clear_range(c0, r0, c1, r1);
+                    recalc();
                     g_modified = true;
                     redraw = true;
                 }
@@ -516,7 +491,7 @@ extern "C" void _start() {
                     // Jump to last non-empty column in current row
                     int last = 0;
                     for (int c = 0; c < MAX_COLS; c++)
-                        if (g_cells[g_sel_row][c].input[0]) last = c;
+                        if (cell_peek(c, g_sel_row)->input[0]) last = c;
                     g_sel_col = last;
                     clear_selection();
                     ensure_sel_visible();
@@ -13,7 +13,7 @@ void render(uint32_t* pixels) {
     px_fill(pixels, g_win_w, g_win_h, 0, 0, g_win_w, TOOLBAR_H, TOOLBAR_BG);
     px_hline(pixels, g_win_w, g_win_h, 0, TOOLBAR_H - 1, g_win_w, GRID_COLOR);
 
-    Cell* cur_cell = &g_cells[g_sel_row][g_sel_col];
+    const Cell* cur_cell = cell_peek(g_sel_col, g_sel_row);
 
     int bx = 4;
     auto tb_btn = [&](int w, bool active, const char* label) {
@@ -115,7 +115,7 @@ void render(uint32_t* pixels) {
     px_fill(pixels, g_win_w, g_win_h, 0, fbar_y, g_win_w, FORMULA_BAR_H, HEADER_BG);
     px_hline(pixels, g_win_w, g_win_h, 0, fbar_y + FORMULA_BAR_H - 1, g_win_w, GRID_COLOR);
 
-    char name_buf[8];
+    char name_buf[CELL_NAME_MAX];
     cell_name(name_buf, g_sel_col, g_sel_row);
     int fbar_ty = fbar_y + (FORMULA_BAR_H - HEADER_FONT) / 2;
     if (g_font)
@@ -166,7 +166,8 @@ void render(uint32_t* pixels) {
                 px_fill(pixels, g_win_w, g_win_h, x, area_y, g_col_widths[c], COL_HEADER_H, SELECT_FILL);
         }
 
-        char label[2] = { (char)('A' + c), '\0' };
+        char label[4];
+        col_name(label, c);
         if (g_font) {
             int tw = g_font->measure_text(label, HEADER_FONT);
             int lx = x + (g_col_widths[c] - tw) / 2;
@@ -181,7 +182,7 @@ void render(uint32_t* pixels) {
     int grid_y = area_y + COL_HEADER_H;
     int grid_h = g_win_h - TOOLBAR_H - pathbar_h - FORMULA_BAR_H - COL_HEADER_H - STATUS_BAR_H;
 
-    for (int r = 0; r < MAX_ROWS; r++) {
+    for (int r = g_scroll_y / ROW_H; r < MAX_ROWS; r++) {
         int y = grid_y + r * ROW_H - g_scroll_y;
         if (y + ROW_H <= grid_y) continue;
         if (y >= grid_y + grid_h) break;
@@ -197,10 +198,7 @@ void render(uint32_t* pixels) {
         }
 
         char row_label[8];
-        int rv = r + 1;
-        if (rv >= 100) { row_label[0] = '0' + rv / 100; row_label[1] = '0' + (rv / 10) % 10; row_label[2] = '0' + rv % 10; row_label[3] = '\0'; }
-        else if (rv >= 10) { row_label[0] = '0' + rv / 10; row_label[1] = '0' + rv % 10; row_label[2] = '\0'; }
-        else { row_label[0] = '0' + rv; row_label[1] = '\0'; }
+        snprintf(row_label, sizeof(row_label), "%d", r + 1);
 
         if (g_font) {
             int tw = g_font->measure_text(row_label, HEADER_FONT);
@@ -216,7 +214,7 @@ void render(uint32_t* pixels) {
             if (x + g_col_widths[c] <= ROW_HEADER_W) continue;
             if (x >= g_win_w) break;
 
-            Cell* cell = &g_cells[r][c];
+            const Cell* cell = cell_peek(c, r);
 
             // Selection fill (drawn before text so text is visible)
             if (g_has_selection) {
@@ -326,14 +324,21 @@ void render(uint32_t* pixels) {
             int c0, r0, c1, r1;
             sel_range(&c0, &r0, &c1, &r1);
 
-            // Calculate aggregates for numeric cells
+            // Calculate aggregates for numeric cells, skipping blank chunks
             double sum = 0;
             int num_count = 0;
-            for (int r = r0; r <= r1; r++) {
-                for (int c = c0; c <= c1; c++) {
-                    if (g_cells[r][c].type == CT_NUMBER || g_cells[r][c].type == CT_FORMULA) {
-                        sum += g_cells[r][c].value;
-                        num_count++;
+            for (int c = c0; c <= c1; c++) {
+                for (int k = r0 / CHUNK_ROWS; k <= r1 / CHUNK_ROWS; k++) {
+                    const CellChunk* chunk = sheet_chunk(c, k, false);
+                    if (!chunk) continue;
+                    for (int i = 0; i < CHUNK_ROWS; i++) {
+                        int r = k * CHUNK_ROWS + i;
+                        if (r < r0 || r > r1) continue;
+                        CellType t = chunk->cells[i].type;
+                        if (t == CT_NUMBER || t == CT_FORMULA) {
+                            sum += chunk->values[i];
+                            num_count++;
+                        }
                     }
                 }
             }
@@ -344,19 +349,19 @@ void render(uint32_t* pixels) {
                 double_to_str(abuf, 24, sum / num_count);
                 snprintf(right, 128, "SUM=%s  AVG=%s  COUNT=%d ", sbuf, abuf, num_count);
             } else {
-                char n0[8], n1[8];
+                char n0[CELL_NAME_MAX], n1[CELL_NAME_MAX];
                 cell_name(n0, c0, r0);
                 cell_name(n1, c1, r1);
                 int ncells = (c1 - c0 + 1) * (r1 - r0 + 1);
                 snprintf(right, 128, "%s:%s (%d cells) ", n0, n1, ncells);
             }
         } else {
-            Cell* sel = &g_cells[g_sel_row][g_sel_col];
-            char cname[8];
+            const Cell* sel = cell_peek(g_sel_col, g_sel_row);
+            char cname[CELL_NAME_MAX];
             cell_name(cname, g_sel_col, g_sel_row);
             if (sel->type == CT_FORMULA || sel->type == CT_NUMBER) {
                 char vbuf[32];
-                double_to_str(vbuf, 32, sel->value);
+                double_to_str(vbuf, 32, cell_value(g_sel_col, g_sel_row));
                 snprintf(right, 128, "%s = %s ", cname, vbuf);
             } else {
                 snprintf(right, 128, "%s ", cname);
@@ -0,0 +1,72 @@
+/*
+ * sheet.cpp
+ * Sparse, chunked cell storage
+ * Copyright (c) 2026 Daniel Hammer
+ */
+
+#include "spreadsheet.h"
+
+// The sheet is stored by column. Each column has a directory of
+// CHUNK_COUNT chunk pointers, allocated the first time anything in the
+// column is written, and each chunk holds CHUNK_ROWS consecutive cells of
+// that column. Their values sit in their own array, so formulas that
+// sweep a range read contiguous doubles. Chunks nobody has written are
+// never allocated and read as blank.
+
+static CellChunk** g_columns[MAX_COLS];
+static const Cell  g_blank_cell = {};
+
+CellChunk* sheet_chunk(int col, int index, bool create) {
+    CellChunk** dir = g_columns[col];
+    if (!dir) {
+        if (!create) return nullptr;
+        dir = (CellChunk**)montauk::malloc(CHUNK_COUNT * sizeof(CellChunk*));
+        if (!dir) return nullptr;
+        montauk::memset(dir, 0, CHUNK_COUNT * sizeof(CellChunk*));
+        g_columns[col] = dir;
+    }
+    if (!dir[index] && create) {
+        CellChunk* chunk = (CellChunk*)montauk::malloc(sizeof(CellChunk));
+        if (!chunk) return nullptr;
+        montauk::memset(chunk, 0, sizeof(CellChunk));
+        dir[index] = chunk;
+    }
+    return dir[index];
+}
+
+Cell* cell_at(int col, int row) {
+    CellChunk* chunk = sheet_chunk(col, row / CHUNK_ROWS, false);
+    return chunk ? &chunk->cells[row % CHUNK_ROWS] : nullptr;
+}
+
+Cell* cell_touch(int col, int row) {
+    CellChunk* chunk = sheet_chunk(col, row / CHUNK_ROWS, true);
+    return chunk ? &chunk->cells[row % CHUNK_ROWS] : nullptr;
+}
+
+const Cell* cell_peek(int col, int row) {
+    const Cell* c = cell_at(col, row);
+    return c ? c : &g_blank_cell;
+}
+
+double cell_value(int col, int row) {
+    CellChunk* chunk = sheet_chunk(col, row / CHUNK_ROWS, false);
+    return chunk ? chunk->values[row % CHUNK_ROWS] : 0;
+}
+
+// Free every chunk, leaving an empty sheet
+void sheet_clear() {
+    for (int c = 0; c < MAX_COLS; c++) {
+        CellChunk** dir = g_columns[c];
+        if (!dir) continue;
+        for (int i = 0; i < CHUNK_COUNT; i++) {
+            if (!dir[i]) continue;
+            for (int r = 0; r < CHUNK_ROWS; r++) {
+                if (dir[i]->cells[r].code) montauk::mfree(dir[i]->cells[r].code);
+            }
+            montauk::mfree(dir[i]);
+        }
+        montauk::mfree(dir);
+        g_columns[c] = nullptr;
+    }
+}
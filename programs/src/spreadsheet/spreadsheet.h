@@ -29,15 +29,17 @@ static constexpr int INIT_H        = 600;
 static constexpr int TOOLBAR_H     = 36;
 static constexpr int FORMULA_BAR_H = 36;
 static constexpr int COL_HEADER_H  = 28;
-static constexpr int ROW_HEADER_W  = 48;
+static constexpr int ROW_HEADER_W  = 64;
 static constexpr int STATUS_BAR_H  = 24;
 static constexpr int SCROLL_STEP   = 50;
 static constexpr int TB_BTN_SIZE   = 24;
 static constexpr int TB_BTN_Y      = 6;
 static constexpr int TB_BTN_RAD    = 3;
 
-static constexpr int MAX_COLS      = 26;   // A-Z
-static constexpr int MAX_ROWS      = 100;
+static constexpr int MAX_COLS      = 52;   // A-Z, AA-AZ
+static constexpr int MAX_ROWS      = 262144;
+static constexpr int CHUNK_ROWS    = 64;    // cells per storage chunk (one column)
+static constexpr int CHUNK_COUNT   = MAX_ROWS / CHUNK_ROWS;
 static constexpr int DEF_COL_W     = 100;
 static constexpr int MIN_COL_W     = 30;
 static constexpr int ROW_H         = 26;
@@ -47,6 +49,8 @@ static constexpr int AC_MAX_MATCHES  = 8;
 static constexpr int DBLCLICK_MS     = 400;
 
 static constexpr int CELL_TEXT_MAX = 128;
+static constexpr int CELL_NAME_MAX = 12;    // "AZ262144"
+static constexpr int FORMULA_MAX_REFS = 64;   // more than a CELL_TEXT_MAX formula can hold
 static constexpr int FONT_SIZE     = 18;
 static constexpr int HEADER_FONT   = 16;
 
@@ -83,14 +87,35 @@ enum CellType : uint8_t {
     CT_ERROR = 4,
 };
 
+// A formula compiled to stack bytecode (see formula.cpp)
+struct FormulaCode {
+    uint16_t len;
+    uint8_t  code[];
+};
+
+// The numeric value (for formulas/numbers) is kept beside the cell, in
+// its chunk's values array
 struct Cell {
     char input[CELL_TEXT_MAX];   // raw user input
     char display[CELL_TEXT_MAX]; // computed display string
-    double value;                // numeric value (for formulas/numbers)
+    FormulaCode* code;           // compiled input, if it is a formula that parses
+    int32_t ref_head;            // dependency graph: the formula's references
+    int32_t indegree;            // recalculation scratch
     CellType type;
     CellAlign align;
     NumFormat fmt;
     bool bold;
+    bool queued;                 // waiting for recalc()
+};
+
+struct CellChunk {
+    double values[CHUNK_ROWS];
+    Cell   cells[CHUNK_ROWS];
+};
+
+// A cell reference, or a range of them (c0 <= c1, r0 <= r1)
+struct CellRange {
+    int c0, r0, c1, r1;
 };
 
 static constexpr int CLIP_MAX_CELLS = 256;
@@ -103,15 +128,22 @@ struct ClipCell {
     bool bold;
 };
 
-static constexpr int UNDO_MAX = 6;
+static constexpr int UNDO_MAX = 64;
 struct UndoCellData {
     char input[CELL_TEXT_MAX];
+    uint32_t row;
+    uint16_t col;
     CellAlign align;
     NumFormat fmt;
     bool bold;
 };
+
+// The cells one edit changed, in the order it changed them, with the
+// state each had before. Undo and redo swap that state with the sheet's.
 struct UndoEntry {
-    UndoCellData cells[MAX_ROWS][MAX_COLS];
+    int count;
+    int capacity;
+    UndoCellData* cells;
 };
 
 static constexpr int PATHBAR_H = 32;
@@ -138,7 +170,6 @@ static constexpr int TB_REDO_X0 = 456, TB_REDO_X1 = 492;
 // ============================================================================
 
 extern int g_win_w, g_win_h;
-extern Cell g_cells[MAX_ROWS][MAX_COLS];
 extern int g_sel_col, g_sel_row;
 extern int g_scroll_x, g_scroll_y;
 extern int g_col_widths[MAX_COLS];
@@ -174,7 +205,7 @@ extern int  g_col_resize_idx;
 extern int  g_col_resize_start_x;
 extern int  g_col_resize_start_w;
 
-extern UndoEntry* g_undo[UNDO_MAX + 1];
+extern UndoEntry* g_undo[UNDO_MAX];
 extern int g_undo_count;
 extern int g_undo_pos;
 
@@ -215,12 +246,25 @@ char to_upper(char c);
 double str_to_double(const char* s, bool* ok);
 void double_to_str(char* buf, int max, double v);
 
+// ============================================================================
+// Function declarations — sheet.cpp
+// ============================================================================
+
+CellChunk*  sheet_chunk(int col, int index, bool create);
+Cell*       cell_at(int col, int row);
+Cell*       cell_touch(int col, int row);
+const Cell* cell_peek(int col, int row);
+double      cell_value(int col, int row);
+void        sheet_clear();
+
 // ============================================================================
 // Function declarations — formula.cpp
 // ============================================================================
 
 void eval_cell(int col, int row);
-void eval_all_cells();
+void compile_cell(int col, int row);
+int  formula_refs(const FormulaCode* f, CellRange* out, int max);
+int  col_name(char* buf, int col);
 int  col_x(int col);
 int  content_width();
 int  content_height();
@@ -228,7 +272,15 @@ void cell_name(char* buf, int col, int row);
 void format_value(char* buf, int max, double val, NumFormat fmt);
 void update_autocomplete();
 void accept_autocomplete();
-void adjust_formula_refs(const char* src, char* dst, int max, int dcol, int drow);
+void adjust_formula_refs(const Cell* src, Cell* dst, int dcol, int drow);
+
+// ============================================================================
+// Function declarations — depgraph.cpp
+// ============================================================================
+
+void cell_changed(int col, int row, bool compile = true);
+void recalc();
+void eval_all_cells();
 
 // ============================================================================
 // Function declarations — fileio.cpp
@@ -242,6 +294,9 @@ void load_file(const char* path);
 // ============================================================================
 
 void undo_push();
+void undo_clear();
+Cell* cell_for_edit(int col, int row);
+void clear_range(int c0, int r0, int c1, int r1);
 void undo_do();
 void redo_do();
 void start_editing();
@@ -0,0 +1,295 @@
+/*
+    * main.cpp
+    * syscallstat - Count and time system calls
+    * Copyright (c) 2026 Daniel Hammer
+*/
+
+#include <montauk/syscall.h>
+#include <montauk/string.h>
+#include <montauk/args.h>
+
+using Montauk::SyscallStatInfo;
+
+static constexpr uint64_t DEFAULT_MS = 1000;
+static constexpr int MAX_PROCS   = 1024;
+static constexpr int NAME_WIDTH  = 18;
+static constexpr int BAR_WIDTH   = 30;
+static constexpr int TOP_PER_PROCESS = 5;
+
+static const char* const g_names[] = {
+    "exit", "yield", "sleep_ms", "getpid", "print", "putchar", "open", "read",
+    "getsize", "close", "readdir", "alloc", "free", "getticks",
+    "getmilliseconds", "getinfo", "iskeyavailable", "getkey", "getchar",
+    "ping", "spawn", "fbinfo", "fbmap", "waitpid", "termsize", "getargs",
+    "reset", "shutdown", "gettime", "socket", "connect", "bind", "listen",
+    "accept", "send", "recv", "closesock", "getnetcfg", "setnetcfg", "sendto",
+    "recvfrom", "fwrite", "fcreate", "termscale", "resolve", "getrandom",
+    "klog", "mousestate", "setmousebounds", "spawn_redir", "childio_read",
+    "childio_write", "childio_writekey", "childio_settermsz", "wincreate",
+    "windestroy", "winpresent", "winpoll", "winenum", "winmap",
+    "winsendevent", "proclist", "kill", "devlist", "winresize", "winsetscale",
+    "wingetscale", "memstats", "winsetcursor", "diskinfo", "partlist",
+    "diskread", "diskwrite", "gptinit", "gptadd", "fsmount", "fsformat",
+    "fdelete", "fmkdir", "drivelist", "audioopen", "audioclose", "audiowrite",
+    "audioctl", "btscan", "btconnect", "btdisconnect", "btlist", "btinfo",
+    "suspend", "settz", "gettz", "setuser", "getuser", "frename", "getcwd",
+    "chdir", "thread_create", "thread_join", "thread_exit", "gettid",
+    "futex_wait", "futex_wake", "setpriority", "getpriority", "setaffinity",
+    "getaffinity", "mmap", "shmopen", "shmunlink", "readdirstat",
+    "ioring_setup", "ioring_enter", "setsockopt", "epoll_create", "epoll_ctl",
+    "epoll_wait", "epoll_close", "sendfile", "winpresentrects", "fbmapbuffer",
+    "fbflip", "cursorset", "resolve_async", "sendmmsg", "recvmmsg",
+    "getsockopt", "bootprofile", "bootmark", "tracectl", "tracemap",
+    "lockstat", "syscallstatctl", "syscallstat", "profctl", "profread",
+    "perfctl", "perfread", "diskbench", "wineventring", "winchanges",
+    "pipe", "pipe_read", "pipe_write", "pipe_close", "spawn_piped",
+    "chan_listen", "chan_connect", "chan_accept", "chan_send", "chan_recv",
+    "chan_close", "batch", "spawn_ex", "getenv", "fcopy",
+    "mouseevents", "fsync", "gpualloc", "gpublit"
+};
+
+static SyscallStatInfo g_stats[Montauk::SYSSTAT_MAX_SYSCALLS];
+static Montauk::ProcInfo g_procs[MAX_PROCS];
+
+static void print_int(uint64_t n) {
+    if (n == 0) {
+        montauk::putchar('0');
+        return;
+    }
+    char buf[20];
+    int i = 0;
+    while (n > 0) {
+        buf[i++] = '0' + (n % 10);
+        n /= 10;
+    }
+    for (int j = i - 1; j >= 0; j--) {
+        montauk::putchar(buf[j]);
+    }
+}
+
+static int digits(uint64_t n) {
+    int d = 1;
+    while (n >= 10) {
+        n /= 10;
+        d++;
+    }
+    return d;
+}
+
+static void pad(int n) {
+    for (int i = 0; i < n; i++) montauk::putchar(' ');
+}
+
+static void print_col(uint64_t n, int width) {
+    pad(width - digits(n));
+    print_int(n);
+}
+
+// `n` thousandths as right-aligned units with one decimal
+static void print_milli(uint64_t n, int width) {
+    uint64_t whole = n / 1000;
+    pad(width - digits(whole) - 2);
+    print_int(whole);
+    montauk::putchar('.');
+    print_int((n / 100) % 10);
+}
+
+static void print_name(uint32_t nr) {
+    int len;
+    if (nr < sizeof(g_names) / sizeof(g_names[0])) {
+        montauk::print(g_names[nr]);
+        len = montauk::slen(g_names[nr]);
+    } else {
+        montauk::print("#");
+        print_int(nr);
+        len = 1 + digits(nr);
+    }
+    pad(NAME_WIDTH - len);
+}
+
+// Lower bound of a histogram bucket, e.g. "512ns" or "16us"
+static int print_bound(uint64_t ns) {
+    const char* unit = "ns";
+    if (ns >= 1000000000) { ns /= 1000000000; unit = "s"; }
+    else if (ns >= 1000000) { ns /= 1000000; unit = "ms"; }
+    else if (ns >= 1000) { ns /= 1000; unit = "us"; }
+    print_int(ns);
+    montauk::print(unit);
+    return digits(ns) + montauk::slen(unit);
+}
+
+static void print_histogram(const SyscallStatInfo& s) {
+    uint64_t peak = 0;
+    for (int b = 0; b < Montauk::SYSSTAT_BUCKETS; b++) {
+        if (s.buckets[b] > peak) peak = s.buckets[b];
+    }
+    if (peak == 0) return;
+
+    for (int b = 0; b < Montauk::SYSSTAT_BUCKETS; b++) {
+        if (s.buckets[b] == 0) continue;
+        pad(6);
+        int used = print_bound(1ull << b);
+        if (b == Montauk::SYSSTAT_BUCKETS - 1) {
+            montauk::print("+");
+            used++;
+        }
+        pad(10 - used);
+
+        int bar = (int)(s.buckets[b] * BAR_WIDTH / peak);
+        if (bar == 0) bar = 1;
+        montauk::print("|");
+        for (int c = 0; c < BAR_WIDTH; c++) montauk::putchar(c < bar ? '#' : ' ');
+        montauk::print("| ");
+        print_int(s.buckets[b]);
+        montauk::putchar('\n');
+    }
+}
+
+// Most total time first
+static void sort_by_time(SyscallStatInfo* stats, int count) {
+    for (int i = 1; i < count; i++) {
+        SyscallStatInfo tmp = stats[i];
+        int j = i - 1;
+        while (j >= 0 && stats[j].totalNs < tmp.totalNs) {
+            stats[j + 1] = stats[j];
+            j--;
+        }
+        stats[j + 1] = tmp;
+    }
+}
+
+static void print_table(const SyscallStatInfo* stats, int count, bool withMax, bool histograms) {
+    montauk::print("syscall               calls   total(ms)    avg(us)");
+    montauk::print(withMax ? "    max(us)\n" : "\n");
+    for (int i = 0; i < count; i++) {
+        const SyscallStatInfo& s = stats[i];
+        print_name(s.nr);
+        print_col(s.count, 9);
+        print_milli(s.totalNs / 1000, 12);
+        print_milli(s.totalNs / s.count, 11);
+        if (withMax) print_milli(s.maxNs, 11);
+        montauk::putchar('\n');
+        if (histograms) print_histogram(s);
+    }
+}
+
+static void usage() {
+    montauk::print("usage: syscallstat [-p] [-h] [-t ms] [command [args]]\n");
+    montauk::exit(1);
+}
+
+extern "C" void _start() {
+    char args[512];
+    montauk::getargs(args, sizeof(args));
+
+    bool perProcess = false;
+    bool histograms = false;
+    uint64_t ms = DEFAULT_MS;
+    char command[256] = "";
+    const char* commandArgs = nullptr;
+
+    const char* p = args;
+    char w[256];
+    while (true) {
+        const char* rest = montauk::next_word(p, w, sizeof(w));
+        if (w[0] == '\0') break;
+        if (montauk::streq(w, "-p")) {
+            perProcess = true;
+            p = rest;
+        } else if (montauk::streq(w, "-h")) {
+            histograms = true;
+            p = rest;
+        } else if (montauk::streq(w, "-t")) {
+            p = montauk::next_word(rest, w, sizeof(w));
+            ms = montauk::parse_u64(w);
+        } else if (w[0] == '-') {
+            usage();
+        } else {
+            montauk::strcpy(command, w);
+            commandArgs = montauk::skip_spaces(rest);
+            if (*commandArgs == '\0') commandArgs = nullptr;
+            break;
+        }
+    }
+
+    // Resolve the command before counting starts
+    char path[300] = "";
+    if (command[0]) {
+        bool direct = false;
+        for (int i = 0; command[i]; i++) {
+            if (command[i] == '/' || command[i] == ':') direct = true;
+        }
+        if (direct) {
+            montauk::strcpy(path, command);
+        } else {
+            montauk::strcpy(path, "0:/os/");
+            montauk::strcpy(path + 6, command);
+            montauk::strcpy(path + 6 + montauk::slen(command), ".elf");
+        }
+    }
+
+    uint32_t flags = Montauk::SYSSTAT_ON | Montauk::SYSSTAT_RESET;
+    if (perProcess || path[0]) flags |= Montauk::SYSSTAT_PROCESS;
+    if (montauk::syscallstat_ctl(flags) < 0) {
+        montauk::print("syscallstat: cannot start counting\n");
+        montauk::exit(1);
+    }
+
+    int pid = -1;
+    if (path[0]) {
+        pid = montauk::spawn(path, commandArgs);
+        if (pid < 0) {
+            montauk::syscallstat_ctl(0);
+            montauk::print("syscallstat: cannot run ");
+            montauk::print(path);
+            montauk::print("\n");
+            montauk::exit(1);
+        }
+        montauk::waitpid(pid);
+    } else {
+        montauk::sleep_ms(ms);
+    }
+
+    montauk::syscallstat_ctl(0);
+
+    int count = montauk::syscallstat(-1, g_stats, Montauk::SYSSTAT_MAX_SYSCALLS);
+    if (count <= 0) {
+        montauk::print("syscallstat: no syscalls counted\n");
+        montauk::exit(0);
+    }
+    sort_by_time(g_stats, count);
+    montauk::print("All processes\n\n");
+    print_table(g_stats, count, true, histograms);
+
+    if (pid >= 0) {
+        count = montauk::syscallstat(pid, g_stats, Montauk::SYSSTAT_MAX_SYSCALLS);
+        if (count > 0) {
+            sort_by_time(g_stats, count);
+            montauk::print("\n");
+            montauk::print(command);
+            montauk::print(" (pid ");
+            print_int(pid);
+            montauk::print(")\n\n");
+            print_table(g_stats, count, false, false);
+        }
+    }
+
+    if (perProcess) {
+        int procs = montauk::proclist(g_procs, MAX_PROCS);
+        for (int i = 0; i < procs; i++) {
+            if (g_procs[i].pid == pid) continue;
+            count = montauk::syscallstat(g_procs[i].pid, g_stats, Montauk::SYSSTAT_MAX_SYSCALLS);
+            if (count <= 0) continue;
+            sort_by_time(g_stats, count);
+            if (count > TOP_PER_PROCESS) count = TOP_PER_PROCESS;
+            montauk::print("\n");
+            montauk::print(g_procs[i].name);
+            montauk::print(" (pid ");
+            print_int(g_procs[i].pid);
+            montauk::print(")\n\n");
+            print_table(g_stats, count, false, false);
+        }
+    }
+
+    montauk::exit(0);
+}
@@ -22,7 +22,8 @@
 #define CONFIG_TCC_CRTPREFIX "0:/lib/tcc/lib"
 #define CONFIG_TCC_ELFINTERP ""
 
-/* We are not native -- no -run support */
+/* We are not native: -run links an executable into the ramdisk and
+   spawns it instead (montauk_build.c) */
 #undef TCC_IS_NATIVE
 
 /* Disable unused features */
@@ -782,7 +782,14 @@ static int _tcc_open(TCCState *s1, const char *filename)
 
 ST_FUNC int tcc_open(TCCState *s1, const char *filename)
 {
-    int fd = _tcc_open(s1, filename);
+    int fd;
+#ifdef __MONTAUKOS__
+    /* system headers come from a cache shared between compiles */
+    fd = montauk_open_cached(s1, filename);
+    if (fd <= 0)
+        return fd;
+#endif
+    fd = _tcc_open(s1, filename);
     if (fd < 0)
         return -1;
     tcc_open_bf(s1, filename, 0);
@@ -2044,11 +2051,16 @@ PUB_FUNC int tcc_parse_args(TCCState *s, int *pargc, char ***pargv)
             s->nostdlib = 1;
             break;
         case TCC_OPTION_run:
-#ifdef TCC_IS_NATIVE
+#if defined TCC_IS_NATIVE || defined __MONTAUKOS__
             /* When from script "#!/usr/bin/tcc -run <options>",
                argv[1] is "-run <options>" and argv[2] is <script-name> */
             run = optarg;
+#ifdef __MONTAUKOS__
+            s->run_exe = 1;
+            x = TCC_OUTPUT_EXE;
+#else
             x = TCC_OUTPUT_MEMORY;
+#endif
             goto set_output_type;
 #else
             return tcc_error_noabort("-run is not available in a cross compiler");
@@ -0,0 +1,393 @@
+/*
+    * montauk_build.c
+    * Parallel compilation, -run and the system header cache for TCC on MontaukOS
+    * Copyright (c) 2026 Daniel Hammer
+*/
+
+/* before tcc.h, whose section macros would rename its struct fields */
+#include <montauk.h>
+#include "tcc.h"
+
+#define TCC_PATH    "0:/os/tcc.elf"
+#define TMP_DIR     "0:/tmp"
+#define MAX_JOBS    64
+#define MAX_FLAGS   64
+
+/* ====================================================================
+   Parallel compilation
+
+   Libtcc keeps its parser and code generator state in globals, so one
+   process compiles one file at a time. With several C files and more
+   than one CPU, each file is compiled to an object by a tcc child
+   process instead, as many at once as there are CPUs, and the parent
+   links the objects. The children get the parent's options without
+   the link-only ones.
+   ==================================================================== */
+
+/* Objects the children compiled for the link, removed after it */
+static char **job_objects;
+static int nb_job_objects;
+
+/* Options whose value is the next argument when it is not attached */
+static const char *const value_options[] = {
+    "-I", "-D", "-U", "-L", "-B", "-include", "-isystem", "-iwithprefix",
+    "-MF", NULL
+};
+
+/* Options that only matter to the link */
+static const char *const link_options[] = {
+    "-c", "-shared", "-static", "-rdynamic", NULL
+};
+
+static int in_list(const char *const *list, const char *arg)
+{
+    for (; *list; list++)
+        if (strcmp(*list, arg) == 0)
+            return 1;
+    return 0;
+}
+
+static int is_c_file(const struct filespec *f)
+{
+    return f->type == AFF_TYPE_NONE
+        && strcmp(tcc_fileextension(f->name), ".c") == 0;
+}
+
+/* The options of the command line `argv` a child compile gets; -1 if
+   they cannot be passed on as they are */
+static int job_flags(int argc, char **argv, const char **flags)
+{
+    int i, n = 0;
+
+    for (i = 1; i < argc; i++) {
+        const char *a = argv[i];
+        if (a[0] == '@' || strncmp(a, "-x", 2) == 0)
+            return -1;  /* listfiles and file types apply to the whole line */
+        if (a[0] != '-' || a[1] == '\0')
+            continue;   /* inputs: one C file per child, the rest for the link */
+        if (strcmp(a, "-o") == 0 || strcmp(a, "-l") == 0
+         || strcmp(a, "-soname") == 0) {
+            i++;
+            continue;
+        }
+        if (a[1] == 'o' || a[1] == 'l' || strncmp(a, "-Wl,", 4) == 0
+         || in_list(link_options, a))
+            continue;
+        if (n + 2 >= MAX_FLAGS)
+            return -1;
+        flags[n++] = a;
+        if (in_list(value_options, a) && i + 1 < argc)
+            flags[n++] = argv[++i];
+    }
+    return n;
+}
+
+static int cpu_count(void)
+{
+    mtk_sysinfo info;
+    memset(&info, 0, sizeof info);
+    mtk_get_info(&info);
+    if (info.cpu_count < 1)
+        return 1;
+    return info.cpu_count < MAX_JOBS ? (int)info.cpu_count : MAX_JOBS;
+}
+
+/* Start a child compiling `src` to `obj`; its pid, or -1 */
+static int start_job(const char **flags, int nb_flags, const char *src, const char *obj)
+{
+    const char *args[MAX_FLAGS + 6];
+    mtk_spawn_attr attr;
+    int n = nb_flags;
+
+    memcpy(args, flags, nb_flags * sizeof *flags);
+    args[n++] = "-c";
+    args[n++] = src;
+    args[n++] = "-o";
+    args[n++] = obj;
+    args[n] = NULL;
+
+    memset(&attr, 0, sizeof attr);
+    attr.path = TCC_PATH;
+    attr.argv = args;
+    attr.priority = MTK_PRIO_INHERIT;
+    return mtk_spawn_ex(&attr);
+}
+
+static int file_exists(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f)
+        return 0;
+    fclose(f);
+    return 1;
+}
+
+ST_FUNC int montauk_compile_jobs(TCCState *s, int argc, char **argv,
+                                 char *(*outputfile)(TCCState *, const char *))
+{
+    const char *flags[MAX_FLAGS];
+    int pids[MAX_JOBS], slots[MAX_JOBS];
+    char *outputs[MAX_JOBS];
+    int nb_flags, jobs, running = 0, next = 0, i, j, ret = 0;
+    int link = s->output_type != TCC_OUTPUT_OBJ;
+
+    if (s->output_type != 0 && s->output_type != TCC_OUTPUT_EXE
+     && s->output_type != TCC_OUTPUT_DLL && s->output_type != TCC_OUTPUT_OBJ)
+        return 0;
+    if (s->option_r || s->just_deps || s->gen_deps || s->run_exe)
+        return 0;
+    for (i = j = 0; i < s->nb_files; i++)
+        j += is_c_file(s->files[i]);
+    if (j < 2 || (jobs = cpu_count()) < 2)
+        return 0;
+    if ((nb_flags = job_flags(argc, argv, flags)) < 0)
+        return 0;
+    if (link)
+        mtk_mkdir(TMP_DIR);
+
+    /* Start the jobs in file order and wait for them oldest first; after
+       a failure no more are started. A file no child could be started
+       for stays in the list, to be compiled here. */
+    for (;;) {
+        while (ret == 0 && running < jobs && next < s->nb_files) {
+            struct filespec *f = s->files[next];
+            char obj[64];
+            char *out;
+            int pid;
+
+            i = next++;
+            if (!is_c_file(f))
+                continue;
+            if (link) {
+                snprintf(obj, sizeof obj, TMP_DIR "/tcc-%d-%d.o", mtk_getpid(), i);
+                out = tcc_strdup(obj);
+            } else {
+                out = outputfile(s, f->name);
+            }
+            remove(out);
+            pid = start_job(flags, nb_flags, f->name, out);
+            if (pid < 0) {
+                tcc_free(out);
+                continue;
+            }
+            pids[running] = pid;
+            slots[running] = i;
+            outputs[running] = out;
+            running++;
+        }
+        if (running == 0)
+            break;
+
+        mtk_waitpid(pids[0]);
+        i = slots[0];
+        if (!file_exists(outputs[0])) {
+            /* the child has reported why */
+            ret = -1;
+            tcc_free(outputs[0]);
+        } else if (link) {
+            struct filespec *f = tcc_malloc(sizeof *f + strlen(outputs[0]));
+            f->type = AFF_TYPE_NONE;
+            strcpy(f->name, outputs[0]);
+            tcc_free(s->files[i]);
+            s->files[i] = f;
+            dynarray_add(&job_objects, &nb_job_objects, outputs[0]);
+        } else {
+            tcc_free(s->files[i]);
+            s->files[i] = NULL;
+            tcc_free(outputs[0]);
+        }
+        running--;
+        memmove(pids, pids + 1, running * sizeof *pids);
+        memmove(slots, slots + 1, running * sizeof *slots);
+        memmove(outputs, outputs + 1, running * sizeof *outputs);
+    }
+
+    /* With -c, the files compiled are done with */
+    for (i = j = 0; i < s->nb_files; i++)
+        if (s->files[i])
+            s->files[j++] = s->files[i];
+    s->nb_files = j;
+    return ret;
+}
+
+ST_FUNC void montauk_remove_job_objects(void)
+{
+    int i;
+    for (i = 0; i < nb_job_objects; i++)
+        remove(job_objects[i]);
+    dynarray_reset(&job_objects, &nb_job_objects);
+}
+
+/* ====================================================================
+   -run
+
+   Code can only run on MontaukOS as a process the kernel loads from a
+   file, so -run links the executable into the ramdisk, which lives in
+   memory, runs it with the arguments after the source file and waits
+   for it.
+   ==================================================================== */
+
+ST_FUNC int montauk_run_exe(TCCState *s1, int argc, char **argv)
+{
+    char path[64];
+    mtk_spawn_attr attr;
+    int pid, ret;
+
+    mtk_mkdir(TMP_DIR);
+    snprintf(path, sizeof path, TMP_DIR "/tcc-%d-run.elf", mtk_getpid());
+    ret = tcc_output_file(s1, path);
+    if (ret)
+        return ret;
+
+    memset(&attr, 0, sizeof attr);
+    attr.path = path;
+    attr.argv = argc > 1 ? (const char *const *)argv + 1 : NULL;
+    attr.priority = MTK_PRIO_INHERIT;
+    pid = mtk_spawn_ex(&attr);
+    if (pid < 0)
+        ret = tcc_error_noabort("could not run '%s'", argv[0]);
+    else
+        mtk_waitpid(pid);
+    remove(path);
+    return ret;
+}
+
+/* ====================================================================
+   System header cache
+
+   Headers under CONFIG_TCCDIR come with the ramdisk image and do not
+   change while the system runs. The first compile to read one keeps
+   its text in a shared memory object; later compiles, and the other
+   jobs of a parallel build, take it from there instead of opening and
+   reading the header again. Entries are appended without a lock: the
+   space and the slot are claimed atomically, and an entry is used only
+   once it is marked ready.
+   ==================================================================== */
+
+#define HCACHE_NAME     "tcc-header-cache"
+#define HCACHE_SIZE     (4 * 1024 * 1024)
+#define HCACHE_ENTRIES  512
+
+typedef struct HeaderEntry {
+    uint32_t ready;
+    uint32_t hash;      /* of the path */
+    uint32_t name;      /* offset of the path in data[] */
+    uint32_t text;      /* offset of the contents in data[] */
+    uint32_t size;
+    uint32_t reserved;
+} HeaderEntry;
+
+typedef struct HeaderCache {
+    uint32_t count;     /* slots claimed */
+    uint32_t used;      /* bytes of data[] claimed */
+    HeaderEntry entries[HCACHE_ENTRIES];
+    char data[];
+} HeaderCache;
+
+#define HCACHE_DATA     (HCACHE_SIZE - sizeof(HeaderCache))
+
+static HeaderCache *header_cache(void)
+{
+    static HeaderCache *cache;
+    static int tried;
+    if (!tried) {
+        tried = 1;
+        cache = (HeaderCache *)mtk_shm_open(HCACHE_NAME, HCACHE_SIZE);
+    }
+    return cache;
+}
+
+static uint32_t path_hash(const char *p)
+{
+    uint32_t h = 2166136261u;
+    while (*p)
+        h = (h ^ (unsigned char)*p++) * 16777619u;
+    return h;
+}
+
+static void header_publish(HeaderCache *c, uint32_t hash, const char *filename,
+                           const char *text, uint32_t size)
+{
+    uint32_t len = strlen(filename) + 1;
+    uint32_t need = (len + size + 7) & ~7u;
+    uint32_t off, slot;
+    HeaderEntry *e;
+
+    off = __atomic_load_n(&c->used, __ATOMIC_RELAXED);
+    do {
+        if (off + need > HCACHE_DATA)
+            return;
+    } while (!__atomic_compare_exchange_n(&c->used, &off, off + need, 1,
+                                          __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+    memcpy(c->data + off, filename, len);
+    memcpy(c->data + off + len, text, size);
+
+    slot = __atomic_load_n(&c->count, __ATOMIC_RELAXED);
+    do {
+        if (slot >= HCACHE_ENTRIES)
+            return;
+    } while (!__atomic_compare_exchange_n(&c->count, &slot, slot + 1, 1,
+                                          __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+    e = &c->entries[slot];
+    e->hash = hash;
+    e->name = off;
+    e->text = off + len;
+    e->size = size;
+    __atomic_store_n(&e->ready, 1, __ATOMIC_RELEASE);
+}
+
+ST_FUNC int montauk_open_cached(TCCState *s1, const char *filename)
+{
+    HeaderCache *c;
+    uint32_t hash, n, i;
+    long size, got;
+    int fd;
+
+    if (strncmp(filename, CONFIG_TCCDIR "/", sizeof(CONFIG_TCCDIR)) != 0)
+        return 1;
+    c = header_cache();
+    if (!c)
+        return 1;
+
+    hash = path_hash(filename);
+    n = __atomic_load_n(&c->count, __ATOMIC_ACQUIRE);
+    if (n > HCACHE_ENTRIES)
+        n = HCACHE_ENTRIES;
+    for (i = 0; i < n; i++) {
+        HeaderEntry *e = &c->entries[i];
+        if (__atomic_load_n(&e->ready, __ATOMIC_ACQUIRE) && e->hash == hash
+         && strcmp(c->data + e->name, filename) == 0) {
+            tcc_open_bf(s1, filename, e->size);
+            memcpy(file->buffer, c->data + e->text, e->size);
+            return 0;
+        }
+    }
+
+    fd = open(filename, O_RDONLY | O_BINARY);
+    if (fd < 0)
+        return -1;
+    size = lseek(fd, 0, SEEK_END);
+    lseek(fd, 0, SEEK_SET);
+    if (size <= 0 || (unsigned long)size > HCACHE_DATA) {
+        /* read as usual */
+        tcc_open_bf(s1, filename, 0);
+        file->fd = fd;
+        return 0;
+    }
+
+    tcc_open_bf(s1, filename, size);
+    for (got = 0; got < size; ) {
+        int r = read(fd, file->buffer + got, size - got);
+        if (r <= 0)
+            break;
+        got += r;
+    }
+    close(fd);
+    if (got < size) {
+        file->buf_end = file->buffer + got;
+        *file->buf_end = CH_EOB;
+        return 0;
+    }
+    header_publish(c, hash, filename, (const char *)file->buffer, size);
+    return 0;
+}
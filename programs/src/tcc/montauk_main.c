@@ -53,13 +53,13 @@ FILE *fdopen(int fd, const char *mode) {
     FILE *f = (FILE *)malloc(sizeof(FILE));
     if (f == NULL) return NULL;
 
+    /* Buffered like an fopen() stream; tccelf.c writes the output file
+       through it in small pieces and always fcloses it */
+    memset(f, 0, sizeof(FILE));
     f->handle = fd;
-    f->pos = 0;
     f->size = fileSize;
-    f->eof = 0;
-    f->error = 0;
-    f->is_std = 0;
     f->ungetc_buf = -1;
+    f->buf_mode = _IOFBF;
     return f;
 }
 
@@ -367,6 +367,15 @@ redo:
         }
         if (s->nb_errors)
             goto err;
+#ifdef __MONTAUKOS__
+        /* several C files are compiled at once in child processes */
+        if (montauk_compile_jobs(s, argc0, argv0, default_outputfile) < 0)
+            goto err;
+        if (s->nb_files == 0) {
+            tcc_delete(s);
+            return 0;
+        }
+#endif
         if (s->do_bench)
             start_time = getclock_ms();
     }
@@ -416,6 +425,10 @@ redo:
         if (s->output_type == TCC_OUTPUT_MEMORY) {
 #ifdef TCC_IS_NATIVE
             ret = tcc_run(s, argc, argv);
+#endif
+#ifdef __MONTAUKOS__
+        } else if (s->run_exe) {
+            ret = montauk_run_exe(s, argc, argv);
 #endif
         } else {
             if (!s->outfile)
@@ -439,6 +452,9 @@ redo:
     else if (s->do_bench)
         tcc_print_stats(s, end_time - start_time);
 
+#ifdef __MONTAUKOS__
+    montauk_remove_job_objects();
+#endif
     tcc_delete(s);
     if (!done)
         goto redo;
@@ -807,6 +807,9 @@ struct TCCState {
     unsigned char do_bench; /* option -bench */
     unsigned char just_deps; /* option -M  */
     unsigned char gen_deps; /* option -MD  */
+#ifdef __MONTAUKOS__
+    unsigned char run_exe; /* option -run: link to a file and spawn it */
+#endif
     unsigned char include_sys_deps; /* option -MD  */
     unsigned char gen_phony_deps; /* option -MP */
 
@@ -1877,6 +1880,15 @@ ST_FUNC void tcc_tcov_block_end(TCCState *s1, int line);
 ST_FUNC void tcc_tcov_block_begin(TCCState *s1);
 ST_FUNC void tcc_tcov_reset_ind(TCCState *s1);
 
+/* ------------ montauk_build.c ----------------- */
+#ifdef __MONTAUKOS__
+ST_FUNC int montauk_compile_jobs(TCCState *s, int argc, char **argv,
+                                 char *(*outputfile)(TCCState *, const char *));
+ST_FUNC void montauk_remove_job_objects(void);
+ST_FUNC int montauk_run_exe(TCCState *s1, int argc, char **argv);
+ST_FUNC int montauk_open_cached(TCCState *s1, const char *filename);
+#endif
+
 #define stab_section            s1->stab_section
 #define stabstr_section         stab_section->link
 #define tcov_section            s1->tcov_section
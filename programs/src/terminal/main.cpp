@@ -44,6 +44,10 @@ static TermTabs g_tabs = {};
 static bool g_should_exit = false;
 static bool g_force_redraw = true;
 
+// What the last term_render changed, in window pixels; -1: everything
+static Montauk::WinRect g_present[2];
+static int g_present_count = -1;
+
 static bool left_pressed(const Montauk::WinEvent& ev) {
     return (ev.mouse.buttons & 1) && !(ev.mouse.prev_buttons & 1);
 }
@@ -125,45 +129,13 @@ static bool term_poll_tabs() {
         }
     }
 
-    if (g_tabs.tab_count > 0 && g_tabs.tabs[g_tabs.active_tab]->dirty)
+    if (g_tabs.tab_count > 0 && terminal_needs_render(g_tabs.tabs[g_tabs.active_tab]))
         changed = true;
 
     return changed || g_force_redraw;
 }
 
-static bool term_render() {
-    if (!g_win.pixels || g_tabs.tab_count <= 0) return false;
-    if (g_tabs.active_tab < 0 || g_tabs.active_tab >= g_tabs.tab_count)
-        g_tabs.active_tab = 0;
-
-    int term_h = g_win.height - TERM_TAB_BAR_H;
-    if (term_h < 1) term_h = 1;
-
-    int new_cols = g_win.width / mono_cell_width();
-    int new_rows = term_h / mono_cell_height();
-    if (new_cols < 1) new_cols = 1;
-    if (new_rows < 1) new_rows = 1;
-
-    TerminalState* ts = g_tabs.tabs[g_tabs.active_tab];
-
-    if (new_cols != ts->cols || new_rows != ts->rows) {
-        for (int i = 0; i < g_tabs.tab_count; i++)
-            terminal_resize(g_tabs.tabs[i], new_cols, new_rows);
-    }
-
-    if (g_tabs.active_tab != g_tabs.prev_active_tab) {
-        g_tabs.tabs[g_tabs.active_tab]->dirty = true;
-        g_tabs.prev_active_tab = g_tabs.active_tab;
-    }
-
-    if (g_win.pixels != g_tabs.last_pixels) {
-        g_tabs.tabs[g_tabs.active_tab]->dirty = true;
-        g_tabs.last_pixels = g_win.pixels;
-    }
-
-    ts = g_tabs.tabs[g_tabs.active_tab];
-    if (!g_force_redraw && !ts->dirty) return false;
-
+static void term_draw_tab_bar() {
     Canvas c = g_win.canvas();
     Color bar_bg = Color::from_hex(0x1C1C1C);
     c.fill_rect(0, 0, g_win.width, TERM_TAB_BAR_H, bar_bg);
@@ -207,9 +179,51 @@ static bool term_render() {
         c.text(px + (TERM_PLUS_W - pw_text) / 2, py + (plus_h - fh) / 2, "+",
                Color::from_hex(0x6E6E6E));
     }
+}
+
+static bool term_render() {
+    if (!g_win.pixels || g_tabs.tab_count <= 0) return false;
+    if (g_tabs.active_tab < 0 || g_tabs.active_tab >= g_tabs.tab_count)
+        g_tabs.active_tab = 0;
+
+    int term_h = g_win.height - TERM_TAB_BAR_H;
+    if (term_h < 1) term_h = 1;
+
+    int new_cols = g_win.width / mono_cell_width();
+    int new_rows = term_h / mono_cell_height();
+    if (new_cols < 1) new_cols = 1;
+    if (new_rows < 1) new_rows = 1;
+
+    TerminalState* ts = g_tabs.tabs[g_tabs.active_tab];
+
+    if (new_cols != ts->cols || new_rows != ts->rows) {
+        for (int i = 0; i < g_tabs.tab_count; i++)
+            terminal_resize(g_tabs.tabs[i], new_cols, new_rows);
+    }
+
+    if (g_tabs.active_tab != g_tabs.prev_active_tab) {
+        g_tabs.tabs[g_tabs.active_tab]->dirty = true;
+        g_tabs.prev_active_tab = g_tabs.active_tab;
+    }
+
+    if (g_win.pixels != g_tabs.last_pixels) {
+        g_tabs.tabs[g_tabs.active_tab]->dirty = true;
+        g_tabs.last_pixels = g_win.pixels;
+    }
+
+    ts = g_tabs.tabs[g_tabs.active_tab];
+    if (!g_force_redraw && !terminal_needs_render(ts)) return false;
+
+    // The tab bar only changes along with a full repaint
+    bool full = g_force_redraw || ts->dirty;
+    g_present_count = full ? -1 : 0;
+    if (full) term_draw_tab_bar();
 
     uint32_t* term_pixels = g_win.pixels + TERM_TAB_BAR_H * g_win.width;
-    terminal_render(ts, term_pixels, g_win.width, term_h);
+    Rect damage = terminal_render(ts, term_pixels, g_win.width, term_h);
+    if (!full && !damage.empty()) {
+        g_present[g_present_count++] = {damage.x, TERM_TAB_BAR_H + damage.y, damage.w, damage.h};
+    }
 
     if (ts->scrollback_lines > 0 && !ts->alt_screen_active) {
         int cell_h = mono_cell_height();
@@ -228,11 +242,21 @@ static bool term_render() {
                 ? (scroll_from_top * (view_h - thumb_h)) / max_scroll : 0;
             sc.fill_rect(sb_x, 0, sb_w, view_h, Color::from_rgb(0x33, 0x33, 0x33));
             sc.fill_rect(sb_x, thumb_y, sb_w, thumb_h, Color::from_rgb(0x88, 0x88, 0x88));
+            if (!full) g_present[g_present_count++] = {sb_x, TERM_TAB_BAR_H, sb_w, view_h};
         }
     }
 
     g_force_redraw = false;
-    return true;
+    return g_present_count != 0;
+}
+
+// Present what the last term_render changed
+static void term_present() {
+    if (g_present_count < 0) {
+        g_win.present();
+    } else {
+        g_win.present(g_present, g_present_count);
+    }
 }
 
 static void term_handle_mouse(const Montauk::WinEvent& ev) {
@@ -332,7 +356,7 @@ extern "C" void _start() {
     g_tabs.last_pixels = g_win.pixels;
 
     if (term_render())
-        g_win.present();
+        term_present();
 
     while (!g_should_exit) {
         bool redraw = term_poll_tabs();
@@ -369,7 +393,7 @@ extern "C" void _start() {
         if (r < 0 || quit) break;
 
         if (redraw && term_render())
-            g_win.present();
+            term_present();
 
         if (r == 0)
             montauk::sleep_ms(16);
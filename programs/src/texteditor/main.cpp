@@ -2,7 +2,7 @@
  * main.cpp
  * MontaukOS Text Editor - standalone Window Server app
  * Single-buffer text editor with line numbers, cursor, scrolling, file I/O,
- * syntax highlighting for C and Lua files
+ * incremental find, syntax highlighting for C and Lua files
  * Copyright (c) 2026 Daniel Hammer
  */
 
@@ -35,8 +35,6 @@ static constexpr int STATUS_H       = 24;
 static constexpr int LINE_NUM_W     = 48;
 static constexpr int SCROLLBAR_W    = 12;
 static constexpr int INIT_CAP       = 4096;
-static constexpr int MAX_CAP        = 262144;  // 256KB
-static constexpr int MAX_LINES      = 16384;
 static constexpr int TAB_WIDTH      = 4;
 static constexpr int FONT_SIZE      = 16;
 static constexpr int SYN_LINE_BUF_CAP = 1024;
@@ -55,6 +53,7 @@ static constexpr Color ACCENT           = Color::from_rgb(0x36, 0x7B, 0xF0);
 static constexpr Color STATUS_BG        = Color::from_rgb(0x2B, 0x3E, 0x50);
 static constexpr Color STATUS_TEXT      = Color::from_rgb(0xE0, 0xE0, 0xE0);
 static constexpr Color PATHBAR_BG       = Color::from_rgb(0xF0, 0xF0, 0xF0);
+static constexpr Color NOT_FOUND        = Color::from_rgb(0xD0, 0x40, 0x40);
 static constexpr Color WHITE            = Color::from_rgb(0xFF, 0xFF, 0xFF);
 
 // ============================================================================
@@ -70,14 +69,24 @@ TrueTypeFont* g_font_mono = nullptr; // Editor font (JetBrains Mono)
 SvgIcon g_icon_folder = {};
 SvgIcon g_icon_save = {};
 
-// Buffer
+// Buffer (gap buffer, see below)
 char* g_buffer = nullptr;
 int g_buf_len = 0;
 int g_buf_cap = 0;
+int g_gap_start = 0;
+int g_gap_end = 0;
+
+// Line index (gapped, see below). Each line also keeps the highlighter
+// state at its start.
+struct LineInfo {
+    int start;
+    SynState syn;
+};
 
-// Line index
-int* g_line_offsets = nullptr;
+LineInfo* g_lines = nullptr;
 int g_line_count = 0;
+int g_line_cap = 0;
+int g_line_gap = 0;
 
 // Cursor
 int g_cursor_pos = 0;    // byte position
@@ -98,15 +107,23 @@ int  g_sel_end = 0;
 bool g_has_selection = false;
 bool g_mouse_selecting = false;
 
-// Pathbar
+// Pathbar, which also serves as the find bar
 bool g_pathbar_open = false;
 bool g_pathbar_save = false;
+bool g_pathbar_find = false;
+montauk::IncrementalSearch g_find;
 char g_pathbar_text[256] = {};
 int  g_pathbar_len = 0;
 int  g_pathbar_cursor = 0;
 
-// Syntax highlighting
+// Syntax highlighting. Start states of lines before g_syn_first are
+// correct (SYN_CLEAN: all of them); from there on they may be stale,
+// and lines up to g_syn_last were edited and must be re-lexed before a
+// stored state can be trusted again.
+static constexpr int SYN_CLEAN = 0x7FFFFFFF;
 SynLanguage g_syntax_language = SYN_LANG_NONE;
+int g_syn_first = SYN_CLEAN;
+int g_syn_last = 0;
 
 // ============================================================================
 // Pixel drawing helpers
@@ -221,84 +238,251 @@ static int font_cell_h() {
     return 16;
 }
 
+// ============================================================================
+// Buffer
+// ============================================================================
+
+// The text is a gap buffer: g_buffer holds g_buf_len bytes with a hole at
+// [g_gap_start, g_gap_end) that sits where the last edit was, so typing
+// only writes into the hole and moving it costs the distance moved.
+//
+// The line index is gapped the same way, at the line of the last edit.
+// Starts before its gap are absolute; those after it are stored as the
+// distance from the end of the text, which an edit before them does not
+// change. An edit touches only the lines it adds or removes.
+
+static char buf_at(int pos) {
+    return g_buffer[pos < g_gap_start ? pos : pos + (g_gap_end - g_gap_start)];
+}
+
+static void move_gap(int pos) {
+    int gap = g_gap_end - g_gap_start;
+    if (pos < g_gap_start) {
+        int n = g_gap_start - pos;
+        montauk::memmove(g_buffer + g_gap_end - n, g_buffer + pos, n);
+    } else if (pos > g_gap_start) {
+        int n = pos - g_gap_start;
+        montauk::memmove(g_buffer + g_gap_start, g_buffer + g_gap_end, n);
+    }
+    g_gap_start = pos;
+    g_gap_end = pos + gap;
+}
+
+static bool ensure_capacity(int needed) {
+    if (g_gap_end - g_gap_start >= needed) return true;
+    int new_cap = g_buf_cap * 2;
+    if (new_cap < g_buf_len + needed + INIT_CAP) new_cap = g_buf_len + needed + INIT_CAP;
+
+    char* grown = (char*)montauk::malloc(new_cap);
+    if (!grown) return false;
+    int tail = g_buf_cap - g_gap_end;
+    montauk::memcpy(grown, g_buffer, g_gap_start);
+    montauk::memcpy(grown + new_cap - tail, g_buffer + g_gap_end, tail);
+    montauk::mfree(g_buffer);
+    g_buffer = grown;
+    g_gap_end = new_cap - tail;
+    g_buf_cap = new_cap;
+    return true;
+}
+
+// Bytes [start, start + len) as one run, moving the gap out of the way if
+// it splits them
+static const char* buf_span(int start, int len) {
+    if (start < g_gap_start && start + len > g_gap_start)
+        move_gap(start + len);
+    return start < g_gap_start ? g_buffer + start : g_buffer + start + (g_gap_end - g_gap_start);
+}
+
 // ============================================================================
 // Line index management
 // ============================================================================
 
-static void recompute_lines() {
-    if (!g_line_offsets)
-        g_line_offsets = (int*)montauk::malloc(MAX_LINES * sizeof(int));
+static LineInfo& line_info(int line) {
+    return g_lines[line < g_line_gap ? line : line + (g_line_cap - g_line_count)];
+}
+
+static int line_start(int line) {
+    if (line < g_line_gap) return g_lines[line].start;
+    return g_buf_len - g_lines[line + (g_line_cap - g_line_count)].start;
+}
+
+static void move_line_gap(int line) {
+    int after = g_line_cap - g_line_count;
+    while (g_line_gap > line) {
+        g_line_gap--;
+        g_lines[g_line_gap + after] = g_lines[g_line_gap];
+        g_lines[g_line_gap + after].start = g_buf_len - g_lines[g_line_gap].start;
+    }
+    while (g_line_gap < line) {
+        g_lines[g_line_gap] = g_lines[g_line_gap + after];
+        g_lines[g_line_gap].start = g_buf_len - g_lines[g_line_gap + after].start;
+        g_line_gap++;
+    }
+}
+
+static void push_line(int start) {
+    g_lines[g_line_gap].start = start;
+    g_lines[g_line_gap].syn = syn_make_state();
+    g_line_gap++;
+    g_line_count++;
+}
+
+static bool ensure_line_capacity(int needed) {
+    if (g_line_count + needed <= g_line_cap) return true;
+    int new_cap = g_line_cap > 0 ? g_line_cap * 2 : 1024;
+    while (new_cap < g_line_count + needed) new_cap *= 2;
+
+    LineInfo* grown = (LineInfo*)montauk::malloc((uint64_t)new_cap * sizeof(LineInfo));
+    if (!grown) return false;
+    int tail = g_line_count - g_line_gap;
+    if (g_lines) {
+        montauk::memcpy(grown, g_lines, (uint64_t)g_line_gap * sizeof(LineInfo));
+        montauk::memcpy(grown + new_cap - tail, g_lines + g_line_cap - tail, (uint64_t)tail * sizeof(LineInfo));
+        montauk::mfree(g_lines);
+    }
+    g_lines = grown;
+    g_line_cap = new_cap;
+    return true;
+}
+
+// Line holding byte pos
+static int line_of(int pos) {
+    int lo = 0, hi = g_line_count - 1;
+    while (lo < hi) {
+        int mid = (lo + hi + 1) / 2;
+        if (line_start(mid) <= pos) lo = mid;
+        else hi = mid - 1;
+    }
+    return lo;
+}
 
+// Forget every line's highlighter state, after a load or a language change
+static void syn_reset() {
+    g_syn_first = 1;
+    g_syn_last = g_line_count - 1;
+}
+
+// Index every line of the buffer from scratch, after a load
+static void recompute_lines() {
     g_line_count = 0;
-    g_line_offsets[g_line_count++] = 0;
+    g_line_gap = 0;
+    if (!ensure_line_capacity(1)) return;
+    push_line(0);
     for (int i = 0; i < g_buf_len; i++) {
-        if (g_buffer[i] == '\n' && g_line_count < MAX_LINES)
-            g_line_offsets[g_line_count++] = i + 1;
+        if (buf_at(i) == '\n') {
+            if (!ensure_line_capacity(1)) return;
+            push_line(i + 1);
+        }
     }
+    syn_reset();
 }
 
 static void update_cursor_pos() {
-    g_cursor_line = 0;
-    for (int i = g_line_count - 1; i >= 0; i--) {
-        if (g_cursor_pos >= g_line_offsets[i]) {
-            g_cursor_line = i;
-            break;
-        }
-    }
-    g_cursor_col = g_cursor_pos - g_line_offsets[g_cursor_line];
+    g_cursor_line = line_of(g_cursor_pos);
+    g_cursor_col = g_cursor_pos - line_start(g_cursor_line);
     g_cursor_moved = true;
 }
 
 static int line_length(int line) {
     if (line < 0 || line >= g_line_count) return 0;
-    int start = g_line_offsets[line];
-    int end = (line + 1 < g_line_count) ? g_line_offsets[line + 1] - 1 : g_buf_len;
+    int start = line_start(line);
+    int end = (line + 1 < g_line_count) ? line_start(line + 1) - 1 : g_buf_len;
     return end - start;
 }
 
+// Record that the lines after `line` up to line + removed were replaced
+// by `added` new ones
+static void syn_lines_changed(int line, int removed, int added) {
+    if (g_syn_first == SYN_CLEAN) {
+        g_syn_first = line + 1;
+        g_syn_last = line + added;
+        return;
+    }
+    if (g_syn_last > line + removed) g_syn_last += added - removed;
+    else if (g_syn_last > line) g_syn_last = line;
+    if (g_syn_last < line + added) g_syn_last = line + added;
+    if (g_syn_first > line + 1) g_syn_first = line + 1;
+}
+
+// Bring the start states of lines up to `upto` up to date. Re-lexing
+// stops early once it is past the edited lines and arrives at a line
+// with the state it already had, since nothing after that can change.
+static void syn_update(int upto) {
+    if (upto >= g_line_count) upto = g_line_count - 1;
+
+    while (g_syn_first <= upto) {
+        int prev = g_syn_first - 1;
+        SynState state = line_info(prev).syn;
+        int len = line_length(prev);
+        syn_highlight_line(buf_span(line_start(prev), len), len, nullptr, 0, g_syntax_language, state);
+
+        LineInfo& info = line_info(g_syn_first);
+        if (g_syn_first > g_syn_last && syn_state_equal(info.syn, state)) {
+            g_syn_first = SYN_CLEAN;
+            return;
+        }
+        info.syn = state;
+        g_syn_first++;
+    }
+    if (g_syn_first >= g_line_count) g_syn_first = SYN_CLEAN;
+}
+
 // ============================================================================
 // Buffer operations
 // ============================================================================
 
-static void ensure_capacity(int needed) {
-    if (g_buf_len + needed <= g_buf_cap) return;
-    int new_cap = g_buf_cap * 2;
-    if (new_cap > MAX_CAP) new_cap = MAX_CAP;
-    if (new_cap < g_buf_len + needed) new_cap = g_buf_len + needed;
-    g_buffer = (char*)montauk::realloc(g_buffer, new_cap);
-    g_buf_cap = new_cap;
+static bool insert_text(int pos, const char* s, int len) {
+    int newlines = 0;
+    for (int i = 0; i < len; i++) {
+        if (s[i] == '\n') newlines++;
+    }
+    if (!ensure_capacity(len) || !ensure_line_capacity(newlines)) return false;
+
+    // Lines starting at or before pos stay put; the ones after keep their
+    // distance from the end
+    int line = line_of(pos);
+    move_line_gap(line + 1);
+    for (int i = 0; i < len; i++) {
+        if (s[i] == '\n') push_line(pos + i + 1);
+    }
+    syn_lines_changed(line, 0, newlines);
+
+    move_gap(pos);
+    montauk::memcpy(g_buffer + g_gap_start, s, len);
+    g_gap_start += len;
+    g_buf_len += len;
+    return true;
 }
 
 static void delete_range(int start, int count) {
-    for (int i = start; i < g_buf_len - count; i++)
-        g_buffer[i] = g_buffer[i + count];
+    int line = line_of(start);
+    move_line_gap(line + 1);
+    int after = g_line_cap - g_line_count;
+    int removed = 0;
+    while (g_line_gap < g_line_count &&
+           g_buf_len - g_lines[g_line_gap + after].start <= start + count) {
+        g_line_count--;
+        after++;
+        removed++;
+    }
+    syn_lines_changed(line, removed, 0);
+
+    move_gap(start);
+    g_gap_end += count;
     g_buf_len -= count;
 }
 
 static void insert_char(char c) {
-    if (g_buf_len >= MAX_CAP - 1) return;
-    ensure_capacity(1);
-    for (int i = g_buf_len; i > g_cursor_pos; i--)
-        g_buffer[i] = g_buffer[i - 1];
-    g_buffer[g_cursor_pos] = c;
-    g_buf_len++;
+    if (!insert_text(g_cursor_pos, &c, 1)) return;
     g_cursor_pos++;
     g_modified = true;
-    recompute_lines();
     update_cursor_pos();
 }
 
 static void insert_string(const char* s, int len) {
-    if (g_buf_len + len >= MAX_CAP) return;
-    ensure_capacity(len);
-    for (int i = g_buf_len - 1; i >= g_cursor_pos; i--)
-        g_buffer[i + len] = g_buffer[i];
-    for (int i = 0; i < len; i++)
-        g_buffer[g_cursor_pos + i] = s[i];
-    g_buf_len += len;
+    if (!insert_text(g_cursor_pos, s, len)) return;
     g_cursor_pos += len;
     g_modified = true;
-    recompute_lines();
     update_cursor_pos();
 }
 
@@ -307,7 +491,6 @@ static void backspace() {
     g_cursor_pos--;
     delete_range(g_cursor_pos, 1);
     g_modified = true;
-    recompute_lines();
     update_cursor_pos();
 }
 
@@ -315,7 +498,6 @@ static void delete_char() {
     if (g_cursor_pos >= g_buf_len) return;
     delete_range(g_cursor_pos, 1);
     g_modified = true;
-    recompute_lines();
     update_cursor_pos();
 }
 
@@ -329,7 +511,7 @@ static void move_up() {
     int prev = g_cursor_line - 1;
     int len = line_length(prev);
     if (col > len) col = len;
-    g_cursor_pos = g_line_offsets[prev] + col;
+    g_cursor_pos = line_start(prev) + col;
     update_cursor_pos();
 }
 
@@ -339,7 +521,7 @@ static void move_down() {
     int next = g_cursor_line + 1;
     int len = line_length(next);
     if (col > len) col = len;
-    g_cursor_pos = g_line_offsets[next] + col;
+    g_cursor_pos = line_start(next) + col;
     update_cursor_pos();
 }
 
@@ -352,12 +534,12 @@ static void move_right() {
 }
 
 static void move_home() {
-    g_cursor_pos = g_line_offsets[g_cursor_line];
+    g_cursor_pos = line_start(g_cursor_line);
     update_cursor_pos();
 }
 
 static void move_end() {
-    g_cursor_pos = g_line_offsets[g_cursor_line] + line_length(g_cursor_line);
+    g_cursor_pos = line_start(g_cursor_line) + line_length(g_cursor_line);
     update_cursor_pos();
 }
 
@@ -400,7 +582,6 @@ static void delete_selection() {
     g_cursor_pos = ss;
     g_modified = true;
     clear_selection();
-    recompute_lines();
     update_cursor_pos();
 }
 
@@ -439,19 +620,27 @@ static void load_file(const char* path) {
     if (fd < 0) return;
 
     uint64_t size = montauk::getsize(fd);
-    if (size > (uint64_t)MAX_CAP) size = MAX_CAP;
-
-    if ((int)size >= g_buf_cap) {
-        int new_cap = (int)size + 1024;
-        if (new_cap > MAX_CAP) new_cap = MAX_CAP;
-        g_buffer = (char*)montauk::realloc(g_buffer, new_cap);
-        g_buf_cap = new_cap;
+    if (size > 0x7FFFFFFF - INIT_CAP) {
+        montauk::close(fd);
+        return;
     }
 
-    montauk::read(fd, (uint8_t*)g_buffer, 0, size);
+    // Read straight into a fresh buffer with the gap after the text
+    int new_cap = (int)size + INIT_CAP;
+    char* buf = (char*)montauk::malloc(new_cap);
+    if (!buf) {
+        montauk::close(fd);
+        return;
+    }
+    montauk::read(fd, (uint8_t*)buf, 0, size);
     montauk::close(fd);
 
+    montauk::mfree(g_buffer);
+    g_buffer = buf;
+    g_buf_cap = new_cap;
     g_buf_len = (int)size;
+    g_gap_start = g_buf_len;
+    g_gap_end = new_cap;
     g_cursor_pos = 0;
     g_scroll_y = 0;
     g_scroll_x = 0;
@@ -479,7 +668,8 @@ static void save_file() {
     int fd = montauk::fcreate(g_filepath);
     if (fd < 0) return;
 
-    montauk::fwrite(fd, (const uint8_t*)g_buffer, 0, g_buf_len);
+    montauk::fwrite(fd, (const uint8_t*)g_buffer, 0, g_gap_start);
+    montauk::fwrite(fd, (const uint8_t*)g_buffer + g_gap_end, g_gap_start, g_buf_len - g_gap_start);
     montauk::close(fd);
 
     g_modified = false;
@@ -502,7 +692,7 @@ static int hit_test(int mx, int my, int editor_y) {
     int ll = line_length(clicked_line);
     if (clicked_col > ll) clicked_col = ll;
 
-    return g_line_offsets[clicked_line] + clicked_col;
+    return line_start(clicked_line) + clicked_col;
 }
 
 // ============================================================================
@@ -558,21 +748,24 @@ static void render(uint32_t* pixels) {
 
         // Input box
         px_fill(pixels, W, H, inp_x, inp_y, inp_w, inp_h, WHITE);
-        // Input border (top, bottom, left, right)
-        px_hline(pixels, W, H, inp_x, inp_y, inp_w, ACCENT);
-        px_hline(pixels, W, H, inp_x, inp_y + inp_h - 1, inp_w, ACCENT);
-        px_vline(pixels, W, H, inp_x, inp_y, inp_h, ACCENT);
-        px_vline(pixels, W, H, inp_x + inp_w - 1, inp_y, inp_h, ACCENT);
-
-        // Path text
-        if (g_font && g_pathbar_text[0])
+        // Input border (top, bottom, left, right), red when nothing is found
+        Color border = (g_pathbar_find && g_find.len > 0 && g_find.match < 0) ? NOT_FOUND : ACCENT;
+        px_hline(pixels, W, H, inp_x, inp_y, inp_w, border);
+        px_hline(pixels, W, H, inp_x, inp_y + inp_h - 1, inp_w, border);
+        px_vline(pixels, W, H, inp_x, inp_y, inp_h, border);
+        px_vline(pixels, W, H, inp_x + inp_w - 1, inp_y, inp_h, border);
+
+        // Path text, or the query with the cursor after it
+        const char* inp_text = g_pathbar_find ? g_find.query : g_pathbar_text;
+        if (g_font && inp_text[0])
             g_font->draw_to_buffer(pixels, W, H, inp_x + 4, inp_y + (inp_h - FONT_SIZE) / 2,
-                                   g_pathbar_text, TEXT_COLOR, FONT_SIZE);
+                                   inp_text, TEXT_COLOR, FONT_SIZE);
 
         // Cursor in pathbar
         char prefix[256];
-        int plen = g_pathbar_cursor > 255 ? 255 : g_pathbar_cursor;
-        for (int i = 0; i < plen; i++) prefix[i] = g_pathbar_text[i];
+        int plen = g_pathbar_find ? g_find.len : g_pathbar_cursor;
+        if (plen > 255) plen = 255;
+        for (int i = 0; i < plen; i++) prefix[i] = inp_text[i];
         prefix[plen] = '\0';
         int cx = inp_x + 4 + (g_font ? g_font->measure_text(prefix, FONT_SIZE) : 0);
         px_fill(pixels, W, H, cx, inp_y + 3, 2, inp_h - 6, ACCENT);
@@ -580,7 +773,7 @@ static void render(uint32_t* pixels) {
         // Button
         int ob_x = inp_x + inp_w + 6;
         px_fill_rounded(pixels, W, H, ob_x, inp_y, btn_w, inp_h, 3, ACCENT);
-        const char* btn_label = g_pathbar_save ? "Save" : "Open";
+        const char* btn_label = g_pathbar_find ? "Next" : g_pathbar_save ? "Save" : "Open";
         if (g_font) {
             int tw = g_font->measure_text(btn_label, FONT_SIZE);
             g_font->draw_to_buffer(pixels, W, H, ob_x + (btn_w - tw) / 2,
@@ -614,16 +807,10 @@ static void render(uint32_t* pixels) {
 
     int text_start_x = LINE_NUM_W + 4;
 
-    // Syntax highlighting: compute multi-line syntax state up to the first visible line
-    SynState syn_state = syn_make_state();
+    // Syntax highlighting: only the visible lines need their start state
     SynToken syn_line_buf[SYN_LINE_BUF_CAP];
-    if (g_syntax_language != SYN_LANG_NONE) {
-        for (int i = 0; i < g_scroll_y && i < g_line_count; i++) {
-            int ls = g_line_offsets[i];
-            int ll = line_length(i);
-            syn_highlight_line(g_buffer + ls, ll, nullptr, 0, g_syntax_language, syn_state);
-        }
-    }
+    if (g_syntax_language != SYN_LANG_NONE)
+        syn_update(g_scroll_y + visible_lines);
 
     GlyphCache* gc = (g_font_mono && g_font_mono->valid) ? g_font_mono->get_cache(MONO_SIZE) : nullptr;
 
@@ -649,22 +836,25 @@ static void render(uint32_t* pixels) {
             g_font_mono->draw_to_buffer(pixels, W, H, 4, py, num_str, LINENUM_COLOR, MONO_SIZE);
 
         // Line text
-        int line_start = g_line_offsets[line];
+        int line_pos = line_start(line);
         int line_len = line_length(line);
+        const char* line_text = buf_span(line_pos, line_len);
 
         // Syntax highlight this line
         int syn_len = line_len > SYN_LINE_BUF_CAP ? SYN_LINE_BUF_CAP : line_len;
-        if (g_syntax_language != SYN_LANG_NONE)
-            syn_highlight_line(g_buffer + line_start, line_len, syn_line_buf,
+        if (g_syntax_language != SYN_LANG_NONE) {
+            SynState syn_state = line_info(line).syn;
+            syn_highlight_line(line_text, line_len, syn_line_buf,
                                SYN_LINE_BUF_CAP, g_syntax_language, syn_state);
+        }
 
         for (int ci = 0; ci < line_len; ci++) {
             int px_x = text_start_x + ci * cell_w - g_scroll_x;
             if (px_x + cell_w <= LINE_NUM_W + 1) continue;
             if (px_x >= text_area_w) break;
 
-            int byte_pos = line_start + ci;
-            char ch = g_buffer[byte_pos];
+            int byte_pos = line_pos + ci;
+            char ch = line_text[ci];
 
             // Selection highlight
             if (g_has_selection && byte_pos >= sel_s && byte_pos < sel_e) {
@@ -688,7 +878,7 @@ static void render(uint32_t* pixels) {
 
         // Selection highlight for newline at end of line
         if (g_has_selection && line + 1 < g_line_count) {
-            int nl_pos = line_start + line_len;
+            int nl_pos = line_pos + line_len;
             if (nl_pos >= sel_s && nl_pos < sel_e) {
                 int px_x = text_start_x + line_len * cell_w - g_scroll_x;
                 if (px_x > LINE_NUM_W && px_x < text_area_w) {
@@ -760,7 +950,35 @@ static void render(uint32_t* pixels) {
 // Pathbar actions
 // ============================================================================
 
+// ============================================================================
+// Find
+// ============================================================================
+
+// Select the match, if there is one
+static void find_show(int64_t match) {
+    if (match < 0) return;
+    g_sel_anchor = (int)match;
+    g_sel_end = (int)match + g_find.len;
+    g_has_selection = true;
+    g_cursor_pos = g_sel_end;
+    update_cursor_pos();
+}
+
+// Searching starts at the cursor and wraps round to it. The text is taken
+// as one run here; keys go to the bar while it is open, so it stays put.
+static void open_findbar() {
+    g_pathbar_open = true;
+    g_pathbar_save = false;
+    g_pathbar_find = true;
+    int from = g_has_selection ? (g_sel_anchor < g_sel_end ? g_sel_anchor : g_sel_end) : g_cursor_pos;
+    g_find.begin(buf_span(0, g_buf_len), (uint64_t)g_buf_len, (uint64_t)from, true);
+}
+
 static void pathbar_confirm(int win_id) {
+    if (g_pathbar_find) {
+        find_show(g_find.next());
+        return;
+    }
     if (g_pathbar_text[0] == '\0') return;
 
     if (g_pathbar_save) {
@@ -770,6 +988,7 @@ static void pathbar_confirm(int win_id) {
             if (g_pathbar_text[i] == '/') name = g_pathbar_text + i + 1;
         montauk::strncpy(g_filename, name, 63);
         g_syntax_language = syn_detect_language(g_filepath);
+        syn_reset();
         save_file();
     } else {
         load_file(g_pathbar_text);
@@ -781,6 +1000,7 @@ static void pathbar_confirm(int win_id) {
 static void open_pathbar_open() {
     g_pathbar_open = true;
     g_pathbar_save = false;
+    g_pathbar_find = false;
     montauk::strncpy(g_pathbar_text, g_filepath, 255);
     g_pathbar_len = montauk::slen(g_pathbar_text);
     g_pathbar_cursor = g_pathbar_len;
@@ -789,6 +1009,7 @@ static void open_pathbar_open() {
 static void open_pathbar_save() {
     g_pathbar_open = true;
     g_pathbar_save = true;
+    g_pathbar_find = false;
     g_pathbar_text[0] = '\0';
     g_pathbar_len = 0;
     g_pathbar_cursor = 0;
@@ -811,6 +1032,29 @@ static bool handle_key(Montauk::KeyEvent& key, int win_id) {
             g_pathbar_open = false;
             return true;
         }
+        if (g_pathbar_find) {
+            if (key.ctrl && (key.ascii == 'f' || key.ascii == 'F')) {
+                g_pathbar_open = false;
+                return true;
+            }
+            if (key.scancode == 0x3D) { // F3
+                find_show(g_find.next());
+                return true;
+            }
+            if (key.ascii == '\b' || key.scancode == 0x0E) {
+                int64_t match = g_find.erase();
+                if (match >= 0) find_show(match);
+                else clear_selection();
+                return true;
+            }
+            if (key.ascii >= 32 && key.ascii < 127 && !key.ctrl) {
+                int64_t match = g_find.type(key.ascii);
+                if (match >= 0) find_show(match);
+                else clear_selection();
+                return true;
+            }
+            return false;
+        }
         if (key.ascii == '\b' || key.scancode == 0x0E) {
             if (g_pathbar_cursor > 0) {
                 for (int i = g_pathbar_cursor - 1; i < g_pathbar_len - 1; i++)
@@ -853,6 +1097,20 @@ static bool handle_key(Montauk::KeyEvent& key, int win_id) {
         return true;
     }
 
+    // Ctrl+F: find
+    if (key.ctrl && (key.ascii == 'f' || key.ascii == 'F')) {
+        open_findbar();
+        return true;
+    }
+
+    // F3: find the next match of the last query
+    if (key.scancode == 0x3D) {
+        if (g_find.len == 0) return false;
+        g_find.rebase(buf_span(0, g_buf_len), (uint64_t)g_buf_len, (uint64_t)g_cursor_pos);
+        find_show(g_find.next());
+        return true;
+    }
+
     // Ctrl+A: select all
     if (key.ctrl && (key.ascii == 'a' || key.ascii == 'A')) {
         g_sel_anchor = 0;
@@ -1064,7 +1322,7 @@ static bool handle_mouse(Montauk::WinEvent& ev, int win_id) {
             int col = g_cursor_col;
             int ll = line_length(new_line);
             if (col > ll) col = ll;
-            g_cursor_pos = g_line_offsets[new_line] + col;
+            g_cursor_pos = line_start(new_line) + col;
             g_cursor_line = new_line;
             g_cursor_col = col;
         }
@@ -1083,20 +1341,15 @@ extern "C" void _start() {
     g_buffer = (char*)montauk::malloc(INIT_CAP);
     g_buf_cap = INIT_CAP;
     g_buf_len = 0;
+    g_gap_start = 0;
+    g_gap_end = INIT_CAP;
 
     recompute_lines();
     update_cursor_pos();
 
     // Load fonts
-    auto load_font = [](const char* path) -> TrueTypeFont* {
-        TrueTypeFont* f = (TrueTypeFont*)montauk::malloc(sizeof(TrueTypeFont));
-        if (!f) return nullptr;
-        montauk::memset(f, 0, sizeof(TrueTypeFont));
-        if (!f->init(path)) { montauk::mfree(f); return nullptr; }
-        return f;
-    };
-    g_font = load_font("0:/fonts/Roboto-Medium.ttf");
-    g_font_mono = load_font("0:/fonts/JetBrainsMono-Regular.ttf");
+    g_font = fonts::open("0:/fonts/Roboto-Medium.ttf");
+    g_font_mono = fonts::open("0:/fonts/JetBrainsMono-Regular.ttf");
 
     // Load toolbar icons
     Color icon_color = Color::from_rgb(0x44, 0x44, 0x44);
@@ -1164,9 +1417,7 @@ extern "C" void _start() {
 
     // Cleanup
     if (g_buffer) montauk::mfree(g_buffer);
-    if (g_line_offsets) montauk::mfree(g_line_offsets);
-    if (g_font) montauk::mfree(g_font);
-    if (g_font_mono) montauk::mfree(g_font_mono);
+    if (g_lines) montauk::mfree(g_lines);
     montauk::win_destroy(win_id);
     montauk::exit(0);
 }
@@ -169,6 +169,12 @@ inline SynState syn_make_state() {
     return state;
 }
 
+inline bool syn_state_equal(const SynState& a, const SynState& b) {
+    return a.in_block_comment == b.in_block_comment &&
+           a.long_token == b.long_token &&
+           a.long_bracket_eqs == b.long_bracket_eqs;
+}
+
 inline bool syn_match_lua_long_bracket_open(const char* line, int len, int i,
                                             int& eqs, int& span) {
     if (i >= len || line[i] != '[') return false;
@@ -0,0 +1,517 @@
+/*
+    * main.cpp
+    * trace - Record kernel tracepoints and show or export the timeline
+    * Copyright (c) 2026 Daniel Hammer
+*/
+
+#include <montauk/syscall.h>
+#include <montauk/string.h>
+#include <montauk/args.h>
+#include <montauk/heap.h>
+
+using Montauk::TraceHeader;
+using Montauk::TraceRecord;
+
+static constexpr uint64_t DEFAULT_MS = 1000;
+static constexpr int MAX_PROCS = 1024;
+
+// ---- Output buffer, printed or written to a file at the end ----
+
+struct Out {
+    char* data = nullptr;
+    uint64_t len = 0;
+    uint64_t cap = 0;
+};
+
+static Out g_out;
+
+static void put(const char* s, uint64_t n) {
+    if (g_out.len + n + 1 > g_out.cap) {
+        uint64_t cap = g_out.cap ? g_out.cap * 2 : 65536;
+        while (cap < g_out.len + n + 1) cap *= 2;
+        char* grown = (char*)montauk::realloc(g_out.data, cap);
+        if (!grown) return;
+        g_out.data = grown;
+        g_out.cap = cap;
+    }
+    montauk::memcpy(g_out.data + g_out.len, s, n);
+    g_out.len += n;
+    g_out.data[g_out.len] = '\0';
+}
+
+static void put(const char* s) { put(s, montauk::slen(s)); }
+
+static void put_u64(uint64_t n) {
+    char buf[20];
+    int i = 0;
+    do {
+        buf[i++] = '0' + (n % 10);
+        n /= 10;
+    } while (n > 0);
+    char rev[20];
+    for (int j = 0; j < i; j++) rev[j] = buf[i - 1 - j];
+    put(rev, i);
+}
+
+static void put_i64(int64_t n) {
+    if (n < 0) {
+        put("-", 1);
+        put_u64((uint64_t)(-n));
+    } else {
+        put_u64((uint64_t)n);
+    }
+}
+
+static void put_hex(uint64_t n) {
+    static const char digits[] = "0123456789abcdef";
+    char buf[16];
+    int i = 0;
+    do {
+        buf[i++] = digits[n & 0xF];
+        n >>= 4;
+    } while (n > 0);
+    put("0x", 2);
+    for (int j = i - 1; j >= 0; j--) put(&buf[j], 1);
+}
+
+static void put_pad(uint64_t n, int width) {
+    int d = 1;
+    for (uint64_t v = n; v >= 10; v /= 10) d++;
+    for (int i = d; i < width; i++) put(" ", 1);
+    put_u64(n);
+}
+
+// Nanoseconds as microseconds with three decimals
+static void put_us(uint64_t ns) {
+    put_u64(ns / 1000);
+    put(".", 1);
+    uint64_t frac = ns % 1000;
+    put(frac < 100 ? (frac < 10 ? "00" : "0") : "");
+    put_u64(frac);
+}
+
+// ---- Trace data ----
+
+static TraceHeader* g_trace;
+static uint64_t g_next[Montauk::TRACE_MAX_CPUS];
+static uint64_t g_firstTsc;
+
+static Montauk::ProcInfo g_procs[MAX_PROCS];
+static int g_procCount;
+
+static const TraceRecord* record_at(uint32_t cpu, uint64_t n) {
+    uint8_t* ring = (uint8_t*)g_trace + g_trace->ringOffset + cpu * g_trace->ringStride;
+    return (const TraceRecord*)ring + (n & (g_trace->recordsPerCpu - 1));
+}
+
+// Start every CPU at the oldest record its ring still holds
+static void rewind() {
+    for (uint32_t c = 0; c < g_trace->cpus; c++) {
+        uint64_t head = g_trace->head[c];
+        g_next[c] = head > g_trace->recordsPerCpu ? head - g_trace->recordsPerCpu : 0;
+    }
+}
+
+// Each ring is in time order already; merge them
+static const TraceRecord* next_record() {
+    const TraceRecord* best = nullptr;
+    uint32_t bestCpu = 0;
+    for (uint32_t c = 0; c < g_trace->cpus; c++) {
+        if (g_next[c] >= g_trace->head[c]) continue;
+        const TraceRecord* r = record_at(c, g_next[c]);
+        if (!best || r->tsc < best->tsc) {
+            best = r;
+            bestCpu = c;
+        }
+    }
+    if (best) g_next[bestCpu]++;
+    return best;
+}
+
+static uint64_t to_ns(uint64_t tsc) {
+    uint64_t perUs = g_trace->tscPerUs ? g_trace->tscPerUs : 1;
+    return (tsc - g_firstTsc) * 1000 / perUs;
+}
+
+static const char* proc_name(int pid) {
+    for (int i = 0; i < g_procCount; i++) {
+        if (g_procs[i].pid == pid) return g_procs[i].name;
+    }
+    return nullptr;
+}
+
+static const char* event_name(uint16_t type) {
+    switch (type) {
+        case Montauk::TRACE_EV_SWITCH:         return "switch";
+        case Montauk::TRACE_EV_WAKEUP:         return "wakeup";
+        case Montauk::TRACE_EV_BLOCK:          return "block";
+        case Montauk::TRACE_EV_SYSCALL_ENTER:  return "syscall";
+        case Montauk::TRACE_EV_SYSCALL_EXIT:   return "sysret";
+        case Montauk::TRACE_EV_PAGE_FAULT:     return "fault";
+        case Montauk::TRACE_EV_BLOCK_SUBMIT:   return "bio-submit";
+        case Montauk::TRACE_EV_BLOCK_COMPLETE: return "bio-done";
+        case Montauk::TRACE_EV_IRQ:            return "irq";
+        case Montauk::TRACE_EV_NET_RX:         return "net-rx";
+        case Montauk::TRACE_EV_NET_TX:         return "net-tx";
+        default:                               return "?";
+    }
+}
+
+static void put_pid(int pid) {
+    if (pid < 0) {
+        put("idle");
+        return;
+    }
+    const char* name = proc_name(pid);
+    if (name) {
+        put(name);
+        put(":", 1);
+    }
+    put_i64(pid);
+}
+
+// Event arguments, "key=value" separated by spaces
+static void put_args_text(const TraceRecord& r) {
+    switch (r.type) {
+        case Montauk::TRACE_EV_SWITCH:
+            put_pid((int32_t)r.arg0);
+            put(" -> ");
+            put_pid((int32_t)r.arg1);
+            if (r.arg2) put(" (prev blocked)");
+            break;
+        case Montauk::TRACE_EV_WAKEUP:
+            put_pid((int32_t)r.arg0);
+            put(" on cpu ");
+            put_u64(r.arg1);
+            break;
+        case Montauk::TRACE_EV_BLOCK:
+            put_pid((int32_t)r.arg0);
+            break;
+        case Montauk::TRACE_EV_SYSCALL_ENTER:
+            put("nr=");
+            put_u64(r.arg0);
+            put(" arg=");
+            put_hex(r.arg1);
+            break;
+        case Montauk::TRACE_EV_SYSCALL_EXIT:
+            put("nr=");
+            put_u64(r.arg0);
+            put(" ret=");
+            put_i64((int64_t)r.arg1);
+            break;
+        case Montauk::TRACE_EV_PAGE_FAULT:
+            put("addr=");
+            put_hex(r.arg1);
+            put(" err=");
+            put_hex(r.arg0);
+            put(r.arg2 ? " resolved" : " fatal");
+            break;
+        case Montauk::TRACE_EV_BLOCK_SUBMIT:
+        case Montauk::TRACE_EV_BLOCK_COMPLETE:
+            put("dev=");
+            put_u64(r.arg0 & 0x7FFFFFFF);
+            put(" lba=");
+            put_u64(r.arg1);
+            put(" sectors=");
+            put_u64(r.arg2 & 0x7FFFFFFF);
+            put((r.arg2 >> 31) & 1 ? " write" : " read");
+            if (r.type == Montauk::TRACE_EV_BLOCK_COMPLETE && (r.arg0 >> 31)) put(" FAILED");
+            break;
+        case Montauk::TRACE_EV_IRQ:
+            put("irq=");
+            put_u64(r.arg0);
+            break;
+        case Montauk::TRACE_EV_NET_RX:
+        case Montauk::TRACE_EV_NET_TX:
+            put("type=");
+            put_hex(r.arg0);
+            put(" bytes=");
+            put_u64(r.arg1);
+            break;
+    }
+}
+
+static void write_text() {
+    put("        time(us)  cpu  event       details\n");
+    rewind();
+    while (const TraceRecord* r = next_record()) {
+        uint64_t ns = to_ns(r->tsc);
+        put_pad(ns / 1000000, 8);
+        put(".", 1);
+        uint64_t us = (ns / 1000) % 1000;
+        put(us < 100 ? (us < 10 ? "00" : "0") : "");
+        put_u64(us);
+        put("  ");
+        put_pad(r->cpu, 3);
+        put("  ");
+        const char* name = event_name(r->type);
+        put(name);
+        for (int i = montauk::slen(name); i < 12; i++) put(" ", 1);
+        put_args_text(*r);
+        put("\n", 1);
+    }
+}
+
+// ---- Chrome trace event JSON (also read by Perfetto) ----
+//
+// Process 0 has one thread per CPU carrying what ran there and the
+// instant events. Syscalls are begin/end pairs on the calling thread's
+// own track.
+
+static bool g_firstEvent = true;
+
+static void json_begin(const char* ph, const char* name, int pid, int tid, uint64_t ns) {
+    put(g_firstEvent ? "\n" : ",\n");
+    g_firstEvent = false;
+    put("{\"ph\":\"");
+    put(ph);
+    put("\",\"name\":\"");
+    put(name);
+    put("\",\"pid\":");
+    put_i64(pid);
+    put(",\"tid\":");
+    put_i64(tid);
+    put(",\"ts\":");
+    put_us(ns);
+}
+
+// What ran on `cpu` from `start` to `end`
+static void json_slice(int cpu, int pid, uint64_t start, uint64_t end) {
+    const char* name = proc_name(pid);
+    json_begin("X", name ? name : "pid", 0, cpu, start);
+    put(",\"dur\":");
+    put_us(end - start);
+    put(",\"args\":{\"pid\":");
+    put_i64(pid);
+    put("}}");
+}
+
+static void json_thread_name(int pid, int tid, const char* name, int64_t number) {
+    json_begin("M", "thread_name", pid, tid, 0);
+    put(",\"args\":{\"name\":\"");
+    put(name);
+    if (number >= 0) put_i64(number);
+    put("\"}}");
+}
+
+static void write_json() {
+    put("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+
+    json_begin("M", "process_name", 0, 0, 0);
+    put(",\"args\":{\"name\":\"CPUs\"}}");
+    for (uint32_t c = 0; c < g_trace->cpus; c++) json_thread_name(0, (int)c, "CPU ", c);
+
+    int running[Montauk::TRACE_MAX_CPUS];
+    uint64_t since[Montauk::TRACE_MAX_CPUS];
+    for (int c = 0; c < Montauk::TRACE_MAX_CPUS; c++) {
+        running[c] = -2;    // not known until the first switch
+        since[c] = 0;
+    }
+
+    uint64_t lastNs = 0;
+    rewind();
+    while (const TraceRecord* r = next_record()) {
+        uint64_t ns = to_ns(r->tsc);
+        int cpu = r->cpu < Montauk::TRACE_MAX_CPUS ? r->cpu : 0;
+        lastNs = ns;
+
+        switch (r->type) {
+            case Montauk::TRACE_EV_SWITCH: {
+                // A CPU's first slice starts at its first switch
+                int prev = (int32_t)r->arg0;
+                if (prev >= 0 && running[cpu] != -2) json_slice(cpu, prev, since[cpu], ns);
+                running[cpu] = (int32_t)r->arg1;
+                since[cpu] = ns;
+                break;
+            }
+            case Montauk::TRACE_EV_SYSCALL_ENTER:
+            case Montauk::TRACE_EV_SYSCALL_EXIT: {
+                int tid = running[cpu] >= 0 ? running[cpu] : -1;
+                bool enter = r->type == Montauk::TRACE_EV_SYSCALL_ENTER;
+                json_begin(enter ? "B" : "E", "syscall", tid, tid, ns);
+                put(",\"args\":{\"nr\":");
+                put_u64(r->arg0);
+                put(enter ? ",\"arg\":" : ",\"ret\":");
+                put_i64((int64_t)r->arg1);
+                put("}}");
+                break;
+            }
+            default:
+                json_begin("i", event_name(r->type), 0, cpu, ns);
+                put(",\"s\":\"t\",\"args\":{\"info\":\"");
+                put_args_text(*r);
+                put("\"}}");
+                break;
+        }
+    }
+
+    // Close what is still running and name the syscall tracks
+    for (uint32_t c = 0; c < g_trace->cpus; c++) {
+        if (running[c] >= 0) json_slice((int)c, running[c], since[c], lastNs);
+    }
+    for (int i = 0; i < g_procCount; i++) {
+        json_begin("M", "thread_name", g_procs[i].pid, g_procs[i].pid, 0);
+        put(",\"args\":{\"name\":\"");
+        put(g_procs[i].name);
+        put("\"}}");
+    }
+
+    put("\n]}\n");
+}
+
+// ---- Command line ----
+
+static uint32_t parse_categories(const char* s, int len) {
+    struct Cat { const char* name; uint32_t bit; };
+    static const Cat cats[] = {
+        {"sched", Montauk::TRACE_SCHED}, {"syscall", Montauk::TRACE_SYSCALL},
+        {"fault", Montauk::TRACE_FAULT}, {"block", Montauk::TRACE_BLOCK},
+        {"irq", Montauk::TRACE_IRQ},     {"net", Montauk::TRACE_NET},
+        {"all", Montauk::TRACE_ALL},
+    };
+
+    uint32_t mask = 0;
+    int start = 0;
+    for (int i = 0; i <= len; i++) {
+        if (i < len && s[i] != ',') continue;
+        int n = i - start;
+        bool found = false;
+        for (const Cat& c : cats) {
+            if (montauk::slen(c.name) == n && montauk::memcmp(c.name, s + start, n) == 0) {
+                mask |= c.bit;
+                found = true;
+            }
+        }
+        if (!found) return 0;
+        start = i + 1;
+    }
+    return mask;
+}
+
+static void usage() {
+    montauk::print("usage: trace [-e sched,syscall,fault,block,irq,net] [-t ms] [-o file.json] [command [args]]\n");
+    montauk::exit(1);
+}
+
+extern "C" void _start() {
+    char args[512];
+    montauk::getargs(args, sizeof(args));
+
+    uint32_t mask = Montauk::TRACE_ALL;
+    uint64_t ms = DEFAULT_MS;
+    char outPath[256] = "";
+    char command[256] = "";
+    const char* commandArgs = nullptr;
+
+    const char* p = args;
+    char w[256];
+    while (true) {
+        const char* rest = montauk::next_word(p, w, sizeof(w));
+        if (w[0] == '\0') break;
+        if (montauk::streq(w, "-e")) {
+            p = montauk::next_word(rest, w, sizeof(w));
+            mask = parse_categories(w, montauk::slen(w));
+            if (mask == 0) usage();
+        } else if (montauk::streq(w, "-t")) {
+            p = montauk::next_word(rest, w, sizeof(w));
+            ms = montauk::parse_u64(w);
+        } else if (montauk::streq(w, "-o")) {
+            p = montauk::next_word(rest, outPath, sizeof(outPath));
+            if (outPath[0] == '\0') usage();
+        } else if (w[0] == '-') {
+            usage();
+        } else {
+            montauk::strcpy(command, w);
+            commandArgs = montauk::skip_spaces(rest);
+            if (*commandArgs == '\0') commandArgs = nullptr;
+            break;
+        }
+    }
+
+    g_trace = montauk::trace_map();
+    if (!g_trace || g_trace->magic != Montauk::TRACE_MAGIC) {
+        montauk::print("trace: cannot map the trace buffer\n");
+        montauk::exit(1);
+    }
+
+    // Resolve the command before tracing starts
+    char path[300] = "";
+    if (command[0]) {
+        bool direct = false;
+        for (int i = 0; command[i]; i++) {
+            if (command[i] == '/' || command[i] == ':') direct = true;
+        }
+        if (direct) {
+            montauk::strcpy(path, command);
+        } else {
+            montauk::strcpy(path, "0:/os/");
+            montauk::strcpy(path + 6, command);
+            montauk::strcpy(path + 6 + montauk::slen(command), ".elf");
+        }
+    }
+
+    montauk::trace_ctl(0);
+    if (montauk::trace_ctl(mask) < 0) {
+        montauk::print("trace: cannot start tracing\n");
+        montauk::exit(1);
+    }
+
+    if (path[0]) {
+        int pid = montauk::spawn(path, commandArgs);
+        if (pid < 0) {
+            montauk::trace_ctl(0);
+            montauk::print("trace: cannot run ");
+            montauk::print(path);
+            montauk::print("\n");
+            montauk::exit(1);
+        }
+        montauk::waitpid(pid);
+    } else {
+        montauk::sleep_ms(ms);
+    }
+
+    montauk::trace_ctl(0);
+    g_procCount = montauk::proclist(g_procs, MAX_PROCS);
+    if (g_procCount < 0) g_procCount = 0;
+
+    // Time zero is the oldest record kept on any CPU
+    g_firstTsc = ~0ull;
+    uint64_t total = 0;
+    rewind();
+    for (uint32_t c = 0; c < g_trace->cpus; c++) {
+        if (g_next[c] < g_trace->head[c]) {
+            uint64_t tsc = record_at(c, g_next[c])->tsc;
+            if (tsc < g_firstTsc) g_firstTsc = tsc;
+        }
+        total += g_trace->head[c] - g_next[c];
+    }
+    if (total == 0) {
+        montauk::print("trace: no events recorded\n");
+        montauk::exit(0);
+    }
+
+    if (outPath[0]) {
+        write_json();
+        int fd = montauk::fcreate(outPath);
+        if (fd < 0) {
+            montauk::print("trace: cannot create ");
+            montauk::print(outPath);
+            montauk::print("\n");
+            montauk::exit(1);
+        }
+        montauk::fwrite(fd, (const uint8_t*)g_out.data, 0, g_out.len);
+        montauk::close(fd);
+
+        g_out.len = 0;
+        put_u64(total);
+        put(" events written to ");
+        put(outPath);
+        put("\n");
+    } else {
+        write_text();
+    }
+
+    if (g_out.data) montauk::print(g_out.data);
+    montauk::free(g_trace);
+    montauk::exit(0);
+}
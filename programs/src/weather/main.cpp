@@ -14,6 +14,7 @@
 #include <gui/svg.hpp>
 #include <gui/truetype.hpp>
 #include <tls/tls.hpp>
+#include <http/cache.hpp>
 
 extern "C" {
 #include <string.h>
@@ -43,6 +44,7 @@ static int           DESC_SIZE  = 17;
 static constexpr int FEELS_Y    = 116;
 static int           LABEL_SIZE = 15;
 static constexpr int RESP_MAX   = 65536;
+static constexpr int CACHE_TTL  = 900;     // wttr.in sends no freshness info
 
 static const char WTTR_HOST[] = "wttr.in";
 
@@ -75,6 +77,8 @@ static char     g_icon_name[64]  = {};
 static bool     g_tls_ready = false;
 static uint32_t g_server_ip = 0;
 static tls::TrustAnchors g_tas = {nullptr, 0, 0};
+static tls::HttpsClient g_https;     // resumes the TLS session on refresh
+static http::Cache g_cache;          // last forecast, reused on launch
 
 // ============================================================================
 // HTTP parsing
@@ -219,36 +223,32 @@ static void apply_scale(int scale) {
 // Network fetch  (blocking — called from the event loop)
 // ============================================================================
 
-static void do_fetch() {
-    // Lazy init: resolve DNS and load CA certificates once
-    if (!g_tls_ready) {
-        g_server_ip = montauk::resolve(WTTR_HOST);
-        if (g_server_ip == 0) {
-            snprintf(g_status, sizeof(g_status),
-                     "Error: could not resolve %s", WTTR_HOST);
-            g_phase = AppPhase::ERR; return;
-        }
-        g_tas = tls::load_trust_anchors();
-        if (g_tas.count == 0) {
-            snprintf(g_status, sizeof(g_status), "Error: no CA certificates loaded");
-            g_phase = AppPhase::ERR; return;
+// On launch a forecast stored less than CACHE_TTL ago is shown without
+// touching the network; Refresh always asks the server.
+static void do_fetch(bool refresh = false) {
+    int respLen = refresh ? -1 : g_cache.lookup(WTTR_HOST, "/?format=j1", g_resp_buf, RESP_MAX);
+    if (respLen < 0) {
+        // Lazy init: resolve DNS and load CA certificates once
+        if (!g_tls_ready) {
+            g_server_ip = montauk::resolve(WTTR_HOST);
+            if (g_server_ip == 0) {
+                snprintf(g_status, sizeof(g_status),
+                         "Error: could not resolve %s", WTTR_HOST);
+                g_phase = AppPhase::ERR; return;
+            }
+            g_tas = tls::load_trust_anchors();
+            if (g_tas.count == 0) {
+                snprintf(g_status, sizeof(g_status), "Error: no CA certificates loaded");
+                g_phase = AppPhase::ERR; return;
+            }
+            g_https.init(g_tas);
+            g_tls_ready = true;
         }
-        g_tls_ready = true;
+        respLen = g_cache.fetch(g_https, WTTR_HOST, g_server_ip, 443, "/?format=j1",
+                                "User-Agent: MontaukOS/1.0 weather\r\n"
+                                "Accept: application/json\r\n",
+                                CACHE_TTL, g_resp_buf, RESP_MAX);
     }
-
-    static char request[512];
-    int reqLen = snprintf(request, sizeof(request),
-        "GET /?format=j1 HTTP/1.0\r\n"
-        "Host: %s\r\n"
-        "User-Agent: MontaukOS/1.0 weather\r\n"
-        "Accept: application/json\r\n"
-        "Connection: close\r\n"
-        "\r\n",
-        WTTR_HOST);
-
-    int respLen = tls::https_fetch(WTTR_HOST, g_server_ip, 443,
-                                   request, reqLen, g_tas,
-                                   g_resp_buf, RESP_MAX);
     if (respLen <= 0) {
         snprintf(g_status, sizeof(g_status), "Error: no response from server");
         g_phase = AppPhase::ERR; return;
@@ -386,18 +386,12 @@ static void render(Canvas& canvas) {
 extern "C" void _start() {
     // Allocate response buffer from heap
     g_resp_buf = (char*)malloc(RESP_MAX + 1);
+    g_cache.init("weather", 256 * 1024);
     if (!g_resp_buf) montauk::exit(1);
 
     // Load fonts
-    auto load_font = [](const char* path) -> TrueTypeFont* {
-        TrueTypeFont* f = (TrueTypeFont*)montauk::malloc(sizeof(TrueTypeFont));
-        if (!f) return nullptr;
-        montauk::memset(f, 0, sizeof(TrueTypeFont));
-        if (!f->init(path)) { montauk::mfree(f); return nullptr; }
-        return f;
-    };
-    g_font      = load_font("0:/fonts/Roboto-Medium.ttf");
-    g_font_bold = load_font("0:/fonts/Roboto-Bold.ttf");
+    g_font      = fonts::open("0:/fonts/Roboto-Medium.ttf");
+    g_font_bold = fonts::open("0:/fonts/Roboto-Bold.ttf");
     if (!g_font) montauk::exit(1);
 
     apply_scale(montauk::win_getscale());
@@ -454,7 +448,7 @@ extern "C" void _start() {
                     canvas = win.canvas();
                     render(canvas);
                     win.present();
-                    do_fetch();
+                    do_fetch(true);
                 }
             }
         }
@@ -39,6 +39,7 @@ struct WikiLine {
 
 static uint32_t g_serverIp = 0;
 static tls::TrustAnchors g_tas = {nullptr, 0, 0};
+static tls::HttpsClient g_https;     // one connection for the search and the article
 
 // ---- Screen buffer for flicker-free rendering ----
 
@@ -85,16 +86,14 @@ static bool check_keyboard_abort() {
 static int wiki_fetch(const char* path, char* respBuf, int respMax) {
     static char request[2560];  // keep off stack
     int reqLen = snprintf(request, sizeof(request),
-        "GET %s HTTP/1.0\r\n"
+        "GET %s HTTP/1.1\r\n"
         "Host: %s\r\n"
         "User-Agent: MontaukOS/1.0 wiki\r\n"
         "Accept: application/json\r\n"
-        "Connection: close\r\n"
         "\r\n",
         path, WIKI_HOST);
-    return tls::https_fetch(WIKI_HOST, g_serverIp, 443,
-                            request, reqLen, g_tas,
-                            respBuf, respMax, check_keyboard_abort);
+    return g_https.fetch(WIKI_HOST, g_serverIp, 443,
+                         request, reqLen, respBuf, respMax, check_keyboard_abort);
 }
 
 // ---- HTTP response parsing ----
@@ -363,10 +362,19 @@ static int build_lines(WikiLine* lines, int maxLines,
 
 // ---- Pager rendering ----
 
+// The pager's search over the article text: '/' starts it and each key
+// typed searches again, 'n' finds the next match
+struct PagerSearch {
+    montauk::IncrementalSearch find;
+    bool prompting = false;
+    int savedScroll = 0;
+};
+
 static void render_pager(WikiLine* lines, int totalLines, int scroll,
                          int rows, int cols, const char* statusTitle,
-                         const char* modeLabel) {
+                         const char* modeLabel, const PagerSearch& search) {
     int contentRows = rows - 1;
+    const char* hit = search.find.match >= 0 ? search.find.text + search.find.match : nullptr;
     sb_reset();
     sb_puts("\033[?25l");
 
@@ -402,15 +410,29 @@ static void render_pager(WikiLine* lines, int totalLines, int scroll,
             maxW -= (ln.level - 2) * 2;
         int printLen = ln.len;
         if (printLen > maxW) printLen = maxW;
-        for (int c = 0; c < printLen; c++)
-            sb_putc(ln.text[c]);
+        bool inHit = false;
+        for (int c = 0; c < printLen; c++) {
+            const char* ch = ln.text + c;
+            bool h = hit && ch >= hit && ch < hit + search.find.len;
+            if (h != inHit) sb_puts(h ? "\033[7m" : "\033[27m");
+            inHit = h;
+            sb_putc(*ch);
+        }
+        if (inHit) sb_puts("\033[27m");
 
         if (ln.type != LINE_BODY)
             sb_puts("\033[0m");
     }
 
-    // Status bar
+    // Status bar, or the search prompt
     sb_cursor_to(rows, 1);
+    if (search.prompting) {
+        sb_puts("\033[2K/");
+        sb_puts(search.find.query);
+        if (search.find.len > 0 && search.find.match < 0) sb_puts("  (not found)");
+        sb_flush();
+        return;
+    }
     sb_puts("\033[7m");
 
     int visCol = 0;
@@ -437,7 +459,7 @@ static void render_pager(WikiLine* lines, int totalLines, int scroll,
     char numStr[32];
     int nLen = snprintf(numStr, sizeof(numStr), "%d/%d", scroll + 1, totalLines);
     for (int i = 0; i < nLen; i++) { sb_putc(numStr[i]); visCol++; }
-    SB_STATUS(" | q:Quit j/k:Scroll Space/b:Page ");
+    SB_STATUS(" | q:Quit j/k:Scroll Space/b:Page /:Search ");
 
     #undef SB_STATUS
 
@@ -448,8 +470,24 @@ static void render_pager(WikiLine* lines, int totalLines, int scroll,
     sb_flush();
 }
 
-static void run_pager(WikiLine* lines, int totalLines, const char* title,
-                      const char* modeLabel, bool useAltScreen) {
+// Scroll so the line holding the match is at the top. Lines not from
+// the article text (title, blank lines) are skipped over.
+static int pager_scroll_to(WikiLine* lines, int totalLines, int64_t match,
+                           const char* text, int textLen, int scroll, int maxScroll) {
+    if (match < 0) return scroll;
+    const char* hit = text + match;
+    int line = scroll;
+    for (int i = 0; i < totalLines; i++) {
+        if (lines[i].text < text || lines[i].text > text + textLen) continue;
+        if (lines[i].text > hit) break;
+        line = i;
+    }
+    return line < maxScroll ? line : maxScroll;
+}
+
+// Page through `lines`, built from the article text `text` (textLen bytes)
+static void run_pager(WikiLine* lines, int totalLines, const char* text, int textLen,
+                      const char* title, const char* modeLabel, bool useAltScreen) {
     int cols = 80, rows = 25;
     montauk::termsize(&cols, &rows);
 
@@ -462,7 +500,10 @@ static void run_pager(WikiLine* lines, int totalLines, const char* title,
     int maxScroll = totalLines - (rows - 1);
     if (maxScroll < 0) maxScroll = 0;
 
-    render_pager(lines, totalLines, scroll, rows, cols, title, modeLabel);
+    PagerSearch search;
+    search.find.begin(text, (uint64_t)textLen, 0, true);
+
+    render_pager(lines, totalLines, scroll, rows, cols, title, modeLabel, search);
 
     bool running = true;
     while (running) {
@@ -474,6 +515,47 @@ static void run_pager(WikiLine* lines, int totalLines, const char* title,
 
         int contentRows = rows - 1;
 
+        if (search.prompting) {
+            int64_t match = search.find.match;
+            if (ev.ascii == '\n' || ev.ascii == '\r') {
+                search.prompting = false;
+            } else if (ev.scancode == 0x01) { // Escape
+                search.prompting = false;
+                search.find.match = -1;
+                scroll = search.savedScroll;
+            } else if (ev.ascii == '\b' || ev.scancode == 0x0E) {
+                match = search.find.erase();
+            } else if (ev.ascii >= 32 && ev.ascii < 127) {
+                match = search.find.type(ev.ascii);
+            }
+            if (search.prompting)
+                scroll = pager_scroll_to(lines, totalLines, match, text, textLen,
+                                         match >= 0 ? scroll : search.savedScroll, maxScroll);
+            render_pager(lines, totalLines, scroll, rows, cols, title, modeLabel, search);
+            continue;
+        }
+
+        if (ev.ascii == '/') {
+            // A new search starts from the first article line shown
+            uint64_t from = 0;
+            for (int i = scroll; i < totalLines; i++) {
+                if (lines[i].text >= text && lines[i].text <= text + textLen) {
+                    from = (uint64_t)(lines[i].text - text);
+                    break;
+                }
+            }
+            search.find.begin(text, (uint64_t)textLen, from, true);
+            search.prompting = true;
+            search.savedScroll = scroll;
+            render_pager(lines, totalLines, scroll, rows, cols, title, modeLabel, search);
+            continue;
+        }
+        if (ev.ascii == 'n') {
+            scroll = pager_scroll_to(lines, totalLines, search.find.next(), text, textLen, scroll, maxScroll);
+            render_pager(lines, totalLines, scroll, rows, cols, title, modeLabel, search);
+            continue;
+        }
+
         if (ev.ascii == 'q' || (ev.ctrl && ev.ascii == 'q')) {
             running = false;
             break;
@@ -499,7 +581,7 @@ static void run_pager(WikiLine* lines, int totalLines, const char* title,
         }
 
         if (running)
-            render_pager(lines, totalLines, scroll, rows, cols, title, modeLabel);
+            render_pager(lines, totalLines, scroll, rows, cols, title, modeLabel, search);
     }
 
     if (useAltScreen) {
@@ -707,6 +789,7 @@ extern "C" void _start() {
         montauk::print("\033[1;31mError:\033[0m no CA certificates loaded\n");
         montauk::exit(1);
     }
+    g_https.init(g_tas);
 
     // Allocate shared buffers
     char* respBuf = (char*)malloc(RESP_MAX);
@@ -870,7 +953,7 @@ extern "C" void _start() {
                 int totalLines = build_lines(lines, MAX_LINES,
                     title, description, extractBuf, extractLen, cols, false);
                 // Run pager without alt screen (we're already in one)
-                run_pager(lines, totalLines, title, "Summary", false);
+                run_pager(lines, totalLines, extractBuf, extractLen, title, "Summary", false);
             }
             // Loop back to re-render search results
         }
@@ -942,7 +1025,7 @@ extern "C" void _start() {
             cols, mode == MODE_FULL);
 
         const char* modeLabel = (mode == MODE_FULL) ? "Full Article" : "Summary";
-        run_pager(lines, totalLines, title, modeLabel, true);
+        run_pager(lines, totalLines, extractBuf, extractLen, title, modeLabel, true);
     }
 
     montauk::exit(0);
@@ -12,6 +12,7 @@
 #include <gui/standalone.hpp>
 #include <gui/truetype.hpp>
 #include <tls/tls.hpp>
+#include <http/cache.hpp>
 
 extern "C" {
 #include <string.h>
@@ -36,6 +37,9 @@ static int           SECTION_SIZE = 24;
 static constexpr int TEXT_PAD     = 16;
 static constexpr int RESP_MAX     = 131072;
 static constexpr int MAX_LINES    = 2000;
+static constexpr int HISTORY_MAX  = 32;
+static constexpr int CACHE_TTL    = 3600;              // articles without freshness info
+static constexpr uint64_t CACHE_BYTES = 8ull << 20;
 
 static const char WIKI_HOST[] = "en.wikipedia.org";
 
@@ -81,6 +85,13 @@ static TrueTypeFont* g_font_serif = nullptr;  // NotoSerif SemiBold (headings)
 static bool          g_tls_ready  = false;
 static uint32_t      g_server_ip  = 0;
 static tls::TrustAnchors g_tas = {nullptr, 0, 0};
+static tls::HttpsClient g_https;     // keeps the connection between searches
+static http::Cache   g_cache;        // articles on disk, across launches
+
+// Articles viewed, for Alt+Left / Alt+Right
+static char          g_history[HISTORY_MAX][256];
+static int           g_hist_count = 0;
+static int           g_hist_pos   = -1;
 
 // ============================================================================
 // UI scale
@@ -95,25 +106,6 @@ static void apply_scale(int scale) {
     if (g_font) g_line_h = g_font->get_line_height(FONT_SIZE) + 4;
 }
 
-// ============================================================================
-// HTTPS fetch wrapper
-// ============================================================================
-
-static int wiki_fetch(const char* path, char* respBuf, int respMax) {
-    static char request[2560];
-    int reqLen = snprintf(request, sizeof(request),
-        "GET %s HTTP/1.0\r\n"
-        "Host: %s\r\n"
-        "User-Agent: MontaukOS/1.0 wikipedia\r\n"
-        "Accept: application/json\r\n"
-        "Connection: close\r\n"
-        "\r\n",
-        path, WIKI_HOST);
-    return tls::https_fetch(WIKI_HOST, g_server_ip, 443,
-                            request, reqLen, g_tas,
-                            respBuf, respMax);
-}
-
 // ============================================================================
 // HTTP parsing
 // ============================================================================
@@ -162,8 +154,9 @@ static int url_encode_title(const char* in, char* out, int maxLen) {
 // JSON string extraction
 // ============================================================================
 
-static int extract_json_string(const char* buf, int len, const char* key,
-                                char* out, int maxOut) {
+// Offset just past the opening quote of `key`'s string value in buf, or
+// -1 if it is not (yet) there
+static int find_json_string(const char* buf, int len, const char* key) {
     int klen = (int)strlen(key);
     for (int i = 0; i < len - klen - 3; i++) {
         if (buf[i] != '"') continue;
@@ -174,60 +167,130 @@ static int extract_json_string(const char* buf, int len, const char* key,
         int p = i + 3 + klen;
         while (p < len && (buf[p]==' ' || buf[p]=='\t')) p++;
         if (p >= len || buf[p] != '"') continue;
-        p++;
+        return p + 1;
+    }
+    return -1;
+}
 
-        int j = 0;
-        while (p < len && j < maxOut - 4) {
-            if (buf[p] == '"') break;
-            if (buf[p] == '\\' && p + 1 < len) {
-                p++;
-                switch (buf[p]) {
-                case '"':  out[j++] = '"';  break;
-                case '\\': out[j++] = '\\'; break;
-                case 'n':  out[j++] = '\n'; break;
-                case 'r':  break;
-                case 't':  out[j++] = '\t'; break;
-                case '/':  out[j++] = '/';  break;
-                case 'u': {
-                    if (p + 4 < len) {
-                        unsigned val = 0;
-                        for (int k = 1; k <= 4; k++) {
-                            char h = buf[p + k]; val <<= 4;
-                            if (h>='0'&&h<='9') val |= h-'0';
-                            else if (h>='a'&&h<='f') val |= h-'a'+10;
-                            else if (h>='A'&&h<='F') val |= h-'A'+10;
-                        }
-                        p += 4;
-                        if (val < 128) out[j++] = (char)val;
-                        else if (val==0x2013||val==0x2014) out[j++] = '-';
-                        else if (val==0x2018||val==0x2019) out[j++] = '\'';
-                        else if (val==0x201C||val==0x201D) out[j++] = '"';
-                        else if (val==0x2026) { out[j++]='.'; out[j++]='.'; out[j++]='.'; }
-                        else out[j++] = '?';
-                    }
-                    break;
+// Decode string contents from buf[*pos] up to the closing quote onto
+// out[*out_len]. Returns true once the string is done (or out is full);
+// false if buf ran out first, with *pos left on the first byte not used,
+// so the rest can be decoded when more of it arrives.
+static bool decode_json_chars(const char* buf, int len, int* pos,
+                              char* out, int* out_len, int maxOut) {
+    int p = *pos, j = *out_len;
+    bool done = false;
+    while (p < len) {
+        if (j >= maxOut - 4 || buf[p] == '"') {
+            done = true;
+            break;
+        }
+        if (buf[p] == '\\') {
+            if (p + 1 >= len) break;
+            p++;
+            switch (buf[p]) {
+            case '"':  out[j++] = '"';  break;
+            case '\\': out[j++] = '\\'; break;
+            case 'n':  out[j++] = '\n'; break;
+            case 'r':  break;
+            case 't':  out[j++] = '\t'; break;
+            case '/':  out[j++] = '/';  break;
+            case 'u': {
+                if (p + 4 >= len) {
+                    p--;
+                    goto out;
                 }
-                default: out[j++] = buf[p]; break;
+                unsigned val = 0;
+                for (int k = 1; k <= 4; k++) {
+                    char h = buf[p + k]; val <<= 4;
+                    if (h>='0'&&h<='9') val |= h-'0';
+                    else if (h>='a'&&h<='f') val |= h-'a'+10;
+                    else if (h>='A'&&h<='F') val |= h-'A'+10;
                 }
+                p += 4;
+                if (val < 128) out[j++] = (char)val;
+                else if (val==0x2013||val==0x2014) out[j++] = '-';
+                else if (val==0x2018||val==0x2019) out[j++] = '\'';
+                else if (val==0x201C||val==0x201D) out[j++] = '"';
+                else if (val==0x2026) { out[j++]='.'; out[j++]='.'; out[j++]='.'; }
+                else out[j++] = '?';
+                break;
+            }
+            default: out[j++] = buf[p]; break;
+            }
+        } else {
+            unsigned char uc = (unsigned char)buf[p];
+            if (uc < 0x80) {
+                out[j++] = buf[p];
             } else {
-                unsigned char uc = (unsigned char)buf[p];
-                if (uc < 0x80) {
-                    out[j++] = buf[p];
-                } else {
-                    // Skip multi-byte UTF-8 sequence (non-ASCII)
-                    if      (uc >= 0xF0) p += 3; // 4-byte seq: skip 3 continuation bytes
-                    else if (uc >= 0xE0) p += 2; // 3-byte seq: skip 2 continuation bytes
-                    else if (uc >= 0xC0) p += 1; // 2-byte seq: skip 1 continuation byte
-                    // else: stray continuation byte (0x80-0xBF), just skip it
-                }
+                // Skip multi-byte UTF-8 sequence (non-ASCII)
+                int extra = uc >= 0xF0 ? 3 : uc >= 0xE0 ? 2 : uc >= 0xC0 ? 1 : 0;
+                if (p + extra >= len) break;
+                p += extra;
+                // extra == 0: stray continuation byte (0x80-0xBF), just skip it
             }
-            p++;
         }
-        out[j] = '\0';
-        return j;
+        p++;
     }
+out:
+    *pos = p;
+    *out_len = j;
+    out[j] = '\0';
+    return done;
+}
+
+static int extract_json_string(const char* buf, int len, const char* key,
+                                char* out, int maxOut) {
+    int p = find_json_string(buf, len, key);
+    int j = 0;
     out[0] = '\0';
-    return 0;
+    if (p >= 0) decode_json_chars(buf, len, &p, out, &j, maxOut);
+    return j;
+}
+
+// ============================================================================
+// Article stream
+// ============================================================================
+
+// The response being read into g_resp_buf. The extract is decoded into
+// g_extract_buf as its bytes arrive, so layout can start on the first
+// paragraphs while the rest is still on the way.
+struct ArticleStream {
+    int body;          // offset of the body in g_resp_buf; -1 until the headers are in
+    int status;
+    int pos;           // next byte of the body to decode; -1 until "extract" is found
+    bool complete;     // the whole extract is in g_extract_buf
+};
+
+static ArticleStream g_article = { -1, 0, -1, false };
+
+static void article_reset() {
+    g_article = { -1, 0, -1, false };
+    g_title[0] = '\0';
+    g_extract_buf[0] = '\0';
+    g_extract_len = 0;
+}
+
+// Take in the first `len` bytes of the response
+static void article_feed(int len) {
+    if (g_article.body < 0) {
+        int headerEnd = find_header_end(g_resp_buf, len);
+        if (headerEnd < 0) return;
+        g_article.body = headerEnd;
+        g_article.status = parse_status_code(g_resp_buf, headerEnd);
+    }
+    if (g_article.status != 200 || g_article.complete) return;
+
+    const char* body = g_resp_buf + g_article.body;
+    int bodyLen = len - g_article.body;
+    if (g_article.pos < 0) {
+        g_article.pos = find_json_string(body, bodyLen, "extract");
+        if (g_article.pos < 0) return;
+        // The title comes before the extract
+        extract_json_string(body, g_article.pos, "title", g_title, sizeof(g_title));
+    }
+    g_article.complete = decode_json_chars(body, bodyLen, &g_article.pos,
+                                           g_extract_buf, &g_extract_len, RESP_MAX - 1);
 }
 
 // ============================================================================
@@ -302,76 +365,153 @@ static void wrap_text(TrueTypeFont* font, int size, const char* text, int textLe
     if (cur_len > 0) add_line(cur, cur_len, color, size, font);
 }
 
-static void build_display_lines(const char* title, const char* extract, int extractLen) {
+// Lines are laid out a paragraph at a time, only as far down as someone
+// looks: the first screen while the article is still arriving, the rest
+// as it is scrolled to. Bytes of g_extract_buf laid out so far:
+static int  g_laid_out   = 0;
+static bool g_title_laid = false;
+
+// Start over, after a new article or a change of width or scale
+static void reset_layout() {
     g_line_count = 0;
+    g_laid_out   = 0;
+    g_title_laid = false;
     g_scroll_y   = 0;
+}
 
-    // Max pixel width for text (accounting for left pad, right pad, scrollbar)
-    int max_px = g_win_w - TEXT_PAD - SCROLLBAR_W - TEXT_PAD;
+static bool layout_done() {
+    return g_article.complete && g_laid_out >= g_extract_len;
+}
 
-    // Title — large, serif, black
-    if (title && title[0]) {
-        TrueTypeFont* tf = g_font_serif ? g_font_serif : g_font;
-        wrap_text(tf, TITLE_SIZE, title, (int)strlen(title), max_px, BLACK);
+static void layout_paragraph(const char* line_start, int line_len, int max_px) {
+    if (line_len == 0) {
         add_empty_line();
+        return;
     }
 
-    // Process extract line-by-line
-    const char* p   = extract;
-    const char* end = extract + extractLen;
+    // Section header: == Title ==
+    if (line_len >= 4 && line_start[0] == '=' && line_start[1] == '=') {
+        int si = 0, ei = line_len;
+        while (si < line_len && line_start[si] == '=') si++;
+        while (si < line_len && line_start[si] == ' ') si++;
+        while (ei > si && line_start[ei-1] == '=') ei--;
+        while (ei > si && line_start[ei-1] == ' ') ei--;
+        if (ei > si) {
+            add_empty_line();
+            TrueTypeFont* tf = g_font_serif ? g_font_serif : g_font;
+            wrap_text(tf, SECTION_SIZE, line_start + si, ei - si, max_px, BLACK);
+        }
+        return;
+    }
 
-    while (p < end && g_line_count < MAX_LINES) {
-        const char* line_start = p;
-        while (p < end && *p != '\n') p++;
-        int line_len = (int)(p - line_start);
-        if (p < end) p++;  // consume '\n'
+    // Regular body text
+    wrap_text(g_font, FONT_SIZE, line_start, line_len, max_px, TEXT_COLOR);
+}
+
+// Lay out paragraphs until there are `lines` display lines or the text
+// that has arrived runs out. A paragraph still arriving waits for its
+// newline, so it is never wrapped twice.
+static void layout_until(int lines) {
+    // Max pixel width for text (accounting for left pad, right pad, scrollbar)
+    int max_px = g_win_w - TEXT_PAD - SCROLLBAR_W - TEXT_PAD;
 
-        if (line_len == 0) {
+    if (!g_title_laid && g_article.pos >= 0) {
+        // Title — large, serif, black
+        if (g_title[0]) {
+            TrueTypeFont* tf = g_font_serif ? g_font_serif : g_font;
+            wrap_text(tf, TITLE_SIZE, g_title, (int)strlen(g_title), max_px, BLACK);
             add_empty_line();
-            continue;
         }
+        g_title_laid = true;
+    }
 
-        // Section header: == Title ==
-        if (line_len >= 4 && line_start[0] == '=' && line_start[1] == '=') {
-            int si = 0, ei = line_len;
-            while (si < line_len && line_start[si] == '=') si++;
-            while (si < line_len && line_start[si] == ' ') si++;
-            while (ei > si && line_start[ei-1] == '=') ei--;
-            while (ei > si && line_start[ei-1] == ' ') ei--;
-            if (ei > si) {
-                add_empty_line();
-                TrueTypeFont* tf = g_font_serif ? g_font_serif : g_font;
-                wrap_text(tf, SECTION_SIZE, line_start + si, ei - si, max_px, BLACK);
-            }
-            continue;
-        }
+    while (g_line_count < lines && g_line_count < MAX_LINES && g_laid_out < g_extract_len) {
+        const char* start = g_extract_buf + g_laid_out;
+        const char* end   = g_extract_buf + g_extract_len;
+        const char* p     = start;
+        while (p < end && *p != '\n') p++;
+        if (p == end && !g_article.complete) break;
 
-        // Regular body text
-        wrap_text(g_font, FONT_SIZE, line_start, line_len, max_px, TEXT_COLOR);
+        layout_paragraph(start, (int)(p - start), max_px);
+        g_laid_out = (int)(p - g_extract_buf) + (p < end ? 1 : 0);
     }
 }
 
+static int visible_lines() {
+    return (g_win_h - TOOLBAR_H - 1) / g_line_h;
+}
+
+// Scroll to line `y`, laying out as far as that takes, within the lines
+// there are
+static void scroll_to(int y) {
+    int visible = visible_lines();
+    layout_until(y + visible);
+    int max_sc = g_line_count - visible;
+    if (max_sc < 0) max_sc = 0;
+    if (y > max_sc) y = max_sc;
+    if (y < 0) y = 0;
+    g_scroll_y = y;
+}
+
 // ============================================================================
 // Network search (blocking)
 // ============================================================================
 
-static void do_search(const char* query) {
-    // Lazy TLS/DNS init
-    if (!g_tls_ready) {
-        g_server_ip = montauk::resolve(WIKI_HOST);
-        if (g_server_ip == 0) {
-            snprintf(g_status, sizeof(g_status),
-                     "Error: could not resolve en.wikipedia.org");
-            g_phase = AppPhase::ERR; return;
-        }
-        g_tas = tls::load_trust_anchors();
-        if (g_tas.count == 0) {
-            snprintf(g_status, sizeof(g_status), "Error: no CA certificates loaded");
-            g_phase = AppPhase::ERR; return;
+static WsWindow*     g_win            = nullptr;
+static bool          g_search_pending = false;
+static bool          g_history_pending = false;
+static bool          g_quit           = false;
+static uint64_t      g_last_paint     = 0;
+static bool          g_first_painted  = false;
+
+static bool handle_event(const Montauk::WinEvent& ev);
+static void paint();
+
+// Called as the response streams in: decode it, show the first screen
+// the moment it can be filled, then keep the view current a few times a
+// second. Events are handled meanwhile, so the article can be scrolled,
+// and closing the window or starting another search drops the transfer.
+static bool on_article_data(void*, const char*, int len) {
+    article_feed(len);
+
+    bool dirty = false;
+    Montauk::WinEvent ev;
+    int r;
+    while ((r = g_win->poll(&ev)) > 0) {
+        if (!handle_event(ev)) {
+            g_quit = true;
+            return false;
         }
-        g_tls_ready = true;
+        dirty = true;
     }
+    if (r < 0) {
+        g_quit = true;
+        return false;
+    }
+    if (g_search_pending) return false;
+
+    int before = g_line_count;
+    layout_until(g_scroll_y + visible_lines());
+    uint64_t now = montauk::get_milliseconds();
+    bool first = !g_first_painted && (g_line_count >= visible_lines() || g_article.complete);
+    if (first || dirty || (g_line_count != before && now - g_last_paint >= 100)) {
+        paint();
+        g_first_painted = g_first_painted || g_line_count > 0;
+        g_last_paint = now;
+    }
+    return true;
+}
 
+static int wiki_fetch(const char* path, char* respBuf, int respMax) {
+    return g_cache.fetch(g_https, WIKI_HOST, g_server_ip, 443, path,
+                         "User-Agent: MontaukOS/1.0 wikipedia\r\n"
+                         "Accept: application/json\r\n",
+                         CACHE_TTL, respBuf, respMax, on_article_data, nullptr);
+}
+
+// Going back or forward shows the stored copy whatever its age, like a
+// browser's history; a new search only uses it while it is fresh.
+static void do_search(const char* query, bool from_history = false) {
     static char encoded[1024];
     url_encode_title(query, encoded, sizeof(encoded));
 
@@ -380,38 +520,79 @@ static void do_search(const char* query) {
         "/w/api.php?action=query&format=json&formatversion=2"
         "&prop=extracts&explaintext=1&titles=%s", encoded);
 
-    int respLen = wiki_fetch(path, g_resp_buf, RESP_MAX);
+    article_reset();
+    reset_layout();
+    g_first_painted = false;
+    g_last_paint = montauk::get_milliseconds();
+
+    int respLen = g_cache.lookup(WIKI_HOST, path, g_resp_buf, RESP_MAX, from_history);
+    if (respLen >= 0) {
+        article_feed(respLen);
+    } else {
+        // Lazy TLS/DNS init
+        if (!g_tls_ready) {
+            g_server_ip = montauk::resolve(WIKI_HOST);
+            if (g_server_ip == 0) {
+                snprintf(g_status, sizeof(g_status),
+                         "Error: could not resolve en.wikipedia.org");
+                g_phase = AppPhase::ERR; return;
+            }
+            g_tas = tls::load_trust_anchors();
+            if (g_tas.count == 0) {
+                snprintf(g_status, sizeof(g_status), "Error: no CA certificates loaded");
+                g_phase = AppPhase::ERR; return;
+            }
+            g_https.init(g_tas);
+            g_tls_ready = true;
+        }
+        respLen = wiki_fetch(path, g_resp_buf, RESP_MAX);
+        // Dropped for the window closing or another search
+        if (g_quit || g_search_pending) return;
+    }
     if (respLen <= 0) {
         snprintf(g_status, sizeof(g_status), "Error: no response from Wikipedia");
         g_phase = AppPhase::ERR; return;
     }
     g_resp_buf[respLen] = '\0';
 
-    int headerEnd = find_header_end(g_resp_buf, respLen);
-    if (headerEnd < 0) {
+    if (g_article.body < 0) {
         snprintf(g_status, sizeof(g_status), "Error: malformed HTTP response");
         g_phase = AppPhase::ERR; return;
     }
 
-    int status      = parse_status_code(g_resp_buf, headerEnd);
-    const char* body = g_resp_buf + headerEnd;
-    int bodyLen     = respLen - headerEnd;
-
-    if (status == 404) {
+    if (g_article.status == 404) {
         snprintf(g_status, sizeof(g_status), "Article not found: %s", query);
         g_phase = AppPhase::ERR; return;
     }
 
-    extract_json_string(body, bodyLen, "title", g_title, sizeof(g_title));
-    g_extract_len = extract_json_string(body, bodyLen, "extract",
-                                        g_extract_buf, RESP_MAX - 1);
     if (g_extract_len == 0) {
         snprintf(g_status, sizeof(g_status), "No content found for: %s", query);
         g_phase = AppPhase::ERR; return;
     }
 
-    build_display_lines(g_title, g_extract_buf, g_extract_len);
+    // A response cut short still shows what arrived
+    g_article.complete = true;
     g_phase = AppPhase::DONE;
+
+    if (!from_history) {
+        // A new article drops whatever was ahead of the current one
+        if (g_hist_pos + 1 >= HISTORY_MAX) {
+            montauk::memmove(g_history[0], g_history[1], (HISTORY_MAX - 1) * sizeof(g_history[0]));
+            g_hist_pos--;
+        }
+        g_hist_pos++;
+        montauk::strncpy(g_history[g_hist_pos], query, sizeof(g_history[0]));
+        g_hist_count = g_hist_pos + 1;
+    }
+}
+
+// Step through the history by delta (-1 back, +1 forward)
+static bool history_go(int delta) {
+    int pos = g_hist_pos + delta;
+    if (pos < 0 || pos >= g_hist_count) return false;
+    g_hist_pos = pos;
+    montauk::strncpy(g_query, g_history[pos], sizeof(g_query));
+    return true;
 }
 
 // ============================================================================
@@ -469,15 +650,19 @@ static void render(Canvas& canvas) {
         draw_text(canvas, g_font, TEXT_PAD, cy + 16,
                   "Type a topic and press Enter or click Search.",
                   HINT_COLOR, FONT_SIZE);
-    } else if (g_phase == AppPhase::LOADING) {
-        draw_text(canvas, g_font, TEXT_PAD, cy + 16,
-                  "Searching Wikipedia...", HINT_COLOR, FONT_SIZE);
     } else if (g_phase == AppPhase::ERR) {
         draw_text(canvas, g_font, TEXT_PAD, cy + 16, g_status, CLOSE_BTN, FONT_SIZE);
-    } else if (g_phase == AppPhase::DONE && g_line_count > 0) {
+    } else {
         int visible = ch / g_line_h;  // approximate using body line height
         int y       = cy + 8;
 
+        layout_until(g_scroll_y + visible);
+        if (g_line_count == 0) {
+            draw_text(canvas, g_font, TEXT_PAD, cy + 16,
+                      "Searching Wikipedia...", HINT_COLOR, FONT_SIZE);
+            return;
+        }
+
         for (int i = g_scroll_y; i < g_line_count && y < g_win_h; i++) {
             WikiLine& l  = g_lines[i];
             int lh = g_font->get_line_height(l.font_size) + 4;
@@ -489,12 +674,18 @@ static void render(Canvas& canvas) {
             y += lh;
         }
 
-        // Scrollbar
-        if (g_line_count > visible) {
+        // Scrollbar, sized by guess from the text laid out so far until
+        // all of it is
+        int total = g_line_count;
+        if (!layout_done() && g_laid_out > 0) {
+            total = (int)((int64_t)g_line_count * g_extract_len / g_laid_out);
+            if (total < g_line_count) total = g_line_count;
+        }
+        if (total > visible) {
             int sbx = g_win_w - SCROLLBAR_W;
             canvas.fill_rect(sbx, cy, SCROLLBAR_W, ch, SCROLLBAR_BG);
-            int max_sc  = g_line_count - visible;
-            int thumb_h = (visible * ch) / g_line_count;
+            int max_sc  = total - visible;
+            int thumb_h = (visible * ch) / total;
             if (thumb_h < 20) thumb_h = 20;
             int thumb_y = cy + (g_scroll_y * (ch - thumb_h)) / (max_sc > 0 ? max_sc : 1);
             canvas.fill_rect(sbx + 2, thumb_y, SCROLLBAR_W - 4, thumb_h, SCROLLBAR_FG);
@@ -502,6 +693,83 @@ static void render(Canvas& canvas) {
     }
 }
 
+static void paint() {
+    Canvas canvas = g_win->canvas();
+    render(canvas);
+    g_win->present();
+}
+
+// ============================================================================
+// Event handling
+// ============================================================================
+
+// Also called while an article streams in. False once the window closes.
+static bool handle_event(const Montauk::WinEvent& ev) {
+    if (ev.type == 3) return false;  // close
+
+    bool article = g_phase == AppPhase::DONE || g_phase == AppPhase::LOADING;
+
+    if (ev.type == 4) {
+        apply_scale(g_win->scale_factor);
+        if (article) reset_layout();
+    }
+
+    if (ev.type == 2) {
+        if (g_win->width > 0 && g_win->height > 0) {
+            g_win_w = g_win->width;
+            g_win_h = g_win->height;
+            if (article) reset_layout();
+        }
+
+    } else if (ev.type == 0 && ev.key.pressed) {
+        uint8_t ascii = ev.key.ascii;
+        uint8_t scan  = ev.key.scancode;
+
+        if (ev.key.alt && (scan == 0x4B || scan == 0x4D)) {
+            g_history_pending = g_phase != AppPhase::LOADING &&
+                                history_go(scan == 0x4B ? -1 : 1);
+        } else if (ascii == '\n' || ascii == '\r') {
+            g_search_pending = g_query[0] != '\0';
+        } else if (ascii == '\b' || scan == 0x0E) {
+            int len = (int)strlen(g_query);
+            if (len > 0) g_query[len - 1] = '\0';
+        } else if (ascii >= 32 && ascii < 127) {
+            int len = (int)strlen(g_query);
+            if (len < 254) { g_query[len] = ascii; g_query[len + 1] = '\0'; }
+        } else if (article && g_line_count > 0) {
+            // Navigation keys
+            int visible = visible_lines();
+            if      (scan == 0x48) scroll_to(g_scroll_y - 1);
+            else if (scan == 0x50) scroll_to(g_scroll_y + 1);
+            else if (scan == 0x49) scroll_to(g_scroll_y - visible);
+            else if (scan == 0x51) scroll_to(g_scroll_y + visible);
+            else if (scan == 0x47) scroll_to(0);
+            else if (scan == 0x4F) scroll_to(MAX_LINES);
+        }
+
+    } else if (ev.type == 1) {
+        // Mouse
+        int mx = ev.mouse.x, my = ev.mouse.y;
+        bool just_clicked = (ev.mouse.buttons & 1) && !(ev.mouse.prev_buttons & 1);
+
+        // Search button hit-test
+        int sb_h  = TOOLBAR_H - 16;
+        int btn_w = 80;
+        int sb_w  = g_win_w - 8 - 8 - btn_w - 8;
+        if (sb_w < 80) sb_w = 80;
+        int btn_x = 8 + sb_w + 8;
+        if (just_clicked && mx >= btn_x && mx < btn_x + btn_w &&
+            my >= 8 && my < 8 + sb_h) {
+            g_search_pending = g_query[0] != '\0';
+        }
+
+        // Scroll wheel
+        if (ev.mouse.scroll != 0 && article && g_line_count > 0)
+            scroll_to(g_scroll_y + ev.mouse.scroll * 3);
+    }
+    return true;
+}
+
 // ============================================================================
 // Entry point
 // ============================================================================
@@ -513,17 +781,12 @@ extern "C" void _start() {
     g_extract_buf = (char*)malloc(RESP_MAX + 1);
     if (!g_lines || !g_resp_buf || !g_extract_buf) montauk::exit(1);
 
+    g_cache.init("wikipedia", CACHE_BYTES);
+
     // Load fonts
-    auto load_font = [](const char* path) -> TrueTypeFont* {
-        TrueTypeFont* f = (TrueTypeFont*)montauk::malloc(sizeof(TrueTypeFont));
-        if (!f) return nullptr;
-        montauk::memset(f, 0, sizeof(TrueTypeFont));
-        if (!f->init(path)) { montauk::mfree(f); return nullptr; }
-        return f;
-    };
-    g_font       = load_font("0:/fonts/Roboto-Medium.ttf");
-    g_font_bold  = load_font("0:/fonts/Roboto-Bold.ttf");
-    g_font_serif = load_font("0:/fonts/NotoSerif-SemiBold.ttf");
+    g_font       = fonts::open("0:/fonts/Roboto-Medium.ttf");
+    g_font_bold  = fonts::open("0:/fonts/Roboto-Bold.ttf");
+    g_font_serif = fonts::open("0:/fonts/NotoSerif-SemiBold.ttf");
     if (!g_font) montauk::exit(1);
 
     g_line_h = g_font->get_line_height(FONT_SIZE) + 4;
@@ -533,14 +796,11 @@ extern "C" void _start() {
     WsWindow win;
     if (!win.create("Wikipedia", INIT_W, INIT_H))
         montauk::exit(1);
+    g_win = &win;
 
-    Canvas canvas = win.canvas();
-    render(canvas);
-    win.present();
+    paint();
 
-    bool search_pending = false;
-
-    while (true) {
+    while (!g_quit) {
         Montauk::WinEvent ev;
         int r = win.poll(&ev);
 
@@ -549,97 +809,24 @@ extern "C" void _start() {
         if (r == 0) {
             // No event — idle at ~60 fps
             montauk::sleep_ms(16);
-            canvas = win.canvas();
-            render(canvas);
-            win.present();
+            paint();
             continue;
         }
 
-        // ---- Handle event ----
-        if (ev.type == 3) break;  // close
-
-        if (ev.type == 4) {
-            apply_scale(win.scale_factor);
-            if (g_phase == AppPhase::DONE && g_line_count > 0) {
-                build_display_lines(g_title, g_extract_buf, g_extract_len);
-            }
-        }
-
-        if (ev.type == 2) {
-            if (win.width > 0 && win.height > 0) {
-                g_win_w = win.width;
-                g_win_h = win.height;
-                canvas = win.canvas();
-                if (g_phase == AppPhase::DONE && g_line_count > 0) {
-                    build_display_lines(g_title, g_extract_buf, g_extract_len);
-                }
-            }
-
-        } else if (ev.type == 0 && ev.key.pressed) {
-            uint8_t ascii = ev.key.ascii;
-            uint8_t scan  = ev.key.scancode;
-
-            if (ascii == '\n' || ascii == '\r') {
-                search_pending = true;
-            } else if (ascii == '\b' || scan == 0x0E) {
-                int len = (int)strlen(g_query);
-                if (len > 0) g_query[len - 1] = '\0';
-            } else if (ascii >= 32 && ascii < 127) {
-                int len = (int)strlen(g_query);
-                if (len < 254) { g_query[len] = ascii; g_query[len + 1] = '\0'; }
-            } else if (g_phase == AppPhase::DONE) {
-                // Navigation keys
-                int visible = (g_win_h - TOOLBAR_H - 1) / g_line_h;
-                int max_sc  = g_line_count - visible;
-                if (max_sc < 0) max_sc = 0;
-                if      (scan == 0x48) { if (g_scroll_y > 0) g_scroll_y--; }
-                else if (scan == 0x50) { if (g_scroll_y < max_sc) g_scroll_y++; }
-                else if (scan == 0x49) { g_scroll_y -= visible; if (g_scroll_y < 0) g_scroll_y = 0; }
-                else if (scan == 0x51) { g_scroll_y += visible; if (g_scroll_y > max_sc) g_scroll_y = max_sc; }
-                else if (scan == 0x47) { g_scroll_y = 0; }
-                else if (scan == 0x4F) { g_scroll_y = max_sc; }
-            }
-
-        } else if (ev.type == 1) {
-            // Mouse
-            int mx = ev.mouse.x, my = ev.mouse.y;
-            bool just_clicked = (ev.mouse.buttons & 1) && !(ev.mouse.prev_buttons & 1);
-
-            // Search button hit-test
-            int sb_h  = TOOLBAR_H - 16;
-            int btn_w = 80;
-            int sb_w  = g_win_w - 8 - 8 - btn_w - 8;
-            if (sb_w < 80) sb_w = 80;
-            int btn_x = 8 + sb_w + 8;
-            if (just_clicked && mx >= btn_x && mx < btn_x + btn_w &&
-                my >= 8 && my < 8 + sb_h) {
-                search_pending = true;
-            }
-
-            // Scroll wheel
-            if (ev.mouse.scroll != 0 && g_phase == AppPhase::DONE) {
-                int visible = (g_win_h - TOOLBAR_H - 1) / g_line_h;
-                int max_sc  = g_line_count - visible;
-                if (max_sc < 0) max_sc = 0;
-                g_scroll_y += ev.mouse.scroll * 3;
-                if (g_scroll_y < 0)       g_scroll_y = 0;
-                if (g_scroll_y > max_sc)  g_scroll_y = max_sc;
-            }
-        }
+        if (!handle_event(ev)) break;
 
-        // Trigger search if requested and query is non-empty
-        if (search_pending && g_query[0] != '\0') {
-            search_pending = false;
+        // Searches run until done, handling events as the article comes
+        // in; one started meanwhile takes over from the one it dropped
+        while (!g_quit && (g_search_pending || g_history_pending)) {
+            bool from_history = !g_search_pending;
+            g_search_pending = false;
+            g_history_pending = false;
             g_phase = AppPhase::LOADING;
-            canvas = win.canvas();
-            render(canvas);
-            win.present();
-            do_search(g_query);  // blocking
+            paint();
+            do_search(g_query, from_history);
         }
 
-        canvas = win.canvas();
-        render(canvas);
-        win.present();
+        paint();
     }
 
     win.destroy();
@@ -36,40 +36,34 @@ static void wp_close_dropdowns(WordProcessorState* wp) {
 static int wp_hit_test_text(WordProcessorState* wp, int local_x, int local_y, int edit_y) {
     int click_y = local_y - edit_y + wp->scrollbar.scroll_offset;
 
-    int target_line = wp->wrap_line_count - 1;
-    for (int i = 0; i < wp->wrap_line_count; i++) {
-        if (click_y >= wp->wrap_lines[i].y &&
-            click_y < wp->wrap_lines[i].y + wp->wrap_lines[i].height) {
-            target_line = i;
-            break;
-        }
-    }
+    WrapLine line;
+    if (!wp_wrap_line(wp, wp_wrap_line_at_y(wp, click_y), &line)) return 0;
 
-    WrapLine* wl = &wp->wrap_lines[target_line];
+    WrapLine* wl = &line;
     int click_x = local_x - wl->x;
-    int ri = wl->run_idx;
-    int ro = wl->run_offset;
     int chars_left = wl->char_count;
     int x = 0;
-    int best_abs = wp_wrap_line_start(wp, target_line);
+    int best_abs = wl->start;
 
     if (click_x <= 0) return best_abs;
 
-    while (chars_left > 0 && ri < wp->run_count) {
-        StyledRun* r = &wp->runs[ri];
-        TrueTypeFont* font = wp_get_font(r->font_id, r->flags);
+    while (chars_left > 0) {
+        int ro;
+        const WpPiece* p = wp_piece_at(wp, best_abs, &ro);
+        if (!p) break;
+        int avail = p->len - ro;
+        int to_check = avail < chars_left ? avail : chars_left;
+
+        TrueTypeFont* font = wp_get_font(p->font_id, p->flags);
         if (!font || !font->valid) {
-            ri++;
-            ro = 0;
+            chars_left -= to_check;
+            best_abs += to_check;
             continue;
         }
 
-        GlyphCache* gc = font->get_cache(r->size);
-        int avail = r->len - ro;
-        int to_check = avail < chars_left ? avail : chars_left;
-
+        GlyphCache* gc = font->get_cache(p->size);
         for (int ci = 0; ci < to_check; ci++) {
-            char ch = r->text[ro + ci];
+            char ch = wp->text[p->start + ro + ci];
             CachedGlyph* g = (ch >= 32 || ch < 0) && ch != '\n'
                 ? font->get_glyph(gc, (unsigned char)ch) : nullptr;
             int char_w = g ? g->advance : 0;
@@ -80,11 +74,6 @@ static int wp_hit_test_text(WordProcessorState* wp, int local_x, int local_y, in
         }
 
         chars_left -= to_check;
-        ro += to_check;
-        if (ro >= r->len) {
-            ri++;
-            ro = 0;
-        }
     }
 
     return best_abs;
@@ -124,7 +113,7 @@ void wp_handle_mouse(const Montauk::WinEvent& ev) {
             if (idx >= 0 && idx < WP_SIZE_OPTION_COUNT) {
                 if (wp->has_selection) wp_apply_style_to_selection(wp, 1, WP_SIZE_OPTIONS[idx]);
                 wp->cur_size = (uint8_t)WP_SIZE_OPTIONS[idx];
-                wp->wrap_dirty = true;
+                if (wp->total_text_len == 0) wp->wrap_dirty = true;
                 if (wp->has_selection) wp_history_checkpoint(wp);
             }
         }
@@ -266,7 +255,7 @@ void wp_handle_mouse(const Montauk::WinEvent& ev) {
         wp_close_dropdowns(wp);
 
         int abs = wp_hit_test_text(wp, local_x, local_y, edit_y);
-        wp_pos_to_run(wp, abs, &wp->cursor_run, &wp->cursor_offset);
+        wp->cursor = abs;
         wp->sel_anchor = abs;
         wp->sel_end = abs;
         wp->has_selection = false;
@@ -277,7 +266,7 @@ void wp_handle_mouse(const Montauk::WinEvent& ev) {
     if (wp->mouse_selecting && wp_left_held(ev.mouse.buttons) && local_y >= edit_y - 20) {
         int abs = wp_hit_test_text(wp, local_x, local_y, edit_y);
         wp->sel_end = abs;
-        wp_pos_to_run(wp, abs, &wp->cursor_run, &wp->cursor_offset);
+        wp->cursor = abs;
         wp->has_selection = (wp->sel_anchor != wp->sel_end);
         return;
     }
@@ -478,7 +467,7 @@ void wp_handle_key(const Montauk::KeyEvent& key) {
         else if (wp->has_selection) {
             int s, e;
             wp_sel_range(wp, &s, &e);
-            wp_pos_to_run(wp, s, &wp->cursor_run, &wp->cursor_offset);
+            wp->cursor = s;
             wp_clear_selection(wp);
             return;
         }
@@ -491,7 +480,7 @@ void wp_handle_key(const Montauk::KeyEvent& key) {
         else if (wp->has_selection) {
             int s, e;
             wp_sel_range(wp, &s, &e);
-            wp_pos_to_run(wp, e, &wp->cursor_run, &wp->cursor_offset);
+            wp->cursor = e;
             wp_clear_selection(wp);
             return;
         }
@@ -503,25 +492,27 @@ void wp_handle_key(const Montauk::KeyEvent& key) {
     if (key.scancode == 0x47) {
         if (key.shift) wp_start_selection(wp);
         else wp_clear_selection(wp);
-        int abs = wp_abs_pos(wp, wp->cursor_run, wp->cursor_offset);
+        int abs = wp->cursor;
         int line = wp_find_wrap_line(wp, abs);
         int start = wp_wrap_line_start(wp, line);
-        wp_pos_to_run(wp, start, &wp->cursor_run, &wp->cursor_offset);
+        wp->cursor = start;
         if (key.shift) wp_update_selection_to_cursor(wp);
         return;
     }
     if (key.scancode == 0x4F) {
         if (key.shift) wp_start_selection(wp);
         else wp_clear_selection(wp);
-        int abs = wp_abs_pos(wp, wp->cursor_run, wp->cursor_offset);
+        int abs = wp->cursor;
         int line = wp_find_wrap_line(wp, abs);
-        int start = wp_wrap_line_start(wp, line);
-        int end = start + wp->wrap_lines[line].char_count;
+        WrapLine wl;
+        if (!wp_wrap_line(wp, line, &wl)) return;
+        int start = wl.start;
+        int end = start + wl.char_count;
         if (end > start) {
             char ch = wp_char_at(wp, end - 1);
             if (ch == '\n') end--;
         }
-        wp_pos_to_run(wp, end, &wp->cursor_run, &wp->cursor_offset);
+        wp->cursor = end;
         if (key.shift) wp_update_selection_to_cursor(wp);
         return;
     }
@@ -530,7 +521,7 @@ void wp_handle_key(const Montauk::KeyEvent& key) {
         wp->sel_anchor = 0;
         wp->sel_end = wp->total_text_len;
         wp->has_selection = (wp->total_text_len > 0);
-        wp_pos_to_run(wp, wp->total_text_len, &wp->cursor_run, &wp->cursor_offset);
+        wp->cursor = wp->total_text_len;
         return;
     }
 
@@ -0,0 +1,570 @@
+/*
+ * layout.cpp
+ * Paragraph layout cache and wrap-line queries
+ * Copyright (c) 2026 Daniel Hammer
+ */
+
+#include "wordprocessor.hpp"
+
+// Each paragraph is wrapped on its own, with line positions and y relative
+// to the paragraph, and kept until an edit touches it or the wrap width
+// changes. Two Fenwick trees over the paragraphs, of heights and of line
+// counts, turn a y coordinate or a line number into a paragraph in
+// O(log n), so typing costs one paragraph's layout however long the
+// document is.
+
+static void wp_font_at(WordProcessorState* wp, int abs_pos,
+                       TrueTypeFont** out_font, GlyphCache** out_gc) {
+    int offset;
+    const WpPiece* piece = wp_piece_at(wp, abs_pos, &offset);
+    if (!piece) {
+        *out_font = wp_get_font(wp->cur_font_id, wp->cur_flags);
+        *out_gc = (*out_font && (*out_font)->valid) ? (*out_font)->get_cache(wp->cur_size) : nullptr;
+        return;
+    }
+
+    *out_font = wp_get_font(piece->font_id, piece->flags);
+    *out_gc = (*out_font && (*out_font)->valid) ? (*out_font)->get_cache(piece->size) : nullptr;
+}
+
+static void wp_default_line_metrics(WordProcessorState* wp, int abs_pos, int* out_height, int* out_ascent) {
+    TrueTypeFont* font = nullptr;
+    GlyphCache* gc = nullptr;
+    if (wp->total_text_len > 0) {
+        int pos = abs_pos;
+        if (pos >= wp->total_text_len) pos = wp->total_text_len - 1;
+        if (pos < 0) pos = 0;
+        wp_font_at(wp, pos, &font, &gc);
+    } else {
+        font = wp_get_font(wp->cur_font_id, wp->cur_flags);
+        gc = (font && font->valid) ? font->get_cache(wp->cur_size) : nullptr;
+    }
+
+    if (gc) {
+        *out_height = gc->line_height;
+        *out_ascent = gc->ascent;
+    } else {
+        *out_height = WP_DEFAULT_SIZE;
+        *out_ascent = WP_DEFAULT_SIZE;
+    }
+}
+
+static int wp_char_advance_at(WordProcessorState* wp, int abs_pos, char ch) {
+    if (ch == '\n') return 0;
+    if (!(ch >= 32 || ch < 0)) return 0;
+
+    TrueTypeFont* font = nullptr;
+    GlyphCache* gc = nullptr;
+    wp_font_at(wp, abs_pos, &font, &gc);
+    if (!font || !gc) return 8;
+
+    CachedGlyph* g = font->get_glyph(gc, (unsigned char)ch);
+    return g ? g->advance : 8;
+}
+
+static void wp_measure_line_range(WordProcessorState* wp, int start, int count,
+                                  int* out_width, int* out_height, int* out_ascent) {
+    int width = 0;
+    int height = 0;
+    int ascent = 0;
+
+    for (int i = 0; i < count; i++) {
+        char ch = wp_char_at(wp, start + i);
+        if (ch != '\n')
+            width += wp_char_advance_at(wp, start + i, ch);
+
+        TrueTypeFont* font = nullptr;
+        GlyphCache* gc = nullptr;
+        wp_font_at(wp, start + i, &font, &gc);
+        if (gc) {
+            if (gc->line_height > height) height = gc->line_height;
+            if (gc->ascent > ascent) ascent = gc->ascent;
+        }
+    }
+
+    if (height == 0)
+        wp_default_line_metrics(wp, start, &height, &ascent);
+
+    *out_width = width;
+    *out_height = height;
+    *out_ascent = ascent;
+}
+
+static int wp_line_spacing_advance(int height, int spacing_percent) {
+    int advance = (height * spacing_percent + 99) / 100;
+    return advance < height ? height : advance;
+}
+
+static int wp_effective_text_indent(const ParagraphStyle* para, bool first_line) {
+    int indent = para->left_indent;
+    if (indent < 0) indent = 0;
+    if (first_line && para->list_type == PARA_LIST_NONE)
+        indent += para->first_line_indent;
+    if (indent < 0) indent = 0;
+    return indent;
+}
+
+// ============================================================================
+// Paragraph layout
+// ============================================================================
+
+static bool wp_ensure_line_capacity(WpParaLayout* layout, int needed) {
+    if (needed <= layout->line_cap) return true;
+
+    int new_cap = layout->line_cap > 0 ? layout->line_cap * 2 : 4;
+    while (new_cap < needed) new_cap *= 2;
+    void* mem = layout->lines
+        ? montauk::realloc(layout->lines, (uint64_t)new_cap * sizeof(WrapLine))
+        : montauk::malloc((uint64_t)new_cap * sizeof(WrapLine));
+    if (!mem) return false;
+
+    layout->lines = (WrapLine*)mem;
+    layout->line_cap = new_cap;
+    return true;
+}
+
+static WrapLine* wp_add_line(WpParaLayout* layout) {
+    if (!wp_ensure_line_capacity(layout, layout->line_count + 1)) return nullptr;
+    WrapLine* line = &layout->lines[layout->line_count++];
+    montauk::memset(line, 0, sizeof(*line));
+    return line;
+}
+
+static int wp_aligned_x(const ParagraphStyle* para, int text_indent, int wrap_width, int line_width) {
+    int extra = wrap_width - text_indent - line_width;
+    if (extra < 0) extra = 0;
+    int x = WP_MARGIN + text_indent;
+    if (para->align == PARA_ALIGN_CENTER) x += extra / 2;
+    else if (para->align == PARA_ALIGN_RIGHT) x += extra;
+    return x;
+}
+
+static void wp_layout_paragraph(WordProcessorState* wp, int para_idx, int wrap_width, WpParaLayout* layout) {
+    const ParagraphStyle* para = wp_paragraph_style(wp, para_idx);
+    int para_start = wp_paragraph_start(wp, para_idx);
+    bool has_newline = para_idx < wp_paragraph_count(wp) - 1;
+    int para_content_end = has_newline ? wp_paragraph_start(wp, para_idx + 1) - 1 : wp->total_text_len;
+
+    layout->line_count = 0;
+    int y = para->space_before;
+
+    bool first_line = true;
+    int line_start = para_start;
+    while (line_start < para_content_end) {
+        int text_indent = wp_effective_text_indent(para, first_line);
+        int avail_width = wrap_width - text_indent;
+        if (avail_width < 40) avail_width = 40;
+
+        int scan = line_start;
+        int width = 0;
+        int last_space = -1;
+        int width_at_last_space = 0;
+
+        while (scan < para_content_end) {
+            char ch = wp_char_at(wp, scan);
+            int cw = wp_char_advance_at(wp, scan, ch);
+            if (width + cw > avail_width && scan > line_start) {
+                if (last_space >= line_start) {
+                    scan = last_space + 1;
+                    width = width_at_last_space;
+                }
+                break;
+            }
+
+            width += cw;
+            if (ch == ' ') {
+                last_space = scan;
+                width_at_last_space = width;
+            }
+            scan++;
+        }
+
+        if (scan == line_start && scan < para_content_end) {
+            width += wp_char_advance_at(wp, scan, wp_char_at(wp, scan));
+            scan++;
+        }
+
+        int char_count = scan - line_start;
+        bool last_visual_line = (scan >= para_content_end);
+        if (last_visual_line && has_newline) char_count++;
+
+        WrapLine* line = wp_add_line(layout);
+        if (!line) break;
+        wp_measure_line_range(wp, line_start, char_count, &line->width, &line->height, &line->baseline);
+        line->start = line_start - para_start;
+        line->char_count = char_count;
+        line->y = y;
+        line->first_in_paragraph = first_line;
+        line->x = wp_aligned_x(para, text_indent, wrap_width, line->width);
+
+        line_start = scan;
+        first_line = false;
+        if (!last_visual_line)
+            y += wp_line_spacing_advance(line->height, para->line_spacing);
+        else
+            y += line->height;
+    }
+
+    if (para_start == para_content_end) {
+        WrapLine* line = wp_add_line(layout);
+        if (line) {
+            line->char_count = has_newline ? 1 : 0;
+            line->y = y;
+            wp_default_line_metrics(wp, para_start, &line->height, &line->baseline);
+            line->first_in_paragraph = true;
+            line->x = wp_aligned_x(para, wp_effective_text_indent(para, true), wrap_width, 0);
+            y += line->height;
+        }
+    }
+
+    layout->height = y + para->space_after;
+    layout->valid = true;
+}
+
+// ============================================================================
+// Fenwick trees over the paragraphs (1-based)
+// ============================================================================
+
+static void wp_tree_add(int* tree, int n, int idx, int delta) {
+    for (int i = idx + 1; i <= n; i += i & -i)
+        tree[i] += delta;
+}
+
+// Sum over paragraphs [0, idx)
+static int wp_tree_prefix(const int* tree, int idx) {
+    int sum = 0;
+    for (int i = idx; i > 0; i -= i & -i)
+        sum += tree[i];
+    return sum;
+}
+
+// The paragraph whose span holds `value`: the largest idx with prefix(idx) <= value
+static int wp_tree_find(const int* tree, int n, int value, int* out_prefix) {
+    int pos = 0;
+    int step = 1;
+    while (step * 2 <= n) step *= 2;
+    int prefix = 0;
+    for (; step > 0; step /= 2) {
+        if (pos + step <= n && prefix + tree[pos + step] <= value) {
+            pos += step;
+            prefix += tree[pos];
+        }
+    }
+    *out_prefix = prefix;
+    return pos;
+}
+
+static void wp_rebuild_trees(WordProcessorState* wp) {
+    int n = wp->layout_count;
+    for (int i = 1; i <= n; i++) {
+        wp->layout_heights[i] = wp->layouts[i - 1].height;
+        wp->layout_lines[i] = wp->layouts[i - 1].line_count;
+    }
+    for (int i = 1; i <= n; i++) {
+        int parent = i + (i & -i);
+        if (parent <= n) {
+            wp->layout_heights[parent] += wp->layout_heights[i];
+            wp->layout_lines[parent] += wp->layout_lines[i];
+        }
+    }
+    wp->layout_trees_stale = false;
+}
+
+// ============================================================================
+// Cache upkeep
+// ============================================================================
+
+static bool wp_ensure_layout_capacity(WordProcessorState* wp, int needed) {
+    if (needed <= wp->layout_cap) return true;
+
+    int new_cap = wp->layout_cap > 0 ? wp->layout_cap : 64;
+    while (new_cap < needed) new_cap *= 2;
+
+    WpParaLayout* layouts = (WpParaLayout*)montauk::malloc((uint64_t)new_cap * sizeof(WpParaLayout));
+    int* heights = (int*)montauk::malloc((uint64_t)(new_cap + 1) * sizeof(int));
+    int* lines = (int*)montauk::malloc((uint64_t)(new_cap + 1) * sizeof(int));
+    if (!layouts || !heights || !lines) {
+        if (layouts) montauk::mfree(layouts);
+        if (heights) montauk::mfree(heights);
+        if (lines) montauk::mfree(lines);
+        return false;
+    }
+
+    if (wp->layouts) {
+        montauk::memcpy(layouts, wp->layouts, (uint64_t)wp->layout_count * sizeof(WpParaLayout));
+        montauk::mfree(wp->layouts);
+    }
+    if (wp->layout_heights) montauk::mfree(wp->layout_heights);
+    if (wp->layout_lines) montauk::mfree(wp->layout_lines);
+    montauk::memset(heights, 0, (uint64_t)(new_cap + 1) * sizeof(int));
+    montauk::memset(lines, 0, (uint64_t)(new_cap + 1) * sizeof(int));
+
+    wp->layouts = layouts;
+    wp->layout_heights = heights;
+    wp->layout_lines = lines;
+    wp->layout_cap = new_cap;
+    wp->layout_trees_stale = true;
+    return true;
+}
+
+static void wp_mark_dirty(WordProcessorState* wp, int first, int end) {
+    if (wp->dirty_first >= wp->dirty_end) {
+        wp->dirty_first = first;
+        wp->dirty_end = end;
+        return;
+    }
+    if (first < wp->dirty_first) wp->dirty_first = first;
+    if (end > wp->dirty_end) wp->dirty_end = end;
+}
+
+// Paragraphs [para, para + old_count) were replaced by new_count others
+void wp_layout_changed(WordProcessorState* wp, int para, int old_count, int new_count) {
+    if (wp->wrap_dirty) return;
+    if (para < 0 || para + old_count > wp->layout_count) {
+        wp->wrap_dirty = true;
+        return;
+    }
+
+    int delta = new_count - old_count;
+    if (delta > 0 && !wp_ensure_layout_capacity(wp, wp->layout_count + delta)) {
+        wp->wrap_dirty = true;
+        return;
+    }
+
+    int tail = wp->layout_count - (para + old_count);
+    if (delta < 0) {
+        for (int i = para + new_count; i < para + old_count; i++) {
+            if (wp->layouts[i].lines) montauk::mfree(wp->layouts[i].lines);
+        }
+    }
+    if (delta != 0) {
+        montauk::memmove(&wp->layouts[para + new_count], &wp->layouts[para + old_count],
+                         (uint64_t)tail * sizeof(WpParaLayout));
+        if (delta > 0)
+            montauk::memset(&wp->layouts[para + old_count], 0, (uint64_t)delta * sizeof(WpParaLayout));
+        wp->layout_count += delta;
+        wp->layout_trees_stale = true;
+    }
+
+    int keep = old_count < new_count ? old_count : new_count;
+    for (int i = para; i < para + keep; i++)
+        wp->layouts[i].valid = false;
+
+    // Shift the pending range past the edit along with the paragraphs
+    if (wp->dirty_first < wp->dirty_end) {
+        if (wp->dirty_first > para + old_count) wp->dirty_first += delta;
+        else if (wp->dirty_first > para + new_count) wp->dirty_first = para + new_count;
+        if (wp->dirty_end > para + old_count) wp->dirty_end += delta;
+        else if (wp->dirty_end > para + new_count) wp->dirty_end = para + new_count;
+    }
+    wp_mark_dirty(wp, para, para + new_count);
+}
+
+void wp_layout_free(WordProcessorState* wp) {
+    for (int i = 0; i < wp->layout_count; i++) {
+        if (wp->layouts[i].lines) montauk::mfree(wp->layouts[i].lines);
+    }
+    if (wp->layouts) montauk::mfree(wp->layouts);
+    if (wp->layout_heights) montauk::mfree(wp->layout_heights);
+    if (wp->layout_lines) montauk::mfree(wp->layout_lines);
+    wp->layouts = nullptr;
+    wp->layout_heights = nullptr;
+    wp->layout_lines = nullptr;
+    wp->layout_count = 0;
+    wp->layout_cap = 0;
+    wp->dirty_first = 0;
+    wp->dirty_end = 0;
+    wp->wrap_dirty = true;
+}
+
+// Lay out whatever edits invalidated, at the last wrap width
+static void wp_layout_update(WordProcessorState* wp) {
+    int para_count = wp_paragraph_count(wp);
+
+    if (wp->wrap_dirty || wp->layout_count != para_count) {
+        if (!wp_ensure_layout_capacity(wp, para_count)) return;
+        for (int i = para_count; i < wp->layout_count; i++) {
+            if (wp->layouts[i].lines) montauk::mfree(wp->layouts[i].lines);
+        }
+        if (para_count > wp->layout_count) {
+            montauk::memset(&wp->layouts[wp->layout_count], 0,
+                            (uint64_t)(para_count - wp->layout_count) * sizeof(WpParaLayout));
+        }
+        wp->layout_count = para_count;
+        for (int i = 0; i < para_count; i++)
+            wp->layouts[i].valid = false;
+        wp->dirty_first = 0;
+        wp->dirty_end = para_count;
+        wp->layout_trees_stale = true;
+        wp->wrap_dirty = false;
+    }
+
+    if (wp->dirty_end > wp->layout_count) wp->dirty_end = wp->layout_count;
+    for (int i = wp->dirty_first; i < wp->dirty_end; i++) {
+        WpParaLayout* layout = &wp->layouts[i];
+        if (layout->valid) continue;
+        int old_height = layout->height;
+        int old_lines = layout->line_count;
+        wp_layout_paragraph(wp, i, wp->last_wrap_width, layout);
+        if (!wp->layout_trees_stale) {
+            wp_tree_add(wp->layout_heights, wp->layout_count, i, layout->height - old_height);
+            wp_tree_add(wp->layout_lines, wp->layout_count, i, layout->line_count - old_lines);
+        }
+    }
+    wp->dirty_first = 0;
+    wp->dirty_end = 0;
+
+    if (wp->layout_trees_stale) wp_rebuild_trees(wp);
+    wp->content_height = WP_MARGIN * 2 + wp_tree_prefix(wp->layout_heights, wp->layout_count);
+}
+
+void wp_recompute_wrap(WordProcessorState* wp, int content_w) {
+    int wrap_width = content_w - WP_MARGIN * 2 - WP_SCROLLBAR_W;
+    if (wrap_width < 50) wrap_width = 50;
+
+    if (wrap_width != wp->last_wrap_width) {
+        wp->wrap_dirty = true;
+        wp->last_wrap_width = wrap_width;
+    }
+
+    wp_layout_update(wp);
+}
+
+// ============================================================================
+// Queries
+// ============================================================================
+
+int wp_wrap_line_count(WordProcessorState* wp) {
+    wp_layout_update(wp);
+    return wp_tree_prefix(wp->layout_lines, wp->layout_count);
+}
+
+// Line line_idx of the document, with its position and y made absolute
+bool wp_wrap_line(WordProcessorState* wp, int line_idx, WrapLine* out) {
+    wp_layout_update(wp);
+    if (line_idx < 0 || wp->layout_count <= 0) return false;
+
+    int first_line;
+    int para = wp_tree_find(wp->layout_lines, wp->layout_count, line_idx, &first_line);
+    if (para >= wp->layout_count) return false;
+
+    const WpParaLayout* layout = &wp->layouts[para];
+    int local = line_idx - first_line;
+    if (local >= layout->line_count) return false;
+
+    *out = layout->lines[local];
+    out->start += wp_paragraph_start(wp, para);
+    out->y += WP_MARGIN + wp_tree_prefix(wp->layout_heights, para);
+    out->paragraph_idx = para;
+    return true;
+}
+
+int wp_find_wrap_line(WordProcessorState* wp, int abs_pos) {
+    wp_layout_update(wp);
+    if (wp->layout_count <= 0) return 0;
+
+    int para = wp_find_paragraph_at(wp, abs_pos);
+    if (para >= wp->layout_count) para = wp->layout_count - 1;
+    const WpParaLayout* layout = &wp->layouts[para];
+    int rel = abs_pos - wp_paragraph_start(wp, para);
+
+    int lo = 0, hi = layout->line_count - 1;
+    if (hi < 0) hi = 0;
+    while (lo < hi) {
+        int mid = (lo + hi + 1) / 2;
+        if (layout->lines[mid].start <= rel) lo = mid;
+        else hi = mid - 1;
+    }
+    return wp_tree_prefix(wp->layout_lines, para) + lo;
+}
+
+// The line at content y, or the nearest one above it
+int wp_wrap_line_at_y(WordProcessorState* wp, int y) {
+    wp_layout_update(wp);
+    if (wp->layout_count <= 0) return 0;
+
+    int rel = y - WP_MARGIN;
+    if (rel < 0) rel = 0;
+    int top;
+    int para = wp_tree_find(wp->layout_heights, wp->layout_count, rel, &top);
+    if (para >= wp->layout_count) {
+        para = wp->layout_count - 1;
+        top = wp_tree_prefix(wp->layout_heights, para);
+    }
+
+    const WpParaLayout* layout = &wp->layouts[para];
+    int local = 0;
+    while (local + 1 < layout->line_count && layout->lines[local + 1].y <= rel - top)
+        local++;
+    return wp_tree_prefix(wp->layout_lines, para) + local;
+}
+
+int wp_wrap_line_start(WordProcessorState* wp, int line_idx) {
+    WrapLine line;
+    return wp_wrap_line(wp, line_idx, &line) ? line.start : 0;
+}
+
+// Number shown on a numbered paragraph: its place in the run of numbered
+// paragraphs it belongs to
+int wp_list_number(WordProcessorState* wp, int para) {
+    if (wp_paragraph_style(wp, para)->list_type != PARA_LIST_NUMBER) return 0;
+    int number = 1;
+    while (para > 0 && wp_paragraph_style(wp, para - 1)->list_type == PARA_LIST_NUMBER) {
+        number++;
+        para--;
+    }
+    return number;
+}
+
+void wp_cursor_up(WordProcessorState* wp) {
+    int abs = wp->cursor;
+    int line = wp_find_wrap_line(wp, abs);
+    if (line <= 0) return;
+
+    WrapLine cur, prev;
+    if (!wp_wrap_line(wp, line, &cur) || !wp_wrap_line(wp, line - 1, &prev)) return;
+    int col = abs - cur.start;
+    int new_col = col < prev.char_count ? col : prev.char_count;
+    if (new_col > 0 && new_col == prev.char_count) {
+        char ch = wp_char_at(wp, prev.start + prev.char_count - 1);
+        if (ch == '\n') new_col = prev.char_count - 1;
+    }
+    wp->cursor = prev.start + new_col;
+}
+
+void wp_cursor_down(WordProcessorState* wp) {
+    int abs = wp->cursor;
+    int line = wp_find_wrap_line(wp, abs);
+    int line_count = wp_wrap_line_count(wp);
+    if (line >= line_count - 1) return;
+
+    WrapLine cur, next;
+    if (!wp_wrap_line(wp, line, &cur) || !wp_wrap_line(wp, line + 1, &next)) return;
+    int col = abs - cur.start;
+    int new_col = col < next.char_count ? col : next.char_count;
+    if (new_col > 0 && new_col == next.char_count && line + 1 < line_count - 1) {
+        char ch = wp_char_at(wp, next.start + next.char_count - 1);
+        if (ch == '\n') new_col = next.char_count - 1;
+    }
+    wp->cursor = next.start + new_col;
+}
+
+void wp_ensure_cursor_visible(WordProcessorState* wp, int view_h) {
+    WrapLine line;
+    if (!wp_wrap_line(wp, wp_find_wrap_line(wp, wp->cursor), &line)) return;
+
+    int cy = line.y;
+    int ch = line.height;
+
+    if (cy < wp->scrollbar.scroll_offset) {
+        wp->scrollbar.scroll_offset = cy - WP_MARGIN;
+        if (wp->scrollbar.scroll_offset < 0) wp->scrollbar.scroll_offset = 0;
+    }
+    if (cy + ch > wp->scrollbar.scroll_offset + view_h) {
+        wp->scrollbar.scroll_offset = cy + ch - view_h + WP_MARGIN;
+    }
+
+    int ms = wp->scrollbar.max_scroll();
+    if (wp->scrollbar.scroll_offset > ms) wp->scrollbar.scroll_offset = ms;
+    if (wp->scrollbar.scroll_offset < 0) wp->scrollbar.scroll_offset = 0;
+}
@@ -0,0 +1,600 @@
+/*
+ * pieces.cpp
+ * Piece table document storage and edit history
+ * Copyright (c) 2026 Daniel Hammer
+ */
+
+#include "wordprocessor.hpp"
+
+// Text is only ever appended to wp->text; the document is the sequence of
+// pieces that point into it. Every change replaces the pieces covering a
+// range with new ones, so editing anywhere costs O(log n) in the tree and
+// nothing in the text. The replaced and inserted pieces are what undo
+// keeps: undoing an edit puts the old pieces back.
+
+bool wp_same_char_style(const WpPiece* a, const WpPiece* b) {
+    return a->font_id == b->font_id && a->size == b->size && a->flags == b->flags;
+}
+
+static uint32_t wp_next_prio(WordProcessorState* wp) {
+    uint32_t x = wp->prio_seed ? wp->prio_seed : 0x9E3779B9u;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    wp->prio_seed = x;
+    return x;
+}
+
+// Make room for `count` more nodes, so that no allocation can fail partway
+// through changing the tree
+static bool wp_reserve_nodes(WordProcessorState* wp, int count) {
+    if (wp->node_top < 1) wp->node_top = 1;
+
+    int free_count = 0;
+    for (int n = wp->node_free; n && free_count < count; n = wp->nodes[n].left)
+        free_count++;
+    int needed = wp->node_top + count - free_count;
+    if (needed <= wp->node_cap) return true;
+
+    int new_cap = wp->node_cap > 0 ? wp->node_cap : 256;
+    while (new_cap < needed) new_cap *= 2;
+    void* mem = wp->nodes
+        ? montauk::realloc(wp->nodes, (uint64_t)new_cap * sizeof(WpNode))
+        : montauk::malloc((uint64_t)new_cap * sizeof(WpNode));
+    if (!mem) return false;
+    wp->nodes = (WpNode*)mem;
+    wp->node_cap = new_cap;
+    return true;
+}
+
+static int wp_node_alloc(WordProcessorState* wp, const WpPiece* piece) {
+    int n = wp->node_free;
+    if (n) wp->node_free = wp->nodes[n].left;
+    else n = wp->node_top++;
+
+    WpNode* node = &wp->nodes[n];
+    node->piece = *piece;
+    node->left = 0;
+    node->right = 0;
+    node->prio = wp_next_prio(wp);
+    node->sum_len = piece->len;
+    node->sum_breaks = piece->is_break ? 1 : 0;
+    return n;
+}
+
+static void wp_node_release(WordProcessorState* wp, int n) {
+    wp->nodes[n].left = wp->node_free;
+    wp->node_free = n;
+}
+
+static void wp_pull(WordProcessorState* wp, int n) {
+    WpNode* node = &wp->nodes[n];
+    node->sum_len = node->piece.len;
+    node->sum_breaks = node->piece.is_break ? 1 : 0;
+    if (node->left) {
+        node->sum_len += wp->nodes[node->left].sum_len;
+        node->sum_breaks += wp->nodes[node->left].sum_breaks;
+    }
+    if (node->right) {
+        node->sum_len += wp->nodes[node->right].sum_len;
+        node->sum_breaks += wp->nodes[node->right].sum_breaks;
+    }
+}
+
+static int wp_merge(WordProcessorState* wp, int a, int b) {
+    if (!a) return b;
+    if (!b) return a;
+    if (wp->nodes[a].prio > wp->nodes[b].prio) {
+        int r = wp_merge(wp, wp->nodes[a].right, b);
+        wp->nodes[a].right = r;
+        wp_pull(wp, a);
+        return a;
+    }
+    int l = wp_merge(wp, a, wp->nodes[b].left);
+    wp->nodes[b].left = l;
+    wp_pull(wp, b);
+    return b;
+}
+
+// Split t into its first `pos` characters and the rest, cutting the piece
+// that straddles pos in two (one node must be reserved for that)
+static void wp_split(WordProcessorState* wp, int t, int pos, int* out_a, int* out_b) {
+    if (!t) {
+        *out_a = 0;
+        *out_b = 0;
+        return;
+    }
+
+    int left = wp->nodes[t].left;
+    int left_len = left ? wp->nodes[left].sum_len : 0;
+    int len = wp->nodes[t].piece.len;
+
+    if (pos <= left_len) {
+        int a, b;
+        wp_split(wp, left, pos, &a, &b);
+        wp->nodes[t].left = b;
+        wp_pull(wp, t);
+        *out_a = a;
+        *out_b = t;
+        return;
+    }
+    if (pos >= left_len + len) {
+        int a, b;
+        wp_split(wp, wp->nodes[t].right, pos - left_len - len, &a, &b);
+        wp->nodes[t].right = a;
+        wp_pull(wp, t);
+        *out_a = t;
+        *out_b = b;
+        return;
+    }
+
+    int cut = pos - left_len;
+    WpPiece tail = wp->nodes[t].piece;
+    tail.start += cut;
+    tail.len -= cut;
+    int m = wp_node_alloc(wp, &tail);
+
+    int right = wp->nodes[t].right;
+    wp->nodes[t].piece.len = cut;
+    wp->nodes[t].right = 0;
+    wp_pull(wp, t);
+    *out_a = t;
+    *out_b = wp_merge(wp, m, right);
+}
+
+static int wp_count_nodes(WordProcessorState* wp, int t) {
+    if (!t) return 0;
+    return 1 + wp_count_nodes(wp, wp->nodes[t].left) + wp_count_nodes(wp, wp->nodes[t].right);
+}
+
+// Release the subtree, copying its pieces in order to out (if not null)
+static void wp_release_tree(WordProcessorState* wp, int t, WpPiece* out, int* count) {
+    if (!t) return;
+    int left = wp->nodes[t].left;
+    int right = wp->nodes[t].right;
+    wp_release_tree(wp, left, out, count);
+    if (out) out[(*count)++] = wp->nodes[t].piece;
+    wp_node_release(wp, t);
+    wp_release_tree(wp, right, out, count);
+}
+
+static void wp_update_totals(WordProcessorState* wp) {
+    int len = wp->root ? wp->nodes[wp->root].sum_len : 0;
+    wp->total_text_len = len > 0 ? len - 1 : 0;
+    wp->lookup_node = 0;
+}
+
+// Node holding abs_pos, and where its piece starts; 0 past the end
+static int wp_find_node(WordProcessorState* wp, int abs_pos, int* out_start) {
+    if (wp->lookup_node) {
+        int n = wp->lookup_node;
+        if (abs_pos >= wp->lookup_start && abs_pos < wp->lookup_start + wp->nodes[n].piece.len) {
+            *out_start = wp->lookup_start;
+            return n;
+        }
+    }
+
+    int n = wp->root;
+    int base = 0;
+    while (n) {
+        WpNode* node = &wp->nodes[n];
+        int left_len = node->left ? wp->nodes[node->left].sum_len : 0;
+        if (abs_pos < base + left_len) {
+            n = node->left;
+            continue;
+        }
+        int at = base + left_len;
+        if (abs_pos < at + node->piece.len) {
+            wp->lookup_node = n;
+            wp->lookup_start = at;
+            *out_start = at;
+            return n;
+        }
+        base = at + node->piece.len;
+        n = node->right;
+    }
+    return 0;
+}
+
+// Node of the break that ends paragraph `para`, and its position
+static int wp_find_break(WordProcessorState* wp, int para, int* out_pos) {
+    int n = wp->root;
+    int base = 0;
+    while (n) {
+        WpNode* node = &wp->nodes[n];
+        int left_breaks = node->left ? wp->nodes[node->left].sum_breaks : 0;
+        int left_len = node->left ? wp->nodes[node->left].sum_len : 0;
+        if (para < left_breaks) {
+            n = node->left;
+            continue;
+        }
+        int at = base + left_len;
+        para -= left_breaks;
+        if (node->piece.is_break) {
+            if (para == 0) {
+                *out_pos = at;
+                return n;
+            }
+            para--;
+        }
+        base = at + node->piece.len;
+        n = node->right;
+    }
+    return 0;
+}
+
+static void wp_current_caret(WordProcessorState* wp, WpCaret* caret) {
+    caret->cursor = wp->cursor;
+    caret->sel_anchor = wp->sel_anchor;
+    caret->sel_end = wp->sel_end;
+    caret->has_selection = wp->has_selection;
+}
+
+static void wp_free_edit(WpEdit* e) {
+    if (e->removed) montauk::mfree(e->removed);
+    if (e->inserted) montauk::mfree(e->inserted);
+}
+
+static void wp_free_step(WpUndoStep* step) {
+    for (int i = 0; i < step->edit_count; i++)
+        wp_free_edit(&step->edits[i]);
+    if (step->edits) montauk::mfree(step->edits);
+    montauk::memset(step, 0, sizeof(*step));
+}
+
+// Add an edit to the pending step; takes ownership of `removed`
+static void wp_record(WordProcessorState* wp, int pos, WpPiece* removed, int removed_count,
+                      const WpPiece* inserted, int inserted_count) {
+    WpUndoStep* step = &wp->pending;
+    if (step->edit_count == step->edit_cap) {
+        int new_cap = step->edit_cap > 0 ? step->edit_cap * 2 : 8;
+        void* mem = step->edits
+            ? montauk::realloc(step->edits, (uint64_t)new_cap * sizeof(WpEdit))
+            : montauk::malloc((uint64_t)new_cap * sizeof(WpEdit));
+        if (!mem) {
+            if (removed) montauk::mfree(removed);
+            return;
+        }
+        step->edits = (WpEdit*)mem;
+        step->edit_cap = new_cap;
+    }
+
+    WpPiece* ins = nullptr;
+    if (inserted_count > 0) {
+        ins = (WpPiece*)montauk::malloc((uint64_t)inserted_count * sizeof(WpPiece));
+        if (!ins) {
+            if (removed) montauk::mfree(removed);
+            return;
+        }
+        montauk::memcpy(ins, inserted, (uint64_t)inserted_count * sizeof(WpPiece));
+    }
+
+    if (step->edit_count == 0) wp_current_caret(wp, &step->before);
+    WpEdit* e = &step->edits[step->edit_count++];
+    e->pos = pos;
+    e->removed = removed;
+    e->removed_count = removed_count;
+    e->inserted = ins;
+    e->inserted_count = inserted_count;
+}
+
+// Replace the `len` characters at pos with the given pieces. If out_removed
+// is set it receives the replaced pieces (allocated, caller frees).
+static bool wp_splice(WordProcessorState* wp, int pos, int len, const WpPiece* pieces, int count,
+                      WpPiece** out_removed, int* out_removed_count) {
+    if (!wp_reserve_nodes(wp, count + 2)) return false;
+
+    int para = wp_breaks_before(wp, pos);
+    int old_breaks = wp_breaks_before(wp, pos + len) - para;
+    int new_breaks = 0;
+    for (int i = 0; i < count; i++) {
+        if (pieces[i].is_break) new_breaks++;
+    }
+
+    int a, b, c;
+    wp_split(wp, wp->root, pos, &a, &b);
+    wp_split(wp, b, len, &b, &c);
+
+    WpPiece* removed = nullptr;
+    int removed_count = 0;
+    if (out_removed && b) {
+        removed = (WpPiece*)montauk::malloc((uint64_t)wp_count_nodes(wp, b) * sizeof(WpPiece));
+        if (!removed) {
+            wp->root = wp_merge(wp, wp_merge(wp, a, b), c);
+            return false;
+        }
+    }
+    wp_release_tree(wp, b, removed, &removed_count);
+
+    // Pieces that continue each other in the buffer become one node
+    int mid = 0;
+    for (int i = 0; i < count; ) {
+        WpPiece p = pieces[i++];
+        while (!p.is_break && i < count && !pieces[i].is_break &&
+               wp_same_char_style(&p, &pieces[i]) && p.start + p.len == pieces[i].start)
+            p.len += pieces[i++].len;
+        if (p.len > 0) mid = wp_merge(wp, mid, wp_node_alloc(wp, &p));
+    }
+
+    wp->root = wp_merge(wp, wp_merge(wp, a, mid), c);
+    wp_update_totals(wp);
+    wp_layout_changed(wp, para, old_breaks + 1, new_breaks + 1);
+
+    if (out_removed) {
+        *out_removed = removed;
+        *out_removed_count = removed_count;
+    }
+    return true;
+}
+
+void wp_pieces_clear(WordProcessorState* wp) {
+    wp->root = 0;
+    wp->node_top = 1;
+    wp->node_free = 0;
+    wp->text_len = 0;
+    wp->total_text_len = 0;
+    wp->lookup_node = 0;
+    wp->wrap_dirty = true;
+}
+
+void wp_pieces_free(WordProcessorState* wp) {
+    if (wp->nodes) montauk::mfree(wp->nodes);
+    if (wp->text) montauk::mfree(wp->text);
+    wp->nodes = nullptr;
+    wp->node_cap = 0;
+    wp->text = nullptr;
+    wp->text_cap = 0;
+    wp_pieces_clear(wp);
+}
+
+// Append to the text buffer; returns where the text starts, or -1
+int wp_append_text(WordProcessorState* wp, const char* text, int len) {
+    if (wp->text_len + len > wp->text_cap) {
+        int new_cap = wp->text_cap > 0 ? wp->text_cap : 4096;
+        while (new_cap < wp->text_len + len) new_cap *= 2;
+        void* mem = wp->text
+            ? montauk::realloc(wp->text, new_cap)
+            : montauk::malloc(new_cap);
+        if (!mem) return -1;
+        wp->text = (char*)mem;
+        wp->text_cap = new_cap;
+    }
+    int start = wp->text_len;
+    montauk::memcpy(wp->text + start, text, len);
+    wp->text_len += len;
+    return start;
+}
+
+// Add a piece at the end of the document, outside the edit history
+bool wp_push_piece(WordProcessorState* wp, const WpPiece* piece) {
+    if (!wp_reserve_nodes(wp, 1)) return false;
+    wp->root = wp_merge(wp, wp->root, wp_node_alloc(wp, piece));
+    wp_update_totals(wp);
+    return true;
+}
+
+const WpPiece* wp_piece_at(WordProcessorState* wp, int abs_pos, int* out_offset) {
+    int start = 0;
+    int n = abs_pos >= 0 ? wp_find_node(wp, abs_pos, &start) : 0;
+    if (!n) return nullptr;
+    *out_offset = abs_pos - start;
+    return &wp->nodes[n].piece;
+}
+
+int wp_breaks_before(WordProcessorState* wp, int abs_pos) {
+    int count = 0;
+    int n = wp->root;
+    int base = 0;
+    while (n) {
+        WpNode* node = &wp->nodes[n];
+        int left_len = node->left ? wp->nodes[node->left].sum_len : 0;
+        if (abs_pos < base + left_len) {
+            n = node->left;
+            continue;
+        }
+        if (node->left) count += wp->nodes[node->left].sum_breaks;
+        int at = base + left_len;
+        if (abs_pos < at + node->piece.len) break;
+        if (node->piece.is_break) count++;
+        base = at + node->piece.len;
+        n = node->right;
+    }
+    return count;
+}
+
+// Position of the first character of paragraph `para`
+int wp_paragraph_start(WordProcessorState* wp, int para) {
+    if (para <= 0) return 0;
+    int pos;
+    if (!wp_find_break(wp, para - 1, &pos)) return wp->total_text_len;
+    return pos + 1;
+}
+
+int wp_paragraph_count(WordProcessorState* wp) {
+    int count = wp->root ? wp->nodes[wp->root].sum_breaks : 0;
+    return count > 0 ? count : 1;
+}
+
+const ParagraphStyle* wp_paragraph_style(WordProcessorState* wp, int para) {
+    static const ParagraphStyle fallback = { PARA_ALIGN_LEFT, PARA_LIST_NONE, 100, 0, 0, 0, 0, 0 };
+    int count = wp_paragraph_count(wp);
+    if (para >= count) para = count - 1;
+    if (para < 0) para = 0;
+    int pos;
+    int n = wp_find_break(wp, para, &pos);
+    return n ? &wp->nodes[n].piece.para : &fallback;
+}
+
+bool wp_set_paragraph_style(WordProcessorState* wp, int para, const ParagraphStyle* style) {
+    int pos;
+    int n = wp_find_break(wp, para, &pos);
+    if (!n) return false;
+    if (memcmp(&wp->nodes[n].piece.para, style, sizeof(ParagraphStyle)) == 0) return false;
+
+    WpPiece* old = (WpPiece*)montauk::malloc(sizeof(WpPiece));
+    if (!old) return false;
+    *old = wp->nodes[n].piece;
+    WpPiece updated = *old;
+    updated.para = *style;
+    wp_record(wp, pos, old, 1, &updated, 1);
+    wp->nodes[n].piece.para = *style;
+    wp_layout_changed(wp, para, 1, 1);
+    return true;
+}
+
+bool wp_replace(WordProcessorState* wp, int pos, int len, const WpPiece* pieces, int count) {
+    WpPiece* removed = nullptr;
+    int removed_count = 0;
+    if (!wp_splice(wp, pos, len, pieces, count, &removed, &removed_count)) return false;
+    wp_record(wp, pos, removed, removed_count, pieces, count);
+    return true;
+}
+
+// Insert one piece. Typing appends to the buffer right after the previous
+// character's text, so that piece just grows instead of splitting the tree.
+bool wp_insert_piece(WordProcessorState* wp, int pos, const WpPiece* piece) {
+    if (pos > 0 && !piece->is_break) {
+        int start = 0;
+        int n = wp_find_node(wp, pos - 1, &start);
+        WpPiece* prev = n ? &wp->nodes[n].piece : nullptr;
+        if (prev && !prev->is_break && start + prev->len == pos &&
+            prev->start + prev->len == piece->start && wp_same_char_style(prev, piece)) {
+            wp_record(wp, pos, nullptr, 0, piece, 1);
+            int m = wp->root;
+            int base = 0;
+            while (m != n) {
+                WpNode* node = &wp->nodes[m];
+                node->sum_len += piece->len;
+                int left_len = node->left ? wp->nodes[node->left].sum_len : 0;
+                if (pos - 1 < base + left_len) {
+                    m = node->left;
+                } else {
+                    base += left_len + node->piece.len;
+                    m = node->right;
+                }
+            }
+            wp->nodes[n].piece.len += piece->len;
+            wp->nodes[n].sum_len += piece->len;
+            wp_update_totals(wp);
+            int para = wp_breaks_before(wp, pos);
+            wp_layout_changed(wp, para, 1, 1);
+            return true;
+        }
+    }
+    return wp_replace(wp, pos, 0, piece, 1);
+}
+
+// Copies of the pieces covering [pos, pos + len), trimmed to it; returns
+// their count, with *out allocated (caller frees)
+int wp_copy_pieces(WordProcessorState* wp, int pos, int len, WpPiece** out) {
+    *out = nullptr;
+    int count = 0;
+    for (int at = pos; at < pos + len; ) {
+        int offset;
+        const WpPiece* p = wp_piece_at(wp, at, &offset);
+        if (!p) break;
+        at += p->len - offset;
+        count++;
+    }
+    if (count == 0) return 0;
+
+    WpPiece* pieces = (WpPiece*)montauk::malloc((uint64_t)count * sizeof(WpPiece));
+    if (!pieces) return 0;
+    int i = 0;
+    for (int at = pos; at < pos + len && i < count; i++) {
+        int offset;
+        const WpPiece* p = wp_piece_at(wp, at, &offset);
+        pieces[i] = *p;
+        pieces[i].start += offset;
+        pieces[i].len -= offset;
+        if (pieces[i].len > pos + len - at) pieces[i].len = pos + len - at;
+        at += pieces[i].len;
+    }
+    *out = pieces;
+    return i;
+}
+
+// ============================================================================
+// History
+// ============================================================================
+
+static void wp_restore_caret(WordProcessorState* wp, const WpCaret* caret) {
+    wp->cursor = gui_clamp(caret->cursor, 0, wp->total_text_len);
+    wp->sel_anchor = gui_clamp(caret->sel_anchor, 0, wp->total_text_len);
+    wp->sel_end = gui_clamp(caret->sel_end, 0, wp->total_text_len);
+    wp->has_selection = caret->has_selection && (wp->sel_anchor != wp->sel_end);
+    wp->modified = wp->undo_pos != wp->saved_pos;
+}
+
+static int wp_pieces_len(const WpPiece* pieces, int count) {
+    int len = 0;
+    for (int i = 0; i < count; i++)
+        len += pieces[i].len;
+    return len;
+}
+
+void wp_history_reset(WordProcessorState* wp) {
+    for (int i = 0; i < wp->undo_count; i++)
+        wp_free_step(&wp->undo[i]);
+    wp_free_step(&wp->pending);
+    wp->undo_count = 0;
+    wp->undo_pos = 0;
+    wp->saved_pos = 0;
+}
+
+void wp_history_checkpoint(WordProcessorState* wp) {
+    if (wp->pending.edit_count == 0) return;
+
+    for (int i = wp->undo_pos; i < wp->undo_count; i++)
+        wp_free_step(&wp->undo[i]);
+    if (wp->saved_pos > wp->undo_pos) wp->saved_pos = -1;
+    wp->undo_count = wp->undo_pos;
+
+    if (wp->undo_count >= WP_UNDO_MAX) {
+        wp_free_step(&wp->undo[0]);
+        for (int i = 1; i < wp->undo_count; i++)
+            wp->undo[i - 1] = wp->undo[i];
+        montauk::memset(&wp->undo[wp->undo_count - 1], 0, sizeof(WpUndoStep));
+        wp->undo_count--;
+        if (wp->saved_pos >= 0) wp->saved_pos--;
+    }
+
+    wp_current_caret(wp, &wp->pending.after);
+    wp->undo[wp->undo_count++] = wp->pending;
+    wp->undo_pos = wp->undo_count;
+    montauk::memset(&wp->pending, 0, sizeof(WpUndoStep));
+}
+
+void wp_history_mark_saved(WordProcessorState* wp) {
+    wp_history_checkpoint(wp);
+    wp->modified = false;
+    wp->saved_pos = wp->undo_pos;
+}
+
+bool wp_undo(WordProcessorState* wp) {
+    wp_history_checkpoint(wp);
+    if (wp->undo_pos <= 0) return false;
+
+    WpUndoStep* step = &wp->undo[--wp->undo_pos];
+    for (int i = step->edit_count - 1; i >= 0; i--) {
+        WpEdit* e = &step->edits[i];
+        wp_splice(wp, e->pos, wp_pieces_len(e->inserted, e->inserted_count),
+                  e->removed, e->removed_count, nullptr, nullptr);
+    }
+    wp_restore_caret(wp, &step->before);
+    return true;
+}
+
+bool wp_redo(WordProcessorState* wp) {
+    wp_history_checkpoint(wp);
+    if (wp->undo_pos >= wp->undo_count) return false;
+
+    WpUndoStep* step = &wp->undo[wp->undo_pos++];
+    for (int i = 0; i < step->edit_count; i++) {
+        WpEdit* e = &step->edits[i];
+        wp_splice(wp, e->pos, wp_pieces_len(e->removed, e->removed_count),
+                  e->inserted, e->inserted_count, nullptr, nullptr);
+    }
+    wp_restore_caret(wp, &step->after);
+    return true;
+}
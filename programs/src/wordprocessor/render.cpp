@@ -35,15 +35,8 @@ static void wp_draw_ui_icon_button(Canvas& c, int x, int y, int w, int h,
     wp_draw_ui_button(c, x, y, w, h, fallback, bg, fg, radius);
 }
 
-static ParagraphStyle* wp_current_paragraph_style(WordProcessorState* wp) {
-    if (wp->paragraph_count <= 0) {
-        static ParagraphStyle fallback = { PARA_ALIGN_LEFT, PARA_LIST_NONE, 100, 0, 0, 0, 0, 0 };
-        return &fallback;
-    }
-    int para = wp_find_paragraph_at(wp, wp_abs_pos(wp, wp->cursor_run, wp->cursor_offset));
-    if (para < 0) para = 0;
-    if (para >= wp->paragraph_count) para = wp->paragraph_count - 1;
-    return &wp->paragraphs[para];
+static const ParagraphStyle* wp_current_paragraph_style(WordProcessorState* wp) {
+    return wp_paragraph_style(wp, wp_find_paragraph_at(wp, wp->cursor));
 }
 
 static const char* wp_align_label(uint8_t align) {
@@ -62,11 +55,11 @@ static const char* wp_list_label(uint8_t list_type) {
     }
 }
 
-static void wp_draw_list_marker(Canvas& c, WordProcessorState* wp, WrapLine* wl, int py) {
-    if (!wl->first_in_paragraph || wl->paragraph_idx < 0 || wl->paragraph_idx >= wp->paragraph_count)
+static void wp_draw_list_marker(Canvas& c, WordProcessorState* wp, WrapLine* wl, int py, int number) {
+    if (!wl->first_in_paragraph || wl->paragraph_idx < 0 || wl->paragraph_idx >= wp_paragraph_count(wp))
         return;
 
-    ParagraphStyle* para = &wp->paragraphs[wl->paragraph_idx];
+    const ParagraphStyle* para = wp_paragraph_style(wp, wl->paragraph_idx);
     if (para->list_type == PARA_LIST_NONE) return;
 
     int marker_x = WP_MARGIN + para->left_indent + para->first_line_indent;
@@ -78,9 +71,10 @@ static void wp_draw_list_marker(Canvas& c, WordProcessorState* wp, WrapLine* wl,
     }
 
     char label[16];
-    snprintf(label, sizeof(label), "%d.", wl->list_number > 0 ? wl->list_number : 1);
-    if (wp->run_count <= 0) return;
-    StyledRun* run = &wp->runs[wl->run_idx < wp->run_count ? wl->run_idx : 0];
+    snprintf(label, sizeof(label), "%d.", number > 0 ? number : 1);
+    int offset;
+    const WpPiece* run = wp_piece_at(wp, wl->start, &offset);
+    if (!run) return;
     TrueTypeFont* font = wp_get_font(run->font_id, run->flags);
     int top_y = py + (wl->height - run->size) / 2;
     draw_text(c, font ? font : g_ui_font, marker_x, top_y, label, colors::TEXT_COLOR, run->size);
@@ -94,8 +88,8 @@ void wp_render() {
     c.fill(colors::WINDOW_BG);
 
     int sfh = wp_ui_line_height();
-    int cursor_abs = wp_abs_pos(wp, wp->cursor_run, wp->cursor_offset);
-    ParagraphStyle* cur_para = wp_current_paragraph_style(wp);
+    int cursor_abs = wp->cursor;
+    const ParagraphStyle* cur_para = wp_current_paragraph_style(wp);
     Color toolbar_bg = Color::from_rgb(0xF5, 0xF5, 0xF5);
     Color btn_bg = Color::from_rgb(0xE8, 0xE8, 0xE8);
     Color btn_active = Color::from_rgb(0xC0, 0xD0, 0xE8);
@@ -231,39 +225,55 @@ void wp_render() {
     if (wp->has_selection) wp_sel_range(wp, &sel_s, &sel_e);
     Color sel_bg = Color::from_rgb(0xB0, 0xD0, 0xF0);
 
-    for (int li = 0; li < wp->wrap_line_count; li++) {
-        WrapLine* wl = &wp->wrap_lines[li];
+    // Only the lines in view are visited; list numbers count on from the
+    // first numbered paragraph drawn
+    int line_count = wp_wrap_line_count(wp);
+    int list_para = -1;
+    int list_number = 0;
+    for (int li = wp_wrap_line_at_y(wp, scroll_y); li < line_count; li++) {
+        WrapLine line;
+        if (!wp_wrap_line(wp, li, &line)) break;
+        WrapLine* wl = &line;
         int py = edit_y + wl->y - scroll_y;
 
         if (py + wl->height <= edit_y) continue;
         if (py >= edit_y + text_area_h) break;
 
-        wp_draw_list_marker(c, wp, wl, py);
+        if (wl->first_in_paragraph) {
+            if (wp_paragraph_style(wp, wl->paragraph_idx)->list_type != PARA_LIST_NUMBER)
+                list_number = 0;
+            else if (list_para >= 0 && list_para == wl->paragraph_idx - 1)
+                list_number++;
+            else
+                list_number = wp_list_number(wp, wl->paragraph_idx);
+            list_para = wl->paragraph_idx;
+        }
+        wp_draw_list_marker(c, wp, wl, py, list_number);
 
         int chars_left = wl->char_count;
-        int ri = wl->run_idx;
-        int ro = wl->run_offset;
         int x = wl->x;
-        int line_abs_start = wp_wrap_line_start(wp, li);
+        int line_abs_start = wl->start;
         int char_idx = 0;
 
-        while (chars_left > 0 && ri < wp->run_count) {
-            StyledRun* r = &wp->runs[ri];
+        while (chars_left > 0) {
+            int ro;
+            const WpPiece* r = wp_piece_at(wp, line_abs_start + char_idx, &ro);
+            if (!r) break;
+            int avail = r->len - ro;
+            int to_draw = avail < chars_left ? avail : chars_left;
+
             TrueTypeFont* font = wp_get_font(r->font_id, r->flags);
             if (!font || !font->valid) {
-                ri++;
-                ro = 0;
+                chars_left -= to_draw;
+                char_idx += to_draw;
                 continue;
             }
 
             GlyphCache* gc = font->get_cache(r->size);
             int baseline = py + wl->baseline;
 
-            int avail = r->len - ro;
-            int to_draw = avail < chars_left ? avail : chars_left;
-
             for (int ci = 0; ci < to_draw; ci++) {
-                char ch = r->text[ro + ci];
+                char ch = wp->text[r->start + ro + ci];
                 int abs_ch = line_abs_start + char_idx;
 
                 int char_adv = 0;
@@ -297,14 +307,9 @@ void wp_render() {
             }
 
             chars_left -= to_draw;
-            ro += to_draw;
-            if (ro >= r->len) {
-                ri++;
-                ro = 0;
-            }
         }
 
-        if (line_abs_start + char_idx == cursor_abs && li == wp->wrap_line_count - 1) {
+        if (line_abs_start + char_idx == cursor_abs && li == line_count - 1) {
             int cur_h = wl->height;
             if (py >= edit_y && py + cur_h <= edit_y + text_area_h)
                 c.fill_rect(x, py, 2, cur_h, colors::ACCENT);
@@ -28,12 +28,8 @@ static constexpr int WP_PATHBAR_H      = 32;
 static constexpr int WP_STATUS_H       = 24;
 static constexpr int WP_SCROLLBAR_W    = 12;
 static constexpr int WP_MARGIN         = 16;
-static constexpr int WP_MAX_RUNS       = 1024;
-static constexpr int WP_MAX_TEXT       = 262144;
-static constexpr int WP_MAX_WRAP_LINES = 4096;
-static constexpr int WP_MAX_PARAGRAPHS = 4096;
 static constexpr int WP_DEFAULT_SIZE   = 18;
-static constexpr int WP_UNDO_MAX       = 24;
+static constexpr int WP_UNDO_MAX       = 1024;
 static constexpr int WP_PARA_STEP      = 12;
 static constexpr int WP_SPACE_STEP     = 6;
 static constexpr int WP_LIST_LEFT      = 28;
@@ -96,18 +92,45 @@ struct WPFontTable {
     bool loaded;
 };
 
-struct StyledRun {
-    char* text;
-    int len;
-    int cap;
+struct ParagraphStyle {
+    uint8_t align;
+    uint8_t list_type;
+    uint8_t line_spacing;
+    uint8_t _pad;
+    int16_t left_indent;
+    int16_t first_line_indent;
+    int16_t space_before;
+    int16_t space_after;
+};
+
+// A span of the text buffer in one character style. Each paragraph break
+// is a piece of its own, the '\n' that ends the paragraph, and carries
+// that paragraph's style; the document always ends with a break that is
+// not part of its text, so every paragraph has one.
+struct WpPiece {
+    int32_t start;          // offset in WordProcessorState::text
+    int32_t len;
     uint8_t font_id;
     uint8_t size;
     uint8_t flags;
+    bool is_break;
+    ParagraphStyle para;    // breaks only
+};
+
+// The pieces in document order, as a treap: ordered by position, heap
+// ordered by a random priority, with subtree totals for finding a
+// position or a paragraph in O(log n)
+struct WpNode {
+    WpPiece piece;
+    int32_t left;           // 0 is none
+    int32_t right;
+    uint32_t prio;
+    int32_t sum_len;        // characters in the subtree
+    int32_t sum_breaks;     // paragraph breaks in the subtree
 };
 
 struct WrapLine {
-    int run_idx;
-    int run_offset;
+    int start;
     int char_count;
     int y;
     int height;
@@ -115,29 +138,41 @@ struct WrapLine {
     int x;
     int width;
     int paragraph_idx;
-    int list_number;
     bool first_in_paragraph;
 };
 
-struct ParagraphStyle {
-    uint8_t align;
-    uint8_t list_type;
-    uint8_t line_spacing;
-    uint8_t _pad;
-    int16_t left_indent;
-    int16_t first_line_indent;
-    int16_t space_before;
-    int16_t space_after;
+// The wrapped lines of one paragraph, kept until an edit touches it
+struct WpParaLayout {
+    WrapLine* lines;        // start and y relative to the paragraph
+    int line_count;
+    int line_cap;
+    int height;             // lines plus the space before and after
+    bool valid;
 };
 
-struct UndoSnapshot {
-    uint8_t* data;
-    int size;
-    int cursor_abs;
+// One replacement in the piece table: at pos, `removed` gave way to `inserted`
+struct WpEdit {
+    int pos;
+    WpPiece* removed;
+    int removed_count;
+    WpPiece* inserted;
+    int inserted_count;
+};
+
+struct WpCaret {
+    int cursor;
     int sel_anchor;
     int sel_end;
     bool has_selection;
-    bool modified;
+};
+
+// The edits between two history checkpoints, undone and redone together
+struct WpUndoStep {
+    WpEdit* edits;
+    int edit_count;
+    int edit_cap;
+    WpCaret before;
+    WpCaret after;
 };
 
 inline bool wp_left_held(uint8_t buttons) {
@@ -235,12 +270,21 @@ struct WpScrollbar {
 };
 
 struct WordProcessorState {
-    StyledRun runs[WP_MAX_RUNS];
-    int run_count;
+    char* text;             // append-only; pieces point into it
+    int text_len;
+    int text_cap;
+
+    WpNode* nodes;
+    int node_cap;
+    int node_top;
+    int node_free;
+    int root;
+    uint32_t prio_seed;
+    int lookup_node;        // last piece found by position, 0 if stale
+    int lookup_start;
     int total_text_len;
 
-    int cursor_run;
-    int cursor_offset;
+    int cursor;
 
     int sel_anchor;
     int sel_end;
@@ -254,15 +298,17 @@ struct WordProcessorState {
     WpScrollbar scrollbar;
     int content_height;
 
-    WrapLine* wrap_lines;
-    int wrap_line_count;
-    int wrap_line_cap;
-    bool wrap_dirty;
+    WpParaLayout* layouts;  // one per paragraph
+    int layout_count;
+    int layout_cap;
+    int* layout_heights;    // Fenwick trees over the paragraphs' heights
+    int* layout_lines;      // and line counts
+    bool layout_trees_stale;
+    int dirty_first;        // paragraphs [dirty_first, dirty_end) may need layout
+    int dirty_end;
+    bool wrap_dirty;        // lay out every paragraph again
     int last_wrap_width;
 
-    ParagraphStyle paragraphs[WP_MAX_PARAGRAPHS];
-    int paragraph_count;
-
     bool modified;
     char filepath[256];
     char filename[64];
@@ -277,9 +323,11 @@ struct WordProcessorState {
     bool size_dropdown_open;
     bool line_spacing_dropdown_open;
 
-    UndoSnapshot undo[WP_UNDO_MAX];
+    WpUndoStep undo[WP_UNDO_MAX];
     int undo_count;
-    int undo_pos;
+    int undo_pos;           // steps applied
+    int saved_pos;          // undo_pos when last saved, -1 if no longer reachable
+    WpUndoStep pending;     // edits since the last checkpoint
 };
 
 extern int g_win_w;
@@ -310,8 +358,21 @@ void wp_cleanup_state();
 
 TrueTypeFont* wp_get_font(int font_id, uint8_t flags);
 
-int  wp_abs_pos(WordProcessorState* wp, int run, int offset);
-void wp_pos_to_run(WordProcessorState* wp, int abs_pos, int* out_run, int* out_offset);
+void wp_pieces_clear(WordProcessorState* wp);
+void wp_pieces_free(WordProcessorState* wp);
+int  wp_append_text(WordProcessorState* wp, const char* text, int len);
+bool wp_push_piece(WordProcessorState* wp, const WpPiece* piece);
+bool wp_same_char_style(const WpPiece* a, const WpPiece* b);
+const WpPiece* wp_piece_at(WordProcessorState* wp, int abs_pos, int* out_offset);
+int  wp_breaks_before(WordProcessorState* wp, int abs_pos);
+int  wp_paragraph_count(WordProcessorState* wp);
+int  wp_paragraph_start(WordProcessorState* wp, int para);
+const ParagraphStyle* wp_paragraph_style(WordProcessorState* wp, int para);
+bool wp_set_paragraph_style(WordProcessorState* wp, int para, const ParagraphStyle* style);
+bool wp_replace(WordProcessorState* wp, int pos, int len, const WpPiece* pieces, int count);
+bool wp_insert_piece(WordProcessorState* wp, int pos, const WpPiece* piece);
+int  wp_copy_pieces(WordProcessorState* wp, int pos, int len, WpPiece** out);
+
 char wp_char_at(WordProcessorState* wp, int abs_pos);
 int  wp_find_paragraph_at(WordProcessorState* wp, int abs_pos);
 void wp_selected_paragraph_range(WordProcessorState* wp, int* out_start_para, int* out_end_para);
@@ -340,9 +401,15 @@ void wp_set_line_spacing(WordProcessorState* wp, int value);
 void wp_toggle_list(WordProcessorState* wp, uint8_t list_type);
 void wp_delete_selection(WordProcessorState* wp);
 
+void wp_layout_changed(WordProcessorState* wp, int para, int old_count, int new_count);
+void wp_layout_free(WordProcessorState* wp);
 void wp_recompute_wrap(WordProcessorState* wp, int content_w);
+int  wp_wrap_line_count(WordProcessorState* wp);
+bool wp_wrap_line(WordProcessorState* wp, int line_idx, WrapLine* out);
 int  wp_find_wrap_line(WordProcessorState* wp, int abs_pos);
+int  wp_wrap_line_at_y(WordProcessorState* wp, int y);
 int  wp_wrap_line_start(WordProcessorState* wp, int line_idx);
+int  wp_list_number(WordProcessorState* wp, int para);
 void wp_ensure_cursor_visible(WordProcessorState* wp, int view_h);
 
 void wp_set_filepath(WordProcessorState* wp, const char* path);
@@ -0,0 +1,158 @@
+#!/usr/bin/env python3
+# mkramdisk.py - Build the MontaukOS ramdisk as a USTAR archive, storing
+# larger regular files as packed members (type 'Z') that the kernel unpacks
+# one 64 KiB block at a time on first read.
+# Usage: ./scripts/mkramdisk.py [--no-pack] input_dir output_path
+
+import io
+import os
+import struct
+import sys
+import tarfile
+
+PACKED_TYPE = b"Z"
+PACKED_MAGIC = 0x315A524D   # "MRZ1"
+PACKED_STORED = 0x80000000
+BLOCK_SIZE = 64 * 1024
+MIN_PACK_SIZE = 4 * 1024    # smaller files are not worth a block table
+
+try:
+    import lz4.block as _lz4
+
+    def lz4_block(data):
+        return _lz4.compress(data, mode="high_compression", store_size=False)
+except ImportError:
+    _lz4 = None
+
+    def lz4_block(data):
+        return _greedy_lz4(data)
+
+
+def _length(out, n):
+    while n >= 255:
+        out.append(255)
+        n -= 255
+    out.append(n)
+
+
+def _sequence(out, literals, offset, match_len):
+    lit = len(literals)
+    token = (min(lit, 15) << 4)
+    if offset:
+        token |= min(match_len - 4, 15)
+    out.append(token)
+    if lit >= 15:
+        _length(out, lit - 15)
+    out += literals
+    if offset:
+        out += struct.pack("<H", offset)
+        if match_len - 4 >= 15:
+            _length(out, match_len - 4 - 15)
+
+
+def _greedy_lz4(data):
+    """Plain single-probe hash chain LZ4 compressor, used when the lz4
+    module is missing. Keeps the format's end rules: the last 5 bytes are
+    literals and no match starts within 12 bytes of the end."""
+    n = len(data)
+    out = bytearray()
+    table = {}
+    anchor = 0
+    i = 0
+    limit = n - 12
+    while i < limit:
+        key = data[i:i + 4]
+        cand = table.get(key)
+        table[key] = i
+        if cand is None or i - cand > 0xFFFF:
+            i += 1
+            continue
+        length = 4
+        end = n - 5
+        while i + length < end and data[cand + length] == data[i + length]:
+            length += 1
+        _sequence(out, data[anchor:i], i - cand, length)
+        i += length
+        anchor = i
+    _sequence(out, data[anchor:], 0, 0)
+    return bytes(out)
+
+
+def pack(data):
+    """The packed form of data, or None when it does not shrink enough."""
+    blocks = []
+    ends = []
+    pos = 0
+    for start in range(0, len(data), BLOCK_SIZE):
+        raw = data[start:start + BLOCK_SIZE]
+        comp = lz4_block(raw)
+        if len(comp) < len(raw):
+            blocks.append(comp)
+            pos += len(comp)
+            ends.append(pos)
+        else:
+            blocks.append(raw)
+            pos += len(raw)
+            ends.append(pos | PACKED_STORED)
+
+    header = struct.pack("<IIQII", PACKED_MAGIC, BLOCK_SIZE, len(data), len(blocks), 0)
+    table = struct.pack("<%dI" % len(ends), *ends)
+    packed = header + table + b"".join(blocks)
+    if len(packed) > len(data) - len(data) // 8:
+        return None
+    return packed
+
+
+def build(input_dir, output_path, packing):
+    raw_total = 0
+    out_total = 0
+    packed_files = 0
+    with tarfile.open(output_path, "w", format=tarfile.USTAR_FORMAT) as tar:
+        for root, dirs, files in os.walk(input_dir):
+            dirs.sort()
+            files.sort()
+            rel_root = os.path.relpath(root, input_dir)
+            arc_root = "." if rel_root == "." else "./" + rel_root
+
+            tar.add(root, arcname=arc_root, recursive=False)
+            for name in files:
+                path = os.path.join(root, name)
+                arcname = arc_root + "/" + name
+                info = tar.gettarinfo(path, arcname=arcname)
+                if not info.isreg():
+                    tar.addfile(info)
+                    continue
+
+                with open(path, "rb") as f:
+                    data = f.read()
+                raw_total += len(data)
+
+                packed = pack(data) if packing and len(data) >= MIN_PACK_SIZE else None
+                if packed is not None:
+                    info.type = PACKED_TYPE
+                    data = packed
+                    packed_files += 1
+                info.size = len(data)
+                out_total += len(data)
+                tar.addfile(info, io.BytesIO(data))
+
+    if packed_files:
+        codec = "lz4" if _lz4 else "builtin lz4"
+        print("mkramdisk: packed %d files with %s, %d -> %d bytes of file data"
+              % (packed_files, codec, raw_total, out_total))
+
+
+def main(argv):
+    packing = True
+    if argv and argv[0] == "--no-pack":
+        packing = False
+        argv = argv[1:]
+    if len(argv) != 2:
+        print("usage: mkramdisk.py [--no-pack] input_dir output_path", file=sys.stderr)
+        return 1
+    build(argv[0], argv[1], packing)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv[1:]))
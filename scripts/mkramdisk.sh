@@ -14,7 +14,16 @@ if [ ! -d "$INPUT_DIR" ]; then
     echo "MontaukOS ramdisk" > "$INPUT_DIR/readme.txt"
 fi
 
-# Create USTAR tar archive
-tar --format=ustar -cf "$OUTPUT_PATH" -C "$INPUT_DIR" .
+# Create USTAR tar archive, with larger files LZ4-packed when python3 is
+# around. MKRAMDISK_PACK=0 leaves every file as is.
+if command -v python3 >/dev/null 2>&1; then
+    if [ "${MKRAMDISK_PACK:-1}" = "0" ]; then
+        python3 "$(dirname "$0")/mkramdisk.py" --no-pack "$INPUT_DIR" "$OUTPUT_PATH"
+    else
+        python3 "$(dirname "$0")/mkramdisk.py" "$INPUT_DIR" "$OUTPUT_PATH"
+    fi
+else
+    tar --format=ustar -cf "$OUTPUT_PATH" -C "$INPUT_DIR" .
+fi
 
 echo "mkramdisk: created $OUTPUT_PATH from $INPUT_DIR ($(wc -c < "$OUTPUT_PATH") bytes)"